@@ -38,6 +38,8 @@
 #define SPI_END       2
 #define SPI_COMPLETE  3
 
+#define SPI_BURST_MAX_BYTES     64      // size of the SPI data registers (W0..W15)
+
 //#define MSG(fmt, ...) printf("[%u] ksz8851: " fmt, mp_hal_ticks_ms(), ##__VA_ARGS__)
 #define MSG(fmt, ...) (void)0
 
@@ -99,6 +101,52 @@ static IRAM_ATTR uint8_t spi_byte(uint8_t outdat) {
     return READ_PERI_REG(SPI_W0_REG(KSZ8851_SPI_NUM));
 }
 
+/* spi_burst() sends and receives len bytes, up to 64 per SPI transaction
+ * instead of one (zeros are sent if outbuf is NULL, received bytes are discarded if inbuf is NULL)
+ */
+static IRAM_ATTR void spi_burst(const uint8_t *outbuf, uint8_t *inbuf, uint32_t len) {
+    while (len > 0) {
+        uint32_t n = (len > SPI_BURST_MAX_BYTES) ? SPI_BURST_MAX_BYTES : len;
+
+        // load the send buffer, the data registers only accept 32-bit writes
+        for (uint32_t i = 0; i < n; i += 4) {
+            uint32_t word = 0;
+            if (outbuf) {
+                for (uint32_t j = i; j < i + 4 && j < n; j++) {
+                    word |= (uint32_t)outbuf[j] << ((j - i) << 3);
+                }
+            }
+            WRITE_PERI_REG(SPI_W0_REG(KSZ8851_SPI_NUM) + i, word);
+        }
+
+        // set the data buffer length and start the transaction
+        SET_PERI_REG_BITS(SPI_MOSI_DLEN_REG(KSZ8851_SPI_NUM), SPI_USR_MOSI_DBITLEN, (n << 3) - 1, SPI_USR_MOSI_DBITLEN_S);
+        SET_PERI_REG_BITS(SPI_MISO_DLEN_REG(KSZ8851_SPI_NUM), SPI_USR_MISO_DBITLEN, (n << 3) - 1, SPI_USR_MISO_DBITLEN_S);
+        SET_PERI_REG_MASK(SPI_CMD_REG(KSZ8851_SPI_NUM), SPI_USR);
+        while (READ_PERI_REG(SPI_CMD_REG(KSZ8851_SPI_NUM)) & SPI_USR);
+
+        // read data out
+        if (inbuf) {
+            uint32_t word = 0;
+            for (uint32_t j = 0; j < n; j++) {
+                if ((j & 3) == 0) {
+                    word = READ_PERI_REG(SPI_W0_REG(KSZ8851_SPI_NUM) + j);
+                }
+                inbuf[j] = word >> ((j & 3) << 3);
+            }
+            inbuf += n;
+        }
+        if (outbuf) {
+            outbuf += n;
+        }
+        len -= n;
+    }
+
+    // back to single byte transactions for spi_byte()
+    SET_PERI_REG_BITS(SPI_MOSI_DLEN_REG(KSZ8851_SPI_NUM), SPI_USR_MOSI_DBITLEN, 7, SPI_USR_MOSI_DBITLEN_S);
+    SET_PERI_REG_BITS(SPI_MISO_DLEN_REG(KSZ8851_SPI_NUM), SPI_USR_MISO_DBITLEN, 7, SPI_USR_MISO_DBITLEN_S);
+}
+
 static IRAM_ATTR void gpio_set_value(pin_obj_t *pin_o, uint32_t value) {
     // set the pin value
     if (value) {
@@ -134,8 +182,12 @@ static IRAM_ATTR void spi_op(uint8_t phase, uint16_t cmd, uint8_t *buf, uint16_t
         }
     }
 
-    /* Data phase */
-    if ((opcode == IO_RD) || (opcode == FIFO_RD)) {
+    /* Data phase, FIFO accesses move whole frames so they go in bursts */
+    if (opcode == FIFO_RD) {
+        spi_burst(NULL, buf, len);
+    } else if (opcode == FIFO_WR) {
+        spi_burst(buf, NULL, len);
+    } else if (opcode == IO_RD) {
         for (ii = 0; ii < len; ii++)
             *buf++ = spi_byte(0);
     } else {
@@ -499,12 +551,13 @@ void ksz8851EndPacketSend(void) {
     while (ksz8851_regrd(REG_TXQ_CMD) & TXQ_ENQUEUE);
 }
 
-/* ksz8851RetrievePacketData() is used to retrieve the payload of a
- * packet.  It may be called as many times as necessary to retrieve
- * the entire payload.
+/* ksz8851BeginPacketRetrieve() checks the frame at the head of the RXQ.
+ * A valid one is opened for reading: its payload length (without the CRC)
+ * is returned in *length, and the number of bytes ksz8851RetrievePacketChunk()
+ * must read, DWORD aligned and CRC included, is returned.
+ * An invalid or errored frame is released, and 0 is returned.
  */
-void ksz8851RetrievePacketData(unsigned char *localBuffer, unsigned int *length, uint16_t frameCnt, uint16_t frameCntTotal) {
-    //spi_op(SPI_CONTINUE, FIFO_RD, localBuffer, length);
+unsigned int ksz8851BeginPacketRetrieve(unsigned int *length) {
     size_t rxPacketLength = 0;
     uint16_t status;
     uint8_t dummy[4];
@@ -523,64 +576,65 @@ void ksz8851RetrievePacketData(unsigned char *localBuffer, unsigned int *length,
     size_t lengthInDWord = ( (rxPacketLength +3) >> 2);
     size_t lengthInByte = ( lengthInDWord * 4 );
 
-    //Make sure the frame is valid
-    if (status & RX_VALID)
-    {
-        //Check error flags
-        if (!(status & (RX_ERRORS)))
-        {
-
-            //Ensure the frame size is acceptable
-            if(rxPacketLength > 4 && rxPacketLength <= ETHERNET_RX_PACKET_BUFF_SIZE)
-            {
-                //Reset QMU RXQ frame pointer to zero
-                //spi_clrbits(REG_RX_ADDR_PTR, ADDR_PTR_MASK);
-                ksz8851_regwr(REG_RX_ADDR_PTR, 0x4000);
-                //Enable RXQ read access
-                spi_setbits(REG_RXQ_CMD, RXQ_START);
-                /* Read 4-byte garbage - must read out dummy 4-byte */
-                spi_op(SPI_BEGIN, FIFO_RD, dummy, 4);
-                /* Read out 2-byte Status Word and
-                   Read out 2-byte Byte Count */
-                spi_op(SPI_CONTINUE, FIFO_RD, dummy, 4);
-
-                /* Read 2-byte IP header offset bytes */
-                spi_op(SPI_CONTINUE, FIFO_RD, dummy, 2);
-                lengthInByte -= 2;
-                rxPacketLength -= 2;
-
-                //Read data
-                spi_op(SPI_END, FIFO_RD, localBuffer, lengthInByte);
-                //End RXQ read access
-                spi_clrbits(REG_RXQ_CMD, RXQ_START);
-                /* pass correct frame to upper layer */
-                rxPacketLength -= 4; // subtract 4-bytes for CRC
-                *length = rxPacketLength;
-                return;
-            }
-            else
-            {
-                // no printf inside portDISABLE_INTERRUPTS()
-                //MSG("Retr[%u/%u] unacceptable frame size: n=%u (4,%u) s=0x%02x a=0x%02x\n", frameCnt, frameCntTotal, n, ETHERNET_RX_PACKET_BUFF_SIZE, status, ksz8851_regrd(REG_RX_ADDR_PTR));
-            }
-        }
-        else
-        {
-            // no printf inside portDISABLE_INTERRUPTS()
-            //MSG("Retr[%u/%u] errors n=%u s=0x%02x a=0x%02x\n\n\n\n\n\n", frameCnt, frameCntTotal, n, status, ksz8851_regrd(REG_RX_ADDR_PTR));
-        }
-    }
-    else
+    //Make sure the frame is valid, without error flags and of an acceptable size
+    // no printf here, this runs inside portDISABLE_INTERRUPTS()
+    if ((status & RX_VALID) && !(status & (RX_ERRORS)) &&
+        rxPacketLength > 4 && rxPacketLength <= ETHERNET_RX_PACKET_BUFF_SIZE)
     {
-        // no printf inside portDISABLE_INTERRUPTS()
-        //MSG("Retr[%u/%u] invalid n=%u s=0x%02x a=%02x\n\n\n\n\n\n", frameCnt, frameCntTotal, n, status, ksz8851_regrd(REG_RX_ADDR_PTR));
+        //Reset QMU RXQ frame pointer to zero
+        //spi_clrbits(REG_RX_ADDR_PTR, ADDR_PTR_MASK);
+        ksz8851_regwr(REG_RX_ADDR_PTR, 0x4000);
+        //Enable RXQ read access
+        spi_setbits(REG_RXQ_CMD, RXQ_START);
+        /* Read 4-byte garbage - must read out dummy 4-byte */
+        spi_op(SPI_BEGIN, FIFO_RD, dummy, 4);
+        /* Read out 2-byte Status Word and
+           Read out 2-byte Byte Count */
+        spi_op(SPI_CONTINUE, FIFO_RD, dummy, 4);
+
+        /* Read 2-byte IP header offset bytes */
+        spi_op(SPI_CONTINUE, FIFO_RD, dummy, 2);
+        lengthInByte -= 2;
+        rxPacketLength -= 2;
+
+        /* pass correct frame to upper layer */
+        *length = rxPacketLength - 4; // subtract 4-bytes for CRC
+        return lengthInByte;
     }
+
     //Release the current error frame from RXQ
     //MSG("clearing\n");
     spi_setbits(REG_RXQ_CMD, RXQ_CMD_FREE_PACKET);
     while ( ksz8851_regrd(REG_RXQ_CMD) & RXQ_CMD_FREE_PACKET ){
         vTaskDelay(1 / portTICK_PERIOD_MS);
     }
+    return 0;
+}
+
+/* ksz8851RetrievePacketChunk() reads the next bytes of the frame opened by
+ * ksz8851BeginPacketRetrieve(), it may be called as many times as needed.
+ */
+void ksz8851RetrievePacketChunk(unsigned char *localBuffer, unsigned int length) {
+    spi_op(SPI_CONTINUE, FIFO_RD, localBuffer, length);
+}
+
+/* ksz8851EndPacketRetrieve() closes the frame read. */
+void ksz8851EndPacketRetrieve(void) {
+    spi_op(SPI_END, FIFO_RD, NULL, 0);
+    //End RXQ read access
+    spi_clrbits(REG_RXQ_CMD, RXQ_START);
+}
+
+/* ksz8851RetrievePacketData() is used to retrieve a whole packet
+ * into localBuffer, which must be ETHERNET_RX_PACKET_BUFF_SIZE bytes.
+ */
+void ksz8851RetrievePacketData(unsigned char *localBuffer, unsigned int *length, uint16_t frameCnt, uint16_t frameCntTotal) {
+    unsigned int lengthInByte = ksz8851BeginPacketRetrieve(length);
+
+    if (lengthInByte) {
+        ksz8851RetrievePacketChunk(localBuffer, lengthInByte);
+        ksz8851EndPacketRetrieve();
+    }
 }
 
 /* ksz8851RegisterLinkStatusCb() register callback for link status update,
@@ -9,6 +9,9 @@ void ksz8851Init(void);
 void ksz8851BeginPacketSend(unsigned int packetLength);
 void ksz8851SendPacketData(unsigned char *localBuffer, unsigned int length);
 void ksz8851EndPacketSend(void);
+unsigned int ksz8851BeginPacketRetrieve(unsigned int *length);
+void ksz8851RetrievePacketChunk(unsigned char *localBuffer, unsigned int length);
+void ksz8851EndPacketRetrieve(void);
 void ksz8851RetrievePacketData(unsigned char *localBuffer, unsigned int *length, uint16_t frameCnt, uint16_t frameCntTotal);
 void ksz8851SpiInit(void);
 bool ksz8851GetLinkStatus(void);
@@ -340,6 +340,13 @@ struct Radio_s
      * \brief Manually resets Lora chip.
      */
     void    ( *Reset )( void );
+    /*!
+     * \brief Puts the radio back in the configuration of this driver after
+     *        another stack (e.g. Sigfox) has used the transceiver
+     *
+     * \remark The upper layer state (MAC, callbacks) is left untouched
+     */
+    void    ( *Restore )( void );
 };
 
 /*!
@@ -152,9 +152,22 @@ const RadioRegisters_t RadioRegsInit[] = RADIO_INIT_REGISTERS_VALUE;
 static RadioEvents_t *RadioEvents;
 
 /*!
- * Reception buffer
+ * Reception buffers, the FIFO is read into them in turn so that in continuous
+ * reception a packet can complete while the previous one is still waiting to
+ * be handed to the RxDone callback
  */
-static uint8_t RxTxBuffer[RX_BUFFER_SIZE];
+static uint8_t RxTxBuffer[RX_BUFFER_SLOTS][RX_BUFFER_SIZE];
+
+/*!
+ * Packet information of each reception buffer
+ */
+static RadioLoRaPacketHandler_t RxPackets[RX_BUFFER_SLOTS];
+
+/*!
+ * Free running counters of the buffers filled and handed over
+ */
+static volatile uint8_t RxPacketsIn;
+static volatile uint8_t RxPacketsOut;
 
 /*
  * Public global variables
@@ -663,8 +676,6 @@ IRAM_ATTR void SX1272SetRx( uint32_t timeout )
         break;
     }
 
-    memset( RxTxBuffer, 0, ( size_t )RX_BUFFER_SIZE );
-
     SX1272.Settings.State = RF_RX_RUNNING;
     if( timeout != 0 )
     {
@@ -874,16 +885,10 @@ IRAM_ATTR uint8_t SX1272Read( uint8_t addr )
 
 IRAM_ATTR void SX1272WriteBuffer( uint8_t addr, uint8_t *buffer, uint8_t size )
 {
-    uint8_t i;
-
     //NSS = 0;
     GpioWrite( &SX1272.Spi.Nss, 0 );
 
-    SpiInOut( &SX1272.Spi, addr | 0x80 );
-    for( i = 0; i < size; i++ )
-    {
-        SpiInOut( &SX1272.Spi, buffer[i] );
-    }
+    SpiBurst( &SX1272.Spi, addr | 0x80, buffer, NULL, size );
 
     //NSS = 1;
     GpioWrite( &SX1272.Spi.Nss, 1 );
@@ -891,17 +896,10 @@ IRAM_ATTR void SX1272WriteBuffer( uint8_t addr, uint8_t *buffer, uint8_t size )
 
 IRAM_ATTR void SX1272ReadBuffer( uint8_t addr, uint8_t *buffer, uint8_t size )
 {
-    uint8_t i;
-
     //NSS = 0;
     GpioWrite( &SX1272.Spi.Nss, 0 );
 
-    SpiInOut( &SX1272.Spi, addr & 0x7F );
-
-    for( i = 0; i < size; i++ )
-    {
-        buffer[i] = SpiInOut( &SX1272.Spi, 0 );
-    }
+    SpiBurst( &SX1272.Spi, addr & 0x7F, NULL, buffer, size );
 
     //NSS = 1;
     GpioWrite( &SX1272.Spi.Nss, 1 );
@@ -947,6 +945,25 @@ void SX1272SetPublicNetwork( bool enable )
     }
 }
 
+void SX1272Restore( void )
+{
+    SX1272Reset( );
+    SX1272SetOpMode( RF_OPMODE_SLEEP );
+
+    // take the DIO interrupt back and reload the register defaults
+    SX1272IoIrqInit( DioIrq );
+    for( uint8_t i = 0; i < sizeof( RadioRegsInit ) / sizeof( RadioRegisters_t ); i++ )
+    {
+        SX1272SetModem( RadioRegsInit[i].Modem );
+        SX1272Write( RadioRegsInit[i].Addr, RadioRegsInit[i].Value );
+    }
+
+    SX1272SetPublicNetwork( SX1272.Settings.LoRa.PublicNetwork );
+    SX1272SetChannel( SX1272.Settings.Channel );
+    SX1272.Settings.State = RF_IDLE;
+    SX1272.irqFlags = 0;
+}
+
 void SX1272OnTimeoutIrq( void )
 {
     switch( SX1272.Settings.State )
@@ -1010,11 +1027,15 @@ IRAM_ATTR void SX1272RadioFlagsIrq (void) {
     }
     if (SX1272.irqFlags & RADIO_IRQ_FLAG_RX_DONE) {
         SX1272.irqFlags &= ~RADIO_IRQ_FLAG_RX_DONE;
-        if( ( RadioEvents != NULL ) && ( RadioEvents->RxDone != NULL ) )
-        {
-            RadioEvents->RxDone( RxTxBuffer, SX1272.Settings.LoRaPacketHandler.TimeStamp, SX1272.Settings.LoRaPacketHandler.Size,
-                                 SX1272.Settings.LoRaPacketHandler.RssiValue, SX1272.Settings.LoRaPacketHandler.SnrValue,
-                                 SX1272.Settings.LoRa.Datarate );
+        while (RxPacketsOut != RxPacketsIn) {
+            uint8_t slot = RxPacketsOut % RX_BUFFER_SLOTS;
+            if( ( RadioEvents != NULL ) && ( RadioEvents->RxDone != NULL ) )
+            {
+                RadioEvents->RxDone( RxTxBuffer[slot], RxPackets[slot].TimeStamp, RxPackets[slot].Size,
+                                     RxPackets[slot].RssiValue, RxPackets[slot].SnrValue,
+                                     SX1272.Settings.LoRa.Datarate );
+            }
+            RxPacketsOut++;
         }
     }
     if (SX1272.irqFlags & RADIO_IRQ_FLAG_RX_ERROR) {
@@ -1119,8 +1140,15 @@ IRAM_ATTR void SX1272OnDio0Irq( void )
                     }
 
                     SX1272.Settings.LoRaPacketHandler.Size = SX1272Read( REG_LR_RXNBBYTES );
-                    SX1272Write( REG_LR_FIFOADDRPTR, SX1272Read( REG_LR_FIFORXCURRENTADDR ) );
-                    SX1272ReadFifo( RxTxBuffer, SX1272.Settings.LoRaPacketHandler.Size );
+                    // if both buffers are still waiting to be handed over the packet is dropped
+                    if( ( uint8_t )( RxPacketsIn - RxPacketsOut ) < RX_BUFFER_SLOTS )
+                    {
+                        uint8_t slot = RxPacketsIn % RX_BUFFER_SLOTS;
+                        SX1272Write( REG_LR_FIFOADDRPTR, SX1272Read( REG_LR_FIFORXCURRENTADDR ) );
+                        SX1272ReadFifo( RxTxBuffer[slot], SX1272.Settings.LoRaPacketHandler.Size );
+                        RxPackets[slot] = SX1272.Settings.LoRaPacketHandler;
+                        RxPacketsIn++;
+                    }
 
                     if( SX1272.Settings.LoRa.RxContinuous == false )
                     {
@@ -140,6 +140,7 @@ typedef void ( DioIrqHandler )( void );
 #define FREQ_STEP                                   61.03515625
 
 #define RX_BUFFER_SIZE                              256
+#define RX_BUFFER_SLOTS                             2
 
 /*!
  * ============================================================================
@@ -413,5 +414,10 @@ void SX1272SetPublicNetwork( bool enable );
  * \brief Resets the SX1272
  */
 void SX1272Reset( void );
+/*!
+ * \brief Restores the register defaults, the DIO interrupt routing and the
+ *        sync word after the transceiver has been used by another stack
+ */
+void SX1272Restore( void );
 
 #endif // __SX1272_H__
@@ -172,9 +172,22 @@ const RadioRegisters_t RadioRegsInit[] = RADIO_INIT_REGISTERS_VALUE;
 static RadioEvents_t *RadioEvents;
 
 /*!
- * Reception buffer
+ * Reception buffers, the FIFO is read into them in turn so that in continuous
+ * reception a packet can complete while the previous one is still waiting to
+ * be handed to the RxDone callback
  */
-static uint8_t RxTxBuffer[RX_BUFFER_SIZE];
+static uint8_t RxTxBuffer[RX_BUFFER_SLOTS][RX_BUFFER_SIZE];
+
+/*!
+ * Packet information of each reception buffer
+ */
+static RadioLoRaPacketHandler_t RxPackets[RX_BUFFER_SLOTS];
+
+/*!
+ * Free running counters of the buffers filled and handed over
+ */
+static volatile uint8_t RxPacketsIn;
+static volatile uint8_t RxPacketsOut;
 
 /*
  * Public global variables
@@ -827,8 +840,6 @@ IRAM_ATTR void SX1276SetRx( uint32_t timeout )
         break;
     }
 
-    memset( RxTxBuffer, 0, ( size_t )RX_BUFFER_SIZE );
-
     SX1276.Settings.State = RF_RX_RUNNING;
     if( timeout != 0 )
     {
@@ -1045,16 +1056,10 @@ IRAM_ATTR uint8_t SX1276Read( uint8_t addr )
 
 IRAM_ATTR void SX1276WriteBuffer( uint8_t addr, uint8_t *buffer, uint8_t size )
 {
-    uint8_t i;
-
     //NSS = 0;
     GpioWrite( &SX1276.Spi.Nss, 0 );
 
-    SpiInOut( &SX1276.Spi, addr | 0x80 );
-    for( i = 0; i < size; i++ )
-    {
-        SpiInOut( &SX1276.Spi, buffer[i] );
-    }
+    SpiBurst( &SX1276.Spi, addr | 0x80, buffer, NULL, size );
 
     //NSS = 1;
     GpioWrite( &SX1276.Spi.Nss, 1 );
@@ -1062,17 +1067,10 @@ IRAM_ATTR void SX1276WriteBuffer( uint8_t addr, uint8_t *buffer, uint8_t size )
 
 IRAM_ATTR void SX1276ReadBuffer( uint8_t addr, uint8_t *buffer, uint8_t size )
 {
-    uint8_t i;
-
     //NSS = 0;
     GpioWrite( &SX1276.Spi.Nss, 0 );
 
-    SpiInOut( &SX1276.Spi, addr & 0x7F );
-
-    for( i = 0; i < size; i++ )
-    {
-        buffer[i] = SpiInOut( &SX1276.Spi, 0 );
-    }
+    SpiBurst( &SX1276.Spi, addr & 0x7F, NULL, buffer, size );
 
     //NSS = 1;
     GpioWrite( &SX1276.Spi.Nss, 1 );
@@ -1118,6 +1116,26 @@ void SX1276SetPublicNetwork( bool enable )
     }
 }
 
+void SX1276Restore( void )
+{
+    SX1276Reset( );
+    RxChainCalibration( );
+    SX1276SetOpMode( RF_OPMODE_SLEEP );
+
+    // take the DIO interrupt back and reload the register defaults
+    SX1276IoIrqInit( DioIrq );
+    for( uint8_t i = 0; i < sizeof( RadioRegsInit ) / sizeof( RadioRegisters_t ); i++ )
+    {
+        SX1276SetModem( RadioRegsInit[i].Modem );
+        SX1276Write( RadioRegsInit[i].Addr, RadioRegsInit[i].Value );
+    }
+
+    SX1276SetPublicNetwork( SX1276.Settings.LoRa.PublicNetwork );
+    SX1276SetChannel( SX1276.Settings.Channel );
+    SX1276.Settings.State = RF_IDLE;
+    SX1276.irqFlags = 0;
+}
+
 void SX1276OnTimeoutIrq( void )
 {
     switch( SX1276.Settings.State )
@@ -1178,11 +1196,15 @@ IRAM_ATTR void SX1276RadioFlagsIrq (void) {
     }
     if (SX1276.irqFlags & RADIO_IRQ_FLAG_RX_DONE) {
         SX1276.irqFlags &= ~RADIO_IRQ_FLAG_RX_DONE;
-        if( ( RadioEvents != NULL ) && ( RadioEvents->RxDone != NULL ) )
-        {
-            RadioEvents->RxDone( RxTxBuffer, SX1276.Settings.LoRaPacketHandler.TimeStamp, SX1276.Settings.LoRaPacketHandler.Size,
-                                 SX1276.Settings.LoRaPacketHandler.RssiValue, SX1276.Settings.LoRaPacketHandler.SnrValue,
-                                 SX1276.Settings.LoRa.Datarate );
+        while (RxPacketsOut != RxPacketsIn) {
+            uint8_t slot = RxPacketsOut % RX_BUFFER_SLOTS;
+            if( ( RadioEvents != NULL ) && ( RadioEvents->RxDone != NULL ) )
+            {
+                RadioEvents->RxDone( RxTxBuffer[slot], RxPackets[slot].TimeStamp, RxPackets[slot].Size,
+                                     RxPackets[slot].RssiValue, RxPackets[slot].SnrValue,
+                                     SX1276.Settings.LoRa.Datarate );
+            }
+            RxPacketsOut++;
         }
     }
     if (SX1276.irqFlags & RADIO_IRQ_FLAG_RX_ERROR) {
@@ -1302,8 +1324,15 @@ IRAM_ATTR void SX1276OnDio0Irq( void )
                     }
 
                     SX1276.Settings.LoRaPacketHandler.Size = SX1276Read( REG_LR_RXNBBYTES );
-                    SX1276Write( REG_LR_FIFOADDRPTR, SX1276Read( REG_LR_FIFORXCURRENTADDR ) );
-                    SX1276ReadFifo( RxTxBuffer, SX1276.Settings.LoRaPacketHandler.Size );
+                    // if both buffers are still waiting to be handed over the packet is dropped
+                    if( ( uint8_t )( RxPacketsIn - RxPacketsOut ) < RX_BUFFER_SLOTS )
+                    {
+                        uint8_t slot = RxPacketsIn % RX_BUFFER_SLOTS;
+                        SX1276Write( REG_LR_FIFOADDRPTR, SX1276Read( REG_LR_FIFORXCURRENTADDR ) );
+                        SX1276ReadFifo( RxTxBuffer[slot], SX1276.Settings.LoRaPacketHandler.Size );
+                        RxPackets[slot] = SX1276.Settings.LoRaPacketHandler;
+                        RxPacketsIn++;
+                    }
 
                     if( SX1276.Settings.LoRa.RxContinuous == false )
                     {
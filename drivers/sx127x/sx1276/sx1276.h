@@ -140,6 +140,7 @@ typedef void ( DioIrqHandler )( void );
 #define FREQ_STEP                                   61.03515625
 
 #define RX_BUFFER_SIZE                              256
+#define RX_BUFFER_SLOTS                             2
 
 /*!
  * ============================================================================
@@ -407,4 +408,14 @@ void SX1276SetMaxPayloadLength( RadioModems_t modem, uint8_t max );
  */
 void SX1276SetPublicNetwork( bool enable );
 
+/*!
+ * \brief Resets the SX1276
+ */
+void SX1276Reset( void );
+/*!
+ * \brief Restores the register defaults, the DIO interrupt routing and the
+ *        sync word after the transceiver has been used by another stack
+ */
+void SX1276Restore( void );
+
 #endif // __SX1276_H__
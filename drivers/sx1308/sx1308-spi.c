@@ -63,6 +63,8 @@ Maintainer: Miguel Luis and Gregory Cristian
 
 #include "sx1308-spi.h"
 
+#define SX1308_SPI_BURST_MAX_BYTES      64      // W0-W15 data registers
+
 
 /*!
  * \brief Initializes the SPI object and MCU peripheral
@@ -139,3 +141,54 @@ IRAM_ATTR uint16_t sx1308_SpiInOut(Spi_sx1308_t *obj, uint16_t outData) {
     // read data out
     return READ_PERI_REG(SPI_W0_REG(spiNum));
 }
+
+/*!
+ * \brief Sends size bytes of outData and stores the received bytes in inData,
+ *        using the 64-byte data buffer of the SPI peripheral so that each
+ *        transaction carries up to 64 bytes instead of a single one
+ *
+ * \param [IN]  obj     SPI object
+ * \param [IN]  outData Bytes to be sent (zeros are sent if NULL)
+ * \param [OUT] inData  Received bytes (discarded if NULL)
+ * \param [IN]  size    Number of bytes
+ */
+IRAM_ATTR void sx1308_SpiInOutBurst(Spi_sx1308_t *obj, const uint8_t *outData, uint8_t *inData, uint32_t size) {
+    uint32_t spiNum = obj->Spi;
+
+    while (size > 0) {
+        uint32_t len = (size > SX1308_SPI_BURST_MAX_BYTES) ? SX1308_SPI_BURST_MAX_BYTES : size;
+
+        // load the send buffer, the data registers only accept 32-bit writes
+        for (uint32_t i = 0; i < len; i += 4) {
+            uint32_t word = 0;
+            if (outData) {
+                for (uint32_t j = i; j < i + 4 && j < len; j++) {
+                    word |= (uint32_t)outData[j] << ((j - i) << 3);
+                }
+            }
+            WRITE_PERI_REG(SPI_W0_REG(spiNum) + i, word);
+        }
+
+        // set the data buffer length and start the transaction
+        SET_PERI_REG_BITS(SPI_MOSI_DLEN_REG(spiNum), SPI_USR_MOSI_DBITLEN, (len << 3) - 1, SPI_USR_MOSI_DBITLEN_S);
+        SET_PERI_REG_BITS(SPI_MISO_DLEN_REG(spiNum), SPI_USR_MISO_DBITLEN, (len << 3) - 1, SPI_USR_MISO_DBITLEN_S);
+        SET_PERI_REG_MASK(SPI_CMD_REG(spiNum), SPI_USR);
+        while (READ_PERI_REG(SPI_CMD_REG(spiNum)) & SPI_USR);
+
+        // read data out
+        if (inData) {
+            uint32_t word = 0;
+            for (uint32_t j = 0; j < len; j++) {
+                if ((j & 3) == 0) {
+                    word = READ_PERI_REG(SPI_W0_REG(spiNum) + j);
+                }
+                inData[j] = word >> ((j & 3) << 3);
+            }
+            inData += len;
+        }
+        if (outData) {
+            outData += len;
+        }
+        size -= len;
+    }
+}
@@ -56,3 +56,5 @@ typedef struct Spi_sx1308_s Spi_sx1308_t;
 extern void sx1308_SpiInit( Spi_sx1308_t *obj);
 
 extern uint16_t sx1308_SpiInOut(Spi_sx1308_t *obj, uint16_t outData);
+
+extern void sx1308_SpiInOutBurst(Spi_sx1308_t *obj, const uint8_t *outData, uint8_t *inData, uint32_t size);
@@ -103,6 +103,9 @@ endif
 ifeq ($(PYETH_ENABLED), 1)
 APP_INC += -I../drivers/ksz8851
 endif
+ifeq ($(MOD_WIZNET5K_ENABLED), 1)
+APP_INC += -I../drivers/wiznet5k
+endif
 APP_INC += -I../ports/stm32
 APP_INC += -I$(ESP_IDF_COMP_PATH)/openthread/src
 
@@ -138,6 +141,7 @@ APP_LIB_SRC_C = $(addprefix lib/,\
 	libm/atanf.c \
 	libm/atan2f.c \
 	mp-readline/readline.c \
+	embed/abort_.c \
 	netutils/netutils.c \
 	utils/pyexec.c \
 	utils/interrupt_char.c \
@@ -151,6 +155,12 @@ APP_MODS_SRC_C = $(addprefix mods/,\
 	machuart.c \
 	machpin.c \
 	machrtc.c \
+	machulp.c \
+	machpcnt.c \
+	machmcpwm.c \
+	machneopixel.c \
+	machonewire.c \
+	machdht.c \
 	pybflash.c \
 	machspi.c \
 	machine_i2c.c \
@@ -169,10 +179,16 @@ APP_MODS_SRC_C = $(addprefix mods/,\
 	machtimer.c \
 	machtimer_alarm.c \
 	machtimer_chrono.c \
+	machtimer_sampler.c \
 	analog.c \
 	pybadc.c \
 	pybdac.c \
 	pybsd.c \
+	pybsdspi.c \
+	machspiflash.c \
+	machnrf24l01.c \
+	machi2s.c \
+	machdisplay.c \
 	modussl.c \
 	modbt.c \
 	modled.c \
@@ -181,6 +197,10 @@ APP_MODS_SRC_C = $(addprefix mods/,\
 	lwipsocket.c \
 	machtouch.c \
 	modmdns.c \
+	modtslog.c \
+	modkvstore.c \
+	modmqttcore.c \
+	modmlinfer.c \
 	)
 ifeq ($(MOD_COAP_ENABLED), 1)
 APP_INC += -Ibsdiff
@@ -229,6 +249,16 @@ APP_UTIL_SRC_C = $(addprefix util/,\
 	esp32chipinfo.c \
 	pycom_general_util.c \
 	str_utils.c \
+	xipimage.c \
+	bootprof.c \
+	fsstate.c \
+	flashstats.c \
+	tracering.c \
+	taskwdt.c \
+	crashdump.c \
+	pwrmgr.c \
+	pollwait.c \
+	btreeport.c \
 	)
 
 APP_FATFS_SRC_C = $(addprefix fatfs/src/,\
@@ -246,6 +276,7 @@ APP_LITTLEFS_SRC_C = $(addprefix littlefs/,\
 
 APP_LORA_SRC_C = $(addprefix lora/,\
 	utilities.c \
+	aes-board.c \
 	timer-board.c \
 	gpio-board.c \
 	spi-board.c \
@@ -265,18 +296,18 @@ APP_MOD_MESH_SRC_C = $(addprefix mods/,\
 	modmesh.c \
 	)
 
+ifeq ($(LORA_REGION),)
+LORA_REGION_SRC_C = $(addprefix mac/region/Region,$(addsuffix .c,$(LORA_REGIONS)))
+else
+LORA_REGION_SRC_C = mac/region/Region$(LORA_REGION).c
+endif
+
 APP_LIB_LORA_SRC_C = $(addprefix lib/lora/,\
 	mac/LoRaMac.c \
 	mac/LoRaMacCrypto.c \
 	mac/region/Region.c \
-	mac/region/RegionAS923.c \
-	mac/region/RegionAU915.c \
 	mac/region/RegionCommon.c \
-	mac/region/RegionEU868.c \
-	mac/region/RegionUS915.c \
-	mac/region/RegionCN470.c \
-	mac/region/RegionEU433.c \
-	mac/region/RegionIN865.c \
+	$(LORA_REGION_SRC_C) \
 	system/delay.c \
 	system/gpio.c \
 	system/timer.c \
@@ -304,6 +335,8 @@ APP_PYGATE_SRC_C = $(addprefix pygate/,\
 	lora_pkt_fwd/jitqueue.c \
 	lora_pkt_fwd/lora_pkt_fwd.c \
 	lora_pkt_fwd/parson.c \
+	lora_pkt_fwd/pkt_json.c \
+	lora_pkt_fwd/pkt_tap.c \
 	lora_pkt_fwd/timersync.c \
 	)
 
@@ -323,6 +356,17 @@ APP_KSZ8851_SRC_C = $(addprefix drivers/ksz8851/,\
 	ksz8851.c \
 	)
 
+APP_WIZNET5K_SRC_C = $(addprefix drivers/wiznet5k/,\
+	ethernet/socket.c \
+	ethernet/wizchip_conf.c \
+	ethernet/w5500/w5500.c \
+	internet/dns/dns.c \
+	)
+
+APP_MODS_WIZNET5K_SRC_C = $(addprefix mods/,\
+	modwiznet5k.c \
+	)
+
 APP_SIGFOX_SRC_SIPY_C = $(addprefix sigfox/src/,\
 	manufacturer_api.c \
 	radio.c \
@@ -363,6 +407,7 @@ APP_LTE_SRC_C = $(addprefix lte/,\
 
 APP_MODS_LTE_SRC_C = $(addprefix mods/,\
     modlte.c \
+    modlteudp.c \
     )
 
 APP_TELNET_SRC_C = $(addprefix telnet/,\
@@ -448,6 +493,12 @@ OBJ += $(addprefix $(BUILD)/, $(APP_KSZ8851_SRC_C:.c=.o) $(APP_ETHERNET_SRC_C:.c
 CFLAGS += -DPYETH_ENABLED
 SRC_QSTR += $(APP_KSZ8851_SRC_C) $(APP_ETHERNET_SRC_C)
 endif
+ifeq ($(MOD_WIZNET5K_ENABLED), 1)
+$(info WIZNET5K Enabled)
+OBJ += $(addprefix $(BUILD)/, $(APP_WIZNET5K_SRC_C:.c=.o) $(APP_MODS_WIZNET5K_SRC_C:.c=.o))
+CFLAGS += -DMOD_WIZNET5K_ENABLED -D_WIZCHIP_=5500
+SRC_QSTR += $(APP_MODS_WIZNET5K_SRC_C)
+endif
 OBJ += $(BUILD)/pins.o
 
 BOOT_OBJ = $(addprefix $(BUILD)/, $(BOOT_SRC_C:.c=.o))
@@ -481,10 +532,18 @@ BOOT_LDFLAGS = $(LDFLAGS) -T esp32.bootloader.ld -T esp32.rom.ld -T esp32.periph
 # add the application linker script(s)
 APP_LDFLAGS += $(LDFLAGS) -T esp32_out.ld -T esp32.project.ld -T esp32.rom.ld -T esp32.peripherals.ld -T esp32.rom.libgcc.ld -T esp32.extram.bss.ld
 APP_LDFLAGS += $(LDFLAGS_MOD)
+# the panic handler saves a crash summary to RTC memory before the console core dump
+APP_LDFLAGS += -Wl,--wrap=esp_core_dump_to_uart
 # add the application specific CFLAGS
 CFLAGS += $(APP_INC) -DMICROPY_NLR_SETJMP=1 -DMBEDTLS_CONFIG_FILE='"mbedtls/esp_config.h"' -DHAVE_CONFIG_H -DESP_PLATFORM -DFFCONF_H=\"lib/oofatfs/ffconf.h\" -DWITH_POSIX
 CFLAGS_SIGFOX += $(APP_INC) -DMICROPY_NLR_SETJMP=1 -DMBEDTLS_CONFIG_FILE='"mbedtls/esp_config.h"' -DHAVE_CONFIG_H -DESP_PLATFORM
-CFLAGS += -DREGION_AS923 -DREGION_AU915 -DREGION_EU868 -DREGION_US915 -DREGION_CN470 -DREGION_EU433 -DREGION_IN865 -DBASE=0 -DPYBYTES=1 
+ifeq ($(LORA_REGION),)
+CFLAGS += $(addprefix -DREGION_,$(LORA_REGIONS))
+else
+# a single region, Region.c calls it directly and the tables of the others aren't linked in
+CFLAGS += -DREGION_$(LORA_REGION) -DLORAMAC_REGION_SINGLE=LORAMAC_REGION_$(LORA_REGION)
+endif
+CFLAGS += -DBASE=0 -DPYBYTES=1 
 
 # Specify if this is Firmware build has Pybytes enabled
 ifeq ($(PYBYTES_ENABLED), 1)
@@ -320,6 +320,41 @@ static bool get_image_from_partition(const esp_partition_pos_t *partition, esp_i
     return false;
 }
 
+// Loads an image verified by a previous boot: the RAM segments are copied as they
+// are, without the checksum and the SHA256 over the whole image. Only used on
+// a deep sleep wake, where the RTC segments are left alone like the IDF loader does.
+static bool load_trusted_image(const esp_partition_pos_t *partition, esp_image_metadata_t *data)
+{
+    memset(data, 0, sizeof(esp_image_metadata_t));
+    data->start_addr = partition->offset;
+    if (bootloader_flash_read(partition->offset, &data->image, sizeof(esp_image_header_t), true) != ESP_OK ||
+        data->image.magic != ESP_IMAGE_HEADER_MAGIC || data->image.segment_count > ESP_IMAGE_MAX_SEGMENTS) {
+        return false;
+    }
+    uint32_t next_addr = partition->offset + sizeof(esp_image_header_t);
+    for (int i = 0; i < data->image.segment_count; i++) {
+        esp_image_segment_header_t *header = &data->segments[i];
+        if (bootloader_flash_read(next_addr, header, sizeof(esp_image_segment_header_t), true) != ESP_OK) {
+            return false;
+        }
+        next_addr += sizeof(esp_image_segment_header_t);
+        data->segment_data[i] = next_addr;
+        uint32_t load_addr = header->load_addr;
+        if ((load_addr >= SOC_IRAM_LOW && load_addr < SOC_IRAM_HIGH) ||
+            (load_addr >= SOC_DRAM_LOW && load_addr < SOC_DRAM_HIGH)) {
+            const void *src = bootloader_mmap(next_addr, header->data_len);
+            if (!src) {
+                return false;
+            }
+            memcpy((void *)load_addr, src, header->data_len);
+            bootloader_munmap(src);
+        }
+        next_addr += header->data_len;
+    }
+    data->image_len = next_addr - partition->offset;
+    return true;
+}
+
 static bool find_active_image(bootloader_state_t *bs, esp_partition_pos_t *partition)
 {
     boot_info_t *boot_info;
@@ -387,6 +422,7 @@ static bool find_active_image(bootloader_state_t *bs, esp_partition_pos_t *parti
 
         // do we have a new image that needs to be verified?
         if (boot_info->Status == IMG_STATUS_CHECK) {
+            bootmgr_image_token_clear();
             if (boot_info->ActiveImg == IMG_ACT_UPDATE2) {
                 boot_info->ActiveImg = IMG_ACT_FACTORY;    // we only have space for 1 OTA image
             }
@@ -514,7 +550,14 @@ static void bootloader_main()
         return;
     }
 
-    get_image_from_partition(&partition, &image_data);
+    // on a deep sleep wake the image can't have changed since it was last verified
+    if (!bootmgr_image_token_check(&partition) || !load_trusted_image(&partition, &image_data)) {
+        if (get_image_from_partition(&partition, &image_data)) {
+            bootmgr_image_token_set(&partition, image_data.image_len);
+        } else {
+            bootmgr_image_token_clear();
+        }
+    }
 
 #ifdef CONFIG_SECURE_BOOT_ENABLED
     // Generate secure digest from this bootloader to protect future modifications
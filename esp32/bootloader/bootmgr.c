@@ -8,10 +8,12 @@
  */
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
+#include <sys/param.h>
 
 #include "mpconfigboard.h"
 
@@ -20,10 +22,15 @@
 #include "esp_system.h"
 #include "esp_spi_flash.h"
 #include "nvs_flash.h"
+#include "esp_log.h"
+#include "rom/rtc.h"
+#include "rom/crc.h"
+#include "soc/soc.h"
 
 #include "gpio.h"
 #include "mperror.h"
 #include "bootloader.h"
+#include "bootmgr.h"
 
 //*****************************************************************************
 // Local Constants
@@ -46,6 +53,7 @@
 //*****************************************************************************
 static bool wait_while_blinking (uint32_t wait_time, uint32_t period, bool force_wait);
 static bool safe_boot_request_start (uint32_t wait_time);
+static void bootmgr_store_timing (uint32_t shared, uint32_t start_ms, uint32_t end_ms);
 
 //*****************************************************************************
 // Private data
@@ -95,11 +103,61 @@ static bool safe_boot_request_start (uint32_t wait_time) {
     return gpio_get_level(MICROPY_HW_SAFE_PIN_NUM) ? true : false;
 }
 
+//*****************************************************************************
+//! Leave the boot timing in the RTC register shared with the application
+//*****************************************************************************
+static void bootmgr_store_timing (uint32_t shared, uint32_t start_ms, uint32_t end_ms) {
+    uint32_t boot_ms = MIN(end_ms, BOOTMGR_RTC_TIME_MASK);
+    uint32_t safe_boot_ms = MIN(end_ms - start_ms, BOOTMGR_RTC_TIME_MASK);
+    REG_WRITE(BOOTMGR_RTC_SHARED_REG, (shared & BOOTMGR_RTC_FAST_BOOT_REQ) | BOOTMGR_RTC_TIMING_VALID |
+                                      (boot_ms << BOOTMGR_RTC_BOOT_TIME_SHIFT) |
+                                      (safe_boot_ms << BOOTMGR_RTC_SAFE_BOOT_TIME_SHIFT));
+}
+
+static uint32_t bootmgr_image_token_crc (const bootmgr_image_token_t *token) {
+    return crc32_le(0, (const uint8_t *)token, offsetof(bootmgr_image_token_t, crc));
+}
+
+//*****************************************************************************
+//! Whether the image at partition can be loaded without verifying it: only on
+//! a deep sleep wake, when it is the last image this bootloader verified
+//*****************************************************************************
+bool bootmgr_image_token_check (const esp_partition_pos_t *partition) {
+#ifdef CONFIG_SECURE_BOOT_ENABLED
+    // the signature must be checked on every boot
+    return false;
+#else
+    volatile bootmgr_image_token_t *rtc = BOOTMGR_RTC_IMAGE_TOKEN;
+    // word by word, RTC memory doesn't take the byte accesses of a struct copy
+    bootmgr_image_token_t token = { .magic = rtc->magic, .offset = rtc->offset, .length = rtc->length, .crc = rtc->crc };
+    return rtc_get_reset_reason(0) == DEEPSLEEP_RESET && token.magic == BOOTMGR_RTC_IMAGE_TOKEN_MAGIC &&
+           token.crc == bootmgr_image_token_crc(&token) && token.offset == partition->offset &&
+           token.length <= partition->size;
+#endif
+}
+
+void bootmgr_image_token_set (const esp_partition_pos_t *partition, uint32_t length) {
+    bootmgr_image_token_t token = { .magic = BOOTMGR_RTC_IMAGE_TOKEN_MAGIC, .offset = partition->offset, .length = length };
+    volatile bootmgr_image_token_t *rtc = BOOTMGR_RTC_IMAGE_TOKEN;
+    rtc->offset = token.offset;
+    rtc->length = token.length;
+    rtc->crc = bootmgr_image_token_crc(&token);
+    rtc->magic = token.magic;
+}
+
 //*****************************************************************************
 //! Check for the safe mode pin
 //*****************************************************************************
 uint32_t wait_for_safe_boot (const boot_info_t *boot_info, uint32_t *ActiveImg) {
     uint32_t ret = 0;
+    uint32_t shared = REG_READ(BOOTMGR_RTC_SHARED_REG);
+    uint32_t start_ms = esp_log_early_timestamp();
+
+    // waking up from deep sleep with fast boot enabled, don't wait for the pin
+    if ((shared & BOOTMGR_RTC_FAST_BOOT_REQ) && rtc_get_reset_reason(0) == DEEPSLEEP_RESET) {
+        bootmgr_store_timing(shared, start_ms, start_ms);
+        return 0;
+    }
 
     // configure the safeboot pin
     gpio_config_t gpioconf = {.pin_bit_mask = 1ull << MICROPY_HW_SAFE_PIN_NUM,
@@ -129,5 +187,6 @@ uint32_t wait_for_safe_boot (const boot_info_t *boot_info, uint32_t *ActiveImg)
     // deinit the safe boot pin
     gpioconf.pull_down_en = GPIO_PULLDOWN_DISABLE;
     gpio_config(&gpioconf);
+    bootmgr_store_timing(shared, start_ms, esp_log_early_timestamp());
     return ret;
 }
@@ -11,7 +11,39 @@
 #define __BOOTMGR_H
 
 #include "bootloader.h"
+#include "soc/rtc_cntl_reg.h"
+#include "soc/soc.h"
+
+// RTC_CNTL_STORE0_REG is left unused by the IDF and keeps its value across a
+// deep sleep. The application sets the fast boot request bit in it, and the
+// bootloader hands back how long it took to reach the image and how much of
+// that was spent on the safe boot pin check.
+#define BOOTMGR_RTC_SHARED_REG              RTC_CNTL_STORE0_REG
+#define BOOTMGR_RTC_FAST_BOOT_REQ           (1UL << 31)
+#define BOOTMGR_RTC_TIMING_VALID            (1UL << 30)
+#define BOOTMGR_RTC_TIME_MASK               (0x7FFF)
+#define BOOTMGR_RTC_BOOT_TIME_SHIFT         (15)
+#define BOOTMGR_RTC_SAFE_BOOT_TIME_SHIFT    (0)
+
+// The last bytes of RTC slow memory lie past the rtc_slow_seg of the application
+// (esp32.project.ld checks it) and survive a deep sleep. The bootloader leaves
+// there the image it has just verified, so that a deep sleep wake can load that
+// same image again without hashing it. The application clears it before touching
+// the image partitions.
+typedef struct {
+    uint32_t magic;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t crc;                           // CRC32 of the fields above
+} bootmgr_image_token_t;
+
+#define BOOTMGR_RTC_IMAGE_TOKEN             ((volatile bootmgr_image_token_t *)(SOC_RTC_DATA_HIGH - sizeof(bootmgr_image_token_t)))
+#define BOOTMGR_RTC_IMAGE_TOKEN_MAGIC       (0x564D4749)
+
+#define bootmgr_image_token_clear()         (BOOTMGR_RTC_IMAGE_TOKEN->magic = 0)
 
 bool wait_for_safe_boot (const boot_info_t *boot_info, uint32_t *ActiveImg);
+bool bootmgr_image_token_check (const esp_partition_pos_t *partition);
+void bootmgr_image_token_set (const esp_partition_pos_t *partition, uint32_t length);
 
 #endif // __BOOTMGR_H
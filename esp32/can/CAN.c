@@ -35,6 +35,7 @@
 #include "esp_intr.h"
 #include "soc/dport_reg.h"
 #include <math.h>
+#include <string.h>
 
 #include "driver/gpio.h"
 
@@ -44,12 +45,43 @@
 
 static void CAN_read_frame(void);
 static void CAN_isr(void *arg_p);
+static void CAN_load_frame(const CAN_frame_t* p_frame);
 
 static bool isr_installed = false;
 static CAN_frame_format_t CAN_frame_format;
 static CAN_sw_filters_t *CAN_sw_filters;
 
+// a frame is in the transmit buffer, the TX interrupt loads the next queued one
+static volatile bool CAN_tx_busy = false;
+static portMUX_TYPE CAN_tx_mux = portMUX_INITIALIZER_UNLOCKED;
+static CAN_stats_t CAN_stats;
+
 extern void can_queue_interrupt(uint32_t events);
+extern bool can_dispatch_frame(const CAN_frame_t *frame);
+extern uint64_t mach_rtc_ticks_us64(void);
+
+// nominal length of a frame with the interframe space, without the stuff bits
+static uint32_t CAN_frame_bits(const CAN_frame_t* p_frame) {
+    uint32_t bits = (p_frame->FIR.B.FF == CAN_frame_ext) ? 67 : 47;
+    if (p_frame->FIR.B.RTR == CAN_no_RTR) {
+        bits += 8 * p_frame->FIR.B.DLC;
+    }
+    return bits;
+}
+
+// the TX interrupt or bus on again: load the next queued frame, if any
+static void CAN_tx_next_from_isr(void) {
+    CAN_frame_t frame;
+    portENTER_CRITICAL_ISR(&CAN_tx_mux);
+    if (CAN_cfg.tx_queue && xQueueReceiveFromISR(CAN_cfg.tx_queue, &frame, NULL) == pdTRUE) {
+        CAN_tx_busy = true;
+        CAN_load_frame(&frame);
+        CAN_stats.bits += CAN_frame_bits(&frame);
+    } else {
+        CAN_tx_busy = false;
+    }
+    portEXIT_CRITICAL_ISR(&CAN_tx_mux);
+}
 
 static void CAN_isr(void *arg_p){
 
@@ -59,24 +91,42 @@ static void CAN_isr(void *arg_p){
     // Read interrupt status and clear flags
     interrupt = MODULE_CAN->IR.U;
 
+    // Handle RX frame available interrupt
+    if ((interrupt & __CAN_IRQ_RX) != 0)
+        CAN_read_frame();
+
     // Handle TX complete interrupt
     if ((interrupt & __CAN_IRQ_TX) != 0) {
-        /*handler*/
+        if (MODULE_CAN->SR.B.TCS) {
+            CAN_stats.tx_frames++;
+        }
+        CAN_tx_next_from_isr();
     }
 
-    // Handle RX frame available interrupt
-    if ((interrupt & __CAN_IRQ_RX) != 0)
-        CAN_read_frame();
+    if ((interrupt & __CAN_IRQ_DATA_OVERRUN) != 0) {
+        CAN_stats.overruns++;
+        MODULE_CAN->CMR.B.CDO = 1;
+    }
+    if ((interrupt & __CAN_IRQ_ARB_LOST) != 0) {
+        CAN_stats.arb_lost++;
+        (void)MODULE_CAN->ALC;
+    }
+    if ((interrupt & __CAN_IRQ_BUS_ERR) != 0) {
+        CAN_stats.bus_errors++;
+        (void)MODULE_CAN->ECC;
+    }
 
-    // Handle error interrupts.
-    if ((interrupt & (__CAN_IRQ_ERR                        //0x4
-                      | __CAN_IRQ_DATA_OVERRUN            //0x8
-                      | __CAN_IRQ_WAKEUP                //0x10
-                      | __CAN_IRQ_ERR_PASSIVE            //0x20
-                      | __CAN_IRQ_ARB_LOST                //0x40
-                      | __CAN_IRQ_BUS_ERR                //0x80
-    )) != 0) {
-        /*handler*/
+    // The error status or the bus status changed
+    if ((interrupt & __CAN_IRQ_ERR) != 0) {
+        if (MODULE_CAN->SR.B.BS) {
+            // bus off puts the controller in reset mode, leaving it starts the recovery sequence
+            CAN_stats.bus_off++;
+            CAN_tx_busy = false;
+            MODULE_CAN->MOD.B.RM = 0;
+        } else if (!CAN_tx_busy) {
+            // back on the bus, resume sending the queued frames
+            CAN_tx_next_from_isr();
+        }
     }
 }
 
@@ -114,6 +164,8 @@ static void CAN_read_frame(void) {
 
     uint32_t events;
 
+    __frame.timestamp = mach_rtc_ticks_us64();
+
     //check if we have a queue. If not, operation is aborted.
     if (CAN_cfg.rx_queue == NULL) {
         goto drop_frame;
@@ -134,10 +186,6 @@ static void CAN_read_frame(void) {
         //Get Message ID
         __frame.MsgID = _CAN_GET_STD_ID;
 
-        if (!CAN_filter_message(__frame.MsgID)) {
-            goto drop_frame;
-        }
-
         //deep copy data bytes
         for(__byte_i=0;__byte_i<__frame.FIR.B.DLC;__byte_i++)
             __frame.data.u8[__byte_i]=MODULE_CAN->MBX_CTRL.FCTRL.TX_RX.STD.data[__byte_i];
@@ -154,16 +202,26 @@ static void CAN_read_frame(void) {
         //Get Message ID
         __frame.MsgID = _CAN_GET_EXT_ID;
 
-        if (!CAN_filter_message(__frame.MsgID)) {
-            goto drop_frame;
-        }
-
         //deep copy data bytes
         for(__byte_i=0;__byte_i<__frame.FIR.B.DLC;__byte_i++)
             __frame.data.u8[__byte_i]=MODULE_CAN->MBX_CTRL.FCTRL.TX_RX.EXT.data[__byte_i];
 
     }
 
+    portENTER_CRITICAL_ISR(&CAN_tx_mux);
+    CAN_stats.rx_frames++;
+    CAN_stats.bits += CAN_frame_bits(&__frame);
+    portEXIT_CRITICAL_ISR(&CAN_tx_mux);
+
+    //frames with a handler of their own don't go through the software filters nor the rx queue
+    if (can_dispatch_frame(&__frame)) {
+        goto drop_frame;
+    }
+
+    if (!CAN_filter_message(__frame.MsgID)) {
+        goto drop_frame;
+    }
+
     events = CAN_RX_FRAME_EVENT;
     if (!uxQueueMessagesWaiting(CAN_cfg.rx_queue)) {
         events |= CAN_FIFO_NOT_EMPTY_EVENT;
@@ -181,15 +239,11 @@ drop_frame:
     MODULE_CAN->CMR.B.RRB=1;
 }
 
-int CAN_write_frame(const CAN_frame_t* p_frame){
+static void CAN_load_frame(const CAN_frame_t* p_frame){
 
     //byte iterator
     uint8_t __byte_i;
 
-    while (MODULE_CAN->SR.B.TS && !MODULE_CAN->SR.B.TBS) {
-        ets_delay_us(50);
-    }
-
     //copy frame information record
     MODULE_CAN->MBX_CTRL.FCTRL.FIR.U=p_frame->FIR.U;
 
@@ -218,10 +272,59 @@ int CAN_write_frame(const CAN_frame_t* p_frame){
 
     // Transmit frame
     MODULE_CAN->CMR.B.TR=1;
+}
+
+int CAN_write_frame(const CAN_frame_t* p_frame){
+
+    while (CAN_tx_busy || (MODULE_CAN->SR.B.TS && !MODULE_CAN->SR.B.TBS)) {
+        ets_delay_us(50);
+    }
+
+    portENTER_CRITICAL(&CAN_tx_mux);
+    CAN_tx_busy = true;
+    CAN_load_frame(p_frame);
+    CAN_stats.bits += CAN_frame_bits(p_frame);
+    portEXIT_CRITICAL(&CAN_tx_mux);
+
+    return 0;
+}
+
+int CAN_queue_frame(const CAN_frame_t* p_frame, TickType_t wait){
+
+    CAN_frame_t frame;
+    bool start;
+
+    if (xQueueSend(CAN_cfg.tx_queue, p_frame, wait) != pdTRUE) {
+        return -1;
+    }
+
+    // with the transmitter idle, nothing else takes frames out of the queue
+    portENTER_CRITICAL(&CAN_tx_mux);
+    start = !CAN_tx_busy;
+    CAN_tx_busy = true;
+    portEXIT_CRITICAL(&CAN_tx_mux);
+    if (start) {
+        if (xQueueReceive(CAN_cfg.tx_queue, &frame, 0) == pdTRUE) {
+            portENTER_CRITICAL(&CAN_tx_mux);
+            CAN_load_frame(&frame);
+            CAN_stats.bits += CAN_frame_bits(&frame);
+            portEXIT_CRITICAL(&CAN_tx_mux);
+        } else {
+            CAN_tx_busy = false;
+        }
+    }
 
     return 0;
 }
 
+void CAN_get_stats(CAN_stats_t *stats, uint8_t *tx_errors, uint8_t *rx_errors) {
+    portENTER_CRITICAL(&CAN_tx_mux);
+    *stats = CAN_stats;
+    portEXIT_CRITICAL(&CAN_tx_mux);
+    *tx_errors = MODULE_CAN->TXERR.U;
+    *rx_errors = MODULE_CAN->RXERR.U;
+}
+
 int CAN_init(CAN_mode_t mode, CAN_frame_format_t frame_format) {
 
     //Time quantum
@@ -293,6 +396,10 @@ int CAN_init(CAN_mode_t mode, CAN_frame_format_t frame_format) {
     //no software filters
     CAN_sw_filters = NULL;
 
+    //nothing being sent, fresh statistics
+    CAN_tx_busy = false;
+    memset(&CAN_stats, 0, sizeof(CAN_stats));
+
     //set to normal mode
     MODULE_CAN->OCR.B.OCMODE=__CAN_OC_NOM;
 
@@ -337,13 +444,20 @@ void CAN_setup_sw_filters(CAN_sw_filters_t *swfilters) {
 void CAN_setup_hw_filters(CAN_hw_filters_t *hwfilters) {
     uint32_t code, mask;
 
+    // the acceptance mask registers use 1 for "don't care", the RTR bit and the data bytes always are
     // enter reset mode
     MODULE_CAN->MOD.B.RM = 1;
     if (hwfilters->num_filters == 1) {
         MODULE_CAN->MOD.B.AFM = 1;
 
-        code = hwfilters->codemask[0][0] << 21;
-        mask = hwfilters->codemask[0][1];
+        // single filter: the whole identifier is compared
+        if (hwfilters->extended) {
+            code = hwfilters->codemask[0][0] << 3;
+            mask = ~(hwfilters->codemask[0][1] << 3);
+        } else {
+            code = hwfilters->codemask[0][0] << 21;
+            mask = ~(hwfilters->codemask[0][1] << 21);
+        }
         MODULE_CAN->MBX_CTRL.ACC.CODE[0] = (code >> 24) & 0xFF;
         MODULE_CAN->MBX_CTRL.ACC.CODE[1] = (code >> 16) & 0xFF;
         MODULE_CAN->MBX_CTRL.ACC.CODE[2] = (code >> 8) & 0xFF;
@@ -355,19 +469,30 @@ void CAN_setup_hw_filters(CAN_hw_filters_t *hwfilters) {
     } else if (hwfilters->num_filters == 2) {
         MODULE_CAN->MOD.B.AFM = 0;
 
-        code = hwfilters->codemask[0][0];
-        mask = hwfilters->codemask[0][1];
-        MODULE_CAN->MBX_CTRL.ACC.CODE[0] = (code >> 8) & 0xFF;
-        MODULE_CAN->MBX_CTRL.ACC.CODE[1] = code & 0xFF;
-        MODULE_CAN->MBX_CTRL.ACC.MASK[0] = (mask >> 8) & 0xFF;
-        MODULE_CAN->MBX_CTRL.ACC.MASK[1] = mask & 0xFF;
-
-        code = hwfilters->codemask[1][0];
-        mask = hwfilters->codemask[1][1];
-        MODULE_CAN->MBX_CTRL.ACC.CODE[2] = (code >> 8) & 0xFF;
-        MODULE_CAN->MBX_CTRL.ACC.CODE[3] = code & 0xFF;
-        MODULE_CAN->MBX_CTRL.ACC.MASK[2] = (mask >> 8) & 0xFF;
-        MODULE_CAN->MBX_CTRL.ACC.MASK[3] = mask & 0xFF;
+        // dual filter: 16 bits each, the whole standard identifier or the 16 MSBs of an extended one
+        uint32_t code16[2], mask16[2];
+        for (int i = 0; i < 2; i++) {
+            if (hwfilters->extended) {
+                code16[i] = (hwfilters->codemask[i][0] >> 13) & 0xFFFF;
+                mask16[i] = ~(hwfilters->codemask[i][1] >> 13) & 0xFFFF;
+            } else {
+                code16[i] = (hwfilters->codemask[i][0] << 5) & 0xFFFF;
+                mask16[i] = ~(hwfilters->codemask[i][1] << 5) & 0xFFFF;
+            }
+        }
+        MODULE_CAN->MBX_CTRL.ACC.CODE[0] = (code16[0] >> 8) & 0xFF;
+        MODULE_CAN->MBX_CTRL.ACC.CODE[1] = code16[0] & 0xFF;
+        MODULE_CAN->MBX_CTRL.ACC.MASK[0] = (mask16[0] >> 8) & 0xFF;
+        MODULE_CAN->MBX_CTRL.ACC.MASK[1] = mask16[0] & 0xFF;
+        MODULE_CAN->MBX_CTRL.ACC.CODE[2] = (code16[1] >> 8) & 0xFF;
+        MODULE_CAN->MBX_CTRL.ACC.CODE[3] = code16[1] & 0xFF;
+        MODULE_CAN->MBX_CTRL.ACC.MASK[2] = (mask16[1] >> 8) & 0xFF;
+        MODULE_CAN->MBX_CTRL.ACC.MASK[3] = mask16[1] & 0xFF;
+        if (!hwfilters->extended) {
+            // the low nibble of the last register belongs to the first data byte of filter 1
+            MODULE_CAN->MBX_CTRL.ACC.CODE[3] &= 0xF0;
+            MODULE_CAN->MBX_CTRL.ACC.MASK[3] |= 0x0F;
+        }
     } else {
         // no acceptance filtering, as we want to fetch all messages
         MODULE_CAN->MBX_CTRL.ACC.CODE[0] = 0;
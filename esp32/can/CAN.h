@@ -78,6 +78,7 @@ typedef struct {
         uint8_t u8[8];                        /**< \brief Payload byte access*/
         uint32_t u32[2];                    /**< \brief Payload u32 access*/
     } data;
+    uint64_t     timestamp;                 /**< \brief Monotonic time of reception in us, see mach_rtc_ticks_us64() */
 }CAN_frame_t;
 
 typedef enum {
@@ -93,10 +94,22 @@ typedef struct {
 }CAN_sw_filters_t;
 
 typedef struct {
-    uint32_t codemask[2][2];
-    uint8_t num_filters;
+    uint32_t codemask[2][2];                /**< \brief id and mask pairs, a mask bit set to 1 must match */
+    uint8_t num_filters;                    /**< \brief 1 uses the single filter mode, 2 the dual filter mode */
+    uint8_t extended;                       /**< \brief the ids are 29 bit, see #CAN_frame_format_t */
 }CAN_hw_filters_t;
 
+/** \brief Counters updated by the ISR */
+typedef struct {
+    uint32_t tx_frames;                     /**< \brief frames transmitted */
+    uint32_t rx_frames;                     /**< \brief frames received, the ones dropped by the software filters included */
+    uint32_t overruns;                      /**< \brief frames lost to a full hardware receive FIFO */
+    uint32_t arb_lost;                      /**< \brief arbitration lost while transmitting */
+    uint32_t bus_errors;                    /**< \brief bit, form, stuff and ACK errors */
+    uint32_t bus_off;                       /**< \brief times the controller went bus off */
+    uint64_t bits;                          /**< \brief estimated bits on the bus for the frames above */
+}CAN_stats_t;
+
 typedef enum {
     CAN_RX_FRAME_EVENT = 1,
     CAN_FIFO_NOT_EMPTY_EVENT = 2,
@@ -119,6 +132,20 @@ int CAN_init(CAN_mode_t mode, CAN_frame_format_t frame_format);
  */
 int CAN_write_frame(const CAN_frame_t* p_frame);
 
+/**
+ * \brief Queue a can frame, the TX interrupt sends the queued frames back to back
+ *
+ * \param    p_frame    Pointer to the frame to be send, see #CAN_frame_t
+ * \param    wait       Ticks to wait for room in the queue
+ * \return  0 Frame has been queued, -1 the queue stayed full
+ */
+int CAN_queue_frame(const CAN_frame_t* p_frame, TickType_t wait);
+
+/**
+ * \brief Copy the statistics and the error counters
+ */
+void CAN_get_stats(CAN_stats_t *stats, uint8_t *tx_errors, uint8_t *rx_errors);
+
 /**
  * \brief Stops the CAN Module
  *
@@ -50,6 +50,7 @@ typedef struct  {
     gpio_num_t             tx_pin_id;        /**< \brief TX pin. */
     gpio_num_t             rx_pin_id;        /**< \brief RX pin. */
     QueueHandle_t         rx_queue;        /**< \brief Handler to FreeRTOS RX queue. */
+    QueueHandle_t         tx_queue;        /**< \brief Handler to FreeRTOS TX queue, see #CAN_queue_frame. */
 }CAN_device_t;
 
 /** \brief CAN configuration reference */
@@ -7,15 +7,18 @@
  * available at https://www.pycom.io/opensource/licensing
  */
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/param.h>
 #include "driver/gpio.h"
 #include "driver/sdmmc_host.h"
 #include "driver/sdmmc_defs.h"
 #include "sdmmc_cmd.h"
 #include "esp_log.h"
 #include "esp_heap_caps.h"
+#include "soc/soc_memory_layout.h"
 #include "lib/oofatfs/ff.h"
 #include "lib/oofatfs/diskio.h"
 #include "sd_diskio.h"
@@ -36,12 +39,66 @@
 #define CARD_VERSION_1              0
 #define CARD_VERSION_2              1
 
+// the bounce buffer is never smaller than this, it also stages transfers for buffers the DMA can't reach
+#define SD_DMA_SECTORS_MIN          8
+
 //*****************************************************************************
 // Disk Info for attached disk
 //*****************************************************************************
 sdmmc_card_t sdmmc_card_info;
 static DSTATUS sd_card_status = STA_NOINIT;
 
+// DMA capable, holds the read-ahead window when it's valid
+static BYTE *sd_dma_buf;
+static UINT sd_dma_sectors;
+static UINT sd_readahead_sectors = SD_READAHEAD_SECTORS_DEFAULT;
+static DWORD sd_cache_start;
+static UINT sd_cache_count;
+// where the last read ended, read-ahead only kicks in for sequential reads
+static DWORD sd_next_sector = UINT32_MAX;
+static sd_disk_stats_t sd_stats;
+
+//*****************************************************************************
+// Local functions
+//*****************************************************************************
+static bool sd_dma_capable (const void *buf) {
+    return esp_ptr_dma_capable(buf) && ((intptr_t)buf % 4) == 0;
+}
+
+static bool sd_dma_buf_alloc (void) {
+    UINT sectors = MAX(sd_readahead_sectors, SD_DMA_SECTORS_MIN);
+    if (sd_dma_buf && sd_dma_sectors == sectors) {
+        return true;
+    }
+    heap_caps_free(sd_dma_buf);
+    sd_cache_count = 0;
+    sd_dma_buf = heap_caps_malloc(sectors * SD_SECTOR_SIZE, MALLOC_CAP_DMA);
+    sd_dma_sectors = (sd_dma_buf != NULL) ? sectors : 0;
+    return sd_dma_buf != NULL;
+}
+
+static bool sd_read_card (BYTE *buf, DWORD sector, UINT count) {
+    sd_stats.reads++;
+    // several sectors at once go out as a single CMD18
+    if (ESP_OK != sdmmc_read_sectors(&sdmmc_card_info, buf, sector, count)) {
+        sd_stats.errors++;
+        return false;
+    }
+    sd_stats.sectors_read += count;
+    return true;
+}
+
+static bool sd_write_card (const BYTE *buf, DWORD sector, UINT count) {
+    sd_stats.writes++;
+    // several sectors at once go out as a single CMD25
+    if (ESP_OK != sdmmc_write_sectors(&sdmmc_card_info, buf, sector, count)) {
+        sd_stats.errors++;
+        return false;
+    }
+    sd_stats.sectors_written += count;
+    return true;
+}
+
 //*****************************************************************************
 //
 //! Initializes physical drive
@@ -50,12 +107,12 @@ static DSTATUS sd_card_status = STA_NOINIT;
 //!
 //! \return Returns 0 on succeeded.
 //*****************************************************************************
-DSTATUS sd_disk_init (void) {
+DSTATUS sd_disk_init (uint8_t width, uint32_t freq_khz) {
     sdmmc_host_t config =
     {
-        .flags = SDMMC_HOST_FLAG_1BIT,
+        .flags = (width == 4) ? (SDMMC_HOST_FLAG_4BIT | SDMMC_HOST_FLAG_1BIT) : SDMMC_HOST_FLAG_1BIT,
         .slot = SDMMC_HOST_SLOT_1,
-        .max_freq_khz = SDMMC_FREQ_DEFAULT,
+        .max_freq_khz = freq_khz,
         .io_voltage = 3.3f,
         .init = &sdmmc_host_init,
         .set_bus_width = &sdmmc_host_set_bus_width,
@@ -69,8 +126,16 @@ DSTATUS sd_disk_init (void) {
     gpio_set_pull_mode(2, GPIO_PULLUP_ONLY);
     gpio_set_pull_mode(14, GPIO_PULLUP_ONLY);
     gpio_set_pull_mode(15, GPIO_PULLUP_ONLY);
+    if (width == 4) {
+        // D1 to D3
+        gpio_set_pull_mode(4, GPIO_PULLUP_ONLY);
+        gpio_set_pull_mode(12, GPIO_PULLUP_ONLY);
+        gpio_set_pull_mode(13, GPIO_PULLUP_ONLY);
+    }
 
-    if (ESP_OK == sdmmc_card_init(&config, &sdmmc_card_info)) {
+    sd_cache_count = 0;
+    sd_next_sector = UINT32_MAX;
+    if (sd_dma_buf_alloc() && ESP_OK == sdmmc_card_init(&config, &sdmmc_card_info)) {
         sd_card_status = 0;
     } else {
         sd_card_status = STA_NOINIT;
@@ -88,6 +153,28 @@ DSTATUS sd_disk_init (void) {
 void sd_disk_deinit (void) {
     sdmmc_card_info.csd.capacity = 0;
     sd_card_status = STA_NOINIT;
+    sd_cache_count = 0;
+    heap_caps_free(sd_dma_buf);
+    sd_dma_buf = NULL;
+    sd_dma_sectors = 0;
+}
+
+//*****************************************************************************
+//
+//! Sets the number of sectors read in one go when reads are sequential, 0 disables read-ahead
+//
+//*****************************************************************************
+bool sd_disk_set_readahead (UINT sectors) {
+    sd_readahead_sectors = sectors;
+    if (sd_card_status != 0) {
+        // takes effect at the next init
+        return true;
+    }
+    return sd_dma_buf_alloc();
+}
+
+void sd_disk_get_stats (sd_disk_stats_t *stats) {
+    memcpy(stats, &sd_stats, sizeof(sd_disk_stats_t));
 }
 
 //*****************************************************************************
@@ -101,12 +188,45 @@ void sd_disk_deinit (void) {
 //
 //*****************************************************************************
 DRESULT sd_disk_read (BYTE* pBuffer, DWORD ulSectorNumber, UINT SectorCount) {
-    if (SectorCount > 0) {
-        if (ESP_OK == sdmmc_read_sectors(&sdmmc_card_info, pBuffer, ulSectorNumber, SectorCount)) {
-            return RES_OK;
+    if (SectorCount == 0 || sd_dma_buf == NULL) {
+        return RES_ERROR;
+    }
+
+    bool sequential = (ulSectorNumber == sd_next_sector);
+    sd_next_sector = ulSectorNumber + SectorCount;
+
+    // served from the read-ahead window
+    if (sd_cache_count > 0 && ulSectorNumber >= sd_cache_start &&
+        ulSectorNumber + SectorCount <= sd_cache_start + sd_cache_count) {
+        sd_stats.readahead_hits++;
+        memcpy(pBuffer, sd_dma_buf + (ulSectorNumber - sd_cache_start) * SD_SECTOR_SIZE, SectorCount * SD_SECTOR_SIZE);
+        return RES_OK;
+    }
+
+    // big reads to memory the DMA can reach go straight to the caller's buffer
+    if (sd_dma_capable(pBuffer) && SectorCount >= sd_readahead_sectors) {
+        return sd_read_card(pBuffer, ulSectorNumber, SectorCount) ? RES_OK : RES_ERROR;
+    }
+
+    while (SectorCount > 0) {
+        UINT count = MIN(SectorCount, sd_dma_sectors);
+        UINT fetch = count;
+        if (sequential && count < sd_readahead_sectors) {
+            // fill the window, FatFS reads a cluster or a FAT sector at a time
+            fetch = MIN(sd_readahead_sectors, sdmmc_card_info.csd.capacity - ulSectorNumber);
         }
+        sd_cache_count = 0;
+        if (!sd_read_card(sd_dma_buf, ulSectorNumber, fetch)) {
+            return RES_ERROR;
+        }
+        sd_cache_start = ulSectorNumber;
+        sd_cache_count = fetch;
+        memcpy(pBuffer, sd_dma_buf, count * SD_SECTOR_SIZE);
+        pBuffer += count * SD_SECTOR_SIZE;
+        ulSectorNumber += count;
+        SectorCount -= count;
     }
-    return RES_ERROR;
+    return RES_OK;
 }
 
 //*****************************************************************************
@@ -120,10 +240,30 @@ DRESULT sd_disk_read (BYTE* pBuffer, DWORD ulSectorNumber, UINT SectorCount) {
 //
 //*****************************************************************************
 DRESULT sd_disk_write (const BYTE* pBuffer, DWORD ulSectorNumber, UINT SectorCount) {
-    if (SectorCount > 0) {
-        if (ESP_OK == sdmmc_write_sectors(&sdmmc_card_info, pBuffer, ulSectorNumber, SectorCount)) {
-            return RES_OK;
+    if (SectorCount == 0 || sd_dma_buf == NULL) {
+        return RES_ERROR;
+    }
+
+    // drop the read-ahead window if it overlaps
+    if (sd_cache_count > 0 && ulSectorNumber < sd_cache_start + sd_cache_count &&
+        sd_cache_start < ulSectorNumber + SectorCount) {
+        sd_cache_count = 0;
+    }
+
+    if (sd_dma_capable(pBuffer)) {
+        return sd_write_card(pBuffer, ulSectorNumber, SectorCount) ? RES_OK : RES_ERROR;
+    }
+    // staged through the bounce buffer, still several sectors per command
+    sd_cache_count = 0;
+    while (SectorCount > 0) {
+        UINT count = MIN(SectorCount, sd_dma_sectors);
+        memcpy(sd_dma_buf, pBuffer, count * SD_SECTOR_SIZE);
+        if (!sd_write_card(sd_dma_buf, ulSectorNumber, count)) {
+            return RES_ERROR;
         }
+        pBuffer += count * SD_SECTOR_SIZE;
+        ulSectorNumber += count;
+        SectorCount -= count;
     }
-    return RES_ERROR;
+    return RES_OK;
 }
@@ -11,6 +11,16 @@
 #define SD_DISKIO_H_
 
 #define SD_SECTOR_SIZE                          512
+#define SD_READAHEAD_SECTORS_DEFAULT            8
+
+typedef struct {
+    uint32_t reads;             // commands, each one may cover many sectors
+    uint32_t writes;
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+    uint32_t readahead_hits;
+    uint32_t errors;
+} sd_disk_stats_t;
 
 //*****************************************************************************
 // Disk Info Structure definition
@@ -18,8 +28,10 @@
 
 extern sdmmc_card_t sdmmc_card_info;
 
-DSTATUS sd_disk_init (void);
+DSTATUS sd_disk_init (uint8_t width, uint32_t freq_khz);
 void sd_disk_deinit (void);
+bool sd_disk_set_readahead (UINT sectors);
+void sd_disk_get_stats (sd_disk_stats_t *stats);
 DRESULT sd_disk_read (BYTE* pBuffer, DWORD ulSectorNumber, UINT bSectorCount);
 DRESULT sd_disk_write (const BYTE* pBuffer, DWORD ulSectorNumber, UINT bSectorCount);
 
@@ -1,6 +1,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
 #include "py/mpconfig.h"
 #include "py/obj.h"
@@ -13,36 +14,195 @@
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "freertos/queue.h"
+#include "freertos/timers.h"
 
 #include "esp_spi_flash.h"
 #include "esp_flash_encrypt.h"
 #include "esp32chipinfo.h"
-
-static uint8_t *sflash_block_cache;
-static bool sflash_cache_is_dirty;
-static uint32_t sflash_prev_block_addr;
+#include "flashstats.h"
+
+typedef struct {
+    uint8_t *data;
+    uint32_t addr;
+    uint32_t used;          // LRU stamp
+    bool dirty;
+} sflash_cache_entry_t;
+
+typedef struct {
+    const uint8_t *ptr;
+    spi_flash_mmap_handle_t handle;
+    uint32_t addr;
+    uint32_t used;          // LRU stamp
+} sflash_window_t;
+
+static sflash_cache_entry_t *sflash_cache;
+static uint32_t sflash_cache_count;
+static uint32_t sflash_cache_clock;
+static sflash_cache_stats_t sflash_cache_stats;
+static SemaphoreHandle_t sflash_cache_mutex;
+static TimerHandle_t sflash_idle_timer;
+static sflash_window_t sflash_windows[SFLASH_MMAP_WINDOWS];
+static uint32_t sflash_window_clock;
 static bool sflash_init_done = false;
 
 static uint32_t sflash_start_address;
 static uint32_t sflash_fs_sector_count;
 
 
-static bool sflash_write (void) {
+static bool sflash_write (sflash_cache_entry_t *entry) {
     esp_err_t wr_result = ESP_FAIL;
 
     // erase the block first
-    if (ESP_OK == spi_flash_erase_sector(sflash_prev_block_addr / SFLASH_BLOCK_SIZE)) {
+    int64_t start = esp_timer_get_time();
+    esp_err_t er_result = spi_flash_erase_sector(entry->addr / SFLASH_BLOCK_SIZE);
+    flashstats_record(FLASHSTATS_FATFS, FLASHSTATS_ERASE, SFLASH_BLOCK_SIZE, start, er_result);
+    if (ESP_OK == er_result) {
+            sflash_cache_stats.erases++;
             // then write it
+            start = esp_timer_get_time();
             if (esp_flash_encryption_enabled()) {
-                // sflash_prev_block_addr being 4KB block address is aligned 32B
-                wr_result = spi_flash_write_encrypted(sflash_prev_block_addr, (void *)sflash_block_cache, SFLASH_BLOCK_SIZE);
+                // the 4KB block address is aligned 32B
+                wr_result = spi_flash_write_encrypted(entry->addr, (void *)entry->data, SFLASH_BLOCK_SIZE);
             } else {
-                wr_result = spi_flash_write(sflash_prev_block_addr, (void *)sflash_block_cache, SFLASH_BLOCK_SIZE);
+                wr_result = spi_flash_write(entry->addr, (void *)entry->data, SFLASH_BLOCK_SIZE);
             }
+            flashstats_record(FLASHSTATS_FATFS, FLASHSTATS_PROGRAM, SFLASH_BLOCK_SIZE, start, wr_result);
     }
     return (wr_result == ESP_OK);
 }
 
+// returns a pointer to addr through a mapped window, remapping the least recently used one on a miss
+static const uint8_t *sflash_window_get (uint32_t addr) {
+    uint32_t base = addr & ~(SFLASH_MMAP_WINDOW_SIZE - 1);
+    sflash_window_t *victim = NULL;
+
+    for (int i = 0; i < SFLASH_MMAP_WINDOWS; i++) {
+        sflash_window_t *window = &sflash_windows[i];
+        if (window->ptr && window->addr == base) {
+            window->used = ++sflash_window_clock;
+            return window->ptr + (addr - base);
+        }
+        if (!victim || !window->ptr || (victim->ptr && window->used < victim->used)) {
+            victim = window;
+        }
+    }
+
+    if (victim->ptr) {
+        spi_flash_munmap(victim->handle);
+        victim->ptr = NULL;
+    }
+    const void *ptr;
+    if (ESP_OK != spi_flash_mmap(base, SFLASH_MMAP_WINDOW_SIZE, SPI_FLASH_MMAP_DATA, &ptr, &victim->handle)) {
+        return NULL;
+    }
+    victim->ptr = ptr;
+    victim->addr = base;
+    victim->used = ++sflash_window_clock;
+    return victim->ptr + (addr - base);
+}
+
+// spi_flash_read_encrypted() maps and unmaps the block on every call, flushing the flash
+// cache each time; the windows stay mapped instead (the flash driver flushes the cache
+// after writing or erasing a mapped region), so only the first read of a 64KB page pays for the mapping
+static esp_err_t sflash_read_block (uint32_t block_addr, uint8_t *data) {
+    const uint8_t *src = sflash_window_get(block_addr);
+    if (src) {
+        memcpy(data, src, SFLASH_BLOCK_SIZE);
+        return ESP_OK;
+    }
+    // out of MMU pages
+    return spi_flash_read_encrypted(block_addr, (void *)data, SFLASH_BLOCK_SIZE);
+}
+
+static DRESULT sflash_cache_flush (void) {
+    for (int i = 0; i < sflash_cache_count; i++) {
+        if (sflash_cache[i].dirty) {
+            if (!sflash_write(&sflash_cache[i])) {
+                return RES_ERROR;
+            }
+            sflash_cache[i].dirty = false;
+        }
+    }
+    return RES_OK;
+}
+
+static bool sflash_cache_alloc (void) {
+    if (sflash_cache) {
+        return true;
+    }
+    // only FatFS goes through the cache, so it's not allocated when /flash is littlefs
+    bool psram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM) > 0;
+    uint32_t count = psram ? MICROPY_PORT_SFLASH_CACHE_BLOCKS_PSRAM : MICROPY_PORT_SFLASH_CACHE_BLOCKS;
+    sflash_cache_entry_t *cache = calloc(count, sizeof(sflash_cache_entry_t));
+    if (!cache) {
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        cache[i].data = heap_caps_malloc(SFLASH_BLOCK_SIZE, psram ? MALLOC_CAP_SPIRAM : MALLOC_CAP_INTERNAL);
+        if (!cache[i].data) {
+            // work with the blocks we've got
+            count = i;
+            break;
+        }
+        cache[i].addr = UINT32_MAX;
+    }
+    if (count == 0) {
+        free(cache);
+        return false;
+    }
+    sflash_cache_count = count;
+    sflash_cache_stats.blocks = count;
+    sflash_cache = cache;
+    return true;
+}
+
+// returns the cache entry holding the block, evicting the least recently used one on a miss
+static sflash_cache_entry_t *sflash_cache_get (uint32_t block_addr, bool load) {
+    sflash_cache_entry_t *victim = NULL;
+
+    for (int i = 0; i < sflash_cache_count; i++) {
+        sflash_cache_entry_t *entry = &sflash_cache[i];
+        if (entry->addr == block_addr) {
+            sflash_cache_stats.hits++;
+            flashstats_cache_hit(FLASHSTATS_FATFS);
+            entry->used = ++sflash_cache_clock;
+            return entry;
+        }
+        if (!victim || entry->addr == UINT32_MAX || (victim->addr != UINT32_MAX && entry->used < victim->used)) {
+            victim = entry;
+        }
+    }
+
+    sflash_cache_stats.misses++;
+    if (victim->dirty) {
+        if (!sflash_write(victim)) {
+            return NULL;
+        }
+        victim->dirty = false;
+    }
+    victim->addr = UINT32_MAX;
+    // a block that's about to be overwritten completely doesn't need to be read first
+    if (load) {
+        int64_t start = esp_timer_get_time();
+        esp_err_t err = sflash_read_block(block_addr, victim->data);
+        flashstats_record(FLASHSTATS_FATFS, FLASHSTATS_READ, SFLASH_BLOCK_SIZE, start, err);
+        if (ESP_OK != err) {
+            return NULL;
+        }
+    }
+    victim->addr = block_addr;
+    victim->used = ++sflash_cache_clock;
+    return victim;
+}
+
+static void sflash_idle_flush (TimerHandle_t timer) {
+    // don't hold up the timer task if a file operation is in progress, it will re-arm the timer
+    if (xSemaphoreTake(sflash_cache_mutex, 0) == pdTRUE) {
+        sflash_cache_flush();
+        xSemaphoreGive(sflash_cache_mutex);
+    }
+}
+
 DRESULT sflash_disk_init (void) {
 
     if (!sflash_init_done) {
@@ -54,9 +214,8 @@ DRESULT sflash_disk_init (void) {
             sflash_start_address = SFLASH_START_ADDR_4MB;
             sflash_fs_sector_count = SFLASH_FS_SECTOR_COUNT_4MB;
         }
-        sflash_block_cache = (uint8_t *)malloc(SFLASH_BLOCK_SIZE);
-        sflash_prev_block_addr = UINT32_MAX;
-        sflash_cache_is_dirty = false;
+        sflash_cache_mutex = xSemaphoreCreateMutex();
+        sflash_idle_timer = xTimerCreate("sflash", SFLASH_IDLE_FLUSH_MS / portTICK_PERIOD_MS, pdFALSE, NULL, sflash_idle_flush);
         sflash_init_done = true;
     }
     return RES_OK;
@@ -71,77 +230,73 @@ DRESULT sflash_disk_status(void) {
 
 DRESULT sflash_disk_read(BYTE *buff, DWORD sector, UINT count) {
     uint32_t secindex;
+    DRESULT res = RES_OK;
 
     if ((sector + count > sflash_fs_sector_count) || !count) {
-        // TODO sl_LockObjLock (&flash_LockObj, SL_OS_WAIT_FOREVER);
-        sflash_disk_flush();
-        // TODO sl_LockObjUnlock (&flash_LockObj);
         return RES_PARERR;
     }
 
-    // TODO sl_LockObjLock (&flash_LockObj, SL_OS_WAIT_FOREVER);
+    xSemaphoreTake(sflash_cache_mutex, portMAX_DELAY);
+    if (!sflash_cache_alloc()) {
+        res = RES_ERROR;
+        goto exit;
+    }
     for (int index = 0; index < count; index++) {
         secindex = (sector + index) % SFLASH_SECTORS_PER_BLOCK;
         uint32_t sflash_block_addr = sflash_start_address + (((sector + index) / SFLASH_SECTORS_PER_BLOCK) * SFLASH_BLOCK_SIZE);
-        // Check if it's a different block than last time
-        if (sflash_prev_block_addr != sflash_block_addr) {
-            if (sflash_disk_flush() != RES_OK) {
-                // TODO sl_LockObjUnlock (&flash_LockObj);
-                return RES_ERROR;
-            }
-            sflash_prev_block_addr = sflash_block_addr;
-            if (ESP_OK != spi_flash_read_encrypted(sflash_block_addr, (void *)sflash_block_cache, SFLASH_BLOCK_SIZE)) {
-                // TODO sl_LockObjUnlock (&flash_LockObj);
-                return RES_ERROR;
-            }
+        sflash_cache_entry_t *entry = sflash_cache_get(sflash_block_addr, true);
+        if (!entry) {
+            res = RES_ERROR;
+            goto exit;
         }
         // Copy the requested sector from the block cache
-        memcpy (buff, (void *)&sflash_block_cache[secindex * SFLASH_FS_SECTOR_SIZE], SFLASH_FS_SECTOR_SIZE);
+        memcpy (buff, (void *)&entry->data[secindex * SFLASH_FS_SECTOR_SIZE], SFLASH_FS_SECTOR_SIZE);
         buff += SFLASH_FS_SECTOR_SIZE;
     }
 
-    // TODO sl_LockObjUnlock (&flash_LockObj);
-    return RES_OK;
+exit:
+    xSemaphoreGive(sflash_cache_mutex);
+    return res;
 }
 
 DRESULT sflash_disk_write(const BYTE *buff, DWORD sector, UINT count) {
     uint32_t secindex;
     uint32_t index = 0;
+    DRESULT res = RES_OK;
 
     if ((sector + count > sflash_fs_sector_count) || !count) {
-        // TODO sl_LockObjLock (&flash_LockObj, SL_OS_WAIT_FOREVER);
-        sflash_disk_flush();
-        // TODO sl_LockObjUnlock (&flash_LockObj);
         return RES_PARERR;
     }
 
-    // TODO sl_LockObjLock (&flash_LockObj, SL_OS_WAIT_FOREVER);
+    xSemaphoreTake(sflash_cache_mutex, portMAX_DELAY);
+    if (!sflash_cache_alloc()) {
+        res = RES_ERROR;
+        goto exit;
+    }
     do {
         secindex = (sector + index) % SFLASH_SECTORS_PER_BLOCK;
         uint32_t sflash_block_addr = sflash_start_address + (((sector + index) / SFLASH_SECTORS_PER_BLOCK) * SFLASH_BLOCK_SIZE);
-        // Check if it's a different block than last time
-        if (sflash_prev_block_addr != sflash_block_addr) {
-            if (sflash_disk_flush() != RES_OK) {
-                // TODO sl_LockObjUnlock (&flash_LockObj);
-                return RES_ERROR;
-            }
-            sflash_prev_block_addr = sflash_block_addr;
-            if (ESP_OK != spi_flash_read_encrypted(sflash_block_addr, (void *)sflash_block_cache, SFLASH_BLOCK_SIZE)) {
-//                // TODO sl_LockObjUnlock (&flash_LockObj);
-                return RES_ERROR;
-            }
+        bool whole_block = (secindex == 0) && (count - index >= SFLASH_SECTORS_PER_BLOCK);
+        sflash_cache_entry_t *entry = sflash_cache_get(sflash_block_addr, !whole_block);
+        if (!entry) {
+            res = RES_ERROR;
+            goto exit;
         }
         // copy the input sector to the block cache
-        memcpy ((void *)&sflash_block_cache[secindex * SFLASH_FS_SECTOR_SIZE], buff, SFLASH_FS_SECTOR_SIZE);
+        memcpy ((void *)&entry->data[secindex * SFLASH_FS_SECTOR_SIZE], buff, SFLASH_FS_SECTOR_SIZE);
         buff += SFLASH_FS_SECTOR_SIZE;
-        sflash_cache_is_dirty = true;
+        entry->dirty = true;
     } while (++index < count);
 
-    // TODO sl_LockObjUnlock (&flash_LockObj);
-    return RES_OK;
+    // the dirty blocks go out together once the filesystem has been quiet for a while
+    xTimerReset(sflash_idle_timer, 0);
+
+exit:
+    xSemaphoreGive(sflash_cache_mutex);
+    return res;
 }
 
-int sflash_disk_read_littlefs(const struct lfs_config *lfscfg, void* buff, uint32_t block, uint32_t size)
+int sflash_disk_read_littlefs(const struct lfs_config *lfscfg, void* buff, uint32_t block, uint32_t off, uint32_t size)
 {
     // TODO sl_LockObjLock (&flash_LockObj, SL_OS_WAIT_FOREVER);
     int ret = LFS_ERR_OK;
@@ -149,8 +304,13 @@ int sflash_disk_read_littlefs(const struct lfs_config *lfscfg, void* buff, uint3
     if(block >= lfscfg->block_count) {
         ret = LFS_ERR_IO;
     }
-    else if (ESP_OK != spi_flash_read(sflash_start_address + block*SFLASH_BLOCK_SIZE, buff, size)) {
-        ret = LFS_ERR_IO;
+    else {
+        int64_t start = esp_timer_get_time();
+        esp_err_t err = spi_flash_read(sflash_start_address + block*SFLASH_BLOCK_SIZE + off, buff, size);
+        flashstats_record(FLASHSTATS_LITTLEFS, FLASHSTATS_READ, size, start, err);
+        if (ESP_OK != err) {
+            ret = LFS_ERR_IO;
+        }
     }
 
     // TODO sl_LockObjUnlock (&flash_LockObj);
@@ -165,15 +325,20 @@ int sflash_disk_erase_littlefs(const struct lfs_config *lfscfg, uint32_t block)
     if(block >= lfscfg->block_count) {
         ret = LFS_ERR_IO;
     }
-    else if(ESP_OK != spi_flash_erase_sector((sflash_start_address + block*SFLASH_BLOCK_SIZE)/SFLASH_BLOCK_SIZE)) {
-        ret = LFS_ERR_IO;
+    else {
+        int64_t start = esp_timer_get_time();
+        esp_err_t err = spi_flash_erase_sector((sflash_start_address + block*SFLASH_BLOCK_SIZE)/SFLASH_BLOCK_SIZE);
+        flashstats_record(FLASHSTATS_LITTLEFS, FLASHSTATS_ERASE, SFLASH_BLOCK_SIZE, start, err);
+        if (ESP_OK != err) {
+            ret = LFS_ERR_IO;
+        }
     }
 
     // TODO sl_LockObjUnlock (&flash_LockObj);
     return ret;
 }
 
-int sflash_disk_write_littlefs(const struct lfs_config *lfscfg, const void *buff, uint32_t block, uint32_t size) {
+int sflash_disk_write_littlefs(const struct lfs_config *lfscfg, const void *buff, uint32_t block, uint32_t off, uint32_t size) {
 
     // TODO sl_LockObjLock (&flash_LockObj, SL_OS_WAIT_FOREVER);
     int ret = LFS_ERR_OK;
@@ -181,8 +346,13 @@ int sflash_disk_write_littlefs(const struct lfs_config *lfscfg, const void *buff
     if(block >= lfscfg->block_count) {
         ret = LFS_ERR_IO;
     }
-    else if(ESP_OK != spi_flash_write((sflash_start_address + block*SFLASH_BLOCK_SIZE), buff, size)) {
-        ret = LFS_ERR_IO;
+    else {
+        int64_t start = esp_timer_get_time();
+        esp_err_t err = spi_flash_write((sflash_start_address + block*SFLASH_BLOCK_SIZE + off), buff, size);
+        flashstats_record(FLASHSTATS_LITTLEFS, FLASHSTATS_PROGRAM, size, start, err);
+        if (ESP_OK != err) {
+            ret = LFS_ERR_IO;
+        }
     }
 
     // TODO sl_LockObjUnlock (&flash_LockObj);
@@ -190,14 +360,22 @@ int sflash_disk_write_littlefs(const struct lfs_config *lfscfg, const void *buff
 }
 
 DRESULT sflash_disk_flush (void) {
-    // write back the cache if it's dirty
-    if (sflash_cache_is_dirty) {
-        if (!sflash_write()) {
-            return RES_ERROR;
-        }
-        sflash_cache_is_dirty = false;
+    if (!sflash_init_done) {
+        return RES_OK;
     }
-    return RES_OK;
+    // write back all the dirty blocks
+    xSemaphoreTake(sflash_cache_mutex, portMAX_DELAY);
+    DRESULT res = sflash_cache_flush();
+    xSemaphoreGive(sflash_cache_mutex);
+    return res;
+}
+
+void sflash_disk_get_cache_stats(sflash_cache_stats_t *stats) {
+    memcpy(stats, &sflash_cache_stats, sizeof(sflash_cache_stats_t));
+}
+
+uint32_t sflash_get_start_address(void) {
+    return sflash_start_address;
 }
 
 uint32_t sflash_get_sector_count(void) {
@@ -27,15 +27,31 @@
 #define SFLASH_START_BLOCK_8MB          (SFLASH_START_ADDR_8MB / SFLASH_BLOCK_SIZE)
 #define SFLASH_END_BLOCK_8MB            (SFLASH_START_BLOCK_8MB + (SFLASH_BLOCK_COUNT - 1))
 
+#define SFLASH_IDLE_FLUSH_MS            (1000)
+
+// cache misses are read through windows kept mapped by the flash MMU, which
+// decrypts transparently when flash encryption is on
+#define SFLASH_MMAP_WINDOW_SIZE         SPI_FLASH_MMU_PAGE_SIZE
+#define SFLASH_MMAP_WINDOWS             (4)
+
+typedef struct {
+    uint32_t blocks;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t erases;
+} sflash_cache_stats_t;
+
 DRESULT sflash_disk_init(void);
 DRESULT sflash_disk_status(void);
 DRESULT sflash_disk_read(BYTE *buff, DWORD sector, UINT count);
 DRESULT sflash_disk_write(const BYTE *buff, DWORD sector, UINT count);
 DRESULT sflash_disk_flush(void);
 uint32_t sflash_get_sector_count(void);
+uint32_t sflash_get_start_address(void);
+void sflash_disk_get_cache_stats(sflash_cache_stats_t *stats);
 
-extern int sflash_disk_read_littlefs(const struct lfs_config *lfscfg, void* buff, uint32_t block, uint32_t size);
-extern int sflash_disk_write_littlefs(const struct lfs_config *lfscfg, const void* buff, uint32_t block, uint32_t size);
+extern int sflash_disk_read_littlefs(const struct lfs_config *lfscfg, void* buff, uint32_t block, uint32_t off, uint32_t size);
+extern int sflash_disk_write_littlefs(const struct lfs_config *lfscfg, const void* buff, uint32_t block, uint32_t off, uint32_t size);
 extern int sflash_disk_erase_littlefs(const struct lfs_config *lfscfg, uint32_t block);
 
 #endif /* SFLASH_DISKIO_H_ */
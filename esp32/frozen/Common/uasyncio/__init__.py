@@ -0,0 +1,14 @@
+'''
+Copyright (c) 2021, Pycom Limited.
+This software is licensed under the GNU GPL version 3 or any
+later version, with permitted additional terms. For more information
+see the Pycom Licence v1.0 document supplied with this file, or
+available at https://www.pycom.io/opensource/licensing
+'''
+
+# Single threaded cooperative scheduling: many connections and drivers
+# served by one task, without a thread stack for each of them.
+
+from .core import *
+from .event import Event, ThreadSafeFlag, Lock
+from .stream import Stream, StreamReader, StreamWriter, open_connection, start_server, Server
@@ -0,0 +1,336 @@
+'''
+Copyright (c) 2021, Pycom Limited.
+This software is licensed under the GNU GPL version 3 or any
+later version, with permitted additional terms. For more information
+see the Pycom Licence v1.0 document supplied with this file, or
+available at https://www.pycom.io/opensource/licensing
+'''
+
+# Event loop core. Timers live in a utimeq heap and I/O readiness comes
+# from uselect.poll(), which blocks in the port until a socket, UART or
+# radio has something for us, so an idle loop costs no CPU.
+#
+# A coroutine talks to the loop through what it yields:
+#   None          - run again on the next round
+#   int           - sleep for that many milliseconds
+#   list          - park in that list until someone releases it
+#   _IOWait       - wait until the object is readable or writable
+
+import utime
+import utimeq
+import uselect
+import sys
+from micropython import const
+
+# longest wait while a ThreadSafeFlag may be set from outside the loop
+_FLAG_POLL_MS = const(20)
+
+
+class CancelledError(BaseException):
+    pass
+
+
+class TimeoutError(Exception):
+    pass
+
+
+class _IOWait:
+    def __init__(self, obj, write):
+        self.obj = obj
+        self.write = write
+
+
+class Task:
+    def __init__(self, coro):
+        self.coro = coro
+        self.done = False
+        self.failed = False
+        self.value = None       # the result, or the exception it ended with
+        self.waiters = []       # tasks that await this one
+        self._exc = None        # exception to throw in on the next step
+        self._on = None         # list we're parked in
+        self._io = None         # entry of loop.io we're waiting on
+        self._tim = None        # handle of our entry in loop.timeq
+
+    def __iter__(self):
+        if not self.done:
+            yield self.waiters
+        if self.failed:
+            raise self.value
+        return self.value
+
+    __await__ = __iter__
+
+    def cancel(self):
+        if self.done or isinstance(self._exc, CancelledError):
+            return False
+        _loop._throw(self, CancelledError())
+        return True
+
+
+class Loop:
+    def __init__(self, qlen=16):
+        self.runq = []
+        self.timeq = utimeq.utimeq(qlen)
+        self.tev = [0, 0, 0]
+        self.poller = uselect.poll()
+        self.io = {}            # id(obj) -> [obj, reader, writer]
+        self.flags = []         # ThreadSafeFlags that have waiters
+        self.main = None
+
+    def create_task(self, coro):
+        t = Task(coro)
+        self.runq.append(t)
+        return t
+
+    def _release(self, waiters):
+        for t in waiters:
+            t._on = None
+            self.runq.append(t)
+        waiters.clear()
+
+    def _detach(self, t):
+        # forget whatever t was blocked on
+        if t._tim is not None:
+            self.timeq.remove(t._tim)
+            t._tim = None
+        if t._on is not None:
+            t._on.remove(t)
+            t._on = None
+        e = t._io
+        if e is not None:
+            t._io = None
+            if e[1] is t:
+                e[1] = None
+            if e[2] is t:
+                e[2] = None
+            self._io_update(e)
+        elif t in self.runq:
+            return False
+        return True
+
+    def _throw(self, t, exc):
+        t._exc = exc
+        if self._detach(t):
+            self.runq.append(t)
+
+    def _sleep(self, t, ms):
+        when = utime.ticks_add(utime.ticks_ms(), ms)
+        try:
+            t._tim = self.timeq.push(when, t, 0)
+        except IndexError:
+            self._grow()
+            t._tim = self.timeq.push(when, t, 0)
+
+    def _grow(self):
+        # utimeq has a fixed size, so move everything into a bigger one
+        old = []
+        while self.timeq:
+            ev = [0, 0, 0]
+            self.timeq.pop(ev)
+            old.append(ev)
+        self.timeq = utimeq.utimeq(2 * len(old))
+        for ev in old:
+            ev[1]._tim = self.timeq.push(ev[0], ev[1], ev[2])
+
+    def _io_wait(self, t, obj, write):
+        e = self.io.get(id(obj))
+        if e is None:
+            e = [obj, None, None]
+            self.io[id(obj)] = e
+        slot = 2 if write else 1
+        if e[slot] is not None:
+            raise RuntimeError('already waiting on this stream')
+        e[slot] = t
+        t._io = e
+        self._io_update(e)
+
+    def _io_update(self, e):
+        mask = 0
+        if e[1] is not None:
+            mask |= uselect.POLLIN
+        if e[2] is not None:
+            mask |= uselect.POLLOUT
+        if mask:
+            self.poller.register(e[0], mask)
+        else:
+            self.poller.unregister(e[0])
+            del self.io[id(e[0])]
+
+    def _io_ready(self, obj, ev):
+        e = self.io.get(id(obj))
+        if e is None:
+            return
+        # errors and hangups wake both sides so they see the failure
+        err = ev & ~(uselect.POLLIN | uselect.POLLOUT)
+        for slot, bit in ((1, uselect.POLLIN), (2, uselect.POLLOUT)):
+            t = e[slot]
+            if t is not None and (ev & bit or err):
+                e[slot] = None
+                t._io = None
+                self.runq.append(t)
+        self._io_update(e)
+
+    def _step(self, t):
+        exc = t._exc
+        t._exc = None
+        try:
+            if exc is None:
+                r = t.coro.send(None)
+            else:
+                r = t.coro.throw(exc)
+        except StopIteration as e:
+            self._finish(t, e.value, False)
+        except CancelledError as e:
+            self._finish(t, e, True)
+        except Exception as e:
+            if not t.waiters and t is not self.main:
+                print('Task exception wasn\'t retrieved')
+                sys.print_exception(e)
+            self._finish(t, e, True)
+        else:
+            if r is None:
+                self.runq.append(t)
+            elif isinstance(r, int):
+                self._sleep(t, r)
+            elif isinstance(r, list):
+                r.append(t)
+                t._on = r
+            elif isinstance(r, _IOWait):
+                self._io_wait(t, r.obj, r.write)
+            else:
+                t._exc = TypeError('bad yield')
+                self.runq.append(t)
+
+    def _finish(self, t, value, failed):
+        t.done = True
+        t.failed = failed
+        t.value = value
+        self._release(t.waiters)
+
+    def run_once(self):
+        # ThreadSafeFlags may have been set by an IRQ handler or another thread
+        if self.flags:
+            for f in self.flags[:]:
+                if f._flag:
+                    self.flags.remove(f)
+                    self._release(f._waiters)
+
+        now = utime.ticks_ms()
+        while self.timeq and utime.ticks_diff(self.timeq.peektime(), now) <= 0:
+            self.timeq.pop(self.tev)
+            t = self.tev[1]
+            t._tim = None
+            self.runq.append(t)
+        self.tev[1] = None
+
+        # tasks made ready while stepping run on the next round
+        q = self.runq
+        self.runq = []
+        for t in q:
+            self._step(t)
+        if self.main is not None and self.main.done:
+            return
+
+        if self.runq:
+            timeout = 0
+        elif self.timeq:
+            timeout = max(0, utime.ticks_diff(self.timeq.peektime(), utime.ticks_ms()))
+        else:
+            timeout = -1
+        if self.flags and (timeout < 0 or timeout > _FLAG_POLL_MS):
+            timeout = _FLAG_POLL_MS
+
+        if self.io:
+            for obj, ev in self.poller.ipoll(timeout):
+                self._io_ready(obj, ev)
+        elif timeout > 0:
+            utime.sleep_ms(timeout)
+        elif timeout < 0:
+            raise RuntimeError('no task can make progress')
+
+    def run_until_complete(self, main):
+        if not isinstance(main, Task):
+            main = self.create_task(main)
+        self.main = main
+        while not main.done:
+            self.run_once()
+        if main.failed:
+            raise main.value
+        return main.value
+
+    def run_forever(self):
+        while True:
+            self.run_once()
+
+
+_loop = Loop()
+
+
+def get_event_loop():
+    return _loop
+
+
+def new_event_loop(qlen=16):
+    global _loop
+    _loop = Loop(qlen)
+    return _loop
+
+
+def create_task(coro):
+    return _loop.create_task(coro)
+
+
+def run(coro):
+    return _loop.run_until_complete(coro)
+
+
+def sleep_ms(ms):
+    yield int(ms)
+
+
+def sleep(s):
+    yield int(s * 1000)
+
+
+def wait_io(obj, write=False):
+    yield _IOWait(obj, write)
+
+
+def _timeout(t, ms):
+    yield ms
+    t.cancel()
+
+
+async def wait_for_ms(aw, ms):
+    t = aw if isinstance(aw, Task) else _loop.create_task(aw)
+    if ms is None:
+        return await t
+    timer = _loop.create_task(_timeout(t, ms))
+    try:
+        return await t
+    except CancelledError:
+        if timer.done:
+            raise TimeoutError()
+        # we were cancelled ourselves, take the inner task with us
+        t.cancel()
+        raise
+    finally:
+        timer.cancel()
+
+
+def wait_for(aw, timeout):
+    return wait_for_ms(aw, None if timeout is None else int(timeout * 1000))
+
+
+async def gather(*aws, return_exceptions=False):
+    ts = [aw if isinstance(aw, Task) else _loop.create_task(aw) for aw in aws]
+    res = []
+    for t in ts:
+        try:
+            res.append(await t)
+        except Exception as e:
+            if not return_exceptions:
+                raise
+            res.append(e)
+    return res
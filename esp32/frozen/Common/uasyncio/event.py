@@ -0,0 +1,84 @@
+'''
+Copyright (c) 2021, Pycom Limited.
+This software is licensed under the GNU GPL version 3 or any
+later version, with permitted additional terms. For more information
+see the Pycom Licence v1.0 document supplied with this file, or
+available at https://www.pycom.io/opensource/licensing
+'''
+
+from . import core
+
+
+class Event:
+    def __init__(self):
+        self._flag = False
+        self._waiters = []
+
+    def is_set(self):
+        return self._flag
+
+    def set(self):
+        self._flag = True
+        core._loop._release(self._waiters)
+
+    def clear(self):
+        self._flag = False
+
+    def wait(self):
+        if not self._flag:
+            yield self._waiters
+        return True
+
+
+# Like Event, but set() may be called from an IRQ handler (Timer.Alarm,
+# Bluetooth, LoRa, Pin callbacks) or another thread. Only one task should
+# wait on it, and wait() clears it again.
+class ThreadSafeFlag:
+    def __init__(self):
+        self._flag = False
+        self._waiters = []
+
+    def set(self):
+        self._flag = True
+
+    def clear(self):
+        self._flag = False
+
+    def wait(self):
+        if not self._flag:
+            flags = core._loop.flags
+            if self not in flags:
+                flags.append(self)
+            yield self._waiters
+        self._flag = False
+
+
+class Lock:
+    def __init__(self):
+        self._locked = False
+        self._waiters = []
+
+    def locked(self):
+        return self._locked
+
+    def acquire(self):
+        while self._locked:
+            yield self._waiters
+        self._locked = True
+        return True
+
+    def release(self):
+        if not self._locked:
+            raise RuntimeError('Lock not acquired')
+        self._locked = False
+        if self._waiters:
+            # hand over to one waiter, the rest keep waiting
+            t = self._waiters.pop(0)
+            t._on = None
+            core._loop.runq.append(t)
+
+    async def __aenter__(self):
+        return await self.acquire()
+
+    async def __aexit__(self, exc_type, exc, tb):
+        self.release()
@@ -0,0 +1,61 @@
+'''
+Copyright (c) 2021, Pycom Limited.
+This software is licensed under the GNU GPL version 3 or any
+later version, with permitted additional terms. For more information
+see the Pycom Licence v1.0 document supplied with this file, or
+available at https://www.pycom.io/opensource/licensing
+'''
+
+# Awaitable wrappers for the callback based drivers. UART and sockets
+# (WLAN, LTE, LoRa) are pollable, wrap them in uasyncio.Stream instead.
+
+from machine import Timer
+from .event import ThreadSafeFlag
+
+
+class Alarm:
+    # await alarm.wait() returns once per expiry of a Timer.Alarm
+    def __init__(self, s=None, ms=0, periodic=False):
+        self._flag = ThreadSafeFlag()
+        self._fired = []
+        self._alarm = Timer.Alarm(self._handler, s, ms=ms, periodic=periodic)
+
+    def _handler(self, alarm):
+        self._fired.append(1)
+        self._flag.set()
+
+    async def wait(self):
+        while not self._fired:
+            await self._flag.wait()
+        # expiries we were too slow for are folded into this one
+        n = 0
+        while self._fired:
+            n += self._fired.pop()
+        return n
+
+    def cancel(self):
+        self._alarm.cancel()
+
+
+class Events:
+    # collects the events of obj.callback() for a task, eg
+    #   ev = Events(bluetooth, Bluetooth.NEW_ADV_EVENT)
+    #   ev = Events(lora, LoRa.RX_PACKET_EVENT | LoRa.TX_PACKET_EVENT)
+    # and await ev.wait() returns the triggers that fired since last time
+    def __init__(self, obj, trigger):
+        self._obj = obj
+        self._flag = ThreadSafeFlag()
+        self._pending = []
+        obj.callback(trigger=trigger, handler=self._handler)
+
+    def _handler(self, obj):
+        self._pending.append(obj.events())
+        self._flag.set()
+
+    async def wait(self):
+        while not self._pending:
+            await self._flag.wait()
+        ev = 0
+        while self._pending:
+            ev |= self._pending.pop()
+        return ev
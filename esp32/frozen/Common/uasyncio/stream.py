@@ -0,0 +1,129 @@
+'''
+Copyright (c) 2021, Pycom Limited.
+This software is licensed under the GNU GPL version 3 or any
+later version, with permitted additional terms. For more information
+see the Pycom Licence v1.0 document supplied with this file, or
+available at https://www.pycom.io/opensource/licensing
+'''
+
+import usocket
+import uerrno
+from . import core
+
+
+# Wraps anything with a poll ioctl: sockets (WLAN, LTE, LoRa), UART, ...
+# Sockets should be non-blocking, UART.read() already returns what's there.
+class Stream:
+    def __init__(self, s, e={}):
+        self.s = s
+        self.e = e
+        self.out = b''
+
+    def get_extra_info(self, v):
+        return self.e[v]
+
+    async def read(self, n):
+        await core.wait_io(self.s)
+        return self.s.read(n)
+
+    async def readinto(self, buf):
+        await core.wait_io(self.s)
+        return self.s.readinto(buf)
+
+    async def readexactly(self, n):
+        r = b''
+        while n:
+            await core.wait_io(self.s)
+            b = self.s.read(n)
+            if b is None:
+                continue
+            if not b:
+                raise EOFError
+            r += b
+            n -= len(b)
+        return r
+
+    async def readline(self):
+        l = b''
+        while True:
+            await core.wait_io(self.s)
+            b = self.s.readline()
+            if b is None:
+                continue
+            l += b
+            if not b or b[-1] == 10:
+                return l
+
+    def write(self, buf):
+        self.out += buf
+
+    async def drain(self):
+        mv = memoryview(self.out)
+        off = 0
+        while off < len(mv):
+            await core.wait_io(self.s, True)
+            n = self.s.write(mv[off:])
+            if n is not None:
+                off += n
+        self.out = b''
+
+    def close(self):
+        pass
+
+    async def wait_closed(self):
+        self.s.close()
+
+
+StreamReader = Stream
+StreamWriter = Stream
+
+
+async def open_connection(host, port):
+    ai = usocket.getaddrinfo(host, port)[0]
+    s = usocket.socket(ai[0], ai[1], ai[2])
+    s.setblocking(False)
+    try:
+        s.connect(ai[-1])
+    except OSError as e:
+        if e.args[0] != uerrno.EINPROGRESS:
+            raise
+    await core.wait_io(s, True)
+    ss = Stream(s)
+    return ss, ss
+
+
+class Server:
+    def __init__(self, s, cb):
+        self.s = s
+        self.task = core.create_task(self._serve(cb))
+
+    async def _serve(self, cb):
+        while True:
+            try:
+                await core.wait_io(self.s)
+            except core.CancelledError:
+                self.s.close()
+                return
+            try:
+                s, addr = self.s.accept()
+            except OSError:
+                continue
+            s.setblocking(False)
+            ss = Stream(s, {'peername': addr})
+            core.create_task(cb(ss, ss))
+
+    def close(self):
+        self.task.cancel()
+
+    async def wait_closed(self):
+        await self.task
+
+
+async def start_server(cb, host, port, backlog=5):
+    ai = usocket.getaddrinfo(host, port)[0]
+    s = usocket.socket()
+    s.setblocking(False)
+    s.setsockopt(usocket.SOL_SOCKET, usocket.SO_REUSEADDR, 1)
+    s.bind(ai[-1])
+    s.listen(backlog)
+    return Server(s, cb)
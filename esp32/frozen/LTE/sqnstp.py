@@ -374,9 +374,26 @@ class Master:
 class args(object):
     pass
 
+def native_transfer():
+    # the firmware does the transfer in C when LTE.modem_upgrade_transfer() exists,
+    # the modem has to be on UART 1 in STP mode already
+    if 'FiPy' in sysname or 'GPy' in sysname:
+        try:
+            from network import LTE
+            return LTE.modem_upgrade_transfer
+        except (ImportError, AttributeError):
+            pass
+    return None
+
 def start(elf, elfsize, serial, baud=3686400, retry=None, debug=None, AT=True, pkgdebug=False):
     dev = None
 
+    transfer = None if pkgdebug else native_transfer()
+    if transfer:
+        if debug: print('running LTE.modem_upgrade_transfer')
+        time.sleep(0.05)
+        return transfer(elf, elfsize, retry=bool(retry))
+
     try:
         # The base-two logarithm of the window size, which therefore ranges between 512 and 32768
         # 12 is 4096K
@@ -32,6 +32,73 @@ import pycom
 import os
 from binascii import hexlify
 
+# bytes read from the socket at a time, the files are streamed through a buffer of that size
+OTA_CHUNK_SIZE = const(4096)
+# times a download cut by a network error is resumed with a Range request
+OTA_RESUME_RETRIES = const(3)
+
+
+class _HttpReader():
+    # reads an HTTP response from a socket, the body going through buf
+    def __init__(self, sock, buf):
+        self.sock = sock
+        self.buf = buf
+        self.pending = b''
+
+    def _readline(self):
+        while True:
+            idx = self.pending.find(b'\r\n')
+            if idx >= 0:
+                line = self.pending[:idx]
+                self.pending = self.pending[idx + 2:]
+                return line
+            data = self.sock.recv(256)
+            if not data:
+                raise OSError("Connection closed by the server")
+            self.pending += data
+
+    def read_headers(self):
+        status = int(self._readline().split(b' ', 2)[1])
+        headers = {}
+        while True:
+            line = self._readline()
+            if not line:
+                return status, headers
+            kv = line.decode().split(':', 1)
+            if len(kv) == 2:
+                headers[kv[0].strip().lower()] = kv[1].strip()
+
+    def copy(self, size, sink):
+        # size bytes of body to sink, or all of them until the server closes when size is None
+        if self.pending:
+            data = self.pending if size is None else self.pending[:size]
+            self.pending = self.pending[len(data):]
+            sink(data)
+            if size is not None:
+                size -= len(data)
+        mv = memoryview(self.buf)
+        while size is None or size > 0:
+            n = self.sock.readinto(mv if size is None else mv[:min(size, len(mv))])
+            if not n:
+                if size is None:
+                    return
+                raise OSError("Connection closed by the server")
+            sink(mv[:n])
+            if size is not None:
+                size -= n
+
+    def copy_chunked(self, sink):
+        while True:
+            size = int(self._readline().split(b';')[0].strip(), 16)
+            if size == 0:
+                # skip the trailers
+                while self._readline():
+                    pass
+                return
+            self.copy(size, sink)
+            self._readline()
+
+
 # Try to get version number
 # try:
 #     from OTA_VERSION import VERSION
@@ -52,6 +119,9 @@ class OTA():
     def update_device_network_config(self, fcota, config):
         raise NotImplementedError()
 
+    def close(self):
+        pass
+
     # OTA methods
 
     def get_current_version(self):
@@ -98,6 +168,7 @@ class OTA():
                         print(e)
                         msg = "Error downloading `{}` retrying..."
                         print(msg.format(f['URL']))
+                        self.close()
                         return 0
                 else:
                     raise Exception("Failed to download `{}`".format(f['URL']))
@@ -133,6 +204,7 @@ class OTA():
         #     fp.write("VERSION = '{}'".format(manifest['version']))
         # from OTA_VERSION import VERSION
 
+        self.close()
         return 2
 
     def get_file(self, f):
@@ -197,6 +269,7 @@ class OTA():
             hash=True,
             firmware=True
         )
+        self.close()
         # TODO: Add verification when released in future firmware
 
 
@@ -206,6 +279,9 @@ class WiFiOTA(OTA):
         self.password = password
         self.ip = ip
         self.port = port
+        self._sock = None
+        self._sock_host = None
+        self._buf = None
 
     def connect(self):
         self.wlan = network.WLAN(mode=network.WLAN.STA)
@@ -223,25 +299,63 @@ class WiFiOTA(OTA):
             # Already connected to the correct WiFi
             pass
 
-    def _http_get(self, path, host):
-        req_fmt = 'GET /{} HTTP/1.0\r\nHost: {}\r\n\r\n'
-        req = bytes(req_fmt.format(path, host), 'utf8')
+    def _http_get(self, path, host, offset=0):
+        req_fmt = 'GET /{} HTTP/1.1\r\nHost: {}\r\nConnection: keep-alive\r\n{}\r\n'
+        resume = 'Range: bytes={}-\r\n'.format(offset) if offset else ''
+        req = bytes(req_fmt.format(path, host, resume), 'utf8')
         return req
 
-    def get_data(self, req, dest_path=None, hash=False, firmware=False):
-        h = None
-        useSSL = int(self.port) == 443
-
-        # Connect to server
-        print("Requesting: {} to {}:{} with SSL? {}".format(req, self.ip, self.port, useSSL))
+    def _open_socket(self):
+        # the connection is kept across the requests made to the same server
+        host = (self.ip, int(self.port))
+        if self._sock is not None and self._sock_host == host:
+            return self._sock
+        self.close()
+        print("Connecting to {}:{} with SSL? {}".format(host[0], host[1], host[1] == 443))
         s = socket.socket(socket.AF_INET, socket.SOCK_STREAM, socket.IPPROTO_TCP)
-        s.connect(socket.getaddrinfo(self.ip, self.port)[0][-1])
-        if (int(self.port) == 443):
+        s.connect(socket.getaddrinfo(host[0], host[1])[0][-1])
+        if host[1] == 443:
             print("Wrapping socket")
             s = ssl.wrap_socket(s)
+        self._sock = s
+        self._sock_host = host
+        return s
+
+    def close(self):
+        if self._sock is not None:
+            try:
+                self._sock.close()
+            except Exception:
+                pass
+            self._sock = None
+
+    def _get(self, s, req, offset, sink):
+        # writes the body of the response to sink, returns the HTTP status
         print("Sending request")
-        # Request File
-        s.sendall(self._http_get(req, "{}:{}".format(self.ip, self.port)))
+        s.sendall(self._http_get(req, "{}:{}".format(self.ip, self.port), offset))
+        reader = _HttpReader(s, self._buf)
+        status, headers = reader.read_headers()
+        print_debug(4, "Result: {} {}".format(status, headers))
+        if status not in (200, 206):
+            raise Exception("HTTP error {}".format(status))
+        if offset and status != 206:
+            raise Exception("The server can't resume the download")
+        if headers.get('transfer-encoding', '').lower() == 'chunked':
+            reader.copy_chunked(sink)
+        elif 'content-length' in headers:
+            reader.copy(int(headers['content-length']), sink)
+        else:
+            reader.copy(None, sink)
+            headers['connection'] = 'close'
+        if headers.get('connection', '').lower() == 'close':
+            self.close()
+        return status
+
+    def get_data(self, req, dest_path=None, hash=False, firmware=False):
+        h = None
+        print("Requesting: {} to {}:{}".format(req, self.ip, self.port))
+        if self._buf is None:
+            self._buf = bytearray(OTA_CHUNK_SIZE)
         try:
             content = bytearray()
             fp = None
@@ -256,33 +370,30 @@ class WiFiOTA(OTA):
                 pycom.ota_start()
 
             h = uhashlib.sha1()
+            received = [0]
 
-            # Get data from server
-            result = s.recv(50)
-            print_debug(4, "Result: {}".format(result))
-
-            start_writing = False
-            while (len(result) > 0):
-                # Ignore the HTTP headers
-                if not start_writing:
-                    if "\r\n\r\n" in result:
-                        start_writing = True
-                        result = result.split(b'\r\n\r\n')[1]
-
-                if start_writing:
-                    if firmware:
-                        pycom.ota_write(result)
-                    elif fp is None:
-                        content.extend(result)
-                    else:
-                        fp.write(result)
-
-                    if hash:
-                        h.update(result)
-
-                result = s.recv(50)
-
-            s.close()
+            # the body is streamed to its destination and hashed on the way
+            def sink(data):
+                if firmware:
+                    pycom.ota_write(data)
+                elif fp is None:
+                    content.extend(data)
+                else:
+                    fp.write(data)
+                if hash:
+                    h.update(data)
+                received[0] += len(data)
+
+            # a download cut by a network error goes on from where it stopped
+            for attempt in range(OTA_RESUME_RETRIES + 1):
+                try:
+                    self._get(self._open_socket(), req, received[0], sink)
+                    break
+                except OSError as e:
+                    self.close()
+                    if attempt == OTA_RESUME_RETRIES:
+                        raise e
+                    print("Download interrupted after {} bytes ({}), resuming".format(received[0], e))
 
             if fp is not None:
                 fp.close()
@@ -291,6 +402,7 @@ class WiFiOTA(OTA):
                 pycom.ota_finish()
 
         except Exception as e:
+            self.close()
             gc.mem_free()
             # Since only one hash operation is allowed at Once
             # ensure we close it if there is an error
@@ -85,7 +85,7 @@ class MQTTClient:
                 if (not self.__reconnect):
                     raise Exception('Reconnection Disabled.')
                 i += 1
-                time.sleep(i)
+                time.sleep_ms(mqtt_core.reconnect_delay_ms(i))
 
     def set_callback(self, mqtt_client, message):
         self.__pybytes_protocol.__process_recv_message(message)
@@ -107,14 +107,14 @@ class MQTTClient:
             self.__reconnecting = True
             try:
                 if not self.__mqtt.connect():
-                    time.sleep(self.__reconnect_count)
+                    time.sleep_ms(mqtt_core.reconnect_delay_ms(self.__reconnect_count))  # noqa
                     continue
                 self.subscribe(self.__mqtt_download_topic)
                 self.__reconnect_count = 0
                 self.__reconnecting = False
                 break
             except OSError:
-                time.sleep(self.__reconnect_count)
+                time.sleep_ms(mqtt_core.reconnect_delay_ms(self.__reconnect_count))  # noqa
 
     def publish(self, topic, msg, retain=False, qos=0, priority=False):
         while 1:
@@ -26,8 +26,15 @@ except:
 
 import time
 import struct
+import socket
+import select
 import _thread
 
+try:
+    import mqttcore
+except ImportError:
+    mqttcore = None
+
 
 class MQTTMessage:
     def __init__(self):
@@ -70,6 +77,10 @@ class MQTTCore:
                 reconnectMethod
             )
 
+    @staticmethod
+    def reconnect_delay_ms(attempt):
+        return attempt * 1000
+
     def configEndpoint(self, srcHost, srcPort):
         self._msgHandler.setEndpoint(srcHost, srcPort)
 
@@ -403,3 +414,196 @@ class MQTTCore:
         else:
             print_debug(2, 'Unknown message type: %d' % msg_type)
             return False
+
+
+class MQTTCoreNative:
+    """MQTTCore on top of the C client of the mqttcore module.
+
+    Framing, acks, keepalive and retransmission happen in C; this class only
+    owns the socket and a thread that feeds the client what the broker sends.
+    """
+
+    KEEPALIVE = 60
+
+    def __init__(
+                self,
+                clientID,
+                cleanSession,
+                protocol,
+                receive_timeout=3000,
+                reconnectMethod=None
+            ):
+        self.client_id = clientID
+        self._cleanSession = cleanSession
+        self._protocol = protocol
+        self._user = ""
+        self._password = ""
+        self._connectdisconnectTimeout = 30
+        self._mqttOperationTimeout = 5
+        self._receive_timeout = receive_timeout
+        self._reconnectMethod = reconnectMethod
+        self._host = ""
+        self._port = -1
+        self._sock = None
+        self._client = None
+        self._running = False
+        self._topic_callback_queue = []
+        self._inbox = []
+        # the C client isn't reentrant, every call into it holds this
+        self._lock = _thread.allocate_lock()
+
+    @staticmethod
+    def reconnect_delay_ms(attempt):
+        return mqttcore.backoff(attempt)
+
+    def configEndpoint(self, srcHost, srcPort):
+        self._host = srcHost
+        self._port = srcPort
+
+    def connect(self):
+        self._close()
+        client = mqttcore.Client(
+            self.client_id,
+            user=self._user or None,
+            password=self._password or None,
+            keepalive=self.KEEPALIVE,
+            clean_session=self._cleanSession,
+            callback=self._on_message
+        )
+        try:
+            sock = socket.socket()
+            sock.settimeout(self._connectdisconnectTimeout)
+            sock.connect(socket.getaddrinfo(self._host, self._port)[0][-1])
+            with self._lock:
+                client.connect(sock)
+        except OSError as err:
+            print_debug(2, "MQTT connect error: {0}".format(err))
+            try:
+                sock.close()
+            except Exception:
+                pass
+            return False
+
+        self._sock = sock
+        self._client = client
+        if not self._running:
+            self._running = True
+            _thread.stack_size(10240)
+            _thread.start_new_thread(self._io_thread_func, ())
+            _thread.stack_size(8192)
+        return True
+
+    def _close(self):
+        client, self._client = self._client, None
+        if client is not None:
+            with self._lock:
+                client.disconnect()
+        if self._sock is not None:
+            self._sock.close()
+            self._sock = None
+
+    def _call(self, method, *args):
+        client = self._client
+        if client is None:
+            raise OSError(-1)
+        with self._lock:
+            return getattr(client, method)(*args)
+
+    def _wait_acked(self, pid):
+        count_10ms = 0
+        while count_10ms <= self._mqttOperationTimeout * 100:
+            client = self._client
+            if client is None:
+                return False
+            if client.acked(pid):
+                return True
+            count_10ms += 1
+            time.sleep(0.01)
+        return False
+
+    def subscribe(self, topic, qos, callback):
+        if (topic is None or callback is None):
+            raise TypeError("Invalid subscribe values.")
+        topic = topic.encode('utf-8')
+        # registered first, the broker may send retained messages with the SUBACK
+        entry = (topic, callback)
+        self._topic_callback_queue.append(entry)
+        try:
+            pid = self._call('subscribe', topic, qos)
+            if self._wait_acked(pid):
+                return True
+        except OSError:
+            pass
+        self._topic_callback_queue.remove(entry)
+        return False
+
+    def unsubscribe(self, topic):
+        topic = topic.encode('utf-8')
+        try:
+            pid = self._call('unsubscribe', topic)
+        except OSError:
+            return False
+        if not self._wait_acked(pid):
+            return False
+        before = len(self._topic_callback_queue)
+        self._topic_callback_queue = [t for t in self._topic_callback_queue if t[0] != topic]  # noqa
+        return len(self._topic_callback_queue) != before
+
+    def publish(self, topic, payload, qos, retain, dup=False, priority=False):
+        # dup and priority don't apply, the client sends at once and marks
+        # its own retransmissions
+        return self._call('publish', topic, payload, qos, retain)
+
+    def disconnect(self, force=False):
+        self._running = False
+        self._close()
+        return True
+
+    def _on_message(self, topic, payload, qos, retain, dup):
+        # runs inside check() with the lock held, the callbacks run after
+        msg = MQTTMessage()
+        msg.topic = topic
+        msg.payload = payload
+        msg.qos = qos
+        msg.retain = retain
+        msg.dup = dup
+        self._inbox.append(msg)
+
+    def _dispatch(self):
+        while self._inbox:
+            msg = self._inbox.pop(0)
+            for sub, callback in self._topic_callback_queue:
+                if mqttcore.topic_matches(sub, msg.topic):
+                    callback(self, msg)
+
+    def _io_thread_func(self):
+        poll = None
+        poll_sock = None
+        while self._running:
+            client, sock = self._client, self._sock
+            if client is None:
+                time.sleep(1)
+                continue
+            if sock is not poll_sock:
+                poll = select.poll()
+                poll.register(sock, select.POLLIN)
+                poll_sock = sock
+            try:
+                poll.poll(self._receive_timeout)
+                with self._lock:
+                    client.check()
+            except OSError as err:
+                if client is not self._client:
+                    # replaced by connect() meanwhile
+                    continue
+                print_debug(2, "MQTT connection lost: {0}".format(err))
+                self._running = False
+                self._close()
+                if self._reconnectMethod is not None:
+                    self._reconnectMethod()
+                break
+            self._dispatch()
+
+
+if mqttcore is not None:
+    MQTTCore = MQTTCoreNative  # noqa: F811
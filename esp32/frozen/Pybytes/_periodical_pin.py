@@ -6,6 +6,8 @@ see the Pycom Licence v1.0 document supplied with this file, or
 available at https://www.pycom.io/opensource/licensing
 '''
 
+from machine import Timer, Pin, ADC
+
 
 class PeriodicalPin:
 
@@ -14,7 +16,40 @@ class PeriodicalPin:
     TYPE_VIRTUAL = 2
 
     def __init__(self, persistent, pin_number, message_type, message, pin_type):
+        self.persistent = persistent
         self.pin_number = pin_number
         self.message_type = message_type
         self.message = message
         self.pin_type = pin_type
+        self.timer = None
+        self.__callback = None
+
+    def start(self, callback, period, samples=1, pull_mode=None):
+        # The firmware samples the pin from C where it has Timer.Sampler, the
+        # callback then runs once per period with the value to publish:
+        # the mean of the samples for analog pins, the last one for digital pins
+        self.__callback = callback
+        if self.pin_type == PeriodicalPin.TYPE_VIRTUAL or not hasattr(Timer, 'Sampler'):
+            self.timer = Timer.Alarm(callback, period, arg=self, periodic=True)
+            return
+        if self.pin_type == PeriodicalPin.TYPE_DIGITAL:
+            source = Pin("P" + str(self.pin_number), mode=Pin.IN, pull=pull_mode)
+        else:
+            source = ADC(bits=12).channel(pin="P" + str(self.pin_number))
+        self.timer = Timer.Sampler(
+            source, period / samples, report=samples, handler=self.__report,
+            samples=False
+        )
+
+    def stop(self):
+        if self.timer:
+            self.timer.cancel()
+            self.timer = None
+
+    def __report(self, sampler):
+        report = sampler.report()
+        if self.pin_type == PeriodicalPin.TYPE_DIGITAL:
+            value = report.last
+        else:
+            value = int(report.mean + 0.5)
+        self.__callback(self, value)
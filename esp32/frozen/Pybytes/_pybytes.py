@@ -13,7 +13,7 @@ import pycom
 import sys
 from network import WLAN
 from binascii import hexlify, a2b_base64
-from machine import Timer, deepsleep, pin_sleep_wakeup, unique_id
+from machine import Timer, deepsleep, pin_sleep_wakeup, unique_id, crash_report
 
 try:
     from periodical_pin import PeriodicalPin
@@ -45,6 +45,7 @@ class Pybytes:
         self.__smart_config = False
         self.__conf = {}
         self.__pymesh = None
+        self.__crash_report_sent = False
 
         if not self.__activation:
             self.__conf = config
@@ -138,6 +139,14 @@ class Pybytes:
         self.__check_init()
         self.__pybytes_connection.__pybytes_protocol.send_info_message()
 
+    # what the panic handler saved before the last reset, sent once per boot
+    def send_crash_report(self):
+        self.__check_init()
+        report = crash_report()
+        if report is not None and not self.__crash_report_sent:
+            self.__pybytes_connection.__pybytes_protocol.send_crash_report(report)
+            self.__crash_report_sent = True
+
     def send_scan_info_message(self):
         self.__check_init()
         self.__pybytes_connection.__pybytes_protocol.send_scan_info_message(None)
@@ -162,9 +171,15 @@ class Pybytes:
         else:
             self.__pybytes_connection.__pybytes_protocol.send_pybytes_custom_method_values(signal_number, [value])
 
-    def __periodical_pin_callback(self, periodical_pin):
+    def __periodical_pin_callback(self, periodical_pin, value=None):
         self.__check_init()
-        if (periodical_pin.pin_type == PeriodicalPin.TYPE_DIGITAL):
+        if value is not None:
+            # already sampled and aggregated by Timer.Sampler
+            self.__pybytes_connection.__pybytes_protocol.send_pybytes_pin_value(
+                periodical_pin.pin_number, value,
+                periodical_pin.pin_type == PeriodicalPin.TYPE_ANALOG
+            )
+        elif (periodical_pin.pin_type == PeriodicalPin.TYPE_DIGITAL):
             self.send_digital_pin_value(
                 periodical_pin.persistent, periodical_pin.pin_number, None
             )
@@ -173,25 +188,23 @@ class Pybytes:
                 periodical_pin.persistent, periodical_pin.pin_number
             )
 
-    def register_periodical_digital_pin_publish(self, persistent, pin_number, pull_mode, period):
+    # samples is the number of reads aggregated into each value published,
+    # spread over the period
+    def register_periodical_digital_pin_publish(self, persistent, pin_number, pull_mode, period, samples=1):
         self.__check_init()
-        self.send_digital_pin_value(pin_number, pull_mode)
-        periodical_pin = PeriodicalPin(pin_number, None, None, PeriodicalPin.TYPE_DIGITAL)
-        Timer.Alarm(
-            self.__periodical_pin_callback, period, arg=periodical_pin,
-            periodic=True
-        )
+        self.send_digital_pin_value(persistent, pin_number, pull_mode)
+        periodical_pin = PeriodicalPin(persistent, pin_number, None, None, PeriodicalPin.TYPE_DIGITAL)
+        periodical_pin.start(self.__periodical_pin_callback, period, samples, pull_mode)
+        return periodical_pin
 
-    def register_periodical_analog_pin_publish(self, pin_number, period):
+    def register_periodical_analog_pin_publish(self, pin_number, period, samples=1):
         self.__check_init()
-        self.send_analog_pin_value(pin_number)
+        self.send_analog_pin_value(False, pin_number)
         periodical_pin = PeriodicalPin(
-            pin_number, None, None, PeriodicalPin.TYPE_ANALOG
-        )
-        Timer.Alarm(
-            self.__periodical_pin_callback, period, arg=periodical_pin,
-            periodic=True
+            False, pin_number, None, None, PeriodicalPin.TYPE_ANALOG
         )
+        periodical_pin.start(self.__periodical_pin_callback, period, samples)
+        return periodical_pin
 
     def add_custom_method(self, method_id, method):
         self.__check_init()
@@ -267,6 +280,7 @@ class Pybytes:
                 # SEND DEVICE'S INFORMATION
                 if self.__conf_reader.send_info():
                     self.send_info_message()
+                    self.send_crash_report()
 
                 # ENABLE TERMINAL
                 if self.__conf_reader.enable_terminal():
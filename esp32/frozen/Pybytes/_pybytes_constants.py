@@ -69,6 +69,7 @@ class constants:
     __TYPE_OTA = 0x05
     __TYPE_FCOTA = 0x06
     __TYPE_PONG = 0x07
+    __TYPE_CRASH = 0x08
     __TYPE_RELEASE_DEPLOY = 0x0A
     __TYPE_RELEASE_INFO = 0x0B
     __TYPE_DEVICE_NETWORK_DEPLOY = 0x0C
@@ -79,6 +80,9 @@ class constants:
     __PYBYTES_PROTOCOL_PING = ">B"
     __PYBYTES_INTERNAL_PROTOCOL = ">BBH"
     __PYBYTES_INTERNAL_PROTOCOL_VARIABLE = ">BB%ds"
+    # reset cause, core, exception cause, pc, faulting address, heap free, heap low mark
+    __CRASH_REPORT_FORMAT = ">BBBIIII"
+    __CRASH_TASK_FORMAT = ">II"
 
     __TERMINAL_PIN = 255
 
@@ -101,6 +101,26 @@ class PybytesLibrary:
 
         return self.__pack_message(constants.__TYPE_INFO, body)
 
+    # The summary of machine.crash_report(): the header, the backtrace of the
+    # crashed task, the pc and caller of every other task and then, each ended by
+    # a null byte, the task names, the crashed task and "file:function:line"
+    def pack_crash_message(self, report):
+        task, core, exccause, pc, excvaddr, backtrace, tasks, heap_free, heap_min_free, python = report
+        body = bytearray(struct.pack(constants.__CRASH_REPORT_FORMAT, machine.reset_cause(), core,
+                                     exccause & 0xFF, pc, excvaddr, heap_free, heap_min_free))
+        body.append(len(backtrace))
+        body += struct.pack(">%dI" % len(backtrace), *backtrace)
+        body.append(len(tasks))
+        for t in tasks:
+            body += struct.pack(constants.__CRASH_TASK_FORMAT, t[1], t[2])
+        for t in tasks:
+            body += t[0].encode() + b'\x00'
+        body += task.encode() + b'\x00'
+        if python is not None:
+            body += '{}:{}:{}'.format(*python).encode()
+        body.append(0)
+        return self.__pack_message(constants.__TYPE_CRASH, body)
+
     def pack_ota_message(self, result):
         body = bytearray()
         body.append(result)
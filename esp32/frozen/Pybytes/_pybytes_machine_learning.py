@@ -8,6 +8,9 @@ available at https://www.pycom.io/opensource/licensing
 
 import math
 import json
+import time
+import array
+from machine import Timer
 
 try:
     from pybytes_debug import print_debug
@@ -50,7 +53,7 @@ class MlFeatures():
             self.__mlSample = parameters["mlSample"]
             self.__frequency = parameters["frequency"]
             self.__pybytes_protocol = pybytes_protocol
-            self.__data = []
+            self.__samples = 0
 
     def _debug_hack(self, pybytes):
         self.__pybytes = pybytes
@@ -106,26 +109,42 @@ class MlFeatures():
             pass
         time.sleep(0.5)
 
-        self.__data = []
-        index = 0
+        # the samples go to preallocated arrays, x, y and z being interleaved
+        self.__samples = 0
+        self.__ts = array.array('L', bytes(4 * samples_num))
+        self.__acc = array.array('f', bytes(12 * samples_num))
         print("Start acquisition data for %d msec, freq %d Hz" % (self.__length, self.__frequency))
 
-        next_ts = time.ticks_us()
-        ts_orig = next_ts
-        while True:
-            while time.ticks_diff(next_ts, time.ticks_us()) > 0:
-                pass
-            acc = li.acceleration()
-            ts = next_ts
-            self.__data.append((ts - ts_orig, acc))
-            next_ts = ts + delta_t_us
-            index += 1
-            if index >= samples_num:
-                break  # done
-
-        print("Done acquisition %d samples, real freq %.1f Hz" % (index, index / (self.__length / 1000)))
+        ts_orig = time.ticks_us()
+
+        def _sample(alarm):
+            index = self.__samples
+            if index < samples_num:
+                acc = li.acceleration()
+                self.__ts[index] = time.ticks_diff(time.ticks_us(), ts_orig)
+                self.__acc[3 * index] = acc[0]
+                self.__acc[3 * index + 1] = acc[1]
+                self.__acc[3 * index + 2] = acc[2]
+                self.__samples = index + 1
+
+        alarm = Timer.Alarm(_sample, us=delta_t_us, periodic=True)
+        while self.__samples < samples_num:
+            time.sleep_ms(10)
+        alarm.cancel()
+
+        print("Done acquisition %d samples, real freq %.1f Hz" % (self.__samples, self.__samples / (self.__length / 1000)))
         self._parse_data(pin)
 
+    def features(self, peaks=3):
+        # (rms, [(freq, magnitude), ...]) of each axis of the last acquisition
+        import mlinfer
+        n = self.__samples
+        ret = []
+        for axis in range(3):
+            samples = array.array('f', (self.__acc[3 * i + axis] for i in range(n)))
+            ret.append(mlinfer.features(samples, self.__frequency, peaks=peaks))
+        return ret
+
     def _send_data(self, data, pin, acc, ts):
         if self.__pybytes_protocol is not None:
             if self.__type == 2:
@@ -137,13 +156,15 @@ class MlFeatures():
             self.__pybytes.send_signal(pin & 0xFF, str((int(ts / 1000), acc)))
 
     def _parse_data(self, pin):
-        print("_parse_data, %d samples" % len(self.__data))
+        print("_parse_data, %d samples" % self.__samples)
         try:
             pycom.rgbled(0x8d05f5)
         except:
             pass
         data = ['{"data": "ml"}']
-        for (ts, acc) in self.__data:
+        for index in range(self.__samples):
+            ts = self.__ts[index]
+            acc = self.__acc[3 * index:3 * index + 3]
             data.append('{' + '"data": [{},{},{}], "ms": {}'.format(acc[0], acc[1], acc[2], int(ts / 1000)) + '}')
             if len(data) > 25:
                 self._send_data(data, pin, acc, ts)
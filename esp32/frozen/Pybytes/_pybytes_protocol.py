@@ -514,6 +514,9 @@ class PybytesProtocol:
             )
         )
 
+    def send_crash_report(self, report):
+        self.__send_message(self.__pybytes_library.pack_crash_message(report))
+
     def send_ota_response(self, result, topic):
         print_debug(2, 'Sending OTA result back {}'.format(result))
         self.__send_message(
@@ -556,6 +559,13 @@ class PybytesProtocol:
         pin = self.__pins[pin_number]
         self.send_pybytes_custom_method_values(signal_number, [pin()])
 
+    def send_pybytes_pin_value(self, pin_number, value, analog=False):
+        if analog:
+            command = constants.__COMMAND_ANALOG_READ
+        else:
+            command = constants.__COMMAND_DIGITAL_READ
+        self.__send_pybytes_message(command, pin_number, value)
+
     def send_pybytes_custom_method_values(self, method_id, parameters, topic=None):
         if(isinstance(parameters[0], int)):
             values = bytearray(struct.pack(">i", parameters[0]))
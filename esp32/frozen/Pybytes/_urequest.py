@@ -2,6 +2,7 @@
 # author = Paul Sokolovsky
 
 import usocket
+import uio
 
 
 class Response:
@@ -77,6 +78,8 @@ def request(method, url, data=None, json=None, headers={}, stream=None):
     if data:
         s.write(data)
 
+    # the headers are read a line at a time, don't go to the socket for every byte
+    s = uio.BufferedReader(s, 256)
     lineRead = s.readline()
 
     protover, status, msg = lineRead.split(None, 2)
@@ -14,6 +14,7 @@
 
 #include "py/mpstate.h"
 #include "py/obj.h"
+#include "py/mphal.h"
 
 //#include "pybrtc.h"
 #include "ftp.h"
@@ -63,6 +64,7 @@
 #define FTP_ACTIVE_DATA_PORT                20
 #define FTP_PASIVE_DATA_PORT                2024
 #define FTP_BUFFER_SIZE                     512
+#define FTP_FILE_BUFFER_SIZE                (32 * 1024)      // file transfer window, only if SPIRAM is present
 #define FTP_TX_RETRIES_MAX                  50
 #define FTP_CMD_SIZE_MAX                    6
 #define FTP_CMD_CLIENTS_MAX                 1
@@ -73,7 +75,6 @@
 #define FTP_UNIX_SECONDS_180_DAYS           15552000ll
 #define FTP_DATA_TIMEOUT_MS                 10000            // 10 seconds
 #define FTP_SOCKETFIFO_ELEMENTS_MAX         5
-#define FTP_CYCLE_TIME_MS                   (SERVERS_CYCLE_TIME_MS * 2)
 
 /******************************************************************************
  DEFINE PRIVATE TYPES
@@ -140,7 +141,10 @@ typedef struct {
 
 typedef struct {
     uint8_t             *dBuffer;
-    uint32_t            ctimeout;
+    uint8_t             *fBuffer;           // file transfer window (dBuffer if there's no SPIRAM)
+    uint32_t            fBufferSize;
+    uint32_t            fBufferLen;         // bytes received and not yet written to the file
+    uint32_t            ctimeout;           // ticks when the command timeout started
     union {
         ftp_file_t fp;
         ftp_dir_t  dp;
@@ -149,7 +153,7 @@ typedef struct {
     int32_t             ld_sd;
     int32_t             c_sd;
     int32_t             d_sd;
-    int32_t             dtimeout;
+    uint32_t            dtimeout;           // ticks when the data timeout started
     uint32_t            volcount;
     uint32_t            ip_addr;
     uint8_t             state;
@@ -592,7 +596,7 @@ static bool ftp_create_listening_socket (int32_t *sd, uint32_t port, uint8_t bac
 static ftp_result_t ftp_wait_for_connection (int32_t l_sd, int32_t *n_sd, uint32_t *ip_addr);
 static ftp_result_t ftp_send_non_blocking (int32_t sd, void *data, int32_t Len);
 static void ftp_send_reply (uint32_t status, char *message);
-static void ftp_send_data (uint32_t datasize);
+static void ftp_send_data (void *data, uint32_t datasize);
 static void ftp_send_from_fifo (void);
 static ftp_result_t ftp_recv_non_blocking (int32_t sd, void *buff, int32_t Maxlen, int32_t *rxLen);
 static void ftp_process_cmd (void);
@@ -606,6 +610,7 @@ static int ftp_print_eplf_drive (char *dest, uint32_t destsize, const char *name
 static bool ftp_open_file (const char *path, int mode);
 static ftp_result_t ftp_read_file (char *filebuf, uint32_t desiredsize, uint32_t *actualsize);
 static ftp_result_t ftp_write_file (char *filebuf, uint32_t size);
+static bool ftp_flush_file_buffer (void);
 static ftp_result_t ftp_open_dir_for_listing (const char *path);
 static ftp_result_t ftp_list_dir (char *list, uint32_t maxlistsize, uint32_t *listsize);
 static void ftp_open_child (char *pwd, char *dir);
@@ -619,6 +624,16 @@ static void ftp_return_to_previous_path (char *pwd, char *dir);
 void ftp_init (void) {
     // allocate memory for the data buffer, and the file system structs (from the RTOS heap)
     ftp_data.dBuffer = malloc(FTP_BUFFER_SIZE);
+    // file data goes through a large window if SPIRAM is available, so that each
+    // socket send and each flash write moves a big block
+    ftp_data.fBuffer = heap_caps_malloc(FTP_FILE_BUFFER_SIZE, MALLOC_CAP_SPIRAM);
+    if (ftp_data.fBuffer) {
+        ftp_data.fBufferSize = FTP_FILE_BUFFER_SIZE;
+    } else {
+        ftp_data.fBuffer = ftp_data.dBuffer;
+        ftp_data.fBufferSize = FTP_BUFFER_SIZE;
+    }
+    ftp_data.fBufferLen = 0;
     ftp_path = malloc(FTP_MAX_PARAM_SIZE);
     ftp_scratch_buffer = malloc(FTP_MAX_PARAM_SIZE);
     ftp_cmd_buffer = malloc(FTP_MAX_PARAM_SIZE + FTP_CMD_SIZE_MAX);
@@ -650,7 +665,7 @@ void ftp_run (void) {
                 if (E_FTP_RESULT_OK == ftp_wait_for_connection(ftp_data.lc_sd, &ftp_data.c_sd, &ftp_data.ip_addr)) {
                     ftp_data.txRetries = 0;
                     ftp_data.logginRetries = 0;
-                    ftp_data.ctimeout = 0;
+                    ftp_data.ctimeout = mp_hal_ticks_ms();
                     ftp_data.loggin.uservalid = false;
                     ftp_data.loggin.passvalid = false;
                     strcpy (ftp_path, "/");
@@ -675,12 +690,12 @@ void ftp_run (void) {
                 uint32_t listsize;
                 ftp_list_dir((char *)ftp_data.dBuffer, FTP_BUFFER_SIZE, &listsize);
                 if (listsize > 0) {
-                    ftp_send_data(listsize);
+                    ftp_send_data(ftp_data.dBuffer, listsize);
                 } else {
                     ftp_send_reply(226, NULL);
                     ftp_data.state = E_FTP_STE_END_TRANSFER;
                 }
-                ftp_data.ctimeout = 0;
+                ftp_data.ctimeout = mp_hal_ticks_ms();
             }
             break;
         case E_FTP_STE_CONTINUE_FILE_TX:
@@ -688,14 +703,14 @@ void ftp_run (void) {
             if (SOCKETFIFO_IsEmpty()) {
                 uint32_t readsize;
                 ftp_result_t result;
-                ftp_data.ctimeout = 0;
-                result = ftp_read_file ((char *)ftp_data.dBuffer, FTP_BUFFER_SIZE, &readsize);
+                ftp_data.ctimeout = mp_hal_ticks_ms();
+                result = ftp_read_file ((char *)ftp_data.fBuffer, ftp_data.fBufferSize, &readsize);
                 if (result == E_FTP_RESULT_FAILED) {
                     ftp_send_reply(451, NULL);
                     ftp_data.state = E_FTP_STE_END_TRANSFER;
                 } else {
                     if (readsize > 0) {
-                        ftp_send_data(readsize);
+                        ftp_send_data(ftp_data.fBuffer, readsize);
                     }
                     if (result == E_FTP_RESULT_OK) {
                         ftp_send_reply(226, NULL);
@@ -708,28 +723,30 @@ void ftp_run (void) {
             if (SOCKETFIFO_IsEmpty()) {
                 int32_t len;
                 ftp_result_t result;
-                if (E_FTP_RESULT_OK == (result = ftp_recv_non_blocking(ftp_data.d_sd, ftp_data.dBuffer, FTP_BUFFER_SIZE, &len))) {
-                    ftp_data.dtimeout = 0;
-                    ftp_data.ctimeout = 0;
-                    // its a software update
-                    if (ftp_data.special_file) {
-                        if (updater_write(ftp_data.dBuffer, len)) {
-                            break;
-                        }
-                    }
-                    // user file being received
-                    else if (E_FTP_RESULT_OK == ftp_write_file ((char *)ftp_data.dBuffer, len)) {
+                if (E_FTP_RESULT_OK == (result = ftp_recv_non_blocking(ftp_data.d_sd, ftp_data.fBuffer + ftp_data.fBufferLen,
+                                                                       ftp_data.fBufferSize - ftp_data.fBufferLen, &len))) {
+                    ftp_data.dtimeout = mp_hal_ticks_ms();
+                    ftp_data.ctimeout = mp_hal_ticks_ms();
+                    // only write once the window is full
+                    ftp_data.fBufferLen += len;
+                    if (ftp_data.fBufferLen < ftp_data.fBufferSize || ftp_flush_file_buffer()) {
                         break;
                     }
                     ftp_send_reply(451, NULL);
                     ftp_data.state = E_FTP_STE_END_TRANSFER;
                 } else if (result == E_FTP_RESULT_CONTINUE) {
-                    if (ftp_data.dtimeout++ > FTP_DATA_TIMEOUT_MS / FTP_CYCLE_TIME_MS) {
+                    if ((mp_hal_ticks_ms() - ftp_data.dtimeout) > FTP_DATA_TIMEOUT_MS) {
                         ftp_close_files();
                         ftp_send_reply(426, NULL);
                         ftp_data.state = E_FTP_STE_END_TRANSFER;
                     }
                 } else {
+                    // the transfer is complete, write what's left in the window
+                    if (!ftp_flush_file_buffer()) {
+                        ftp_send_reply(451, NULL);
+                        ftp_data.state = E_FTP_STE_END_TRANSFER;
+                        break;
+                    }
                     if (ftp_data.special_file) {
                         ftp_data.special_file = false;
                         updater_finish();
@@ -749,17 +766,17 @@ void ftp_run (void) {
         break;
     case E_FTP_STE_SUB_LISTEN_FOR_DATA:
         if (E_FTP_RESULT_OK == ftp_wait_for_connection(ftp_data.ld_sd, &ftp_data.d_sd, NULL)) {
-            ftp_data.dtimeout = 0;
+            ftp_data.dtimeout = mp_hal_ticks_ms();
             ftp_data.substate = E_FTP_STE_SUB_DATA_CONNECTED;
-        } else if (ftp_data.dtimeout++ > FTP_DATA_TIMEOUT_MS / FTP_CYCLE_TIME_MS) {
-            ftp_data.dtimeout = 0;
+        } else if ((mp_hal_ticks_ms() - ftp_data.dtimeout) > FTP_DATA_TIMEOUT_MS) {
+            ftp_data.dtimeout = mp_hal_ticks_ms();
             // close the listening socket
             servers_close_socket(&ftp_data.ld_sd);
             ftp_data.substate = E_FTP_STE_SUB_DISCONNECTED;
         }
         break;
     case E_FTP_STE_SUB_DATA_CONNECTED:
-        if (ftp_data.state == E_FTP_STE_READY && ftp_data.dtimeout++ > FTP_DATA_TIMEOUT_MS / FTP_CYCLE_TIME_MS) {
+        if (ftp_data.state == E_FTP_STE_READY && (mp_hal_ticks_ms() - ftp_data.dtimeout) > FTP_DATA_TIMEOUT_MS) {
             // close the listening and the data socket
             servers_close_socket(&ftp_data.ld_sd);
             servers_close_socket(&ftp_data.d_sd);
@@ -781,6 +798,56 @@ void ftp_run (void) {
     }
 }
 
+bool ftp_add_wait_sockets (fd_set *readfds, fd_set *writefds, int32_t *maxfd) {
+    SocketFifoElement_t fifoelement;
+    if (SOCKETFIFO_Peek(&fifoelement)) {
+        if (*fifoelement.sd <= 0) {
+            // the socket is gone, the element must be dropped
+            return true;
+        }
+        // wait until the pending data can be sent
+        FD_SET(*fifoelement.sd, writefds);
+        *maxfd = MAX(*maxfd, *fifoelement.sd);
+        return false;
+    }
+
+    switch (ftp_data.state) {
+        case E_FTP_STE_READY:
+            if (ftp_data.c_sd < 0 && ftp_data.substate == E_FTP_STE_SUB_DISCONNECTED) {
+                FD_SET(ftp_data.lc_sd, readfds);
+                *maxfd = MAX(*maxfd, ftp_data.lc_sd);
+            } else if (ftp_data.c_sd > 0 && ftp_data.substate != E_FTP_STE_SUB_LISTEN_FOR_DATA) {
+                FD_SET(ftp_data.c_sd, readfds);
+                *maxfd = MAX(*maxfd, ftp_data.c_sd);
+            }
+            break;
+        case E_FTP_STE_END_TRANSFER:
+            if (ftp_data.d_sd > 0) {
+                // the data sockets must be closed
+                return true;
+            }
+            break;
+        case E_FTP_STE_CONTINUE_LISTING:
+        case E_FTP_STE_CONTINUE_FILE_TX:
+            // the send queue is empty, the next block can be produced
+            return true;
+        case E_FTP_STE_CONTINUE_FILE_RX:
+            if (ftp_data.d_sd > 0) {
+                FD_SET(ftp_data.d_sd, readfds);
+                *maxfd = MAX(*maxfd, ftp_data.d_sd);
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (ftp_data.substate == E_FTP_STE_SUB_LISTEN_FOR_DATA && ftp_data.ld_sd > 0) {
+        FD_SET(ftp_data.ld_sd, readfds);
+        *maxfd = MAX(*maxfd, ftp_data.ld_sd);
+    }
+    return false;
+}
+
 void ftp_enable (void) {
     ftp_data.enabled = true;
 }
@@ -957,10 +1024,10 @@ static void ftp_send_reply (uint32_t status, char *message) {
     }
 }
 
-static void ftp_send_data (uint32_t datasize) {
+static void ftp_send_data (void *data, uint32_t datasize) {
     SocketFifoElement_t fifoelement;
 
-    fifoelement.data = ftp_data.dBuffer;
+    fifoelement.data = data;
     fifoelement.datasize = datasize;
     fifoelement.sd = &ftp_data.d_sd;
     fifoelement.closesockets = E_FTP_CLOSE_NONE;
@@ -1147,7 +1214,7 @@ static void ftp_process_cmd (void) {
                 }
                 if (socketcreated) {
                     uint8_t *pip = (uint8_t *)&ftp_data.ip_addr;
-                    ftp_data.dtimeout = 0;
+                    ftp_data.dtimeout = mp_hal_ticks_ms();
                     snprintf((char *)ftp_data.dBuffer, FTP_BUFFER_SIZE, "(%u,%u,%u,%u,%u,%u)",
                              pip[0], pip[1], pip[2], pip[3], (FTP_PASIVE_DATA_PORT >> 8), (FTP_PASIVE_DATA_PORT & 0xFF));
                     ftp_data.substate = E_FTP_STE_SUB_LISTEN_FOR_DATA;
@@ -1177,6 +1244,7 @@ static void ftp_process_cmd (void) {
             break;
         case E_FTP_CMD_STOR:
             ftp_get_param_and_open_child (&bufptr);
+            ftp_data.fBufferLen = 0;
             // first check if a software update is being requested
             if (updater_check_path (ftp_path)) {
                 if (updater_start()) {
@@ -1191,6 +1259,8 @@ static void ftp_process_cmd (void) {
                 }
             } else {
                 if (ftp_open_file (ftp_path, FA_WRITE | FA_CREATE_ALWAYS)) {
+                    // the file now exists for the importer too
+                    mp_vfs_import_stat_cache_clear();
                     ftp_data.state = E_FTP_STE_CONTINUE_FILE_RX;
                     ftp_send_reply(150, NULL);
                 } else {
@@ -1203,6 +1273,7 @@ static void ftp_process_cmd (void) {
         case E_FTP_CMD_RMD:
             ftp_get_param_and_open_child (&bufptr);
             if (FR_OK == f_unlink_helper(ftp_path)) {
+                mp_vfs_import_stat_cache_clear();
                 ftp_send_reply(250, NULL);
             } else {
                 ftp_send_reply(550, NULL);
@@ -1211,6 +1282,7 @@ static void ftp_process_cmd (void) {
         case E_FTP_CMD_MKD:
             ftp_get_param_and_open_child (&bufptr);
             if (FR_OK == f_mkdir_helper(ftp_path)) {
+                mp_vfs_import_stat_cache_clear();
                 ftp_send_reply(250, NULL);
             } else {
                 ftp_send_reply(550, NULL);
@@ -1230,6 +1302,7 @@ static void ftp_process_cmd (void) {
             ftp_get_param_and_open_child (&bufptr);
             // old path was saved in the data buffer
             if (FR_OK == (fres = f_rename_helper ((char *)ftp_data.dBuffer, ftp_path))) {
+                mp_vfs_import_stat_cache_clear();
                 ftp_send_reply(250, NULL);
             } else {
                 ftp_send_reply(550, NULL);
@@ -1252,7 +1325,7 @@ static void ftp_process_cmd (void) {
             ftp_return_to_previous_path(ftp_path, ftp_scratch_buffer);
         }
     } else if (result == E_FTP_RESULT_CONTINUE) {
-        if (ftp_data.ctimeout++ > (servers_get_timeout() / FTP_CYCLE_TIME_MS)) {
+        if ((mp_hal_ticks_ms() - ftp_data.ctimeout) > servers_get_timeout()) {
             ftp_send_reply(221, NULL);
         }
     } else {
@@ -1435,6 +1508,20 @@ static ftp_result_t ftp_write_file (char *filebuf, uint32_t size) {
     return result;
 }
 
+static bool ftp_flush_file_buffer (void) {
+    uint32_t len = ftp_data.fBufferLen;
+    ftp_data.fBufferLen = 0;
+    if (len == 0) {
+        return true;
+    }
+    // its a software update
+    if (ftp_data.special_file) {
+        return updater_write(ftp_data.fBuffer, len);
+    }
+    // user file being received
+    return E_FTP_RESULT_OK == ftp_write_file ((char *)ftp_data.fBuffer, len);
+}
+
 static ftp_result_t ftp_open_dir_for_listing (const char *path) {
 
     // "hack" to detect the root directory
@@ -10,6 +10,8 @@
 #ifndef FTP_H_
 #define FTP_H_
 
+#include "lwip/sockets.h"
+
 extern void stoupper (char *str);
 
 /******************************************************************************
@@ -20,5 +22,6 @@ extern void ftp_run (void);
 extern void ftp_enable (void);
 extern void ftp_disable (void);
 extern void ftp_reset (void);
+extern bool ftp_add_wait_sockets (fd_set *readfds, fd_set *writefds, int32_t *maxfd);
 
 #endif /* FTP_H_ */
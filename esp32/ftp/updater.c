@@ -10,10 +10,12 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
 #include "py/mpconfig.h"
 #include "py/obj.h"
 #include "bootloader.h"
+#include "bootmgr.h"
 #include "updater.h"
 #include "esp_spi_flash.h"
 #include "esp_flash_encrypt.h"
@@ -22,12 +24,25 @@
 #include "esp_log.h"
 #include "rom/crc.h"
 #include "esp32chipinfo.h"
+#include "pycom_config.h"
+#include "flashstats.h"
+#include "mbedtls/sha256.h"
+#include "nvs.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 
 #ifdef DIFF_UPDATE_ENABLED
 #include "bzlib.h"
 #include "bsdiff_api.h"
 #endif
 
+#if MICROPY_PY_UZLIB
+#include "extmod/uzlib/uzlib.h"
+#endif
+
 /******************************************************************************
  DEFINE PRIVATE CONSTANTS
  ******************************************************************************/
@@ -37,6 +52,32 @@ static const char *TAG = "updater";
 /* if flash is encrypted, it requires the flash_write operation to be done in 16 Bytes chunks */
 #define ENCRYP_FLASH_MIN_CHUNK                            16
 
+/* incoming data is staged in sector sized blocks, while one block is being
+ * erased/programmed by the updater task the next one is being received */
+#define UPDATER_BLOCK_SIZE                                SPI_FLASH_SEC_SIZE
+#define UPDATER_BLOCK_COUNT                               2
+#define UPDATER_TASK_STACK_SIZE                           3072
+#define UPDATER_TASK_PRIORITY                             5
+
+/* length of the SHA-256 digest appended at the end of the application images */
+#define UPDATER_HASH_LEN                                  32
+
+/* streamed delta images ("PYDELTA1"), see tools/mkdelta.py for the format */
+#define DELTA_MAGIC                                       "PYDELTA1"
+#define DELTA_MAGIC_LEN                                   8
+#define DELTA_HEADER_LEN                                  24
+#define DELTA_MAX_CHUNK                                   SPI_FLASH_SEC_SIZE
+#define DELTA_RECORD_HEADER_MAX                           9
+#define DELTA_CHECKPOINT_INTERVAL                         (16 * SPI_FLASH_SEC_SIZE)
+#define DELTA_CHECKPOINT_MAGIC                            0x444C5443
+#define DELTA_NVS_NAMESPACE                               "PY_DELTA"
+#define DELTA_NVS_KEY                                     "ckpt"
+
+#define DELTA_OP_COPY                                     0x01    // u32 old offset, u32 length
+#define DELTA_OP_ADD                                      0x02    // u32 old offset, u16 length, u16 payload length
+#define DELTA_OP_DATA                                     0x03    // u16 length, u16 payload length
+#define DELTA_OP_END                                      0xFF
+
 /******************************************************************************
  DEFINE TYPES
  ******************************************************************************/
@@ -48,6 +89,72 @@ typedef struct {
     uint32_t current_chunk;
 } updater_data_t;
 
+typedef struct {
+    uint8_t *data;
+    uint32_t len;
+} updater_block_t;
+
+typedef struct {
+    QueueHandle_t free_queue;
+    QueueHandle_t write_queue;
+    SemaphoreHandle_t done;
+    TaskHandle_t task;
+    uint8_t *mem;
+    updater_block_t block;              // block currently being filled by updater_write()
+    volatile bool failed;
+} updater_pipe_t;
+
+typedef struct {
+    mbedtls_sha256_context ctx;
+    esp_image_header_t header;
+    uint32_t header_len;
+    uint8_t tail[UPDATER_HASH_LEN];     // held back from the digest, might be the appended image hash
+    uint32_t tail_len;
+    bool finished;
+    bool verified;
+} updater_hash_t;
+
+// where to pick up an interrupted delta update, kept in NVS
+typedef struct {
+    uint32_t magic;
+    uint32_t old_crc;                   // together with new_size identifies the delta
+    uint32_t old_size;
+    uint32_t new_size;
+    uint32_t slot_offset;               // partition the new image goes into
+    uint32_t patch_offset;              // first byte of the delta not applied yet
+    uint32_t new_offset;                // bytes of the new image in flash, sector aligned
+    uint32_t crc;
+} updater_delta_checkpoint_t;
+
+typedef enum {
+    DELTA_STATE_DETECT = 0,             // collecting the first bytes to look for the magic
+    DELTA_STATE_OFF,                    // plain image
+    DELTA_STATE_ACTIVE,
+    DELTA_STATE_DONE,
+    DELTA_STATE_FAILED,
+} updater_delta_state_t;
+
+typedef struct {
+    updater_delta_state_t state;
+    uint8_t head[DELTA_HEADER_LEN];
+    uint32_t head_len;
+    uint8_t *rec;                       // record being received
+    uint8_t *out;                       // bytes of the new image decoded from it
+    uint32_t rec_len;
+#if MICROPY_PY_UZLIB
+    TINF_DATA *inflate;
+#endif
+    uint32_t old_offset;                // running image the delta applies to
+    uint32_t old_size;
+    uint32_t old_crc;
+    uint32_t new_size;
+    uint32_t new_pos;
+    uint32_t patch_pos;                 // delta bytes consumed up to the last complete record
+    uint32_t slot_offset;
+    updater_delta_checkpoint_t pending; // waits until its data is really in flash
+    uint32_t saved_new_offset;
+} updater_delta_t;
+
 /******************************************************************************
  DECLARE PRIVATE DATA
  ******************************************************************************/
@@ -62,12 +169,31 @@ static updater_data_t updater_data = {
 static boot_info_t boot_info;
 static uint32_t boot_info_offset;
 
+static updater_pipe_t updater_pipe;
+static updater_hash_t updater_hash;
+static updater_delta_t updater_delta;
+
 /******************************************************************************
  DECLARE PRIVATE FUNCTIONS
  ******************************************************************************/
 static esp_err_t updater_spi_flash_read(size_t src, void *dest, size_t size, bool allow_decrypt);
 static esp_err_t updater_spi_flash_write(size_t dest_addr, void *src, size_t size, bool write_encrypted);
+static esp_err_t updater_spi_flash_erase(size_t addr);
 static bool updater_is_delta_file(void);
+static bool updater_write_block(uint8_t *buf, uint32_t len);
+static void updater_pipe_start(void);
+static bool updater_pipe_stop(bool flush);
+static void TASK_Updater(void *pvParameters);
+static void updater_hash_start(void);
+static void updater_hash_update(const uint8_t *buf, uint32_t len);
+static void updater_hash_finish(void);
+static bool updater_write_image(uint8_t *buf, uint32_t len);
+static void updater_delta_reset(void);
+static bool updater_delta_begin(void);
+static bool updater_delta_feed(const uint8_t *buf, uint32_t len);
+static bool updater_delta_checkpoint_load(updater_delta_checkpoint_t *ckpt);
+static void updater_delta_checkpoint_store(const updater_delta_checkpoint_t *ckpt);
+static void updater_delta_checkpoint_erase(void);
 
 /******************************************************************************
  DEFINE PUBLIC FUNCTIONS
@@ -105,6 +231,14 @@ bool updater_check_path (void *path) {
 
 bool updater_start (void) {
 
+    // the bootloader must verify the images again
+    bootmgr_image_token_clear();
+
+    // drop whatever was left over from an aborted update
+    updater_pipe_stop(false);
+    updater_delta_reset();
+    updater_delta_checkpoint_erase();
+
     updater_data.size = (esp32_get_chip_rev() > 0 ? IMG_SIZE_8MB : IMG_SIZE_4MB);
     // check which one should be the next active image
     updater_data.offset = updater_ota_next_slot_address();
@@ -113,11 +247,11 @@ bool updater_start (void) {
     updater_data.offset_start_upd = updater_data.offset;
 
     // erase the first 2 sectors
-    if (ESP_OK != spi_flash_erase_sector(updater_data.offset / SPI_FLASH_SEC_SIZE)) {
+    if (ESP_OK != updater_spi_flash_erase(updater_data.offset)) {
         ESP_LOGE(TAG, "Erasing first sector failed!\n");
         return false;
     }
-    if (ESP_OK != spi_flash_erase_sector((updater_data.offset + SPI_FLASH_SEC_SIZE) / SPI_FLASH_SEC_SIZE)) {
+    if (ESP_OK != updater_spi_flash_erase(updater_data.offset + SPI_FLASH_SEC_SIZE)) {
         ESP_LOGE(TAG, "Erasing second sector failed!\n");
         return false;
     }
@@ -125,32 +259,122 @@ bool updater_start (void) {
     boot_info.size = 0;
     updater_data.current_chunk = 0;
 
+    updater_hash_start();
+    updater_pipe_start();
+
+    return true;
+}
+
+bool updater_resume (uint32_t *patch_offset) {
+    updater_delta_checkpoint_t ckpt;
+
+    updater_pipe_stop(false);
+    updater_delta_reset();
+
+    if (!updater_delta_checkpoint_load(&ckpt) || ckpt.slot_offset != updater_ota_next_slot_address()) {
+        // nothing to resume, start over
+        *patch_offset = 0;
+        return updater_start();
+    }
+
+    updater_data.size = (esp32_get_chip_rev() > 0 ? IMG_SIZE_8MB : IMG_SIZE_4MB);
+    updater_data.offset_start_upd = ckpt.slot_offset;
+    updater_data.offset = ckpt.slot_offset + ckpt.new_offset;
+    ESP_LOGI(TAG, "Resuming delta update at new offset %d, delta offset %d\n", ckpt.new_offset, ckpt.patch_offset);
+
+    // whatever was written after the checkpoint gets written again
+    if (ESP_OK != updater_spi_flash_erase(updater_data.offset) ||
+        ESP_OK != updater_spi_flash_erase(updater_data.offset + SPI_FLASH_SEC_SIZE)) {
+        ESP_LOGE(TAG, "Erasing resume sectors failed!\n");
+        return false;
+    }
+
+    boot_info.size = ckpt.new_offset;
+    updater_data.current_chunk = 0;
+
+    // the digest can't be resumed, updater_verify() reads back the flash instead
+    updater_hash_start();
+    updater_pipe_start();
+
+    updater_delta.old_crc = ckpt.old_crc;
+    updater_delta.old_size = ckpt.old_size;
+    updater_delta.new_size = ckpt.new_size;
+    updater_delta.new_pos = ckpt.new_offset;
+    updater_delta.patch_pos = ckpt.patch_offset;
+    updater_delta.saved_new_offset = ckpt.new_offset;
+    if (!updater_delta_begin()) {
+        return false;
+    }
+    *patch_offset = ckpt.patch_offset;
     return true;
 }
 
 bool updater_write (uint8_t *buf, uint32_t len) {
 
-    // the actual writing into flash, not-encrypted,
-    // because it already came encrypted from OTA server
-    if (ESP_OK != updater_spi_flash_write(updater_data.offset, (void *)buf, len, false)) {
-        ESP_LOGE(TAG, "SPI flash write failed\n");
+    switch (updater_delta.state) {
+    case DELTA_STATE_DETECT: {
+        // the first bytes tell whether this is a delta or a plain image
+        uint32_t n = MIN(len, DELTA_HEADER_LEN - updater_delta.head_len);
+        memcpy(updater_delta.head + updater_delta.head_len, buf, n);
+        updater_delta.head_len += n;
+        buf += n;
+        len -= n;
+        if (updater_delta.head_len < DELTA_HEADER_LEN) {
+            return true;
+        }
+        if (memcmp(updater_delta.head, DELTA_MAGIC, DELTA_MAGIC_LEN)) {
+            updater_delta.state = DELTA_STATE_OFF;
+            if (!updater_write_image(updater_delta.head, DELTA_HEADER_LEN)) {
+                return false;
+            }
+            return updater_write_image(buf, len);
+        }
+        memcpy(&updater_delta.new_size, updater_delta.head + 8, sizeof(uint32_t));
+        memcpy(&updater_delta.old_size, updater_delta.head + 12, sizeof(uint32_t));
+        memcpy(&updater_delta.old_crc, updater_delta.head + 16, sizeof(uint32_t));
+        updater_delta.patch_pos = DELTA_HEADER_LEN;
+        if (!updater_delta_begin()) {
+            return false;
+        }
+        return updater_delta_feed(buf, len);
+    }
+    case DELTA_STATE_OFF:
+        return updater_write_image(buf, len);
+    case DELTA_STATE_ACTIVE:
+        return updater_delta_feed(buf, len);
+    default:
+        // data after the end record, or a delta that already failed
         return false;
     }
+}
 
-    updater_data.offset += len;
-    updater_data.current_chunk += len;
-    boot_info.size += len;
+static bool updater_write_image (uint8_t *buf, uint32_t len) {
 
-    if (updater_data.current_chunk >= SPI_FLASH_SEC_SIZE) {
-        updater_data.current_chunk -= SPI_FLASH_SEC_SIZE;
-        // erase the next sector
-        if (ESP_OK != spi_flash_erase_sector((updater_data.offset + SPI_FLASH_SEC_SIZE) / SPI_FLASH_SEC_SIZE)) {
-            ESP_LOGE(TAG, "Erasing next sector failed!\n");
+    if (updater_pipe.task == NULL) {
+        // no pipeline available, write synchronously
+        return updater_write_block(buf, len);
+    }
+
+    while (len > 0) {
+        if (updater_pipe.failed) {
             return false;
         }
+        if (updater_pipe.block.data == NULL) {
+            // wait for the updater task to hand back a block
+            xQueueReceive(updater_pipe.free_queue, &updater_pipe.block.data, portMAX_DELAY);
+            updater_pipe.block.len = 0;
+        }
+        uint32_t n = MIN(len, UPDATER_BLOCK_SIZE - updater_pipe.block.len);
+        memcpy(updater_pipe.block.data + updater_pipe.block.len, buf, n);
+        updater_pipe.block.len += n;
+        buf += n;
+        len -= n;
+        if (updater_pipe.block.len == UPDATER_BLOCK_SIZE) {
+            xQueueSend(updater_pipe.write_queue, &updater_pipe.block, portMAX_DELAY);
+            updater_pipe.block.data = NULL;
+        }
     }
-//    sl_LockObjUnlock (&wlan_LockObj);
-    return true;
+    return !updater_pipe.failed;
 }
 
 #ifdef DIFF_UPDATE_ENABLED
@@ -446,6 +670,11 @@ bool updater_patch(void) {
     }
 
 return_status:
+    // make sure the patched image is completely in flash
+    if (!updater_pipe_stop(true)) {
+        printf("Error while writing the patched image\n");
+        status = false;
+    }
     if (status) {
         // Updating BOOT INFO
         boot_info.PrevImg = boot_info.ActiveImg;
@@ -471,7 +700,26 @@ return_status:
 #endif
 
 bool updater_finish (void) {
+    bool delta_ok = true;
+
+    if (updater_delta.state == DELTA_STATE_DETECT && updater_delta.head_len > 0) {
+        // an image shorter than the delta header
+        updater_delta.state = DELTA_STATE_OFF;
+        delta_ok = updater_write_image(updater_delta.head, updater_delta.head_len);
+    } else if (updater_delta.state == DELTA_STATE_ACTIVE || updater_delta.state == DELTA_STATE_FAILED) {
+        ESP_LOGE(TAG, "Delta update incomplete, %d of %d bytes\n", updater_delta.new_pos, updater_delta.new_size);
+        delta_ok = false;
+    }
+    updater_delta_reset();
+
+    // wait until everything received so far is in flash
+    if (!updater_pipe_stop(true) || !delta_ok) {
+        ESP_LOGE(TAG, "Writing the new image failed, boot info left untouched\n");
+        updater_data.offset = 0;
+        return false;
+    }
     if (updater_data.offset > 0) {
+        updater_hash_finish();
         ESP_LOGI(TAG, "Updater finished, boot status: %d\n", boot_info.Status);
 //        sl_LockObjLock (&wlan_LockObj, SL_OS_WAIT_FOREVER);
         // if we still have an image pending for verification, leave the boot info as it is
@@ -518,6 +766,12 @@ bool updater_verify (void) {
     // the last image written stats at updater_data.offset_start_upd and
     // has the lenght boot_info.size
 
+    // the digest was already computed while the image was being received
+    if (updater_hash.verified) {
+        ESP_LOGI(TAG, "Image hash verified while streaming\n");
+        return true;
+    }
+
     esp_err_t ret;
     esp_image_metadata_t data;
     const esp_partition_pos_t part_pos = {
@@ -538,7 +792,7 @@ bool updater_write_boot_info(boot_info_t *boot_info, uint32_t boot_info_offset)
     boot_info->crc = crc32_le(UINT32_MAX, (uint8_t *)boot_info, sizeof(boot_info_t) - sizeof(boot_info->crc));
     ESP_LOGI(TAG, "Wr crc=0x%x\n", boot_info->crc);
 
-    if (ESP_OK != spi_flash_erase_sector(boot_info_offset / SPI_FLASH_SEC_SIZE)) {
+    if (ESP_OK != updater_spi_flash_erase(boot_info_offset)) {
         printf("Erasing boot info failed\n");
         return false;
     }
@@ -562,13 +816,13 @@ bool updater_write_boot_info(boot_info_t *boot_info, uint32_t boot_info_offset)
         memcpy(buff, (void *)boot_info, sizeof(boot_info_t));
 
         // read the next bytes
-        spi_flash_read_encrypted(boot_info_offset + sizeof(boot_info_t),
-                                (void *)(buff + sizeof(boot_info_t)),
-                                len_aligned_16 - sizeof(boot_info_t) );
+        updater_spi_flash_read(boot_info_offset + sizeof(boot_info_t),
+                               (void *)(buff + sizeof(boot_info_t)),
+                               len_aligned_16 - sizeof(boot_info_t), true);
 
-        ret = spi_flash_write_encrypted(boot_info_offset, (void *)buff, len_aligned_16);
+        ret = updater_spi_flash_write(boot_info_offset, (void *)buff, len_aligned_16, true);
     } else { // not-encrypted flash, just write directly boot_info
-            ret = spi_flash_write(boot_info_offset, (void *)boot_info, sizeof(boot_info_t));
+            ret = updater_spi_flash_write(boot_info_offset, (void *)boot_info, sizeof(boot_info_t), false);
     }
 
     if (ESP_OK != ret) {
@@ -623,11 +877,15 @@ int updater_ota_next_slot_address() {
 
 static esp_err_t updater_spi_flash_read(size_t src, void *dest, size_t size, bool allow_decrypt)
 {
+    esp_err_t err;
+    int64_t start = esp_timer_get_time();
     if (allow_decrypt && esp_flash_encryption_enabled()) {
-        return spi_flash_read_encrypted(src, dest, size);
+        err = spi_flash_read_encrypted(src, dest, size);
     } else {
-        return spi_flash_read(src, dest, size);
+        err = spi_flash_read(src, dest, size);
     }
+    flashstats_record(FLASHSTATS_OTA, FLASHSTATS_READ, size, start, err);
+    return err;
 }
 
 /* @note Both dest_addr and size must be multiples of 16 bytes. For
@@ -637,11 +895,197 @@ static esp_err_t updater_spi_flash_read(size_t src, void *dest, size_t size, boo
 static esp_err_t updater_spi_flash_write(size_t dest_addr, void *src, size_t size,
                                         bool write_encrypted)
 {
+    esp_err_t err;
+    int64_t start = esp_timer_get_time();
     if (write_encrypted && esp_flash_encryption_enabled()) {
-        return spi_flash_write_encrypted(dest_addr, src, size);
+        err = spi_flash_write_encrypted(dest_addr, src, size);
     } else {
-        return spi_flash_write(dest_addr, src, size);
+        err = spi_flash_write(dest_addr, src, size);
+    }
+    flashstats_record(FLASHSTATS_OTA, FLASHSTATS_PROGRAM, size, start, err);
+    return err;
+}
+
+static esp_err_t updater_spi_flash_erase(size_t addr)
+{
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = spi_flash_erase_sector(addr / SPI_FLASH_SEC_SIZE);
+    flashstats_record(FLASHSTATS_OTA, FLASHSTATS_ERASE, SPI_FLASH_SEC_SIZE, start, err);
+    return err;
+}
+
+/* @brief Writes a block of the new image into flash, erasing the next sector
+ * ahead of time.
+ */
+static bool updater_write_block(uint8_t *buf, uint32_t len)
+{
+    // the actual writing into flash, not-encrypted,
+    // because it already came encrypted from OTA server
+    if (ESP_OK != updater_spi_flash_write(updater_data.offset, (void *)buf, len, false)) {
+        ESP_LOGE(TAG, "SPI flash write failed\n");
+        return false;
+    }
+    updater_hash_update(buf, len);
+
+    updater_data.offset += len;
+    updater_data.current_chunk += len;
+    boot_info.size += len;
+
+    if (updater_data.current_chunk >= SPI_FLASH_SEC_SIZE) {
+        updater_data.current_chunk -= SPI_FLASH_SEC_SIZE;
+        // erase the next sector
+        if (ESP_OK != updater_spi_flash_erase(updater_data.offset + SPI_FLASH_SEC_SIZE)) {
+            ESP_LOGE(TAG, "Erasing next sector failed!\n");
+            return false;
+        }
     }
+    return true;
+}
+
+/* @brief Starts the updater task and its staging blocks. If they can't be
+ * allocated updater_write() falls back to writing synchronously.
+ */
+static void updater_pipe_start(void)
+{
+    memset(&updater_pipe, 0, sizeof(updater_pipe));
+
+    updater_pipe.mem = malloc(UPDATER_BLOCK_SIZE * UPDATER_BLOCK_COUNT);
+    updater_pipe.free_queue = xQueueCreate(UPDATER_BLOCK_COUNT, sizeof(uint8_t *));
+    // one extra slot for the end marker
+    updater_pipe.write_queue = xQueueCreate(UPDATER_BLOCK_COUNT + 1, sizeof(updater_block_t));
+    updater_pipe.done = xSemaphoreCreateBinary();
+
+    if (updater_pipe.mem && updater_pipe.free_queue && updater_pipe.write_queue && updater_pipe.done) {
+        for (int i = 0; i < UPDATER_BLOCK_COUNT; i++) {
+            uint8_t *data = updater_pipe.mem + (i * UPDATER_BLOCK_SIZE);
+            xQueueSend(updater_pipe.free_queue, &data, 0);
+        }
+        if (pdPASS == xTaskCreatePinnedToCore(TASK_Updater, "Updater", UPDATER_TASK_STACK_SIZE / sizeof(StackType_t), NULL,
+                                              UPDATER_TASK_PRIORITY, &updater_pipe.task, config_get_service_core())) {
+            return;
+        }
+    }
+
+    ESP_LOGW(TAG, "Updater pipeline not available, writing synchronously\n");
+    updater_pipe.task = NULL;
+    updater_pipe_stop(false);
+}
+
+/* @brief Waits for the updater task to write out everything queued so far
+ * and releases the pipeline. When flush is false the partially filled block
+ * is dropped. Returns false if any block failed to be written.
+ */
+static bool updater_pipe_stop(bool flush)
+{
+    bool failed = updater_pipe.failed;
+
+    if (updater_pipe.task) {
+        if (flush && updater_pipe.block.data && updater_pipe.block.len > 0) {
+            xQueueSend(updater_pipe.write_queue, &updater_pipe.block, portMAX_DELAY);
+        }
+        updater_block_t marker = { .data = NULL, .len = 0 };
+        xQueueSend(updater_pipe.write_queue, &marker, portMAX_DELAY);
+        xSemaphoreTake(updater_pipe.done, portMAX_DELAY);
+        failed = updater_pipe.failed;
+    }
+
+    if (updater_pipe.done) {
+        vSemaphoreDelete(updater_pipe.done);
+    }
+    if (updater_pipe.write_queue) {
+        vQueueDelete(updater_pipe.write_queue);
+    }
+    if (updater_pipe.free_queue) {
+        vQueueDelete(updater_pipe.free_queue);
+    }
+    free(updater_pipe.mem);
+    memset(&updater_pipe, 0, sizeof(updater_pipe));
+
+    return !failed;
+}
+
+static void TASK_Updater(void *pvParameters)
+{
+    updater_block_t block;
+
+    for (;;) {
+        xQueueReceive(updater_pipe.write_queue, &block, portMAX_DELAY);
+        if (block.data == NULL) {
+            // end marker, everything queued before it has been handled. The
+            // digest is finalized here as well, in the task that has been feeding it
+            updater_hash_finish();
+            break;
+        }
+        // once a block failed the image is unusable, just recycle the rest
+        if (!updater_pipe.failed && !updater_write_block(block.data, block.len)) {
+            updater_pipe.failed = true;
+        }
+        xQueueSend(updater_pipe.free_queue, &block.data, portMAX_DELAY);
+    }
+
+    xSemaphoreGive(updater_pipe.done);
+    vTaskDelete(NULL);
+}
+
+static void updater_hash_start(void)
+{
+    mbedtls_sha256_free(&updater_hash.ctx);
+    memset(&updater_hash, 0, sizeof(updater_hash));
+    mbedtls_sha256_init(&updater_hash.ctx);
+    mbedtls_sha256_starts_ret(&updater_hash.ctx, 0);
+}
+
+/* @brief Feeds the digest with everything but the last UPDATER_HASH_LEN bytes
+ * received so far, these are only known to be the appended hash once the
+ * transfer is over.
+ */
+static void updater_hash_update(const uint8_t *buf, uint32_t len)
+{
+    if (updater_hash.header_len < sizeof(esp_image_header_t)) {
+        uint32_t n = MIN(len, sizeof(esp_image_header_t) - updater_hash.header_len);
+        memcpy((uint8_t *)&updater_hash.header + updater_hash.header_len, buf, n);
+        updater_hash.header_len += n;
+    }
+
+    if (len >= UPDATER_HASH_LEN) {
+        mbedtls_sha256_update_ret(&updater_hash.ctx, updater_hash.tail, updater_hash.tail_len);
+        mbedtls_sha256_update_ret(&updater_hash.ctx, buf, len - UPDATER_HASH_LEN);
+        memcpy(updater_hash.tail, buf + len - UPDATER_HASH_LEN, UPDATER_HASH_LEN);
+        updater_hash.tail_len = UPDATER_HASH_LEN;
+    } else {
+        uint32_t total = updater_hash.tail_len + len;
+        if (total > UPDATER_HASH_LEN) {
+            uint32_t spill = total - UPDATER_HASH_LEN;
+            mbedtls_sha256_update_ret(&updater_hash.ctx, updater_hash.tail, spill);
+            memmove(updater_hash.tail, updater_hash.tail + spill, updater_hash.tail_len - spill);
+            updater_hash.tail_len -= spill;
+        }
+        memcpy(updater_hash.tail + updater_hash.tail_len, buf, len);
+        updater_hash.tail_len += len;
+    }
+}
+
+/* @brief Compares the streamed digest against the hash appended to the image.
+ * With flash encryption the received data is ciphertext, so in that case (or
+ * for images without an appended hash) updater_verify() reads back the flash.
+ */
+static void updater_hash_finish(void)
+{
+    uint8_t digest[UPDATER_HASH_LEN];
+
+    if (updater_hash.finished) {
+        return;
+    }
+    updater_hash.finished = true;
+    mbedtls_sha256_finish_ret(&updater_hash.ctx, digest);
+    mbedtls_sha256_free(&updater_hash.ctx);
+
+    updater_hash.verified = !esp_flash_encryption_enabled() &&
+                            updater_hash.header_len == sizeof(esp_image_header_t) &&
+                            updater_hash.header.magic == ESP_IMAGE_HEADER_MAGIC &&
+                            updater_hash.header.hash_appended &&
+                            updater_hash.tail_len == UPDATER_HASH_LEN &&
+                            !memcmp(digest, updater_hash.tail, UPDATER_HASH_LEN);
 }
 
 /* @brief Checks whether the image present in the inactive partition a patch
@@ -694,3 +1138,301 @@ static bool updater_is_delta_file(void)
 
     return true;
 }
+
+/* @brief Forgets the delta state, the checkpoint in NVS is left alone.
+ */
+static void updater_delta_reset(void)
+{
+    free(updater_delta.rec);
+    free(updater_delta.out);
+#if MICROPY_PY_UZLIB
+    free(updater_delta.inflate);
+#endif
+    memset(&updater_delta, 0, sizeof(updater_delta));
+}
+
+/* @brief Prepares to apply a streamed delta against the running image. The
+ * header fields are already filled in; on a fresh start the running image is
+ * checked against the CRC the delta was made for.
+ */
+static bool updater_delta_begin(void)
+{
+#if MICROPY_PY_UZLIB
+    // the running image is whichever slot isn't being written
+    updater_delta.slot_offset = updater_data.offset_start_upd;
+    if (updater_delta.slot_offset == IMG_FACTORY_OFFSET) {
+        updater_delta.old_offset = (esp32_get_chip_rev() > 0 ? IMG_UPDATE1_OFFSET_8MB : IMG_UPDATE1_OFFSET_4MB);
+    } else {
+        updater_delta.old_offset = IMG_FACTORY_OFFSET;
+    }
+
+    updater_delta.state = DELTA_STATE_FAILED;
+    if (updater_delta.new_size > updater_data.size || updater_delta.old_size > updater_data.size) {
+        ESP_LOGE(TAG, "Delta sizes out of range\n");
+        return false;
+    }
+
+    updater_delta.rec = malloc(DELTA_RECORD_HEADER_MAX + DELTA_MAX_CHUNK);
+    updater_delta.out = malloc(DELTA_MAX_CHUNK);
+    updater_delta.inflate = malloc(sizeof(TINF_DATA));
+    if (!updater_delta.rec || !updater_delta.out || !updater_delta.inflate) {
+        ESP_LOGE(TAG, "Not enough memory to apply the delta\n");
+        return false;
+    }
+
+    if (updater_delta.new_pos == 0) {
+        uint32_t crc = 0;
+        for (uint32_t pos = 0; pos < updater_delta.old_size; pos += DELTA_MAX_CHUNK) {
+            uint32_t n = MIN(DELTA_MAX_CHUNK, updater_delta.old_size - pos);
+            if (ESP_OK != updater_spi_flash_read(updater_delta.old_offset + pos, updater_delta.out, n, false)) {
+                return false;
+            }
+            crc = crc32_le(crc, updater_delta.out, n);
+        }
+        if (crc != updater_delta.old_crc) {
+            printf("Delta update was made for a different firmware\n");
+            return false;
+        }
+    }
+
+    printf("Delta Update Image detected, applying it while it is received.\n");
+    updater_delta.rec_len = 0;
+    updater_delta.state = DELTA_STATE_ACTIVE;
+    return true;
+#else
+    printf("Delta Update Image detected. This feature is disabled in the build.\n");
+    updater_delta.state = DELTA_STATE_FAILED;
+    return false;
+#endif
+}
+
+#if MICROPY_PY_UZLIB
+static uint32_t updater_delta_get_u16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t updater_delta_get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* @brief Returns how long the record in rec is, as far as can be told from the
+ * rec_len bytes received so far, or 0 if the opcode is invalid.
+ */
+static uint32_t updater_delta_record_len(void)
+{
+    const uint8_t *rec = updater_delta.rec;
+
+    switch (rec[0]) {
+    case DELTA_OP_COPY:
+        return 9;
+    case DELTA_OP_ADD:
+        return (updater_delta.rec_len < 9) ? 9 : 9 + updater_delta_get_u16(rec + 7);
+    case DELTA_OP_DATA:
+        return (updater_delta.rec_len < 5) ? 5 : 5 + updater_delta_get_u16(rec + 3);
+    case DELTA_OP_END:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* @brief Decodes a payload into out, either stored (same length) or raw
+ * deflate compressed on its own.
+ */
+static bool updater_delta_unpack(const uint8_t *payload, uint32_t plen, uint32_t len)
+{
+    if (plen == len) {
+        memcpy(updater_delta.out, payload, len);
+        return true;
+    }
+    TINF_DATA *d = updater_delta.inflate;
+    memset(d, 0, sizeof(TINF_DATA));
+    uzlib_uncompress_init(d, NULL, 0);
+    d->source = payload;
+    d->source_limit = payload + plen;
+    d->dest_start = d->dest = updater_delta.out;
+    d->dest_limit = updater_delta.out + len;
+    int st = uzlib_uncompress(d);
+    return st >= 0 && d->dest == d->dest_limit;
+}
+
+/* @brief Remembers where to resume from once the new image is written up to a
+ * sector boundary. The checkpoint only reaches NVS after its data has left the
+ * write pipeline, and at most every DELTA_CHECKPOINT_INTERVAL bytes.
+ */
+static void updater_delta_checkpoint(void)
+{
+    if ((updater_delta.new_pos % SPI_FLASH_SEC_SIZE) != 0) {
+        return;
+    }
+    if (updater_delta.pending.magic == DELTA_CHECKPOINT_MAGIC && boot_info.size >= updater_delta.pending.new_offset &&
+        updater_delta.pending.new_offset >= updater_delta.saved_new_offset + DELTA_CHECKPOINT_INTERVAL) {
+        updater_delta_checkpoint_store(&updater_delta.pending);
+        updater_delta.saved_new_offset = updater_delta.pending.new_offset;
+    }
+    updater_delta.pending.magic = DELTA_CHECKPOINT_MAGIC;
+    updater_delta.pending.old_crc = updater_delta.old_crc;
+    updater_delta.pending.old_size = updater_delta.old_size;
+    updater_delta.pending.new_size = updater_delta.new_size;
+    updater_delta.pending.slot_offset = updater_delta.slot_offset;
+    updater_delta.pending.patch_offset = updater_delta.patch_pos;
+    updater_delta.pending.new_offset = updater_delta.new_pos;
+}
+
+static bool updater_delta_apply(void)
+{
+    const uint8_t *rec = updater_delta.rec;
+    uint32_t old_pos = 0, len = 0;
+
+    switch (rec[0]) {
+    case DELTA_OP_END:
+        if (updater_delta.new_pos != updater_delta.new_size) {
+            ESP_LOGE(TAG, "Delta ended at %d of %d bytes\n", updater_delta.new_pos, updater_delta.new_size);
+            return false;
+        }
+        updater_delta.state = DELTA_STATE_DONE;
+        updater_delta_checkpoint_erase();
+        return true;
+    case DELTA_OP_COPY:
+        old_pos = updater_delta_get_u32(rec + 1);
+        len = updater_delta_get_u32(rec + 5);
+        break;
+    case DELTA_OP_ADD:
+        old_pos = updater_delta_get_u32(rec + 1);
+        len = updater_delta_get_u16(rec + 5);
+        break;
+    case DELTA_OP_DATA:
+        len = updater_delta_get_u16(rec + 1);
+        break;
+    }
+
+    // records never straddle a sector of the new image, that's what makes
+    // every sector boundary a place to resume from
+    if (len == 0 || len > DELTA_MAX_CHUNK || updater_delta.new_pos + len > updater_delta.new_size ||
+        (updater_delta.new_pos % SPI_FLASH_SEC_SIZE) + len > SPI_FLASH_SEC_SIZE ||
+        (rec[0] != DELTA_OP_DATA && old_pos + len > updater_delta.old_size)) {
+        ESP_LOGE(TAG, "Corrupt delta record at %d\n", updater_delta.patch_pos);
+        return false;
+    }
+
+    if (rec[0] == DELTA_OP_COPY) {
+        if (ESP_OK != updater_spi_flash_read(updater_delta.old_offset + old_pos, updater_delta.out, len, false)) {
+            return false;
+        }
+    } else {
+        uint32_t hlen = (rec[0] == DELTA_OP_ADD) ? 9 : 5;
+        if (!updater_delta_unpack(rec + hlen, updater_delta.rec_len - hlen, len)) {
+            ESP_LOGE(TAG, "Corrupt delta payload at %d\n", updater_delta.patch_pos);
+            return false;
+        }
+        if (rec[0] == DELTA_OP_ADD) {
+            // the old bytes go into rec, its payload has been decoded already
+            uint8_t *old = updater_delta.rec;
+            if (ESP_OK != updater_spi_flash_read(updater_delta.old_offset + old_pos, old, len, false)) {
+                return false;
+            }
+            for (uint32_t i = 0; i < len; i++) {
+                updater_delta.out[i] += old[i];
+            }
+        }
+    }
+
+    if (!updater_write_image(updater_delta.out, len)) {
+        return false;
+    }
+    updater_delta.new_pos += len;
+    return true;
+}
+
+static bool updater_delta_feed(const uint8_t *buf, uint32_t len)
+{
+    while (len > 0) {
+        if (updater_delta.state != DELTA_STATE_ACTIVE) {
+            updater_delta.state = DELTA_STATE_FAILED;
+            return false;
+        }
+        if (updater_delta.rec_len == 0) {
+            updater_delta.rec[updater_delta.rec_len++] = *buf++;
+            len--;
+        }
+        uint32_t need = updater_delta_record_len();
+        if (need == 0 || need > DELTA_RECORD_HEADER_MAX + DELTA_MAX_CHUNK) {
+            ESP_LOGE(TAG, "Corrupt delta record at %d\n", updater_delta.patch_pos);
+            updater_delta.state = DELTA_STATE_FAILED;
+            return false;
+        }
+        uint32_t n = MIN(len, need - updater_delta.rec_len);
+        memcpy(updater_delta.rec + updater_delta.rec_len, buf, n);
+        updater_delta.rec_len += n;
+        buf += n;
+        len -= n;
+        // the payload length is only known once the record header is in
+        if (updater_delta.rec_len == need && updater_delta_record_len() == need) {
+            if (!updater_delta_apply()) {
+                updater_delta.state = DELTA_STATE_FAILED;
+                return false;
+            }
+            updater_delta.patch_pos += need;
+            updater_delta.rec_len = 0;
+            if (updater_delta.state == DELTA_STATE_ACTIVE) {
+                updater_delta_checkpoint();
+            }
+        }
+    }
+    return true;
+}
+#else
+static bool updater_delta_feed(const uint8_t *buf, uint32_t len)
+{
+    return false;
+}
+#endif
+
+static uint32_t updater_delta_checkpoint_crc(const updater_delta_checkpoint_t *ckpt)
+{
+    return crc32_le(UINT32_MAX, (const uint8_t *)ckpt, sizeof(updater_delta_checkpoint_t) - sizeof(ckpt->crc));
+}
+
+static bool updater_delta_checkpoint_load(updater_delta_checkpoint_t *ckpt)
+{
+    nvs_handle handle;
+    size_t len = sizeof(updater_delta_checkpoint_t);
+    bool ok = false;
+
+    if (nvs_open(DELTA_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        ok = nvs_get_blob(handle, DELTA_NVS_KEY, ckpt, &len) == ESP_OK &&
+             len == sizeof(updater_delta_checkpoint_t) &&
+             ckpt->magic == DELTA_CHECKPOINT_MAGIC &&
+             ckpt->crc == updater_delta_checkpoint_crc(ckpt);
+        nvs_close(handle);
+    }
+    return ok;
+}
+
+static void updater_delta_checkpoint_store(const updater_delta_checkpoint_t *ckpt)
+{
+    nvs_handle handle;
+    updater_delta_checkpoint_t copy = *ckpt;
+
+    copy.crc = updater_delta_checkpoint_crc(&copy);
+    if (nvs_open(DELTA_NVS_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK) {
+        if (nvs_set_blob(handle, DELTA_NVS_KEY, &copy, sizeof(copy)) == ESP_OK) {
+            nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+}
+
+static void updater_delta_checkpoint_erase(void)
+{
+    nvs_handle handle;
+
+    if (nvs_open(DELTA_NVS_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK) {
+        if (nvs_erase_key(handle, DELTA_NVS_KEY) == ESP_OK) {
+            nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+}
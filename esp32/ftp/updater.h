@@ -30,6 +30,17 @@ extern bool updater_check_path(void *path);
  */
 extern bool updater_start(void);
 
+/**
+ * @brief  Picks up a delta update that was interrupted, from its last checkpoint.
+ *
+ * @note Falls back to updater_start() when there is nothing to resume.
+ *
+ * @param  patch_offset [out] offset in the delta file from which the data has to be sent again
+ *
+ * @return true if initialization succeeded; false otherwise.
+ */
+extern bool updater_resume(uint32_t *patch_offset);
+
 
 /**
  * @brief  OTA Write next chunk to Flash.
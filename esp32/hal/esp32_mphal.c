@@ -15,6 +15,7 @@
 #include "py/mphal.h"
 #include "py/runtime.h"
 #include "py/objstr.h"
+#include "py/mperrno.h"
 #include "py/mpstate.h"
 
 #include "esp_heap_caps.h"
@@ -36,9 +37,12 @@
 #include "modwlan.h"
 #include "modbt.h"
 #include "machtimer.h"
+#include "machrtc.h"
 #include "mpirq.h"
+#include "taskwdt.h"
 
 #include "driver/timer.h"
+#include "esp_timer.h"
 
 typedef void (*HAL_tick_user_cb_t)(void);
 #if defined (LOPY) || defined(LOPY4) || defined(FIPY)
@@ -101,30 +105,99 @@ void mp_hal_init(bool soft_reset) {
 
     #endif
     }
+#if MICROPY_PY_MICROPYTHON_PROFILE
+    else {
+        // a profile doesn't survive the soft reset
+        mp_hal_profile_timer(0);
+    }
+#endif
+}
+
+#if MICROPY_PY_MICROPYTHON_PROFILE
+static esp_timer_handle_t profile_timer;
+
+// Runs in the esp_timer task, so the sample is taken from another core/task
+static void profile_timer_cb(void *arg) {
+    mp_micropython_profile_sample();
+}
+
+void mp_hal_profile_timer(mp_uint_t period_us) {
+    if (profile_timer == NULL) {
+        if (period_us == 0) {
+            return;
+        }
+        esp_timer_create_args_t args = {
+            .callback = profile_timer_cb,
+            .arg = NULL,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "profile",
+        };
+        if (esp_timer_create(&args, &profile_timer) != ESP_OK) {
+            mp_raise_OSError(MP_ENOMEM);
+        }
+    }
+    esp_timer_stop(profile_timer);
+    if (period_us > 0) {
+        esp_timer_start_periodic(profile_timer, period_us);
+    }
 }
+#endif
 
 void mp_hal_feed_watchdog(void) {
+    taskwdt_alive();
+}
+
+// shorter waits aren't worth a context switch, and the timed ones wake up that
+// early to spin the last microseconds, as getting the GIL back takes a while
+#define MP_HAL_DELAY_SPIN_US                (100)
+#define MP_HAL_DELAY_WAKE_EARLY_US          (50)
+
+typedef struct {
+    TaskHandle_t task;
+    volatile bool fired;
+} mp_hal_delay_wake_t;
+
+STATIC void mp_hal_delay_timer_cb(void *arg) {
+    mp_hal_delay_wake_t *wake = arg;
+    wake->fired = true;
+    xTaskNotifyGive(wake->task);
+}
 
+void mp_hal_delay_until_us(uint64_t target) {
+    int64_t remaining = (int64_t)(target - esp_timer_get_time());
+    if (remaining >= MP_HAL_DELAY_SPIN_US) {
+        // block on a one-shot timer without the GIL, the tick would be too coarse
+        mp_hal_delay_wake_t wake = { .task = xTaskGetCurrentTaskHandle(), .fired = false };
+        esp_timer_create_args_t timer_args = { .callback = mp_hal_delay_timer_cb, .arg = &wake,
+                                               .dispatch_method = ESP_TIMER_TASK, .name = "delay" };
+        esp_timer_handle_t timer;
+        if (esp_timer_create(&timer_args, &timer) == ESP_OK) {
+            ulTaskNotifyTake(pdTRUE, 0);
+            esp_timer_start_once(timer, remaining - MP_HAL_DELAY_WAKE_EARLY_US);
+            MP_THREAD_GIL_EXIT();
+            while (!wake.fired) {
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            }
+            MP_THREAD_GIL_ENTER();
+            esp_timer_delete(timer);
+        }
+    }
+    while ((int64_t)(target - esp_timer_get_time()) > 0);
 }
 
 void mp_hal_delay_us(uint32_t us) {
-    if (us <= 1000) {
+    if (us < MP_HAL_DELAY_SPIN_US) {
         if (us > 0) {
             ets_delay_us(us);
         }
     } else {
-        uint32_t ms = us / 1000;
-        us = us % 1000;
-        MP_THREAD_GIL_EXIT();
-        vTaskDelay (ms / portTICK_PERIOD_MS);
-        MP_THREAD_GIL_ENTER();
-        if (us > 0) {
-            ets_delay_us(us);
-        }
+        mp_hal_delay_until_us(esp_timer_get_time() + us);
     }
 }
 
 int mp_hal_stdin_rx_chr(void) {
+    // the prompt, or whatever was printed before waiting for input, must be seen now
+    telnet_flush();
     for ( ; ; ) {
         // read telnet first
         if (telnet_rx_any()) {
@@ -186,22 +259,17 @@ void mp_hal_stdout_tx_strn_cooked(const char *str, uint32_t len) {
     }
 }
 
+// the ticks come from the monotonic timebase, setting the clock doesn't move them
 uint32_t mp_hal_ticks_s(void) {
-    struct timeval now;
-    gettimeofday(&now, NULL);
-    return now.tv_sec;
+    return mach_rtc_ticks_us64() / 1000000;
 }
 
 IRAM_ATTR uint32_t mp_hal_ticks_ms(void) {
-    struct timeval now;
-    gettimeofday(&now, NULL);
-    return now.tv_sec * 1000 + now.tv_usec / 1000;
+    return mach_rtc_ticks_us64() / 1000;
 }
 
 IRAM_ATTR uint32_t mp_hal_ticks_us(void) {
-    struct timeval now;
-    gettimeofday(&now, NULL);
-    return now.tv_sec * 1000000 + now.tv_usec;
+    return mach_rtc_ticks_us64();
 }
 
 IRAM_ATTR uint64_t mp_hal_ticks_ms_non_blocking(void) {
@@ -237,3 +305,44 @@ void mp_hal_reset_safe_and_boot(bool reset) {
         machine_reset();
     }
 }
+
+#if MICROPY_EMIT_NATIVE
+// Native code must run from IRAM (PSRAM is not executable on the ESP32), which is
+// outside the GC heap, so the committed blocks are kept in a list and released
+// on soft reset when all the function objects referring to them are gone.
+typedef struct _native_code_node_t {
+    struct _native_code_node_t *next;
+    uint32_t data[];
+} native_code_node_t;
+
+static native_code_node_t *native_code_head = NULL;
+
+void *esp_native_code_commit(void *buf, size_t len) {
+    // IRAM only supports 32-bit accesses
+    size_t n_words = (len + 3) / 4;
+    size_t len_node = sizeof(native_code_node_t) + n_words * sizeof(uint32_t);
+    native_code_node_t *node = heap_caps_malloc(len_node, MALLOC_CAP_EXEC);
+    if (node == NULL) {
+        m_malloc_fail(len_node);
+    }
+    const uint8_t *src = buf;
+    for (size_t i = 0; i < n_words; ++i, src += 4) {
+        uint32_t w = src[0];
+        for (size_t j = 1; j < 4 && i * 4 + j < len; ++j) {
+            w |= (uint32_t)src[j] << (8 * j);
+        }
+        node->data[i] = w;
+    }
+    node->next = native_code_head;
+    native_code_head = node;
+    return node->data;
+}
+
+void esp_native_code_free_all(void) {
+    while (native_code_head != NULL) {
+        native_code_node_t *next = native_code_head->next;
+        heap_caps_free(native_code_head);
+        native_code_head = next;
+    }
+}
+#endif
@@ -16,6 +16,7 @@ void HAL_set_tick_cb (void *cb);
 void mp_hal_init(bool soft_reset);
 void mp_hal_feed_watchdog(void);
 void mp_hal_delay_us(uint32_t us);
+void mp_hal_delay_until_us(uint64_t target);
 int mp_hal_stdin_rx_chr(void);
 void mp_hal_stdout_tx_str(const char *str);
 void mp_hal_stdout_tx_strn(const char *str, uint32_t len);
@@ -29,5 +30,8 @@ void mp_hal_delay_ms(uint32_t delay);
 void mp_hal_set_interrupt_char(int c);
 void mp_hal_set_reset_char(int c);
 void mp_hal_reset_safe_and_boot(bool reset);
+#if MICROPY_EMIT_NATIVE
+void esp_native_code_free_all(void);
+#endif
 
 #endif // _INCLUDED_MPHAL_H_
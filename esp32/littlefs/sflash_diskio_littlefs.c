@@ -1,31 +1,101 @@
+#include <string.h>
+
 #include "ff.h" /* Needed by diskio.h */
 #include "diskio.h"
 #include "sflash_diskio.h"
 #include "sflash_diskio_littlefs.h"
+#include "lfs_util.h"
 
 //TODO: figure out a proper value here
 #define PYCOM_CONTEXT ((void*)"pycom.io")
 
 
-char prog_buffer[SFLASH_BLOCK_SIZE] = {0};
-char read_buffer[SFLASH_BLOCK_SIZE] = {0};
+typedef struct {
+    lfs_block_t block;
+    lfs_off_t   off;
+    uint32_t    used;       // LRU stamp
+    uint8_t     data[SFLASH_LFS_RCACHE_LINE_SIZE];
+} littlefs_rcache_line_t;
+
+char prog_buffer[SFLASH_LFS_CACHE_SIZE] = {0};
+char read_buffer[SFLASH_LFS_CACHE_SIZE] = {0};
 // Must be on 64 bit aligned address, create it as array of 64 bit entries to achieve it
 uint64_t lookahead_buffer[SFLASH_BLOCK_COUNT_8MB/(8*8)] = {0};
 
+// all the calls below are serialized by the littlefs mutex of the VFS
+static littlefs_rcache_line_t littlefs_rcache[SFLASH_LFS_RCACHE_LINES];
+static uint32_t littlefs_rcache_clock;
+
+static void littlefs_rcache_invalidate(lfs_block_t block, lfs_off_t off, lfs_size_t size)
+{
+    for (int i = 0; i < SFLASH_LFS_RCACHE_LINES; i++) {
+        littlefs_rcache_line_t *line = &littlefs_rcache[i];
+        if (line->used && line->block == block && off < line->off + SFLASH_LFS_RCACHE_LINE_SIZE && line->off < off + size) {
+            line->used = 0;
+        }
+    }
+}
+
+static littlefs_rcache_line_t *littlefs_rcache_get(const struct lfs_config *c, lfs_block_t block, lfs_off_t off)
+{
+    littlefs_rcache_line_t *victim = &littlefs_rcache[0];
+
+    for (int i = 0; i < SFLASH_LFS_RCACHE_LINES; i++) {
+        littlefs_rcache_line_t *line = &littlefs_rcache[i];
+        if (line->used && line->block == block && line->off == off) {
+            line->used = ++littlefs_rcache_clock;
+            return line;
+        }
+        if (line->used < victim->used) {
+            victim = line;
+        }
+    }
+
+    victim->used = 0;
+    if (LFS_ERR_OK != sflash_disk_read_littlefs(c, victim->data, block, off, SFLASH_LFS_RCACHE_LINE_SIZE)) {
+        return NULL;
+    }
+    victim->block = block;
+    victim->off = off;
+    victim->used = ++littlefs_rcache_clock;
+    return victim;
+}
+
 int littlefs_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size)
 {
-    return sflash_disk_read_littlefs(c, buffer, block, size);
+    uint8_t *data = buffer;
+
+    // bulk file data bypasses the cache, it would only evict the metadata
+    if (size > SFLASH_LFS_RCACHE_LINE_SIZE) {
+        return sflash_disk_read_littlefs(c, buffer, block, off, size);
+    }
+
+    while (size > 0) {
+        lfs_off_t line_off = off - (off % SFLASH_LFS_RCACHE_LINE_SIZE);
+        lfs_size_t chunk = lfs_min(size, line_off + SFLASH_LFS_RCACHE_LINE_SIZE - off);
+        littlefs_rcache_line_t *line = littlefs_rcache_get(c, block, line_off);
+        if (!line) {
+            return LFS_ERR_IO;
+        }
+        memcpy(data, &line->data[off - line_off], chunk);
+        data += chunk;
+        off += chunk;
+        size -= chunk;
+    }
+    return LFS_ERR_OK;
 }
 
 
 int littlefs_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size)
 {
-    return sflash_disk_write_littlefs(c, buffer, block, size);
+    littlefs_rcache_invalidate(block, off, size);
+    return sflash_disk_write_littlefs(c, buffer, block, off, size);
 }
 
 
 int littlefs_erase(const struct lfs_config *c, lfs_block_t block)
 {
+    littlefs_rcache_invalidate(block, 0, SFLASH_BLOCK_SIZE);
     return sflash_disk_erase_littlefs(c, block);
 }
 
@@ -41,16 +111,16 @@ struct lfs_config lfscfg =
     .prog = &littlefs_prog,
     .erase = &littlefs_erase,
     .sync = &littlefs_sync,
-    .read_size = SFLASH_BLOCK_SIZE,
-    .prog_size = SFLASH_BLOCK_SIZE,
+    .read_size = SFLASH_LFS_READ_SIZE,
+    .prog_size = SFLASH_LFS_PROG_SIZE,
     .block_size = SFLASH_BLOCK_SIZE,
     .block_count = 0, // To be initialized according to the flash size of the chip
     .block_cycles = 0, // No block-level wear-leveling
-    /* Current implementation of littlefs_read/prog/erase/sync() functions only operates with
-     * full blocks, always the starting address of the block is passed to the driver.
-     * This helps on the Power-loss resilient behavior of LittleFS, with this approach the File System will not be corrupted by corruption of a single file/block
-     * E.g.: it is not possible to only read/write a middle of a block, inline files will not work, set cache_size equal to read/prog size.*/
-    .cache_size = SFLASH_BLOCK_SIZE,
+    /* Reads and programs go to any offset inside a block, littlefs only ever programs erased areas and checks each commit
+     * with a CRC, so a power loss in the middle of a page program is still caught on mount.
+     * Files up to cache_size / block_size/8 (512 bytes) are kept inline in their directory's metadata instead of taking a whole block,
+     * every open file needs a cache_size buffer too.*/
+    .cache_size = SFLASH_LFS_CACHE_SIZE,
     .lookahead_size = 0, // To be initialized according to the flash size of the chip
     .prog_buffer = prog_buffer,
     .read_buffer = read_buffer,
@@ -4,6 +4,14 @@
 
 #include "lfs.h"
 
+// SPI NOR flash can be read at any byte and programmed in 256 byte pages once erased
+#define SFLASH_LFS_READ_SIZE            (32)
+#define SFLASH_LFS_PROG_SIZE            (256)
+#define SFLASH_LFS_CACHE_SIZE           (512)
+// lines of the driver read cache, which keeps the metadata of recently walked directories
+#define SFLASH_LFS_RCACHE_LINES         (4)
+#define SFLASH_LFS_RCACHE_LINE_SIZE     SFLASH_LFS_CACHE_SIZE
+
 extern int littlefs_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size);
 extern int littlefs_prog(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size);
 extern int littlefs_erase(const struct lfs_config *c, lfs_block_t block);
@@ -4,6 +4,7 @@
 #include <string.h>
 #include "py/runtime.h"
 #include "py/mperrno.h"
+#include "py/gc.h"
 #include "lib/oofatfs/ff.h"
 #include "extmod/vfs.h"
 #include "vfs_littlefs.h"
@@ -395,6 +396,27 @@ void littlefs_update_timestamp_cfg(struct lfs_file_config *cfg)
     }
 }
 
+// The GIL is given up before waiting for the mutex and taken back only after releasing it,
+// so the flash task or FTP holding the mutex can never deadlock with a Python thread
+bool littlefs_io_lock(vfs_lfs_struct_t* littlefs)
+{
+    // no other thread may run in the middle of a collection, e.g. when a finaliser closes a file
+    bool release_gil = !gc_is_locked();
+    if (release_gil) {
+        MP_THREAD_GIL_EXIT();
+    }
+    xSemaphoreTake(littlefs->mutex, portMAX_DELAY);
+    return release_gil;
+}
+
+void littlefs_io_unlock(vfs_lfs_struct_t* littlefs, bool gil_released)
+{
+    xSemaphoreGive(littlefs->mutex);
+    if (gil_released) {
+        MP_THREAD_GIL_ENTER();
+    }
+}
+
 
 typedef struct _mp_vfs_littlefs_ilistdir_it_t {
     mp_obj_base_t base;
@@ -411,9 +433,9 @@ STATIC mp_obj_t mp_vfs_littlefs_ilistdir_it_iternext(mp_obj_t self_in) {
     for (;;) {
         struct lfs_info fno;
 
-        xSemaphoreTake(self->littlefs->mutex, portMAX_DELAY);
+        LITTLEFS_IO_LOCK(self->littlefs);
             int res = lfs_dir_read(&self->littlefs->lfs, &self->dir, &fno);
-        xSemaphoreGive(self->littlefs->mutex);
+        LITTLEFS_IO_UNLOCK(self->littlefs);
 
         char *fn = fno.name;
         if (res < LFS_ERR_OK || fn[0] == 0) {
@@ -446,9 +468,9 @@ STATIC mp_obj_t mp_vfs_littlefs_ilistdir_it_iternext(mp_obj_t self_in) {
     }
 
     // ignore error because we may be closing a second time
-    xSemaphoreTake(self->littlefs->mutex, portMAX_DELAY);
+    LITTLEFS_IO_LOCK(self->littlefs);
         lfs_dir_close(&self->littlefs->lfs, &self->dir);
-    xSemaphoreGive(self->littlefs->mutex);
+    LITTLEFS_IO_UNLOCK(self->littlefs);
 
     return MP_OBJ_STOP_ITERATION;
 }
@@ -476,14 +498,14 @@ STATIC mp_obj_t littlefs_vfs_ilistdir_func(size_t n_args, const mp_obj_t *args)
     iter->iternext = mp_vfs_littlefs_ilistdir_it_iternext;
     iter->is_str = is_str_type;
 
-    xSemaphoreTake(self->fs.littlefs.mutex, portMAX_DELAY);
+    LITTLEFS_IO_LOCK(&self->fs.littlefs);
         const char *path = concat_with_cwd(&self->fs.littlefs, path_in);
         if (path == NULL) {
             res = LFS_ERR_NOMEM;
         } else {
             res = lfs_dir_open(&self->fs.littlefs.lfs, &iter->dir, path);
         }
-    xSemaphoreGive(self->fs.littlefs.mutex);
+    LITTLEFS_IO_UNLOCK(&self->fs.littlefs);
 
     free((void*)path);
 
@@ -501,7 +523,7 @@ STATIC mp_obj_t littlefs_vfs_mkdir(mp_obj_t vfs_in, mp_obj_t path_param) {
     fs_user_mount_t *self = MP_OBJ_TO_PTR(vfs_in);
     const char *path_in = mp_obj_str_get_str(path_param);
 
-    xSemaphoreTake(self->fs.littlefs.mutex, portMAX_DELAY);
+    LITTLEFS_IO_LOCK(&self->fs.littlefs);
         const char *path = concat_with_cwd(&self->fs.littlefs, path_in);
         if (path == NULL) {
             res = LFS_ERR_NOMEM;
@@ -511,7 +533,7 @@ STATIC mp_obj_t littlefs_vfs_mkdir(mp_obj_t vfs_in, mp_obj_t path_param) {
                 littlefs_update_timestamp(&self->fs.littlefs.lfs, path);
             }
         }
-    xSemaphoreGive(self->fs.littlefs.mutex);
+    LITTLEFS_IO_UNLOCK(&self->fs.littlefs);
 
     free((void*)path);
 
@@ -530,14 +552,14 @@ STATIC mp_obj_t littlefs_vfs_remove(mp_obj_t vfs_in, mp_obj_t path_param) {
     fs_user_mount_t *self = MP_OBJ_TO_PTR(vfs_in);
     const char *path_in = mp_obj_str_get_str(path_param);
 
-    xSemaphoreTake(self->fs.littlefs.mutex, portMAX_DELAY);
+    LITTLEFS_IO_LOCK(&self->fs.littlefs);
         const char *path = concat_with_cwd(&self->fs.littlefs, path_in);
         if (path == NULL) {
             res = LFS_ERR_NOMEM;
         } else {
             res = lfs_remove(&self->fs.littlefs.lfs, path);
         }
-    xSemaphoreGive(self->fs.littlefs.mutex);
+    LITTLEFS_IO_UNLOCK(&self->fs.littlefs);
 
     free((void*)path);
 
@@ -557,7 +579,7 @@ STATIC mp_obj_t littlefs_vfs_rename(mp_obj_t vfs_in, mp_obj_t path_param_in, mp_
     const char *path_in = mp_obj_str_get_str(path_param_in);
     const char *path_out = mp_obj_str_get_str(path_param_out);
 
-    xSemaphoreTake(self->fs.littlefs.mutex, portMAX_DELAY);
+    LITTLEFS_IO_LOCK(&self->fs.littlefs);
         const char *old_path = concat_with_cwd(&self->fs.littlefs, path_in);
         const char *new_path = concat_with_cwd(&self->fs.littlefs, path_out);
 
@@ -566,7 +588,7 @@ STATIC mp_obj_t littlefs_vfs_rename(mp_obj_t vfs_in, mp_obj_t path_param_in, mp_
         } else {
             res = lfs_rename(&self->fs.littlefs.lfs, old_path, new_path);
         }
-    xSemaphoreGive(self->fs.littlefs.mutex);
+    LITTLEFS_IO_UNLOCK(&self->fs.littlefs);
 
     free((void*)old_path);
     free((void*)new_path);
@@ -619,7 +641,7 @@ STATIC mp_obj_t littlefs_vfs_stat(mp_obj_t vfs_in, mp_obj_t path_param) {
     lfs_timestamp_attribute_t ts;
 
 
-    xSemaphoreTake(self->fs.littlefs.mutex, portMAX_DELAY);
+    LITTLEFS_IO_LOCK(&self->fs.littlefs);
         const char *path = concat_with_cwd(&self->fs.littlefs, path_in);
         if (path == NULL) {
             res = LFS_ERR_NOMEM;
@@ -631,7 +653,7 @@ STATIC mp_obj_t littlefs_vfs_stat(mp_obj_t vfs_in, mp_obj_t path_param) {
             res = littlefs_stat_common_helper(&self->fs.littlefs.lfs, path, &fno, &ts);
         }
 
-    xSemaphoreGive(self->fs.littlefs.mutex);
+    LITTLEFS_IO_UNLOCK(&self->fs.littlefs);
 
     free((void*)path);
 
@@ -687,9 +709,9 @@ STATIC mp_obj_t littlefs_vfs_statvfs(mp_obj_t vfs_in, mp_obj_t path_in) {
 
     mp_obj_tuple_t *t = MP_OBJ_TO_PTR(mp_obj_new_tuple(10, NULL));
 
-    xSemaphoreTake(self->fs.littlefs.mutex, portMAX_DELAY);
+    LITTLEFS_IO_LOCK(&self->fs.littlefs);
         lfs_ssize_t in_use = lfs_fs_size(lfs);
-    xSemaphoreGive(self->fs.littlefs.mutex);
+    LITTLEFS_IO_UNLOCK(&self->fs.littlefs);
 
     if (in_use < 0) {
         mp_raise_OSError(littleFsErrorToErrno(in_use));
@@ -717,9 +739,9 @@ STATIC mp_obj_t littlefs_vfs_getfree(mp_obj_t vfs_in) {
 
     lfs_t* lfs = &self->fs.littlefs.lfs;
 
-    xSemaphoreTake(self->fs.littlefs.mutex, portMAX_DELAY);
+    LITTLEFS_IO_LOCK(&self->fs.littlefs);
         lfs_ssize_t in_use = lfs_fs_size(lfs);
-    xSemaphoreGive(self->fs.littlefs.mutex);
+    LITTLEFS_IO_UNLOCK(&self->fs.littlefs);
 
     if (in_use < 0) {
         mp_raise_OSError(littleFsErrorToErrno(in_use));
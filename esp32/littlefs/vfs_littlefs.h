@@ -47,6 +47,13 @@ extern void littlefs_free_up_attributes(struct lfs_file_config *cfg);
 extern int littlefs_update_timestamp(lfs_t* lfs, const char* file_relative_path);
 extern void littlefs_update_timestamp_cfg(struct lfs_file_config *cfg);
 extern lfs_timestamp_attribute_t littlefs_get_timestamp_fp(lfs_file_t* fp);
+extern bool littlefs_io_lock(vfs_lfs_struct_t* littlefs);
+extern void littlefs_io_unlock(vfs_lfs_struct_t* littlefs, bool gil_released);
+
+// Takes the littlefs mutex around flash operations with the GIL released, the
+// region in between must not touch the MicroPython heap or raise
+#define LITTLEFS_IO_LOCK(littlefs)      bool littlefs_gil_released = littlefs_io_lock(littlefs)
+#define LITTLEFS_IO_UNLOCK(littlefs)    littlefs_io_unlock(littlefs, littlefs_gil_released)
 
 
 extern const mp_obj_type_t mp_littlefs_vfs_type;
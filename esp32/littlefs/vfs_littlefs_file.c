@@ -2,17 +2,44 @@
 //#if MICROPY_VFS && MICROPY_VFS_FAT
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "py/runtime.h"
 #include "py/stream.h"
 #include "py/mperrno.h"
+#include "py/gc.h"
 #include "lfs.h"
 #include "extmod/vfs.h"
 #include "vfs_littlefs.h"
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "pycom_config.h"
+
+#define LITTLEFS_WB_TASK_STACK_SIZE     (3 * 1024)
+#define LITTLEFS_WB_TASK_PRIORITY       (2)     // below the MicroPython task
+#define LITTLEFS_WB_QUEUE_SIZE          (8)
+#define LITTLEFS_WB_CHUNK_MAX           (1024)
+#define LITTLEFS_WB_WAIT_MS             (100)
+
 extern const mp_obj_type_t mp_type_vfs_lfs_fileio;
 extern const mp_obj_type_t mp_type_vfs_lfs_textio;
 
+struct _pyb_file_obj_t;
+
+// write-behind ring of a file, written by the MicroPython thread and committed to flash by the flush task
+typedef struct {
+    struct _pyb_file_obj_t *file;
+    uint8_t *buf;
+    size_t size;
+    size_t head;
+    volatile size_t count;
+    volatile bool queued;       // handed to the flush task, which owns the file until it clears this
+    volatile int error;         // errno of the first background write that failed
+    SemaphoreHandle_t progress; // given by the flush task every time it frees some space
+} littlefs_wb_t;
 
 typedef struct _pyb_file_obj_t {
     mp_obj_base_t base;
@@ -20,8 +47,127 @@ typedef struct _pyb_file_obj_t {
     vfs_lfs_struct_t* littlefs;
     struct lfs_file_config cfg;  // Attributes of the file, e.g.: timestamp
     bool timestamp_update;  // For requesting timestamp update when closing the file
+    littlefs_wb_t *wb;  // NULL unless writebehind() has been enabled
 } pyb_file_obj_t;
 
+static QueueHandle_t littlefs_wb_queue;
+static portMUX_TYPE littlefs_wb_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void TASK_LittlefsWriteBehind(void *pvParameters) {
+    littlefs_wb_t *wb;
+
+    for (;;) {
+        xQueueReceive(littlefs_wb_queue, &wb, portMAX_DELAY);
+        pyb_file_obj_t *self = wb->file;
+
+        for (;;) {
+            portENTER_CRITICAL(&littlefs_wb_mux);
+            size_t count = wb->count;
+            if (count == 0 || wb->error) {
+                // new writes will queue the file again from now on, and it may be closed and freed right away
+                wb->queued = false;
+            }
+            portEXIT_CRITICAL(&littlefs_wb_mux);
+            if (count == 0 || wb->error) {
+                break;
+            }
+
+            // the data before the wrap point, in pieces so the writer gets space back early
+            size_t chunk = MIN(MIN(count, wb->size - wb->head), LITTLEFS_WB_CHUNK_MAX);
+            xSemaphoreTake(self->littlefs->mutex, portMAX_DELAY);
+                lfs_ssize_t sz_out = lfs_file_write(&self->littlefs->lfs, &self->fp, &wb->buf[wb->head], chunk);
+            xSemaphoreGive(self->littlefs->mutex);
+
+            if (sz_out != chunk) {
+                wb->error = (sz_out < 0) ? littleFsErrorToErrno(sz_out) : MP_ENOSPC;
+            } else {
+                self->timestamp_update = true;
+            }
+            portENTER_CRITICAL(&littlefs_wb_mux);
+            wb->head = (wb->head + chunk) % wb->size;
+            wb->count -= chunk;
+            portEXIT_CRITICAL(&littlefs_wb_mux);
+            xSemaphoreGive(wb->progress);
+        }
+    }
+}
+
+STATIC void littlefs_wb_wait(littlefs_wb_t *wb, TickType_t ticks) {
+    if (gc_is_locked()) {
+        // closed by the finaliser, no other thread may run in the middle of a collection
+        vTaskDelay(1);
+    } else {
+        MP_THREAD_GIL_EXIT();
+        xSemaphoreTake(wb->progress, ticks);
+        MP_THREAD_GIL_ENTER();
+    }
+}
+
+// waits until the flush task is done with the file, the GIL is released meanwhile
+STATIC int littlefs_wb_drain(pyb_file_obj_t *self) {
+    littlefs_wb_t *wb = self->wb;
+    if (wb) {
+        while (wb->queued) {
+            // the flush task doesn't signal once it lets go of the file, so poll for that
+            littlefs_wb_wait(wb, 1);
+        }
+        if (wb->error) {
+            int error = wb->error;
+            // report it once, then start over with an empty ring
+            wb->error = 0;
+            wb->count = 0;
+            wb->head = 0;
+            return error;
+        }
+    }
+    return 0;
+}
+
+STATIC void littlefs_wb_free(pyb_file_obj_t *self) {
+    if (self->wb) {
+        vSemaphoreDelete(self->wb->progress);
+        free(self->wb->buf);
+        free(self->wb);
+        self->wb = NULL;
+    }
+}
+
+STATIC mp_uint_t littlefs_wb_write(pyb_file_obj_t *self, const uint8_t *buf, mp_uint_t size, int *errcode) {
+    littlefs_wb_t *wb = self->wb;
+    mp_uint_t written = 0;
+
+    while (written < size) {
+        if (wb->error) {
+            *errcode = littlefs_wb_drain(self);
+            return MP_STREAM_ERROR;
+        }
+
+        portENTER_CRITICAL(&littlefs_wb_mux);
+        size_t count = wb->count;
+        size_t tail = (wb->head + count) % wb->size;
+        portEXIT_CRITICAL(&littlefs_wb_mux);
+
+        size_t n = MIN(size - written, MIN(wb->size - count, wb->size - tail));
+        if (n == 0) {
+            // the ring is full, wait for the flush task to catch up
+            littlefs_wb_wait(wb, LITTLEFS_WB_WAIT_MS / portTICK_PERIOD_MS);
+            continue;
+        }
+        memcpy(&wb->buf[tail], &buf[written], n);
+        written += n;
+
+        portENTER_CRITICAL(&littlefs_wb_mux);
+        wb->count += n;
+        bool queue = !wb->queued;
+        wb->queued = true;
+        portEXIT_CRITICAL(&littlefs_wb_mux);
+        if (queue) {
+            xQueueSend(littlefs_wb_queue, &wb, portMAX_DELAY);
+        }
+    }
+    return written;
+}
+
 STATIC void file_obj_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
     (void)kind;
     mp_printf(print, "<io.%s %p>", mp_obj_get_type_str(self_in), MP_OBJ_TO_PTR(self_in));
@@ -31,9 +177,13 @@ STATIC mp_uint_t file_obj_read(mp_obj_t self_in, void *buf, mp_uint_t size, int
 
     pyb_file_obj_t *self = MP_OBJ_TO_PTR(self_in);
 
-    xSemaphoreTake(self->littlefs->mutex, portMAX_DELAY);
+    if ((*errcode = littlefs_wb_drain(self)) != 0) {
+        return MP_STREAM_ERROR;
+    }
+
+    LITTLEFS_IO_LOCK(self->littlefs);
         lfs_ssize_t sz_out = lfs_file_read(&self->littlefs->lfs ,&self->fp, buf, size);
-    xSemaphoreGive(self->littlefs->mutex);
+    LITTLEFS_IO_UNLOCK(self->littlefs);
 
     if (sz_out < 0) {
         *errcode = littleFsErrorToErrno(sz_out);
@@ -46,13 +196,17 @@ STATIC mp_uint_t file_obj_write(mp_obj_t self_in, const void *buf, mp_uint_t siz
 
     pyb_file_obj_t *self = MP_OBJ_TO_PTR(self_in);
 
-    xSemaphoreTake(self->littlefs->mutex, portMAX_DELAY);
+    if (self->wb) {
+        return littlefs_wb_write(self, buf, size, errcode);
+    }
+
+    LITTLEFS_IO_LOCK(self->littlefs);
         lfs_ssize_t sz_out = lfs_file_write(&self->littlefs->lfs, &self->fp, buf, size);
         // Request timestamp update if file has been written successfully
         if(sz_out > 0) {
             self->timestamp_update = true;
         }
-    xSemaphoreGive(self->littlefs->mutex);
+    LITTLEFS_IO_UNLOCK(self->littlefs);
 
     if (sz_out < 0) {
         *errcode = littleFsErrorToErrno(sz_out);
@@ -76,22 +230,29 @@ STATIC mp_uint_t file_obj_ioctl(mp_obj_t o_in, mp_uint_t request, uintptr_t arg,
 
     pyb_file_obj_t *self = MP_OBJ_TO_PTR(o_in);
 
+    // everything below needs the queued data to be in the file first
+    int wb_error = littlefs_wb_drain(self);
+    if (wb_error && request != MP_STREAM_CLOSE) {
+        *errcode = wb_error;
+        return MP_STREAM_ERROR;
+    }
+
     if (request == MP_STREAM_SEEK) {
 
         struct mp_stream_seek_t *s = (struct mp_stream_seek_t*)(uintptr_t)arg;
 
-        xSemaphoreTake(self->littlefs->mutex, portMAX_DELAY);
+        LITTLEFS_IO_LOCK(self->littlefs);
             lfs_file_seek(&self->littlefs->lfs, &self->fp, s->offset, s->whence);
             s->offset = lfs_file_tell(&self->littlefs->lfs, &self->fp);
-        xSemaphoreGive(self->littlefs->mutex);
+        LITTLEFS_IO_UNLOCK(self->littlefs);
 
         return 0;
 
     } else if (request == MP_STREAM_FLUSH) {
 
-        xSemaphoreTake(self->littlefs->mutex, portMAX_DELAY);
+        LITTLEFS_IO_LOCK(self->littlefs);
             int res = lfs_file_sync(&self->littlefs->lfs, &self->fp);
-        xSemaphoreGive(self->littlefs->mutex);
+        LITTLEFS_IO_UNLOCK(self->littlefs);
 
         if (res < 0) {
             *errcode = littleFsErrorToErrno(res);
@@ -101,13 +262,19 @@ STATIC mp_uint_t file_obj_ioctl(mp_obj_t o_in, mp_uint_t request, uintptr_t arg,
 
     } else if (request == MP_STREAM_CLOSE) {
 
-        xSemaphoreTake(self->littlefs->mutex, portMAX_DELAY);
+        littlefs_wb_free(self);
+        LITTLEFS_IO_LOCK(self->littlefs);
             int res = littlefs_close_common_helper(&self->littlefs->lfs, &self->fp, &self->cfg, &self->timestamp_update);
-        xSemaphoreGive(self->littlefs->mutex);
+        LITTLEFS_IO_UNLOCK(self->littlefs);
         if (res < 0) {
             *errcode = littleFsErrorToErrno(res);
             return MP_STREAM_ERROR;
         }
+        if (wb_error) {
+            // data that never made it to the file
+            *errcode = wb_error;
+            return MP_STREAM_ERROR;
+        }
         // Free up the object so GC does not need to do that
         m_del_obj(pyb_file_obj_t, self);
 
@@ -165,11 +332,12 @@ STATIC mp_obj_t file_open(fs_user_mount_t *vfs, const mp_obj_type_t *type, mp_ar
     pyb_file_obj_t *o = m_new_obj_with_finaliser(pyb_file_obj_t);
     o->base.type = type;
     o->timestamp_update = false;
+    o->wb = NULL;
 
-    xSemaphoreTake(vfs->fs.littlefs.mutex, portMAX_DELAY);
+    LITTLEFS_IO_LOCK(&vfs->fs.littlefs);
         const char *fname = concat_with_cwd(&vfs->fs.littlefs, mp_obj_str_get_str(args[0].u_obj));
         int res = littlefs_open_common_helper(&vfs->fs.littlefs.lfs, fname, &o->fp, mode, &o->cfg, &o->timestamp_update);
-    xSemaphoreGive(vfs->fs.littlefs.mutex);
+    LITTLEFS_IO_UNLOCK(&vfs->fs.littlefs);
 
     free((void*)fname);
     if (res < LFS_ERR_OK) {
@@ -190,6 +358,60 @@ STATIC mp_obj_t file_obj_make_new(const mp_obj_type_t *type, size_t n_args, size
 
 // TODO gc hook to close the file if not already closed
 
+/// \method writebehind(size)
+/// queues writes in a RAM ring of size bytes committed to flash by a background task,
+/// flush() and close() wait for them to land. A size of 0 goes back to synchronous writes.
+STATIC mp_obj_t file_obj_writebehind(mp_obj_t self_in, mp_obj_t size_in) {
+    pyb_file_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_int_t size = mp_obj_get_int(size_in);
+
+    if (size < 0) {
+        mp_raise_ValueError(NULL);
+    }
+
+    int error = littlefs_wb_drain(self);
+    littlefs_wb_free(self);
+    if (error) {
+        mp_raise_OSError(error);
+    }
+    if (size == 0) {
+        return mp_const_none;
+    }
+
+    if (!littlefs_wb_queue) {
+        littlefs_wb_queue = xQueueCreate(LITTLEFS_WB_QUEUE_SIZE, sizeof(littlefs_wb_t *));
+        if (!littlefs_wb_queue) {
+            mp_raise_OSError(MP_ENOMEM);
+        }
+        if (pdPASS != xTaskCreatePinnedToCore(TASK_LittlefsWriteBehind, "LfsWB", LITTLEFS_WB_TASK_STACK_SIZE / sizeof(StackType_t),
+                                              NULL, LITTLEFS_WB_TASK_PRIORITY, NULL, config_get_service_core())) {
+            vQueueDelete(littlefs_wb_queue);
+            littlefs_wb_queue = NULL;
+            mp_raise_OSError(MP_ENOMEM);
+        }
+    }
+
+    littlefs_wb_t *wb = calloc(1, sizeof(littlefs_wb_t));
+    uint8_t *buf = malloc(size);
+    SemaphoreHandle_t progress = xSemaphoreCreateBinary();
+    if (!wb || !buf || !progress) {
+        free(wb);
+        free(buf);
+        if (progress) {
+            vSemaphoreDelete(progress);
+        }
+        mp_raise_msg(&mp_type_MemoryError, "cannot allocate the write-behind buffer");
+    }
+    wb->file = self;
+    wb->buf = buf;
+    wb->size = size;
+    wb->progress = progress;
+    self->wb = wb;
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(file_obj_writebehind_obj, file_obj_writebehind);
+
 STATIC const mp_rom_map_elem_t rawfile_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_read), MP_ROM_PTR(&mp_stream_read_obj) },
     { MP_ROM_QSTR(MP_QSTR_readinto), MP_ROM_PTR(&mp_stream_readinto_obj) },
@@ -200,6 +422,7 @@ STATIC const mp_rom_map_elem_t rawfile_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_close), MP_ROM_PTR(&mp_stream_close_obj) },
     { MP_ROM_QSTR(MP_QSTR_seek), MP_ROM_PTR(&mp_stream_seek_obj) },
     { MP_ROM_QSTR(MP_QSTR_tell), MP_ROM_PTR(&mp_stream_tell_obj) },
+    { MP_ROM_QSTR(MP_QSTR_writebehind), MP_ROM_PTR(&file_obj_writebehind_obj) },
     { MP_ROM_QSTR(MP_QSTR___del__), MP_ROM_PTR(&mp_stream_close_obj) },
     { MP_ROM_QSTR(MP_QSTR___enter__), MP_ROM_PTR(&mp_identity_obj) },
     { MP_ROM_QSTR(MP_QSTR___exit__), MP_ROM_PTR(&file_obj___exit___obj) },
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "lora/system/crypto/aes.h"
+
+#if defined( LORA_HW_AES )
+
+/******************************************************************************
+ DESCRIPTION
+ The LoRaMAC MIC, payload and join crypto only needs single block AES-128
+ encryption with a prekeyed context (CMAC is built on top of it). Route it
+ through the hardware AES engine instead of the software implementation.
+ esp_aes_crypt_ecb() takes the hardware lock by itself, so this is safe to
+ share with mbedtls and the crypto module.
+ ******************************************************************************/
+
+return_type aes_set_key_lora( const uint8_t key[], length_type keylen, aes_context ctx[1] )
+{
+    esp_aes_init(ctx);
+    if (esp_aes_setkey(ctx, key, keylen * 8) != 0) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+return_type aes_encrypt_lora( const uint8_t in[N_BLOCK], uint8_t out[N_BLOCK], const aes_context ctx[1] )
+{
+    if (esp_aes_crypt_ecb((aes_context *)ctx, ESP_AES_ENCRYPT, in, out) != 0) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+return_type aes_cbc_encrypt_lora( const uint8_t *in, uint8_t *out,
+                                  int32_t n_block, uint8_t iv[N_BLOCK], const aes_context ctx[1] )
+{
+    if (n_block <= 0) {
+        return EXIT_SUCCESS;
+    }
+    if (esp_aes_crypt_cbc((aes_context *)ctx, ESP_AES_ENCRYPT, n_block * N_BLOCK, iv, in, out) != 0) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+#endif // LORA_HW_AES
@@ -74,7 +74,9 @@ void BoardDeInitMcu( void )
 
 uint32_t BoardGetRandomSeed( void )
 {
-    return rng_get();
+    uint32_t seed;
+    rng_fill( &seed, sizeof( seed ) );
+    return seed;
 }
 
 void BoardGetUniqueId( uint8_t *id )
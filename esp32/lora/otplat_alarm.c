@@ -18,6 +18,7 @@
 #include "esp32_mphal.h"
 #include "random.h"
 #include "../lib/lora/system/timer.h"
+#include "mods/modmesh.h"
 #include <openthread/platform/alarm-milli.h>
 #include <openthread/instance.h>
 #include <openthread/ip6.h>
@@ -42,6 +43,9 @@ void alarmCallback(void) {
         else
 #endif
         otPlatAlarmMilliFired(otPtr);
+
+        // let the Mesh task run the timers that just expired
+        mesh_task_notify();
     }
 }
 
@@ -114,7 +118,9 @@ void otPlatAlarmMilliStop(otInstance *aInstance) {
  *
  */
 uint32_t otPlatRandomGet(void) {
-    return rng_get();
+    uint32_t value;
+    rng_fill(&value, sizeof(value));
+    return value;
 }
 
 /**
@@ -12,6 +12,7 @@
 
 #include "pycom_config.h"
 #include "mods/modlora.h"
+#include "mods/modmesh.h"
 
 #include <openthread/platform/radio.h>
 #include <openthread-core-config.h>
@@ -96,11 +97,11 @@ static int8_t txPower = 14; //dBm
 /******************************************************************************
  DECLARE PRIVATE FUNCTIONS
  ******************************************************************************/
-static void radioTransmit(const struct otRadioFrame *pkt);
+static void radioTransmit(const struct otRadioFrame *pkt, bool isAck);
 static void radioSendMessage(otInstance *aInstance);
 static void radioSendAck(void);
 static void radioProcessFrame(otInstance *aInstance);
-void radioReceive(otInstance *aInstance);
+bool radioReceive(otInstance *aInstance);
 
 static bool findShortAddress(uint16_t aShortAddress);
 static bool findExtAddress(const otExtAddress *aExtAddress);
@@ -538,6 +539,9 @@ otError otPlatRadioTransmit(otInstance *aInstance, otRadioFrame *aFrame) {
     if (sState == OT_RADIO_STATE_RECEIVE) {
         error = OT_ERROR_NONE;
         sState = OT_RADIO_STATE_TRANSMIT;
+
+        // the frame is sent by otRadioProcess() in the Mesh task
+        mesh_task_notify();
     }
 
     otPlatLog(OT_LOG_LEVEL_DEBG, 0, "otTx s=%d, l=%d, ch=%d", sState,
@@ -598,7 +602,8 @@ int8_t otPlatRadioGetRssi(otInstance *aInstance) {
 otRadioCaps otPlatRadioGetCaps(otInstance *aInstance) {
     (void) aInstance;
 
-    otRadioCaps caps = OT_RADIO_CAPS_NONE;
+    // the LoRa task does the CSMA/CA backoffs, with CAD as the clear channel assessment
+    otRadioCaps caps = OT_RADIO_CAPS_CSMA_BACKOFF;
 //    OT_RADIO_CAPS_NONE             = 0, ///< None
 //    OT_RADIO_CAPS_ACK_TIMEOUT      = 1, ///< Radio supports AckTime event
 //    OT_RADIO_CAPS_ENERGY_SCAN      = 2, ///< Radio supports Energy Scans
@@ -749,7 +754,8 @@ int8_t otPlatRadioGetReceiveSensitivity(otInstance *aInstance) {
 void otRadioProcess(otInstance *aInstance) {
     if (sState != OT_RADIO_STATE_DISABLED) {
 
-        radioReceive(aInstance);
+        // hand over all the frames queued since the last pass
+        while (radioReceive(aInstance));
 
         if (sState == OT_RADIO_STATE_TRANSMIT && !sAckWait) {
             radioSendMessage(aInstance);
@@ -919,12 +925,12 @@ static inline void getExtAddress(const uint8_t *frame, otExtAddress *address) {
     }
 }
 
-void radioReceive(otInstance *aInstance) {
+bool radioReceive(otInstance *aInstance) {
     bool    isAck;
     ssize_t rval = lora_ot_recv(sReceiveFrame.mPsdu,
             &(sReceiveFrame.mInfo.mRxInfo.mRssi));
     if (rval <= 0)
-        return;
+        return false;
 
     if (otPlatRadioGetPromiscuous(aInstance)) {
         // Timestamp
@@ -954,7 +960,7 @@ void radioReceive(otInstance *aInstance) {
             && (!isAck || sPromiscuous)) {
         radioProcessFrame(aInstance);
     }
-
+    return true;
 }
 
 void radioSendMessage(otInstance *aInstance) {
@@ -989,7 +995,7 @@ void radioSendMessage(otInstance *aInstance) {
     //sTransmitMessage.mChannel = sTransmitFrame.mChannel;
 
     otPlatRadioTxStarted(aInstance, &sTransmitFrame);
-    radioTransmit(&sTransmitFrame);
+    radioTransmit(&sTransmitFrame, false);
 
     sAckWait = isAckRequested(sTransmitFrame.mPsdu);
 
@@ -1013,8 +1019,8 @@ void radioSendMessage(otInstance *aInstance) {
 }
 
 //void radioTransmit(struct RadioMessage *aMessage, const struct otRadioFrame *aFrame)
-void radioTransmit(const struct otRadioFrame *aFrame) {
-    lora_ot_send(aFrame->mPsdu, aFrame->mLength);
+void radioTransmit(const struct otRadioFrame *aFrame, bool isAck) {
+    lora_ot_send(aFrame->mPsdu, aFrame->mLength, isAck);
 }
 
 void radioSendAck(void) {
@@ -1030,7 +1036,7 @@ void radioSendAck(void) {
 
     sAckFrame.mChannel = sReceiveFrame.mChannel;
 
-    radioTransmit(&sAckFrame);
+    radioTransmit(&sAckFrame, true);
 }
 
 void radioProcessFrame(otInstance *aInstance) {
@@ -52,6 +52,8 @@ Maintainer: Miguel Luis and Gregory Cristian
 
 #define SPIDEV      SpiNum_SPI3
 
+#define SPI_BURST_MAX_BYTES         64      // W0-W15 data registers
+
 /*!
  * \brief Initializes the SPI object and MCU peripheral
  *
@@ -179,6 +181,68 @@ IRAM_ATTR uint16_t SpiInOut(Spi_t *obj, uint16_t outData) {
     // read data out
     return READ_PERI_REG(SPI_W0_REG(spiNum));
 }
+
+/*!
+ * \brief Sends the address byte followed by size bytes of outBuffer and
+ *        stores the bytes received after the address in inBuffer, using
+ *        the 64-byte data buffer of the SPI peripheral so that each
+ *        transaction carries up to 64 bytes instead of a single one
+ *
+ * \param [IN]  obj       SPI object
+ * \param [IN]  addr      Address byte sent first
+ * \param [IN]  outBuffer Bytes to be sent (zeros are sent if NULL)
+ * \param [OUT] inBuffer  Received bytes (discarded if NULL)
+ * \param [IN]  size      Number of data bytes
+ */
+IRAM_ATTR void SpiBurst(Spi_t *obj, uint8_t addr, const uint8_t *outBuffer, uint8_t *inBuffer, uint16_t size) {
+    uint32_t spiNum = (uint32_t)obj->Spi;
+    uint32_t lead = 1;      // the address byte goes first in the first transaction
+
+    do {
+        uint32_t len = size + lead;
+        if (len > SPI_BURST_MAX_BYTES) {
+            len = SPI_BURST_MAX_BYTES;
+        }
+        uint32_t ndata = len - lead;
+
+        // load the send buffer, the data registers only accept 32-bit writes
+        for (uint32_t i = 0; i < len; i += 4) {
+            uint32_t word = 0;
+            for (uint32_t j = i; j < i + 4 && j < len; j++) {
+                uint32_t b = (j < lead) ? addr : (outBuffer ? outBuffer[j - lead] : 0);
+                word |= b << ((j - i) << 3);
+            }
+            WRITE_PERI_REG(SPI_W0_REG(spiNum) + i, word);
+        }
+
+        // set the data buffer length and start the transaction
+        SET_PERI_REG_BITS(SPI_MOSI_DLEN_REG(spiNum), SPI_USR_MOSI_DBITLEN, (len << 3) - 1, SPI_USR_MOSI_DBITLEN_S);
+        SET_PERI_REG_BITS(SPI_MISO_DLEN_REG(spiNum), SPI_USR_MISO_DBITLEN, (len << 3) - 1, SPI_USR_MISO_DBITLEN_S);
+        SET_PERI_REG_MASK(SPI_CMD_REG(spiNum), SPI_USR);
+        while (READ_PERI_REG(SPI_CMD_REG(spiNum)) & SPI_USR);
+
+        // read data out
+        if (inBuffer) {
+            uint32_t word = 0;
+            for (uint32_t j = lead; j < len; j++) {
+                if (j == lead || (j & 3) == 0) {
+                    word = READ_PERI_REG(SPI_W0_REG(spiNum) + (j & ~3));
+                }
+                inBuffer[j - lead] = word >> ((j & 3) << 3);
+            }
+            inBuffer += ndata;
+        }
+        if (outBuffer) {
+            outBuffer += ndata;
+        }
+        size -= ndata;
+        lead = 0;
+    } while (size > 0);
+
+    // back to single byte transactions for SpiInOut()
+    SET_PERI_REG_BITS(SPI_MOSI_DLEN_REG(spiNum), SPI_USR_MOSI_DBITLEN, 7, SPI_USR_MOSI_DBITLEN_S);
+    SET_PERI_REG_BITS(SPI_MISO_DLEN_REG(spiNum), SPI_USR_MISO_DBITLEN, 7, SPI_USR_MISO_DBITLEN_S);
+}
 #elif defined(SIPY)
 IRAM_ATTR uint8_t SpiInOut(uint32_t spiNum, uint32_t outData) {
     // set data send buffer length (1 byte)
@@ -50,7 +50,9 @@ DRAM_ATTR const struct Radio_s Radio =
     SX1276WriteBuffer,
     SX1276ReadBuffer,
     SX1276SetMaxPayloadLength,
-    SX1276SetPublicNetwork
+    SX1276SetPublicNetwork,
+    SX1276Reset,
+    SX1276Restore
 };
 
 /*!
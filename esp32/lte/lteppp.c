@@ -7,13 +7,17 @@
  * available at https://www.pycom.io/opensource/licensing
  */
 
+#include <stddef.h>
 #include <string.h>
+#include <sys/param.h>
 #include "py/mpconfig.h"
 #include "py/obj.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_system.h"
 #include "esp_log.h"
+#include "esp_attr.h"
+#include "rom/crc.h"
 
 #include "driver/uart.h"
 #include "driver/gpio.h"
@@ -30,6 +34,10 @@
 #include "lwip/dns.h"
 #include "modlte.h"
 #include "str_utils.h"
+#include "pycom_config.h"
+#include "tracering.h"
+#include "taskwdt.h"
+#include "pwrmgr.h"
 
 /******************************************************************************
  DEFINE CONSTANTS
@@ -38,6 +46,7 @@
 #define LTE_TRX_WAIT_MS(len)                                    (((len + 1) * 12 * 1000) / MICROPY_LTE_UART_BAUDRATE)
 #define LTE_TASK_PERIOD_MS                                      (2)
 #define LTE_AT_CMD_TRIALS                                       (5)
+#define LTE_RTC_SESSION_MAGIC                                   (0x4C544553)    // "LTES"
 
 /******************************************************************************
  DEFINE TYPES
@@ -48,6 +57,20 @@ typedef enum
     LTE_PPP_RESUMED,
     LTE_PPP_SUSPENDED
 }ltepppconnstatus_t;
+
+// the data session parked by LTE.deinit(detach=False), kept in RTC slow memory
+// so that the wake from deep sleep can skip the modem start-up and attach
+typedef struct {
+    uint32_t    magic;
+    uint32_t    crc;                // over everything that follows
+    uint32_t    cid;
+    uint32_t    ipv4addr;
+    uint32_t    gw;
+    uint32_t    netmask;
+    ip_addr_t   dns[2];
+    uint8_t     legacy;
+    uint8_t     legacyattach;
+} lteppp_rtc_session_t;
 /******************************************************************************
  DECLARE EXPORTED DATA
  ******************************************************************************/
@@ -73,12 +96,19 @@ static lte_log_t lteppp_log;
 #endif
 
 static char lteppp_queue_buffer[LTE_UART_BUFFER_SIZE];
+// PPP data is read by the UART event task, outside of the AT command buffer
+static uint8_t lteppp_rx_buffer[LTE_UART_RX_CHUNK_SIZE];
 static uart_dev_t* lteppp_uart_reg;
 static QueueHandle_t xCmdQueue = NULL;
 static QueueHandle_t xRxQueue = NULL;
 static lte_state_t lteppp_lte_state;
 static lte_legacy_t lteppp_lte_legacy;
 static SemaphoreHandle_t xLTESem;
+static SemaphoreHandle_t xLTERxSem;     // held while an AT command waits for its reply
+static lte_async_rsp_t *lteppp_async_rsp_list;  // replies to tagged commands, oldest first
+static char lteppp_urc_buffer[LTE_URC_BUFFER_SIZE + 1];
+static bool lteppp_registered = false;
+static uint8_t lteppp_socket_rings;     // modem sockets with data announced by +SQNSRING, bit n for connId n + 1
 static ppp_pcb *lteppp_pcb;         // PPP control block
 struct netif lteppp_netif;          // PPP net interface
 
@@ -99,6 +129,9 @@ static QueueHandle_t uart0_queue = NULL;
 
 static bool lte_uart_break_evt = false;
 
+static RTC_DATA_ATTR lteppp_rtc_session_t lteppp_rtc_session;
+static uint32_t lteppp_ipcp_ouraddr;    // address of the resumed session, asked for by the next connect
+
 /******************************************************************************
  DECLARE PRIVATE FUNCTIONS
  ******************************************************************************/
@@ -109,6 +142,13 @@ static bool lteppp_send_at_cmd(const char *cmd, uint32_t timeout);
 static bool lteppp_check_sim_present(void);
 static void lteppp_status_cb (ppp_pcb *pcb, int err_code, void *ctx);
 static uint32_t lteppp_output_callback(ppp_pcb *pcb, u8_t *data, u32_t len, void *ctx);
+static void lteppp_ppp_input (void);
+static bool lteppp_read_at_rsp (const char *expected_rsp, uint32_t timeout, bool from_mp, void* data_rem);
+static void lteppp_store_async_rsp (uint32_t tag, uint32_t timeout);
+static void lteppp_read_urcs (void);
+static void lteppp_dispatch_urcs (const char *buf);
+static uint32_t lteppp_rtc_session_crc (void);
+static bool lteppp_rtc_session_resumable (void);
 #ifdef LTEPPP_DEBUG
 static void lteppp_print_states();
 #endif
@@ -142,7 +182,8 @@ void connect_lte_uart (void) {
     uart_set_hw_flow_ctrl(LTE_UART_ID, UART_HW_FLOWCTRL_DISABLE, 0);
 
     // install the UART driver
-    uart_driver_install(LTE_UART_ID, LTE_UART_BUFFER_SIZE, LTE_UART_BUFFER_SIZE, 1, &uart0_queue, 0, NULL);
+    // PPP frames are only copied into the TX ring buffer, which the TX interrupt drains
+    uart_driver_install(LTE_UART_ID, LTE_UART_BUFFER_SIZE, LTE_UART_TX_BUFFER_SIZE, 8, &uart0_queue, 0, NULL);
     lteppp_uart_reg = &UART2;
 
     // disable the delay between transfers
@@ -153,7 +194,7 @@ void connect_lte_uart (void) {
 
     uart_set_rts(LTE_UART_ID, false);
 
-    xTaskCreatePinnedToCore(TASK_UART_EVT, "LTE_UART_EVT", 2048 / sizeof(StackType_t), NULL, 12, &xLTEUartEvtTaskHndl, 1);
+    xTaskCreatePinnedToCore(TASK_UART_EVT, "LTE_UART_EVT", 2048 / sizeof(StackType_t), NULL, 12, &xLTEUartEvtTaskHndl, config_get_service_core());
 
     MSG("done\n");
 }
@@ -169,6 +210,7 @@ void lteppp_init(void) {
         xRxQueue = xQueueCreate(LTE_RSP_QUEUE_SIZE_MAX, LTE_AT_RSP_SIZE_MAX + 1);
 
         xLTESem = xSemaphoreCreateMutex();
+        xLTERxSem = xSemaphoreCreateMutex();
         xLTE_modem_Conn_Sem = xSemaphoreCreateMutex();
 
         lteppp_pcb = pppapi_pppos_create(&lteppp_netif, lteppp_output_callback, lteppp_status_cb, NULL);
@@ -176,7 +218,7 @@ void lteppp_init(void) {
         //wait on connecting modem until it is allowed
         lteppp_set_modem_conn_state(E_LTE_MODEM_DISCONNECTED);
 
-        xTaskCreatePinnedToCore(TASK_LTE, "LTE", LTE_TASK_STACK_SIZE / sizeof(StackType_t), NULL, LTE_TASK_PRIORITY, &xLTETaskHndl, 1);
+        xTaskCreatePinnedToCore(TASK_LTE, "LTE", LTE_TASK_STACK_SIZE / sizeof(StackType_t), NULL, LTE_TASK_PRIORITY, &xLTETaskHndl, config_get_service_core());
 
         lteppp_connstatus = LTE_PPP_IDLE;
 #ifdef LTE_DEBUG_BUFF
@@ -229,6 +271,8 @@ void lteppp_set_modem_conn_state(lte_modem_conn_state_t state)
     xSemaphoreTake(xLTESem, portMAX_DELAY);
     lteppp_modem_conn_state = state;
     xSemaphoreGive(xLTESem);
+    // the UART loses what the modem sends while the chip sleeps
+    pwrmgr_hold(PWRMGR_LTE, state != E_LTE_MODEM_DISCONNECTED);
 }
 
 void lteppp_set_state(lte_state_t state) {
@@ -258,6 +302,12 @@ void lteppp_connect (void) {
     pppapi_set_default(lteppp_pcb);
     ppp_set_usepeerdns(lteppp_pcb, 1);
     pppapi_set_auth(lteppp_pcb, PPPAUTHTYPE_PAP, "", "");
+#if PPP_IPV4_SUPPORT
+    // ask for the address of the resumed session, IPCP then settles in one round
+    ip4_addr_t ouraddr = { .addr = lteppp_ipcp_ouraddr };
+    ppp_set_ipcp_ouraddr(lteppp_pcb, &ouraddr);
+    lteppp_ipcp_ouraddr = 0;
+#endif
     pppapi_connect(lteppp_pcb, 0);
     lteppp_connstatus = LTE_PPP_IDLE;
     MSG("done\n");
@@ -278,7 +328,40 @@ void lteppp_send_at_command (lte_task_cmd_data_t *cmd, lte_task_rsp_data_t *rsp)
         xQueueReceive(xRxQueue, rsp, (TickType_t)portMAX_DELAY);
 }
 
+bool lteppp_send_at_command_async (lte_task_cmd_data_t *cmd) {
+    // the reply is collected later with lteppp_take_async_rsp()
+    return xQueueSend(xCmdQueue, (void *)cmd, 0) == pdTRUE;
+}
+
+lte_async_rsp_t *lteppp_take_async_rsp (uint32_t tag) {
+    lte_async_rsp_t *rsp;
+    lte_async_rsp_t **prev = &lteppp_async_rsp_list;
+
+    xSemaphoreTake(xLTESem, portMAX_DELAY);
+    for (rsp = lteppp_async_rsp_list; rsp != NULL; prev = &rsp->next, rsp = rsp->next) {
+        if (rsp->tag == tag) {
+            *prev = rsp->next;
+            break;
+        }
+    }
+    xSemaphoreGive(xLTESem);
+    // the caller owns (and has to free) the reply now
+    return rsp;
+}
+
 bool lteppp_wait_at_rsp (const char *expected_rsp, uint32_t timeout, bool from_mp, void* data_rem) {
+    // TASK_LTE already holds the lock while it handles a command
+    if (from_mp) {
+        xSemaphoreTake(xLTERxSem, portMAX_DELAY);
+    }
+    bool ret = lteppp_read_at_rsp(expected_rsp, timeout, from_mp, data_rem);
+    if (from_mp) {
+        xSemaphoreGive(xLTERxSem);
+    }
+    return ret;
+}
+
+static bool lteppp_read_at_rsp (const char *expected_rsp, uint32_t timeout, bool from_mp, void* data_rem) {
 
     uint32_t rx_len = 0;
     uint32_t timeout_cnt = timeout;
@@ -352,7 +435,9 @@ bool lteppp_wait_at_rsp (const char *expected_rsp, uint32_t timeout, bool from_m
             else if(rx_len == 0)
             {
                 uint8_t timeout_buff = 10;
+                // "> " is the prompt for the data of a command, nothing else follows it
                 while((!strstr(lteppp_trx_buffer,"\r\nOK\r\n")) && (!strstr(lteppp_trx_buffer,"\r\nERROR\r\n")) && (!strstr(lteppp_trx_buffer,"+SYSSTART")) && (!strstr(lteppp_trx_buffer,"\r\nCONNECT\r\n")) &&
+                        (!strstr(lteppp_trx_buffer,"\r\n> ")) &&
                         rx_len == 0 && timeout_buff > 0)
                 {
 #ifdef LTE_DEBUG_BUFF
@@ -419,6 +504,7 @@ void lteppp_deinit (void) {
     lteppp_lte_state = E_LTE_INIT;
     lteppp_modem_conn_state = E_LTE_MODEM_DISCONNECTED;
 	xSemaphoreGive(xLTESem);
+    pwrmgr_hold(PWRMGR_LTE, false);
     MSG("done\n");
 }
 
@@ -441,9 +527,65 @@ void lteppp_resume(void) {
     lteppp_connstatus = LTE_PPP_RESUMED;
 }
 
+void lteppp_rtc_session_save(uint32_t cid, bool legacyattach) {
+    lteppp_rtc_session.cid = cid;
+    lteppp_rtc_session.ipv4addr = lte_ipv4addr;
+    lteppp_rtc_session.gw = lte_gw;
+    lteppp_rtc_session.netmask = lte_netmask;
+    lteppp_rtc_session.dns[0] = ltepp_dns_info[0];
+    lteppp_rtc_session.dns[1] = ltepp_dns_info[1];
+    lteppp_rtc_session.legacy = lteppp_lte_legacy;
+    lteppp_rtc_session.legacyattach = legacyattach;
+    lteppp_rtc_session.magic = LTE_RTC_SESSION_MAGIC;
+    lteppp_rtc_session.crc = lteppp_rtc_session_crc();
+}
+
+bool lteppp_rtc_session_get(uint32_t *cid, bool *legacyattach) {
+    if (!lteppp_rtc_session_resumable()) {
+        return false;
+    }
+    *cid = lteppp_rtc_session.cid;
+    *legacyattach = lteppp_rtc_session.legacyattach;
+    lteppp_set_legacy(lteppp_rtc_session.legacy);
+    lteppp_ipcp_ouraddr = lteppp_rtc_session.ipv4addr;
+    lte_gw = lteppp_rtc_session.gw;
+    lte_netmask = lteppp_rtc_session.netmask;
+    ltepp_dns_info[0] = lteppp_rtc_session.dns[0];
+    ltepp_dns_info[1] = lteppp_rtc_session.dns[1];
+    dns_setserver(0, &ltepp_dns_info[0]);
+    dns_setserver(1, &ltepp_dns_info[1]);
+    // used once, the next deinit(detach=False) parks the session again
+    lteppp_rtc_session_invalidate();
+    return true;
+}
+
+void lteppp_rtc_session_invalidate(void) {
+    lteppp_rtc_session.magic = 0;
+}
+
+bool lteppp_socket_ring_take(uint8_t conn_id) {
+    uint8_t bit = 1 << (conn_id - 1);
+    xSemaphoreTake(xLTESem, portMAX_DELAY);
+    bool ring = (lteppp_socket_rings & bit) != 0;
+    lteppp_socket_rings &= ~bit;
+    xSemaphoreGive(xLTESem);
+    return ring;
+}
+
 /******************************************************************************
  DEFINE PRIVATE FUNCTIONS
  ******************************************************************************/
+static uint32_t lteppp_rtc_session_crc (void) {
+    return crc32_le(UINT32_MAX, (const uint8_t *)&lteppp_rtc_session.cid,
+                    sizeof(lteppp_rtc_session) - offsetof(lteppp_rtc_session_t, cid));
+}
+
+// only a wake from deep sleep finds the modem as it was left, any other reset restarts it
+static bool lteppp_rtc_session_resumable (void) {
+    return mpsleep_get_reset_cause() == MPSLEEP_DEEPSLEEP_RESET &&
+           lteppp_rtc_session.magic == LTE_RTC_SESSION_MAGIC && lteppp_rtc_session.crc == lteppp_rtc_session_crc();
+}
+
 bool trx_is_ok_or_error(){
     if (strstr(lteppp_trx_buffer, "ERROR\r\n") != NULL){
         // printf("ok\n");
@@ -482,10 +624,13 @@ static void TASK_LTE (void *pvParameters) {
     static uint32_t thread_notification;
 
     connect_lte_uart();
+    taskwdt_register(TASKWDT_LTE_TIMEOUT_MS);
 
 modem_init:
     MSG("modem_init\n");
+    taskwdt_sleeping(true);
     thread_notification = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    taskwdt_sleeping(false);
 
     if (thread_notification)
     {
@@ -495,6 +640,16 @@ modem_init:
         uart_set_rts(LTE_UART_ID, true);
         vTaskDelay(500/portTICK_PERIOD_MS);
         uart_set_hw_flow_ctrl(LTE_UART_ID, UART_HW_FLOWCTRL_CTS_RTS, 64);
+        if (lteppp_rtc_session_resumable()) {
+            // the modem was left in command mode and configured, the first AT may only wake it up
+            if (lteppp_send_at_cmd("AT", LTE_RX_TIMEOUT_MIN_MS) || lteppp_send_at_cmd("AT", LTE_RX_TIMEOUT_MIN_MS)) {
+                MSG("resumed\n");
+                lteppp_set_modem_conn_state(E_LTE_MODEM_CONNECTED);
+                xSemaphoreGive(xLTE_modem_Conn_Sem);
+                goto modem_ready;
+            }
+            lteppp_rtc_session_invalidate();
+        }
         // exit PPP session if applicable
         if(lteppp_send_at_cmd("+++", LTE_PPP_BACK_OFF_TIME_MS))
         {
@@ -590,10 +745,12 @@ modem_init:
         }
         lteppp_set_modem_conn_state(E_LTE_MODEM_CONNECTED);
         xSemaphoreGive(xLTE_modem_Conn_Sem);
+modem_ready:
         MSG("forever\n");
         lte_state_t state;
         for (;;) {
             vTaskDelay(LTE_TASK_PERIOD_MS);
+            taskwdt_alive();
             if(lteppp_get_modem_conn_state() == E_LTE_MODEM_DISCONNECTED ){
                 // restart the task
                 goto modem_init;
@@ -602,8 +759,18 @@ modem_init:
             if (xQueueReceive(xCmdQueue, lteppp_trx_buffer, 0)) {
                 MSG("cmd\n");
                 bool expect_continuation = lte_task_cmd->expect_continuation;
+                // the reply overwrites the command in the buffer
+                uint32_t tag = lte_task_cmd->tag;
+                uint32_t timeout = lte_task_cmd->timeout;
+                // keep the UART event task from feeding the reply to PPP (eg. the one for "+++")
+                xSemaphoreTake(xLTERxSem, portMAX_DELAY);
                 lteppp_send_at_cmd_exp(lte_task_cmd->data, lte_task_cmd->timeout, NULL, &(lte_task_rsp->data_remaining), lte_task_cmd->dataLen, lte_task_cmd->expect_continuation);
-                if(!expect_continuation)
+                lteppp_dispatch_urcs(lteppp_trx_buffer);
+                if (tag != 0) {
+                    lteppp_store_async_rsp(tag, timeout);
+                }
+                xSemaphoreGive(xLTERxSem);
+                if(!expect_continuation && tag == 0)
                     xQueueSend(xRxQueue, (void *)lte_task_rsp, (TickType_t)portMAX_DELAY);
             }
             //else if(state == E_LTE_PPP && lte_uart_break_evt)
@@ -614,7 +781,6 @@ modem_init:
             else
             {
                 if (state == E_LTE_PPP) {
-                    uint32_t rx_len;
                     // check for IP connection
                     if(lteppp_ipv4() > 0)
                     {
@@ -632,16 +798,8 @@ modem_init:
                         }
                         MSG("else, ppp, no ipv4 done\n");
                     }
-                    // wait for characters received
-                    uart_get_buffered_data_len(LTE_UART_ID, &rx_len);
-                    if (rx_len > 0) {
-                        // try to read up to the size of the buffer
-                        rx_len = uart_read_bytes(LTE_UART_ID, (uint8_t *)lteppp_trx_buffer, LTE_UART_BUFFER_SIZE,
-                                                 LTE_TRX_WAIT_MS(LTE_UART_BUFFER_SIZE) / portTICK_RATE_MS);
-                        if (rx_len > 0) {
-                            pppos_input_tcpip(lteppp_pcb, (uint8_t *)lteppp_trx_buffer, rx_len);
-                        }
-                    }
+                    // pick up anything that arrived while an AT command was being handled
+                    lteppp_ppp_input();
                 }
                 else
                 {
@@ -649,6 +807,11 @@ modem_init:
                         MSG("set ltepp_ppp_conn_up to false\n");
 
                     ltepp_ppp_conn_up = false;
+                    // only once attaching, before that the MicroPython thread may be
+                    // waiting for +SYSSTART itself after resetting the modem
+                    if (state == E_LTE_ATTACHING || state == E_LTE_ATTACHED || state == E_LTE_SUSPENDED) {
+                        lteppp_read_urcs();
+                    }
                 }
             }
         }
@@ -665,6 +828,8 @@ static void TASK_UART_EVT (void *pvParameters) {
 
             switch(event.type) {
                 case UART_DATA:
+                case UART_BUFFER_FULL:
+                    lteppp_ppp_input();
                 //     if (lte_uart_break_evt) {
 
                 //         uint32_t rx_len = uart_read_bytes(LTE_UART_ID, buff, LTE_UART_BUFFER_SIZE,
@@ -784,20 +949,140 @@ static bool lteppp_check_sim_present(void) {
     }
 }
 
+// Keep the reply to a tagged command, reading the rest of it if it didn't fit in the buffer
+static void lteppp_store_async_rsp (uint32_t tag, uint32_t timeout) {
+    lte_task_rsp_data_t *lte_task_rsp = (lte_task_rsp_data_t *)lteppp_trx_buffer;
+    size_t len = strlen(lteppp_trx_buffer);
+    lte_async_rsp_t *rsp = malloc(sizeof(lte_async_rsp_t) + len + 1);
+
+    if (rsp != NULL) {
+        rsp->tag = tag;
+        rsp->len = len;
+        memcpy(rsp->data, lteppp_trx_buffer, len + 1);
+    }
+    while (lte_task_rsp->data_remaining) {
+        lteppp_read_at_rsp(NULL, timeout, false, &(lte_task_rsp->data_remaining));
+        len = strlen(lteppp_trx_buffer);
+        lte_async_rsp_t *grown = (rsp == NULL) ? NULL : realloc(rsp, sizeof(lte_async_rsp_t) + rsp->len + len + 1);
+        if (grown == NULL) {
+            // out of memory, drain the modem anyway
+            free(rsp);
+            rsp = NULL;
+            continue;
+        }
+        rsp = grown;
+        memcpy(&rsp->data[rsp->len], lteppp_trx_buffer, len + 1);
+        rsp->len += len;
+    }
+    if (rsp == NULL) {
+        // the owner will time out
+        return;
+    }
+
+    rsp->next = NULL;
+    xSemaphoreTake(xLTESem, portMAX_DELAY);
+    // append, dropping the oldest replies nobody came to collect
+    lte_async_rsp_t **last = &lteppp_async_rsp_list;
+    uint32_t count = 0;
+    for ( ; *last != NULL; last = &(*last)->next) {
+        count++;
+    }
+    *last = rsp;
+    while (count >= LTE_ASYNC_RSP_KEEP_MAX) {
+        lte_async_rsp_t *oldest = lteppp_async_rsp_list;
+        lteppp_async_rsp_list = oldest->next;
+        free(oldest);
+        count--;
+    }
+    xSemaphoreGive(xLTESem);
+}
+
+// Read unsolicited result codes that arrive while no command is running
+static void lteppp_read_urcs (void) {
+    size_t rx_len = 0;
+
+    if (xSemaphoreTake(xLTERxSem, 0) != pdTRUE) {
+        return;
+    }
+    if (uart_get_buffered_data_len(LTE_UART_ID, &rx_len) == ESP_OK && rx_len > 0) {
+        // give the rest of the line a chance to arrive
+        int len = uart_read_bytes(LTE_UART_ID, (uint8_t *)lteppp_urc_buffer, LTE_URC_BUFFER_SIZE,
+                                  LTE_TRX_WAIT_MS(LTE_URC_BUFFER_SIZE) / portTICK_RATE_MS);
+        if (len > 0) {
+            lteppp_urc_buffer[len] = '\0';
+            lteppp_dispatch_urcs(lteppp_urc_buffer);
+        }
+    }
+    xSemaphoreGive(xLTERxSem);
+}
+
+// Pick the URCs out of the given text, wherever they were read (replies can carry them too)
+static void lteppp_dispatch_urcs (const char *buf) {
+    const char *pos = buf;
+
+    // "+CEREG: <stat>" is the URC, a reply to AT+CEREG? is "+CEREG: <n>,<stat>"
+    while ((pos = strstr(pos, "+CEREG: ")) != NULL) {
+        pos += strlen("+CEREG: ");
+        if (pos[0] >= '0' && pos[0] <= '9' && (pos[1] == '\r' || pos[1] == '\n' || pos[1] == '\0')) {
+            // 1 is registered on the home network, 5 is roaming, 2 is still searching
+            bool registered = (pos[0] == '1' || pos[0] == '5');
+            if (lteppp_registered && !registered && pos[0] != '2') {
+                MSG("CEREG %c, coverage lost\n", pos[0]);
+                modlte_urc_events(LTE_EVENT_COVERAGE_LOST);
+            }
+            lteppp_registered = registered;
+        }
+    }
+
+    // "+SQNSRING: <connId>,<recData>", data waiting in a socket of the modem
+    pos = buf;
+    while ((pos = strstr(pos, "+SQNSRING: ")) != NULL) {
+        pos += strlen("+SQNSRING: ");
+        if (pos[0] >= '1' && pos[0] <= '8') {
+            xSemaphoreTake(xLTESem, portMAX_DELAY);
+            lteppp_socket_rings |= 1 << (pos[0] - '1');
+            xSemaphoreGive(xLTESem);
+        }
+    }
+}
+
+// Feed whatever PPP data the UART driver holds to lwIP, in chunks as large as possible
+static void lteppp_ppp_input (void) {
+    size_t rx_len = 0;
+
+    // while suspended the modem is in command mode, and the replies belong to TASK_LTE
+    if (lteppp_get_state() != E_LTE_PPP || lteppp_connstatus == LTE_PPP_SUSPENDED) {
+        return;
+    }
+    xSemaphoreTake(xLTERxSem, portMAX_DELAY);
+    while (lteppp_get_state() == E_LTE_PPP && lteppp_connstatus != LTE_PPP_SUSPENDED &&
+           uart_get_buffered_data_len(LTE_UART_ID, &rx_len) == ESP_OK && rx_len > 0) {
+        int len = uart_read_bytes(LTE_UART_ID, lteppp_rx_buffer, MIN(rx_len, sizeof(lteppp_rx_buffer)), 0);
+        if (len <= 0) {
+            break;
+        }
+        // the data is copied into a pbuf, so the buffer can be reused straight away
+        TRACE_INSTANT(TRACE_EV_PPP_RX, len);
+        pppos_input_tcpip(lteppp_pcb, lteppp_rx_buffer, len);
+    }
+    xSemaphoreGive(xLTERxSem);
+}
+
 // PPP output callback
 static uint32_t lteppp_output_callback(ppp_pcb *pcb, u8_t *data, u32_t len, void *ctx) {
     LWIP_UNUSED_ARG(ctx);
     uint32_t tx_bytes;
     static uint32_t top =0;
+    TRACE_INSTANT(TRACE_EV_PPP_TX, len);
+    // no need to wait for the transmission to finish, the UART TX interrupt drains the
+    // driver's ring buffer in the background, and CTS keeps the modem from being overrun
     if (lteppp_connstatus == LTE_PPP_IDLE || lteppp_connstatus == LTE_PPP_RESUMED) {
         if(top > 0 && lteppp_connstatus == LTE_PPP_RESUMED)
         {
-            uart_write_bytes(LTE_UART_ID, (const char*)lteppp_queue_buffer, top+1);
-            uart_wait_tx_done(LTE_UART_ID, LTE_TRX_WAIT_MS(top+1) / portTICK_RATE_MS);
+            uart_write_bytes(LTE_UART_ID, (const char*)lteppp_queue_buffer, top);
         }
         top = 0;
         tx_bytes = uart_write_bytes(LTE_UART_ID, (const char*)data, len);
-        uart_wait_tx_done(LTE_UART_ID, LTE_TRX_WAIT_MS(len) / portTICK_RATE_MS);
     }
     else
     {
@@ -16,7 +16,11 @@
 #define LTE_UART_ID                                                     (2)
 
 #define LTE_UART_BUFFER_SIZE                                            (2048)
-#define LTE_CMD_QUEUE_SIZE_MAX                                          (1)
+#define LTE_UART_TX_BUFFER_SIZE                                         (4096)
+#define LTE_UART_RX_CHUNK_SIZE                                          (512)
+#define LTE_CMD_QUEUE_SIZE_MAX                                          (4)
+#define LTE_ASYNC_RSP_KEEP_MAX                                          (8)
+#define LTE_URC_BUFFER_SIZE                                             (256)
 #define LTE_RSP_QUEUE_SIZE_MAX                                          (1)
 #define LTE_AT_CMD_SIZE_MAX                                             (128)
 #define LTE_AT_CMD_DATA_SIZE_MAX                                        (LTE_AT_CMD_SIZE_MAX - 4)
@@ -28,6 +32,9 @@
 #define LTE_RX_TIMEOUT_MIN_MS                                           (300)
 #define LTE_PPP_BACK_OFF_TIME_MS                                        (1150)
 
+// tags of the commands of the UDP offload, the async commands of MicroPython stay below
+#define LTE_ASYNC_TAG_OFFLOAD                                           (0x80000000)
+
 #define LTE_MUTEX_TIMEOUT                                               (5050 / portTICK_RATE_MS)
 #define LTE_TASK_STACK_SIZE                                             (3072)
 #define LTE_TASK_PRIORITY                                               (6)
@@ -75,11 +82,20 @@ typedef struct {
 
 typedef struct {
     uint32_t timeout;
+    uint32_t tag;               // 0 for commands whose caller waits for the reply
     char data[LTE_AT_CMD_DATA_SIZE_MAX];
     size_t dataLen;
     bool expect_continuation;
 } lte_task_cmd_data_t;
 
+// reply to a tagged command, kept until its owner collects it
+typedef struct _lte_async_rsp_t {
+    struct _lte_async_rsp_t *next;
+    uint32_t tag;
+    size_t len;
+    char data[];
+} lte_async_rsp_t;
+
 #pragma pack(1)
 typedef struct {
     char data[LTE_UART_BUFFER_SIZE];
@@ -118,6 +134,10 @@ extern void lteppp_deinit (void);
 
 extern void lteppp_send_at_command (lte_task_cmd_data_t *cmd, lte_task_rsp_data_t *rsp);
 
+extern bool lteppp_send_at_command_async (lte_task_cmd_data_t *cmd);
+
+extern lte_async_rsp_t *lteppp_take_async_rsp (uint32_t tag);
+
 extern bool lteppp_wait_at_rsp (const char *expected_rsp, uint32_t timeout, bool from_mp, void* data_rem);
 
 lte_modem_conn_state_t lteppp_get_modem_conn_state(void);
@@ -133,6 +153,14 @@ extern void lteppp_resume(void);
 
 extern void lteppp_set_default_inf(void);
 
+extern void lteppp_rtc_session_save(uint32_t cid, bool legacyattach);
+
+extern bool lteppp_rtc_session_get(uint32_t *cid, bool *legacyattach);
+
+extern void lteppp_rtc_session_invalidate(void);
+
+extern bool lteppp_socket_ring_take(uint8_t conn_id);
+
 #ifdef LTE_DEBUG_BUFF
 extern char* lteppp_get_log_buff(void);
 #endif
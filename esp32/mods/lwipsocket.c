@@ -37,6 +37,8 @@
 
 
 #define WLAN_MAX_RX_SIZE                    2048
+#define WLAN_MAX_RX_SIZE_USER               (64 * 1024)     // cap of SO_RCVBUF, the large reads end up in PSRAM
+#define LWIPSOCKET_RX_SIZE(s)               ((s)->sock_base.rx_size ? (s)->sock_base.rx_size : WLAN_MAX_RX_SIZE)
 #define WLAN_MAX_TX_SIZE                    1476
 
 #define MAKE_SOCKADDR(addr, ip, port)       struct sockaddr addr; \
@@ -97,6 +99,7 @@ void lwipsocket_socket_close(mod_network_socket_obj_t *s) {
         }
         mbedtls_net_free(&ss->context_fd);
         mbedtls_x509_crt_free(&ss->cacert);
+        modussl_release_ca(ss);
         mbedtls_x509_crt_free(&ss->own_cert);
         mbedtls_pk_free(&ss->pk_key);
         mbedtls_ssl_free(&ss->ssl);
@@ -171,6 +174,41 @@ int lwipsocket_socket_connect(mod_network_socket_obj_t *s, byte *ip, mp_uint_t p
     return ret;
 }
 
+// waits for a non-blocking connect in progress to complete, or fail, within timeout_ms
+int lwipsocket_socket_connect_wait(mod_network_socket_obj_t *s, mp_int_t timeout_ms, int *_errno) {
+    int32_t sd = s->sock_base.u.sd;
+    fd_set wfds;
+    FD_ZERO(&wfds);
+    FD_SET(sd, &wfds);
+
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    int32_t nfds = lwip_select(sd + 1, NULL, &wfds, NULL, &tv);
+    if (nfds < 0) {
+        *_errno = errno;
+        return -1;
+    }
+    if (nfds == 0) {
+        *_errno = MP_ETIMEDOUT;
+        return -1;
+    }
+
+    // writable also means the connect failed, the reason is in SO_ERROR
+    int err = 0;
+    socklen_t optlen = sizeof(err);
+    if (lwip_getsockopt_r(sd, SOL_SOCKET, SO_ERROR, &err, &optlen) != 0) {
+        *_errno = errno;
+        return -1;
+    }
+    if (err != 0) {
+        *_errno = err;
+        return -1;
+    }
+    s->sock_base.connected = true;
+    return 0;
+}
+
 int lwipsocket_socket_send(mod_network_socket_obj_t *s, const byte *buf, mp_uint_t len, int *_errno) {
     mp_int_t bytes = 0;
     if (len > 0) {
@@ -237,7 +275,7 @@ int lwipsocket_socket_recv(mod_network_socket_obj_t *s, byte *buf, mp_uint_t len
             return -1;
         }
     } else {
-        ret = lwip_recv_r(s->sock_base.u.sd, buf, MIN(len, WLAN_MAX_RX_SIZE), 0);
+        ret = lwip_recv_r(s->sock_base.u.sd, buf, MIN(len, LWIPSOCKET_RX_SIZE(s)), 0);
         if (ret < 0) {
             *_errno = errno;
             return -1;
@@ -262,7 +300,7 @@ int lwipsocket_socket_sendto( mod_network_socket_obj_t *s, const byte *buf, mp_u
 int lwipsocket_socket_recvfrom(mod_network_socket_obj_t *s, byte *buf, mp_uint_t len, byte *ip, mp_uint_t *port, int *_errno) {
     struct sockaddr addr;
     socklen_t addr_len = sizeof(addr);
-    mp_int_t ret = lwip_recvfrom_r(s->sock_base.u.sd, buf, MIN(len, WLAN_MAX_RX_SIZE), 0, &addr, &addr_len);
+    mp_int_t ret = lwip_recvfrom_r(s->sock_base.u.sd, buf, MIN(len, LWIPSOCKET_RX_SIZE(s)), 0, &addr, &addr_len);
     if (ret < 0) {
         *_errno = errno;
         return -1;
@@ -277,6 +315,11 @@ int lwipsocket_socket_setsockopt(mod_network_socket_obj_t *s, mp_uint_t level, m
         *_errno = errno;
         return -1;
     }
+    // lwIP bounds what a datagram socket queues with it, recv() then reads up to that much at once
+    if (level == SOL_SOCKET && opt == SO_RCVBUF && optlen >= sizeof(int)) {
+        int size = *(const int *)optval;
+        s->sock_base.rx_size = (size <= 0) ? 0 : MIN(size, WLAN_MAX_RX_SIZE_USER);
+    }
     return 0;
 }
 
@@ -397,6 +440,7 @@ int lwipsocket_socket_setup_ssl(mod_network_socket_obj_t *s, int *_errno)
         if ((ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE && ret != MBEDTLS_ERR_SSL_TIMEOUT ) || count >= ss->read_timeout)
         {
             // printf("mbedtls_ssl_handshake returned -0x%x\n", -ret);
+            modussl_session_update(ss, false);
             *_errno = ret;
             return -1;
         }
@@ -411,9 +455,11 @@ int lwipsocket_socket_setup_ssl(mod_network_socket_obj_t *s, int *_errno)
     if ((ret = mbedtls_ssl_get_verify_result(&ss->ssl)) != 0) {
         /* In real life, we probably want to close connection if ret != 0 */
         // printf("Failed to verify peer certificate!\n");
+        modussl_session_update(ss, false);
         *_errno = ret;
         return -1;
     }
     // printf("Certificate verified.\n");
+    modussl_session_update(ss, true);
     return 0;
 }
@@ -26,6 +26,8 @@ extern int lwipsocket_socket_accept(mod_network_socket_obj_t *s, mod_network_soc
 
 extern int lwipsocket_socket_connect(mod_network_socket_obj_t *s, byte *ip, mp_uint_t port, int *_errno);
 
+extern int lwipsocket_socket_connect_wait(mod_network_socket_obj_t *s, mp_int_t timeout_ms, int *_errno);
+
 extern int lwipsocket_socket_send(mod_network_socket_obj_t *s, const byte *buf, mp_uint_t len, int *_errno);
 
 extern int lwipsocket_socket_recv(mod_network_socket_obj_t *s, byte *buf, mp_uint_t len, int *_errno);
@@ -31,12 +31,15 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include "machcan.h"
 #include "mpexception.h"
 #include "machpin.h"
 #include "mpirq.h"
 #include "CAN.h"
+#include "pwrmgr.h"
 #include "CAN_config.h"
+#include "machrtc.h"
 
 /******************************************************************************
  DECLARE EXPORTED DATA
@@ -51,6 +54,10 @@ CAN_device_t CAN_cfg = { .rx_queue = NULL };
 #define MACH_CAN_FORMAT_BOTH                        (MACH_CAN_FORMAT_STD | MACH_CAN_FORMAT_EXT)
 
 #define MACH_CAN_DEF_RX_QUEUE_LEN                   (128)
+#define MACH_CAN_DEF_TX_QUEUE_LEN                   (32)
+
+#define MACH_CAN_DISPATCH_MAX                       (8)
+#define MACH_CAN_DISPATCH_QUEUE_LEN                 (32)
 
 /******************************************************************************
  DEFINE TYPES
@@ -61,6 +68,10 @@ typedef struct {
     mp_obj_t handler_arg;
     uint32_t baudrate;
     uint32_t rx_queue_len;
+    uint32_t tx_queue_len;
+    // for the bus load between two calls of stats()
+    uint64_t stats_bits;
+    uint64_t stats_time;
     pin_obj_t *tx;
     pin_obj_t *rx;
     CAN_sw_filters_t swfilters;
@@ -71,13 +82,38 @@ typedef struct {
     uint8_t events;
 } mach_can_obj_t;
 
+typedef struct {
+    uint32_t id;
+    uint32_t mask;
+    bool extended;
+} mach_can_dispatch_entry_t;
+
+typedef struct {
+    mach_can_dispatch_entry_t entries[MACH_CAN_DISPATCH_MAX];
+    // the handlers, in the same order as the entries, rooted through the IRQ list
+    mp_obj_t handlers;
+    QueueHandle_t queue;
+    volatile uint8_t count;
+} mach_can_dispatch_t;
+
 /******************************************************************************
  DECLARE PRIVATE DATA
  ******************************************************************************/
 STATIC mach_can_obj_t mach_can_obj = { .baudrate = 0 };
 STATIC const mp_obj_t mach_can_def_pin[2] = {&PIN_MODULE_P22, &PIN_MODULE_P23};
+STATIC mach_can_dispatch_t mach_can_dispatch = { .count = 0 };
+
+STATIC const qstr can_recv_info_fields[] = {
+    MP_QSTR_id, MP_QSTR_data, MP_QSTR_rtr, MP_QSTR_extended, MP_QSTR_timestamp
+};
+
+STATIC const qstr can_stats_info_fields[] = {
+    MP_QSTR_tx_frames, MP_QSTR_rx_frames, MP_QSTR_tx_queued, MP_QSTR_tx_errors, MP_QSTR_rx_errors,
+    MP_QSTR_arb_lost, MP_QSTR_bus_errors, MP_QSTR_overruns, MP_QSTR_bus_off, MP_QSTR_bus_load
+};
 
 STATIC void can_callback_handler(void *arg);
+STATIC void can_dispatch_handler(void *arg);
 
 /******************************************************************************
  DEFINE PUBLIC FUNCTIONS
@@ -89,6 +125,19 @@ void can_queue_interrupt(uint32_t events) {
     }
 }
 
+// called from the ISR, returns true if the frame was handed over to a per-id handler
+bool can_dispatch_frame(const CAN_frame_t *frame) {
+    for (int i = 0; i < mach_can_dispatch.count; i++) {
+        mach_can_dispatch_entry_t *entry = &mach_can_dispatch.entries[i];
+        if (entry->extended == frame->FIR.B.FF && (frame->MsgID & entry->mask) == (entry->id & entry->mask)) {
+            xQueueSendFromISR(mach_can_dispatch.queue, frame, NULL);
+            mp_irq_queue_interrupt(can_dispatch_handler, (void *)&mach_can_dispatch);
+            return true;
+        }
+    }
+    return false;
+}
+
 /******************************************************************************
  DEFINE PRIVATE FUNCTIONS
  ******************************************************************************/
@@ -112,6 +161,99 @@ STATIC void can_callback_handler(void *arg) {
     }
 }
 
+STATIC mp_obj_t can_frame_to_obj(const CAN_frame_t *frame, bool timestamp) {
+    mp_obj_t tuple[5];
+    tuple[0] = mp_obj_new_int(frame->MsgID);
+    if (frame->FIR.B.RTR == CAN_RTR) {
+        tuple[1] = mp_const_empty_bytes;
+        tuple[2] = mp_const_true;
+    } else {
+        tuple[1] = mp_obj_new_bytes((const byte *)frame->data.u8, frame->FIR.B.DLC);
+        tuple[2] = mp_const_false;
+    }
+    tuple[3] = frame->FIR.B.FF ? mp_const_true : mp_const_false;
+    if (timestamp) {
+        tuple[4] = mp_obj_new_int_from_ull(frame->timestamp);
+        return mp_obj_new_attrtuple(can_recv_info_fields, 5, tuple);
+    }
+    return mp_obj_new_attrtuple(can_recv_info_fields, 4, tuple);
+}
+
+STATIC void can_dispatch_handler(void *arg) {
+    mach_can_dispatch_t *dispatch = arg;
+    CAN_frame_t frame;
+    // one queued callback serves all the frames that arrived in the meantime
+    while (xQueueReceive(dispatch->queue, &frame, 0) == pdTRUE) {
+        mp_obj_t *handlers;
+        size_t n_handlers;
+        mp_obj_get_array(dispatch->handlers, &n_handlers, &handlers);
+        for (int i = 0; i < n_handlers; i++) {
+            mach_can_dispatch_entry_t *entry = &dispatch->entries[i];
+            if (entry->extended == frame.FIR.B.FF && (frame.MsgID & entry->mask) == (entry->id & entry->mask)) {
+                mp_call_function_1(handlers[i], can_frame_to_obj(&frame, false));
+                break;
+            }
+        }
+    }
+}
+
+STATIC uint32_t can_get_timeout(mp_obj_t timeout_o) {
+    uint64_t timeout = 0;
+    if (timeout_o == mp_const_none) {
+        timeout = portMAX_DELAY;
+    } else if (timeout_o != MP_OBJ_NULL) {
+        timeout = mp_obj_get_float(timeout_o) * 1000;
+        if (timeout < 0 || timeout > portMAX_DELAY) {
+            timeout = portMAX_DELAY;
+        }
+    }
+    return timeout;
+}
+
+STATIC void can_build_frame(CAN_frame_t *tx_frame, uint32_t msg_id, mp_obj_t data_o, bool rtr, bool extended) {
+    // get the buffer to send from
+    mp_buffer_info_t bufinfo;
+    uint8_t data[1];
+    if (data_o == mp_const_none) {
+        bufinfo.len = 0;
+    } else {
+        pyb_buf_get_for_send(data_o, &bufinfo, data);
+    }
+
+    if (msg_id > 2047 && !extended) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "invalid message id %d", msg_id));
+    }
+
+    if (rtr) {
+        if (bufinfo.len > 0) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "data given for RTR message"));
+        }
+    } else if (bufinfo.len == 0 || bufinfo.len > 8) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "invalid data length %d", bufinfo.len));
+    }
+
+    tx_frame->FIR.U = 0;
+    tx_frame->FIR.B.DLC = bufinfo.len;
+    tx_frame->FIR.B.RTR = rtr ? CAN_RTR : CAN_no_RTR;
+    tx_frame->FIR.B.FF = extended ? CAN_frame_ext : CAN_frame_std;
+    tx_frame->MsgID = msg_id;
+    memcpy(tx_frame->data.u8, bufinfo.buf, bufinfo.len);
+}
+
+// queues the frame, only giving up the GIL when the queue is full
+STATIC bool can_queue_frame(const CAN_frame_t *tx_frame, uint32_t timeout) {
+    if (CAN_queue_frame(tx_frame, 0) == 0) {
+        return true;
+    }
+    if (timeout == 0) {
+        return false;
+    }
+    MP_THREAD_GIL_EXIT();
+    int ret = CAN_queue_frame(tx_frame, timeout * portTICK_PERIOD_MS);
+    MP_THREAD_GIL_ENTER();
+    return ret == 0;
+}
+
 /******************************************************************************/
 /* Micro Python bindings : CAN object                                         */
 
@@ -129,8 +271,8 @@ STATIC void mach_can_print(const mp_print_t *print, mp_obj_t self_in, mp_print_k
             default:
                 break;
         }
-        mp_printf(print, "CAN(0, mode=%d, baudrate=%d, frame_format=%q, rx_queue_len=%d)",
-                  self->mode, self->baudrate, frame_format, self->rx_queue_len);
+        mp_printf(print, "CAN(0, mode=%d, baudrate=%d, frame_format=%q, rx_queue_len=%d, tx_queue_len=%d)",
+                  self->mode, self->baudrate, frame_format, self->rx_queue_len, self->tx_queue_len);
     } else {
         mp_printf(print, "CAN(0)");
     }
@@ -197,12 +339,33 @@ STATIC mp_obj_t mach_can_init_helper(mach_can_obj_t *self, const mp_arg_val_t *a
         goto invalid_args;
     }
 
+    if (args[5].u_int > 0) {
+        self->tx_queue_len = args[5].u_int;
+        if (CAN_cfg.tx_queue) {
+            // keep the ISR away from the queue while it's replaced
+            CAN_stop();
+            QueueHandle_t tx_queue = CAN_cfg.tx_queue;
+            CAN_cfg.tx_queue = NULL;
+            vQueueDelete(tx_queue);
+        }
+        CAN_cfg.tx_queue = xQueueCreate(args[5].u_int, sizeof(CAN_frame_t));
+        if (!CAN_cfg.tx_queue) {
+            mp_raise_OSError(MP_ENOMEM);
+        }
+    } else {
+        goto invalid_args;
+    }
+
     // start the CAN Module
     CAN_init(mode, frame_format - 1);
+    pwrmgr_hold(PWRMGR_CAN, true);
+    self->stats_bits = 0;
+    self->stats_time = mach_rtc_ticks_us64();
 
-    // remove the software filters
+    // remove the software filters, CAN_init already opened the hardware ones
     self->swfilters.num_filters = 0;
     CAN_setup_sw_filters(&self->swfilters);
+    self->hwfilters.num_filters = 0;
 
     // set the af values, so that deassign works later on
     if (self->tx && self->rx) {
@@ -225,6 +388,7 @@ STATIC const mp_arg_t mach_can_init_args[] = {
     { MP_QSTR_frame_format,     MP_ARG_KW_ONLY | MP_ARG_INT,        {.u_int = MACH_CAN_FORMAT_STD} },
     { MP_QSTR_pins,             MP_ARG_KW_ONLY | MP_ARG_OBJ,        {.u_obj = MP_OBJ_NULL} },
     { MP_QSTR_rx_queue_len,     MP_ARG_KW_ONLY | MP_ARG_INT,        {.u_int = MACH_CAN_DEF_RX_QUEUE_LEN} },
+    { MP_QSTR_tx_queue_len,     MP_ARG_KW_ONLY | MP_ARG_INT,        {.u_int = MACH_CAN_DEF_TX_QUEUE_LEN} },
 };
 
 STATIC mp_obj_t mach_can_make_new(const mp_obj_type_t *type, mp_uint_t n_args, mp_uint_t n_kw, const mp_obj_t *all_args) {
@@ -263,6 +427,7 @@ STATIC mp_obj_t mach_can_deinit(mp_obj_t self_in) {
 
     // stop the can controller
     CAN_stop();
+    pwrmgr_hold(PWRMGR_CAN, false);
 
     // de-assign the pins
     can_deassign_pins_af(self);
@@ -271,17 +436,26 @@ STATIC mp_obj_t mach_can_deinit(mp_obj_t self_in) {
         vQueueDelete(CAN_cfg.rx_queue);
         CAN_cfg.rx_queue = NULL;
     }
+    if (CAN_cfg.tx_queue) {
+        QueueHandle_t tx_queue = CAN_cfg.tx_queue;
+        CAN_cfg.tx_queue = NULL;
+        vQueueDelete(tx_queue);
+    }
 
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_can_deinit_obj, mach_can_deinit);
 
+/// \method send(id, *, data, rtr, extended, timeout)
+/// Queues the frame for the TX interrupt, waiting up to timeout (forever by default) for
+/// room in the queue.
 STATIC mp_obj_t mach_can_send(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     static const mp_arg_t allowed_args[] = {
         { MP_QSTR_id,           MP_ARG_REQUIRED | MP_ARG_INT,  },
         { MP_QSTR_data,         MP_ARG_KW_ONLY  | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
         { MP_QSTR_rtr,          MP_ARG_KW_ONLY  | MP_ARG_BOOL, {.u_bool = false} },
         { MP_QSTR_extended,     MP_ARG_KW_ONLY  | MP_ARG_BOOL, {.u_bool = false} },
+        { MP_QSTR_timeout,      MP_ARG_KW_ONLY  | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
     };
 
     // parse args
@@ -289,90 +463,137 @@ STATIC mp_obj_t mach_can_send(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map
     mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
 
     CAN_frame_t tx_frame;
+    can_build_frame(&tx_frame, args[0].u_int, args[1].u_obj, args[2].u_bool, args[3].u_bool);
 
-    // get the buffer to send from
-    mp_buffer_info_t bufinfo;
-    uint8_t data[1];
-    if (args[1].u_obj == mp_const_none) {
-        bufinfo.len = 0;
-    } else {
-        pyb_buf_get_for_send(args[1].u_obj, &bufinfo, data);
-    }
-
-    uint32_t msg_id = args[0].u_int;
-    if (msg_id > 2047 && !args[3].u_bool) {
-        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "invalid message id %d", msg_id));
-    }
-
-    if (args[2].u_bool) {
-        if (bufinfo.len > 0) {
-            nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "data given for RTR message"));
-        }
-    } else if (bufinfo.len == 0 || bufinfo.len > 8) {
-        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "invalid data length %d", bufinfo.len));
+    if (!can_queue_frame(&tx_frame, can_get_timeout(args[4].u_obj))) {
+        mp_raise_OSError(MP_ETIMEDOUT);
     }
 
-    tx_frame.FIR.B.DLC = bufinfo.len;
-    tx_frame.FIR.B.RTR = args[2].u_bool ? CAN_RTR : CAN_no_RTR;
-    tx_frame.FIR.B.FF = args[3].u_bool ? CAN_frame_ext : CAN_frame_std;
-    tx_frame.MsgID = msg_id;
-    memcpy(tx_frame.data.u8, bufinfo.buf, bufinfo.len);
-
-    CAN_write_frame(&tx_frame);
-
     // return the number of bytes sent
-    return mp_obj_new_int(bufinfo.len);
+    return mp_obj_new_int(tx_frame.FIR.B.DLC);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_can_send_obj, 1, mach_can_send);
 
-STATIC mp_obj_t mach_can_recv(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+/// \method send_many(frames, *, timeout)
+/// Queues a burst of frames, given either as a sequence of (id, data, rtr, extended) tuples
+/// (rtr and extended are optional, the tuples from recv() fit) or as a buffer of frames in the
+/// recv_into() layout. Returns the number of frames queued before timeout expired.
+STATIC mp_obj_t mach_can_send_many(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     static const mp_arg_t allowed_args[] = {
-        { MP_QSTR_timeout,      MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
-    };
-
-    static const qstr can_recv_info_fields[] = {
-        MP_QSTR_id, MP_QSTR_data, MP_QSTR_rtr, MP_QSTR_extended
+        { MP_QSTR_frames,       MP_ARG_REQUIRED | MP_ARG_OBJ,  },
+        { MP_QSTR_timeout,      MP_ARG_KW_ONLY  | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
     };
 
     // parse args
     mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
 
-    uint64_t timeout = 0;
-    if (args[0].u_obj == mp_const_none) {
-        timeout = portMAX_DELAY;
+    uint32_t timeout = can_get_timeout(args[1].u_obj);
+    CAN_frame_t tx_frame;
+    size_t n_frames = 0;
+
+    mp_buffer_info_t bufinfo;
+    if (mp_get_buffer(args[0].u_obj, &bufinfo, MP_BUFFER_READ)) {
+        const CAN_frame_t *frames = bufinfo.buf;
+        size_t count = bufinfo.len / sizeof(CAN_frame_t);
+        for (; n_frames < count; n_frames++) {
+            memcpy(&tx_frame, &frames[n_frames], sizeof(CAN_frame_t));
+            if (tx_frame.FIR.B.DLC > 8 || (tx_frame.MsgID > 2047 && tx_frame.FIR.B.FF == CAN_frame_std)) {
+                nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+            }
+            if (!can_queue_frame(&tx_frame, timeout)) {
+                break;
+            }
+        }
     } else {
-        if (args[0].u_obj != MP_OBJ_NULL) {
-            timeout = mp_obj_get_float(args[0].u_obj) * 1000;
-            if (timeout < 0 || timeout > portMAX_DELAY) {
-                timeout = portMAX_DELAY;
+        mp_obj_t *frames;
+        size_t count;
+        mp_obj_get_array(args[0].u_obj, &count, &frames);
+        for (; n_frames < count; n_frames++) {
+            mp_obj_t *items;
+            size_t n_items;
+            mp_obj_get_array(frames[n_frames], &n_items, &items);
+            if (n_items < 2 || n_items > 5) {
+                nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+            }
+            bool rtr = n_items > 2 && mp_obj_is_true(items[2]);
+            bool extended = n_items > 3 && mp_obj_is_true(items[3]);
+            can_build_frame(&tx_frame, mp_obj_get_int_truncated(items[0]), rtr ? mp_const_none : items[1], rtr, extended);
+            if (!can_queue_frame(&tx_frame, timeout)) {
+                break;
             }
         }
     }
+    return mp_obj_new_int(n_frames);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_can_send_many_obj, 1, mach_can_send_many);
+
+/// \method recv(timeout, *, timestamp=False)
+/// With timestamp=True the frame carries the ticks_us64() time the ISR received it.
+STATIC mp_obj_t mach_can_recv(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_timeout,      MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_timestamp,    MP_ARG_KW_ONLY  | MP_ARG_BOOL, {.u_bool = false} },
+    };
+
+    // parse args
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+
+    uint32_t timeout = can_get_timeout(args[0].u_obj);
 
     CAN_frame_t rx_frame;
     MP_THREAD_GIL_EXIT();
-    if (xQueueReceive(CAN_cfg.rx_queue, &rx_frame, (uint32_t)timeout * portTICK_PERIOD_MS) == pdTRUE) {
+    if (xQueueReceive(CAN_cfg.rx_queue, &rx_frame, timeout * portTICK_PERIOD_MS) == pdTRUE) {
         MP_THREAD_GIL_ENTER();
-        mp_obj_t tuple[4];
-        tuple[0] = mp_obj_new_int(rx_frame.MsgID);
-        if (rx_frame.FIR.B.RTR == CAN_RTR) {
-            tuple[1] = mp_const_empty_bytes;
-            tuple[2] = mp_const_true;
-        } else {
-            tuple[1] = mp_obj_new_bytes((const byte *)rx_frame.data.u8, rx_frame.FIR.B.DLC);
-            tuple[2] = mp_const_false;
-        }
-        tuple[3] = rx_frame.FIR.B.FF ? mp_const_true : mp_const_false;
-
         // return the attribute tuple
-        return mp_obj_new_attrtuple(can_recv_info_fields, 4, tuple);
+        return can_frame_to_obj(&rx_frame, args[1].u_bool);
     }
     MP_THREAD_GIL_ENTER();
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_can_recv_obj, 1, mach_can_recv);
 
+/// \method recv_into(buf, *, timeout)
+/// Copies as many frames as fit from the rx queue into buf without any allocation, waiting up
+/// to timeout for the first one. Each frame takes CAN.FRAME_SIZE bytes, which can be read with
+/// uctypes: byte 0 holds the DLC (bits 0-3), RTR (bit 6) and extended (bit 7) flags, the
+/// little endian id is at offset 4, the data bytes start at offset 8 and the 64 bit
+/// reception time in us (see recv()) is at offset 16.
+STATIC mp_obj_t mach_can_recv_into(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_buf,          MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_timeout,      MP_ARG_KW_ONLY  | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+    };
+
+    // parse args
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[0].u_obj, &bufinfo, MP_BUFFER_WRITE);
+    size_t max_frames = bufinfo.len / sizeof(CAN_frame_t);
+    if (max_frames == 0) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+
+    uint32_t timeout = can_get_timeout(args[1].u_obj);
+
+    // the queue holds the frames in this very layout, so they are copied straight into the buffer
+    CAN_frame_t *frames = bufinfo.buf;
+    size_t n_frames = 0;
+    MP_THREAD_GIL_EXIT();
+    if (xQueueReceive(CAN_cfg.rx_queue, &frames[0], timeout * portTICK_PERIOD_MS) == pdTRUE) {
+        n_frames = 1;
+        while (n_frames < max_frames && xQueueReceive(CAN_cfg.rx_queue, &frames[n_frames], 0) == pdTRUE) {
+            n_frames++;
+        }
+    }
+    MP_THREAD_GIL_ENTER();
+    return mp_obj_new_int(n_frames);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_can_recv_into_obj, 1, mach_can_recv_into);
+
 STATIC mp_obj_t mach_can_soft_filter(mp_obj_t self_in, mp_obj_t mode_o, mp_obj_t filters_l) {
     mach_can_obj_t *self = self_in;
 
@@ -414,39 +635,125 @@ STATIC mp_obj_t mach_can_soft_filter(mp_obj_t self_in, mp_obj_t mode_o, mp_obj_t
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_3(mach_can_soft_filter_obj, mach_can_soft_filter);
 
-// STATIC mp_obj_t mach_can_hard_filter(mp_obj_t self_in, mp_obj_t filters_l) {
-//     mach_can_obj_t *self = self_in;
-
-//     mp_obj_t *filters;
-//     mp_uint_t n_filters;
-//     if (filters_l != mp_const_none) {
-//         mp_obj_get_array(filters_l, &n_filters, &filters);
-//         if (n_filters < 1 || n_filters > 2) {
-//             nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "between 1 and 2 hardware filters are possible"));
-//         }
-//         for (int i = 0; i < n_filters; i++) {
-//             mp_obj_t *fromto;
-//             mp_obj_get_array_fixed_n(filters[i], 2, &fromto);
-//             self->hwfilters.codemask[i][0] = mp_obj_get_int_truncated(fromto[0]);
-//             self->hwfilters.codemask[i][1] = mp_obj_get_int_truncated(fromto[1]);
-//         }
-//         self->hwfilters.num_filters = n_filters;
-//     } else {
-//         self->hwfilters.num_filters = 0;
-//     }
-
-//     CAN_setup_hw_filters(&self->hwfilters);
-
-//     return mp_const_none;
-// }
-// STATIC MP_DEFINE_CONST_FUN_OBJ_2(mach_can_hard_filter_obj, mach_can_hard_filter);
-
-/// \method callback(trigger, handler, arg)
+/// \method hard_filter(filters, *, extended)
+/// Sets up 1 or 2 (id, mask) acceptance filters in the controller, frames that don't match never
+/// reach the ISR. With two filters, only the 16 MSBs of an extended id are compared.
+STATIC mp_obj_t mach_can_hard_filter(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_filters,      MP_ARG_REQUIRED | MP_ARG_OBJ,  },
+        { MP_QSTR_extended,     MP_ARG_KW_ONLY  | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+    };
+
+    // parse args
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+    mach_can_obj_t *self = pos_args[0];
+
+    if (args[1].u_obj == mp_const_none) {
+        self->hwfilters.extended = (self->frame_format == MACH_CAN_FORMAT_EXT);
+    } else {
+        self->hwfilters.extended = mp_obj_is_true(args[1].u_obj);
+    }
+
+    mp_obj_t *filters;
+    mp_uint_t n_filters;
+    if (args[0].u_obj != mp_const_none) {
+        mp_obj_get_array(args[0].u_obj, &n_filters, &filters);
+        if (n_filters < 1 || n_filters > 2) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "between 1 and 2 hardware filters are possible"));
+        }
+        for (int i = 0; i < n_filters; i++) {
+            mp_obj_t *fromto;
+            mp_obj_get_array_fixed_n(filters[i], 2, &fromto);
+            self->hwfilters.codemask[i][0] = mp_obj_get_int_truncated(fromto[0]);
+            self->hwfilters.codemask[i][1] = mp_obj_get_int_truncated(fromto[1]);
+        }
+        self->hwfilters.num_filters = n_filters;
+    } else {
+        self->hwfilters.num_filters = 0;
+    }
+
+    CAN_setup_hw_filters(&self->hwfilters);
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_can_hard_filter_obj, 1, mach_can_hard_filter);
+
+/// \method subscribe(id, handler, *, mask, extended)
+/// Calls handler(frame) for every frame matching id under mask, those frames bypass the
+/// software filters and the rx queue. A handler of None removes the subscription.
+STATIC mp_obj_t mach_can_subscribe(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_id,           MP_ARG_REQUIRED | MP_ARG_INT,  },
+        { MP_QSTR_handler,      MP_ARG_REQUIRED | MP_ARG_OBJ,  },
+        { MP_QSTR_mask,         MP_ARG_KW_ONLY  | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+        { MP_QSTR_extended,     MP_ARG_KW_ONLY  | MP_ARG_BOOL, {.u_bool = false} },
+    };
+
+    // parse args
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+
+    mach_can_dispatch_entry_t entry;
+    entry.id = args[0].u_int;
+    entry.extended = args[3].u_bool;
+    if (args[2].u_obj == mp_const_none) {
+        entry.mask = entry.extended ? 0x1FFFFFFF : 0x7FF;
+    } else {
+        entry.mask = mp_obj_get_int_truncated(args[2].u_obj);
+    }
+
+    if (mach_can_dispatch.queue == NULL) {
+        mach_can_dispatch.queue = xQueueCreate(MACH_CAN_DISPATCH_QUEUE_LEN, sizeof(CAN_frame_t));
+        if (!mach_can_dispatch.queue) {
+            mp_raise_OSError(MP_ENOMEM);
+        }
+        mach_can_dispatch.handlers = mp_const_empty_tuple;
+    }
+
+    // build the new tables aside, the ISR keeps using the current ones meanwhile
+    mach_can_dispatch_entry_t entries[MACH_CAN_DISPATCH_MAX];
+    mp_obj_t handlers[MACH_CAN_DISPATCH_MAX];
+    mp_obj_t *cur_handlers;
+    size_t count = 0, n_cur;
+    mp_obj_get_array(mach_can_dispatch.handlers, &n_cur, &cur_handlers);
+    for (int i = 0; i < n_cur; i++) {
+        mach_can_dispatch_entry_t *cur = &mach_can_dispatch.entries[i];
+        if (cur->id != entry.id || cur->mask != entry.mask || cur->extended != entry.extended) {
+            entries[count] = *cur;
+            handlers[count++] = cur_handlers[i];
+        }
+    }
+    if (args[1].u_obj != mp_const_none) {
+        if (count == MACH_CAN_DISPATCH_MAX) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable));
+        }
+        entries[count] = entry;
+        handlers[count++] = args[1].u_obj;
+    }
+
+    mp_obj_t handlers_o = mp_obj_new_tuple(count, handlers);
+    mach_can_dispatch.count = 0;
+    memcpy(mach_can_dispatch.entries, entries, sizeof(entries));
+    mach_can_dispatch.handlers = handlers_o;
+    mach_can_dispatch.count = count;
+    if (count > 0) {
+        mp_irq_add(&mach_can_dispatch, handlers_o);
+    } else {
+        mp_irq_remove(&mach_can_dispatch);
+    }
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_can_subscribe_obj, 1, mach_can_subscribe);
+
+/// \method callback(trigger, handler, arg, *, priority)
 STATIC mp_obj_t mach_can_callback(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     STATIC const mp_arg_t allowed_args[] = {
         { MP_QSTR_trigger,      MP_ARG_REQUIRED | MP_ARG_OBJ,   },
         { MP_QSTR_handler,      MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
         { MP_QSTR_arg,          MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
+        { MP_QSTR_priority,     MP_ARG_KW_ONLY | MP_ARG_INT,    {.u_int = MP_IRQ_PRIORITY_NORMAL} },
     };
 
     // parse arguments
@@ -458,7 +765,7 @@ STATIC mp_obj_t mach_can_callback(mp_uint_t n_args, const mp_obj_t *pos_args, mp
     if (args[0].u_obj != mp_const_none && args[1].u_obj != mp_const_none) {
         self->trigger = mp_obj_get_int(args[0].u_obj);
         self->handler = args[1].u_obj;
-        mp_irq_add(self, args[1].u_obj);
+        mp_irq_add_prio(self, args[1].u_obj, args[3].u_int);
         if (args[2].u_obj == mp_const_none) {
             self->handler_arg = self;
         } else {
@@ -483,16 +790,54 @@ STATIC mp_obj_t mach_can_events(mp_obj_t self_in) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_can_events_obj, mach_can_events);
 
+/// \method stats()
+/// The counters since init(), the error counters of the controller and the bus load in %
+/// since the previous call, estimated from the frames seen without their stuff bits.
+STATIC mp_obj_t mach_can_stats(mp_obj_t self_in) {
+    mach_can_obj_t *self = self_in;
+    CAN_stats_t stats;
+    uint8_t tx_errors, rx_errors;
+
+    CAN_get_stats(&stats, &tx_errors, &rx_errors);
+    uint64_t now = mach_rtc_ticks_us64();
+    uint64_t elapsed = now - self->stats_time;
+    mp_float_t load = 0;
+    if (elapsed > 0 && self->baudrate > 0) {
+        load = (mp_float_t)(stats.bits - self->stats_bits) * 100 * 1000000 / ((mp_float_t)elapsed * self->baudrate);
+    }
+    self->stats_bits = stats.bits;
+    self->stats_time = now;
+
+    mp_obj_t tuple[10] = {
+        mp_obj_new_int_from_uint(stats.tx_frames),
+        mp_obj_new_int_from_uint(stats.rx_frames),
+        mp_obj_new_int(CAN_cfg.tx_queue ? uxQueueMessagesWaiting(CAN_cfg.tx_queue) : 0),
+        mp_obj_new_int(tx_errors),
+        mp_obj_new_int(rx_errors),
+        mp_obj_new_int_from_uint(stats.arb_lost),
+        mp_obj_new_int_from_uint(stats.bus_errors),
+        mp_obj_new_int_from_uint(stats.overruns),
+        mp_obj_new_int_from_uint(stats.bus_off),
+        mp_obj_new_float(load),
+    };
+    return mp_obj_new_attrtuple(can_stats_info_fields, 10, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_can_stats_obj, mach_can_stats);
+
 STATIC const mp_map_elem_t mach_can_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_init),                (mp_obj_t)&mach_can_init_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_deinit),              (mp_obj_t)&mach_can_deinit_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_send),                (mp_obj_t)&mach_can_send_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_send_many),           (mp_obj_t)&mach_can_send_many_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_recv),                (mp_obj_t)&mach_can_recv_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_recv_into),           (mp_obj_t)&mach_can_recv_into_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_soft_filter),         (mp_obj_t)&mach_can_soft_filter_obj },
-    // { MP_OBJ_NEW_QSTR(MP_QSTR_hard_filter),         (mp_obj_t)&mach_can_hard_filter_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_hard_filter),         (mp_obj_t)&mach_can_hard_filter_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_subscribe),           (mp_obj_t)&mach_can_subscribe_obj },
 
     { MP_OBJ_NEW_QSTR(MP_QSTR_callback),            (mp_obj_t)&mach_can_callback_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_events),              (mp_obj_t)&mach_can_events_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_stats),               (mp_obj_t)&mach_can_stats_obj },
 
     { MP_OBJ_NEW_QSTR(MP_QSTR_NORMAL),              MP_OBJ_NEW_SMALL_INT(CAN_mode_normal) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_SILENT),              MP_OBJ_NEW_SMALL_INT(CAN_mode_listen_only) },
@@ -508,6 +853,8 @@ STATIC const mp_map_elem_t mach_can_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_FILTER_LIST),         MP_OBJ_NEW_SMALL_INT(CAN_FILTER_LIST) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_FILTER_RANGE),        MP_OBJ_NEW_SMALL_INT(CAN_FILTER_RANGE) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_FILTER_MASK),         MP_OBJ_NEW_SMALL_INT(CAN_FILTER_MASK) },
+
+    { MP_OBJ_NEW_QSTR(MP_QSTR_FRAME_SIZE),          MP_OBJ_NEW_SMALL_INT(sizeof(CAN_frame_t)) },
 };
 
 STATIC MP_DEFINE_CONST_DICT(mach_can_locals_dict, mach_can_locals_dict_table);
@@ -0,0 +1,370 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/mpthread.h"
+#include "py/mperrno.h"
+#include "mpexception.h"
+#include "mpirq.h"
+#include "machpin.h"
+#include "machrmt.h"
+#include "machdht.h"
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/ringbuf.h"
+#include "driver/gpio.h"
+#include "driver/rmt.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+// 1 us ticks out of the 80 MHz APB clock
+#define DHT_CLK_DIV                         (80)
+#define DHT_START_LOW_US                    (18000) // what the DHT11 needs, the DHT22 is fine with it
+#define DHT_START_HIGH_US                   (20)
+// the capture ends on the first level lasting longer than this, our start pulse included
+#define DHT_RX_IDLE_US                      (DHT_START_LOW_US + 2000)
+#define DHT_FILTER_TICKS                    (100)
+#define DHT_RX_BUF_SIZE                     (512)
+#define DHT_BIT_1_US                        (48)    // the high time of a 0 is 26 us, of a 1 70 us
+#define DHT_DATA_BITS                       (40)
+// start pulse, response, 40 bits of at most 120 us and the idle time closing the capture
+#define DHT_DONE_US                         (DHT_START_LOW_US + 5000 + DHT_RX_IDLE_US + 5000)
+#define DHT_POLL_MS                         (10)
+
+#define DHT_TYPE_DHT11                      (11)
+#define DHT_TYPE_DHT22                      (22)
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+typedef enum {
+    DHT_STATE_NONE = 0,
+    DHT_STATE_PENDING,
+    DHT_STATE_OK,
+    DHT_STATE_TIMEOUT,
+    DHT_STATE_CHECKSUM,
+} dht_state_t;
+
+typedef struct _mach_dht_obj_t {
+    mp_obj_base_t base;
+    rmt_channel_t tx_channel;
+    rmt_channel_t rx_channel;
+    RingbufHandle_t rx_ring;
+    esp_timer_handle_t timer;
+    gpio_num_t gpio;
+    uint8_t type;
+    bool active;
+    volatile dht_state_t state;
+    uint8_t data[5];
+} mach_dht_obj_t;
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+// the high times once the sensor has answered: its response pulse, then one per bit
+STATIC dht_state_t dht_decode(const rmt_item32_t *items, size_t n_items, uint8_t *data) {
+    uint32_t highs[DHT_DATA_BITS + 2];
+    int n_highs = 0;
+    for (size_t i = 0; i < n_items; i++) {
+        uint32_t halves[2][2] = { { items[i].level0, items[i].duration0 }, { items[i].level1, items[i].duration1 } };
+        for (int h = 0; h < 2; h++) {
+            if (halves[h][0] == 1 && halves[h][1] > 0) {
+                // only the last ones matter, the bits come last
+                if (n_highs == MP_ARRAY_SIZE(highs)) {
+                    memmove(highs, highs + 1, sizeof(highs) - sizeof(highs[0]));
+                    n_highs--;
+                }
+                highs[n_highs++] = halves[h][1];
+            }
+        }
+    }
+    if (n_highs < DHT_DATA_BITS + 1) {
+        return DHT_STATE_TIMEOUT;
+    }
+    memset(data, 0, 5);
+    const uint32_t *bits = &highs[n_highs - DHT_DATA_BITS];
+    for (int i = 0; i < DHT_DATA_BITS; i++) {
+        data[i / 8] = (data[i / 8] << 1) | (bits[i] > DHT_BIT_1_US);
+    }
+    if (((data[0] + data[1] + data[2] + data[3]) & 0xFF) != data[4]) {
+        return DHT_STATE_CHECKSUM;
+    }
+    return DHT_STATE_OK;
+}
+
+// runs in the interrupts task, what keeps the object alive while pending goes away
+STATIC void dht_done(void *arg) {
+    mach_dht_obj_t *self = arg;
+    mp_obj_tuple_t *irq = mp_irq_find(self);
+    if (irq == NULL) {
+        return;
+    }
+    mp_obj_t handler = irq->items[1];
+    mp_irq_remove(self);
+    if (handler != mp_const_none) {
+        mp_call_function_1(handler, self);
+    }
+}
+
+// runs in the esp_timer task once the capture must be over
+STATIC void dht_capture_done(void *arg) {
+    mach_dht_obj_t *self = arg;
+    size_t size = 0;
+    rmt_item32_t *items = xRingbufferReceive(self->rx_ring, &size, 0);
+    rmt_rx_stop(self->rx_channel);
+    dht_state_t state = DHT_STATE_TIMEOUT;
+    if (items != NULL) {
+        state = dht_decode(items, size / sizeof(rmt_item32_t), self->data);
+        vRingbufferReturnItem(self->rx_ring, items);
+    }
+    self->state = state;
+    mp_irq_queue_interrupt_non_ISR(dht_done, self);
+}
+
+STATIC mach_dht_obj_t *dht_get_self(mp_obj_t self_in) {
+    mach_dht_obj_t *self = self_in;
+    if (!self->active) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_request_not_possible);
+    }
+    return self;
+}
+
+STATIC void dht_start(mach_dht_obj_t *self, mp_obj_t handler) {
+    if (self->state == DHT_STATE_PENDING) {
+        mp_raise_OSError(MP_EBUSY);
+    }
+    size_t size;
+    void *items;
+    while ((items = xRingbufferReceive(self->rx_ring, &size, 0)) != NULL) {
+        vRingbufferReturnItem(self->rx_ring, items);
+    }
+    mp_irq_add(self, handler);
+    self->state = DHT_STATE_PENDING;
+    // the RX channel records the whole exchange, our start pulse included
+    rmt_item32_t start = {{{ DHT_START_LOW_US, 0, DHT_START_HIGH_US, 1 }}};
+    rmt_rx_start(self->rx_channel, true);
+    if (rmt_write_items(self->tx_channel, &start, 1, false) != ESP_OK ||
+        esp_timer_start_once(self->timer, DHT_DONE_US) != ESP_OK) {
+        rmt_rx_stop(self->rx_channel);
+        mp_irq_remove(self);
+        self->state = DHT_STATE_NONE;
+        mp_raise_msg(&mp_type_OSError, mpexception_os_operation_failed);
+    }
+}
+
+STATIC void dht_wait(mach_dht_obj_t *self) {
+    MP_THREAD_GIL_EXIT();
+    while (self->state == DHT_STATE_PENDING) {
+        vTaskDelay(DHT_POLL_MS / portTICK_PERIOD_MS);
+    }
+    MP_THREAD_GIL_ENTER();
+}
+
+// the raw readings of the last measurement, raising if there's none
+STATIC const uint8_t *dht_get_data(mach_dht_obj_t *self) {
+    switch (self->state) {
+        case DHT_STATE_OK: return self->data;
+        case DHT_STATE_PENDING: mp_raise_OSError(MP_EINPROGRESS);
+        case DHT_STATE_CHECKSUM: mp_raise_OSError(MP_EIO);
+        default: mp_raise_OSError(MP_ETIMEDOUT);
+    }
+}
+
+STATIC mp_obj_t dht_temperature(mach_dht_obj_t *self) {
+    const uint8_t *data = dht_get_data(self);
+    if (self->type == DHT_TYPE_DHT11) {
+        return MP_OBJ_NEW_SMALL_INT(data[2]);
+    }
+    mp_float_t t = (((data[2] & 0x7F) << 8) | data[3]) * 0.1f;
+    return mp_obj_new_float((data[2] & 0x80) ? -t : t);
+}
+
+STATIC mp_obj_t dht_humidity(mach_dht_obj_t *self) {
+    const uint8_t *data = dht_get_data(self);
+    if (self->type == DHT_TYPE_DHT11) {
+        return MP_OBJ_NEW_SMALL_INT(data[0]);
+    }
+    return mp_obj_new_float(((data[0] << 8) | data[1]) * 0.1f);
+}
+
+/******************************************************************************/
+// MicroPython bindings
+
+/// \class DHT(pin, *, type=DHT.DHT22, channel=None)
+/// A DHT11 or DHT22 captured by an RMT channel instead of polling the pin with the
+/// interrupts disabled: a second channel on the same open drain pin sends the start
+/// pulse, and the answer is decoded from the recorded edges when it's over. Takes a
+/// pair of RMT channels; the pull-up of the sensor module is needed.
+STATIC mp_obj_t mach_dht_make_new(const mp_obj_type_t *type, mp_uint_t n_args, mp_uint_t n_kw, const mp_obj_t *all_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_pin,          MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_type,         MP_ARG_KW_ONLY | MP_ARG_INT,  {.u_int = DHT_TYPE_DHT22} },
+        { MP_QSTR_channel,      MP_ARG_KW_ONLY | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+    };
+    mp_map_t kw_args;
+    mp_map_init_fixed_table(&kw_args, n_kw, all_args + n_args);
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, all_args, &kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+
+    pin_obj_t *pin = pin_find(args[0].u_obj);
+    if (args[1].u_int != DHT_TYPE_DHT11 && args[1].u_int != DHT_TYPE_DHT22) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    mach_dht_obj_t *self = m_new_obj(mach_dht_obj_t);
+    self->base.type = type;
+    self->gpio = pin->pin_number;
+    self->type = args[1].u_int;
+    self->state = DHT_STATE_NONE;
+    self->tx_channel = machrmt_claim((args[2].u_obj == mp_const_none) ? -1 : mp_obj_get_int(args[2].u_obj), self->gpio);
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        self->rx_channel = machrmt_claim_rx(self->tx_channel);
+        nlr_pop();
+    } else {
+        machrmt_release(self->tx_channel);
+        nlr_jump(nlr.ret_val);
+    }
+
+    rmt_config_t tx_config = {
+        .rmt_mode = RMT_MODE_TX,
+        .channel = self->tx_channel,
+        .clk_div = DHT_CLK_DIV,
+        .gpio_num = self->gpio,
+        .mem_block_num = 1,
+        .tx_config = {
+            .loop_en = false,
+            .carrier_en = false,
+            .idle_level = RMT_IDLE_LEVEL_HIGH,
+            .idle_output_en = true,
+        }
+    };
+    rmt_config_t rx_config = {
+        .rmt_mode = RMT_MODE_RX,
+        .channel = self->rx_channel,
+        .clk_div = DHT_CLK_DIV,
+        .gpio_num = self->gpio,
+        .mem_block_num = 1,
+        .rx_config = {
+            .filter_en = true,
+            .filter_ticks_thresh = DHT_FILTER_TICKS,
+            .idle_threshold = DHT_RX_IDLE_US,
+        }
+    };
+    esp_timer_create_args_t timer_args = { .callback = dht_capture_done, .arg = self,
+                                           .dispatch_method = ESP_TIMER_TASK, .name = "dht" };
+    bool tx_installed = false;
+    bool ok = rmt_config(&tx_config) == ESP_OK && (tx_installed = (rmt_driver_install(self->tx_channel, 0, 0) == ESP_OK)) &&
+              rmt_config(&rx_config) == ESP_OK && rmt_driver_install(self->rx_channel, DHT_RX_BUF_SIZE, 0) == ESP_OK;
+    if (ok) {
+        rmt_get_ringbuf_handle(self->rx_channel, &self->rx_ring);
+        // both channels were routed to the pin by rmt_config(), the pad itself
+        // is made an open drain that can be read back
+        ok = gpio_set_direction(self->gpio, GPIO_MODE_INPUT_OUTPUT_OD) == ESP_OK &&
+             esp_timer_create(&timer_args, &self->timer) == ESP_OK;
+    }
+    if (!ok) {
+        if (tx_installed) {
+            rmt_driver_uninstall(self->tx_channel);
+        }
+        rmt_driver_uninstall(self->rx_channel);
+        machrmt_release(self->tx_channel);
+        machrmt_release(self->rx_channel);
+        mp_raise_msg(&mp_type_OSError, mpexception_os_operation_failed);
+    }
+    self->active = true;
+    return self;
+}
+
+/// \method measure(handler=None)
+/// Starts a measurement and returns at once, handler(dht) is called when it's over.
+/// The sensors need about 2 s (DHT22) or 1 s (DHT11) between two measurements.
+STATIC mp_obj_t mach_dht_measure(mp_uint_t n_args, const mp_obj_t *args) {
+    mach_dht_obj_t *self = dht_get_self(args[0]);
+    dht_start(self, n_args > 1 ? args[1] : mp_const_none);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mach_dht_measure_obj, 1, 2, mach_dht_measure);
+
+STATIC mp_obj_t mach_dht_pending(mp_obj_t self_in) {
+    mach_dht_obj_t *self = dht_get_self(self_in);
+    return mp_obj_new_bool(self->state == DHT_STATE_PENDING);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_dht_pending_obj, mach_dht_pending);
+
+/// \method read()
+/// A measurement waited for with the GIL released, returns (temperature, humidity).
+STATIC mp_obj_t mach_dht_read(mp_obj_t self_in) {
+    mach_dht_obj_t *self = dht_get_self(self_in);
+    dht_start(self, mp_const_none);
+    dht_wait(self);
+    mp_obj_t tuple[2] = { dht_temperature(self), dht_humidity(self) };
+    return mp_obj_new_tuple(2, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_dht_read_obj, mach_dht_read);
+
+/// \method temperature()
+/// Of the last measurement, OSError EINPROGRESS while it's pending, ETIMEDOUT when
+/// the sensor didn't answer and EIO on a checksum error.
+STATIC mp_obj_t mach_dht_temperature(mp_obj_t self_in) {
+    return dht_temperature(dht_get_self(self_in));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_dht_temperature_obj, mach_dht_temperature);
+
+STATIC mp_obj_t mach_dht_humidity(mp_obj_t self_in) {
+    return dht_humidity(dht_get_self(self_in));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_dht_humidity_obj, mach_dht_humidity);
+
+STATIC mp_obj_t mach_dht_deinit(mp_obj_t self_in) {
+    mach_dht_obj_t *self = self_in;
+    if (self->active) {
+        // a capture going on is let finish, its callbacks use the channels
+        dht_wait(self);
+        esp_timer_delete(self->timer);
+        rmt_driver_uninstall(self->tx_channel);
+        rmt_driver_uninstall(self->rx_channel);
+        machrmt_release(self->tx_channel);
+        machrmt_release(self->rx_channel);
+        gpio_set_direction(self->gpio, GPIO_MODE_INPUT);
+        self->active = false;
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_dht_deinit_obj, mach_dht_deinit);
+
+STATIC const mp_map_elem_t mach_dht_locals_dict_table[] = {
+    // instance methods
+    { MP_OBJ_NEW_QSTR(MP_QSTR_measure),             (mp_obj_t)&mach_dht_measure_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_pending),             (mp_obj_t)&mach_dht_pending_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_read),                (mp_obj_t)&mach_dht_read_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_temperature),         (mp_obj_t)&mach_dht_temperature_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_humidity),            (mp_obj_t)&mach_dht_humidity_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_deinit),              (mp_obj_t)&mach_dht_deinit_obj },
+
+    // class constants
+    { MP_OBJ_NEW_QSTR(MP_QSTR_DHT11),               MP_OBJ_NEW_SMALL_INT(DHT_TYPE_DHT11) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_DHT22),               MP_OBJ_NEW_SMALL_INT(DHT_TYPE_DHT22) },
+};
+STATIC MP_DEFINE_CONST_DICT(mach_dht_locals_dict, mach_dht_locals_dict_table);
+
+const mp_obj_type_t mach_dht_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_DHT,
+    .make_new = mach_dht_make_new,
+    .locals_dict = (mp_obj_t)&mach_dht_locals_dict,
+};
@@ -0,0 +1,15 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#ifndef MACHDHT_H_
+#define MACHDHT_H_
+
+extern const mp_obj_type_t mach_dht_type;
+
+#endif  // MACHDHT_H_
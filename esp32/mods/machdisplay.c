@@ -0,0 +1,711 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/builtin.h"
+#include "py/objarray.h"
+#include "py/mpthread.h"
+#include "py/mperrno.h"
+#include "esp32_mphal.h"
+#include "mpexception.h"
+#include "machpin.h"
+#include "machspi.h"
+#include "machine_i2c.h"
+#include "pycom_config.h"
+#include "machdisplay.h"
+
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define DISPLAY_QUEUE_LEN                   (4)
+#define DISPLAY_TASK_STACK_SIZE             (2048)
+#define DISPLAY_TASK_PRIORITY               (5)
+#define DISPLAY_CMD_MAX                     (32)
+
+#define SSD1306_PAGES_MAX                   (8)
+#define SSD1306_ADDR_DEFAULT                (0x3C)
+
+// SSD1306 commands
+#define SSD1306_SET_CONTRAST                (0x81)
+#define SSD1306_SET_ENTIRE_ON               (0xA4)
+#define SSD1306_SET_NORM_INV                (0xA6)
+#define SSD1306_SET_DISP                    (0xAE)
+#define SSD1306_SET_MEM_ADDR                (0x20)
+#define SSD1306_SET_COL_ADDR                (0x21)
+#define SSD1306_SET_PAGE_ADDR               (0x22)
+#define SSD1306_SET_DISP_START_LINE         (0x40)
+#define SSD1306_SET_SEG_REMAP               (0xA0)
+#define SSD1306_SET_MUX_RATIO               (0xA8)
+#define SSD1306_SET_COM_OUT_DIR             (0xC0)
+#define SSD1306_SET_DISP_OFFSET             (0xD3)
+#define SSD1306_SET_COM_PIN_CFG             (0xDA)
+#define SSD1306_SET_DISP_CLK_DIV            (0xD5)
+#define SSD1306_SET_PRECHARGE               (0xD9)
+#define SSD1306_SET_VCOM_DESEL              (0xDB)
+#define SSD1306_SET_CHARGE_PUMP             (0x8D)
+
+// SSD1306 I2C control bytes
+#define SSD1306_CTRL_CMD                    (0x00)  // Co=0, D/C#=0
+#define SSD1306_CTRL_DATA                   (0x40)  // Co=0, D/C#=1
+#define SSD1306_PAGE_CMD_LEN                (6)
+
+#define LCD160CR_ADDR_DEFAULT               (98)
+#define LCD160CR_FLUSH_TRIES                (5000)
+#define LCD160CR_SPI_WIN_LEN                (19)
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+typedef enum {
+    DISPLAY_SSD1306 = 0,
+    DISPLAY_LCD160CR,
+} display_kind_t;
+
+// the columns [x0, x1) of one page or row still to be sent, empty when x0 >= x1
+typedef struct {
+    uint16_t x0;
+    uint16_t x1;
+} display_span_t;
+
+typedef struct _mach_display_obj_t {
+    mp_obj_base_t base;
+    mp_obj_t buffer;
+    mp_obj_t fb;
+    mp_obj_t i2c;
+    mp_obj_t spi;
+    pin_obj_t *dc;
+    pin_obj_t *cs;
+    uint8_t *shadow;            // what the display shows once the last show() has been sent
+    uint8_t *tx_buf;            // the I2C segments of an SSD1306 update
+    display_span_t *spans;      // one per page (SSD1306) or per row (LCD160CR)
+    display_span_t win_x;       // the LCD160CR window to stream, spanning the rows below
+    display_span_t win_y;
+    uint32_t shows;
+    uint32_t bytes_sent;
+    uint32_t bytes_skipped;
+    uint16_t width;
+    uint16_t height;
+    uint16_t units;
+    uint16_t stride;
+    uint16_t addr;
+    uint8_t col_offset;
+    uint8_t kind;
+    bool full;
+    volatile bool busy;
+    volatile bool failed;
+} mach_display_obj_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+// the updates of every display are sent by a single task
+STATIC QueueHandle_t mach_display_queue;
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+STATIC void display_pin (pin_obj_t *pin, uint32_t value) {
+    if (pin) {
+        pin->value = value;
+        pin_set_value(pin);
+    }
+}
+
+STATIC bool display_spi_write (mach_display_obj_t *self, bool data, const uint8_t *buf, uint32_t len) {
+    display_pin(self->cs, 1);
+    display_pin(self->dc, data);
+    display_pin(self->cs, 0);
+    bool ok = machspi_write(self->spi, buf, len);
+    display_pin(self->cs, 1);
+    return ok;
+}
+
+STATIC bool ssd1306_write_cmds (mach_display_obj_t *self, const uint8_t *cmds, uint32_t len) {
+    if (self->i2c) {
+        uint8_t buf[DISPLAY_CMD_MAX + 1];
+        buf[0] = SSD1306_CTRL_CMD;
+        memcpy(&buf[1], cmds, len);
+        uint8_t *part = buf;
+        size_t part_len = len + 1;
+        return machine_i2c_write_parts(self->i2c, self->addr, &part, &part_len, 1);
+    }
+    return display_spi_write(self, false, cmds, len);
+}
+
+// the SSD1306 is in horizontal addressing mode, so each dirty page gets its own column and page
+// window; over I2C every window and its data go out as segments of a single transaction
+STATIC bool ssd1306_send (mach_display_obj_t *self) {
+    uint8_t *parts[2 * SSD1306_PAGES_MAX];
+    size_t lens[2 * SSD1306_PAGES_MAX];
+    size_t nparts = 0;
+    uint8_t *p = self->tx_buf;
+    for (uint32_t page = 0; page < self->units; page++) {
+        display_span_t *span = &self->spans[page];
+        if (span->x0 >= span->x1) {
+            continue;
+        }
+        uint8_t cmds[SSD1306_PAGE_CMD_LEN] = { SSD1306_SET_COL_ADDR, span->x0 + self->col_offset, span->x1 - 1 + self->col_offset,
+                                               SSD1306_SET_PAGE_ADDR, page, page };
+        const uint8_t *data = &self->shadow[page * self->stride + span->x0];
+        uint32_t len = span->x1 - span->x0;
+        if (self->i2c) {
+            p[0] = SSD1306_CTRL_CMD;
+            memcpy(&p[1], cmds, sizeof(cmds));
+            parts[nparts] = p;
+            lens[nparts++] = sizeof(cmds) + 1;
+            p += sizeof(cmds) + 1;
+            p[0] = SSD1306_CTRL_DATA;
+            memcpy(&p[1], data, len);
+            parts[nparts] = p;
+            lens[nparts++] = len + 1;
+            p += len + 1;
+        } else if (!display_spi_write(self, false, cmds, sizeof(cmds)) || !display_spi_write(self, true, data, len)) {
+            return false;
+        }
+    }
+    if (nparts > 0) {
+        return machine_i2c_write_parts(self->i2c, self->addr, parts, lens, nparts);
+    }
+    return true;
+}
+
+STATIC void lcd160cr_put16 (uint8_t *p, uint16_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+}
+
+// the same sequence as set_spi_win() followed by fast_spi() in the Python driver
+STATIC bool lcd160cr_send (mach_display_obj_t *self) {
+    if (self->win_y.x0 >= self->win_y.x1) {
+        return true;
+    }
+    uint32_t x = self->win_x.x0, w = self->win_x.x1 - self->win_x.x0;
+    uint32_t y = self->win_y.x0, h = self->win_y.x1 - self->win_y.x0;
+
+    // wait until the output queue of the display is empty
+    uint8_t level = 0;
+    for (uint32_t tries = LCD160CR_FLUSH_TRIES; ; tries--) {
+        if (!tries || !machine_i2c_read(self->i2c, self->addr + 1, &level, 1)) {
+            return false;
+        }
+        if (level >= 255) {
+            break;
+        }
+        vTaskDelay(1);
+    }
+
+    uint8_t win[LCD160CR_SPI_WIN_LEN] = { 2, 0x55, 10 };
+    lcd160cr_put16(&win[3], x);
+    lcd160cr_put16(&win[5], y);
+    lcd160cr_put16(&win[7], x + w - 1);
+    lcd160cr_put16(&win[9], y + h - 1);
+    lcd160cr_put16(&win[17], 0xffff);
+    uint8_t fast_spi[2] = { 2, 0x12 };
+    uint8_t *parts[1] = { win };
+    size_t lens[1] = { sizeof(win) };
+    if (!machine_i2c_write_parts(self->i2c, self->addr, parts, lens, 1)) {
+        return false;
+    }
+    parts[0] = fast_spi;
+    lens[0] = sizeof(fast_spi);
+    if (!machine_i2c_write_parts(self->i2c, self->addr, parts, lens, 1)) {
+        return false;
+    }
+
+    if (w == self->width) {
+        // whole rows are contiguous in the shadow
+        return machspi_write(self->spi, &self->shadow[y * self->stride], h * self->stride);
+    }
+    for (uint32_t row = y; row < y + h; row++) {
+        if (!machspi_write(self->spi, &self->shadow[row * self->stride + x * 2], w * 2)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+STATIC void TASK_DISPLAY (void *pvParameters) {
+    mach_display_obj_t *self;
+    for (;;) {
+        xQueueReceive(mach_display_queue, &self, portMAX_DELAY);
+        bool ok = (self->kind == DISPLAY_SSD1306) ? ssd1306_send(self) : lcd160cr_send(self);
+        self->failed = !ok;
+        self->busy = false;
+    }
+}
+
+STATIC void display_wait (mach_display_obj_t *self) {
+    if (self->busy) {
+        MP_THREAD_GIL_EXIT();
+        while (self->busy) {
+            vTaskDelay(1);
+        }
+        MP_THREAD_GIL_ENTER();
+    }
+}
+
+STATIC mach_display_obj_t *display_get_self (mp_obj_t self_in) {
+    mach_display_obj_t *self = self_in;
+    if (self->shadow == NULL) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_request_not_possible);
+    }
+    return self;
+}
+
+STATIC void display_free (mach_display_obj_t *self) {
+    display_wait(self);
+    heap_caps_free(self->shadow);
+    heap_caps_free(self->tx_buf);
+    heap_caps_free(self->spans);
+    self->shadow = NULL;
+    self->tx_buf = NULL;
+    self->spans = NULL;
+}
+
+// the buffer gets a FrameBuffer of its own, so that every drawing method works on the display
+STATIC void display_setup (mach_display_obj_t *self, qstr format, uint32_t units, uint32_t stride, uint32_t tx_len) {
+    size_t size = units * stride;
+    self->buffer = mp_obj_new_bytearray(size, NULL);
+    memset(((mp_obj_array_t *)MP_OBJ_TO_PTR(self->buffer))->items, 0, size);
+    mp_obj_t fb_args[4] = {
+        self->buffer,
+        MP_OBJ_NEW_SMALL_INT(self->width),
+        MP_OBJ_NEW_SMALL_INT(self->height),
+        mp_load_attr(MP_OBJ_FROM_PTR(&mp_module_framebuf), format),
+    };
+    self->fb = mp_call_function_n_kw(mp_load_attr(MP_OBJ_FROM_PTR(&mp_module_framebuf), MP_QSTR_FrameBuffer), 4, 0, fb_args);
+    self->units = units;
+    self->stride = stride;
+    self->full = true;
+    self->shadow = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+    self->spans = heap_caps_malloc(units * sizeof(display_span_t), MALLOC_CAP_8BIT);
+    if (tx_len) {
+        self->tx_buf = heap_caps_malloc(tx_len, MALLOC_CAP_8BIT);
+    }
+    if (self->shadow == NULL || self->spans == NULL || (tx_len && self->tx_buf == NULL)) {
+        display_free(self);
+        mp_raise_OSError(MP_ENOMEM);
+    }
+    if (mach_display_queue == NULL) {
+        mach_display_queue = xQueueCreate(DISPLAY_QUEUE_LEN, sizeof(mach_display_obj_t *));
+        xTaskCreatePinnedToCore(TASK_DISPLAY, "Display", DISPLAY_TASK_STACK_SIZE / sizeof(StackType_t), NULL,
+                                DISPLAY_TASK_PRIORITY, NULL, config_get_service_core());
+    }
+}
+
+// compares the units [u0, u1) with the shadow over the columns [x0, x1), narrowing each span to
+// the columns that really changed, and brings the shadow up to date
+STATIC uint32_t display_diff (mach_display_obj_t *self, uint32_t u0, uint32_t u1, uint32_t x0, uint32_t x1) {
+    const uint8_t *buf = ((mp_obj_array_t *)MP_OBJ_TO_PTR(self->buffer))->items;
+    uint32_t bpp = (self->kind == DISPLAY_SSD1306) ? 1 : 2;
+    uint32_t sent = 0;
+    for (uint32_t u = 0; u < self->units; u++) {
+        self->spans[u].x0 = self->spans[u].x1 = 0;
+    }
+    for (uint32_t u = u0; u < u1; u++) {
+        const uint8_t *row = &buf[u * self->stride];
+        uint8_t *shadow = &self->shadow[u * self->stride];
+        uint32_t c0 = x0, c1 = x1;
+        if (!self->full) {
+            while (c0 < c1 && !memcmp(&row[c0 * bpp], &shadow[c0 * bpp], bpp)) {
+                c0++;
+            }
+            while (c1 > c0 && !memcmp(&row[(c1 - 1) * bpp], &shadow[(c1 - 1) * bpp], bpp)) {
+                c1--;
+            }
+        }
+        if (c0 < c1) {
+            memcpy(&shadow[c0 * bpp], &row[c0 * bpp], (c1 - c0) * bpp);
+            self->spans[u].x0 = c0;
+            self->spans[u].x1 = c1;
+            sent += (c1 - c0) * bpp;
+        }
+    }
+    return sent;
+}
+
+// the LCD160CR takes a single window, so the dirty rows are merged into their bounding box
+STATIC uint32_t lcd160cr_merge (mach_display_obj_t *self) {
+    self->win_x.x0 = self->width;
+    self->win_x.x1 = 0;
+    self->win_y.x0 = self->win_y.x1 = 0;
+    for (uint32_t row = 0; row < self->units; row++) {
+        display_span_t *span = &self->spans[row];
+        if (span->x0 < span->x1) {
+            if (self->win_y.x0 >= self->win_y.x1) {
+                self->win_y.x0 = row;
+            }
+            self->win_y.x1 = row + 1;
+            self->win_x.x0 = MIN(self->win_x.x0, span->x0);
+            self->win_x.x1 = MAX(self->win_x.x1, span->x1);
+        }
+    }
+    if (self->win_y.x0 >= self->win_y.x1) {
+        return 0;
+    }
+    return (self->win_x.x1 - self->win_x.x0) * (self->win_y.x1 - self->win_y.x0) * 2;
+}
+
+STATIC void display_check_bus (mp_obj_t bus, const mp_obj_type_t *type) {
+    if (mp_obj_get_type(bus) != type) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+}
+
+STATIC void ssd1306_cmds (mach_display_obj_t *self, const uint8_t *cmds, uint32_t len) {
+    display_wait(self);
+    if (!ssd1306_write_cmds(self, cmds, len)) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_operation_failed);
+    }
+}
+
+/******************************************************************************/
+// MicroPython bindings
+
+// the methods of the display come first, everything else is looked up on its FrameBuffer
+STATIC void mach_display_attr (mp_obj_t self_in, qstr attr, mp_obj_t *dest) {
+    if (dest[0] != MP_OBJ_NULL) {
+        return;
+    }
+    mach_display_obj_t *self = self_in;
+    if (attr == MP_QSTR_buffer) {
+        dest[0] = self->buffer;
+        return;
+    }
+    const mp_obj_type_t *type = mp_obj_get_type(self_in);
+    mp_map_elem_t *elem = mp_map_lookup(&type->locals_dict->map, MP_OBJ_NEW_QSTR(attr), MP_MAP_LOOKUP);
+    if (elem != NULL) {
+        mp_convert_member_lookup(self_in, type, elem->value, dest);
+    } else if (self->fb != MP_OBJ_NULL) {
+        mp_load_method_maybe(self->fb, attr, dest);
+    }
+}
+
+/// \method show(full=False, wait=False)
+/// Sends what was drawn since the last call. The area drawn through the FrameBuffer
+/// methods is compared with what the display shows and only the columns that
+/// changed in each page (SSD1306) or the bounding box of the changed rows
+/// (LCD160CR) are sent, by a background task. full=True compares the whole
+/// buffer, which is needed after writing to it directly. Returns the number of
+/// bytes queued.
+STATIC mp_obj_t mach_display_show (mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_full, ARG_wait };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_full,                     MP_ARG_BOOL, {.u_bool = false} },
+        { MP_QSTR_wait,                     MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false} },
+    };
+    mach_display_obj_t *self = display_get_self(pos_args[0]);
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+
+    // the task reads the shadow and the spans until it's done
+    display_wait(self);
+
+    mp_obj_t dest[3];
+    mp_load_method(self->fb, MP_QSTR_dirty, dest);
+    dest[2] = mp_const_true;
+    mp_obj_t rect = mp_call_method_n_kw(1, 0, dest);
+
+    uint32_t x0 = 0, x1 = self->width, u0 = 0, u1 = self->units;
+    if (!self->full && !args[ARG_full].u_bool) {
+        if (rect == mp_const_none) {
+            u1 = 0;
+        } else {
+            mp_obj_t *items;
+            mp_obj_get_array_fixed_n(rect, 4, &items);
+            x0 = mp_obj_get_int(items[0]);
+            x1 = x0 + mp_obj_get_int(items[2]);
+            u0 = mp_obj_get_int(items[1]);
+            u1 = u0 + mp_obj_get_int(items[3]);
+            if (self->kind == DISPLAY_SSD1306) {
+                u0 /= 8;
+                u1 = (u1 + 7) / 8;
+            }
+        }
+    }
+    uint32_t sent = display_diff(self, u0, u1, x0, x1);
+    if (self->kind == DISPLAY_LCD160CR) {
+        sent = lcd160cr_merge(self);
+    }
+    self->full = false;
+    self->shows++;
+    self->bytes_sent += sent;
+    self->bytes_skipped += (self->units * self->stride) - sent;
+
+    if (sent > 0) {
+        self->busy = true;
+        self->failed = false;
+        xQueueSend(mach_display_queue, &self, portMAX_DELAY);
+        if (args[ARG_wait].u_bool) {
+            display_wait(self);
+            if (self->failed) {
+                // send it all again next time, the display is in an unknown state
+                self->full = true;
+                mp_raise_msg(&mp_type_OSError, mpexception_os_operation_failed);
+            }
+        }
+    }
+    return mp_obj_new_int_from_uint(sent);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_display_show_obj, 1, mach_display_show);
+
+/// \method busy()
+/// True while an update is being sent. The buses must not be used meanwhile.
+/// Raises OSError if the previous update failed.
+STATIC mp_obj_t mach_display_busy (mp_obj_t self_in) {
+    mach_display_obj_t *self = display_get_self(self_in);
+    if (self->busy) {
+        return mp_const_true;
+    }
+    if (self->failed) {
+        self->failed = false;
+        self->full = true;
+        mp_raise_msg(&mp_type_OSError, mpexception_os_operation_failed);
+    }
+    return mp_const_false;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_display_busy_obj, mach_display_busy);
+
+/// \method stats()
+/// (shows, bytes_sent, bytes_skipped)
+STATIC mp_obj_t mach_display_stats (mp_obj_t self_in) {
+    mach_display_obj_t *self = self_in;
+    mp_obj_t tuple[3] = {
+        mp_obj_new_int_from_uint(self->shows),
+        mp_obj_new_int_from_uint(self->bytes_sent),
+        mp_obj_new_int_from_uint(self->bytes_skipped),
+    };
+    return mp_obj_new_tuple(3, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_display_stats_obj, mach_display_stats);
+
+STATIC mp_obj_t mach_display_deinit (mp_obj_t self_in) {
+    display_free(self_in);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_display_deinit_obj, mach_display_deinit);
+
+// the GIL can't be released from within a collection, and an update takes a few ms at most
+STATIC mp_obj_t mach_display_del (mp_obj_t self_in) {
+    mach_display_obj_t *self = self_in;
+    while (self->busy) {
+        vTaskDelay(1);
+    }
+    display_free(self);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_display_del_obj, mach_display_del);
+
+/// \class SSD1306(width=128, height=64, *, i2c=None, addr=0x3C, spi=None, dc=None, cs=None, res=None, external_vcc=False)
+/// An SSD1306 OLED on a machine.I2C, or on a machine.SPI with the dc, cs and res pins.
+/// The FrameBuffer methods draw into its MONO_VLSB buffer and show() sends the changes.
+STATIC mp_obj_t mach_ssd1306_make_new (const mp_obj_type_t *type, mp_uint_t n_args, mp_uint_t n_kw, const mp_obj_t *all_args) {
+    enum { ARG_width, ARG_height, ARG_i2c, ARG_addr, ARG_spi, ARG_dc, ARG_cs, ARG_res, ARG_external_vcc };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_width,                    MP_ARG_INT, {.u_int = 128} },
+        { MP_QSTR_height,                   MP_ARG_INT, {.u_int = 64} },
+        { MP_QSTR_i2c,                      MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_addr,                     MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = SSD1306_ADDR_DEFAULT} },
+        { MP_QSTR_spi,                      MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_dc,                       MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_cs,                       MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_res,                      MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_external_vcc,             MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false} },
+    };
+    mp_map_t kw_args;
+    mp_map_init_fixed_table(&kw_args, n_kw, all_args + n_args);
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, all_args, &kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+
+    mp_int_t width = args[ARG_width].u_int;
+    mp_int_t height = args[ARG_height].u_int;
+    bool use_i2c = args[ARG_i2c].u_obj != mp_const_none;
+    if (width <= 0 || width > 128 || height <= 0 || height > 8 * SSD1306_PAGES_MAX || (height % 8) ||
+        use_i2c == (args[ARG_spi].u_obj != mp_const_none) || (!use_i2c && args[ARG_dc].u_obj == mp_const_none)) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+
+    mach_display_obj_t *self = m_new_obj_with_finaliser(mach_display_obj_t);
+    memset(self, 0, sizeof(*self));
+    self->base.type = &mach_ssd1306_type;
+    self->kind = DISPLAY_SSD1306;
+    self->width = width;
+    self->height = height;
+    // displays with a width of 64 pixels are shifted by 32
+    self->col_offset = (width == 64) ? 32 : 0;
+    if (use_i2c) {
+        display_check_bus(args[ARG_i2c].u_obj, &machine_i2c_type);
+        self->i2c = args[ARG_i2c].u_obj;
+        self->addr = args[ARG_addr].u_int;
+    } else {
+        display_check_bus(args[ARG_spi].u_obj, &mach_spi_type);
+        self->spi = args[ARG_spi].u_obj;
+        self->dc = pin_find(args[ARG_dc].u_obj);
+        pin_config(self->dc, -1, -1, GPIO_MODE_OUTPUT, MACHPIN_PULL_NONE, 0);
+        if (args[ARG_cs].u_obj != mp_const_none) {
+            self->cs = pin_find(args[ARG_cs].u_obj);
+            pin_config(self->cs, -1, -1, GPIO_MODE_OUTPUT, MACHPIN_PULL_NONE, 1);
+        }
+        if (args[ARG_res].u_obj != mp_const_none) {
+            pin_obj_t *res = pin_find(args[ARG_res].u_obj);
+            pin_config(res, -1, -1, GPIO_MODE_OUTPUT, MACHPIN_PULL_NONE, 1);
+            mp_hal_delay_ms(1);
+            display_pin(res, 0);
+            mp_hal_delay_ms(10);
+            display_pin(res, 1);
+        }
+    }
+    uint32_t pages = height / 8;
+    display_setup(self, MP_QSTR_MONO_VLSB, pages, width,
+                  use_i2c ? pages * (SSD1306_PAGE_CMD_LEN + 2 + width) : 0);
+
+    bool ext = args[ARG_external_vcc].u_bool;
+    const uint8_t init[] = {
+        SSD1306_SET_DISP | 0x00,                            // off
+        SSD1306_SET_MEM_ADDR, 0x00,                         // horizontal
+        SSD1306_SET_DISP_START_LINE | 0x00,
+        SSD1306_SET_SEG_REMAP | 0x01,                       // column addr 127 mapped to SEG0
+        SSD1306_SET_MUX_RATIO, height - 1,
+        SSD1306_SET_COM_OUT_DIR | 0x08,                     // scan from COM[N] to COM0
+        SSD1306_SET_DISP_OFFSET, 0x00,
+        SSD1306_SET_COM_PIN_CFG, (height == 32) ? 0x02 : 0x12,
+        SSD1306_SET_DISP_CLK_DIV, 0x80,
+        SSD1306_SET_PRECHARGE, ext ? 0x22 : 0xF1,
+        SSD1306_SET_VCOM_DESEL, 0x30,                       // 0.83 * Vcc
+        SSD1306_SET_CONTRAST, 0xFF,
+        SSD1306_SET_ENTIRE_ON,                              // output follows RAM contents
+        SSD1306_SET_NORM_INV,
+        SSD1306_SET_CHARGE_PUMP, ext ? 0x10 : 0x14,
+        SSD1306_SET_DISP | 0x01,                            // on
+    };
+    ssd1306_cmds(self, init, sizeof(init));
+    return self;
+}
+
+/// \method poweroff()
+STATIC mp_obj_t mach_ssd1306_poweroff (mp_obj_t self_in) {
+    const uint8_t cmd = SSD1306_SET_DISP | 0x00;
+    ssd1306_cmds(display_get_self(self_in), &cmd, 1);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_ssd1306_poweroff_obj, mach_ssd1306_poweroff);
+
+/// \method poweron()
+STATIC mp_obj_t mach_ssd1306_poweron (mp_obj_t self_in) {
+    const uint8_t cmd = SSD1306_SET_DISP | 0x01;
+    ssd1306_cmds(display_get_self(self_in), &cmd, 1);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_ssd1306_poweron_obj, mach_ssd1306_poweron);
+
+/// \method contrast(value)
+STATIC mp_obj_t mach_ssd1306_contrast (mp_obj_t self_in, mp_obj_t contrast) {
+    const uint8_t cmds[2] = { SSD1306_SET_CONTRAST, mp_obj_get_int(contrast) };
+    ssd1306_cmds(display_get_self(self_in), cmds, sizeof(cmds));
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mach_ssd1306_contrast_obj, mach_ssd1306_contrast);
+
+/// \method invert(invert)
+STATIC mp_obj_t mach_ssd1306_invert (mp_obj_t self_in, mp_obj_t invert) {
+    const uint8_t cmd = SSD1306_SET_NORM_INV | (mp_obj_is_true(invert) ? 1 : 0);
+    ssd1306_cmds(display_get_self(self_in), &cmd, 1);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mach_ssd1306_invert_obj, mach_ssd1306_invert);
+
+STATIC const mp_map_elem_t mach_ssd1306_locals_dict_table[] = {
+    { MP_OBJ_NEW_QSTR(MP_QSTR___del__),         (mp_obj_t)&mach_display_del_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_deinit),          (mp_obj_t)&mach_display_deinit_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_show),            (mp_obj_t)&mach_display_show_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_busy),            (mp_obj_t)&mach_display_busy_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_stats),           (mp_obj_t)&mach_display_stats_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_poweroff),        (mp_obj_t)&mach_ssd1306_poweroff_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_poweron),         (mp_obj_t)&mach_ssd1306_poweron_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_contrast),        (mp_obj_t)&mach_ssd1306_contrast_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_invert),          (mp_obj_t)&mach_ssd1306_invert_obj },
+};
+STATIC MP_DEFINE_CONST_DICT(mach_ssd1306_locals_dict, mach_ssd1306_locals_dict_table);
+
+const mp_obj_type_t mach_ssd1306_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_SSD1306,
+    .make_new = mach_ssd1306_make_new,
+    .attr = mach_display_attr,
+    .locals_dict = (mp_obj_t)&mach_ssd1306_locals_dict,
+};
+
+/// \class LCD160CR(i2c, spi, *, addr=98, width=128, height=160)
+/// The framebuffer path of the LCD160CR: an RGB565 FrameBuffer whose changes are
+/// sent by show() through a SPI window. The orientation, the power and the other
+/// commands stay with the Python driver, which can share both buses. width and
+/// height must match the orientation set on the display.
+STATIC mp_obj_t mach_lcd160cr_make_new (const mp_obj_type_t *type, mp_uint_t n_args, mp_uint_t n_kw, const mp_obj_t *all_args) {
+    enum { ARG_i2c, ARG_spi, ARG_addr, ARG_width, ARG_height };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_i2c,                      MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_spi,                      MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_addr,                     MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = LCD160CR_ADDR_DEFAULT} },
+        { MP_QSTR_width,                    MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 128} },
+        { MP_QSTR_height,                   MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 160} },
+    };
+    mp_map_t kw_args;
+    mp_map_init_fixed_table(&kw_args, n_kw, all_args + n_args);
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, all_args, &kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+
+    mp_int_t width = args[ARG_width].u_int;
+    mp_int_t height = args[ARG_height].u_int;
+    if (width <= 0 || width > 160 || height <= 0 || height > 160) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    display_check_bus(args[ARG_i2c].u_obj, &machine_i2c_type);
+    display_check_bus(args[ARG_spi].u_obj, &mach_spi_type);
+
+    mach_display_obj_t *self = m_new_obj_with_finaliser(mach_display_obj_t);
+    memset(self, 0, sizeof(*self));
+    self->base.type = &mach_lcd160cr_type;
+    self->kind = DISPLAY_LCD160CR;
+    self->width = width;
+    self->height = height;
+    self->i2c = args[ARG_i2c].u_obj;
+    self->spi = args[ARG_spi].u_obj;
+    self->addr = args[ARG_addr].u_int;
+    display_setup(self, MP_QSTR_RGB565, height, width * 2, 0);
+    return self;
+}
+
+STATIC const mp_map_elem_t mach_lcd160cr_locals_dict_table[] = {
+    { MP_OBJ_NEW_QSTR(MP_QSTR___del__),         (mp_obj_t)&mach_display_del_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_deinit),          (mp_obj_t)&mach_display_deinit_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_show),            (mp_obj_t)&mach_display_show_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_busy),            (mp_obj_t)&mach_display_busy_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_stats),           (mp_obj_t)&mach_display_stats_obj },
+};
+STATIC MP_DEFINE_CONST_DICT(mach_lcd160cr_locals_dict, mach_lcd160cr_locals_dict_table);
+
+const mp_obj_type_t mach_lcd160cr_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_LCD160CR,
+    .make_new = mach_lcd160cr_make_new,
+    .attr = mach_display_attr,
+    .locals_dict = (mp_obj_t)&mach_lcd160cr_locals_dict,
+};
@@ -0,0 +1,334 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/mpthread.h"
+#include "mpexception.h"
+#include "mpirq.h"
+#include "machpin.h"
+#include "pycom_config.h"
+#include "machi2s.h"
+
+#include "i2s.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define I2S_NUM                             (I2S_NUM_MAX)
+#define I2S_RATE_DEFAULT                    (16000)
+#define I2S_BUFFERS_DEFAULT                 (4)
+#define I2S_BUFFERS_MAX                     (128)
+#define I2S_BUFFER_LEN_DEFAULT              (256)       // frames per DMA buffer
+#define I2S_BUFFER_LEN_MAX                  (1024)
+#define I2S_EVENT_QUEUE_LEN                 (8)
+#define I2S_TASK_STACK_SIZE                 (2048)
+#define I2S_TASK_PRIORITY                   (6)
+
+#define I2S_FORMAT_MONO                     (0)
+#define I2S_FORMAT_STEREO                   (1)
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+typedef struct _mach_i2s_obj_t {
+    mp_obj_base_t base;
+    QueueHandle_t events;               // DMA buffer events from the driver, while enabled
+    TaskHandle_t task;
+    mp_obj_t handler;
+    mp_obj_t handler_arg;
+    uint8_t id;
+    uint8_t mode;
+    volatile bool stop;                 // set by deinit, cleared by the task once off the event queue
+    volatile bool pending;              // a callback is queued and hasn't run yet
+    bool enabled;
+} mach_i2s_obj_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+STATIC mach_i2s_obj_t mach_i2s_obj[I2S_NUM] = { {.id = I2S_NUM_0}, {.id = I2S_NUM_1} };
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+STATIC void i2s_callback_handler (void *arg) {
+    mach_i2s_obj_t *self = arg;
+    self->pending = false;
+    if (self->handler && self->handler != mp_const_none) {
+        mp_call_function_1(self->handler, self->handler_arg);
+    }
+}
+
+// Forwards the end of each DMA buffer to the callback, one queued call at a time
+// so that a slow handler doesn't flood the interrupt queue
+STATIC void TASK_I2S (void *pvParameters) {
+    mach_i2s_obj_t *self = pvParameters;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        i2s_event_t event;
+        while (xQueueReceive(self->events, &event, portMAX_DELAY) == pdTRUE && !self->stop) {
+            if ((event.type == I2S_EVENT_RX_DONE || event.type == I2S_EVENT_TX_DONE) &&
+                self->handler != NULL && !self->pending) {
+                self->pending = true;
+                mp_irq_queue_interrupt_non_ISR(i2s_callback_handler, (void *)self);
+            }
+        }
+        self->stop = false;
+    }
+}
+
+STATIC void i2s_hw_deinit (mach_i2s_obj_t *self) {
+    if (self->enabled) {
+        // get the task off the event queue before the driver deletes it
+        i2s_event_t wakeup = { .type = I2S_EVENT_MAX };
+        self->stop = true;
+        MP_THREAD_GIL_EXIT();
+        xQueueSend(self->events, &wakeup, portMAX_DELAY);
+        while (self->stop) {
+            vTaskDelay(1);
+        }
+        MP_THREAD_GIL_ENTER();
+        i2s_driver_uninstall(self->id);
+        self->events = NULL;
+        self->enabled = false;
+    }
+}
+
+STATIC mach_i2s_obj_t *i2s_get_self (mp_obj_t self_in) {
+    mach_i2s_obj_t *self = self_in;
+    if (!self->enabled) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_request_not_possible);
+    }
+    return self;
+}
+
+STATIC mp_obj_t mach_i2s_init_helper (mach_i2s_obj_t *self, const mp_arg_val_t *args) {
+    mp_int_t mode = args[0].u_int;
+    bool master = mode & I2S_MODE_MASTER;
+    bool tx = mode & I2S_MODE_TX;
+    // one role and one direction, full duplex isn't supported
+    if (master == !!(mode & I2S_MODE_SLAVE) || tx == !!(mode & I2S_MODE_RX) ||
+        (mode & ~(I2S_MODE_MASTER | I2S_MODE_SLAVE | I2S_MODE_TX | I2S_MODE_RX))) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    mp_obj_t *pins;
+    if (args[1].u_obj == MP_OBJ_NULL) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    mp_obj_get_array_fixed_n(args[1].u_obj, 3, &pins);
+    mp_int_t rate = args[2].u_int;
+    mp_int_t bits = args[3].u_int;
+    mp_int_t format = args[4].u_int;
+    mp_int_t buffers = args[5].u_int;
+    mp_int_t buffer_len = args[6].u_int;
+    if (rate <= 0 || (bits != 16 && bits != 24 && bits != 32) ||
+        (format != I2S_FORMAT_MONO && format != I2S_FORMAT_STEREO) ||
+        buffers < 2 || buffers > I2S_BUFFERS_MAX || buffer_len < 8 || buffer_len > I2S_BUFFER_LEN_MAX) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+
+    i2s_hw_deinit(self);
+    self->handler = NULL;
+    self->handler_arg = NULL;
+    self->pending = false;
+
+    i2s_config_t i2s_config = {
+        .mode = mode,
+        .sample_rate = rate,
+        .bits_per_sample = bits,
+        .channel_format = (format == I2S_FORMAT_MONO) ? I2S_CHANNEL_FMT_ONLY_LEFT : I2S_CHANNEL_FMT_RIGHT_LEFT,
+        .communication_format = I2S_COMM_FORMAT_I2S | I2S_COMM_FORMAT_I2S_MSB,
+        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
+        .dma_buf_count = buffers,
+        .dma_buf_len = buffer_len,
+        .use_apll = false,
+        .tx_desc_auto_clear = true,     // silence instead of repeating the last buffer on underrun
+    };
+    // fails as well when the ADC or the DAC stream through I2S0
+    if (i2s_driver_install(self->id, &i2s_config, I2S_EVENT_QUEUE_LEN, &self->events) != ESP_OK) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable);
+    }
+    i2s_pin_config_t pin_config = {
+        .bck_io_num = pin_find(pins[0])->pin_number,
+        .ws_io_num = pin_find(pins[1])->pin_number,
+        .data_out_num = tx ? pin_find(pins[2])->pin_number : I2S_PIN_NO_CHANGE,
+        .data_in_num = tx ? I2S_PIN_NO_CHANGE : pin_find(pins[2])->pin_number,
+    };
+    if (i2s_set_pin(self->id, &pin_config) != ESP_OK) {
+        i2s_driver_uninstall(self->id);
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    if (self->task == NULL) {
+        xTaskCreatePinnedToCore(TASK_I2S, "I2S", I2S_TASK_STACK_SIZE / sizeof(StackType_t), self,
+                                I2S_TASK_PRIORITY, &self->task, config_get_service_core());
+    }
+    self->mode = mode;
+    self->enabled = true;
+    xTaskNotifyGive(self->task);
+    return mp_const_none;
+}
+
+/******************************************************************************/
+// MicroPython bindings
+
+/// \class I2S(id=0, *, mode=I2S.MASTER | I2S.RX, pins=(SCK, WS, SD), rate=16000, bits=16, format=I2S.MONO, buffers=4, buffer_len=256)
+/// An I2S bus streaming through a ring of DMA buffers of buffer_len frames, so the
+/// samples keep flowing while Python is busy. SD is the data output for TX and the
+/// data input for RX. I2S0 is shared with the ADC and DAC streams.
+STATIC const mp_arg_t mach_i2s_init_args[] = {
+    { MP_QSTR_id,                          MP_ARG_INT, {.u_int = 0} },
+    { MP_QSTR_mode,                        MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = I2S_MODE_MASTER | I2S_MODE_RX} },
+    { MP_QSTR_pins,                        MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+    { MP_QSTR_rate,                        MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = I2S_RATE_DEFAULT} },
+    { MP_QSTR_bits,                        MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 16} },
+    { MP_QSTR_format,                      MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = I2S_FORMAT_MONO} },
+    { MP_QSTR_buffers,                     MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = I2S_BUFFERS_DEFAULT} },
+    { MP_QSTR_buffer_len,                  MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = I2S_BUFFER_LEN_DEFAULT} },
+};
+STATIC mp_obj_t mach_i2s_make_new (const mp_obj_type_t *type, mp_uint_t n_args, mp_uint_t n_kw, const mp_obj_t *all_args) {
+    mp_map_t kw_args;
+    mp_map_init_fixed_table(&kw_args, n_kw, all_args + n_args);
+    mp_arg_val_t args[MP_ARRAY_SIZE(mach_i2s_init_args)];
+    mp_arg_parse_all(n_args, all_args, &kw_args, MP_ARRAY_SIZE(args), mach_i2s_init_args, args);
+
+    if (args[0].u_int < 0 || args[0].u_int >= I2S_NUM) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable);
+    }
+    mach_i2s_obj_t *self = &mach_i2s_obj[args[0].u_int];
+    self->base.type = &mach_i2s_type;
+    mach_i2s_init_helper(self, &args[1]);
+    return self;
+}
+
+STATIC mp_obj_t mach_i2s_init (mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    mp_arg_val_t args[MP_ARRAY_SIZE(mach_i2s_init_args) - 1];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), &mach_i2s_init_args[1], args);
+    return mach_i2s_init_helper(pos_args[0], args);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_i2s_init_obj, 1, mach_i2s_init);
+
+STATIC mp_obj_t mach_i2s_deinit (mp_obj_t self_in) {
+    mach_i2s_obj_t *self = self_in;
+    i2s_hw_deinit(self);
+    mp_irq_remove(self);
+    INTERRUPT_OBJ_CLEAN(self);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_i2s_deinit_obj, mach_i2s_deinit);
+
+/// \method readinto(buf, *, timeout=-1)
+/// Fills buf with the samples received, waiting up to timeout ms for them (-1 waits
+/// for ever, 0 only takes what is in the DMA buffers). Returns the number of bytes read.
+STATIC mp_obj_t mach_i2s_readinto (mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_buf,                     MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_timeout,                 MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = -1} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+    mach_i2s_obj_t *self = i2s_get_self(pos_args[0]);
+    if (!(self->mode & I2S_MODE_RX)) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_request_not_possible);
+    }
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[0].u_obj, &bufinfo, MP_BUFFER_WRITE);
+    TickType_t ticks = (args[1].u_int < 0) ? portMAX_DELAY : args[1].u_int / portTICK_PERIOD_MS;
+
+    size_t read = 0;
+    MP_THREAD_GIL_EXIT();
+    i2s_read(self->id, bufinfo.buf, bufinfo.len, &read, ticks);
+    MP_THREAD_GIL_ENTER();
+    return mp_obj_new_int_from_uint(read);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_i2s_readinto_obj, 2, mach_i2s_readinto);
+
+/// \method write(buf, *, timeout=-1)
+/// Queues the samples of buf in the DMA buffers, waiting up to timeout ms for room
+/// (-1 waits for ever, 0 only fills the free ones). Returns the number of bytes taken.
+STATIC mp_obj_t mach_i2s_write (mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_buf,                     MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_timeout,                 MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = -1} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+    mach_i2s_obj_t *self = i2s_get_self(pos_args[0]);
+    if (!(self->mode & I2S_MODE_TX)) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_request_not_possible);
+    }
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[0].u_obj, &bufinfo, MP_BUFFER_READ);
+    TickType_t ticks = (args[1].u_int < 0) ? portMAX_DELAY : args[1].u_int / portTICK_PERIOD_MS;
+
+    size_t written = 0;
+    MP_THREAD_GIL_EXIT();
+    i2s_write(self->id, bufinfo.buf, bufinfo.len, &written, ticks);
+    MP_THREAD_GIL_ENTER();
+    return mp_obj_new_int_from_uint(written);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_i2s_write_obj, 2, mach_i2s_write);
+
+/// \method callback(handler, arg=None)
+/// Calls handler(arg) each time a DMA buffer has been filled (RX) or played (TX);
+/// with buffers=2 these are the half and full points of the ring. handler=None
+/// removes the callback.
+STATIC mp_obj_t mach_i2s_callback (mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_handler,                 MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_arg,                     MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+    mach_i2s_obj_t *self = i2s_get_self(pos_args[0]);
+
+    if (args[0].u_obj != mp_const_none) {
+        self->handler_arg = (args[1].u_obj == mp_const_none) ? self : args[1].u_obj;
+        self->handler = args[0].u_obj;
+        mp_irq_add(self, args[0].u_obj);
+    } else {
+        mp_irq_remove(self);
+        INTERRUPT_OBJ_CLEAN(self);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_i2s_callback_obj, 1, mach_i2s_callback);
+
+STATIC const mp_map_elem_t mach_i2s_locals_dict_table[] = {
+    // instance methods
+    { MP_OBJ_NEW_QSTR(MP_QSTR_init),                (mp_obj_t)&mach_i2s_init_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_deinit),              (mp_obj_t)&mach_i2s_deinit_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_readinto),            (mp_obj_t)&mach_i2s_readinto_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_write),               (mp_obj_t)&mach_i2s_write_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_callback),            (mp_obj_t)&mach_i2s_callback_obj },
+
+    // class constants
+    { MP_OBJ_NEW_QSTR(MP_QSTR_MASTER),              MP_OBJ_NEW_SMALL_INT(I2S_MODE_MASTER) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_SLAVE),               MP_OBJ_NEW_SMALL_INT(I2S_MODE_SLAVE) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_TX),                  MP_OBJ_NEW_SMALL_INT(I2S_MODE_TX) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_RX),                  MP_OBJ_NEW_SMALL_INT(I2S_MODE_RX) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_MONO),                MP_OBJ_NEW_SMALL_INT(I2S_FORMAT_MONO) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_STEREO),              MP_OBJ_NEW_SMALL_INT(I2S_FORMAT_STEREO) },
+};
+STATIC MP_DEFINE_CONST_DICT(mach_i2s_locals_dict, mach_i2s_locals_dict_table);
+
+const mp_obj_type_t mach_i2s_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_I2S,
+    .make_new = mach_i2s_make_new,
+    .locals_dict = (mp_obj_t)&mach_i2s_locals_dict,
+};
@@ -56,9 +56,12 @@
 #include "machpin.h"
 #include "pins.h"
 #include "mpexception.h"
+#include "mpirq.h"
+#include "pycom_config.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include "rom/ets_sys.h"
 #include "driver/i2c.h"
 #include "driver/gpio.h"
@@ -70,22 +73,46 @@ typedef struct _machine_i2c_obj_t {
     uint32_t baudrate;
     pin_obj_t *scl;
     pin_obj_t *sda;
+    volatile esp_err_t txn_status;
+    volatile bool txn_active;
     uint8_t bus_id;
 } machine_i2c_obj_t;
 
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    uint16_t addr;
+    uint8_t op;
+} machine_i2c_segment_t;
+
+typedef struct {
+    machine_i2c_obj_t *i2c_obj;
+    i2c_cmd_handle_t cmd;
+    TickType_t timeout;
+} machine_i2c_txn_t;
+
 #define MACHI2C_MASTER                          (0)
+#define MACHI2C_WRITE                           (0)
+#define MACHI2C_READ                            (1)
 #define I2C_ACK_CHECK_EN                        (1)
 #define I2C_ACK_VAL                             (0)
 #define I2C_NACK_VAL                            (1)
 
 
 STATIC void mp_hal_i2c_stop(machine_i2c_obj_t *self);
+STATIC void machine_i2c_txn_done (void *arg);
 
 STATIC machine_i2c_obj_t mach_i2c_obj[3];
 STATIC const mp_obj_t mach_i2c_def_pin[2] = {&PIN_MODULE_P9, &PIN_MODULE_P10};
 STATIC const uint32_t mach_i2c_pin_af[2][4] = { { I2CEXT0_SDA_OUT_IDX, I2CEXT0_SDA_IN_IDX, I2CEXT0_SCL_OUT_IDX, I2CEXT0_SCL_IN_IDX },
                                                 { I2CEXT1_SDA_OUT_IDX, I2CEXT1_SDA_IN_IDX, I2CEXT1_SCL_OUT_IDX, I2CEXT1_SCL_IN_IDX } };
 STATIC uint32_t isrmask;
+// transactions started with a handler are executed by a single task shared by both hardware buses
+STATIC QueueHandle_t mach_i2c_txn_queue;
+
+#define MACHI2C_TXN_QUEUE_LEN                   (2)
+#define MACHI2C_TXN_TASK_STACK_SIZE             (2048)
+#define MACHI2C_TXN_TASK_PRIORITY               (6)
 
 
 STATIC void mp_hal_i2c_delay(machine_i2c_obj_t *self) {
@@ -421,6 +448,102 @@ STATIC bool hw_i2c_slave_ping (machine_i2c_obj_t *i2c_obj, uint16_t slave_addr)
     return (ret == ESP_OK) ? true : false;
 }
 
+STATIC i2c_cmd_handle_t hw_i2c_master_build_txn (machine_i2c_segment_t *segs, size_t nsegs, bool stop, size_t *total) {
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    *total = 0;
+    for (size_t i = 0; i < nsegs; i++) {
+        // every segment after the first one begins with a repeated start
+        ESP_ERROR_CHECK(i2c_master_start(cmd));
+        if (segs[i].op == MACHI2C_READ) {
+            ESP_ERROR_CHECK(i2c_master_write_byte(cmd, (segs[i].addr << 1) | I2C_MASTER_READ, I2C_ACK_CHECK_EN));
+            if (segs[i].len > 1) {
+                ESP_ERROR_CHECK(i2c_master_read(cmd, segs[i].buf, segs[i].len - 1, I2C_ACK_VAL));
+            }
+            ESP_ERROR_CHECK(i2c_master_read_byte(cmd, segs[i].buf + segs[i].len - 1, I2C_NACK_VAL));
+        } else {
+            ESP_ERROR_CHECK(i2c_master_write_byte(cmd, (segs[i].addr << 1) | I2C_MASTER_WRITE, I2C_ACK_CHECK_EN));
+            if (segs[i].len > 0) {
+                ESP_ERROR_CHECK(i2c_master_write(cmd, segs[i].buf, segs[i].len, I2C_ACK_CHECK_EN));
+            }
+        }
+        *total += segs[i].len;
+    }
+    if (stop) {
+        ESP_ERROR_CHECK(i2c_master_stop(cmd));
+    }
+    return cmd;
+}
+
+STATIC void TASK_I2C (void *pvParameters) {
+    machine_i2c_txn_t txn;
+    for (;;) {
+        xQueueReceive(mach_i2c_txn_queue, &txn, portMAX_DELAY);
+        txn.i2c_obj->txn_status = i2c_master_cmd_begin(txn.i2c_obj->bus_id, txn.cmd, txn.timeout);
+        i2c_cmd_link_delete(txn.cmd);
+        txn.i2c_obj->txn_active = false;
+        mp_irq_queue_interrupt_non_ISR(machine_i2c_txn_done, (void *)txn.i2c_obj);
+    }
+}
+
+STATIC void mp_hal_i2c_transaction(machine_i2c_obj_t *self, machine_i2c_segment_t *segs, size_t nsegs, bool stop) {
+    for (size_t i = 0; i < nsegs; i++) {
+        mp_hal_i2c_start(self);
+        uint8_t *data = segs[i].buf;
+        size_t len = segs[i].len;
+        if (segs[i].op == MACHI2C_READ) {
+            if (!mp_hal_i2c_write_byte(self, (segs[i].addr << 1) | 1)) {
+                goto er;
+            }
+            while (len--) {
+                if (!mp_hal_i2c_read_byte(self, data++, len == 0)) {
+                    goto er;
+                }
+            }
+        } else {
+            if (!mp_hal_i2c_write_byte(self, segs[i].addr << 1)) {
+                goto er;
+            }
+            while (len--) {
+                if (!mp_hal_i2c_write_byte(self, *data++)) {
+                    goto er;
+                }
+            }
+        }
+    }
+    if (stop) {
+        mp_hal_i2c_stop(self);
+    }
+    return;
+
+er:
+    mp_hal_i2c_stop(self);
+    nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "I2C bus error"));
+}
+
+STATIC void machine_i2c_txn_wait (machine_i2c_obj_t *self) {
+    if (self->txn_active) {
+        MP_THREAD_GIL_EXIT();
+        while (self->txn_active) {
+            vTaskDelay(1);
+        }
+        MP_THREAD_GIL_ENTER();
+    }
+}
+
+STATIC void machine_i2c_txn_done (void *arg) {
+    machine_i2c_obj_t *self = arg;
+    mp_obj_tuple_t *irq = mp_irq_find(self);
+    if (irq == NULL) {
+        return;
+    }
+    // the handler, the segments and the results have been kept alive through the IRQ list until now
+    mp_obj_tuple_t *pending = MP_OBJ_TO_PTR(irq->items[1]);
+    mp_obj_t handler = pending->items[0];
+    mp_obj_t result = (self->txn_status == ESP_OK) ? pending->items[2] : mp_const_none;
+    mp_irq_remove(self);
+    mp_call_function_2(handler, self, result);
+}
+
 STATIC void i2c_deassign_pins_af (machine_i2c_obj_t *self) {
     if (self->sda && self->scl) {
         // we must set the value to 1 so that when Rx pins are deassigned, their are hardwired to 1
@@ -441,6 +564,72 @@ STATIC void i2c_validate_address_size(uint8_t addr_size) {
     }
 }
 
+/******************************************************************************/
+// Helpers for the native drivers, callable without the GIL: errors are returned, not raised
+
+// writes every part as its own segment of a single transaction, with a repeated start between them
+bool machine_i2c_write_parts (mp_obj_t self_in, uint16_t addr, uint8_t *const *parts, const size_t *lens, size_t nparts) {
+    machine_i2c_obj_t *self = self_in;
+    if (!self->baudrate || self->txn_active) {
+        return false;
+    }
+    if (self->bus_id < 2) {
+        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+        size_t total = 0;
+        for (size_t i = 0; i < nparts; i++) {
+            ESP_ERROR_CHECK(i2c_master_start(cmd));
+            ESP_ERROR_CHECK(i2c_master_write_byte(cmd, (addr << 1) | I2C_MASTER_WRITE, I2C_ACK_CHECK_EN));
+            if (lens[i] > 0) {
+                ESP_ERROR_CHECK(i2c_master_write(cmd, parts[i], lens[i], I2C_ACK_CHECK_EN));
+            }
+            total += lens[i];
+        }
+        ESP_ERROR_CHECK(i2c_master_stop(cmd));
+        esp_err_t ret = i2c_master_cmd_begin(self->bus_id, cmd, (5000 + (1000 * total)) / portTICK_RATE_MS);
+        i2c_cmd_link_delete(cmd);
+        return ret == ESP_OK;
+    }
+    for (size_t i = 0; i < nparts; i++) {
+        mp_hal_i2c_start(self);
+        if (!mp_hal_i2c_write_byte(self, addr << 1)) {
+            goto er;
+        }
+        for (size_t j = 0; j < lens[i]; j++) {
+            if (!mp_hal_i2c_write_byte(self, parts[i][j])) {
+                goto er;
+            }
+        }
+    }
+    mp_hal_i2c_stop(self);
+    return true;
+
+er:
+    mp_hal_i2c_stop(self);
+    return false;
+}
+
+bool machine_i2c_read (mp_obj_t self_in, uint16_t addr, uint8_t *buf, size_t len) {
+    machine_i2c_obj_t *self = self_in;
+    if (!self->baudrate || self->txn_active || len == 0) {
+        return false;
+    }
+    if (self->bus_id < 2) {
+        machine_i2c_segment_t seg = {.buf = buf, .len = len, .addr = addr, .op = MACHI2C_READ};
+        size_t total;
+        i2c_cmd_handle_t cmd = hw_i2c_master_build_txn(&seg, 1, true, &total);
+        esp_err_t ret = i2c_master_cmd_begin(self->bus_id, cmd, (5000 + (1000 * total)) / portTICK_RATE_MS);
+        i2c_cmd_link_delete(cmd);
+        return ret == ESP_OK;
+    }
+    mp_hal_i2c_start(self);
+    bool ok = mp_hal_i2c_write_byte(self, (addr << 1) | 1);
+    while (ok && len--) {
+        ok = mp_hal_i2c_read_byte(self, buf++, len == 0);
+    }
+    mp_hal_i2c_stop(self);
+    return ok;
+}
+
 /******************************************************************************/
 // MicroPython bindings for I2C
 
@@ -462,6 +651,7 @@ STATIC mp_obj_t machine_i2c_init_helper(machine_i2c_obj_t *self, const mp_arg_va
     // before assigning the baudrate
     if (self->bus_id < 2) {
         if (self->baudrate > 0) {
+            machine_i2c_txn_wait(self);
             i2c_driver_delete(self->bus_id);
         }
         i2c_deassign_pins_af(self);
@@ -735,15 +925,112 @@ STATIC mp_obj_t machine_i2c_writeto_mem(size_t n_args, const mp_obj_t *pos_args,
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(machine_i2c_writeto_mem_obj, 1, machine_i2c_writeto_mem);
 
+STATIC mp_obj_t machine_i2c_transaction(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_segments, ARG_stop, ARG_handler };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_segments, MP_ARG_REQUIRED | MP_ARG_OBJ,  },
+        { MP_QSTR_stop,     MP_ARG_KW_ONLY  | MP_ARG_BOOL, {.u_bool = true} },
+        { MP_QSTR_handler,  MP_ARG_KW_ONLY  | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+    };
+    machine_i2c_obj_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    mp_obj_t handler = args[ARG_handler].u_obj;
+    if (self->baudrate == 0 || (handler != mp_const_none && self->txn_active)) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_request_not_possible));
+    }
+
+    // each segment is (I2C.WRITE, addr, buf) or (I2C.READ, addr, buf_or_nbytes)
+    size_t nsegs;
+    mp_obj_t *items;
+    mp_obj_get_array(args[ARG_segments].u_obj, &nsegs, &items);
+    if (nsegs == 0) {
+        goto invalid_args;
+    }
+    machine_i2c_segment_t *segs = m_new(machine_i2c_segment_t, nsegs);
+    mp_obj_t results = mp_obj_new_list(0, NULL);
+    for (size_t i = 0; i < nsegs; i++) {
+        mp_obj_t *seg;
+        mp_obj_get_array_fixed_n(items[i], 3, &seg);
+        segs[i].op = mp_obj_get_int(seg[0]);
+        segs[i].addr = mp_obj_get_int(seg[1]);
+        mp_buffer_info_t bufinfo;
+        if (segs[i].op == MACHI2C_READ) {
+            if (MP_OBJ_IS_INT(seg[2])) {
+                size_t nbytes = mp_obj_get_int(seg[2]);
+                mp_obj_t buf = mp_obj_new_bytearray_by_ref(nbytes, m_new0(byte, nbytes));
+                mp_get_buffer_raise(buf, &bufinfo, MP_BUFFER_WRITE);
+                mp_obj_list_append(results, buf);
+            } else {
+                mp_get_buffer_raise(seg[2], &bufinfo, MP_BUFFER_WRITE);
+                mp_obj_list_append(results, seg[2]);
+            }
+            if (bufinfo.len == 0) {
+                goto invalid_args;
+            }
+        } else if (segs[i].op == MACHI2C_WRITE) {
+            mp_get_buffer_raise(seg[2], &bufinfo, MP_BUFFER_READ);
+        } else {
+            goto invalid_args;
+        }
+        segs[i].buf = bufinfo.buf;
+        segs[i].len = bufinfo.len;
+    }
+
+    if (self->bus_id < 2) {
+        size_t total;
+        i2c_cmd_handle_t cmd = hw_i2c_master_build_txn(segs, nsegs, args[ARG_stop].u_bool, &total);
+        m_del(machine_i2c_segment_t, segs, nsegs);
+        TickType_t timeout = (5000 + (1000 * total)) / portTICK_RATE_MS;
+        if (handler != mp_const_none) {
+            if (mach_i2c_txn_queue == NULL) {
+                mach_i2c_txn_queue = xQueueCreate(MACHI2C_TXN_QUEUE_LEN, sizeof(machine_i2c_txn_t));
+                xTaskCreatePinnedToCore(TASK_I2C, "I2C", MACHI2C_TXN_TASK_STACK_SIZE / sizeof(StackType_t), NULL,
+                                        MACHI2C_TXN_TASK_PRIORITY, NULL, config_get_service_core());
+            }
+            // the command link only points to the buffers, so keep them reachable until the handler runs
+            mp_obj_t pending[3] = { handler, args[ARG_segments].u_obj, results };
+            mp_irq_add(self, mp_obj_new_tuple(3, pending));
+            self->txn_active = true;
+            machine_i2c_txn_t txn = { .i2c_obj = self, .cmd = cmd, .timeout = timeout };
+            xQueueSend(mach_i2c_txn_queue, &txn, portMAX_DELAY);
+            return mp_const_none;
+        }
+        MP_THREAD_GIL_EXIT();
+        esp_err_t ret = i2c_master_cmd_begin(self->bus_id, cmd, timeout);
+        MP_THREAD_GIL_ENTER();
+        i2c_cmd_link_delete(cmd);
+        if (ret != ESP_OK) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "I2C bus error"));
+        }
+    } else {
+        // the software bus can't run in the background, the handler is called right away
+        mp_hal_i2c_transaction(self, segs, nsegs, args[ARG_stop].u_bool);
+        m_del(machine_i2c_segment_t, segs, nsegs);
+        if (handler != mp_const_none) {
+            mp_call_function_2(handler, self, results);
+            return mp_const_none;
+        }
+    }
+    return results;
+
+invalid_args:
+    nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(machine_i2c_transaction_obj, 1, machine_i2c_transaction);
+
 STATIC mp_obj_t machine_i2c_deinit(mp_obj_t self_in) {
     machine_i2c_obj_t *self = self_in;
 
     if (self->baudrate > 0) {
         // before assigning the baudrate
         if (self->bus_id < 2) {
+            machine_i2c_txn_wait(self);
             i2c_driver_delete(self->bus_id);
             i2c_deassign_pins_af(self);
         }
+        mp_irq_remove(self);
         // invalidate the baudrate
         self->baudrate = 0;
     }
@@ -767,7 +1054,12 @@ STATIC const mp_rom_map_elem_t machine_i2c_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_readfrom_mem_into),   (mp_obj_t)&machine_i2c_readfrom_mem_into_obj },
     { MP_ROM_QSTR(MP_QSTR_writeto_mem),         (mp_obj_t)&machine_i2c_writeto_mem_obj },
 
+    // batched operations
+    { MP_ROM_QSTR(MP_QSTR_transaction),         (mp_obj_t)&machine_i2c_transaction_obj },
+
     { MP_OBJ_NEW_QSTR(MP_QSTR_MASTER),          MP_OBJ_NEW_SMALL_INT(MACHI2C_MASTER) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_READ),            MP_OBJ_NEW_SMALL_INT(MACHI2C_READ) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_WRITE),           MP_OBJ_NEW_SMALL_INT(MACHI2C_WRITE) },
 };
 
 STATIC MP_DEFINE_CONST_DICT(machine_i2c_locals_dict, machine_i2c_locals_dict_table);
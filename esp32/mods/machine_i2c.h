@@ -42,4 +42,7 @@
 
 extern const mp_obj_type_t machine_i2c_type;
 
+extern bool machine_i2c_write_parts (mp_obj_t self_in, uint16_t addr, uint8_t *const *parts, const size_t *lens, size_t nparts);
+extern bool machine_i2c_read (mp_obj_t self_in, uint16_t addr, uint8_t *buf, size_t len);
+
 #endif // __MICROPY_INCLUDED_EXTMOD_MACHINE_I2C_H__
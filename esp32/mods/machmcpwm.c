@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/gc.h"
+#include "py/mperrno.h"
+#include "mpexception.h"
+#include "machpin.h"
+#include "machmcpwm.h"
+
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_intr_alloc.h"
+#include "driver/mcpwm.h"
+#include "soc/mcpwm_reg.h"
+#include "soc/mcpwm_struct.h"
+#include "freertos/FreeRTOS.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define MACHMCPWM_DEAD_TIME_NS              (100)   // the unit of the dead time registers
+#define MACHMCPWM_DEAD_TIME_MAX             (0xFFFF)
+#define MACHMCPWM_SEQUENCE_MAX              (4096)
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+// A duty sequence played by the TEZ (timer equal zero) interrupt: the compare value
+// written there is latched by the hardware at the start of the next period
+typedef struct {
+    uint16_t *samples;                      // duty cycles out of 65535, internal RAM
+    uint32_t len;
+    uint32_t pos;
+    uint32_t divider;                       // periods per sample
+    uint32_t count;
+    bool loop;
+    bool done;                              // the end was reached without loop
+} machmcpwm_sequence_t;
+
+typedef struct _mach_mcpwm_obj_t {
+    mp_obj_base_t base;
+    uint8_t id;
+    int8_t pin_b;                           // -1 without a B output
+    bool complementary;                     // B is A inverted, with the dead time
+    uint32_t freq;
+    float duty[2];
+} mach_mcpwm_obj_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+STATIC machmcpwm_sequence_t *machmcpwm_sequences[MACHMCPWM_NUM_TIMERS];
+STATIC bool machmcpwm_isr_installed[MCPWM_UNIT_MAX];
+static portMUX_TYPE machmcpwm_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+STATIC inline mcpwm_dev_t *machmcpwm_dev(int unit) {
+    return (unit == MCPWM_UNIT_0) ? &MCPWM0 : &MCPWM1;
+}
+
+STATIC IRAM_ATTR void machmcpwm_isr(void *arg) {
+    int unit = (int)arg;
+    mcpwm_dev_t *dev = machmcpwm_dev(unit);
+    uint32_t status = dev->int_st.val;
+    dev->int_clr.val = status;
+
+    portENTER_CRITICAL_ISR(&machmcpwm_mux);
+    for (int timer = 0; timer < MCPWM_TIMER_MAX; timer++) {
+        machmcpwm_sequence_t *seq = machmcpwm_sequences[unit * MCPWM_TIMER_MAX + timer];
+        if (!(status & (MCPWM_TIMER0_TEZ_INT_ST_M << timer)) || seq == NULL || seq->done || --seq->count > 0) {
+            continue;
+        }
+        seq->count = seq->divider;
+        uint32_t period = dev->timer[timer].period.period;
+        dev->channel[timer].cmpr_value[MCPWM_OPR_A].cmpr_val = (period * seq->samples[seq->pos]) / 0xFFFF;
+        if (++seq->pos == seq->len) {
+            if (seq->loop) {
+                seq->pos = 0;
+            } else {
+                // the last duty cycle stays
+                seq->done = true;
+            }
+        }
+    }
+    portEXIT_CRITICAL_ISR(&machmcpwm_mux);
+}
+
+STATIC void machmcpwm_check(esp_err_t err) {
+    if (err != ESP_OK) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_operation_failed);
+    }
+}
+
+STATIC void machmcpwm_set_dead_time(mach_mcpwm_obj_t *self, mp_obj_t dead_time_o) {
+    int unit = self->id / MCPWM_TIMER_MAX;
+    int timer = self->id % MCPWM_TIMER_MAX;
+    if (dead_time_o == mp_const_none) {
+        self->complementary = false;
+        machmcpwm_check(mcpwm_deadtime_disable(unit, timer));
+        return;
+    }
+    mp_int_t rising, falling;
+    if (MP_OBJ_IS_SMALL_INT(dead_time_o)) {
+        rising = falling = mp_obj_get_int(dead_time_o);
+    } else {
+        mp_obj_t *items;
+        mp_obj_get_array_fixed_n(dead_time_o, 2, &items);
+        rising = mp_obj_get_int(items[0]);
+        falling = mp_obj_get_int(items[1]);
+    }
+    rising /= MACHMCPWM_DEAD_TIME_NS;
+    falling /= MACHMCPWM_DEAD_TIME_NS;
+    if (self->pin_b < 0 || rising < 0 || falling < 0 || rising > MACHMCPWM_DEAD_TIME_MAX || falling > MACHMCPWM_DEAD_TIME_MAX) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    self->complementary = true;
+    machmcpwm_check(mcpwm_deadtime_enable(unit, timer, MCPWM_ACTIVE_HIGH_COMPLIMENT_MODE, rising, falling));
+}
+
+STATIC void machmcpwm_set_duty(mach_mcpwm_obj_t *self, int op, float duty) {
+    if (duty > 1.0f) {
+        duty = 1.0f;
+    } else if (duty < 0.0f) {
+        duty = 0.0f;
+    }
+    self->duty[op] = duty;
+    machmcpwm_check(mcpwm_set_duty(self->id / MCPWM_TIMER_MAX, self->id % MCPWM_TIMER_MAX, op, duty * 100.0f));
+}
+
+STATIC void machmcpwm_sequence_stop(int id) {
+    portENTER_CRITICAL(&machmcpwm_mux);
+    machmcpwm_sequence_t *seq = machmcpwm_sequences[id];
+    machmcpwm_sequences[id] = NULL;
+    portEXIT_CRITICAL(&machmcpwm_mux);
+    if (seq) {
+        mcpwm_dev_t *dev = machmcpwm_dev(id / MCPWM_TIMER_MAX);
+        dev->int_ena.val &= ~(MCPWM_TIMER0_TEZ_INT_ENA_M << (id % MCPWM_TIMER_MAX));
+        heap_caps_free(seq->samples);
+        heap_caps_free(seq);
+    }
+}
+
+STATIC mach_mcpwm_obj_t *machmcpwm_get_self (mp_obj_t self_in) {
+    mach_mcpwm_obj_t *self = self_in;
+    if (MP_STATE_PORT(mach_mcpwm_obj[self->id]) != self) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_request_not_possible);
+    }
+    return self;
+}
+
+/******************************************************************************/
+// MicroPython bindings
+
+/// \class MCPWM(id, *, freq, pin_a, pin_b=None, duty=0.5, dead_time_ns=None)
+/// One of the 6 motor control PWM timers, driving up to two outputs. With
+/// dead_time_ns (one value or a (rising, falling) pair) B is the complement of A
+/// with the given gaps, otherwise A and B have their own duty cycles.
+STATIC mp_obj_t mach_mcpwm_make_new(const mp_obj_type_t *type, mp_uint_t n_args, mp_uint_t n_kw, const mp_obj_t *all_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_id,           MP_ARG_REQUIRED | MP_ARG_INT,                   },
+        { MP_QSTR_freq,         MP_ARG_REQUIRED | MP_ARG_KW_ONLY | MP_ARG_INT,  },
+        { MP_QSTR_pin_a,        MP_ARG_REQUIRED | MP_ARG_KW_ONLY | MP_ARG_OBJ,  },
+        { MP_QSTR_pin_b,        MP_ARG_KW_ONLY | MP_ARG_OBJ,                    {.u_obj = mp_const_none} },
+        { MP_QSTR_duty,         MP_ARG_KW_ONLY | MP_ARG_OBJ,                    {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_dead_time_ns, MP_ARG_KW_ONLY | MP_ARG_OBJ,                    {.u_obj = mp_const_none} },
+    };
+    mp_map_t kw_args;
+    mp_map_init_fixed_table(&kw_args, n_kw, all_args + n_args);
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, all_args, &kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+
+    mp_uint_t id = args[0].u_int;
+    if (id >= MACHMCPWM_NUM_TIMERS) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable);
+    }
+    if (args[1].u_int <= 0) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    int unit = id / MCPWM_TIMER_MAX;
+    int timer = id % MCPWM_TIMER_MAX;
+
+    if (MP_STATE_PORT(mach_mcpwm_obj[id]) != NULL) {
+        machmcpwm_sequence_stop(id);
+    }
+    mach_mcpwm_obj_t *self = m_new_obj(mach_mcpwm_obj_t);
+    self->base.type = type;
+    self->id = id;
+    self->freq = args[1].u_int;
+    self->pin_b = -1;
+    self->complementary = false;
+
+    pin_obj_t *pin_a = pin_find(args[2].u_obj);
+    machmcpwm_check(mcpwm_gpio_init(unit, MCPWM0A + timer * 2, pin_a->pin_number));
+    if (args[3].u_obj != mp_const_none) {
+        pin_obj_t *pin_b = pin_find(args[3].u_obj);
+        self->pin_b = pin_b->pin_number;
+        machmcpwm_check(mcpwm_gpio_init(unit, MCPWM0B + timer * 2, self->pin_b));
+    }
+
+    float duty = (args[4].u_obj == MP_OBJ_NULL) ? 0.5f : mp_obj_get_float(args[4].u_obj);
+    mcpwm_config_t config = {
+        .frequency = self->freq,
+        .cmpr_a = 0,
+        .cmpr_b = 0,
+        .counter_mode = MCPWM_UP_COUNTER,
+        .duty_mode = MCPWM_DUTY_MODE_0,
+    };
+    machmcpwm_check(mcpwm_init(unit, timer, &config));
+    MP_STATE_PORT(mach_mcpwm_obj[id]) = self;
+
+    machmcpwm_set_duty(self, MCPWM_OPR_A, duty);
+    machmcpwm_set_duty(self, MCPWM_OPR_B, duty);
+    machmcpwm_set_dead_time(self, args[5].u_obj);
+    return self;
+}
+
+/// \method duty([a, b])
+/// The compare registers are shadowed, a new duty cycle starts with the next period.
+STATIC mp_obj_t mach_mcpwm_duty(mp_uint_t n_args, const mp_obj_t *args) {
+    mach_mcpwm_obj_t *self = machmcpwm_get_self(args[0]);
+    if (n_args == 1) {
+        if (self->pin_b < 0 || self->complementary) {
+            return mp_obj_new_float(self->duty[MCPWM_OPR_A]);
+        }
+        mp_obj_t tuple[2] = { mp_obj_new_float(self->duty[MCPWM_OPR_A]), mp_obj_new_float(self->duty[MCPWM_OPR_B]) };
+        return mp_obj_new_tuple(2, tuple);
+    }
+    if (machmcpwm_sequences[self->id]) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_request_not_possible);
+    }
+    machmcpwm_set_duty(self, MCPWM_OPR_A, mp_obj_get_float(args[1]));
+    machmcpwm_set_duty(self, MCPWM_OPR_B, mp_obj_get_float((n_args > 2) ? args[2] : args[1]));
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mach_mcpwm_duty_obj, 1, 3, mach_mcpwm_duty);
+
+/// \method freq([freq])
+STATIC mp_obj_t mach_mcpwm_freq(mp_uint_t n_args, const mp_obj_t *args) {
+    mach_mcpwm_obj_t *self = machmcpwm_get_self(args[0]);
+    if (n_args == 1) {
+        return mp_obj_new_int_from_uint(self->freq);
+    }
+    mp_int_t freq = mp_obj_get_int(args[1]);
+    if (freq <= 0) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    self->freq = freq;
+    machmcpwm_check(mcpwm_set_frequency(self->id / MCPWM_TIMER_MAX, self->id % MCPWM_TIMER_MAX, freq));
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mach_mcpwm_freq_obj, 1, 2, mach_mcpwm_freq);
+
+/// \method dead_time(dead_time_ns)
+/// Sets the gaps between A and B, None switches back to independent outputs.
+STATIC mp_obj_t mach_mcpwm_dead_time(mp_obj_t self_in, mp_obj_t dead_time_o) {
+    machmcpwm_set_dead_time(machmcpwm_get_self(self_in), dead_time_o);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mach_mcpwm_dead_time_obj, mach_mcpwm_dead_time);
+
+/// \method sequence(samples, *, divider=1, loop=True)
+/// Plays the duty cycles of output A from samples (an array of 16 bit values out of
+/// 65535), one every divider periods, from the timer interrupt with no Python code
+/// running. sequence(None) stops, leaving the last value.
+STATIC mp_obj_t mach_mcpwm_sequence(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_samples,      MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_divider,      MP_ARG_KW_ONLY | MP_ARG_INT,  {.u_int = 1} },
+        { MP_QSTR_loop,         MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = true} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+    mach_mcpwm_obj_t *self = machmcpwm_get_self(pos_args[0]);
+
+    machmcpwm_sequence_stop(self->id);
+    if (args[0].u_obj == mp_const_none) {
+        return mp_const_none;
+    }
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[0].u_obj, &bufinfo, MP_BUFFER_READ);
+    uint32_t len = bufinfo.len / sizeof(uint16_t);
+    if (len == 0 || len > MACHMCPWM_SEQUENCE_MAX || args[1].u_int < 1) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    // the interrupt runs from IRAM, so the samples can't stay in the heap (maybe in PSRAM)
+    machmcpwm_sequence_t *seq = heap_caps_malloc(sizeof(machmcpwm_sequence_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    uint16_t *samples = heap_caps_malloc(len * sizeof(uint16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (seq == NULL || samples == NULL) {
+        heap_caps_free(seq);
+        heap_caps_free(samples);
+        mp_raise_OSError(MP_ENOMEM);
+    }
+    memcpy(samples, bufinfo.buf, len * sizeof(uint16_t));
+    seq->samples = samples;
+    seq->len = len;
+    seq->pos = 0;
+    seq->divider = seq->count = args[1].u_int;
+    seq->loop = args[2].u_bool;
+    seq->done = false;
+
+    int unit = self->id / MCPWM_TIMER_MAX;
+    int timer = self->id % MCPWM_TIMER_MAX;
+    if (!machmcpwm_isr_installed[unit]) {
+        machmcpwm_check(mcpwm_isr_register(unit, machmcpwm_isr, (void *)unit, ESP_INTR_FLAG_IRAM, NULL));
+        machmcpwm_isr_installed[unit] = true;
+    }
+    portENTER_CRITICAL(&machmcpwm_mux);
+    machmcpwm_sequences[self->id] = seq;
+    portEXIT_CRITICAL(&machmcpwm_mux);
+    mcpwm_dev_t *dev = machmcpwm_dev(unit);
+    dev->int_clr.val = MCPWM_TIMER0_TEZ_INT_CLR_M << timer;
+    dev->int_ena.val |= MCPWM_TIMER0_TEZ_INT_ENA_M << timer;
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_mcpwm_sequence_obj, 1, mach_mcpwm_sequence);
+
+STATIC mp_obj_t mach_mcpwm_deinit(mp_obj_t self_in) {
+    mach_mcpwm_obj_t *self = self_in;
+    if (MP_STATE_PORT(mach_mcpwm_obj[self->id]) == self) {
+        machmcpwm_sequence_stop(self->id);
+        mcpwm_stop(self->id / MCPWM_TIMER_MAX, self->id % MCPWM_TIMER_MAX);
+        MP_STATE_PORT(mach_mcpwm_obj[self->id]) = NULL;
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_mcpwm_deinit_obj, mach_mcpwm_deinit);
+
+STATIC const mp_map_elem_t mach_mcpwm_locals_dict_table[] = {
+    // instance methods
+    { MP_OBJ_NEW_QSTR(MP_QSTR_duty),                (mp_obj_t)&mach_mcpwm_duty_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_freq),                (mp_obj_t)&mach_mcpwm_freq_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_dead_time),           (mp_obj_t)&mach_mcpwm_dead_time_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_sequence),            (mp_obj_t)&mach_mcpwm_sequence_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_deinit),              (mp_obj_t)&mach_mcpwm_deinit_obj },
+};
+STATIC MP_DEFINE_CONST_DICT(mach_mcpwm_locals_dict, mach_mcpwm_locals_dict_table);
+
+const mp_obj_type_t mach_mcpwm_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_MCPWM,
+    .make_new = mach_mcpwm_make_new,
+    .locals_dict = (mp_obj_t)&mach_mcpwm_locals_dict,
+};
@@ -0,0 +1,17 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#ifndef MACHMCPWM_H_
+#define MACHMCPWM_H_
+
+#define MACHMCPWM_NUM_TIMERS                (6)     // 3 per unit
+
+extern const mp_obj_type_t mach_mcpwm_type;
+
+#endif  // MACHMCPWM_H_
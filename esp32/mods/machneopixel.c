@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/mpthread.h"
+#include "py/mperrno.h"
+#include "mpexception.h"
+#include "machpin.h"
+#include "machrmt.h"
+#include "machneopixel.h"
+
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "rom/ets_sys.h"
+#include "driver/rmt.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+// 40 MHz ticks at 800 kHz, the 400 kHz parts take the same items at half the clock
+#define NEOPIXEL_CLK_DIV_800KHZ             (2)
+#define NEOPIXEL_CLK_DIV_400KHZ             (4)
+#define NEOPIXEL_T0H                        (14)    // 350 ns
+#define NEOPIXEL_T0L                        (34)    // 850 ns
+#define NEOPIXEL_T1H                        (28)    // 700 ns
+#define NEOPIXEL_T1L                        (20)    // 500 ns
+#define NEOPIXEL_BIT_NS_800KHZ              (1200)
+#define NEOPIXEL_RESET_US                   (80)    // low time latching the colours
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+typedef struct _mach_neopixel_obj_t {
+    mp_obj_base_t base;
+    rmt_channel_t channel;
+    bool active;
+    uint8_t bpp;
+    uint8_t order[4];               // byte offset in a pixel of R, G, B and W
+    uint8_t clk_div;
+    uint32_t n;
+    uint8_t *tx_buf;                // what the RMT interrupt reads from, in internal RAM
+    int64_t tx_end_us;              // when the last show() is off the wire
+    uint8_t buf[];                  // the pixels in wire order
+} mach_neopixel_obj_t;
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+// Called by the RMT driver from its threshold interrupt, refilling half of the
+// channel memory at a time: the strip only ever costs one item per bit there
+STATIC void IRAM_ATTR neopixel_translate(const void *src, rmt_item32_t *dest, size_t src_size,
+                                         size_t wanted_num, size_t *translated_size, size_t *item_num) {
+    const rmt_item32_t bit0 = {{{ NEOPIXEL_T0H, 1, NEOPIXEL_T0L, 0 }}};
+    const rmt_item32_t bit1 = {{{ NEOPIXEL_T1H, 1, NEOPIXEL_T1L, 0 }}};
+    const uint8_t *psrc = src;
+    size_t size = 0;
+    size_t num = 0;
+    while (size < src_size && num + 8 <= wanted_num) {
+        uint8_t byte = *psrc++;
+        for (int i = 7; i >= 0; i--) {
+            (dest++)->val = (byte & (1 << i)) ? bit1.val : bit0.val;
+        }
+        num += 8;
+        size++;
+    }
+    *translated_size = size;
+    *item_num = num;
+}
+
+STATIC mach_neopixel_obj_t *neopixel_get_self(mp_obj_t self_in) {
+    mach_neopixel_obj_t *self = self_in;
+    if (!self->active) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_request_not_possible);
+    }
+    return self;
+}
+
+STATIC void neopixel_wait(mach_neopixel_obj_t *self) {
+    MP_THREAD_GIL_EXIT();
+    rmt_wait_tx_done(self->channel, portMAX_DELAY);
+    MP_THREAD_GIL_ENTER();
+}
+
+STATIC void neopixel_set_pixel(mach_neopixel_obj_t *self, uint32_t index, mp_obj_t color_in) {
+    mp_obj_t *color;
+    mp_obj_get_array_fixed_n(color_in, self->bpp, &color);
+    uint8_t *pixel = &self->buf[index * self->bpp];
+    for (int i = 0; i < self->bpp; i++) {
+        pixel[self->order[i]] = mp_obj_get_int(color[i]);
+    }
+}
+
+/******************************************************************************/
+// MicroPython bindings
+
+/// \class NeoPixel(pin, n, *, bpp=3, order='GRB', channel=None, timing=1)
+/// WS2812 type LED strips on an RMT channel. The pixels are kept in wire order and
+/// turned into RMT items by the channel interrupt while sending, and show() returns
+/// while the strip is updated, so strips on different channels send in parallel.
+/// timing=0 for the 400 kHz parts. order names the colours in wire order.
+STATIC mp_obj_t mach_neopixel_make_new(const mp_obj_type_t *type, mp_uint_t n_args, mp_uint_t n_kw, const mp_obj_t *all_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_pin,          MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_n,            MP_ARG_REQUIRED | MP_ARG_INT, },
+        { MP_QSTR_bpp,          MP_ARG_KW_ONLY | MP_ARG_INT,  {.u_int = 3} },
+        { MP_QSTR_order,        MP_ARG_KW_ONLY | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+        { MP_QSTR_channel,      MP_ARG_KW_ONLY | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+        { MP_QSTR_timing,       MP_ARG_KW_ONLY | MP_ARG_INT,  {.u_int = 1} },
+    };
+    mp_map_t kw_args;
+    mp_map_init_fixed_table(&kw_args, n_kw, all_args + n_args);
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, all_args, &kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+
+    pin_obj_t *pin = pin_find(args[0].u_obj);
+    mp_int_t n = args[1].u_int;
+    mp_int_t bpp = args[2].u_int;
+    if (n <= 0 || (bpp != 3 && bpp != 4)) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    const char *order = (bpp == 3) ? "GRB" : "GRBW";
+    if (args[3].u_obj != mp_const_none) {
+        size_t len;
+        order = mp_obj_str_get_data(args[3].u_obj, &len);
+        if (len != bpp) {
+            mp_raise_ValueError(mpexception_value_invalid_arguments);
+        }
+    }
+
+    mach_neopixel_obj_t *self = m_new_obj_var(mach_neopixel_obj_t, uint8_t, n * bpp);
+    self->base.type = type;
+    self->n = n;
+    self->bpp = bpp;
+    self->clk_div = args[5].u_int ? NEOPIXEL_CLK_DIV_800KHZ : NEOPIXEL_CLK_DIV_400KHZ;
+    self->tx_end_us = 0;
+    memset(self->buf, 0, n * bpp);
+    // order is given in wire order, the setters go through RGB(W)
+    for (int i = 0; i < bpp; i++) {
+        const char *pos = memchr("RGBW", order[i], bpp);
+        if (pos == NULL || memchr(order, order[i], i) != NULL) {
+            mp_raise_ValueError(mpexception_value_invalid_arguments);
+        }
+        self->order[pos - "RGBW"] = i;
+    }
+
+    self->channel = machrmt_claim((args[4].u_obj == mp_const_none) ? -1 : mp_obj_get_int(args[4].u_obj), pin->pin_number);
+    self->tx_buf = heap_caps_malloc(n * bpp, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (self->tx_buf == NULL) {
+        machrmt_release(self->channel);
+        mp_raise_OSError(MP_ENOMEM);
+    }
+
+    rmt_config_t config = {
+        .rmt_mode = RMT_MODE_TX,
+        .channel = self->channel,
+        .clk_div = self->clk_div,
+        .gpio_num = pin->pin_number,
+        .mem_block_num = 1,
+        .tx_config = {
+            .loop_en = false,
+            .carrier_en = false,
+            .idle_level = RMT_IDLE_LEVEL_LOW,
+            .idle_output_en = true,
+        }
+    };
+    if (rmt_config(&config) != ESP_OK || rmt_driver_install(self->channel, 0, 0) != ESP_OK ||
+        rmt_translator_init(self->channel, neopixel_translate) != ESP_OK) {
+        machrmt_release(self->channel);
+        heap_caps_free(self->tx_buf);
+        mp_raise_msg(&mp_type_OSError, mpexception_os_operation_failed);
+    }
+    self->active = true;
+    return self;
+}
+
+/// \method show(wait=False)
+/// Sends the pixels. A show() still going on is waited for first, the pixels can
+/// be changed as soon as it returns.
+STATIC mp_obj_t mach_neopixel_show(mp_uint_t n_args, const mp_obj_t *args) {
+    mach_neopixel_obj_t *self = neopixel_get_self(args[0]);
+    neopixel_wait(self);
+    while (esp_timer_get_time() < self->tx_end_us + NEOPIXEL_RESET_US) {
+        ets_delay_us(10);
+    }
+    size_t size = self->n * self->bpp;
+    memcpy(self->tx_buf, self->buf, size);
+    self->tx_end_us = esp_timer_get_time() +
+                      ((int64_t)size * 8 * NEOPIXEL_BIT_NS_800KHZ * (self->clk_div / NEOPIXEL_CLK_DIV_800KHZ)) / 1000;
+    if (rmt_write_sample(self->channel, self->tx_buf, size, false) != ESP_OK) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_operation_failed);
+    }
+    if (n_args > 1 && mp_obj_is_true(args[1])) {
+        neopixel_wait(self);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mach_neopixel_show_obj, 1, 2, mach_neopixel_show);
+
+STATIC mp_obj_t mach_neopixel_wait(mp_obj_t self_in) {
+    neopixel_wait(neopixel_get_self(self_in));
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_neopixel_wait_obj, mach_neopixel_wait);
+
+STATIC mp_obj_t mach_neopixel_fill(mp_obj_t self_in, mp_obj_t color) {
+    mach_neopixel_obj_t *self = self_in;
+    neopixel_set_pixel(self, 0, color);
+    for (uint32_t i = 1; i < self->n; i++) {
+        memcpy(&self->buf[i * self->bpp], self->buf, self->bpp);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mach_neopixel_fill_obj, mach_neopixel_fill);
+
+STATIC mp_obj_t mach_neopixel_deinit(mp_obj_t self_in) {
+    mach_neopixel_obj_t *self = self_in;
+    if (self->active) {
+        neopixel_wait(self);
+        rmt_driver_uninstall(self->channel);
+        machrmt_release(self->channel);
+        heap_caps_free(self->tx_buf);
+        self->tx_buf = NULL;
+        self->active = false;
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_neopixel_deinit_obj, mach_neopixel_deinit);
+
+STATIC mp_obj_t mach_neopixel_subscr(mp_obj_t self_in, mp_obj_t index_in, mp_obj_t value) {
+    mach_neopixel_obj_t *self = self_in;
+    if (value == MP_OBJ_NULL) {
+        return MP_OBJ_NULL; // op not supported
+    }
+    size_t index = mp_get_index(self->base.type, self->n, index_in, false);
+    if (value == MP_OBJ_SENTINEL) {
+        mp_obj_t color[4];
+        uint8_t *pixel = &self->buf[index * self->bpp];
+        for (int i = 0; i < self->bpp; i++) {
+            color[i] = MP_OBJ_NEW_SMALL_INT(pixel[self->order[i]]);
+        }
+        return mp_obj_new_tuple(self->bpp, color);
+    }
+    neopixel_set_pixel(self, index, value);
+    return mp_const_none;
+}
+
+STATIC mp_obj_t mach_neopixel_unary_op(mp_unary_op_t op, mp_obj_t self_in) {
+    mach_neopixel_obj_t *self = self_in;
+    switch (op) {
+        case MP_UNARY_OP_BOOL: return mp_obj_new_bool(self->n != 0);
+        case MP_UNARY_OP_LEN: return MP_OBJ_NEW_SMALL_INT(self->n);
+        default: return MP_OBJ_NULL; // op not supported
+    }
+}
+
+// the pixels in wire order, for filling the strip from a buffer in one go
+STATIC mp_int_t mach_neopixel_get_buffer(mp_obj_t self_in, mp_buffer_info_t *bufinfo, mp_uint_t flags) {
+    mach_neopixel_obj_t *self = self_in;
+    bufinfo->buf = self->buf;
+    bufinfo->len = self->n * self->bpp;
+    bufinfo->typecode = 'B';
+    return 0;
+}
+
+STATIC const mp_map_elem_t mach_neopixel_locals_dict_table[] = {
+    // instance methods
+    { MP_OBJ_NEW_QSTR(MP_QSTR_show),                (mp_obj_t)&mach_neopixel_show_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_wait),                (mp_obj_t)&mach_neopixel_wait_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_fill),                (mp_obj_t)&mach_neopixel_fill_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_deinit),              (mp_obj_t)&mach_neopixel_deinit_obj },
+};
+STATIC MP_DEFINE_CONST_DICT(mach_neopixel_locals_dict, mach_neopixel_locals_dict_table);
+
+const mp_obj_type_t mach_neopixel_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_NeoPixel,
+    .make_new = mach_neopixel_make_new,
+    .unary_op = mach_neopixel_unary_op,
+    .subscr = mach_neopixel_subscr,
+    .buffer_p = { .get_buffer = mach_neopixel_get_buffer },
+    .locals_dict = (mp_obj_t)&mach_neopixel_locals_dict,
+};
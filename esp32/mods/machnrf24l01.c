@@ -0,0 +1,964 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/mpthread.h"
+#include "py/mperrno.h"
+#include "esp32_mphal.h"
+#include "mpexception.h"
+#include "machpin.h"
+#include "pins.h"
+#include "pycom_config.h"
+#include "machnrf24l01.h"
+
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "rom/ets_sys.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "driver/spi_master.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define NRF24_BAUDRATE_DEFAULT              (8000000)
+#define NRF24_BAUDRATE_MAX                  (10000000)
+#define NRF24_RX_DEPTH_DEFAULT              (32)
+#define NRF24_PAYLOAD_MAX                   (32)
+#define NRF24_PIPES                         (6)
+#define NRF24_ADDR_LEN                      (5)
+#define NRF24_XFER_BUF_SIZE                 (NRF24_PAYLOAD_MAX + 4)
+#define NRF24_TASK_STACK_SIZE               (2048)
+#define NRF24_TASK_PRIORITY                 (6)     // above the MicroPython threads, the chip only holds 3 packets
+#define NRF24_CE_PULSE_US                   (15)    // needs to be >10 us
+#define NRF24_SETTLE_US                     (130)
+#define NRF24_POWER_UP_MS                   (5)
+
+// registers
+#define NRF24_CONFIG                        (0x00)
+#define NRF24_EN_AA                         (0x01)
+#define NRF24_EN_RXADDR                     (0x02)
+#define NRF24_SETUP_AW                      (0x03)
+#define NRF24_SETUP_RETR                    (0x04)
+#define NRF24_RF_CH                         (0x05)
+#define NRF24_RF_SETUP                      (0x06)
+#define NRF24_STATUS                        (0x07)
+#define NRF24_RX_ADDR_P0                    (0x0A)
+#define NRF24_TX_ADDR                       (0x10)
+#define NRF24_RX_PW_P0                      (0x11)
+#define NRF24_DYNPD                         (0x1C)
+#define NRF24_FEATURE                       (0x1D)
+
+// CONFIG register
+#define NRF24_EN_CRC                        (0x08)
+#define NRF24_CRCO                          (0x04)
+#define NRF24_PWR_UP                        (0x02)
+#define NRF24_PRIM_RX                       (0x01)
+
+// RF_SETUP register
+#define NRF24_POWER_0                       (0x00)  // -18 dBm
+#define NRF24_POWER_1                       (0x02)  // -12 dBm
+#define NRF24_POWER_2                       (0x04)  // -6 dBm
+#define NRF24_POWER_3                       (0x06)  // 0 dBm
+#define NRF24_SPEED_1M                      (0x00)
+#define NRF24_SPEED_2M                      (0x08)
+#define NRF24_SPEED_250K                    (0x20)
+#define NRF24_RF_SETUP_MASK                 (0xD1)
+
+// STATUS register
+#define NRF24_RX_DR                         (0x40)
+#define NRF24_TX_DS                         (0x20)
+#define NRF24_MAX_RT                        (0x10)
+#define NRF24_RX_P_NO(status)               (((status) >> 1) & 0x07)
+#define NRF24_RX_P_NO_EMPTY                 (0x07)
+#define NRF24_TX_FULL                       (0x01)
+
+// FEATURE register
+#define NRF24_EN_DPL                        (0x04)
+#define NRF24_EN_ACK_PAY                    (0x02)
+
+// instructions
+#define NRF24_W_REGISTER                    (0x20)
+#define NRF24_R_RX_PL_WID                   (0x60)
+#define NRF24_R_RX_PAYLOAD                  (0x61)
+#define NRF24_W_TX_PAYLOAD                  (0xA0)
+#define NRF24_W_ACK_PAYLOAD                 (0xA8)
+#define NRF24_FLUSH_TX                      (0xE1)
+#define NRF24_FLUSH_RX                      (0xE2)
+#define NRF24_ACTIVATE                      (0x50)  // the FEATURE register of the nRF24L01 without the +
+#define NRF24_ACTIVATE_KEY                  (0x73)
+#define NRF24_NOP                           (0xFF)
+
+#define NRF24_TX_NONE                       (0)
+#define NRF24_TX_OK                         (1)
+#define NRF24_TX_FAIL                       (2)
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+typedef struct {
+    uint8_t len;
+    uint8_t data[NRF24_PAYLOAD_MAX];
+} nrf24_packet_t;
+
+typedef struct {
+    nrf24_packet_t *slots;
+    uint16_t head;
+    uint16_t count;
+} nrf24_ring_t;
+
+typedef struct {
+    uint32_t rx;
+    uint32_t dropped;       // the ring of the pipe was full
+    uint32_t tx;
+    uint32_t tx_failed;
+} nrf24_stats_t;
+
+typedef struct _mach_nrf24l01_obj_t {
+    mp_obj_base_t base;
+    spi_device_handle_t dev;
+    uint8_t *tx_buf;
+    uint8_t *rx_buf;
+    SemaphoreHandle_t mutex;            // the bus, the rings and the state below
+    SemaphoreHandle_t rx_sem;           // given by the task when it stores packets
+    SemaphoreHandle_t tx_sem;           // given by the task when the chip is done sending
+    TaskHandle_t task;
+    pin_obj_t *ce;
+    pin_obj_t *irq;
+    nrf24_ring_t ring[NRF24_PIPES];
+    nrf24_stats_t stats;
+    uint16_t rx_depth;
+    uint8_t pipe0_addr[NRF24_ADDR_LEN];
+    uint8_t payload_size;               // 0 for dynamic payloads
+    uint8_t config;
+    uint8_t next_pipe;                  // where recv() looks first, so that no pipe starves
+    volatile uint8_t tx_result;
+    bool pipe0_set;
+    bool listening;
+    uint8_t host;
+    bool enabled;
+} mach_nrf24l01_obj_t;
+
+/******************************************************************************
+ DECLARE PRIVATE FUNCTIONS
+ ******************************************************************************/
+STATIC IRAM_ATTR void nrf24_intr_handler_0 (void);
+#if defined(WIPY) || defined(GPY)
+STATIC IRAM_ATTR void nrf24_intr_handler_1 (void);
+#endif
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+#if defined(WIPY) || defined(GPY)
+STATIC mach_nrf24l01_obj_t mach_nrf24l01_obj[2] = { {.host = HSPI_HOST}, {.host = VSPI_HOST} };
+STATIC const mp_obj_t mach_nrf24l01_def_pin[2][3] = { {&PIN_MODULE_P10, &PIN_MODULE_P11, &PIN_MODULE_P14},
+                                                      {&PIN_MODULE_P19, &PIN_MODULE_P20, &PIN_MODULE_P21} };
+STATIC void (*const mach_nrf24l01_intr_handler[2])(void) = { nrf24_intr_handler_0, nrf24_intr_handler_1 };
+#else
+STATIC mach_nrf24l01_obj_t mach_nrf24l01_obj[1] = { {.host = HSPI_HOST} };
+STATIC const mp_obj_t mach_nrf24l01_def_pin[1][3] = { {&PIN_MODULE_P10, &PIN_MODULE_P11, &PIN_MODULE_P14} };
+STATIC void (*const mach_nrf24l01_intr_handler[1])(void) = { nrf24_intr_handler_0 };
+#endif
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+STATIC IRAM_ATTR void nrf24_intr (mach_nrf24l01_obj_t *self) {
+    BaseType_t woken = pdFALSE;
+    // SPI can't be used from here, the task reads the chip
+    vTaskNotifyGiveFromISR(self->task, &woken);
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+STATIC IRAM_ATTR void nrf24_intr_handler_0 (void) {
+    nrf24_intr(&mach_nrf24l01_obj[0]);
+}
+
+#if defined(WIPY) || defined(GPY)
+STATIC IRAM_ATTR void nrf24_intr_handler_1 (void) {
+    nrf24_intr(&mach_nrf24l01_obj[1]);
+}
+#endif
+
+// The functions below are called with the mutex taken and the GIL released
+
+// one instruction and its data in a single burst, returns STATUS which the chip
+// shifts out while it receives the instruction
+STATIC uint8_t nrf24_cmd (mach_nrf24l01_obj_t *self, uint8_t cmd, const uint8_t *tx, uint8_t *rx, uint32_t len) {
+    self->tx_buf[0] = cmd;
+    if (tx) {
+        memcpy(self->tx_buf + 1, tx, len);
+    } else {
+        memset(self->tx_buf + 1, NRF24_NOP, len);
+    }
+    spi_transaction_t t;
+    memset(&t, 0, sizeof(t));
+    t.length = (len + 1) * 8;
+    t.tx_buffer = self->tx_buf;
+    t.rx_buffer = self->rx_buf;
+    spi_device_transmit(self->dev, &t);
+    if (rx) {
+        memcpy(rx, self->rx_buf + 1, len);
+    }
+    return self->rx_buf[0];
+}
+
+STATIC uint8_t nrf24_reg_read (mach_nrf24l01_obj_t *self, uint8_t reg) {
+    uint8_t value;
+    nrf24_cmd(self, reg, NULL, &value, 1);
+    return value;
+}
+
+STATIC uint8_t nrf24_reg_write (mach_nrf24l01_obj_t *self, uint8_t reg, uint8_t value) {
+    return nrf24_cmd(self, NRF24_W_REGISTER | reg, &value, NULL, 1);
+}
+
+STATIC void nrf24_set_config (mach_nrf24l01_obj_t *self, uint8_t config) {
+    if (config != self->config) {
+        self->config = config;
+        nrf24_reg_write(self, NRF24_CONFIG, config);
+    }
+}
+
+STATIC void nrf24_set_ce (mach_nrf24l01_obj_t *self, uint32_t value) {
+    self->ce->value = value;
+    pin_set_value(self->ce);
+}
+
+// drains the RX FIFO of the chip into the rings, and reports the end of a transmission
+STATIC void nrf24_service (mach_nrf24l01_obj_t *self) {
+    bool stored = false;
+    uint8_t status = nrf24_cmd(self, NRF24_NOP, NULL, NULL, 0);
+    while (NRF24_RX_P_NO(status) < NRF24_PIPES) {
+        uint8_t pipe = NRF24_RX_P_NO(status);
+        uint8_t len = self->payload_size;
+        if (len == 0) {
+            nrf24_cmd(self, NRF24_R_RX_PL_WID, NULL, &len, 1);
+            if (len == 0 || len > NRF24_PAYLOAD_MAX) {
+                // a corrupt packet, the datasheet says to flush it
+                nrf24_cmd(self, NRF24_FLUSH_RX, NULL, NULL, 0);
+                self->stats.dropped++;
+                break;
+            }
+        }
+        nrf24_ring_t *ring = &self->ring[pipe];
+        if (ring->slots != NULL && ring->count < self->rx_depth) {
+            nrf24_packet_t *packet = &ring->slots[(ring->head + ring->count) % self->rx_depth];
+            nrf24_cmd(self, NRF24_R_RX_PAYLOAD, NULL, packet->data, len);
+            packet->len = len;
+            ring->count++;
+            self->stats.rx++;
+            stored = true;
+        } else {
+            // read anyway, so the FIFO keeps moving for the other pipes
+            nrf24_cmd(self, NRF24_R_RX_PAYLOAD, NULL, NULL, len);
+            self->stats.dropped++;
+        }
+        nrf24_reg_write(self, NRF24_STATUS, NRF24_RX_DR);
+        status = nrf24_cmd(self, NRF24_NOP, NULL, NULL, 0);
+    }
+    if (status & (NRF24_TX_DS | NRF24_MAX_RT)) {
+        if (status & NRF24_TX_DS) {
+            self->tx_result = NRF24_TX_OK;
+            self->stats.tx++;
+        } else {
+            // the packet stays in the FIFO and would be sent again on the next CE pulse
+            nrf24_cmd(self, NRF24_FLUSH_TX, NULL, NULL, 0);
+            self->tx_result = NRF24_TX_FAIL;
+            self->stats.tx_failed++;
+        }
+        nrf24_reg_write(self, NRF24_STATUS, NRF24_TX_DS | NRF24_MAX_RT);
+        xSemaphoreGive(self->tx_sem);
+    }
+    if (stored) {
+        xSemaphoreGive(self->rx_sem);
+    }
+}
+
+// IRQ stays low until all the flags are cleared, so a flag raised while they are
+// served gives no new edge, which is why the level is checked before sleeping
+STATIC void TASK_NRF24L01 (void *pvParameters) {
+    mach_nrf24l01_obj_t *self = pvParameters;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        do {
+            xSemaphoreTake(self->mutex, portMAX_DELAY);
+            if (self->enabled) {
+                nrf24_service(self);
+            }
+            xSemaphoreGive(self->mutex);
+        } while (self->enabled && pin_get_value(self->irq) == 0);
+    }
+}
+
+STATIC bool nrf24_alloc_ring (mach_nrf24l01_obj_t *self, uint8_t pipe) {
+    nrf24_ring_t *ring = &self->ring[pipe];
+    if (ring->slots == NULL) {
+        ring->slots = heap_caps_malloc(self->rx_depth * sizeof(nrf24_packet_t), MALLOC_CAP_INTERNAL);
+        ring->head = 0;
+        ring->count = 0;
+    }
+    return ring->slots != NULL;
+}
+
+STATIC void nrf24_free_rings (mach_nrf24l01_obj_t *self) {
+    for (uint8_t pipe = 0; pipe < NRF24_PIPES; pipe++) {
+        heap_caps_free(self->ring[pipe].slots);
+        self->ring[pipe].slots = NULL;
+        self->ring[pipe].count = 0;
+    }
+}
+
+// back to receiving after a transmission, if it was before
+STATIC void nrf24_tx_finish (mach_nrf24l01_obj_t *self) {
+    if (self->listening) {
+        nrf24_set_config(self, self->config | NRF24_PRIM_RX);
+        nrf24_set_ce(self, 1);
+        ets_delay_us(NRF24_SETTLE_US);
+    }
+}
+
+STATIC bool nrf24_setup (mach_nrf24l01_obj_t *self, uint8_t channel) {
+    nrf24_set_ce(self, 0);
+    // address width of 5 bytes, which tells whether the chip is there
+    nrf24_reg_write(self, NRF24_SETUP_AW, 0x03);
+    if (nrf24_reg_read(self, NRF24_SETUP_AW) != 0x03) {
+        return false;
+    }
+    uint8_t feature = (self->payload_size == 0) ? (NRF24_EN_DPL | NRF24_EN_ACK_PAY) : 0;
+    nrf24_reg_write(self, NRF24_FEATURE, feature);
+    if (nrf24_reg_read(self, NRF24_FEATURE) != feature) {
+        uint8_t key = NRF24_ACTIVATE_KEY;
+        nrf24_cmd(self, NRF24_ACTIVATE, &key, NULL, 1);
+        nrf24_reg_write(self, NRF24_FEATURE, feature);
+    }
+    nrf24_reg_write(self, NRF24_DYNPD, (self->payload_size == 0) ? 0x3F : 0);
+    nrf24_reg_write(self, NRF24_EN_AA, 0x3F);
+    // pipe 0 receives the ACKs, the others are enabled as they are opened
+    nrf24_reg_write(self, NRF24_EN_RXADDR, 0x01);
+    // auto retransmit delay: 1750 us, auto retransmit count: 8
+    nrf24_reg_write(self, NRF24_SETUP_RETR, (6 << 4) | 8);
+    uint8_t setup = nrf24_reg_read(self, NRF24_RF_SETUP) & NRF24_RF_SETUP_MASK;
+    nrf24_reg_write(self, NRF24_RF_SETUP, setup | NRF24_POWER_3 | NRF24_SPEED_250K);
+    nrf24_reg_write(self, NRF24_RF_CH, MIN(channel, 125));
+    nrf24_reg_write(self, NRF24_STATUS, NRF24_RX_DR | NRF24_TX_DS | NRF24_MAX_RT);
+    nrf24_cmd(self, NRF24_FLUSH_RX, NULL, NULL, 0);
+    nrf24_cmd(self, NRF24_FLUSH_TX, NULL, NULL, 0);
+    // kept in standby between the packets, powering up each time takes 1.5 ms
+    self->config = 0;
+    nrf24_set_config(self, NRF24_EN_CRC | NRF24_CRCO | NRF24_PWR_UP);
+    vTaskDelay(NRF24_POWER_UP_MS / portTICK_PERIOD_MS);
+    return true;
+}
+
+STATIC void nrf24_hw_deinit (mach_nrf24l01_obj_t *self) {
+    if (self->enabled) {
+        pin_irq_disable(self->irq);
+        machpin_register_irq_c_handler(self->irq, NULL);
+        xSemaphoreTake(self->mutex, portMAX_DELAY);
+        nrf24_set_ce(self, 0);
+        nrf24_set_config(self, self->config & ~NRF24_PWR_UP);
+        self->enabled = false;
+        self->listening = false;
+        nrf24_free_rings(self);
+        xSemaphoreGive(self->mutex);
+        spi_bus_remove_device(self->dev);
+        spi_bus_free(self->host);
+        heap_caps_free(self->tx_buf);
+        heap_caps_free(self->rx_buf);
+        self->tx_buf = NULL;
+        self->rx_buf = NULL;
+    }
+}
+
+STATIC mach_nrf24l01_obj_t *nrf24_get_self (mp_obj_t self_in) {
+    mach_nrf24l01_obj_t *self = self_in;
+    if (!self->enabled) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_request_not_possible);
+    }
+    return self;
+}
+
+STATIC void nrf24_get_address (mp_obj_t addr_in, uint8_t *addr) {
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(addr_in, &bufinfo, MP_BUFFER_READ);
+    if (bufinfo.len != NRF24_ADDR_LEN) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    memcpy(addr, bufinfo.buf, NRF24_ADDR_LEN);
+}
+
+// the oldest packet of the given pipe, or of the next pipe holding one, round robin
+STATIC int nrf24_pop (mach_nrf24l01_obj_t *self, int pipe, nrf24_packet_t *packet) {
+    for (uint8_t i = 0; i < NRF24_PIPES; i++) {
+        uint8_t p = (pipe >= 0) ? pipe : (self->next_pipe + i) % NRF24_PIPES;
+        nrf24_ring_t *ring = &self->ring[p];
+        if (ring->count > 0) {
+            memcpy(packet, &ring->slots[ring->head], sizeof(nrf24_packet_t));
+            ring->head = (ring->head + 1) % self->rx_depth;
+            ring->count--;
+            self->next_pipe = (p + 1) % NRF24_PIPES;
+            return p;
+        }
+        if (pipe >= 0) {
+            break;
+        }
+    }
+    return -1;
+}
+
+STATIC mp_obj_t mach_nrf24l01_init_helper (mach_nrf24l01_obj_t *self, const mp_arg_val_t *args) {
+    mp_int_t baudrate = args[0].u_int;
+    if (baudrate <= 0 || baudrate > NRF24_BAUDRATE_MAX) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    mp_obj_t *pins = (mp_obj_t *)mach_nrf24l01_def_pin[self - mach_nrf24l01_obj];
+    if (args[1].u_obj != MP_OBJ_NULL) {
+        mp_obj_get_array_fixed_n(args[1].u_obj, 3, &pins);
+    }
+    if (args[2].u_obj == MP_OBJ_NULL || args[3].u_obj == MP_OBJ_NULL || args[4].u_obj == MP_OBJ_NULL) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    mp_int_t channel = args[5].u_int;
+    mp_int_t payload_size = args[6].u_int;
+    mp_int_t rx_depth = args[7].u_int;
+    if (channel < 0 || payload_size < 0 || payload_size > NRF24_PAYLOAD_MAX || rx_depth <= 0 || rx_depth > UINT16_MAX) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    spi_bus_config_t bus_config = {
+        .sclk_io_num = pin_find(pins[0])->pin_number,
+        .mosi_io_num = pin_find(pins[1])->pin_number,
+        .miso_io_num = pin_find(pins[2])->pin_number,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .max_transfer_sz = NRF24_XFER_BUF_SIZE,
+    };
+    spi_device_interface_config_t dev_config = {
+        .mode = 0,
+        .clock_speed_hz = baudrate,
+        .spics_io_num = pin_find(args[2].u_obj)->pin_number,
+        .queue_size = 1,
+    };
+    pin_obj_t *ce = pin_find(args[3].u_obj);
+    pin_obj_t *irq = pin_find(args[4].u_obj);
+
+    MP_THREAD_GIL_EXIT();
+    nrf24_hw_deinit(self);
+    MP_THREAD_GIL_ENTER();
+    if (self->mutex == NULL) {
+        self->mutex = xSemaphoreCreateMutex();
+        self->rx_sem = xSemaphoreCreateBinary();
+        self->tx_sem = xSemaphoreCreateBinary();
+        xTaskCreatePinnedToCore(TASK_NRF24L01, "NRF24L01", NRF24_TASK_STACK_SIZE / sizeof(StackType_t), self,
+                                NRF24_TASK_PRIORITY, &self->task, config_get_service_core());
+    }
+    self->payload_size = payload_size;
+    self->rx_depth = rx_depth;
+    self->pipe0_set = false;
+    self->listening = false;
+    self->tx_result = NRF24_TX_NONE;
+    self->next_pipe = 0;
+    memset(&self->stats, 0, sizeof(self->stats));
+    self->tx_buf = heap_caps_malloc(NRF24_XFER_BUF_SIZE, MALLOC_CAP_DMA);
+    self->rx_buf = heap_caps_malloc(NRF24_XFER_BUF_SIZE, MALLOC_CAP_DMA);
+    // pipe 0 gets the ACK payloads as well
+    if (self->tx_buf == NULL || self->rx_buf == NULL || !nrf24_alloc_ring(self, 0)) {
+        heap_caps_free(self->tx_buf);
+        heap_caps_free(self->rx_buf);
+        self->tx_buf = NULL;
+        self->rx_buf = NULL;
+        nrf24_free_rings(self);
+        mp_raise_OSError(MP_ENOMEM);
+    }
+
+    self->ce = ce;
+    self->irq = irq;
+    pin_config(ce, -1, -1, GPIO_MODE_OUTPUT, MACHPIN_PULL_NONE, 0);
+    bool ok = false;
+    // each host has its own DMA channel
+    if (spi_bus_initialize(self->host, &bus_config, self->host) == ESP_OK) {
+        if (spi_bus_add_device(self->host, &dev_config, &self->dev) == ESP_OK) {
+            MP_THREAD_GIL_EXIT();
+            xSemaphoreTake(self->mutex, portMAX_DELAY);
+            ok = nrf24_setup(self, channel);
+            self->enabled = ok;
+            xSemaphoreGive(self->mutex);
+            MP_THREAD_GIL_ENTER();
+            if (!ok) {
+                spi_bus_remove_device(self->dev);
+                spi_bus_free(self->host);
+            }
+        } else {
+            spi_bus_free(self->host);
+        }
+    }
+    if (!ok) {
+        heap_caps_free(self->tx_buf);
+        heap_caps_free(self->rx_buf);
+        self->tx_buf = NULL;
+        self->rx_buf = NULL;
+        nrf24_free_rings(self);
+        mp_raise_msg(&mp_type_OSError, "nRF24L01+ Hardware not responding");
+    }
+
+    pin_config(irq, -1, -1, GPIO_MODE_INPUT, MACHPIN_PULL_UP, 0);
+    pin_irq_disable(irq);
+    pin_extint_register(irq, GPIO_INTR_NEGEDGE, 0);
+    machpin_register_irq_c_handler(irq, (void *)mach_nrf24l01_intr_handler[self - mach_nrf24l01_obj]);
+    pin_irq_enable(irq);
+    return mp_const_none;
+}
+
+/******************************************************************************/
+// MicroPython bindings
+
+/// \class NRF24L01(id=0, *, baudrate=8000000, pins=(CLK, MOSI, MISO), cs, ce, irq, channel=46, payload_size=0, rx_depth=32)
+/// An nRF24L01+ radio on its own SPI host. The IRQ pin wakes a task which moves
+/// the received packets into a ring of rx_depth packets per pipe, so the chip's
+/// FIFO of 3 never overflows while Python is busy. payload_size=0 selects dynamic
+/// payloads, which auto-ACK payloads need. The SPI host is taken over.
+STATIC const mp_arg_t mach_nrf24l01_init_args[] = {
+    { MP_QSTR_id,                          MP_ARG_INT, {.u_int = 0} },
+    { MP_QSTR_baudrate,                    MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = NRF24_BAUDRATE_DEFAULT} },
+    { MP_QSTR_pins,                        MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+    { MP_QSTR_cs,                          MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+    { MP_QSTR_ce,                          MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+    { MP_QSTR_irq,                         MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+    { MP_QSTR_channel,                     MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 46} },
+    { MP_QSTR_payload_size,                MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0} },
+    { MP_QSTR_rx_depth,                    MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = NRF24_RX_DEPTH_DEFAULT} },
+};
+STATIC mp_obj_t mach_nrf24l01_make_new (const mp_obj_type_t *type, mp_uint_t n_args, mp_uint_t n_kw, const mp_obj_t *all_args) {
+    mp_map_t kw_args;
+    mp_map_init_fixed_table(&kw_args, n_kw, all_args + n_args);
+    mp_arg_val_t args[MP_ARRAY_SIZE(mach_nrf24l01_init_args)];
+    mp_arg_parse_all(n_args, all_args, &kw_args, MP_ARRAY_SIZE(args), mach_nrf24l01_init_args, args);
+
+    if (args[0].u_int < 0 || args[0].u_int >= MP_ARRAY_SIZE(mach_nrf24l01_obj)) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable);
+    }
+    mach_nrf24l01_obj_t *self = &mach_nrf24l01_obj[args[0].u_int];
+    self->base.type = &mach_nrf24l01_type;
+    mach_nrf24l01_init_helper(self, &args[1]);
+    return self;
+}
+
+STATIC mp_obj_t mach_nrf24l01_init (mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    mp_arg_val_t args[MP_ARRAY_SIZE(mach_nrf24l01_init_args) - 1];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), &mach_nrf24l01_init_args[1], args);
+    return mach_nrf24l01_init_helper(pos_args[0], args);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_nrf24l01_init_obj, 1, mach_nrf24l01_init);
+
+STATIC mp_obj_t mach_nrf24l01_deinit (mp_obj_t self_in) {
+    MP_THREAD_GIL_EXIT();
+    nrf24_hw_deinit(self_in);
+    MP_THREAD_GIL_ENTER();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_nrf24l01_deinit_obj, mach_nrf24l01_deinit);
+
+/// \method set_channel(channel)
+STATIC mp_obj_t mach_nrf24l01_set_channel (mp_obj_t self_in, mp_obj_t channel_in) {
+    mach_nrf24l01_obj_t *self = nrf24_get_self(self_in);
+    mp_int_t channel = mp_obj_get_int(channel_in);
+    if (channel < 0) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    MP_THREAD_GIL_EXIT();
+    xSemaphoreTake(self->mutex, portMAX_DELAY);
+    nrf24_reg_write(self, NRF24_RF_CH, MIN(channel, 125));
+    xSemaphoreGive(self->mutex);
+    MP_THREAD_GIL_ENTER();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mach_nrf24l01_set_channel_obj, mach_nrf24l01_set_channel);
+
+/// \method set_power_speed(power, speed)
+/// power is one of the POWER_x constants, speed one of the SPEED_x ones.
+STATIC mp_obj_t mach_nrf24l01_set_power_speed (mp_obj_t self_in, mp_obj_t power_in, mp_obj_t speed_in) {
+    mach_nrf24l01_obj_t *self = nrf24_get_self(self_in);
+    mp_int_t power = mp_obj_get_int(power_in);
+    mp_int_t speed = mp_obj_get_int(speed_in);
+    if ((power & ~NRF24_POWER_3) || (speed != NRF24_SPEED_1M && speed != NRF24_SPEED_2M && speed != NRF24_SPEED_250K)) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    MP_THREAD_GIL_EXIT();
+    xSemaphoreTake(self->mutex, portMAX_DELAY);
+    uint8_t setup = nrf24_reg_read(self, NRF24_RF_SETUP) & NRF24_RF_SETUP_MASK;
+    nrf24_reg_write(self, NRF24_RF_SETUP, setup | power | speed);
+    xSemaphoreGive(self->mutex);
+    MP_THREAD_GIL_ENTER();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(mach_nrf24l01_set_power_speed_obj, mach_nrf24l01_set_power_speed);
+
+/// \method set_crc(length)
+/// length in bytes: 0, 1 or 2
+STATIC mp_obj_t mach_nrf24l01_set_crc (mp_obj_t self_in, mp_obj_t length_in) {
+    mach_nrf24l01_obj_t *self = nrf24_get_self(self_in);
+    mp_int_t length = mp_obj_get_int(length_in);
+    MP_THREAD_GIL_EXIT();
+    xSemaphoreTake(self->mutex, portMAX_DELAY);
+    uint8_t config = self->config & ~(NRF24_CRCO | NRF24_EN_CRC);
+    if (length == 1) {
+        config |= NRF24_EN_CRC;
+    } else if (length > 1) {
+        config |= NRF24_EN_CRC | NRF24_CRCO;
+    }
+    nrf24_set_config(self, config);
+    xSemaphoreGive(self->mutex);
+    MP_THREAD_GIL_ENTER();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mach_nrf24l01_set_crc_obj, mach_nrf24l01_set_crc);
+
+/// \method set_retries(delay_us, count)
+/// The auto retransmit delay, in steps of 250 us, and count, at most 15.
+STATIC mp_obj_t mach_nrf24l01_set_retries (mp_obj_t self_in, mp_obj_t delay_in, mp_obj_t count_in) {
+    mach_nrf24l01_obj_t *self = nrf24_get_self(self_in);
+    mp_int_t delay = mp_obj_get_int(delay_in);
+    mp_int_t count = mp_obj_get_int(count_in);
+    if (delay < 250 || delay > 4000 || count < 0 || count > 15) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    MP_THREAD_GIL_EXIT();
+    xSemaphoreTake(self->mutex, portMAX_DELAY);
+    nrf24_reg_write(self, NRF24_SETUP_RETR, (((delay / 250) - 1) << 4) | count);
+    xSemaphoreGive(self->mutex);
+    MP_THREAD_GIL_ENTER();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(mach_nrf24l01_set_retries_obj, mach_nrf24l01_set_retries);
+
+/// \method open_tx_pipe(address)
+/// address is 5 bytes long, the ACKs are received on it by pipe 0.
+STATIC mp_obj_t mach_nrf24l01_open_tx_pipe (mp_obj_t self_in, mp_obj_t addr_in) {
+    mach_nrf24l01_obj_t *self = nrf24_get_self(self_in);
+    uint8_t addr[NRF24_ADDR_LEN];
+    nrf24_get_address(addr_in, addr);
+    MP_THREAD_GIL_EXIT();
+    xSemaphoreTake(self->mutex, portMAX_DELAY);
+    nrf24_cmd(self, NRF24_W_REGISTER | NRF24_RX_ADDR_P0, addr, NULL, NRF24_ADDR_LEN);
+    nrf24_cmd(self, NRF24_W_REGISTER | NRF24_TX_ADDR, addr, NULL, NRF24_ADDR_LEN);
+    if (self->payload_size) {
+        nrf24_reg_write(self, NRF24_RX_PW_P0, self->payload_size);
+    }
+    xSemaphoreGive(self->mutex);
+    MP_THREAD_GIL_ENTER();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mach_nrf24l01_open_tx_pipe_obj, mach_nrf24l01_open_tx_pipe);
+
+/// \method open_rx_pipe(pipe_id, address)
+/// address is 5 bytes long, pipes 2-5 use the 4 most significant bytes of pipe 1
+/// and only the first byte of their address is used.
+STATIC mp_obj_t mach_nrf24l01_open_rx_pipe (mp_obj_t self_in, mp_obj_t pipe_in, mp_obj_t addr_in) {
+    mach_nrf24l01_obj_t *self = nrf24_get_self(self_in);
+    mp_int_t pipe = mp_obj_get_int(pipe_in);
+    if (pipe < 0 || pipe >= NRF24_PIPES) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    uint8_t addr[NRF24_ADDR_LEN];
+    nrf24_get_address(addr_in, addr);
+    MP_THREAD_GIL_EXIT();
+    xSemaphoreTake(self->mutex, portMAX_DELAY);
+    bool ok = nrf24_alloc_ring(self, pipe);
+    if (ok) {
+        if (pipe == 0) {
+            memcpy(self->pipe0_addr, addr, NRF24_ADDR_LEN);
+            self->pipe0_set = true;
+        }
+        if (pipe < 2) {
+            nrf24_cmd(self, NRF24_W_REGISTER | (NRF24_RX_ADDR_P0 + pipe), addr, NULL, NRF24_ADDR_LEN);
+        } else {
+            nrf24_reg_write(self, NRF24_RX_ADDR_P0 + pipe, addr[0]);
+        }
+        if (self->payload_size) {
+            nrf24_reg_write(self, NRF24_RX_PW_P0 + pipe, self->payload_size);
+        }
+        nrf24_reg_write(self, NRF24_EN_RXADDR, nrf24_reg_read(self, NRF24_EN_RXADDR) | (1 << pipe));
+    }
+    xSemaphoreGive(self->mutex);
+    MP_THREAD_GIL_ENTER();
+    if (!ok) {
+        mp_raise_OSError(MP_ENOMEM);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(mach_nrf24l01_open_rx_pipe_obj, mach_nrf24l01_open_rx_pipe);
+
+STATIC mp_obj_t mach_nrf24l01_start_listening (mp_obj_t self_in) {
+    mach_nrf24l01_obj_t *self = nrf24_get_self(self_in);
+    MP_THREAD_GIL_EXIT();
+    xSemaphoreTake(self->mutex, portMAX_DELAY);
+    nrf24_set_config(self, self->config | NRF24_PWR_UP | NRF24_PRIM_RX);
+    nrf24_reg_write(self, NRF24_STATUS, NRF24_RX_DR | NRF24_TX_DS | NRF24_MAX_RT);
+    if (self->pipe0_set) {
+        // open_tx_pipe() may have taken it over for the ACKs
+        nrf24_cmd(self, NRF24_W_REGISTER | NRF24_RX_ADDR_P0, self->pipe0_addr, NULL, NRF24_ADDR_LEN);
+    }
+    nrf24_cmd(self, NRF24_FLUSH_RX, NULL, NULL, 0);
+    nrf24_cmd(self, NRF24_FLUSH_TX, NULL, NULL, 0);
+    self->listening = true;
+    nrf24_set_ce(self, 1);
+    ets_delay_us(NRF24_SETTLE_US);
+    xSemaphoreGive(self->mutex);
+    MP_THREAD_GIL_ENTER();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_nrf24l01_start_listening_obj, mach_nrf24l01_start_listening);
+
+STATIC mp_obj_t mach_nrf24l01_stop_listening (mp_obj_t self_in) {
+    mach_nrf24l01_obj_t *self = nrf24_get_self(self_in);
+    MP_THREAD_GIL_EXIT();
+    xSemaphoreTake(self->mutex, portMAX_DELAY);
+    nrf24_set_ce(self, 0);
+    self->listening = false;
+    nrf24_cmd(self, NRF24_FLUSH_TX, NULL, NULL, 0);
+    nrf24_cmd(self, NRF24_FLUSH_RX, NULL, NULL, 0);
+    xSemaphoreGive(self->mutex);
+    MP_THREAD_GIL_ENTER();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_nrf24l01_stop_listening_obj, mach_nrf24l01_stop_listening);
+
+/// \method any(pipe=None)
+/// The number of packets held for the pipe, or for all of them.
+STATIC mp_obj_t mach_nrf24l01_any (mp_uint_t n_args, const mp_obj_t *args) {
+    mach_nrf24l01_obj_t *self = nrf24_get_self(args[0]);
+    mp_int_t pipe = (n_args > 1 && args[1] != mp_const_none) ? mp_obj_get_int(args[1]) : -1;
+    if (pipe >= NRF24_PIPES) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    uint32_t count = 0;
+    for (uint8_t p = 0; p < NRF24_PIPES; p++) {
+        if (pipe < 0 || p == pipe) {
+            count += self->ring[p].count;
+        }
+    }
+    return mp_obj_new_int_from_uint(count);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mach_nrf24l01_any_obj, 1, 2, mach_nrf24l01_any);
+
+/// \method recv(pipe=None, *, timeout=0)
+/// The oldest packet of the pipe, or of any pipe in turn, None when there's
+/// none within timeout ms (-1 waits for ever).
+STATIC mp_obj_t mach_nrf24l01_recv (mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t mach_nrf24l01_recv_args[] = {
+        { MP_QSTR_pipe,                    MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_timeout,                 MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(mach_nrf24l01_recv_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), mach_nrf24l01_recv_args, args);
+    mach_nrf24l01_obj_t *self = nrf24_get_self(pos_args[0]);
+    mp_int_t pipe = (args[0].u_obj == mp_const_none) ? -1 : mp_obj_get_int(args[0].u_obj);
+    mp_int_t timeout = args[1].u_int;
+    if (pipe >= NRF24_PIPES) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+
+    nrf24_packet_t packet;
+    int got;
+    uint32_t start = mp_hal_ticks_ms();
+    MP_THREAD_GIL_EXIT();
+    for (;;) {
+        xSemaphoreTake(self->mutex, portMAX_DELAY);
+        got = nrf24_pop(self, pipe, &packet);
+        xSemaphoreGive(self->mutex);
+        if (got >= 0 || timeout == 0) {
+            break;
+        }
+        TickType_t ticks = portMAX_DELAY;
+        if (timeout > 0) {
+            uint32_t elapsed = mp_hal_ticks_ms() - start;
+            if (elapsed >= timeout) {
+                break;
+            }
+            ticks = MAX(1, (timeout - elapsed) / portTICK_PERIOD_MS);
+        }
+        xSemaphoreTake(self->rx_sem, ticks);
+    }
+    MP_THREAD_GIL_ENTER();
+    if (got < 0) {
+        return mp_const_none;
+    }
+    return mp_obj_new_bytes(packet.data, packet.len);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_nrf24l01_recv_obj, 1, mach_nrf24l01_recv);
+
+/// \method ack_payload(pipe, buf)
+/// Queues buf for the ACK of the next packet received on pipe, at most 3 are held.
+STATIC mp_obj_t mach_nrf24l01_ack_payload (mp_obj_t self_in, mp_obj_t pipe_in, mp_obj_t buf_in) {
+    mach_nrf24l01_obj_t *self = nrf24_get_self(self_in);
+    mp_int_t pipe = mp_obj_get_int(pipe_in);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(buf_in, &bufinfo, MP_BUFFER_READ);
+    if (self->payload_size != 0 || pipe < 0 || pipe >= NRF24_PIPES || bufinfo.len == 0 || bufinfo.len > NRF24_PAYLOAD_MAX) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    MP_THREAD_GIL_EXIT();
+    xSemaphoreTake(self->mutex, portMAX_DELAY);
+    uint8_t status = nrf24_cmd(self, NRF24_NOP, NULL, NULL, 0);
+    if (!(status & NRF24_TX_FULL)) {
+        nrf24_cmd(self, NRF24_W_ACK_PAYLOAD | pipe, bufinfo.buf, NULL, bufinfo.len);
+    }
+    xSemaphoreGive(self->mutex);
+    MP_THREAD_GIL_ENTER();
+    if (status & NRF24_TX_FULL) {
+        mp_raise_OSError(MP_ENOBUFS);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(mach_nrf24l01_ack_payload_obj, mach_nrf24l01_ack_payload);
+
+/// \method send_start(buf)
+/// Starts sending buf and returns, send_done() tells the outcome.
+STATIC mp_obj_t mach_nrf24l01_send_start (mp_obj_t self_in, mp_obj_t buf_in) {
+    mach_nrf24l01_obj_t *self = nrf24_get_self(self_in);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(buf_in, &bufinfo, MP_BUFFER_READ);
+    uint32_t len = self->payload_size ? self->payload_size : bufinfo.len;
+    if (bufinfo.len == 0 || bufinfo.len > len) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    uint8_t payload[NRF24_PAYLOAD_MAX] = {0};
+    memcpy(payload, bufinfo.buf, bufinfo.len);
+
+    MP_THREAD_GIL_EXIT();
+    xSemaphoreTake(self->mutex, portMAX_DELAY);
+    nrf24_set_ce(self, 0);
+    if (self->config & NRF24_PRIM_RX) {
+        nrf24_set_config(self, (self->config | NRF24_PWR_UP) & ~NRF24_PRIM_RX);
+        ets_delay_us(NRF24_SETTLE_US);
+    }
+    xSemaphoreTake(self->tx_sem, 0);
+    self->tx_result = NRF24_TX_NONE;
+    nrf24_cmd(self, NRF24_W_TX_PAYLOAD, payload, NULL, len);
+    // enable the chip so it can send the data
+    nrf24_set_ce(self, 1);
+    ets_delay_us(NRF24_CE_PULSE_US);
+    nrf24_set_ce(self, 0);
+    xSemaphoreGive(self->mutex);
+    MP_THREAD_GIL_ENTER();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mach_nrf24l01_send_start_obj, mach_nrf24l01_send_start);
+
+STATIC mp_int_t nrf24_send_result (mach_nrf24l01_obj_t *self) {
+    xSemaphoreTake(self->mutex, portMAX_DELAY);
+    mp_int_t result = self->tx_result;
+    if (result != NRF24_TX_NONE) {
+        self->tx_result = NRF24_TX_NONE;
+        nrf24_tx_finish(self);
+    }
+    xSemaphoreGive(self->mutex);
+    return result;
+}
+
+/// \method send_done()
+/// None while sending, then 1 for success and 2 when no ACK came.
+STATIC mp_obj_t mach_nrf24l01_send_done (mp_obj_t self_in) {
+    mach_nrf24l01_obj_t *self = nrf24_get_self(self_in);
+    MP_THREAD_GIL_EXIT();
+    mp_int_t result = nrf24_send_result(self);
+    MP_THREAD_GIL_ENTER();
+    return (result == NRF24_TX_NONE) ? mp_const_none : MP_OBJ_NEW_SMALL_INT(result);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_nrf24l01_send_done_obj, mach_nrf24l01_send_done);
+
+/// \method send(buf, timeout=500)
+/// Sends buf and waits for its ACK, without holding the other threads up.
+STATIC mp_obj_t mach_nrf24l01_send (mp_uint_t n_args, const mp_obj_t *args) {
+    mach_nrf24l01_obj_t *self = nrf24_get_self(args[0]);
+    mp_int_t timeout = (n_args > 2) ? mp_obj_get_int(args[2]) : 500;
+    mach_nrf24l01_send_start(self, args[1]);
+
+    mp_int_t result;
+    uint32_t start = mp_hal_ticks_ms();
+    MP_THREAD_GIL_EXIT();
+    for (;;) {
+        result = nrf24_send_result(self);
+        uint32_t elapsed = mp_hal_ticks_ms() - start;
+        if (result != NRF24_TX_NONE || elapsed >= timeout) {
+            break;
+        }
+        xSemaphoreTake(self->tx_sem, MAX(1, (timeout - elapsed) / portTICK_PERIOD_MS));
+    }
+    MP_THREAD_GIL_ENTER();
+    if (result == NRF24_TX_NONE) {
+        mp_raise_OSError(MP_ETIMEDOUT);
+    } else if (result == NRF24_TX_FAIL) {
+        mp_raise_msg(&mp_type_OSError, "send failed");
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mach_nrf24l01_send_obj, 2, 3, mach_nrf24l01_send);
+
+/// \method stats()
+/// (rx, dropped, tx, tx_failed)
+STATIC mp_obj_t mach_nrf24l01_stats (mp_obj_t self_in) {
+    mach_nrf24l01_obj_t *self = nrf24_get_self(self_in);
+    mp_obj_t tuple[4] = {
+        mp_obj_new_int_from_uint(self->stats.rx),
+        mp_obj_new_int_from_uint(self->stats.dropped),
+        mp_obj_new_int_from_uint(self->stats.tx),
+        mp_obj_new_int_from_uint(self->stats.tx_failed),
+    };
+    return mp_obj_new_tuple(4, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_nrf24l01_stats_obj, mach_nrf24l01_stats);
+
+STATIC const mp_map_elem_t mach_nrf24l01_locals_dict_table[] = {
+    { MP_OBJ_NEW_QSTR(MP_QSTR_init),            (mp_obj_t)&mach_nrf24l01_init_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_deinit),          (mp_obj_t)&mach_nrf24l01_deinit_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_set_channel),     (mp_obj_t)&mach_nrf24l01_set_channel_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_set_power_speed), (mp_obj_t)&mach_nrf24l01_set_power_speed_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_set_crc),         (mp_obj_t)&mach_nrf24l01_set_crc_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_set_retries),     (mp_obj_t)&mach_nrf24l01_set_retries_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_open_tx_pipe),    (mp_obj_t)&mach_nrf24l01_open_tx_pipe_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_open_rx_pipe),    (mp_obj_t)&mach_nrf24l01_open_rx_pipe_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_start_listening), (mp_obj_t)&mach_nrf24l01_start_listening_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_stop_listening),  (mp_obj_t)&mach_nrf24l01_stop_listening_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_any),             (mp_obj_t)&mach_nrf24l01_any_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_recv),            (mp_obj_t)&mach_nrf24l01_recv_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_ack_payload),     (mp_obj_t)&mach_nrf24l01_ack_payload_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_send),            (mp_obj_t)&mach_nrf24l01_send_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_send_start),      (mp_obj_t)&mach_nrf24l01_send_start_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_send_done),       (mp_obj_t)&mach_nrf24l01_send_done_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_stats),           (mp_obj_t)&mach_nrf24l01_stats_obj },
+
+    // class constants
+    { MP_OBJ_NEW_QSTR(MP_QSTR_POWER_0),         MP_OBJ_NEW_SMALL_INT(NRF24_POWER_0) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_POWER_1),         MP_OBJ_NEW_SMALL_INT(NRF24_POWER_1) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_POWER_2),         MP_OBJ_NEW_SMALL_INT(NRF24_POWER_2) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_POWER_3),         MP_OBJ_NEW_SMALL_INT(NRF24_POWER_3) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_SPEED_250K),      MP_OBJ_NEW_SMALL_INT(NRF24_SPEED_250K) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_SPEED_1M),        MP_OBJ_NEW_SMALL_INT(NRF24_SPEED_1M) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_SPEED_2M),        MP_OBJ_NEW_SMALL_INT(NRF24_SPEED_2M) },
+};
+STATIC MP_DEFINE_CONST_DICT(mach_nrf24l01_locals_dict, mach_nrf24l01_locals_dict_table);
+
+const mp_obj_type_t mach_nrf24l01_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_NRF24L01,
+    .make_new = mach_nrf24l01_make_new,
+    .locals_dict = (mp_obj_t)&mach_nrf24l01_locals_dict,
+};
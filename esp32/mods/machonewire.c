@@ -0,0 +1,571 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/mpthread.h"
+#include "py/mperrno.h"
+#include "mpexception.h"
+#include "machpin.h"
+#include "machrmt.h"
+#include "machonewire.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/ringbuf.h"
+#include "driver/gpio.h"
+#include "driver/rmt.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+// 1 us ticks out of the 80 MHz APB clock
+#define ONEWIRE_CLK_DIV                     (80)
+#define ONEWIRE_RESET_US                    (480)
+#define ONEWIRE_PRESENCE_US                 (70)    // the presence pulse is over by then
+#define ONEWIRE_SLOT_US                     (70)
+#define ONEWIRE_1_LOW_US                    (6)     // also what starts a read slot
+#define ONEWIRE_0_LOW_US                    (60)
+#define ONEWIRE_SAMPLE_US                   (15)    // a device holding the bus longer sends a 0
+#define ONEWIRE_FILTER_TICKS                (30)
+#define ONEWIRE_RX_BUF_SIZE                 (512)
+#define ONEWIRE_RX_TIMEOUT_MS               (20)
+
+#define ONEWIRE_SEARCH_ROM                  (0xF0)
+#define ONEWIRE_MATCH_ROM                   (0x55)
+#define ONEWIRE_SKIP_ROM                    (0xCC)
+#define ONEWIRE_CONVERT_T                   (0x44)
+#define ONEWIRE_READ_SCRATCH                (0xBE)
+
+#define ONEWIRE_SCAN_MAX                    (32)
+#define ONEWIRE_CONVERT_POLL_MS             (10)
+#define ONEWIRE_CONVERT_TIMEOUT_MS          (1000)  // 750 ms at 12 bits, with margin
+#define ONEWIRE_FAMILY_DS18S20              (0x10)
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+typedef struct _mach_onewire_obj_t {
+    mp_obj_base_t base;
+    rmt_channel_t tx_channel;
+    rmt_channel_t rx_channel;
+    RingbufHandle_t rx_ring;
+    gpio_num_t gpio;
+    bool active;
+} mach_onewire_obj_t;
+
+typedef struct {
+    uint8_t rom[8];
+    int last_discrepancy;
+    bool last_device;
+} onewire_search_t;
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+// The bus functions below only talk to the RMT driver, they run with the GIL
+// released and report failures to the caller instead of raising
+
+STATIC void onewire_flush_rx(mach_onewire_obj_t *self) {
+    size_t size;
+    void *items;
+    while ((items = xRingbufferReceive(self->rx_ring, &size, 0)) != NULL) {
+        vRingbufferReturnItem(self->rx_ring, items);
+    }
+}
+
+// sends n items while the RX channel records the bus, the devices pulling it
+// low included; returns the number of items recorded, -1 on a failure
+STATIC int onewire_frame(mach_onewire_obj_t *self, const rmt_item32_t *tx_items, int n,
+                         rmt_item32_t *rx_items, int rx_max) {
+    int count = -1;
+    onewire_flush_rx(self);
+    rmt_rx_start(self->rx_channel, true);
+    if (rmt_write_items(self->tx_channel, tx_items, n, true) == ESP_OK) {
+        size_t size = 0;
+        rmt_item32_t *items = xRingbufferReceive(self->rx_ring, &size, ONEWIRE_RX_TIMEOUT_MS / portTICK_PERIOD_MS);
+        if (items != NULL) {
+            count = MIN(size / sizeof(rmt_item32_t), rx_max);
+            memcpy(rx_items, items, count * sizeof(rmt_item32_t));
+            vRingbufferReturnItem(self->rx_ring, items);
+        }
+    }
+    rmt_rx_stop(self->rx_channel);
+    return count;
+}
+
+// false on a failure, *presence tells if any device answered
+STATIC bool onewire_reset(mach_onewire_obj_t *self, bool *presence) {
+    rmt_item32_t tx_item = {{{ ONEWIRE_RESET_US, 0, 0, 1 }}};
+    rmt_item32_t rx_items[2];
+    rmt_set_rx_idle_thresh(self->rx_channel, ONEWIRE_RESET_US + ONEWIRE_PRESENCE_US);
+    int count = onewire_frame(self, &tx_item, 1, rx_items, 2);
+    rmt_set_rx_idle_thresh(self->rx_channel, ONEWIRE_SLOT_US + 10);
+    if (count < 0) {
+        return false;
+    }
+    // our own low pulse, the bus released, then the presence pulse
+    *presence = count >= 2 && rx_items[0].level0 == 0 && rx_items[0].duration0 >= ONEWIRE_RESET_US - 2 &&
+                rx_items[0].level1 == 1 && rx_items[0].duration1 > 0 && rx_items[1].level0 == 0;
+    return true;
+}
+
+// up to 8 slots in one frame, the bits of out going first; a 1 is also a read
+// slot, returns what was on the bus or -1 on a failure
+STATIC int onewire_bits(mach_onewire_obj_t *self, uint8_t out, int n) {
+    rmt_item32_t tx_items[8];
+    rmt_item32_t rx_items[8];
+    for (int i = 0; i < n; i++) {
+        uint32_t low = ((out >> i) & 1) ? ONEWIRE_1_LOW_US : ONEWIRE_0_LOW_US;
+        tx_items[i].level0 = 0;
+        tx_items[i].duration0 = low;
+        tx_items[i].level1 = 1;
+        tx_items[i].duration1 = ONEWIRE_SLOT_US - low;
+    }
+    if (onewire_frame(self, tx_items, n, rx_items, n) < n) {
+        return -1;
+    }
+    int in = 0;
+    for (int i = 0; i < n; i++) {
+        if (rx_items[i].level0 == 0 && rx_items[i].duration0 <= ONEWIRE_SAMPLE_US) {
+            in |= 1 << i;
+        }
+    }
+    return in;
+}
+
+STATIC bool onewire_write(mach_onewire_obj_t *self, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (onewire_bits(self, data[i], 8) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+STATIC bool onewire_read(mach_onewire_obj_t *self, uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        int in = onewire_bits(self, 0xFF, 8);
+        if (in < 0) {
+            return false;
+        }
+        data[i] = in;
+    }
+    return true;
+}
+
+// reset, then the ROM command and the ROM to address one device or all of them
+STATIC bool onewire_select(mach_onewire_obj_t *self, const uint8_t *rom, bool *presence) {
+    if (!onewire_reset(self, presence)) {
+        return false;
+    }
+    if (!*presence) {
+        return true;
+    }
+    uint8_t cmd = (rom != NULL) ? ONEWIRE_MATCH_ROM : ONEWIRE_SKIP_ROM;
+    return onewire_write(self, &cmd, 1) && (rom == NULL || onewire_write(self, rom, 8));
+}
+
+// one step of the ROM search of the Maxim application note 187; 1 with the next
+// ROM in s->rom, 0 when there are no more, -1 on a failure
+STATIC int onewire_search_next(mach_onewire_obj_t *self, onewire_search_t *s) {
+    if (s->last_device) {
+        return 0;
+    }
+    bool presence;
+    uint8_t cmd = ONEWIRE_SEARCH_ROM;
+    if (!onewire_reset(self, &presence)) {
+        return -1;
+    }
+    if (!presence) {
+        return 0;
+    }
+    if (!onewire_write(self, &cmd, 1)) {
+        return -1;
+    }
+    int last_zero = 0;
+    for (int bit = 1; bit <= 64; bit++) {
+        // the bit of every device still in the search and its complement
+        int pair = onewire_bits(self, 0x03, 2);
+        if (pair < 0) {
+            return -1;
+        }
+        if (pair == 0x03) {
+            // they all went away
+            return 0;
+        }
+        uint8_t *byte = &s->rom[(bit - 1) / 8];
+        uint8_t mask = 1 << ((bit - 1) % 8);
+        int dir;
+        if (pair != 0) {
+            dir = pair & 1;
+        } else {
+            // a discrepancy, the 0 branch first
+            if (bit < s->last_discrepancy) {
+                dir = (*byte & mask) != 0;
+            } else {
+                dir = (bit == s->last_discrepancy);
+            }
+            if (dir == 0) {
+                last_zero = bit;
+            }
+        }
+        if (dir) {
+            *byte |= mask;
+        } else {
+            *byte &= ~mask;
+        }
+        if (onewire_bits(self, dir, 1) < 0) {
+            return -1;
+        }
+    }
+    s->last_discrepancy = last_zero;
+    s->last_device = (last_zero == 0);
+    return 1;
+}
+
+STATIC uint8_t onewire_crc8(const uint8_t *data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t byte = data[i];
+        for (int b = 0; b < 8; b++) {
+            uint8_t mix = (crc ^ byte) & 0x01;
+            crc >>= 1;
+            if (mix) {
+                crc ^= 0x8C;
+            }
+            byte >>= 1;
+        }
+    }
+    return crc;
+}
+
+STATIC mp_obj_t onewire_temp(const uint8_t *rom, const uint8_t *scratch) {
+    int16_t raw = scratch[0] | (scratch[1] << 8);
+    if (rom[0] == ONEWIRE_FAMILY_DS18S20 && scratch[7] != 0) {
+        // half degrees, refined with the count remaining
+        return mp_obj_new_float((raw >> 1) - 0.25f + (float)(scratch[7] - scratch[6]) / scratch[7]);
+    }
+    return mp_obj_new_float(raw / 16.0f);
+}
+
+STATIC mach_onewire_obj_t *onewire_get_self(mp_obj_t self_in) {
+    mach_onewire_obj_t *self = self_in;
+    if (!self->active) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_request_not_possible);
+    }
+    return self;
+}
+
+STATIC void onewire_check(bool ok) {
+    if (!ok) {
+        mp_raise_OSError(MP_EIO);
+    }
+}
+
+STATIC void onewire_get_rom(mp_obj_t rom_in, uint8_t *rom) {
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(rom_in, &bufinfo, MP_BUFFER_READ);
+    if (bufinfo.len != 8) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    memcpy(rom, bufinfo.buf, 8);
+}
+
+/******************************************************************************/
+// MicroPython bindings
+
+/// \class OneWire(pin, *, channel=None)
+/// A 1-Wire bus timed by a pair of RMT channels on the same open drain pin, one
+/// sending the slots and one recording the bus, so that the timing holds with the
+/// interrupts left enabled. The bus needs its external pull-up resistor.
+STATIC mp_obj_t mach_onewire_make_new(const mp_obj_type_t *type, mp_uint_t n_args, mp_uint_t n_kw, const mp_obj_t *all_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_pin,          MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_channel,      MP_ARG_KW_ONLY | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+    };
+    mp_map_t kw_args;
+    mp_map_init_fixed_table(&kw_args, n_kw, all_args + n_args);
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, all_args, &kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+
+    pin_obj_t *pin = pin_find(args[0].u_obj);
+    mach_onewire_obj_t *self = m_new_obj(mach_onewire_obj_t);
+    self->base.type = type;
+    self->gpio = pin->pin_number;
+    self->tx_channel = machrmt_claim((args[1].u_obj == mp_const_none) ? -1 : mp_obj_get_int(args[1].u_obj), self->gpio);
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        self->rx_channel = machrmt_claim_rx(self->tx_channel);
+        nlr_pop();
+    } else {
+        machrmt_release(self->tx_channel);
+        nlr_jump(nlr.ret_val);
+    }
+
+    rmt_config_t tx_config = {
+        .rmt_mode = RMT_MODE_TX,
+        .channel = self->tx_channel,
+        .clk_div = ONEWIRE_CLK_DIV,
+        .gpio_num = self->gpio,
+        .mem_block_num = 1,
+        .tx_config = {
+            .loop_en = false,
+            .carrier_en = false,
+            .idle_level = RMT_IDLE_LEVEL_HIGH,
+            .idle_output_en = true,
+        }
+    };
+    rmt_config_t rx_config = {
+        .rmt_mode = RMT_MODE_RX,
+        .channel = self->rx_channel,
+        .clk_div = ONEWIRE_CLK_DIV,
+        .gpio_num = self->gpio,
+        .mem_block_num = 1,
+        .rx_config = {
+            .filter_en = true,
+            .filter_ticks_thresh = ONEWIRE_FILTER_TICKS,
+            .idle_threshold = ONEWIRE_SLOT_US + 10,
+        }
+    };
+    bool tx_installed = false;
+    bool ok = rmt_config(&tx_config) == ESP_OK && (tx_installed = (rmt_driver_install(self->tx_channel, 0, 0) == ESP_OK)) &&
+              rmt_config(&rx_config) == ESP_OK && rmt_driver_install(self->rx_channel, ONEWIRE_RX_BUF_SIZE, 0) == ESP_OK;
+    if (ok) {
+        rmt_get_ringbuf_handle(self->rx_channel, &self->rx_ring);
+        // both channels were routed to the pin by rmt_config(), the pad itself
+        // is made an open drain that can be read back
+        ok = gpio_set_direction(self->gpio, GPIO_MODE_INPUT_OUTPUT_OD) == ESP_OK;
+    }
+    if (!ok) {
+        if (tx_installed) {
+            rmt_driver_uninstall(self->tx_channel);
+        }
+        rmt_driver_uninstall(self->rx_channel);
+        machrmt_release(self->tx_channel);
+        machrmt_release(self->rx_channel);
+        mp_raise_msg(&mp_type_OSError, mpexception_os_operation_failed);
+    }
+    self->active = true;
+    return self;
+}
+
+/// \method reset()
+/// Returns True when a device answered with a presence pulse.
+STATIC mp_obj_t mach_onewire_reset(mp_obj_t self_in) {
+    mach_onewire_obj_t *self = onewire_get_self(self_in);
+    bool presence;
+    MP_THREAD_GIL_EXIT();
+    bool ok = onewire_reset(self, &presence);
+    MP_THREAD_GIL_ENTER();
+    onewire_check(ok);
+    return mp_obj_new_bool(presence);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_onewire_reset_obj, mach_onewire_reset);
+
+STATIC mp_obj_t mach_onewire_readbit(mp_obj_t self_in) {
+    mach_onewire_obj_t *self = onewire_get_self(self_in);
+    int in = onewire_bits(self, 1, 1);
+    onewire_check(in >= 0);
+    return MP_OBJ_NEW_SMALL_INT(in);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_onewire_readbit_obj, mach_onewire_readbit);
+
+STATIC mp_obj_t mach_onewire_writebit(mp_obj_t self_in, mp_obj_t value) {
+    mach_onewire_obj_t *self = onewire_get_self(self_in);
+    onewire_check(onewire_bits(self, mp_obj_is_true(value), 1) >= 0);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mach_onewire_writebit_obj, mach_onewire_writebit);
+
+/// \method readinto(buf)
+/// Each byte is a single RMT frame of 8 slots.
+STATIC mp_obj_t mach_onewire_readinto(mp_obj_t self_in, mp_obj_t buf_in) {
+    mach_onewire_obj_t *self = onewire_get_self(self_in);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(buf_in, &bufinfo, MP_BUFFER_WRITE);
+    MP_THREAD_GIL_EXIT();
+    bool ok = onewire_read(self, bufinfo.buf, bufinfo.len);
+    MP_THREAD_GIL_ENTER();
+    onewire_check(ok);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mach_onewire_readinto_obj, mach_onewire_readinto);
+
+STATIC mp_obj_t mach_onewire_read(mp_obj_t self_in, mp_obj_t n_in) {
+    vstr_t vstr;
+    vstr_init_len(&vstr, mp_obj_get_int(n_in));
+    mp_obj_t buf = mp_obj_new_bytearray_by_ref(vstr.len, vstr.buf);
+    mach_onewire_readinto(self_in, buf);
+    return mp_obj_new_str_from_vstr(&mp_type_bytes, &vstr);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mach_onewire_read_obj, mach_onewire_read);
+
+STATIC mp_obj_t mach_onewire_write(mp_obj_t self_in, mp_obj_t buf_in) {
+    mach_onewire_obj_t *self = onewire_get_self(self_in);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(buf_in, &bufinfo, MP_BUFFER_READ);
+    MP_THREAD_GIL_EXIT();
+    bool ok = onewire_write(self, bufinfo.buf, bufinfo.len);
+    MP_THREAD_GIL_ENTER();
+    onewire_check(ok);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mach_onewire_write_obj, mach_onewire_write);
+
+/// \method select_rom(rom=None)
+/// Reset, then MATCH ROM with the given ROM or SKIP ROM without one. Returns
+/// the presence like reset().
+STATIC mp_obj_t mach_onewire_select_rom(mp_uint_t n_args, const mp_obj_t *args) {
+    mach_onewire_obj_t *self = onewire_get_self(args[0]);
+    uint8_t rom[8];
+    bool match = n_args > 1 && args[1] != mp_const_none;
+    if (match) {
+        onewire_get_rom(args[1], rom);
+    }
+    bool presence;
+    MP_THREAD_GIL_EXIT();
+    bool ok = onewire_select(self, match ? rom : NULL, &presence);
+    MP_THREAD_GIL_ENTER();
+    onewire_check(ok);
+    return mp_obj_new_bool(presence);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mach_onewire_select_rom_obj, 1, 2, mach_onewire_select_rom);
+
+/// \method scan()
+/// The ROM search done here rather than slot by slot from Python. Returns the
+/// ROMs of the devices on the bus, those failing their CRC are left out.
+STATIC mp_obj_t mach_onewire_scan(mp_obj_t self_in) {
+    mach_onewire_obj_t *self = onewire_get_self(self_in);
+    uint8_t *roms = m_new(uint8_t, ONEWIRE_SCAN_MAX * 8);
+    onewire_search_t search = { .last_discrepancy = 0, .last_device = false };
+    int n = 0;
+    int res = 0;
+    MP_THREAD_GIL_EXIT();
+    while (n < ONEWIRE_SCAN_MAX && (res = onewire_search_next(self, &search)) > 0) {
+        if (onewire_crc8(search.rom, 7) == search.rom[7]) {
+            memcpy(&roms[n++ * 8], search.rom, 8);
+        }
+    }
+    MP_THREAD_GIL_ENTER();
+    if (res < 0) {
+        m_del(uint8_t, roms, ONEWIRE_SCAN_MAX * 8);
+        mp_raise_OSError(MP_EIO);
+    }
+    mp_obj_t list = mp_obj_new_list(0, NULL);
+    for (int i = 0; i < n; i++) {
+        mp_obj_list_append(list, mp_obj_new_bytes(&roms[i * 8], 8));
+    }
+    m_del(uint8_t, roms, ONEWIRE_SCAN_MAX * 8);
+    return list;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_onewire_scan_obj, mach_onewire_scan);
+
+/// \method read_temps(roms)
+/// Starts the conversion of every DS18x20 on the bus at once with SKIP ROM, waits
+/// for the last one to finish and reads the scratchpad of each ROM given. Returns
+/// the temperatures in the same order, None for a device that didn't answer or
+/// failed the CRC. Parasite powered devices aren't supported.
+STATIC mp_obj_t mach_onewire_read_temps(mp_obj_t self_in, mp_obj_t roms_in) {
+    mach_onewire_obj_t *self = onewire_get_self(self_in);
+    size_t n_roms;
+    mp_obj_t *roms_items;
+    mp_obj_get_array(roms_in, &n_roms, &roms_items);
+    uint8_t *roms = m_new(uint8_t, n_roms * 8);
+    uint8_t *scratch = m_new(uint8_t, n_roms * 9);
+    bool *answered = m_new(bool, n_roms);
+    for (size_t i = 0; i < n_roms; i++) {
+        onewire_get_rom(roms_items[i], &roms[i * 8]);
+    }
+
+    bool presence;
+    MP_THREAD_GIL_EXIT();
+    uint8_t cmd = ONEWIRE_CONVERT_T;
+    bool ok = onewire_select(self, NULL, &presence) && (!presence || onewire_write(self, &cmd, 1));
+    if (ok && presence) {
+        // the devices answer read slots with 0s until they are all done
+        for (int waited = 0; waited < ONEWIRE_CONVERT_TIMEOUT_MS; waited += ONEWIRE_CONVERT_POLL_MS) {
+            vTaskDelay(ONEWIRE_CONVERT_POLL_MS / portTICK_PERIOD_MS);
+            int in = onewire_bits(self, 1, 1);
+            if (in != 0) {
+                ok = in > 0;
+                break;
+            }
+        }
+    }
+    memset(answered, 0, n_roms * sizeof(bool));
+    for (size_t i = 0; ok && presence && i < n_roms; i++) {
+        cmd = ONEWIRE_READ_SCRATCH;
+        ok = onewire_select(self, &roms[i * 8], &answered[i]) &&
+             (!answered[i] || (onewire_write(self, &cmd, 1) && onewire_read(self, &scratch[i * 9], 9)));
+    }
+    MP_THREAD_GIL_ENTER();
+    mp_obj_t list = mp_obj_new_list(0, NULL);
+    for (size_t i = 0; ok && i < n_roms; i++) {
+        const uint8_t *sp = &scratch[i * 9];
+        bool valid = answered[i] && onewire_crc8(sp, 8) == sp[8];
+        mp_obj_list_append(list, valid ? onewire_temp(&roms[i * 8], sp) : mp_const_none);
+    }
+    m_del(uint8_t, roms, n_roms * 8);
+    m_del(uint8_t, scratch, n_roms * 9);
+    m_del(bool, answered, n_roms);
+    onewire_check(ok);
+    return list;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mach_onewire_read_temps_obj, mach_onewire_read_temps);
+
+STATIC mp_obj_t mach_onewire_crc8(mp_obj_t data) {
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(data, &bufinfo, MP_BUFFER_READ);
+    return MP_OBJ_NEW_SMALL_INT(onewire_crc8(bufinfo.buf, bufinfo.len));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_onewire_crc8_fun_obj, mach_onewire_crc8);
+STATIC MP_DEFINE_CONST_STATICMETHOD_OBJ(mach_onewire_crc8_obj, (mp_obj_t)&mach_onewire_crc8_fun_obj);
+
+STATIC mp_obj_t mach_onewire_deinit(mp_obj_t self_in) {
+    mach_onewire_obj_t *self = self_in;
+    if (self->active) {
+        rmt_driver_uninstall(self->tx_channel);
+        rmt_driver_uninstall(self->rx_channel);
+        machrmt_release(self->tx_channel);
+        machrmt_release(self->rx_channel);
+        gpio_set_direction(self->gpio, GPIO_MODE_INPUT);
+        self->active = false;
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_onewire_deinit_obj, mach_onewire_deinit);
+
+STATIC const mp_map_elem_t mach_onewire_locals_dict_table[] = {
+    // instance methods
+    { MP_OBJ_NEW_QSTR(MP_QSTR_reset),               (mp_obj_t)&mach_onewire_reset_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_readbit),             (mp_obj_t)&mach_onewire_readbit_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_writebit),            (mp_obj_t)&mach_onewire_writebit_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_read),                (mp_obj_t)&mach_onewire_read_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_readinto),            (mp_obj_t)&mach_onewire_readinto_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_write),               (mp_obj_t)&mach_onewire_write_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_select_rom),          (mp_obj_t)&mach_onewire_select_rom_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_scan),                (mp_obj_t)&mach_onewire_scan_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_read_temps),          (mp_obj_t)&mach_onewire_read_temps_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_crc8),                (mp_obj_t)&mach_onewire_crc8_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_deinit),              (mp_obj_t)&mach_onewire_deinit_obj },
+};
+STATIC MP_DEFINE_CONST_DICT(mach_onewire_locals_dict, mach_onewire_locals_dict_table);
+
+const mp_obj_type_t mach_onewire_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_OneWire,
+    .make_new = mach_onewire_make_new,
+    .locals_dict = (mp_obj_t)&mach_onewire_locals_dict,
+};
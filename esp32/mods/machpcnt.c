@@ -0,0 +1,401 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "mpexception.h"
+#include "mpirq.h"
+#include "machpin.h"
+#include "machpcnt.h"
+
+#include "esp_attr.h"
+#include "esp_intr_alloc.h"
+#include "soc/soc.h"
+#include "soc/pcnt_struct.h"
+#include "driver/pcnt.h"
+#include "freertos/FreeRTOS.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define MACHPCNT_H_LIM                  (32767)
+#define MACHPCNT_L_LIM                  (-32768)
+#define MACHPCNT_FILTER_MAX             (1023)      // in APB clock cycles
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+typedef struct _mach_pcnt_obj_t {
+    mp_obj_base_t base;
+    mp_obj_t handler;
+    mp_obj_t handler_arg;
+    int unit;                           // -1 once deinit()
+} mach_pcnt_obj_t;
+
+// The unit counts in 16 bits and goes back to 0 on reaching either limit, the
+// interrupt then moves the limit into the 64 bit total
+typedef struct {
+    int32_t gpio;                       // of the pulse input, -1 while the unit is free
+    int64_t total;
+    // one shot callback once the count reaches threshold
+    bool armed;
+    int64_t threshold;
+    mach_pcnt_obj_t *owner;
+} machpcnt_unit_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+STATIC machpcnt_unit_t machpcnt_units[PCNT_UNIT_MAX] = {
+    [0 ... PCNT_UNIT_MAX - 1] = {.gpio = -1}
+};
+STATIC bool machpcnt_isr_installed;
+static portMUX_TYPE machpcnt_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+STATIC void machpcnt_callback_handler (void *arg) {
+    // called by the interrupt task
+    mach_pcnt_obj_t *self = arg;
+    if (self->handler && self->handler != mp_const_none) {
+        mp_call_function_1(self->handler, self->handler_arg);
+    }
+}
+
+// the threshold as an offset from the current total, if it's in reach of the unit
+STATIC IRAM_ATTR void machpcnt_load_threshold (int unit) {
+    machpcnt_unit_t *u = &machpcnt_units[unit];
+    int64_t offset = u->threshold - u->total;
+    if (u->armed && offset > MACHPCNT_L_LIM && offset < MACHPCNT_H_LIM && offset != 0) {
+        PCNT.conf_unit[unit].conf2.cnt_thres0 = (int16_t)offset;
+        PCNT.conf_unit[unit].conf0.thr_thres0_en = 1;
+    } else {
+        PCNT.conf_unit[unit].conf0.thr_thres0_en = 0;
+    }
+}
+
+STATIC IRAM_ATTR void machpcnt_isr (void *arg) {
+    int unit = (int)arg;
+    machpcnt_unit_t *u = &machpcnt_units[unit];
+    uint32_t status = PCNT.status_unit[unit].val;
+
+    portENTER_CRITICAL_ISR(&machpcnt_mux);
+    if (status & PCNT_STATUS_H_LIM_M) {
+        u->total += MACHPCNT_H_LIM;
+    }
+    if (status & PCNT_STATUS_L_LIM_M) {
+        u->total += MACHPCNT_L_LIM;
+    }
+    bool fire = (status & PCNT_STATUS_THRES0_M) && u->armed;
+    if (fire) {
+        u->armed = false;
+    }
+    machpcnt_load_threshold(unit);
+    portEXIT_CRITICAL_ISR(&machpcnt_mux);
+
+    if (fire && u->owner) {
+        mp_irq_queue_interrupt(machpcnt_callback_handler, u->owner);
+    }
+}
+
+STATIC int machpcnt_alloc (void) {
+    for (int i = 0; i < PCNT_UNIT_MAX; i++) {
+        if (machpcnt_units[i].gpio < 0) {
+            return i;
+        }
+    }
+    mp_raise_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable);
+}
+
+STATIC uint32_t machpcnt_filter (uint32_t filter_ns) {
+    uint32_t filter = filter_ns * (APB_CLK_FREQ / 1000000) / 1000;
+    if (filter > MACHPCNT_FILTER_MAX) {
+        mp_raise_ValueError("filter_ns too long");
+    }
+    return filter;
+}
+
+STATIC void machpcnt_config (const pcnt_config_t *config) {
+    if (pcnt_unit_config(config) != ESP_OK) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_operation_failed);
+    }
+}
+
+// the channels are configured, set the rest up and start counting
+STATIC void machpcnt_run (int unit, uint32_t gpio, uint32_t filter, mach_pcnt_obj_t *owner) {
+    if (filter > 0) {
+        pcnt_set_filter_value(unit, filter);
+        pcnt_filter_enable(unit);
+    } else {
+        pcnt_filter_disable(unit);
+    }
+    if (!machpcnt_isr_installed) {
+        pcnt_isr_service_install(ESP_INTR_FLAG_IRAM);
+        machpcnt_isr_installed = true;
+    }
+    machpcnt_unit_t *u = &machpcnt_units[unit];
+    u->gpio = gpio;
+    u->total = 0;
+    u->armed = false;
+    u->owner = owner;
+    pcnt_event_enable(unit, PCNT_EVT_H_LIM);
+    pcnt_event_enable(unit, PCNT_EVT_L_LIM);
+    pcnt_event_enable(unit, PCNT_EVT_THRES_0);
+    machpcnt_load_threshold(unit);
+    pcnt_isr_handler_add(unit, machpcnt_isr, (void *)unit);
+    pcnt_intr_enable(unit);
+    pcnt_counter_clear(unit);
+    pcnt_counter_resume(unit);
+}
+
+STATIC mach_pcnt_obj_t *machpcnt_get_self (mp_obj_t self_in) {
+    mach_pcnt_obj_t *self = self_in;
+    if (self->unit < 0) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_request_not_possible);
+    }
+    return self;
+}
+
+/******************************************************************************
+ DEFINE PUBLIC FUNCTIONS
+ ******************************************************************************/
+int machpcnt_find_pin (uint32_t gpio) {
+    for (int i = 0; i < PCNT_UNIT_MAX; i++) {
+        if (machpcnt_units[i].gpio == gpio) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int machpcnt_start_counter (uint32_t gpio, uint32_t edge, uint32_t filter_ns) {
+    if (edge < GPIO_INTR_POSEDGE || edge > GPIO_INTR_ANYEDGE) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    uint32_t filter = machpcnt_filter(filter_ns);
+    int unit = machpcnt_alloc();
+    pcnt_config_t config = {
+        .pulse_gpio_num = gpio,
+        .ctrl_gpio_num = PCNT_PIN_NOT_USED,
+        .lctrl_mode = PCNT_MODE_KEEP,
+        .hctrl_mode = PCNT_MODE_KEEP,
+        .pos_mode = (edge & GPIO_INTR_POSEDGE) ? PCNT_COUNT_INC : PCNT_COUNT_DIS,
+        .neg_mode = (edge & GPIO_INTR_NEGEDGE) ? PCNT_COUNT_INC : PCNT_COUNT_DIS,
+        .counter_h_lim = MACHPCNT_H_LIM,
+        .counter_l_lim = MACHPCNT_L_LIM,
+        .unit = unit,
+        .channel = PCNT_CHANNEL_0,
+    };
+    machpcnt_config(&config);
+    machpcnt_run(unit, gpio, filter, NULL);
+    return unit;
+}
+
+int64_t machpcnt_get (int unit, bool reset) {
+    int64_t total, check;
+    int16_t value;
+    // an overflow between the two reads shows as a change of the total
+    do {
+        portENTER_CRITICAL(&machpcnt_mux);
+        total = machpcnt_units[unit].total;
+        portEXIT_CRITICAL(&machpcnt_mux);
+        pcnt_get_counter_value(unit, &value);
+        portENTER_CRITICAL(&machpcnt_mux);
+        check = machpcnt_units[unit].total;
+        portEXIT_CRITICAL(&machpcnt_mux);
+    } while (total != check);
+    if (reset) {
+        pcnt_counter_clear(unit);
+        portENTER_CRITICAL(&machpcnt_mux);
+        machpcnt_units[unit].total = 0;
+        machpcnt_load_threshold(unit);
+        portEXIT_CRITICAL(&machpcnt_mux);
+    }
+    return total + value;
+}
+
+void machpcnt_stop (int unit) {
+    pcnt_counter_pause(unit);
+    pcnt_intr_disable(unit);
+    pcnt_isr_handler_remove(unit);
+    machpcnt_units[unit].owner = NULL;
+    machpcnt_units[unit].gpio = -1;
+}
+
+/******************************************************************************/
+// MicroPython bindings
+
+/// \class Counter(pin, *, edge=Pin.IRQ_RISING, filter_ns=0)
+STATIC mp_obj_t mach_counter_make_new (const mp_obj_type_t *type, mp_uint_t n_args, mp_uint_t n_kw, const mp_obj_t *all_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_pin,          MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_edge,         MP_ARG_KW_ONLY | MP_ARG_INT,  {.u_int = GPIO_INTR_POSEDGE} },
+        { MP_QSTR_filter_ns,    MP_ARG_KW_ONLY | MP_ARG_INT,  {.u_int = 0} },
+    };
+    mp_map_t kw_args;
+    mp_map_init_fixed_table(&kw_args, n_kw, all_args + n_args);
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, all_args, &kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+
+    pin_obj_t *pin = pin_find(args[0].u_obj);
+    if (machpcnt_find_pin(pin->pin_number) >= 0) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable);
+    }
+    mach_pcnt_obj_t *self = m_new_obj(mach_pcnt_obj_t);
+    self->base.type = type;
+    self->handler = NULL;
+    self->handler_arg = NULL;
+    self->unit = machpcnt_start_counter(pin->pin_number, args[1].u_int, args[2].u_int);
+    machpcnt_units[self->unit].owner = self;
+    return self;
+}
+
+/// \class Encoder(pin_a, pin_b, *, phases=4, filter_ns=0)
+/// Quadrature decoding, the count goes up or down with the direction. phases is
+/// the number of counts per cycle of the A input: 1, 2 or 4.
+STATIC mp_obj_t mach_encoder_make_new (const mp_obj_type_t *type, mp_uint_t n_args, mp_uint_t n_kw, const mp_obj_t *all_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_pin_a,        MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_pin_b,        MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_phases,       MP_ARG_KW_ONLY | MP_ARG_INT,  {.u_int = 4} },
+        { MP_QSTR_filter_ns,    MP_ARG_KW_ONLY | MP_ARG_INT,  {.u_int = 0} },
+    };
+    mp_map_t kw_args;
+    mp_map_init_fixed_table(&kw_args, n_kw, all_args + n_args);
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, all_args, &kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+
+    pin_obj_t *pin_a = pin_find(args[0].u_obj);
+    pin_obj_t *pin_b = pin_find(args[1].u_obj);
+    mp_int_t phases = args[2].u_int;
+    if ((phases != 1 && phases != 2 && phases != 4) || pin_a == pin_b) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    if (machpcnt_find_pin(pin_a->pin_number) >= 0) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable);
+    }
+    uint32_t filter = machpcnt_filter(args[3].u_int);
+    int unit = machpcnt_alloc();
+
+    // channel 0 counts the edges of A, B giving the direction
+    pcnt_config_t config = {
+        .pulse_gpio_num = pin_a->pin_number,
+        .ctrl_gpio_num = pin_b->pin_number,
+        .lctrl_mode = PCNT_MODE_REVERSE,
+        .hctrl_mode = PCNT_MODE_KEEP,
+        .pos_mode = PCNT_COUNT_DEC,
+        .neg_mode = (phases > 1) ? PCNT_COUNT_INC : PCNT_COUNT_DIS,
+        .counter_h_lim = MACHPCNT_H_LIM,
+        .counter_l_lim = MACHPCNT_L_LIM,
+        .unit = unit,
+        .channel = PCNT_CHANNEL_0,
+    };
+    machpcnt_config(&config);
+    // and channel 1 those of B for the full 4 counts per cycle
+    config.pulse_gpio_num = pin_b->pin_number;
+    config.ctrl_gpio_num = pin_a->pin_number;
+    config.channel = PCNT_CHANNEL_1;
+    if (phases == 4) {
+        config.pos_mode = PCNT_COUNT_INC;
+        config.neg_mode = PCNT_COUNT_DEC;
+    } else {
+        config.pos_mode = PCNT_COUNT_DIS;
+        config.neg_mode = PCNT_COUNT_DIS;
+    }
+    machpcnt_config(&config);
+
+    mach_pcnt_obj_t *self = m_new_obj(mach_pcnt_obj_t);
+    self->base.type = type;
+    self->handler = NULL;
+    self->handler_arg = NULL;
+    self->unit = unit;
+    machpcnt_run(unit, pin_a->pin_number, filter, self);
+    return self;
+}
+
+/// \method value(reset=False)
+STATIC mp_obj_t mach_pcnt_value (mp_uint_t n_args, const mp_obj_t *args) {
+    mach_pcnt_obj_t *self = machpcnt_get_self(args[0]);
+    return mp_obj_new_int_from_ll(machpcnt_get(self->unit, n_args > 1 && mp_obj_is_true(args[1])));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mach_pcnt_value_obj, 1, 2, mach_pcnt_value);
+
+/// \method irq(handler=None, value=0, *, arg=None)
+/// Calls the handler once, when the count reaches value. Counts that jump over the
+/// value between two interrupts of the unit (at 16 bit boundaries) don't fire.
+STATIC mp_obj_t mach_pcnt_irq (mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_handler,      MP_ARG_OBJ,                  {.u_obj = mp_const_none} },
+        { MP_QSTR_value,        MP_ARG_OBJ,                  {.u_obj = MP_OBJ_NEW_SMALL_INT(0)} },
+        { MP_QSTR_arg,          MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+    mach_pcnt_obj_t *self = machpcnt_get_self(pos_args[0]);
+    machpcnt_unit_t *u = &machpcnt_units[self->unit];
+
+    portENTER_CRITICAL(&machpcnt_mux);
+    u->armed = false;
+    machpcnt_load_threshold(self->unit);
+    portEXIT_CRITICAL(&machpcnt_mux);
+    mp_irq_remove(self);
+    INTERRUPT_OBJ_CLEAN(self);
+
+    if (args[0].u_obj != mp_const_none) {
+        self->handler = args[0].u_obj;
+        self->handler_arg = (args[2].u_obj == mp_const_none) ? self : args[2].u_obj;
+        mp_irq_add(self, self->handler);
+        int64_t threshold = mp_obj_get_int_truncated(args[1].u_obj);
+        portENTER_CRITICAL(&machpcnt_mux);
+        u->threshold = threshold;
+        u->armed = true;
+        machpcnt_load_threshold(self->unit);
+        portEXIT_CRITICAL(&machpcnt_mux);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_pcnt_irq_obj, 1, mach_pcnt_irq);
+
+STATIC mp_obj_t mach_pcnt_deinit (mp_obj_t self_in) {
+    mach_pcnt_obj_t *self = self_in;
+    if (self->unit >= 0) {
+        machpcnt_stop(self->unit);
+        self->unit = -1;
+        mp_irq_remove(self);
+        INTERRUPT_OBJ_CLEAN(self);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_pcnt_deinit_obj, mach_pcnt_deinit);
+
+STATIC const mp_map_elem_t mach_pcnt_locals_dict_table[] = {
+    { MP_OBJ_NEW_QSTR(MP_QSTR_value),               (mp_obj_t)&mach_pcnt_value_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_irq),                 (mp_obj_t)&mach_pcnt_irq_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_deinit),              (mp_obj_t)&mach_pcnt_deinit_obj },
+};
+STATIC MP_DEFINE_CONST_DICT(mach_pcnt_locals_dict, mach_pcnt_locals_dict_table);
+
+const mp_obj_type_t mach_counter_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_Counter,
+    .make_new = mach_counter_make_new,
+    .locals_dict = (mp_obj_t)&mach_pcnt_locals_dict,
+};
+
+const mp_obj_type_t mach_encoder_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_Encoder,
+    .make_new = mach_encoder_make_new,
+    .locals_dict = (mp_obj_t)&mach_pcnt_locals_dict,
+};
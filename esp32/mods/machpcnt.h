@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#ifndef MACHPCNT_H_
+#define MACHPCNT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+extern const mp_obj_type_t mach_counter_type;
+extern const mp_obj_type_t mach_encoder_type;
+
+/******************************************************************************
+ DECLARE FUNCTIONS
+ ******************************************************************************/
+// a plain edge counter on one pin, as Pin.counter() uses it
+int machpcnt_find_pin (uint32_t gpio);
+int machpcnt_start_counter (uint32_t gpio, uint32_t edge, uint32_t filter_ns);
+int64_t machpcnt_get (int unit, bool reset);
+void machpcnt_stop (int unit);
+
+#endif // MACHPCNT_H_
@@ -38,6 +38,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "py/mpconfig.h"
@@ -45,6 +46,9 @@
 #include "py/runtime.h"
 #include "py/gc.h"
 #include "py/mpstate.h"
+#include "py/mperrno.h"
+#include "py/binary.h"
+#include "py/objint.h"
 
 #include "esp_heap_caps.h"
 #include "sdkconfig.h"
@@ -53,9 +57,11 @@
 #include "nvs_flash.h"
 #include "esp_intr.h"
 #include "driver/rtc_io.h"
+#include "esp_timer.h"
 
 #include "gpio.h"
 #include "machpin.h"
+#include "machpcnt.h"
 #include "mpirq.h"
 #include "pins.h"
 //#include "pybsleep.h"
@@ -66,6 +72,8 @@
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "freertos/xtensa_api.h"
+#include "rom/ets_sys.h"
+#include "xtensa/hal.h"
 
 /******************************************************************************
 DECLARE PRIVATE FUNCTIONS
@@ -83,6 +91,14 @@ DEFINE CONSTANTS
 #define MACHPIN_SIMPLE_IN_LOW               0x30
 #define MACHPIN_SIMPLE_IN_HIGH              0x38
 #define ETS_GPIO_INUM                       13
+#define MACHPIN_NUM_GPIOS                   40
+#define MACHPIN_CAPTURE_MAX                 4096
+#define MACHPIN_CAPTURE_READ_CHUNK          32
+// the GPIOs that exist, and those that can drive an output (34-39 are inputs only)
+#define MACHPIN_PORT_IN_MASK                0xFF0EEFFFFFULL
+#define MACHPIN_PORT_OUT_MASK               0x030EEFFFFFULL
+// timed sequences run with the interrupts off, so they are kept short
+#define MACHPIN_PORT_PLAY_MAX_US            2000
 
 /******************************************************************************
 DEFINE TYPES
@@ -93,6 +109,20 @@ DEFINE TYPES
 //    int8_t     hib;
 //} pybpin_wake_pin_t;
 
+typedef struct {
+    int64_t     time;           // esp_timer_get_time() at the interrupt
+    uint32_t    level;
+} machpin_capture_event_t;
+
+// written by the interrupt, read by Python, in internal RAM as the ISR is IRAM
+typedef struct {
+    uint32_t    size;
+    uint32_t    head;
+    uint32_t    count;
+    uint32_t    lost;           // events coming in while the ring was full
+    machpin_capture_event_t events[];
+} machpin_capture_t;
+
 /******************************************************************************
 DECLARE PRIVATE DATA
 ******************************************************************************/
@@ -103,6 +133,10 @@ DECLARE PRIVATE DATA
 //                                      {.active = false, .lpds = PYBPIN_WAKES_NOT, .hib = PYBPIN_WAKES_NOT},
 //                                      {.active = false, .lpds = PYBPIN_WAKES_NOT, .hib = PYBPIN_WAKES_NOT},
 //                                      {.active = false, .lpds = PYBPIN_WAKES_NOT, .hib = PYBPIN_WAKES_NOT} } ;
+STATIC machpin_capture_t *machpin_captures[MACHPIN_NUM_GPIOS];
+static portMUX_TYPE machpin_capture_mux = portMUX_INITIALIZER_UNLOCKED;
+static portMUX_TYPE machpin_port_mux = portMUX_INITIALIZER_UNLOCKED;
+
 /******************************************************************************
  DEFINE PUBLIC FUNCTIONS
  ******************************************************************************/
@@ -324,12 +358,33 @@ STATIC IRAM_ATTR void call_interrupt_handler (pin_obj_t *pin) {
     }
 }
 
+STATIC IRAM_ATTR void machpin_capture_record (uint32_t gpio_num, int64_t time, uint32_t level) {
+    portENTER_CRITICAL_ISR(&machpin_capture_mux);
+    // read again under the lock, capture() may have just freed it
+    machpin_capture_t *capture = machpin_captures[gpio_num];
+    if (capture == NULL) {
+        // stopped
+    } else if (capture->count == capture->size) {
+        capture->lost++;
+    } else {
+        machpin_capture_event_t *ev = &capture->events[(capture->head + capture->count) % capture->size];
+        ev->time = time;
+        ev->level = level;
+        capture->count++;
+    }
+    portEXIT_CRITICAL_ISR(&machpin_capture_mux);
+}
+
 STATIC IRAM_ATTR void machpin_intr_process (void* arg) {
     uint32_t gpio_num = 0;
     uint32_t mask;
 
     uint32_t gpio_intr_status = READ_PERI_REG(GPIO_STATUS_REG);
     uint32_t gpio_intr_status_h = READ_PERI_REG(GPIO_STATUS1_REG);
+    // taken once for all the pins, as close to the edge as we get
+    int64_t now = esp_timer_get_time();
+    uint32_t gpio_in = READ_PERI_REG(GPIO_IN_REG);
+    uint32_t gpio_in_h = READ_PERI_REG(GPIO_IN1_REG);
 
 #ifdef MICROPY_LPWAN_DIO_PIN
     // fast path for the LPWAN DIO interrupt
@@ -349,6 +404,9 @@ STATIC IRAM_ATTR void machpin_intr_process (void* arg) {
     mask = 1;
     while (gpio_num < 32) {
         if (gpio_intr_status & mask) {
+            if (machpin_captures[gpio_num]) {
+                machpin_capture_record(gpio_num, now, (gpio_in & mask) != 0);
+            }
             pin_obj_t *self = (pin_obj_t *)pin_find_pin_by_num(&pin_cpu_pins_locals_dict, gpio_num);
             call_interrupt_handler(self);
         }
@@ -360,6 +418,9 @@ STATIC IRAM_ATTR void machpin_intr_process (void* arg) {
     mask = 1;
     while (gpio_num < 40) {
         if (gpio_intr_status_h & mask) {
+            if (machpin_captures[gpio_num]) {
+                machpin_capture_record(gpio_num, now, (gpio_in_h & mask) != 0);
+            }
             pin_obj_t *self = (pin_obj_t *)pin_find_pin_by_num(&pin_cpu_pins_locals_dict, gpio_num);
             call_interrupt_handler(self);
         }
@@ -615,12 +676,13 @@ STATIC void set_pin_callback_helper(mp_obj_t self_in, mp_obj_t handler, mp_obj_t
     self->handler_arg = handler_arg;
 }
 
-/// \method callback(trigger, handler, arg)
+/// \method callback(trigger, handler, arg, *, priority)
 STATIC mp_obj_t pin_callback(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     STATIC const mp_arg_t allowed_args[] = {
         { MP_QSTR_trigger,      MP_ARG_INT,                  {.u_int = GPIO_INTR_DISABLE} },
         { MP_QSTR_handler,      MP_ARG_OBJ,                  {.u_obj = mp_const_none} },
         { MP_QSTR_arg,          MP_ARG_OBJ,                  {.u_obj = mp_const_none} },
+        { MP_QSTR_priority,     MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = MP_IRQ_PRIORITY_NORMAL} },
     };
 
     // parse arguments
@@ -634,7 +696,7 @@ STATIC mp_obj_t pin_callback(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_
     if (args[0].u_int != GPIO_INTR_DISABLE && args[1].u_obj != mp_const_none) {
         set_pin_callback_helper(self, args[1].u_obj, args[2].u_obj);
         pin_extint_register(self, args[0].u_int, 0);
-        mp_irq_add(self, args[1].u_obj);
+        mp_irq_add_prio(self, args[1].u_obj, args[3].u_int);
         pin_irq_enable(self);
     } else {
         mp_irq_remove(self);
@@ -645,6 +707,246 @@ STATIC mp_obj_t pin_callback(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(pin_callback_obj, 1, pin_callback);
 
+/// \method capture(size, trigger=IRQ_RISING | IRQ_FALLING)
+/// Records the time and level of each edge, capture(0) stops. Uses the interrupt
+/// trigger of the pin, a callback keeps running alongside on the same edges.
+STATIC mp_obj_t pin_capture(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_size,         MP_ARG_REQUIRED | MP_ARG_INT, {.u_int = 0} },
+        { MP_QSTR_trigger,      MP_ARG_INT,                   {.u_int = GPIO_INTR_ANYEDGE} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+    pin_obj_t *self = pos_args[0];
+
+    mp_int_t size = args[0].u_int;
+    if (size < 0 || size > MACHPIN_CAPTURE_MAX) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+
+    machpin_capture_t *capture = NULL;
+    if (size > 0) {
+        capture = heap_caps_malloc(sizeof(machpin_capture_t) + size * sizeof(machpin_capture_event_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (capture == NULL) {
+            mp_raise_OSError(MP_ENOMEM);
+        }
+        capture->size = size;
+        capture->head = capture->count = capture->lost = 0;
+    }
+
+    pin_irq_disable(self);
+    portENTER_CRITICAL(&machpin_capture_mux);
+    machpin_capture_t *old = machpin_captures[self->pin_number];
+    machpin_captures[self->pin_number] = capture;
+    portEXIT_CRITICAL(&machpin_capture_mux);
+    free(old);
+    if (capture) {
+        pin_extint_register(self, args[1].u_int, 0);
+        pin_irq_enable(self);
+    } else if (self->handler) {
+        // the callback goes on
+        pin_irq_enable(self);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(pin_capture_obj, 2, pin_capture);
+
+/// \method capture_read()
+/// Returns ([(time_us, level), ...], lost) with the edges recorded since the last
+/// call, lost being those that didn't fit in the ring.
+STATIC mp_obj_t pin_capture_read(mp_obj_t self_in) {
+    pin_obj_t *self = self_in;
+    machpin_capture_t *capture = machpin_captures[self->pin_number];
+    if (capture == NULL) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_request_not_possible);
+    }
+
+    mp_obj_t list = mp_obj_new_list(0, NULL);
+    machpin_capture_event_t chunk[MACHPIN_CAPTURE_READ_CHUNK];
+    uint32_t lost = 0;
+    uint32_t n;
+    do {
+        // a few at a time, so the interrupt isn't kept waiting while the objects are made
+        portENTER_CRITICAL(&machpin_capture_mux);
+        n = MIN(capture->count, MACHPIN_CAPTURE_READ_CHUNK);
+        for (uint32_t i = 0; i < n; i++) {
+            chunk[i] = capture->events[capture->head];
+            capture->head = (capture->head + 1) % capture->size;
+        }
+        capture->count -= n;
+        lost += capture->lost;
+        capture->lost = 0;
+        portEXIT_CRITICAL(&machpin_capture_mux);
+
+        for (uint32_t i = 0; i < n; i++) {
+            mp_obj_t pair[2] = { mp_obj_new_int_from_ll(chunk[i].time), MP_OBJ_NEW_SMALL_INT(chunk[i].level) };
+            mp_obj_list_append(list, mp_obj_new_tuple(2, pair));
+        }
+    } while (n == MACHPIN_CAPTURE_READ_CHUNK);
+
+    mp_obj_t tuple[2] = { list, mp_obj_new_int_from_uint(lost) };
+    return mp_obj_new_tuple(2, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(pin_capture_read_obj, pin_capture_read);
+
+/// \method counter(edge=IRQ_RISING, *, filter_ns=0, reset=False)
+/// Counts the edges in hardware (PCNT) without interrupts per edge, and returns the
+/// count so far. counter(None) releases the unit. Pulses shorter than filter_ns,
+/// up to 12.7 us, are ignored.
+STATIC mp_obj_t pin_counter(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_edge,         MP_ARG_OBJ,                   {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_filter_ns,    MP_ARG_KW_ONLY | MP_ARG_INT,  {.u_int = 0} },
+        { MP_QSTR_reset,        MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+    pin_obj_t *self = pos_args[0];
+
+    int unit = machpcnt_find_pin(self->pin_number);
+    if (args[0].u_obj == mp_const_none) {
+        if (unit >= 0) {
+            machpcnt_stop(unit);
+        }
+        return mp_const_none;
+    }
+
+    if (unit < 0) {
+        mp_int_t edge = (args[0].u_obj == MP_OBJ_NULL) ? GPIO_INTR_POSEDGE : mp_obj_get_int(args[0].u_obj);
+        machpcnt_start_counter(self->pin_number, edge, args[1].u_int);
+        return MP_OBJ_NEW_SMALL_INT(0);
+    }
+    return mp_obj_new_int_from_ll(machpcnt_get(unit, args[2].u_bool));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(pin_counter_obj, 1, pin_counter);
+
+// An int as a GPIO bit mask, bit n being GPIOn, negative ones extended to all 64 bits
+STATIC uint64_t pin_port_get_bits (mp_obj_t bits_in) {
+    if (MP_OBJ_IS_SMALL_INT(bits_in)) {
+        return (int64_t)MP_OBJ_SMALL_INT_VALUE(bits_in);
+    }
+    if (!MP_OBJ_IS_INT(bits_in)) {
+        mp_raise_TypeError(NULL);
+    }
+    uint64_t bits;
+    mp_obj_int_to_bytes_impl(bits_in, false, sizeof(bits), (byte *)&bits);
+    return bits;
+}
+
+STATIC uint64_t pin_port_get_mask (mp_obj_t mask_in, uint64_t valid) {
+    uint64_t mask = pin_port_get_bits(mask_in);
+    if (mask & ~valid) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    return mask;
+}
+
+// The pins outside of the mask are left alone, the set and clear registers
+// make it safe against interrupts driving other pins of the same bank
+STATIC IRAM_ATTR void pin_port_write_value (uint64_t mask, uint64_t value) {
+    GPIO_REG_WRITE(GPIO_OUT_W1TS_REG, (uint32_t)(mask & value));
+    GPIO_REG_WRITE(GPIO_OUT_W1TC_REG, (uint32_t)(mask & ~value));
+    if (mask >> 32) {
+        GPIO_REG_WRITE(GPIO_OUT1_W1TS_REG, (uint32_t)((mask & value) >> 32));
+        GPIO_REG_WRITE(GPIO_OUT1_W1TC_REG, (uint32_t)((mask & ~value) >> 32));
+    }
+}
+
+STATIC IRAM_ATTR uint64_t pin_port_read_value (void) {
+    return GPIO_REG_READ(GPIO_IN_REG) | ((uint64_t)(GPIO_REG_READ(GPIO_IN1_REG) & 0xFF) << 32);
+}
+
+// Each step writes the next pattern, waits for the period and then samples the inputs
+STATIC IRAM_ATTR void pin_port_play_steps (uint64_t mask, const byte *patterns, size_t size, size_t n_steps,
+                                           uint32_t period_cycles, byte *into, size_t into_size) {
+    uint32_t next = xthal_get_ccount();
+    for (size_t i = 0; i < n_steps; i++) {
+        uint64_t value = 0;
+        memcpy(&value, patterns + i * size, size);
+        pin_port_write_value(mask, value);
+        next += period_cycles;
+        while ((int32_t)(xthal_get_ccount() - next) < 0);
+        if (into) {
+            uint64_t in = pin_port_read_value();
+            memcpy(into + i * into_size, &in, into_size);
+        }
+    }
+}
+
+/// \staticmethod port_write(mask, value)
+/// Drives all the pins in mask (bit n is GPIOn) at once, from the same bits of
+/// value. The pins must be outputs already, and toggle() doesn't see the change.
+STATIC mp_obj_t pin_port_write(mp_obj_t mask_in, mp_obj_t value_in) {
+    uint64_t mask = pin_port_get_mask(mask_in, MACHPIN_PORT_OUT_MASK);
+    pin_port_write_value(mask, pin_port_get_bits(value_in));
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(pin_port_write_fun_obj, pin_port_write);
+STATIC MP_DEFINE_CONST_STATICMETHOD_OBJ(pin_port_write_obj, (mp_obj_t)&pin_port_write_fun_obj);
+
+/// \staticmethod port_read(mask)
+/// Returns the level of all the pins in mask at once, as bits of an int.
+STATIC mp_obj_t pin_port_read(mp_obj_t mask_in) {
+    uint64_t mask = pin_port_get_mask(mask_in, MACHPIN_PORT_IN_MASK);
+    return mp_obj_new_int_from_ull(pin_port_read_value() & mask);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(pin_port_read_fun_obj, pin_port_read);
+STATIC MP_DEFINE_CONST_STATICMETHOD_OBJ(pin_port_read_obj, (mp_obj_t)&pin_port_read_fun_obj);
+
+/// \staticmethod port_play(mask, patterns, period_us=0, *, into=None)
+/// Writes the precomputed values of patterns (an array of ints) to the pins in mask
+/// one after the other, every period_us. If into is given, the inputs are sampled at
+/// the end of each step into it, eg the columns of a keypad while scanning its rows.
+/// With a period the steps are timed with the interrupts off, up to 2 ms in total;
+/// without one they follow each other as fast as possible.
+STATIC mp_obj_t pin_port_play(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_mask,         MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_patterns,     MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+        { MP_QSTR_period_us,    MP_ARG_INT,                   {.u_int = 0} },
+        { MP_QSTR_into,         MP_ARG_KW_ONLY | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+
+    uint64_t mask = pin_port_get_mask(args[0].u_obj, MACHPIN_PORT_OUT_MASK);
+    mp_buffer_info_t patterns;
+    mp_get_buffer_raise(args[1].u_obj, &patterns, MP_BUFFER_READ);
+    size_t size = mp_binary_get_size('@', patterns.typecode, NULL);
+    // the patterns must be wide enough for the highest pin of the mask
+    if (size > sizeof(uint64_t) || (size < sizeof(uint64_t) && (mask >> (size * 8)))) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    size_t n_steps = patterns.len / size;
+    mp_int_t period_us = args[2].u_int;
+    if (period_us < 0 || (uint64_t)period_us * n_steps > MACHPIN_PORT_PLAY_MAX_US) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+
+    byte *into = NULL;
+    size_t into_size = 0;
+    if (args[3].u_obj != mp_const_none) {
+        mp_buffer_info_t into_buf;
+        mp_get_buffer_raise(args[3].u_obj, &into_buf, MP_BUFFER_WRITE);
+        into_size = mp_binary_get_size('@', into_buf.typecode, NULL);
+        if (into_size > sizeof(uint64_t) || into_buf.len < n_steps * into_size) {
+            mp_raise_ValueError(mpexception_value_invalid_arguments);
+        }
+        into = into_buf.buf;
+    }
+
+    if (period_us > 0) {
+        portENTER_CRITICAL(&machpin_port_mux);
+        pin_port_play_steps(mask, patterns.buf, size, n_steps, period_us * ets_get_cpu_frequency(), into, into_size);
+        portEXIT_CRITICAL(&machpin_port_mux);
+    } else {
+        pin_port_play_steps(mask, patterns.buf, size, n_steps, 0, into, into_size);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(pin_port_play_fun_obj, 2, pin_port_play);
+STATIC MP_DEFINE_CONST_STATICMETHOD_OBJ(pin_port_play_obj, (mp_obj_t)&pin_port_play_fun_obj);
+
 void machpin_register_irq_c_handler(pin_obj_t *self, void *handler) {
     self->handler = handler;
     self->handler_arg = NULL;
@@ -661,6 +963,12 @@ STATIC const mp_map_elem_t pin_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_hold),                    (mp_obj_t)&pin_hold_obj },
 //    { MP_OBJ_NEW_QSTR(MP_QSTR_alt_list),                (mp_obj_t)&pin_alt_list_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_callback),                (mp_obj_t)&pin_callback_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_capture),                 (mp_obj_t)&pin_capture_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_capture_read),            (mp_obj_t)&pin_capture_read_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_counter),                 (mp_obj_t)&pin_counter_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_port_write),              (mp_obj_t)&pin_port_write_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_port_read),               (mp_obj_t)&pin_port_read_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_port_play),               (mp_obj_t)&pin_port_play_obj },
 
     // class attributes
     { MP_OBJ_NEW_QSTR(MP_QSTR_module),                  (mp_obj_t)&pin_module_pins_obj_type },
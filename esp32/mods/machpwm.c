@@ -26,15 +26,25 @@
 #include "periph_ctrl.h"
 #include "machpin.h"
 
+#include "soc/ledc_reg.h"
+#include "soc/ledc_struct.h"
+#include "freertos/FreeRTOS.h"
 
-STATIC mp_obj_t pwm_channel_duty(mp_obj_t self_in, mp_obj_t duty_o) {
-    mach_pwm_channel_obj_t *self = self_in;
+static portMUX_TYPE machpwm_mux = portMUX_INITIALIZER_UNLOCKED;
+
+STATIC float machpwm_get_duty(mp_obj_t duty_o) {
     float duty = mp_obj_get_float(duty_o);
     if (duty > 1.0f) {
         duty = 1.0f;
     } else if (duty < 0.0f) {
         duty = 0.0f;
     }
+    return duty;
+}
+
+STATIC mp_obj_t pwm_channel_duty(mp_obj_t self_in, mp_obj_t duty_o) {
+    mach_pwm_channel_obj_t *self = self_in;
+    float duty = machpwm_get_duty(duty_o);
 
     uint8_t duty_resolution = ((mach_pwm_timer_obj_t *)MP_STATE_PORT(mach_pwm_timer_obj[self->config.timer_sel]))->config.duty_resolution;
     uint32_t max_duty = (0x1 << duty_resolution) - 1;
@@ -110,12 +120,7 @@ STATIC mp_obj_t mach_pwm_channel_make_new(mp_uint_t n_args, const mp_obj_t *pos_
     float duty = 0.5f;
     if (args[2].u_obj != MP_OBJ_NULL) {
         // duty_cycle
-        duty = mp_obj_get_float(args[2].u_obj);
-        if (duty > 1.0f) {
-            duty = 1.0f;
-        } else if (duty < 0.0f) {
-            duty = 0.0f;
-        }
+        duty = machpwm_get_duty(args[2].u_obj);
     }
 
     uint32_t max_duty = (0x1 << pwm->config.duty_resolution) - 1;
@@ -213,6 +218,65 @@ STATIC mp_obj_t mach_pwm_init(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_pwm_init_obj, 1, mach_pwm_init);
 
+STATIC void mach_pwm_duty_many_add(mach_pwm_timer_obj_t *self, mp_obj_t id_o, mp_obj_t duty_o, uint32_t *duty_scaled) {
+    mp_uint_t id = mp_obj_get_int(id_o);
+    if (id > LEDC_CHANNEL_7 || self->mach_pwm_channel_obj_t[id] == NULL ||
+        self->mach_pwm_channel_obj_t[id]->config.timer_sel != self->config.timer_num) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    // a duty of 1 << duty_resolution keeps the output high, no need to stop the channel
+    float duty = machpwm_get_duty(duty_o);
+    duty_scaled[id] = (duty >= 0.999f) ? (1 << self->config.duty_resolution) :
+                                         (uint32_t)(((1 << self->config.duty_resolution) - 1) * duty);
+}
+
+/// \method duty_many(duties)
+/// Takes a dict or a sequence of (channel_id, duty_cycle) pairs. The new duty cycles
+/// are written to all the channels at once and the hardware latches them at the end
+/// of the running period, so the channels of the timer change together and no
+/// period is cut short.
+STATIC mp_obj_t mach_pwm_duty_many(mp_obj_t self_in, mp_obj_t duties_in) {
+    mach_pwm_timer_obj_t *self = self_in;
+    // a channel not in duties keeps its duty cycle, marked here by the invalid value
+    uint32_t duty_scaled[LEDC_CHANNEL_7 + 1];
+    memset(duty_scaled, 0xFF, sizeof(duty_scaled));
+
+    if (MP_OBJ_IS_TYPE(duties_in, &mp_type_dict)) {
+        mp_map_t *map = mp_obj_dict_get_map(duties_in);
+        for (mp_uint_t i = 0; i < map->alloc; i++) {
+            if (MP_MAP_SLOT_IS_FILLED(map, i)) {
+                mach_pwm_duty_many_add(self, map->table[i].key, map->table[i].value, duty_scaled);
+            }
+        }
+    } else {
+        mp_obj_t iter = mp_getiter(duties_in, NULL);
+        mp_obj_t item;
+        while ((item = mp_iternext(iter)) != MP_OBJ_STOP_ITERATION) {
+            mp_obj_t *pair;
+            mp_obj_get_array_fixed_n(item, 2, &pair);
+            mach_pwm_duty_many_add(self, pair[0], pair[1], duty_scaled);
+        }
+    }
+
+    portENTER_CRITICAL(&machpwm_mux);
+    for (int id = 0; id <= LEDC_CHANNEL_7; id++) {
+        if (duty_scaled[id] != UINT32_MAX) {
+            LEDC.channel_group[self->config.speed_mode].channel[id].duty.duty = duty_scaled[id] << 4;
+        }
+    }
+    for (int id = 0; id <= LEDC_CHANNEL_7; id++) {
+        if (duty_scaled[id] != UINT32_MAX) {
+            LEDC.channel_group[self->config.speed_mode].channel[id].conf0.sig_out_en = 1;
+            LEDC.channel_group[self->config.speed_mode].channel[id].conf1.val =
+                    LEDC_DUTY_START_HSCH0_M | LEDC_DUTY_INC_HSCH0_M |
+                    (1 << LEDC_DUTY_NUM_HSCH0_S) | (1 << LEDC_DUTY_CYCLE_HSCH0_S);
+        }
+    }
+    portEXIT_CRITICAL(&machpwm_mux);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mach_pwm_duty_many_obj, mach_pwm_duty_many);
+
 STATIC mp_obj_t mach_pwm_deinit(mp_obj_t self_in) {
     return mp_const_none;
 }
@@ -223,6 +287,7 @@ STATIC const mp_map_elem_t mach_pwm_timer_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_init),          (mp_obj_t)&mach_pwm_init_obj },
     // { MP_OBJ_NEW_QSTR(MP_QSTR_deinit),        (mp_obj_t)&mach_pwm_deinit_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_channel),       (mp_obj_t)&mach_pwm_channel_obj},
+    { MP_OBJ_NEW_QSTR(MP_QSTR_duty_many),     (mp_obj_t)&mach_pwm_duty_many_obj},
 };
 STATIC MP_DEFINE_CONST_DICT(mach_pwm_timer_locals_dict, mach_pwm_timer_locals_dict_table);
 
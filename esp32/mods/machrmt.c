@@ -7,10 +7,13 @@
  * available at https://www.pycom.io/opensource/licensing
  */
 
+#include <string.h>
+
 #include "py/mpstate.h"
 #include "py/runtime.h"
 #include "py/obj.h"
 #include "py/objtuple.h"
+#include "py/objarray.h"
 #include "esp_err.h"
 #include "machpin.h"
 #include "rmt.h"
@@ -25,13 +28,21 @@
 #define RMT_RESOLUTION_1000NS  ((uint8_t)80)   /* Maximum measured pulse-width: ~32.768 ms */
 #define RMT_RESOLUTION_3125NS  ((uint8_t)250)  /* Maximum measured pulse-width: ~102.4  ms */
 
+/* Number of complete RX bursts the ringbuffer can hold while the receiver keeps running */
+#define RMT_RX_BURSTS          (4)
+/* Size of one burst in the ringbuffer, see the comment at the driver install */
+#define RMT_RX_BURST_SIZE      (130 * sizeof(rmt_item32_t) + sizeof(size_t) + sizeof(int))
+
 /******************************************************************************
  DEFINE PRIVATE TYPES
  ******************************************************************************/
 struct _mach_rmt_obj_t {
     mp_obj_base_t base;
     rmt_config_t config;
+    rmt_item32_t *tx_items;     /* Items still being sent when not waiting for the TX to finish */
     bool is_used;
+    bool rx_running;
+    bool is_claimed;            /* Used by another driver through machrmt_claim() */
 };
 
 /******************************************************************************
@@ -50,8 +61,94 @@ static mach_rmt_obj_t mach_rmt_obj[RMT_CHANNEL_MAX] = {
 };
 
 
+STATIC void mach_rmt_tx_release(mach_rmt_obj_t *self) {
+    if (self->tx_items != NULL) {
+        MP_THREAD_GIL_EXIT();
+        rmt_wait_tx_done(self->config.channel, portMAX_DELAY);
+        MP_THREAD_GIL_ENTER();
+        free(self->tx_items);
+        self->tx_items = NULL;
+    }
+}
+
+STATIC void mach_rmt_uninstall(mach_rmt_obj_t *self) {
+    mach_rmt_tx_release(self);
+    if (self->rx_running) {
+        rmt_rx_stop(self->config.channel);
+        self->rx_running = false;
+    }
+    /* Deregister the previously registered GPIO */
+    gpio_matrix_out(mach_rmt_obj[self->config.channel].config.gpio_num, SIG_GPIO_OUT_IDX, 0, 0);
+    rmt_driver_uninstall(self->config.channel);
+    self->is_used = false;
+}
+
+STATIC void mach_rmt_check_claimed(mach_rmt_obj_t *self) {
+    if (self->is_claimed) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "RMT channel is used by another driver!"));
+    }
+}
+
+/******************************************************************************
+ DEFINE PUBLIC FUNCTIONS
+ ******************************************************************************/
+
+/* Reserves a channel for a driver of its own, the first free one when channel is -1 */
+rmt_channel_t machrmt_claim(int channel, gpio_num_t gpio) {
+    for(int i = RMT_CHANNEL_2; i < RMT_CHANNEL_MAX; i++) {
+        if(mach_rmt_obj[i].is_used == true && mach_rmt_obj[i].config.gpio_num == gpio) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "The given Pin is already used by other RMT channel!"));
+        }
+    }
+    if(channel < 0) {
+        for(int i = RMT_CHANNEL_MAX - 1; i >= RMT_CHANNEL_2; i--) {
+            if(mach_rmt_obj[i].is_used == false) {
+                channel = i;
+                break;
+            }
+        }
+        if(channel < 0) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "No free RMT channel!"));
+        }
+    }
+    else if(channel <= RMT_CHANNEL_1 || channel >= RMT_CHANNEL_MAX) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "Channel is invalid!"));
+    }
+    else if(mach_rmt_obj[channel].is_used == true) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "RMT channel is already used!"));
+    }
+    mach_rmt_obj[channel].config.gpio_num = gpio;
+    mach_rmt_obj[channel].is_used = true;
+    mach_rmt_obj[channel].is_claimed = true;
+    return channel;
+}
+
+/* The receiving half of a bidirectional bus, on the pin of a channel claimed for sending */
+rmt_channel_t machrmt_claim_rx(rmt_channel_t tx_channel) {
+    for(int i = RMT_CHANNEL_MAX - 1; i >= RMT_CHANNEL_2; i--) {
+        if(mach_rmt_obj[i].is_used == false) {
+            mach_rmt_obj[i].config.gpio_num = mach_rmt_obj[tx_channel].config.gpio_num;
+            mach_rmt_obj[i].is_used = true;
+            mach_rmt_obj[i].is_claimed = true;
+            return i;
+        }
+    }
+    nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "No free RMT channel!"));
+}
+
+void machrmt_release(rmt_channel_t channel) {
+    mach_rmt_obj[channel].is_used = false;
+    mach_rmt_obj[channel].is_claimed = false;
+}
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+
 STATIC mp_obj_t mach_rmt_init_helper(mach_rmt_obj_t *self, const mp_arg_val_t *args) {
 
+    mach_rmt_check_claimed(self);
+
     if(args[0].u_obj == mp_const_none) {
         nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "GPIO must be defined!"));  
     }
@@ -70,10 +167,7 @@ STATIC mp_obj_t mach_rmt_init_helper(mach_rmt_obj_t *self, const mp_arg_val_t *a
 
     /* After it is checked that the given GPIO is correct uninstall the driver if needed */
     if(self->is_used == true) {
-        /* Deregister the previously registered GPIO */
-        gpio_matrix_out(mach_rmt_obj[self->config.channel].config.gpio_num, SIG_GPIO_OUT_IDX, 0, 0);
-        rmt_driver_uninstall(self->config.channel);
-        self->is_used = false;
+        mach_rmt_uninstall(self);
     }
 
     mach_rmt_obj[self->config.channel].config.gpio_num = gpio;
@@ -157,8 +251,10 @@ STATIC mp_obj_t mach_rmt_init_helper(mach_rmt_obj_t *self, const mp_arg_val_t *a
          * where sizeof(size_t) + sizeof(int) is the header/administration cost of the Ringbuffer.
          * 128*sizeof(rmt_item32_t) + sizeof(size_t) + sizeof(int) is not enough, it does not allow to receive
          * 128 pulses after each other due to a bug/behavior in Ringbuffer's implementation
+          * Room for several bursts is reserved, so that a running receiver doesn't lose the next
+         * one while the previous is being processed.
          **/
-        retval = rmt_driver_install(self->config.channel, 130*sizeof(rmt_item32_t) + sizeof(size_t) + sizeof(int), 0);
+        retval = rmt_driver_install(self->config.channel, RMT_RX_BURSTS * RMT_RX_BURST_SIZE, 0);
         if(retval != ESP_OK) {
             if(retval == ESP_ERR_NO_MEM) {
                 nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Not enough memory to initialize RMT driver!"));
@@ -230,10 +326,9 @@ STATIC mp_obj_t mach_rmt_deinit(mp_obj_t self_in) {
 
     mach_rmt_obj_t *self = self_in;
 
+    mach_rmt_check_claimed(self);
     if(self->is_used == true){
-        gpio_matrix_out(mach_rmt_obj[self->config.channel].config.gpio_num, SIG_GPIO_OUT_IDX, 0, 0);
-        rmt_driver_uninstall(self->config.channel);
-        self->is_used = false;
+        mach_rmt_uninstall(self);
     }
 
     return mp_const_none;
@@ -392,11 +487,19 @@ STATIC mp_obj_t mach_rmt_pulses_send(mp_uint_t n_args, const mp_obj_t *pos_args,
         }
     }
 
+    /* The previous transmission might still be reading its items */
+    mach_rmt_tx_release(self);
+
     MP_THREAD_GIL_EXIT();
     esp_err_t retval = rmt_write_items(self->config.channel, items_to_send, items_to_send_count, wait_tx_done);
     MP_THREAD_GIL_ENTER();
 
-    free(items_to_send);
+    /* The driver keeps refilling the channel memory from the items until the end, so they can only be freed then */
+    if (wait_tx_done || retval != ESP_OK) {
+        free(items_to_send);
+    } else {
+        self->tx_items = items_to_send;
+    }
 
     if (retval != ESP_OK) {
         nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Could not send data!"));
@@ -469,7 +572,9 @@ STATIC mp_obj_t mach_rmt_pulses_get(mp_uint_t n_args, const mp_obj_t *pos_args,
 
     rmt_wait_tx_done(self->config.channel, portMAX_DELAY);
     rmt_get_ringbuf_handle(self->config.channel, &ringbuf);
-    rmt_rx_start(self->config.channel, true);
+    if(self->rx_running == false) {
+        rmt_rx_start(self->config.channel, true);
+    }
 
     /* Wait until required number of pulses received */
     while(total_received < number_of_rmt_item_to_receive) {
@@ -512,17 +617,203 @@ STATIC mp_obj_t mach_rmt_pulses_get(mp_uint_t n_args, const mp_obj_t *pos_args,
         }
     }
     rmt_rx_stop(self->config.channel);
+    self->rx_running = false;
 
     return mp_obj_new_tuple(((mp_obj_list_t*)ret_items)->len, ((mp_obj_list_t*)ret_items)->items);
 
 }
 MP_DEFINE_CONST_FUN_OBJ_KW(mach_rmt_pulses_get_obj, 0, mach_rmt_pulses_get);
 
+/* The buffers of send(), recv() and recv_into() hold one 16 bit value per pulse, the level in the MSB
+ * and the duration in the 15 lower bits, which is exactly the layout of the halves of an rmt_item32_t */
+#define RMT_PULSE_DURATION(p)   ((p) & 0x7FFF)
+
+STATIC mach_rmt_obj_t *mach_rmt_get_channel(mp_obj_t self_in, rmt_mode_t mode) {
+    mach_rmt_obj_t *self = self_in;
+
+    if(self->is_used == false){
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "RMT channel is not initialized!"));
+    }
+    if(self->config.rmt_mode != mode) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, (mode == RMT_MODE_TX) ? "RMT channel is configured for RX!" : "RMT channel is configured for TX!"));
+    }
+    return self;
+}
+
+STATIC TickType_t mach_rmt_get_timeout(mp_obj_t timeout_o) {
+    if(timeout_o == mp_const_none) {
+        return portMAX_DELAY;
+    }
+    return mp_obj_get_int(timeout_o) / portTICK_PERIOD_MS;
+}
+
+STATIC mp_obj_t mach_rmt_send(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+
+    STATIC const mp_arg_t mach_rmt_send_args[] = {
+        { MP_QSTR_pulses,                 MP_ARG_OBJ | MP_ARG_REQUIRED, },
+        { MP_QSTR_wait_tx_done,           MP_ARG_BOOL | MP_ARG_KW_ONLY, {.u_bool = true} },
+    };
+
+    // parse args
+    mp_arg_val_t args[MP_ARRAY_SIZE(mach_rmt_send_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), mach_rmt_send_args, args);
+
+    mach_rmt_obj_t *self = mach_rmt_get_channel(pos_args[0], RMT_MODE_TX);
+    bool wait_tx_done = args[1].u_bool;
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[0].u_obj, &bufinfo, MP_BUFFER_READ);
+    mp_uint_t pulses = bufinfo.len / sizeof(uint16_t);
+    if(pulses == 0) {
+        return mp_const_none;
+    }
+    mp_uint_t items_count = (pulses / 2) + (pulses % 2);
+
+    /* The previous transmission might still be reading its items */
+    mach_rmt_tx_release(self);
+
+    /* When waiting for the end an even number of aligned pulses can be sent right from the buffer,
+     * otherwise the items must outlive the call or need a terminating half */
+    rmt_item32_t *items = bufinfo.buf;
+    bool copied = false;
+    if(!wait_tx_done || (pulses % 2) != 0 || ((uint32_t)bufinfo.buf & 3) != 0) {
+        items = malloc(items_count * sizeof(rmt_item32_t));
+        if(items == NULL) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_MemoryError, "Not enough memory to send the pulses!"));
+        }
+        items[items_count - 1].val = 0;
+        memcpy(items, bufinfo.buf, pulses * sizeof(uint16_t));
+        copied = true;
+    }
+
+    MP_THREAD_GIL_EXIT();
+    esp_err_t retval = rmt_write_items(self->config.channel, items, items_count, wait_tx_done);
+    MP_THREAD_GIL_ENTER();
+
+    if(copied) {
+        if(wait_tx_done || retval != ESP_OK) {
+            free(items);
+        } else {
+            self->tx_items = items;
+        }
+    }
+
+    if (retval != ESP_OK) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Could not send data!"));
+    }
+
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_KW(mach_rmt_send_obj, 1, mach_rmt_send);
+
+/* Waits for the next burst and copies at most max_pulses of it to dest, returns the number of pulses copied.
+ * The receiver is left running so that the bursts arriving meanwhile are queued in the ringbuffer. */
+STATIC mp_uint_t mach_rmt_recv_burst(mach_rmt_obj_t *self, uint16_t *dest, mp_uint_t max_pulses, TickType_t timeout, mp_obj_t *burst_o) {
+    RingbufHandle_t ringbuf = NULL;
+    size_t received = 0;
+
+    rmt_get_ringbuf_handle(self->config.channel, &ringbuf);
+    if(self->rx_running == false) {
+        rmt_rx_start(self->config.channel, true);
+        self->rx_running = true;
+    }
+
+    MP_THREAD_GIL_EXIT();
+    uint16_t *pulses = (uint16_t *)xRingbufferReceive(ringbuf, &received, timeout);
+    MP_THREAD_GIL_ENTER();
+    if(pulses == NULL) {
+        return 0;
+    }
+
+    /* The burst ends with the first pulse of zero duration */
+    mp_uint_t count = received / sizeof(uint16_t);
+    for(mp_uint_t i = 0; i < count; i++) {
+        if(RMT_PULSE_DURATION(pulses[i]) == 0) {
+            count = i;
+            break;
+        }
+    }
+    if(burst_o != NULL) {
+        /* Don't hold on to the ringbuffer space if there isn't enough memory for the array */
+        nlr_buf_t nlr;
+        if(nlr_push(&nlr) == 0) {
+            *burst_o = mp_obj_new_array('H', count);
+            nlr_pop();
+        } else {
+            vRingbufferReturnItem(ringbuf, (void *)pulses);
+            nlr_jump(nlr.ret_val);
+        }
+        dest = ((mp_obj_array_t *)MP_OBJ_TO_PTR(*burst_o))->items;
+    } else if(count > max_pulses) {
+        count = max_pulses;
+    }
+    memcpy(dest, pulses, count * sizeof(uint16_t));
+
+    /* Free the fetched memory area in the buffer */
+    vRingbufferReturnItem(ringbuf, (void *)pulses);
+    return count;
+}
+
+STATIC mp_obj_t mach_rmt_recv(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+
+    STATIC const mp_arg_t mach_rmt_recv_args[] = {
+        { MP_QSTR_timeout,                MP_ARG_OBJ | MP_ARG_KW_ONLY, {.u_obj = mp_const_none} },
+    };
+
+    // parse args
+    mp_arg_val_t args[MP_ARRAY_SIZE(mach_rmt_recv_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), mach_rmt_recv_args, args);
+
+    mach_rmt_obj_t *self = mach_rmt_get_channel(pos_args[0], RMT_MODE_RX);
+
+    mp_obj_t burst = mp_const_none;
+    mach_rmt_recv_burst(self, NULL, 0, mach_rmt_get_timeout(args[0].u_obj), &burst);
+    return burst;
+}
+MP_DEFINE_CONST_FUN_OBJ_KW(mach_rmt_recv_obj, 1, mach_rmt_recv);
+
+STATIC mp_obj_t mach_rmt_recv_into(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+
+    STATIC const mp_arg_t mach_rmt_recv_into_args[] = {
+        { MP_QSTR_buf,                    MP_ARG_OBJ | MP_ARG_REQUIRED, },
+        { MP_QSTR_timeout,                MP_ARG_OBJ | MP_ARG_KW_ONLY, {.u_obj = mp_const_none} },
+    };
+
+    // parse args
+    mp_arg_val_t args[MP_ARRAY_SIZE(mach_rmt_recv_into_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), mach_rmt_recv_into_args, args);
+
+    mach_rmt_obj_t *self = mach_rmt_get_channel(pos_args[0], RMT_MODE_RX);
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[0].u_obj, &bufinfo, MP_BUFFER_WRITE);
+
+    mp_uint_t count = mach_rmt_recv_burst(self, bufinfo.buf, bufinfo.len / sizeof(uint16_t), mach_rmt_get_timeout(args[1].u_obj), NULL);
+    return mp_obj_new_int(count);
+}
+MP_DEFINE_CONST_FUN_OBJ_KW(mach_rmt_recv_into_obj, 1, mach_rmt_recv_into);
+
+STATIC mp_obj_t mach_rmt_recv_stop(mp_obj_t self_in) {
+
+    mach_rmt_obj_t *self = mach_rmt_get_channel(self_in, RMT_MODE_RX);
+
+    if(self->rx_running == true) {
+        rmt_rx_stop(self->config.channel);
+        self->rx_running = false;
+    }
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_1(mach_rmt_recv_stop_obj, mach_rmt_recv_stop);
+
 STATIC const mp_map_elem_t mach_rmt_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_init),                (mp_obj_t)&mach_rmt_init_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_deinit),              (mp_obj_t)&mach_rmt_deinit_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_pulses_send),         (mp_obj_t)&mach_rmt_pulses_send_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_pulses_get),          (mp_obj_t)&mach_rmt_pulses_get_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_send),                (mp_obj_t)&mach_rmt_send_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_recv),                (mp_obj_t)&mach_rmt_recv_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_recv_into),           (mp_obj_t)&mach_rmt_recv_into_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_recv_stop),           (mp_obj_t)&mach_rmt_recv_stop_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_LOW),                 MP_OBJ_NEW_SMALL_INT(RMT_CARRIER_LEVEL_LOW) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_HIGH),                MP_OBJ_NEW_SMALL_INT(RMT_CARRIER_LEVEL_HIGH) },
 };
@@ -10,7 +10,13 @@
 #ifndef MACHRMT_H_
 #define MACHRMT_H_
 
+#include "driver/rmt.h"
+
 extern const mp_obj_type_t mach_rmt_type;
 typedef struct _mach_rmt_obj_t mach_rmt_obj_t;
 
+extern rmt_channel_t machrmt_claim(int channel, gpio_num_t gpio);
+extern rmt_channel_t machrmt_claim_rx(rmt_channel_t tx_channel);
+extern void machrmt_release(rmt_channel_t channel);
+
 #endif  // MACHRMT_H_
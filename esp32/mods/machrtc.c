@@ -11,6 +11,7 @@
 #include <string.h>
 
 #include "lwip/apps/sntp.h"
+#include "freertos/FreeRTOS.h"
 
 #include "py/nlr.h"
 #include "py/obj.h"
@@ -18,11 +19,15 @@
 #include "py/runtime.h"
 #include "timeutils.h"
 #include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
 #include "mpexception.h"
+#include "mpsleep.h"
 #include "machrtc.h"
 #include "soc/rtc.h"
 #include "esp_clk.h"
 #include "esp_clk_internal.h"
+#include "rom/crc.h"
 
 
 uint32_t sntp_update_period = 3600000; // in ms
@@ -37,6 +42,14 @@ uint32_t sntp_update_period = 3600000; // in ms
 */
 #define MEM_USER_MAXLEN     2048
 
+/* Time corrections once the clock is set (periodic NTP updates, a drifting RTC
+    after deep sleep) are slewed at 500 ppm like ntpd does, so time.time() never
+    goes backwards. Only larger errors, the first sync and RTC.init() step it.
+*/
+#define WALL_SLEW_PPM       500
+#define WALL_STEP_US        (60 * 1000000ll)
+#define MONO_MAGIC          0x4D4F4E4F      // "MONO"
+
 /******************************************************************************
  DECLARE PRIVATE DATA
  ******************************************************************************/
@@ -49,24 +62,74 @@ typedef struct _mach_rtc_obj_t {
 } mach_rtc_obj_t;
 
 static RTC_DATA_ATTR uint32_t rtc_user_mem_len;
+static RTC_DATA_ATTR uint32_t rtc_user_mem_schema;     // CRC of the store() format, 0 for memory()
+static RTC_DATA_ATTR uint32_t rtc_user_mem_crc;
 static RTC_DATA_ATTR uint8_t rtc_user_mem_data[MEM_USER_MAXLEN];
 
+// the monotonic time and the RTC timer when going to deep sleep, the sleep time is added on wake up
+static RTC_DATA_ATTR uint64_t rtc_mono_sleep_us;
+static RTC_DATA_ATTR uint64_t rtc_mono_sleep_rtc_us;
+static RTC_DATA_ATTR uint32_t rtc_mono_magic;
+// esp_timer_get_time() counts from this boot, the base makes it count from power on
+static int64_t rtc_mono_base;
+
+// the disciplined wall clock is the monotonic time plus this offset
+static int64_t rtc_wall_offset;
+static uint64_t rtc_wall_updated;
+static bool rtc_wall_step;
+static portMUX_TYPE rtc_wall_mux = portMUX_INITIALIZER_UNLOCKED;
+
 STATIC mach_rtc_obj_t mach_rtc_obj;
 const mp_obj_type_t mach_rtc_type;
 
+STATIC uint64_t mach_rtc_system_us (void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)(tv.tv_sec * 1000000ull ) + (tv.tv_usec);
+}
+
 void rtc_init0(void) {
     mach_rtc_set_us_since_epoch(0);
 }
 
+void mach_rtc_mono_init (void) {
+    uint64_t base = 0;
+    if (mpsleep_get_reset_cause() == MPSLEEP_DEEPSLEEP_RESET && rtc_mono_magic == MONO_MAGIC) {
+        uint64_t rtc_now = esp_clk_rtc_time();
+        base = rtc_mono_sleep_us;
+        if (rtc_now > rtc_mono_sleep_rtc_us) {
+            base += rtc_now - rtc_mono_sleep_rtc_us;
+        }
+    }
+    rtc_mono_magic = 0;
+    rtc_mono_base = (int64_t)base - esp_timer_get_time();
+    rtc_wall_step = true;
+}
+
+void mach_rtc_mono_save (void) {
+    rtc_mono_sleep_us = mach_rtc_ticks_us64();
+    rtc_mono_sleep_rtc_us = esp_clk_rtc_time();
+    rtc_mono_magic = MONO_MAGIC;
+}
+
+IRAM_ATTR uint64_t mach_rtc_ticks_us64 (void) {
+    return rtc_mono_base + esp_timer_get_time();
+}
+
 void mach_rtc_set_us_since_epoch(uint64_t nowus) {
     struct timeval tv;
     // store the packet timestamp
     tv.tv_usec = nowus % 1000000ull;
     tv.tv_sec = nowus / 1000000ull;
     settimeofday(&tv, NULL);
+    rtc_wall_step = true;
 }
 
 void mach_rtc_synced (void) {
+    // called by SNTP after it set the system time, the first sync after ntp_sync() steps
+    if (!mach_rtc_obj.synced) {
+        rtc_wall_step = true;
+    }
     mach_rtc_obj.synced = true;
 }
 
@@ -74,11 +137,30 @@ bool mach_is_rtc_synced (void) {
     return mach_rtc_obj.synced;
 }
 
+// the system time minus the monotonic one only changes when the system time is set,
+// the offset of the wall clock follows it at most at WALL_SLEW_PPM
 uint64_t mach_rtc_get_us_since_epoch(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (uint64_t)(tv.tv_sec * 1000000ull ) + (tv.tv_usec);
-    
+    uint64_t now = mach_rtc_ticks_us64();
+    int64_t target = (int64_t)mach_rtc_system_us() - (int64_t)now;
+
+    portENTER_CRITICAL(&rtc_wall_mux);
+    int64_t error = target - rtc_wall_offset;
+    int64_t slew = (int64_t)(now - rtc_wall_updated) * WALL_SLEW_PPM / 1000000;
+    if (rtc_wall_step || error > WALL_STEP_US || error < -WALL_STEP_US) {
+        rtc_wall_offset = target;
+        rtc_wall_step = false;
+    } else if (error > slew) {
+        rtc_wall_offset += slew;
+    } else if (error < -slew) {
+        rtc_wall_offset -= slew;
+    } else {
+        rtc_wall_offset = target;
+    }
+    rtc_wall_updated = now;
+    int64_t offset = rtc_wall_offset;
+    portEXIT_CRITICAL(&rtc_wall_mux);
+
+    return now + offset;
 }
 
 STATIC uint64_t mach_rtc_datetime_us(const mp_obj_t datetime) {
@@ -257,35 +339,82 @@ STATIC mp_obj_t mach_rtc_has_synced (mp_obj_t self_in) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_rtc_has_synced_obj, mach_rtc_has_synced);
 
+STATIC uint32_t machine_rtc_memory_crc (void) {
+    uint32_t crc = crc32_le(0, (uint8_t *)&rtc_user_mem_schema, sizeof(rtc_user_mem_schema));
+    return crc32_le(crc, rtc_user_mem_data, rtc_user_mem_len);
+}
+
+// anything but what was written last, e.g. after a brown out, reads as empty
+STATIC bool machine_rtc_memory_valid (uint32_t schema) {
+    return rtc_user_mem_len <= MEM_USER_MAXLEN && rtc_user_mem_schema == schema &&
+           rtc_user_mem_crc == machine_rtc_memory_crc();
+}
+
+STATIC void machine_rtc_memory_write (uint32_t schema, const void *data, size_t len) {
+    if (len > MEM_USER_MAXLEN) {
+        mp_raise_ValueError("buffer too long");
+    }
+    memcpy(rtc_user_mem_data, data, len);
+    rtc_user_mem_len = len;
+    rtc_user_mem_schema = schema;
+    rtc_user_mem_crc = machine_rtc_memory_crc();
+}
+
+STATIC uint32_t machine_rtc_schema (mp_obj_t fmt_in) {
+    size_t len;
+    const char *fmt = mp_obj_str_get_data(fmt_in, &len);
+    // never 0, that is the raw memory() contents
+    return crc32_le(0, (const uint8_t *)fmt, len) | 1;
+}
+
 STATIC mp_obj_t machine_rtc_memory (size_t n_args, const mp_obj_t *args) {
 
     if (n_args == 1) {
         // read RTC memory
-        uint32_t len = rtc_user_mem_len;
-        uint8_t rtcram[MEM_USER_MAXLEN];
-        memcpy( (char *) rtcram, (char *) rtc_user_mem_data, len);
-        return mp_obj_new_bytes(rtcram,  len);
+        if (!machine_rtc_memory_valid(0)) {
+            return mp_const_empty_bytes;
+        }
+        return mp_obj_new_bytes(rtc_user_mem_data, rtc_user_mem_len);
     } else {
         // write RTC memory
         mp_buffer_info_t bufinfo;
         mp_get_buffer_raise(args[1], &bufinfo, MP_BUFFER_READ);
-
-        if (bufinfo.len > MEM_USER_MAXLEN) {
-            mp_raise_ValueError("buffer too long");
-        }
-        memcpy( (char *) rtc_user_mem_data, (char *) bufinfo.buf, bufinfo.len);
-        rtc_user_mem_len = bufinfo.len;
+        machine_rtc_memory_write(0, bufinfo.buf, bufinfo.len);
         return mp_const_none;
     }
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(machine_rtc_memory_obj, 1, 2, machine_rtc_memory);
 
+// store(fmt, v1, v2, ...) keeps the values packed as ustruct.pack() does, load(fmt)
+// gives them back as a tuple, or None when nothing was stored with that format
+STATIC mp_obj_t machine_rtc_store (size_t n_args, const mp_obj_t *args) {
+    mp_obj_t ustruct = mp_import_name(MP_QSTR_ustruct, mp_const_none, MP_OBJ_NEW_SMALL_INT(0));
+    mp_obj_t packed = mp_call_function_n_kw(mp_load_attr(ustruct, MP_QSTR_pack), n_args - 1, 0, args + 1);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(packed, &bufinfo, MP_BUFFER_READ);
+    machine_rtc_memory_write(machine_rtc_schema(args[1]), bufinfo.buf, bufinfo.len);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(machine_rtc_store_obj, 2, MP_OBJ_FUN_ARGS_MAX, machine_rtc_store);
+
+STATIC mp_obj_t machine_rtc_load (mp_obj_t self_in, mp_obj_t fmt_in) {
+    if (!machine_rtc_memory_valid(machine_rtc_schema(fmt_in))) {
+        return mp_const_none;
+    }
+    mp_obj_t ustruct = mp_import_name(MP_QSTR_ustruct, mp_const_none, MP_OBJ_NEW_SMALL_INT(0));
+    return mp_call_function_2(mp_load_attr(ustruct, MP_QSTR_unpack), fmt_in,
+                              mp_obj_new_bytes(rtc_user_mem_data, rtc_user_mem_len));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(machine_rtc_load_obj, machine_rtc_load);
+
 STATIC const mp_map_elem_t mach_rtc_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_init),                (mp_obj_t)&mach_rtc_init_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_now),                 (mp_obj_t)&mach_rtc_now_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_ntp_sync),            (mp_obj_t)&mach_rtc_ntp_sync_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_synced),              (mp_obj_t)&mach_rtc_has_synced_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_memory),                 (mp_obj_t)&machine_rtc_memory_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_store),               (mp_obj_t)&machine_rtc_store_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_load),                (mp_obj_t)&machine_rtc_load_obj },
 
     { MP_OBJ_NEW_QSTR(MP_QSTR_INTERNAL_RC),         MP_OBJ_NEW_SMALL_INT(RTC_SOURCE_INTERNAL_RC) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_XTAL_32KHZ),          MP_OBJ_NEW_SMALL_INT(RTC_SOURCE_EXTERNAL_XTAL) },
@@ -58,6 +58,7 @@
 #include "spi.h"
 #include "machspi.h"
 #include "mpexception.h"
+#include "pwrmgr.h"
 #include "mpsleep.h"
 #include "machpin.h"
 #include "pins.h"
@@ -85,6 +86,7 @@ typedef struct _mach_spi_obj_t {
  DEFINE CONSTANTS
  ******************************************************************************/
 #define MACH_SPI_FIRST_BIT_MSB                    0
+#define MACH_SPI_DATA_BUF_SIZE                    64      // W0-W15 data registers
 /******************************************************************************
  DECLARE PRIVATE DATA
  ******************************************************************************/
@@ -103,6 +105,15 @@ static const uint32_t mach_spi_pin_af[1][3] = { {HSPICLK_OUT_IDX, HSPID_OUT_IDX,
 /******************************************************************************
  DEFINE PRIVATE FUNCTIONS
  ******************************************************************************/
+// the bus clock is derived from the APB clock, which must stay up while any bus is on
+STATIC void machspi_update_pwrmgr (void) {
+    bool active = false;
+    for (int i = 0; i < MP_ARRAY_SIZE(mach_spi_obj); i++) {
+        active |= mach_spi_obj[i].baudrate > 0;
+    }
+    pwrmgr_hold(PWRMGR_SPI, active);
+}
+
 // only master mode is available for the moment
 STATIC void machspi_init (const mach_spi_obj_t *self) {
     if (self->spi_num == SpiNum_SPI2) {
@@ -186,34 +197,41 @@ static int spi_master_send_recv_data(spi_num_e spiNum, spi_data_t* pData) {
     return 0;
 }
 
-STATIC void pybspi_transfer (mach_spi_obj_t *self, const char *txdata, char *rxdata, uint32_t len, uint32_t *txchar) {
-    if (!self->baudrate) {
-        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_request_not_possible));
+STATIC void machspi_transfer (mach_spi_obj_t *self, const char *txdata, char *rxdata, uint32_t len, uint32_t *txchar) {
+    uint32_t _txdata[MACH_SPI_DATA_BUF_SIZE / 4];
+    uint32_t _rxdata[MACH_SPI_DATA_BUF_SIZE / 4];
+    if (!txdata) {
+        // fill the data buffer once with the word to repeat
+        uint32_t _txchar = txchar ? *txchar : 0x55555555;
+        for (int i = 0; i < MACH_SPI_DATA_BUF_SIZE; i += self->wlen) {
+            memcpy((uint8_t *)_txdata + i, &_txchar, self->wlen);
+        }
     }
-    // send and receive the data
-    for (int i = 0; i < len; i += self->wlen) {
-        uint32_t _rxdata = 0;
-        uint32_t _txdata;
+    // send and receive the data, using the whole hardware buffer on each transaction
+    // (the buffer size is a multiple of every word length so words are never split)
+    for (uint32_t i = 0; i < len; i += MACH_SPI_DATA_BUF_SIZE) {
+        uint32_t chunk = MIN(len - i, MACH_SPI_DATA_BUF_SIZE);
         if (txdata) {
-            memcpy(&_txdata, &txdata[i], self->wlen);
-        } else {
-            if (txchar) {
-                _txdata = *txchar;
-            } else {
-                _txdata = 0x55555555;
-            }
+            memcpy(_txdata, &txdata[i], chunk);
         }
         spi_data_t spidata = {.cmd = 0, .cmdLen = 0, .addr = NULL, .addrLen = 0,
-                                .txData = &_txdata, .txDataLen = self->wlen,
-                                .rxData = &_rxdata, .rxDataLen = self->wlen};
+                                .txData = _txdata, .txDataLen = chunk,
+                                .rxData = _rxdata, .rxDataLen = chunk};
 
         spi_master_send_recv_data(self->spi_num, &spidata);
         if (rxdata) {
-            memcpy(&rxdata[i], &_rxdata, self->wlen);
+            memcpy(&rxdata[i], _rxdata, chunk);
         }
     }
 }
 
+STATIC void pybspi_transfer (mach_spi_obj_t *self, const char *txdata, char *rxdata, uint32_t len, uint32_t *txchar) {
+    if (!self->baudrate) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_request_not_possible));
+    }
+    machspi_transfer(self, txdata, rxdata, len, txchar);
+}
+
 static void spi_assign_pins_af (mach_spi_obj_t *self, mp_obj_t *pins) {
     uint32_t spi_idx = self->spi_num - 2;
     for (int i = 0; i < 3; i++) {
@@ -246,6 +264,19 @@ static void spi_deassign_pins_af (mach_spi_obj_t *self) {
     }
 }
 
+/******************************************************************************
+ DEFINE PUBLIC FUNCTIONS
+ ******************************************************************************/
+// for the native drivers, which write without holding the GIL and so cannot raise
+bool machspi_write (mp_obj_t self_in, const uint8_t *data, uint32_t len) {
+    mach_spi_obj_t *self = self_in;
+    if (!self->baudrate) {
+        return false;
+    }
+    machspi_transfer(self, (const char *)data, NULL, len, NULL);
+    return true;
+}
+
 /******************************************************************************/
 /* Micro Python bindings                                                      */
 /******************************************************************************/
@@ -321,6 +352,7 @@ STATIC mp_obj_t pyb_spi_init_helper(mach_spi_obj_t *self, const mp_arg_val_t *ar
 
     // init the bus
     machspi_init((const mach_spi_obj_t *)self);
+    machspi_update_pwrmgr();
 
     return mp_const_none;
 
@@ -380,6 +412,7 @@ STATIC mp_obj_t pyb_spi_deinit(mp_obj_t self_in) {
     if (self->baudrate > 0) {
         self->baudrate = 0;
         spi_deassign_pins_af(self);
+        machspi_update_pwrmgr();
     }
     return mp_const_none;
 }
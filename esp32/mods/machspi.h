@@ -39,4 +39,6 @@
 
 extern const mp_obj_type_t mach_spi_type;
 
+extern bool machspi_write (mp_obj_t self_in, const uint8_t *data, uint32_t len);
+
 #endif  // MACHSPI_H_
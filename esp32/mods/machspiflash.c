@@ -0,0 +1,671 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/mpthread.h"
+#include "py/mperrno.h"
+#include "extmod/vfs.h"
+#include "mpexception.h"
+#include "machpin.h"
+#include "pins.h"
+#include "pycom_config.h"
+#include "machspiflash.h"
+
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/timers.h"
+#include "driver/spi_master.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define SPIFLASH_CMD_WRSR                   (0x01)
+#define SPIFLASH_CMD_PP                     (0x02)
+#define SPIFLASH_CMD_RDSR                   (0x05)
+#define SPIFLASH_CMD_WREN                   (0x06)
+#define SPIFLASH_CMD_FAST_READ              (0x0B)
+#define SPIFLASH_CMD_SE                     (0x20)
+#define SPIFLASH_CMD_RDSR2                  (0x35)
+#define SPIFLASH_CMD_QUAD_READ              (0x6B) // quad output, command and address on one line
+#define SPIFLASH_CMD_SUSPEND                (0x75)
+#define SPIFLASH_CMD_RESUME                 (0x7A)
+#define SPIFLASH_CMD_RDID                   (0x9F)
+
+#define SPIFLASH_SR_WIP                     (0x01)
+#define SPIFLASH_SR2_QE                     (0x02)
+
+#define SPIFLASH_BLOCK_SIZE                 (4096)  // the erase sector of the chip, what the cache holds
+#define SPIFLASH_PAGE_SIZE                  (256)
+#define SPIFLASH_SECTOR_SIZE                (512)   // what the filesystem sees
+#define SPIFLASH_SECTORS_PER_BLOCK          (SPIFLASH_BLOCK_SIZE / SPIFLASH_SECTOR_SIZE)
+#define SPIFLASH_SIZE_MAX                   (16 * 1024 * 1024)  // 24 bit addresses
+
+#define SPIFLASH_BAUDRATE_DEFAULT           (40000000)
+#define SPIFLASH_CACHE_BLOCKS               (4)
+#define SPIFLASH_CACHE_BLOCKS_PSRAM         (16)
+#define SPIFLASH_IDLE_FLUSH_MS              (1000)
+#define SPIFLASH_BUSY_SPINS                 (100000)
+#define SPIFLASH_ERASE_TIMEOUT_MS           (1000)
+#define SPIFLASH_TASK_STACK_SIZE            (2048)
+#define SPIFLASH_TASK_PRIORITY              (3)
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+typedef struct {
+    uint8_t *data;
+    uint32_t addr;
+    uint32_t used;          // LRU stamp
+    bool dirty;
+} spiflash_cache_entry_t;
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t erases;
+    uint32_t suspends;
+} spiflash_stats_t;
+
+typedef struct _mach_spiflash_obj_t {
+    mp_obj_base_t base;
+    spi_device_handle_t dev;
+    uint8_t *dma_buf;                   // one block, what all the transfers go through
+    spiflash_cache_entry_t *cache;
+    uint32_t cache_count;
+    uint32_t cache_clock;
+    uint32_t size;
+    SemaphoreHandle_t mutex;            // the bus and the cache
+    TimerHandle_t idle_timer;
+    TaskHandle_t task;
+    spiflash_cache_entry_t *flushing;   // written back by the task, never evicted meanwhile
+    volatile bool erasing;              // by the task, with the mutex given back
+    spiflash_stats_t stats;
+    uint8_t host;
+    bool quad;
+    bool enabled;
+} mach_spiflash_obj_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+#if defined(WIPY) || defined(GPY)
+STATIC mach_spiflash_obj_t mach_spiflash_obj[2] = { {.host = HSPI_HOST}, {.host = VSPI_HOST} };
+STATIC const mp_obj_t mach_spiflash_def_pin[2][3] = { {&PIN_MODULE_P10, &PIN_MODULE_P11, &PIN_MODULE_P14},
+                                                      {&PIN_MODULE_P19, &PIN_MODULE_P20, &PIN_MODULE_P21} };
+#else
+STATIC mach_spiflash_obj_t mach_spiflash_obj[1] = { {.host = HSPI_HOST} };
+STATIC const mp_obj_t mach_spiflash_def_pin[1][3] = { {&PIN_MODULE_P10, &PIN_MODULE_P11, &PIN_MODULE_P14} };
+#endif
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+// The functions below are called with the mutex taken and the GIL released
+
+// one command, with its address and either data to send or data to receive
+STATIC bool spiflash_cmd (mach_spiflash_obj_t *self, uint8_t cmd, int addr_bits, uint32_t addr,
+                          const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len) {
+    spi_transaction_ext_t t;
+    memset(&t, 0, sizeof(t));
+    t.base.flags = SPI_TRANS_VARIABLE_CMD | SPI_TRANS_VARIABLE_ADDR | SPI_TRANS_VARIABLE_DUMMY;
+    t.base.cmd = cmd;
+    t.base.addr = addr;
+    t.command_bits = 8;
+    t.address_bits = addr_bits;
+    if (cmd == SPIFLASH_CMD_FAST_READ || cmd == SPIFLASH_CMD_QUAD_READ) {
+        t.dummy_bits = 8;
+    }
+    if (cmd == SPIFLASH_CMD_QUAD_READ) {
+        t.base.flags |= SPI_TRANS_MODE_QIO;
+    }
+    if (tx_len > 0 && tx_len <= 4) {
+        t.base.flags |= SPI_TRANS_USE_TXDATA;
+        memcpy(t.base.tx_data, tx, tx_len);
+    } else {
+        t.base.tx_buffer = tx;
+    }
+    t.base.length = tx_len * 8;
+    if (rx_len > 0 && rx_len <= 4) {
+        t.base.flags |= SPI_TRANS_USE_RXDATA;
+    } else {
+        t.base.rx_buffer = rx;
+    }
+    t.base.rxlength = rx_len * 8;
+    if (spi_device_transmit(self->dev, (spi_transaction_t *)&t) != ESP_OK) {
+        return false;
+    }
+    if (rx_len > 0 && rx_len <= 4) {
+        memcpy(rx, t.base.rx_data, rx_len);
+    }
+    return true;
+}
+
+STATIC int spiflash_read_sr (mach_spiflash_obj_t *self, uint8_t cmd) {
+    uint8_t sr;
+    return spiflash_cmd(self, cmd, 0, 0, NULL, 0, &sr, 1) ? sr : -1;
+}
+
+// a page program takes a millisecond at most, it's spun for
+STATIC bool spiflash_wait_ready (mach_spiflash_obj_t *self) {
+    for (int i = 0; i < SPIFLASH_BUSY_SPINS; i++) {
+        int sr = spiflash_read_sr(self, SPIFLASH_CMD_RDSR);
+        if (sr < 0) {
+            return false;
+        }
+        if (!(sr & SPIFLASH_SR_WIP)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+STATIC bool spiflash_write_enable (mach_spiflash_obj_t *self) {
+    return spiflash_cmd(self, SPIFLASH_CMD_WREN, 0, 0, NULL, 0, NULL, 0);
+}
+
+// a background erase is suspended for the time of the read, as the chip
+// answers nothing else while erasing
+STATIC bool spiflash_read (mach_spiflash_obj_t *self, uint32_t addr, uint8_t *dest, size_t len) {
+    bool suspended = false;
+    if (self->erasing) {
+        if (!spiflash_cmd(self, SPIFLASH_CMD_SUSPEND, 0, 0, NULL, 0, NULL, 0) || !spiflash_wait_ready(self)) {
+            return false;
+        }
+        self->stats.suspends++;
+        suspended = true;
+    }
+    bool ok = spiflash_cmd(self, self->quad ? SPIFLASH_CMD_QUAD_READ : SPIFLASH_CMD_FAST_READ, 24, addr,
+                           NULL, 0, self->dma_buf, len);
+    if (ok) {
+        memcpy(dest, self->dma_buf, len);
+    }
+    if (suspended) {
+        ok &= spiflash_cmd(self, SPIFLASH_CMD_RESUME, 0, 0, NULL, 0, NULL, 0);
+    }
+    return ok;
+}
+
+STATIC bool spiflash_start_erase (mach_spiflash_obj_t *self, uint32_t addr) {
+    self->stats.erases++;
+    return spiflash_write_enable(self) && spiflash_cmd(self, SPIFLASH_CMD_SE, 24, addr, NULL, 0, NULL, 0);
+}
+
+// the erase takes tens of milliseconds, the other tasks get the CPU meanwhile
+STATIC bool spiflash_wait_erase (mach_spiflash_obj_t *self, bool give_mutex) {
+    for (int waited = 0; waited < SPIFLASH_ERASE_TIMEOUT_MS; waited += portTICK_PERIOD_MS) {
+        int sr = spiflash_read_sr(self, SPIFLASH_CMD_RDSR);
+        if (sr < 0) {
+            return false;
+        }
+        if (!(sr & SPIFLASH_SR_WIP)) {
+            return true;
+        }
+        if (give_mutex) {
+            xSemaphoreGive(self->mutex);
+        }
+        vTaskDelay(1);
+        if (give_mutex) {
+            xSemaphoreTake(self->mutex, portMAX_DELAY);
+        }
+    }
+    return false;
+}
+
+STATIC bool spiflash_program (mach_spiflash_obj_t *self, spiflash_cache_entry_t *entry) {
+    for (uint32_t off = 0; off < SPIFLASH_BLOCK_SIZE; off += SPIFLASH_PAGE_SIZE) {
+        memcpy(self->dma_buf, &entry->data[off], SPIFLASH_PAGE_SIZE);
+        if (!spiflash_write_enable(self) ||
+            !spiflash_cmd(self, SPIFLASH_CMD_PP, 24, entry->addr + off, self->dma_buf, SPIFLASH_PAGE_SIZE, NULL, 0) ||
+            !spiflash_wait_ready(self)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// a background erase going on is let finish first
+STATIC void spiflash_wait_idle (mach_spiflash_obj_t *self) {
+    while (self->erasing) {
+        xSemaphoreGive(self->mutex);
+        vTaskDelay(1);
+        xSemaphoreTake(self->mutex, portMAX_DELAY);
+    }
+}
+
+STATIC bool spiflash_write_back (mach_spiflash_obj_t *self, spiflash_cache_entry_t *entry) {
+    spiflash_wait_idle(self);
+    if (!spiflash_start_erase(self, entry->addr) || !spiflash_wait_erase(self, false)) {
+        return false;
+    }
+    entry->dirty = false;
+    return spiflash_program(self, entry);
+}
+
+STATIC bool spiflash_flush (mach_spiflash_obj_t *self) {
+    for (uint32_t i = 0; i < self->cache_count; i++) {
+        if (self->cache[i].dirty && !spiflash_write_back(self, &self->cache[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// returns the entry holding the block, evicting the least recently used one on a miss
+STATIC spiflash_cache_entry_t *spiflash_cache_get (mach_spiflash_obj_t *self, uint32_t block_addr, bool load) {
+    for (;;) {
+        spiflash_cache_entry_t *victim = NULL;
+        for (uint32_t i = 0; i < self->cache_count; i++) {
+            spiflash_cache_entry_t *entry = &self->cache[i];
+            if (entry->addr == block_addr) {
+                self->stats.hits++;
+                entry->used = ++self->cache_clock;
+                return entry;
+            }
+            if (entry == self->flushing) {
+                continue;
+            }
+            if (!victim || entry->addr == UINT32_MAX || (victim->addr != UINT32_MAX && entry->used < victim->used)) {
+                victim = entry;
+            }
+        }
+        if (victim == NULL || (victim->dirty && self->erasing)) {
+            // the cache changes while the mutex is given back, look again after
+            spiflash_wait_idle(self);
+            continue;
+        }
+        self->stats.misses++;
+        if (victim->dirty && !spiflash_write_back(self, victim)) {
+            return NULL;
+        }
+        victim->addr = UINT32_MAX;
+        // a block that's about to be overwritten completely doesn't need to be read first
+        if (load && !spiflash_read(self, block_addr, victim->data, SPIFLASH_BLOCK_SIZE)) {
+            return NULL;
+        }
+        victim->addr = block_addr;
+        victim->used = ++self->cache_clock;
+        return victim;
+    }
+}
+
+STATIC bool spiflash_sectors (mach_spiflash_obj_t *self, uint8_t *buf, uint32_t sector, uint32_t count, bool write) {
+    bool ok = true;
+    xSemaphoreTake(self->mutex, portMAX_DELAY);
+    for (uint32_t i = 0; ok && i < count; i++) {
+        uint32_t index = (sector + i) % SPIFLASH_SECTORS_PER_BLOCK;
+        uint32_t block_addr = ((sector + i) / SPIFLASH_SECTORS_PER_BLOCK) * SPIFLASH_BLOCK_SIZE;
+        bool whole_block = write && index == 0 && count - i >= SPIFLASH_SECTORS_PER_BLOCK;
+        spiflash_cache_entry_t *entry = spiflash_cache_get(self, block_addr, !whole_block);
+        if (entry == NULL) {
+            ok = false;
+        } else if (write) {
+            memcpy(&entry->data[index * SPIFLASH_SECTOR_SIZE], buf, SPIFLASH_SECTOR_SIZE);
+            entry->dirty = true;
+        } else {
+            memcpy(buf, &entry->data[index * SPIFLASH_SECTOR_SIZE], SPIFLASH_SECTOR_SIZE);
+        }
+        buf += SPIFLASH_SECTOR_SIZE;
+    }
+    xSemaphoreGive(self->mutex);
+    if (write) {
+        // the dirty blocks go out once the filesystem has been quiet for a while
+        xTimerReset(self->idle_timer, 0);
+    }
+    return ok;
+}
+
+// the task writes the dirty blocks back one at a time, giving the mutex back
+// while each one is erased so that reads can suspend the erase
+STATIC void TASK_SPIFlash (void *pvParameters) {
+    mach_spiflash_obj_t *self = pvParameters;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        xSemaphoreTake(self->mutex, portMAX_DELAY);
+        for (uint32_t i = 0; self->enabled && i < self->cache_count; i++) {
+            spiflash_cache_entry_t *entry = &self->cache[i];
+            if (!entry->dirty) {
+                continue;
+            }
+            self->flushing = entry;
+            if (spiflash_start_erase(self, entry->addr)) {
+                self->erasing = true;
+                bool erased = spiflash_wait_erase(self, true);
+                self->erasing = false;
+                if (erased) {
+                    // whatever was written meanwhile is in the data programmed now
+                    entry->dirty = false;
+                    if (!spiflash_program(self, entry)) {
+                        entry->dirty = true;
+                    }
+                }
+            }
+            self->flushing = NULL;
+        }
+        xSemaphoreGive(self->mutex);
+    }
+}
+
+STATIC void spiflash_idle_flush (TimerHandle_t timer) {
+    mach_spiflash_obj_t *self = pvTimerGetTimerID(timer);
+    xTaskNotifyGive(self->task);
+}
+
+STATIC void spiflash_hw_deinit (mach_spiflash_obj_t *self) {
+    if (self->enabled) {
+        xSemaphoreTake(self->mutex, portMAX_DELAY);
+        spiflash_flush(self);
+        self->enabled = false;
+        xSemaphoreGive(self->mutex);
+        xTimerStop(self->idle_timer, 0);
+        spi_bus_remove_device(self->dev);
+        spi_bus_free(self->host);
+        for (uint32_t i = 0; i < self->cache_count; i++) {
+            heap_caps_free(self->cache[i].data);
+        }
+        free(self->cache);
+        self->cache = NULL;
+        self->cache_count = 0;
+        heap_caps_free(self->dma_buf);
+        self->dma_buf = NULL;
+    }
+}
+
+STATIC bool spiflash_cache_alloc (mach_spiflash_obj_t *self, mp_int_t count) {
+    bool psram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM) > 0;
+    if (count <= 0) {
+        count = psram ? SPIFLASH_CACHE_BLOCKS_PSRAM : SPIFLASH_CACHE_BLOCKS;
+    }
+    self->cache = calloc(count, sizeof(spiflash_cache_entry_t));
+    if (self->cache == NULL) {
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        self->cache[i].data = heap_caps_malloc(SPIFLASH_BLOCK_SIZE, psram ? MALLOC_CAP_SPIRAM : MALLOC_CAP_INTERNAL);
+        if (self->cache[i].data == NULL) {
+            // work with the blocks we've got
+            count = i;
+            break;
+        }
+        self->cache[i].addr = UINT32_MAX;
+    }
+    self->cache_count = count;
+    return count > 0;
+}
+
+// the capacity from the JEDEC id, and the quad enable bit set when asked for
+STATIC bool spiflash_probe (mach_spiflash_obj_t *self) {
+    uint8_t id[3];
+    if (!spiflash_cmd(self, SPIFLASH_CMD_RDID, 0, 0, NULL, 0, id, 3) || id[2] < 16 || id[2] > 31) {
+        return false;
+    }
+    self->size = MIN(1u << id[2], SPIFLASH_SIZE_MAX);
+    if (self->quad) {
+        int sr = spiflash_read_sr(self, SPIFLASH_CMD_RDSR);
+        int sr2 = spiflash_read_sr(self, SPIFLASH_CMD_RDSR2);
+        if (sr < 0 || sr2 < 0) {
+            return false;
+        }
+        if (!(sr2 & SPIFLASH_SR2_QE)) {
+            uint8_t data[2] = { sr, sr2 | SPIFLASH_SR2_QE };
+            if (!spiflash_write_enable(self) || !spiflash_cmd(self, SPIFLASH_CMD_WRSR, 0, 0, data, 2, NULL, 0) ||
+                !spiflash_wait_ready(self)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+STATIC mach_spiflash_obj_t *spiflash_get_self (mp_obj_t self_in) {
+    mach_spiflash_obj_t *self = self_in;
+    if (!self->enabled) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_request_not_possible);
+    }
+    return self;
+}
+
+STATIC mp_obj_t spiflash_blocks (mp_obj_t self_in, mp_obj_t block_num, mp_obj_t buf, bool write) {
+    mach_spiflash_obj_t *self = self_in;
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(buf, &bufinfo, write ? MP_BUFFER_READ : MP_BUFFER_WRITE);
+    uint32_t sector = mp_obj_get_int(block_num);
+    uint32_t count = bufinfo.len / SPIFLASH_SECTOR_SIZE;
+    bool ok = false;
+    if (self->enabled && sector + count <= self->size / SPIFLASH_SECTOR_SIZE) {
+        MP_THREAD_GIL_EXIT();
+        ok = spiflash_sectors(self, bufinfo.buf, sector, count, write);
+        MP_THREAD_GIL_ENTER();
+    }
+    return MP_OBJ_NEW_SMALL_INT(!ok); // return of 0 means success
+}
+
+STATIC mp_obj_t mach_spiflash_init_helper (mach_spiflash_obj_t *self, const mp_arg_val_t *args) {
+    mp_int_t baudrate = args[0].u_int;
+    if (baudrate <= 0 || baudrate > 80000000) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    mp_obj_t *pins = (mp_obj_t *)mach_spiflash_def_pin[self - mach_spiflash_obj];
+    if (args[1].u_obj != MP_OBJ_NULL) {
+        mp_obj_get_array_fixed_n(args[1].u_obj, 3, &pins);
+    }
+    if (args[2].u_obj == MP_OBJ_NULL) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    int wp = -1;
+    int hd = -1;
+    if (args[3].u_obj != mp_const_none) {
+        mp_obj_t *quad_pins;
+        mp_obj_get_array_fixed_n(args[3].u_obj, 2, &quad_pins);
+        wp = pin_find(quad_pins[0])->pin_number;
+        hd = pin_find(quad_pins[1])->pin_number;
+    }
+    spi_bus_config_t bus_config = {
+        .sclk_io_num = pin_find(pins[0])->pin_number,
+        .mosi_io_num = pin_find(pins[1])->pin_number,
+        .miso_io_num = pin_find(pins[2])->pin_number,
+        .quadwp_io_num = wp,
+        .quadhd_io_num = hd,
+        .max_transfer_sz = SPIFLASH_BLOCK_SIZE,
+    };
+    spi_device_interface_config_t dev_config = {
+        .mode = 0,
+        .clock_speed_hz = baudrate,
+        .spics_io_num = pin_find(args[2].u_obj)->pin_number,
+        .queue_size = 1,
+        // the quad reads need the half duplex mode
+        .flags = SPI_DEVICE_HALFDUPLEX,
+    };
+
+    spiflash_hw_deinit(self);
+    if (self->mutex == NULL) {
+        self->mutex = xSemaphoreCreateMutex();
+        self->idle_timer = xTimerCreate("spiflash", SPIFLASH_IDLE_FLUSH_MS / portTICK_PERIOD_MS, pdFALSE, self, spiflash_idle_flush);
+        xTaskCreatePinnedToCore(TASK_SPIFlash, "SPIFlash", SPIFLASH_TASK_STACK_SIZE / sizeof(StackType_t), self,
+                                SPIFLASH_TASK_PRIORITY, &self->task, config_get_service_core());
+    }
+    self->quad = (wp >= 0);
+    self->dma_buf = heap_caps_malloc(SPIFLASH_BLOCK_SIZE, MALLOC_CAP_DMA);
+    if (self->dma_buf == NULL || !spiflash_cache_alloc(self, args[4].u_int)) {
+        heap_caps_free(self->dma_buf);
+        self->dma_buf = NULL;
+        mp_raise_OSError(MP_ENOMEM);
+    }
+    // each host has its own DMA channel
+    bool ok = false;
+    if (spi_bus_initialize(self->host, &bus_config, self->host) == ESP_OK) {
+        if (spi_bus_add_device(self->host, &dev_config, &self->dev) == ESP_OK) {
+            self->enabled = true;
+            MP_THREAD_GIL_EXIT();
+            ok = spiflash_probe(self);
+            MP_THREAD_GIL_ENTER();
+        } else {
+            spi_bus_free(self->host);
+        }
+    }
+    if (!ok) {
+        if (self->enabled) {
+            spiflash_hw_deinit(self);
+        } else {
+            for (uint32_t i = 0; i < self->cache_count; i++) {
+                heap_caps_free(self->cache[i].data);
+            }
+            free(self->cache);
+            self->cache = NULL;
+            self->cache_count = 0;
+            heap_caps_free(self->dma_buf);
+            self->dma_buf = NULL;
+        }
+        mp_raise_msg(&mp_type_OSError, mpexception_os_operation_failed);
+    }
+    return mp_const_none;
+}
+
+/******************************************************************************/
+// MicroPython bindings
+
+/// \class SPIFlash(id=0, *, baudrate=40000000, pins=(CLK, MOSI, MISO), cs, quad=None, cache=0)
+/// An external SPI NOR flash chip as a block device of 512 byte sectors. The
+/// sectors are cached by erase block with a write-back LRU cache of cache blocks
+/// (0 for the default), the dirty blocks are written back by a task once the
+/// filesystem is idle, and a read needing the chip while it erases suspends the
+/// erase. quad=(WP, HD) enables quad output reads. The SPI host is taken over.
+STATIC const mp_arg_t mach_spiflash_init_args[] = {
+    { MP_QSTR_id,                          MP_ARG_INT, {.u_int = 0} },
+    { MP_QSTR_baudrate,                    MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = SPIFLASH_BAUDRATE_DEFAULT} },
+    { MP_QSTR_pins,                        MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+    { MP_QSTR_cs,                          MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+    { MP_QSTR_quad,                        MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    { MP_QSTR_cache,                       MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0} },
+};
+STATIC mp_obj_t mach_spiflash_make_new (const mp_obj_type_t *type, mp_uint_t n_args, mp_uint_t n_kw, const mp_obj_t *all_args) {
+    mp_map_t kw_args;
+    mp_map_init_fixed_table(&kw_args, n_kw, all_args + n_args);
+    mp_arg_val_t args[MP_ARRAY_SIZE(mach_spiflash_init_args)];
+    mp_arg_parse_all(n_args, all_args, &kw_args, MP_ARRAY_SIZE(args), mach_spiflash_init_args, args);
+
+    if (args[0].u_int < 0 || args[0].u_int >= MP_ARRAY_SIZE(mach_spiflash_obj)) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable);
+    }
+    mach_spiflash_obj_t *self = &mach_spiflash_obj[args[0].u_int];
+    self->base.type = &mach_spiflash_type;
+    mach_spiflash_init_helper(self, &args[1]);
+    return self;
+}
+
+STATIC mp_obj_t mach_spiflash_init (mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    mp_arg_val_t args[MP_ARRAY_SIZE(mach_spiflash_init_args) - 1];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), &mach_spiflash_init_args[1], args);
+    return mach_spiflash_init_helper(pos_args[0], args);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_spiflash_init_obj, 1, mach_spiflash_init);
+
+STATIC mp_obj_t mach_spiflash_deinit (mp_obj_t self_in) {
+    MP_THREAD_GIL_EXIT();
+    spiflash_hw_deinit(self_in);
+    MP_THREAD_GIL_ENTER();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_spiflash_deinit_obj, mach_spiflash_deinit);
+
+/// \method flush()
+/// Writes the dirty blocks back now.
+STATIC mp_obj_t mach_spiflash_flush (mp_obj_t self_in) {
+    mach_spiflash_obj_t *self = spiflash_get_self(self_in);
+    MP_THREAD_GIL_EXIT();
+    xSemaphoreTake(self->mutex, portMAX_DELAY);
+    bool ok = spiflash_flush(self);
+    xSemaphoreGive(self->mutex);
+    MP_THREAD_GIL_ENTER();
+    if (!ok) {
+        mp_raise_OSError(MP_EIO);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_spiflash_flush_obj, mach_spiflash_flush);
+
+/// \method stats()
+/// (size, cache_blocks, hits, misses, erases, suspends)
+STATIC mp_obj_t mach_spiflash_stats (mp_obj_t self_in) {
+    mach_spiflash_obj_t *self = spiflash_get_self(self_in);
+    mp_obj_t tuple[6] = {
+        mp_obj_new_int_from_uint(self->size),
+        mp_obj_new_int_from_uint(self->cache_count),
+        mp_obj_new_int_from_uint(self->stats.hits),
+        mp_obj_new_int_from_uint(self->stats.misses),
+        mp_obj_new_int_from_uint(self->stats.erases),
+        mp_obj_new_int_from_uint(self->stats.suspends),
+    };
+    return mp_obj_new_tuple(6, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_spiflash_stats_obj, mach_spiflash_stats);
+
+STATIC mp_obj_t mach_spiflash_readblocks (mp_obj_t self, mp_obj_t block_num, mp_obj_t buf) {
+    return spiflash_blocks(self, block_num, buf, false);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(mach_spiflash_readblocks_obj, mach_spiflash_readblocks);
+
+STATIC mp_obj_t mach_spiflash_writeblocks (mp_obj_t self, mp_obj_t block_num, mp_obj_t buf) {
+    return spiflash_blocks(self, block_num, buf, true);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(mach_spiflash_writeblocks_obj, mach_spiflash_writeblocks);
+
+STATIC mp_obj_t mach_spiflash_ioctl (mp_obj_t self_in, mp_obj_t cmd_in, mp_obj_t arg_in) {
+    mach_spiflash_obj_t *self = self_in;
+    mp_int_t cmd = mp_obj_get_int(cmd_in);
+    switch (cmd) {
+        case BP_IOCTL_INIT:
+            return MP_OBJ_NEW_SMALL_INT(self->enabled ? 0 : -1);
+
+        case BP_IOCTL_DEINIT:
+        case BP_IOCTL_SYNC:
+            if (self->enabled) {
+                mach_spiflash_flush(self);
+            }
+            return MP_OBJ_NEW_SMALL_INT(0);
+
+        case BP_IOCTL_SEC_COUNT:
+            return MP_OBJ_NEW_SMALL_INT(self->size / SPIFLASH_SECTOR_SIZE);
+
+        case BP_IOCTL_SEC_SIZE:
+            return MP_OBJ_NEW_SMALL_INT(SPIFLASH_SECTOR_SIZE);
+
+        default: // unknown command
+            return MP_OBJ_NEW_SMALL_INT(-1); // error
+    }
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(mach_spiflash_ioctl_obj, mach_spiflash_ioctl);
+
+STATIC const mp_map_elem_t mach_spiflash_locals_dict_table[] = {
+    { MP_OBJ_NEW_QSTR(MP_QSTR_init),            (mp_obj_t)&mach_spiflash_init_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_deinit),          (mp_obj_t)&mach_spiflash_deinit_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_flush),           (mp_obj_t)&mach_spiflash_flush_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_stats),           (mp_obj_t)&mach_spiflash_stats_obj },
+    // block device protocol
+    { MP_OBJ_NEW_QSTR(MP_QSTR_readblocks),      (mp_obj_t)&mach_spiflash_readblocks_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_writeblocks),     (mp_obj_t)&mach_spiflash_writeblocks_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_ioctl),           (mp_obj_t)&mach_spiflash_ioctl_obj },
+};
+STATIC MP_DEFINE_CONST_DICT(mach_spiflash_locals_dict, mach_spiflash_locals_dict_table);
+
+const mp_obj_type_t mach_spiflash_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_SPIFlash,
+    .make_new = mach_spiflash_make_new,
+    .locals_dict = (mp_obj_t)&mach_spiflash_locals_dict,
+};
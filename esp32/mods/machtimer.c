@@ -17,6 +17,7 @@
 #include "machtimer.h"
 #include "machtimer_alarm.h"
 #include "machtimer_chrono.h"
+#include "machtimer_sampler.h"
 
 static uint64_t us_timer_calibration;
 
@@ -52,6 +53,7 @@ void machtimer_preinit(void) {
 
 void machtimer_init0(void) {
     mach_timer_alarm_init_heap();
+    mach_timer_sampler_init0();
     timer_enable_intr(TIMER_GROUP_0, TIMER_0);
 }
 
@@ -102,6 +104,7 @@ STATIC const mp_map_elem_t mach_timer_globals_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR___name__),            MP_OBJ_NEW_QSTR(MP_QSTR_timer)},
     { MP_OBJ_NEW_QSTR(MP_QSTR_Alarm),               (mp_obj_t)&mach_timer_alarm_type },
     { MP_OBJ_NEW_QSTR(MP_QSTR_Chrono),              (mp_obj_t)&mach_timer_chrono_type },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_Sampler),             (mp_obj_t)&mach_timer_sampler_type },
     { MP_OBJ_NEW_QSTR(MP_QSTR_sleep_us),            (mp_obj_t)&sleep_us_obj },
 };
 
@@ -9,6 +9,7 @@
 #include "py/nlr.h"
 #include "py/runtime.h"
 #include "py/mperrno.h"
+#include "py/objtuple.h"
 #include "util/mpirq.h"
 
 #include "esp_system.h"
@@ -23,6 +24,8 @@
 /******************************************************************************
  DEFINE PRIVATE TYPES
  ******************************************************************************/
+typedef mp_uint_t (*alarm_hard_fun_t)(mp_uint_t);
+
 typedef struct {
     mp_obj_base_t base;
     uint64_t when;
@@ -31,6 +34,19 @@ typedef struct {
     mp_obj_t handler;
     mp_obj_t handler_arg;
     bool periodic;
+    // hard alarms run inline assembler code straight from the interrupt
+    bool hard;
+    alarm_hard_fun_t hard_fun;
+    mp_uint_t hard_arg;
+    // jitter statistics, in timer clocks
+    uint64_t fired;                 // when the last interrupt came
+    uint32_t count;
+    uint32_t missed;                // periods that had already gone by when re-armed
+    uint64_t late_sum;              // from the programmed time to the interrupt
+    uint32_t late_max;
+    uint32_t dispatched;
+    uint64_t dispatch_sum;          // from the interrupt to the Python handler
+    uint32_t dispatch_max;
 } mp_obj_alarm_t;
 
 struct {
@@ -44,7 +60,7 @@ struct {
 IRAM_ATTR void timer_alarm_isr(void *arg);
 STATIC void load_next_alarm(void);
 STATIC mp_obj_t alarm_delete(mp_obj_t self_in);
-STATIC void alarm_set_callback_helper(mp_obj_t self_in, mp_obj_t handler, mp_obj_t handler_arg);
+STATIC void alarm_set_callback_helper(mp_obj_t self_in, mp_obj_t handler, mp_obj_t handler_arg, mp_int_t priority);
 
 /******************************************************************************
  DEFINE PUBLIC FUNCTIONS
@@ -63,45 +79,59 @@ void mach_timer_alarm_init_heap(void) {
     }
 }
 
-// Insert a new alarm into the heap
-// Note: It has already been checked that there is at least 1 free space on the heap
-// Note: The heap will remain ordered after the operation.
-// Note: If the new element is placed at the first place, which means its timestamp is the smallest, it is loaded immediatelly
-STATIC IRAM_ATTR void insert_alarm(mp_obj_alarm_t *alarm) {
-    uint32_t index = 0, index2;
-
-    // the list is ordered at any given time. Find the place where the new element shall be inserted
-    if(alarm_heap.count != 0) {
-        for (; index < alarm_heap.count; ++index){
-            if (alarm->when <= alarm_heap.data[index]->when) {
-                break;
-            }
+// The alarms are kept in a binary heap, the one due first at index 0, so that
+// adding, removing and re-arming an alarm is O(log n) in the interrupt.
+STATIC IRAM_ATTR void alarm_heap_set(uint32_t index, mp_obj_alarm_t *alarm) {
+    alarm_heap.data[index] = alarm;
+    alarm->heap_index = index;
+}
+
+// Move the alarm at index towards the root while it's due before its parent
+STATIC IRAM_ATTR uint32_t alarm_heap_up(uint32_t index) {
+    mp_obj_alarm_t *alarm = alarm_heap.data[index];
+    while (index > 0) {
+        uint32_t parent = (index - 1) / 2;
+        if (alarm->when >= alarm_heap.data[parent]->when) {
+            break;
         }
+        alarm_heap_set(index, alarm_heap.data[parent]);
+        index = parent;
+    }
+    alarm_heap_set(index, alarm);
+    return index;
+}
 
-        // restructuring the list while keeping the order so the new element can be inserted at its correct place
-        for(index2 = alarm_heap.count; index2 > index; index2--) {
-            alarm_heap.data[index2] = alarm_heap.data[(index2 - 1)];
-            alarm_heap.data[index2]->heap_index = index2;
+// Move the alarm at index towards the leaves while a child is due before it
+STATIC IRAM_ATTR void alarm_heap_down(uint32_t index) {
+    mp_obj_alarm_t *alarm = alarm_heap.data[index];
+    for (uint32_t child = 2 * index + 1; child < alarm_heap.count; child = 2 * index + 1) {
+        if (child + 1 < alarm_heap.count && alarm_heap.data[child + 1]->when < alarm_heap.data[child]->when) {
+            child++;
+        }
+        if (alarm->when <= alarm_heap.data[child]->when) {
+            break;
         }
+        alarm_heap_set(index, alarm_heap.data[child]);
+        index = child;
     }
+    alarm_heap_set(index, alarm);
+}
 
-    // insert the new element
-    alarm_heap.data[index] = alarm;
-    alarm->heap_index = index;
-    alarm_heap.count++;
+// Insert a new alarm into the heap
+// Note: It has already been checked that there is at least 1 free space on the heap
+// Note: If the new element is placed at the first place, which means its timestamp is the smallest, it is loaded immediatelly
+STATIC IRAM_ATTR void insert_alarm(mp_obj_alarm_t *alarm) {
+    alarm_heap_set(alarm_heap.count++, alarm);
 
-    // start the newly added alarm if it is the first in the list
-    if (index == 0) {
+    // start the newly added alarm if it is the first in the heap
+    if (alarm_heap_up(alarm->heap_index) == 0) {
         load_next_alarm();
     }
 }
 
 
 // Remove the alarm from the heap at the position alarm_heap_index
-// Note: The heap will remain ordered after the operation.
 STATIC IRAM_ATTR void remove_alarm(uint32_t alarm_heap_index) {
-    uint32_t index;
-
     /* Need to disable the HW timer if the alarm is currently active, because it can happen
      * that during the removal process the HW timer expires and generates an interrupt.
      * In this case the ISR should not be performed at all because the user had requested
@@ -112,21 +142,30 @@ STATIC IRAM_ATTR void remove_alarm(uint32_t alarm_heap_index) {
 
     // invalidate the element
     alarm_heap.data[alarm_heap_index]->heap_index = -1;
-    alarm_heap.data[alarm_heap_index] = NULL;
     alarm_heap.count--;
 
-    for (index = alarm_heap_index; index < alarm_heap.count; ++index) {
-        alarm_heap.data[index] = alarm_heap.data[index+1];
-        alarm_heap.data[index]->heap_index = index;
-        alarm_heap.data[index + 1] = NULL;
+    // the last alarm fills the hole, and goes up or down from there
+    uint32_t index = alarm_heap_index;
+    if (index != alarm_heap.count) {
+        alarm_heap_set(index, alarm_heap.data[alarm_heap.count]);
+        index = alarm_heap_up(index);
+        alarm_heap_down(index);
     }
+    alarm_heap.data[alarm_heap.count] = NULL;
 
-    // If the removed element was currently scheduled, start the next one
-    if(alarm_heap_index == 0) {
+    // If the removed element was currently scheduled, or another one takes its
+    // place, start the next one
+    if (alarm_heap_index == 0 || index == 0) {
         load_next_alarm();
     }
 }
 
+// The first alarm fired and is periodic: it moves to where its next period goes
+STATIC IRAM_ATTR void rearm_first_alarm(void) {
+    alarm_heap_down(0);
+    load_next_alarm();
+}
+
 STATIC IRAM_ATTR void load_next_alarm(void) {
     TIMERG0.hw_timer[0].config.alarm_en = 0; // disable the alarm system
     // everything here done without calling any timers function, so it works inside the interrupts
@@ -139,17 +178,37 @@ STATIC IRAM_ATTR void load_next_alarm(void) {
     }
 }
 
-STATIC IRAM_ATTR void set_alarm_when(mp_obj_alarm_t *alarm, uint64_t delta) {
+STATIC IRAM_ATTR uint64_t alarm_timer_now(void) {
     TIMERG0.hw_timer[0].update = 1;
-    alarm->when = ((uint64_t) TIMERG0.hw_timer[0].cnt_high << 32)
-        | (TIMERG0.hw_timer[0].cnt_low);
-    alarm->when += delta;
+    return ((uint64_t) TIMERG0.hw_timer[0].cnt_high << 32) | (TIMERG0.hw_timer[0].cnt_low);
+}
+
+STATIC IRAM_ATTR void set_alarm_when(mp_obj_alarm_t *alarm, uint64_t delta) {
+    alarm->when = alarm_timer_now() + delta;
+}
+
+// the next period counts from when this one was due, not from when the interrupt
+// was served, so the latency doesn't add up over the periods
+STATIC IRAM_ATTR void set_alarm_next_period(mp_obj_alarm_t *alarm, uint64_t now) {
+    alarm->when += alarm->interval;
+    if (alarm->when <= now) {
+        uint64_t late = (now - alarm->when) / alarm->interval + 1;
+        alarm->missed += late;
+        alarm->when += late * alarm->interval;
+    }
 }
 
 STATIC void alarm_handler(void *arg) {
     // this function will be called by the interrupt thread
     mp_obj_alarm_t *alarm = arg;
 
+    uint32_t dispatch = alarm_timer_now() - alarm->fired;
+    alarm->dispatched++;
+    alarm->dispatch_sum += dispatch;
+    if (dispatch > alarm->dispatch_max) {
+        alarm->dispatch_max = dispatch;
+    }
+
     if (alarm->handler && alarm->handler != mp_const_none) {
         mp_call_function_1(alarm->handler, alarm->handler_arg);
     }
@@ -166,17 +225,29 @@ IRAM_ATTR void timer_alarm_isr(void *arg) {
     // or not since the last time the HW timer was set up
     if (alarm_heap.count > 0) {
         mp_obj_alarm_t *alarm = alarm_heap.data[0];
-
-        // This will automatically load the next alarm in the queue
-        remove_alarm(0);
+        uint64_t now = alarm_timer_now();
+        uint32_t late = (now > alarm->when) ? now - alarm->when : 0;
+        alarm->fired = now;
+        alarm->count++;
+        alarm->late_sum += late;
+        if (late > alarm->late_max) {
+            alarm->late_max = late;
+        }
 
         if (alarm->periodic) {
-            set_alarm_when(alarm, alarm->interval);
-            // If this alarm is inserted back to the 0th place, load again
-            insert_alarm(alarm);
+            set_alarm_next_period(alarm, now);
+            // stays in the heap, and whatever is first now is loaded
+            rearm_first_alarm();
+        } else {
+            // This will automatically load the next alarm in the queue
+            remove_alarm(0);
         }
 
-        mp_irq_queue_interrupt(alarm_handler, alarm);
+        if (alarm->hard) {
+            alarm->hard_fun(alarm->hard_arg);
+        } else {
+            mp_irq_queue_interrupt(alarm_handler, alarm);
+        }
     }
 }
 
@@ -189,6 +260,8 @@ STATIC mp_obj_t alarm_make_new(const mp_obj_type_t *type, mp_uint_t n_args, mp_u
         { MP_QSTR_us,           MP_ARG_INT  | MP_ARG_KW_ONLY,    {.u_int = 0} },
         { MP_QSTR_arg,          MP_ARG_OBJ  | MP_ARG_KW_ONLY,    {.u_obj = mp_const_none} },
         { MP_QSTR_periodic,     MP_ARG_BOOL | MP_ARG_KW_ONLY,    {.u_bool = false} },
+        { MP_QSTR_priority,     MP_ARG_INT  | MP_ARG_KW_ONLY,    {.u_int = MP_IRQ_PRIORITY_NORMAL} },
+        { MP_QSTR_hard,         MP_ARG_BOOL | MP_ARG_KW_ONLY,    {.u_bool = false} },
     };
 
     // parse arguments
@@ -220,17 +293,46 @@ STATIC mp_obj_t alarm_make_new(const mp_obj_type_t *type, mp_uint_t n_args, mp_u
     self->interval = clocks;
     self->periodic = args[5].u_bool;
 
+    self->hard = args[7].u_bool;
+
     self->heap_index = -1;
-    alarm_set_callback_helper(self, args[0].u_obj, args[4].u_obj);
+    alarm_set_callback_helper(self, args[0].u_obj, args[4].u_obj, args[6].u_int);
     return self;
 }
 
-STATIC void alarm_set_callback_helper(mp_obj_t self_in, mp_obj_t handler, mp_obj_t handler_arg) {
+// A hard handler must be an @micropython.asm_xtensa function, called with the arg
+// (an int, or the address of a buffer) or with nothing. Any Python code, viper
+// included, needs the VM and the GIL, which the interrupt can't wait for.
+STATIC void alarm_set_hard_handler(mp_obj_alarm_t *self, mp_obj_t handler, mp_obj_t handler_arg) {
+    size_t n_args;
+    const void *code = mp_obj_fun_asm_get_code(handler, &n_args);
+    if (code == NULL || n_args > 1) {
+        mp_raise_TypeError("hard handler must be an assembler function with at most 1 argument");
+    }
+    mp_uint_t arg = 0;
+    if (n_args == 1 && handler_arg != mp_const_none) {
+        mp_buffer_info_t bufinfo;
+        if (mp_obj_is_int(handler_arg)) {
+            arg = mp_obj_get_int_truncated(handler_arg);
+        } else if (mp_get_buffer(handler_arg, &bufinfo, MP_BUFFER_RW)) {
+            arg = (mp_uint_t)bufinfo.buf;
+        } else {
+            mp_raise_TypeError("hard handler arg must be an int or a buffer");
+        }
+    }
+    self->hard_fun = (alarm_hard_fun_t)code;
+    self->hard_arg = arg;
+}
+
+STATIC void alarm_set_callback_helper(mp_obj_t self_in, mp_obj_t handler, mp_obj_t handler_arg, mp_int_t priority) {
     bool error = false;
     mp_obj_alarm_t *self = self_in;
 
     // do as much as possible outside the atomic section
     // handler is given by the user for sure
+    if (self->hard && handler != mp_const_none) {
+        alarm_set_hard_handler(self, handler, handler_arg);
+    }
     self->handler = handler;
 
     if (handler_arg == mp_const_none) {
@@ -256,7 +358,6 @@ STATIC void alarm_set_callback_helper(mp_obj_t self_in, mp_obj_t handler, mp_obj
     if (alarm_heap.count == ALARM_HEAP_MAX_ELEMENTS) {
         error = true;
     } else if (self->handler != mp_const_none) {
-        mp_irq_add(self, handler);
         set_alarm_when(self, self->interval);
         insert_alarm(self);
     }
@@ -266,24 +367,64 @@ STATIC void alarm_set_callback_helper(mp_obj_t self_in, mp_obj_t handler, mp_obj
     if (error) {
         nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_MemoryError, "maximum number of %d alarms already reached", ALARM_HEAP_MAX_ELEMENTS));
     }
+    // registering can raise, so it's kept out of the atomic section
+    if (handler != mp_const_none && !self->hard) {
+        mp_irq_add_prio(self, handler, priority);
+    }
 }
 
 STATIC mp_obj_t alarm_callback(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     static const mp_arg_t allowed_args[] = {
         { MP_QSTR_handler,  MP_ARG_OBJ | MP_ARG_REQUIRED, {.u_obj = mp_const_none} },
         { MP_QSTR_arg,      MP_ARG_OBJ | MP_ARG_KW_ONLY,  {.u_obj = mp_const_none} },
+        { MP_QSTR_priority, MP_ARG_INT | MP_ARG_KW_ONLY,  {.u_int = MP_IRQ_PRIORITY_NORMAL} },
     };
 
     mp_obj_t *self = MP_OBJ_TO_PTR(pos_args[0]);
     mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
-    alarm_set_callback_helper(self, args[0].u_obj, args[1].u_obj);
+    alarm_set_callback_helper(self, args[0].u_obj, args[1].u_obj, args[2].u_int);
 
     return mp_const_none;
 }
 MP_DEFINE_CONST_FUN_OBJ_KW(alarm_callback_obj, 1, alarm_callback);
 
+// A periodic alarm for C code, the function runs straight from the interrupt
+// like the hard handlers do. The owner is kept as the handler_arg, so the GC
+// sees it through the alarms heap for as long as the alarm is running.
+mp_obj_t mach_timer_alarm_new_native(mp_uint_t (*fun)(mp_uint_t), mp_obj_t owner, uint64_t clocks) {
+    mp_obj_alarm_t *self = m_new_obj_with_finaliser(mp_obj_alarm_t);
+    self->base.type = &mach_timer_alarm_type;
+    self->interval = clocks;
+    self->periodic = true;
+    self->hard = true;
+    self->hard_fun = fun;
+    self->hard_arg = (mp_uint_t)owner;
+    self->handler = owner;
+    self->handler_arg = owner;
+    self->heap_index = -1;
+
+    bool error = false;
+    uint32_t state = MICROPY_BEGIN_ATOMIC_SECTION();
+    if (alarm_heap.count == ALARM_HEAP_MAX_ELEMENTS) {
+        error = true;
+    } else {
+        set_alarm_when(self, self->interval);
+        insert_alarm(self);
+    }
+    MICROPY_END_ATOMIC_SECTION(state);
+
+    if (error) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_MemoryError, "maximum number of %d alarms already reached", ALARM_HEAP_MAX_ELEMENTS));
+    }
+    return self;
+}
+
+void mach_timer_alarm_cancel(mp_obj_t alarm) {
+    alarm_delete(alarm);
+}
+
 STATIC mp_obj_t alarm_delete(mp_obj_t self_in) {
     mp_obj_alarm_t *self = self_in;
 
@@ -306,12 +447,40 @@ STATIC mp_obj_t alarm_delete(mp_obj_t self_in) {
 }
 MP_DEFINE_CONST_FUN_OBJ_1(alarm_delete_obj, alarm_delete);
 
+STATIC mp_obj_t alarm_stats(size_t n_args, const mp_obj_t *args) {
+    mp_obj_alarm_t *self = args[0];
+
+    uint32_t state = MICROPY_BEGIN_ATOMIC_SECTION();
+    mp_obj_alarm_t copy = *self;
+    if (n_args > 1 && mp_obj_is_true(args[1])) {
+        self->count = self->missed = self->late_max = self->dispatched = self->dispatch_max = 0;
+        self->late_sum = self->dispatch_sum = 0;
+    }
+    MICROPY_END_ATOMIC_SECTION(state);
+
+    static const qstr alarm_stats_fields[] = {
+        MP_QSTR_count, MP_QSTR_missed, MP_QSTR_late_avg_us, MP_QSTR_late_max_us,
+        MP_QSTR_dispatch_avg_us, MP_QSTR_dispatch_max_us
+    };
+    // the timer clocks are converted to us as floats, one clock is 25 ns
+    mp_obj_t tuple[6];
+    tuple[0] = mp_obj_new_int_from_uint(copy.count);
+    tuple[1] = mp_obj_new_int_from_uint(copy.missed);
+    tuple[2] = mp_obj_new_float(copy.count ? (float)copy.late_sum * 1000000 / CLK_FREQ / copy.count : 0);
+    tuple[3] = mp_obj_new_float((float)copy.late_max * 1000000 / CLK_FREQ);
+    tuple[4] = mp_obj_new_float(copy.dispatched ? (float)copy.dispatch_sum * 1000000 / CLK_FREQ / copy.dispatched : 0);
+    tuple[5] = mp_obj_new_float((float)copy.dispatch_max * 1000000 / CLK_FREQ);
+    return mp_obj_new_attrtuple(alarm_stats_fields, 6, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(alarm_stats_obj, 1, 2, alarm_stats);
+
 
 STATIC const mp_map_elem_t mach_timer_alarm_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR___name__),            MP_OBJ_NEW_QSTR(MP_QSTR_alarm) },
     { MP_OBJ_NEW_QSTR(MP_QSTR___del__),             (mp_obj_t) &alarm_delete_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_callback),            (mp_obj_t) &alarm_callback_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_cancel),              (mp_obj_t) &alarm_delete_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_stats),               (mp_obj_t) &alarm_stats_obj },
 };
 
 STATIC MP_DEFINE_CONST_DICT(mach_timer_alarm_dict, mach_timer_alarm_dict_table);
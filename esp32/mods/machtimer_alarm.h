@@ -4,5 +4,7 @@
 extern const mp_obj_type_t mach_timer_alarm_type;
 extern void mach_timer_alarm_preinit(void);
 extern void mach_timer_alarm_init_heap(void);
+extern mp_obj_t mach_timer_alarm_new_native(mp_uint_t (*fun)(mp_uint_t), mp_obj_t owner, uint64_t clocks);
+extern void mach_timer_alarm_cancel(mp_obj_t alarm);
 
 #endif  // MACHTIMER_ALARM_H_
@@ -0,0 +1,360 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "py/mpconfig.h"
+#include "py/nlr.h"
+#include "py/runtime.h"
+#include "py/objtuple.h"
+#include "py/objstr.h"
+#include "util/mpirq.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "adc.h"
+#include "esp_system.h"
+#include "machtimer.h"
+#include "machtimer_alarm.h"
+#include "machtimer_sampler.h"
+#include "machpin.h"
+#include "pybadc.h"
+#include "mpexception.h"
+#include "pycom_config.h"
+
+/******************************************************************************
+ DEFINE PRIVATE CONSTANTS
+ ******************************************************************************/
+#define SAMPLER_QUEUE_LEN                           (16)
+#define SAMPLER_TASK_STACK_SIZE                     (2048)
+// above the interrupt workers, a sample is taken in a few us and the period must hold
+#define SAMPLER_TASK_PRIORITY                       (INTERRUPTS_HIGH_TASK_PRIORITY + 1)
+#define SAMPLER_REPORT_MAX                          (4096)
+
+/******************************************************************************
+ DEFINE PRIVATE TYPES
+ ******************************************************************************/
+typedef struct {
+    uint32_t count;
+    uint32_t sum;
+    uint16_t min;
+    uint16_t max;
+} sampler_aggr_t;
+
+typedef struct {
+    mp_obj_base_t base;
+    mp_obj_t alarm;
+    mp_obj_t source;
+    mp_obj_t handler;
+    mp_obj_t handler_arg;
+    pin_obj_t *pin;                 // NULL when an ADC channel is sampled
+    uint16_t *ring;                 // the last two batches, NULL if they aren't kept
+    uint32_t report;                // samples per report
+    uint32_t head;                  // samples taken so far
+    uint32_t missed;                // periods that went by without a sample
+    sampler_aggr_t aggr;            // of the batch being filled
+    sampler_aggr_t last;            // of the last complete batch
+    uint32_t last_seq;
+    uint32_t last_end;              // value of head when the last batch completed
+    uint16_t last_value;
+    uint8_t adc_channel;
+    bool voltage;
+    volatile bool pending;          // a tick is queued and not sampled yet
+    volatile bool active;
+} mach_timer_sampler_obj_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+STATIC QueueHandle_t sampler_queue;
+STATIC portMUX_TYPE sampler_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/******************************************************************************
+ DECLARE PRIVATE FUNCTIONS
+ ******************************************************************************/
+STATIC void TASK_Sampler (void *pvParameters);
+
+/******************************************************************************
+ DEFINE PUBLIC FUNCTIONS
+ ******************************************************************************/
+void mach_timer_sampler_init0(void) {
+    // the samplers of the last session are gone with the alarms heap
+    if (sampler_queue) {
+        xQueueReset(sampler_queue);
+    }
+}
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+// Runs from the alarm interrupt: the ADC driver takes a lock, so the reading
+// itself is left to the task
+STATIC IRAM_ATTR mp_uint_t sampler_isr(mp_uint_t arg) {
+    mach_timer_sampler_obj_t *self = (mach_timer_sampler_obj_t *)arg;
+    BaseType_t woken = pdFALSE;
+
+    if (self->pending || xQueueSendFromISR(sampler_queue, &self, &woken) != pdTRUE) {
+        self->missed++;
+    } else {
+        self->pending = true;
+    }
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+    return 0;
+}
+
+STATIC void sampler_handler(void *arg) {
+    // this function will be called by the interrupt thread
+    mach_timer_sampler_obj_t *self = arg;
+    if (self->handler && self->handler != mp_const_none) {
+        mp_call_function_1(self->handler, self->handler_arg);
+    }
+}
+
+STATIC void sampler_aggr_reset(sampler_aggr_t *aggr) {
+    aggr->count = 0;
+    aggr->sum = 0;
+    aggr->min = UINT16_MAX;
+    aggr->max = 0;
+}
+
+STATIC void sampler_take(mach_timer_sampler_obj_t *self) {
+    uint16_t value;
+    if (self->pin) {
+        value = pin_get_value(self->pin);
+    } else if (pyb_adc_is_streaming()) {
+        // ADC1 belongs to the I2S peripheral for now
+        self->missed++;
+        self->pending = false;
+        return;
+    } else {
+        value = adc1_get_raw(self->adc_channel);
+        if (self->voltage) {
+            value = pyb_adc_channel_raw_to_voltage(self->adc_channel, value);
+        }
+    }
+
+    bool report = false;
+    portENTER_CRITICAL(&sampler_mux);
+    if (self->ring) {
+        self->ring[self->head % (2 * self->report)] = value;
+    }
+    self->head++;
+    self->last_value = value;
+    self->aggr.count++;
+    self->aggr.sum += value;
+    if (value < self->aggr.min) {
+        self->aggr.min = value;
+    }
+    if (value > self->aggr.max) {
+        self->aggr.max = value;
+    }
+    if (self->aggr.count == self->report) {
+        self->last = self->aggr;
+        self->last_seq++;
+        self->last_end = self->head;
+        sampler_aggr_reset(&self->aggr);
+        report = true;
+    }
+    self->pending = false;
+    portEXIT_CRITICAL(&sampler_mux);
+
+    if (report) {
+        mp_irq_queue_interrupt_non_ISR(sampler_handler, self);
+    }
+}
+
+STATIC void TASK_Sampler (void *pvParameters) {
+    mach_timer_sampler_obj_t *self;
+    for (;;) {
+        if (xQueueReceive(sampler_queue, &self, portMAX_DELAY) == pdTRUE && self->active) {
+            sampler_take(self);
+        }
+    }
+}
+
+STATIC void sampler_start_task(void) {
+    if (!sampler_queue) {
+        sampler_queue = xQueueCreate(SAMPLER_QUEUE_LEN, sizeof(mach_timer_sampler_obj_t *));
+        if (!sampler_queue || xTaskCreatePinnedToCore(TASK_Sampler, "Sampler", SAMPLER_TASK_STACK_SIZE / sizeof(StackType_t),
+                                                      NULL, SAMPLER_TASK_PRIORITY, NULL, config_get_service_core()) != pdPASS) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_MemoryError, mpexception_os_resource_not_avaliable));
+        }
+    }
+}
+
+/******************************************************************************/
+// Micro Python bindings
+
+/// \class Sampler - reads a pin or an ADC channel periodically from C
+///
+/// The samples of each report interval are aggregated without running any
+/// Python code, the handler is only called once per interval.
+STATIC mp_obj_t sampler_make_new(const mp_obj_type_t *type, mp_uint_t n_args, mp_uint_t n_kw, const mp_obj_t *all_args) {
+
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_source,       MP_ARG_OBJ  | MP_ARG_REQUIRED,   {.u_obj = mp_const_none} },
+        { MP_QSTR_s,            MP_ARG_OBJ,                      {.u_obj = mp_const_none} },
+        { MP_QSTR_ms,           MP_ARG_INT  | MP_ARG_KW_ONLY,    {.u_int = 0} },
+        { MP_QSTR_us,           MP_ARG_INT  | MP_ARG_KW_ONLY,    {.u_int = 0} },
+        { MP_QSTR_report,       MP_ARG_INT  | MP_ARG_KW_ONLY,    {.u_int = 1} },
+        { MP_QSTR_handler,      MP_ARG_OBJ  | MP_ARG_KW_ONLY,    {.u_obj = mp_const_none} },
+        { MP_QSTR_arg,          MP_ARG_OBJ  | MP_ARG_KW_ONLY,    {.u_obj = mp_const_none} },
+        { MP_QSTR_voltage,      MP_ARG_BOOL | MP_ARG_KW_ONLY,    {.u_bool = false} },
+        { MP_QSTR_samples,      MP_ARG_BOOL | MP_ARG_KW_ONLY,    {.u_bool = true} },
+        { MP_QSTR_priority,     MP_ARG_INT  | MP_ARG_KW_ONLY,    {.u_int = MP_IRQ_PRIORITY_NORMAL} },
+    };
+
+    // parse arguments
+    mp_map_t kw_args;
+    mp_map_init_fixed_table(&kw_args, n_kw, all_args + n_args);
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, all_args, &kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+
+    float s = 0.0f;
+    if (args[1].u_obj != mp_const_none) {
+        s = mp_obj_get_float(args[1].u_obj);
+    }
+    mp_int_t ms = args[2].u_int;
+    mp_int_t us = args[3].u_int;
+
+    if (((s != 0.0) + (ms != 0) + (us != 0)) != 1) {
+        mp_raise_ValueError("please provide a single duration");
+    }
+    if (s < 0.0 || ms < 0 || us < 0) {
+        mp_raise_ValueError("please provide a positive number");
+    }
+    if (args[4].u_int < 1 || args[4].u_int > SAMPLER_REPORT_MAX) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+
+    mach_timer_sampler_obj_t *self = m_new_obj_with_finaliser(mach_timer_sampler_obj_t);
+    self->base.type = type;
+    self->source = args[0].u_obj;
+    if (MP_OBJ_IS_TYPE(self->source, &pin_type)) {
+        self->pin = self->source;
+    } else {
+        int channel = pyb_adc_channel_get_id(self->source);
+        if (channel < 0) {
+            mp_raise_TypeError("source must be a Pin or an enabled ADCChannel");
+        }
+        self->adc_channel = channel;
+        self->voltage = args[7].u_bool;
+    }
+    self->report = args[4].u_int;
+    if (args[8].u_bool) {
+        self->ring = m_new(uint16_t, 2 * self->report);
+    }
+    sampler_aggr_reset(&self->aggr);
+    sampler_aggr_reset(&self->last);
+
+    self->handler = args[5].u_obj;
+    self->handler_arg = (args[6].u_obj == mp_const_none) ? self : args[6].u_obj;
+    if (self->handler != mp_const_none) {
+        mp_irq_add_prio(self, self->handler, args[9].u_int);
+    }
+
+    sampler_start_task();
+    uint64_t clocks = (uint64_t) (s * CLK_FREQ + 0.5) + ms * (CLK_FREQ / 1000) + us * (CLK_FREQ / 1000000);
+    self->active = true;
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        self->alarm = mach_timer_alarm_new_native(sampler_isr, self, clocks);
+        nlr_pop();
+    } else {
+        // no alarm left, the handler mustn't stay registered
+        self->active = false;
+        mp_irq_remove(self);
+        nlr_jump(nlr.ret_val);
+    }
+    return self;
+}
+
+/// \method report()
+/// Returns the aggregation of the last complete batch. `samples` holds its values
+/// packed as little endian 16 bit integers, as in `array('H')`, if they are kept.
+STATIC mp_obj_t sampler_report(mp_obj_t self_in) {
+    mach_timer_sampler_obj_t *self = self_in;
+
+    // allocated before, the copy is made while the task is kept out
+    vstr_t vstr;
+    if (self->ring) {
+        vstr_init_len(&vstr, self->report * sizeof(uint16_t));
+    }
+
+    portENTER_CRITICAL(&sampler_mux);
+    sampler_aggr_t last = self->last;
+    uint32_t seq = self->last_seq;
+    uint32_t missed = self->missed;
+    uint16_t value = self->last_value;
+    if (self->ring && last.count) {
+        uint16_t *out = (uint16_t *)vstr.buf;
+        for (uint32_t i = self->last_end - last.count; i != self->last_end; i++) {
+            *out++ = self->ring[i % (2 * self->report)];
+        }
+    }
+    portEXIT_CRITICAL(&sampler_mux);
+
+    static const qstr sampler_report_fields[] = {
+        MP_QSTR_seq, MP_QSTR_count, MP_QSTR_min, MP_QSTR_max, MP_QSTR_mean, MP_QSTR_last, MP_QSTR_missed, MP_QSTR_samples
+    };
+    mp_obj_t tuple[8];
+    tuple[0] = mp_obj_new_int_from_uint(seq);
+    tuple[1] = mp_obj_new_int_from_uint(last.count);
+    tuple[2] = last.count ? MP_OBJ_NEW_SMALL_INT(last.min) : mp_const_none;
+    tuple[3] = last.count ? MP_OBJ_NEW_SMALL_INT(last.max) : mp_const_none;
+    tuple[4] = last.count ? mp_obj_new_float((float)last.sum / last.count) : mp_const_none;
+    tuple[5] = MP_OBJ_NEW_SMALL_INT(value);
+    tuple[6] = mp_obj_new_int_from_uint(missed);
+    if (!self->ring) {
+        tuple[7] = mp_const_none;
+    } else if (!last.count) {
+        vstr_clear(&vstr);
+        tuple[7] = mp_const_empty_bytes;
+    } else {
+        tuple[7] = mp_obj_new_str_from_vstr(&mp_type_bytes, &vstr);
+    }
+    return mp_obj_new_attrtuple(sampler_report_fields, 8, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(sampler_report_obj, sampler_report);
+
+/// \method cancel()
+STATIC mp_obj_t sampler_cancel(mp_obj_t self_in) {
+    mach_timer_sampler_obj_t *self = self_in;
+
+    if (self->alarm) {
+        mach_timer_alarm_cancel(self->alarm);
+        self->alarm = NULL;
+    }
+    // a tick already queued is dropped by the task
+    self->active = false;
+    mp_irq_remove(self);
+    INTERRUPT_OBJ_CLEAN(self);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(sampler_cancel_obj, sampler_cancel);
+
+STATIC const mp_map_elem_t mach_timer_sampler_dict_table[] = {
+    { MP_OBJ_NEW_QSTR(MP_QSTR___del__),             (mp_obj_t) &sampler_cancel_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_report),              (mp_obj_t) &sampler_report_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_cancel),              (mp_obj_t) &sampler_cancel_obj },
+};
+
+STATIC MP_DEFINE_CONST_DICT(mach_timer_sampler_dict, mach_timer_sampler_dict_table);
+
+const mp_obj_type_t mach_timer_sampler_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_Sampler,
+    .make_new = sampler_make_new,
+    .locals_dict = (mp_obj_t)&mach_timer_sampler_dict,
+};
@@ -0,0 +1,16 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#ifndef MACHTIMER_SAMPLER_H_
+#define MACHTIMER_SAMPLER_H_
+
+extern const mp_obj_type_t mach_timer_sampler_type;
+extern void mach_timer_sampler_init0(void);
+
+#endif  // MACHTIMER_SAMPLER_H_
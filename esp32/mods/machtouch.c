@@ -28,12 +28,15 @@
 #include <stdio.h>
 
 #include "esp_log.h"
+#include "esp_sleep.h"
 
 #include "driver/gpio.h"
 #include "driver/touch_pad.h"
 
 #include "py/runtime.h"
 #include "py/mphal.h"
+#include "mpexception.h"
+#include "mpirq.h"
 #include "machtouch.h"
 #include "machpin.h"
 
@@ -42,6 +45,16 @@
 
 
 #define TOUCHPAD_FILTER_TOUCH_PERIOD_MS         (10)
+// the baseline keeps 4 fractional bits and follows the filtered value with a
+// time constant of 256 filter periods (~2.5 s), so a press doesn't drag it along
+#define TOUCHPAD_BASELINE_FRAC                  (4)
+#define TOUCHPAD_BASELINE_DRIFT                 (8)
+// a pad reading touched for this long is assumed to have drifted and recalibrates
+#define TOUCHPAD_STUCK_PERIODS                  (30000 / TOUCHPAD_FILTER_TOUCH_PERIOD_MS)
+#define TOUCHPAD_SENSITIVITY_DEFAULT            (10)    // in % below the baseline
+
+#define TOUCHPAD_TRIGGER_PRESS                  (0x01)
+#define TOUCHPAD_TRIGGER_RELEASE                (0x02)
 
 
 typedef struct _mtp_obj_t {
@@ -49,6 +62,17 @@ typedef struct _mtp_obj_t {
     gpio_num_t gpio_id;
     touch_pad_t touchpad_id;
     uint16_t init_value;
+    mp_obj_t handler;
+    mp_obj_t handler_arg;
+    int32_t baseline;                   // with TOUCHPAD_BASELINE_FRAC fractional bits
+    uint16_t threshold;                 // 0 while the pad is neither armed for irq() nor wake()
+    uint16_t touched_periods;
+    uint8_t sensitivity;
+    uint8_t trigger;
+    bool active;
+    bool armed;
+    bool wake;
+    volatile bool touched;
 } mtp_obj_t;
 
 STATIC mtp_obj_t touchpad_obj[] = {
@@ -64,6 +88,117 @@ STATIC mtp_obj_t touchpad_obj[] = {
     {{&machine_touchpad_type}, GPIO_NUM_32, TOUCH_PAD_NUM9},
 };
 
+STATIC bool mtp_isr_installed;
+
+STATIC void mtp_callback_handler (void *arg) {
+    // called by the interrupt task
+    mtp_obj_t *self = arg;
+    if (self->handler && self->handler != mp_const_none) {
+        mp_call_function_1(self->handler, self->handler_arg);
+    }
+}
+
+// the hardware threshold follows the baseline, touch_pad_set_thresh only takes a spinlock
+STATIC void mtp_update_threshold (mtp_obj_t *self) {
+    uint16_t threshold = 0;
+    if (self->armed || self->wake) {
+        threshold = (uint32_t)(self->baseline >> TOUCHPAD_BASELINE_FRAC) * (100 - self->sensitivity) / 100;
+    }
+    if (threshold != self->threshold) {
+        self->threshold = threshold;
+        touch_pad_set_thresh(self->touchpad_id, threshold);
+    }
+}
+
+// runs in the timer task after each filter period
+STATIC void mtp_filter_cb (uint16_t *raw_value, uint16_t *filtered_value) {
+    for (int i = 0; i < MP_ARRAY_SIZE(touchpad_obj); i++) {
+        mtp_obj_t *self = &touchpad_obj[i];
+        if (!self->active) {
+            continue;
+        }
+        uint16_t value = filtered_value[self->touchpad_id];
+        if (self->touched) {
+            // released once the value is half way back from the threshold to the baseline
+            bool stuck = ++self->touched_periods >= TOUCHPAD_STUCK_PERIODS;
+            if (stuck) {
+                self->baseline = (int32_t)value << TOUCHPAD_BASELINE_FRAC;
+            }
+            if (stuck || value > (self->threshold + (self->baseline >> TOUCHPAD_BASELINE_FRAC)) / 2) {
+                self->touched = false;
+                if (self->handler && (self->trigger & TOUCHPAD_TRIGGER_RELEASE)) {
+                    mp_irq_queue_interrupt_non_ISR(mtp_callback_handler, (void *)self);
+                }
+            }
+        } else {
+            self->baseline += (((int32_t)value << TOUCHPAD_BASELINE_FRAC) - self->baseline) >> TOUCHPAD_BASELINE_DRIFT;
+        }
+        mtp_update_threshold(self);
+    }
+}
+
+// keeps firing on every measurement while a pad stays below its threshold
+STATIC void mtp_isr (void *arg) {
+    uint32_t status = touch_pad_get_status();
+    touch_pad_clear_status();
+    for (int i = 0; i < MP_ARRAY_SIZE(touchpad_obj); i++) {
+        mtp_obj_t *self = &touchpad_obj[i];
+        if ((status & BIT(self->touchpad_id)) && self->armed && !self->touched) {
+            self->touched = true;
+            self->touched_periods = 0;
+            if (self->handler && (self->trigger & TOUCHPAD_TRIGGER_PRESS)) {
+                mp_irq_queue_interrupt(mtp_callback_handler, (void *)self);
+            }
+        }
+    }
+}
+
+STATIC void mtp_disarm (mtp_obj_t *self) {
+    self->armed = false;
+    self->touched = false;
+    mp_irq_remove(self);
+    INTERRUPT_OBJ_CLEAN(self);
+    mtp_update_threshold(self);
+}
+
+STATIC void mtp_update_wakeup (void) {
+    for (int i = 0; i < MP_ARRAY_SIZE(touchpad_obj); i++) {
+        if (touchpad_obj[i].wake) {
+            esp_sleep_enable_touchpad_wakeup();
+            return;
+        }
+    }
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TOUCHPAD);
+}
+
+/******************************************************************************
+ DEFINE PUBLIC FUNCTIONS
+ ******************************************************************************/
+void machtouch_sleep_prepare (void) {
+    // only the pads selected with wake() may wake the chip, with their last calibrated threshold
+    for (int i = 0; i < MP_ARRAY_SIZE(touchpad_obj); i++) {
+        mtp_obj_t *self = &touchpad_obj[i];
+        if (self->active && !self->wake) {
+            self->armed = false;
+            mtp_update_threshold(self);
+        }
+    }
+}
+
+void machtouch_deinit_all (void) {
+    for (int i = 0; i < MP_ARRAY_SIZE(touchpad_obj); i++) {
+        mtp_obj_t *self = &touchpad_obj[i];
+        if (self->active) {
+            self->wake = false;
+            mtp_disarm(self);
+        }
+    }
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TOUCHPAD);
+}
+
+/******************************************************************************/
+// MicroPython bindings
+
 STATIC mp_obj_t mtp_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw,
         const mp_obj_t *args) {
 
@@ -86,13 +221,22 @@ STATIC mp_obj_t mtp_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_
         touch_pad_set_voltage(TOUCH_HVOLT_2V7, TOUCH_LVOLT_0V5, TOUCH_HVOLT_ATTEN_1V);
         // initialize and start a software filter to detect slight changes in capacitance
         touch_pad_filter_start(TOUCHPAD_FILTER_TOUCH_PERIOD_MS);
+        touch_pad_set_filter_read_cb(mtp_filter_cb);
         touch_pad_intr_disable();
         touch_pad_clear_status();
+        touch_pad_set_trigger_mode(TOUCH_TRIGGER_BELOW);
+        touch_pad_set_trigger_source(TOUCH_TRIGGER_SOURCE_SET1);
         initialized = 1;
     }
     esp_err_t err = touch_pad_config(self->touchpad_id, 0);
     mp_hal_delay_ms(TOUCHPAD_FILTER_TOUCH_PERIOD_MS * 2);
     touch_pad_read_filtered(self->touchpad_id, &self->init_value);
+    if (!self->active) {
+        self->baseline = (int32_t)self->init_value << TOUCHPAD_BASELINE_FRAC;
+        self->sensitivity = TOUCHPAD_SENSITIVITY_DEFAULT;
+        self->threshold = 0;
+        self->active = true;
+    }
 
     if (err == ESP_OK) return MP_OBJ_FROM_PTR(self);
     mp_raise_ValueError("Touch pad error");
@@ -127,11 +271,77 @@ STATIC mp_obj_t mtp_init_value(uint n_args, const mp_obj_t *arg) {
 }
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mtp_init_value_obj, 1, 2, mtp_init_value);
 
+/// \method baseline()
+/// The untouched value as tracked by the drift compensation.
+STATIC mp_obj_t mtp_baseline(mp_obj_t self_in) {
+    mtp_obj_t *self = self_in;
+    return MP_OBJ_NEW_SMALL_INT(self->baseline >> TOUCHPAD_BASELINE_FRAC);
+}
+MP_DEFINE_CONST_FUN_OBJ_1(mtp_baseline_obj, mtp_baseline);
+
+/// \method irq(handler=None, trigger=Touch.PRESS, *, arg=None, sensitivity=10)
+/// The pad counts as touched when its value drops sensitivity % below the
+/// baseline; the threshold interrupt of the touch sensor detects it.
+STATIC mp_obj_t mtp_irq(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_handler,      MP_ARG_OBJ,                  {.u_obj = mp_const_none} },
+        { MP_QSTR_trigger,      MP_ARG_INT,                  {.u_int = TOUCHPAD_TRIGGER_PRESS} },
+        { MP_QSTR_arg,          MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_sensitivity,  MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = TOUCHPAD_SENSITIVITY_DEFAULT} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+    mtp_obj_t *self = pos_args[0];
+
+    mp_int_t trigger = args[1].u_int;
+    mp_int_t sensitivity = args[3].u_int;
+    if ((trigger & ~(TOUCHPAD_TRIGGER_PRESS | TOUCHPAD_TRIGGER_RELEASE)) || sensitivity < 1 || sensitivity > 90) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+
+    mtp_disarm(self);
+    if (args[0].u_obj != mp_const_none) {
+        self->handler = args[0].u_obj;
+        self->handler_arg = (args[2].u_obj == mp_const_none) ? self : args[2].u_obj;
+        self->trigger = trigger;
+        self->sensitivity = sensitivity;
+        mp_irq_add(self, self->handler);
+        self->armed = true;
+        mtp_update_threshold(self);
+        if (!mtp_isr_installed) {
+            touch_pad_isr_register(mtp_isr, NULL);
+            touch_pad_intr_enable();
+            mtp_isr_installed = true;
+        }
+    }
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_KW(mtp_irq_obj, 1, mtp_irq);
+
+/// \method wake(enable=True)
+/// Makes a touch of the pad a deep sleep wake source, using the baseline
+/// calibrated up to the moment the chip goes to sleep.
+STATIC mp_obj_t mtp_wake(uint n_args, const mp_obj_t *arg) {
+    mtp_obj_t *self = arg[0];
+    self->wake = (n_args > 1) ? mp_obj_is_true(arg[1]) : true;
+    mtp_update_threshold(self);
+    mtp_update_wakeup();
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mtp_wake_obj, 1, 2, mtp_wake);
+
 STATIC const mp_rom_map_elem_t mtp_locals_dict_table[] = {
     // instance methods
     { MP_ROM_QSTR(MP_QSTR_config), MP_ROM_PTR(&mtp_config_obj) },
     { MP_ROM_QSTR(MP_QSTR_read), MP_ROM_PTR(&mtp_read_obj) },
     { MP_ROM_QSTR(MP_QSTR_init_value), MP_ROM_PTR(&mtp_init_value_obj) },
+    { MP_ROM_QSTR(MP_QSTR_baseline), MP_ROM_PTR(&mtp_baseline_obj) },
+    { MP_ROM_QSTR(MP_QSTR_irq), MP_ROM_PTR(&mtp_irq_obj) },
+    { MP_ROM_QSTR(MP_QSTR_wake), MP_ROM_PTR(&mtp_wake_obj) },
+
+    // class constants
+    { MP_ROM_QSTR(MP_QSTR_PRESS), MP_ROM_INT(TOUCHPAD_TRIGGER_PRESS) },
+    { MP_ROM_QSTR(MP_QSTR_RELEASE), MP_ROM_INT(TOUCHPAD_TRIGGER_RELEASE) },
 };
 
 STATIC MP_DEFINE_CONST_DICT(mtp_locals_dict, mtp_locals_dict_table);
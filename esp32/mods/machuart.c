@@ -40,6 +40,7 @@
 #include "mpexception.h"
 #include "utils/interrupt_char.h"
 #include "moduos.h"
+#include "mpirq.h"
 #include "machpin.h"
 #include "pins.h"
 #include "periph_ctrl.h"
@@ -47,7 +48,9 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/timers.h"
 #include "freertos/xtensa_api.h"
+#include "pollwait.h"
 
 /// \moduleref machine
 /// \class UART - duplex serial communication bus
@@ -64,6 +67,9 @@ extern void IRAM_ATTR mp_hal_trig_term_sig(void);
 #define MACHUART_RX_BUFFER_LEN                  (4096)
 #define MACHUART_TX_FIFO_LEN                    (UART_FIFO_LEN)
 
+#define MACHUART_FRAME_QUEUE_LEN                (16)
+#define MACHUART_FRAME_LEN_MAX                  (0xFFFF)
+
 // interrupt triggers
 #define UART_TRIGGER_RX_ANY                     (0x01)
 #define UART_TRIGGER_RX_HALF                    (0x02)
@@ -78,15 +84,37 @@ extern void IRAM_ATTR mp_hal_trig_term_sig(void);
  ******************************************************************************/
 static bool uart_tx_fifo_space (mach_uart_obj_t *self);
 STATIC mp_obj_t mach_uart_deinit(mp_obj_t self_in);
+STATIC void uart_frame_complete (mach_uart_obj_t *self, bool from_isr);
+STATIC void uart_frame_idle_timer (TimerHandle_t xTimer);
+STATIC void uart_frame_callback_handler (void *arg);
+STATIC void uart_frame_disable (mach_uart_obj_t *self);
 
 /******************************************************************************
  DEFINE PRIVATE TYPES
  ******************************************************************************/
+// the frames stay in the driver's ring buffer, only their boundaries are queued
+// skip is the length of the frames dropped before this one because the queue was full
+typedef struct {
+    uint16_t skip;
+    uint16_t len;
+} uart_frame_t;
+
 struct _mach_uart_obj_t {
     mp_obj_base_t base;
     uart_dev_t* uart_reg;
     pin_obj_t *pins[4];
     uart_config_t config;
+    mp_obj_t frame_handler;
+    QueueHandle_t frame_queue;
+    TimerHandle_t frame_timer;
+    volatile TickType_t frame_last_rx;
+    uint32_t frame_bytes;               // received so far for the frame being assembled
+    uint32_t frame_skip;
+    uint32_t frame_length;              // fixed frame length, 0 when not used
+    TickType_t frame_idle_ticks;        // idle gap closing a frame, 0 when not used
+    int16_t frame_delimiter;            // byte closing a frame, -1 when not used
+    bool framing;
+    int32_t rx_timeout_ms;
     uint8_t irq_flags;
     uint8_t uart_id;
     uint8_t rx_timeout;
@@ -98,6 +126,7 @@ struct _mach_uart_obj_t {
  DECLARE PRIVATE DATA
  ******************************************************************************/
 static mach_uart_obj_t mach_uart_obj[MACH_NUM_UARTS] = { {.uart_reg = &UART0}, {.uart_reg = &UART1}, {.uart_reg = &UART2} };
+static portMUX_TYPE mach_uart_frame_mux = portMUX_INITIALIZER_UNLOCKED;
 static const mp_obj_t mach_uart_def_pin[MACH_NUM_UARTS][2] = { { &PIN_MODULE_P1,  &PIN_MODULE_P0 },
                                                                { &PIN_MODULE_P3,  &PIN_MODULE_P4 },
                                                                { &PIN_MODULE_P8,  &PIN_MODULE_P9 } };
@@ -248,22 +277,21 @@ static void uart_assign_pins_af (mach_uart_obj_t *self, mp_obj_t *pins, uint32_t
     self->n_pins = n_pins;
 }
 
-// waits at most timeout microseconds for at least 1 char to become ready for
-// reading (from buf or for direct reading).
-// returns true if something available, false if not.
-STATIC bool uart_rx_wait (mach_uart_obj_t *self) {
-    int timeout = MACHUART_RX_TIMEOUT_US(self->config.baud_rate, self->rx_timeout);
-    for ( ; ; ) {
-        if (uart_rx_any(self)) {
-            return true; // we have at least 1 char ready for reading
-        }
-        if (timeout > 0) {
-            ets_delay_us(1);
-            timeout--;
-        } else {
-            return false;
-        }
+// the gap after which a read returns what it got so far, rounded up to the tick
+// the driver's ring buffer wakes the reader up, so waiting doesn't keep the CPU busy
+STATIC TickType_t uart_rx_gap_ticks (mach_uart_obj_t *self) {
+    uint32_t timeout_us = MACHUART_RX_TIMEOUT_US(self->config.baud_rate, self->rx_timeout);
+    return (timeout_us + (portTICK_PERIOD_MS * 1000) - 1) / (portTICK_PERIOD_MS * 1000);
+}
+
+// how long to wait for the first char of a read
+STATIC TickType_t uart_rx_first_ticks (mach_uart_obj_t *self) {
+    if (self->rx_timeout_ms < 0) {
+        return portMAX_DELAY;
+    } else if (self->rx_timeout_ms > 0) {
+        return self->rx_timeout_ms / portTICK_PERIOD_MS;
     }
+    return uart_rx_gap_ticks(self);
 }
 
 STATIC void mach_uart_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
@@ -316,6 +344,93 @@ STATIC IRAM_ATTR void UARTRxCallback(int uart_id, int rx_byte) {
         // raise an exception when interrupts are finished
         mp_hal_trig_term_sig();
     }
+
+    mach_uart_obj_t *self = &mach_uart_obj[uart_id];
+    if (self->framing) {
+        portENTER_CRITICAL_ISR(&mach_uart_frame_mux);
+        self->frame_bytes++;
+        self->frame_last_rx = xTaskGetTickCountFromISR();
+        portEXIT_CRITICAL_ISR(&mach_uart_frame_mux);
+        if (self->frame_delimiter == rx_byte || self->frame_bytes == self->frame_length || self->frame_bytes == MACHUART_FRAME_LEN_MAX) {
+            uart_frame_complete(self, true);
+        }
+    }
+    pollwait_notify_from_isr();
+}
+
+// closes the frame being assembled and lets the reader or the handler know
+STATIC IRAM_ATTR void uart_frame_complete (mach_uart_obj_t *self, bool from_isr) {
+    uart_frame_t frame;
+    bool queued;
+
+    if (from_isr) {
+        portENTER_CRITICAL_ISR(&mach_uart_frame_mux);
+    } else {
+        portENTER_CRITICAL(&mach_uart_frame_mux);
+    }
+    frame.len = self->frame_bytes;
+    frame.skip = self->frame_skip;
+    self->frame_bytes = 0;
+    if (from_isr) {
+        portEXIT_CRITICAL_ISR(&mach_uart_frame_mux);
+    } else {
+        portEXIT_CRITICAL(&mach_uart_frame_mux);
+    }
+
+    if (frame.len == 0) {
+        return;
+    }
+    if (from_isr) {
+        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+        queued = (xQueueSendFromISR(self->frame_queue, &frame, &xHigherPriorityTaskWoken) == pdTRUE);
+        if (xHigherPriorityTaskWoken) {
+            portYIELD_FROM_ISR();
+        }
+    } else {
+        queued = (xQueueSend(self->frame_queue, &frame, 0) == pdTRUE);
+    }
+    if (queued) {
+        self->frame_skip = 0;
+        if (self->frame_handler != mp_const_none) {
+            if (from_isr) {
+                mp_irq_queue_interrupt(uart_frame_callback_handler, (void *)self);
+            } else {
+                mp_irq_queue_interrupt_non_ISR(uart_frame_callback_handler, (void *)self);
+            }
+        }
+    } else {
+        // nobody is reading, drop it but keep the following frames aligned
+        self->frame_skip = MIN(self->frame_skip + frame.len, MACHUART_FRAME_LEN_MAX);
+    }
+}
+
+// runs in the timer task, twice per idle gap
+STATIC void uart_frame_idle_timer (TimerHandle_t xTimer) {
+    mach_uart_obj_t *self = pvTimerGetTimerID(xTimer);
+    if (self->frame_bytes > 0 && (xTaskGetTickCount() - self->frame_last_rx) >= self->frame_idle_ticks) {
+        uart_frame_complete(self, false);
+    }
+}
+
+STATIC void uart_frame_callback_handler (void *arg) {
+    mach_uart_obj_t *self = arg;
+    if (self->frame_handler && self->frame_handler != mp_const_none) {
+        mp_call_function_1(self->frame_handler, self);
+    }
+}
+
+STATIC void uart_frame_disable (mach_uart_obj_t *self) {
+    self->framing = false;
+    if (self->frame_timer != NULL) {
+        xTimerStop(self->frame_timer, portMAX_DELAY);
+    }
+    if (self->frame_queue != NULL) {
+        xQueueReset(self->frame_queue);
+    }
+    self->frame_bytes = 0;
+    self->frame_skip = 0;
+    self->frame_handler = mp_const_none;
+    mp_irq_remove(self);
 }
 
 STATIC mp_obj_t mach_uart_init_helper(mach_uart_obj_t *self, const mp_arg_val_t *args) {
@@ -427,6 +542,7 @@ STATIC mp_obj_t mach_uart_init_helper(mach_uart_obj_t *self, const mp_arg_val_t
     }
 
     self->rx_timeout = args[5].u_int;
+    self->rx_timeout_ms = args[7].u_int;
 
     self->base.type = &mach_uart_type;
     self->config.baud_rate = baudrate;
@@ -463,7 +579,8 @@ STATIC const mp_arg_t mach_uart_init_args[] = {
     { MP_QSTR_stop,                            MP_ARG_OBJ,  {.u_obj = mp_const_none} },
     { MP_QSTR_pins,           MP_ARG_KW_ONLY | MP_ARG_OBJ,  {.u_obj = MP_OBJ_NULL} },
     { MP_QSTR_timeout_chars,  MP_ARG_KW_ONLY | MP_ARG_INT,  {.u_int = 2} },
-    { MP_QSTR_rx_buffer_size, MP_ARG_KW_ONLY | MP_ARG_INT,  {.u_int = MACHUART_RX_BUFFER_LEN} }
+    { MP_QSTR_rx_buffer_size, MP_ARG_KW_ONLY | MP_ARG_INT,  {.u_int = MACHUART_RX_BUFFER_LEN} },
+    { MP_QSTR_timeout_ms,     MP_ARG_KW_ONLY | MP_ARG_INT,  {.u_int = 0} },
 };
 STATIC mp_obj_t mach_uart_make_new(const mp_obj_type_t *type, mp_uint_t n_args, mp_uint_t n_kw, const mp_obj_t *all_args) {
     // parse args
@@ -505,6 +622,8 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_uart_init_obj, 1, mach_uart_init);
 STATIC mp_obj_t mach_uart_deinit(mp_obj_t self_in) {
     mach_uart_obj_t *self = self_in;
 
+    uart_frame_disable(self);
+
     if (self->config.baud_rate > 0) {
         // invalidate the baudrate
         self->config.baud_rate = 0;
@@ -583,6 +702,112 @@ STATIC mp_obj_t mach_uart_sendbreak(mp_uint_t n_args, const mp_obj_t *pos_args,
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_uart_sendbreak_obj, 1, mach_uart_sendbreak);
 
+STATIC mp_obj_t mach_uart_framing(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t mach_uart_framing_args[] = {
+        { MP_QSTR_delimiter,      MP_ARG_KW_ONLY | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+        { MP_QSTR_length,         MP_ARG_KW_ONLY | MP_ARG_INT,  {.u_int = 0} },
+        { MP_QSTR_idle_ms,        MP_ARG_KW_ONLY | MP_ARG_INT,  {.u_int = 0} },
+        { MP_QSTR_handler,        MP_ARG_KW_ONLY | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+    };
+
+    mp_arg_val_t args[MP_ARRAY_SIZE(mach_uart_framing_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), mach_uart_framing_args, args);
+
+    mach_uart_obj_t *self = pos_args[0];
+    MACH_UART_CHECK_INIT(self)
+
+    int16_t delimiter = (args[0].u_obj == mp_const_none) ? -1 : mp_obj_get_int(args[0].u_obj);
+    if (delimiter > 0xFF || args[1].u_int < 0 || args[1].u_int > MACHUART_FRAME_LEN_MAX || args[2].u_int < 0) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+
+    uart_frame_disable(self);
+    // calling it without any rule turns framing off
+    if (delimiter < 0 && args[1].u_int == 0 && args[2].u_int == 0) {
+        return mp_const_none;
+    }
+
+    if (self->frame_queue == NULL) {
+        self->frame_queue = xQueueCreate(MACHUART_FRAME_QUEUE_LEN, sizeof(uart_frame_t));
+    }
+    self->frame_delimiter = delimiter;
+    self->frame_length = args[1].u_int;
+    self->frame_idle_ticks = args[2].u_int / portTICK_PERIOD_MS;
+    if (args[2].u_int > 0 && self->frame_idle_ticks == 0) {
+        self->frame_idle_ticks = 1;
+    }
+    self->frame_handler = args[3].u_obj;
+    if (self->frame_handler != mp_const_none) {
+        mp_irq_add(self, self->frame_handler);
+    }
+
+    // whatever is buffered now can't be told apart from the frames that follow
+    uart_flush_input(self->uart_id);
+    self->framing = true;
+
+    if (self->frame_idle_ticks > 0) {
+        TickType_t period = MAX(self->frame_idle_ticks / 2, 1);
+        if (self->frame_timer == NULL) {
+            self->frame_timer = xTimerCreate("UART_frame", period, pdTRUE, self, uart_frame_idle_timer);
+        } else {
+            xTimerChangePeriod(self->frame_timer, period, portMAX_DELAY);
+        }
+        xTimerStart(self->frame_timer, portMAX_DELAY);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mach_uart_framing_obj, 1, mach_uart_framing);
+
+STATIC mp_obj_t mach_uart_read_frame(mp_uint_t n_args, const mp_obj_t *args) {
+    mach_uart_obj_t *self = args[0];
+    MACH_UART_CHECK_INIT(self)
+    if (!self->framing) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_request_not_possible));
+    }
+
+    TickType_t timeout = 0;
+    if (n_args > 1) {
+        mp_int_t timeout_ms = mp_obj_get_int(args[1]);
+        timeout = (timeout_ms < 0) ? portMAX_DELAY : (timeout_ms / portTICK_PERIOD_MS);
+    }
+
+    uart_frame_t frame;
+    MP_THREAD_GIL_EXIT();
+    BaseType_t got = xQueueReceive(self->frame_queue, &frame, timeout);
+    MP_THREAD_GIL_ENTER();
+    if (got != pdTRUE) {
+        return mp_const_none;
+    }
+
+    // the frame is queued from the RX interrupt while its bytes are being moved into the ring buffer,
+    // so allow for the interrupt to finish on the other core
+    TickType_t settle = uart_rx_gap_ticks(self) + 1;
+    uint8_t discard[32];
+    while (frame.skip > 0) {
+        int32_t len = uart_read_bytes(self->uart_id, discard, MIN(frame.skip, sizeof(discard)), settle);
+        if (len <= 0) {
+            break;
+        }
+        frame.skip -= len;
+    }
+    vstr_t vstr;
+    vstr_init_len(&vstr, frame.len);
+    int32_t len = uart_read_bytes(self->uart_id, (uint8_t *)vstr.buf, frame.len, settle);
+    vstr.len = (len > 0) ? len : 0;
+    return mp_obj_new_str_from_vstr(&mp_type_bytes, &vstr);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mach_uart_read_frame_obj, 1, 2, mach_uart_read_frame);
+
+STATIC mp_obj_t mach_uart_frames(mp_obj_t self_in) {
+    mach_uart_obj_t *self = self_in;
+    MACH_UART_CHECK_INIT(self)
+    if (!self->framing) {
+        return MP_OBJ_NEW_SMALL_INT(0);
+    }
+    return MP_OBJ_NEW_SMALL_INT(uxQueueMessagesWaiting(self->frame_queue));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_uart_frames_obj, mach_uart_frames);
+
 STATIC const mp_map_elem_t mach_uart_locals_dict_table[] = {
     // instance methods
     { MP_OBJ_NEW_QSTR(MP_QSTR_init),            (mp_obj_t)&mach_uart_init_obj },
@@ -590,6 +815,9 @@ STATIC const mp_map_elem_t mach_uart_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_any),             (mp_obj_t)&mach_uart_any_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_wait_tx_done),    (mp_obj_t)&mach_uart_wait_tx_done_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_sendbreak),       (mp_obj_t)&mach_uart_sendbreak_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_framing),         (mp_obj_t)&mach_uart_framing_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_read_frame),      (mp_obj_t)&mach_uart_read_frame_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_frames),          (mp_obj_t)&mach_uart_frames_obj },
 //    { MP_OBJ_NEW_QSTR(MP_QSTR_irq),         (mp_obj_t)&pyb_uart_irq_obj },
 
     { MP_OBJ_NEW_QSTR(MP_QSTR_read),            (mp_obj_t)&mp_stream_read_obj },
@@ -614,22 +842,27 @@ STATIC mp_uint_t mach_uart_read(mp_obj_t self_in, void *buf_in, mp_uint_t size,
         return 0;
     }
 
-    // wait for first char to become available
-    if (!uart_rx_wait(self)) {
+    // sleep until the first char is available, other tasks and threads keep running meanwhile
+    MP_THREAD_GIL_EXIT();
+    int32_t len = uart_read_bytes(self->uart_id, buf, 1, uart_rx_first_ticks(self));
+    MP_THREAD_GIL_ENTER();
+    if (len <= 0) {
         // return EAGAIN error to indicate non-blocking (then read() method returns None)
         *errcode = MP_EAGAIN;
         return MP_STREAM_ERROR;
     }
 
-    // read the data
-    byte *orig_buf = buf;
-    for ( ; ; ) {
-        *buf++ = uart_rx_char(self);
-        if (--size == 0 || !uart_rx_wait(self)) {
-            // return number of bytes read
-            return buf - orig_buf;
+    // copy the rest in bulk straight from the driver's ring buffer, until it's full or the line goes quiet
+    if (size > 1) {
+        MP_THREAD_GIL_EXIT();
+        int32_t more = uart_read_bytes(self->uart_id, buf + 1, size - 1, uart_rx_gap_ticks(self));
+        MP_THREAD_GIL_ENTER();
+        if (more > 0) {
+            len += more;
         }
     }
+    // return number of bytes read
+    return len;
 }
 
 STATIC mp_uint_t mach_uart_write(mp_obj_t self_in, const void *buf_in, mp_uint_t size, int *errcode) {
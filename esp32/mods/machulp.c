@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/objarray.h"
+#include "mpexception.h"
+#include "machulp.h"
+
+#include "sdkconfig.h"
+#include "esp_sleep.h"
+#include "esp_clk.h"
+#include "rom/ets_sys.h"
+#include "soc/soc.h"
+#include "soc/rtc.h"
+#include "soc/rtc_cntl_reg.h"
+#include "soc/sens_reg.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define MACH_ULP_BIN_MAGIC              (0x00706c75)    // "ulp\0"
+#define MACH_ULP_NUM_PERIODS            (5)
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+// the header esp32ulp-elf-objcopy and micropython-esp32-ulp put in front of a program
+typedef struct {
+    uint32_t magic;
+    uint16_t text_offset;
+    uint16_t text_size;
+    uint16_t data_size;
+    uint16_t bss_size;
+} mach_ulp_bin_header_t;
+
+typedef struct _mach_ulp_obj_t {
+    mp_obj_base_t base;
+} mach_ulp_obj_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+STATIC mach_ulp_obj_t mach_ulp_obj = {{&mach_ulp_type}};
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+STATIC void mach_ulp_stop (void) {
+    CLEAR_PERI_REG_MASK(RTC_CNTL_STATE0_REG, RTC_CNTL_ULP_CP_SLP_TIMER_EN);
+    // takes effect on the next RTC slow clock cycle
+    ets_delay_us(10);
+}
+
+/******************************************************************************/
+// MicroPython bindings
+
+STATIC mp_obj_t mach_ulp_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+    mp_arg_check_num(n_args, n_kw, 0, 0, false);
+    return (mp_obj_t)&mach_ulp_obj;
+}
+
+// load_binary(load_addr, program_binary), load_addr is in 32 bit words from the
+// start of the RTC slow memory, as for ulp_load_binary() of the IDF
+STATIC mp_obj_t mach_ulp_load_binary (mp_obj_t self_in, mp_obj_t addr_in, mp_obj_t bin_in) {
+    mp_int_t addr = mp_obj_get_int(addr_in);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(bin_in, &bufinfo, MP_BUFFER_READ);
+
+    mach_ulp_bin_header_t header;
+    if (bufinfo.len < sizeof(header)) {
+        mp_raise_ValueError("not a ULP binary");
+    }
+    memcpy(&header, bufinfo.buf, sizeof(header));
+    if (header.magic != MACH_ULP_BIN_MAGIC || header.text_offset + header.text_size + header.data_size > bufinfo.len ||
+        (header.text_size | header.data_size | header.bss_size) % sizeof(uint32_t) != 0) {
+        mp_raise_ValueError("not a ULP binary");
+    }
+    uint32_t words = (header.text_size + header.data_size + header.bss_size) / sizeof(uint32_t);
+    if (addr < 0 || (addr + words) * sizeof(uint32_t) > CONFIG_ULP_COPROC_RESERVE_MEM) {
+        mp_raise_ValueError("program doesn't fit");
+    }
+
+    mach_ulp_stop();
+    uint32_t *dst = (uint32_t *)RTC_SLOW_MEM + addr;
+    memcpy(dst, (const uint8_t *)bufinfo.buf + header.text_offset, header.text_size + header.data_size);
+    memset((uint8_t *)dst + header.text_size + header.data_size, 0, header.bss_size);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(mach_ulp_load_binary_obj, mach_ulp_load_binary);
+
+// run(entry_point), the entry point is a byte offset into the RTC slow memory
+STATIC mp_obj_t mach_ulp_run (mp_obj_t self_in, mp_obj_t entry_in) {
+    mp_uint_t entry = mp_obj_get_int(entry_in) / sizeof(uint32_t);
+    if (entry * sizeof(uint32_t) >= CONFIG_ULP_COPROC_RESERVE_MEM) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    // the same sequence as ulp_run() of the IDF
+    mach_ulp_stop();
+    REG_SET_FIELD(SENS_SAR_START_FORCE_REG, SENS_PC_INIT, entry);
+    CLEAR_PERI_REG_MASK(SENS_SAR_START_FORCE_REG, SENS_ULP_CP_FORCE_START_TOP_M);
+    REG_SET_FIELD(RTC_CNTL_TIMER5_REG, RTC_CNTL_MIN_SLP_VAL, RTC_CNTL_MIN_SLP_VAL_MIN);
+    // keep the voltage up while the 8 MHz clock runs
+    SET_PERI_REG_MASK(RTC_CNTL_OPTIONS0_REG, RTC_CNTL_BIAS_I2C_FOLW_8M);
+    SET_PERI_REG_MASK(RTC_CNTL_OPTIONS0_REG, RTC_CNTL_BIAS_CORE_FOLW_8M);
+    SET_PERI_REG_MASK(RTC_CNTL_OPTIONS0_REG, RTC_CNTL_BIAS_SLEEP_FOLW_8M);
+    SET_PERI_REG_MASK(RTC_CNTL_STATE0_REG, RTC_CNTL_ULP_CP_SLP_TIMER_EN);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mach_ulp_run_obj, mach_ulp_run);
+
+STATIC mp_obj_t mach_ulp_stop_ (mp_obj_t self_in) {
+    mach_ulp_stop();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_ulp_stop_obj, mach_ulp_stop_);
+
+// set_wakeup_period(period_index, period_us), the time from a HALT to the next run,
+// the SLEEP instruction of the program picks one of the 5 periods
+STATIC mp_obj_t mach_ulp_set_wakeup_period (mp_obj_t self_in, mp_obj_t index_in, mp_obj_t period_in) {
+    mp_int_t index = mp_obj_get_int(index_in);
+    if (index < 0 || index >= MACH_ULP_NUM_PERIODS) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    uint64_t cycles = rtc_time_us_to_slowclk(mp_obj_get_int_truncated(period_in), esp_clk_slowclk_cal_get());
+    if (cycles > SENS_SLEEP_CYCLES_S0) {
+        mp_raise_ValueError("period too long");
+    }
+    REG_SET_FIELD(SENS_ULP_CP_SLEEP_CYC0_REG + index * sizeof(uint32_t), SENS_SLEEP_CYCLES_S0, (uint32_t)cycles);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(mach_ulp_set_wakeup_period_obj, mach_ulp_set_wakeup_period);
+
+// the memory shared with the program, one 32 bit word per variable of which the ULP
+// only reads and writes the lower 16 bits
+STATIC mp_obj_t mach_ulp_memory (mp_obj_t self_in) {
+    return mp_obj_new_memoryview('I' | MP_OBJ_ARRAY_TYPECODE_FLAG_RW, CONFIG_ULP_COPROC_RESERVE_MEM / sizeof(uint32_t), (void *)RTC_SLOW_MEM);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_ulp_memory_obj, mach_ulp_memory);
+
+// let the WAKE instruction of the program end a deep sleep, seen as machine.ULP_WAKE
+STATIC mp_obj_t mach_ulp_wake_on_halt (mp_obj_t self_in, mp_obj_t enable_in) {
+    if (mp_obj_is_true(enable_in)) {
+        if (esp_sleep_enable_ulp_wakeup() != ESP_OK) {
+            mp_raise_msg(&mp_type_OSError, mpexception_os_operation_failed);
+        }
+    } else {
+        esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ULP);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mach_ulp_wake_on_halt_obj, mach_ulp_wake_on_halt);
+
+STATIC const mp_map_elem_t mach_ulp_locals_dict_table[] = {
+    { MP_OBJ_NEW_QSTR(MP_QSTR_load_binary),         (mp_obj_t)&mach_ulp_load_binary_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_run),                 (mp_obj_t)&mach_ulp_run_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_stop),                (mp_obj_t)&mach_ulp_stop_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_set_wakeup_period),   (mp_obj_t)&mach_ulp_set_wakeup_period_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_memory),              (mp_obj_t)&mach_ulp_memory_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_wake_on_halt),        (mp_obj_t)&mach_ulp_wake_on_halt_obj },
+};
+STATIC MP_DEFINE_CONST_DICT(mach_ulp_locals_dict, mach_ulp_locals_dict_table);
+
+const mp_obj_type_t mach_ulp_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_ULP,
+    .make_new = mach_ulp_make_new,
+    .locals_dict = (mp_obj_t)&mach_ulp_locals_dict,
+};
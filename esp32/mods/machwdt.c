@@ -30,6 +30,7 @@
 #include "driver/timer.h"
 
 #include "machwdt.h"
+#include "taskwdt.h"
 
 
 /******************************************************************************
@@ -56,8 +57,9 @@ const mp_obj_type_t mach_wdt_type;
  ******************************************************************************/
 
 static void task_wdt_isr (void *arg) {
-    // ack the interrupt
+    // ack the interrupt, the reset is one more timeout away
     TIMERG0.int_clr_timers.wdt = 1;
+    taskwdt_hw_expired();
 }
 
 /******************************************************************************
@@ -85,6 +87,8 @@ void machine_wdt_start (uint32_t timeout_ms) {
         esp_intr_alloc(ETS_TG0_WDT_LEVEL_INTR_SOURCE, 0, task_wdt_isr, NULL, NULL);
         mach_wdt_obj.started = true;
     }
+    // from now on a system task that misses its deadline resets the board too
+    taskwdt_start();
 }
 
 /******************************************************************************/
@@ -130,13 +134,48 @@ STATIC mp_obj_t mach_wdt_feed (mp_obj_t self_in) {
     TIMERG0.wdt_wprotect = TIMG_WDT_WKEY_VALUE;
     TIMERG0.wdt_feed = 1;
     TIMERG0.wdt_wprotect = 0;
+    taskwdt_alive();
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(mach_wdt_feed_obj, mach_wdt_feed);
 
+/// \method watch(timeout)
+/// the calling thread must then feed() at least every timeout ms, or the board
+/// resets with a report naming it
+STATIC mp_obj_t mach_wdt_watch (mp_obj_t self_in, mp_obj_t timeout_in) {
+    mp_int_t timeout = mp_obj_get_int(timeout_in);
+    if (timeout <= 0) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    taskwdt_register(timeout);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mach_wdt_watch_obj, mach_wdt_watch);
+
+/// \method tasks()
+/// [(name, timeout_ms, since_alive_ms, stack_free, sleeping), ...] of the watched tasks
+STATIC mp_obj_t mach_wdt_tasks (void) {
+    return taskwdt_get_tasks();
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mach_wdt_tasks_fun_obj, mach_wdt_tasks);
+STATIC MP_DEFINE_CONST_STATICMETHOD_OBJ(mach_wdt_tasks_obj, (mp_obj_t)&mach_wdt_tasks_fun_obj);
+
+/// \method report()
+/// what made the watchdog reset the board last time, None after any other reset:
+/// (task, timeout_ms, overdue_ms, stack_free, hw, [(event, phase, arg, age_us), ...])
+/// with the latest trace events if tracing was on
+STATIC mp_obj_t mach_wdt_report (void) {
+    return taskwdt_get_report();
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mach_wdt_report_fun_obj, mach_wdt_report);
+STATIC MP_DEFINE_CONST_STATICMETHOD_OBJ(mach_wdt_report_obj, (mp_obj_t)&mach_wdt_report_fun_obj);
+
 STATIC const mp_map_elem_t mach_wdt_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_init),                (mp_obj_t)&mach_wdt_init_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_feed),                (mp_obj_t)&mach_wdt_feed_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_watch),               (mp_obj_t)&mach_wdt_watch_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_tasks),               (mp_obj_t)&mach_wdt_tasks_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_report),              (mp_obj_t)&mach_wdt_report_obj },
 };
 STATIC MP_DEFINE_CONST_DICT(mach_wdt_locals_dict, mach_wdt_locals_dict_table);
 
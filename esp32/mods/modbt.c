@@ -50,6 +50,8 @@
 #include "freertos/queue.h"
 #include "freertos/event_groups.h"
 
+#include "esp_heap_caps.h"
+
 #include "lwip/opt.h"
 #include "lwip/def.h"
 
@@ -60,6 +62,16 @@
  DEFINE PRIVATE CONSTANTS
  ******************************************************************************/
 #define BT_SCAN_QUEUE_SIZE_MAX                              (16)
+#define BT_SCAN_RING_SIZE                                   (32)
+#define BT_SCAN_RING_SIZE_PSRAM                             (1024)
+#define BT_SCAN_DEDUP_SIZE                                  (64)
+#define BT_SCAN_FILTER_MAC_MAX                              (8)
+#define BT_SCAN_FILTER_PREFIX_MAX                           (16)
+#define BT_NOTIFY_RING_SIZE                                 (16)
+#define BT_NOTIFY_RING_SIZE_PSRAM                           (128)
+#define BT_NOTIFY_CONGEST_TIMEOUT_MS                        (1000)
+#define BT_CONN_INTERVAL_UNIT_US                            (1250)
+#define BT_CONN_TIMEOUT_UNIT_MS                             (10)
 #define BT_GATTS_QUEUE_SIZE_MAX                             (2)
 #define BT_MTU_SIZE_MAX                                     (200)
 #define BT_CHAR_VALUE_SIZE_MAX                              (BT_MTU_SIZE_MAX - 3)
@@ -154,6 +166,53 @@ typedef struct {
     uint16_t    value_len;
 } bt_read_value_t;
 
+// what is kept of an advertisement report, a fraction of esp_ble_gap_cb_param_t
+typedef struct {
+    esp_bd_addr_t   bda;
+    uint8_t         addr_type;
+    uint8_t         adv_type;
+    int8_t          rssi;
+    uint8_t         data[ESP_BLE_ADV_DATA_LEN_MAX + ESP_BLE_SCAN_RSP_DATA_LEN_MAX];
+} bt_scan_result_t;
+
+typedef struct {
+    esp_bd_addr_t   bda;
+    uint32_t        data_hash;
+    TickType_t      seen;
+} bt_scan_seen_t;
+
+// a notification or indication received by the client, waiting for the handler to run
+typedef struct {
+    int32_t         conn_id;
+    uint16_t        handle;
+    uint16_t        value_len;
+    uint32_t        event;
+    uint8_t         value[BT_CHAR_VALUE_SIZE_MAX];
+} bt_notify_t;
+
+// fixed size records copied in and out under a spinlock, filled by the BT task and drained by the MicroPython one
+typedef struct {
+    uint8_t         *items;
+    uint32_t        dropped;
+    uint16_t        item_size;
+    uint16_t        size;
+    uint16_t        head;
+    uint16_t        count;
+    bool            overwrite;          // when full, replace the oldest record instead of dropping the new one
+    portMUX_TYPE    mux;
+} bt_ring_t;
+
+typedef struct {
+    esp_bd_addr_t   macs[BT_SCAN_FILTER_MAC_MAX];
+    uint8_t         uuid[ESP_UUID_LEN_128];
+    uint8_t         prefix[BT_SCAN_FILTER_PREFIX_MAX];
+    TickType_t      dedup_ticks;
+    int8_t          rssi;
+    uint8_t         n_macs;
+    uint8_t         uuid_len;           // 0 when not filtering by UUID
+    uint8_t         prefix_len;         // 0 when not filtering by manufacturer data
+} bt_scan_filter_t;
+
 typedef struct {
     esp_gatt_status_t status;
 } bt_write_value_t;
@@ -229,12 +288,6 @@ typedef struct {
     uint8_t* data;
 } gatts_char_cbk_arg_t;
 
-typedef struct {
-    bt_char_obj_t *chr;
-    uint32_t event;
-    uint32_t data_length;
-    uint8_t* data;
-} gattc_char_cbk_arg_t;
 
 
 /******************************************************************************
@@ -242,6 +295,13 @@ typedef struct {
  ******************************************************************************/
 static volatile bt_obj_t bt_obj;
 static QueueHandle_t xScanQueue;
+
+// the advertisement reports, the oldest one is overwritten when full
+static bt_ring_t bt_scan_ring = { .overwrite = true, .mux = portMUX_INITIALIZER_UNLOCKED };
+static bt_ring_t bt_notify_ring = { .overwrite = false, .mux = portMUX_INITIALIZER_UNLOCKED };
+static volatile bool bt_gatts_congested;
+static bt_scan_filter_t bt_scan_filter = { .rssi = -128 };
+static bt_scan_seen_t bt_scan_seen[BT_SCAN_DEDUP_SIZE];
 static QueueHandle_t xGattsQueue;
 
 static esp_ble_adv_data_t adv_data;
@@ -265,6 +325,8 @@ static esp_ble_adv_params_t bt_adv_params = {
 };
 
 static bool mod_bt_allow_resume_deinit;
+// set once the controller and Bluedroid memory was given to the heap, only a reset gets it back
+static bool mod_bt_mem_released;
 static uint16_t mod_bt_gatts_mtu_restore = 0;
 
 static nvs_handle modbt_nvs_handle;
@@ -281,6 +343,11 @@ static void close_connection(int32_t conn_id);
 static esp_err_t modem_sleep(bool enable);
 
 STATIC void bluetooth_callback_handler(void *arg);
+static void bt_ring_alloc(bt_ring_t *ring, uint16_t item_size, uint16_t size, uint16_t size_psram);
+static void bt_ring_reset(bt_ring_t *ring);
+static bool bt_ring_get(bt_ring_t *ring, void *item);
+static void bt_scan_ring_reset(void);
+STATIC void gattc_notify_callback_handler(void *arg);
 STATIC void gattc_char_callback_handler(void *arg);
 STATIC void gatts_char_callback_handler(void *arg);
 static mp_obj_t modbt_start_scan(mp_obj_t timeout);
@@ -296,6 +363,12 @@ void modbt_init0(void) {
     } else {
         xQueueReset(xScanQueue);
     }
+    // busy places easily have hundreds of beacons
+    bt_ring_alloc(&bt_scan_ring, sizeof(bt_scan_result_t), BT_SCAN_RING_SIZE, BT_SCAN_RING_SIZE_PSRAM);
+    bt_scan_ring_reset();
+    bt_ring_alloc(&bt_notify_ring, sizeof(bt_notify_t), BT_NOTIFY_RING_SIZE, BT_NOTIFY_RING_SIZE_PSRAM);
+    bt_ring_reset(&bt_notify_ring);
+    bt_gatts_congested = false;
     if (!xGattsQueue) {
         xGattsQueue = xQueueCreate(BT_GATTS_QUEUE_SIZE_MAX, sizeof(bt_gatts_event_result_t));
     } else {
@@ -321,7 +394,9 @@ void modbt_init0(void) {
     mp_obj_list_init((mp_obj_t)&MP_STATE_PORT(bts_srv_list), 0);
     mp_obj_list_init((mp_obj_t)&MP_STATE_PORT(bts_attr_list), 0);
 
-    esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT);
+    if (!mod_bt_mem_released) {
+        esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT);
+    }
 
     mod_bt_allow_resume_deinit = false;
 }
@@ -376,7 +451,7 @@ void modbt_deinit(bool allow_reconnect)
 
 void bt_resume(bool reconnect)
 {
-    if(mod_bt_allow_resume_deinit && !bt_obj.init)
+    if(mod_bt_allow_resume_deinit && !bt_obj.init && !mod_bt_mem_released)
     {
         esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
         esp_bt_controller_init(&bt_cfg);
@@ -630,6 +705,161 @@ static bt_gatts_attr_obj_t *find_gatts_attr_by_handle (uint16_t handle) {
     return NULL;
 }
 
+static void bt_ring_alloc(bt_ring_t *ring, uint16_t item_size, uint16_t size, uint16_t size_psram) {
+    if (!ring->items) {
+        // use the PSRAM when there is one
+        if (heap_caps_get_free_size(MALLOC_CAP_SPIRAM) > 0) {
+            ring->items = heap_caps_malloc(size_psram * item_size, MALLOC_CAP_SPIRAM);
+            ring->size = size_psram;
+        } else {
+            ring->items = heap_caps_malloc(size * item_size, MALLOC_CAP_INTERNAL);
+            ring->size = size;
+        }
+        if (!ring->items) {
+            ring->size = 0;
+        }
+        ring->item_size = item_size;
+    }
+}
+
+static void bt_ring_reset(bt_ring_t *ring) {
+    portENTER_CRITICAL(&ring->mux);
+    ring->head = 0;
+    ring->count = 0;
+    ring->dropped = 0;
+    portEXIT_CRITICAL(&ring->mux);
+}
+
+static bool bt_ring_put(bt_ring_t *ring, const void *item) {
+    bool ret = true;
+    portENTER_CRITICAL(&ring->mux);
+    if (ring->count == ring->size) {
+        ring->dropped++;
+        if (!ring->overwrite || ring->size == 0) {
+            ret = false;
+            goto exit;
+        }
+        ring->head = (ring->head + 1) % ring->size;
+        ring->count--;
+    }
+    memcpy(&ring->items[((ring->head + ring->count) % ring->size) * ring->item_size], item, ring->item_size);
+    ring->count++;
+exit:
+    portEXIT_CRITICAL(&ring->mux);
+    return ret;
+}
+
+static bool bt_ring_get(bt_ring_t *ring, void *item) {
+    bool ret = false;
+    portENTER_CRITICAL(&ring->mux);
+    if (ring->count > 0) {
+        memcpy(item, &ring->items[ring->head * ring->item_size], ring->item_size);
+        ring->head = (ring->head + 1) % ring->size;
+        ring->count--;
+        ret = true;
+    }
+    portEXIT_CRITICAL(&ring->mux);
+    return ret;
+}
+
+static void bt_scan_ring_reset(void) {
+    bt_ring_reset(&bt_scan_ring);
+    portENTER_CRITICAL(&bt_scan_ring.mux);
+    memset(bt_scan_seen, 0, sizeof(bt_scan_seen));
+    portEXIT_CRITICAL(&bt_scan_ring.mux);
+}
+
+// returns the payload of each AD structure of the given types in turn, data is NULL when none is left
+static uint8_t *bt_scan_find_ad(uint8_t *data, uint8_t **pos, uint8_t type_a, uint8_t type_b, uint8_t *len) {
+    uint8_t *end = data + ESP_BLE_ADV_DATA_LEN_MAX + ESP_BLE_SCAN_RSP_DATA_LEN_MAX;
+    uint8_t *p = (*pos) ? *pos : data;
+    while (p < end && p[0] != 0) {
+        uint8_t *ad = p;
+        p += ad[0] + 1;
+        if (p > end) {
+            break;
+        }
+        if (ad[1] == type_a || ad[1] == type_b) {
+            *pos = p;
+            *len = ad[0] - 1;
+            return &ad[2];
+        }
+    }
+    return NULL;
+}
+
+static bool bt_scan_filter_accept(bt_scan_result_t *result) {
+    bt_scan_filter_t *filter = &bt_scan_filter;
+    uint8_t *payload, *pos, len;
+
+    if (result->rssi < filter->rssi) {
+        return false;
+    }
+    if (filter->n_macs > 0) {
+        int i;
+        for (i = 0; i < filter->n_macs; i++) {
+            if (!memcmp(filter->macs[i], result->bda, ESP_BD_ADDR_LEN)) {
+                break;
+            }
+        }
+        if (i == filter->n_macs) {
+            return false;
+        }
+    }
+    if (filter->prefix_len > 0) {
+        pos = NULL;
+        payload = bt_scan_find_ad(result->data, &pos, ESP_BLE_AD_MANUFACTURER_SPECIFIC_TYPE, ESP_BLE_AD_MANUFACTURER_SPECIFIC_TYPE, &len);
+        if (!payload || len < filter->prefix_len || memcmp(payload, filter->prefix, filter->prefix_len)) {
+            return false;
+        }
+    }
+    if (filter->uuid_len > 0) {
+        // UUIDs are sent little endian, which is also how the filter stores them
+        bool found = false;
+        uint8_t type_a = (filter->uuid_len == ESP_UUID_LEN_16) ? ESP_BLE_AD_TYPE_16SRV_PART : ESP_BLE_AD_TYPE_128SRV_PART;
+        uint8_t type_b = (filter->uuid_len == ESP_UUID_LEN_16) ? ESP_BLE_AD_TYPE_16SRV_CMPL : ESP_BLE_AD_TYPE_128SRV_CMPL;
+        pos = NULL;
+        while (!found && (payload = bt_scan_find_ad(result->data, &pos, type_a, type_b, &len))) {
+            for (int i = 0; i + filter->uuid_len <= len; i += filter->uuid_len) {
+                if (!memcmp(&payload[i], filter->uuid, filter->uuid_len)) {
+                    found = true;
+                    break;
+                }
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    if (filter->dedup_ticks > 0) {
+        // the same address with the same data within the window is a duplicate
+        uint32_t hash = 5381;
+        for (int i = 0; i < sizeof(result->data); i++) {
+            hash = (hash * 33) ^ result->data[i];
+        }
+        TickType_t now = xTaskGetTickCount();
+        bt_scan_seen_t *oldest = &bt_scan_seen[0];
+        for (int i = 0; i < BT_SCAN_DEDUP_SIZE; i++) {
+            bt_scan_seen_t *seen = &bt_scan_seen[i];
+            if (!memcmp(seen->bda, result->bda, ESP_BD_ADDR_LEN)) {
+                bool duplicate = (seen->data_hash == hash && (now - seen->seen) < filter->dedup_ticks);
+                if (!duplicate) {
+                    seen->data_hash = hash;
+                    seen->seen = now;
+                }
+                return !duplicate;
+            }
+            if ((now - seen->seen) > (now - oldest->seen)) {
+                oldest = seen;
+            }
+        }
+        memcpy(oldest->bda, result->bda, ESP_BD_ADDR_LEN);
+        oldest->data_hash = hash;
+        oldest->seen = now;
+    }
+    return true;
+}
+
 static void gap_events_handler (esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
     switch (event) {
     case ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT: {
@@ -656,19 +886,28 @@ static void gap_events_handler (esp_gap_ble_cb_event_t event, esp_ble_gap_cb_par
         if (bt_obj.secure){
             esp_ble_gap_security_rsp(param->ble_security.ble_req.bd_addr, true);
         }
+        break;
     }
     case ESP_GAP_BLE_SCAN_RESULT_EVT: {
-        bt_event_result_t bt_event_result;
         esp_ble_gap_cb_param_t *scan_result = (esp_ble_gap_cb_param_t *)param;
-        memcpy(&bt_event_result.scan, scan_result, sizeof(esp_ble_gap_cb_param_t));
         switch (scan_result->scan_rst.search_evt) {
-        case ESP_GAP_SEARCH_INQ_RES_EVT:
-            xQueueSend(xScanQueue, (void *)&bt_event_result, (TickType_t)0);
+        case ESP_GAP_SEARCH_INQ_RES_EVT: {
+            bt_scan_result_t result;
+            memcpy(result.bda, scan_result->scan_rst.bda, ESP_BD_ADDR_LEN);
+            result.addr_type = scan_result->scan_rst.ble_addr_type;
+            result.adv_type = scan_result->scan_rst.ble_evt_type;
+            result.rssi = scan_result->scan_rst.rssi;
+            memcpy(result.data, scan_result->scan_rst.ble_adv, sizeof(result.data));
+            if (!bt_scan_filter_accept(&result)) {
+                break;
+            }
+            bt_ring_put(&bt_scan_ring, &result);
             bt_obj.events |= MOD_BT_GATTC_ADV_EVT;
             if (bt_obj.trigger & MOD_BT_GATTC_ADV_EVT) {
                 mp_irq_queue_interrupt_non_ISR(bluetooth_callback_handler, (void *)&bt_obj);
             }
             break;
+        }
         case ESP_GAP_SEARCH_DISC_RES_EVT:
             break;
         case ESP_GAP_SEARCH_INQ_CMPL_EVT:
@@ -761,32 +1000,28 @@ static void gattc_events_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc
         bt_char_obj_t *char_obj;
         char_obj = find_gattc_char (p_data->notify.conn_id, p_data->notify.handle);
         if (char_obj != NULL) {
+            uint16_t value_len = p_data->notify.value_len > BT_CHAR_VALUE_SIZE_MAX ? BT_CHAR_VALUE_SIZE_MAX : p_data->notify.value_len;
+            uint32_t event = p_data->notify.is_notify ? MOD_BT_GATTC_NOTIFY_EVT : MOD_BT_GATTC_INDICATE_EVT;
+
             // copy the new value into the characteristic
-            memcpy(&char_obj->value, p_data->notify.value, p_data->notify.value_len);
-            char_obj->value_len = p_data->notify.value_len;
+            memcpy(&char_obj->value, p_data->notify.value, value_len);
+            char_obj->value_len = value_len;
 
             // register the event
-            if (p_data->notify.is_notify) {
-                char_obj->events |= MOD_BT_GATTC_NOTIFY_EVT;
-            } else {
-                char_obj->events |= MOD_BT_GATTC_INDICATE_EVT;
-            }
-
-            if ((char_obj->trigger & MOD_BT_GATTC_NOTIFY_EVT) || (char_obj->trigger & MOD_BT_GATTC_INDICATE_EVT)) {
-
-                gattc_char_cbk_arg_t *cbk_arg = malloc(sizeof(gattc_char_cbk_arg_t));
-
-                cbk_arg->chr = char_obj;
-                if (p_data->notify.is_notify) {
-                    cbk_arg->event =  MOD_BT_GATTC_NOTIFY_EVT;
-                } else {
-                    cbk_arg->event =  MOD_BT_GATTC_INDICATE_EVT;
+            char_obj->events |= event;
+
+            if (char_obj->trigger & event) {
+                bt_notify_t notify;
+                notify.conn_id = p_data->notify.conn_id;
+                notify.handle = p_data->notify.handle;
+                notify.event = event;
+                notify.value_len = value_len;
+                memcpy(notify.value, p_data->notify.value, value_len);
+
+                // a single drain call is queued, it runs the handlers for everything received meanwhile
+                if (bt_ring_put(&bt_notify_ring, &notify)) {
+                    mp_irq_queue_interrupt_non_ISR(gattc_notify_callback_handler, (void *)&bt_notify_ring);
                 }
-                cbk_arg->data_length = p_data->notify.value_len;
-                cbk_arg->data = malloc(cbk_arg->data_length);
-                memcpy(cbk_arg->data, p_data->notify.value, cbk_arg->data_length);
-
-                mp_irq_queue_interrupt_non_ISR(gattc_char_callback_handler, cbk_arg);
             }
         }
         break;
@@ -816,22 +1051,22 @@ STATIC void bluetooth_callback_handler(void *arg) {
 }
 
 // this function will be called by the interrupt thread
-STATIC void gattc_char_callback_handler(void *arg) {
-    bt_char_obj_t *chr = ((gattc_char_cbk_arg_t *)arg)->chr;
-
-    if (chr->handler && chr->handler != mp_const_none) {
-
-        mp_obj_t tuple[2];
-        tuple[0] = mp_obj_new_int(((gattc_char_cbk_arg_t*)arg)->event);
-        tuple[1] = mp_const_none;
-        if(((gattc_char_cbk_arg_t*)arg)->data_length > 0) {
-            tuple[1] = mp_obj_new_bytes(((gattc_char_cbk_arg_t*)arg)->data, ((gattc_char_cbk_arg_t*)arg)->data_length);
-            free(((gattc_char_cbk_arg_t*)arg)->data);
+STATIC void gattc_notify_callback_handler(void *arg) {
+    bt_notify_t notify;
+
+    while (bt_ring_get((bt_ring_t *)arg, &notify)) {
+        // the connection may have been closed since the notification arrived
+        bt_char_obj_t *chr = find_gattc_char(notify.conn_id, notify.handle);
+        if (chr && chr->handler && chr->handler != mp_const_none) {
+            mp_obj_t tuple[2];
+            tuple[0] = mp_obj_new_int(notify.event);
+            tuple[1] = mp_const_none;
+            if (notify.value_len > 0) {
+                tuple[1] = mp_obj_new_bytes(notify.value, notify.value_len);
+            }
+            mp_call_function_2(chr->handler, chr->handler_arg, mp_obj_new_tuple(2, tuple));
         }
-
-        mp_call_function_2(chr->handler, chr->handler_arg, mp_obj_new_tuple(2, tuple));
     }
-    free((gattc_char_cbk_arg_t*)arg);
 }
 
 // this function will be called by the interrupt thread
@@ -1034,6 +1269,7 @@ static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_
         break;
     case ESP_GATTS_DISCONNECT_EVT:
         bt_obj.gatts_conn_id = -1;
+        bt_gatts_congested = false;
         xEventGroupClearBits(bt_event_group, MOD_BT_GATTS_MTU_EVT);
         if (bt_obj.advertising) {
             esp_ble_gap_start_advertising(&bt_adv_params);
@@ -1047,10 +1283,13 @@ static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_
     case ESP_GATTS_CLOSE_EVT:
         xEventGroupSetBits(bt_event_group, MOD_BT_GATTS_CLOSE_EVT);
         break;
+    case ESP_GATTS_CONGEST_EVT:
+        // the controller buffers are full, notify_many() holds off until they drain
+        bt_gatts_congested = p->congest.congested;
+        break;
     case ESP_GATTS_OPEN_EVT:
     case ESP_GATTS_CANCEL_OPEN_EVT:
     case ESP_GATTS_LISTEN_EVT:
-    case ESP_GATTS_CONGEST_EVT:
     default:
         break;
     }
@@ -1062,6 +1301,9 @@ static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_
 /// \class Bluetooth
 static mp_obj_t bt_init_helper(bt_obj_t *self, const mp_arg_val_t *args) {
     if (!self->init) {
+        if (mod_bt_mem_released) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Bluetooth memory released, reset to enable it again"));
+        }
 
         esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
         esp_bt_controller_init(&bt_cfg);
@@ -1207,7 +1449,29 @@ mp_obj_t bt_deinit(mp_obj_t self_in) {
     MP_THREAD_GIL_ENTER();
     return mp_const_none;
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_1(bt_deinit_obj, bt_deinit);
+
+/// \method deinit(*, release_memory=False)
+/// With release_memory=True the ~60 KB reserved for the controller and the
+/// Bluedroid stack are handed to the system heap (sockets, TLS, LoRa buffers).
+/// The IDF cannot take them back, so Bluetooth stays unavailable until a reset.
+STATIC mp_obj_t bt_deinit_kw(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_release_memory,       MP_ARG_KW_ONLY  | MP_ARG_BOOL,  {.u_bool = false} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    bt_deinit(pos_args[0]);
+    if (args[0].u_bool && !mod_bt_mem_released) {
+        // the controller must be back in its idle state, which modbt_deinit guarantees
+        if (ESP_OK != esp_bt_mem_release(ESP_BT_MODE_BTDM)) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_request_not_possible));
+        }
+        mod_bt_mem_released = true;
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(bt_deinit_obj, 1, bt_deinit_kw);
 
 STATIC mp_obj_t bt_start_scan(mp_obj_t self_in, mp_obj_t timeout) {
     if (bt_obj.scanning || bt_obj.busy) {
@@ -1222,6 +1486,7 @@ STATIC mp_obj_t bt_start_scan(mp_obj_t self_in, mp_obj_t timeout) {
     bt_obj.scan_duration = duration;
     bt_obj.scanning = true;
     xQueueReset(xScanQueue);
+    bt_scan_ring_reset();
     if (ESP_OK != esp_ble_gap_set_scan_params(&ble_scan_params)) {
         nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_operation_failed));
     }
@@ -1280,49 +1545,145 @@ STATIC mp_obj_t bt_stop_scan(mp_obj_t self_in) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(bt_stop_scan_obj, bt_stop_scan);
 
-STATIC mp_obj_t bt_read_scan(mp_obj_t self_in) {
-    bt_event_result_t bt_event;
-
+STATIC mp_obj_t bt_scan_result_to_obj(bt_scan_result_t *result) {
     STATIC const qstr bt_scan_info_fields[] = {
         MP_QSTR_mac, MP_QSTR_addr_type, MP_QSTR_adv_type, MP_QSTR_rssi, MP_QSTR_data,
     };
 
-    if (xQueueReceive(xScanQueue, &bt_event, (TickType_t)0)) {
-        mp_obj_t tuple[5];
-        tuple[0] = mp_obj_new_bytes((const byte *)bt_event.scan.scan_rst.bda, 6);
-        tuple[1] = mp_obj_new_int(bt_event.scan.scan_rst.ble_addr_type);
-        tuple[2] = mp_obj_new_int(bt_event.scan.scan_rst.ble_evt_type & 0x03);    // FIXME
-        tuple[3] = mp_obj_new_int(bt_event.scan.scan_rst.rssi);
-        tuple[4] = mp_obj_new_bytes((const byte *)bt_event.scan.scan_rst.ble_adv, sizeof(bt_event.scan.scan_rst.ble_adv));
+    mp_obj_t tuple[5];
+    tuple[0] = mp_obj_new_bytes((const byte *)result->bda, 6);
+    tuple[1] = mp_obj_new_int(result->addr_type);
+    tuple[2] = mp_obj_new_int(result->adv_type & 0x03);    // FIXME
+    tuple[3] = mp_obj_new_int(result->rssi);
+    tuple[4] = mp_obj_new_bytes((const byte *)result->data, sizeof(result->data));
 
-        return mp_obj_new_attrtuple(bt_scan_info_fields, 5, tuple);
+    return mp_obj_new_attrtuple(bt_scan_info_fields, 5, tuple);
+}
+
+STATIC mp_obj_t bt_read_scan(mp_obj_t self_in) {
+    bt_scan_result_t result;
+
+    if (bt_ring_get(&bt_scan_ring, &result)) {
+        return bt_scan_result_to_obj(&result);
     }
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(bt_read_scan_obj, bt_read_scan);
 
 STATIC mp_obj_t bt_get_advertisements(mp_obj_t self_in) {
-    bt_event_result_t bt_event;
-
-    STATIC const qstr bt_scan_info_fields[] = {
-        MP_QSTR_mac, MP_QSTR_addr_type, MP_QSTR_adv_type, MP_QSTR_rssi, MP_QSTR_data,
-    };
+    bt_scan_result_t result;
 
     mp_obj_t advs = mp_obj_new_list(0, NULL);
-    while (xQueueReceive(xScanQueue, &bt_event, (TickType_t)0)) {
-        mp_obj_t tuple[5];
-        tuple[0] = mp_obj_new_bytes((const byte *)bt_event.scan.scan_rst.bda, 6);
-        tuple[1] = mp_obj_new_int(bt_event.scan.scan_rst.ble_addr_type);
-        tuple[2] = mp_obj_new_int(bt_event.scan.scan_rst.ble_evt_type & 0x03);    // FIXME
-        tuple[3] = mp_obj_new_int(bt_event.scan.scan_rst.rssi);
-        tuple[4] = mp_obj_new_bytes((const byte *)bt_event.scan.scan_rst.ble_adv, sizeof(bt_event.scan.scan_rst.ble_adv));
-
-        mp_obj_list_append(advs, mp_obj_new_attrtuple(bt_scan_info_fields, 5, tuple));
+    while (bt_ring_get(&bt_scan_ring, &result)) {
+        mp_obj_list_append(advs, bt_scan_result_to_obj(&result));
     }
     return advs;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(bt_get_advertisements_obj, bt_get_advertisements);
 
+STATIC mp_obj_t bt_get_advs(mp_uint_t n_args, const mp_obj_t *args) {
+    bt_scan_result_t result;
+    mp_int_t max = (n_args > 1 && args[1] != mp_const_none) ? mp_obj_get_int(args[1]) : bt_scan_ring.size;
+
+    mp_obj_t advs = mp_obj_new_list(0, NULL);
+    while (max-- > 0 && bt_ring_get(&bt_scan_ring, &result)) {
+        mp_obj_list_append(advs, bt_scan_result_to_obj(&result));
+    }
+    return advs;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(bt_get_advs_obj, 1, 2, bt_get_advs);
+
+/// \method scan_filter(*, mac, uuid, manufacturer, rssi, dedup_ms)
+/// Filters the advertisements before they are stored, all the given conditions must be met.
+/// mac is a list of addresses, uuid a 16 bit integer or a 16 byte UUID among the advertised
+/// services, manufacturer a prefix of the manufacturer specific data (company id first) and
+/// rssi the weakest signal accepted. dedup_ms drops the repeated reports of an address with
+/// unchanged data within that window. Called without arguments, all filters are removed.
+STATIC mp_obj_t bt_scan_filter(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_mac,              MP_ARG_KW_ONLY  | MP_ARG_OBJ,   {.u_obj = mp_const_none} },
+        { MP_QSTR_uuid,             MP_ARG_KW_ONLY  | MP_ARG_OBJ,   {.u_obj = mp_const_none} },
+        { MP_QSTR_manufacturer,     MP_ARG_KW_ONLY  | MP_ARG_OBJ,   {.u_obj = mp_const_none} },
+        { MP_QSTR_rssi,             MP_ARG_KW_ONLY  | MP_ARG_INT,   {.u_int = -128} },
+        { MP_QSTR_dedup_ms,         MP_ARG_KW_ONLY  | MP_ARG_INT,   {.u_int = 0} },
+    };
+
+    // parse args
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+
+    bt_scan_filter_t filter;
+    memset(&filter, 0, sizeof(filter));
+    mp_buffer_info_t bufinfo;
+
+    if (args[0].u_obj != mp_const_none) {
+        mp_obj_t *macs;
+        size_t n_macs;
+        mp_obj_get_array(args[0].u_obj, &n_macs, &macs);
+        if (n_macs > BT_SCAN_FILTER_MAC_MAX) {
+            goto invalid_args;
+        }
+        for (int i = 0; i < n_macs; i++) {
+            mp_get_buffer_raise(macs[i], &bufinfo, MP_BUFFER_READ);
+            if (bufinfo.len != ESP_BD_ADDR_LEN) {
+                goto invalid_args;
+            }
+            memcpy(filter.macs[i], bufinfo.buf, ESP_BD_ADDR_LEN);
+        }
+        filter.n_macs = n_macs;
+    }
+
+    if (args[1].u_obj != mp_const_none) {
+        if (MP_OBJ_IS_INT(args[1].u_obj)) {
+            uint16_t uuid = mp_obj_get_int(args[1].u_obj);
+            filter.uuid[0] = uuid & 0xFF;
+            filter.uuid[1] = uuid >> 8;
+            filter.uuid_len = ESP_UUID_LEN_16;
+        } else {
+            mp_get_buffer_raise(args[1].u_obj, &bufinfo, MP_BUFFER_READ);
+            if (bufinfo.len != ESP_UUID_LEN_128) {
+                goto invalid_args;
+            }
+            // given in the usual big endian notation
+            for (int i = 0; i < ESP_UUID_LEN_128; i++) {
+                filter.uuid[i] = ((uint8_t *)bufinfo.buf)[ESP_UUID_LEN_128 - 1 - i];
+            }
+            filter.uuid_len = ESP_UUID_LEN_128;
+        }
+    }
+
+    if (args[2].u_obj != mp_const_none) {
+        mp_get_buffer_raise(args[2].u_obj, &bufinfo, MP_BUFFER_READ);
+        if (bufinfo.len == 0 || bufinfo.len > BT_SCAN_FILTER_PREFIX_MAX) {
+            goto invalid_args;
+        }
+        memcpy(filter.prefix, bufinfo.buf, bufinfo.len);
+        filter.prefix_len = bufinfo.len;
+    }
+
+    filter.rssi = MAX(-128, MIN(127, args[3].u_int));
+    if (args[4].u_int < 0) {
+        goto invalid_args;
+    }
+    filter.dedup_ticks = args[4].u_int / portTICK_PERIOD_MS;
+
+    portENTER_CRITICAL(&bt_scan_ring.mux);
+    memcpy(&bt_scan_filter, &filter, sizeof(filter));
+    memset(bt_scan_seen, 0, sizeof(bt_scan_seen));
+    portEXIT_CRITICAL(&bt_scan_ring.mux);
+
+    return mp_const_none;
+
+invalid_args:
+    nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(bt_scan_filter_obj, 1, bt_scan_filter);
+
+STATIC mp_obj_t bt_scan_dropped(mp_obj_t self_in) {
+    return mp_obj_new_int_from_uint(bt_scan_ring.dropped);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(bt_scan_dropped_obj, bt_scan_dropped);
+
 STATIC mp_obj_t bt_resolve_adv_data(mp_obj_t self_in, mp_obj_t adv_data, mp_obj_t data_type) {
     mp_buffer_info_t bufinfo;
     uint8_t data_len;
@@ -1370,12 +1731,13 @@ STATIC mp_obj_t bt_resolve_adv_data(mp_obj_t self_in, mp_obj_t adv_data, mp_obj_
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_3(bt_resolve_adv_data_obj, bt_resolve_adv_data);
 
-/// \method callback(trigger, handler, arg)
+/// \method callback(trigger, handler, arg, *, priority)
 STATIC mp_obj_t bt_callback(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     STATIC const mp_arg_t allowed_args[] = {
         { MP_QSTR_trigger,      MP_ARG_REQUIRED | MP_ARG_OBJ,   },
         { MP_QSTR_handler,      MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
         { MP_QSTR_arg,          MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
+        { MP_QSTR_priority,     MP_ARG_KW_ONLY | MP_ARG_INT,    {.u_int = MP_IRQ_PRIORITY_NORMAL} },
     };
 
     // parse arguments
@@ -1398,7 +1760,7 @@ STATIC mp_obj_t bt_callback(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t
         INTERRUPT_OBJ_CLEAN(self);
     }
 
-    mp_irq_add(self, args[1].u_obj);
+    mp_irq_add_prio(self, args[1].u_obj, args[3].u_int);
 
     return mp_const_none;
 }
@@ -1494,7 +1856,7 @@ static mp_obj_t bt_connect_helper(mp_obj_t addr, TickType_t timeout, esp_ble_add
 
         // Only drop exception if not called from bt_resume() API, otherwise return with mp_const_none on error
         if(mod_bt_allow_resume_deinit == false) {
-            nlr_raise(mp_obj_new_exception_msg(&mp_type_TimeoutError, "timed out"));
+            mp_raise_prealloc(MP_PREALLOC_EXC_TIMEOUT);
         }
         else {
             return mp_const_none;
@@ -2012,12 +2374,13 @@ STATIC mp_obj_t bt_characteristic_value (mp_uint_t n_args, const mp_obj_t *args)
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(bt_characteristic_value_obj, 1, 2, bt_characteristic_value);
 
-/// \method callback(trigger, handler, arg)
+/// \method callback(trigger, handler, arg, *, priority)
 STATIC mp_obj_t bt_characteristic_callback(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     STATIC const mp_arg_t allowed_args[] = {
         { MP_QSTR_trigger,      MP_ARG_REQUIRED | MP_ARG_OBJ,   },
         { MP_QSTR_handler,      MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
         { MP_QSTR_arg,          MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
+        { MP_QSTR_priority,     MP_ARG_KW_ONLY | MP_ARG_INT,    {.u_int = MP_IRQ_PRIORITY_NORMAL} },
     };
 
     // parse arguments
@@ -2040,7 +2403,7 @@ STATIC mp_obj_t bt_characteristic_callback(mp_uint_t n_args, const mp_obj_t *pos
         INTERRUPT_OBJ_CLEAN(self);
     }
 
-    mp_irq_add(self, args[1].u_obj);
+    mp_irq_add_prio(self, args[1].u_obj, args[3].u_int);
 
     return mp_const_none;
 }
@@ -2061,12 +2424,89 @@ STATIC mp_obj_t bt_characteristic_config(mp_obj_t self_in) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(bt_characteristic_config_obj, bt_characteristic_config);
 
+STATIC bool bt_gatts_wait_uncongested(void) {
+    TickType_t start = xTaskGetTickCount();
+    while (bt_gatts_congested) {
+        if (bt_obj.gatts_conn_id < 0 || (xTaskGetTickCount() - start) > (BT_NOTIFY_CONGEST_TIMEOUT_MS / portTICK_PERIOD_MS)) {
+            return false;
+        }
+        MP_THREAD_GIL_EXIT();
+        vTaskDelay(1);
+        MP_THREAD_GIL_ENTER();
+    }
+    return true;
+}
+
+STATIC bool bt_characteristic_send_chunk(bt_gatts_char_obj_t *self, const uint8_t *data, size_t len) {
+    if (!bt_gatts_wait_uncongested()) {
+        return false;
+    }
+    return ESP_OK == esp_ble_gatts_send_indicate(bt_obj.gatts_if, bt_obj.gatts_conn_id, self->attr_obj.handle, len, (uint8_t *)data, false);
+}
+
+/// \method notify_many(data, *, size)
+/// sends a list of buffers, or a single buffer cut in chunks of size bytes, as back to back notifications
+STATIC mp_obj_t bt_characteristic_notify_many(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_data,         MP_ARG_REQUIRED | MP_ARG_OBJ,   },
+        { MP_QSTR_size,         MP_ARG_KW_ONLY  | MP_ARG_OBJ,   {.u_obj = mp_const_none} },
+    };
+
+    // parse arguments
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+    bt_gatts_char_obj_t *self = pos_args[0];
+
+    if (bt_obj.gatts_conn_id < 0) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_request_not_possible));
+    }
+
+    // a notification carries at most MTU - 3 bytes of value
+    mp_int_t max_len = (bt_obj.gatts_mtu > 3 ? bt_obj.gatts_mtu : 23) - 3;
+    if (max_len > BT_CHAR_VALUE_SIZE_MAX) {
+        max_len = BT_CHAR_VALUE_SIZE_MAX;
+    }
+    if (args[1].u_obj != mp_const_none) {
+        mp_int_t size = mp_obj_get_int(args[1].u_obj);
+        if (size <= 0 || size > max_len) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+        }
+        max_len = size;
+    }
+
+    mp_int_t sent = 0;
+    mp_buffer_info_t bufinfo;
+    if (MP_OBJ_IS_TYPE(args[0].u_obj, &mp_type_list) || MP_OBJ_IS_TYPE(args[0].u_obj, &mp_type_tuple)) {
+        size_t len;
+        mp_obj_t *items;
+        mp_obj_get_array(args[0].u_obj, &len, &items);
+        for (size_t i = 0; i < len; i++) {
+            mp_get_buffer_raise(items[i], &bufinfo, MP_BUFFER_READ);
+            if (!bt_characteristic_send_chunk(self, bufinfo.buf, MIN(bufinfo.len, max_len))) {
+                break;
+            }
+            sent++;
+        }
+    } else {
+        mp_get_buffer_raise(args[0].u_obj, &bufinfo, MP_BUFFER_READ);
+        for (size_t offset = 0; offset < bufinfo.len; offset += max_len) {
+            if (!bt_characteristic_send_chunk(self, (uint8_t *)bufinfo.buf + offset, MIN(bufinfo.len - offset, max_len))) {
+                break;
+            }
+            sent++;
+        }
+    }
+    return mp_obj_new_int(sent);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(bt_characteristic_notify_many_obj, 1, bt_characteristic_notify_many);
+
 STATIC const mp_map_elem_t bt_gatts_char_locals_dict_table[] = {
     // instance methods
     { MP_OBJ_NEW_QSTR(MP_QSTR_value),          (mp_obj_t)&bt_characteristic_value_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_callback),       (mp_obj_t)&bt_characteristic_callback_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_events),         (mp_obj_t)&bt_characteristic_events_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_config),         (mp_obj_t)&bt_characteristic_config_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_notify_many),    (mp_obj_t)&bt_characteristic_notify_many_obj },
 };
 STATIC MP_DEFINE_CONST_DICT(bt_gatts_char_locals_dict, bt_gatts_char_locals_dict_table);
 
@@ -2144,6 +2584,92 @@ STATIC mp_obj_t bt_tx_power(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(bt_tx_power_obj, 2, bt_tx_power);
 
+STATIC void bt_set_conn_params(esp_bd_addr_t bda, mp_arg_val_t *args) {
+    if (args[0].u_obj != mp_const_none || args[1].u_obj != mp_const_none) {
+        esp_ble_conn_update_params_t params;
+        memcpy(params.bda, bda, ESP_BD_ADDR_LEN);
+        // intervals are given in microseconds and the supervision timeout in milliseconds
+        mp_int_t min_int = args[0].u_obj != mp_const_none ? mp_obj_get_int(args[0].u_obj) : mp_obj_get_int(args[1].u_obj);
+        mp_int_t max_int = args[1].u_obj != mp_const_none ? mp_obj_get_int(args[1].u_obj) : min_int;
+        params.min_int = min_int / BT_CONN_INTERVAL_UNIT_US;
+        params.max_int = max_int / BT_CONN_INTERVAL_UNIT_US;
+        params.latency = args[2].u_int;
+        params.timeout = args[3].u_int / BT_CONN_TIMEOUT_UNIT_MS;
+        // 7.5ms to 4s, as per the core spec
+        if (params.min_int < 6 || params.max_int > 3200 || params.min_int > params.max_int ||
+            params.latency > 499 || params.timeout < 10 || params.timeout > 3200) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+        }
+        if (ESP_OK != esp_ble_gap_update_conn_params(&params)) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_operation_failed));
+        }
+    }
+    if (args[4].u_obj != mp_const_none) {
+        // data length extension, 27 to 251 bytes per link layer packet
+        mp_int_t data_len = mp_obj_get_int(args[4].u_obj);
+        if (data_len < 27 || data_len > 251) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+        }
+        if (ESP_OK != esp_ble_gap_set_pkt_data_len(bda, data_len)) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_operation_failed));
+        }
+    }
+}
+
+STATIC const mp_arg_t bt_conn_params_args[] = {
+    { MP_QSTR_min_interval,     MP_ARG_KW_ONLY  | MP_ARG_OBJ,   {.u_obj = mp_const_none} },
+    { MP_QSTR_max_interval,     MP_ARG_KW_ONLY  | MP_ARG_OBJ,   {.u_obj = mp_const_none} },
+    { MP_QSTR_latency,          MP_ARG_KW_ONLY  | MP_ARG_INT,   {.u_int = 0} },
+    { MP_QSTR_timeout,          MP_ARG_KW_ONLY  | MP_ARG_INT,   {.u_int = 4000} },
+    { MP_QSTR_data_len,         MP_ARG_KW_ONLY  | MP_ARG_OBJ,   {.u_obj = mp_const_none} },
+};
+
+/// \method conn_params(*, min_interval, max_interval, latency, timeout, data_len)
+STATIC mp_obj_t bt_conn_conn_params(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    mp_arg_val_t args[MP_ARRAY_SIZE(bt_conn_params_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), bt_conn_params_args, args);
+    bt_connection_obj_t *self = pos_args[0];
+
+    if (self->conn_id < 0) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "connection already closed"));
+    }
+    bt_set_conn_params(self->srv_bda, args);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(bt_conn_conn_params_obj, 1, bt_conn_conn_params);
+
+/// \method exchange_mtu(mtu)
+STATIC mp_obj_t bt_conn_exchange_mtu(mp_obj_t self_in, mp_obj_t mtu_in) {
+    bt_connection_obj_t *self = self_in;
+    mp_int_t mtu = mp_obj_get_int(mtu_in);
+
+    if (self->conn_id < 0) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "connection already closed"));
+    }
+    if (mtu < 23) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+    // the characteristic values can't grow beyond this anyway
+    mtu = MIN(mtu, BT_MTU_SIZE_MAX);
+
+    xEventGroupClearBits(bt_event_group, MOD_BT_GATTC_MTU_EVT);
+    esp_ble_gatt_set_local_mtu(mtu);
+    mod_bt_gatts_mtu_restore = mtu;
+    if (ESP_OK != esp_ble_gattc_send_mtu_req(self->gatt_if, self->conn_id)) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_operation_failed));
+    }
+
+    MP_THREAD_GIL_EXIT();
+    EventBits_t uxBits = xEventGroupWaitBits(bt_event_group, MOD_BT_GATTC_MTU_EVT, true, true, 1000/portTICK_PERIOD_MS);
+    MP_THREAD_GIL_ENTER();
+
+    if (uxBits & MOD_BT_GATTC_MTU_EVT) {
+        self->mtu = bt_conn_mtu;
+    }
+    return mp_obj_new_int(self->mtu);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(bt_conn_exchange_mtu_obj, bt_conn_exchange_mtu);
+
 STATIC mp_obj_t bt_conn_get_mtu(mp_obj_t self_in) {
 
     bt_connection_obj_t * self =  (bt_connection_obj_t *)self_in;
@@ -2175,6 +2701,20 @@ STATIC mp_obj_t bt_gatts_get_mtu(mp_obj_t self_in) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(bt_gatts_get_mtu_obj, bt_gatts_get_mtu);
 
+/// \method conn_params(*, min_interval, max_interval, latency, timeout, data_len)
+/// tunes the link to the client connected to our GATT server
+STATIC mp_obj_t bt_gatts_conn_params(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    mp_arg_val_t args[MP_ARRAY_SIZE(bt_conn_params_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), bt_conn_params_args, args);
+
+    if (bt_obj.gatts_conn_id < 0) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_request_not_possible));
+    }
+    bt_set_conn_params(bt_obj.client_bda, args);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(bt_gatts_conn_params_obj, 1, bt_gatts_conn_params);
+
 STATIC const mp_map_elem_t bt_locals_dict_table[] = {
     // instance methods
     { MP_OBJ_NEW_QSTR(MP_QSTR_init),                    (mp_obj_t)&bt_init_obj },
@@ -2184,6 +2724,9 @@ STATIC const mp_map_elem_t bt_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_stop_scan),               (mp_obj_t)&bt_stop_scan_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_get_adv),                 (mp_obj_t)&bt_read_scan_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_get_advertisements),      (mp_obj_t)&bt_get_advertisements_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_get_advs),                (mp_obj_t)&bt_get_advs_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_scan_filter),             (mp_obj_t)&bt_scan_filter_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_scan_dropped),            (mp_obj_t)&bt_scan_dropped_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_resolve_adv_data),        (mp_obj_t)&bt_resolve_adv_data_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_connect),                 (mp_obj_t)&bt_connect_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_set_advertisement_params),(mp_obj_t)&bt_set_advertisement_params_obj },
@@ -2198,6 +2741,7 @@ STATIC const mp_map_elem_t bt_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_modem_sleep),             (mp_obj_t)&bt_modem_sleep_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_tx_power),                (mp_obj_t)&bt_tx_power_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_gatts_mtu),               (mp_obj_t)&bt_gatts_get_mtu_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_conn_params),             (mp_obj_t)&bt_gatts_conn_params_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_nvram_erase),             (mp_obj_t)&bt_nvram_erase_obj },
 
 
@@ -2383,6 +2927,8 @@ STATIC const mp_map_elem_t bt_connection_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_disconnect),              (mp_obj_t)&bt_conn_disconnect_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_services),                (mp_obj_t)&bt_conn_services_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_get_mtu),                 (mp_obj_t)&bt_conn_get_mtu_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_exchange_mtu),            (mp_obj_t)&bt_conn_exchange_mtu_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_conn_params),             (mp_obj_t)&bt_conn_conn_params_obj },
 
 };
 STATIC MP_DEFINE_CONST_DICT(bt_connection_locals_dict, bt_connection_locals_dict_table);
@@ -2622,12 +3168,13 @@ error:
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_2(bt_char_write_obj, bt_char_write);
 
-/// \method callback(trigger, handler, arg)
+/// \method callback(trigger, handler, arg, *, priority)
 STATIC mp_obj_t bt_char_callback(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     STATIC const mp_arg_t allowed_args[] = {
         { MP_QSTR_trigger,      MP_ARG_REQUIRED | MP_ARG_OBJ,   },
         { MP_QSTR_handler,      MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
         { MP_QSTR_arg,          MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
+        { MP_QSTR_priority,     MP_ARG_KW_ONLY | MP_ARG_INT,    {.u_int = MP_IRQ_PRIORITY_NORMAL} },
     };
 
     // parse arguments
@@ -2710,7 +3257,7 @@ STATIC mp_obj_t bt_char_callback(mp_uint_t n_args, const mp_obj_t *pos_args, mp_
         INTERRUPT_OBJ_CLEAN(self);
     }
 
-    mp_irq_add(self, args[1].u_obj);
+    mp_irq_add_prio(self, args[1].u_obj, args[3].u_int);
 
     return mp_const_none;
 
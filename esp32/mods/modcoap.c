@@ -11,6 +11,7 @@
 #include "py/mpconfig.h"
 #include "py/obj.h"
 #include "py/runtime.h"
+#include "py/stream.h"
 
 #include "coap.h"
 #include "coap_list.h"
@@ -20,7 +21,13 @@
 #include "modusocket.h"
 #include "lwipsocket.h"
 #include "netutils.h"
+#include "mpirq.h"
+#include "pycom_config.h"
 
+#include "lwip/sockets.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "freertos/semphr.h"
 
 
@@ -35,17 +42,27 @@
 #define MODCOAP_REQUEST_POST    (0x04)
 #define MODCOAP_REQUEST_DELETE  (0x08)
 
+#define MODCOAP_RESOURCE_BUCKETS    (16)    // must be a power of 2
+#define MODCOAP_BLOCK_SZX           (5)     // 512 bytes, RFC 7959 block size exponent
+#define MODCOAP_BLOCK_SIZE          (1 << (MODCOAP_BLOCK_SZX + 4))
+#define MODCOAP_OBSERVE_DEREGISTER  (1)
+
+#define MODCOAP_TASK_STACK_SIZE     (3072)
+#define MODCOAP_TASK_PRIORITY       (5)
+#define MODCOAP_TASK_RETRY_MS       (100)
+
 /******************************************************************************
  DEFINE PRIVATE TYPES
  ******************************************************************************/
 typedef struct mod_coap_resource_obj_s {
     mp_obj_base_t base;
     coap_resource_t* coap_resource;
-    struct mod_coap_resource_obj_s* next;
+    struct mod_coap_resource_obj_s* next;   // next resource in the same hash bucket
+    mp_obj_t value_obj;                     // bytes, str or stream object the value is served from without a copy
     uint8_t* value;
+    uint32_t value_len;
     uint32_t max_age;
     uint16_t etag_value;
-    uint16_t value_len;
     uint8_t mediatype;
     bool etag;
 }mod_coap_resource_obj_t;
@@ -54,8 +71,9 @@ typedef struct mod_coap_obj_s {
     mp_obj_base_t base;
     coap_context_t* context;
     mod_network_socket_obj_t* socket;
-    mod_coap_resource_obj_t* resources;
+    mod_coap_resource_obj_t* resources[MODCOAP_RESOURCE_BUCKETS];
     SemaphoreHandle_t semphr;
+    TaskHandle_t task;
     mp_obj_t callback;
     coap_list_t *optlist;
 }mod_coap_obj_t;
@@ -67,10 +85,16 @@ typedef struct mod_coap_obj_s {
  ******************************************************************************/
 STATIC mod_coap_resource_obj_t* find_resource(coap_resource_t* resource);
 STATIC mod_coap_resource_obj_t* find_resource_by_key(coap_key_t key);
-STATIC mod_coap_resource_obj_t* add_resource(const char* uri, uint8_t mediatype, uint8_t max_age, mp_obj_t value, bool etag);
+STATIC mod_coap_resource_obj_t** resource_bucket(const coap_key_t key);
+STATIC mod_coap_resource_obj_t* add_resource(const char* uri, uint8_t mediatype, uint8_t max_age, mp_obj_t value, bool etag, bool observable);
 STATIC void remove_resource_by_key(coap_key_t key);
 STATIC void remove_resource(const char* uri);
+STATIC void resource_free_value(mod_coap_resource_obj_t* resource);
 STATIC void resource_update_value(mod_coap_resource_obj_t* resource, mp_obj_t new_value);
+STATIC bool resource_value_size(mod_coap_resource_obj_t* resource, uint32_t* size);
+STATIC const uint8_t* resource_value_slice(mod_coap_resource_obj_t* resource, uint32_t offset, uint32_t len, uint8_t* buf);
+STATIC void modcoap_serve(void* arg);
+STATIC void TASK_CoAP(void *pvParameters);
 
 STATIC void coap_resource_callback_get(coap_context_t * context,
                                        struct coap_resource_t * resource,
@@ -138,16 +162,22 @@ STATIC bool initialized = false;
 /******************************************************************************
  DEFINE PRIVATE FUNCTIONS
  ******************************************************************************/
+// Get the head of the hash bucket the key belongs to
+STATIC mod_coap_resource_obj_t** resource_bucket(const coap_key_t key) {
+
+    // The key is already a hash of the Uri, folding its bytes is enough to spread the resources
+    uint32_t index = key[0] ^ key[1] ^ key[2] ^ key[3];
+    return &coap_obj_ptr->resources[index & (MODCOAP_RESOURCE_BUCKETS - 1)];
+}
+
 // Get the resource if exists
 STATIC mod_coap_resource_obj_t* find_resource(coap_resource_t* resource) {
 
-    if(coap_obj_ptr->resources != NULL) {
-        mod_coap_resource_obj_t* current = coap_obj_ptr->resources;
-        for(; current != NULL; current = current->next) {
-            // The hash key is generated from Uri
-            if(memcmp(current->coap_resource->key, resource->key, sizeof(current->coap_resource->key)) == 0) {
-                return current;
-            }
+    mod_coap_resource_obj_t* current = *resource_bucket(resource->key);
+    for(; current != NULL; current = current->next) {
+        // The hash key is generated from Uri
+        if(memcmp(current->coap_resource->key, resource->key, sizeof(current->coap_resource->key)) == 0) {
+            return current;
         }
     }
     return NULL;
@@ -156,13 +186,11 @@ STATIC mod_coap_resource_obj_t* find_resource(coap_resource_t* resource) {
 // Get the resource if exists by its key
 STATIC mod_coap_resource_obj_t* find_resource_by_key(coap_key_t key) {
 
-    if(coap_obj_ptr->resources != NULL) {
-        mod_coap_resource_obj_t* current = coap_obj_ptr->resources;
-        for(; current != NULL; current = current->next) {
-            // The hash key is generated from Uri
-            if(memcmp(current->coap_resource->key, key, sizeof(current->coap_resource->key)) == 0) {
-                return current;
-            }
+    mod_coap_resource_obj_t* current = *resource_bucket(key);
+    for(; current != NULL; current = current->next) {
+        // The hash key is generated from Uri
+        if(memcmp(current->coap_resource->key, key, sizeof(current->coap_resource->key)) == 0) {
+            return current;
         }
     }
     return mp_const_none;
@@ -170,7 +198,7 @@ STATIC mod_coap_resource_obj_t* find_resource_by_key(coap_key_t key) {
 
 
 // Create a new resource in the scope of the only context
-STATIC mod_coap_resource_obj_t* add_resource(const char* uri, uint8_t mediatype, uint8_t max_age, mp_obj_t value, bool etag) {
+STATIC mod_coap_resource_obj_t* add_resource(const char* uri, uint8_t mediatype, uint8_t max_age, mp_obj_t value, bool etag, bool observable) {
 
     // Currently only 1 context is supported
     mod_coap_obj_t* context = coap_obj_ptr;
@@ -178,16 +206,13 @@ STATIC mod_coap_resource_obj_t* add_resource(const char* uri, uint8_t mediatype,
     coap_key_t key;
     (void)coap_hash_path((const unsigned char*)uri, strlen(uri), key);
 
-    // Check if there is at least 1 resource
-    if(context->resources != NULL) {
-        mod_coap_resource_obj_t* current = context->resources;
-        // Iterate through the resources and check whether the new one exists
-        for(; current != NULL; current = current->next) {
-            // The hash key is generated from Uri
-            if(memcmp(key, current->coap_resource->key, sizeof(key)) == 0) {
-                // Resource already exists
-                return NULL;
-            }
+    mod_coap_resource_obj_t** bucket = resource_bucket(key);
+    // Iterate through the resources with the same hash and check whether the new one exists
+    for(mod_coap_resource_obj_t* current = *bucket; current != NULL; current = current->next) {
+        // The hash key is generated from Uri
+        if(memcmp(key, current->coap_resource->key, sizeof(key)) == 0) {
+            // Resource already exists
+            return NULL;
         }
     }
 
@@ -202,6 +227,10 @@ STATIC mod_coap_resource_obj_t* add_resource(const char* uri, uint8_t mediatype,
     // Get ETAG
     resource->etag = etag; // by default it is false
     resource->etag_value = 0; // start with 0, resource_update_value() will update it (0 is incorrect for E-Tag value)
+    // No value yet
+    resource->value_obj = MP_OBJ_NULL;
+    resource->value = NULL;
+    resource->value_len = 0;
 
     // No next elem
     resource->next = NULL;
@@ -212,6 +241,8 @@ STATIC mod_coap_resource_obj_t* add_resource(const char* uri, uint8_t mediatype,
     // Pass COAP_RESOURCE_FLAGS_RELEASE_URI so Coap Library will free up the memory allocated to store the URI when the Resource is deleted
     resource->coap_resource = coap_resource_init(uri_ptr, strlen(uri), COAP_RESOURCE_FLAGS_RELEASE_URI);
     if(resource->coap_resource != NULL) {
+        // Observers are registered in coap_resource_callback_get() and notified when the value changes
+        resource->coap_resource->observable = observable ? 1 : 0;
         // Add the resource to the Coap context
         coap_add_resource(context->context, resource->coap_resource);
 
@@ -223,17 +254,8 @@ STATIC mod_coap_resource_obj_t* add_resource(const char* uri, uint8_t mediatype,
         resource_update_value(resource, value);
 
         // Add the resource to our context
-        if(context->resources == NULL) {
-            // No resource exists, add as first element
-            context->resources = resource;
-        }
-        else {
-            mod_coap_resource_obj_t* current = context->resources;
-            // Find the last resource
-            for(; current->next != NULL; current = current->next) {}
-            // Append the new resource to the end of the list
-            current->next = resource;
-        }
+        resource->next = *bucket;
+        *bucket = resource;
 
         return resource;
     }
@@ -254,42 +276,24 @@ STATIC void remove_resource_by_key(coap_key_t key) {
     // Currently only 1 context is supported
     mod_coap_obj_t* context = coap_obj_ptr;
 
-    if(context->resources != NULL) {
-        mod_coap_resource_obj_t* current = context->resources;
-        mod_coap_resource_obj_t* previous = context->resources;
-        for(; current != NULL; current = current->next) {
-
-            // The hash key is generated from Uri
-            if(memcmp(current->coap_resource->key, key, sizeof(coap_key_t)) == 0) {
-                // Resource found, remove from the list
-                // Check if it is the first element in the list
-                if(context->resources == current) {
-                    // If no more element in the list then invalidate the list
-                    if(current->next == NULL) {
-                        context->resources = NULL;
-                    }
-                    // Other elements are in the list
-                    else {
-                        context->resources = current->next;
-                    }
-                }
-                else {
-                    // It is not the first element
-                    previous->next = current->next;
-                }
+    // Walk the bucket through the link pointing to the current element, so it can be unlinked in place
+    mod_coap_resource_obj_t** link = resource_bucket(key);
+    for(; *link != NULL; link = &(*link)->next) {
+        mod_coap_resource_obj_t* current = *link;
 
-                // Free the resource in coap's scope
-                coap_delete_resource(context->context, key);
-                // Free the element in MP scope
-                free(current->value);
-                // Free the resource itself
-                m_del_obj(mod_coap_resource_obj_t, current);
+        // The hash key is generated from Uri
+        if(memcmp(current->coap_resource->key, key, sizeof(coap_key_t)) == 0) {
+            // Resource found, remove from the list
+            *link = current->next;
 
-                return;
-            }
+            // Free the resource in coap's scope, this drops its observers too
+            coap_delete_resource(context->context, key);
+            // Free the element in MP scope
+            resource_free_value(current);
+            // Free the resource itself
+            m_del_obj(mod_coap_resource_obj_t, current);
 
-            // Mark the current element as previous, needed when removing the actual current element from the list
-            previous = current;
+            return;
         }
     }
 }
@@ -304,6 +308,17 @@ STATIC void remove_resource(const char* uri) {
     remove_resource_by_key(key);
 }
 
+// Release the value of a resource, only copies are owned by the resource
+STATIC void resource_free_value(mod_coap_resource_obj_t* resource) {
+
+    if(resource->value_obj == MP_OBJ_NULL) {
+        free(resource->value);
+    }
+    resource->value_obj = MP_OBJ_NULL;
+    resource->value = NULL;
+    resource->value_len = 0;
+}
+
 // Update the value of a resource
 STATIC void resource_update_value(mod_coap_resource_obj_t* resource, mp_obj_t new_value) {
 
@@ -317,8 +332,10 @@ STATIC void resource_update_value(mod_coap_resource_obj_t* resource, mp_obj_t ne
     }
 
     // Invalidate current data first
-    resource->value_len = 0;
-    free(resource->value);
+    resource_free_value(resource);
+
+    // Let the observers know at the next coap_check_notify()
+    resource->coap_resource->dirty = 1;
 
     if (mp_obj_is_integer(new_value)) {
 
@@ -332,19 +349,71 @@ STATIC void resource_update_value(mod_coap_resource_obj_t* resource, mp_obj_t ne
         }
 
         // Allocate memory for the new data
-        resource->value = malloc(resource->value_len);
+        resource->value = malloc(sizeof(value));
         memcpy(resource->value, &value, sizeof(value));
 
-    } else {
+    } else if (MP_OBJ_IS_STR_OR_BYTES(new_value)) {
 
+        // Immutable objects are served straight from their own buffer, keeping a reference makes sure the GC won't collect them
         mp_buffer_info_t value_bufinfo;
         mp_get_buffer_raise(new_value, &value_bufinfo, MP_BUFFER_READ);
+        resource->value_obj = new_value;
+        resource->value = value_bufinfo.buf;
         resource->value_len = value_bufinfo.len;
 
-        // Allocate memory for the new data
-        resource->value = malloc(resource->value_len);
-        memcpy(resource->value, value_bufinfo.buf, resource->value_len);
+    } else {
+
+        mp_buffer_info_t value_bufinfo;
+        if (mp_get_buffer(new_value, &value_bufinfo, MP_BUFFER_READ)) {
+            resource->value_len = value_bufinfo.len;
+
+            // Mutable buffers can change under our feet, allocate memory for the new data
+            resource->value = malloc(resource->value_len);
+            memcpy(resource->value, value_bufinfo.buf, resource->value_len);
+        } else {
+            // A file or any other seekable stream, read block by block when requested
+            mp_get_stream_raise(new_value, MP_STREAM_OP_READ | MP_STREAM_OP_IOCTL);
+            resource->value_obj = new_value;
+        }
+    }
+}
+
+// Get the size of the value of a resource, returns false if a stream based value cannot be read
+STATIC bool resource_value_size(mod_coap_resource_obj_t* resource, uint32_t* size) {
+
+    if(resource->value != NULL || resource->value_obj == MP_OBJ_NULL) {
+        *size = resource->value_len;
+        return true;
+    }
+
+    const mp_stream_p_t *stream_p = mp_get_stream(resource->value_obj);
+    struct mp_stream_seek_t seek_s = { .offset = 0, .whence = SEEK_END };
+    int errcode;
+    if(stream_p->ioctl(resource->value_obj, MP_STREAM_SEEK, (mp_uint_t)(uintptr_t)&seek_s, &errcode) == MP_STREAM_ERROR) {
+        return false;
+    }
+    *size = seek_s.offset;
+    return true;
+}
+
+// Get a slice of the value of a resource, buffers are returned in place and streams are read into buf
+STATIC const uint8_t* resource_value_slice(mod_coap_resource_obj_t* resource, uint32_t offset, uint32_t len, uint8_t* buf) {
+
+    if(resource->value != NULL || resource->value_obj == MP_OBJ_NULL) {
+        return resource->value + offset;
     }
+
+    const mp_stream_p_t *stream_p = mp_get_stream(resource->value_obj);
+    struct mp_stream_seek_t seek_s = { .offset = offset, .whence = SEEK_SET };
+    int errcode;
+    if(stream_p->ioctl(resource->value_obj, MP_STREAM_SEEK, (mp_uint_t)(uintptr_t)&seek_s, &errcode) == MP_STREAM_ERROR) {
+        return NULL;
+    }
+    // This runs inside the Coap library, so the stream is read without raising
+    if(mp_stream_rw(resource->value_obj, buf, len, &errcode, MP_STREAM_RW_READ) != len) {
+        return NULL;
+    }
+    return buf;
 }
 
 
@@ -363,8 +432,11 @@ STATIC void coap_resource_callback_get(coap_context_t * context,
     // Check if the resource exists. (e.g.: has not been removed in the background before we got the semaphore in mod_coap_read())
     if(resource_obj != NULL) {
 
+        // The request is NULL when the Coap library composes a notification for an observer
+        bool observe = (request == NULL);
+
         // Check if media type of the resource is given
-        if(resource_obj->mediatype != -1) {
+        if(request != NULL && resource_obj->mediatype != -1) {
             coap_opt_iterator_t opt_it;
             // Need to check if ACCEPT option is specified and we can serve it
             coap_opt_t *opt = coap_check_option(request, COAP_OPTION_ACCEPT, &opt_it);
@@ -392,7 +464,7 @@ STATIC void coap_resource_callback_get(coap_context_t * context,
         response->hdr->code = COAP_RESPONSE_CODE(205);
 
         // Check if ETAG value is maintained for the resource
-        if(resource_obj->etag == true) {
+        if(request != NULL && resource_obj->etag == true) {
 
             coap_opt_iterator_t opt_it;
             // Need to check if E-TAG option is specified and we can serve it
@@ -415,13 +487,51 @@ STATIC void coap_resource_callback_get(coap_context_t * context,
             }
         }
 
-        // Add the options if configured
+        // Register or deregister the requester as an observer (RFC 7641)
+        if(request != NULL && resource->observable) {
+            coap_opt_iterator_t opt_it;
+            coap_opt_t *opt = coap_check_option(request, COAP_OPTION_OBSERVE, &opt_it);
+            if(opt != NULL) {
+                if(coap_decode_var_bytes(coap_opt_value(opt), coap_opt_length(opt)) == MODCOAP_OBSERVE_DEREGISTER) {
+                    coap_delete_observer(resource, address, token);
+                }
+                else if(coap_add_observer(resource, endpoint, address, token) != NULL) {
+                    observe = true;
+                }
+            }
+        }
+
+        // Find out whether the value has to be sent block-wise (RFC 7959)
+        uint32_t value_size;
+        if(!resource_value_size(resource_obj, &value_size)) {
+            // 5.00 Internal Server error occurred
+            response->hdr->code = COAP_RESPONSE_CODE(500);
+            const char* error_message = coap_response_phrase(response->hdr->code);
+            coap_add_data(response, strlen(error_message), (unsigned char *)error_message);
+            return;
+        }
+
+        coap_block_t block = { .num = 0, .m = 0, .szx = MODCOAP_BLOCK_SZX };
+        bool blockwise = (value_size > MODCOAP_BLOCK_SIZE);
+        if(request != NULL && coap_get_block(request, COAP_OPTION_BLOCK2, &block)) {
+            // Serve the block size asked by the client if smaller than ours
+            if(block.szx > MODCOAP_BLOCK_SZX) {
+                block.szx = MODCOAP_BLOCK_SZX;
+            }
+            blockwise = true;
+        }
+
+        // Add the options if configured, they must be added in the order of their numbers
         unsigned char buf[3];
 
         if(resource_obj->etag == true) {
             coap_add_option(response, COAP_OPTION_ETAG, coap_encode_var_bytes(buf, resource_obj->etag_value), buf);
         }
 
+        if(observe == true) {
+            coap_add_option(response, COAP_OPTION_OBSERVE, coap_encode_var_bytes(buf, context->observe), buf);
+        }
+
         if(resource_obj->mediatype != -1) {
             coap_add_option(response, COAP_OPTION_CONTENT_TYPE, coap_encode_var_bytes(buf, resource_obj->mediatype), buf);
         }
@@ -432,7 +542,31 @@ STATIC void coap_resource_callback_get(coap_context_t * context,
 
         // Add the data itself if updated
         if(response->hdr->code == COAP_RESPONSE_CODE(205)) {
-            coap_add_data(response, resource_obj->value_len, (unsigned char *)resource_obj->value);
+            uint32_t offset = 0;
+            uint32_t length = value_size;
+
+            if(blockwise == true) {
+                // Adds the Block2 option, the block size might be reduced to fit in the response
+                if(coap_write_block_opt(&block, COAP_OPTION_BLOCK2, response, value_size) < 0) {
+                    // 4.02 Bad Option: the requested block is beyond the end of the value
+                    response->hdr->code = COAP_RESPONSE_CODE(402);
+                    return;
+                }
+                offset = block.num << (block.szx + 4);
+                length = MIN(value_size - offset, 1 << (block.szx + 4));
+            }
+
+            if(length > 0) {
+                // Buffers are added straight from the resource, streams larger than a block are always sent block-wise
+                uint8_t block_buf[MODCOAP_BLOCK_SIZE];
+                const uint8_t* data = resource_value_slice(resource_obj, offset, length, block_buf);
+                if(data == NULL) {
+                    // 5.00 Internal Server error occurred
+                    response->hdr->code = COAP_RESPONSE_CODE(500);
+                    return;
+                }
+                coap_add_data(response, length, (unsigned char *)data);
+            }
         }
     }
     else {
@@ -758,6 +892,53 @@ STATIC coap_list_t * modcoap_new_option_node(unsigned short key, unsigned int le
     return node;
 }
 
+// Handle the pending requests and send out the notifications of the changed resources
+STATIC void modcoap_serve(void* arg) {
+
+    nlr_buf_t nlr;
+
+    // Take the context's semaphore to avoid concurrent access, this will guard the handler functions too
+    xSemaphoreTake(coap_obj_ptr->semphr, portMAX_DELAY);
+    // The response handler calls into Python, which might raise
+    bool raised = (nlr_push(&nlr) != 0);
+    if(!raised) {
+        coap_read(coap_obj_ptr->context);
+        coap_check_notify(coap_obj_ptr->context);
+        nlr_pop();
+    }
+    xSemaphoreGive(coap_obj_ptr->semphr);
+
+    // Let the background task watch the socket again
+    if(arg != NULL) {
+        xTaskNotifyGive((TaskHandle_t)arg);
+    }
+
+    if(raised) {
+        nlr_jump(nlr.ret_val);
+    }
+}
+
+// Wait for requests and have them served in the context of the interpreter, as the handlers create MicroPython objects
+STATIC void TASK_CoAP(void *pvParameters) {
+
+    int sd = coap_obj_ptr->context->sockfd;
+
+    for (;;) {
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(sd, &rfds);
+
+        if(lwip_select(sd + 1, &rfds, NULL, NULL, NULL) > 0) {
+            mp_irq_queue_interrupt_non_ISR(modcoap_serve, (void *)xTaskGetCurrentTaskHandle());
+            // Only one serve request is queued at a time
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+        else {
+            vTaskDelay(MODCOAP_TASK_RETRY_MS / portTICK_PERIOD_MS);
+        }
+    }
+}
+
 /******************************************************************************
  DEFINE COAP RESOURCE CLASS FUNCTIONS
  ******************************************************************************/
@@ -794,13 +975,20 @@ STATIC mp_obj_t mod_coap_resource_value(mp_uint_t n_args, const mp_obj_t *args)
 
     xSemaphoreTake(coap_obj_ptr->semphr, portMAX_DELAY);
     // If the value exists, e.g.: not deleted from another task before we got the semaphore
-    if(self->value != NULL) {
+    if(self->value != NULL || self->value_obj != MP_OBJ_NULL) {
         if (n_args == 1) {
             // get
-            ret = mp_obj_new_bytes(self->value, self->value_len);
+            if(self->value == NULL) {
+                // Stream based value
+                ret = self->value_obj;
+            } else {
+                ret = mp_obj_new_bytes(self->value, self->value_len);
+            }
         } else {
             // set
             resource_update_value(self, (mp_obj_t)args[1]);
+            // Push the new value to the observers straight away
+            coap_check_notify(coap_obj_ptr->context);
         }
     }
     xSemaphoreGive(coap_obj_ptr->semphr);
@@ -923,6 +1111,7 @@ STATIC const mp_arg_t mod_coap_init_args[] = {
         { MP_QSTR_address,                  MP_ARG_OBJ  | MP_ARG_REQUIRED, },
         { MP_QSTR_port,                     MP_ARG_OBJ  | MP_ARG_KW_ONLY, {.u_int = MODCOAP_DEFAULT_PORT}},
         { MP_QSTR_service_discovery,        MP_ARG_BOOL | MP_ARG_KW_ONLY, {.u_bool = false}},
+        { MP_QSTR_background,               MP_ARG_BOOL | MP_ARG_KW_ONLY, {.u_bool = false}},
 };
 
 // Initialize the module
@@ -935,9 +1124,12 @@ STATIC mp_obj_t mod_coap_init(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map
         MP_STATE_PORT(coap_ptr) = m_new_obj(mod_coap_obj_t);
         coap_obj_ptr = MP_STATE_PORT(coap_ptr);
         coap_obj_ptr->context = NULL;
-        coap_obj_ptr->resources = NULL;
+        for(int i = 0; i < MODCOAP_RESOURCE_BUCKETS; i++) {
+            coap_obj_ptr->resources[i] = NULL;
+        }
         coap_obj_ptr->socket = NULL;
         coap_obj_ptr->semphr = NULL;
+        coap_obj_ptr->task = NULL;
 
         mp_arg_val_t args[MP_ARRAY_SIZE(mod_coap_init_args)];
         mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(args), mod_coap_init_args, args);
@@ -955,6 +1147,11 @@ STATIC mp_obj_t mod_coap_init(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map
         coap_obj_ptr->semphr = xSemaphoreCreateBinary();
         xSemaphoreGive(coap_obj_ptr->semphr);
 
+        // Serve the requests as they arrive instead of waiting for coap.read() to be called
+        if(args[3].u_bool == true) {
+            xTaskCreatePinnedToCore(TASK_CoAP, "CoAP", MODCOAP_TASK_STACK_SIZE / sizeof(StackType_t), NULL, MODCOAP_TASK_PRIORITY, &coap_obj_ptr->task, config_get_service_core());
+        }
+
         initialized = true;
     }
     else {
@@ -988,6 +1185,7 @@ STATIC const mp_arg_t mod_coap_add_resource_args[] = {
         { MP_QSTR_max_age,                  MP_ARG_KW_ONLY  | MP_ARG_INT, {.u_int = -1}},
         { MP_QSTR_value,                    MP_ARG_KW_ONLY  | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL}},
         { MP_QSTR_etag,                     MP_ARG_KW_ONLY  | MP_ARG_BOOL,{.u_bool = false}},
+        { MP_QSTR_observable,               MP_ARG_KW_ONLY  | MP_ARG_BOOL,{.u_bool = false}},
 };
 
 // Add a new resource to the context if not exists
@@ -1001,7 +1199,7 @@ STATIC mp_obj_t mod_coap_add_resource(mp_uint_t n_args, const mp_obj_t *pos_args
         mp_arg_val_t args[MP_ARRAY_SIZE(mod_coap_add_resource_args)];
         mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(args), mod_coap_add_resource_args, args);
 
-        mod_coap_resource_obj_t* res = add_resource(mp_obj_str_get_str(args[0].u_obj), args[1].u_int, args[2].u_int, args[3].u_obj, args[4].u_bool);
+        mod_coap_resource_obj_t* res = add_resource(mp_obj_str_get_str(args[0].u_obj), args[1].u_int, args[2].u_int, args[3].u_obj, args[4].u_bool, args[5].u_bool);
 
         xSemaphoreGive(coap_obj_ptr->semphr);
 
@@ -1066,10 +1264,7 @@ STATIC mp_obj_t mod_coap_read(void) {
 
     // The Coap module should have been already initialized
     if(initialized == true) {
-        // Take the context's semaphore to avoid concurrent access, this will guard the handler functions too
-        xSemaphoreTake(coap_obj_ptr->semphr, portMAX_DELAY);
-        coap_read(coap_obj_ptr->context);
-        xSemaphoreGive(coap_obj_ptr->semphr);
+        modcoap_serve(NULL);
     }
     else {
         nlr_raise(mp_obj_new_exception_msg(&mp_type_RuntimeError, "Coap module has not been initialized!"));
@@ -22,6 +22,9 @@
 
 #include "netutils.h"
 
+#include "lwip/pbuf.h"
+#include "lwip/netif.h"
+
 #include "esp_system.h"
 #include "esp_event.h"
 #include "esp_log.h"
@@ -47,6 +50,7 @@
 
 #include "esp32chipinfo.h"
 #include "app_sys_evt.h"
+#include "pycom_config.h"
 
 /*****************************************************************************
 * DEFINE CONSTANTS
@@ -56,6 +60,9 @@
 #define ETHERNET_CHECK_LINK_PERIOD_MS   2000
 #define ETHERNET_CMD_QUEUE_SIZE         100
 
+// number of ETH.stats() micropy command fields
+#define ETHERNET_STATS_FIELDS_NUM       5
+
 //EVENT bits
 #define ETHERNET_EVT_CONNECTED        0x0001
 #define ETHERNET_EVT_STARTED          0x0002
@@ -86,7 +93,12 @@ eth_obj_t DRAM_ATTR eth_obj = {
         .trigger = 0,
         .events = 0,
         .handler = NULL,
-        .handler_arg = NULL
+        .handler_arg = NULL,
+        .rx_frames = 0,
+        .rx_bytes = 0,
+        .rx_dropped = 0,
+        .tx_frames = 0,
+        .tx_bytes = 0
 };
 
 static uint8_t* modeth_rxBuff = NULL;
@@ -115,7 +127,7 @@ void eth_pre_init (void) {
     eth_event_group = xEventGroupCreate();
 
     // create eth Task
-    xTaskCreatePinnedToCore(TASK_ETHERNET, "ethernet_task", ETHERNET_TASK_STACK_SIZE / sizeof(StackType_t), NULL, ETHERNET_TASK_PRIORITY, &ethernetTaskHandle, 1);
+    xTaskCreatePinnedToCore(TASK_ETHERNET, "ethernet_task", ETHERNET_TASK_STACK_SIZE / sizeof(StackType_t), NULL, ETHERNET_TASK_PRIORITY, &ethernetTaskHandle, config_get_service_core());
 }
 
 void modeth_get_mac(uint8_t *mac)
@@ -220,6 +232,8 @@ static void process_tx(uint8_t* buff, uint16_t len)
         ksz8851BeginPacketSend(len);
         ksz8851SendPacketData(buff, len);
         ksz8851EndPacketSend();
+        eth_obj.tx_frames++;
+        eth_obj.tx_bytes += len;
     }
 
     // re-enable int
@@ -230,28 +244,56 @@ static void process_tx(uint8_t* buff, uint16_t len)
 
 static uint32_t process_rx(void)
 {
-    uint32_t len, frameCnt;
+    uint32_t len = 0, frameCnt, toRead;
     uint32_t totalLen = 0;
+    struct netif *netif = NULL;
+    struct pbuf *p, *q;
+
+    // frames are read straight into pool pbufs and handed to lwIP as they are
+    if (tcpip_adapter_get_netif(TCPIP_ADAPTER_IF_ETH, (void **)&netif) != ESP_OK || !netif_is_up(netif)) {
+        netif = NULL;
+    }
 
     // disable int before reading buffer
     portDISABLE_INTERRUPTS();
     //ksz8851_regwr(REG_INT_MASK, 0);
 
+    // drain all the frames the RXQ holds in one go
     frameCnt = (ksz8851_regrd(REG_RX_FRAME_CNT_THRES) & RX_FRAME_CNT_MASK) >> 8;
     uint32_t frameCntTotal = frameCnt;
     uint32_t frameCntZeroLen = 0;
     while (frameCnt > 0)
     {
-        ksz8851RetrievePacketData(modeth_rxBuff, &len, frameCnt, frameCntTotal);
-        if(len)
+        toRead = ksz8851BeginPacketRetrieve(&len);
+        if (toRead)
         {
+            p = (netif != NULL) ? pbuf_alloc(PBUF_RAW, toRead, PBUF_POOL) : NULL;
+            if (p != NULL) {
+                for (q = p; q != NULL; q = q->next) {
+                    ksz8851RetrievePacketChunk(q->payload, q->len);
+                }
+                ksz8851EndPacketRetrieve();
+                // drop the CRC and the padding
+                pbuf_realloc(p, len);
+                if (netif->input(p, netif) != ERR_OK) {
+                    pbuf_free(p);
+                    eth_obj.rx_dropped++;
+                }
+            } else {
+                // pool exhausted, copy through the rx buffer like before
+                ksz8851RetrievePacketChunk(modeth_rxBuff, toRead);
+                ksz8851EndPacketRetrieve();
+                tcpip_adapter_eth_input(modeth_rxBuff, len, NULL);
+            }
             totalLen += len;
-            tcpip_adapter_eth_input(modeth_rxBuff, len, NULL);
+            eth_obj.rx_frames++;
         } else {
             frameCntZeroLen++;
+            eth_obj.rx_dropped++;
         }
         frameCnt--;
     }
+    eth_obj.rx_bytes += totalLen;
 
     // re-enable int
     //ksz8851_regwr(REG_INT_MASK, INT_MASK);
@@ -445,6 +487,11 @@ eth_start:
                     case ETH_CMD_TX:
                         //MSG("TE TX %u\n", queue_entry.len);
                         process_tx(queue_entry.buf, queue_entry.len);
+                        // send the frames queued right behind without going round the loop
+                        while (xQueuePeek(eth_cmdQueue, &queue_entry, 0) == pdTRUE && queue_entry.cmd == ETH_CMD_TX) {
+                            xQueueReceive(eth_cmdQueue, &queue_entry, 0);
+                            process_tx(queue_entry.buf, queue_entry.len);
+                        }
                         break;
                     case ETH_CMD_HW_INT:
                         processInterrupt();
@@ -744,6 +791,22 @@ STATIC mp_obj_t modeth_isconnected(mp_obj_t self_in) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(modeth_isconnected_obj, modeth_isconnected);
 
+STATIC mp_obj_t modeth_stats(mp_obj_t self_in) {
+    static const qstr eth_stats_fields[ETHERNET_STATS_FIELDS_NUM] = {
+            MP_QSTR_rx_frames, MP_QSTR_rx_bytes, MP_QSTR_rx_dropped, MP_QSTR_tx_frames, MP_QSTR_tx_bytes
+    };
+    mp_obj_t stats_tuple[ETHERNET_STATS_FIELDS_NUM];
+
+    stats_tuple[0] = mp_obj_new_int_from_uint(eth_obj.rx_frames);
+    stats_tuple[1] = mp_obj_new_int_from_uint(eth_obj.rx_bytes);
+    stats_tuple[2] = mp_obj_new_int_from_uint(eth_obj.rx_dropped);
+    stats_tuple[3] = mp_obj_new_int_from_uint(eth_obj.tx_frames);
+    stats_tuple[4] = mp_obj_new_int_from_uint(eth_obj.tx_bytes);
+
+    return mp_obj_new_attrtuple(eth_stats_fields, ETHERNET_STATS_FIELDS_NUM, stats_tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(modeth_stats_obj, modeth_stats);
+
 STATIC const mp_map_elem_t eth_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_init),                (mp_obj_t)&modeth_init_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_ifconfig),            (mp_obj_t)&eth_ifconfig_obj },
@@ -751,12 +814,15 @@ STATIC const mp_map_elem_t eth_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_mac),                 (mp_obj_t)&modeth_mac_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_deinit),              (mp_obj_t)&modeth_deinit_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_isconnected),         (mp_obj_t)&modeth_isconnected_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_stats),               (mp_obj_t)&modeth_stats_obj },
 #ifdef DEBUG_MODETH
     { MP_OBJ_NEW_QSTR(MP_QSTR_register),            (mp_obj_t)&modeth_ksz8851_reg_wr_obj },
 #endif
 };
 STATIC MP_DEFINE_CONST_DICT(eth_locals_dict, eth_locals_dict_table);
 
+STATIC mod_network_nic_stats_t eth_stats;
+
 const mod_network_nic_type_t mod_network_nic_type_eth = {
     .base = {
         { &mp_type_type },
@@ -781,5 +847,6 @@ const mod_network_nic_type_t mod_network_nic_type_eth = {
     .n_ioctl = lwipsocket_socket_ioctl,
     .n_setupssl = lwipsocket_socket_setup_ssl,
     .inf_up = is_eth_link_up,
-    .set_default_inf = eth_set_default_inf
+    .set_default_inf = eth_set_default_inf,
+    .stats = &eth_stats
 };
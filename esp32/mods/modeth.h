@@ -32,6 +32,11 @@ typedef struct _eth_obj_t {
     int32_t                 events;
     mp_obj_t                handler;
     mp_obj_t                handler_arg;
+    uint32_t                rx_frames;
+    uint32_t                rx_bytes;
+    uint32_t                rx_dropped;
+    uint32_t                tx_frames;
+    uint32_t                tx_bytes;
 } eth_obj_t;
 
 typedef enum
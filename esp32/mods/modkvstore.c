@@ -0,0 +1,557 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <string.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/objstr.h"
+#include "py/runtime.h"
+#include "py/stream.h"
+#include "py/mperrno.h"
+#include "py/nlr.h"
+#include "extmod/vfs.h"
+
+#include "rom/crc.h"
+
+#include "mpexception.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define KVSTORE_MAGIC                   "KVS1"
+#define KVSTORE_MAGIC_SIZE              (4)
+#define KVSTORE_KEY_LEN_MAX             (255)
+#define KVSTORE_VALUE_LEN_MAX           (UINT16_MAX)
+// stale records tolerated on top of the live ones before compacting
+#define KVSTORE_COMPACT_SLACK           (32)
+
+#define KVSTORE_OP_BYTES                (1)
+#define KVSTORE_OP_STR                  (2)
+#define KVSTORE_OP_INT                  (3)
+#define KVSTORE_OP_DELETE               (4)
+#define KVSTORE_OP_COMMIT               (5)
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+// followed by the key, the value and a crc32 of all three
+typedef struct {
+    uint8_t op;
+    uint8_t key_len;
+    uint16_t val_len;
+} kvstore_record_t;
+
+typedef struct _kvstore_obj_t {
+    mp_obj_base_t base;
+    mp_obj_t path;
+    mp_obj_t file;
+    mp_obj_t index;         // key -> offset of its record in the file
+    mp_obj_t pending;       // key -> value (None when deleted) not committed yet
+    mp_uint_t end;          // where the next batch goes
+    mp_uint_t records;      // in the file, stale ones included
+    bool autocommit;
+} kvstore_obj_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+STATIC const mp_obj_type_t kvstore_type;
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+STATIC mp_uint_t kvstore_read(mp_obj_t file, void *buf, mp_uint_t len) {
+    int errcode;
+    mp_uint_t out = mp_stream_read_exactly(file, buf, len, &errcode);
+    if (errcode != 0) {
+        mp_raise_OSError(errcode);
+    }
+    return out;
+}
+
+STATIC void kvstore_write(mp_obj_t file, const void *buf, mp_uint_t len) {
+    int errcode;
+    mp_stream_write_exactly(file, buf, len, &errcode);
+    if (errcode != 0) {
+        mp_raise_OSError(errcode);
+    }
+}
+
+STATIC mp_uint_t kvstore_seek(mp_obj_t file, mp_off_t offset, int whence) {
+    const mp_stream_p_t *stream = mp_get_stream_raise(file, MP_STREAM_OP_IOCTL);
+    struct mp_stream_seek_t seek = { .offset = offset, .whence = whence };
+    int errcode;
+    if (stream->ioctl(file, MP_STREAM_SEEK, (uintptr_t)&seek, &errcode) == MP_STREAM_ERROR) {
+        mp_raise_OSError(errcode);
+    }
+    return seek.offset;
+}
+
+STATIC void kvstore_flush(mp_obj_t file) {
+    const mp_stream_p_t *stream = mp_get_stream_raise(file, MP_STREAM_OP_IOCTL);
+    int errcode;
+    if (stream->ioctl(file, MP_STREAM_FLUSH, 0, &errcode) == MP_STREAM_ERROR) {
+        mp_raise_OSError(errcode);
+    }
+}
+
+STATIC mp_obj_t kvstore_open(mp_obj_t path, const char *mode) {
+    mp_obj_t args[2] = { path, mp_obj_new_str(mode, strlen(mode)) };
+    return mp_vfs_open(2, args, (mp_map_t*)&mp_const_empty_map);
+}
+
+STATIC bool kvstore_exists(mp_obj_t path) {
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        mp_vfs_stat(path);
+        nlr_pop();
+        return true;
+    }
+    return false;
+}
+
+// returns the size of the record
+STATIC mp_uint_t kvstore_write_record(mp_obj_t file, uint8_t op, const char *key, size_t key_len, const void *val, size_t val_len) {
+    kvstore_record_t record = { .op = op, .key_len = key_len, .val_len = val_len };
+    uint32_t crc = crc32_le(0, (const uint8_t *)&record, sizeof(record));
+    crc = crc32_le(crc, (const uint8_t *)key, key_len);
+    crc = crc32_le(crc, val, val_len);
+    kvstore_write(file, &record, sizeof(record));
+    kvstore_write(file, key, key_len);
+    kvstore_write(file, val, val_len);
+    kvstore_write(file, &crc, sizeof(crc));
+    return sizeof(record) + key_len + val_len + sizeof(crc);
+}
+
+STATIC uint8_t kvstore_encode(mp_obj_t value, mp_int_t *num, const void **buf, size_t *len) {
+    uint8_t op;
+    if (MP_OBJ_IS_STR(value)) {
+        *buf = mp_obj_str_get_data(value, len);
+        op = KVSTORE_OP_STR;
+    } else if (MP_OBJ_IS_INT(value)) {
+        *num = mp_obj_get_int(value);
+        *buf = num;
+        *len = sizeof(*num);
+        op = KVSTORE_OP_INT;
+    } else {
+        mp_buffer_info_t bufinfo;
+        mp_get_buffer_raise(value, &bufinfo, MP_BUFFER_READ);
+        *buf = bufinfo.buf;
+        *len = bufinfo.len;
+        op = KVSTORE_OP_BYTES;
+    }
+    if (*len > KVSTORE_VALUE_LEN_MAX) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+    return op;
+}
+
+STATIC mp_obj_t kvstore_read_value(kvstore_obj_t *self, mp_obj_t file, mp_uint_t offset) {
+    kvstore_record_t record;
+    kvstore_seek(file, offset, MP_SEEK_SET);
+    if (kvstore_read(file, &record, sizeof(record)) != sizeof(record)) {
+        mp_raise_OSError(MP_EIO);
+    }
+    kvstore_seek(file, offset + sizeof(record) + record.key_len, MP_SEEK_SET);
+
+    vstr_t vstr;
+    vstr_init_len(&vstr, record.val_len);
+    if (kvstore_read(file, vstr.buf, record.val_len) != record.val_len) {
+        mp_raise_OSError(MP_EIO);
+    }
+    if (record.op == KVSTORE_OP_INT) {
+        mp_int_t num;
+        memcpy(&num, vstr.buf, sizeof(num));
+        vstr_clear(&vstr);
+        return mp_obj_new_int(num);
+    }
+    return mp_obj_new_str_from_vstr((record.op == KVSTORE_OP_STR) ? &mp_type_str : &mp_type_bytes, &vstr);
+}
+
+// a batch goes into the index only once its commit record made it to the file
+STATIC void kvstore_apply(kvstore_obj_t *self, mp_obj_t batch) {
+    mp_map_t *map = mp_obj_dict_get_map(batch);
+    for (size_t i = 0; i < map->alloc; i++) {
+        if (MP_MAP_SLOT_IS_FILLED(map, i)) {
+            if (map->table[i].value == mp_const_none) {
+                mp_map_lookup(mp_obj_dict_get_map(self->index), map->table[i].key, MP_MAP_LOOKUP_REMOVE_IF_FOUND);
+            } else {
+                mp_obj_dict_store(self->index, map->table[i].key, map->table[i].value);
+            }
+        }
+    }
+}
+
+// rebuilds the index, returns false if there's a batch cut short by a power loss at the end
+STATIC bool kvstore_load(kvstore_obj_t *self) {
+    char magic[KVSTORE_MAGIC_SIZE];
+    if (kvstore_read(self->file, magic, sizeof(magic)) != sizeof(magic) || memcmp(magic, KVSTORE_MAGIC, sizeof(magic))) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "not a key-value store"));
+    }
+
+    mp_obj_t batch = mp_obj_new_dict(0);
+    mp_uint_t batch_records = 0;
+    mp_uint_t offset = KVSTORE_MAGIC_SIZE;
+    vstr_t vstr;
+    vstr_init(&vstr, 64);
+    self->end = offset;
+    self->records = 0;
+
+    for (;;) {
+        kvstore_record_t record;
+        uint32_t crc;
+        if (kvstore_read(self->file, &record, sizeof(record)) != sizeof(record)) {
+            break;
+        }
+        size_t len = record.key_len + record.val_len;
+        vstr_reset(&vstr);
+        vstr_add_len(&vstr, len);
+        if (kvstore_read(self->file, vstr.buf, len) != len || kvstore_read(self->file, &crc, sizeof(crc)) != sizeof(crc) ||
+            crc != crc32_le(crc32_le(0, (const uint8_t *)&record, sizeof(record)), (const uint8_t *)vstr.buf, len)) {
+            break;
+        }
+
+        if (record.op == KVSTORE_OP_COMMIT) {
+            kvstore_apply(self, batch);
+            mp_map_clear(mp_obj_dict_get_map(batch));
+            self->records += batch_records;
+            batch_records = 0;
+            self->end = offset + sizeof(record) + len + sizeof(crc);
+        } else {
+            mp_obj_t key = mp_obj_new_str(vstr.buf, record.key_len);
+            mp_obj_dict_store(batch, key, (record.op == KVSTORE_OP_DELETE) ? mp_const_none : mp_obj_new_int_from_uint(offset));
+            batch_records++;
+        }
+        offset += sizeof(record) + len + sizeof(crc);
+    }
+    vstr_clear(&vstr);
+
+    return kvstore_seek(self->file, 0, MP_SEEK_END) == self->end;
+}
+
+STATIC void kvstore_check_open(kvstore_obj_t *self) {
+    if (self->file == mp_const_none) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_request_not_possible));
+    }
+}
+
+STATIC mp_obj_t kvstore_tmp_path(kvstore_obj_t *self) {
+    vstr_t vstr;
+    size_t len;
+    const char *path = mp_obj_str_get_data(self->path, &len);
+    vstr_init(&vstr, len + 4);
+    vstr_add_strn(&vstr, path, len);
+    vstr_add_str(&vstr, ".tmp");
+    return mp_obj_new_str_from_vstr(&mp_type_str, &vstr);
+}
+
+// writes the live records to a new file which then replaces the old one in a single rename
+STATIC void kvstore_compact(kvstore_obj_t *self) {
+    mp_obj_t tmp_path = kvstore_tmp_path(self);
+    mp_obj_t tmp = kvstore_open(tmp_path, "wb");
+    mp_obj_t index = mp_obj_new_dict(0);
+    mp_uint_t end = KVSTORE_MAGIC_SIZE;
+
+    kvstore_write(tmp, KVSTORE_MAGIC, KVSTORE_MAGIC_SIZE);
+    mp_map_t *map = mp_obj_dict_get_map(self->index);
+    for (size_t i = 0; i < map->alloc; i++) {
+        if (MP_MAP_SLOT_IS_FILLED(map, i)) {
+            size_t key_len, val_len;
+            mp_int_t num;
+            const void *buf;
+            const char *key = mp_obj_str_get_data(map->table[i].key, &key_len);
+            mp_obj_t value = kvstore_read_value(self, self->file, mp_obj_get_int(map->table[i].value));
+            uint8_t op = kvstore_encode(value, &num, &buf, &val_len);
+            mp_obj_dict_store(index, map->table[i].key, mp_obj_new_int_from_uint(end));
+            end += kvstore_write_record(tmp, op, key, key_len, buf, val_len);
+        }
+    }
+    end += kvstore_write_record(tmp, KVSTORE_OP_COMMIT, NULL, 0, NULL, 0);
+    mp_stream_close(tmp);
+
+    mp_stream_close(self->file);
+    self->file = mp_const_none;
+    mp_vfs_rename(tmp_path, self->path);
+    self->file = kvstore_open(self->path, "r+b");
+    self->index = index;
+    self->end = end;
+    self->records = mp_obj_dict_get_map(index)->used;
+}
+
+STATIC void kvstore_commit(kvstore_obj_t *self) {
+    mp_map_t *map = mp_obj_dict_get_map(self->pending);
+    if (map->used == 0) {
+        return;
+    }
+
+    mp_obj_t batch = mp_obj_new_dict(0);
+    mp_uint_t end = self->end;
+    mp_uint_t records = 0;
+    kvstore_seek(self->file, end, MP_SEEK_SET);
+    for (size_t i = 0; i < map->alloc; i++) {
+        if (MP_MAP_SLOT_IS_FILLED(map, i)) {
+            size_t key_len, val_len;
+            mp_int_t num;
+            const void *buf;
+            const char *key = mp_obj_str_get_data(map->table[i].key, &key_len);
+            mp_obj_t value = map->table[i].value;
+            if (value == mp_const_none) {
+                if (mp_map_lookup(mp_obj_dict_get_map(self->index), map->table[i].key, MP_MAP_LOOKUP) == NULL) {
+                    // it never made it to the file
+                    continue;
+                }
+                mp_obj_dict_store(batch, map->table[i].key, mp_const_none);
+                end += kvstore_write_record(self->file, KVSTORE_OP_DELETE, key, key_len, NULL, 0);
+            } else {
+                uint8_t op = kvstore_encode(value, &num, &buf, &val_len);
+                mp_obj_dict_store(batch, map->table[i].key, mp_obj_new_int_from_uint(end));
+                end += kvstore_write_record(self->file, op, key, key_len, buf, val_len);
+            }
+            records++;
+        }
+    }
+    end += kvstore_write_record(self->file, KVSTORE_OP_COMMIT, NULL, 0, NULL, 0);
+    // the whole batch costs a single filesystem commit
+    kvstore_flush(self->file);
+
+    kvstore_apply(self, batch);
+    mp_map_clear(map);
+    self->end = end;
+    self->records += records;
+
+    if (self->records > 2 * mp_obj_dict_get_map(self->index)->used + KVSTORE_COMPACT_SLACK) {
+        kvstore_compact(self);
+    }
+}
+
+STATIC mp_obj_t kvstore_get(kvstore_obj_t *self, mp_obj_t key, mp_obj_t deflt) {
+    kvstore_check_open(self);
+    mp_map_elem_t *elem = mp_map_lookup(mp_obj_dict_get_map(self->pending), key, MP_MAP_LOOKUP);
+    if (elem != NULL) {
+        return (elem->value == mp_const_none) ? deflt : elem->value;
+    }
+    elem = mp_map_lookup(mp_obj_dict_get_map(self->index), key, MP_MAP_LOOKUP);
+    if (elem == NULL) {
+        return deflt;
+    }
+    return kvstore_read_value(self, self->file, mp_obj_get_int(elem->value));
+}
+
+/******************************************************************************/
+// Micro Python bindings; Store class
+
+/// \class Store(path, *, autocommit=False)
+/// a persistent key-value store in a file, keys are strings and values are bytes, str or int.
+/// Changes are kept in RAM and written as one batch by commit(), and the file is compacted
+/// once it's mostly stale records.
+STATIC mp_obj_t kvstore_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args) {
+    STATIC const mp_arg_t kvstore_args[] = {
+        { MP_QSTR_path,                         MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_autocommit,                   MP_ARG_KW_ONLY  | MP_ARG_BOOL, {.u_bool = false} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(kvstore_args)];
+    mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(args), kvstore_args, args);
+
+    kvstore_obj_t *self = m_new_obj(kvstore_obj_t);
+    self->base.type = &kvstore_type;
+    self->path = args[0].u_obj;
+    self->file = mp_const_none;
+    self->index = mp_obj_new_dict(0);
+    self->pending = mp_obj_new_dict(0);
+    self->autocommit = args[1].u_bool;
+
+    // a compaction interrupted before the rename leaves the new file next to the old one,
+    // and one interrupted by FatFS replacing the old file leaves only the new one
+    mp_obj_t tmp_path = kvstore_tmp_path(self);
+    if (kvstore_exists(tmp_path)) {
+        if (kvstore_exists(self->path)) {
+            mp_vfs_remove(tmp_path);
+        } else {
+            mp_vfs_rename(tmp_path, self->path);
+        }
+    }
+    if (!kvstore_exists(self->path)) {
+        mp_obj_t file = kvstore_open(self->path, "wb");
+        kvstore_write(file, KVSTORE_MAGIC, KVSTORE_MAGIC_SIZE);
+        mp_stream_close(file);
+    }
+
+    self->file = kvstore_open(self->path, "r+b");
+    if (!kvstore_load(self)) {
+        // leftovers of an interrupted commit, don't let the next batch land after them
+        kvstore_compact(self);
+    }
+
+    return MP_OBJ_FROM_PTR(self);
+}
+
+STATIC mp_obj_t kvstore_subscr(mp_obj_t self_in, mp_obj_t index, mp_obj_t value) {
+    kvstore_obj_t *self = MP_OBJ_TO_PTR(self_in);
+
+    if (value == MP_OBJ_SENTINEL) {
+        // load
+        mp_obj_t result = kvstore_get(self, index, MP_OBJ_NULL);
+        if (result == MP_OBJ_NULL) {
+            nlr_raise(mp_obj_new_exception_arg1(&mp_type_KeyError, index));
+        }
+        return result;
+    }
+
+    kvstore_check_open(self);
+    size_t key_len;
+    if (!MP_OBJ_IS_STR(index)) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_TypeError, mpexception_num_type_invalid_arguments));
+    }
+    mp_obj_str_get_data(index, &key_len);
+    if (key_len > KVSTORE_KEY_LEN_MAX) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+    if (value == MP_OBJ_NULL) {
+        // delete
+        if (kvstore_get(self, index, MP_OBJ_NULL) == MP_OBJ_NULL) {
+            nlr_raise(mp_obj_new_exception_arg1(&mp_type_KeyError, index));
+        }
+        mp_obj_dict_store(self->pending, index, mp_const_none);
+    } else {
+        // store, checking the value can be written now rather than at commit time
+        mp_int_t num;
+        const void *buf;
+        size_t len;
+        kvstore_encode(value, &num, &buf, &len);
+        mp_obj_dict_store(self->pending, index, value);
+    }
+    if (self->autocommit) {
+        kvstore_commit(self);
+    }
+    return mp_const_none;
+}
+
+STATIC mp_obj_t kvstore_keys_list(kvstore_obj_t *self) {
+    kvstore_check_open(self);
+    mp_obj_t keys = mp_obj_new_list(0, NULL);
+    mp_map_t *index = mp_obj_dict_get_map(self->index);
+    mp_map_t *pending = mp_obj_dict_get_map(self->pending);
+    for (size_t i = 0; i < index->alloc; i++) {
+        if (MP_MAP_SLOT_IS_FILLED(index, i) && mp_map_lookup(pending, index->table[i].key, MP_MAP_LOOKUP) == NULL) {
+            mp_obj_list_append(keys, index->table[i].key);
+        }
+    }
+    for (size_t i = 0; i < pending->alloc; i++) {
+        if (MP_MAP_SLOT_IS_FILLED(pending, i) && pending->table[i].value != mp_const_none) {
+            mp_obj_list_append(keys, pending->table[i].key);
+        }
+    }
+    return keys;
+}
+
+STATIC mp_obj_t kvstore_unary_op(mp_unary_op_t op, mp_obj_t self_in) {
+    kvstore_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    switch (op) {
+        case MP_UNARY_OP_LEN: {
+            size_t len;
+            mp_obj_t *items;
+            mp_obj_list_get(kvstore_keys_list(self), &len, &items);
+            return MP_OBJ_NEW_SMALL_INT(len);
+        }
+        default:
+            return MP_OBJ_NULL; // op not supported
+    }
+}
+
+STATIC mp_obj_t kvstore_binary_op(mp_binary_op_t op, mp_obj_t lhs_in, mp_obj_t rhs_in) {
+    kvstore_obj_t *self = MP_OBJ_TO_PTR(lhs_in);
+    switch (op) {
+        case MP_BINARY_OP_CONTAINS:
+            return mp_obj_new_bool(kvstore_get(self, rhs_in, MP_OBJ_NULL) != MP_OBJ_NULL);
+        default:
+            return MP_OBJ_NULL; // op not supported
+    }
+}
+
+STATIC mp_obj_t kvstore_get_method(size_t n_args, const mp_obj_t *args) {
+    kvstore_obj_t *self = MP_OBJ_TO_PTR(args[0]);
+    return kvstore_get(self, args[1], (n_args > 2) ? args[2] : mp_const_none);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(kvstore_get_obj, 2, 3, kvstore_get_method);
+
+STATIC mp_obj_t kvstore_keys(mp_obj_t self_in) {
+    return kvstore_keys_list(MP_OBJ_TO_PTR(self_in));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(kvstore_keys_obj, kvstore_keys);
+
+/// \method commit()
+/// writes the pending changes, they all make it to the file or none of them does
+STATIC mp_obj_t kvstore_commit_method(mp_obj_t self_in) {
+    kvstore_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    kvstore_check_open(self);
+    kvstore_commit(self);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(kvstore_commit_obj, kvstore_commit_method);
+
+STATIC mp_obj_t kvstore_compact_method(mp_obj_t self_in) {
+    kvstore_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    kvstore_check_open(self);
+    kvstore_commit(self);
+    kvstore_compact(self);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(kvstore_compact_obj, kvstore_compact_method);
+
+/// \method close()
+/// commits the pending changes and closes the file
+STATIC mp_obj_t kvstore_close(mp_obj_t self_in) {
+    kvstore_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->file != mp_const_none) {
+        kvstore_commit(self);
+        mp_stream_close(self->file);
+        self->file = mp_const_none;
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(kvstore_close_obj, kvstore_close);
+
+STATIC mp_obj_t kvstore___exit__(size_t n_args, const mp_obj_t *args) {
+    return kvstore_close(args[0]);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(kvstore___exit___obj, 4, 4, kvstore___exit__);
+
+STATIC const mp_map_elem_t kvstore_locals_dict_table[] = {
+    // instance methods
+    { MP_OBJ_NEW_QSTR(MP_QSTR_get),                     (mp_obj_t)&kvstore_get_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_keys),                    (mp_obj_t)&kvstore_keys_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_commit),                  (mp_obj_t)&kvstore_commit_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_compact),                 (mp_obj_t)&kvstore_compact_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_close),                   (mp_obj_t)&kvstore_close_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR___enter__),               (mp_obj_t)&mp_identity_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR___exit__),                (mp_obj_t)&kvstore___exit___obj },
+};
+STATIC MP_DEFINE_CONST_DICT(kvstore_locals_dict, kvstore_locals_dict_table);
+
+STATIC const mp_obj_type_t kvstore_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_Store,
+    .make_new = kvstore_make_new,
+    .unary_op = kvstore_unary_op,
+    .binary_op = kvstore_binary_op,
+    .subscr = kvstore_subscr,
+    .locals_dict = (mp_obj_t)&kvstore_locals_dict,
+};
+
+STATIC const mp_map_elem_t mp_module_kvstore_globals_table[] = {
+    { MP_OBJ_NEW_QSTR(MP_QSTR___name__),            MP_OBJ_NEW_QSTR(MP_QSTR_kvstore) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_Store),               (mp_obj_t)&kvstore_type },
+};
+STATIC MP_DEFINE_CONST_DICT(mp_module_kvstore_globals, mp_module_kvstore_globals_table);
+
+const mp_obj_module_t mp_module_kvstore = {
+    .base = { &mp_type_module },
+    .globals = (mp_obj_dict_t*)&mp_module_kvstore_globals,
+};
@@ -29,6 +29,7 @@
 #include "pycom_config.h"
 #include "mpirq.h"
 #include "modlora.h"
+#include "tracering.h"
 
 #include "esp_heap_caps.h"
 #include "sdkconfig.h"
@@ -36,12 +37,15 @@
 #include "esp_spi_flash.h"
 #include "nvs_flash.h"
 #include "nvs.h"
+#include "esp_attr.h"
+#include "rom/crc.h"
 
 #include "lwip/sockets.h"       // for the socket error codes
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "freertos/event_groups.h"
 
 #include "lora/mac/LoRaMacTest.h"
@@ -62,6 +66,9 @@
 #endif  // #ifdef LORA_OPENTHREAD_ENABLED
 
 #include "random.h"
+#include "pollwait.h"
+#include "pwrmgr.h"
+#include "taskwdt.h"
 /******************************************************************************
  DEFINE PRIVATE CONSTANTS
  ******************************************************************************/
@@ -111,9 +118,21 @@
 #define MODLORA_RX_EVENT                            (0x01)
 #define MODLORA_TX_EVENT                            (0x02)
 #define MODLORA_TX_FAILED_EVENT                     (0x04)
+#define MODLORA_CAD_EVENT                           (0x08)
+
+// packet log record flags
+#define MODLORA_PKT_LOG_TX                          (0x01)
+#define MODLORA_PKT_LOG_LORAWAN                     (0x02)
+#define MODLORA_PKT_LOG_ACK                         (0x04)
+#define MODLORA_PKT_LOG_FAILED                      (0x08)
+#define MODLORA_PKT_LOG_ENTRIES_MAX                 (1024)
 
 #define MODLORA_NVS_NAMESPACE                       "LORA_NVM"
 
+#define MODLORA_RTC_SESSION_MAGIC                   (0x4C524153)    // "LRAS"
+#define MODLORA_RTC_SESSION_BLOB_SIZE               (1600)          // fits the CN470 channel plan
+#define MODLORA_RTC_SESSION_FCNT_GAP_DEF            (32)
+
 #define MESH_CLI_OUTPUT_SIZE                            (1024)
 
 /******************************************************************************
@@ -137,7 +156,10 @@ typedef enum {
     E_LORA_STATE_TX_DONE,
     E_LORA_STATE_TX_TIMEOUT,
     E_LORA_STATE_SLEEP,
-    E_LORA_STATE_RESET
+    E_LORA_STATE_RESET,
+    E_LORA_STATE_CAD,
+    E_LORA_STATE_CAD_DONE,
+    E_LORA_STATE_CSMA_BACKOFF
 } lora_state_t;
 
 typedef enum {
@@ -188,6 +210,7 @@ typedef struct {
     uint8_t           sf;
     int8_t            tx_power;
     uint8_t           pwr_mode;
+    uint8_t           payload_len;
 
     struct {
         bool Enabled;
@@ -224,6 +247,7 @@ typedef struct {
     bool              rxiq;
     bool              adr;
     bool              public;
+    bool              stream;
     bool              joined;
     bool              reset;
     uint8_t           events;
@@ -238,11 +262,106 @@ typedef struct {
     uint8_t     port;
 } lora_partial_rx_packet_t;
 
+// state of a channel activity detection sweep over frequencies x spreading factors
+typedef struct {
+    lora_cad_cmd_data_t params;
+    uint64_t    detected;           // one bit per (frequency, sf) pair
+    uint32_t    index;              // pair being scanned
+    uint32_t    started;            // tick at which the current CAD was started
+    bool        activity;           // result of the last CAD
+    bool        busy;
+} lora_cad_sweep_t;
+
+// unslotted CSMA/CA of the frame in task_cmd_data, with CAD as the clear channel assessment
+typedef struct {
+    uint32_t    backoff_until;      // tick at which the next CAD starts
+    uint32_t    failures;           // frames dropped after LORA_CSMA_MAX_BACKOFFS
+    uint8_t     nb;                 // backoffs done for the current frame
+    uint8_t     be;                 // backoff exponent
+    bool        busy;
+} lora_csma_t;
+
+// copy of the MAC session kept in RTC slow memory across deep sleep
+typedef struct {
+    uint32_t    magic;
+    uint32_t    crc;                                    // over everything that follows
+    uint32_t    region;
+    uint32_t    nvs_uplink_reserved;                    // uplink counter last committed to NVS
+    uint32_t    valid;                                  // one bit per NVS key
+    uint32_t    values[E_LORA_NVS_NUM_KEYS];
+    uint16_t    blob_offset[E_LORA_NVS_NUM_KEYS];
+    uint16_t    blob_len[E_LORA_NVS_NUM_KEYS];
+    uint32_t    blob_used;
+    uint8_t     blob[MODLORA_RTC_SESSION_BLOB_SIZE];
+} lora_rtc_session_t;
+
+// small application messages packed as [len][data] records into a single uplink
+typedef struct {
+    uint8_t     data[LORA_PAYLOAD_SIZE_MAX];
+    uint32_t    len;
+    uint32_t    count;          // messages in the buffer
+    uint32_t    deadline_ms;    // 0 when aggregation is disabled
+    uint8_t     port;
+    uint8_t     dr;
+    bool        confirmed;
+} lora_aggregate_t;
+
+// received packets are packed back to back as [len][port][rssi][data], so short
+// frames don't each take a full LORA_PAYLOAD_SIZE_MAX slot
+typedef struct {
+    uint8_t     *buf;
+    uint32_t    size;
+    uint32_t    head;               // next byte written
+    uint32_t    tail;               // next byte read
+    uint32_t    used;
+    uint32_t    count;              // packets queued
+    uint32_t    max_count;
+    uint32_t    dropped;
+} lora_rx_ring_t;
+
+// radio metadata of one packet, lora.packet_log() returns the records back to back
+// as they are here, struct format '<IIHhbBBbBBBx'
+typedef struct __attribute__((packed)) {
+    uint32_t    timestamp;          // us, reception time or end of the transmission
+    uint32_t    frequency;          // Hz, 0 for LoRaWAN downlinks
+    uint16_t    airtime;            // ms, 0 for LoRaWAN downlinks
+    int16_t     rssi;               // dBm, 0 for uplinks
+    int8_t      snr;                // 0.25 dB steps, 0 for uplinks
+    uint8_t     flags;              // MODLORA_PKT_LOG_*
+    uint8_t     dr;                 // spreading factor in LoRa mode, data rate in LoRaWAN mode
+    int8_t      tx_power;
+    uint8_t     retries;
+    uint8_t     rx_window;          // LoRaWAN receive slot of a downlink
+    uint8_t     size;               // payload bytes
+    uint8_t     reserved;
+} lora_pkt_log_record_t;
+
+// the oldest records are overwritten once it's full
+typedef struct {
+    lora_pkt_log_record_t *records;
+    uint32_t    size;
+    uint32_t    head;               // next record written
+    uint32_t    count;
+} lora_pkt_log_t;
+
 /******************************************************************************
  DECLARE PRIVATE DATA
  ******************************************************************************/
 static QueueHandle_t xCmdQueue;
-static QueueHandle_t xRxQueue;
+static SemaphoreHandle_t xRxSem;            // counts the packets in the rx ring
+static lora_rx_ring_t lora_rx_ring;
+static portMUX_TYPE lora_rx_ring_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t lora_tx_dropped;
+static lora_aggregate_t lora_aggregate;
+static SemaphoreHandle_t xAggregateSem;
+static TimerEvent_t AggregateTimer;
+static uint8_t lora_tx_msgs_in_flight;
+static uint32_t lora_tx_msgs_delivered;
+static uint32_t lora_tx_msgs_failed;
+static lora_cad_sweep_t lora_cad;
+static lora_csma_t lora_csma;
+static lora_pkt_log_t lora_pkt_log;
+static portMUX_TYPE lora_pkt_log_mux = portMUX_INITIALIZER_UNLOCKED;
 static QueueHandle_t xCbQueue;
 static EventGroupHandle_t LoRaEvents;
 
@@ -253,11 +372,13 @@ static LoRaMacCallback_t LoRaMacCallbacks;
 
 static lora_obj_t lora_obj;
 static lora_partial_rx_packet_t lora_partial_rx_packet;
-static lora_rx_data_t rx_data_isr;
 
 static TimerEvent_t TxNextActReqTimer;
 
 static nvs_handle modlora_nvs_handle;
+static RTC_DATA_ATTR lora_rtc_session_t lora_rtc_session;
+static bool lora_rtc_session_active;        // route the NVS accessors to the RTC copy
+static bool lora_rtc_session_overflow;      // a blob didn't fit in the RTC copy
 static const char *modlora_nvs_data_key[E_LORA_NVS_NUM_KEYS] = { "JOINED", "UPLNK", "DWLNK", "DEVADDR",
                                                                  "NWSKEY", "APPSKEY", "NETID", "ADRACK",
                                                                  "MACPARAMS", "CHANNELS", "SRVACK", "MACNXTTX",
@@ -273,11 +394,24 @@ extern TaskHandle_t xLoRaTaskHndl;
  ******************************************************************************/
 static void TASK_LoRa (void *pvParameters);
 static void TASK_LoRa_Timer (void *pvParameters);
+static void lora_task_wake (void);
+static TickType_t lora_task_wait_ticks (bool lbt_retry);
+static bool lora_cmd_enqueue (lora_cmd_data_t *cmd_data, TickType_t timeout);
+static void lora_radio_acquire (void);
+static void lora_radio_release (void);
 static void OnTxDone (void);
 static void OnRxDone (uint8_t *payload, uint32_t timestamp, uint16_t size, int16_t rssi, int8_t snr, uint8_t sf);
 static void OnTxTimeout (void);
 static void OnRxTimeout (void);
 static void OnRxError (void);
+static void OnCadDone (bool channelActivityDetected);
+static void lora_cad_start_next (void);
+static bool lora_stream_tx_next (void);
+static void lora_csma_start (void);
+static void lora_csma_backoff (void);
+static void lora_csma_cad_done (void);
+static void lora_pkt_log_push (const lora_pkt_log_record_t *record);
+static void lora_pkt_log_tx_done (void);
 static void lora_radio_setup (lora_init_cmd_data_t *init_data);
 static void lora_validate_mode (uint32_t mode);
 static void lora_validate_frequency (uint32_t frequency);
@@ -291,7 +425,16 @@ static void lora_send_cmd (lora_cmd_data_t *cmd_data);
 static int32_t lora_send (const byte *buf, uint32_t len, uint32_t timeout_ms);
 static int32_t lora_recv (byte *buf, uint32_t len, int32_t timeout_ms, uint32_t *port);
 static bool lora_rx_any (void);
+static bool lora_rx_ring_alloc (uint32_t max_count);
+static void lora_rx_ring_reset (void);
+static bool lora_rx_ring_push (const uint8_t *data, uint32_t len, uint8_t port, int16_t rssi, bool from_isr);
+static bool lora_rx_ring_pop (lora_rx_data_t *rx_data);
 static bool lora_tx_space (void);
+static void lorawan_fill_tx_cmd (lora_cmd_data_t *cmd_data, const byte *buf, uint32_t len, bool confirmed, uint32_t dr, uint32_t port, uint32_t msgs);
+static int32_t lorawan_aggregate_send (const byte *buf, uint32_t len, uint32_t timeout_ms, bool confirmed, uint32_t dr, uint32_t port);
+static int32_t lorawan_aggregate_flush (uint32_t timeout_ms);
+static int lorawan_aggregate_push (uint32_t timeout_ms, int *_errno);
+static void OnAggregateTimerEvent (void);
 static void lora_callback_handler (void *arg);
 static bool lorawan_nvs_open (void);
 
@@ -321,9 +464,12 @@ SemaphoreHandle_t xLoRaSigfoxSem;
  ******************************************************************************/
 void modlora_init0(void) {
     xCmdQueue = xQueueCreate(LORA_CMD_QUEUE_SIZE_MAX, sizeof(lora_cmd_data_t));
-    xRxQueue = xQueueCreate(LORA_DATA_QUEUE_SIZE_MAX, sizeof(lora_rx_data_t));
+    xRxSem = xSemaphoreCreateCounting(LORA_RX_QUEUE_LEN_MAX, 0);
+    lora_rx_ring_alloc(LORA_DATA_QUEUE_SIZE_MAX);
     xCbQueue = xQueueCreate(LORA_CB_QUEUE_SIZE_MAX, sizeof(modlora_timerCallback));
     LoRaEvents = xEventGroupCreate();
+    xAggregateSem = xSemaphoreCreateMutex();
+    TimerInit(&AggregateTimer, OnAggregateTimerEvent);
 #if defined(FIPY) || defined(LOPY4)
     xLoRaSigfoxSem = xSemaphoreCreateMutex();
 #endif
@@ -336,11 +482,62 @@ void modlora_init0(void) {
     BoardInitMcu();
     BoardInitPeriph();
 
-    xTaskCreatePinnedToCore(TASK_LoRa, "LoRa", LORA_STACK_SIZE / sizeof(StackType_t), NULL, LORA_TASK_PRIORITY, &xLoRaTaskHndl, 1);
-    xTaskCreatePinnedToCore(TASK_LoRa_Timer, "LoRa_Timer_callback", LORA_TIMER_STACK_SIZE / sizeof(StackType_t), NULL, LORA_TIMER_TASK_PRIORITY, &xLoRaTimerTaskHndl, 1);
+    xTaskCreatePinnedToCore(TASK_LoRa, "LoRa", LORA_STACK_SIZE / sizeof(StackType_t), NULL, LORA_TASK_PRIORITY, &xLoRaTaskHndl, config_get_service_core());
+    xTaskCreatePinnedToCore(TASK_LoRa_Timer, "LoRa_Timer_callback", LORA_TIMER_STACK_SIZE / sizeof(StackType_t), NULL, LORA_TIMER_TASK_PRIORITY, &xLoRaTimerTaskHndl, config_get_service_core());
+}
+
+static uint32_t lora_rtc_session_crc (void) {
+    const uint8_t *start = (const uint8_t *)&lora_rtc_session.region;
+    return crc32_le(UINT32_MAX, start, sizeof(lora_rtc_session) - (start - (const uint8_t *)&lora_rtc_session));
+}
+
+static bool lora_rtc_session_is_valid (void) {
+    return lora_rtc_session.magic == MODLORA_RTC_SESSION_MAGIC && lora_rtc_session.crc == lora_rtc_session_crc();
+}
+
+static void lora_rtc_session_seal (void) {
+    lora_rtc_session.magic = MODLORA_RTC_SESSION_MAGIC;
+    lora_rtc_session.crc = lora_rtc_session_crc();
+}
+
+static void lora_rtc_session_invalidate (void) {
+    lora_rtc_session.magic = 0;
+}
+
+static bool lora_rtc_session_set_blob (uint32_t key_idx, const void *value, uint32_t length) {
+    if (!(lora_rtc_session.valid & (1 << key_idx))) {
+        // blobs get their slot the first time they are stored, the sizes don't change within a region
+        if (lora_rtc_session.blob_used + length > MODLORA_RTC_SESSION_BLOB_SIZE) {
+            lora_rtc_session_overflow = true;
+            return false;
+        }
+        lora_rtc_session.blob_offset[key_idx] = lora_rtc_session.blob_used;
+        lora_rtc_session.blob_len[key_idx] = length;
+        lora_rtc_session.blob_used += length;
+        lora_rtc_session.valid |= (1 << key_idx);
+    } else if (length != lora_rtc_session.blob_len[key_idx]) {
+        lora_rtc_session_overflow = true;
+        return false;
+    }
+    memcpy(&lora_rtc_session.blob[lora_rtc_session.blob_offset[key_idx]], value, length);
+    return true;
+}
+
+static bool lora_rtc_session_get_blob (uint32_t key_idx, void *value, uint32_t *length) {
+    if (!(lora_rtc_session.valid & (1 << key_idx)) || lora_rtc_session.blob_len[key_idx] > *length) {
+        return false;
+    }
+    *length = lora_rtc_session.blob_len[key_idx];
+    memcpy(value, &lora_rtc_session.blob[lora_rtc_session.blob_offset[key_idx]], *length);
+    return true;
 }
 
 bool modlora_nvs_set_uint(uint32_t key_idx, uint32_t value) {
+    if (lora_rtc_session_active) {
+        lora_rtc_session.values[key_idx] = value;
+        lora_rtc_session.valid |= (1 << key_idx);
+        return true;
+    }
     if (ESP_OK == nvs_set_u32(modlora_nvs_handle, modlora_nvs_data_key[key_idx], value)) {
         return true;
     }
@@ -348,6 +545,9 @@ bool modlora_nvs_set_uint(uint32_t key_idx, uint32_t value) {
 }
 
 bool modlora_nvs_set_blob(uint32_t key_idx, const void *value, uint32_t length) {
+    if (lora_rtc_session_active) {
+        return lora_rtc_session_set_blob(key_idx, value, length);
+    }
     if (ESP_OK == nvs_set_blob(modlora_nvs_handle, modlora_nvs_data_key[key_idx], value, length)) {
         return true;
     }
@@ -356,6 +556,13 @@ bool modlora_nvs_set_blob(uint32_t key_idx, const void *value, uint32_t length)
 
 bool modlora_nvs_get_uint(uint32_t key_idx, uint32_t *value) {
     esp_err_t err;
+    if (lora_rtc_session_active) {
+        if (lora_rtc_session.valid & (1 << key_idx)) {
+            *value = lora_rtc_session.values[key_idx];
+            return true;
+        }
+        return false;
+    }
     if (ESP_OK == (err = nvs_get_u32(modlora_nvs_handle, modlora_nvs_data_key[key_idx], value))) {
         return true;
     }
@@ -364,6 +571,9 @@ bool modlora_nvs_get_uint(uint32_t key_idx, uint32_t *value) {
 
 bool modlora_nvs_get_blob(uint32_t key_idx, void *value, uint32_t *length) {
     esp_err_t err;
+    if (lora_rtc_session_active) {
+        return lora_rtc_session_get_blob(key_idx, value, length);
+    }
     if (ESP_OK == (err = nvs_get_blob(modlora_nvs_handle, modlora_nvs_data_key[key_idx], value, length))) {
         return true;
     }
@@ -408,32 +618,50 @@ IRAM_ATTR void modlora_set_timer_callback(modlora_timerCallback cb)
 }
 
 #ifdef LORA_OPENTHREAD_ENABLED
-int lora_ot_recv(uint8_t *buf, int8_t *rssi) {
-
-    // put Lora into RX mode
-    int len = lora_recv (buf, OT_RADIO_FRAME_MAX_SIZE, 0, NULL);
-
-    if (len > 0) {
+void lora_ot_init(void) {
+    // control traffic of a large mesh comes in bursts, make room for it
+    if (lora_rx_ring.max_count < LORA_OT_RX_QUEUE_LEN) {
+        lora_rx_ring_alloc(LORA_OT_RX_QUEUE_LEN);
+    }
+}
 
-        // put rssi on signed 8bit, saturate at -128dB
-        if (lora_obj.rssi < INT8_MIN)
-            *rssi = INT8_MIN;
-        else
-            *rssi = lora_obj.rssi;
+int lora_ot_recv(uint8_t *buf, int8_t *rssi) {
+    static lora_rx_data_t rx_data;
 
-        otPlatLog(OT_LOG_LEVEL_INFO, 0, "radio rcv: %d, %d", len, *rssi);
+    if (!xSemaphoreTake(xRxSem, 0) || !lora_rx_ring_pop(&rx_data)) {
+        return 0;
     }
-    return len;
+    memcpy(buf, rx_data.data, rx_data.len);
+    // the rssi of this frame, not of the last one received
+    *rssi = rx_data.rssi;
+
+    otPlatLog(OT_LOG_LEVEL_INFO, 0, "radio rcv: %d, %d", rx_data.len, *rssi);
+    return rx_data.len;
 }
 
-void lora_ot_send(const uint8_t *buf, uint16_t len) {
+void lora_ot_send(const uint8_t *buf, uint16_t len, bool is_ack) {
+    lora_cmd_data_t cmd_data;
 
     // send max 255 bytes
     len = LORA_PAYLOAD_SIZE_MAX < len ? LORA_PAYLOAD_SIZE_MAX : len;
 
-    lora_send(buf, len, 0);
-
-    //otPlatLog(OT_LOG_LEVEL_INFO, 0, "radio TX: %d", len);
+    cmd_data.cmd = E_LORA_CMD_TX;
+    memcpy(cmd_data.info.tx.data, buf, len);
+    cmd_data.info.tx.len = len;
+    if (is_ack) {
+        // acks are sent without channel access, ahead of the frames already queued
+        cmd_data.info.tx.csma = false;
+        if (!xQueueSendToFront(xCmdQueue, (void *)&cmd_data, 0)) {
+            lora_tx_dropped++;
+            return;
+        }
+        lora_task_wake();
+    } else {
+        cmd_data.info.tx.csma = true;
+        if (!lora_cmd_enqueue(&cmd_data, 0)) {
+            lora_tx_dropped++;
+        }
+    }
 }
 #endif  // #ifdef LORA_OPENTHREAD_ENABLED
 
@@ -457,24 +685,29 @@ static bool lorawan_nvs_open (void) {
     return true;
 }
 
-static int32_t lorawan_send (const byte *buf, uint32_t len, uint32_t timeout_ms, bool confirmed, uint32_t dr, uint32_t port) {
-    lora_cmd_data_t cmd_data;
-
-    cmd_data.cmd = E_LORA_CMD_LORAWAN_TX;
-    memcpy (cmd_data.info.tx.data, buf, len);
-    cmd_data.info.tx.len = len;
-    cmd_data.info.tx.dr = dr;
+static void lorawan_fill_tx_cmd (lora_cmd_data_t *cmd_data, const byte *buf, uint32_t len, bool confirmed, uint32_t dr, uint32_t port, uint32_t msgs) {
+    cmd_data->cmd = E_LORA_CMD_LORAWAN_TX;
+    memcpy (cmd_data->info.tx.data, buf, len);
+    cmd_data->info.tx.len = len;
+    cmd_data->info.tx.dr = dr;
+    cmd_data->info.tx.msgs = msgs;
     if (lora_obj.ComplianceTest.Enabled && lora_obj.ComplianceTest.Running) {
-        cmd_data.info.tx.port = 224;  // MAC commands port
+        cmd_data->info.tx.port = 224;  // MAC commands port
         if (lora_obj.ComplianceTest.IsTxConfirmed) {
-            cmd_data.info.tx.confirmed = true;
+            cmd_data->info.tx.confirmed = true;
         } else {
-            cmd_data.info.tx.confirmed = false;
+            cmd_data->info.tx.confirmed = false;
         }
     } else {
-        cmd_data.info.tx.confirmed = confirmed;
-        cmd_data.info.tx.port = port;    // data port
+        cmd_data->info.tx.confirmed = confirmed;
+        cmd_data->info.tx.port = port;    // data port
     }
+}
+
+static int32_t lorawan_send (const byte *buf, uint32_t len, uint32_t timeout_ms, bool confirmed, uint32_t dr, uint32_t port, uint32_t msgs) {
+    lora_cmd_data_t cmd_data;
+
+    lorawan_fill_tx_cmd(&cmd_data, buf, len, confirmed, dr, port, msgs);
 
     if (timeout_ms < 0) {
         // blocking mode
@@ -484,7 +717,7 @@ static int32_t lorawan_send (const byte *buf, uint32_t len, uint32_t timeout_ms,
     xEventGroupClearBits(LoRaEvents, LORA_STATUS_COMPLETED | LORA_STATUS_ERROR | LORA_STATUS_MSG_SIZE);
 
     // just pass to the LoRa queue
-    if (!xQueueSend(xCmdQueue, (void *)&cmd_data, (TickType_t)(timeout_ms / portTICK_PERIOD_MS))) {
+    if (!lora_cmd_enqueue(&cmd_data, (TickType_t)(timeout_ms / portTICK_PERIOD_MS))) {
         return 0;
     }
 
@@ -511,8 +744,124 @@ static int32_t lorawan_send (const byte *buf, uint32_t len, uint32_t timeout_ms,
     return len;
 }
 
+// must be called with xAggregateSem taken
+static int32_t lorawan_aggregate_flush (uint32_t timeout_ms) {
+    TimerStop(&AggregateTimer);
+    if (lora_aggregate.count == 0) {
+        return 0;
+    }
+    if (timeout_ms == 0 && !lora_tx_space()) {
+        // keep the messages and let the timer try again
+        TimerSetValue(&AggregateTimer, LORA_AGGREGATE_RETRY_MS);
+        TimerStart(&AggregateTimer);
+        return 0;
+    }
+    int32_t n_bytes = lorawan_send(lora_aggregate.data, lora_aggregate.len, timeout_ms,
+                                   lora_aggregate.confirmed, lora_aggregate.dr, lora_aggregate.port, lora_aggregate.count);
+    lora_aggregate.len = 0;
+    lora_aggregate.count = 0;
+    return n_bytes;
+}
+
+static int32_t lorawan_aggregate_send (const byte *buf, uint32_t len, uint32_t timeout_ms, bool confirmed, uint32_t dr, uint32_t port) {
+    xSemaphoreTake(xAggregateSem, portMAX_DELAY);
+    // the message must fit in a frame on its own, including its length byte
+    if (len >= LORA_PAYLOAD_SIZE_MAX || false == ValidatePayloadLength(len + 1, dr, 0)) {
+        xSemaphoreGive(xAggregateSem);
+        return -1;
+    }
+
+    if (lora_aggregate.count > 0 &&
+        (lora_aggregate.port != port || lora_aggregate.dr != dr || lora_aggregate.confirmed != confirmed ||
+         false == ValidatePayloadLength(lora_aggregate.len + len + 1, dr, 0))) {
+        // different frame parameters or no room left, send what we have first
+        lorawan_aggregate_flush(timeout_ms);
+        if (lora_aggregate.count > 0) {
+            xSemaphoreGive(xAggregateSem);
+            return 0;
+        }
+    }
+
+    lora_aggregate.data[lora_aggregate.len++] = len;
+    memcpy(&lora_aggregate.data[lora_aggregate.len], buf, len);
+    lora_aggregate.len += len;
+    if (lora_aggregate.count++ == 0) {
+        lora_aggregate.port = port;
+        lora_aggregate.dr = dr;
+        lora_aggregate.confirmed = confirmed;
+        TimerSetValue(&AggregateTimer, lora_aggregate.deadline_ms);
+        TimerStart(&AggregateTimer);
+    }
+
+    if (false == ValidatePayloadLength(lora_aggregate.len + 2, dr, 0)) {
+        // not even a 1 byte message would fit anymore
+        lorawan_aggregate_flush(timeout_ms);
+    }
+    xSemaphoreGive(xAggregateSem);
+    return len;
+}
+
+static int lorawan_aggregate_push (uint32_t timeout_ms, int *_errno) {
+    int32_t n_bytes = 1;
+
+    xSemaphoreTake(xAggregateSem, portMAX_DELAY);
+    if (lora_aggregate.count > 0) {
+        n_bytes = lorawan_aggregate_flush(timeout_ms);
+    }
+    xSemaphoreGive(xAggregateSem);
+
+    if (n_bytes == 0) {
+        *_errno = MP_EAGAIN;
+        return -1;
+    } else if (n_bytes < 0) {
+        *_errno = MP_EMSGSIZE;
+        return -1;
+    }
+    return 0;
+}
+
+static void OnAggregateTimerEvent (void) {
+    lora_cmd_data_t cmd_data;
+
+    // the deadline expired, hand the frame to the LoRa task without blocking the timer task
+    if (xSemaphoreTake(xAggregateSem, 0) != pdTRUE) {
+        TimerSetValue(&AggregateTimer, LORA_AGGREGATE_RETRY_MS);
+        TimerStart(&AggregateTimer);
+        return;
+    }
+    if (lora_aggregate.count > 0) {
+        lorawan_fill_tx_cmd(&cmd_data, lora_aggregate.data, lora_aggregate.len, lora_aggregate.confirmed,
+                            lora_aggregate.dr, lora_aggregate.port, lora_aggregate.count);
+        if (lora_cmd_enqueue(&cmd_data, 0)) {
+            lora_aggregate.len = 0;
+            lora_aggregate.count = 0;
+        } else {
+            TimerSetValue(&AggregateTimer, LORA_AGGREGATE_RETRY_MS);
+            TimerStart(&AggregateTimer);
+        }
+    }
+    xSemaphoreGive(xAggregateSem);
+}
+
 static void McpsConfirm (McpsConfirm_t *McpsConfirm) {
     uint32_t status = LORA_STATUS_COMPLETED;
+
+    if (lora_pkt_log.records) {
+        lora_pkt_log_record_t record = { .timestamp = mp_hal_ticks_us_non_blocking(),
+                                         .frequency = McpsConfirm->UpLinkFrequency,
+                                         .airtime = McpsConfirm->TxTimeOnAir,
+                                         .flags = MODLORA_PKT_LOG_TX | MODLORA_PKT_LOG_LORAWAN,
+                                         .dr = McpsConfirm->Datarate,
+                                         .tx_power = McpsConfirm->TxPower,
+                                         .retries = McpsConfirm->NbRetries };
+        if (McpsConfirm->AckReceived) {
+            record.flags |= MODLORA_PKT_LOG_ACK;
+        }
+        if (McpsConfirm->Status != LORAMAC_EVENT_INFO_STATUS_OK) {
+            record.flags |= MODLORA_PKT_LOG_FAILED;
+        }
+        lora_pkt_log_push(&record);
+    }
     if (McpsConfirm->Status == LORAMAC_EVENT_INFO_STATUS_OK) {
         // save the values before calling the event handler
         lora_obj.sftx = McpsConfirm->Datarate;
@@ -524,6 +873,8 @@ static void McpsConfirm (McpsConfirm_t *McpsConfirm) {
 
         switch (McpsConfirm->McpsRequest) {
             case MCPS_UNCONFIRMED: {
+                lora_tx_msgs_delivered += lora_tx_msgs_in_flight;
+                lora_tx_msgs_in_flight = 0;
                 lora_obj.events |= MODLORA_TX_EVENT;
                 if (lora_obj.trigger & MODLORA_TX_EVENT) {
                     mp_irq_queue_interrupt(lora_callback_handler, (void *)&lora_obj);
@@ -535,6 +886,8 @@ static void McpsConfirm (McpsConfirm_t *McpsConfirm) {
             case MCPS_CONFIRMED:
                 lora_obj.tx_trials = McpsConfirm->NbRetries;
                 if (McpsConfirm->AckReceived) {
+                    lora_tx_msgs_delivered += lora_tx_msgs_in_flight;
+                    lora_tx_msgs_in_flight = 0;
                     lora_obj.events |= MODLORA_TX_EVENT;
                     if (lora_obj.trigger & MODLORA_TX_EVENT) {
                         mp_irq_queue_interrupt(lora_callback_handler, (void *)&lora_obj);
@@ -551,6 +904,8 @@ static void McpsConfirm (McpsConfirm_t *McpsConfirm) {
                 break;
         }
     } else {
+        lora_tx_msgs_failed += lora_tx_msgs_in_flight;
+        lora_tx_msgs_in_flight = 0;
         lora_obj.events |= MODLORA_TX_FAILED_EVENT;
         if (lora_obj.trigger & MODLORA_TX_FAILED_EVENT) {
             mp_irq_queue_interrupt(lora_callback_handler, (void *)&lora_obj);
@@ -559,9 +914,7 @@ static void McpsConfirm (McpsConfirm_t *McpsConfirm) {
         status |= LORA_STATUS_ERROR;
         xEventGroupSetBits(LoRaEvents, status);
     }
-#if defined(FIPY) || defined(LOPY4)
-    xSemaphoreGive(xLoRaSigfoxSem);
-#endif
+    lora_radio_release();
 }
 
 static void McpsIndication (McpsIndication_t *mcpsIndication) {
@@ -599,6 +952,17 @@ static void McpsIndication (McpsIndication_t *mcpsIndication) {
     lora_obj.snr = mcpsIndication->Snr;
     lora_obj.sfrx = mcpsIndication->RxDatarate;
 
+    if (lora_pkt_log.records) {
+        lora_pkt_log_record_t record = { .timestamp = mcpsIndication->TimeStamp,
+                                         .rssi = mcpsIndication->Rssi,
+                                         .snr = (int8_t)mcpsIndication->Snr,
+                                         .flags = MODLORA_PKT_LOG_LORAWAN,
+                                         .dr = mcpsIndication->RxDatarate,
+                                         .rx_window = mcpsIndication->RxSlot,
+                                         .size = mcpsIndication->BufferSize };
+        lora_pkt_log_push(&record);
+    }
+
     if ((mcpsIndication->Port == 224) && (lora_obj.ComplianceTest.Enabled == true)
         && (lora_obj.ComplianceTest.Running == true)) {
        MibRequestConfirm_t mibReq;
@@ -622,10 +986,7 @@ static void McpsIndication (McpsIndication_t *mcpsIndication) {
     if (mcpsIndication->RxData && mcpsIndication->BufferSize > 0) {
         if (mcpsIndication->Port > 0 && mcpsIndication->Port < 224) {
             if (mcpsIndication->BufferSize <= LORA_PAYLOAD_SIZE_MAX) {
-                memcpy((void *)rx_data_isr.data, mcpsIndication->Buffer, mcpsIndication->BufferSize);
-                rx_data_isr.len = mcpsIndication->BufferSize;
-                rx_data_isr.port = mcpsIndication->Port;
-                xQueueSend(xRxQueue, (void *)&rx_data_isr, 0);
+                lora_rx_ring_push(mcpsIndication->Buffer, mcpsIndication->BufferSize, mcpsIndication->Port, mcpsIndication->Rssi, false);
                 lora_obj.events |= MODLORA_RX_EVENT;
                 if (lora_obj.trigger & MODLORA_RX_EVENT) {
                     mp_irq_queue_interrupt(lora_callback_handler, (void *)&lora_obj);
@@ -652,7 +1013,7 @@ static void McpsIndication (McpsIndication_t *mcpsIndication) {
                         lora_obj.ComplianceTest.State = 1;
 
                         // flush the rx queue
-                        xQueueReset(xRxQueue);
+                        lora_rx_ring_reset();
 
                         // enable ADR during test mode
                         MibRequestConfirm_t mibReq;
@@ -699,9 +1060,7 @@ static void McpsIndication (McpsIndication_t *mcpsIndication) {
                         // return the payload
                         if (bDoEcho) {
                             if (mcpsIndication->BufferSize <= LORA_PAYLOAD_SIZE_MAX) {
-                                memcpy((void *)rx_data_isr.data, mcpsIndication->Buffer, mcpsIndication->BufferSize);
-                                rx_data_isr.len = mcpsIndication->BufferSize;
-                                xQueueSend(xRxQueue, (void *)&rx_data_isr, 0);
+                                lora_rx_ring_push(mcpsIndication->Buffer, mcpsIndication->BufferSize, 0, mcpsIndication->Rssi, false);
                             }
                         } else {
                             // set the state back to 1
@@ -753,9 +1112,7 @@ static void MlmeConfirm (MlmeConfirm_t *MlmeConfirm) {
                 break;
         }
     }
-#if defined(FIPY) || defined(LOPY4)
-    xSemaphoreGive(xLoRaSigfoxSem);
-#endif
+    lora_radio_release();
 }
 
 static void OnTxNextActReqTimerEvent(void) {
@@ -801,8 +1158,16 @@ static void TASK_LoRa (void *pvParameters) {
     lora_obj.state = E_LORA_STATE_NOINIT;
     lora_obj.pwr_mode = E_LORA_MODE_ALWAYS_ON;
 
+    bool lbt_retry = false;
+
+    taskwdt_register(TASKWDT_LORA_TIMEOUT_MS);
+
     for ( ; ; ) {
-        vTaskDelay (2 / portTICK_PERIOD_MS);
+        // sleep until a command, a radio event or a MAC timer needs us
+        taskwdt_sleeping(true);
+        ulTaskNotifyTake(pdTRUE, lora_task_wait_ticks(lbt_retry));
+        taskwdt_sleeping(false);
+        lbt_retry = false;
 
         if(lora_obj.reset)
         {
@@ -946,6 +1311,7 @@ static void TASK_LoRa (void *pvParameters) {
                         RadioEvents.TxTimeout = OnTxTimeout;
                         RadioEvents.RxTimeout = OnRxTimeout;
                         RadioEvents.RxError = OnRxError;
+                        RadioEvents.CadDone = OnCadDone;
                         Radio.Init(&RadioEvents);
 
                         // radio configuration
@@ -977,21 +1343,25 @@ static void TASK_LoRa (void *pvParameters) {
                     lora_obj.state = E_LORA_STATE_JOIN;
                     break;
                 case E_LORA_CMD_TX:
+                    if (task_cmd_data.info.tx.csma) {
+                        // sent by lora_csma_cad_done() once a CAD finds the channel free
+                        lora_csma_start();
+                        break;
+                    }
                     // implement Listen-before-Talk LBT, only for LoRa RAW (not LoRaWAN)
                     if (lora_lbt_is_free()) {
                         // no activity detected on Lora, so send the pack now
 
-                        // taking sigfox semaphore blocks ?!?!?
-                        // maybe, in the end of TX sempahore has to be released sooner
-//                        #if defined(FIPY) || defined(LOPY4)
-//                            xSemaphoreTake(xLoRaSigfoxSem, portMAX_DELAY);
-//                        #endif
+                        // released again in E_LORA_STATE_TX_DONE / E_LORA_STATE_TX_TIMEOUT, or
+                        // at the end of the packet train in streaming mode
+                        lora_radio_acquire();
                         Radio.Send(task_cmd_data.info.tx.data, task_cmd_data.info.tx.len);
                         lora_obj.state = E_LORA_STATE_TX;
                     } else {
                         // activity detected on Lora, so put the TX command back on queue on Front
                         // to be executed on next Lora task
                         xQueueSendToFront(xCmdQueue, (void *)&task_cmd_data, (TickType_t)portMAX_DELAY);
+                        lbt_retry = true;
                     }
                     break;
                 case E_LORA_CMD_CONFIG_CHANNEL:
@@ -1045,9 +1415,7 @@ static void TASK_LoRa (void *pvParameters) {
                                 mcpsReq.Req.Unconfirmed.Datarate = task_cmd_data.info.tx.dr;
                             }
                         }
-                    #if defined(FIPY) || defined(LOPY4)
-                        xSemaphoreTake(xLoRaSigfoxSem, portMAX_DELAY);
-                    #endif
+                        lora_radio_acquire();
 
                         // set back the original datarate
                         if (!lora_obj.adr) {
@@ -1057,13 +1425,13 @@ static void TASK_LoRa (void *pvParameters) {
 
                         if (LoRaMacMcpsRequest(&mcpsReq) != LORAMAC_STATUS_OK || empty_frame) {
                             // the command has failed, send the response now
+                            lora_tx_msgs_failed += task_cmd_data.info.tx.msgs;
                             lora_obj.state = E_LORA_STATE_IDLE;
                             status |= LORA_STATUS_ERROR;
                             xEventGroupSetBits(LoRaEvents, status);
-                        #if defined(FIPY) || defined(LOPY4)
-                            xSemaphoreGive(xLoRaSigfoxSem);
-                        #endif
+                            lora_radio_release();
                         } else {
+                            lora_tx_msgs_in_flight = task_cmd_data.info.tx.msgs;
                             lora_obj.state = E_LORA_STATE_TX;
                         }
                     }
@@ -1072,18 +1440,23 @@ static void TASK_LoRa (void *pvParameters) {
                     Radio.Sleep();
                     lora_obj.state = E_LORA_STATE_SLEEP;
                     xEventGroupSetBits(LoRaEvents, LORA_STATUS_COMPLETED);
-                #if defined(FIPY) || defined(LOPY4)
-                    xSemaphoreGive(xLoRaSigfoxSem);
-                #endif
+                    lora_radio_release();
                     break;
                 case E_LORA_CMD_WAKE_UP:
+                    // Sigfox might have used the radio while we were asleep
+                    lora_radio_acquire();
                     // just enable the receiver again
                     Radio.Rx(LORA_RX_TIMEOUT);
                     lora_obj.state = E_LORA_STATE_RX;
                     xEventGroupSetBits(LoRaEvents, LORA_STATUS_COMPLETED);
-                #if defined(FIPY) || defined(LOPY4)
-                    xSemaphoreGive(xLoRaSigfoxSem);
-                #endif
+                    lora_radio_release();
+                    break;
+                case E_LORA_CMD_CAD:
+                    // the caller doesn't wait, the result is reported with MODLORA_CAD_EVENT
+                    memcpy(&lora_cad.params, &task_cmd_data.info.cad, sizeof(lora_cad.params));
+                    lora_cad.detected = 0;
+                    lora_cad.index = 0;
+                    lora_cad_start_next();
                     break;
                 default:
                     break;
@@ -1097,9 +1470,7 @@ static void TASK_LoRa (void *pvParameters) {
             TimerStop( &TxNextActReqTimer );
             if (!lora_obj.joined) {
                 if (lora_obj.activation == E_LORA_ACTIVATION_OTAA) {
-                #if defined(FIPY) || defined(LOPY4)
-                    xSemaphoreTake(xLoRaSigfoxSem, portMAX_DELAY);
-                #endif
+                    lora_radio_acquire();
                     mibReq.Type = MIB_NETWORK_ACTIVATION;
                     mibReq.Param.NetworkActivation = ACTIVATION_TYPE_OTAA;
                     LoRaMacMibSetRequestConfirm( &mibReq );
@@ -1151,24 +1522,75 @@ static void TASK_LoRa (void *pvParameters) {
         case E_LORA_STATE_RX_DONE:
         case E_LORA_STATE_RX_TIMEOUT:
         case E_LORA_STATE_RX_ERROR:
-            // we need to perform a mode transition in order to clear the TxRx FIFO
-            Radio.Sleep();
-            //lora_obj.state = E_LORA_STATE_IDLE;
-            lora_obj.state = E_LORA_STATE_RX;
-            Radio.Rx(LORA_RX_TIMEOUT);
+            if (lora_obj.stream) {
+                // the radio stays in continuous reception and the driver reads every
+                // packet out of the FIFO, so there's nothing to re-arm
+                lora_obj.state = E_LORA_STATE_RX;
+            } else {
+                // we need to perform a mode transition in order to clear the TxRx FIFO
+                Radio.Sleep();
+                //lora_obj.state = E_LORA_STATE_IDLE;
+                lora_obj.state = E_LORA_STATE_RX;
+                Radio.Rx(LORA_RX_TIMEOUT);
+            }
+            if (lora_csma.busy) {
+                // a frame arrived during the backoff, carry on with it
+                lora_obj.state = E_LORA_STATE_CSMA_BACKOFF;
+            }
+            break;
+        case E_LORA_STATE_CSMA_BACKOFF:
+            if ((int32_t)(xTaskGetTickCount() - lora_csma.backoff_until) >= 0) {
+                Radio.Standby();
+                lora_cad.activity = false;
+                lora_cad.started = xTaskGetTickCount();
+                lora_obj.state = E_LORA_STATE_CAD;
+                Radio.StartCad();
+            }
             break;
         case E_LORA_STATE_TX:
             break;
+        case E_LORA_STATE_CAD:
+            if ((xTaskGetTickCount() - lora_cad.started) < (LORA_CAD_TIMEOUT_MS / portTICK_PERIOD_MS)) {
+                break;
+            }
+            // the CAD done interrupt never came, count it as no activity
+            lora_cad.activity = false;
+            // fall through
+        case E_LORA_STATE_CAD_DONE:
+            if (lora_csma.busy) {
+                lora_csma_cad_done();
+                break;
+            }
+            if (lora_cad.activity) {
+                lora_cad.detected |= ((uint64_t)1 << lora_cad.index);
+            }
+            if (++lora_cad.index < (lora_cad.params.n_freq * lora_cad.params.n_sf)) {
+                lora_cad_start_next();
+            } else {
+                // put back the user's channel and radio settings, this also restores the rx/sleep state
+                lora_cmd_data_t cmd_data;
+                lora_get_config(&cmd_data);
+                lora_radio_setup(&cmd_data.info.init);
+                lora_cad.busy = false;
+                lora_obj.events |= MODLORA_CAD_EVENT;
+                if (lora_obj.trigger & MODLORA_CAD_EVENT) {
+                    mp_irq_queue_interrupt(lora_callback_handler, (void *)&lora_obj);
+                }
+            }
+            break;
         case E_LORA_STATE_TX_DONE:
+            lora_pkt_log_tx_done();
+            if (lora_obj.stream && lora_stream_tx_next()) {
+                xEventGroupSetBits(LoRaEvents, LORA_STATUS_COMPLETED);
+                break;
+            }
             // we need to perform a mode transition in order to clear the TxRx FIFO
             Radio.Sleep();
             xEventGroupSetBits(LoRaEvents, LORA_STATUS_COMPLETED);
             //lora_obj.state = E_LORA_STATE_IDLE;
             lora_obj.state = E_LORA_STATE_RX;
             Radio.Rx(LORA_RX_TIMEOUT);
-        #if defined(FIPY) || defined(LOPY4)
-            xSemaphoreGive(xLoRaSigfoxSem);
-        #endif
+            lora_radio_release();
             break;
         case E_LORA_STATE_TX_TIMEOUT:
             // we need to perform a mode transition in order to clear the TxRx FIFO
@@ -1177,14 +1599,15 @@ static void TASK_LoRa (void *pvParameters) {
             //lora_obj.state = E_LORA_STATE_IDLE;
             lora_obj.state = E_LORA_STATE_RX;
             Radio.Rx(LORA_RX_TIMEOUT);
-        #if defined(FIPY) || defined(LOPY4)
-            xSemaphoreGive(xLoRaSigfoxSem);
-        #endif
+            lora_radio_release();
             break;
         default:
             break;
         }
 
+        // the radio events come over SPI and the DIO lines, neither survives a light sleep
+        pwrmgr_hold(PWRMGR_LORA, lora_obj.state != E_LORA_STATE_NOINIT && lora_obj.state != E_LORA_STATE_IDLE &&
+                                 lora_obj.state != E_LORA_STATE_SLEEP);
         TimerLowPowerHandler();
     }
 }
@@ -1199,6 +1622,8 @@ static void TASK_LoRa_Timer (void *pvParameters) {
             if(cb != NULL)
             {
                 cb();
+                // the MAC timers drive the LoRaWAN state machine, let the LoRa task catch up
+                lora_task_wake();
             }
         }
     }
@@ -1246,23 +1671,122 @@ static void lora_callback_handler(void *arg) {
     }
 }
 
+static IRAM_ATTR void lora_task_wake (void) {
+    if (xLoRaTaskHndl == NULL) {
+        return;
+    }
+    // the radio events are raised either by the DIO interrupts or by the timer task
+    if (xPortInIsrContext()) {
+        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+        vTaskNotifyGiveFromISR(xLoRaTaskHndl, &xHigherPriorityTaskWoken);
+        if (xHigherPriorityTaskWoken) {
+            portYIELD_FROM_ISR();
+        }
+    } else {
+        xTaskNotifyGive(xLoRaTaskHndl);
+    }
+}
+
+#if defined(FIPY) || defined(LOPY4)
+static void lora_radio_reclaim (void) {
+    // Sigfox drives the transceiver in FSK/OOK mode, so if the long range bit is gone
+    // it has been used since we last had it. Only the radio registers are restored,
+    // the MAC and the Sigfox library state are both kept warm.
+    if (Radio.Read(REG_LR_OPMODE) & RFLR_OPMODE_LONGRANGEMODE_ON) {
+        return;
+    }
+    Radio.Restore();
+    if (lora_obj.stack_mode == E_LORA_STACK_MODE_LORA) {
+        // the LoRaWAN MAC programs the radio before every Tx/Rx window, raw LoRa doesn't
+        lora_cmd_data_t cmd_data;
+        lora_get_config(&cmd_data);
+        lora_radio_setup(&cmd_data.info.init);
+    } else {
+        Radio.SetModem(MODEM_LORA);
+    }
+}
+#endif
+
+static void lora_radio_acquire (void) {
+#if defined(FIPY) || defined(LOPY4)
+    // the mutex hands the radio to the highest priority waiter (with priority inheritance),
+    // and a task which already owns it must not take it twice
+    if (xSemaphoreGetMutexHolder(xLoRaSigfoxSem) != xTaskGetCurrentTaskHandle()) {
+        xSemaphoreTake(xLoRaSigfoxSem, portMAX_DELAY);
+    }
+    lora_radio_reclaim();
+#endif
+}
+
+static void lora_radio_release (void) {
+#if defined(FIPY) || defined(LOPY4)
+    xSemaphoreGive(xLoRaSigfoxSem);
+#endif
+}
+
+static TickType_t lora_task_wait_ticks (bool lbt_retry) {
+    if (lbt_retry) {
+        // the channel was busy, sense it again shortly
+        return LORA_TASK_LBT_RETRY_MS / portTICK_PERIOD_MS;
+    }
+    switch (lora_obj.state) {
+    case E_LORA_STATE_NOINIT:
+    case E_LORA_STATE_IDLE:
+    case E_LORA_STATE_RX:
+    case E_LORA_STATE_SLEEP:
+    case E_LORA_STATE_RESET:
+        if (uxQueueMessagesWaiting(xCmdQueue) > 0) {
+            return 0;
+        }
+        return portMAX_DELAY;
+    case E_LORA_STATE_TX:
+        // the radio or the MAC will wake us up when the transmission ends
+        return portMAX_DELAY;
+    case E_LORA_STATE_CAD:
+        return LORA_CAD_TIMEOUT_MS / portTICK_PERIOD_MS;
+    case E_LORA_STATE_CSMA_BACKOFF: {
+        int32_t ticks = lora_csma.backoff_until - xTaskGetTickCount();
+        return (ticks > 0) ? ticks : 0;
+    }
+    default:
+        // transitional states are handled right away
+        return 0;
+    }
+}
+
+static bool lora_cmd_enqueue (lora_cmd_data_t *cmd_data, TickType_t timeout) {
+    if (!xQueueSend(xCmdQueue, (void *)cmd_data, timeout)) {
+        return false;
+    }
+    lora_task_wake();
+    return true;
+}
+
 static IRAM_ATTR void OnTxDone (void) {
+    TRACE_INSTANT(TRACE_EV_LORA_TX_DONE, 0);
     lora_obj.events |= MODLORA_TX_EVENT;
     if (lora_obj.trigger & MODLORA_TX_EVENT) {
         mp_irq_queue_interrupt(lora_callback_handler, (void *)&lora_obj);
     }
     lora_obj.state = E_LORA_STATE_TX_DONE;
+    lora_task_wake();
 }
 
 static IRAM_ATTR void OnRxDone (uint8_t *payload, uint32_t timestamp, uint16_t size, int16_t rssi, int8_t snr, uint8_t sf) {
+    TRACE_INSTANT(TRACE_EV_LORA_RX_DONE, size);
     lora_obj.rx_timestamp = timestamp;
     lora_obj.rssi = rssi;
     lora_obj.snr = snr;
     lora_obj.sfrx = sf;
     if (size <= LORA_PAYLOAD_SIZE_MAX) {
-        memcpy((void *)rx_data_isr.data, payload, size);
-        rx_data_isr.len = size;
-        xQueueSendFromISR(xRxQueue, (void *)&rx_data_isr, NULL);
+        lora_rx_ring_push(payload, size, 0, rssi, true);
+    }
+    if (lora_pkt_log.records) {
+        // the radio callbacks run in the LoRa timer task, not in the interrupt
+        lora_pkt_log_record_t record = { .timestamp = timestamp, .frequency = lora_obj.frequency,
+                                         .airtime = Radio.TimeOnAir(MODEM_LORA, size),
+                                         .rssi = rssi, .snr = snr, .dr = sf, .size = size };
+        lora_pkt_log_push(&record);
     }
 
     lora_obj.events |= MODLORA_RX_EVENT;
@@ -1271,18 +1795,120 @@ static IRAM_ATTR void OnRxDone (uint8_t *payload, uint32_t timestamp, uint16_t s
     }
 
     lora_obj.state = E_LORA_STATE_RX_DONE;
+    lora_task_wake();
 }
 
 static IRAM_ATTR void OnTxTimeout (void) {
+    TRACE_INSTANT(TRACE_EV_LORA_TIMEOUT, 0);
     lora_obj.state = E_LORA_STATE_TX_TIMEOUT;
+    lora_task_wake();
 }
 
 static IRAM_ATTR void OnRxTimeout (void) {
+    TRACE_INSTANT(TRACE_EV_LORA_TIMEOUT, 1);
     lora_obj.state = E_LORA_STATE_RX_TIMEOUT;
+    lora_task_wake();
 }
 
 static IRAM_ATTR void OnRxError (void) {
     lora_obj.state = E_LORA_STATE_RX_ERROR;
+    lora_task_wake();
+}
+
+static IRAM_ATTR void OnCadDone (bool channelActivityDetected) {
+    lora_cad.activity = channelActivityDetected;
+    lora_obj.state = E_LORA_STATE_CAD_DONE;
+    lora_task_wake();
+}
+
+static void lora_cad_start_next (void) {
+    uint32_t freq = lora_cad.params.frequency[lora_cad.index / lora_cad.params.n_sf];
+    uint8_t sf = lora_cad.params.sf[lora_cad.index % lora_cad.params.n_sf];
+
+    Radio.Standby();
+    Radio.SetChannel(freq);
+    Radio.SetRxConfig(MODEM_LORA, lora_obj.bandwidth, sf, lora_obj.coding_rate, 0, lora_obj.preamble,
+                      8, LORA_FIX_LENGTH_PAYLOAD_OFF, 0, true, 0, 0, lora_obj.rxiq, true);
+    lora_cad.activity = false;
+    lora_cad.started = xTaskGetTickCount();
+    lora_obj.state = E_LORA_STATE_CAD;
+    Radio.StartCad();
+}
+
+// sends the next queued raw packet right after the previous one, the radio is
+// already in standby and the channel was sensed before the first packet
+static bool lora_stream_tx_next (void) {
+    if (!xQueuePeek(xCmdQueue, (void *)&task_cmd_data, 0) || task_cmd_data.cmd != E_LORA_CMD_TX ||
+        task_cmd_data.info.tx.csma) {
+        return false;
+    }
+    xQueueReceive(xCmdQueue, (void *)&task_cmd_data, 0);
+    Radio.Send(task_cmd_data.info.tx.data, task_cmd_data.info.tx.len);
+    lora_obj.state = E_LORA_STATE_TX;
+    return true;
+}
+
+static void lora_csma_start (void) {
+    lora_csma.nb = 0;
+    lora_csma.be = LORA_CSMA_MIN_BE;
+    lora_csma.busy = true;
+    // like 802.15.4, back off before the first assessment as well, so that the nodes that
+    // heard the same frame don't all answer at once
+    lora_csma_backoff();
+}
+
+static void lora_csma_backoff (void) {
+    uint32_t units = rng_get() & ((1 << lora_csma.be) - 1);
+    lora_csma.backoff_until = xTaskGetTickCount() + ((units * LORA_CSMA_BACKOFF_UNIT_MS) / portTICK_PERIOD_MS);
+    // keep receiving meanwhile
+    lora_obj.state = E_LORA_STATE_CSMA_BACKOFF;
+}
+
+static void lora_csma_cad_done (void) {
+    if (!lora_cad.activity) {
+        lora_csma.busy = false;
+        // released again in E_LORA_STATE_TX_DONE / E_LORA_STATE_TX_TIMEOUT
+        lora_radio_acquire();
+        Radio.Send(task_cmd_data.info.tx.data, task_cmd_data.info.tx.len);
+        lora_obj.state = E_LORA_STATE_TX;
+        return;
+    }
+    Radio.Rx(LORA_RX_TIMEOUT);
+    if (++lora_csma.nb > LORA_CSMA_MAX_BACKOFFS) {
+        // channel access failure, the MAC retransmits when the ack doesn't come
+        lora_csma.busy = false;
+        lora_csma.failures++;
+        lora_obj.state = E_LORA_STATE_RX;
+    } else {
+        if (lora_csma.be < LORA_CSMA_MAX_BE) {
+            lora_csma.be++;
+        }
+        lora_csma_backoff();
+    }
+}
+
+static void lora_pkt_log_push (const lora_pkt_log_record_t *record) {
+    portENTER_CRITICAL(&lora_pkt_log_mux);
+    if (lora_pkt_log.records) {
+        lora_pkt_log.records[lora_pkt_log.head] = *record;
+        lora_pkt_log.head = (lora_pkt_log.head + 1) % lora_pkt_log.size;
+        if (lora_pkt_log.count < lora_pkt_log.size) {
+            lora_pkt_log.count++;
+        }
+    }
+    portEXIT_CRITICAL(&lora_pkt_log_mux);
+}
+
+// logs the raw LoRa packet in task_cmd_data that has just been sent
+static void lora_pkt_log_tx_done (void) {
+    if (lora_pkt_log.records) {
+        lora_pkt_log_record_t record = { .timestamp = mp_hal_ticks_us_non_blocking(),
+                                         .frequency = lora_obj.frequency,
+                                         .airtime = Radio.TimeOnAir(MODEM_LORA, task_cmd_data.info.tx.len),
+                                         .flags = MODLORA_PKT_LOG_TX, .dr = lora_obj.sf,
+                                         .tx_power = lora_obj.tx_power, .size = task_cmd_data.info.tx.len };
+        lora_pkt_log_push(&record);
+    }
 }
 
 static void lora_radio_setup (lora_init_cmd_data_t *init_data) {
@@ -1300,13 +1926,13 @@ static void lora_radio_setup (lora_init_cmd_data_t *init_data) {
 
     Radio.SetTxConfig(MODEM_LORA, init_data->tx_power, 0, init_data->bandwidth,
                                   init_data->sf, init_data->coding_rate,
-                                  init_data->preamble, LORA_FIX_LENGTH_PAYLOAD_OFF,
+                                  init_data->preamble, init_data->payload_len > 0,
                                   true, 0, 0, init_data->txiq, LORA_TX_TIMEOUT_MAX);
 
     Radio.SetRxConfig(MODEM_LORA, init_data->bandwidth, init_data->sf,
                                   init_data->coding_rate, 0, init_data->preamble,
-                                  symbol_to, LORA_FIX_LENGTH_PAYLOAD_OFF,
-                                  0, true, 0, 0, init_data->rxiq, true);
+                                  symbol_to, init_data->payload_len > 0,
+                                  init_data->payload_len, true, 0, 0, init_data->rxiq, true);
 
     Radio.SetMaxPayloadLength(MODEM_LORA, LORA_PAYLOAD_SIZE_MAX);
 
@@ -1494,6 +2120,12 @@ static void lora_validate_device_class (DeviceClass_t device_class) {
 }
 
 static void lora_validate_region (LoRaMacRegion_t region) {
+#ifdef LORAMAC_REGION_SINGLE
+    // the firmware is built for this region only
+    if (region != LORAMAC_REGION_SINGLE) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "invalid region %d", region));
+    }
+#endif
     if (region != LORAMAC_REGION_AS923 && region != LORAMAC_REGION_AU915
         && region != LORAMAC_REGION_EU868 && region != LORAMAC_REGION_US915
         && region != LORAMAC_REGION_IN865
@@ -1517,6 +2149,8 @@ static void lora_set_config (lora_cmd_data_t *cmd_data) {
     lora_obj.sf = cmd_data->info.init.sf;
     lora_obj.tx_power = cmd_data->info.init.tx_power;
     lora_obj.pwr_mode = cmd_data->info.init.power_mode;
+    lora_obj.payload_len = cmd_data->info.init.payload_len;
+    lora_obj.stream = cmd_data->info.init.stream;
     lora_obj.adr = cmd_data->info.init.adr;
     lora_obj.public = cmd_data->info.init.public;
     lora_obj.tx_retries = cmd_data->info.init.tx_retries;
@@ -1535,6 +2169,8 @@ static void lora_get_config (lora_cmd_data_t *cmd_data) {
     cmd_data->info.init.sf = lora_obj.sf;
     cmd_data->info.init.tx_power = lora_obj.tx_power;
     cmd_data->info.init.power_mode = lora_obj.pwr_mode;
+    cmd_data->info.init.payload_len = lora_obj.payload_len;
+    cmd_data->info.init.stream = lora_obj.stream;
     cmd_data->info.init.public = lora_obj.public;
     cmd_data->info.init.adr = lora_obj.adr;
     cmd_data->info.init.tx_retries = lora_obj.tx_retries;
@@ -1545,7 +2181,7 @@ static void lora_get_config (lora_cmd_data_t *cmd_data) {
 static void lora_send_cmd (lora_cmd_data_t *cmd_data) {
     xEventGroupClearBits(LoRaEvents, LORA_STATUS_COMPLETED | LORA_STATUS_ERROR | LORA_STATUS_MSG_SIZE);
 
-    xQueueSend(xCmdQueue, (void *)cmd_data, (TickType_t)portMAX_DELAY);
+    lora_cmd_enqueue(cmd_data, (TickType_t)portMAX_DELAY);
 
     uint32_t result = xEventGroupWaitBits(LoRaEvents,
                                           LORA_STATUS_COMPLETED | LORA_STATUS_ERROR,
@@ -1561,18 +2197,10 @@ static void lora_send_cmd (lora_cmd_data_t *cmd_data) {
 static int32_t lora_send (const byte *buf, uint32_t len, uint32_t timeout_ms) {
     lora_cmd_data_t cmd_data;
 
-/*
-#if defined(FIPY) || defined(LOPY4)
-    xSemaphoreTake(xLoRaSigfoxSem, portMAX_DELAY);
-    lora_get_config (&cmd_data);
-    cmd_data.cmd = E_LORA_CMD_INIT;
-    lora_send_cmd (&cmd_data);
-    xSemaphoreGive(xLoRaSigfoxSem);
-#endif
-*/
     cmd_data.cmd = E_LORA_CMD_TX;
     memcpy (cmd_data.info.tx.data, buf, len);
     cmd_data.info.tx.len = len;
+    cmd_data.info.tx.csma = false;
 
     if (timeout_ms < 0) {
         // blocking mode
@@ -1582,8 +2210,9 @@ static int32_t lora_send (const byte *buf, uint32_t len, uint32_t timeout_ms) {
     xEventGroupClearBits(LoRaEvents, LORA_STATUS_COMPLETED | LORA_STATUS_ERROR | LORA_STATUS_MSG_SIZE);
 
     // just pass to the LoRa queue
-    if (!xQueueSend(xCmdQueue, (void *)&cmd_data, (TickType_t)(timeout_ms / portTICK_PERIOD_MS))) {
+    if (!lora_cmd_enqueue(&cmd_data, (TickType_t)(timeout_ms / portTICK_PERIOD_MS))) {
         //printf("Q full\n");
+        lora_tx_dropped++;
         return 0;
     }
 
@@ -1627,7 +2256,7 @@ static int32_t lora_recv (byte *buf, uint32_t len, int32_t timeout_ms, uint32_t
         // get the available data
         memcpy(buf, (void *)&lora_partial_rx_packet.data[lora_partial_rx_packet.index], len);
         if (port != NULL) {
-            *port = rx_data.port;
+            *port = lora_partial_rx_packet.port;
         }
 
         // update the index and size values
@@ -1638,7 +2267,7 @@ static int32_t lora_recv (byte *buf, uint32_t len, int32_t timeout_ms, uint32_t
         }
         // return the number of bytes received
         return len;
-    } else if (xQueueReceive(xRxQueue, &rx_data, (TickType_t)(timeout_ms / portTICK_PERIOD_MS))) {
+    } else if (xSemaphoreTake(xRxSem, (TickType_t)(timeout_ms / portTICK_PERIOD_MS)) && lora_rx_ring_pop(&rx_data)) {
         // adjust the len
         if (rx_data.len < len) {
             len = rx_data.len;
@@ -1670,15 +2299,125 @@ static int32_t lora_recv (byte *buf, uint32_t len, int32_t timeout_ms, uint32_t
 }
 
 static bool lora_rx_any (void) {
-    lora_rx_data_t rx_data;
     if (lora_partial_rx_packet.size > 0) {
         return true;
-    } else if (xQueuePeek(xRxQueue, &rx_data, (TickType_t)0)) {
+    } else if (lora_rx_ring.count > 0) {
         return true;
     }
     return false;
 }
 
+static bool lora_rx_ring_alloc (uint32_t max_count) {
+    // room for max_count average frames, and always for at least one of the largest
+    uint32_t size = (max_count * LORA_RX_RING_BYTES_PER_PACKET) + LORA_PAYLOAD_SIZE_MAX + 3;
+    // the radio interrupt writes into it, so keep it out of PSRAM
+    uint8_t *buf = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (buf == NULL) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&lora_rx_ring_mux);
+    uint8_t *old = lora_rx_ring.buf;
+    lora_rx_ring.buf = buf;
+    lora_rx_ring.size = size;
+    lora_rx_ring.max_count = max_count;
+    lora_rx_ring.head = lora_rx_ring.tail = lora_rx_ring.used = lora_rx_ring.count = 0;
+    portEXIT_CRITICAL(&lora_rx_ring_mux);
+    // the packets that were queued are gone with the old buffer
+    while (xSemaphoreTake(xRxSem, 0));
+    free(old);
+    return true;
+}
+
+static void lora_rx_ring_reset (void) {
+    portENTER_CRITICAL(&lora_rx_ring_mux);
+    lora_rx_ring.head = lora_rx_ring.tail = lora_rx_ring.used = lora_rx_ring.count = 0;
+    portEXIT_CRITICAL(&lora_rx_ring_mux);
+    while (xSemaphoreTake(xRxSem, 0));
+}
+
+static IRAM_ATTR void lora_rx_ring_write (const uint8_t *data, uint32_t len) {
+    uint32_t first = lora_rx_ring.size - lora_rx_ring.head;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&lora_rx_ring.buf[lora_rx_ring.head], data, first);
+    memcpy(lora_rx_ring.buf, &data[first], len - first);
+    lora_rx_ring.head = (lora_rx_ring.head + len) % lora_rx_ring.size;
+}
+
+static void lora_rx_ring_read (uint8_t *data, uint32_t len) {
+    uint32_t first = lora_rx_ring.size - lora_rx_ring.tail;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(data, &lora_rx_ring.buf[lora_rx_ring.tail], first);
+    memcpy(&data[first], lora_rx_ring.buf, len - first);
+    lora_rx_ring.tail = (lora_rx_ring.tail + len) % lora_rx_ring.size;
+}
+
+static IRAM_ATTR bool lora_rx_ring_push (const uint8_t *data, uint32_t len, uint8_t port, int16_t rssi, bool from_isr) {
+    // the rssi is kept per packet, saturated at -128 dBm
+    uint8_t header[3] = { len, port, (uint8_t)((rssi < INT8_MIN) ? INT8_MIN : rssi) };
+    bool stored = false;
+
+    if (from_isr) {
+        portENTER_CRITICAL_ISR(&lora_rx_ring_mux);
+    } else {
+        portENTER_CRITICAL(&lora_rx_ring_mux);
+    }
+    if (lora_rx_ring.count < lora_rx_ring.max_count && lora_rx_ring.used + len + sizeof(header) <= lora_rx_ring.size) {
+        lora_rx_ring_write(header, sizeof(header));
+        lora_rx_ring_write(data, len);
+        lora_rx_ring.used += len + sizeof(header);
+        lora_rx_ring.count++;
+        stored = true;
+    } else {
+        lora_rx_ring.dropped++;
+    }
+    if (from_isr) {
+        portEXIT_CRITICAL_ISR(&lora_rx_ring_mux);
+    } else {
+        portEXIT_CRITICAL(&lora_rx_ring_mux);
+    }
+
+    if (stored) {
+        if (from_isr) {
+            xSemaphoreGiveFromISR(xRxSem, NULL);
+            pollwait_notify_from_isr();
+#ifdef LORA_OPENTHREAD_ENABLED
+            mesh_task_notify_from_isr();
+#endif
+        } else {
+            xSemaphoreGive(xRxSem);
+            pollwait_notify();
+#ifdef LORA_OPENTHREAD_ENABLED
+            mesh_task_notify();
+#endif
+        }
+    }
+    return stored;
+}
+
+static bool lora_rx_ring_pop (lora_rx_data_t *rx_data) {
+    bool popped = false;
+
+    portENTER_CRITICAL(&lora_rx_ring_mux);
+    if (lora_rx_ring.count > 0) {
+        uint8_t header[3];
+        lora_rx_ring_read(header, sizeof(header));
+        rx_data->len = header[0];
+        rx_data->port = header[1];
+        rx_data->rssi = (int8_t)header[2];
+        lora_rx_ring_read(rx_data->data, rx_data->len);
+        lora_rx_ring.used -= rx_data->len + sizeof(header);
+        lora_rx_ring.count--;
+        popped = true;
+    }
+    portEXIT_CRITICAL(&lora_rx_ring_mux);
+    return popped;
+}
+
 static bool lora_tx_space (void) {
     if (uxQueueSpacesAvailable(xCmdQueue) > 0) {
         return true;
@@ -1785,6 +2524,22 @@ static mp_obj_t lora_init_helper(lora_obj_t *self, const mp_arg_val_t *args) {
     cmd_data.info.init.device_class = args[13].u_int;
     lora_validate_device_class(cmd_data.info.init.device_class);
 
+    if (args[16].u_int < 0 || args[16].u_int > LORA_PAYLOAD_SIZE_MAX) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "payload_len must be between 0 and %d", LORA_PAYLOAD_SIZE_MAX));
+    }
+    if ((args[16].u_int > 0 || args[17].u_bool) && cmd_data.info.init.stack_mode != E_LORA_STACK_MODE_LORA) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "payload_len and stream are only available in LoRa mode"));
+    }
+    cmd_data.info.init.payload_len = args[16].u_int;
+    cmd_data.info.init.stream = args[17].u_bool;
+
+    if (args[15].u_int < 1 || args[15].u_int > LORA_RX_QUEUE_LEN_MAX) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "rx_queue_len must be between 1 and %d", LORA_RX_QUEUE_LEN_MAX));
+    }
+    if (args[15].u_int != lora_rx_ring.max_count && !lora_rx_ring_alloc(args[15].u_int)) {
+        mp_raise_OSError(MP_ENOMEM);
+    }
+
     // send message to the lora task
     cmd_data.cmd = E_LORA_CMD_INIT;
     lora_send_cmd(&cmd_data);
@@ -1809,6 +2564,9 @@ STATIC const mp_arg_t lora_init_args[] = {
     { MP_QSTR_tx_retries,   MP_ARG_KW_ONLY  | MP_ARG_INT,   {.u_int = 2} },
     { MP_QSTR_device_class, MP_ARG_KW_ONLY  | MP_ARG_INT,   {.u_int = CLASS_A} },
     { MP_QSTR_region,       MP_ARG_KW_ONLY  | MP_ARG_OBJ,   {.u_obj = MP_OBJ_NULL} },
+    { MP_QSTR_rx_queue_len, MP_ARG_KW_ONLY  | MP_ARG_INT,   {.u_int = LORA_DATA_QUEUE_SIZE_MAX} },
+    { MP_QSTR_payload_len,  MP_ARG_KW_ONLY  | MP_ARG_INT,   {.u_int = 0} },
+    { MP_QSTR_stream,       MP_ARG_KW_ONLY  | MP_ARG_BOOL,  {.u_bool = false} },
 };
 STATIC mp_obj_t lora_make_new(const mp_obj_type_t *type, mp_uint_t n_args, mp_uint_t n_kw, const mp_obj_t *all_args) {
     // parse args
@@ -1974,7 +2732,7 @@ STATIC mp_obj_t lora_join(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *
             timeout -= LORA_JOIN_WAIT_MS;
         }
         if (timeout <= 0) {
-            nlr_raise(mp_obj_new_exception_msg(&mp_type_TimeoutError, "timed out"));
+            mp_raise_prealloc(MP_PREALLOC_EXC_TIMEOUT);
         }
     }
     return mp_const_none;
@@ -2209,7 +2967,8 @@ STATIC mp_obj_t lora_stats(mp_obj_t self_in) {
     static const qstr lora_stats_info_fields[] = {
         MP_QSTR_rx_timestamp, MP_QSTR_rssi, MP_QSTR_snr, MP_QSTR_sfrx, MP_QSTR_sftx,
         MP_QSTR_tx_trials, MP_QSTR_tx_power, MP_QSTR_tx_time_on_air, MP_QSTR_tx_counter,
-        MP_QSTR_tx_frequency
+        MP_QSTR_tx_frequency, MP_QSTR_rx_dropped, MP_QSTR_tx_dropped, MP_QSTR_tx_msgs_delivered,
+        MP_QSTR_tx_msgs_failed, MP_QSTR_csma_failures
     };
 
     if (self->snr & 0x80)  { // the SNR sign bit is 1
@@ -2221,7 +2980,7 @@ STATIC mp_obj_t lora_stats(mp_obj_t self_in) {
         snr = (self->snr & 0xFF) / 4;
     }
 
-    mp_obj_t stats_tuple[10];
+    mp_obj_t stats_tuple[15];
     stats_tuple[0] = mp_obj_new_int_from_uint(self->rx_timestamp);
     stats_tuple[1] = mp_obj_new_int(self->rssi);
     stats_tuple[2] = mp_obj_new_float(snr);
@@ -2232,11 +2991,88 @@ STATIC mp_obj_t lora_stats(mp_obj_t self_in) {
     stats_tuple[7] = mp_obj_new_int(self->tx_time_on_air);
     stats_tuple[8] = mp_obj_new_int(self->tx_counter);
     stats_tuple[9] = mp_obj_new_int(self->tx_frequency);
+    // frames lost because the rx ring was full, and sends that found the tx queue full
+    stats_tuple[10] = mp_obj_new_int_from_uint(lora_rx_ring.dropped);
+    stats_tuple[11] = mp_obj_new_int_from_uint(lora_tx_dropped);
+    // application messages confirmed by McpsConfirm, counted per message when uplinks are aggregated
+    stats_tuple[12] = mp_obj_new_int_from_uint(lora_tx_msgs_delivered);
+    stats_tuple[13] = mp_obj_new_int_from_uint(lora_tx_msgs_failed);
+    // mesh frames dropped because CAD kept finding the channel busy
+    stats_tuple[14] = mp_obj_new_int_from_uint(lora_csma.failures);
 
     return mp_obj_new_attrtuple(lora_stats_info_fields, sizeof(stats_tuple) / sizeof(stats_tuple[0]), stats_tuple);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(lora_stats_obj, lora_stats);
 
+STATIC mp_obj_t lora_packet_log(mp_uint_t n_args, const mp_obj_t *args) {
+    if (n_args > 1) {
+        // (re)size the log, 0 switches it off
+        mp_int_t entries = mp_obj_get_int(args[1]);
+        if (entries < 0 || entries > MODLORA_PKT_LOG_ENTRIES_MAX) {
+            nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "the log size must be between 0 and %d", MODLORA_PKT_LOG_ENTRIES_MAX));
+        }
+        lora_pkt_log_record_t *records = NULL;
+        if (entries > 0) {
+            records = heap_caps_malloc(entries * sizeof(lora_pkt_log_record_t), MALLOC_CAP_8BIT);
+            if (records == NULL) {
+                mp_raise_OSError(MP_ENOMEM);
+            }
+        }
+        portENTER_CRITICAL(&lora_pkt_log_mux);
+        lora_pkt_log_record_t *old = lora_pkt_log.records;
+        lora_pkt_log.records = records;
+        lora_pkt_log.size = entries;
+        lora_pkt_log.head = lora_pkt_log.count = 0;
+        portEXIT_CRITICAL(&lora_pkt_log_mux);
+        free(old);
+        return mp_const_none;
+    }
+
+    // hand out all the records in one buffer, oldest first, and empty the log
+    vstr_t vstr;
+    vstr_init_len(&vstr, lora_pkt_log.size * sizeof(lora_pkt_log_record_t));
+    uint32_t count = 0;
+    portENTER_CRITICAL(&lora_pkt_log_mux);
+    if (lora_pkt_log.records && lora_pkt_log.size * sizeof(lora_pkt_log_record_t) == vstr.len) {
+        uint32_t first = (lora_pkt_log.head + lora_pkt_log.size - lora_pkt_log.count) % lora_pkt_log.size;
+        for (count = 0; count < lora_pkt_log.count; count++) {
+            memcpy(&vstr.buf[count * sizeof(lora_pkt_log_record_t)],
+                   &lora_pkt_log.records[(first + count) % lora_pkt_log.size], sizeof(lora_pkt_log_record_t));
+        }
+        lora_pkt_log.count = 0;
+    }
+    portEXIT_CRITICAL(&lora_pkt_log_mux);
+    vstr.len = count * sizeof(lora_pkt_log_record_t);
+    return mp_obj_new_str_from_vstr(&mp_type_bytes, &vstr);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(lora_packet_log_obj, 1, 2, lora_packet_log);
+
+STATIC mp_obj_t lora_recv_many(mp_uint_t n_args, const mp_obj_t *args) {
+    lora_rx_data_t rx_data;
+    mp_int_t max = (n_args > 1) ? mp_obj_get_int(args[1]) : LORA_RX_QUEUE_LEN_MAX + 1;
+    mp_obj_t list = mp_obj_new_list(0, NULL);
+
+    // what's left of a packet a socket read only partially goes first
+    if (max > 0 && lora_partial_rx_packet.size > 0) {
+        mp_obj_t tuple[2];
+        tuple[0] = mp_obj_new_bytes(&lora_partial_rx_packet.data[lora_partial_rx_packet.index],
+                                    lora_partial_rx_packet.size - lora_partial_rx_packet.index);
+        tuple[1] = mp_obj_new_int(lora_partial_rx_packet.port);
+        lora_partial_rx_packet.size = 0;
+        mp_obj_list_append(list, mp_obj_new_tuple(2, tuple));
+        max--;
+    }
+    // never blocks, only drains what has already arrived
+    for ( ; max > 0 && xSemaphoreTake(xRxSem, 0) && lora_rx_ring_pop(&rx_data); max--) {
+        mp_obj_t tuple[2];
+        tuple[0] = mp_obj_new_bytes(rx_data.data, rx_data.len);
+        tuple[1] = mp_obj_new_int(rx_data.port);
+        mp_obj_list_append(list, mp_obj_new_tuple(2, tuple));
+    }
+    return list;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(lora_recv_many_obj, 1, 2, lora_recv_many);
+
 STATIC mp_obj_t lora_has_joined(mp_obj_t self_in) {
     lora_obj_t *self = self_in;
     return self->joined ? mp_const_true : mp_const_false;
@@ -2304,12 +3140,13 @@ STATIC mp_obj_t lora_mac(mp_obj_t self_in) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(lora_mac_obj, lora_mac);
 
-/// \method callback(trigger, handler, arg)
+/// \method callback(trigger, handler, arg, *, priority)
 STATIC mp_obj_t lora_callback(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     STATIC const mp_arg_t allowed_args[] = {
         { MP_QSTR_trigger,      MP_ARG_REQUIRED | MP_ARG_OBJ,   },
         { MP_QSTR_handler,      MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
         { MP_QSTR_arg,          MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
+        { MP_QSTR_priority,     MP_ARG_KW_ONLY | MP_ARG_INT,    {.u_int = MP_IRQ_PRIORITY_NORMAL} },
     };
 
     // parse arguments
@@ -2321,7 +3158,7 @@ STATIC mp_obj_t lora_callback(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map
     if (args[0].u_obj != mp_const_none && args[1].u_obj != mp_const_none) {
         self->trigger = mp_obj_get_int(args[0].u_obj);
         self->handler = args[1].u_obj;
-        mp_irq_add(self, args[1].u_obj);
+        mp_irq_add_prio(self, args[1].u_obj, args[3].u_int);
         if (args[2].u_obj == mp_const_none) {
             self->handler_arg = self;
         } else {
@@ -2357,13 +3194,135 @@ STATIC mp_obj_t lora_ischannel_free(mp_obj_t self_in, mp_obj_t rssi, mp_obj_t ti
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_3(lora_ischannel_free_obj, lora_ischannel_free);
 
+/// \method cad(frequencies=None, sfs=None)
+STATIC mp_obj_t lora_cad_scan(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_frequencies,  MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
+        { MP_QSTR_sfs,          MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
+    };
+
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+    lora_obj_t *self = pos_args[0];
+
+    // in LoRaWAN mode the MAC owns the radio
+    if (self->stack_mode != E_LORA_STACK_MODE_LORA || self->state == E_LORA_STATE_NOINIT) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_request_not_possible));
+    }
+
+    lora_cmd_data_t cmd_data;
+    cmd_data.cmd = E_LORA_CMD_CAD;
+    if (args[0].u_obj == mp_const_none) {
+        cmd_data.info.cad.frequency[0] = self->frequency;
+        cmd_data.info.cad.n_freq = 1;
+    } else {
+        mp_uint_t n;
+        mp_obj_t *items;
+        mp_obj_get_array(args[0].u_obj, &n, &items);
+        if (n == 0 || n > LORA_CAD_FREQ_MAX) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+        }
+        for (mp_uint_t i = 0; i < n; i++) {
+            uint32_t frequency = mp_obj_get_int_truncated(items[i]);
+            lora_validate_frequency(frequency);
+            cmd_data.info.cad.frequency[i] = frequency;
+        }
+        cmd_data.info.cad.n_freq = n;
+    }
+    if (args[1].u_obj == mp_const_none) {
+        cmd_data.info.cad.sf[0] = self->sf;
+        cmd_data.info.cad.n_sf = 1;
+    } else {
+        mp_uint_t n;
+        mp_obj_t *items;
+        mp_obj_get_array(args[1].u_obj, &n, &items);
+        if (n == 0 || n > LORA_CAD_SF_MAX) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+        }
+        for (mp_uint_t i = 0; i < n; i++) {
+            uint8_t sf = mp_obj_get_int(items[i]);
+            lora_validate_sf(sf);
+            cmd_data.info.cad.sf[i] = sf;
+        }
+        cmd_data.info.cad.n_sf = n;
+    }
+
+    if (lora_cad.busy) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable));
+    }
+    // flag it before the LoRa task can pick up the command and finish the sweep
+    lora_cad.busy = true;
+    if (!lora_cmd_enqueue(&cmd_data, 0)) {
+        lora_cad.busy = false;
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable));
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(lora_cad_scan_obj, 1, lora_cad_scan);
+
+/// \method cad_results()
+STATIC mp_obj_t lora_cad_results(mp_obj_t self_in) {
+    if (lora_cad.busy) {
+        // the sweep is still running
+        return mp_const_none;
+    }
+
+    mp_obj_t list = mp_obj_new_list(0, NULL);
+    for (uint32_t i = 0; i < (lora_cad.params.n_freq * lora_cad.params.n_sf); i++) {
+        mp_obj_t tuple[3];
+        tuple[0] = mp_obj_new_int_from_uint(lora_cad.params.frequency[i / lora_cad.params.n_sf]);
+        tuple[1] = mp_obj_new_int(lora_cad.params.sf[i % lora_cad.params.n_sf]);
+        tuple[2] = mp_obj_new_bool(lora_cad.detected & ((uint64_t)1 << i));
+        mp_obj_list_append(list, mp_obj_new_tuple(3, tuple));
+    }
+    return list;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(lora_cad_results_obj, lora_cad_results);
+
 STATIC mp_obj_t lora_set_battery_level(mp_obj_t self_in, mp_obj_t battery) {
     BoardSetBatteryLevel(mp_obj_get_int(battery));
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_2(lora_set_battery_level_obj, lora_set_battery_level);
 
-STATIC mp_obj_t lora_nvram_save (mp_obj_t self_in) {
+STATIC mp_obj_t lora_nvram_save (mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_rtc,              MP_ARG_KW_ONLY  | MP_ARG_BOOL, {.u_bool = false} },
+        { MP_QSTR_fcnt_gap,         MP_ARG_KW_ONLY  | MP_ARG_INT,  {.u_int = MODLORA_RTC_SESSION_FCNT_GAP_DEF} },
+    };
+
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    uint32_t fcnt_gap = args[1].u_int;
+    if (args[1].u_int < 1) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+
+    if (args[0].u_bool) {
+        // keep the session in RTC memory, it survives deep sleep but not a power loss
+        if (!lora_rtc_session_is_valid() || lora_rtc_session.region != lora_obj.region) {
+            memset(&lora_rtc_session, 0, sizeof(lora_rtc_session));
+            lora_rtc_session.region = lora_obj.region;
+        }
+        lora_rtc_session_active = true;
+        lora_rtc_session_overflow = false;
+        LoRaMacNvsSave();
+        modlora_nvs_set_uint(E_LORA_NVS_ELE_REGION, (uint32_t)lora_obj.region);
+        modlora_nvs_set_uint(E_LORA_NVS_ELE_JOINED, (uint32_t)lora_obj.joined);
+        lora_rtc_session_active = false;
+
+        if (lora_rtc_session_overflow) {
+            // the session doesn't fit, use the flash only
+            lora_rtc_session_invalidate();
+            args[0].u_bool = false;
+        } else if (lora_rtc_session.values[E_LORA_NVS_ELE_UPLINK] < lora_rtc_session.nvs_uplink_reserved) {
+            // the flash copy still covers the frame counter, no need to write it
+            lora_rtc_session_seal();
+            return mp_const_none;
+        }
+    }
+
     LoRaMacRegion_t region = 0xFF;
     modlora_nvs_get_uint(E_LORA_NVS_ELE_REGION, &region);
     // if the region doesn't match, erase the previous stored data
@@ -2373,18 +3332,40 @@ STATIC mp_obj_t lora_nvram_save (mp_obj_t self_in) {
     LoRaMacNvsSave();
     modlora_nvs_set_uint(E_LORA_NVS_ELE_REGION, (uint32_t)lora_obj.region);
     modlora_nvs_set_uint(E_LORA_NVS_ELE_JOINED, (uint32_t)lora_obj.joined);
+    if (args[0].u_bool) {
+        // store a frame counter ahead of the real one, so that restoring from
+        // flash after a power loss can never reuse an uplink counter
+        lora_rtc_session.nvs_uplink_reserved = lora_rtc_session.values[E_LORA_NVS_ELE_UPLINK] + fcnt_gap;
+        modlora_nvs_set_uint(E_LORA_NVS_ELE_UPLINK, lora_rtc_session.nvs_uplink_reserved);
+        lora_rtc_session_seal();
+    }
     if (ESP_OK != nvs_commit(modlora_nvs_handle)) {
         nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_operation_failed));
     }
     return mp_const_none;
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_1(lora_nvram_save_obj, lora_nvram_save);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(lora_nvram_save_obj, 1, lora_nvram_save);
 
 STATIC mp_obj_t lora_nvram_restore (mp_obj_t self_in) {
     uint32_t joined = 0;
     LoRaMacRegion_t region;
     lora_cmd_data_t cmd_data;
 
+    // a session kept in RTC memory across deep sleep is the freshest copy
+    if (lora_rtc_session_is_valid() && lora_rtc_session.region == lora_obj.region) {
+        lora_rtc_session_active = true;
+        if (modlora_nvs_get_uint(E_LORA_NVS_ELE_JOINED, &joined) && joined) {
+            lora_obj.joined = true;
+            lora_get_config (&cmd_data);
+            cmd_data.cmd = E_LORA_CMD_INIT;
+            lora_send_cmd (&cmd_data);
+            lora_rtc_session_active = false;
+            lora_rtc_session_seal();
+            return mp_const_none;
+        }
+        lora_rtc_session_active = false;
+    }
+
     if (modlora_nvs_get_uint(E_LORA_NVS_ELE_JOINED, &joined)) {
         lora_obj.joined = joined;
         if (joined) {
@@ -2410,6 +3391,7 @@ STATIC mp_obj_t lora_nvram_restore (mp_obj_t self_in) {
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(lora_nvram_restore_obj, lora_nvram_restore);
 
 STATIC mp_obj_t lora_nvram_erase (mp_obj_t self_in) {
+    lora_rtc_session_invalidate();
     if (ESP_OK != nvs_erase_all(modlora_nvs_handle)) {
         nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_operation_failed));
     }
@@ -2471,6 +3453,8 @@ STATIC const mp_map_elem_t lora_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_sf),                    (mp_obj_t)&lora_sf_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_power_mode),            (mp_obj_t)&lora_power_mode_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_stats),                 (mp_obj_t)&lora_stats_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_packet_log),            (mp_obj_t)&lora_packet_log_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_recv_many),             (mp_obj_t)&lora_recv_many_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_has_joined),            (mp_obj_t)&lora_has_joined_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_add_channel),           (mp_obj_t)&lora_add_channel_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_remove_channel),        (mp_obj_t)&lora_remove_channel_obj },
@@ -2479,6 +3463,8 @@ STATIC const mp_map_elem_t lora_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_callback),              (mp_obj_t)&lora_callback_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_events),                (mp_obj_t)&lora_events_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_ischannel_free),        (mp_obj_t)&lora_ischannel_free_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_cad),                   (mp_obj_t)&lora_cad_scan_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_cad_results),           (mp_obj_t)&lora_cad_results_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_set_battery_level),     (mp_obj_t)&lora_set_battery_level_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_nvram_save),            (mp_obj_t)&lora_nvram_save_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_nvram_restore),         (mp_obj_t)&lora_nvram_restore_obj },
@@ -2516,6 +3502,7 @@ STATIC const mp_map_elem_t lora_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_RX_PACKET_EVENT),     MP_OBJ_NEW_SMALL_INT(MODLORA_RX_EVENT) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_TX_PACKET_EVENT),     MP_OBJ_NEW_SMALL_INT(MODLORA_TX_EVENT) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_TX_FAILED_EVENT),     MP_OBJ_NEW_SMALL_INT(MODLORA_TX_FAILED_EVENT) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_CAD_EVENT),           MP_OBJ_NEW_SMALL_INT(MODLORA_CAD_EVENT) },
 
     { MP_OBJ_NEW_QSTR(MP_QSTR_CLASS_A),             MP_OBJ_NEW_SMALL_INT(CLASS_A) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_CLASS_C),             MP_OBJ_NEW_SMALL_INT(CLASS_C) },
@@ -2531,6 +3518,8 @@ STATIC const mp_map_elem_t lora_locals_dict_table[] = {
 
 STATIC MP_DEFINE_CONST_DICT(lora_locals_dict, lora_locals_dict_table);
 
+STATIC mod_network_nic_stats_t lora_stats;
+
 const mod_network_nic_type_t mod_network_nic_type_lora = {
     .base = {
         { &mp_type_type },
@@ -2549,6 +3538,7 @@ const mod_network_nic_type_t mod_network_nic_type_lora = {
     .n_setsockopt = lora_socket_setsockopt,
     .n_bind = lora_socket_bind,
     .n_ioctl = lora_socket_ioctl,
+    .stats = &lora_stats
 };
 
 ///******************************************************************************/
@@ -2592,6 +3582,13 @@ static int lora_socket_socket (mod_network_socket_obj_t *s, int *_errno) {
 }
 
 static void lora_socket_close (mod_network_socket_obj_t *s) {
+    if (lora_aggregate.deadline_ms > 0) {
+        // give the pending messages a chance to go out
+        xSemaphoreTake(xAggregateSem, portMAX_DELAY);
+        lorawan_aggregate_flush(0);
+        lora_aggregate.deadline_ms = 0;
+        xSemaphoreGive(xAggregateSem);
+    }
     s->sock_base.u.sd = -1;
 #ifdef LORA_OPENTHREAD_ENABLED
     mesh_socket_close(s);
@@ -2615,15 +3612,25 @@ static int lora_socket_send (mod_network_socket_obj_t *s, const byte *buf, mp_ui
         *_errno = MP_ENETDOWN;
     } else if (len > LORA_PAYLOAD_SIZE_MAX) {
         *_errno = MP_EMSGSIZE;
+    } else if (lora_obj.payload_len > 0 && len != lora_obj.payload_len) {
+        // with an implicit header the receiver only knows the configured length
+        *_errno = MP_EMSGSIZE;
     } else if (len > 0) {
         if (lora_obj.stack_mode == E_LORA_STACK_MODE_LORA) {
             n_bytes = lora_send (buf, len, s->sock_base.timeout);
         } else {
             if (lora_obj.joined) {
-                n_bytes = lorawan_send (buf, len, s->sock_base.timeout,
-                                        LORAWAN_SOCKET_IS_CONFIRMED(s->sock_base.u.sd),
-                                        LORAWAN_SOCKET_GET_DR(s->sock_base.u.sd),
-                                        LORAWAN_SOCKET_GET_PORT(s->sock_base.u.sd));
+                if (lora_aggregate.deadline_ms > 0) {
+                    n_bytes = lorawan_aggregate_send (buf, len, s->sock_base.timeout,
+                                                      LORAWAN_SOCKET_IS_CONFIRMED(s->sock_base.u.sd),
+                                                      LORAWAN_SOCKET_GET_DR(s->sock_base.u.sd),
+                                                      LORAWAN_SOCKET_GET_PORT(s->sock_base.u.sd));
+                } else {
+                    n_bytes = lorawan_send (buf, len, s->sock_base.timeout,
+                                            LORAWAN_SOCKET_IS_CONFIRMED(s->sock_base.u.sd),
+                                            LORAWAN_SOCKET_GET_DR(s->sock_base.u.sd),
+                                            LORAWAN_SOCKET_GET_PORT(s->sock_base.u.sd), 1);
+                }
             } else {
                 *_errno = MP_ENETDOWN;
                 return -1;
@@ -2635,6 +3642,9 @@ static int lora_socket_send (mod_network_socket_obj_t *s, const byte *buf, mp_ui
         } else if (n_bytes < 0) {
             *_errno = MP_EMSGSIZE;
         }
+    } else if (lora_obj.stack_mode == E_LORA_STACK_MODE_LORAWAN && lora_aggregate.deadline_ms > 0) {
+        // an empty send pushes out the messages accumulated so far
+        n_bytes = lorawan_aggregate_push(s->sock_base.timeout, _errno);
     } else {
         n_bytes = 0;
     }
@@ -2682,8 +3692,7 @@ static int lora_socket_setsockopt(mod_network_socket_obj_t *s, mp_uint_t level,
 
 #ifdef LORA_OPENTHREAD_ENABLED
     if (lora_mesh_ready()) {
-        *_errno = MP_EOPNOTSUPP;
-        return -1;
+        return mesh_socket_setsockopt(s, level, opt, optval, optlen, _errno);
     }
 #endif  // #ifdef LORA_OPENTHREAD_ENABLED
 
@@ -2704,6 +3713,19 @@ static int lora_socket_setsockopt(mod_network_socket_obj_t *s, mp_uint_t level,
             return -1;
         }
         LORAWAN_SOCKET_SET_DR(s->sock_base.u.sd, *(uint8_t *)optval);
+    } else if (opt == SO_LORAWAN_AGGREGATE) {
+        // the value is the longest time (in ms) a message may wait to be packed with others
+        int32_t deadline_ms = *(int32_t *)optval;
+        if (deadline_ms < 0) {
+            *_errno = MP_EINVAL;
+            return -1;
+        }
+        xSemaphoreTake(xAggregateSem, portMAX_DELAY);
+        if (deadline_ms == 0) {
+            lorawan_aggregate_flush(s->sock_base.timeout);
+        }
+        lora_aggregate.deadline_ms = deadline_ms;
+        xSemaphoreGive(xAggregateSem);
     } else {
         *_errno = MP_EOPNOTSUPP;
         return -1;
@@ -19,11 +19,23 @@
 #define LORA_PAYLOAD_SIZE_MAX                                   (255)
 #define LORA_CMD_QUEUE_SIZE_MAX                                 (7)
 #define LORA_DATA_QUEUE_SIZE_MAX                                (7)
+#define LORA_RX_QUEUE_LEN_MAX                                   (64)
+#define LORA_RX_RING_BYTES_PER_PACKET                           (64)    // average size the rx ring is dimensioned for
 #define LORA_CB_QUEUE_SIZE_MAX                                  (7)
 #define LORA_STACK_SIZE                                         (4096)
 #define LORA_TIMER_STACK_SIZE                                   (3072)
 #define LORA_TASK_PRIORITY                                      (6)
 #define LORA_TIMER_TASK_PRIORITY                                (8)
+#define LORA_TASK_LBT_RETRY_MS                                  (2)
+#define LORA_AGGREGATE_RETRY_MS                                 (20)
+#define LORA_CAD_FREQ_MAX                                       (8)
+#define LORA_CAD_SF_MAX                                         (6)
+#define LORA_CAD_TIMEOUT_MS                                     (500)
+#define LORA_CSMA_MIN_BE                                        (2)     // backoff exponents of the mesh CSMA/CA
+#define LORA_CSMA_MAX_BE                                        (5)
+#define LORA_CSMA_MAX_BACKOFFS                                  (4)
+#define LORA_CSMA_BACKOFF_UNIT_MS                               (10)
+#define LORA_OT_RX_QUEUE_LEN                                    (32)
 
 #define LORA_STATUS_COMPLETED                                   (0x01)
 #define LORA_STATUS_ERROR                                       (0x02)
@@ -41,6 +53,7 @@ typedef enum {
     E_LORA_CMD_LORAWAN_TX,
     E_LORA_CMD_SLEEP,
     E_LORA_CMD_WAKE_UP,
+    E_LORA_CMD_CAD,
 } lora_cmd_t;
 
 typedef enum {
@@ -80,8 +93,10 @@ typedef struct {
     uint8_t         tx_retries;
     bool            txiq;
     bool            rxiq;
+    uint8_t         payload_len;    // implicit header length, 0 for an explicit header
     bool            adr;
     bool            public;
+    bool            stream;
 } lora_init_cmd_data_t;
 
 typedef struct {
@@ -109,7 +124,9 @@ typedef struct {
     uint8_t     len;
     uint8_t     port;
     uint8_t     dr;
+    uint8_t     msgs;       // application messages carried by the frame
     bool        confirmed;
+    bool        csma;       // wait for a free channel with CAD based CSMA/CA
 } lora_tx_cmd_data_t;
 
 typedef struct {
@@ -120,11 +137,19 @@ typedef struct {
     bool        add;
 } lora_config_channel_cmd_data_t;
 
+typedef struct {
+    uint32_t    frequency[LORA_CAD_FREQ_MAX];
+    uint8_t     sf[LORA_CAD_SF_MAX];
+    uint8_t     n_freq;
+    uint8_t     n_sf;
+} lora_cad_cmd_data_t;
+
 typedef union {
     lora_init_cmd_data_t                init;
     lora_join_cmd_data_t                join;
     lora_tx_cmd_data_t                  tx;
     lora_config_channel_cmd_data_t      channel;
+    lora_cad_cmd_data_t                 cad;
 } lora_cmd_info_u_t;
 
 typedef struct {
@@ -138,6 +163,7 @@ typedef struct {
     uint8_t data[LORA_PAYLOAD_SIZE_MAX + 1];
     uint8_t len;
     uint8_t port;
+    int8_t  rssi;
 } lora_rx_data_t;
 
 typedef void ( *modlora_timerCallback )( void );
@@ -157,7 +183,8 @@ extern void modlora_sleep_module(void);
 extern bool modlora_is_module_sleep(void);
 IRAM_ATTR extern void modlora_set_timer_callback(modlora_timerCallback cb);
 
+extern void lora_ot_init(void);
 extern int lora_ot_recv(uint8_t *buf, int8_t *rssi);
-extern void lora_ot_send(const uint8_t *buf, uint16_t len);
+extern void lora_ot_send(const uint8_t *buf, uint16_t len, bool is_ack);
 
 #endif  // MODLORA_H_
@@ -48,6 +48,7 @@
 
 #include "lteppp.h"
 #include "modlte.h"
+#include "modlteudp.h"
 
 #include "lwip/sockets.h"
 #include "lwip/dns.h"
@@ -73,6 +74,22 @@
 /******************************************************************************
  DEFINE TYPES
  ******************************************************************************/
+typedef struct {
+    uint32_t        tid;
+    uint16_t        plen;
+    uint16_t        pcrc;
+    uint8_t         op;
+    uint8_t         sid;
+} lte_stp_srsp_t;
+
+typedef struct {
+    uint8_t         *txbuf;
+    const char      *error;
+    uint32_t        tid;
+    uint32_t        timeout_ms;
+    uint16_t        max_transfer;
+    uint8_t         sid;
+} lte_stp_t;
 
 /******************************************************************************
  DEFINE CONSTANTS
@@ -102,6 +119,24 @@
 #define PSM_ACTIVE_6M         0b010
 #define PSM_ACTIVE_DISABLED   0b111
 
+#define LTE_TASK_POLL_MS      (10)
+
+// Sequans STP, used by LTE.modem_upgrade_transfer()
+#define LTE_STP_UART                    UART_NUM_1
+#define LTE_STP_HEADER_SIZE             16
+#define LTE_STP_MREQ_SIGNATURE          0x66617374
+#define LTE_STP_SRSP_SIGNATURE          0x74736166
+#define LTE_STP_OP_RESET                0
+#define LTE_STP_OP_SESSION_OPEN         1
+#define LTE_STP_OP_TRANSFER_BLOCK_CMD   2
+#define LTE_STP_OP_TRANSFER_BLOCK       3
+#define LTE_STP_ACK(op)                 ((op) | 0x80)
+#define LTE_STP_CHUNK_SIZE              2048
+#define LTE_STP_BLOCK_MAX               (2048 - 32)     // 31x0 mii limitation
+#define LTE_STP_TRIALS                  4
+#define LTE_STP_TIMEOUT_MS              90000
+#define LTE_STP_CLOSE_TIMEOUT_MS        2000
+
 /******************************************************************************
  DECLARE PRIVATE DATA
  ******************************************************************************/
@@ -118,6 +153,12 @@ static bool lte_debug = false;
 
 static bool lte_ue_is_out_of_coverage = false;
 
+// the session parked before the last deep sleep was picked up by init()
+static bool lte_session_resumed = false;
+
+// tags the commands sent with send_at_cmd_async(), 0 is for the blocking ones
+static uint32_t lte_at_async_tag = 0;
+
 extern TaskHandle_t xLTEUpgradeTaskHndl;
 extern TaskHandle_t mpTaskHandle;
 extern TaskHandle_t svTaskHandle;
@@ -143,6 +184,8 @@ static void lte_pause_ppp(void);
 static bool lte_check_attached(bool legacy);
 static void lte_check_init(void);
 static bool lte_check_sim_present(void);
+static void lte_config_psm(const mp_arg_val_t *args);
+static bool lte_resume_session(void);
 static int lte_get_modem_version(void);
 STATIC mp_obj_t lte_suspend(mp_obj_t self_in);
 STATIC mp_obj_t lte_connect(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args);
@@ -380,6 +423,44 @@ static void lte_check_inppp(void) {
     }
 }
 
+// args are psm_period_value, psm_period_unit, psm_active_value and psm_active_unit
+static void lte_config_psm(const mp_arg_val_t *args) {
+    u8_t psm_period_value = args[0].u_int;
+    u8_t psm_period_unit = args[1].u_int;
+    u8_t psm_active_value = args[2].u_int;
+    u8_t psm_active_unit = args[3].u_int;
+    if ( psm_period_unit != PSM_PERIOD_DISABLED && psm_active_unit != PSM_ACTIVE_DISABLED ) {
+        const size_t at_cmd_len = LTE_AT_CMD_SIZE_MAX - 4;
+        char at_cmd[at_cmd_len];
+        u8_t psm_period = ( psm_period_unit << 5 ) | psm_period_value;
+        u8_t psm_active = ( psm_active_unit << 5 ) | psm_active_value;
+        char p[9];
+        char a[9];
+        sprint_binary_u8(p, psm_period);
+        sprint_binary_u8(a, psm_active);
+        snprintf(at_cmd, at_cmd_len, "AT+CPSMS=1,,,\"%s\",\"%s\"", p, a);
+        lte_push_at_command(at_cmd, LTE_RX_TIMEOUT_MAX_MS);
+    }
+}
+
+// picks up the session parked by deinit(detach=False) before a deep sleep, the modem
+// stayed attached in PSM meanwhile so a single registration query is enough
+static bool lte_resume_session(void) {
+    uint32_t cid;
+    bool legacyattach;
+    if (!lteppp_rtc_session_get(&cid, &legacyattach)) {
+        return false;
+    }
+    lte_push_at_command("AT+CEREG?", LTE_RX_TIMEOUT_MIN_MS);
+    if (!strstr(modlte_rsp.data, "+CEREG: 1,1") && !strstr(modlte_rsp.data, "+CEREG: 1,5")) {
+        return false;
+    }
+    lte_obj.cid = cid;
+    lte_legacyattach_flag = legacyattach;
+    lteppp_set_state(E_LTE_ATTACHED);
+    return true;
+}
+
 static bool lte_check_sim_present(void) {
     lte_push_at_command("AT+CFUN?", LTE_RX_TIMEOUT_MIN_MS);
     if (strstr(modlte_rsp.data, "+CFUN: 0")) {
@@ -441,13 +522,279 @@ static void TASK_LTE_UPGRADE(void *pvParameters){
     }
 }
 
+// Sequans STP master, pushes a firmware image to the modem once it's in "AT+STP" mode.
+// This is the protocol of frozen/LTE/sqnstp.py, doing the CRC and the framing here
+// instead of in Python loops over every byte of the image.
+static uint16_t lte_stp_crc16 (const uint8_t *data, uint32_t len) {
+    // CRC-16(CCITT), polynomial 0x1021 and no reflection
+    uint16_t crc = 0;
+    while (len--) {
+        crc ^= (uint16_t)*data++ << 8;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void lte_stp_put16 (uint8_t *buf, uint16_t value) {
+    buf[0] = value >> 8;
+    buf[1] = value;
+}
+
+static uint16_t lte_stp_get16 (const uint8_t *buf) {
+    return (buf[0] << 8) | buf[1];
+}
+
+static void lte_stp_put32 (uint8_t *buf, uint32_t value) {
+    lte_stp_put16(buf, value >> 16);
+    lte_stp_put16(buf + 2, value);
+}
+
+static uint32_t lte_stp_get32 (const uint8_t *buf) {
+    return ((uint32_t)lte_stp_get16(buf) << 16) | lte_stp_get16(buf + 2);
+}
+
+// the header is ">IBBHIHH": signature, op, sid, payload length, tid, header CRC and payload CRC
+static void lte_stp_pack_header (uint8_t *hdr, uint32_t signature, uint8_t op, uint8_t sid, uint16_t plen,
+                                 uint32_t tid, uint16_t hcrc, uint16_t pcrc) {
+    lte_stp_put32(hdr, signature);
+    hdr[4] = op;
+    hdr[5] = sid;
+    lte_stp_put16(hdr + 6, plen);
+    lte_stp_put32(hdr + 8, tid);
+    lte_stp_put16(hdr + 12, hcrc);
+    lte_stp_put16(hdr + 14, pcrc);
+}
+
+static void lte_stp_send_mreq (lte_stp_t *stp, uint8_t op, const uint8_t *pld, uint16_t plen) {
+    uint8_t *buf = stp->txbuf;
+    uint16_t pcrc = plen ? lte_stp_crc16(pld, plen) : 0;
+
+    lte_stp_pack_header(buf, LTE_STP_MREQ_SIGNATURE, op, stp->sid, plen, stp->tid, 0, pcrc);
+    lte_stp_put16(buf + 12, lte_stp_crc16(buf, LTE_STP_HEADER_SIZE));
+    if (plen > 0) {
+        memcpy(buf + LTE_STP_HEADER_SIZE, pld, plen);
+    }
+
+    // the header and the payload go out in a single driver write
+    MP_THREAD_GIL_EXIT();
+    uart_write_bytes(LTE_STP_UART, (const char *)buf, LTE_STP_HEADER_SIZE + plen);
+    MP_THREAD_GIL_ENTER();
+}
+
+static bool lte_stp_read (lte_stp_t *stp, uint8_t *buf, uint32_t len) {
+    MP_THREAD_GIL_EXIT();
+    int32_t n = uart_read_bytes(LTE_STP_UART, buf, len, stp->timeout_ms / portTICK_PERIOD_MS);
+    MP_THREAD_GIL_ENTER();
+    return n == (int32_t)len;
+}
+
+static bool lte_stp_read_srsp (lte_stp_t *stp, lte_stp_srsp_t *srsp) {
+    uint8_t hdr[LTE_STP_HEADER_SIZE];
+
+    if (!lte_stp_read(stp, hdr, sizeof(hdr))) {
+        stp->error = "SRSP header too small";
+        return false;
+    }
+    uint32_t signature = lte_stp_get32(hdr);
+    srsp->op = hdr[4];
+    srsp->sid = hdr[5];
+    srsp->plen = lte_stp_get16(hdr + 6);
+    srsp->tid = lte_stp_get32(hdr + 8);
+    uint16_t hcrc = lte_stp_get16(hdr + 12);
+    srsp->pcrc = lte_stp_get16(hdr + 14);
+
+    if (signature != LTE_STP_SRSP_SIGNATURE) {
+        mp_printf(&mp_plat_print, "Wrong SRSP signature: 0x%08X\n", signature);
+    }
+    if (hcrc != 0) {
+        lte_stp_pack_header(hdr, LTE_STP_SRSP_SIGNATURE, srsp->op, srsp->sid, srsp->plen, srsp->tid, 0, srsp->pcrc);
+        if (hcrc != lte_stp_crc16(hdr, sizeof(hdr))) {
+            stp->error = "Wrong header CRC";
+            return false;
+        }
+    }
+    return true;
+}
+
+// sends the request again until a well formed response header comes back
+static bool lte_stp_request (lte_stp_t *stp, uint8_t op, const uint8_t *pld, uint16_t plen, lte_stp_srsp_t *srsp) {
+    for (int trials = LTE_STP_TRIALS; ; ) {
+        lte_stp_send_mreq(stp, op, pld, plen);
+        if (lte_stp_read_srsp(stp, srsp)) {
+            return true;
+        }
+        if (--trials == 0) {
+            return false;
+        }
+    }
+}
+
+static bool lte_stp_verify_session (lte_stp_t *stp, const lte_stp_srsp_t *srsp, uint8_t op) {
+    if (srsp->op != LTE_STP_ACK(op)) {
+        stp->error = "Invalid op";
+    } else if (srsp->sid != stp->sid) {
+        stp->error = "Invalid sid";
+    } else if (srsp->tid != stp->tid) {
+        stp->error = "Invalid tid";
+    } else {
+        return true;
+    }
+    return false;
+}
+
+static bool lte_stp_read_data (lte_stp_t *stp, uint8_t *buf, uint16_t len, const lte_stp_srsp_t *srsp) {
+    if (!lte_stp_read(stp, buf, len) || srsp->plen != len) {
+        stp->error = "Wrong payload size";
+        return false;
+    }
+    if (srsp->pcrc != 0 && srsp->pcrc != lte_stp_crc16(buf, len)) {
+        stp->error = "Wrong payload CRC";
+        return false;
+    }
+    return true;
+}
+
+static bool lte_stp_reset (lte_stp_t *stp, bool closing) {
+    lte_stp_srsp_t srsp;
+
+    lte_stp_send_mreq(stp, LTE_STP_OP_RESET, NULL, 0);
+    if (closing) {
+        // the modem restarts, the answer doesn't matter
+        uint8_t hdr[LTE_STP_HEADER_SIZE];
+        lte_stp_read(stp, hdr, sizeof(hdr));
+        return true;
+    }
+    if (!lte_stp_read_srsp(stp, &srsp)) {
+        return false;
+    }
+    if (srsp.op != LTE_STP_ACK(LTE_STP_OP_RESET)) {
+        stp->error = "Reset: invalid op";
+        return false;
+    }
+    stp->sid = 0;
+    stp->tid = 0;
+    return true;
+}
+
+static bool lte_stp_open_session (lte_stp_t *stp) {
+    lte_stp_srsp_t srsp;
+    uint8_t rsp[4];     // ">BBH": ok, version and max transfer size
+
+    stp->sid = 1;
+    stp->tid = 1;
+    lte_stp_send_mreq(stp, LTE_STP_OP_SESSION_OPEN, NULL, 0);
+    if (!lte_stp_read_srsp(stp, &srsp) || !lte_stp_verify_session(stp, &srsp, LTE_STP_OP_SESSION_OPEN) ||
+        !lte_stp_read_data(stp, rsp, sizeof(rsp), &srsp)) {
+        return false;
+    }
+    if (!rsp[0]) {
+        stp->error = "OpenSession: failed to open";
+        return false;
+    }
+    stp->max_transfer = lte_stp_get16(rsp + 2);
+    if (stp->max_transfer <= LTE_STP_HEADER_SIZE) {
+        stp->error = "OpenSession: invalid max transfer";
+        return false;
+    }
+    mp_printf(&mp_plat_print, "Session opened: version %d, max transfer %d bytes\n", rsp[1], stp->max_transfer);
+    stp->tid++;
+    return true;
+}
+
+static mp_uint_t lte_stp_read_blob (mp_obj_t blob, uint8_t *buf, mp_uint_t len) {
+    const mp_stream_p_t *stream = (const mp_stream_p_t *)mp_obj_get_type(blob)->protocol;
+    if (stream != NULL && stream->read != NULL) {
+        int errcode = 0;
+        mp_uint_t n = mp_stream_rw(blob, buf, len, &errcode, MP_STREAM_RW_READ);
+        if (errcode != 0) {
+            mp_raise_OSError(errcode);
+        }
+        return n;
+    }
+    // anything with a read() method, like the image of sqnsbrz.bootrom
+    mp_obj_t data = mp_call_function_1(mp_load_attr(blob, MP_QSTR_read), MP_OBJ_NEW_SMALL_INT(len));
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(data, &bufinfo, MP_BUFFER_READ);
+    len = MIN(bufinfo.len, len);
+    memcpy(buf, bufinfo.buf, len);
+    return len;
+}
+
+static void lte_stp_progress (uint32_t downloaded, uint32_t total) {
+    static const char hashes[] = "########################################";
+    static const char spaces[] = "                                        ";
+    const uint32_t bar_len = sizeof(hashes) - 1;
+    uint32_t percent = total ? (uint64_t)downloaded * 100 / total : 100;
+    uint32_t n = MIN(bar_len, percent * bar_len / 100);
+    mp_printf(&mp_plat_print, "\rSending %u bytes: [%.*s%.*s] %3u%%", total, (int)n, hashes, (int)(bar_len - n), spaces, percent);
+}
+
+static bool lte_stp_send_data (lte_stp_t *stp, mp_obj_t blob, uint32_t total) {
+    lte_stp_srsp_t srsp;
+    uint8_t *chunk = stp->txbuf + LTE_STP_HEADER_SIZE + LTE_STP_BLOCK_MAX;
+    uint32_t downloaded = 0;
+    // shared by all the blocks, like the Trial() of sqnstp.py
+    int trials = LTE_STP_TRIALS;
+
+    for (;;) {
+        mp_uint_t size = lte_stp_read_blob(blob, chunk, LTE_STP_CHUNK_SIZE);
+        if (size == 0) {
+            break;
+        }
+        const uint8_t *data = chunk;
+        while (size > 0) {
+            uint16_t l = MIN(size, stp->max_transfer - LTE_STP_HEADER_SIZE);
+            l = MIN(l, LTE_STP_BLOCK_MAX);
+
+            uint8_t pld[2];
+            lte_stp_put16(pld, l);
+            if (!lte_stp_request(stp, LTE_STP_OP_TRANSFER_BLOCK_CMD, pld, sizeof(pld), &srsp)) {
+                return false;
+            }
+            if (!lte_stp_verify_session(stp, &srsp, LTE_STP_OP_TRANSFER_BLOCK_CMD)) {
+                if (--trials > 0) {
+                    continue;
+                }
+                return false;
+            }
+            stp->tid++;
+
+            uint8_t rsp[2];     // ">H": the bytes the modem didn't consume
+            if (!lte_stp_request(stp, LTE_STP_OP_TRANSFER_BLOCK, data, l, &srsp)) {
+                return false;
+            }
+            if (!lte_stp_verify_session(stp, &srsp, LTE_STP_OP_TRANSFER_BLOCK) ||
+                !lte_stp_read_data(stp, rsp, sizeof(rsp), &srsp)) {
+                if (--trials > 0) {
+                    continue;
+                }
+                return false;
+            }
+            stp->tid++;
+
+            uint16_t residue = lte_stp_get16(rsp);
+            if (residue > 0) {
+                mp_printf(&mp_plat_print, "Slave didn't consume %d bytes\n", residue);
+                l -= MIN(residue, l);
+            }
+            data += l;
+            size -= l;
+            downloaded += l;
+        }
+        lte_stp_progress(downloaded, total);
+    }
+    mp_printf(&mp_plat_print, "\n");
+    return true;
+}
+
 /******************************************************************************/
 // Micro Python bindings; LTE class
 
 static mp_obj_t lte_init_helper(lte_obj_t *self, const mp_arg_val_t *args) {
     lteppp_init();
-    const size_t at_cmd_len = LTE_AT_CMD_SIZE_MAX - 4;
-    char at_cmd[at_cmd_len];
+    char at_cmd[LTE_AT_CMD_SIZE_MAX - 4];
     lte_modem_conn_state_t modem_state;
 
     if (lte_obj.init) {
@@ -490,6 +837,15 @@ static mp_obj_t lte_init_helper(lte_obj_t *self, const mp_arg_val_t *args) {
         nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Couldn't connect to Modem (modem_state - default)"));
         break;
     }
+
+    lte_session_resumed = lte_resume_session();
+    if (lte_session_resumed) {
+        mod_network_register_nic(&lte_obj);
+        lte_obj.init = true;
+        lte_config_psm(&args[4]);
+        xSemaphoreGive(xLTE_modem_Conn_Sem);
+        return mp_const_none;
+    }
     lte_obj.cid = args[1].u_int;
 
     lte_push_at_command("AT+CFUN?", LTE_RX_TIMEOUT_MIN_MS);
@@ -536,21 +892,7 @@ static mp_obj_t lte_init_helper(lte_obj_t *self, const mp_arg_val_t *args) {
     mod_network_register_nic(&lte_obj);
     lte_obj.init = true;
 
-    // configure PSM
-    u8_t psm_period_value = args[4].u_int;
-    u8_t psm_period_unit = args[5].u_int;
-    u8_t psm_active_value = args[6].u_int;
-    u8_t psm_active_unit = args[7].u_int;
-    if ( psm_period_unit != PSM_PERIOD_DISABLED && psm_active_unit != PSM_ACTIVE_DISABLED ) {
-        u8_t psm_period = ( psm_period_unit << 5 ) | psm_period_value;
-        u8_t psm_active = ( psm_active_unit << 5 ) | psm_active_value;
-        char p[9];
-        char a[9];
-        sprint_binary_u8(p, psm_period);
-        sprint_binary_u8(a, psm_active);
-        snprintf(at_cmd, at_cmd_len, "AT+CPSMS=1,,,\"%s\",\"%s\"", p, a);
-        lte_push_at_command(at_cmd, LTE_RX_TIMEOUT_MAX_MS);
-    }
+    lte_config_psm(&args[4]);
 
     xSemaphoreGive(xLTE_modem_Conn_Sem);
     return mp_const_none;
@@ -703,8 +1045,11 @@ STATIC mp_obj_t lte_deinit(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t
     mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
+    lteppp_rtc_session_invalidate();
+    lte_session_resumed = false;
     if (lte_obj.init) {
         lte_obj_t *self = (lte_obj_t*)pos_args[0];
+        lteudp_stop();
         if (lteppp_get_state() == E_LTE_PPP && (lteppp_get_legacy() == E_LTE_LEGACY || args[0].u_bool)) {
             lte_disconnect(self);
         } else {
@@ -714,6 +1059,10 @@ STATIC mp_obj_t lte_deinit(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t
             if (!args[0].u_bool || !args[2].u_bool) { /* backward compatibility for dettach method FIXME */
                 vTaskDelay(100);
                 lte_push_at_command("AT!=\"setlpm airplane=1 enable=1\"", LTE_RX_TIMEOUT_MAX_MS);
+                // still attached, a wake from deep sleep can carry on from here
+                if (lte_check_attached(lte_legacyattach_flag)) {
+                    lteppp_rtc_session_save(lte_obj.cid, lte_legacyattach_flag);
+                }
                 lteppp_deinit();
                 lte_obj.init = false;
                 return mp_const_none;
@@ -1113,21 +1462,34 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(lte_isattached_obj, lte_isattached);
 
 STATIC mp_obj_t lte_connect(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     lte_check_init();
-    if (lteppp_get_state() == E_LTE_PPP  && lteppp_ipv4() > 0) {
+    if ((lteppp_get_state() == E_LTE_PPP  && lteppp_ipv4() > 0) || lteudp_is_enabled()) {
         return mp_const_none;
     }
     STATIC const mp_arg_t allowed_args[] = {
         { MP_QSTR_cid,      MP_ARG_KW_ONLY  | MP_ARG_INT, {.u_obj = mp_const_none} },
         { MP_QSTR_legacy,   MP_ARG_KW_ONLY  | MP_ARG_BOOL, {.u_obj = mp_const_none} },
-
+        { MP_QSTR_offload,  MP_ARG_KW_ONLY  | MP_ARG_BOOL, {.u_bool = false} },
     };
 
     // parse args
     mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
+    if (args[2].u_bool) {
+        // the UDP sockets go through the IP stack of the modem, one AT command per datagram, no PPP
+        if (!lte_check_attached(lte_legacyattach_flag) || lteppp_get_state() != E_LTE_ATTACHED) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "modem not attached"));
+        }
+        if (args[0].u_obj != mp_const_none) {
+            lte_obj.cid = args[0].u_int;
+        }
+        lteudp_start(lte_obj.cid);
+        return mp_const_none;
+    }
+
     if (args[1].u_obj == mp_const_none) {
-        args[1].u_bool = lte_check_legacy_version();
+        // a resumed session already knows the modem firmware
+        args[1].u_bool = lte_session_resumed ? (lteppp_get_legacy() == E_LTE_LEGACY) : lte_check_legacy_version();
     }
 
     lte_check_attached(lte_legacyattach_flag);
@@ -1219,6 +1581,10 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(lte_resume_obj, 1, lte_resume);
 
 STATIC mp_obj_t lte_disconnect(mp_obj_t self_in) {
     lte_check_init();
+    if (lteudp_is_enabled()) {
+        lteudp_stop();
+        return mp_const_none;
+    }
     if (lteppp_get_state() == E_LTE_PPP || lteppp_get_state() == E_LTE_SUSPENDED) {
         lteppp_disconnect();
         if (lteppp_get_state() == E_LTE_PPP) {
@@ -1241,7 +1607,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(lte_disconnect_obj, lte_disconnect);
 
 STATIC mp_obj_t lte_isconnected(mp_obj_t self_in) {
     lte_check_init();
-    if (ltepp_is_ppp_conn_up()) {
+    if (ltepp_is_ppp_conn_up() || (lteudp_is_enabled() && lteppp_get_state() == E_LTE_ATTACHED)) {
         return mp_const_true;
     }
     else
@@ -1299,6 +1665,101 @@ STATIC mp_obj_t lte_send_at_cmd(mp_uint_t n_args, const mp_obj_t *pos_args, mp_m
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(lte_send_at_cmd_obj, 1, lte_send_at_cmd);
 
+/******************************************************************************/
+// Reply to an AT command sent with send_at_cmd_async()
+
+typedef struct _lte_at_future_obj_t {
+    mp_obj_base_t base;
+    uint32_t tag;
+    uint32_t deadline;
+    mp_obj_t result;            // MP_OBJ_NULL until the reply is in
+} lte_at_future_obj_t;
+
+STATIC const mp_obj_type_t lte_at_future_type;
+
+STATIC bool lte_at_future_poll (lte_at_future_obj_t *self) {
+    if (self->result == MP_OBJ_NULL) {
+        lte_async_rsp_t *rsp = lteppp_take_async_rsp(self->tag);
+        if (rsp != NULL) {
+            self->result = mp_obj_new_str(rsp->data, rsp->len);
+            free(rsp);
+        }
+    }
+    return self->result != MP_OBJ_NULL;
+}
+
+STATIC mp_obj_t lte_at_future_done (mp_obj_t self_in) {
+    return mp_obj_new_bool(lte_at_future_poll(self_in));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(lte_at_future_done_obj, lte_at_future_done);
+
+STATIC mp_obj_t lte_at_future_result (mp_obj_t self_in) {
+    lte_at_future_obj_t *self = self_in;
+    // the LTE task always replies, even if only with an empty string after the command's
+    // timeout, so only give up if the reply was dropped (eg. it was never collected)
+    while (!lte_at_future_poll(self)) {
+        if ((int32_t)(mp_hal_ticks_ms() - self->deadline) >= 0) {
+            mp_raise_prealloc(MP_PREALLOC_EXC_ETIMEDOUT);
+        }
+        mp_hal_delay_ms(LTE_TASK_POLL_MS);
+    }
+    return self->result;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(lte_at_future_result_obj, lte_at_future_result);
+
+STATIC const mp_map_elem_t lte_at_future_locals_dict_table[] = {
+    { MP_OBJ_NEW_QSTR(MP_QSTR_done),                (mp_obj_t)&lte_at_future_done_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_result),              (mp_obj_t)&lte_at_future_result_obj },
+};
+STATIC MP_DEFINE_CONST_DICT(lte_at_future_locals_dict, lte_at_future_locals_dict_table);
+
+STATIC const mp_obj_type_t lte_at_future_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_ATFuture,
+    .locals_dict = (mp_obj_t)&lte_at_future_locals_dict,
+};
+
+STATIC mp_obj_t lte_send_at_cmd_async(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    lte_check_init();
+    lte_check_inppp();
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_cmd,        MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_timeout,    MP_ARG_KW_ONLY  | MP_ARG_INT, {.u_int = LTE_RX_TIMEOUT_MAX_MS} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    if (!MP_OBJ_IS_STR_OR_BYTES(args[0].u_obj)) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_TypeError, mpexception_num_type_invalid_arguments));
+    }
+    size_t len;
+    const char *cmd_str = mp_obj_str_get_data(args[0].u_obj, &len);
+    lte_task_cmd_data_t cmd = { .timeout = args[1].u_int, .dataLen = len, .expect_continuation = false };
+    if (len >= sizeof(cmd.data)) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "command too long"));
+    }
+    memcpy(cmd.data, cmd_str, len);
+    if (++lte_at_async_tag >= LTE_ASYNC_TAG_OFFLOAD) {
+        lte_at_async_tag = 1;
+    }
+    cmd.tag = lte_at_async_tag;
+    if (lte_debug)
+        printf("[AT-ASYNC] %u #%u %s\n", mp_hal_ticks_ms(), cmd.tag, cmd.data);
+    if (!lteppp_send_at_command_async(&cmd)) {
+        // the command queue is full
+        mp_raise_prealloc(MP_PREALLOC_EXC_EAGAIN);
+    }
+
+    lte_at_future_obj_t *future = m_new_obj(lte_at_future_obj_t);
+    future->base.type = &lte_at_future_type;
+    future->tag = cmd.tag;
+    // the commands queued in front of this one may each take their full timeout too
+    future->deadline = mp_hal_ticks_ms() + (LTE_CMD_QUEUE_SIZE_MAX + 1) * args[1].u_int + LTE_RX_TIMEOUT_MAX_MS;
+    future->result = MP_OBJ_NULL;
+    return future;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(lte_send_at_cmd_async_obj, 1, lte_send_at_cmd_async);
+
 
 STATIC mp_obj_t lte_imei(mp_obj_t self_in) {
     lte_check_init();
@@ -1513,6 +1974,39 @@ STATIC mp_obj_t lte_upgrade_mode(void) {
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(lte_upgrade_mode_obj, lte_upgrade_mode);
+
+STATIC mp_obj_t lte_upgrade_transfer(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_blob,     MP_ARG_REQUIRED | MP_ARG_OBJ,  },
+        { MP_QSTR_size,     MP_ARG_REQUIRED | MP_ARG_INT,  },
+        { MP_QSTR_retry,    MP_ARG_KW_ONLY  | MP_ARG_BOOL, {.u_bool = false} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    // room for one request, followed by the chunk of the image being sent
+    lte_stp_t stp = {.txbuf = m_new(uint8_t, LTE_STP_HEADER_SIZE + LTE_STP_BLOCK_MAX + LTE_STP_CHUNK_SIZE)};
+
+    for (;;) {
+        stp.timeout_ms = LTE_STP_TIMEOUT_MS;
+        stp.error = NULL;
+        uart_flush_input(LTE_STP_UART);
+        if (lte_stp_reset(&stp, false) && lte_stp_open_session(&stp) &&
+            lte_stp_send_data(&stp, args[0].u_obj, args[1].u_int)) {
+            stp.timeout_ms = LTE_STP_CLOSE_TIMEOUT_MS;
+            lte_stp_reset(&stp, true);
+            m_del(uint8_t, stp.txbuf, LTE_STP_HEADER_SIZE + LTE_STP_BLOCK_MAX + LTE_STP_CHUNK_SIZE);
+            return mp_const_true;
+        }
+        mp_printf(&mp_plat_print, "%s\n", stp.error);
+        if (!args[2].u_bool) {
+            break;
+        }
+    }
+    m_del(uint8_t, stp.txbuf, LTE_STP_HEADER_SIZE + LTE_STP_BLOCK_MAX + LTE_STP_CHUNK_SIZE);
+    return mp_const_false;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(lte_upgrade_transfer_obj, 2, lte_upgrade_transfer);
 #ifdef LTE_DEBUG_BUFF
 STATIC mp_obj_t lte_debug_buff(void) {
     vstr_t vstr;
@@ -1536,6 +2030,7 @@ STATIC mp_obj_t lte_callback(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_
         { MP_QSTR_trigger,      MP_ARG_REQUIRED | MP_ARG_OBJ,   },
         { MP_QSTR_handler,      MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
         { MP_QSTR_arg,          MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
+        { MP_QSTR_priority,     MP_ARG_KW_ONLY | MP_ARG_INT,    {.u_int = MP_IRQ_PRIORITY_NORMAL} },
     };
 
     // parse arguments
@@ -1563,7 +2058,7 @@ STATIC mp_obj_t lte_callback(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_
         INTERRUPT_OBJ_CLEAN(self);
     }
 
-    mp_irq_add(self, args[1].u_obj);
+    mp_irq_add_prio(self, args[1].u_obj, args[3].u_int);
 
     return mp_const_none;
 }
@@ -1595,9 +2090,11 @@ STATIC const mp_map_elem_t lte_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_imei),                (mp_obj_t)&lte_imei_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_iccid),               (mp_obj_t)&lte_iccid_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_send_at_cmd),         (mp_obj_t)&lte_send_at_cmd_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_send_at_cmd_async),   (mp_obj_t)&lte_send_at_cmd_async_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_reset),               (mp_obj_t)&lte_reset_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_factory_reset),       (mp_obj_t)&lte_factory_reset_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_modem_upgrade_mode),  (mp_obj_t)&lte_upgrade_mode_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_modem_upgrade_transfer), (mp_obj_t)&lte_upgrade_transfer_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_reconnect_uart),      (mp_obj_t)&lte_reconnect_uart_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_ue_coverage),         (mp_obj_t)&lte_ue_coverage_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_lte_callback),         (mp_obj_t)&lte_callback_obj },
@@ -1628,6 +2125,8 @@ STATIC const mp_map_elem_t lte_locals_dict_table[] = {
 };
 STATIC MP_DEFINE_CONST_DICT(lte_locals_dict, lte_locals_dict_table);
 
+STATIC mod_network_nic_stats_t lte_stats;
+
 const mod_network_nic_type_t mod_network_nic_type_lte = {
     .base = {
         { &mp_type_type },
@@ -1652,5 +2151,6 @@ const mod_network_nic_type_t mod_network_nic_type_lte = {
     .n_ioctl = lwipsocket_socket_ioctl,
     .n_setupssl = lwipsocket_socket_setup_ssl,
     .inf_up = ltepp_is_ppp_conn_up,
-    .set_default_inf = lte_set_default_inf
+    .set_default_inf = lte_set_default_inf,
+    .stats = &lte_stats
 };
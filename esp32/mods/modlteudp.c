@@ -0,0 +1,556 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/param.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/stream.h"
+#include "py/mperrno.h"
+#include "py/mphal.h"
+#include "mpexception.h"
+#include "modnetwork.h"
+#include "modlteudp.h"
+#include "lteppp.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define LTEUDP_SOCKETS_MAX                  (6)     // connIds 1 to 6 of the modem
+#define LTEUDP_PAYLOAD_MAX                  (1500)  // most one AT+SQNSSENDEXT takes
+#define LTEUDP_RECV_MAX                     (512)   // most one AT+SQNSRECV hands over, twice that in hex
+#define LTEUDP_HEX_CHUNK                    (LTE_AT_CMD_DATA_SIZE_MAX - 2)  // hex digits per command of the task
+#define LTEUDP_POLL_MS                      (20)
+#define LTEUDP_NAME_MAX                     (LTE_AT_CMD_DATA_SIZE_MAX - 20)
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+typedef struct _lteudp_obj_t {
+    mp_obj_base_t base;
+    SemaphoreHandle_t mutex;            // held for a whole exchange, the payload has to follow its prompt
+    uint32_t tag;
+    uint8_t cid;
+    uint8_t socket_used;                // u.sd holds the index, the connId is one more
+    uint8_t socket_dialed;
+    uint8_t socket_pending;             // announced by +SQNSRING and not read out yet
+    uint8_t remote_ip[LTEUDP_SOCKETS_MAX][MOD_NETWORK_IPV4ADDR_BUF_SIZE];
+    uint16_t remote_port[LTEUDP_SOCKETS_MAX];
+    uint16_t local_port[LTEUDP_SOCKETS_MAX];
+    bool enabled;
+} lteudp_obj_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+STATIC lteudp_obj_t lteudp_obj = {.base = {(mp_obj_type_t *)&mod_network_nic_type_lte_udp}};
+STATIC mod_network_nic_stats_t lteudp_stats;
+STATIC const char lteudp_hex_digits[] = "0123456789ABCDEF";
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+// queues a tagged command and waits for its reply, which the caller frees; NULL if none came
+STATIC lte_async_rsp_t *lteudp_at (const char *cmd, uint32_t timeout) {
+    lte_task_cmd_data_t at = { .timeout = timeout, .dataLen = strlen(cmd), .expect_continuation = false };
+    if (at.dataLen >= sizeof(at.data)) {
+        return NULL;
+    }
+    memcpy(at.data, cmd, at.dataLen);
+    if (++lteudp_obj.tag < LTE_ASYNC_TAG_OFFLOAD) {
+        lteudp_obj.tag = LTE_ASYNC_TAG_OFFLOAD;
+    }
+    at.tag = lteudp_obj.tag;
+
+    // the commands queued in front of this one may each take their full timeout too
+    uint32_t start = mp_hal_ticks_ms();
+    uint32_t deadline = (LTE_CMD_QUEUE_SIZE_MAX + 1) * timeout + LTE_RX_TIMEOUT_MAX_MS;
+    while (!lteppp_send_at_command_async(&at)) {
+        if (mp_hal_ticks_ms() - start >= deadline) {
+            return NULL;
+        }
+        vTaskDelay(LTEUDP_POLL_MS / portTICK_RATE_MS);
+    }
+    for (;;) {
+        lte_async_rsp_t *rsp = lteppp_take_async_rsp(at.tag);
+        if (rsp != NULL) {
+            return rsp;
+        }
+        if (mp_hal_ticks_ms() - start >= deadline) {
+            return NULL;
+        }
+        vTaskDelay(LTEUDP_POLL_MS / portTICK_RATE_MS);
+    }
+}
+
+STATIC bool lteudp_at_expect (const char *cmd, uint32_t timeout, const char *expected_rsp) {
+    lte_async_rsp_t *rsp = lteudp_at(cmd, timeout);
+    bool ok = (rsp != NULL && strstr(rsp->data, expected_rsp) != NULL);
+    free(rsp);
+    return ok;
+}
+
+STATIC void lteudp_lock (void) {
+    xSemaphoreTake(lteudp_obj.mutex, portMAX_DELAY);
+}
+
+STATIC void lteudp_unlock (void) {
+    xSemaphoreGive(lteudp_obj.mutex);
+}
+
+STATIC int lteudp_hex_value (char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+// decodes at most len bytes, up to the first character that isn't a hex digit
+STATIC mp_uint_t lteudp_unhex (byte *buf, mp_uint_t len, const char *hex) {
+    mp_uint_t n = 0;
+    while (n < len) {
+        int hi = lteudp_hex_value(hex[0]);
+        int lo = (hi < 0) ? -1 : lteudp_hex_value(hex[1]);
+        if (lo < 0) {
+            break;
+        }
+        buf[n++] = (hi << 4) | lo;
+        hex += 2;
+    }
+    return n;
+}
+
+STATIC bool lteudp_socket_get_sn (mod_network_socket_obj_t *s, uint8_t *sn, int *_errno) {
+    int32_t sd = s->sock_base.u.sd;
+    if (!lteudp_obj.enabled || sd < 0 || sd >= LTEUDP_SOCKETS_MAX) {
+        *_errno = MP_EBADF;
+        return false;
+    }
+    *sn = sd;
+    return true;
+}
+
+STATIC void lteudp_hangup (uint8_t sn) {
+    char at_cmd[LTE_AT_CMD_DATA_SIZE_MAX];
+    if (lteudp_obj.socket_dialed & (1 << sn)) {
+        snprintf(at_cmd, sizeof(at_cmd), "AT+SQNSH=%u", sn + 1);
+        lteudp_at_expect(at_cmd, LTE_RX_TIMEOUT_MAX_MS, LTE_OK_RSP);
+        lteudp_obj.socket_dialed &= ~(1 << sn);
+    }
+    lteudp_obj.socket_pending &= ~(1 << sn);
+}
+
+// a UDP "connection" of the modem has a single peer, a datagram to another one dials again
+STATIC int lteudp_dial (uint8_t sn, const byte *ip, mp_uint_t port, int *_errno) {
+    char at_cmd[LTE_AT_CMD_DATA_SIZE_MAX];
+    if ((lteudp_obj.socket_dialed & (1 << sn)) && lteudp_obj.remote_port[sn] == port &&
+        memcmp(lteudp_obj.remote_ip[sn], ip, MOD_NETWORK_IPV4ADDR_BUF_SIZE) == 0) {
+        return 0;
+    }
+    lteudp_hangup(sn);
+    // ring with the amount received, and hex both ways, so that no payload is taken for a reply
+    snprintf(at_cmd, sizeof(at_cmd), "AT+SQNSCFG=%u,%u,300,90,600,50", sn + 1, lteudp_obj.cid);
+    if (!lteudp_at_expect(at_cmd, LTE_RX_TIMEOUT_MAX_MS, LTE_OK_RSP)) {
+        goto fail;
+    }
+    snprintf(at_cmd, sizeof(at_cmd), "AT+SQNSCFGEXT=%u,1,1,0,0,1", sn + 1);
+    if (!lteudp_at_expect(at_cmd, LTE_RX_TIMEOUT_MAX_MS, LTE_OK_RSP)) {
+        goto fail;
+    }
+    // the socket layer keeps the addresses with the last byte first; command mode, the AT port stays usable
+    snprintf(at_cmd, sizeof(at_cmd), "AT+SQNSD=%u,1,%u,\"%u.%u.%u.%u\",0,%u,1", sn + 1, (unsigned)port,
+             ip[3], ip[2], ip[1], ip[0], lteudp_obj.local_port[sn]);
+    if (!lteudp_at_expect(at_cmd, LTE_RX_TIMEOUT_MAX_MS, LTE_OK_RSP)) {
+        goto fail;
+    }
+    memcpy(lteudp_obj.remote_ip[sn], ip, MOD_NETWORK_IPV4ADDR_BUF_SIZE);
+    lteudp_obj.remote_port[sn] = port;
+    lteudp_obj.socket_dialed |= (1 << sn);
+    return 0;
+
+fail:
+    *_errno = MP_ENETUNREACH;
+    return -1;
+}
+
+// one datagram: the command, its prompt, the payload in hex and the final OK
+STATIC int lteudp_write (uint8_t sn, const byte *buf, mp_uint_t len, int *_errno) {
+    char at_cmd[LTE_AT_CMD_DATA_SIZE_MAX];
+    snprintf(at_cmd, sizeof(at_cmd), "AT+SQNSSENDEXT=%u,%u", sn + 1, (unsigned)len);
+    if (!lteudp_at_expect(at_cmd, LTE_RX_TIMEOUT_MAX_MS, "> ")) {
+        *_errno = MP_EIO;
+        return -1;
+    }
+    lte_task_cmd_data_t cmd = { .timeout = 0, .tag = 0, .expect_continuation = true };
+    mp_uint_t i = 0;
+    while (i < len) {
+        size_t n = 0;
+        while (i < len && n + 2 <= LTEUDP_HEX_CHUNK) {
+            cmd.data[n++] = lteudp_hex_digits[buf[i] >> 4];
+            cmd.data[n++] = lteudp_hex_digits[buf[i] & 0x0F];
+            i++;
+        }
+        cmd.data[n] = '\0';
+        cmd.dataLen = n;
+        lteppp_send_at_command(&cmd, NULL);
+    }
+    // only waits for the reply to the payload
+    if (!lteudp_at_expect("Pycom_Dummy", LTE_RX_TIMEOUT_MAX_MS, LTE_OK_RSP)) {
+        *_errno = MP_EIO;
+        return -1;
+    }
+    return len;
+}
+
+// reads what the modem holds for the socket, 0 when it has nothing
+STATIC int lteudp_read (uint8_t sn, byte *buf, mp_uint_t len, int *_errno) {
+    char at_cmd[LTE_AT_CMD_DATA_SIZE_MAX];
+    snprintf(at_cmd, sizeof(at_cmd), "AT+SQNSRECV=%u,%u", sn + 1, (unsigned)MIN(len, LTEUDP_RECV_MAX));
+    lte_async_rsp_t *rsp = lteudp_at(at_cmd, LTE_RX_TIMEOUT_MAX_MS);
+    if (rsp == NULL) {
+        *_errno = MP_EIO;
+        return -1;
+    }
+    // "+SQNSRECV: <connId>,<count>" and the data on the next line, an ERROR when there's none
+    int ret = 0;
+    unsigned int conn_id, count;
+    const char *pos = strstr(rsp->data, "+SQNSRECV: ");
+    if (pos != NULL && sscanf(pos, "+SQNSRECV: %u,%u", &conn_id, &count) == 2 && (pos = strstr(pos, "\r\n")) != NULL) {
+        ret = lteudp_unhex(buf, MIN(count, len), pos + 2);
+    }
+    free(rsp);
+    return ret;
+}
+
+// false once the timeout is over, a timeout of -1 waits for ever
+STATIC bool lteudp_wait (int32_t timeout, uint32_t start) {
+    uint32_t slice = LTEUDP_POLL_MS;
+    if (timeout >= 0) {
+        uint32_t elapsed = mp_hal_ticks_ms() - start;
+        if (elapsed >= timeout) {
+            return false;
+        }
+        slice = MIN(slice, timeout - elapsed);
+    }
+    vTaskDelay(MAX(1, slice / portTICK_RATE_MS));
+    return true;
+}
+
+STATIC bool lteudp_has_data (uint8_t sn) {
+    if (lteppp_socket_ring_take(sn + 1)) {
+        lteudp_obj.socket_pending |= (1 << sn);
+    }
+    return (lteudp_obj.socket_pending & (1 << sn)) != 0;
+}
+
+STATIC int lteudp_gethostbyname (const char *name, mp_uint_t len, uint8_t *out_ip, mp_uint_t family) {
+    char at_cmd[LTE_AT_CMD_DATA_SIZE_MAX];
+    if (!lteudp_obj.enabled) {
+        return -MP_ENETDOWN;
+    }
+    if (len > LTEUDP_NAME_MAX) {
+        return -MP_EINVAL;
+    }
+    snprintf(at_cmd, sizeof(at_cmd), "AT+SQNDNSLKUP=\"%.*s\"", (int)len, name);
+    lteudp_lock();
+    lte_async_rsp_t *rsp = lteudp_at(at_cmd, LTE_RX_TIMEOUT_MAX_MS);
+    lteudp_unlock();
+    if (rsp == NULL) {
+        return -MP_EIO;
+    }
+    // the address is the last field of "+SQNDNSLKUP: ", quoted or not
+    int ret = -MP_ENOENT;
+    const char *pos = strstr(rsp->data, "+SQNDNSLKUP: ");
+    if (pos != NULL) {
+        const char *end = strstr(pos, "\r\n");
+        for (const char *p = pos; *p != '\0' && (end == NULL || p < end); p++) {
+            unsigned int a, b, c, d;
+            if ((*p == ' ' || *p == ',' || *p == '"') && sscanf(p + 1, "%u.%u.%u.%u", &a, &b, &c, &d) == 4 &&
+                a <= 255 && b <= 255 && c <= 255 && d <= 255) {
+                // in network order, as lwIP returns it
+                out_ip[0] = a;
+                out_ip[1] = b;
+                out_ip[2] = c;
+                out_ip[3] = d;
+                ret = 0;
+            }
+        }
+    }
+    free(rsp);
+    return ret;
+}
+
+STATIC int lteudp_socket_socket (mod_network_socket_obj_t *s, int *_errno) {
+    if (s->sock_base.u.u_param.domain != AF_INET) {
+        *_errno = MP_EAFNOSUPPORT;
+        return -1;
+    }
+    if (s->sock_base.u.u_param.type != SOCK_DGRAM) {
+        *_errno = MP_EOPNOTSUPP;
+        return -1;
+    }
+    int sn = -1;
+    lteudp_lock();
+    for (uint8_t i = 0; i < LTEUDP_SOCKETS_MAX; i++) {
+        if ((lteudp_obj.socket_used & (1 << i)) == 0) {
+            lteudp_obj.socket_used |= (1 << i);
+            lteudp_obj.local_port[i] = 0;
+            sn = i;
+            break;
+        }
+    }
+    lteudp_unlock();
+    if (sn < 0) {
+        *_errno = MP_EMFILE;
+        return -1;
+    }
+    // dialed by the first connect or sendto
+    s->sock_base.u.sd = sn;
+    return 0;
+}
+
+STATIC void lteudp_socket_close (mod_network_socket_obj_t *s) {
+    int32_t sd = s->sock_base.u.sd;
+    if (sd >= 0 && sd < LTEUDP_SOCKETS_MAX && lteudp_obj.mutex != NULL) {
+        lteudp_lock();
+        if (lteudp_obj.enabled) {
+            lteudp_hangup(sd);
+        }
+        lteudp_obj.socket_used &= ~(1 << sd);
+        lteudp_unlock();
+    }
+}
+
+STATIC int lteudp_socket_bind (mod_network_socket_obj_t *s, byte *ip, mp_uint_t port, int *_errno) {
+    uint8_t sn;
+    if (!lteudp_socket_get_sn(s, &sn, _errno)) {
+        return -1;
+    }
+    if (lteudp_obj.socket_dialed & (1 << sn)) {
+        *_errno = MP_EINVAL;
+        return -1;
+    }
+    // the modem has a single address, ip is ignored; the port is taken when dialing
+    lteudp_obj.local_port[sn] = port;
+    return 0;
+}
+
+STATIC int lteudp_socket_listen (mod_network_socket_obj_t *s, mp_int_t backlog, int *_errno) {
+    *_errno = MP_EOPNOTSUPP;
+    return -1;
+}
+
+STATIC int lteudp_socket_accept (mod_network_socket_obj_t *s, mod_network_socket_obj_t *s2, byte *ip, mp_uint_t *port, int *_errno) {
+    *_errno = MP_EOPNOTSUPP;
+    return -1;
+}
+
+STATIC int lteudp_socket_connect (mod_network_socket_obj_t *s, byte *ip, mp_uint_t port, int *_errno) {
+    uint8_t sn;
+    if (!lteudp_socket_get_sn(s, &sn, _errno)) {
+        return -1;
+    }
+    lteudp_lock();
+    int ret = lteudp_dial(sn, ip, port, _errno);
+    lteudp_unlock();
+    return ret;
+}
+
+STATIC int lteudp_socket_sendto (mod_network_socket_obj_t *s, const byte *buf, mp_uint_t len, byte *ip, mp_uint_t port, int *_errno) {
+    uint8_t sn;
+    if (!lteudp_socket_get_sn(s, &sn, _errno)) {
+        return -1;
+    }
+    if (len == 0 || len > LTEUDP_PAYLOAD_MAX) {
+        *_errno = MP_EMSGSIZE;
+        return -1;
+    }
+    lteudp_lock();
+    int ret = lteudp_dial(sn, ip, port, _errno);
+    if (ret == 0) {
+        ret = lteudp_write(sn, buf, len, _errno);
+    }
+    lteudp_unlock();
+    return ret;
+}
+
+STATIC int lteudp_socket_send (mod_network_socket_obj_t *s, const byte *buf, mp_uint_t len, int *_errno) {
+    uint8_t sn;
+    if (!lteudp_socket_get_sn(s, &sn, _errno)) {
+        return -1;
+    }
+    if ((lteudp_obj.socket_dialed & (1 << sn)) == 0) {
+        *_errno = MP_ENOTCONN;
+        return -1;
+    }
+    return lteudp_socket_sendto(s, buf, len, lteudp_obj.remote_ip[sn], lteudp_obj.remote_port[sn], _errno);
+}
+
+STATIC int lteudp_socket_recvfrom (mod_network_socket_obj_t *s, byte *buf, mp_uint_t len, byte *ip, mp_uint_t *port, int *_errno) {
+    uint8_t sn;
+    if (!lteudp_socket_get_sn(s, &sn, _errno)) {
+        return -1;
+    }
+    // the modem only receives from the peer it has been dialed to
+    if ((lteudp_obj.socket_dialed & (1 << sn)) == 0) {
+        *_errno = MP_ENOTCONN;
+        return -1;
+    }
+    uint32_t start = mp_hal_ticks_ms();
+    for (;;) {
+        if (lteudp_has_data(sn)) {
+            lteudp_lock();
+            int ret = (len > 0) ? lteudp_read(sn, buf, len, _errno) : 0;
+            // what fills the buffer may not be all there is
+            if (ret < (int)MIN(len, LTEUDP_RECV_MAX)) {
+                lteudp_obj.socket_pending &= ~(1 << sn);
+            }
+            lteudp_unlock();
+            if (ret != 0 || len == 0) {
+                if (ret > 0 && ip != NULL) {
+                    memcpy(ip, lteudp_obj.remote_ip[sn], MOD_NETWORK_IPV4ADDR_BUF_SIZE);
+                    *port = lteudp_obj.remote_port[sn];
+                }
+                return ret;
+            }
+        }
+        if (!lteudp_wait(s->sock_base.timeout, start)) {
+            *_errno = MP_EAGAIN;
+            return -1;
+        }
+    }
+}
+
+STATIC int lteudp_socket_recv (mod_network_socket_obj_t *s, byte *buf, mp_uint_t len, int *_errno) {
+    return lteudp_socket_recvfrom(s, buf, len, NULL, NULL, _errno);
+}
+
+STATIC int lteudp_socket_setsockopt (mod_network_socket_obj_t *s, mp_uint_t level, mp_uint_t opt, const void *optval, mp_uint_t optlen, int *_errno) {
+    uint8_t sn;
+    if (!lteudp_socket_get_sn(s, &sn, _errno)) {
+        return -1;
+    }
+    if (level == SOL_SOCKET && opt == SO_REUSEADDR) {
+        // every modem socket has its own port anyway
+        return 0;
+    }
+    *_errno = MP_EOPNOTSUPP;
+    return -1;
+}
+
+STATIC int lteudp_socket_settimeout (mod_network_socket_obj_t *s, mp_int_t timeout_ms, int *_errno) {
+    // the waiting is done by the calls above
+    s->sock_base.timeout = timeout_ms;
+    return 0;
+}
+
+STATIC int lteudp_socket_ioctl (mod_network_socket_obj_t *s, mp_uint_t request, mp_uint_t arg, int *_errno) {
+    uint8_t sn;
+    if (request != MP_STREAM_POLL) {
+        *_errno = MP_EINVAL;
+        return MP_STREAM_ERROR;
+    }
+    if (!lteudp_socket_get_sn(s, &sn, _errno)) {
+        return MP_STREAM_POLL_NVAL;
+    }
+    int ret = 0;
+    if ((arg & MP_STREAM_POLL_RD) && lteudp_has_data(sn)) {
+        ret |= MP_STREAM_POLL_RD;
+    }
+    if ((arg & MP_STREAM_POLL_WR) && lteppp_get_state() == E_LTE_ATTACHED) {
+        ret |= MP_STREAM_POLL_WR;
+    }
+    return ret;
+}
+
+STATIC int lteudp_socket_setupssl (mod_network_socket_obj_t *s, int *_errno) {
+    // DTLS would have to go through mbedTLS, which only knows lwIP sockets
+    *_errno = MP_EOPNOTSUPP;
+    return -1;
+}
+
+STATIC bool lteudp_inf_up (void) {
+    return lteudp_obj.enabled && lteppp_get_state() == E_LTE_ATTACHED;
+}
+
+STATIC void lteudp_set_default_inf (void) {
+    // not an lwIP interface, the sockets are picked by mod_network_find_nic()
+}
+
+/******************************************************************************
+ DEFINE PUBLIC FUNCTIONS
+ ******************************************************************************/
+// called by LTE.connect(offload=True) once attached, PPP stays down
+void lteudp_start (uint8_t cid) {
+    if (lteudp_obj.mutex == NULL) {
+        lteudp_obj.mutex = xSemaphoreCreateMutex();
+    }
+    lteudp_obj.cid = cid;
+    lteudp_obj.enabled = true;
+    mod_network_register_nic(&lteudp_obj);
+}
+
+void lteudp_stop (void) {
+    if (!lteudp_obj.enabled) {
+        return;
+    }
+    mod_network_deregister_nic(&lteudp_obj);
+    lteudp_lock();
+    for (uint8_t sn = 0; sn < LTEUDP_SOCKETS_MAX; sn++) {
+        lteudp_hangup(sn);
+    }
+    // the sockets still open fail with EBADF from now on
+    lteudp_obj.enabled = false;
+    lteudp_unlock();
+}
+
+bool lteudp_is_enabled (void) {
+    return lteudp_obj.enabled;
+}
+
+const mod_network_nic_type_t mod_network_nic_type_lte_udp = {
+    .base = {
+        { &mp_type_type },
+        .name = MP_QSTR_LTE_UDP,
+    },
+
+    .n_gethostbyname = lteudp_gethostbyname,
+    .n_socket = lteudp_socket_socket,
+    .n_close = lteudp_socket_close,
+    .n_bind = lteudp_socket_bind,
+    .n_listen = lteudp_socket_listen,
+    .n_accept = lteudp_socket_accept,
+    .n_connect = lteudp_socket_connect,
+    .n_send = lteudp_socket_send,
+    .n_recv = lteudp_socket_recv,
+    .n_sendto = lteudp_socket_sendto,
+    .n_recvfrom = lteudp_socket_recvfrom,
+    .n_setsockopt = lteudp_socket_setsockopt,
+    .n_settimeout = lteudp_socket_settimeout,
+    .n_ioctl = lteudp_socket_ioctl,
+    .n_setupssl = lteudp_socket_setupssl,
+    .inf_up = lteudp_inf_up,
+    .set_default_inf = lteudp_set_default_inf,
+    .stats = &lteudp_stats
+};
@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#ifndef MODLTEUDP_H_
+#define MODLTEUDP_H_
+
+#include "modnetwork.h"
+
+extern const mod_network_nic_type_t mod_network_nic_type_lte_udp;
+
+extern void lteudp_start (uint8_t cid);
+extern void lteudp_stop (void);
+extern bool lteudp_is_enabled (void);
+
+#endif  // MODLTEUDP_H_
@@ -54,6 +54,7 @@
 #include "soc/timer_group_struct.h"
 #include "esp_flash_encrypt.h"
 #include "esp_secure_boot.h"
+#include "driver/touch_pad.h"
 
 #include "random.h"
 #include "extmod/machine_mem.h"
@@ -65,10 +66,17 @@
 #include "machpwm.h"
 #include "machrtc.h"
 #include "mperror.h"
+#include "mpexception.h"
 #include "mpsleep.h"
+#include "mptask.h"
 #include "pybadc.h"
 #include "pybdac.h"
 #include "pybsd.h"
+#include "pybsdspi.h"
+#include "machspiflash.h"
+#include "machnrf24l01.h"
+#include "machi2s.h"
+#include "machdisplay.h"
 #include "modbt.h"
 #include "modwlan.h"
 #include "modlora.h"
@@ -76,8 +84,16 @@
 #include "machcan.h"
 #include "machrmt.h"
 #include "machtouch.h"
+#include "machulp.h"
+#include "machpcnt.h"
+#include "machmcpwm.h"
+#include "machneopixel.h"
+#include "machonewire.h"
+#include "machdht.h"
 #include "pycom_config.h"
 #include "modmachine.h"
+#include "fsstate.h"
+#include "crashdump.h"
 #if defined (GPY) || defined (FIPY)
 #include "lteppp.h"
 #endif
@@ -104,6 +120,7 @@
 #define PYGATE_STOP_EVENT           (0x00001)
 #define PYGATE_START_EVENT          (0x00002)
 #define PYGATE_ERROR_EVENT          (0x00004)
+#define PYGATE_RX_EVENT             (0x00008)
 #endif
 
 static RTC_DATA_ATTR int64_t mach_expected_wakeup_time;
@@ -194,6 +211,16 @@ void machine_pygate_set_status(machine_pygate_states_t status)
         mp_irq_queue_interrupt(machine_callback_handler, &machine_obj);
     }
 }
+
+// called by the forwarder when packets are stored in an empty tap ring
+void machine_pygate_rx_event(void)
+{
+    if(machine_obj.trigger & PYGATE_RX_EVENT)
+    {
+        machine_obj.events |= PYGATE_RX_EVENT;
+        mp_irq_queue_interrupt_non_ISR(machine_callback_handler, &machine_obj);
+    }
+}
 #endif
 /// \module machine - functions related to the SoC
 ///
@@ -215,6 +242,7 @@ STATIC mp_obj_t machine_info(void) {
     mp_printf(&mp_plat_print, "ServersTask stack water mark: %d\n", (unsigned int)uxTaskGetStackHighWaterMark((TaskHandle_t)svTaskHandle));
 #if defined (LOPY) || defined (LOPY4) || defined (FIPY)
     mp_printf(&mp_plat_print, "LoRaTask stack water mark: %d\n", (unsigned int)uxTaskGetStackHighWaterMark((TaskHandle_t)xLoRaTaskHndl));
+    mp_printf(&mp_plat_print, "LoRa pending timers: %d\n", (unsigned int)TimerGetPendingCount());
 #endif
 #if defined (SIPY) || defined (LOPY4) || defined (FIPY)
     mp_printf(&mp_plat_print, "SigfoxTask stack water mark: %d\n", (unsigned int)uxTaskGetStackHighWaterMark((TaskHandle_t)xSigfoxTaskHndl));
@@ -228,13 +256,29 @@ STATIC mp_obj_t machine_info(void) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(machine_info_obj, machine_info);
 
+STATIC mp_obj_t machine_irq_stats (void) {
+    return mp_irq_stats();
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(machine_irq_stats_obj, machine_irq_stats);
+
 mp_obj_t NORETURN machine_reset(void) {
+    config_commit();
     machtimer_deinit();
     machine_wdt_start(1);
     for ( ; ; );
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(machine_reset_obj, machine_reset);
 
+// ends the running script like sys.exit() does; a warm one keeps /flash mounted and skips
+// the filesystem and LPWAN set-up, the radio links stay up either way
+STATIC mp_obj_t machine_soft_reset (uint n_args, const mp_obj_t *args) {
+    if (n_args > 0 && mp_obj_is_true(args[0])) {
+        mptask_request_warm_reset();
+    }
+    nlr_raise(mp_obj_new_exception(&mp_type_SystemExit));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(machine_soft_reset_obj, 0, 1, machine_soft_reset);
+
 STATIC mp_obj_t machine_freq(void) {
     return mp_obj_new_int(ets_get_cpu_frequency() * 1000000);
 }
@@ -343,11 +387,57 @@ STATIC mp_obj_t machine_pygate_cmd_get (void) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(machine_pygate_cmd_get_obj, machine_pygate_cmd_get);
 
+/// \function pygate_tap(records)
+/// Makes the forwarder copy every received packet, as a raw PYGATE_TAP_REC_SIZE
+/// bytes record, to a ring of that many records, and returns a memoryview on it.
+/// pygate_tap(0) stops the copies.
+STATIC mp_obj_t machine_pygate_tap (mp_obj_t records_in) {
+    mp_int_t records = mp_obj_get_int(records_in);
+
+    if (records < 0) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "records must be 0 or more"));
+    }
+    // stop the writer before the old ring can be collected, views on it stay valid
+    pkt_tap_start(NULL, 0);
+    MP_STATE_PORT(pygate_tap_buf) = NULL;
+    if (records == 0) {
+        return mp_const_none;
+    }
+    MP_STATE_PORT(pygate_tap_buf) = m_new(uint8_t, records * PKT_TAP_REC_SIZE);
+    pkt_tap_start(MP_STATE_PORT(pygate_tap_buf), records);
+    return mp_obj_new_memoryview('B', records * PKT_TAP_REC_SIZE, MP_STATE_PORT(pygate_tap_buf));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(machine_pygate_tap_obj, machine_pygate_tap);
+
+/// \function pygate_tap_get()
+/// Returns (first, count, dropped): count records are ready from record index first
+/// on, without wrapping around the end of the ring.
+STATIC mp_obj_t machine_pygate_tap_get (void) {
+    uint32_t first, dropped;
+    uint32_t count = pkt_tap_available(&first, &dropped);
+    mp_obj_t tuple[3];
+
+    tuple[0] = mp_obj_new_int_from_uint(first);
+    tuple[1] = mp_obj_new_int_from_uint(count);
+    tuple[2] = mp_obj_new_int_from_uint(dropped);
+    return mp_obj_new_tuple(3, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(machine_pygate_tap_get_obj, machine_pygate_tap_get);
+
+/// \function pygate_tap_release(count)
+/// Gives count records, from the first one returned by pygate_tap_get(), back to the forwarder.
+STATIC mp_obj_t machine_pygate_tap_release (mp_obj_t count_in) {
+    pkt_tap_release(mp_obj_get_int(count_in));
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(machine_pygate_tap_release_obj, machine_pygate_tap_release);
+
 STATIC mp_obj_t machine_callback(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     STATIC const mp_arg_t allowed_args[] = {
         { MP_QSTR_trigger,      MP_ARG_REQUIRED | MP_ARG_OBJ,   },
         { MP_QSTR_handler,      MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
         { MP_QSTR_arg,          MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
+        { MP_QSTR_priority,     MP_ARG_KW_ONLY | MP_ARG_INT,    {.u_int = MP_IRQ_PRIORITY_NORMAL} },
     };
 
     // parse arguments
@@ -369,7 +459,7 @@ STATIC mp_obj_t machine_callback(mp_uint_t n_args, const mp_obj_t *pos_args, mp_
         INTERRUPT_OBJ_CLEAN(&machine_obj);
     }
 
-    mp_irq_add((mp_obj_t)(&machine_obj), args[1].u_obj);
+    mp_irq_add_prio((mp_obj_t)(&machine_obj), args[1].u_obj, args[3].u_int);
 
     return mp_const_none;
 }
@@ -470,19 +560,42 @@ STATIC mp_obj_t machine_deepsleep (uint n_args, const mp_obj_t *arg) {
         lteppp_deinit();
     }
 #endif
+    fsstate_save();
+    config_commit();
+    machtouch_sleep_prepare();
+    mach_rtc_mono_save();
     if (n_args == 0) {
         mach_expected_wakeup_time = 0;
+        mpsleep_stub_arm(0);
         esp_deep_sleep_start();
     } else {
         int64_t sleep_time = (int64_t)mp_obj_get_int_truncated(arg[0]) * 1000;
         struct timeval tv;
         gettimeofday(&tv, NULL);
         mach_expected_wakeup_time = (int64_t)((tv.tv_sec * 1000000ull) + tv.tv_usec) + sleep_time;
+        mpsleep_stub_arm(sleep_time);
         esp_deep_sleep(sleep_time);
     }
 }
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(machine_deepsleep_obj, 0, 1, machine_deepsleep);
 
+STATIC mp_obj_t machine_wake_stub (uint n_args, const mp_obj_t *arg) {
+    if (n_args == 0) {
+        // (boot_every, timer wakes the stub handled alone before this boot)
+        mp_obj_t tuple[2];
+        tuple[0] = mp_obj_new_int_from_uint(mpsleep_stub_get_boot_every());
+        tuple[1] = mp_obj_new_int_from_uint(mpsleep_stub_get_skipped());
+        return mp_obj_new_tuple(2, tuple);
+    }
+    mp_int_t boot_every = mp_obj_get_int(arg[0]);
+    if (boot_every < 1) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    mpsleep_stub_config(boot_every);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(machine_wake_stub_obj, 0, 1, machine_wake_stub);
+
 STATIC mp_obj_t machine_remaining_sleep_time (void) {
     return mp_obj_new_int_from_uint(mach_remaining_sleep_time);
 }
@@ -529,6 +642,11 @@ STATIC mp_obj_t machine_reset_cause (void) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(machine_reset_cause_obj, machine_reset_cause);
 
+STATIC mp_obj_t machine_crash_report (void) {
+    return crashdump_get_report();
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(machine_crash_report_obj, machine_crash_report);
+
 STATIC mp_obj_t machine_wake_reason (void) {
     mpsleep_wake_reason_t wake_reason = mpsleep_get_wake_reason();
     mp_obj_t tuple[2];
@@ -546,6 +664,12 @@ STATIC mp_obj_t machine_wake_reason (void) {
             }
             mask <<= 1ull;
         }
+    } else if (wake_reason == MPSLEEP_TOUCH_WAKE) {
+        gpio_num_t gpio;
+        pins = mp_obj_new_list(0, NULL);
+        if (ESP_OK == touch_pad_get_io_num(esp_sleep_get_touchpad_wakeup_status(), &gpio)) {
+            mp_obj_list_append(pins, pin_find_pin_by_num(&pin_cpu_pins_locals_dict, gpio));
+        }
     }
     tuple[1] = pins;
     return mp_obj_new_tuple(2, tuple);
@@ -607,6 +731,7 @@ STATIC const mp_rom_map_elem_t machine_module_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR_mem32),                       (mp_obj_t)(&machine_mem32_obj) },
 
     { MP_OBJ_NEW_QSTR(MP_QSTR_reset),                   (mp_obj_t)(&machine_reset_obj) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_soft_reset),              (mp_obj_t)(&machine_soft_reset_obj) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_freq),                    (mp_obj_t)(&machine_freq_obj) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_unique_id),               (mp_obj_t)(&machine_unique_id_obj) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_main),                    (mp_obj_t)(&machine_main_obj) },
@@ -614,14 +739,17 @@ STATIC const mp_rom_map_elem_t machine_module_globals_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_idle),                    (mp_obj_t)(&machine_idle_obj) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_sleep),                   (mp_obj_t)(&machine_sleep_obj) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_deepsleep),               (mp_obj_t)(&machine_deepsleep_obj) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_wake_stub),               (mp_obj_t)(&machine_wake_stub_obj) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_remaining_sleep_time),    (mp_obj_t)(&machine_remaining_sleep_time_obj) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_pin_sleep_wakeup),        (mp_obj_t)(&machine_pin_sleep_wakeup_obj) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_reset_cause),             (mp_obj_t)(&machine_reset_cause_obj) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_crash_report),            (mp_obj_t)(&machine_crash_report_obj) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_wake_reason),             (mp_obj_t)(&machine_wake_reason_obj) },
 
     { MP_OBJ_NEW_QSTR(MP_QSTR_disable_irq),             (mp_obj_t)&machine_disable_irq_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_enable_irq),              (mp_obj_t)&machine_enable_irq_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_info),                    (mp_obj_t)&machine_info_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_irq_stats),               (mp_obj_t)&machine_irq_stats_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_temperature),             (mp_obj_t)&machine_temperature_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_flash_encrypt),           (mp_obj_t)&machine_flash_encrypt_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_secure_boot),             (mp_obj_t)&machine_secure_boot_obj },
@@ -633,6 +761,9 @@ STATIC const mp_rom_map_elem_t machine_module_globals_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_pygate_debug_level),      (mp_obj_t)&machine_pygate_debug_level_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_pygate_cmd_decode),       (mp_obj_t)&machine_pygate_cmd_decode_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_pygate_cmd_get),          (mp_obj_t)&machine_pygate_cmd_get_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_pygate_tap),              (mp_obj_t)&machine_pygate_tap_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_pygate_tap_get),          (mp_obj_t)&machine_pygate_tap_get_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_pygate_tap_release),      (mp_obj_t)&machine_pygate_tap_release_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_callback),                (mp_obj_t)&machine_callback_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_events),                  (mp_obj_t)&machine_events_obj },
 #endif
@@ -642,15 +773,28 @@ STATIC const mp_rom_map_elem_t machine_module_globals_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_SPI),                     (mp_obj_t)&mach_spi_type },
     { MP_OBJ_NEW_QSTR(MP_QSTR_I2C),                     (mp_obj_t)&machine_i2c_type },
     { MP_OBJ_NEW_QSTR(MP_QSTR_PWM),                     (mp_obj_t)&mach_pwm_timer_type },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_MCPWM),                   (mp_obj_t)&mach_mcpwm_type },
     { MP_OBJ_NEW_QSTR(MP_QSTR_ADC),                     (mp_obj_t)&pyb_adc_type },
     { MP_OBJ_NEW_QSTR(MP_QSTR_DAC),                     (mp_obj_t)&pyb_dac_type },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_I2S),                     (mp_obj_t)&mach_i2s_type },
     { MP_OBJ_NEW_QSTR(MP_QSTR_SD),                      (mp_obj_t)&pyb_sd_type },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_SDSPI),                   (mp_obj_t)&pyb_sdspi_type },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_SPIFlash),                (mp_obj_t)&mach_spiflash_type },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_NRF24L01),                (mp_obj_t)&mach_nrf24l01_type },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_SSD1306),                 (mp_obj_t)&mach_ssd1306_type },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_LCD160CR),                (mp_obj_t)&mach_lcd160cr_type },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_Counter),                 (mp_obj_t)&mach_counter_type },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_Encoder),                 (mp_obj_t)&mach_encoder_type },
     { MP_OBJ_NEW_QSTR(MP_QSTR_Timer),                   (mp_obj_t)&mach_timer_type },
     { MP_OBJ_NEW_QSTR(MP_QSTR_RTC),                     (mp_obj_t)&mach_rtc_type },
     { MP_OBJ_NEW_QSTR(MP_QSTR_WDT),                     (mp_obj_t)&mach_wdt_type },
     { MP_OBJ_NEW_QSTR(MP_QSTR_CAN),                     (mp_obj_t)&mach_can_type },
     { MP_OBJ_NEW_QSTR(MP_QSTR_RMT),                     (mp_obj_t)&mach_rmt_type },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_NeoPixel),                (mp_obj_t)&mach_neopixel_type },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_OneWire),                 (mp_obj_t)&mach_onewire_type },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_DHT),                     (mp_obj_t)&mach_dht_type },
     { MP_OBJ_NEW_QSTR(MP_QSTR_Touch),                   (mp_obj_t)&machine_touchpad_type },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_ULP),                     (mp_obj_t)&mach_ulp_type },
 
 
     // constants
@@ -665,14 +809,21 @@ STATIC const mp_rom_map_elem_t machine_module_globals_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_PIN_WAKE),            MP_OBJ_NEW_SMALL_INT(MPSLEEP_GPIO_WAKE) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_RTC_WAKE),            MP_OBJ_NEW_SMALL_INT(MPSLEEP_RTC_WAKE) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_ULP_WAKE),            MP_OBJ_NEW_SMALL_INT(MPSLEEP_ULP_WAKE) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_TOUCH_WAKE),          MP_OBJ_NEW_SMALL_INT(MPSLEEP_TOUCH_WAKE) },
 
     { MP_OBJ_NEW_QSTR(MP_QSTR_WAKEUP_ALL_LOW),      MP_OBJ_NEW_SMALL_INT(ESP_EXT1_WAKEUP_ALL_LOW) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_WAKEUP_ANY_HIGH),     MP_OBJ_NEW_SMALL_INT(ESP_EXT1_WAKEUP_ANY_HIGH) },
 
+    { MP_OBJ_NEW_QSTR(MP_QSTR_IRQ_PRIORITY_LOW),      MP_OBJ_NEW_SMALL_INT(MP_IRQ_PRIORITY_LOW) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_IRQ_PRIORITY_NORMAL),   MP_OBJ_NEW_SMALL_INT(MP_IRQ_PRIORITY_NORMAL) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_IRQ_PRIORITY_HIGH),     MP_OBJ_NEW_SMALL_INT(MP_IRQ_PRIORITY_HIGH) },
+
 #ifdef PYGATE_ENABLED
     { MP_OBJ_NEW_QSTR(MP_QSTR_PYGATE_START_EVT),    MP_OBJ_NEW_SMALL_INT(PYGATE_START_EVENT) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_PYGATE_STOP_EVT),     MP_OBJ_NEW_SMALL_INT(PYGATE_STOP_EVENT) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_PYGATE_ERROR_EVT),    MP_OBJ_NEW_SMALL_INT(PYGATE_ERROR_EVENT) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_PYGATE_RX_EVT),       MP_OBJ_NEW_SMALL_INT(PYGATE_RX_EVENT) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_PYGATE_TAP_REC_SIZE), MP_OBJ_NEW_SMALL_INT(PKT_TAP_REC_SIZE) },
 #endif
 };
 
@@ -24,5 +24,6 @@ typedef void (*_sig_func_cb_ptr)(int);
 extern mp_obj_t NORETURN machine_reset(void);
 extern void machine_register_pygate_sig_handler(_sig_func_cb_ptr sig_handler);
 extern void machine_pygate_set_status(machine_pygate_states_t status);
+extern void machine_pygate_rx_event(void);
 
 #endif
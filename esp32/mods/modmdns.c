@@ -12,10 +12,18 @@
 #include "py/obj.h"
 #include "py/runtime.h"
 #include "py/gc.h"
+#include "py/mphal.h"
+#include "py/mperrno.h"
 #include <string.h>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
 #include "mdns.h"
 #include "netutils.h"
+#include "mpirq.h"
+#include "pycom_config.h"
 
 #include "modmdns.h"
 #include "modnetwork.h"
@@ -27,6 +35,20 @@
 #define MOD_MDNS_PROTO_TCP      (0)
 #define MOD_MDNS_PROTO_UDP      (1)
 
+#define MOD_MDNS_NAME_LEN                   (64)
+#define MOD_MDNS_MAX_RESULTS                (10)
+// answers are kept this long, the usual TTL of SRV and address records
+#define MOD_MDNS_CACHE_TTL_MS               (120 * 1000)
+#define MOD_MDNS_CACHE_LEN                  (8)
+#define MOD_MDNS_ASYNC_QUEUE_LEN            (4)
+#define MOD_MDNS_BROWSE_LEN                 (4)
+#define MOD_MDNS_BROWSE_INTERVAL_MS         (10 * 1000)
+#define MOD_MDNS_BROWSE_TIMEOUT_MS          (1000)
+#define MOD_MDNS_TASK_STACK_SIZE            (3072)
+#define MOD_MDNS_TASK_PRIORITY              (5)
+// sent to the task to make it look at the browse table again
+#define MOD_MDNS_WAKEUP                     (0xFF)
+
 /******************************************************************************
  DEFINE PRIVATE TYPES
  ******************************************************************************/
@@ -38,6 +60,37 @@ typedef struct mod_mdns_query_obj_s {
     mp_obj_t txt;                 /* txt record */
     mp_obj_t addr;                /* linked list of IP addresses found */
 }mod_mdns_query_obj_t;
+
+typedef struct {
+    char service_type[MOD_MDNS_NAME_LEN];
+    char instance_name[MOD_MDNS_NAME_LEN];  // empty for a PTR query
+    uint8_t proto;
+} mod_mdns_key_t;
+
+typedef struct {
+    mod_mdns_key_t key;
+    mdns_result_t *results;
+    uint32_t expires_ms;
+    bool used;
+} mod_mdns_cache_entry_t;
+
+// a query run by the mDNS task, its results are handed back to the
+// interrupts task which converts them and puts them in the cache
+typedef struct {
+    mod_mdns_key_t key;
+    uint32_t timeout_ms;
+    uint32_t tag;
+    esp_err_t error;
+    mdns_result_t *results;
+    volatile bool busy;
+} mod_mdns_req_t;
+
+typedef struct {
+    mod_mdns_req_t req;
+    uint32_t interval_ms;
+    TickType_t next;
+    volatile bool active;
+} mod_mdns_browse_t;
 /******************************************************************************
  DECLARE PRIVATE FUNCTIONS
  ******************************************************************************/
@@ -48,9 +101,282 @@ typedef struct mod_mdns_query_obj_s {
 STATIC bool initialized = false;
 STATIC const mp_obj_type_t mod_mdns_query_type;
 
+// the cache is only touched with the GIL held, the mDNS task never sees it
+STATIC mod_mdns_cache_entry_t mod_mdns_cache[MOD_MDNS_CACHE_LEN];
+STATIC mod_mdns_req_t mod_mdns_reqs[MOD_MDNS_ASYNC_QUEUE_LEN];
+STATIC mod_mdns_browse_t mod_mdns_browses[MOD_MDNS_BROWSE_LEN];
+STATIC QueueHandle_t mod_mdns_queue;
+STATIC uint32_t mod_mdns_tag;
+
 /******************************************************************************
  DEFINE PRIVATE FUNCTIONS
  ******************************************************************************/
+STATIC const char *mod_mdns_get_proto (mp_int_t proto_num) {
+    if(proto_num != MOD_MDNS_PROTO_TCP && proto_num != MOD_MDNS_PROTO_UDP) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "proto must be 0 (TCP) or 1 (UDP)"));
+    }
+    return proto_num == MOD_MDNS_PROTO_TCP ? "_tcp" : "_udp";
+}
+
+STATIC void mod_mdns_check_initialized (void) {
+    if(initialized == false) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_RuntimeError, "MDNS module is not initialized!"));
+    }
+}
+
+STATIC void mod_mdns_copy_name (char *dest, mp_obj_t name_in) {
+    size_t len;
+    const char *name = mp_obj_str_get_data(name_in, &len);
+    if (len >= MOD_MDNS_NAME_LEN) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "name too long"));
+    }
+    memcpy(dest, name, len);
+    dest[len] = '\0';
+}
+
+STATIC void mod_mdns_make_key (mod_mdns_key_t *key, mp_obj_t service_type, mp_int_t proto_num, mp_obj_t instance_name) {
+    memset(key, 0, sizeof(*key));
+    mod_mdns_get_proto(proto_num);
+    mod_mdns_copy_name(key->service_type, service_type);
+    if (instance_name != MP_OBJ_NULL && instance_name != mp_const_none) {
+        mod_mdns_copy_name(key->instance_name, instance_name);
+    }
+    key->proto = proto_num;
+}
+
+STATIC bool mod_mdns_key_equal (const mod_mdns_key_t *a, const mod_mdns_key_t *b) {
+    return a->proto == b->proto && !strcmp(a->service_type, b->service_type) && !strcmp(a->instance_name, b->instance_name);
+}
+
+// blocking, so it runs without the GIL
+STATIC esp_err_t mod_mdns_run_query (const mod_mdns_key_t *key, uint32_t timeout_ms, mdns_result_t **results) {
+    const char *proto = key->proto == MOD_MDNS_PROTO_TCP ? "_tcp" : "_udp";
+    *results = NULL;
+    if (key->instance_name[0] == '\0') {
+        return mdns_query_ptr(key->service_type, proto, timeout_ms, MOD_MDNS_MAX_RESULTS, results);
+    }
+    return mdns_query_srv(key->instance_name, key->service_type, proto, timeout_ms, results);
+}
+
+STATIC mp_obj_t mod_mdns_new_str (const char *str) {
+    return str ? mp_obj_new_str(str, strlen(str)) : MP_OBJ_NEW_QSTR(MP_QSTR_);
+}
+
+STATIC mp_obj_t mod_mdns_results_to_list (const mdns_result_t *result) {
+    mp_obj_t queries_list = mp_obj_new_list(0, NULL);
+    while(result != NULL) {
+        mod_mdns_query_obj_t *query_obj = m_new(mod_mdns_query_obj_t, 1);
+        query_obj->base.type = (mp_obj_t)&mod_mdns_query_type;
+        query_obj->instance_name = mod_mdns_new_str(result->instance_name);
+        query_obj->hostname = mod_mdns_new_str(result->hostname);
+        query_obj->port = mp_obj_new_int(result->port);
+
+        query_obj->txt = mp_obj_new_list(0, NULL);
+        for(int i = 0; i < result->txt_count; i++) {
+            mp_obj_t tuple[2];
+            tuple[0] = mod_mdns_new_str(result->txt[i].key);
+            tuple[1] = mod_mdns_new_str(result->txt[i].value);
+            mp_obj_list_append(query_obj->txt, mp_obj_new_tuple(2, tuple));
+        }
+
+        if (result->addr) {
+            query_obj->addr = netutils_format_ipv4_addr((uint8_t *)&result->addr->addr.u_addr.ip4.addr, NETUTILS_BIG);
+        } else {
+            u32_t zero_ip = 0;
+            query_obj->addr = netutils_format_ipv4_addr((uint8_t *)&zero_ip, NETUTILS_BIG);
+        }
+
+        mp_obj_list_append(queries_list, query_obj);
+
+        result = result->next;
+    }
+    return queries_list;
+}
+
+STATIC mod_mdns_cache_entry_t *mod_mdns_cache_find (const mod_mdns_key_t *key) {
+    uint32_t now = mp_hal_ticks_ms();
+    for (int i = 0; i < MOD_MDNS_CACHE_LEN; i++) {
+        mod_mdns_cache_entry_t *entry = &mod_mdns_cache[i];
+        if (entry->used && mod_mdns_key_equal(&entry->key, key)) {
+            if ((int32_t)(entry->expires_ms - now) > 0) {
+                return entry;
+            }
+            // expired, make room
+            mdns_query_results_free(entry->results);
+            entry->used = false;
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+// takes ownership of the results, replacing the entry with the same key or
+// else the one closest to expiring
+STATIC void mod_mdns_cache_put (const mod_mdns_key_t *key, mdns_result_t *results) {
+    mod_mdns_cache_entry_t *slot = NULL;
+    for (int i = 0; i < MOD_MDNS_CACHE_LEN; i++) {
+        mod_mdns_cache_entry_t *entry = &mod_mdns_cache[i];
+        if (entry->used && mod_mdns_key_equal(&entry->key, key)) {
+            slot = entry;
+            break;
+        }
+        if (slot == NULL || !entry->used || (slot->used && (int32_t)(entry->expires_ms - slot->expires_ms) < 0)) {
+            slot = entry;
+        }
+    }
+    if (slot->used) {
+        mdns_query_results_free(slot->results);
+    }
+    slot->key = *key;
+    slot->results = results;
+    slot->expires_ms = mp_hal_ticks_ms() + MOD_MDNS_CACHE_TTL_MS;
+    slot->used = true;
+}
+
+STATIC void mod_mdns_cache_clear (void) {
+    for (int i = 0; i < MOD_MDNS_CACHE_LEN; i++) {
+        if (mod_mdns_cache[i].used) {
+            mdns_query_results_free(mod_mdns_cache[i].results);
+            mod_mdns_cache[i].used = false;
+        }
+    }
+}
+
+// converts the results of a finished query and keeps them in the cache
+STATIC mp_obj_t mod_mdns_collect (mod_mdns_req_t *req) {
+    mp_obj_t list = mod_mdns_results_to_list(req->results);
+    // an empty answer isn't kept, the service may show up any moment
+    if (initialized && req->error == ESP_OK && req->results != NULL) {
+        mod_mdns_cache_put(&req->key, req->results);
+    } else {
+        mdns_query_results_free(req->results);
+    }
+    req->results = NULL;
+    return list;
+}
+
+// the results of a query_async(), called from the interrupts task
+STATIC void mod_mdns_async_done (void *arg) {
+    mod_mdns_req_t *req = arg;
+    mp_obj_tuple_t *irq = mp_irq_find(req);
+    mp_obj_t list = mod_mdns_collect(req);
+    req->busy = false;
+    if (irq == NULL) {
+        return;
+    }
+    mp_obj_list_t *pending = MP_OBJ_TO_PTR(irq->items[1]);
+    mp_obj_t handler = pending->items[0];
+    if (pending->items[1] != mp_const_none) {
+        // answered from the cache, the task was skipped
+        list = pending->items[1];
+    }
+    mp_irq_remove(req);
+    if (handler != mp_const_none) {
+        mp_call_function_n_kw(handler, 3, 0, (mp_obj_t []){ mp_obj_new_int_from_uint(req->tag),
+                                                           MP_OBJ_NEW_SMALL_INT(req->error), list });
+    }
+}
+
+STATIC bool mod_mdns_tables_differ (mp_obj_t old_in, mp_obj_t new_in) {
+    if (old_in == mp_const_none) {
+        return true;
+    }
+    size_t old_len, new_len;
+    mp_obj_t *old_items, *new_items;
+    mp_obj_list_get(old_in, &old_len, &old_items);
+    mp_obj_list_get(new_in, &new_len, &new_items);
+    if (old_len != new_len) {
+        return true;
+    }
+    for (size_t i = 0; i < new_len; i++) {
+        mod_mdns_query_obj_t *n = MP_OBJ_TO_PTR(new_items[i]);
+        bool found = false;
+        for (size_t j = 0; j < old_len && !found; j++) {
+            mod_mdns_query_obj_t *o = MP_OBJ_TO_PTR(old_items[j]);
+            found = mp_obj_equal(n->instance_name, o->instance_name) && mp_obj_equal(n->hostname, o->hostname) &&
+                    mp_obj_equal(n->port, o->port) && mp_obj_equal(n->addr, o->addr);
+        }
+        if (!found) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// a browse query is back: update the service table and tell the handler when it changed
+STATIC void mod_mdns_browse_done (void *arg) {
+    mod_mdns_browse_t *browse = arg;
+    mp_obj_tuple_t *irq = mp_irq_find(browse);
+    esp_err_t error = browse->req.error;
+    mp_obj_t list = mod_mdns_collect(&browse->req);
+    browse->req.busy = false;
+    if (irq == NULL || !browse->active || error != ESP_OK) {
+        return;
+    }
+    mp_obj_list_t *pending = MP_OBJ_TO_PTR(irq->items[1]);
+    bool changed = mod_mdns_tables_differ(pending->items[1], list);
+    pending->items[1] = list;
+    if (changed && pending->items[0] != mp_const_none) {
+        mp_call_function_n_kw(pending->items[0], 3, 0, (mp_obj_t []){ mod_mdns_new_str(browse->req.key.service_type),
+                                                                     MP_OBJ_NEW_SMALL_INT(browse->req.key.proto), list });
+    }
+}
+
+// runs the due browse queries and returns how long until the next one
+STATIC TickType_t mod_mdns_run_browses (void) {
+    TickType_t wait = portMAX_DELAY;
+    for (int i = 0; i < MOD_MDNS_BROWSE_LEN; i++) {
+        mod_mdns_browse_t *browse = &mod_mdns_browses[i];
+        if (!browse->active) {
+            continue;
+        }
+        // the last answer hasn't been collected yet
+        if (browse->req.busy) {
+            wait = MIN(wait, MOD_MDNS_BROWSE_TIMEOUT_MS / portTICK_PERIOD_MS);
+            continue;
+        }
+        int32_t due = (int32_t)(browse->next - xTaskGetTickCount());
+        if (due <= 0) {
+            browse->req.busy = true;
+            browse->req.error = mod_mdns_run_query(&browse->req.key, browse->req.timeout_ms, &browse->req.results);
+            browse->next = xTaskGetTickCount() + browse->interval_ms / portTICK_PERIOD_MS;
+            mp_irq_queue_interrupt_non_ISR(mod_mdns_browse_done, (void *)browse);
+            due = browse->interval_ms / portTICK_PERIOD_MS;
+        }
+        wait = MIN(wait, due);
+    }
+    return wait;
+}
+
+STATIC void TASK_mDNS (void *pvParameters) {
+    TickType_t wait = portMAX_DELAY;
+    uint8_t idx;
+    for (;;) {
+        if (xQueueReceive(mod_mdns_queue, &idx, wait) == pdTRUE && idx != MOD_MDNS_WAKEUP) {
+            mod_mdns_req_t *req = &mod_mdns_reqs[idx];
+            req->error = mod_mdns_run_query(&req->key, req->timeout_ms, &req->results);
+            mp_irq_queue_interrupt_non_ISR(mod_mdns_async_done, (void *)req);
+        }
+        wait = mod_mdns_run_browses();
+    }
+}
+
+STATIC void mod_mdns_start_task (void) {
+    if (mod_mdns_queue == NULL) {
+        mod_mdns_queue = xQueueCreate(MOD_MDNS_ASYNC_QUEUE_LEN + 1, sizeof(uint8_t));
+        xTaskCreatePinnedToCore(TASK_mDNS, "mDNS", MOD_MDNS_TASK_STACK_SIZE / sizeof(StackType_t), NULL,
+                                MOD_MDNS_TASK_PRIORITY, NULL, config_get_service_core());
+    }
+}
+
+STATIC mod_mdns_browse_t *mod_mdns_browse_find (const mod_mdns_key_t *key) {
+    for (int i = 0; i < MOD_MDNS_BROWSE_LEN; i++) {
+        if (mod_mdns_browses[i].active && mod_mdns_key_equal(&mod_mdns_browses[i].req.key, key)) {
+            return &mod_mdns_browses[i];
+        }
+    }
+    return NULL;
+}
 
 /******************************************************************************
  DEFINE MDNS CLASS FUNCTIONS
@@ -86,6 +412,13 @@ STATIC mp_obj_t mod_mdns_deinit() {
 
     if(initialized == true) {
 
+        for (int i = 0; i < MOD_MDNS_BROWSE_LEN; i++) {
+            if (mod_mdns_browses[i].active) {
+                mod_mdns_browses[i].active = false;
+                mp_irq_remove(&mod_mdns_browses[i]);
+            }
+        }
+        mod_mdns_cache_clear();
         mdns_service_remove_all();
         mdns_free();
         initialized = false;
@@ -229,99 +562,168 @@ STATIC mp_obj_t mod_mdns_remove_service(mp_obj_t service_type_in, mp_obj_t proto
 STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_mdns_remove_service_obj, mod_mdns_remove_service);
 
 
-// Initiate a new query
-STATIC mp_obj_t mod_mdns_query(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
-
-    STATIC const mp_arg_t mod_mdns_query_args[] = {
-            { MP_QSTR_timeout,                  MP_ARG_INT  | MP_ARG_REQUIRED, },
-            { MP_QSTR_service_type,             MP_ARG_OBJ  | MP_ARG_REQUIRED, },
-            { MP_QSTR_proto,                    MP_ARG_INT  | MP_ARG_REQUIRED, },
-            { MP_QSTR_instance_name,            MP_ARG_OBJ  | MP_ARG_KW_ONLY,  {.u_obj = MP_OBJ_NULL}},
-    };
+STATIC const mp_arg_t mod_mdns_query_args[] = {
+    { MP_QSTR_timeout,                  MP_ARG_INT  | MP_ARG_REQUIRED, },
+    { MP_QSTR_service_type,             MP_ARG_OBJ  | MP_ARG_REQUIRED, },
+    { MP_QSTR_proto,                    MP_ARG_INT  | MP_ARG_REQUIRED, },
+    { MP_QSTR_instance_name,            MP_ARG_OBJ  | MP_ARG_KW_ONLY,  {.u_obj = MP_OBJ_NULL}},
+    { MP_QSTR_cache,                    MP_ARG_BOOL | MP_ARG_KW_ONLY,  {.u_bool = true}},
+    { MP_QSTR_handler,                  MP_ARG_OBJ  | MP_ARG_KW_ONLY,  {.u_obj = mp_const_none}},
+};
 
-    if(initialized == true) {
+// Initiate a new query, answered from the cache when an earlier one is still fresh
+STATIC mp_obj_t mod_mdns_query(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
 
-        mp_arg_val_t args[MP_ARRAY_SIZE(mod_mdns_query_args)];
-        mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(args), mod_mdns_query_args, args);
+    mod_mdns_check_initialized();
 
-        // Get timeout value
-        uint32_t timeout = args[0].u_int;
+    // handler= is only for query_async()
+    mp_arg_val_t args[MP_ARRAY_SIZE(mod_mdns_query_args) - 1];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(args), mod_mdns_query_args, args);
 
-        // Get service type
-        const char * service_type = mp_obj_str_get_str(args[1].u_obj);
+    mod_mdns_key_t key;
+    mod_mdns_make_key(&key, args[1].u_obj, args[2].u_int, args[3].u_obj);
 
-        // Get proto
-        const char * proto = NULL;
-        mp_int_t proto_num = args[2].u_int;
-        if(proto_num != MOD_MDNS_PROTO_TCP && proto_num != MOD_MDNS_PROTO_UDP) {
-            nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "proto must be 0 (TCP) or 1 (UDP)"));
+    if (args[4].u_bool) {
+        mod_mdns_cache_entry_t *entry = mod_mdns_cache_find(&key);
+        if (entry != NULL) {
+            return mod_mdns_results_to_list(entry->results);
         }
-        proto = proto_num == MOD_MDNS_PROTO_TCP ? "_tcp" : "_udp";
+    }
 
-        // Get instance name
-        const char * instance_name = NULL;
-        if(args[3].u_obj != NULL) {
-            instance_name = mp_obj_str_get_str(args[3].u_obj);
-        }
+    mod_mdns_req_t req = { .key = key, .results = NULL };
+    MP_THREAD_GIL_EXIT();
+    req.error = mod_mdns_run_query(&key, args[0].u_int, &req.results);
+    MP_THREAD_GIL_ENTER();
 
+    if(req.error != ESP_OK) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_RuntimeError, "Query failed, error code: %d", req.error));
+    }
+    return mod_mdns_collect(&req);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_mdns_query_obj, 3, mod_mdns_query);
 
-        mdns_result_t *results;
-        esp_err_t ret;
+// The same as query() but returns a tag right away, handler(tag, error, results)
+// is called once the answer is in, with error 0 on success
+STATIC mp_obj_t mod_mdns_query_async(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
 
-        if(instance_name == NULL) {
-            ret = mdns_query_ptr(service_type, proto, timeout, 10, &results);
-        }
-        else {
-            ret = mdns_query_srv(instance_name, service_type, proto, timeout, &results);
-        }
+    mod_mdns_check_initialized();
 
+    mp_arg_val_t args[MP_ARRAY_SIZE(mod_mdns_query_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(args), mod_mdns_query_args, args);
 
-        if(ret != ESP_OK) {
-            nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_RuntimeError, "Query failed, error code: %d", ret));
-        }
-        else {
-            mdns_result_t *result = results;
-            mp_obj_t queries_list = mp_obj_new_list(0, NULL);
-            while(result != NULL) {
-                mod_mdns_query_obj_t *query_obj = m_new(mod_mdns_query_obj_t, 1);
-                query_obj->base.type = (mp_obj_t)&mod_mdns_query_type;
-                query_obj->instance_name = mp_obj_new_str(result->instance_name, strlen(result->instance_name));
-                query_obj->hostname = mp_obj_new_str(result->hostname, strlen(result->hostname));
-                query_obj->port = mp_obj_new_int(result->port);
-
-                query_obj->txt = mp_obj_new_list(0, NULL);
-                for(int i = 0; i < result->txt_count; i++) {
-                    mp_obj_t tuple[2];
-                    tuple[0] = mp_obj_new_str(result->txt[i].key, strlen(result->txt[i].key));
-                    tuple[1] = mp_obj_new_str(result->txt[i].value, strlen(result->txt[i].value));
-                    mp_obj_list_append(query_obj->txt, mp_obj_new_tuple(2, tuple));
-                }
+    mod_mdns_key_t key;
+    mod_mdns_make_key(&key, args[1].u_obj, args[2].u_int, args[3].u_obj);
 
-                if (result->addr) {
-                    query_obj->addr = netutils_format_ipv4_addr((uint8_t *)&result->addr->addr.u_addr.ip4.addr, NETUTILS_BIG);
-                } else {
-                    u32_t zero_ip = 0;
-                    query_obj->addr = netutils_format_ipv4_addr((uint8_t *)&zero_ip, NETUTILS_BIG);
-                }
+    uint8_t idx;
+    for (idx = 0; idx < MOD_MDNS_ASYNC_QUEUE_LEN && mod_mdns_reqs[idx].busy; idx++);
+    if (idx == MOD_MDNS_ASYNC_QUEUE_LEN) {
+        mp_raise_OSError(MP_ENOBUFS);
+    }
+    mod_mdns_start_task();
+
+    mod_mdns_req_t *req = &mod_mdns_reqs[idx];
+    req->key = key;
+    req->timeout_ms = args[0].u_int;
+    req->tag = ++mod_mdns_tag;
+    req->error = ESP_OK;
+    req->results = NULL;
+    req->busy = true;
+
+    mp_obj_t pending[2] = { args[5].u_obj, mp_const_none };
+    mod_mdns_cache_entry_t *entry = args[4].u_bool ? mod_mdns_cache_find(&key) : NULL;
+    if (entry != NULL) {
+        pending[1] = mod_mdns_results_to_list(entry->results);
+    }
+    mp_irq_add(req, mp_obj_new_list(2, pending));
+    if (entry != NULL) {
+        mp_irq_queue_interrupt_non_ISR(mod_mdns_async_done, (void *)req);
+    } else {
+        xQueueSend(mod_mdns_queue, &idx, portMAX_DELAY);
+    }
+    return mp_obj_new_int_from_uint(req->tag);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_mdns_query_async_obj, 3, mod_mdns_query_async);
 
-                mp_obj_list_append(queries_list, query_obj);
+// Keep querying for a service in the background, handler(service_type, proto, results)
+// is called whenever the instances found change
+STATIC mp_obj_t mod_mdns_browse(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
 
-                result = result->next;
-            }
+    STATIC const mp_arg_t mod_mdns_browse_args[] = {
+            { MP_QSTR_service_type,             MP_ARG_OBJ  | MP_ARG_REQUIRED, },
+            { MP_QSTR_proto,                    MP_ARG_INT  | MP_ARG_REQUIRED, },
+            { MP_QSTR_interval,                 MP_ARG_INT  | MP_ARG_KW_ONLY,  {.u_int = MOD_MDNS_BROWSE_INTERVAL_MS}},
+            { MP_QSTR_timeout,                  MP_ARG_INT  | MP_ARG_KW_ONLY,  {.u_int = MOD_MDNS_BROWSE_TIMEOUT_MS}},
+            { MP_QSTR_handler,                  MP_ARG_OBJ  | MP_ARG_KW_ONLY,  {.u_obj = mp_const_none}},
+    };
 
-            mdns_query_results_free(results);
+    mod_mdns_check_initialized();
 
-            return queries_list;
+    mp_arg_val_t args[MP_ARRAY_SIZE(mod_mdns_browse_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(args), mod_mdns_browse_args, args);
 
-        }
+    mod_mdns_key_t key;
+    mod_mdns_make_key(&key, args[0].u_obj, args[1].u_int, MP_OBJ_NULL);
+    if (args[2].u_int < args[3].u_int) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "interval must not be shorter than timeout"));
     }
-    else {
-        nlr_raise(mp_obj_new_exception_msg(&mp_type_RuntimeError, "MDNS module is not initialized!"));
+
+    mod_mdns_browse_t *browse = mod_mdns_browse_find(&key);
+    if (browse == NULL) {
+        for (int i = 0; i < MOD_MDNS_BROWSE_LEN && browse == NULL; i++) {
+            // a stopped browse stays busy until its last answer has been collected
+            if (!mod_mdns_browses[i].active && !mod_mdns_browses[i].req.busy) {
+                browse = &mod_mdns_browses[i];
+            }
+        }
+        if (browse == NULL) {
+            mp_raise_OSError(MP_ENOBUFS);
+        }
     }
+    mod_mdns_start_task();
+
+    browse->active = false;
+    browse->req.key = key;
+    browse->req.timeout_ms = args[3].u_int;
+    browse->interval_ms = args[2].u_int;
+    browse->next = xTaskGetTickCount();
+    mp_obj_t pending[2] = { args[4].u_obj, mp_const_none };
+    mp_irq_add(browse, mp_obj_new_list(2, pending));
+    browse->active = true;
+
+    uint8_t wakeup = MOD_MDNS_WAKEUP;
+    xQueueSend(mod_mdns_queue, &wakeup, 0);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_mdns_browse_obj, 2, mod_mdns_browse);
+
+STATIC mp_obj_t mod_mdns_stop_browse(mp_obj_t service_type_in, mp_obj_t proto_in) {
 
+    mod_mdns_key_t key;
+    mod_mdns_make_key(&key, service_type_in, mp_obj_get_int(proto_in), MP_OBJ_NULL);
+    mod_mdns_browse_t *browse = mod_mdns_browse_find(&key);
+    if (browse != NULL) {
+        browse->active = false;
+        mp_irq_remove(browse);
+    }
     return mp_const_none;
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_mdns_query_obj, 3, mod_mdns_query);
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_mdns_stop_browse_obj, mod_mdns_stop_browse);
+
+// The latest instances found by browse(), None if the service isn't browsed or
+// hasn't been answered yet
+STATIC mp_obj_t mod_mdns_services(mp_obj_t service_type_in, mp_obj_t proto_in) {
+
+    mod_mdns_key_t key;
+    mod_mdns_make_key(&key, service_type_in, mp_obj_get_int(proto_in), MP_OBJ_NULL);
+    mod_mdns_browse_t *browse = mod_mdns_browse_find(&key);
+    mp_obj_tuple_t *irq = browse ? mp_irq_find(browse) : NULL;
+    if (irq == NULL) {
+        return mp_const_none;
+    }
+    mp_obj_list_t *pending = MP_OBJ_TO_PTR(irq->items[1]);
+    return pending->items[1];
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_mdns_services_obj, mod_mdns_services);
 
 STATIC mp_obj_t mod_mdns_query_instance_name(mp_obj_t self) {
 
@@ -380,6 +782,10 @@ STATIC const mp_map_elem_t mod_mdns_globals_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_add_service),                     (mp_obj_t)&mod_mdns_add_service_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_remove_service),                  (mp_obj_t)&mod_mdns_remove_service_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_query),                           (mp_obj_t)&mod_mdns_query_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_query_async),                     (mp_obj_t)&mod_mdns_query_async_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_browse),                          (mp_obj_t)&mod_mdns_browse_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_stop_browse),                     (mp_obj_t)&mod_mdns_stop_browse_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_services),                        (mp_obj_t)&mod_mdns_services_obj },
 
     // class constants
     { MP_OBJ_NEW_QSTR(MP_QSTR_PROTO_TCP),                     MP_OBJ_NEW_SMALL_INT(MOD_MDNS_PROTO_TCP) },
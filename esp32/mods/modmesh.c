@@ -11,6 +11,9 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_attr.h"
 
 #include <stdint.h>
 #include <stdio.h>
@@ -32,6 +35,7 @@
 #include "py/stream.h"
 #include "modusocket.h"
 #include "pycom_config.h"
+#include "modlora.h"
 
 #include "util/mpirq.h"
 
@@ -54,13 +58,18 @@
 #include "lora/otplat_radio.h"
 #include "lora/ot-settings.h"
 #include "lora/ot-log.h"
+#include "pollwait.h"
+#include "lwip/sockets.h"       // for SOL_SOCKET and SO_RCVBUF
 
 /******************************************************************************
  DEFINE PRIVATE CONSTANTS
  ******************************************************************************/
 #define MESH_STACK_SIZE                                             (8192)
 #define MESH_TASK_PRIORITY                                          (6)
-#define OT_DATA_QUEUE_SIZE_MAX                                      (5)
+#define OT_DATA_QUEUE_SIZE_DEFAULT                                  (5)
+#define OT_DATA_QUEUE_SIZE_MAX                                      (32)
+// the Mesh task is woken up by events, this is only a safety net
+#define MESH_TASK_WAIT_MAX_MS                                       (100)
 #define OT_RX_PACK_SIZE_MAX                                         (512)
 #define IPV6_HEADER_UDP_PROTOCOL_CODE                               (17)
 #define MESH_CLI_OUTPUT_SIZE                                        (1024)
@@ -77,6 +86,9 @@
 // number of Mesh.leader() micropy command fields
 #define MESH_LEADER_FIELDS_NUM                                      (3)
 
+// number of Mesh.rx_stats() micropy command fields
+#define MESH_RX_STATS_FIELDS_NUM                                    (5)
+
 // number of Mesh.border_router() micropy command fields
 #define MESH_BR_FIELDS_NUM                                          (2)
 
@@ -154,6 +166,9 @@ typedef struct {
     otIp6Address ip;                        // ipv6
     //char ip_str[MOD_USOCKET_IPV6_CHARS_MAX];// IPv6 in string
     QueueHandle_t rx_queue;                 // queue for RX packages
+    uint16_t rx_depth;                      // max number of packages in rx_queue
+    uint32_t rx_received;                   // packages stored in rx_queue
+    uint32_t rx_dropped;                    // oldest packages dropped because rx_queue was full
 }pymesh_socket_t;
 
 /******************************************************************************
@@ -164,6 +179,8 @@ static otInstance *ot = NULL;
 static otIp6Prefix border_router_prefix;
 static mesh_obj_t mesh_obj;
 static pymesh_socket_t sockets[UDP_SOCKETS_MAX];
+// guards the rx queues, shared between the Mesh task and the micropython threads
+static SemaphoreHandle_t xSocketsMutex;
 
 /******************************************************************************
  DECLARE PUBLIC DATA
@@ -211,6 +228,8 @@ static int mesh_del_border_router(const char* ipv6_net_str);
 
 static pymesh_socket_t *find_socket(mod_network_socket_obj_t *nic_sock);
 
+static void mesh_socket_rx_push(pymesh_socket_t *sock, const ot_rx_data_t *rx_data);
+
 /******************************************************************************
  DEFINE PUBLIC FUNCTIONS
  ******************************************************************************/
@@ -222,6 +241,29 @@ bool lora_mesh_ready(void) {
     return mesh_obj.ot_ready;
 }
 
+/*
+ * wakes up the Mesh task, called when a LoRa frame arrived or openthread has work to do
+ */
+void mesh_task_notify(void) {
+    if (xMeshTaskHndl) {
+        xTaskNotifyGive(xMeshTaskHndl);
+    }
+}
+
+void IRAM_ATTR mesh_task_notify_from_isr(void) {
+    if (xMeshTaskHndl) {
+        vTaskNotifyGiveFromISR(xMeshTaskHndl, NULL);
+    }
+}
+
+/*
+ * called by openthread when a tasklet was posted
+ */
+void otTaskletsSignalPending(otInstance *aInstance) {
+    (void) aInstance;
+    mesh_task_notify();
+}
+
 // opens a new UDP socket on Pymesh
 int mesh_socket_open(mod_network_socket_obj_t *s, int *_errno) {
 
@@ -232,8 +274,11 @@ int mesh_socket_open(mod_network_socket_obj_t *s, int *_errno) {
 
     memset(&sock->udp_sock, 0, sizeof(otUdpSocket));
 
-    otEXPECT_ACTION(NULL != (sock->rx_queue = xQueueCreate(OT_DATA_QUEUE_SIZE_MAX, sizeof(ot_rx_data_t))),
+    otEXPECT_ACTION(NULL != (sock->rx_queue = xQueueCreate(OT_DATA_QUEUE_SIZE_DEFAULT, sizeof(ot_rx_data_t))),
             *_errno = MP_ENOBUFS);
+    sock->rx_depth = OT_DATA_QUEUE_SIZE_DEFAULT;
+    sock->rx_received = 0;
+    sock->rx_dropped = 0;
 
     // open socket
     otEXPECT_ACTION(
@@ -245,8 +290,10 @@ int mesh_socket_open(mod_network_socket_obj_t *s, int *_errno) {
 
     exit: if (*_errno != 0) {
         printf("err: %d", *_errno);
-        vQueueDelete(sock->rx_queue);
-        sock->s = NULL;
+        if (sock && sock->rx_queue) {
+            vQueueDelete(sock->rx_queue);
+            sock->rx_queue = NULL;
+        }
         return -1;
     }
 
@@ -260,15 +307,19 @@ void mesh_socket_close(mod_network_socket_obj_t *s) {
         // destroy a specific socket
         pymesh_socket_t *sock = find_socket(s);
         otUdpClose(&sock->udp_sock);
+        xSemaphoreTake(xSocketsMutex, portMAX_DELAY);
         vQueueDelete(sock->rx_queue);
         memset(sock, 0, sizeof(pymesh_socket_t));
+        xSemaphoreGive(xSocketsMutex);
     } else {
         // destroy all sockets
         for (int i = 0 ; i < UDP_SOCKETS_MAX; i++) {
             if (sockets[i].s) {
                 otUdpClose(&sockets[i].udp_sock);
+                xSemaphoreTake(xSocketsMutex, portMAX_DELAY);
                 vQueueDelete(sockets[i].rx_queue);
                 memset(&sockets[i], 0, sizeof(pymesh_socket_t));
+                xSemaphoreGive(xSocketsMutex);
             }
         }
     }
@@ -362,7 +413,11 @@ int mesh_socket_recvfrom(mod_network_socket_obj_t *s, byte *buf, mp_uint_t len,
 
     otEXPECT_ACTION(NULL != (sock = find_socket(s)), *_errno = MP_ENOENT);
 
-    if (xQueueReceive(sock->rx_queue, &rx_data, 0)) {
+    xSemaphoreTake(xSocketsMutex, portMAX_DELAY);
+    bool received = xQueueReceive(sock->rx_queue, &rx_data, 0);
+    xSemaphoreGive(xSocketsMutex);
+
+    if (received) {
         // adjust the len
         if (rx_data.len < len) {
             len = rx_data.len;
@@ -381,6 +436,54 @@ int mesh_socket_recvfrom(mod_network_socket_obj_t *s, byte *buf, mp_uint_t len,
     return 0;
 }
 
+// SO_RCVBUF sets the size of the socket RX queue, in bytes, rounded up to whole packages
+int mesh_socket_setsockopt(mod_network_socket_obj_t *s, mp_uint_t level, mp_uint_t opt, const void *optval,
+        mp_uint_t optlen, int *_errno) {
+
+    ot_rx_data_t rx_data;
+    QueueHandle_t rx_queue;
+    mp_int_t size;
+    uint32_t depth;
+
+    *_errno = 0;
+
+    pymesh_socket_t *sock;
+
+    otEXPECT_ACTION(NULL != (sock = find_socket(s)), *_errno = MP_ENOENT);
+
+    otEXPECT_ACTION(level == SOL_SOCKET && opt == SO_RCVBUF, *_errno = MP_EOPNOTSUPP);
+    otEXPECT_ACTION(optlen == sizeof(mp_int_t), *_errno = MP_EINVAL);
+
+    size = *(mp_int_t *)optval;
+    otEXPECT_ACTION(size > 0, *_errno = MP_EINVAL);
+
+    depth = (size + OT_RX_PACK_SIZE_MAX - 1) / OT_RX_PACK_SIZE_MAX;
+    if (depth > OT_DATA_QUEUE_SIZE_MAX) {
+        depth = OT_DATA_QUEUE_SIZE_MAX;
+    }
+
+    otEXPECT_ACTION(NULL != (rx_queue = xQueueCreate(depth, sizeof(ot_rx_data_t))), *_errno = MP_ENOBUFS);
+
+    // move the packages already received, keeping the newest ones if they don't fit
+    xSemaphoreTake(xSocketsMutex, portMAX_DELAY);
+    while (uxQueueMessagesWaiting(sock->rx_queue) > depth) {
+        xQueueReceive(sock->rx_queue, &rx_data, 0);
+        sock->rx_dropped++;
+    }
+    while (xQueueReceive(sock->rx_queue, &rx_data, 0)) {
+        xQueueSend(rx_queue, &rx_data, 0);
+    }
+    vQueueDelete(sock->rx_queue);
+    sock->rx_queue = rx_queue;
+    sock->rx_depth = depth;
+    xSemaphoreGive(xSocketsMutex);
+
+    exit: if (*_errno != 0) {
+        return -1;
+    }
+    return 0;
+}
+
 /******************************************************************************
  DEFINE PRIVATE FUNCTIONS
  ******************************************************************************/
@@ -390,11 +493,12 @@ int mesh_socket_recvfrom(mod_network_socket_obj_t *s, byte *buf, mp_uint_t len,
 static void TASK_Mesh(void *pvParameters) {
     
     for (;;) {
-        vTaskDelay(1 / portTICK_PERIOD_MS);
-
-        // openThread process tasklets
+        // sleep until a LoRa frame arrives, an alarm fires, a tasklet is posted or there's CLI input;
+        // every notification runs one iteration, so a burst of frames is processed back to back
+        if (!mesh_obj.ot_ready || !otTaskletsArePending(ot)) {
+            ulTaskNotifyTake(pdFALSE, MESH_TASK_WAIT_MAX_MS / portTICK_PERIOD_MS);
+        }
 
-        // CLI
         if (mesh_obj.ot_ready) {
 
             // Radio 802.15.4 TX/RX state-machine
@@ -420,7 +524,9 @@ static void TASK_Mesh(void *pvParameters) {
  */
 static void modmesh_init(void) {
 
-    //xRxQueue = xQueueCreate(OT_DATA_QUEUE_SIZE_MAX, sizeof(ot_rx_data_t));
+    if (!xSocketsMutex) {
+        xSocketsMutex = xSemaphoreCreateMutex();
+    }
 
     ot_obj.handler = mp_const_none;
     ot_obj.handler_arg = mp_const_none;
@@ -455,6 +561,34 @@ static pymesh_socket_t *find_socket(mod_network_socket_obj_t *nic_sock) {
     return NULL;
 }
 
+/*
+ * stores a received package in the socket queue, dropping the oldest one if the queue is full
+ */
+static void mesh_socket_rx_push(pymesh_socket_t *sock, const ot_rx_data_t *rx_data) {
+    ot_rx_data_t rx_data_drop;
+
+    xSemaphoreTake(xSocketsMutex, portMAX_DELAY);
+    if (sock->rx_queue) {
+        if (!xQueueSend(sock->rx_queue, (void *) rx_data, 0)) {
+            xQueueReceive(sock->rx_queue, &rx_data_drop, 0);
+            sock->rx_dropped++;
+
+            // try to store it again
+            xQueueSend(sock->rx_queue, (void *) rx_data, 0);
+        }
+        sock->rx_received++;
+    }
+    xSemaphoreGive(xSocketsMutex);
+
+    pollwait_notify();
+
+    // callback to mpy if registered, a callback still pending covers this package too,
+    // so it should drain the socket using Mesh.recv_many()
+    if (ot_obj.handler != mp_const_none) {
+        mp_irq_queue_interrupt_non_ISR(rx_interrupt_queue_handler, (void *)&ot_obj);
+    }
+}
+
 /*
  * this function will be called by the micropython interrupt thread
  */
@@ -818,21 +952,7 @@ static void socket_udp_cb(void *aContext, otMessage *aMessage,
 //    otPlatLog(0, 0,"reg in queue, call handler");
 
     // store packet received in queue, to be consumed by socket.recvfrom()
-    if (!xQueueSend(sock->rx_queue, (void *) &rx_data, 0)) {
-        // queue is full, so we should drop the oldest item, to add the new one
-        ot_rx_data_t rx_data_drop;
-        xQueueReceive(sock->rx_queue, &rx_data_drop, 0);
-
-        // try to store it again
-        xQueueSend(sock->rx_queue, (void *) &rx_data, 0);
-    }
-
-
-    // callback to mpy if registered
-    if (ot_obj.handler != mp_const_none) {
-        //printf("Calling cb\n");
-        mp_irq_queue_interrupt(rx_interrupt_queue_handler, (void *)&ot_obj);
-    }
+    mesh_socket_rx_push(sock, &rx_data);
 
 #if 0
     // code for sending back ACK pack to the same IP+port that this package was received
@@ -966,24 +1086,10 @@ void br_ip6_rcv_cb(otMessage *aMessage, void *aContext){
     //otPlatLog(0, 0,"reg in queue, call handler %d", rx_data.src_port);
 
     // store packet received in queue, to be consumed by socket.recvfrom()
-
-    if (!xQueueSend(sock->rx_queue, (void *) &rx_data, 0)) {
-        // queue is full, so we should drop the oldest item, to add the new one
-        ot_rx_data_t rx_data_drop;
-        xQueueReceive(sock->rx_queue, &rx_data_drop, 0);
-
-        // try to store it again
-        xQueueSend(sock->rx_queue, (void *) &rx_data, 0);
-    }
+    mesh_socket_rx_push(sock, &rx_data);
 
     // free message
     otMessageFree(aMessage);
-
-    // callback to mpy if registered
-    if (ot_obj.handler != mp_const_none) {
-        //printf("Calling cb\n");
-        mp_irq_queue_interrupt(rx_interrupt_queue_handler, (void *)&ot_obj);
-    }
 }
 
 /******************************************************************************
@@ -1054,6 +1160,7 @@ STATIC mp_obj_t mesh_make_new(const mp_obj_type_t *type, mp_uint_t n_args, mp_ui
         }
 
         modmesh_init();
+        lora_ot_init();
         //printf("mesh task started\n");
         
         // setup the object
@@ -1082,6 +1189,7 @@ STATIC mp_obj_t mesh_deinit_cmd (mp_obj_t self_in) {
     
     openthread_deinit();
     vTaskDelete(xMeshTaskHndl);
+    xMeshTaskHndl = NULL;
 
     return mp_obj_new_bool(true);
 }
@@ -1123,6 +1231,7 @@ STATIC mp_obj_t mesh_cli(mp_obj_t self_in, mp_obj_t data) {
 
     mesh_obj.otCliBufferLen = len;
     mesh_obj.meshCliOutputDone = false;
+    mesh_task_notify();
     while (!mesh_obj.meshCliOutputDone && timeout >= 0) {
         mp_hal_delay_ms(300);
         timeout -= 300;
@@ -1320,6 +1429,73 @@ STATIC mp_obj_t mesh_rx_cb (mp_obj_t self_in, mp_obj_t cb_obj, mp_obj_t cb_arg_o
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_3(mesh_rx_cb_obj, mesh_rx_cb);
 
+/*
+ * returns a list with (data, (ip, port)) of all the packages queued on a socket, without blocking
+ */
+STATIC mp_obj_t mesh_recv_many (mp_uint_t n_args, const mp_obj_t *args) {
+    ot_rx_data_t rx_data;
+    char ip_str[MOD_USOCKET_IPV6_CHARS_MAX];
+    mp_int_t max = (n_args > 2) ? mp_obj_get_int(args[2]) : OT_DATA_QUEUE_SIZE_MAX;
+    mp_obj_t list = mp_obj_new_list(0, NULL);
+    pymesh_socket_t *sock;
+
+    if (!MP_OBJ_IS_TYPE(args[1], &socket_type) || NULL == (sock = find_socket(args[1]))) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "not a Pymesh socket"));
+    }
+
+    for ( ; max > 0; max--) {
+        xSemaphoreTake(xSocketsMutex, portMAX_DELAY);
+        bool received = xQueueReceive(sock->rx_queue, &rx_data, 0);
+        xSemaphoreGive(xSocketsMutex);
+        if (!received) {
+            break;
+        }
+
+        otIp6ToString(rx_data.src_ip, ip_str, MOD_USOCKET_IPV6_CHARS_MAX);
+        mp_obj_t addr[2];
+        addr[0] = mp_obj_new_str(ip_str, strlen(ip_str));
+        addr[1] = mp_obj_new_int(rx_data.src_port);
+
+        mp_obj_t tuple[2];
+        tuple[0] = mp_obj_new_bytes(rx_data.data, rx_data.len);
+        tuple[1] = mp_obj_new_tuple(2, addr);
+        mp_obj_list_append(list, mp_obj_new_tuple(2, tuple));
+    }
+    return list;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mesh_recv_many_obj, 2, 3, mesh_recv_many);
+
+/*
+ * returns a list with the RX queue statistics (port, queued, depth, received, dropped) of each socket
+ */
+STATIC mp_obj_t mesh_rx_stats (mp_obj_t self_in) {
+    static const qstr mesh_rx_stats_fields[MESH_RX_STATS_FIELDS_NUM] = {
+            MP_QSTR_port, MP_QSTR_queued, MP_QSTR_depth, MP_QSTR_received, MP_QSTR_dropped
+    };
+
+    mp_obj_t stats_list[UDP_SOCKETS_MAX];
+    mp_obj_t stats_tuple[MESH_RX_STATS_FIELDS_NUM];
+    int sock_num = 0;
+
+    for (int i = 0; i < UDP_SOCKETS_MAX; i++) {
+        if (sockets[i].s) {
+            xSemaphoreTake(xSocketsMutex, portMAX_DELAY);
+            stats_tuple[0] = mp_obj_new_int(sockets[i].port);
+            stats_tuple[1] = mp_obj_new_int(uxQueueMessagesWaiting(sockets[i].rx_queue));
+            stats_tuple[2] = mp_obj_new_int(sockets[i].rx_depth);
+            stats_tuple[3] = mp_obj_new_int_from_uint(sockets[i].rx_received);
+            stats_tuple[4] = mp_obj_new_int_from_uint(sockets[i].rx_dropped);
+            xSemaphoreGive(xSocketsMutex);
+
+            stats_list[sock_num++] = mp_obj_new_attrtuple(mesh_rx_stats_fields,
+                    sizeof(stats_tuple) / sizeof(stats_tuple[0]),
+                    stats_tuple);
+        }
+    }
+    return mp_obj_new_list(sock_num, stats_list);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mesh_rx_stats_obj, mesh_rx_stats);
+
 
 /*
  * list the Border Router entries, if no param OR
@@ -1385,6 +1561,8 @@ STATIC const mp_map_elem_t mesh_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_routers),                 (mp_obj_t)&mesh_routers_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_leader),                  (mp_obj_t)&mesh_leader_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_rx_cb),                   (mp_obj_t)&mesh_rx_cb_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_recv_many),               (mp_obj_t)&mesh_recv_many_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_rx_stats),                (mp_obj_t)&mesh_rx_stats_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_border_router),           (mp_obj_t)&mesh_border_router_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_border_router_del),       (mp_obj_t)&mesh_border_router_del_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_deinit),                  (mp_obj_t)&mesh_deinit_obj },
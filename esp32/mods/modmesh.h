@@ -41,6 +41,10 @@ extern const mp_obj_type_t lora_mesh_type;
 
 extern bool lora_mesh_ready(void);
 
+extern void mesh_task_notify(void);
+
+extern void mesh_task_notify_from_isr(void);
+
 /******************************************************************************
  * socket functions used in modlora.c
  */
@@ -56,6 +60,9 @@ extern int mesh_socket_bind(mod_network_socket_obj_t *s, byte *ip, mp_uint_t por
 
 extern int mesh_socket_sendto(mod_network_socket_obj_t *s, const byte *buf, mp_uint_t len, byte *ip,
         mp_uint_t port, int *_errno);
+
+extern int mesh_socket_setsockopt(mod_network_socket_obj_t *s, mp_uint_t level, mp_uint_t opt,
+        const void *optval, mp_uint_t optlen, int *_errno);
 /******************************************************************************/
 
 #endif /* LORA_MESH_TASK_H_ */
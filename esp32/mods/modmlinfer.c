@@ -0,0 +1,469 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/binary.h"
+#include "py/nlr.h"
+
+#include "mpexception.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define MLINFER_MAGIC                   "MLM1"
+#define MLINFER_MAGIC_SIZE              (4)
+#define MLINFER_LAYERS_MAX              (16)
+
+#define MLINFER_LAYER_DENSE             (1)
+#define MLINFER_LAYER_CONV1D            (2)
+
+#define MLINFER_ACT_NONE                (0)
+#define MLINFER_ACT_RELU                (1)
+#define MLINFER_ACT_SIGMOID             (2)
+#define MLINFER_ACT_SOFTMAX             (3)
+
+#define MLINFER_WEIGHTS_FLOAT           (0)
+#define MLINFER_WEIGHTS_INT8            (1)
+
+#define MLINFER_FFT_SIZE_MAX            (4096)
+#define MLINFER_PEAKS_MAX               (16)
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+// the model is a header followed by the layers, each a layer header, the weights
+// padded to 4 bytes and the float32 biases, all little endian:
+//  dense:  weights[out][in]
+//  conv1d: weights[out][kernel][in], over channel-last input, stride 1, no padding
+typedef struct {
+    char magic[MLINFER_MAGIC_SIZE];
+    uint16_t n_layers;
+    uint16_t n_inputs;
+} mlinfer_model_header_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t activation;
+    uint8_t weights;
+    uint8_t kernel;
+    uint16_t in;
+    uint16_t out;
+    float scale;            // of the int8 weights
+} mlinfer_layer_header_t;
+
+typedef struct {
+    const mlinfer_layer_header_t *hdr;
+    const void *weights;
+    const float *bias;
+    uint16_t in_len;        // conv1d input length, in samples
+} mlinfer_layer_t;
+
+typedef struct _mlinfer_model_obj_t {
+    mp_obj_base_t base;
+    mp_obj_t buf;           // the model is used in place, this keeps it alive
+    float *scratch[2];
+    uint16_t n_layers;
+    uint16_t n_inputs;
+    uint16_t n_outputs;
+    mlinfer_layer_t layers[MLINFER_LAYERS_MAX];
+} mlinfer_model_obj_t;
+
+/******************************************************************************
+ DECLARE PRIVATE FUNCTIONS
+ ******************************************************************************/
+STATIC const mp_obj_type_t mlinfer_model_type;
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+STATIC NORETURN void mlinfer_invalid_model(void) {
+    nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "invalid model"));
+}
+
+STATIC float *mlinfer_get_floats(mp_obj_t obj, size_t *len, int flags) {
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(obj, &bufinfo, flags);
+    if (bufinfo.typecode != 'f') {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_TypeError, "expecting an array of floats"));
+    }
+    *len = bufinfo.len / sizeof(float);
+    return bufinfo.buf;
+}
+
+STATIC void mlinfer_activate(float *x, size_t n, uint8_t activation) {
+    switch (activation) {
+    case MLINFER_ACT_RELU:
+        for (size_t i = 0; i < n; i++) {
+            if (x[i] < 0.0f) {
+                x[i] = 0.0f;
+            }
+        }
+        break;
+    case MLINFER_ACT_SIGMOID:
+        for (size_t i = 0; i < n; i++) {
+            x[i] = 1.0f / (1.0f + expf(-x[i]));
+        }
+        break;
+    case MLINFER_ACT_SOFTMAX: {
+        float max = x[0];
+        for (size_t i = 1; i < n; i++) {
+            if (x[i] > max) {
+                max = x[i];
+            }
+        }
+        float sum = 0.0f;
+        for (size_t i = 0; i < n; i++) {
+            x[i] = expf(x[i] - max);
+            sum += x[i];
+        }
+        for (size_t i = 0; i < n; i++) {
+            x[i] /= sum;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// the dot product of n inputs with a row of weights, the int8 ones being scaled at the end
+STATIC float mlinfer_dot(const mlinfer_layer_header_t *hdr, const void *weights, size_t offset, const float *x, size_t n) {
+    float acc = 0.0f;
+    if (hdr->weights == MLINFER_WEIGHTS_INT8) {
+        const int8_t *w = (const int8_t *)weights + offset;
+        for (size_t i = 0; i < n; i++) {
+            acc += w[i] * x[i];
+        }
+        return acc * hdr->scale;
+    }
+    const float *w = (const float *)weights + offset;
+    for (size_t i = 0; i < n; i++) {
+        acc += w[i] * x[i];
+    }
+    return acc;
+}
+
+// returns the number of outputs written to y
+STATIC size_t mlinfer_run_layer(const mlinfer_layer_t *layer, const float *x, float *y) {
+    const mlinfer_layer_header_t *hdr = layer->hdr;
+    size_t n;
+    if (hdr->type == MLINFER_LAYER_DENSE) {
+        for (size_t o = 0; o < hdr->out; o++) {
+            y[o] = mlinfer_dot(hdr, layer->weights, o * hdr->in, x, hdr->in) + layer->bias[o];
+        }
+        n = hdr->out;
+    } else {
+        // the kernel rows of a filter are contiguous, and so are the input samples they see
+        size_t out_len = layer->in_len - hdr->kernel + 1;
+        size_t row = hdr->kernel * hdr->in;
+        for (size_t t = 0; t < out_len; t++) {
+            for (size_t o = 0; o < hdr->out; o++) {
+                y[t * hdr->out + o] = mlinfer_dot(hdr, layer->weights, o * row, &x[t * hdr->in], row) + layer->bias[o];
+            }
+        }
+        n = out_len * hdr->out;
+    }
+    mlinfer_activate(y, n, hdr->activation);
+    return n;
+}
+
+STATIC void mlinfer_parse_model(mlinfer_model_obj_t *self, const byte *buf, size_t len) {
+    const mlinfer_model_header_t *mhdr = (const mlinfer_model_header_t *)buf;
+    if (len < sizeof(*mhdr) || memcmp(mhdr->magic, MLINFER_MAGIC, MLINFER_MAGIC_SIZE) ||
+        mhdr->n_layers == 0 || mhdr->n_layers > MLINFER_LAYERS_MAX || mhdr->n_inputs == 0) {
+        mlinfer_invalid_model();
+    }
+    self->n_layers = mhdr->n_layers;
+    self->n_inputs = mhdr->n_inputs;
+
+    size_t offset = sizeof(*mhdr);
+    size_t cur = mhdr->n_inputs;
+    size_t scratch = cur;
+    for (size_t i = 0; i < self->n_layers; i++) {
+        mlinfer_layer_t *layer = &self->layers[i];
+        if (len - offset < sizeof(mlinfer_layer_header_t)) {
+            mlinfer_invalid_model();
+        }
+        const mlinfer_layer_header_t *hdr = (const mlinfer_layer_header_t *)(buf + offset);
+        offset += sizeof(*hdr);
+        if (hdr->in == 0 || hdr->out == 0 || hdr->activation > MLINFER_ACT_SOFTMAX || hdr->weights > MLINFER_WEIGHTS_INT8) {
+            mlinfer_invalid_model();
+        }
+
+        size_t n_weights;
+        if (hdr->type == MLINFER_LAYER_DENSE) {
+            if (cur != hdr->in) {
+                mlinfer_invalid_model();
+            }
+            n_weights = (size_t)hdr->out * hdr->in;
+            cur = hdr->out;
+        } else if (hdr->type == MLINFER_LAYER_CONV1D) {
+            if (hdr->kernel == 0 || cur % hdr->in || cur / hdr->in < hdr->kernel) {
+                mlinfer_invalid_model();
+            }
+            layer->in_len = cur / hdr->in;
+            n_weights = (size_t)hdr->out * hdr->kernel * hdr->in;
+            cur = (layer->in_len - hdr->kernel + 1) * hdr->out;
+        } else {
+            mlinfer_invalid_model();
+        }
+
+        size_t w_size = n_weights * (hdr->weights == MLINFER_WEIGHTS_INT8 ? 1 : sizeof(float));
+        size_t b_size = hdr->out * sizeof(float);
+        w_size = (w_size + 3) & ~3;
+        if (len - offset < w_size + b_size) {
+            mlinfer_invalid_model();
+        }
+        layer->hdr = hdr;
+        layer->weights = buf + offset;
+        layer->bias = (const float *)(buf + offset + w_size);
+        offset += w_size + b_size;
+        if (cur > scratch) {
+            scratch = cur;
+        }
+    }
+    self->n_outputs = cur;
+    self->scratch[0] = m_new(float, scratch);
+    self->scratch[1] = m_new(float, scratch);
+}
+
+// in place, n being a power of 2
+STATIC void mlinfer_fft(float *re, float *im, size_t n) {
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (size_t len = 2; len <= n; len <<= 1) {
+        float ang = -2.0f * (float)M_PI / len;
+        float wr = cosf(ang), wi = sinf(ang);
+        for (size_t i = 0; i < n; i += len) {
+            float cr = 1.0f, ci = 0.0f;
+            for (size_t k = 0; k < len / 2; k++) {
+                size_t a = i + k, b = a + len / 2;
+                float tr = re[b] * cr - im[b] * ci;
+                float ti = re[b] * ci + im[b] * cr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+                float ncr = cr * wr - ci * wi;
+                ci = cr * wi + ci * wr;
+                cr = ncr;
+            }
+        }
+    }
+}
+
+/******************************************************************************/
+// Micro Python bindings; Model class
+
+/// \class Model(buf)
+/// a model in the flat MLM1 format; the buffer is used in place, so a model
+/// frozen into the firmware or kept in a bytes object isn't copied
+STATIC mp_obj_t mlinfer_model_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args) {
+    mp_arg_check_num(n_args, n_kw, 1, 1, false);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(all_args[0], &bufinfo, MP_BUFFER_READ);
+
+    mlinfer_model_obj_t *self = m_new_obj(mlinfer_model_obj_t);
+    self->base.type = &mlinfer_model_type;
+    self->buf = all_args[0];
+    const byte *buf = bufinfo.buf;
+    // the float32 fields are read directly, which needs them aligned
+    if ((uintptr_t)buf & 3) {
+        byte *copy = m_new(byte, bufinfo.len);
+        memcpy(copy, buf, bufinfo.len);
+        self->buf = mp_obj_new_bytearray_by_ref(bufinfo.len, copy);
+        buf = copy;
+    }
+    mlinfer_parse_model(self, buf, bufinfo.len);
+    return self;
+}
+
+/// \method predict(x, [out])
+/// runs the model over the array of floats x; the results go to the array out
+/// when it is given, which is then returned, or to a new list
+STATIC mp_obj_t mlinfer_model_predict(size_t n_args, const mp_obj_t *args) {
+    mlinfer_model_obj_t *self = args[0];
+    size_t n;
+    const float *x = mlinfer_get_floats(args[1], &n, MP_BUFFER_READ);
+    if (n != self->n_inputs) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+    float *out = NULL;
+    if (n_args > 2) {
+        out = mlinfer_get_floats(args[2], &n, MP_BUFFER_WRITE);
+        if (n < self->n_outputs) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+        }
+    }
+
+    const float *in = x;
+    for (size_t i = 0; i < self->n_layers; i++) {
+        float *y = self->scratch[i & 1];
+        mlinfer_run_layer(&self->layers[i], in, y);
+        in = y;
+    }
+
+    if (out != NULL) {
+        memcpy(out, in, self->n_outputs * sizeof(float));
+        return args[2];
+    }
+    mp_obj_t list = mp_obj_new_list(self->n_outputs, NULL);
+    mp_obj_t *items = ((mp_obj_list_t *)MP_OBJ_TO_PTR(list))->items;
+    for (size_t i = 0; i < self->n_outputs; i++) {
+        items[i] = mp_obj_new_float(in[i]);
+    }
+    return list;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mlinfer_model_predict_obj, 2, 3, mlinfer_model_predict);
+
+/// \method shape()
+/// returns (inputs, outputs)
+STATIC mp_obj_t mlinfer_model_shape(mp_obj_t self_in) {
+    mlinfer_model_obj_t *self = self_in;
+    mp_obj_t tuple[2] = { MP_OBJ_NEW_SMALL_INT(self->n_inputs), MP_OBJ_NEW_SMALL_INT(self->n_outputs) };
+    return mp_obj_new_tuple(2, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mlinfer_model_shape_obj, mlinfer_model_shape);
+
+STATIC const mp_map_elem_t mlinfer_model_locals_dict_table[] = {
+    { MP_OBJ_NEW_QSTR(MP_QSTR_predict),             (mp_obj_t)&mlinfer_model_predict_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_shape),               (mp_obj_t)&mlinfer_model_shape_obj },
+};
+STATIC MP_DEFINE_CONST_DICT(mlinfer_model_locals_dict, mlinfer_model_locals_dict_table);
+
+STATIC const mp_obj_type_t mlinfer_model_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_Model,
+    .make_new = mlinfer_model_make_new,
+    .locals_dict = (mp_obj_t)&mlinfer_model_locals_dict,
+};
+
+/******************************************************************************/
+// Micro Python bindings; module functions
+
+/// \function features(samples, rate, *, peaks=3, spectrum=None)
+/// returns (rms, [(freq, magnitude), ...]) of an array of float samples taken
+/// at rate Hz, the mean removed; the peaks are the largest local maxima of the
+/// spectrum of the first power of 2 samples, whose magnitudes also go to the
+/// float array spectrum when one is given
+STATIC mp_obj_t mlinfer_features(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_samples, ARG_rate, ARG_peaks, ARG_spectrum };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_samples,  MP_ARG_REQUIRED | MP_ARG_OBJ,  },
+        { MP_QSTR_rate,     MP_ARG_REQUIRED | MP_ARG_OBJ,  },
+        { MP_QSTR_peaks,    MP_ARG_KW_ONLY  | MP_ARG_INT,  {.u_int = 3} },
+        { MP_QSTR_spectrum, MP_ARG_KW_ONLY  | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    size_t len;
+    const float *samples = mlinfer_get_floats(args[ARG_samples].u_obj, &len, MP_BUFFER_READ);
+    float rate = mp_obj_get_float(args[ARG_rate].u_obj);
+    mp_int_t npeaks = args[ARG_peaks].u_int;
+    if (len < 2 || rate <= 0.0f || npeaks < 0 || npeaks > MLINFER_PEAKS_MAX) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+
+    float mean = 0.0f;
+    for (size_t i = 0; i < len; i++) {
+        mean += samples[i];
+    }
+    mean /= len;
+    float sq = 0.0f;
+    for (size_t i = 0; i < len; i++) {
+        float d = samples[i] - mean;
+        sq += d * d;
+    }
+    float rms = sqrtf(sq / len);
+
+    size_t n = 1;
+    while (n * 2 <= len && n * 2 <= MLINFER_FFT_SIZE_MAX) {
+        n *= 2;
+    }
+    float *re = m_new(float, n);
+    float *im = m_new(float, n);
+    for (size_t i = 0; i < n; i++) {
+        re[i] = samples[i] - mean;
+        im[i] = 0.0f;
+    }
+    mlinfer_fft(re, im, n);
+    // the magnitudes of the first half replace the real parts
+    size_t bins = n / 2;
+    for (size_t i = 0; i < bins; i++) {
+        re[i] = sqrtf(re[i] * re[i] + im[i] * im[i]) * 2.0f / n;
+    }
+
+    if (args[ARG_spectrum].u_obj != mp_const_none) {
+        size_t slen;
+        float *spectrum = mlinfer_get_floats(args[ARG_spectrum].u_obj, &slen, MP_BUFFER_WRITE);
+        memcpy(spectrum, re, MIN(slen, bins) * sizeof(float));
+    }
+
+    // keep the largest local maxima, sorted by decreasing magnitude
+    size_t top[MLINFER_PEAKS_MAX];
+    size_t found = 0;
+    for (size_t i = 1; i + 1 < bins; i++) {
+        if (re[i] <= re[i - 1] || re[i] < re[i + 1]) {
+            continue;
+        }
+        size_t pos = found;
+        while (pos > 0 && re[top[pos - 1]] < re[i]) {
+            pos--;
+        }
+        if (pos >= (size_t)npeaks) {
+            continue;
+        }
+        size_t last = (found < (size_t)npeaks) ? found : npeaks - 1;
+        memmove(&top[pos + 1], &top[pos], (last - pos) * sizeof(size_t));
+        top[pos] = i;
+        if (found < (size_t)npeaks) {
+            found++;
+        }
+    }
+
+    mp_obj_t peaks = mp_obj_new_list(0, NULL);
+    for (size_t i = 0; i < found; i++) {
+        mp_obj_t peak[2] = { mp_obj_new_float(top[i] * rate / n), mp_obj_new_float(re[top[i]]) };
+        mp_obj_list_append(peaks, mp_obj_new_tuple(2, peak));
+    }
+    m_del(float, re, n);
+    m_del(float, im, n);
+
+    mp_obj_t ret[2] = { mp_obj_new_float(rms), peaks };
+    return mp_obj_new_tuple(2, ret);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mlinfer_features_obj, 2, mlinfer_features);
+
+STATIC const mp_map_elem_t mp_module_mlinfer_globals_table[] = {
+    { MP_OBJ_NEW_QSTR(MP_QSTR___name__),            MP_OBJ_NEW_QSTR(MP_QSTR_mlinfer) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_Model),               (mp_obj_t)&mlinfer_model_type },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_features),            (mp_obj_t)&mlinfer_features_obj },
+};
+STATIC MP_DEFINE_CONST_DICT(mp_module_mlinfer_globals, mp_module_mlinfer_globals_table);
+
+const mp_obj_module_t mp_module_mlinfer = {
+    .base = { &mp_type_module },
+    .globals = (mp_obj_dict_t*)&mp_module_mlinfer_globals,
+};
@@ -0,0 +1,741 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <string.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/objstr.h"
+#include "py/runtime.h"
+#include "py/stream.h"
+#include "py/mperrno.h"
+#include "py/mphal.h"
+
+#include "esp_system.h"
+
+#include "mpexception.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define MQTT_CONNECT                    (0x10)
+#define MQTT_CONNACK                    (0x20)
+#define MQTT_PUBLISH                    (0x30)
+#define MQTT_PUBACK                     (0x40)
+#define MQTT_PUBREC                     (0x50)
+#define MQTT_PUBREL                     (0x60)
+#define MQTT_PUBCOMP                    (0x70)
+#define MQTT_SUBSCRIBE                  (0x80)
+#define MQTT_SUBACK                     (0x90)
+#define MQTT_UNSUBSCRIBE                (0xA0)
+#define MQTT_UNSUBACK                   (0xB0)
+#define MQTT_PINGREQ                    (0xC0)
+#define MQTT_PINGRESP                   (0xD0)
+#define MQTT_DISCONNECT                 (0xE0)
+
+#define MQTT_FLAG_DUP                   (0x08)
+#define MQTT_FLAG_RETAIN                (0x01)
+
+// packets waiting for an acknowledge from the broker
+#define MQTT_INFLIGHT_MAX               (8)
+#define MQTT_RX_CHUNK_SIZE              (256)
+#define MQTT_REMAINING_LEN_MAX          (268435455)
+
+#define MQTT_DEF_KEEPALIVE_S            (60)
+#define MQTT_DEF_RETRY_MS               (20000)
+#define MQTT_DEF_MAX_PACKET             (4096)
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+typedef enum {
+    MQTT_RX_HEADER = 0,
+    MQTT_RX_LENGTH,
+    MQTT_RX_BODY,
+} mqtt_rx_state_t;
+
+typedef struct {
+    byte *pkt;              // the PUBLISH packet, kept to resend it; NULL otherwise
+    size_t len;
+    uint32_t stamp;         // when it was last sent
+    uint16_t pid;           // 0 when the slot is free
+    uint8_t type;           // the packet type waiting for its ack
+} mqtt_inflight_t;
+
+typedef struct _mqtt_client_obj_t {
+    mp_obj_base_t base;
+    mp_obj_t client_id;
+    mp_obj_t user;
+    mp_obj_t password;
+    mp_obj_t callback;
+    mp_obj_t sock;
+    uint32_t keepalive_ms;
+    uint32_t retry_ms;
+    uint32_t last_tx;
+    uint32_t ping_at;
+    size_t max_packet;
+    uint16_t next_pid;
+    bool clean_session;
+    bool connected;
+    bool ping_outstanding;
+    // receive side: a chunk read from the socket, and the packet being assembled
+    uint8_t rx_state;
+    uint8_t rx_cmd;
+    uint8_t rx_shift;
+    size_t rx_len;
+    size_t rx_got;
+    byte *rx_pkt;
+    size_t rx_alloc;
+    uint16_t rx_pos;
+    uint16_t rx_end;
+    byte rx_chunk[MQTT_RX_CHUNK_SIZE];
+    mqtt_inflight_t inflight[MQTT_INFLIGHT_MAX];
+} mqtt_client_obj_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+STATIC const mp_obj_type_t mqtt_client_type;
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+STATIC NORETURN void mqtt_fail(mqtt_client_obj_t *self, int errcode) {
+    self->connected = false;
+    self->rx_state = MQTT_RX_HEADER;
+    self->rx_pos = self->rx_end = 0;
+    mp_raise_OSError(errcode);
+}
+
+STATIC void mqtt_send(mqtt_client_obj_t *self, const byte *buf, size_t len) {
+    if (self->sock == mp_const_none) {
+        mp_raise_OSError(MP_ENOTCONN);
+    }
+    int errcode;
+    mp_stream_write_exactly(self->sock, buf, len, &errcode);
+    if (errcode != 0) {
+        mqtt_fail(self, errcode);
+    }
+    self->last_tx = mp_hal_ticks_ms();
+}
+
+STATIC void mqtt_send_short(mqtt_client_obj_t *self, byte type, uint16_t pid) {
+    byte pkt[4] = { type, 2, pid >> 8, pid & 0xff };
+    mqtt_send(self, pkt, sizeof(pkt));
+}
+
+// the fixed header: the packet type and the varint encoded remaining length
+STATIC void mqtt_vstr_header(vstr_t *vstr, byte type, size_t remaining) {
+    if (remaining > MQTT_REMAINING_LEN_MAX) {
+        mp_raise_OSError(MP_EMSGSIZE);
+    }
+    vstr_add_byte(vstr, type);
+    do {
+        byte b = remaining & 0x7f;
+        remaining >>= 7;
+        vstr_add_byte(vstr, remaining ? (b | 0x80) : b);
+    } while (remaining);
+}
+
+STATIC void mqtt_vstr_u16(vstr_t *vstr, uint16_t val) {
+    vstr_add_byte(vstr, val >> 8);
+    vstr_add_byte(vstr, val & 0xff);
+}
+
+STATIC void mqtt_vstr_string(vstr_t *vstr, const char *str, size_t len) {
+    mqtt_vstr_u16(vstr, len);
+    vstr_add_strn(vstr, str, len);
+}
+
+STATIC const char *mqtt_get_data(mp_obj_t obj, size_t *len) {
+    if (obj == mp_const_none) {
+        *len = 0;
+        return NULL;
+    }
+    return mp_obj_str_get_data(obj, len);
+}
+
+STATIC mqtt_inflight_t *mqtt_inflight_find(mqtt_client_obj_t *self, uint16_t pid) {
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        if (self->inflight[i].pid == pid) {
+            return &self->inflight[i];
+        }
+    }
+    return NULL;
+}
+
+STATIC void mqtt_inflight_release(mqtt_inflight_t *entry) {
+    if (entry->pkt != NULL) {
+        m_del(byte, entry->pkt, entry->len);
+    }
+    entry->pkt = NULL;
+    entry->pid = 0;
+}
+
+// reserves a packet identifier and its inflight slot, before anything is sent
+STATIC mqtt_inflight_t *mqtt_inflight_new(mqtt_client_obj_t *self, byte type) {
+    mqtt_inflight_t *entry = mqtt_inflight_find(self, 0);
+    if (entry == NULL) {
+        mp_raise_OSError(MP_ENOBUFS);
+    }
+    do {
+        self->next_pid = (self->next_pid == UINT16_MAX) ? 1 : self->next_pid + 1;
+    } while (mqtt_inflight_find(self, self->next_pid) != NULL);
+    entry->pid = self->next_pid;
+    entry->type = type;
+    entry->pkt = NULL;
+    entry->len = 0;
+    entry->stamp = mp_hal_ticks_ms();
+    return entry;
+}
+
+STATIC void mqtt_resend_publish(mqtt_client_obj_t *self, mqtt_inflight_t *entry) {
+    entry->pkt[0] |= MQTT_FLAG_DUP;
+    mqtt_send(self, entry->pkt, entry->len);
+    entry->stamp = mp_hal_ticks_ms();
+}
+
+// fills the receive chunk; returns false when nothing is waiting and block is false.
+// A stream that can't be polled must be non-blocking for check() not to stall.
+STATIC bool mqtt_fill(mqtt_client_obj_t *self, bool block) {
+    const mp_stream_p_t *stream_p = mp_get_stream(self->sock);
+    int errcode;
+    if (!block && stream_p->ioctl != NULL) {
+        mp_uint_t ret = stream_p->ioctl(self->sock, MP_STREAM_POLL, MP_STREAM_POLL_RD, &errcode);
+        if (ret == MP_STREAM_ERROR) {
+            if (errcode != MP_EINVAL) {
+                mqtt_fail(self, errcode);
+            }
+        } else if (!(ret & MP_STREAM_POLL_RD)) {
+            return false;
+        }
+    }
+    mp_uint_t n = stream_p->read(self->sock, self->rx_chunk, MQTT_RX_CHUNK_SIZE, &errcode);
+    if (n == MP_STREAM_ERROR) {
+        if (!block && mp_is_nonblocking_error(errcode)) {
+            return false;
+        }
+        mqtt_fail(self, errcode);
+    }
+    if (n == 0) {
+        // the broker closed the connection
+        mqtt_fail(self, MP_ECONNRESET);
+    }
+    self->rx_pos = 0;
+    self->rx_end = n;
+    return true;
+}
+
+// assembles the next packet from the bytes in the receive chunk; returns false
+// when the chunk runs out first, the partial packet then waits for more bytes
+STATIC bool mqtt_parse_next(mqtt_client_obj_t *self) {
+    while (self->rx_pos < self->rx_end) {
+        if (self->rx_state == MQTT_RX_BODY) {
+            size_t n = MIN(self->rx_end - self->rx_pos, self->rx_len - self->rx_got);
+            memcpy(self->rx_pkt + self->rx_got, self->rx_chunk + self->rx_pos, n);
+            self->rx_pos += n;
+            self->rx_got += n;
+            if (self->rx_got == self->rx_len) {
+                self->rx_state = MQTT_RX_HEADER;
+                return true;
+            }
+            continue;
+        }
+        byte b = self->rx_chunk[self->rx_pos++];
+        if (self->rx_state == MQTT_RX_HEADER) {
+            self->rx_cmd = b;
+            self->rx_len = 0;
+            self->rx_shift = 0;
+            self->rx_state = MQTT_RX_LENGTH;
+            continue;
+        }
+        self->rx_len |= (size_t)(b & 0x7f) << self->rx_shift;
+        if (b & 0x80) {
+            self->rx_shift += 7;
+            if (self->rx_shift > 21) {
+                mqtt_fail(self, MP_EIO);
+            }
+            continue;
+        }
+        if (self->rx_len > self->max_packet) {
+            mqtt_fail(self, MP_EMSGSIZE);
+        }
+        if (self->rx_len > self->rx_alloc) {
+            self->rx_pkt = m_renew(byte, self->rx_pkt, self->rx_alloc, self->rx_len);
+            self->rx_alloc = self->rx_len;
+        }
+        self->rx_got = 0;
+        if (self->rx_len == 0) {
+            self->rx_state = MQTT_RX_HEADER;
+            return true;
+        }
+        self->rx_state = MQTT_RX_BODY;
+    }
+    return false;
+}
+
+STATIC uint16_t mqtt_pkt_u16(const byte *p) {
+    return (p[0] << 8) | p[1];
+}
+
+STATIC void mqtt_handle_publish(mqtt_client_obj_t *self, byte cmd, const byte *body, size_t len) {
+    uint8_t qos = (cmd >> 1) & 0x03;
+    if (len < 2) {
+        mqtt_fail(self, MP_EIO);
+    }
+    size_t topic_len = mqtt_pkt_u16(body);
+    size_t header_len = 2 + topic_len + (qos ? 2 : 0);
+    if (header_len > len || qos > 2) {
+        mqtt_fail(self, MP_EIO);
+    }
+    // copy out before acking, the receive buffer is reused by a re-entrant check()
+    mp_obj_t args[5] = {
+        mp_obj_new_bytes(body + 2, topic_len),
+        mp_obj_new_bytes(body + header_len, len - header_len),
+        MP_OBJ_NEW_SMALL_INT(qos),
+        mp_obj_new_bool(cmd & MQTT_FLAG_RETAIN),
+        mp_obj_new_bool(cmd & MQTT_FLAG_DUP),
+    };
+    if (qos == 1) {
+        mqtt_send_short(self, MQTT_PUBACK, mqtt_pkt_u16(body + 2 + topic_len));
+    } else if (qos == 2) {
+        mqtt_send_short(self, MQTT_PUBREC, mqtt_pkt_u16(body + 2 + topic_len));
+    }
+    if (self->callback != mp_const_none) {
+        mp_call_function_n_kw(self->callback, 5, 0, args);
+    }
+}
+
+STATIC void mqtt_handle_packet(mqtt_client_obj_t *self, byte cmd, const byte *body, size_t len) {
+    byte type = cmd & 0xf0;
+    if (type == MQTT_PUBLISH) {
+        mqtt_handle_publish(self, cmd, body, len);
+    } else if (type == MQTT_PINGRESP) {
+        self->ping_outstanding = false;
+    } else if (len >= 2 && (type == MQTT_PUBACK || type == MQTT_SUBACK || type == MQTT_UNSUBACK)) {
+        mqtt_inflight_t *entry = mqtt_inflight_find(self, mqtt_pkt_u16(body));
+        if (entry != NULL && entry->type == (type == MQTT_PUBACK ? MQTT_PUBLISH : type - 0x10)) {
+            mqtt_inflight_release(entry);
+        }
+    } else if (len >= 2 && type == MQTT_PUBREL) {
+        mqtt_send_short(self, MQTT_PUBCOMP, mqtt_pkt_u16(body));
+    }
+    // anything else, a late CONNACK included, carries nothing for us
+}
+
+STATIC void mqtt_housekeeping(mqtt_client_obj_t *self) {
+    uint32_t now = mp_hal_ticks_ms();
+    if (self->keepalive_ms > 0) {
+        if (self->ping_outstanding) {
+            if (now - self->ping_at > self->keepalive_ms) {
+                mqtt_fail(self, MP_ETIMEDOUT);
+            }
+        } else if (now - self->last_tx >= self->keepalive_ms / 2) {
+            byte pkt[2] = { MQTT_PINGREQ, 0 };
+            mqtt_send(self, pkt, sizeof(pkt));
+            self->ping_outstanding = true;
+            self->ping_at = now;
+        }
+    }
+    if (self->retry_ms > 0) {
+        for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+            mqtt_inflight_t *entry = &self->inflight[i];
+            if (entry->pkt != NULL && now - entry->stamp >= self->retry_ms) {
+                mqtt_resend_publish(self, entry);
+            }
+        }
+    }
+}
+
+/******************************************************************************/
+// Micro Python bindings; MQTT Client class
+
+STATIC mp_obj_t mqtt_client_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args) {
+    enum { ARG_client_id, ARG_user, ARG_password, ARG_keepalive, ARG_clean_session, ARG_callback, ARG_retry_ms, ARG_max_packet };
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_client_id,        MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_user,             MP_ARG_KW_ONLY  | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_password,         MP_ARG_KW_ONLY  | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_keepalive,        MP_ARG_KW_ONLY  | MP_ARG_INT, {.u_int = MQTT_DEF_KEEPALIVE_S} },
+        { MP_QSTR_clean_session,    MP_ARG_KW_ONLY  | MP_ARG_BOOL, {.u_bool = true} },
+        { MP_QSTR_callback,         MP_ARG_KW_ONLY  | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_retry_ms,         MP_ARG_KW_ONLY  | MP_ARG_INT, {.u_int = MQTT_DEF_RETRY_MS} },
+        { MP_QSTR_max_packet,       MP_ARG_KW_ONLY  | MP_ARG_INT, {.u_int = MQTT_DEF_MAX_PACKET} },
+    };
+
+    mp_map_t kw_args;
+    mp_map_init_fixed_table(&kw_args, n_kw, all_args + n_args);
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, all_args, &kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    size_t len;
+    mp_obj_str_get_data(args[ARG_client_id].u_obj, &len);
+    mqtt_get_data(args[ARG_user].u_obj, &len);
+    mqtt_get_data(args[ARG_password].u_obj, &len);
+    if (args[ARG_keepalive].u_int < 0 || args[ARG_keepalive].u_int > UINT16_MAX ||
+        args[ARG_retry_ms].u_int < 0 || args[ARG_max_packet].u_int <= 0) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+
+    mqtt_client_obj_t *self = m_new0(mqtt_client_obj_t, 1);
+    self->base.type = &mqtt_client_type;
+    self->client_id = args[ARG_client_id].u_obj;
+    self->user = args[ARG_user].u_obj;
+    self->password = args[ARG_password].u_obj;
+    self->callback = args[ARG_callback].u_obj;
+    self->sock = mp_const_none;
+    self->keepalive_ms = args[ARG_keepalive].u_int * 1000;
+    self->retry_ms = args[ARG_retry_ms].u_int;
+    self->max_packet = args[ARG_max_packet].u_int;
+    self->clean_session = args[ARG_clean_session].u_bool;
+    return self;
+}
+
+STATIC mp_obj_t mqtt_client_connect(mp_obj_t self_in, mp_obj_t sock) {
+    mqtt_client_obj_t *self = self_in;
+    mp_get_stream_raise(sock, MP_STREAM_OP_READ | MP_STREAM_OP_WRITE);
+
+    size_t id_len, user_len, password_len;
+    const char *id = mp_obj_str_get_data(self->client_id, &id_len);
+    const char *user = mqtt_get_data(self->user, &user_len);
+    const char *password = mqtt_get_data(self->password, &password_len);
+
+    byte flags = self->clean_session ? 0x02 : 0x00;
+    size_t remaining = 10 + 2 + id_len;
+    if (user != NULL) {
+        flags |= 0x80;
+        remaining += 2 + user_len;
+    }
+    if (password != NULL) {
+        flags |= 0x40;
+        remaining += 2 + password_len;
+    }
+
+    vstr_t vstr;
+    vstr_init(&vstr, remaining + 5);
+    mqtt_vstr_header(&vstr, MQTT_CONNECT, remaining);
+    // protocol name and level 4, MQTT 3.1.1
+    vstr_add_strn(&vstr, "\x00\x04MQTT\x04", 7);
+    vstr_add_byte(&vstr, flags);
+    mqtt_vstr_u16(&vstr, self->keepalive_ms / 1000);
+    mqtt_vstr_string(&vstr, id, id_len);
+    if (user != NULL) {
+        mqtt_vstr_string(&vstr, user, user_len);
+    }
+    if (password != NULL) {
+        mqtt_vstr_string(&vstr, password, password_len);
+    }
+
+    self->sock = sock;
+    self->connected = false;
+    self->ping_outstanding = false;
+    self->rx_state = MQTT_RX_HEADER;
+    self->rx_pos = self->rx_end = 0;
+    mqtt_send(self, (byte *)vstr.buf, vstr.len);
+    vstr_clear(&vstr);
+
+    // wait for the CONNACK, the socket timeout bounds each read
+    for (;;) {
+        while (!mqtt_parse_next(self)) {
+            mqtt_fill(self, true);
+        }
+        if ((self->rx_cmd & 0xf0) == MQTT_CONNACK && self->rx_len == 2) {
+            break;
+        }
+    }
+    if (self->rx_pkt[1] != 0) {
+        // a refusal: -1 bad protocol ... -5 not authorised
+        self->sock = mp_const_none;
+        nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(-self->rx_pkt[1])));
+    }
+    bool session_present = self->rx_pkt[0] & 0x01;
+    self->connected = true;
+
+    // publishes not acknowledged before are sent again; subscription requests
+    // are dropped, their callers have given up on them by now
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        mqtt_inflight_t *entry = &self->inflight[i];
+        if (entry->pkt != NULL) {
+            mqtt_resend_publish(self, entry);
+        } else if (entry->pid != 0) {
+            mqtt_inflight_release(entry);
+        }
+    }
+    return mp_obj_new_bool(session_present);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mqtt_client_connect_obj, mqtt_client_connect);
+
+STATIC mp_obj_t mqtt_client_disconnect(mp_obj_t self_in) {
+    mqtt_client_obj_t *self = self_in;
+    if (self->connected) {
+        byte pkt[2] = { MQTT_DISCONNECT, 0 };
+        nlr_buf_t nlr;
+        if (nlr_push(&nlr) == 0) {
+            mqtt_send(self, pkt, sizeof(pkt));
+            nlr_pop();
+        }
+    }
+    self->connected = false;
+    self->sock = mp_const_none;
+    if (self->rx_pkt != NULL) {
+        m_del(byte, self->rx_pkt, self->rx_alloc);
+        self->rx_pkt = NULL;
+        self->rx_alloc = 0;
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mqtt_client_disconnect_obj, mqtt_client_disconnect);
+
+STATIC mp_obj_t mqtt_client_isconnected(mp_obj_t self_in) {
+    mqtt_client_obj_t *self = self_in;
+    return mp_obj_new_bool(self->connected);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mqtt_client_isconnected_obj, mqtt_client_isconnected);
+
+STATIC mp_obj_t mqtt_client_publish(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_topic, ARG_msg, ARG_qos, ARG_retain };
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_topic,    MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_msg,      MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_qos,      MP_ARG_INT,  {.u_int = 0} },
+        { MP_QSTR_retain,   MP_ARG_BOOL, {.u_bool = false} },
+    };
+    mqtt_client_obj_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    size_t topic_len;
+    const char *topic = mp_obj_str_get_data(args[ARG_topic].u_obj, &topic_len);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[ARG_msg].u_obj, &bufinfo, MP_BUFFER_READ);
+    mp_int_t qos = args[ARG_qos].u_int;
+    if (qos < 0 || qos > 1) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    if (!self->connected) {
+        mp_raise_OSError(MP_ENOTCONN);
+    }
+
+    mqtt_inflight_t *entry = qos ? mqtt_inflight_new(self, MQTT_PUBLISH) : NULL;
+    size_t remaining = 2 + topic_len + (qos ? 2 : 0) + bufinfo.len;
+    vstr_t vstr;
+    vstr_init(&vstr, remaining + 5);
+    mqtt_vstr_header(&vstr, MQTT_PUBLISH | (qos << 1) | (args[ARG_retain].u_bool ? MQTT_FLAG_RETAIN : 0), remaining);
+    mqtt_vstr_string(&vstr, topic, topic_len);
+    if (entry != NULL) {
+        mqtt_vstr_u16(&vstr, entry->pid);
+    }
+    vstr_add_strn(&vstr, bufinfo.buf, bufinfo.len);
+
+    if (entry != NULL) {
+        // the slot owns the packet from here, for the retransmissions
+        entry->len = vstr.len;
+        entry->pkt = (byte *)vstr.buf;
+        mqtt_send(self, entry->pkt, entry->len);
+        return MP_OBJ_NEW_SMALL_INT(entry->pid);
+    }
+    mqtt_send(self, (byte *)vstr.buf, vstr.len);
+    vstr_clear(&vstr);
+    return MP_OBJ_NEW_SMALL_INT(0);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mqtt_client_publish_obj, 3, mqtt_client_publish);
+
+STATIC mp_obj_t mqtt_client_subscription(mqtt_client_obj_t *self, byte type, mp_obj_t topic_in, mp_int_t qos) {
+    size_t topic_len;
+    const char *topic = mp_obj_str_get_data(topic_in, &topic_len);
+    if (!self->connected) {
+        mp_raise_OSError(MP_ENOTCONN);
+    }
+    mqtt_inflight_t *entry = mqtt_inflight_new(self, type);
+    size_t remaining = 2 + 2 + topic_len + (type == MQTT_SUBSCRIBE ? 1 : 0);
+    vstr_t vstr;
+    vstr_init(&vstr, remaining + 5);
+    // the reserved flags of (UN)SUBSCRIBE are 0b0010
+    mqtt_vstr_header(&vstr, type | 0x02, remaining);
+    mqtt_vstr_u16(&vstr, entry->pid);
+    mqtt_vstr_string(&vstr, topic, topic_len);
+    if (type == MQTT_SUBSCRIBE) {
+        vstr_add_byte(&vstr, qos);
+    }
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        mqtt_send(self, (byte *)vstr.buf, vstr.len);
+        nlr_pop();
+    } else {
+        mqtt_inflight_release(entry);
+        vstr_clear(&vstr);
+        nlr_jump(nlr.ret_val);
+    }
+    vstr_clear(&vstr);
+    return MP_OBJ_NEW_SMALL_INT(entry->pid);
+}
+
+STATIC mp_obj_t mqtt_client_subscribe(size_t n_args, const mp_obj_t *args) {
+    mp_int_t qos = (n_args > 2) ? mp_obj_get_int(args[2]) : 0;
+    if (qos < 0 || qos > 2) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    return mqtt_client_subscription(args[0], MQTT_SUBSCRIBE, args[1], qos);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mqtt_client_subscribe_obj, 2, 3, mqtt_client_subscribe);
+
+STATIC mp_obj_t mqtt_client_unsubscribe(mp_obj_t self_in, mp_obj_t topic) {
+    return mqtt_client_subscription(self_in, MQTT_UNSUBSCRIBE, topic, 0);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mqtt_client_unsubscribe_obj, mqtt_client_unsubscribe);
+
+STATIC mp_obj_t mqtt_client_acked(mp_obj_t self_in, mp_obj_t pid_in) {
+    mqtt_client_obj_t *self = self_in;
+    mp_int_t pid = mp_obj_get_int(pid_in);
+    return mp_obj_new_bool(pid <= 0 || mqtt_inflight_find(self, pid) == NULL);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mqtt_client_acked_obj, mqtt_client_acked);
+
+STATIC mp_obj_t mqtt_client_inflight(mp_obj_t self_in) {
+    mqtt_client_obj_t *self = self_in;
+    mp_int_t count = 0;
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        count += (self->inflight[i].pid != 0);
+    }
+    return MP_OBJ_NEW_SMALL_INT(count);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mqtt_client_inflight_obj, mqtt_client_inflight);
+
+// processes whatever the broker sent, then keeps the connection alive and
+// resends the publishes still unacknowledged; returns the packets handled
+STATIC mp_obj_t mqtt_client_check(mp_obj_t self_in) {
+    mqtt_client_obj_t *self = self_in;
+    if (!self->connected) {
+        mp_raise_OSError(MP_ENOTCONN);
+    }
+    mp_int_t count = 0;
+    for (;;) {
+        while (mqtt_parse_next(self)) {
+            count++;
+            mqtt_handle_packet(self, self->rx_cmd, self->rx_pkt, self->rx_len);
+        }
+        if (!mqtt_fill(self, false)) {
+            break;
+        }
+    }
+    mqtt_housekeeping(self);
+    return MP_OBJ_NEW_SMALL_INT(count);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mqtt_client_check_obj, mqtt_client_check);
+
+STATIC mp_obj_t mqtt_client_set_callback(mp_obj_t self_in, mp_obj_t callback) {
+    mqtt_client_obj_t *self = self_in;
+    if (callback != mp_const_none && !mp_obj_is_callable(callback)) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    self->callback = callback;
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mqtt_client_set_callback_obj, mqtt_client_set_callback);
+
+STATIC const mp_map_elem_t mqtt_client_locals_dict_table[] = {
+    { MP_OBJ_NEW_QSTR(MP_QSTR_connect),             (mp_obj_t)&mqtt_client_connect_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_disconnect),          (mp_obj_t)&mqtt_client_disconnect_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_isconnected),         (mp_obj_t)&mqtt_client_isconnected_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_publish),             (mp_obj_t)&mqtt_client_publish_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_subscribe),           (mp_obj_t)&mqtt_client_subscribe_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_unsubscribe),         (mp_obj_t)&mqtt_client_unsubscribe_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_acked),               (mp_obj_t)&mqtt_client_acked_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_inflight),            (mp_obj_t)&mqtt_client_inflight_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_check),               (mp_obj_t)&mqtt_client_check_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_set_callback),        (mp_obj_t)&mqtt_client_set_callback_obj },
+};
+STATIC MP_DEFINE_CONST_DICT(mqtt_client_locals_dict, mqtt_client_locals_dict_table);
+
+STATIC const mp_obj_type_t mqtt_client_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_Client,
+    .make_new = mqtt_client_make_new,
+    .locals_dict = (mp_obj_t)&mqtt_client_locals_dict,
+};
+
+/******************************************************************************/
+// Micro Python bindings; module functions
+
+// MQTT topic filter matching: '+' is one level, a trailing '#' any number of
+// them (the parent level included), and '$' topics only match '$' filters
+STATIC mp_obj_t mqtt_topic_matches(mp_obj_t sub_in, mp_obj_t topic_in) {
+    size_t slen, tlen;
+    const char *sub = mp_obj_str_get_data(sub_in, &slen);
+    const char *topic = mp_obj_str_get_data(topic_in, &tlen);
+    if (tlen > 0 && topic[0] == '$' && (slen == 0 || sub[0] != '$')) {
+        return mp_const_false;
+    }
+    size_t s = 0, t = 0;
+    for (;;) {
+        if (s < slen && sub[s] == '#') {
+            // only valid as the last level
+            return mp_obj_new_bool(s + 1 == slen);
+        }
+        if (s < slen && sub[s] == '+') {
+            s++;
+            while (t < tlen && topic[t] != '/') {
+                t++;
+            }
+        } else {
+            while (s < slen && t < tlen && sub[s] != '/' && sub[s] == topic[t]) {
+                s++;
+                t++;
+            }
+            if ((s < slen && sub[s] != '/') || (t < tlen && topic[t] != '/')) {
+                return mp_const_false;
+            }
+        }
+        // both at the end of a level
+        if (s == slen || t == tlen) {
+            break;
+        }
+        s++;
+        t++;
+    }
+    if (t == tlen && s + 2 == slen && sub[s] == '/' && sub[s + 1] == '#') {
+        // "a/#" matches "a"
+        return mp_const_true;
+    }
+    return mp_obj_new_bool(s == slen && t == tlen);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mqtt_topic_matches_obj, mqtt_topic_matches);
+
+// the delay before reconnection attempt n, exponential with equal jitter so that
+// a fleet rebooted together doesn't hammer the broker in step
+STATIC mp_obj_t mqtt_backoff(size_t n_args, const mp_obj_t *args) {
+    mp_int_t attempt = mp_obj_get_int(args[0]);
+    mp_uint_t base_ms = (n_args > 1) ? mp_obj_get_int(args[1]) : 1000;
+    mp_uint_t max_ms = (n_args > 2) ? mp_obj_get_int(args[2]) : 60000;
+    if (attempt < 0) {
+        attempt = 0;
+    }
+    mp_uint_t delay = max_ms;
+    if (attempt < 16 && base_ms < (max_ms >> attempt)) {
+        delay = base_ms << attempt;
+    }
+    if (delay > 1) {
+        delay = delay / 2 + esp_random() % (delay / 2 + 1);
+    }
+    return mp_obj_new_int_from_uint(delay);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mqtt_backoff_obj, 1, 3, mqtt_backoff);
+
+STATIC const mp_map_elem_t mp_module_mqttcore_globals_table[] = {
+    { MP_OBJ_NEW_QSTR(MP_QSTR___name__),            MP_OBJ_NEW_QSTR(MP_QSTR_mqttcore) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_Client),              (mp_obj_t)&mqtt_client_type },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_topic_matches),       (mp_obj_t)&mqtt_topic_matches_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_backoff),             (mp_obj_t)&mqtt_backoff_obj },
+};
+STATIC MP_DEFINE_CONST_DICT(mp_module_mqttcore_globals, mp_module_mqttcore_globals_table);
+
+const mp_obj_module_t mp_module_mqttcore = {
+    .base = { &mp_type_module },
+    .globals = (mp_obj_dict_t*)&mp_module_mqttcore_globals,
+};
@@ -38,6 +38,7 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "py/mpstate.h"
 #include "py/obj.h"
@@ -57,6 +58,12 @@
 #ifdef PYETH_ENABLED
 #include "modeth.h"
 #endif
+#ifdef MOD_WIZNET5K_ENABLED
+#include "modwiznet5k.h"
+#endif
+#if defined(FIPY) || defined(GPY)
+#include "modlteudp.h"
+#endif
 
 #include "lwip/sockets.h"
 
@@ -76,6 +83,28 @@ STATIC const mp_obj_type_t network_server_type;
 
 STATIC void network_select_nic(mp_obj_t removed_nic);
 
+STATIC const mod_network_nic_type_t *network_nic_types[] = {
+    &mod_network_nic_type_wlan,
+#ifdef PYETH_ENABLED
+    &mod_network_nic_type_eth,
+#endif
+#ifdef MOD_WIZNET5K_ENABLED
+    &mod_network_nic_type_wiznet5k,
+#endif
+#ifdef MOD_LORA_ENABLED
+    &mod_network_nic_type_lora,
+#endif
+#if defined (SIPY) || defined (LOPY4) || defined (FIPY)
+#if defined (MOD_SIGFOX_ENABLED)
+    &mod_network_nic_type_sigfox,
+#endif
+#endif
+#if defined(FIPY) || defined(GPY)
+    &mod_network_nic_type_lte,
+#endif
+    &mod_network_nic_type_bt,
+};
+
 /// \module network - network configuration
 ///
 /// This module provides network drivers and server configuration.
@@ -106,7 +135,75 @@ void mod_network_deregister_nic(mp_obj_t nic) {
     }
 }
 
+// returns the time the socket call starts at, only read when the latency is recorded
+uint32_t mod_network_stats_start(const mod_network_nic_type_t *nic_type) {
+    if (nic_type->stats != NULL && nic_type->stats->latency_enabled) {
+        return mp_hal_ticks_us();
+    }
+    return 0;
+}
+
+STATIC void network_stats_latency(mod_network_nic_stats_t *stats, uint32_t start) {
+    if (stats->latency_enabled) {
+        uint32_t elapsed = (mp_hal_ticks_us() - start) / 1000;
+        uint32_t bucket = 0;
+        while (bucket < MOD_NETWORK_LATENCY_BUCKETS - 1 && elapsed >= (1 << (2 * bucket))) {
+            bucket++;
+        }
+        stats->latency[bucket]++;
+    }
+}
+
+void mod_network_stats_tx(const mod_network_nic_type_t *nic_type, mp_int_t ret, uint32_t start) {
+    mod_network_nic_stats_t *stats = nic_type->stats;
+    if (stats != NULL) {
+        if (ret < 0) {
+            stats->tx_errors++;
+        } else {
+            stats->tx_packets++;
+            stats->tx_bytes += ret;
+            network_stats_latency(stats, start);
+        }
+    }
+}
+
+void mod_network_stats_rx(const mod_network_nic_type_t *nic_type, mp_int_t ret, uint32_t start) {
+    mod_network_nic_stats_t *stats = nic_type->stats;
+    // nothing read from a non-blocking socket is not counted
+    if (stats != NULL) {
+        if (ret < 0) {
+            stats->rx_errors++;
+        } else if (ret > 0) {
+            stats->rx_packets++;
+            stats->rx_bytes += ret;
+            network_stats_latency(stats, start);
+        }
+    }
+}
+
 mp_obj_t mod_network_find_nic(const mod_network_socket_obj_t *s, const uint8_t *ip) {
+#ifdef MOD_WIZNET5K_ENABLED
+    // the sockets of the W5500 bypass lwIP, it takes them all while it's initialised
+    if (ip != NULL && s->sock_base.u.u_param.domain == AF_INET) {
+        for (mp_uint_t i = 0; i < MP_STATE_PORT(mod_network_nic_list).len; i++) {
+            mp_obj_t nic = MP_STATE_PORT(mod_network_nic_list).items[i];
+            if (mp_obj_get_type(nic) == (mp_obj_type_t *)&mod_network_nic_type_wiznet5k) {
+                return nic;
+            }
+        }
+    }
+#endif
+#if defined(FIPY) || defined(GPY)
+    // with LTE.connect(offload=True) the datagrams go through the sockets of the modem, PPP is down
+    if (ip != NULL && s->sock_base.u.u_param.domain == AF_INET && s->sock_base.u.u_param.type == SOCK_DGRAM) {
+        for (mp_uint_t i = 0; i < MP_STATE_PORT(mod_network_nic_list).len; i++) {
+            mp_obj_t nic = MP_STATE_PORT(mod_network_nic_list).items[i];
+            if (mp_obj_get_type(nic) == (mp_obj_type_t *)&mod_network_nic_type_lte_udp) {
+                return nic;
+            }
+        }
+    }
+#endif
     // find a NIC that is suited to a given IP address
     for (mp_uint_t i = 0; i < MP_STATE_PORT(mod_network_nic_list).len; i++) {
         mp_obj_t nic = MP_STATE_PORT(mod_network_nic_list).items[i];
@@ -365,12 +462,77 @@ STATIC mp_obj_t network_server_deinit(mp_obj_t self_in) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(network_server_deinit_obj, network_server_deinit);
 
+/// \function stats(nic, *, latency=None, reset=False)
+/// the nic can be given as an interface object or as its class, like network.WLAN
+STATIC const mp_arg_t network_stats_args[] = {
+    { MP_QSTR_nic,                           MP_ARG_REQUIRED | MP_ARG_OBJ, },
+    { MP_QSTR_latency,      MP_ARG_KW_ONLY | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+    { MP_QSTR_reset,        MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false} },
+};
+STATIC mp_obj_t network_stats(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    static const qstr network_stats_fields[] = {
+        MP_QSTR_tx_packets, MP_QSTR_tx_bytes, MP_QSTR_tx_errors,
+        MP_QSTR_rx_packets, MP_QSTR_rx_bytes, MP_QSTR_rx_errors, MP_QSTR_latency
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(network_stats_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(args), network_stats_args, args);
+
+    mp_obj_t nic = args[0].u_obj;
+    const mod_network_nic_type_t *nic_type = NULL;
+    if (!MP_OBJ_IS_TYPE(nic, &mp_type_type)) {
+        nic = (mp_obj_t)mp_obj_get_type(nic);
+    }
+    for (mp_uint_t i = 0; i < MP_ARRAY_SIZE(network_nic_types); i++) {
+        if (nic == (mp_obj_t)network_nic_types[i]) {
+            nic_type = network_nic_types[i];
+            break;
+        }
+    }
+    if (nic_type == NULL || nic_type->stats == NULL) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+
+    mod_network_nic_stats_t *stats = nic_type->stats;
+    mp_obj_t tuple[MP_ARRAY_SIZE(network_stats_fields)];
+    tuple[0] = mp_obj_new_int_from_uint(stats->tx_packets);
+    tuple[1] = mp_obj_new_int_from_uint(stats->tx_bytes);
+    tuple[2] = mp_obj_new_int_from_uint(stats->tx_errors);
+    tuple[3] = mp_obj_new_int_from_uint(stats->rx_packets);
+    tuple[4] = mp_obj_new_int_from_uint(stats->rx_bytes);
+    tuple[5] = mp_obj_new_int_from_uint(stats->rx_errors);
+    tuple[6] = mp_const_none;
+    if (stats->latency_enabled) {
+        mp_obj_t buckets[MOD_NETWORK_LATENCY_BUCKETS];
+        for (mp_uint_t i = 0; i < MOD_NETWORK_LATENCY_BUCKETS; i++) {
+            buckets[i] = mp_obj_new_int_from_uint(stats->latency[i]);
+        }
+        tuple[6] = mp_obj_new_tuple(MOD_NETWORK_LATENCY_BUCKETS, buckets);
+    }
+
+    if (args[2].u_bool) {
+        bool latency_enabled = stats->latency_enabled;
+        memset(stats, 0, sizeof(*stats));
+        stats->latency_enabled = latency_enabled;
+    }
+    if (args[1].u_obj != mp_const_none) {
+        stats->latency_enabled = mp_obj_is_true(args[1].u_obj);
+        memset(stats->latency, 0, sizeof(stats->latency));
+    }
+
+    return mp_obj_new_attrtuple(network_stats_fields, MP_ARRAY_SIZE(network_stats_fields), tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(network_stats_obj, 1, network_stats);
+
 STATIC const mp_map_elem_t mp_module_network_globals_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR___name__),            MP_OBJ_NEW_QSTR(MP_QSTR_network) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_stats),               (mp_obj_t)&network_stats_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_WLAN),                (mp_obj_t)&mod_network_nic_type_wlan },
 #ifdef PYETH_ENABLED
     { MP_OBJ_NEW_QSTR(MP_QSTR_ETH),                (mp_obj_t)&mod_network_nic_type_eth },
 #endif
+#ifdef MOD_WIZNET5K_ENABLED
+    { MP_OBJ_NEW_QSTR(MP_QSTR_WIZNET5K),           (mp_obj_t)&mod_network_nic_type_wiznet5k },
+#endif
 #ifdef MOD_LORA_ENABLED
     { MP_OBJ_NEW_QSTR(MP_QSTR_LoRa),                (mp_obj_t)&mod_network_nic_type_lora },
 #endif
@@ -44,6 +44,9 @@
  ******************************************************************************/
 #define MOD_NETWORK_IPV4ADDR_BUF_SIZE             (4)
 
+// socket call latency buckets, bucket n counts the calls below 4^n ms, the last one the rest
+#define MOD_NETWORK_LATENCY_BUCKETS               (8)
+
 /******************************************************************************
  DEFINE TYPES
  ******************************************************************************/
@@ -59,6 +62,18 @@ typedef enum {
     SOCKET_CONN_TIMEDOUT
 }mod_network_sock_conn_status_t;
 
+// kept by each nic, updated by the socket layer on every send / recv
+typedef struct _mod_network_nic_stats_t {
+    uint32_t tx_packets;
+    uint32_t tx_bytes;
+    uint32_t tx_errors;
+    uint32_t rx_packets;
+    uint32_t rx_bytes;
+    uint32_t rx_errors;
+    bool latency_enabled;
+    uint32_t latency[MOD_NETWORK_LATENCY_BUCKETS];
+} mod_network_nic_stats_t;
+
 typedef struct _mod_network_nic_type_t {
     mp_obj_type_t base;
 
@@ -85,6 +100,9 @@ typedef struct _mod_network_nic_type_t {
     bool (*inf_up)(void);
     // Bring Inf_up
     void (*set_default_inf)(void);
+
+    // Traffic counters, NULL if the nic keeps none
+    mod_network_nic_stats_t *stats;
 } mod_network_nic_type_t;
 
 typedef struct _mod_network_socket_base_t {
@@ -107,6 +125,7 @@ typedef struct _mod_network_socket_base_t {
     mod_network_sock_conn_status_t conn_status;
     int err;
     uint8_t domain;
+    uint32_t rx_size;       // most bytes one recv hands over, 0 for the nic default
 } mod_network_socket_base_t;
 
 typedef struct _mod_network_socket_obj_t {
@@ -128,6 +147,9 @@ extern const mod_network_nic_type_t mod_network_nic_type_lte;
  ******************************************************************************/
 void mod_network_init0(void);
 void mod_network_register_nic(mp_obj_t nic);
+uint32_t mod_network_stats_start(const mod_network_nic_type_t *nic_type);
+void mod_network_stats_tx(const mod_network_nic_type_t *nic_type, mp_int_t ret, uint32_t start);
+void mod_network_stats_rx(const mod_network_nic_type_t *nic_type, mp_int_t ret, uint32_t start);
 void mod_network_deregister_nic(mp_obj_t nic);
 mp_obj_t mod_network_find_nic(const mod_network_socket_obj_t *s, const uint8_t *ip);
 
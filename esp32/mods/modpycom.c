@@ -39,6 +39,12 @@
 #include "modmachine.h"
 #include "esp32chipinfo.h"
 #include "modwlan.h"
+#include "xipimage.h"
+#include "bootprof.h"
+#include "flashstats.h"
+#include "tracering.h"
+#include "pwrmgr.h"
+#include "py/stream.h"
 
 
 #include <string.h>
@@ -176,13 +182,23 @@ STATIC mp_obj_t mod_pycom_rgb_led (mp_uint_t n_args, const mp_obj_t *args) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_pycom_rgb_led_obj, 0,1,mod_pycom_rgb_led);
 
-STATIC mp_obj_t mod_pycom_ota_start (void) {
-    if (!updater_start()) {
+STATIC mp_obj_t mod_pycom_ota_start (mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_resume,       MP_ARG_KW_ONLY | MP_ARG_BOOL,  {.u_bool = false} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    // with resume=True an interrupted delta update carries on, the return value
+    // is the offset in the delta file from where the download has to continue
+    uint32_t patch_offset = 0;
+    bool ok = args[0].u_bool ? updater_resume(&patch_offset) : updater_start();
+    if (!ok) {
         nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_operation_failed));
     }
-    return mp_const_none;
+    return mp_obj_new_int_from_uint(patch_offset);
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_pycom_ota_start_obj, mod_pycom_ota_start);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_pycom_ota_start_obj, 0, mod_pycom_ota_start);
 
 STATIC mp_obj_t mod_pycom_ota_write (mp_obj_t data) {
     mp_buffer_info_t bufinfo;
@@ -215,6 +231,20 @@ STATIC mp_obj_t mod_pycom_ota_slot (void) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_pycom_ota_slot_obj, mod_pycom_ota_slot);
 
+#if MICROPY_MODULE_FROZEN_XIP
+STATIC mp_obj_t mod_pycom_xip_build (mp_obj_t modules) {
+    xipimage_build(modules);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_pycom_xip_build_obj, mod_pycom_xip_build);
+
+STATIC mp_obj_t mod_pycom_xip_invalidate (void) {
+    xipimage_invalidate();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_pycom_xip_invalidate_obj, mod_pycom_xip_invalidate);
+#endif
+
 STATIC mp_obj_t mod_pycom_diff_update_enabled (void) {
 #ifdef DIFF_UPDATE_ENABLED
     return mp_obj_new_bool(true);
@@ -244,14 +274,20 @@ STATIC mp_obj_t mod_pycom_pulses_get (mp_obj_t gpio, mp_obj_t timeout) {
     rmt_rx_start(RMT_CHANNEL_0, 1);
 
     size_t rx_size = 0;
+    MP_THREAD_GIL_EXIT();
     rmt_item32_t* item = (rmt_item32_t*) xRingbufferReceive(rb, &rx_size, mp_obj_get_int(timeout));
+    MP_THREAD_GIL_ENTER();
     if (item) {
-        for (int i = 0; i < rx_size / 4; i++) {
+        // the burst ends with the first pulse of zero duration
+        for (int i = 0; i < rx_size / 4 && item[i].duration0 != 0; i++) {
             mp_obj_t tuple[2];
             tuple[0] = mp_obj_new_int(item[i].level0);
             tuple[1] = mp_obj_new_int(item[i].duration0);
             mp_obj_list_append(pulses_l, mp_obj_new_tuple(2, tuple));
 
+            if (item[i].duration1 == 0) {
+                break;
+            }
             tuple[0] = mp_obj_new_int(item[i].level1);
             tuple[1] = mp_obj_new_int(item[i].duration1);
             mp_obj_list_append(pulses_l, mp_obj_new_tuple(2, tuple));
@@ -268,6 +304,23 @@ STATIC mp_obj_t mod_pycom_pulses_get (mp_obj_t gpio, mp_obj_t timeout) {
 STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_pycom_pulses_get_obj, mod_pycom_pulses_get);
 
 
+// provisioning scripts tend to set the same values again, leave the flash alone then
+STATIC bool mod_pycom_nvs_str_unchanged (const char *key, const char *value) {
+    size_t len;
+    if (nvs_get_str(pycom_nvs_handle, key, NULL, &len) != ESP_OK || len != strlen(value) + 1) {
+        return false;
+    }
+    char *stored = malloc(len);
+    bool unchanged = stored != NULL && nvs_get_str(pycom_nvs_handle, key, stored, &len) == ESP_OK && !strcmp(stored, value);
+    free(stored);
+    return unchanged;
+}
+
+STATIC bool mod_pycom_nvs_u32_unchanged (const char *key, uint32_t value) {
+    uint32_t stored;
+    return nvs_get_u32(pycom_nvs_handle, key, &stored) == ESP_OK && stored == value;
+}
+
 STATIC mp_obj_t mod_pycom_nvs_set (mp_obj_t _key, mp_obj_t _value) {
 
     const char *key = mp_obj_str_get_str(_key);
@@ -279,9 +332,15 @@ STATIC mp_obj_t mod_pycom_nvs_set (mp_obj_t _key, mp_obj_t _value) {
             // Maximum length (including null character) can be 1984 bytes
             nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "value too long (max: 1984)"));
         }
+        if (mod_pycom_nvs_str_unchanged(key, value)) {
+            return mp_const_none;
+        }
         esp_err = nvs_set_str(pycom_nvs_handle, key, value);
     } else if(MP_OBJ_IS_INT(_value)) {
         uint32_t value = mp_obj_get_int_truncated(_value);
+        if (mod_pycom_nvs_u32_unchanged(key, value)) {
+            return mp_const_none;
+        }
         esp_err = nvs_set_u32(pycom_nvs_handle, key, value);
     } else {
         nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "Value must be string, bytes or integer"));
@@ -594,6 +653,145 @@ STATIC mp_obj_t mod_pycom_pybytes_on_boot (mp_uint_t n_args, const mp_obj_t *arg
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_pycom_pybytes_on_boot_obj, 0, 1, mod_pycom_pybytes_on_boot);
 
+STATIC mp_obj_t mod_pycom_fast_boot_on_wake (mp_uint_t n_args, const mp_obj_t *args) {
+    if (n_args) {
+        bool enable = mp_obj_is_true(args[0]);
+        config_set_fast_boot_on_wake (enable);
+        // let the bootloader know straight away, the next deep sleep may come before a reboot
+        bootprof_set_fast_boot (enable);
+    } else {
+        return mp_obj_new_bool(config_get_fast_boot_on_wake());
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_pycom_fast_boot_on_wake_obj, 0, 1, mod_pycom_fast_boot_on_wake);
+
+// pycom.config_batch(True) holds the changes to the settings in RAM, and
+// pycom.config_batch(False) writes them all with a single sector erase
+STATIC mp_obj_t mod_pycom_config_batch (mp_uint_t n_args, const mp_obj_t *args) {
+    if (n_args) {
+        if (mp_obj_is_true(args[0])) {
+            config_batch_begin();
+        } else if (!config_commit()) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_operation_failed));
+        }
+    } else {
+        return mp_obj_new_bool(config_get_batching());
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_pycom_config_batch_obj, 0, 1, mod_pycom_config_batch);
+
+STATIC mp_obj_t mod_pycom_boot_profile (void) {
+    return bootprof_get_profile();
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_pycom_boot_profile_obj, mod_pycom_boot_profile);
+
+STATIC mp_obj_t mod_pycom_flash_stats (mp_uint_t n_args, const mp_obj_t *args) {
+    // {region: (reads, bytes_read, programs, bytes_programmed, erases, bytes_erased,
+    //           cache_hits, errors, max_read_us, max_program_us, max_erase_us)}
+    return flashstats_get(n_args > 0 && mp_obj_is_true(args[0]));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_pycom_flash_stats_obj, 0, 1, mod_pycom_flash_stats);
+
+STATIC mp_obj_t mod_pycom_trace_start (mp_uint_t n_args, const mp_obj_t *args) {
+    // events per core, recording goes on over the oldest ones once the ring is full
+    trace_start(n_args > 0 ? mp_obj_get_int(args[0]) : 4096);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_pycom_trace_start_obj, 0, 1, mod_pycom_trace_start);
+
+STATIC mp_obj_t mod_pycom_trace_stop (void) {
+    trace_stop();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_pycom_trace_stop_obj, mod_pycom_trace_stop);
+
+STATIC mp_obj_t mod_pycom_trace_event (mp_uint_t n_args, const mp_obj_t *args) {
+    TRACE_INSTANT(TRACE_EV_USER, n_args > 0 ? mp_obj_get_int(args[0]) : 0);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_pycom_trace_event_obj, 0, 1, mod_pycom_trace_event);
+
+STATIC mp_obj_t mod_pycom_trace_dump (mp_uint_t n_args, const mp_obj_t *args) {
+    // to the REPL (UART or telnet) unless a file or a socket is given
+    if (n_args > 0 && args[0] != mp_const_none) {
+        mp_get_stream_raise(args[0], MP_STREAM_OP_WRITE);
+        mp_print_t print = {MP_OBJ_TO_PTR(args[0]), mp_stream_write_adaptor};
+        trace_dump(&print);
+    } else {
+        trace_dump(&mp_plat_print);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_pycom_trace_dump_obj, 0, 1, mod_pycom_trace_dump);
+
+STATIC mp_obj_t mod_pycom_service_core (mp_uint_t n_args, const mp_obj_t *args) {
+    if (n_args) {
+        mp_int_t core = mp_obj_get_int(args[0]);
+        if (core != PYCOM_CORE_AFFINITY_CORE_0 && core != PYCOM_CORE_AFFINITY_CORE_1) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "Error invalid core!"));
+        }
+        config_set_service_core(core);
+    } else {
+        return mp_obj_new_int(config_get_service_core());
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_pycom_service_core_obj, 0, 1, mod_pycom_service_core);
+
+STATIC mp_obj_t mod_pycom_thread_core (mp_uint_t n_args, const mp_obj_t *args) {
+    if (n_args) {
+        mp_int_t core = mp_obj_get_int(args[0]);
+        if (core < PYCOM_CORE_AFFINITY_CORE_0 || core > PYCOM_CORE_AFFINITY_ANY) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "Error invalid core!"));
+        }
+        config_set_thread_core(core);
+    } else {
+        return mp_obj_new_int(config_get_thread_core());
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_pycom_thread_core_obj, 0, 1, mod_pycom_thread_core);
+
+STATIC mp_obj_t mod_pycom_power_manager (size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_enable, ARG_min_freq, ARG_light_sleep };
+    STATIC const mp_arg_t allowed_args[] = {
+            { MP_QSTR_enable,           MP_ARG_OBJ,                   {.u_obj = mp_const_none} },
+            { MP_QSTR_min_freq,         MP_ARG_KW_ONLY | MP_ARG_INT,  {.u_int = 40} },
+            { MP_QSTR_light_sleep,      MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = true} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+
+    if (args[ARG_enable].u_obj == mp_const_none) {
+        // (enabled, (peripherals keeping the chip at full speed, ...))
+        mp_obj_t holders[PWRMGR_NUM_HOLDERS];
+        uint32_t mask = pwrmgr_get_holders();
+        size_t n = 0;
+        for (int i = 0; i < PWRMGR_NUM_HOLDERS; i++) {
+            if (mask & (1 << i)) {
+                holders[n++] = mp_obj_new_str(pwrmgr_holder_name(i), strlen(pwrmgr_holder_name(i)));
+            }
+        }
+        mp_obj_t tuple[2] = { mp_obj_new_bool(pwrmgr_is_enabled()), mp_obj_new_tuple(n, holders) };
+        return mp_obj_new_tuple(2, tuple);
+    }
+
+    mp_int_t min_freq = args[ARG_min_freq].u_int;
+    if (min_freq != 40 && min_freq != 80) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    esp_err_t err = pwrmgr_configure(mp_obj_is_true(args[ARG_enable].u_obj), min_freq, args[ARG_light_sleep].u_bool);
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        mp_raise_msg(&mp_type_OSError, "power management not supported by this firmware");
+    } else if (err != ESP_OK) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_operation_failed);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_pycom_power_manager_obj, 0, mod_pycom_power_manager);
+
 
 STATIC mp_obj_t mod_pycom_pybytes_lte_config (size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     enum { ARG_carrier, ARG_apn, ARG_cid, ARG_band, ARG_type, ARG_reset };
@@ -1070,16 +1268,31 @@ STATIC const mp_map_elem_t pycom_module_globals_table[] = {
         { MP_OBJ_NEW_QSTR(MP_QSTR_ota_verify),                      (mp_obj_t)&mod_pycom_ota_verify_obj },
         { MP_OBJ_NEW_QSTR(MP_QSTR_ota_slot),                        (mp_obj_t)&mod_pycom_ota_slot_obj },
         { MP_OBJ_NEW_QSTR(MP_QSTR_diff_update_enabled),             (mp_obj_t)&mod_pycom_diff_update_enabled_obj },
+#if MICROPY_MODULE_FROZEN_XIP
+        { MP_OBJ_NEW_QSTR(MP_QSTR_xip_build),                       (mp_obj_t)&mod_pycom_xip_build_obj },
+        { MP_OBJ_NEW_QSTR(MP_QSTR_xip_invalidate),                  (mp_obj_t)&mod_pycom_xip_invalidate_obj },
+#endif
         { MP_OBJ_NEW_QSTR(MP_QSTR_pulses_get),                      (mp_obj_t)&mod_pycom_pulses_get_obj },
         { MP_OBJ_NEW_QSTR(MP_QSTR_nvs_set),                         (mp_obj_t)&mod_pycom_nvs_set_obj },
         { MP_OBJ_NEW_QSTR(MP_QSTR_nvs_get),                         (mp_obj_t)&mod_pycom_nvs_get_obj },
         { MP_OBJ_NEW_QSTR(MP_QSTR_nvs_erase),                       (mp_obj_t)&mod_pycom_nvs_erase_obj },
         { MP_OBJ_NEW_QSTR(MP_QSTR_nvs_erase_all),                   (mp_obj_t)&mod_pycom_nvs_erase_all_obj },
+        { MP_OBJ_NEW_QSTR(MP_QSTR_config_batch),                    (mp_obj_t)&mod_pycom_config_batch_obj },
         { MP_OBJ_NEW_QSTR(MP_QSTR_wifi_on_boot),                    (mp_obj_t)&mod_pycom_wifi_on_boot_obj },
         { MP_OBJ_NEW_QSTR(MP_QSTR_wdt_on_boot),                     (mp_obj_t)&mod_pycom_wdt_on_boot_obj },
         { MP_OBJ_NEW_QSTR(MP_QSTR_wdt_on_boot_timeout),             (mp_obj_t)&mod_pycom_wdt_on_boot_timeout_obj },
         { MP_OBJ_NEW_QSTR(MP_QSTR_heartbeat_on_boot),               (mp_obj_t)&mod_pycom_heartbeat_on_boot_obj },
         { MP_OBJ_NEW_QSTR(MP_QSTR_lte_modem_en_on_boot),            (mp_obj_t)&mod_pycom_lte_modem_on_boot_obj },
+        { MP_OBJ_NEW_QSTR(MP_QSTR_fast_boot_on_wake),               (mp_obj_t)&mod_pycom_fast_boot_on_wake_obj },
+        { MP_OBJ_NEW_QSTR(MP_QSTR_boot_profile),                    (mp_obj_t)&mod_pycom_boot_profile_obj },
+        { MP_OBJ_NEW_QSTR(MP_QSTR_flash_stats),                     (mp_obj_t)&mod_pycom_flash_stats_obj },
+        { MP_OBJ_NEW_QSTR(MP_QSTR_trace_start),                     (mp_obj_t)&mod_pycom_trace_start_obj },
+        { MP_OBJ_NEW_QSTR(MP_QSTR_trace_stop),                      (mp_obj_t)&mod_pycom_trace_stop_obj },
+        { MP_OBJ_NEW_QSTR(MP_QSTR_trace_event),                     (mp_obj_t)&mod_pycom_trace_event_obj },
+        { MP_OBJ_NEW_QSTR(MP_QSTR_trace_dump),                      (mp_obj_t)&mod_pycom_trace_dump_obj },
+        { MP_OBJ_NEW_QSTR(MP_QSTR_service_core),                    (mp_obj_t)&mod_pycom_service_core_obj },
+        { MP_OBJ_NEW_QSTR(MP_QSTR_thread_core),                     (mp_obj_t)&mod_pycom_thread_core_obj },
+        { MP_OBJ_NEW_QSTR(MP_QSTR_power_manager),                   (mp_obj_t)&mod_pycom_power_manager_obj },
         { MP_OBJ_NEW_QSTR(MP_QSTR_get_free_heap),                   (mp_obj_t)&mod_pycom_get_free_heap_obj },
         { MP_OBJ_NEW_QSTR(MP_QSTR_wifi_ssid_sta),                   (mp_obj_t)&mod_pycom_wifi_ssid_sta_obj },
         { MP_OBJ_NEW_QSTR(MP_QSTR_wifi_ssid_ap),                    (mp_obj_t)&mod_pycom_wifi_ssid_ap_obj },
@@ -21,12 +21,58 @@
 #include "mpexception.h"
 #include "py/stream.h"
 #include "esp32_mphal.h"
+#include "mpirq.h"
+#include "pycom_config.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
 
 #include "modnetwork.h"
 #include "modusocket.h"
 
 #include "sigfox/modsigfox.h"
 
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define SIGFOX_ASYNC_QUEUE_LEN                      (4)
+#define SIGFOX_ASYNC_TASK_STACK_SIZE                (3072)
+#define SIGFOX_ASYNC_TASK_PRIORITY                  (5)
+// a Sigfox frame carries about 14 bytes of overhead and is sent 3 times at
+// 100 bps in RCZ1 and RCZ3, where the radio may only be on 1% of the time
+#define SIGFOX_ASYNC_FRAME_OVERHEAD                 (14)
+#define SIGFOX_ASYNC_FRAME_REPEATS                  (3)
+#define SIGFOX_ASYNC_MS_PER_BYTE_100BPS             (80)
+#define SIGFOX_ASYNC_DUTY_CYCLE_OFF_FACTOR          (99)
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+typedef struct {
+    mod_network_socket_obj_t    *socket;
+    uint32_t                    tag;
+    int                         error;
+    uint8_t                     data[FSK_TX_PAYLOAD_SIZE_MAX];
+    uint8_t                     rx_data[FSK_TX_PAYLOAD_SIZE_MAX];
+    uint8_t                     len;
+    uint8_t                     rx_len;
+    volatile bool               busy;
+} sigfox_async_req_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+// requests made with send_async() are sent one after the other by a single task,
+// the handler and the socket are kept alive through the IRQ list until it runs
+STATIC sigfox_async_req_t sigfox_async_reqs[SIGFOX_ASYNC_QUEUE_LEN];
+STATIC QueueHandle_t sigfox_async_queue;
+STATIC uint32_t sigfox_async_tag;
+STATIC uint8_t sigfox_async_rcz = E_SIGFOX_RCZ1;
+// the library raises through nlr, so the task needs a thread state of its own
+STATIC mp_state_thread_t sigfox_async_ts;
+
 
 STATIC const mp_arg_t sigfox_init_args[] = {
     { MP_QSTR_id,                             MP_ARG_INT,   {.u_int  = 0} },
@@ -58,6 +104,7 @@ STATIC mp_obj_t sigfox_make_new(const mp_obj_type_t *type, mp_uint_t n_args, mp_
     if (n_kw > 0 || self->state == E_SIGFOX_STATE_NOINIT) {
         // start the peripheral
         sigfox_init_helper(self, &args[1]);
+        sigfox_async_rcz = args[2].u_int;
         // register it as a network card
         mod_network_register_nic(self);
     }
@@ -69,10 +116,136 @@ STATIC mp_obj_t sigfox_init(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t
     // parse args
     mp_arg_val_t args[MP_ARRAY_SIZE(sigfox_init_args) - 1];
     mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), &sigfox_init_args[1], args);
-    return sigfox_init_helper(pos_args[0], args);
+    mp_obj_t ret = sigfox_init_helper(pos_args[0], args);
+    sigfox_async_rcz = args[1].u_int;
+    return ret;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(sigfox_init_obj, 1, sigfox_init);
 
+STATIC void sigfox_async_done (void *arg) {
+    sigfox_async_req_t *req = arg;
+    mp_obj_tuple_t *irq = mp_irq_find(req);
+    req->busy = false;
+    if (irq == NULL) {
+        return;
+    }
+    mp_obj_tuple_t *pending = MP_OBJ_TO_PTR(irq->items[1]);
+    mp_obj_t handler = pending->items[0];
+    mp_irq_remove(req);
+    if (handler != mp_const_none) {
+        mp_obj_t downlink = req->rx_len > 0 ? mp_obj_new_bytes(req->rx_data, req->rx_len) : mp_const_none;
+        mp_call_function_n_kw(handler, 3, 0, (mp_obj_t []){ mp_obj_new_int_from_uint(req->tag),
+                                                           MP_OBJ_NEW_SMALL_INT(req->error), downlink });
+    }
+}
+
+STATIC uint32_t sigfox_async_off_time_ms (uint32_t len) {
+    if (sigfox_obj.mode != E_SIGFOX_MODE_SIGFOX || (sigfox_async_rcz != E_SIGFOX_RCZ1 && sigfox_async_rcz != E_SIGFOX_RCZ3)) {
+        return 0;
+    }
+    uint32_t airtime = (len + SIGFOX_ASYNC_FRAME_OVERHEAD) * SIGFOX_ASYNC_MS_PER_BYTE_100BPS * SIGFOX_ASYNC_FRAME_REPEATS;
+    return airtime * SIGFOX_ASYNC_DUTY_CYCLE_OFF_FACTOR;
+}
+
+STATIC void TASK_Sigfox_Async (void *pvParameters) {
+    mp_thread_set_state(&sigfox_async_ts);
+    TickType_t next_tx = xTaskGetTickCount();
+    uint8_t idx;
+    for (;;) {
+        xQueueReceive(sigfox_async_queue, &idx, portMAX_DELAY);
+        sigfox_async_req_t *req = &sigfox_async_reqs[idx];
+        // wait for the end of the off time left by the previous frame
+        int32_t wait = (int32_t)(next_tx - xTaskGetTickCount());
+        if (wait > 0) {
+            vTaskDelay(wait);
+        }
+        int _errno = 0;
+        nlr_buf_t nlr;
+        if (nlr_push(&nlr) == 0) {
+            if (sigfox_socket_send(req->socket, req->data, req->len, &_errno) >= 0) {
+                _errno = 0;
+                // a downlink, if one was requested, is already buffered when the send returns
+                if (sigfox_socket_ioctl(req->socket, MP_STREAM_POLL, MP_STREAM_POLL_RD, &_errno) & MP_STREAM_POLL_RD) {
+                    int n = sigfox_socket_recv(req->socket, req->rx_data, sizeof(req->rx_data), &_errno);
+                    req->rx_len = (n > 0) ? n : 0;
+                }
+                _errno = 0;
+            } else if (_errno == 0) {
+                _errno = MP_EIO;
+            }
+            nlr_pop();
+        } else {
+            _errno = MP_EIO;
+        }
+#if MICROPY_PY_THREAD_GIL
+        // the library waits with mp_hal_delay_ms(), which leaves us holding the GIL
+        if (xSemaphoreGetMutexHolder(MP_STATE_VM(gil_mutex).handle) == xTaskGetCurrentTaskHandle()) {
+            MP_THREAD_GIL_EXIT();
+        }
+#endif
+        req->error = _errno;
+        next_tx = xTaskGetTickCount() + sigfox_async_off_time_ms(req->len) / portTICK_PERIOD_MS;
+        mp_irq_queue_interrupt_non_ISR(sigfox_async_done, (void *)req);
+    }
+}
+
+/// \method send_async(socket, data, *, handler=None)
+/// queue data to be sent on a Sigfox socket and return right away with a tag;
+/// handler(tag, errno, downlink) is called once the frame is out, where
+/// downlink is the received payload or None. In RCZ1 and RCZ3 the frames are
+/// spaced to keep the radio within its 1% duty cycle
+STATIC mp_obj_t sigfox_send_async(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    enum { ARG_socket, ARG_data, ARG_handler };
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_socket,   MP_ARG_REQUIRED | MP_ARG_OBJ,  },
+        { MP_QSTR_data,     MP_ARG_REQUIRED | MP_ARG_OBJ,  },
+        { MP_QSTR_handler,  MP_ARG_KW_ONLY  | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+    };
+    sigfox_obj_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    if (self->state == E_SIGFOX_STATE_NOINIT) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_request_not_possible));
+    }
+    mod_network_socket_obj_t *socket = args[ARG_socket].u_obj;
+    if (!MP_OBJ_IS_TYPE(socket, &socket_type) || socket->sock_base.nic_type != &mod_network_nic_type_sigfox) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[ARG_data].u_obj, &bufinfo, MP_BUFFER_READ);
+    size_t maxlen = (self->mode == E_SIGFOX_MODE_SIGFOX) ? SIGFOX_TX_PAYLOAD_SIZE_MAX : FSK_TX_PAYLOAD_SIZE_MAX;
+    if (bufinfo.len > maxlen) {
+        mp_raise_OSError(MP_EMSGSIZE);
+    }
+
+    uint8_t idx;
+    for (idx = 0; idx < SIGFOX_ASYNC_QUEUE_LEN && sigfox_async_reqs[idx].busy; idx++);
+    if (idx == SIGFOX_ASYNC_QUEUE_LEN) {
+        mp_raise_OSError(MP_ENOBUFS);
+    }
+
+    if (sigfox_async_queue == NULL) {
+        sigfox_async_queue = xQueueCreate(SIGFOX_ASYNC_QUEUE_LEN, sizeof(uint8_t));
+        xTaskCreatePinnedToCore(TASK_Sigfox_Async, "SigfoxAsync", SIGFOX_ASYNC_TASK_STACK_SIZE / sizeof(StackType_t), NULL,
+                                SIGFOX_ASYNC_TASK_PRIORITY, NULL, config_get_service_core());
+    }
+
+    sigfox_async_req_t *req = &sigfox_async_reqs[idx];
+    req->socket = socket;
+    req->tag = ++sigfox_async_tag;
+    req->error = 0;
+    req->rx_len = 0;
+    req->len = bufinfo.len;
+    memcpy(req->data, bufinfo.buf, bufinfo.len);
+    req->busy = true;
+    mp_obj_t pending[2] = { args[ARG_handler].u_obj, socket };
+    mp_irq_add(req, mp_obj_new_tuple(2, pending));
+    xQueueSend(sigfox_async_queue, &idx, portMAX_DELAY);
+    return mp_obj_new_int_from_uint(req->tag);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(sigfox_send_async_obj, 1, sigfox_send_async);
+
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(sigfox_mac_obj, sigfox_mac);
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(sigfox_id_obj, sigfox_id);
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(sigfox_pac_obj, sigfox_pac);
@@ -105,6 +278,7 @@ STATIC const mp_map_elem_t sigfox_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_freq_offset),         (mp_obj_t)&sigfox_freq_offset_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_info),                (mp_obj_t)&sigfox_info_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_reset),               (mp_obj_t)&sigfox_reset_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_send_async),          (mp_obj_t)&sigfox_send_async_obj },
 
     { MP_OBJ_NEW_QSTR(MP_QSTR_SIGFOX),              MP_OBJ_NEW_SMALL_INT(E_SIGFOX_MODE_SIGFOX) },
 #if !defined(FIPY) && !defined(LOPY4)
@@ -119,6 +293,8 @@ STATIC const mp_map_elem_t sigfox_locals_dict_table[] = {
 
 STATIC MP_DEFINE_CONST_DICT(sigfox_locals_dict, sigfox_locals_dict_table);
 
+STATIC mod_network_nic_stats_t sigfox_stats;
+
 const mod_network_nic_type_t mod_network_nic_type_sigfox = {
     .base = {
         { &mp_type_type },
@@ -134,4 +310,5 @@ const mod_network_nic_type_t mod_network_nic_type_sigfox = {
     .n_settimeout = sigfox_socket_settimeout,
     .n_setsockopt = sigfox_socket_setsockopt,
     .n_ioctl = sigfox_socket_ioctl,
+    .stats = &sigfox_stats
 };
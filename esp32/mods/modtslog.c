@@ -0,0 +1,529 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/mperrno.h"
+#include "py/builtin.h"
+
+#include "esp_spi_flash.h"
+#include "esp_flash_encrypt.h"
+#include "rom/crc.h"
+
+#include "mpexception.h"
+#include "machrtc.h"
+#include "moduos.h"
+#include "esp32chipinfo.h"
+#include "flashstats.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define TSLOG_SECTOR_SIZE               SPI_FLASH_SEC_SIZE
+#define TSLOG_MAGIC                     (0x474C5354)    // "TSLG"
+#define TSLOG_RECORD_OVERHEAD           (sizeof(uint32_t) + sizeof(uint16_t))   // timestamp and crc
+#define TSLOG_SLOT_SIZE_MAX             (256)
+// encrypted flash can only be written in blocks of 16 bytes
+#define TSLOG_SLOT_ALIGN                (esp_flash_encryption_enabled() ? 16 : 4)
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+// at the start of every sector, written once right after the sector is erased
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;           // one more than the sector written before
+    uint16_t slot_size;
+    uint16_t schema;        // crc of the record format
+    uint16_t reserved;
+    uint16_t crc;
+} tslog_header_t;
+
+typedef struct _tslog_obj_t {
+    mp_obj_base_t base;
+    mp_obj_t fmt;
+    uint32_t addr;
+    uint32_t sectors;
+    uint16_t slot_size;
+    uint16_t payload_size;
+    uint16_t slots;         // per sector
+    uint16_t schema;
+    uint32_t head;          // the sector being written
+    uint32_t head_seq;
+    uint32_t head_pos;      // the next free slot of the head sector
+    uint32_t used;          // sectors holding records, ending with the head
+    uint8_t *slot;          // one record
+} tslog_obj_t;
+
+typedef struct _tslog_iter_t {
+    mp_obj_base_t base;
+    mp_fun_1_t iternext;
+    tslog_obj_t *log;
+    uint32_t seq;
+    uint32_t pos;
+    uint32_t start;
+    uint32_t end;
+} tslog_iter_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+STATIC const mp_obj_type_t tslog_type;
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+STATIC void tslog_flash_read(uint32_t addr, void *buf, uint32_t len) {
+    esp_err_t err;
+    int64_t start = esp_timer_get_time();
+    if (esp_flash_encryption_enabled()) {
+        err = spi_flash_read_encrypted(addr, buf, len);
+    } else {
+        err = spi_flash_read(addr, buf, len);
+    }
+    flashstats_record(FLASHSTATS_TSLOG, FLASHSTATS_READ, len, start, err);
+    if (err != ESP_OK) {
+        mp_raise_OSError(MP_EIO);
+    }
+}
+
+STATIC void tslog_flash_write(uint32_t addr, const void *buf, uint32_t len) {
+    esp_err_t err;
+    int64_t start = esp_timer_get_time();
+    if (esp_flash_encryption_enabled()) {
+        err = spi_flash_write_encrypted(addr, buf, len);
+    } else {
+        err = spi_flash_write(addr, buf, len);
+    }
+    flashstats_record(FLASHSTATS_TSLOG, FLASHSTATS_PROGRAM, len, start, err);
+    if (err != ESP_OK) {
+        mp_raise_OSError(MP_EIO);
+    }
+}
+
+STATIC void tslog_flash_erase(uint32_t addr) {
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = spi_flash_erase_sector(addr / TSLOG_SECTOR_SIZE);
+    flashstats_record(FLASHSTATS_TSLOG, FLASHSTATS_ERASE, TSLOG_SECTOR_SIZE, start, err);
+    if (err != ESP_OK) {
+        mp_raise_OSError(MP_EIO);
+    }
+}
+
+STATIC uint32_t tslog_sector_addr(tslog_obj_t *self, uint32_t idx) {
+    return self->addr + idx * TSLOG_SECTOR_SIZE;
+}
+
+STATIC uint32_t tslog_slot_addr(tslog_obj_t *self, uint32_t idx, uint32_t pos) {
+    return tslog_sector_addr(self, idx) + sizeof(tslog_header_t) + pos * self->slot_size;
+}
+
+// where the sector with the given sequence number lives, it must be one of the used ones
+STATIC uint32_t tslog_seq_to_idx(tslog_obj_t *self, uint32_t seq) {
+    return (self->head + self->sectors - ((self->head_seq - seq) % self->sectors)) % self->sectors;
+}
+
+STATIC uint32_t tslog_oldest_seq(tslog_obj_t *self) {
+    return self->head_seq - (self->used - 1);
+}
+
+STATIC bool tslog_read_header(tslog_obj_t *self, uint32_t idx, tslog_header_t *header) {
+    tslog_flash_read(tslog_sector_addr(self, idx), header, sizeof(tslog_header_t));
+    // an erased, half erased or torn header doesn't pass, so the sector counts as free
+    return header->magic == TSLOG_MAGIC &&
+           header->crc == crc16_le(UINT16_MAX, (const uint8_t *)header, offsetof(tslog_header_t, crc));
+}
+
+// erased flash only reads back as 0xFF without decryption
+STATIC bool tslog_slot_erased(tslog_obj_t *self, uint32_t idx, uint32_t pos) {
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = spi_flash_read(tslog_slot_addr(self, idx, pos), self->slot, self->slot_size);
+    flashstats_record(FLASHSTATS_TSLOG, FLASHSTATS_READ, self->slot_size, start, err);
+    if (err != ESP_OK) {
+        mp_raise_OSError(MP_EIO);
+    }
+    for (int i = 0; i < self->slot_size; i++) {
+        if (self->slot[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// loads the record into self->slot, false if it was torn by a power loss or never written
+STATIC bool tslog_read_record(tslog_obj_t *self, uint32_t idx, uint32_t pos, uint32_t *ts) {
+    uint16_t crc;
+    tslog_flash_read(tslog_slot_addr(self, idx, pos), self->slot, self->slot_size);
+    memcpy(&crc, &self->slot[sizeof(uint32_t) + self->payload_size], sizeof(crc));
+    memcpy(ts, self->slot, sizeof(uint32_t));
+    return *ts != UINT32_MAX && crc == crc16_le(UINT16_MAX, self->slot, sizeof(uint32_t) + self->payload_size);
+}
+
+// the timestamp of the first intact record of a used sector
+STATIC bool tslog_first_ts(tslog_obj_t *self, uint32_t seq, uint32_t *ts) {
+    uint32_t idx = tslog_seq_to_idx(self, seq);
+    uint32_t count = (seq == self->head_seq) ? self->head_pos : self->slots;
+    for (uint32_t pos = 0; pos < count; pos++) {
+        if (tslog_read_record(self, idx, pos, ts)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+STATIC bool tslog_last_ts(tslog_obj_t *self, uint32_t *ts) {
+    for (uint32_t age = 0; age < self->used; age++) {
+        uint32_t idx = tslog_seq_to_idx(self, self->head_seq - age);
+        uint32_t count = (age == 0) ? self->head_pos : self->slots;
+        while (count-- > 0) {
+            if (tslog_read_record(self, idx, count, ts)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+STATIC void tslog_start_sector(tslog_obj_t *self, uint32_t idx, uint32_t seq) {
+    tslog_flash_erase(tslog_sector_addr(self, idx));
+    tslog_header_t header = {
+        .magic = TSLOG_MAGIC,
+        .seq = seq,
+        .slot_size = self->slot_size,
+        .schema = self->schema,
+        .reserved = UINT16_MAX,
+    };
+    header.crc = crc16_le(UINT16_MAX, (const uint8_t *)&header, offsetof(tslog_header_t, crc));
+    tslog_flash_write(tslog_sector_addr(self, idx), &header, sizeof(header));
+}
+
+// rebuilds the state from the sector headers, which also recovers from a power loss at any point
+STATIC void tslog_mount(tslog_obj_t *self, bool reset) {
+    tslog_header_t header;
+    bool found = false;
+    bool mismatch = false;
+
+    for (uint32_t idx = 0; idx < self->sectors; idx++) {
+        if (!tslog_read_header(self, idx, &header)) {
+            continue;
+        }
+        if (reset) {
+            tslog_flash_erase(tslog_sector_addr(self, idx));
+        } else if (header.slot_size != self->slot_size || header.schema != self->schema) {
+            mismatch = true;
+        } else if (!found || (int32_t)(header.seq - self->head_seq) > 0) {
+            // the head is the sector with the newest sequence number
+            self->head = idx;
+            self->head_seq = header.seq;
+            found = true;
+        }
+    }
+    if (mismatch) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "the log was written with another schema"));
+    }
+
+    if (!found) {
+        // the first record goes to sector 0
+        self->head = self->sectors - 1;
+        self->head_seq = 0;
+        self->head_pos = self->slots;
+        self->used = 0;
+        return;
+    }
+
+    // the sectors written before the head follow it backwards, the first gap is where it wrapped
+    // or a sector that was being erased to make room
+    self->used = 1;
+    while (self->used < self->sectors) {
+        uint32_t idx = (self->head + self->sectors - self->used) % self->sectors;
+        if (!tslog_read_header(self, idx, &header) || header.seq != self->head_seq - self->used ||
+            header.slot_size != self->slot_size || header.schema != self->schema) {
+            break;
+        }
+        self->used++;
+    }
+
+    // slots are written in order, a torn one isn't erased any more so it's skipped over
+    uint32_t lo = 0, hi = self->slots;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (tslog_slot_erased(self, self->head, mid)) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    self->head_pos = lo;
+}
+
+// the sector a record with the given timestamp (or a later one) can be found from
+STATIC uint32_t tslog_seek(tslog_obj_t *self, uint32_t ts) {
+    uint32_t oldest = tslog_oldest_seq(self);
+    uint32_t lo = 0, hi = self->used;
+    // sectors are filled in time order, find the last one starting at or before ts
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        uint32_t first;
+        if (tslog_first_ts(self, oldest + mid, &first) && first > ts) {
+            hi = mid;
+        } else {
+            lo = mid;
+        }
+    }
+    return oldest + lo;
+}
+
+/******************************************************************************/
+// Micro Python bindings; Log iterator
+
+STATIC mp_obj_t tslog_iter_next(mp_obj_t self_in) {
+    tslog_iter_t *it = MP_OBJ_TO_PTR(self_in);
+    tslog_obj_t *self = it->log;
+
+    for (;;) {
+        uint32_t age = self->head_seq - it->seq;
+        if (self->used == 0 || (int32_t)age < 0) {
+            return MP_OBJ_STOP_ITERATION;
+        }
+        if (age >= self->used) {
+            // the sector got recycled meanwhile, carry on with the oldest one left
+            it->seq = tslog_oldest_seq(self);
+            it->pos = 0;
+            continue;
+        }
+        if (age == 0 && it->pos >= self->head_pos) {
+            return MP_OBJ_STOP_ITERATION;
+        }
+        if (it->pos >= self->slots) {
+            it->seq++;
+            it->pos = 0;
+            continue;
+        }
+
+        uint32_t ts;
+        if (!tslog_read_record(self, tslog_seq_to_idx(self, it->seq), it->pos++, &ts) || ts < it->start) {
+            continue;
+        }
+        if (ts > it->end) {
+            return MP_OBJ_STOP_ITERATION;
+        }
+
+        mp_obj_t unpack = mp_load_attr(MP_OBJ_FROM_PTR(&mp_module_ustruct), MP_QSTR_unpack);
+        mp_obj_t tuple[2] = {
+            mp_obj_new_int_from_uint(ts),
+            mp_call_function_2(unpack, self->fmt, mp_obj_new_bytes(&self->slot[sizeof(uint32_t)], self->payload_size)),
+        };
+        return mp_obj_new_tuple(2, tuple);
+    }
+}
+
+/******************************************************************************/
+// Micro Python bindings; Log class
+
+/// \class Log(schema, *, file=None, reset=False)
+/// an append-only log of timestamped records in the format of ustruct, which wraps around once
+/// full. Without a file it uses the flash set aside for it, otherwise the file must be stored in
+/// one piece on the internal flash (e.g. on FatFS), must not be opened while the log uses it and
+/// should span a few 4K sectors.
+STATIC mp_obj_t tslog_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *all_args) {
+    STATIC const mp_arg_t tslog_args[] = {
+        { MP_QSTR_schema,                       MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_file,                         MP_ARG_KW_ONLY  | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+        { MP_QSTR_reset,                        MP_ARG_KW_ONLY  | MP_ARG_BOOL, {.u_bool = false} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(tslog_args)];
+    mp_arg_parse_all_kw_array(n_args, n_kw, all_args, MP_ARRAY_SIZE(args), tslog_args, args);
+
+    size_t fmt_len;
+    const char *fmt = mp_obj_str_get_data(args[0].u_obj, &fmt_len);
+    mp_obj_t calcsize = mp_load_attr(MP_OBJ_FROM_PTR(&mp_module_ustruct), MP_QSTR_calcsize);
+    mp_int_t payload_size = mp_obj_get_int(mp_call_function_1(calcsize, args[0].u_obj));
+    uint32_t align = TSLOG_SLOT_ALIGN;
+    uint32_t slot_size = (payload_size + TSLOG_RECORD_OVERHEAD + align - 1) & ~(align - 1);
+    if (payload_size <= 0 || slot_size > TSLOG_SLOT_SIZE_MAX) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+
+    uint32_t addr, size;
+    if (args[1].u_obj == mp_const_none) {
+        if (esp32_get_chip_rev() > 0) {
+            addr = MICROPY_PORT_TSLOG_START_ADDR_8MB;
+            size = MICROPY_PORT_TSLOG_BLOCK_COUNT_8MB * TSLOG_SECTOR_SIZE;
+        } else {
+            addr = MICROPY_PORT_TSLOG_START_ADDR_4MB;
+            size = MICROPY_PORT_TSLOG_BLOCK_COUNT_4MB * TSLOG_SECTOR_SIZE;
+        }
+    } else {
+        uint32_t len;
+        moduos_flash_locate(mp_obj_str_get_str(args[1].u_obj), &addr, &len);
+        // only whole sectors, the partial ones at the edges may hold other files too
+        uint32_t end = (addr + len) & ~(TSLOG_SECTOR_SIZE - 1);
+        addr = (addr + TSLOG_SECTOR_SIZE - 1) & ~(TSLOG_SECTOR_SIZE - 1);
+        size = (end > addr) ? end - addr : 0;
+    }
+    // one sector gets erased when the log wraps, so at least two are needed
+    if (size < 2 * TSLOG_SECTOR_SIZE) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable));
+    }
+
+    tslog_obj_t *self = m_new_obj(tslog_obj_t);
+    self->base.type = &tslog_type;
+    self->fmt = args[0].u_obj;
+    self->addr = addr;
+    self->sectors = size / TSLOG_SECTOR_SIZE;
+    self->slot_size = slot_size;
+    self->payload_size = payload_size;
+    self->slots = (TSLOG_SECTOR_SIZE - sizeof(tslog_header_t)) / slot_size;
+    self->schema = crc16_le(UINT16_MAX, (const uint8_t *)fmt, fmt_len);
+    self->slot = m_new(uint8_t, slot_size);
+    tslog_mount(self, args[2].u_bool);
+
+    return MP_OBJ_FROM_PTR(self);
+}
+
+/// \method append(*values, ts=None)
+/// adds a record, the timestamp defaults to the RTC time in seconds. Timestamps are
+/// expected not to go backwards, range() relies on that.
+STATIC mp_obj_t tslog_append(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    tslog_obj_t *self = MP_OBJ_TO_PTR(pos_args[0]);
+
+    uint32_t ts;
+    mp_map_elem_t *ts_arg = mp_map_lookup(kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_ts), MP_MAP_LOOKUP);
+    if (ts_arg == NULL || ts_arg->value == mp_const_none) {
+        ts = mach_rtc_get_us_since_epoch() / 1000000;
+    } else {
+        ts = mp_obj_get_int_truncated(ts_arg->value);
+    }
+    if (ts == UINT32_MAX) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+
+    // pack before touching the flash, bad values must not leave a record behind
+    mp_obj_t *items = m_new(mp_obj_t, n_args);
+    items[0] = self->fmt;
+    memcpy(&items[1], &pos_args[1], (n_args - 1) * sizeof(mp_obj_t));
+    mp_obj_t pack = mp_load_attr(MP_OBJ_FROM_PTR(&mp_module_ustruct), MP_QSTR_pack);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(mp_call_function_n_kw(pack, n_args, 0, items), &bufinfo, MP_BUFFER_READ);
+    m_del(mp_obj_t, items, n_args);
+
+    if (self->head_pos >= self->slots) {
+        uint32_t next = (self->head + 1) % self->sectors;
+        if (self->used == self->sectors) {
+            // full, the oldest sector makes room
+            self->used--;
+        }
+        tslog_start_sector(self, next, self->head_seq + 1);
+        self->head = next;
+        self->head_seq++;
+        self->head_pos = 0;
+        self->used++;
+    }
+
+    memset(self->slot, 0xFF, self->slot_size);
+    memcpy(self->slot, &ts, sizeof(ts));
+    memcpy(&self->slot[sizeof(ts)], bufinfo.buf, self->payload_size);
+    uint16_t crc = crc16_le(UINT16_MAX, self->slot, sizeof(ts) + self->payload_size);
+    memcpy(&self->slot[sizeof(ts) + self->payload_size], &crc, sizeof(crc));
+    // the slot is taken even if the write fails half way
+    uint32_t pos = self->head_pos++;
+    tslog_flash_write(tslog_slot_addr(self, self->head, pos), self->slot, self->slot_size);
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(tslog_append_obj, 1, tslog_append);
+
+/// \method range(start=None, end=None)
+/// iterates over (ts, values) of the records with timestamps between start and end inclusive,
+/// records appended meanwhile are included
+STATIC mp_obj_t tslog_range(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t tslog_range_args[] = {
+        { MP_QSTR_start,                        MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_end,                          MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    };
+    tslog_obj_t *self = MP_OBJ_TO_PTR(pos_args[0]);
+    mp_arg_val_t args[MP_ARRAY_SIZE(tslog_range_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), tslog_range_args, args);
+
+    tslog_iter_t *it = m_new_obj(tslog_iter_t);
+    it->base.type = &mp_type_polymorph_iter;
+    it->iternext = tslog_iter_next;
+    it->log = self;
+    it->pos = 0;
+    it->start = (args[0].u_obj == mp_const_none) ? 0 : mp_obj_get_int_truncated(args[0].u_obj);
+    it->end = (args[1].u_obj == mp_const_none) ? UINT32_MAX : mp_obj_get_int_truncated(args[1].u_obj);
+    if (self->used == 0) {
+        it->seq = self->head_seq + 1;
+    } else if (it->start == 0) {
+        it->seq = tslog_oldest_seq(self);
+    } else {
+        it->seq = tslog_seek(self, it->start);
+    }
+
+    return MP_OBJ_FROM_PTR(it);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(tslog_range_obj, 1, tslog_range);
+
+/// \method stats()
+/// returns (records, sectors_used, sectors, first_ts, last_ts), the timestamps are None when empty
+STATIC mp_obj_t tslog_stats(mp_obj_t self_in) {
+    tslog_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    uint32_t first_ts, last_ts;
+    bool empty = self->used == 0 || !tslog_first_ts(self, tslog_oldest_seq(self), &first_ts) || !tslog_last_ts(self, &last_ts);
+
+    mp_obj_t tuple[5] = {
+        mp_obj_new_int_from_uint((self->used == 0) ? 0 : (self->used - 1) * self->slots + self->head_pos),
+        mp_obj_new_int_from_uint(self->used),
+        mp_obj_new_int_from_uint(self->sectors),
+        empty ? mp_const_none : mp_obj_new_int_from_uint(first_ts),
+        empty ? mp_const_none : mp_obj_new_int_from_uint(last_ts),
+    };
+    return mp_obj_new_tuple(5, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(tslog_stats_obj, tslog_stats);
+
+/// \method erase()
+/// drops all the records
+STATIC mp_obj_t tslog_erase(mp_obj_t self_in) {
+    tslog_obj_t *self = MP_OBJ_TO_PTR(self_in);
+    tslog_mount(self, true);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(tslog_erase_obj, tslog_erase);
+
+STATIC const mp_map_elem_t tslog_locals_dict_table[] = {
+    // instance methods
+    { MP_OBJ_NEW_QSTR(MP_QSTR_append),                  (mp_obj_t)&tslog_append_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_range),                   (mp_obj_t)&tslog_range_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_stats),                   (mp_obj_t)&tslog_stats_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_erase),                   (mp_obj_t)&tslog_erase_obj },
+};
+STATIC MP_DEFINE_CONST_DICT(tslog_locals_dict, tslog_locals_dict_table);
+
+STATIC const mp_obj_type_t tslog_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_Log,
+    .make_new = tslog_make_new,
+    .locals_dict = (mp_obj_t)&tslog_locals_dict,
+};
+
+STATIC const mp_map_elem_t mp_module_tslog_globals_table[] = {
+    { MP_OBJ_NEW_QSTR(MP_QSTR___name__),            MP_OBJ_NEW_QSTR(MP_QSTR_tslog) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_Log),                 (mp_obj_t)&tslog_type },
+};
+STATIC MP_DEFINE_CONST_DICT(mp_module_tslog_globals, mp_module_tslog_globals_table);
+
+const mp_obj_module_t mp_module_tslog = {
+    .base = { &mp_type_module },
+    .globals = (mp_obj_dict_t*)&mp_module_tslog_globals,
+};
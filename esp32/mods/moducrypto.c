@@ -17,9 +17,12 @@
 #include "hwcrypto/aes.h"
 #include "hwcrypto/sha.h"
 #include "mpexception.h"
+#include "random.h"
 #include "mbedtls/entropy.h"
 #include "mbedtls/pk.h"
 #include "mbedtls/ctr_drbg.h"
+#include "mbedtls/gcm.h"
+#include "mbedtls/ccm.h"
 
 /******************************************************************************
  DEFINE CONSTANTS
@@ -33,6 +36,8 @@ typedef enum {
     CRYPT_MODE_CBC = 2,
     CRYPT_MODE_CFB = 3,
     CRYPT_MODE_CTR = 6,
+    CRYPT_MODE_CCM = 8,
+    CRYPT_MODE_GCM = 11,
 } crypt_mode_t;
 
 typedef enum {
@@ -42,110 +47,253 @@ typedef enum {
 
 typedef struct _mp_obj_AES_t mp_obj_AES_t;
 
-typedef mp_obj_t(*crypt_func_t)(mp_obj_AES_t *, uint32_t, const unsigned char *, uint32_t);
+typedef void (*crypt_func_t)(mp_obj_AES_t *, uint32_t, const unsigned char *, unsigned char *, uint32_t);
 
 typedef struct _mp_obj_AES_t {
     mp_obj_base_t base;
-    esp_aes_context ctx;
+    union {
+        esp_aes_context ctx;
+        mbedtls_gcm_context gcm;    // used only in GCM
+        mbedtls_ccm_context ccm;    // used only in CCM
+    } c;
     crypt_segment_size_t segment_size;
     union {
         uint8_t IV[16];
         uint8_t counter[16]; // used only in CTR
+        uint8_t nonce[16];   // used only in GCM and CCM
     }u;
     uint8_t stream[16]; // used only in CTR
     uint32_t offset;
     crypt_func_t crypt_func;
+    crypt_mode_t mode;
+    uint8_t nonce_len;
+    uint8_t mac_len;
 } mp_obj_AES_t;
 
 /******************************************************************************
  DECLARE PRIVATE FUNCTIONS
  ******************************************************************************/
-STATIC mp_obj_t aes_do_ecb(mp_obj_AES_t *self, uint32_t operation, const unsigned char *input, uint32_t len);
-STATIC mp_obj_t aes_do_cbc(mp_obj_AES_t *self, uint32_t operation, const unsigned char *input, uint32_t len);
-STATIC mp_obj_t aes_do_cfb(mp_obj_AES_t *self, uint32_t operation, const unsigned char *input, uint32_t len);
-STATIC mp_obj_t aes_do_ctr(mp_obj_AES_t *self, uint32_t operation, const unsigned char *input, uint32_t len);
+STATIC void aes_do_ecb(mp_obj_AES_t *self, uint32_t operation, const unsigned char *input, unsigned char *output, uint32_t len);
+STATIC void aes_do_cbc(mp_obj_AES_t *self, uint32_t operation, const unsigned char *input, unsigned char *output, uint32_t len);
+STATIC void aes_do_cfb(mp_obj_AES_t *self, uint32_t operation, const unsigned char *input, unsigned char *output, uint32_t len);
+STATIC void aes_do_ctr(mp_obj_AES_t *self, uint32_t operation, const unsigned char *input, unsigned char *output, uint32_t len);
 
 /******************************************************************************
  DEFINE PRIVATE FUNCTIONS
  ******************************************************************************/
 
-STATIC mp_obj_t aes_do_ecb(mp_obj_AES_t *self, uint32_t operation, const unsigned char *input, uint32_t len) {
-    int i;
-    uint8_t *output = m_new(uint8_t, len);
-    uint8_t *tmp = output;
-
-    if ((len % 16) != 0) {
-        mp_raise_ValueError("Input strings must be a multiple of 16 in length");
-    }
+// all modes below support output == input; IV, counter and offset carry over
+// between calls so a message can be processed in pieces
 
-    for (i = len / 16; i > 0; i--) {
-        esp_aes_crypt_ecb(&self->ctx, operation, input, tmp);
+STATIC void aes_do_ecb(mp_obj_AES_t *self, uint32_t operation, const unsigned char *input, unsigned char *output, uint32_t len) {
+    for (uint32_t i = len / 16; i > 0; i--) {
+        esp_aes_crypt_ecb(&self->c.ctx, operation, input, output);
         input += 16;
-        tmp += 16;
+        output += 16;
     }
+}
 
-    return mp_obj_new_bytes(output, len);
+STATIC void aes_do_cbc(mp_obj_AES_t *self, uint32_t operation, const unsigned char *input, unsigned char *output, uint32_t len) {
+    esp_aes_crypt_cbc(&self->c.ctx, operation, len, self->u.IV, input, output);
 }
 
-STATIC mp_obj_t aes_do_cbc(mp_obj_AES_t *self, uint32_t operation, const unsigned char *input, uint32_t len) {
-    int result;
-    uint8_t *output = m_new(uint8_t, len);
+STATIC void aes_do_cfb(mp_obj_AES_t *self, uint32_t operation, const unsigned char *input, unsigned char *output, uint32_t len) {
+    if (self->segment_size == CRYPT_SEGMENT_128) {
+        esp_aes_crypt_cfb128(&self->c.ctx, operation, len, &self->offset, self->u.IV, input, output);
+    } else {
+        esp_aes_crypt_cfb8(&self->c.ctx, operation, len, self->u.IV, input, output);
+    }
+}
 
-    result = esp_aes_crypt_cbc(&self->ctx, operation, len, self->u.IV, input, output);
+STATIC void aes_do_ctr(mp_obj_AES_t *self, uint32_t operation, const unsigned char *input, unsigned char *output, uint32_t len) {
+    esp_aes_crypt_ctr(&self->c.ctx, len, &self->offset, self->u.counter, self->stream, input, output);
+}
 
-    if (result == ERR_ESP_AES_INVALID_INPUT_LENGTH) {
+STATIC void aes_check_input(mp_obj_AES_t *self, size_t len) {
+    if (self->crypt_func == NULL) {
+        mp_raise_TypeError("use encrypt_and_digest/decrypt_and_verify in AEAD modes");
+    }
+    if ((self->mode == CRYPT_MODE_ECB || self->mode == CRYPT_MODE_CBC) && (len % 16) != 0) {
         mp_raise_ValueError("Input strings must be a multiple of 16 in length");
     }
+}
 
-    return mp_obj_new_bytes(output, len);
+STATIC mp_obj_t aes_crypt(mp_obj_t self_in, mp_obj_t input, uint32_t operation) {
+    mp_obj_AES_t *self = self_in;
+    mp_buffer_info_t bufinfo;
+    vstr_t vstr;
+
+    mp_get_buffer_raise(input, &bufinfo, MP_BUFFER_READ);
+    aes_check_input(self, bufinfo.len);
+    // encrypt straight into the storage of the result
+    vstr_init_len(&vstr, bufinfo.len);
+    self->crypt_func(self, operation, bufinfo.buf, (unsigned char *)vstr.buf, bufinfo.len);
+    return mp_obj_new_str_from_vstr(&mp_type_bytes, &vstr);
 }
 
-STATIC mp_obj_t aes_do_cfb(mp_obj_AES_t *self, uint32_t operation, const unsigned char *input, uint32_t len) {
-    int result;
-    uint8_t *output = m_new(uint8_t, len);
+STATIC mp_obj_t aes_crypt_into(mp_obj_t self_in, mp_obj_t input, mp_obj_t output, uint32_t operation) {
+    mp_obj_AES_t *self = self_in;
+    mp_buffer_info_t in_bufinfo, out_bufinfo;
 
-    if (self->segment_size == CRYPT_SEGMENT_128) {
-        result = esp_aes_crypt_cfb128(&self->ctx, operation, len, &self->offset, self->u.IV, input, output);
-    } else {
-        result = esp_aes_crypt_cfb8(&self->ctx, operation, len, self->u.IV, input, output);
+    mp_get_buffer_raise(input, &in_bufinfo, MP_BUFFER_READ);
+    mp_get_buffer_raise(output, &out_bufinfo, MP_BUFFER_WRITE);
+    aes_check_input(self, in_bufinfo.len);
+    if (out_bufinfo.len < in_bufinfo.len) {
+        mp_raise_ValueError("output buffer too small");
     }
+    self->crypt_func(self, operation, in_bufinfo.buf, out_bufinfo.buf, in_bufinfo.len);
+    return MP_OBJ_NEW_SMALL_INT(in_bufinfo.len);
+}
 
-    if (result == ERR_ESP_AES_INVALID_INPUT_LENGTH) {
-        mp_raise_ValueError("Input strings must be a multiple of 16 in length");
-    }
+STATIC mp_obj_t AES_decrypt(mp_obj_t self_in, mp_obj_t ciphertext) {
+    return aes_crypt(self_in, ciphertext, ESP_AES_DECRYPT);
+}
+MP_DEFINE_CONST_FUN_OBJ_2(AES_decrypt_obj, AES_decrypt);
 
-    return mp_obj_new_bytes(output, len);
+STATIC mp_obj_t AES_encrypt(mp_obj_t self_in, mp_obj_t plaintext) {
+    return aes_crypt(self_in, plaintext, ESP_AES_ENCRYPT);
 }
+MP_DEFINE_CONST_FUN_OBJ_2(AES_encrypt_obj, AES_encrypt);
 
-STATIC mp_obj_t aes_do_ctr(mp_obj_AES_t *self, uint32_t operation, const unsigned char *input, uint32_t len) {
-    uint8_t *output = m_new(uint8_t, len);
+/// \method decrypt_into(ciphertext, buf)
+/// buf may be ciphertext itself; returns the number of bytes written
+STATIC mp_obj_t AES_decrypt_into(mp_obj_t self_in, mp_obj_t ciphertext, mp_obj_t buf) {
+    return aes_crypt_into(self_in, ciphertext, buf, ESP_AES_DECRYPT);
+}
+MP_DEFINE_CONST_FUN_OBJ_3(AES_decrypt_into_obj, AES_decrypt_into);
 
-    esp_aes_crypt_ctr(&self->ctx, len, &self->offset, self->u.counter, self->stream, input, output);
+/// \method encrypt_into(plaintext, buf)
+STATIC mp_obj_t AES_encrypt_into(mp_obj_t self_in, mp_obj_t plaintext, mp_obj_t buf) {
+    return aes_crypt_into(self_in, plaintext, buf, ESP_AES_ENCRYPT);
+}
+MP_DEFINE_CONST_FUN_OBJ_3(AES_encrypt_into_obj, AES_encrypt_into);
 
-    return mp_obj_new_bytes(output, len);
+// parses the (data, aad=None, nonce=None) arguments of the AEAD methods
+STATIC void aes_aead_args(mp_obj_AES_t *self, mp_obj_t aad_in, mp_obj_t nonce_in,
+                          mp_buffer_info_t *aad, const uint8_t **nonce, size_t *nonce_len) {
+    if (self->mode != CRYPT_MODE_GCM && self->mode != CRYPT_MODE_CCM) {
+        mp_raise_TypeError("only available in GCM and CCM modes");
+    }
+    aad->buf = NULL;
+    aad->len = 0;
+    if (aad_in != mp_const_none) {
+        mp_get_buffer_raise(aad_in, aad, MP_BUFFER_READ);
+    }
+    *nonce = self->u.nonce;
+    *nonce_len = self->nonce_len;
+    if (nonce_in != mp_const_none) {
+        mp_buffer_info_t bufinfo;
+        mp_get_buffer_raise(nonce_in, &bufinfo, MP_BUFFER_READ);
+        *nonce = bufinfo.buf;
+        *nonce_len = bufinfo.len;
+    }
+    if (*nonce_len == 0) {
+        mp_raise_ValueError("a nonce is required");
+    }
 }
 
-STATIC mp_obj_t AES_decrypt(mp_obj_t self_in, mp_obj_t ciphertext) {
-    mp_obj_AES_t *self = self_in;
-    mp_buffer_info_t bufinfo;
+/// \method encrypt_and_digest(plaintext, aad=None, nonce=None)
+/// returns (ciphertext, mac)
+STATIC mp_obj_t AES_encrypt_and_digest(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_plaintext,    MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_aad,          MP_ARG_OBJ,                   {.u_obj = mp_const_none} },
+        { MP_QSTR_nonce,        MP_ARG_OBJ,                   {.u_obj = mp_const_none} },
+    };
+    mp_obj_AES_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
 
-    mp_get_buffer_raise(ciphertext, &bufinfo, MP_BUFFER_READ);
-    return self->crypt_func(self, ESP_AES_DECRYPT, bufinfo.buf, bufinfo.len);
+    mp_buffer_info_t in, aad;
+    const uint8_t *nonce;
+    size_t nonce_len;
+    vstr_t out, mac;
+    int result;
+
+    mp_get_buffer_raise(args[0].u_obj, &in, MP_BUFFER_READ);
+    aes_aead_args(self, args[1].u_obj, args[2].u_obj, &aad, &nonce, &nonce_len);
+    vstr_init_len(&out, in.len);
+    vstr_init_len(&mac, self->mac_len);
+    if (self->mode == CRYPT_MODE_GCM) {
+        result = mbedtls_gcm_crypt_and_tag(&self->c.gcm, MBEDTLS_GCM_ENCRYPT, in.len, nonce, nonce_len,
+                                           aad.buf, aad.len, in.buf, (unsigned char *)out.buf,
+                                           self->mac_len, (unsigned char *)mac.buf);
+    } else {
+        result = mbedtls_ccm_encrypt_and_tag(&self->c.ccm, in.len, nonce, nonce_len, aad.buf, aad.len,
+                                             in.buf, (unsigned char *)out.buf, (unsigned char *)mac.buf, self->mac_len);
+    }
+    if (result != 0) {
+        mp_raise_ValueError("invalid nonce or MAC length");
+    }
+    mp_obj_t tuple[2] = {
+        mp_obj_new_str_from_vstr(&mp_type_bytes, &out),
+        mp_obj_new_str_from_vstr(&mp_type_bytes, &mac),
+    };
+    return mp_obj_new_tuple(2, tuple);
 }
-MP_DEFINE_CONST_FUN_OBJ_2(AES_decrypt_obj, AES_decrypt);
+MP_DEFINE_CONST_FUN_OBJ_KW(AES_encrypt_and_digest_obj, 2, AES_encrypt_and_digest);
 
-STATIC mp_obj_t AES_encrypt(mp_obj_t self_in, mp_obj_t plaintext) {
-    mp_obj_AES_t *self = self_in;
-    mp_buffer_info_t bufinfo;
+/// \method decrypt_and_verify(ciphertext, mac, aad=None, nonce=None)
+/// raises ValueError if the MAC doesn't match
+STATIC mp_obj_t AES_decrypt_and_verify(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_ciphertext,   MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_mac,          MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_aad,          MP_ARG_OBJ,                   {.u_obj = mp_const_none} },
+        { MP_QSTR_nonce,        MP_ARG_OBJ,                   {.u_obj = mp_const_none} },
+    };
+    mp_obj_AES_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
 
-    mp_get_buffer_raise(plaintext, &bufinfo, MP_BUFFER_READ);
-    return self->crypt_func(self, ESP_AES_ENCRYPT, bufinfo.buf, bufinfo.len);
+    mp_buffer_info_t in, mac, aad;
+    const uint8_t *nonce;
+    size_t nonce_len;
+    vstr_t out;
+    int result;
+
+    mp_get_buffer_raise(args[0].u_obj, &in, MP_BUFFER_READ);
+    mp_get_buffer_raise(args[1].u_obj, &mac, MP_BUFFER_READ);
+    aes_aead_args(self, args[2].u_obj, args[3].u_obj, &aad, &nonce, &nonce_len);
+    vstr_init_len(&out, in.len);
+    if (self->mode == CRYPT_MODE_GCM) {
+        result = mbedtls_gcm_auth_decrypt(&self->c.gcm, in.len, nonce, nonce_len, aad.buf, aad.len,
+                                          mac.buf, mac.len, in.buf, (unsigned char *)out.buf);
+    } else {
+        result = mbedtls_ccm_auth_decrypt(&self->c.ccm, in.len, nonce, nonce_len, aad.buf, aad.len,
+                                          in.buf, (unsigned char *)out.buf, mac.buf, mac.len);
+    }
+    if (result == MBEDTLS_ERR_GCM_AUTH_FAILED || result == MBEDTLS_ERR_CCM_AUTH_FAILED) {
+        vstr_clear(&out);
+        mp_raise_ValueError("MAC check failed");
+    } else if (result != 0) {
+        vstr_clear(&out);
+        mp_raise_ValueError("invalid nonce or MAC length");
+    }
+    return mp_obj_new_str_from_vstr(&mp_type_bytes, &out);
 }
-MP_DEFINE_CONST_FUN_OBJ_2(AES_encrypt_obj, AES_encrypt);
+MP_DEFINE_CONST_FUN_OBJ_KW(AES_decrypt_and_verify_obj, 3, AES_decrypt_and_verify);
+
+STATIC mp_obj_t AES_del(mp_obj_t self_in) {
+    mp_obj_AES_t *self = self_in;
+    if (self->mode == CRYPT_MODE_GCM) {
+        mbedtls_gcm_free(&self->c.gcm);
+    } else if (self->mode == CRYPT_MODE_CCM) {
+        mbedtls_ccm_free(&self->c.ccm);
+    }
+    self->mode = 0;
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_1(AES_del_obj, AES_del);
 
 STATIC const mp_map_elem_t AES_locals_dict_table[] = {
-    { MP_OBJ_NEW_QSTR(MP_QSTR_decrypt),    (mp_obj_t) &AES_decrypt_obj },
-    { MP_OBJ_NEW_QSTR(MP_QSTR_encrypt),    (mp_obj_t) &AES_encrypt_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_decrypt),             (mp_obj_t) &AES_decrypt_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_encrypt),             (mp_obj_t) &AES_encrypt_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_decrypt_into),        (mp_obj_t) &AES_decrypt_into_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_encrypt_into),        (mp_obj_t) &AES_encrypt_into_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_encrypt_and_digest),  (mp_obj_t) &AES_encrypt_and_digest_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_decrypt_and_verify),  (mp_obj_t) &AES_decrypt_and_verify_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR___del__),             (mp_obj_t) &AES_del_obj },
 };
 
 STATIC MP_DEFINE_CONST_DICT(AES_locals_dict, AES_locals_dict_table);
@@ -171,6 +319,7 @@ STATIC mp_obj_t AES_make_new(const mp_obj_type_t *type, mp_uint_t n_args, mp_uin
         { MP_QSTR_IV,           MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
         { MP_QSTR_counter,      MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
         { MP_QSTR_segment_size, MP_ARG_INT,                     {.u_int = -1} },
+        { MP_QSTR_mac_len,      MP_ARG_KW_ONLY | MP_ARG_INT,    {.u_int = 16} },
     };
 
     // parse arguments
@@ -179,12 +328,19 @@ STATIC mp_obj_t AES_make_new(const mp_obj_type_t *type, mp_uint_t n_args, mp_uin
     mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all(n_args, all_args, &kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
 
-    // and store them
-    mp_obj_AES_t *self = m_new_obj(mp_obj_AES_t);
+    // store the mode
+    crypt_mode_t mode;
+    mode = args[1].u_int;
+    bool aead = (mode == CRYPT_MODE_GCM || mode == CRYPT_MODE_CCM);
+
+    // and store them; the AEAD contexts hold memory that must be freed
+    mp_obj_AES_t *self = aead ? m_new_obj_with_finaliser(mp_obj_AES_t) : m_new_obj(mp_obj_AES_t);
     mp_buffer_info_t bufinfo;
 
     self->base.type = &AESCipher_type;
     self->offset = 0;
+    self->mode = 0;
+    self->crypt_func = NULL;
 
     // store the key
     mp_get_buffer_raise(args[0].u_obj, &bufinfo, MP_BUFFER_READ);
@@ -193,11 +349,23 @@ STATIC mp_obj_t AES_make_new(const mp_obj_type_t *type, mp_uint_t n_args, mp_uin
         mp_raise_ValueError("AES key must be either 16, 24, or 32 bytes long");
     }
 
-    esp_aes_setkey(&self->ctx, bufinfo.buf, bufinfo.len * 8);
-
-    // store the mode
-    crypt_mode_t mode;
-    mode = args[1].u_int;
+    // GCM and CCM run through mbedtls, which uses the AES hardware underneath
+    if (mode == CRYPT_MODE_GCM) {
+        mbedtls_gcm_init(&self->c.gcm);
+        if (mbedtls_gcm_setkey(&self->c.gcm, MBEDTLS_CIPHER_ID_AES, bufinfo.buf, bufinfo.len * 8) != 0) {
+            mbedtls_gcm_free(&self->c.gcm);
+            mp_raise_msg(&mp_type_MemoryError, NULL);
+        }
+    } else if (mode == CRYPT_MODE_CCM) {
+        mbedtls_ccm_init(&self->c.ccm);
+        if (mbedtls_ccm_setkey(&self->c.ccm, MBEDTLS_CIPHER_ID_AES, bufinfo.buf, bufinfo.len * 8) != 0) {
+            mbedtls_ccm_free(&self->c.ccm);
+            mp_raise_msg(&mp_type_MemoryError, NULL);
+        }
+    } else {
+        esp_aes_setkey(&self->c.ctx, bufinfo.buf, bufinfo.len * 8);
+    }
+    self->mode = mode;
 
     switch (mode) {
     case CRYPT_MODE_ECB:
@@ -216,14 +384,36 @@ STATIC mp_obj_t AES_make_new(const mp_obj_type_t *type, mp_uint_t n_args, mp_uin
         self->crypt_func = &aes_do_ctr;
         break;
 
+    case CRYPT_MODE_GCM:
+    case CRYPT_MODE_CCM:
+        break;
+
     default:
         nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError,
             "Unknown cipher feedback mode %d", mode));
         break;
     }
 
+    // in the AEAD modes the IV is the nonce, it can also be given per message
+    self->nonce_len = 0;
+    self->mac_len = args[5].u_int;
+    if (aead) {
+        if (self->mac_len < 4 || self->mac_len > 16 || (self->mac_len & 1)) {
+            mp_raise_ValueError("mac_len must be an even number between 4 and 16");
+        }
+        if (args[2].u_obj != mp_const_none) {
+            mp_get_buffer_raise(args[2].u_obj, &bufinfo, MP_BUFFER_READ);
+            if (bufinfo.len == 0 || bufinfo.len > sizeof(self->u.nonce)) {
+                mp_raise_ValueError("nonce must be 1 to 16 bytes long");
+            }
+            memcpy(self->u.nonce, bufinfo.buf, bufinfo.len);
+            self->nonce_len = bufinfo.len;
+        }
+    }
+
     // store the IV (ignored in ECB & CTR)
-    if (mode != CRYPT_MODE_ECB &&
+    if (!aead &&
+        mode != CRYPT_MODE_ECB &&
         mode != CRYPT_MODE_CTR &&
         args[2].u_obj != mp_const_none
     ) {
@@ -262,7 +452,7 @@ STATIC mp_obj_t AES_make_new(const mp_obj_type_t *type, mp_uint_t n_args, mp_uin
 }
 
 STATIC mp_obj_t getrandbits(mp_obj_t bits) {
-    uint32_t num_cycles, i;
+    uint32_t num_cycles;
     vstr_t vstr;
 
     num_cycles = mp_obj_get_int(bits);
@@ -270,9 +460,7 @@ STATIC mp_obj_t getrandbits(mp_obj_t bits) {
     num_cycles >>= 5;
 
     vstr_init_len(&vstr, num_cycles << 2); // going to get 32 bit integers (4 bytes)
-    for (i = 0; i < num_cycles; i++) {
-        *((uint32_t *) (vstr.buf + (i << 2))) = esp_random();
-    }
+    rng_fill(vstr.buf, vstr.len);
 
     return mp_obj_new_str_from_vstr(&mp_type_bytes, &vstr);
 }
@@ -479,6 +667,8 @@ STATIC const mp_map_elem_t mp_module_AES_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_MODE_CBC),            MP_OBJ_NEW_SMALL_INT(CRYPT_MODE_CBC) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_MODE_CFB),            MP_OBJ_NEW_SMALL_INT(CRYPT_MODE_CFB) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_MODE_CTR),            MP_OBJ_NEW_SMALL_INT(CRYPT_MODE_CTR) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_MODE_CCM),            MP_OBJ_NEW_SMALL_INT(CRYPT_MODE_CCM) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_MODE_GCM),            MP_OBJ_NEW_SMALL_INT(CRYPT_MODE_GCM) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_SEGMENT_8),           MP_OBJ_NEW_SMALL_INT(CRYPT_SEGMENT_8) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_SEGMENT_128),         MP_OBJ_NEW_SMALL_INT(CRYPT_SEGMENT_128) },
 };
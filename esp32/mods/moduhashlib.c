@@ -17,6 +17,8 @@
 #include "py/mpconfig.h"
 #include "py/nlr.h"
 #include "py/runtime.h"
+#include "py/stream.h"
+#include "extmod/vfs.h"
 #include "sha1_alt.h"
 #include "sha256_alt.h"
 #include "sha512_alt.h"
@@ -27,18 +29,22 @@
 #include "mbedtls/sha256.h"
 #include "mbedtls/sha512.h"
 
-STATIC bool hash_busy = false;
+// the *_alt implementations use the SHA accelerator when it is free and fall
+// back to software otherwise, so any number of hash objects can be active
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define HASH_FILE_CHUNK_SIZE                    (1024)
 
 /******************************************************************************
  DEFINE PRIVATE TYPES
  ******************************************************************************/
 typedef struct _mp_obj_hash_t {
     mp_obj_base_t base;
-    uint8_t  b_size;
     uint8_t  h_size;
-    uint8_t  buf_count;
     bool  digested;
-    uint8_t buffer[128];
+    uint8_t digest[64];
     union {
         struct MD5Context md5_context;
         mbedtls_sha1_context sha1_context;
@@ -51,15 +57,15 @@ typedef struct _mp_obj_hash_t {
 /******************************************************************************
  DECLARE PRIVATE FUNCTIONS
  ******************************************************************************/
-STATIC void hash_update_internal(mp_obj_t self_in, mp_obj_t data, bool digest);
+STATIC void hash_update_internal(mp_obj_hash_t *self, const void *data, size_t len);
 STATIC mp_obj_t hash_read (mp_obj_t self_in);
 
 /******************************************************************************
  DEFINE PRIVATE FUNCTIONS
  ******************************************************************************/
 
-
-STATIC void generic_hash_update(mp_obj_hash_t *self, void *data, uint32_t len) {
+// the contexts buffer partial blocks themselves, so data is hashed in place
+STATIC void hash_update_internal(mp_obj_hash_t *self, const void *data, size_t len) {
     switch (self->base.type->name) {
     case MP_QSTR_sha1:
         mbedtls_sha1_update_ret(&self->u.sha1_context, data, len);
@@ -81,95 +87,54 @@ STATIC void generic_hash_update(mp_obj_hash_t *self, void *data, uint32_t len) {
     }
 }
 
-STATIC void hash_update_internal(mp_obj_t self_in, mp_obj_t data, bool digest) {
-    mp_obj_hash_t *self = self_in;
-    mp_buffer_info_t bufinfo;
-    uint32_t len;
-
-    if (digest == true) {
-        generic_hash_update(self, self->buffer, self->buf_count);
-        return;
-    }
-
-    if (!data) {
-        return;
-    }
-
-    mp_get_buffer_raise(data, &bufinfo, MP_BUFFER_READ);
-
-    // Try to fill the buffer to the top
-    len = self->b_size - self->buf_count;
-    len = MIN(len, bufinfo.len);
-
-    memcpy(self->buffer + self->buf_count, bufinfo.buf, len);
-
-    self->buf_count += len;
-
-    // check if there is a complete block
-    if (self->buf_count != self->b_size && digest == false) {
-        return;
-    }
-
-    // process it
-    generic_hash_update(self, self->buffer, self->buf_count);
-    self->buf_count = 0;
-
-    // update the input string information
-    bufinfo.buf = ((uint8_t *) bufinfo.buf) + len;
-    bufinfo.len -= len;
+// releases the context, and with it the SHA engine if this object had it
+STATIC void hash_free(mp_obj_hash_t *self) {
+    switch (self->base.type->name) {
+    case MP_QSTR_sha1:
+        mbedtls_sha1_free(&self->u.sha1_context);
+        break;
 
-    // see if there is at least another complete block
-    len = bufinfo.len / self->b_size;
-    if (len != 0) {
-        // process it (them)
-        len *= self->b_size;
-        generic_hash_update(self, bufinfo.buf, len);
+    case MP_QSTR_sha224:
+    case MP_QSTR_sha256:
+        mbedtls_sha256_free(&self->u.sha256_context);
+        break;
 
-        // update the input string information
-        bufinfo.buf = ((uint8_t *) bufinfo.buf) + len;
-        bufinfo.len -= len;
+    case MP_QSTR_sha384:
+    case MP_QSTR_sha512:
+        mbedtls_sha512_free(&self->u.sha512_context);
+        break;
     }
-
-    // and copy any remaining bytes to the buffer
-    memcpy(self->buffer, bufinfo.buf, bufinfo.len);
-    self->buf_count = bufinfo.len;
+    self->digested = true;
 }
 
 STATIC mp_obj_t hash_read(mp_obj_t self_in) {
     mp_obj_hash_t *self = self_in;
 
     if (!self->digested) {
-        // process any remaining data in the buffer
-        hash_update_internal(self, MP_OBJ_NULL, true);
-
         switch (self->base.type->name) {
         case MP_QSTR_sha1:
-            mbedtls_sha1_finish_ret(&self->u.sha1_context, (uint8_t *)self->buffer);
-            mbedtls_sha1_free(&self->u.sha1_context);
+            mbedtls_sha1_finish_ret(&self->u.sha1_context, self->digest);
             break;
 
         case MP_QSTR_sha224:
         case MP_QSTR_sha256:
-            mbedtls_sha256_finish_ret(&self->u.sha256_context, (uint8_t *)self->buffer);
-            mbedtls_sha256_free(&self->u.sha256_context);
+            mbedtls_sha256_finish_ret(&self->u.sha256_context, self->digest);
             break;
 
         case MP_QSTR_sha384:
         case MP_QSTR_sha512:
-            mbedtls_sha512_finish_ret(&self->u.sha512_context, (uint8_t *)self->buffer);
-            mbedtls_sha512_free(&self->u.sha512_context);
+            mbedtls_sha512_finish_ret(&self->u.sha512_context, self->digest);
             break;
 
         case MP_QSTR_md5:
-            MD5Final((uint8_t *)self->buffer, &self->u.md5_context);
+            MD5Final(self->digest, &self->u.md5_context);
             break;
         }
 
-        self->digested = true;
-        hash_busy = false;
+        hash_free(self);
     }
 
-    return mp_obj_new_bytes(self->buffer, self->h_size);
+    return mp_obj_new_bytes(self->digest, self->h_size);
 }
 
 /******************************************************************************/
@@ -180,14 +145,8 @@ STATIC mp_obj_t hash_read(mp_obj_t self_in) {
 STATIC mp_obj_t hash_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
     mp_arg_check_num(n_args, n_kw, 0, 1, false);
 
-
-    if (hash_busy == true) {
-        mp_raise_msg(&mp_type_OSError, "only one active hash operation is permitted at a time");
-    }
-
-    hash_busy = true;
-
-    mp_obj_hash_t *self = m_new_obj(mp_obj_hash_t);
+    // a finaliser makes sure the SHA engine is released by abandoned objects
+    mp_obj_hash_t *self = m_new_obj_with_finaliser(mp_obj_hash_t);
 
     memset(self, 0, sizeof(mp_obj_hash_t));
 
@@ -197,48 +156,44 @@ STATIC mp_obj_t hash_make_new(const mp_obj_type_t *type, size_t n_args, size_t n
     switch (self->base.type->name) {
     case MP_QSTR_sha1:
         self->h_size = 20;
-        self->b_size = 64;
         mbedtls_sha1_init(&self->u.sha1_context);
         mbedtls_sha1_starts_ret(&self->u.sha1_context);
         break;
 
     case MP_QSTR_sha224:
         self->h_size = 28;
-        self->b_size = 64;
         mbedtls_sha256_init(&self->u.sha256_context);
         mbedtls_sha256_starts_ret(&self->u.sha256_context, 1);
         break;
 
     case MP_QSTR_sha256:
         self->h_size = 32;
-        self->b_size = 64;
         mbedtls_sha256_init(&self->u.sha256_context);
         mbedtls_sha256_starts_ret(&self->u.sha256_context, 0);
         break;
 
     case MP_QSTR_sha384:
         self->h_size = 48;
-        self->b_size = 128;
         mbedtls_sha512_init(&self->u.sha512_context);
         mbedtls_sha512_starts_ret(&self->u.sha512_context, 1);
         break;
 
     case MP_QSTR_sha512:
         self->h_size = 64;
-        self->b_size = 128;
         mbedtls_sha512_init(&self->u.sha512_context);
         mbedtls_sha512_starts_ret(&self->u.sha512_context, 0);
         break;
 
     case MP_QSTR_md5:
         self->h_size = 16;
-        self->b_size = 64;
         MD5Init(&self->u.md5_context);
         break;
     }
 
     if (n_args) {
-        hash_update_internal(self, args[0], false);
+        mp_buffer_info_t bufinfo;
+        mp_get_buffer_raise(args[0], &bufinfo, MP_BUFFER_READ);
+        hash_update_internal(self, bufinfo.buf, bufinfo.len);
     }
 
     return self;
@@ -247,7 +202,10 @@ STATIC mp_obj_t hash_make_new(const mp_obj_type_t *type, size_t n_args, size_t n
 STATIC mp_obj_t hash_update(mp_obj_t self_in, mp_obj_t arg) {
     mp_obj_hash_t *self = self_in;
     if (self->digested == false) {
-        hash_update_internal(self, arg, false);
+        // any buffer works, a memoryview slice is hashed without a copy
+        mp_buffer_info_t bufinfo;
+        mp_get_buffer_raise(arg, &bufinfo, MP_BUFFER_READ);
+        hash_update_internal(self, bufinfo.buf, bufinfo.len);
     }
     return mp_const_none;
 }
@@ -258,9 +216,19 @@ STATIC mp_obj_t hash_digest(mp_obj_t self_in) {
 }
 MP_DEFINE_CONST_FUN_OBJ_1(hash_digest_obj, hash_digest);
 
+STATIC mp_obj_t hash_del(mp_obj_t self_in) {
+    mp_obj_hash_t *self = self_in;
+    if (!self->digested) {
+        hash_free(self);
+    }
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_1(hash_del_obj, hash_del);
+
 STATIC const mp_map_elem_t hash_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_update),    (mp_obj_t) &hash_update_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_digest),    (mp_obj_t) &hash_digest_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR___del__),   (mp_obj_t) &hash_del_obj },
 };
 
 STATIC MP_DEFINE_CONST_DICT(hash_locals_dict, hash_locals_dict_table);
@@ -307,6 +275,40 @@ STATIC const mp_obj_type_t sha512_type = {
    .locals_dict = (mp_obj_t)&hash_locals_dict,
 };
 
+/// \function file_digest(path, algorithm=sha256)
+/// hashes a whole file in C and returns the digest
+STATIC mp_obj_t hash_file_digest(size_t n_args, const mp_obj_t *args) {
+    const mp_obj_type_t *type = &sha256_type;
+    if (n_args > 1) {
+        type = MP_OBJ_TO_PTR(args[1]);
+        if (!MP_OBJ_IS_TYPE(args[1], &mp_type_type) || type->make_new != hash_make_new) {
+            mp_raise_TypeError("algorithm must be one of the uhashlib types");
+        }
+    }
+
+    mp_obj_t open_args[2] = { args[0], MP_OBJ_NEW_QSTR(MP_QSTR_rb) };
+    mp_obj_t file = mp_vfs_open(2, open_args, (mp_map_t*)&mp_const_empty_map);
+    mp_obj_hash_t *self = hash_make_new(type, 0, 0, NULL);
+    uint8_t *chunk = m_new(uint8_t, HASH_FILE_CHUNK_SIZE);
+    int errcode = 0;
+
+    for (;;) {
+        mp_uint_t len = mp_stream_rw(file, chunk, HASH_FILE_CHUNK_SIZE, &errcode, MP_STREAM_RW_READ | MP_STREAM_RW_ONCE);
+        if (errcode != 0 || len == 0) {
+            break;
+        }
+        hash_update_internal(self, chunk, len);
+    }
+    m_del(uint8_t, chunk, HASH_FILE_CHUNK_SIZE);
+    mp_stream_close(file);
+    if (errcode != 0) {
+        hash_free(self);
+        mp_raise_OSError(errcode);
+    }
+    return hash_read(self);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(hash_file_digest_obj, 1, 2, hash_file_digest);
+
 STATIC const mp_map_elem_t mp_module_hashlib_globals_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR___name__),    MP_OBJ_NEW_QSTR(MP_QSTR_uhashlib) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_md5),         (mp_obj_t)&md5_type },
@@ -315,6 +317,7 @@ STATIC const mp_map_elem_t mp_module_hashlib_globals_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_sha256),      (mp_obj_t)&sha256_type },
     { MP_OBJ_NEW_QSTR(MP_QSTR_sha384),      (mp_obj_t)&sha384_type },
     { MP_OBJ_NEW_QSTR(MP_QSTR_sha512),      (mp_obj_t)&sha512_type },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_file_digest), (mp_obj_t)&hash_file_digest_obj },
 };
 
 STATIC MP_DEFINE_CONST_DICT(mp_module_hashlib_globals, mp_module_hashlib_globals_table);
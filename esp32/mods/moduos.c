@@ -59,6 +59,9 @@
 #include "machuart.h"
 #include "pycom_version.h"
 #include "mptask.h"
+#include "py/mperrno.h"
+
+#include "esp_spi_flash.h"
 
 /// \module os - basic "operating system" services
 ///
@@ -159,13 +162,183 @@ STATIC mp_obj_t os_sync(void) {
 }
 MP_DEFINE_CONST_FUN_OBJ_0(mod_os_sync_obj, os_sync);
 
+typedef struct {
+    mp_obj_base_t base;
+    const uint8_t *data;
+    size_t len;
+    spi_flash_mmap_handle_t handle;
+    bool mapped;
+} os_flash_map_obj_t;
+
+STATIC const mp_obj_type_t os_flash_map_type;
+
+// finds where a file lives in flash, only files stored in one piece can be mapped
+STATIC void os_mmap_locate(mp_vfs_mount_t *vfs, const char *path, uint32_t *addr, uint32_t *len) {
+    fs_user_mount_t *mount = MP_OBJ_TO_PTR(vfs->obj);
+
+    if (mp_obj_get_type(vfs->obj) == &mp_littlefs_vfs_type) {
+        lfs_file_t fp;
+        struct lfs_file_config cfg;
+        bool timestamp_update = false;
+        int res;
+
+        LITTLEFS_IO_LOCK(&mount->fs.littlefs);
+            const char *lfs_path = concat_with_cwd(&mount->fs.littlefs, path);
+            if (lfs_path == NULL) {
+                res = LFS_ERR_NOMEM;
+            } else {
+                res = littlefs_open_common_helper(&mount->fs.littlefs.lfs, lfs_path, &fp, LFS_O_RDONLY, &cfg, &timestamp_update);
+            }
+            if (res == LFS_ERR_OK) {
+                // inline files live in the metadata and bigger ones have skip-list pointers in every block but the first
+                if ((fp.flags & LFS_F_INLINE) || fp.ctz.size == 0 || fp.ctz.size > mount->fs.littlefs.lfs.cfg->block_size) {
+                    res = LFS_ERR_INVAL;
+                } else {
+                    *addr = sflash_get_start_address() + fp.ctz.head * mount->fs.littlefs.lfs.cfg->block_size;
+                    *len = fp.ctz.size;
+                }
+                littlefs_close_common_helper(&mount->fs.littlefs.lfs, &fp, &cfg, &timestamp_update);
+            }
+        LITTLEFS_IO_UNLOCK(&mount->fs.littlefs);
+        free((void *)lfs_path);
+
+        if (res < LFS_ERR_OK) {
+            mp_raise_OSError(littleFsErrorToErrno(res));
+        }
+    } else if (mp_obj_get_type(vfs->obj) == &mp_fat_vfs_type && mount->readblocks[2] == (mp_obj_t)sflash_disk_read) {
+        FATFS *fs = &mount->fs.fatfs;
+        FIL fp;
+        if (f_open(fs, &fp, path, FA_READ) != FR_OK) {
+            mp_raise_OSError(MP_ENOENT);
+        }
+        FSIZE_t size = f_size(&fp);
+        DWORD sclust = fp.obj.sclust;
+        DWORD clust_bytes = fs->csize * SFLASH_FS_SECTOR_SIZE;
+        bool contiguous = size > 0;
+        for (FSIZE_t off = clust_bytes; contiguous && off < size; off += clust_bytes) {
+            // seeking one byte into the next cluster makes FatFS follow the chain to it
+            if (f_lseek(&fp, off + 1) != FR_OK || fp.clust != sclust + (off / clust_bytes)) {
+                contiguous = false;
+            }
+        }
+        f_close(&fp);
+        if (!contiguous) {
+            mp_raise_OSError(MP_EINVAL);
+        }
+        // the sectors of the internal flash are laid out linearly, make sure the cached ones got there
+        if (sflash_disk_flush() != RES_OK) {
+            mp_raise_OSError(MP_EIO);
+        }
+        *addr = sflash_get_start_address() + (fs->database + fs->csize * (sclust - 2)) * SFLASH_FS_SECTOR_SIZE;
+        *len = size;
+    } else {
+        mp_raise_OSError(MP_ENODEV);
+    }
+}
+
+// finds the flash range holding the file with the given absolute path,
+// raises unless the file is stored in one piece on the internal flash
+void moduos_flash_locate (const char *path, uint32_t *addr, uint32_t *len) {
+    const char *path_out;
+    mp_vfs_mount_t *vfs = mp_vfs_lookup_path(path, &path_out);
+    if (vfs == MP_VFS_NONE || vfs == MP_VFS_ROOT) {
+        mp_raise_OSError(MP_ENOENT);
+    }
+    os_mmap_locate(vfs, path_out, addr, len);
+}
+
+/// \function mmap(path)
+/// maps a file read-only through the flash cache, it can be used wherever a buffer is accepted
+/// without copying it to the heap. The file must not be changed while it's mapped.
+STATIC mp_obj_t os_mmap(mp_obj_t path_in) {
+    uint32_t addr, len;
+    moduos_flash_locate(mp_obj_str_get_str(path_in), &addr, &len);
+
+    os_flash_map_obj_t *self = m_new_obj_with_finaliser(os_flash_map_obj_t);
+    self->base.type = &os_flash_map_type;
+    self->mapped = false;
+
+    // mappings start on an MMU page
+    uint32_t page = addr & ~(SPI_FLASH_MMU_PAGE_SIZE - 1);
+    const void *ptr;
+    if (spi_flash_mmap(page, len + (addr - page), SPI_FLASH_MMAP_DATA, &ptr, &self->handle) != ESP_OK) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable));
+    }
+    self->data = (const uint8_t *)ptr + (addr - page);
+    self->len = len;
+    self->mapped = true;
+    return self;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(os_mmap_obj, os_mmap);
+
+STATIC mp_obj_t os_flash_map_close(mp_obj_t self_in) {
+    os_flash_map_obj_t *self = self_in;
+    if (self->mapped) {
+        spi_flash_munmap(self->handle);
+        self->mapped = false;
+        self->len = 0;
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(os_flash_map_close_obj, os_flash_map_close);
+
+STATIC mp_obj_t os_flash_map___exit__(size_t n_args, const mp_obj_t *args) {
+    return os_flash_map_close(args[0]);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(os_flash_map___exit___obj, 4, 4, os_flash_map___exit__);
+
+STATIC mp_int_t os_flash_map_get_buffer(mp_obj_t self_in, mp_buffer_info_t *bufinfo, mp_uint_t flags) {
+    os_flash_map_obj_t *self = self_in;
+    if (!self->mapped || (flags & MP_BUFFER_WRITE)) {
+        return 1;
+    }
+    bufinfo->buf = (void *)self->data;
+    bufinfo->len = self->len;
+    bufinfo->typecode = 'B';
+    return 0;
+}
+
+STATIC mp_obj_t os_flash_map_unary_op(mp_unary_op_t op, mp_obj_t self_in) {
+    os_flash_map_obj_t *self = self_in;
+    switch (op) {
+        case MP_UNARY_OP_LEN: return MP_OBJ_NEW_SMALL_INT(self->len);
+        default: return MP_OBJ_NULL; // op not supported
+    }
+}
+
+STATIC const mp_rom_map_elem_t os_flash_map_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_close),           MP_ROM_PTR(&os_flash_map_close_obj) },
+    { MP_ROM_QSTR(MP_QSTR___del__),         MP_ROM_PTR(&os_flash_map_close_obj) },
+    { MP_ROM_QSTR(MP_QSTR___enter__),       MP_ROM_PTR(&mp_identity_obj) },
+    { MP_ROM_QSTR(MP_QSTR___exit__),        MP_ROM_PTR(&os_flash_map___exit___obj) },
+};
+STATIC MP_DEFINE_CONST_DICT(os_flash_map_locals_dict, os_flash_map_locals_dict_table);
+
+STATIC const mp_obj_type_t os_flash_map_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_FlashMap,
+    .unary_op = os_flash_map_unary_op,
+    .buffer_p = { .get_buffer = os_flash_map_get_buffer },
+    .locals_dict = (mp_obj_dict_t *)&os_flash_map_locals_dict,
+};
+
+STATIC mp_obj_t os_fscache_stats(void) {
+    sflash_cache_stats_t stats;
+    sflash_disk_get_cache_stats(&stats);
+    mp_obj_t tuple[4];
+    tuple[0] = mp_obj_new_int_from_uint(stats.blocks);
+    tuple[1] = mp_obj_new_int_from_uint(stats.hits);
+    tuple[2] = mp_obj_new_int_from_uint(stats.misses);
+    tuple[3] = mp_obj_new_int_from_uint(stats.erases);
+    return mp_obj_new_tuple(4, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(os_fscache_stats_obj, os_fscache_stats);
+
 STATIC mp_obj_t os_urandom(mp_obj_t num) {
     mp_int_t n = mp_obj_get_int(num);
     vstr_t vstr;
     vstr_init_len(&vstr, n);
-    for (int i = 0; i < n; i++) {
-        vstr.buf[i] = rng_get();
-    }
+    rng_fill(vstr.buf, n);
     return mp_obj_new_str_from_vstr(&mp_type_bytes, &vstr);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(os_urandom_obj, os_urandom);
@@ -214,6 +387,8 @@ STATIC const mp_rom_map_elem_t os_module_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR_unlink),          MP_ROM_PTR(&mp_vfs_remove_obj) },
 
     { MP_ROM_QSTR(MP_QSTR_sync),            MP_ROM_PTR(&mod_os_sync_obj) },
+    { MP_ROM_QSTR(MP_QSTR_fscache_stats),   MP_ROM_PTR(&os_fscache_stats_obj) },
+    { MP_ROM_QSTR(MP_QSTR_mmap),            MP_ROM_PTR(&os_mmap_obj) },
     { MP_ROM_QSTR(MP_QSTR_urandom),         MP_ROM_PTR(&os_urandom_obj) },
 
     // MicroPython additions
@@ -67,5 +67,6 @@ typedef struct _os_term_dup_obj_t {
  ******************************************************************************/
 os_fs_mount_t *osmount_find_by_path (const char *path);
 os_fs_mount_t *osmount_find_by_volume (uint8_t vol);
+void moduos_flash_locate (const char *path, uint32_t *addr, uint32_t *len);
 
 #endif // MODUOS_H_
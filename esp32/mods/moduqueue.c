@@ -7,6 +7,8 @@
  * available at https://www.pycom.io/opensource/licensing
  */
 
+#include <string.h>
+
 #include "py/mpconfig.h"
 #include "py/obj.h"
 #include "py/objstr.h"
@@ -22,6 +24,17 @@
  DECLARE PRIVATE DATA
  ******************************************************************************/
 STATIC const mp_obj_type_t mp_queue_type;
+STATIC const mp_obj_type_t mp_ringbuf_type;
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+STATIC TickType_t uqueue_timeout_ticks(mp_obj_t timeout) {
+    if (timeout == mp_const_none) {
+        return portMAX_DELAY;
+    }
+    return (TickType_t)(mp_obj_get_int_truncated(timeout) / portTICK_PERIOD_MS);
+}
 
 /******************************************************************************/
 // Micro Python bindings; Queue class
@@ -58,9 +71,45 @@ STATIC mp_obj_t mod_uqueue_queue(mp_uint_t n_args, const mp_obj_t *pos_args, mp_
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_uqueue_queue_obj, 0, mod_uqueue_queue);
 
+STATIC mp_obj_t mod_uqueue_ringbuffer(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_nbytes,       MP_ARG_REQUIRED | MP_ARG_INT, },
+        { MP_QSTR_record_size,                    MP_ARG_INT, {.u_int = 0} },
+    };
+
+    // parse arguments
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    if (args[0].u_int <= 0 || args[1].u_int < 0 || args[1].u_int > args[0].u_int) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+
+    mp_obj_ringbuf_t *rb = m_new_obj_with_finaliser(mp_obj_ringbuf_t);
+    rb->base.type = &mp_ringbuf_type;
+    // the ring buffer works in 32-bit words
+    rb->size = (args[0].u_int + 3) & ~3;
+    rb->record_size = args[1].u_int;
+    // byte streams can be read in any amount, records always come out whole
+    rb->handle = xRingbufferCreate(rb->size, rb->record_size ? RINGBUF_TYPE_NOSPLIT : RINGBUF_TYPE_BYTEBUF);
+    if (NULL == rb->handle) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_MemoryError, "no memory available to create the ring buffer"));
+    }
+    // each record also carries a small header, so make sure one fits
+    if (rb->record_size > xRingbufferGetMaxItemSize(rb->handle)) {
+        vRingbufferDelete(rb->handle);
+        rb->handle = NULL;
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+
+    return rb;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_uqueue_ringbuffer_obj, 1, mod_uqueue_ringbuffer);
+
 STATIC const mp_map_elem_t mp_module_uqueue_globals_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR___name__),            MP_OBJ_NEW_QSTR(MP_QSTR_queue) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_Queue),               (mp_obj_t)&mod_uqueue_queue_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_RingBuffer),          (mp_obj_t)&mod_uqueue_ringbuffer_obj },
 };
 
 STATIC MP_DEFINE_CONST_DICT(mp_module_uqueue_globals, mp_module_uqueue_globals_table);
@@ -165,3 +214,151 @@ STATIC const mp_obj_type_t mp_queue_type = {
     .name = MP_QSTR_Queue,
     .locals_dict = (mp_obj_t)&queue_locals_dict,
 };
+
+/******************************************************************************/
+// Micro Python bindings; RingBuffer class
+
+STATIC mp_obj_t mp_ringbuf_delete(mp_obj_t self_in) {
+    mp_obj_ringbuf_t *self = self_in;
+    if (self->handle) {
+        vRingbufferDelete(self->handle);
+        self->handle = NULL;
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_ringbuf_delete_obj, mp_ringbuf_delete);
+
+STATIC mp_obj_t mp_ringbuf_write(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_buf,        MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_timeout,                      MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+    };
+
+    // parse args
+    mp_obj_ringbuf_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[0].u_obj, &bufinfo, MP_BUFFER_READ);
+    // a byte stream is written in one go, records are written one at a time
+    size_t chunk = self->record_size ? self->record_size : bufinfo.len;
+    if ((!self->record_size && bufinfo.len > self->size) || (self->record_size && bufinfo.len % chunk != 0)) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+
+    TickType_t ticks = uqueue_timeout_ticks(args[1].u_obj);
+    bool sent = true;
+    MP_THREAD_GIL_EXIT();
+    for (size_t off = 0; off < bufinfo.len && sent; off += chunk) {
+        sent = xRingbufferSend(self->handle, (uint8_t *)bufinfo.buf + off, chunk, ticks) == pdTRUE;
+    }
+    MP_THREAD_GIL_ENTER();
+    if (!sent) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Full"));
+    }
+
+    return mp_obj_new_int(bufinfo.len);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mp_ringbuf_write_obj, 1, mp_ringbuf_write);
+
+// receives up to len bytes (or one record) into buf, returns the number of bytes
+STATIC size_t ringbuf_receive(mp_obj_ringbuf_t *self, uint8_t *buf, size_t len, TickType_t ticks) {
+    size_t got = 0;
+    MP_THREAD_GIL_EXIT();
+    if (self->record_size) {
+        size_t size;
+        uint8_t *item = xRingbufferReceive(self->handle, &size, ticks);
+        if (item) {
+            got = MIN(size, len);
+            memcpy(buf, item, got);
+            vRingbufferReturnItem(self->handle, item);
+        }
+    } else {
+        // data that wraps around the end of the buffer comes back in two pieces
+        for (int i = 0; i < 2 && got < len; i++) {
+            size_t size;
+            uint8_t *item = xRingbufferReceiveUpTo(self->handle, &size, i == 0 ? ticks : 0, len - got);
+            if (item == NULL) {
+                break;
+            }
+            memcpy(buf + got, item, size);
+            got += size;
+            vRingbufferReturnItem(self->handle, item);
+        }
+    }
+    MP_THREAD_GIL_ENTER();
+    if (got == 0) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Empty"));
+    }
+    return got;
+}
+
+STATIC mp_obj_t mp_ringbuf_readinto(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_buf,        MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_timeout,                      MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+    };
+
+    // parse args
+    mp_obj_ringbuf_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[0].u_obj, &bufinfo, MP_BUFFER_WRITE);
+    if (bufinfo.len == 0 || bufinfo.len < self->record_size) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+
+    return mp_obj_new_int(ringbuf_receive(self, bufinfo.buf, bufinfo.len, uqueue_timeout_ticks(args[1].u_obj)));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mp_ringbuf_readinto_obj, 1, mp_ringbuf_readinto);
+
+STATIC mp_obj_t mp_ringbuf_read(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_nbytes,                       MP_ARG_INT,  {.u_int = -1} },
+        { MP_QSTR_timeout,                      MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+    };
+
+    // parse args
+    mp_obj_ringbuf_t *self = pos_args[0];
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+
+    size_t len = self->record_size ? self->record_size : self->size;
+    if (args[0].u_int > 0 && (size_t)args[0].u_int < len) {
+        len = args[0].u_int;
+    }
+    vstr_t vstr;
+    vstr_init_len(&vstr, len);
+    vstr.len = ringbuf_receive(self, (uint8_t *)vstr.buf, len, uqueue_timeout_ticks(args[1].u_obj));
+    return mp_obj_new_str_from_vstr(&mp_type_bytes, &vstr);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mp_ringbuf_read_obj, 1, mp_ringbuf_read);
+
+STATIC mp_obj_t mp_ringbuf_free(mp_obj_t self_in) {
+    mp_obj_ringbuf_t *self = self_in;
+    return mp_obj_new_int(xRingbufferGetCurFreeSize(self->handle));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(mp_ringbuf_free_obj, mp_ringbuf_free);
+
+STATIC const mp_map_elem_t ringbuf_locals_dict_table[] = {
+    // instance methods
+    { MP_OBJ_NEW_QSTR(MP_QSTR___del__),                 (mp_obj_t)&mp_ringbuf_delete_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_write),                   (mp_obj_t)&mp_ringbuf_write_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_read),                    (mp_obj_t)&mp_ringbuf_read_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_readinto),                (mp_obj_t)&mp_ringbuf_readinto_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_free),                    (mp_obj_t)&mp_ringbuf_free_obj },
+
+    { MP_OBJ_NEW_QSTR(MP_QSTR_Full),                    (mp_obj_t)&mp_type_OSError },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_Empty),                   (mp_obj_t)&mp_type_OSError },
+};
+
+STATIC MP_DEFINE_CONST_DICT(ringbuf_locals_dict, ringbuf_locals_dict_table);
+
+STATIC const mp_obj_type_t mp_ringbuf_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_RingBuffer,
+    .locals_dict = (mp_obj_t)&ringbuf_locals_dict,
+};
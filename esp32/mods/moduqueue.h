@@ -10,9 +10,13 @@
 #ifndef MODUQUEUE_H_
 #define MODUQUEUE_H_
 
+#include <string.h>
+#include <sys/param.h>
+
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/ringbuf.h"
 
 /******************************************************************************
  DEFINE TYPES
@@ -25,4 +29,40 @@ typedef struct _mp_obj_queue_t {
     uint32_t maxsize;
 } mp_obj_queue_t;
 
+typedef struct _mp_obj_ringbuf_t {
+    mp_obj_base_t base;
+    RingbufHandle_t handle;
+    uint32_t size;
+    uint32_t record_size;   // 0 for a plain byte stream
+} mp_obj_ringbuf_t;
+
+/******************************************************************************
+ DECLARE PUBLIC FUNCTIONS
+ ******************************************************************************/
+// Let C producers (drivers, tasks, ISRs) feed a uqueue.RingBuffer directly.
+// The caller must keep a reference to the Python object while doing so.
+static inline bool uqueue_ringbuf_send(mp_obj_t rb, const void *data, size_t len, TickType_t ticks) {
+    return xRingbufferSend(((mp_obj_ringbuf_t *)rb)->handle, data, len, ticks) == pdTRUE;
+}
+
+static inline bool uqueue_ringbuf_send_from_isr(mp_obj_t rb, const void *data, size_t len, BaseType_t *woken) {
+    return xRingbufferSendFromISR(((mp_obj_ringbuf_t *)rb)->handle, data, len, woken) == pdTRUE;
+}
+
+// And let C consumers (such as a control loop task on the other core) take what the
+// script writes: one record, or up to len bytes of a byte stream. Returns the number
+// of bytes copied into buf, 0 if nothing arrived within ticks.
+static inline size_t uqueue_ringbuf_receive(mp_obj_t rb, void *buf, size_t len, TickType_t ticks) {
+    mp_obj_ringbuf_t *self = rb;
+    size_t size = 0;
+    uint8_t *item = self->record_size ? xRingbufferReceive(self->handle, &size, ticks)
+                                      : xRingbufferReceiveUpTo(self->handle, &size, ticks, len);
+    if (item) {
+        size = MIN(size, len);
+        memcpy(buf, item, size);
+        vRingbufferReturnItem(self->handle, item);
+    }
+    return size;
+}
+
 #endif /* MODUQUEUE_H_ */
@@ -38,6 +38,7 @@
 
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 
 #include "py/mpconfig.h"
 #include "py/obj.h"
@@ -50,10 +51,12 @@
 #include "modwlan.h"
 #include "modusocket.h"
 #include "mpexception.h"
+#include "pycom_config.h"
 
 #include "esp_heap_caps.h"
 #include "sdkconfig.h"
 #include "esp_system.h"
+#include "esp_attr.h"
 #include "esp_spi_flash.h"
 #include "nvs_flash.h"
 
@@ -61,12 +64,18 @@
 #include "lwip/dns.h"
 #include "lwip/netdb.h"
 #include "lwipsocket.h"
+#include "tracering.h"
+#ifdef MOD_WIZNET5K_ENABLED
+#include "modwiznet5k.h"
+#endif
+#if defined(FIPY) || defined(GPY)
+#include "modlteudp.h"
+#endif
 
 #include "mbedtls/ssl.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/timers.h"
 
 /******************************************************************************
  DEFINE PRIVATE CONSTANTS
@@ -74,6 +83,12 @@
 #define MODUSOCKET_MAX_SOCKETS                      15
 #define MODUSOCKET_CONN_TIMEOUT                     -2
 #define MODUSOCKET_MAX_DNS_SERV                      2
+
+#define MODUSOCKET_DNS_CACHE_MAX                    (8)
+#define MODUSOCKET_DNS_NAME_MAX                     (64)
+#define MODUSOCKET_DNS_CACHE_MAGIC                  (0x444E5343)    // "DNSC"
+#define MODUSOCKET_DNS_TTL_DEFAULT                  (300)           // seconds
+#define MODUSOCKET_DNS_NEG_TTL_DEFAULT              (10)            // seconds
 /******************************************************************************
  DEFINE PRIVATE TYPES
  ******************************************************************************/
@@ -82,6 +97,27 @@ typedef struct {
     bool    user;
 } modusocket_sock_t;
 
+// getaddrinfo() doesn't report the record TTL, so the entries live for the configured one
+typedef struct {
+    char name[MODUSOCKET_DNS_NAME_MAX];
+    uint32_t addr;                          // network order, 0 for a failed lookup
+    int32_t error;                          // what getaddrinfo() returned for a failed lookup
+    uint32_t stored;                        // time() of the lookup
+    uint32_t ttl;
+} modusocket_dns_entry_t;
+
+// lives in RTC memory, a wake from deep sleep finds the names still resolved
+typedef struct {
+    uint32_t magic;
+    uint32_t size;
+    uint32_t ttl;
+    uint32_t neg_ttl;
+    uint32_t hits;
+    uint32_t neg_hits;
+    uint32_t misses;
+    modusocket_dns_entry_t entries[MODUSOCKET_DNS_CACHE_MAX];
+} modusocket_dns_cache_t;
+
 /******************************************************************************
  DEFINE PRIVATE DATA
  ******************************************************************************/
@@ -91,29 +127,11 @@ STATIC const mp_obj_type_t raw_socket_type;
 STATIC modusocket_sock_t modusocket_sockets[MODUSOCKET_MAX_SOCKETS] = {{.sd = -1}, {.sd = -1}, {.sd = -1}, {.sd = -1}, {.sd = -1},
                                                                        {.sd = -1}, {.sd = -1}, {.sd = -1}, {.sd = -1}, {.sd = -1},
                                                                        {.sd = -1}, {.sd = -1}, {.sd = -1}, {.sd = -1}, {.sd = -1}};
+STATIC RTC_DATA_ATTR modusocket_dns_cache_t modusocket_dns_cache;
 
-STATIC mod_network_socket_obj_t* modsocket_sock;
-STATIC TimerHandle_t modsocket_conn_timeout_timer;
-STATIC bool modsocket_istimeout = false;
-
-STATIC void TASK_SOCK_OPS (void *pvParameters) ;
-STATIC void modsocket_timer_callback( TimerHandle_t xTimer );
-/******************************************************************************
- DEFINE PUBLIC DATA
- ******************************************************************************/
-extern TaskHandle_t xSocketOpsTaskHndl;
-SemaphoreHandle_t xSocketOpsSem;
 /******************************************************************************
  DEFINE PUBLIC FUNCTIONS
  ******************************************************************************/
-void modusocket_pre_init (void) {
-
-	// Create a Task to handle Socket Async ops
-	xTaskCreatePinnedToCore(TASK_SOCK_OPS, "Socket Operations", 4096 / sizeof(StackType_t), NULL, 5, &xSocketOpsTaskHndl, 1);
-	// Create semaphore
-	xSocketOpsSem = xSemaphoreCreateMutex();
-}
-
 void modusocket_socket_add (int32_t sd, bool user) {
 //    sl_LockObjLock (&modusocket_LockObj, SL_OS_WAIT_FOREVER);
     for (int i = 0; i < MODUSOCKET_MAX_SOCKETS; i++) {
@@ -181,6 +199,17 @@ void modusocket_close_all_user_sockets (void) {
 ///******************************************************************************/
 // socket class
 
+// EAGAIN and ETIMEDOUT are raised over and over by polling loops, so they use
+// the preallocated exception objects
+STATIC NORETURN void socket_raise_errno(int _errno) {
+    if (_errno == MP_EAGAIN) {
+        mp_raise_prealloc(MP_PREALLOC_EXC_EAGAIN);
+    } else if (_errno == MP_ETIMEDOUT) {
+        mp_raise_prealloc(MP_PREALLOC_EXC_ETIMEDOUT);
+    }
+    nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(_errno)));
+}
+
 STATIC void socket_select_nic(mod_network_socket_obj_t *self, const byte *ip) {
     if (self->sock_base.nic == MP_OBJ_NULL) {
         // select a nic
@@ -214,6 +243,7 @@ STATIC mp_obj_t socket_make_new(const mp_obj_type_t *type, mp_uint_t n_args, mp_
     s->sock_base.timeout = -1;      // sockets are blocking by default
     s->sock_base.is_ssl = false;
     s->sock_base.connected = false;
+    s->sock_base.rx_size = 0;
 
     if (n_args > 0) {
         s->sock_base.u.u_param.domain = mp_obj_get_int(args[0]);
@@ -241,7 +271,7 @@ STATIC mp_obj_t socket_make_new(const mp_obj_type_t *type, mp_uint_t n_args, mp_
     // now create the socket
     int _errno;
     if (s->sock_base.nic_type->n_socket(s, &_errno) != 0) {
-        nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(_errno)));
+        socket_raise_errno(_errno);
     }
     // add the socket to the list
     modusocket_socket_add(s->sock_base.u.sd, true);
@@ -277,7 +307,7 @@ STATIC mp_obj_t socket_bind(mp_obj_t self_in, mp_obj_t addr_in) {
         if (MP_OBJ_IS_INT(addr_in)) {
               mp_uint_t port = mp_obj_get_int(addr_in);
               if (self->sock_base.nic_type->n_bind(self, (unsigned char*) "::", port, &_errno) != 0) {
-                  nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(_errno)));
+                  socket_raise_errno(_errno);
               }
          } else {
              uint8_t ip[MOD_USOCKET_IPV6_CHARS_MAX];
@@ -289,7 +319,7 @@ STATIC mp_obj_t socket_bind(mp_obj_t self_in, mp_obj_t addr_in) {
              memcpy(ip, addr_str, (addr_len< MOD_USOCKET_IPV6_CHARS_MAX)?addr_len:MOD_USOCKET_IPV6_CHARS_MAX);
              mp_uint_t port = mp_obj_get_int(addr_items[1]);
              if (self->sock_base.nic_type->n_bind(self, ip, port, &_errno) != 0) {
-                 nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(_errno)));
+                 socket_raise_errno(_errno);
              }
          }
     } else {
@@ -299,7 +329,7 @@ STATIC mp_obj_t socket_bind(mp_obj_t self_in, mp_obj_t addr_in) {
         mp_uint_t port = netutils_parse_inet_addr(addr_in, ip, NETUTILS_LITTLE);
 
         if (self->sock_base.nic_type->n_bind(self, ip, port, &_errno) != 0) {
-            nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(_errno)));
+            socket_raise_errno(_errno);
         }
 #ifdef MOD_LORA_ENABLED
     }
@@ -320,7 +350,7 @@ STATIC mp_obj_t socket_listen(mp_uint_t n_args, const mp_obj_t *args) {
 
     int _errno;
     if (self->sock_base.nic_type->n_listen(self, backlog, &_errno) != 0) {
-        nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(_errno)));
+        socket_raise_errno(_errno);
     }
     return mp_const_none;
 }
@@ -342,7 +372,7 @@ STATIC mp_obj_t socket_accept(mp_obj_t self_in) {
     MP_THREAD_GIL_EXIT();
     if (self->sock_base.nic_type->n_accept(self, socket2, ip, &port, &_errno) != 0) {
         MP_THREAD_GIL_ENTER();
-        nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(_errno)));
+        socket_raise_errno(_errno);
     }
 
     MP_THREAD_GIL_ENTER();
@@ -363,85 +393,52 @@ STATIC mp_obj_t socket_connect(mp_obj_t self_in, mp_obj_t addr_in) {
     mod_network_socket_obj_t* self = self_in;
 
     if (self->sock_base.timeout > 0 && self->sock_base.domain == AF_INET) {
-
-        modsocket_sock = self_in;
-        int timeout_temp = modsocket_sock->sock_base.timeout;
+        int timeout_temp = self->sock_base.timeout;
+        int _errno = 0;
+        int ret;
 
         // get address
         self->sock_base.port = netutils_parse_inet_addr(addr_in, self->sock_base.ip_addr, NETUTILS_LITTLE);
 
         // Set socket to Non-Blocking
-        if(modsocket_sock->sock_base.nic_type->n_settimeout(modsocket_sock, 0, &(self->sock_base.err)) != 0)
-        {
-            nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(self->sock_base.err)));
+        if (self->sock_base.nic_type->n_settimeout(self, 0, &(self->sock_base.err)) != 0) {
+            socket_raise_errno(self->sock_base.err);
         }
 
-        /* Start socket operation handling task */
-        self->sock_base.conn_status = SOCKET_CONN_START;
-        /*create Timer */
-        modsocket_conn_timeout_timer = xTimerCreate("Socket_conn_Timer", timeout_temp / portTICK_PERIOD_MS, 0, 0, modsocket_timer_callback);
-
+        // the connection is waited for in the calling thread, with the GIL released,
+        // so connects from several threads proceed side by side
         MP_THREAD_GIL_EXIT();
-        xTaskNotifyGive(xSocketOpsTaskHndl);
-        portYIELD();
-        vTaskDelay(10 / portTICK_PERIOD_MS);
-
-        xSemaphoreTake(xSocketOpsSem, portMAX_DELAY);
-
-        switch(self->sock_base.conn_status)
-        {
-        case SOCKET_CONN_TIMEDOUT:
-            // Set socket back to Blocking
-            modsocket_sock->sock_base.nic_type->n_settimeout(modsocket_sock, timeout_temp, &(self->sock_base.err));
-            //Close socket
-            socket_close(modsocket_sock);
-            /* Release Sem */
-            xSemaphoreGive(xSocketOpsSem);
-            nlr_raise(mp_obj_new_exception_msg(&mp_type_TimeoutError, "timed out"));
-            break;
-        case SOCKET_CONN_ERROR:
-            // Set socket back to Blocking
-            modsocket_sock->sock_base.nic_type->n_settimeout(modsocket_sock, timeout_temp, &(self->sock_base.err));
-            //Close socket
-            socket_close(modsocket_sock);
-            /* Release Sem */
-            xSemaphoreGive(xSocketOpsSem);
-            nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, mp_obj_new_int(self->sock_base.err)));
-            break;
-        case SOCKET_CONN_PENDING:
-        case SOCKET_NOT_CONNECTED:
-        case SOCKET_CONN_START:
-            // Do Nothing
-            break;
-        case SOCKET_CONNECTED:
-            /* Release Sem */
-            xSemaphoreGive(xSocketOpsSem);
+        ret = self->sock_base.nic_type->n_connect(self, self->sock_base.ip_addr, self->sock_base.port, &_errno);
+        if (ret != 0 && _errno == EINPROGRESS) {
+#ifdef MOD_WIZNET5K_ENABLED
+            if (self->sock_base.nic_type == &mod_network_nic_type_wiznet5k) {
+                ret = wiznet5k_socket_connect_wait(self, timeout_temp, &_errno);
+            } else
+#endif
+            ret = lwipsocket_socket_connect_wait(self, timeout_temp, &_errno);
             // Set socket back to Blocking
-            modsocket_sock->sock_base.nic_type->n_settimeout(modsocket_sock, timeout_temp, &(self->sock_base.err));
-            // setup ssl if applicable
-            if(modsocket_sock->sock_base.is_ssl)
-            {
-                if(modsocket_sock->sock_base.nic_type->n_setupssl(modsocket_sock, &(self->sock_base.err)) != 0)
-                {
-                    //Close socket
-                    socket_close(modsocket_sock);
-                    nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(self->sock_base.err)));
-                }
+            self->sock_base.nic_type->n_settimeout(self, timeout_temp, &(self->sock_base.err));
+            // setup ssl if applicable, n_connect did it already when connected straight away
+            if (ret == 0 && self->sock_base.is_ssl) {
+                ret = self->sock_base.nic_type->n_setupssl(self, &_errno);
             }
-            // mark socket as connected to allow ssl handshake if applicable
-            modsocket_sock->sock_base.connected = true;
-            break;
-        default:
+        } else {
             // Set socket back to Blocking
-            modsocket_sock->sock_base.nic_type->n_settimeout(modsocket_sock, timeout_temp, &(self->sock_base.err));
-            //Close socket
-            socket_close(modsocket_sock);
-            /* Release Sem */
-            xSemaphoreGive(xSocketOpsSem);
-            nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Connection failed"));
-            break;
+            self->sock_base.nic_type->n_settimeout(self, timeout_temp, &(self->sock_base.err));
         }
         MP_THREAD_GIL_ENTER();
+
+        if (ret != 0) {
+            self->sock_base.err = _errno;
+            //Close socket
+            socket_close(self);
+            if (_errno == MP_ETIMEDOUT) {
+                mp_raise_prealloc(MP_PREALLOC_EXC_TIMEOUT);
+            }
+            socket_raise_errno(_errno);
+        }
+        // mark socket as connected to allow ssl handshake if applicable
+        self->sock_base.connected = true;
     }
     else
     {
@@ -452,7 +449,7 @@ STATIC mp_obj_t socket_connect(mp_obj_t self_in, mp_obj_t addr_in) {
         MP_THREAD_GIL_EXIT();
         if (self->sock_base.nic_type->n_connect(self, self->sock_base.ip_addr, self->sock_base.port, &(self->sock_base.err)) != 0) {
             MP_THREAD_GIL_ENTER();
-            nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(self->sock_base.err)));
+            socket_raise_errno(self->sock_base.err);
         }
         MP_THREAD_GIL_ENTER();
     }
@@ -466,41 +463,71 @@ STATIC mp_obj_t socket_send(mp_obj_t self_in, mp_obj_t buf_in) {
     mp_buffer_info_t bufinfo;
     mp_get_buffer_raise(buf_in, &bufinfo, MP_BUFFER_READ);
     int _errno;
+    uint32_t start = mod_network_stats_start(self->sock_base.nic_type);
+    TRACE_BEGIN(TRACE_EV_SOCK_SEND, 0);
     MP_THREAD_GIL_EXIT();
     mp_int_t ret = self->sock_base.nic_type->n_send(self, bufinfo.buf, bufinfo.len, &_errno);
     MP_THREAD_GIL_ENTER();
+    mod_network_stats_tx(self->sock_base.nic_type, ret, start);
+    TRACE_END(TRACE_EV_SOCK_SEND, (ret < 0) ? 0 : ret);
     if (ret < 0) {
         if (_errno == MP_EAGAIN && self->sock_base.timeout > 0) {
-            nlr_raise(mp_obj_new_exception_msg(&mp_type_TimeoutError, "timed out"));
+            mp_raise_prealloc(MP_PREALLOC_EXC_TIMEOUT);
         }
-        nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(_errno)));
+        socket_raise_errno(_errno);
     }
     return mp_obj_new_int_from_uint(ret);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_2(socket_send_obj, socket_send);
 
-// method socket.recv(bufsize)
-STATIC mp_obj_t socket_recv(mp_obj_t self_in, mp_obj_t len_in) {
-    mod_network_socket_obj_t *self = self_in;
-    mp_int_t len = mp_obj_get_int(len_in);
-    vstr_t vstr;
-    vstr_init_len(&vstr, len);
+// receive into the given buffer, returns the number of bytes read or 0 if a
+// non-blocking socket has nothing available
+STATIC mp_int_t socket_recv_buf(mod_network_socket_obj_t *self, byte *buf, mp_uint_t len) {
     int _errno;
+    uint32_t start = mod_network_stats_start(self->sock_base.nic_type);
+    TRACE_BEGIN(TRACE_EV_SOCK_RECV, 0);
     MP_THREAD_GIL_EXIT();
-    mp_int_t ret = self->sock_base.nic_type->n_recv(self, (byte*)vstr.buf, len, &_errno);
+    mp_int_t ret = self->sock_base.nic_type->n_recv(self, buf, len, &_errno);
     MP_THREAD_GIL_ENTER();
+    mod_network_stats_rx(self->sock_base.nic_type, (ret < 0 && (_errno == MP_EAGAIN || _errno == MBEDTLS_ERR_SSL_TIMEOUT)) ? 0 : ret, start);
+    TRACE_END(TRACE_EV_SOCK_RECV, (ret < 0) ? 0 : ret);
     if (ret < 0) {
         if (_errno == MP_EAGAIN || _errno == MBEDTLS_ERR_SSL_TIMEOUT ) {
             if (self->sock_base.timeout > 0) {
-                nlr_raise(mp_obj_new_exception_msg(&mp_type_TimeoutError, "timed out"));
+                mp_raise_prealloc(MP_PREALLOC_EXC_TIMEOUT);
             } else {
                 ret = 0;        // non-blocking socket
             }
         } else {
-            nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(_errno)));
+            socket_raise_errno(_errno);
         }
     }
+    return ret;
+}
+
+// get the writable region of buf_in, optionally limited to nbytes
+STATIC void socket_get_recv_buffer(mp_uint_t n_args, const mp_obj_t *args, mp_buffer_info_t *bufinfo) {
+    mp_get_buffer_raise(args[1], bufinfo, MP_BUFFER_WRITE);
+    if (n_args > 2) {
+        mp_int_t nbytes = mp_obj_get_int(args[2]);
+        if (nbytes < 0) {
+            mp_raise_ValueError(mpexception_value_invalid_arguments);
+        }
+        if ((mp_uint_t)nbytes < bufinfo->len) {
+            bufinfo->len = nbytes;
+        }
+    }
+}
+
+// method socket.recv(bufsize)
+STATIC mp_obj_t socket_recv(mp_obj_t self_in, mp_obj_t len_in) {
+    mod_network_socket_obj_t *self = self_in;
+    mp_int_t len = mp_obj_get_int(len_in);
+    vstr_t vstr;
+    vstr_init_len(&vstr, len);
+    mp_int_t ret = socket_recv_buf(self, (byte*)vstr.buf, len);
     if (ret == 0) {
+        vstr_clear(&vstr);
         return mp_const_empty_bytes;
     }
     vstr.len = ret;
@@ -509,6 +536,18 @@ STATIC mp_obj_t socket_recv(mp_obj_t self_in, mp_obj_t len_in) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_2(socket_recv_obj, socket_recv);
 
+// method socket.recv_into(buffer[, nbytes])
+STATIC mp_obj_t socket_recv_into(mp_uint_t n_args, const mp_obj_t *args) {
+    mod_network_socket_obj_t *self = args[0];
+    mp_buffer_info_t bufinfo;
+    socket_get_recv_buffer(n_args, args, &bufinfo);
+    if (bufinfo.len == 0) {
+        return MP_OBJ_NEW_SMALL_INT(0);
+    }
+    return mp_obj_new_int_from_uint(socket_recv_buf(self, bufinfo.buf, bufinfo.len));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(socket_recv_into_obj, 2, 3, socket_recv_into);
+
 // method socket.sendto(bytes, address)
 STATIC mp_obj_t socket_sendto(mp_obj_t self_in, mp_obj_t data_in, mp_obj_t addr_in) {
     mod_network_socket_obj_t *self = self_in;
@@ -539,69 +578,100 @@ STATIC mp_obj_t socket_sendto(mp_obj_t self_in, mp_obj_t data_in, mp_obj_t addr_
 
     // call the nic to sendto
     int _errno;
+    uint32_t start = mod_network_stats_start(self->sock_base.nic_type);
+    TRACE_BEGIN(TRACE_EV_SOCK_SEND, 0);
     MP_THREAD_GIL_EXIT();
     mp_int_t ret = self->sock_base.nic_type->n_sendto(self, bufinfo.buf, bufinfo.len, ip, port, &_errno);
     MP_THREAD_GIL_ENTER();
+    mod_network_stats_tx(self->sock_base.nic_type, ret, start);
+    TRACE_END(TRACE_EV_SOCK_SEND, (ret < 0) ? 0 : ret);
     if (ret < 0) {
         if (_errno == MP_EAGAIN && self->sock_base.timeout > 0) {
-            nlr_raise(mp_obj_new_exception_msg(&mp_type_TimeoutError, "timed out"));
+            mp_raise_prealloc(MP_PREALLOC_EXC_TIMEOUT);
         }
-        nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(_errno)));
+        socket_raise_errno(_errno);
     }
     return mp_obj_new_int(ret);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_3(socket_sendto_obj, socket_sendto);
 
-// method socket.recvfrom(bufsize)
-STATIC mp_obj_t socket_recvfrom(mp_obj_t self_in, mp_obj_t len_in) {
-    mod_network_socket_obj_t *self = self_in;
-    vstr_t vstr;
-    vstr_init_len(&vstr, mp_obj_get_int(len_in));
-    byte ip[MOD_USOCKET_IPV6_CHARS_MAX];
-    mp_uint_t port;
+// receive a datagram into the given buffer, the sender goes into ip/port
+STATIC mp_int_t socket_recvfrom_buf(mod_network_socket_obj_t *self, byte *buf, mp_uint_t len, byte *ip, mp_uint_t *port) {
     int _errno;
-
     ip[0] = 0;// init IP with null
+    uint32_t start = mod_network_stats_start(self->sock_base.nic_type);
+    TRACE_BEGIN(TRACE_EV_SOCK_RECV, 0);
     MP_THREAD_GIL_EXIT();
-    mp_int_t ret = self->sock_base.nic_type->n_recvfrom(self, (byte*)vstr.buf, vstr.len, ip, &port, &_errno);
+    mp_int_t ret = self->sock_base.nic_type->n_recvfrom(self, buf, len, ip, port, &_errno);
     MP_THREAD_GIL_ENTER();
+    mod_network_stats_rx(self->sock_base.nic_type, (ret < 0 && (_errno == MP_EAGAIN || _errno == MBEDTLS_ERR_SSL_TIMEOUT)) ? 0 : ret, start);
+    TRACE_END(TRACE_EV_SOCK_RECV, (ret < 0) ? 0 : ret);
     if (ret < 0) {
         if ((_errno == MP_EAGAIN || _errno == MBEDTLS_ERR_SSL_TIMEOUT ) && self->sock_base.timeout > 0) {
-            nlr_raise(mp_obj_new_exception_msg(&mp_type_TimeoutError, "timed out"));
+            mp_raise_prealloc(MP_PREALLOC_EXC_TIMEOUT);
+        }
+        socket_raise_errno(_errno);
+    }
+    return ret;
+}
+
+STATIC mp_obj_t socket_format_addr(mod_network_socket_obj_t *self, byte *ip, mp_uint_t port) {
+#ifdef MOD_LORA_ENABLED
+    // check if lora NIC and IP is not set (so Lora Raw or LoraWAN, but no Lora Mesh)
+    if (self->sock_base.nic_type == &mod_network_nic_type_lora) {
+        if (ip[0] == 0) {
+            return mp_obj_new_int(port);
+        } else {
+            // Lora Mesh
+            mp_obj_t addr[2] = {
+                mp_obj_new_str((char*)ip, strlen((char*)ip)),
+                mp_obj_new_int(port),
+            };
+            return mp_obj_new_tuple(2, addr);
         }
-        nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(_errno)));
     }
+#endif
+    return netutils_format_inet_addr(ip, port, NETUTILS_LITTLE);
+}
+
+// method socket.recvfrom(bufsize)
+STATIC mp_obj_t socket_recvfrom(mp_obj_t self_in, mp_obj_t len_in) {
+    mod_network_socket_obj_t *self = self_in;
+    vstr_t vstr;
+    vstr_init_len(&vstr, mp_obj_get_int(len_in));
+    byte ip[MOD_USOCKET_IPV6_CHARS_MAX];
+    mp_uint_t port;
+    mp_int_t ret = socket_recvfrom_buf(self, (byte*)vstr.buf, vstr.len, ip, &port);
     mp_obj_t tuple[2];
     if (ret == 0) {
+        vstr_clear(&vstr);
         tuple[0] = mp_const_empty_bytes;
     } else {
         vstr.len = ret;
         vstr.buf[vstr.len] = '\0';
         tuple[0] = mp_obj_new_str_from_vstr(&mp_type_bytes, &vstr);
     }
-#ifdef MOD_LORA_ENABLED
-    // check if lora NIC and IP is not set (so Lora Raw or LoraWAN, but no Lora Mesh)
-    if (self->sock_base.nic_type == &mod_network_nic_type_lora) {
-            if (ip[0] == 0) {
-            tuple[1] = mp_obj_new_int(port);
-            } else {
-                // Lora Mesh
-                mp_obj_t addr[2] = {
-                addr[0] = mp_obj_new_str((char*)ip, strlen((char*)ip)),
-                addr[1] = mp_obj_new_int(port),
-                };
-                tuple[1] = mp_obj_new_tuple(2, addr);
-            }
-    } else {
-        tuple[1] = netutils_format_inet_addr(ip, port, NETUTILS_LITTLE);
-    }
-#else
-    tuple[1] = netutils_format_inet_addr(ip, port, NETUTILS_LITTLE);
-#endif
+    tuple[1] = socket_format_addr(self, ip, port);
     return mp_obj_new_tuple(2, tuple);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_2(socket_recvfrom_obj, socket_recvfrom);
 
+// method socket.recvfrom_into(buffer[, nbytes])
+STATIC mp_obj_t socket_recvfrom_into(mp_uint_t n_args, const mp_obj_t *args) {
+    mod_network_socket_obj_t *self = args[0];
+    mp_buffer_info_t bufinfo;
+    socket_get_recv_buffer(n_args, args, &bufinfo);
+    byte ip[MOD_USOCKET_IPV6_CHARS_MAX];
+    mp_uint_t port;
+    mp_int_t ret = socket_recvfrom_buf(self, bufinfo.buf, bufinfo.len, ip, &port);
+    mp_obj_t tuple[2] = {
+        mp_obj_new_int_from_uint(ret),
+        socket_format_addr(self, ip, port),
+    };
+    return mp_obj_new_tuple(2, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(socket_recvfrom_into_obj, 2, 3, socket_recvfrom_into);
+
 // method socket.setsockopt(level, optname, value)
 STATIC mp_obj_t socket_setsockopt(mp_uint_t n_args, const mp_obj_t *args) {
     mod_network_socket_obj_t *self = args[0];
@@ -629,7 +699,7 @@ STATIC mp_obj_t socket_setsockopt(mp_uint_t n_args, const mp_obj_t *args) {
 
     int _errno;
     if (self->sock_base.nic_type->n_setsockopt(self, level, opt, optval, optlen, &_errno) != 0) {
-        nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(_errno)));
+        socket_raise_errno(_errno);
     }
     return mp_const_none;
 }
@@ -649,7 +719,7 @@ STATIC mp_obj_t socket_settimeout(mp_obj_t self_in, mp_obj_t timeout_in) {
     }
     int _errno;
     if (self->sock_base.nic_type->n_settimeout(self, timeout, &_errno) != 0) {
-        nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(_errno)));
+        socket_raise_errno(_errno);
     }
     return mp_const_none;
 }
@@ -686,104 +756,13 @@ STATIC mp_obj_t socket_do_handshake(mp_obj_t self_in) {
     int _errno;
     MP_THREAD_GIL_EXIT();
     if (self->sock_base.nic_type->n_setupssl(self, &_errno) != 0) {
-        nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(_errno)));
+        socket_raise_errno(_errno);
     }
     MP_THREAD_GIL_ENTER();
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(socket_do_handshake_obj, socket_do_handshake);
 
-static void TASK_SOCK_OPS (void *pvParameters) {
-
-    mp_uint_t flag = MP_STREAM_POLL_WR;
-    int ret;
-    static uint32_t thread_notification;
-
-Conn_start:
-
-    thread_notification = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-
-    if (thread_notification) {
-        for (;;)
-        {
-            if(modsocket_sock->sock_base.conn_status == SOCKET_CONN_START)
-            {
-                xSemaphoreTake(xSocketOpsSem, portMAX_DELAY);
-
-                //connect socket
-                if (modsocket_sock->sock_base.nic_type->n_connect(modsocket_sock, modsocket_sock->sock_base.ip_addr, modsocket_sock->sock_base.port, &(modsocket_sock->sock_base.err)) != 0) {
-
-                    if(modsocket_sock->sock_base.err == EINPROGRESS)
-                    {
-                        /*start Timer */
-                        xTimerStart(modsocket_conn_timeout_timer, 0);
-                        /* Pending */
-                        modsocket_sock->sock_base.conn_status = SOCKET_CONN_PENDING;
-                    }
-                    else
-                    {
-                        modsocket_sock->sock_base.conn_status = SOCKET_CONN_ERROR;
-                        xSemaphoreGive(xSocketOpsSem);
-                        goto Conn_start;
-                    }
-                }
-                else
-                {
-                    // socket already connected
-                    modsocket_sock->sock_base.conn_status = SOCKET_CONNECTED;
-                    xSemaphoreGive(xSocketOpsSem);
-                    goto Conn_start;
-                }
-            }
-            else if (modsocket_sock->sock_base.conn_status == SOCKET_CONN_PENDING)
-            {
-                //start polling
-                ret = lwipsocket_socket_ioctl(modsocket_sock, MP_STREAM_POLL, flag, &(modsocket_sock->sock_base.err));
-                if((ret & MP_STREAM_POLL_WR) == MP_STREAM_POLL_WR)
-                {
-                    // socket connected
-                    modsocket_sock->sock_base.conn_status = SOCKET_CONNECTED;
-                    /* Stop Timer*/
-                    xTimerStop(modsocket_conn_timeout_timer, 0);
-                    xTimerDelete(modsocket_conn_timeout_timer, 0);
-                    xSemaphoreGive(xSocketOpsSem);
-                    goto Conn_start;
-                }
-                else if(ret < 0)
-                {
-                    modsocket_sock->sock_base.conn_status = SOCKET_CONN_ERROR;
-                    xSemaphoreGive(xSocketOpsSem);
-                    goto Conn_start;
-                }
-
-                if(modsocket_istimeout)
-                {
-                    modsocket_sock->sock_base.conn_status = SOCKET_CONN_TIMEDOUT;
-                    modsocket_istimeout = false;
-                    xSemaphoreGive(xSocketOpsSem);
-                    goto Conn_start;
-                }
-            }
-            else
-            {
-                // Nothing
-            }
-
-            vTaskDelay(5/portTICK_PERIOD_MS);
-        }
-    }
-
-    goto Conn_start;
-}
-
-STATIC void modsocket_timer_callback( TimerHandle_t xTimer )
-{
-    modsocket_istimeout = true;
-    /* Stop Timer*/
-    xTimerStop(modsocket_conn_timeout_timer, 0);
-    xTimerDelete(modsocket_conn_timeout_timer, 0);
-}
-
 STATIC const mp_map_elem_t socket_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR___del__),         (mp_obj_t)&socket_close_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_close),           (mp_obj_t)&socket_close_obj },
@@ -794,8 +773,10 @@ STATIC const mp_map_elem_t socket_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_send),            (mp_obj_t)&socket_send_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_sendall),         (mp_obj_t)&socket_send_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_recv),            (mp_obj_t)&socket_recv_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_recv_into),       (mp_obj_t)&socket_recv_into_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_sendto),          (mp_obj_t)&socket_sendto_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_recvfrom),        (mp_obj_t)&socket_recvfrom_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_recvfrom_into),   (mp_obj_t)&socket_recvfrom_into_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_setsockopt),      (mp_obj_t)&socket_setsockopt_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_settimeout),      (mp_obj_t)&socket_settimeout_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_setblocking),     (mp_obj_t)&socket_setblocking_obj },
@@ -819,7 +800,9 @@ STATIC const mp_map_elem_t raw_socket_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_send),            (mp_obj_t)&socket_send_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_sendto),          (mp_obj_t)&socket_sendto_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_recv),            (mp_obj_t)&socket_recv_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_recv_into),       (mp_obj_t)&socket_recv_into_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_recvfrom),        (mp_obj_t)&socket_recvfrom_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_recvfrom_into),   (mp_obj_t)&socket_recvfrom_into_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_settimeout),      (mp_obj_t)&socket_settimeout_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_bind),            (mp_obj_t)&socket_bind_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_setblocking),     (mp_obj_t)&socket_setblocking_obj },
@@ -831,6 +814,7 @@ STATIC const mp_map_elem_t raw_socket_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_close),           (mp_obj_t)&socket_close_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_send),            (mp_obj_t)&socket_send_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_recv),            (mp_obj_t)&socket_recv_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_recv_into),       (mp_obj_t)&socket_recv_into_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_settimeout),      (mp_obj_t)&socket_settimeout_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_setblocking),     (mp_obj_t)&socket_setblocking_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_setsockopt),      (mp_obj_t)&socket_setsockopt_obj },
@@ -841,9 +825,13 @@ MP_DEFINE_CONST_DICT(raw_socket_locals_dict, raw_socket_locals_dict_table);
 
 STATIC mp_uint_t socket_read(mp_obj_t self_in, void *buf, mp_uint_t size, int *errcode) {
     mod_network_socket_obj_t *self = self_in;
+    uint32_t start = mod_network_stats_start(self->sock_base.nic_type);
+    TRACE_BEGIN(TRACE_EV_SOCK_RECV, 0);
     MP_THREAD_GIL_EXIT();
     mp_int_t ret = self->sock_base.nic_type->n_recv(self, buf, size, errcode);
     MP_THREAD_GIL_ENTER();
+    mod_network_stats_rx(self->sock_base.nic_type, (ret < 0 && *errcode == MP_EAGAIN) ? 0 : ret, start);
+    TRACE_END(TRACE_EV_SOCK_RECV, (ret < 0) ? 0 : ret);
     if (ret < 0) {
 //        // we need to ignore the socket closed error here because a readall() or read() without params
 //        // only returns when the socket is closed by the other end
@@ -858,9 +846,13 @@ STATIC mp_uint_t socket_read(mp_obj_t self_in, void *buf, mp_uint_t size, int *e
 
 STATIC mp_uint_t socket_write(mp_obj_t self_in, const void *buf, mp_uint_t size, int *errcode) {
     mod_network_socket_obj_t *self = self_in;
+    uint32_t start = mod_network_stats_start(self->sock_base.nic_type);
+    TRACE_BEGIN(TRACE_EV_SOCK_SEND, 0);
     MP_THREAD_GIL_EXIT();
     mp_int_t ret = self->sock_base.nic_type->n_send(self, buf, size, errcode);
     MP_THREAD_GIL_ENTER();
+    mod_network_stats_tx(self->sock_base.nic_type, ret, start);
+    TRACE_END(TRACE_EV_SOCK_SEND, (ret < 0) ? 0 : ret);
     if (ret < 0) {
         ret = MP_STREAM_ERROR;
     }
@@ -903,6 +895,61 @@ STATIC const mp_obj_type_t raw_socket_type = {
 ///******************************************************************************/
 //// usocket module
 
+// the cache is only touched with the GIL held
+STATIC modusocket_dns_cache_t *modusocket_dns_cache_get(void) {
+    if (modusocket_dns_cache.magic != MODUSOCKET_DNS_CACHE_MAGIC || modusocket_dns_cache.size > MODUSOCKET_DNS_CACHE_MAX) {
+        memset(&modusocket_dns_cache, 0, sizeof(modusocket_dns_cache));
+        modusocket_dns_cache.size = MODUSOCKET_DNS_CACHE_MAX;
+        modusocket_dns_cache.ttl = MODUSOCKET_DNS_TTL_DEFAULT;
+        modusocket_dns_cache.neg_ttl = MODUSOCKET_DNS_NEG_TTL_DEFAULT;
+        modusocket_dns_cache.magic = MODUSOCKET_DNS_CACHE_MAGIC;
+    }
+    return &modusocket_dns_cache;
+}
+
+STATIC bool modusocket_dns_entry_valid(const modusocket_dns_entry_t *entry, uint32_t now) {
+    // a clock set backwards makes the entry look too old as well
+    return entry->name[0] != '\0' && (now - entry->stored) < entry->ttl;
+}
+
+STATIC modusocket_dns_entry_t *modusocket_dns_cache_find(modusocket_dns_cache_t *cache, const char *name, uint32_t now) {
+    for (uint32_t i = 0; i < cache->size; i++) {
+        modusocket_dns_entry_t *entry = &cache->entries[i];
+        if (modusocket_dns_entry_valid(entry, now) && !strncmp(entry->name, name, MODUSOCKET_DNS_NAME_MAX)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+STATIC void modusocket_dns_cache_store(modusocket_dns_cache_t *cache, const char *name, uint32_t addr, int32_t error, uint32_t now) {
+    uint32_t ttl = (addr != 0) ? cache->ttl : cache->neg_ttl;
+    modusocket_dns_entry_t *slot = NULL;
+    uint32_t slot_age = 0;
+
+    if (cache->size == 0 || ttl == 0) {
+        return;
+    }
+    // the same name, else a free or stale entry, else the oldest one
+    for (uint32_t i = 0; i < cache->size; i++) {
+        modusocket_dns_entry_t *entry = &cache->entries[i];
+        if (!strncmp(entry->name, name, MODUSOCKET_DNS_NAME_MAX)) {
+            slot = entry;
+            break;
+        }
+        uint32_t age = modusocket_dns_entry_valid(entry, now) ? (now - entry->stored) : UINT32_MAX;
+        if (slot == NULL || age > slot_age) {
+            slot = entry;
+            slot_age = age;
+        }
+    }
+    strncpy(slot->name, name, MODUSOCKET_DNS_NAME_MAX);
+    slot->addr = addr;
+    slot->error = error;
+    slot->stored = now;
+    slot->ttl = ttl;
+}
+
 // function usocket.getaddrinfo(host, port)
 /// \function getaddrinfo(host, port)
 STATIC mp_obj_t mod_usocket_getaddrinfo(size_t n_args, const mp_obj_t *args) {
@@ -918,29 +965,156 @@ STATIC mp_obj_t mod_usocket_getaddrinfo(size_t n_args, const mp_obj_t *args) {
         .ai_socktype = SOCK_STREAM,
     };
     struct addrinfo *res;
-    struct in_addr *addr;
+    uint32_t s_addr;
+
+    // names only, the addresses in dotted form are not looked up anyway
+    modusocket_dns_cache_t *cache = modusocket_dns_cache_get();
+    uint32_t now = time(NULL);
+    ip4_addr_t numeric;
+    bool cacheable = cache->size > 0 && hlen > 0 && hlen < MODUSOCKET_DNS_NAME_MAX && !ip4addr_aton(host, &numeric);
+
+    // the nics with an IP stack of their own ask their DNS server themselves, lwIP has no route then
+    const mod_network_nic_type_t *resolver = NULL;
+#ifdef MOD_WIZNET5K_ENABLED
+    if (wiznet5k_is_enabled()) {
+        resolver = &mod_network_nic_type_wiznet5k;
+    }
+#endif
+#if defined(FIPY) || defined(GPY)
+    if (resolver == NULL && lteudp_is_enabled()) {
+        resolver = &mod_network_nic_type_lte_udp;
+    }
+#endif
 
-    char port_s[6];
-    sprintf(port_s, "%d", port);
-    int32_t result = getaddrinfo(host, port_s, &hints, &res);
-    if(result != 0 || res == NULL) {
-        nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(result)));
+    modusocket_dns_entry_t *entry = cacheable ? modusocket_dns_cache_find(cache, host, now) : NULL;
+    if (entry != NULL) {
+        if (entry->addr == 0) {
+            cache->neg_hits++;
+            nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(entry->error)));
+        }
+        cache->hits++;
+        s_addr = entry->addr;
+    }
+    else if (resolver != NULL && !ip4addr_aton(host, &numeric)) {
+        uint8_t out_ip[MOD_NETWORK_IPV4ADDR_BUF_SIZE];
+        MP_THREAD_GIL_EXIT();
+        int32_t result = resolver->n_gethostbyname(host, hlen, out_ip, AF_INET);
+        MP_THREAD_GIL_ENTER();
+        if (cacheable) {
+            cache->misses++;
+        }
+        if (result != 0) {
+            if (cacheable) {
+                modusocket_dns_cache_store(cache, host, 0, EAI_FAIL, now);
+            }
+            nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(EAI_FAIL)));
+        }
+        // in network order, as lwIP returns it
+        memcpy(&s_addr, out_ip, sizeof(s_addr));
+        if (cacheable) {
+            modusocket_dns_cache_store(cache, host, s_addr, 0, now);
+        }
+    }
+    else {
+        char port_s[6];
+        sprintf(port_s, "%d", port);
+        // lwIP answers from its TTL bound cache, else waits for the server, without holding up the other threads
+        MP_THREAD_GIL_EXIT();
+        int32_t result = getaddrinfo(host, port_s, &hints, &res);
+        MP_THREAD_GIL_ENTER();
+        if (cacheable) {
+            cache->misses++;
+        }
+        if(result != 0 || res == NULL) {
+            if (cacheable) {
+                modusocket_dns_cache_store(cache, host, 0, result, now);
+            }
+            nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(result)));
+        }
+        s_addr = ((struct sockaddr_in *)res->ai_addr)->sin_addr.s_addr;
+        //getaddrinfo() allocates memory, needs to be freed
+        freeaddrinfo(res);
+        if (cacheable) {
+            modusocket_dns_cache_store(cache, host, s_addr, 0, now);
+        }
     }
-    addr = &((struct sockaddr_in *)res->ai_addr)->sin_addr;
+
     mp_obj_tuple_t *tuple = mp_obj_new_tuple(5, NULL);
-    tuple->items[0] = MP_OBJ_NEW_SMALL_INT(res->ai_family);
-    tuple->items[1] = MP_OBJ_NEW_SMALL_INT(res->ai_socktype);
+    tuple->items[0] = MP_OBJ_NEW_SMALL_INT(hints.ai_family);
+    tuple->items[1] = MP_OBJ_NEW_SMALL_INT(hints.ai_socktype);
     tuple->items[2] = MP_OBJ_NEW_SMALL_INT(0);
     tuple->items[3] = MP_OBJ_NEW_QSTR(MP_QSTR_);
-    tuple->items[4] = netutils_format_inet_addr((uint8_t *) &addr->s_addr, port, NETUTILS_BIG);
-
-    //getaddrinfo() allocates memory, needs to be freed
-    freeaddrinfo(res);
+    tuple->items[4] = netutils_format_inet_addr((uint8_t *)&s_addr, port, NETUTILS_BIG);
 
     return mp_obj_new_list(1, (mp_obj_t*) &tuple);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_usocket_getaddrinfo_obj, 2, 6, mod_usocket_getaddrinfo);
 
+/// \function dns_cache(*, size, ttl, neg_ttl, flush=False)
+/// returns the (size, ttl, neg_ttl) in use, size 0 disables the cache
+STATIC const mp_arg_t mod_usocket_dns_cache_args[] = {
+    { MP_QSTR_size,         MP_ARG_KW_ONLY | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+    { MP_QSTR_ttl,          MP_ARG_KW_ONLY | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+    { MP_QSTR_neg_ttl,      MP_ARG_KW_ONLY | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+    { MP_QSTR_flush,        MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false} },
+};
+STATIC mp_obj_t mod_usocket_dns_cache(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    mp_arg_val_t args[MP_ARRAY_SIZE(mod_usocket_dns_cache_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(args), mod_usocket_dns_cache_args, args);
+
+    modusocket_dns_cache_t *cache = modusocket_dns_cache_get();
+    mp_int_t values[3];
+    for (int i = 0; i < 3; i++) {
+        values[i] = (args[i].u_obj != mp_const_none) ? mp_obj_get_int(args[i].u_obj) : -1;
+    }
+    if (values[0] > MODUSOCKET_DNS_CACHE_MAX) {
+        nlr_raise(mp_obj_new_exception_msg_varg(&mp_type_ValueError, "size can be %d at most", MODUSOCKET_DNS_CACHE_MAX));
+    }
+    if (values[0] >= 0) {
+        cache->size = values[0];
+    }
+    // the entries already there keep their ttl
+    if (values[1] >= 0) {
+        cache->ttl = values[1];
+    }
+    if (values[2] >= 0) {
+        cache->neg_ttl = values[2];
+    }
+    if (args[3].u_bool || values[0] >= 0) {
+        memset(cache->entries, 0, sizeof(cache->entries));
+    }
+
+    mp_obj_t tuple[3] = {
+        mp_obj_new_int_from_uint(cache->size),
+        mp_obj_new_int_from_uint(cache->ttl),
+        mp_obj_new_int_from_uint(cache->neg_ttl),
+    };
+    return mp_obj_new_tuple(3, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_usocket_dns_cache_obj, 0, mod_usocket_dns_cache);
+
+STATIC mp_obj_t mod_usocket_dns_cache_stats(void) {
+    static const qstr dns_cache_stats_fields[] = {
+        MP_QSTR_hits, MP_QSTR_negative_hits, MP_QSTR_misses, MP_QSTR_entries
+    };
+    modusocket_dns_cache_t *cache = modusocket_dns_cache_get();
+    uint32_t now = time(NULL);
+    uint32_t entries = 0;
+    for (uint32_t i = 0; i < cache->size; i++) {
+        if (modusocket_dns_entry_valid(&cache->entries[i], now)) {
+            entries++;
+        }
+    }
+
+    mp_obj_t tuple[4];
+    tuple[0] = mp_obj_new_int_from_uint(cache->hits);
+    tuple[1] = mp_obj_new_int_from_uint(cache->neg_hits);
+    tuple[2] = mp_obj_new_int_from_uint(cache->misses);
+    tuple[3] = mp_obj_new_int_from_uint(entries);
+    return mp_obj_new_attrtuple(dns_cache_stats_fields, 4, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_usocket_dns_cache_stats_obj, mod_usocket_dns_cache_stats);
+
 STATIC mp_obj_t mod_usocket_dnsserver(size_t n_args, const mp_obj_t *args)
 {
     if(n_args == 1)
@@ -997,6 +1171,8 @@ STATIC const mp_map_elem_t mp_module_usocket_globals_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_socket),          (mp_obj_t)&socket_type },
     { MP_OBJ_NEW_QSTR(MP_QSTR_getaddrinfo),     (mp_obj_t)&mod_usocket_getaddrinfo_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_dnsserver),       (mp_obj_t)&mod_usocket_dnsserver_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_dns_cache),       (mp_obj_t)&mod_usocket_dns_cache_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_dns_cache_stats), (mp_obj_t)&mod_usocket_dns_cache_stats_obj },
 
     // class exceptions
     { MP_OBJ_NEW_QSTR(MP_QSTR_error),           (mp_obj_t)&mp_type_OSError },
@@ -1037,10 +1213,12 @@ STATIC const mp_map_elem_t mp_module_usocket_globals_table[] = {
 #endif
     { MP_OBJ_NEW_QSTR(MP_QSTR_SOL_SOCKET),      MP_OBJ_NEW_SMALL_INT(SOL_SOCKET) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_SO_REUSEADDR),    MP_OBJ_NEW_SMALL_INT(SO_REUSEADDR) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_SO_RCVBUF),       MP_OBJ_NEW_SMALL_INT(SO_RCVBUF) },
 
 #if defined(LOPY) || defined (LOPY4) || defined(FIPY)
     { MP_OBJ_NEW_QSTR(MP_QSTR_SO_CONFIRMED),    MP_OBJ_NEW_SMALL_INT(SO_LORAWAN_CONFIRMED) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_SO_DR),           MP_OBJ_NEW_SMALL_INT(SO_LORAWAN_DR) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_SO_AGGREGATE),    MP_OBJ_NEW_SMALL_INT(SO_LORAWAN_AGGREGATE) },
 #endif
 #if defined(SIPY) || defined (LOPY4) || defined(FIPY)
      { MP_OBJ_NEW_QSTR(MP_QSTR_SO_RX),          MP_OBJ_NEW_SMALL_INT(SO_SIGFOX_RX) },
@@ -8,15 +8,20 @@
  */
 
 #include <string.h>
+#include <time.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "freertos/event_groups.h"
 #include "esp_wifi.h"
 #include "esp_event_loop.h"
 #include "esp_log.h"
 #include "esp_system.h"
 #include "nvs_flash.h"
+#include "rom/crc.h"
+#include "esp_attr.h"
+#include "mbedtls/platform.h"
 
 #include "py/mpconfig.h"
 #include "py/obj.h"
@@ -28,12 +33,45 @@
 #include "modussl.h"
 #include "mptask.h"
 #include "pycom_general_util.h"
+#ifdef MOD_WIZNET5K_ENABLED
+#include "modwiznet5k.h"
+#endif
 
 /******************************************************************************
  DEFINE CONSTANTS
  ******************************************************************************/
 #define DEFAULT_SSL_READ_TIMEOUT                    10 //sec
 
+#define MODUSSL_CACHE_NUM_ENTRIES                   4
+#define MODUSSL_CACHE_HOST_MAX                      64
+#define MODUSSL_RTC_TICKET_MAX                      384
+#define MODUSSL_RTC_SESSION_MAGIC                   0x55534C31
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+typedef struct {
+    char host[MODUSSL_CACHE_HOST_MAX];      // empty when the slot is free
+    uint32_t last_used;
+    mbedtls_ssl_session session;
+} ussl_cache_entry_t;
+
+// copy of the most recent session kept in RTC slow memory across deep sleep
+typedef struct {
+    uint32_t magic;
+    uint32_t crc;                           // over everything that follows
+    char host[MODUSSL_CACHE_HOST_MAX];
+    mbedtls_ssl_session session;            // the pointers in here are not valid
+    uint8_t ticket[MODUSSL_RTC_TICKET_MAX];
+} ussl_rtc_session_t;
+
+typedef struct _ussl_ca_entry_t {
+    uint32_t crc;
+    uint32_t len;
+    uint32_t refs;                          // one for the cache plus one per socket using it
+    mbedtls_x509_crt chain;
+} ussl_ca_entry_t;
+
 /******************************************************************************
  DECLARE PRIVATE FUNCTIONS
  ******************************************************************************/
@@ -41,6 +79,14 @@
 /******************************************************************************
  DECLARE PRIVATE DATA
  ******************************************************************************/
+static ussl_cache_entry_t ussl_cache[MODUSSL_CACHE_NUM_ENTRIES];
+static uint32_t ussl_cache_clock;
+static bool ussl_cache_enabled = true;
+static bool ussl_cache_persist;
+static ussl_ca_entry_t *ussl_shared_ca;
+static SemaphoreHandle_t ussl_cache_mutex;
+static RTC_DATA_ATTR ussl_rtc_session_t ussl_rtc_session;
+
 // tiny object for storing ssl sessions
 STATIC mp_obj_t ssl_session_free(mp_obj_t self_in) {
     mp_obj_ssl_session_t *self = self_in;
@@ -71,9 +117,215 @@ STATIC const mp_obj_type_t ssl_socket_type = {
     .locals_dict = (mp_obj_t)&socket_locals_dict,
 };
 
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+// must be called with the GIL held, before any other thread can use the cache
+static void ussl_cache_init (void) {
+    if (ussl_cache_mutex == NULL) {
+        ussl_cache_mutex = xSemaphoreCreateMutex();
+    }
+}
+
+static void ussl_cache_lock (void) {
+    xSemaphoreTake(ussl_cache_mutex, portMAX_DELAY);
+}
+
+static void ussl_cache_unlock (void) {
+    xSemaphoreGive(ussl_cache_mutex);
+}
+
+static uint32_t ussl_rtc_session_crc (void) {
+    const uint8_t *start = (const uint8_t *)&ussl_rtc_session.host;
+    return crc32_le(UINT32_MAX, start, sizeof(ussl_rtc_session) - (start - (const uint8_t *)&ussl_rtc_session));
+}
+
+static bool ussl_rtc_session_is_valid (void) {
+    return ussl_rtc_session.magic == MODUSSL_RTC_SESSION_MAGIC && ussl_rtc_session.crc == ussl_rtc_session_crc();
+}
+
+static void ussl_rtc_session_invalidate (void) {
+    ussl_rtc_session.magic = 0;
+}
+
+static void ussl_rtc_session_save (const ussl_cache_entry_t *entry) {
+    memcpy(ussl_rtc_session.host, entry->host, MODUSSL_CACHE_HOST_MAX);
+    memcpy(&ussl_rtc_session.session, &entry->session, sizeof(mbedtls_ssl_session));
+    ussl_rtc_session.session.peer_cert = NULL;
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    ussl_rtc_session.session.ticket = NULL;
+    if (entry->session.ticket_len <= MODUSSL_RTC_TICKET_MAX) {
+        memcpy(ussl_rtc_session.ticket, entry->session.ticket, entry->session.ticket_len);
+    } else {
+        // too big for RTC memory, the session id alone may still get us resumed
+        ussl_rtc_session.session.ticket_len = 0;
+    }
+#endif
+    ussl_rtc_session.magic = MODUSSL_RTC_SESSION_MAGIC;
+    ussl_rtc_session.crc = ussl_rtc_session_crc();
+}
+
+static bool ussl_rtc_session_restore (ussl_cache_entry_t *entry) {
+    memcpy(&entry->session, &ussl_rtc_session.session, sizeof(mbedtls_ssl_session));
+    entry->session.peer_cert = NULL;
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    entry->session.ticket = NULL;
+    if (entry->session.ticket_len > 0) {
+        if ((entry->session.ticket = mbedtls_calloc(1, entry->session.ticket_len)) == NULL) {
+            memset(&entry->session, 0, sizeof(mbedtls_ssl_session));
+            return false;
+        }
+        memcpy(entry->session.ticket, ussl_rtc_session.ticket, entry->session.ticket_len);
+    }
+#endif
+    memcpy(entry->host, ussl_rtc_session.host, MODUSSL_CACHE_HOST_MAX);
+    return true;
+}
+
+static void ussl_cache_free_entry (ussl_cache_entry_t *entry) {
+    if (entry->host[0] != '\0') {
+        mbedtls_ssl_session_free(&entry->session);
+        entry->host[0] = '\0';
+    }
+}
+
+static bool ussl_cache_entry_expired (const ussl_cache_entry_t *entry) {
+#if defined(MBEDTLS_HAVE_TIME) && defined(MBEDTLS_SSL_SESSION_TICKETS)
+    if (entry->session.ticket_len > 0 && entry->session.ticket_lifetime > 0) {
+        return (time(NULL) - entry->session.start) > entry->session.ticket_lifetime;
+    }
+#endif
+    return false;
+}
+
+// returns the slot already holding host, or the one to be recycled for it
+static ussl_cache_entry_t *ussl_cache_find (const char *host, bool *found) {
+    ussl_cache_entry_t *victim = &ussl_cache[0];
+    for (int i = 0; i < MODUSSL_CACHE_NUM_ENTRIES; i++) {
+        ussl_cache_entry_t *entry = &ussl_cache[i];
+        if (entry->host[0] != '\0' && !strncmp(entry->host, host, MODUSSL_CACHE_HOST_MAX)) {
+            *found = true;
+            return entry;
+        }
+        if (victim->host[0] != '\0' && (entry->host[0] == '\0' || entry->last_used < victim->last_used)) {
+            victim = entry;
+        }
+    }
+    *found = false;
+    return victim;
+}
+
+// called with the GIL released
+static void ussl_cache_resume (mbedtls_ssl_context *ssl, const char *host) {
+    bool found;
+    ussl_cache_lock();
+    ussl_cache_entry_t *entry = ussl_cache_find(host, &found);
+    if (!found && ussl_cache_persist && ussl_rtc_session_is_valid() &&
+        !strncmp(ussl_rtc_session.host, host, MODUSSL_CACHE_HOST_MAX)) {
+        ussl_cache_free_entry(entry);
+        found = ussl_rtc_session_restore(entry);
+    }
+    if (found) {
+        if (ussl_cache_entry_expired(entry)) {
+            ussl_cache_free_entry(entry);
+        } else if (mbedtls_ssl_set_session(ssl, &entry->session) == 0) {
+            entry->last_used = ++ussl_cache_clock;
+        }
+    }
+    ussl_cache_unlock();
+}
+
+static void ussl_cache_store (mbedtls_ssl_context *ssl, const char *host) {
+    bool found;
+    if (strlen(host) >= MODUSSL_CACHE_HOST_MAX) {
+        return;
+    }
+    ussl_cache_lock();
+    ussl_cache_entry_t *entry = ussl_cache_find(host, &found);
+    ussl_cache_free_entry(entry);
+    if (mbedtls_ssl_get_session(ssl, &entry->session) == 0) {
+        // resuming only needs the verify result, not the peer certificate itself
+        if (entry->session.peer_cert != NULL) {
+            mbedtls_x509_crt_free(entry->session.peer_cert);
+            mbedtls_free(entry->session.peer_cert);
+            entry->session.peer_cert = NULL;
+        }
+        strcpy(entry->host, host);
+        entry->last_used = ++ussl_cache_clock;
+        if (ussl_cache_persist) {
+            ussl_rtc_session_save(entry);
+        }
+    } else {
+        mbedtls_ssl_session_free(&entry->session);
+    }
+    ussl_cache_unlock();
+}
+
+static void ussl_cache_drop (const char *host) {
+    bool found;
+    ussl_cache_lock();
+    ussl_cache_entry_t *entry = ussl_cache_find(host, &found);
+    if (found) {
+        ussl_cache_free_entry(entry);
+    }
+    if (!strncmp(ussl_rtc_session.host, host, MODUSSL_CACHE_HOST_MAX)) {
+        ussl_rtc_session_invalidate();
+    }
+    ussl_cache_unlock();
+}
+
+// called with the cache lock held
+static void ussl_ca_put (ussl_ca_entry_t *ca) {
+    if (--ca->refs == 0) {
+        mbedtls_x509_crt_free(&ca->chain);
+        free(ca);
+    }
+}
+
+// parses the CA chain only when it differs from the one parsed last time
+static int32_t ussl_ca_get (const char *pem, ussl_ca_entry_t **ca_out) {
+    int32_t ret;
+    uint32_t len = strlen(pem) + 1;
+    uint32_t crc = crc32_le(UINT32_MAX, (const uint8_t *)pem, len);
+
+    ussl_cache_lock();
+    if (ussl_shared_ca != NULL && ussl_shared_ca->len == len && ussl_shared_ca->crc == crc) {
+        ussl_shared_ca->refs++;
+        *ca_out = ussl_shared_ca;
+        ussl_cache_unlock();
+        return 0;
+    }
+
+    ussl_ca_entry_t *ca = malloc(sizeof(ussl_ca_entry_t));
+    if (ca == NULL) {
+        ussl_cache_unlock();
+        return MBEDTLS_ERR_X509_ALLOC_FAILED;
+    }
+    mbedtls_x509_crt_init(&ca->chain);
+    // printf("Loading the CA root certificate...\n");
+    ret = mbedtls_x509_crt_parse(&ca->chain, (const uint8_t *)pem, len);
+    if (ret < 0) {
+        // printf("mbedtls_x509_crt_parse returned -0x%x\n\n", -ret);
+        mbedtls_x509_crt_free(&ca->chain);
+        free(ca);
+        ussl_cache_unlock();
+        return ret;
+    }
+    ca->crc = crc;
+    ca->len = len;
+    ca->refs = 2;
+    if (ussl_shared_ca != NULL) {
+        ussl_ca_put(ussl_shared_ca);
+    }
+    ussl_shared_ca = ca;
+    *ca_out = ca;
+    ussl_cache_unlock();
+    return 0;
+}
+
 static int32_t mod_ssl_setup_socket (mp_obj_ssl_socket_t *ssl_sock, const mbedtls_ssl_session *saved_session, const char *host_name,
                                      const char *ca_cert, const char *client_cert, const char *client_key,
-                                     uint32_t ssl_verify, uint32_t client_or_server) {
+                                     uint32_t ssl_verify, uint32_t client_or_server, int32_t mfl_code) {
 
     int32_t ret;
     mbedtls_ssl_init(&ssl_sock->ssl);
@@ -90,10 +342,7 @@ static int32_t mod_ssl_setup_socket (mp_obj_ssl_socket_t *ssl_sock, const mbedtl
     }
 
     if (ca_cert) {
-        // printf("Loading the CA root certificate...\n");
-        ret = mbedtls_x509_crt_parse(&ssl_sock->cacert, (uint8_t *)ca_cert, strlen(ca_cert) + 1);
-        if (ret < 0) {
-            // printf("mbedtls_x509_crt_parse returned -0x%x\n\n", -ret);
+        if ((ret = ussl_ca_get(ca_cert, &ssl_sock->shared_ca)) != 0) {
             return ret;
         }
     }
@@ -125,7 +374,19 @@ static int32_t mod_ssl_setup_socket (mp_obj_ssl_socket_t *ssl_sock, const mbedtl
 
     mbedtls_ssl_conf_authmode(&ssl_sock->conf, ssl_verify);
     mbedtls_ssl_conf_rng(&ssl_sock->conf, mbedtls_ctr_drbg_random, &ssl_sock->ctr_drbg);
-    mbedtls_ssl_conf_ca_chain(&ssl_sock->conf, &ssl_sock->cacert, NULL);
+    mbedtls_ssl_conf_ca_chain(&ssl_sock->conf, ssl_sock->shared_ca ? &ssl_sock->shared_ca->chain : &ssl_sock->cacert, NULL);
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    if (mfl_code != MBEDTLS_SSL_MAX_FRAG_LEN_NONE) {
+        if ((ret = mbedtls_ssl_conf_max_frag_len(&ssl_sock->conf, mfl_code)) != 0) {
+            return ret;
+        }
+    }
+#endif
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    if (client_or_server == MBEDTLS_SSL_IS_CLIENT) {
+        mbedtls_ssl_conf_session_tickets(&ssl_sock->conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+    }
+#endif
     if (client_cert && client_key) {
         if ((ret = mbedtls_ssl_conf_own_cert(&ssl_sock->conf,
                                              &ssl_sock->own_cert,
@@ -153,6 +414,11 @@ static int32_t mod_ssl_setup_socket (mp_obj_ssl_socket_t *ssl_sock, const mbedtl
             // printf("mbedtls_ssl_set_hostname returned -0x%x\n", -ret);
             return ret;
         }
+        // an explicitly saved session takes precedence over the cached one
+        ssl_sock->cache_session = ussl_cache_enabled && client_or_server == MBEDTLS_SSL_IS_CLIENT;
+        if (ssl_sock->cache_session && saved_session == NULL) {
+            ussl_cache_resume(&ssl_sock->ssl, host_name);
+        }
     }
 
     ssl_sock->context_fd.fd = ssl_sock->sock_base.u.sd;
@@ -174,6 +440,7 @@ static int32_t mod_ssl_setup_socket (mp_obj_ssl_socket_t *ssl_sock, const mbedtl
         {
             if ((ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE && ret != MBEDTLS_ERR_SSL_TIMEOUT) || count >= ssl_sock->read_timeout) {
                  //printf("mbedtls_ssl_handshake returned -0x%x\n", -ret);
+                modussl_session_update(ssl_sock, false);
                 return ret;
             }
             if(ret == MBEDTLS_ERR_SSL_TIMEOUT)
@@ -186,16 +453,19 @@ static int32_t mod_ssl_setup_socket (mp_obj_ssl_socket_t *ssl_sock, const mbedtl
         ret = mbedtls_ssl_get_verify_result(&ssl_sock->ssl);
         if (ret == 0) {
             //printf("Certificate verified.\n");
+            modussl_session_update(ssl_sock, true);
             return 0;
         }
         // If no verification is needed the mbedtls_ssl_get_verify_result() returns with MBEDTLS_X509_BADCERT_SKIP_VERIFY
         else if((ssl_verify == MBEDTLS_SSL_VERIFY_NONE) && (ret == MBEDTLS_X509_BADCERT_SKIP_VERIFY)) {
             //printf("Certification validation skipped.\n");
+            modussl_session_update(ssl_sock, true);
             return 0;
         }
         else {
             /* In real life, we probably want to close connection in this case */
             //printf("Failed to verify peer certificate!\n");
+            modussl_session_update(ssl_sock, false);
             return -1;
         }
     }
@@ -204,6 +474,29 @@ static int32_t mod_ssl_setup_socket (mp_obj_ssl_socket_t *ssl_sock, const mbedtl
 }
 
 
+/******************************************************************************
+ DEFINE PUBLIC FUNCTIONS
+ ******************************************************************************/
+// called with the GIL released once the handshake has completed or failed
+void modussl_session_update (mp_obj_ssl_socket_t *ss, bool handshake_ok) {
+    if (ss->cache_session && ss->ssl.hostname != NULL) {
+        if (handshake_ok) {
+            ussl_cache_store(&ss->ssl, ss->ssl.hostname);
+        } else {
+            ussl_cache_drop(ss->ssl.hostname);
+        }
+    }
+}
+
+void modussl_release_ca (mp_obj_ssl_socket_t *ss) {
+    if (ss->shared_ca != NULL) {
+        ussl_cache_lock();
+        ussl_ca_put(ss->shared_ca);
+        ussl_cache_unlock();
+        ss->shared_ca = NULL;
+    }
+}
+
 /******************************************************************************/
 // Micro Python bindings; SSL class
 
@@ -219,6 +512,7 @@ STATIC mp_obj_t mod_ssl_wrap_socket(mp_uint_t n_args, const mp_obj_t *pos_args,
         { MP_QSTR_server_hostname,              MP_ARG_KW_ONLY  | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
         { MP_QSTR_saved_session,                MP_ARG_KW_ONLY  | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
         { MP_QSTR_timeout,                      MP_ARG_KW_ONLY  | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+        { MP_QSTR_max_fragment_len,             MP_ARG_KW_ONLY  | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
     };
 
     int32_t _error;
@@ -250,6 +544,12 @@ STATIC mp_obj_t mod_ssl_wrap_socket(mp_uint_t n_args, const mp_obj_t *pos_args,
     if (!mp_obj_is_type(args[0].u_obj, &socket_type)) {
     	goto arg_error;
     }
+#ifdef MOD_WIZNET5K_ENABLED
+    // mbedTLS reads and writes the lwIP socket straight away
+    if (((mod_network_socket_obj_t *)args[0].u_obj)->sock_base.nic_type == &mod_network_nic_type_wiznet5k) {
+        mp_raise_msg(&mp_type_OSError, "SSL is not supported on WIZNET5K sockets");
+    }
+#endif
 
     // saved_session type check
     if (args[8].u_obj != mp_const_none) {
@@ -258,6 +558,27 @@ STATIC mp_obj_t mod_ssl_wrap_socket(mp_uint_t n_args, const mp_obj_t *pos_args,
         }
     }
 
+    // max fragment length extension, which also caps the records sent by the server
+    int32_t mfl_code = MBEDTLS_SSL_MAX_FRAG_LEN_NONE;
+    if (args[10].u_obj != mp_const_none) {
+        switch (mp_obj_get_int(args[10].u_obj)) {
+        case 512:
+            mfl_code = MBEDTLS_SSL_MAX_FRAG_LEN_512;
+            break;
+        case 1024:
+            mfl_code = MBEDTLS_SSL_MAX_FRAG_LEN_1024;
+            break;
+        case 2048:
+            mfl_code = MBEDTLS_SSL_MAX_FRAG_LEN_2048;
+            break;
+        case 4096:
+            mfl_code = MBEDTLS_SSL_MAX_FRAG_LEN_4096;
+            break;
+        default:
+            goto arg_error;
+        }
+    }
+
     // Retrieve previously saved session
     const mbedtls_ssl_session *saved_session  = (args[8].u_obj == mp_const_none) ? NULL : &((mp_obj_ssl_session_t *)args[8].u_obj)->saved_session;
 
@@ -267,6 +588,8 @@ STATIC mp_obj_t mod_ssl_wrap_socket(mp_uint_t n_args, const mp_obj_t *pos_args,
     memcpy (&ssl_sock->sock_base, &((mod_network_socket_obj_t *)args[0].u_obj)->sock_base, sizeof(mod_network_socket_base_t));
     ssl_sock->base.type = &ssl_socket_type;
     ssl_sock->o_sock = args[0].u_obj;       // this is needed so that the GC doesnt collect the socket
+    ssl_sock->shared_ca = NULL;
+    ssl_sock->cache_session = false;
 
     //Read timeout
     if(args[9].u_obj == mp_const_none)
@@ -300,10 +623,12 @@ STATIC mp_obj_t mod_ssl_wrap_socket(mp_uint_t n_args, const mp_obj_t *pos_args,
     }
 
 
+    ussl_cache_init();
+
     MP_THREAD_GIL_EXIT();
 
     _error = mod_ssl_setup_socket(ssl_sock, saved_session, host_name, ca_cert, client_cert, client_key,
-                                  verify_type, server_side ? MBEDTLS_SSL_IS_SERVER : MBEDTLS_SSL_IS_CLIENT);
+                                  verify_type, server_side ? MBEDTLS_SSL_IS_SERVER : MBEDTLS_SSL_IS_CLIENT, mfl_code);
 
     MP_THREAD_GIL_ENTER();
 
@@ -350,10 +675,71 @@ STATIC mp_obj_t mod_ssl_save_session(mp_uint_t n_args, const mp_obj_t *pos_args,
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_ssl_save_session_obj, 0, mod_ssl_save_session);
 
+STATIC mp_obj_t mod_ssl_session_cache(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_enable,       MP_ARG_OBJ,                   {.u_obj = mp_const_none} },
+        { MP_QSTR_persist,      MP_ARG_KW_ONLY | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+    };
+
+    // parse arguments
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    ussl_cache_init();
+    ussl_cache_lock();
+    if (args[0].u_obj != mp_const_none) {
+        ussl_cache_enabled = mp_obj_is_true(args[0].u_obj);
+        if (!ussl_cache_enabled) {
+            for (int i = 0; i < MODUSSL_CACHE_NUM_ENTRIES; i++) {
+                ussl_cache_free_entry(&ussl_cache[i]);
+            }
+        }
+    }
+    if (args[1].u_obj != mp_const_none) {
+        ussl_cache_persist = mp_obj_is_true(args[1].u_obj);
+        if (!ussl_cache_persist) {
+            ussl_rtc_session_invalidate();
+        }
+    }
+    mp_int_t entries = 0;
+    for (int i = 0; i < MODUSSL_CACHE_NUM_ENTRIES; i++) {
+        if (ussl_cache[i].host[0] != '\0') {
+            entries++;
+        }
+    }
+    ussl_cache_unlock();
+
+    mp_obj_t tuple[3];
+    tuple[0] = mp_obj_new_bool(ussl_cache_enabled);
+    tuple[1] = mp_obj_new_bool(ussl_cache_persist);
+    tuple[2] = mp_obj_new_int(entries);
+    return mp_obj_new_tuple(3, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_ssl_session_cache_obj, 0, mod_ssl_session_cache);
+
+STATIC mp_obj_t mod_ssl_clear_cache(void) {
+    ussl_cache_init();
+    ussl_cache_lock();
+    for (int i = 0; i < MODUSSL_CACHE_NUM_ENTRIES; i++) {
+        ussl_cache_free_entry(&ussl_cache[i]);
+    }
+    ussl_rtc_session_invalidate();
+    // sockets still using the shared CA chain keep it alive until they are closed
+    if (ussl_shared_ca != NULL) {
+        ussl_ca_put(ussl_shared_ca);
+        ussl_shared_ca = NULL;
+    }
+    ussl_cache_unlock();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_ssl_clear_cache_obj, mod_ssl_clear_cache);
+
 STATIC const mp_map_elem_t mp_module_ussl_globals_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR___name__),            MP_OBJ_NEW_QSTR(MP_QSTR_ussl) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_wrap_socket),         (mp_obj_t)&mod_ssl_wrap_socket_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_save_session),        (mp_obj_t)&mod_ssl_save_session_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_session_cache),       (mp_obj_t)&mod_ssl_session_cache_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_clear_cache),         (mp_obj_t)&mod_ssl_clear_cache_obj },
 
     // class exceptions
     { MP_OBJ_NEW_QSTR(MP_QSTR_SSLError),            (mp_obj_t)&mp_type_OSError },
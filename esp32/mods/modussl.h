@@ -42,7 +42,9 @@ typedef struct _mp_obj_ssl_socket_t {
     mbedtls_net_context context_fd;
     mbedtls_x509_crt own_cert;
     mbedtls_pk_context pk_key;
+    struct _ussl_ca_entry_t *shared_ca;     // parsed CA chain shared with other sockets
     uint8_t read_timeout;
+    bool cache_session;                     // store the session in the per host cache
 } mp_obj_ssl_socket_t;
 
 typedef struct _mp_obj_ssl_session_t {
@@ -50,4 +52,10 @@ typedef struct _mp_obj_ssl_session_t {
     mbedtls_ssl_session saved_session;
 } mp_obj_ssl_session_t;
 
+/******************************************************************************
+ DECLARE PUBLIC FUNCTIONS
+ ******************************************************************************/
+extern void modussl_session_update (mp_obj_ssl_socket_t *ss, bool handshake_ok);
+extern void modussl_release_ca (mp_obj_ssl_socket_t *ss);
+
 #endif /* MODUSSL_H_ */
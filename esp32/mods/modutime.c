@@ -134,23 +134,45 @@ MP_DEFINE_CONST_FUN_OBJ_1(time_mktime_obj, time_mktime);
 /// \function sleep(seconds)
 /// Sleep for the given number of seconds.
 STATIC mp_obj_t time_sleep(mp_obj_t seconds_o) {
-    mp_hal_delay_ms(1000 * mp_obj_get_float(seconds_o));
+    mp_float_t us = 1000000 * mp_obj_get_float(seconds_o);
+    if (us > 0) {
+        mp_hal_delay_until_us(mp_hal_ticks_us_non_blocking() + (uint64_t)us);
+    }
     return mp_const_none;
 }
 MP_DEFINE_CONST_FUN_OBJ_1(time_sleep_obj, time_sleep);
 
 STATIC mp_obj_t time_sleep_ms(mp_obj_t arg) {
-    mp_hal_delay_ms(mp_obj_get_int(arg));
+    mp_int_t ms = mp_obj_get_int(arg);
+    if (ms > 0) {
+        mp_hal_delay_until_us(mp_hal_ticks_us_non_blocking() + (uint64_t)ms * 1000);
+    }
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(time_sleep_ms_obj, time_sleep_ms);
 
 STATIC mp_obj_t time_sleep_us(mp_obj_t arg) {
-    mp_hal_delay_us(mp_obj_get_int(arg));
+    mp_int_t us = mp_obj_get_int(arg);
+    if (us > 0) {
+        mp_hal_delay_us(us);
+    }
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(time_sleep_us_obj, time_sleep_us);
 
+/// \function sleep_until(ticks)
+/// Sleep until ticks_us() reaches ticks, returning right away if it is past;
+/// stepping the deadline by the period keeps a periodic loop from drifting
+STATIC mp_obj_t time_sleep_until(mp_obj_t ticks_in) {
+    uint64_t now = mp_hal_ticks_us_non_blocking();
+    int32_t delta = (uint32_t)mp_obj_get_int_truncated(ticks_in) - mp_hal_ticks_us();
+    if (delta > 0) {
+        mp_hal_delay_until_us(now + delta);
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(time_sleep_until_obj, time_sleep_until);
+
 STATIC mp_obj_t time_ticks_ms(void) {
     return mp_obj_new_int_from_uint(mp_hal_ticks_ms());
 }
@@ -161,6 +183,13 @@ STATIC mp_obj_t time_ticks_us(void) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(time_ticks_us_obj, time_ticks_us);
 
+/// \function ticks_us64()
+/// Microseconds of the monotonic timebase, counting on through deep sleep; never wraps.
+STATIC mp_obj_t time_ticks_us64(void) {
+    return mp_obj_new_int_from_ull(mach_rtc_ticks_us64());
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(time_ticks_us64_obj, time_ticks_us64);
+
 STATIC mp_obj_t time_ticks_cpu(void) {
    return mp_obj_new_int_from_uint(mp_hal_ticks_us_non_blocking());
 }
@@ -188,6 +217,13 @@ STATIC mp_obj_t time_time(void) {
 }
 MP_DEFINE_CONST_FUN_OBJ_0(time_time_obj, time_time);
 
+/// \function time_ns()
+/// Returns the number of nanoseconds since 1/1/1970, with microsecond resolution.
+STATIC mp_obj_t time_time_ns(void) {
+   return mp_obj_new_int_from_ull(mach_rtc_get_us_since_epoch() * 1000ull);
+}
+MP_DEFINE_CONST_FUN_OBJ_0(time_time_ns_obj, time_time_ns);
+
 /// \function time_timezone()
 /// Return or set the timezone offset, in seconds
 STATIC mp_obj_t time_timezone(mp_uint_t n_args, const mp_obj_t *args) {
@@ -209,12 +245,15 @@ STATIC const mp_map_elem_t time_module_globals_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_sleep),               (mp_obj_t)&time_sleep_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_sleep_ms),            (mp_obj_t)&time_sleep_ms_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_sleep_us),            (mp_obj_t)&time_sleep_us_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_sleep_until),         (mp_obj_t)&time_sleep_until_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_ticks_ms),            (mp_obj_t)&time_ticks_ms_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_ticks_us),            (mp_obj_t)&time_ticks_us_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_ticks_us64),          (mp_obj_t)&time_ticks_us64_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_ticks_cpu),           (mp_obj_t)&time_ticks_cpu_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_ticks_add),           (mp_obj_t)&time_ticks_add_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_ticks_diff),          (mp_obj_t)&time_ticks_diff_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_time),                (mp_obj_t)&time_time_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_time_ns),             (mp_obj_t)&time_time_ns_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_timezone),            (mp_obj_t)&time_timezone_obj },
 };
 
@@ -0,0 +1,1041 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/stream.h"
+#include "py/mpthread.h"
+#include "py/mperrno.h"
+#include "py/mphal.h"
+#include "netutils.h"
+#include "mpexception.h"
+#include "machpin.h"
+#include "pins.h"
+#include "modnetwork.h"
+#include "modwiznet5k.h"
+
+#include "ethernet/wizchip_conf.h"
+#include "ethernet/socket.h"
+#include "internet/dns/dns.h"
+
+#include "esp_heap_caps.h"
+#include "esp_system.h"
+#include "soc/soc_memory_layout.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "driver/spi_master.h"
+#include "lwip/sockets.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define WIZNET5K_BAUDRATE_DEFAULT           (20000000)
+#define WIZNET5K_BAUDRATE_MAX               (80000000)
+#define WIZNET5K_DMA_BUF_SIZE               (2048)  // a full socket buffer in one burst
+#define WIZNET5K_SOCKET_BUF_KB              (2)     // the 16 KB of each direction shared by the 8 sockets
+#define WIZNET5K_VERSION                    (0x04)
+#define WIZNET5K_WAIT_SLICE_MS              (20)    // bounds the cost of a missed INTn edge
+#define WIZNET5K_POLL_MS                    (2)     // without INTn, and while the TX buffer is full
+#define WIZNET5K_UDP_DRAIN_CHUNK            (32)
+#define WIZNET5K_KEEPALIVE_5S               (2)
+
+// raised on INTn while a thread waits on the socket, SENDOK and TIMEOUT are left to the ioLibrary
+#define WIZNET5K_SN_IMR                     (Sn_IR_RECV | Sn_IR_DISCON | Sn_IR_CON | Sn_IR_TIMEOUT)
+#define WIZNET5K_SN_IR_CLEAR                (Sn_IR_RECV | Sn_IR_DISCON | Sn_IR_CON)
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+typedef struct _wiznet5k_obj_t {
+    mp_obj_base_t base;
+    spi_device_handle_t dev;
+    uint8_t *dma_buf;
+    SemaphoreHandle_t mutex;            // recursive, taken around each frame by the ioLibrary
+    SemaphoreHandle_t dns_mutex;        // the resolver of the ioLibrary keeps its state in globals
+    SemaphoreHandle_t sn_sem[_WIZCHIP_SOCK_NUM_];
+    pin_obj_t *rst;
+    pin_obj_t *int_pin;
+    uint32_t hdr;                       // address phase of the frame being sent
+    bool hdr_valid;
+    volatile uint8_t waiting;           // sockets with a thread waiting on INTn
+    uint8_t socket_used;
+    uint8_t socket_open;                // a WIZnet socket is opened as a client or a server, not before
+    uint8_t socket_dgram;               // u.sd holds the socket number, like the lwIP descriptor
+    uint8_t host;
+    bool enabled;
+} wiznet5k_obj_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+STATIC wiznet5k_obj_t wiznet5k_obj = {.host = HSPI_HOST};
+STATIC const mp_obj_t wiznet5k_def_pin[3] = {&PIN_MODULE_P10, &PIN_MODULE_P11, &PIN_MODULE_P14};
+STATIC mod_network_nic_stats_t wiznet5k_stats;
+
+/******************************************************************************
+ DEFINE PUBLIC FUNCTIONS
+ ******************************************************************************/
+// the resolver of the ioLibrary keeps its time with the STM32 HAL tick
+uint32_t HAL_GetTick (void) {
+    return mp_hal_ticks_ms();
+}
+
+bool wiznet5k_is_enabled (void) {
+    return wiznet5k_obj.enabled;
+}
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+STATIC void wiz_cris_enter (void) {
+    xSemaphoreTakeRecursive(wiznet5k_obj.mutex, portMAX_DELAY);
+}
+
+STATIC void wiz_cris_exit (void) {
+    xSemaphoreGiveRecursive(wiznet5k_obj.mutex);
+}
+
+// one SPI transaction per frame: the address and control bytes go out as the address
+// phase, the data in DMA bursts of at most WIZNET5K_DMA_BUF_SIZE, each with its own
+// frame carrying on from the address the previous one stopped at
+STATIC void wiznet5k_frame (uint32_t hdr, const uint8_t *tx, uint8_t *rx, uint32_t len) {
+    wiznet5k_obj_t *self = &wiznet5k_obj;
+    const void *buf = tx ? (const void *)tx : (const void *)rx;
+    bool direct = esp_ptr_dma_capable(buf) && ((intptr_t)buf % 4) == 0;
+    while (len > 0) {
+        uint32_t chunk = MIN(len, WIZNET5K_DMA_BUF_SIZE);
+        spi_transaction_ext_t t;
+        memset(&t, 0, sizeof(t));
+        t.base.flags = SPI_TRANS_VARIABLE_ADDR;
+        t.base.addr = hdr;
+        t.address_bits = 24;
+        if (tx) {
+            if (chunk <= 4) {
+                t.base.flags |= SPI_TRANS_USE_TXDATA;
+                memcpy(t.base.tx_data, tx, chunk);
+            } else if (direct) {
+                t.base.tx_buffer = tx;
+            } else {
+                memcpy(self->dma_buf, tx, chunk);
+                t.base.tx_buffer = self->dma_buf;
+            }
+            t.base.length = chunk * 8;
+        } else {
+            if (chunk <= 4) {
+                t.base.flags |= SPI_TRANS_USE_RXDATA;
+            } else {
+                t.base.rx_buffer = direct ? rx : self->dma_buf;
+            }
+            t.base.rxlength = chunk * 8;
+        }
+        spi_device_transmit(self->dev, (spi_transaction_t *)&t);
+        if (tx) {
+            tx += chunk;
+        } else {
+            if (chunk <= 4) {
+                memcpy(rx, t.base.rx_data, chunk);
+            } else if (!direct) {
+                memcpy(rx, self->dma_buf, chunk);
+            }
+            rx += chunk;
+        }
+        hdr = (hdr + (chunk << 8)) & 0xFFFFFF;
+        len -= chunk;
+    }
+}
+
+// the ioLibrary sends the 3 header bytes first, then the data, all between a select
+// and a deselect; the header is kept back so that both go out in one frame
+STATIC void wiz_cs_select (void) {
+    wiznet5k_obj.hdr_valid = false;
+}
+
+STATIC void wiz_cs_deselect (void) {
+    wiznet5k_obj.hdr_valid = false;
+}
+
+STATIC void wiz_spi_write (const uint8_t *buf, uint32_t len) {
+    if (!wiznet5k_obj.hdr_valid) {
+        wiznet5k_obj.hdr = (buf[0] << 16) | (buf[1] << 8) | buf[2];
+        wiznet5k_obj.hdr_valid = true;
+        buf += 3;
+        len -= 3;
+    }
+    if (len > 0) {
+        wiznet5k_frame(wiznet5k_obj.hdr, buf, NULL, len);
+    }
+}
+
+STATIC void wiz_spi_read (uint8_t *buf, uint32_t len) {
+    wiznet5k_frame(wiznet5k_obj.hdr, NULL, buf, len);
+}
+
+STATIC IRAM_ATTR void wiznet5k_intr_handler (void) {
+    BaseType_t woken = pdFALSE;
+    // the chip can't be asked which socket it was from here, every waiter checks its own
+    uint8_t waiting = wiznet5k_obj.waiting;
+    for (uint8_t sn = 0; sn < _WIZCHIP_SOCK_NUM_; sn++) {
+        if (waiting & (1 << sn)) {
+            xSemaphoreGiveFromISR(wiznet5k_obj.sn_sem[sn], &woken);
+        }
+    }
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+// The functions below are called with the GIL released
+
+// sleeps until INTn for the socket or until the slice is over, the caller checks again
+STATIC void wiznet5k_wait (uint8_t sn, uint32_t ms) {
+    wiz_cris_enter();
+    wiznet5k_obj.waiting |= (1 << sn);
+    // unmasking a pending event drives INTn low as well
+    setSn_IMR(sn, WIZNET5K_SN_IMR);
+    setSIMR(getSIMR() | (1 << sn));
+    wiz_cris_exit();
+
+    xSemaphoreTake(wiznet5k_obj.sn_sem[sn], MAX(1, ms / portTICK_PERIOD_MS));
+
+    wiz_cris_enter();
+    wiznet5k_obj.waiting &= ~(1 << sn);
+    setSIMR(getSIMR() & ~(1 << sn));
+    setSn_IR(sn, WIZNET5K_SN_IR_CLEAR);
+    wiz_cris_exit();
+}
+
+// false once the timeout is over, a timeout of -1 waits for ever
+STATIC bool wiznet5k_wait_event (uint8_t sn, int32_t timeout, uint32_t start, uint32_t slice) {
+    if (wiznet5k_obj.int_pin == NULL) {
+        slice = WIZNET5K_POLL_MS;
+    }
+    if (timeout >= 0) {
+        uint32_t elapsed = mp_hal_ticks_ms() - start;
+        if (elapsed >= timeout) {
+            return false;
+        }
+        slice = MIN(slice, timeout - elapsed);
+    }
+    wiznet5k_wait(sn, slice);
+    return true;
+}
+
+STATIC int wiznet5k_errno (int32_t ret) {
+    switch (ret) {
+        case SOCKERR_SOCKNUM:
+        case SOCKERR_SOCKINIT:
+            return MP_EBADF;
+        case SOCKERR_SOCKCLOSED:
+        case SOCKERR_SOCKSTATUS:
+            return MP_ENOTCONN;
+        case SOCKERR_TIMEOUT:
+            return MP_ETIMEDOUT;
+        case SOCKERR_ARG:
+        case SOCKERR_PORTZERO:
+        case SOCKERR_IPINVALID:
+        case SOCKERR_DATALEN:
+        case SOCKERR_SOCKMODE:
+        case SOCKERR_SOCKOPT:
+        case SOCKERR_SOCKFLAG:
+            return MP_EINVAL;
+        default:
+            return MP_EIO;
+    }
+}
+
+// the socket layer keeps the addresses with the last byte first
+STATIC void wiznet5k_flip_ip (uint8_t *dest, const uint8_t *src) {
+    dest[0] = src[3];
+    dest[1] = src[2];
+    dest[2] = src[1];
+    dest[3] = src[0];
+}
+
+STATIC int wiznet5k_alloc_socket (void) {
+    int sn = -1;
+    wiz_cris_enter();
+    for (uint8_t i = 0; i < _WIZCHIP_SOCK_NUM_; i++) {
+        if ((wiznet5k_obj.socket_used & (1 << i)) == 0) {
+            wiznet5k_obj.socket_used |= (1 << i);
+            sn = i;
+            break;
+        }
+    }
+    wiz_cris_exit();
+    return sn;
+}
+
+STATIC void wiznet5k_close_sn (uint8_t sn) {
+    wiz_cris_enter();
+    if (wiznet5k_obj.socket_open & (1 << sn)) {
+        WIZCHIP_EXPORT(close)(sn);
+        wiznet5k_obj.socket_open &= ~(1 << sn);
+    }
+    wiz_cris_exit();
+}
+
+STATIC bool wiznet5k_socket_get_sn (mod_network_socket_obj_t *s, uint8_t *sn, int *_errno) {
+    int32_t sd = s->sock_base.u.sd;
+    if (!wiznet5k_obj.enabled || sd < 0 || sd >= _WIZCHIP_SOCK_NUM_) {
+        *_errno = MP_EBADF;
+        return false;
+    }
+    *sn = sd;
+    return true;
+}
+
+STATIC bool wiznet5k_is_dgram (uint8_t sn) {
+    return (wiznet5k_obj.socket_dgram & (1 << sn)) != 0;
+}
+
+// opens the socket on the chip, as a server when port is not 0
+STATIC int wiznet5k_socket_open (mod_network_socket_obj_t *s, uint8_t sn, mp_uint_t port, int *_errno) {
+    uint8_t protocol = wiznet5k_is_dgram(sn) ? Sn_MR_UDP : Sn_MR_TCP;
+    // the waiting is done here, with INTn, rather than by spinning in the ioLibrary
+    int8_t ret = WIZCHIP_EXPORT(socket)(sn, protocol, port, SF_IO_NONBLOCK);
+    if (ret < 0) {
+        *_errno = wiznet5k_errno(ret);
+        return -1;
+    }
+    wiz_cris_enter();
+    wiznet5k_obj.socket_open |= (1 << sn);
+    wiz_cris_exit();
+    return 0;
+}
+
+STATIC int wiznet5k_socket_ensure_open (mod_network_socket_obj_t *s, uint8_t sn, int *_errno) {
+    if (wiznet5k_obj.socket_open & (1 << sn)) {
+        return 0;
+    }
+    return wiznet5k_socket_open(s, sn, 0, _errno);
+}
+
+STATIC int wiznet5k_gethostbyname (const char *name, mp_uint_t len, uint8_t *out_ip, mp_uint_t family) {
+    if (!wiznet5k_obj.enabled) {
+        return -MP_ENETDOWN;
+    }
+    int sn = wiznet5k_alloc_socket();
+    if (sn < 0) {
+        return -MP_EMFILE;
+    }
+    uint8_t *buf = heap_caps_malloc(MAX_DNS_BUF_SIZE, MALLOC_CAP_INTERNAL);
+    if (buf == NULL) {
+        wiz_cris_enter();
+        wiznet5k_obj.socket_used &= ~(1 << sn);
+        wiz_cris_exit();
+        return -MP_ENOMEM;
+    }
+    wiz_NetInfo netinfo;
+    ctlnetwork(CN_GET_NETINFO, &netinfo);
+
+    xSemaphoreTake(wiznet5k_obj.dns_mutex, portMAX_DELAY);
+    DNS_init(sn, buf);
+    int8_t ret = DNS_run(netinfo.dns, (uint8_t *)name, out_ip);
+    xSemaphoreGive(wiznet5k_obj.dns_mutex);
+
+    // DNS_run leaves the socket open when the server doesn't answer
+    WIZCHIP_EXPORT(close)(sn);
+    heap_caps_free(buf);
+    wiz_cris_enter();
+    wiznet5k_obj.socket_used &= ~(1 << sn);
+    wiz_cris_exit();
+    return (ret == 1) ? 0 : -MP_ENOENT;
+}
+
+STATIC int wiznet5k_socket_socket (mod_network_socket_obj_t *s, int *_errno) {
+    if (s->sock_base.u.u_param.domain != AF_INET) {
+        *_errno = MP_EAFNOSUPPORT;
+        return -1;
+    }
+    uint8_t type = s->sock_base.u.u_param.type;
+    if (type != SOCK_STREAM && type != SOCK_DGRAM) {
+        *_errno = MP_EINVAL;
+        return -1;
+    }
+    int sn = wiznet5k_alloc_socket();
+    if (sn < 0) {
+        *_errno = MP_EMFILE;
+        return -1;
+    }
+    wiz_cris_enter();
+    if (type == SOCK_DGRAM) {
+        wiznet5k_obj.socket_dgram |= (1 << sn);
+    } else {
+        wiznet5k_obj.socket_dgram &= ~(1 << sn);
+    }
+    wiz_cris_exit();
+    // opened when it's known whether it's a client or a server
+    s->sock_base.u.sd = sn;
+    return 0;
+}
+
+STATIC void wiznet5k_socket_close (mod_network_socket_obj_t *s) {
+    int32_t sd = s->sock_base.u.sd;
+    if (sd >= 0 && sd < _WIZCHIP_SOCK_NUM_) {
+        if (wiznet5k_obj.enabled) {
+            wiznet5k_close_sn(sd);
+        }
+        wiz_cris_enter();
+        wiznet5k_obj.socket_used &= ~(1 << sd);
+        wiz_cris_exit();
+    }
+}
+
+STATIC int wiznet5k_socket_bind (mod_network_socket_obj_t *s, byte *ip, mp_uint_t port, int *_errno) {
+    uint8_t sn;
+    if (!wiznet5k_socket_get_sn(s, &sn, _errno)) {
+        return -1;
+    }
+    if (wiznet5k_obj.socket_open & (1 << sn)) {
+        *_errno = MP_EINVAL;
+        return -1;
+    }
+    // the chip has a single address, ip is ignored
+    return wiznet5k_socket_open(s, sn, port, _errno);
+}
+
+STATIC int wiznet5k_socket_listen (mod_network_socket_obj_t *s, mp_int_t backlog, int *_errno) {
+    uint8_t sn;
+    if (!wiznet5k_socket_get_sn(s, &sn, _errno)) {
+        return -1;
+    }
+    if (wiznet5k_socket_ensure_open(s, sn, _errno) != 0) {
+        return -1;
+    }
+    // one connection per hardware socket, accept() listens again on another one
+    int8_t ret = WIZCHIP_EXPORT(listen)(sn);
+    if (ret < 0) {
+        *_errno = wiznet5k_errno(ret);
+        return -1;
+    }
+    return 0;
+}
+
+STATIC int wiznet5k_socket_accept (mod_network_socket_obj_t *s, mod_network_socket_obj_t *s2, byte *ip, mp_uint_t *port, int *_errno) {
+    uint8_t sn;
+    if (!wiznet5k_socket_get_sn(s, &sn, _errno)) {
+        return -1;
+    }
+    uint32_t start = mp_hal_ticks_ms();
+    for (;;) {
+        uint8_t sr = getSn_SR(sn);
+        if (sr == SOCK_ESTABLISHED || sr == SOCK_CLOSE_WAIT) {
+            break;
+        }
+        if (sr == SOCK_CLOSED) {
+            *_errno = MP_EINVAL;
+            return -1;
+        }
+        if (!wiznet5k_wait_event(sn, s->sock_base.timeout, start, WIZNET5K_WAIT_SLICE_MS)) {
+            *_errno = MP_EAGAIN;
+            return -1;
+        }
+    }
+
+    // the listening socket became the connection, it goes to the new socket object
+    uint8_t peer[MOD_NETWORK_IPV4ADDR_BUF_SIZE];
+    getSn_DIPR(sn, peer);
+    wiznet5k_flip_ip(ip, peer);
+    *port = getSn_DPORT(sn);
+    uint16_t local_port = getSn_PORT(sn);
+    s2->sock_base.u.sd = sn;
+    s2->sock_base.connected = true;
+
+    // and the server listens again on another hardware socket
+    s->sock_base.u.sd = -1;
+    int sn2 = wiznet5k_alloc_socket();
+    if (sn2 < 0) {
+        // the server can't accept any more until a connection is closed
+        return 0;
+    }
+    s->sock_base.u.sd = sn2;
+    wiz_cris_enter();
+    wiznet5k_obj.socket_dgram &= ~(1 << sn2);
+    wiz_cris_exit();
+    int _errno2;
+    if (wiznet5k_socket_open(s, sn2, local_port, &_errno2) == 0) {
+        WIZCHIP_EXPORT(listen)(sn2);
+    }
+    return 0;
+}
+
+STATIC int wiznet5k_connect_wait (mod_network_socket_obj_t *s, uint8_t sn, int32_t timeout, int *_errno) {
+    uint32_t start = mp_hal_ticks_ms();
+    for (;;) {
+        uint8_t ir = getSn_IR(sn);
+        uint8_t sr = getSn_SR(sn);
+        if (sr == SOCK_ESTABLISHED) {
+            s->sock_base.connected = true;
+            return 0;
+        }
+        if (sr == SOCK_CLOSED || (ir & Sn_IR_TIMEOUT)) {
+            // open it again for the next attempt
+            wiznet5k_close_sn(sn);
+            *_errno = (ir & Sn_IR_TIMEOUT) ? MP_ETIMEDOUT : MP_ECONNREFUSED;
+            return -1;
+        }
+        if (!wiznet5k_wait_event(sn, timeout, start, WIZNET5K_WAIT_SLICE_MS)) {
+            *_errno = MP_ETIMEDOUT;
+            return -1;
+        }
+    }
+}
+
+int wiznet5k_socket_connect_wait (mod_network_socket_obj_t *s, mp_int_t timeout_ms, int *_errno) {
+    uint8_t sn;
+    if (!wiznet5k_socket_get_sn(s, &sn, _errno)) {
+        return -1;
+    }
+    return wiznet5k_connect_wait(s, sn, timeout_ms, _errno);
+}
+
+STATIC int wiznet5k_socket_connect (mod_network_socket_obj_t *s, byte *ip, mp_uint_t port, int *_errno) {
+    uint8_t sn;
+    if (!wiznet5k_socket_get_sn(s, &sn, _errno)) {
+        return -1;
+    }
+    if (wiznet5k_socket_ensure_open(s, sn, _errno) != 0) {
+        return -1;
+    }
+    if (wiznet5k_is_dgram(sn)) {
+        // send() and recv() use the address the socket layer kept
+        s->sock_base.connected = true;
+        return 0;
+    }
+    uint8_t addr[MOD_NETWORK_IPV4ADDR_BUF_SIZE];
+    wiznet5k_flip_ip(addr, ip);
+    int8_t ret = WIZCHIP_EXPORT(connect)(sn, addr, port);
+    if (ret < 0) {
+        *_errno = wiznet5k_errno(ret);
+        return -1;
+    }
+    if (s->sock_base.timeout == 0) {
+        *_errno = MP_EINPROGRESS;
+        return -1;
+    }
+    return wiznet5k_connect_wait(s, sn, s->sock_base.timeout, _errno);
+}
+
+STATIC int wiznet5k_socket_sendto (mod_network_socket_obj_t *s, const byte *buf, mp_uint_t len, byte *ip, mp_uint_t port, int *_errno) {
+    uint8_t sn;
+    if (!wiznet5k_socket_get_sn(s, &sn, _errno)) {
+        return -1;
+    }
+    if (!wiznet5k_is_dgram(sn)) {
+        *_errno = MP_EOPNOTSUPP;
+        return -1;
+    }
+    if (wiznet5k_socket_ensure_open(s, sn, _errno) != 0) {
+        return -1;
+    }
+    if (len > getSn_TxMAX(sn)) {
+        *_errno = MP_EMSGSIZE;
+        return -1;
+    }
+    uint8_t addr[MOD_NETWORK_IPV4ADDR_BUF_SIZE];
+    wiznet5k_flip_ip(addr, ip);
+    uint32_t start = mp_hal_ticks_ms();
+    for (;;) {
+        int32_t ret = WIZCHIP_EXPORT(sendto)(sn, (uint8_t *)buf, len, addr, port);
+        if (ret > 0) {
+            return ret;
+        }
+        if (ret < 0) {
+            *_errno = wiznet5k_errno(ret);
+            return -1;
+        }
+        // the datagram doesn't fit yet, SENDOK is not an INTn source
+        if (!wiznet5k_wait_event(sn, s->sock_base.timeout, start, WIZNET5K_POLL_MS)) {
+            *_errno = MP_EAGAIN;
+            return -1;
+        }
+    }
+}
+
+STATIC int wiznet5k_socket_send (mod_network_socket_obj_t *s, const byte *buf, mp_uint_t len, int *_errno) {
+    uint8_t sn;
+    if (!wiznet5k_socket_get_sn(s, &sn, _errno)) {
+        return -1;
+    }
+    if (wiznet5k_is_dgram(sn)) {
+        return wiznet5k_socket_sendto(s, buf, len, s->sock_base.ip_addr, s->sock_base.port, _errno);
+    }
+    if (len == 0) {
+        return 0;
+    }
+    uint32_t start = mp_hal_ticks_ms();
+    for (;;) {
+        uint8_t sr = getSn_SR(sn);
+        if (sr != SOCK_ESTABLISHED && sr != SOCK_CLOSE_WAIT) {
+            *_errno = MP_ENOTCONN;
+            return -1;
+        }
+        // as much as fits in the TX buffer, like a non blocking socket of lwIP
+        uint16_t free = getSn_TX_FSR(sn);
+        if (free > 0) {
+            int32_t ret = WIZCHIP_EXPORT(send)(sn, (uint8_t *)buf, MIN(len, free));
+            if (ret > 0) {
+                return ret;
+            }
+            if (ret < 0) {
+                *_errno = wiznet5k_errno(ret);
+                return -1;
+            }
+        }
+        // the previous segment is still going out
+        if (!wiznet5k_wait_event(sn, s->sock_base.timeout, start, WIZNET5K_POLL_MS)) {
+            *_errno = MP_EAGAIN;
+            return -1;
+        }
+    }
+}
+
+STATIC int wiznet5k_socket_recvfrom (mod_network_socket_obj_t *s, byte *buf, mp_uint_t len, byte *ip, mp_uint_t *port, int *_errno) {
+    uint8_t sn;
+    if (!wiznet5k_socket_get_sn(s, &sn, _errno)) {
+        return -1;
+    }
+    if (!wiznet5k_is_dgram(sn)) {
+        *_errno = MP_EOPNOTSUPP;
+        return -1;
+    }
+    if (wiznet5k_socket_ensure_open(s, sn, _errno) != 0) {
+        return -1;
+    }
+    uint32_t start = mp_hal_ticks_ms();
+    while (getSn_RX_RSR(sn) == 0) {
+        if (!wiznet5k_wait_event(sn, s->sock_base.timeout, start, WIZNET5K_WAIT_SLICE_MS)) {
+            *_errno = MP_EAGAIN;
+            return -1;
+        }
+    }
+    uint8_t addr[MOD_NETWORK_IPV4ADDR_BUF_SIZE];
+    uint16_t peer_port;
+    int32_t ret = 0;
+    if (len > 0) {
+        ret = WIZCHIP_EXPORT(recvfrom)(sn, buf, MIN(len, UINT16_MAX), addr, &peer_port);
+        if (ret < 0) {
+            *_errno = wiznet5k_errno(ret);
+            return -1;
+        }
+    }
+    // what didn't fit is discarded, one datagram per call like lwIP
+    uint16_t remain;
+    while (WIZCHIP_EXPORT(getsockopt)(sn, SO_REMAINSIZE, &remain) == SOCK_OK && remain > 0) {
+        uint8_t drain[WIZNET5K_UDP_DRAIN_CHUNK];
+        if (WIZCHIP_EXPORT(recvfrom)(sn, drain, MIN(remain, sizeof(drain)), addr, &peer_port) <= 0) {
+            break;
+        }
+    }
+    if (ip) {
+        wiznet5k_flip_ip(ip, addr);
+        *port = peer_port;
+    }
+    return ret;
+}
+
+STATIC int wiznet5k_socket_recv (mod_network_socket_obj_t *s, byte *buf, mp_uint_t len, int *_errno) {
+    uint8_t sn;
+    if (!wiznet5k_socket_get_sn(s, &sn, _errno)) {
+        return -1;
+    }
+    if (wiznet5k_is_dgram(sn)) {
+        return wiznet5k_socket_recvfrom(s, buf, len, NULL, NULL, _errno);
+    }
+    if (s->sock_base.rx_size > 0) {
+        len = MIN(len, s->sock_base.rx_size);
+    }
+    uint32_t start = mp_hal_ticks_ms();
+    while (getSn_RX_RSR(sn) == 0) {
+        uint8_t sr = getSn_SR(sn);
+        if (sr == SOCK_CLOSE_WAIT || (sr == SOCK_CLOSED && s->sock_base.connected)) {
+            // orderly shutdown by the peer
+            return 0;
+        }
+        if (sr != SOCK_ESTABLISHED) {
+            *_errno = MP_ENOTCONN;
+            return -1;
+        }
+        if (!wiznet5k_wait_event(sn, s->sock_base.timeout, start, WIZNET5K_WAIT_SLICE_MS)) {
+            *_errno = MP_EAGAIN;
+            return -1;
+        }
+    }
+    if (len == 0) {
+        return 0;
+    }
+    int32_t ret = WIZCHIP_EXPORT(recv)(sn, buf, MIN(len, UINT16_MAX));
+    if (ret < 0) {
+        *_errno = wiznet5k_errno(ret);
+        return -1;
+    }
+    return ret;
+}
+
+STATIC int wiznet5k_socket_setsockopt (mod_network_socket_obj_t *s, mp_uint_t level, mp_uint_t opt, const void *optval, mp_uint_t optlen, int *_errno) {
+    uint8_t sn;
+    if (!wiznet5k_socket_get_sn(s, &sn, _errno)) {
+        return -1;
+    }
+    uint32_t value = (optlen >= sizeof(uint32_t)) ? *(const uint32_t *)optval : 0;
+    if (level == SOL_SOCKET && opt == SO_REUSEADDR) {
+        // every hardware socket has its own port anyway
+        return 0;
+    } else if (level == SOL_SOCKET && opt == SO_KEEPALIVE) {
+        uint8_t period = value ? WIZNET5K_KEEPALIVE_5S : 0;
+        wiz_cris_enter();
+        setSn_KPALVTR(sn, period);
+        wiz_cris_exit();
+        return 0;
+    } else if (level == IPPROTO_IP && opt == IP_TTL) {
+        wiz_cris_enter();
+        setSn_TTL(sn, value);
+        wiz_cris_exit();
+        return 0;
+    }
+    *_errno = MP_EOPNOTSUPP;
+    return -1;
+}
+
+STATIC int wiznet5k_socket_settimeout (mod_network_socket_obj_t *s, mp_int_t timeout_ms, int *_errno) {
+    // the chip sockets all stay non blocking, the waiting is done by the calls above
+    s->sock_base.timeout = timeout_ms;
+    return 0;
+}
+
+STATIC int wiznet5k_socket_ioctl (mod_network_socket_obj_t *s, mp_uint_t request, mp_uint_t arg, int *_errno) {
+    uint8_t sn;
+    if (request != MP_STREAM_POLL) {
+        *_errno = MP_EINVAL;
+        return MP_STREAM_ERROR;
+    }
+    if (!wiznet5k_socket_get_sn(s, &sn, _errno)) {
+        return MP_STREAM_POLL_NVAL;
+    }
+    int ret = 0;
+    uint8_t sr = getSn_SR(sn);
+    if (arg & MP_STREAM_POLL_RD) {
+        // data, a connection to accept, or the end of the stream
+        if (getSn_RX_RSR(sn) > 0 || sr == SOCK_CLOSE_WAIT ||
+            (sr == SOCK_ESTABLISHED && !s->sock_base.connected && !wiznet5k_is_dgram(sn))) {
+            ret |= MP_STREAM_POLL_RD;
+        }
+    }
+    if (arg & MP_STREAM_POLL_WR) {
+        if ((sr == SOCK_ESTABLISHED || sr == SOCK_UDP) && getSn_TX_FSR(sn) > 0) {
+            ret |= MP_STREAM_POLL_WR;
+        }
+    }
+    if (sr == SOCK_CLOSED && s->sock_base.connected) {
+        ret |= MP_STREAM_POLL_HUP;
+    }
+    return ret;
+}
+
+STATIC int wiznet5k_socket_setupssl (mod_network_socket_obj_t *s, int *_errno) {
+    // the TLS records would have to go through mbedTLS, which only knows lwIP sockets
+    *_errno = MP_EOPNOTSUPP;
+    return -1;
+}
+
+STATIC bool wiznet5k_inf_up (void) {
+    return wiznet5k_obj.enabled && wizphy_getphylink() == PHY_LINK_ON;
+}
+
+STATIC void wiznet5k_set_default_inf (void) {
+    // not an lwIP interface, the sockets are picked by mod_network_find_nic()
+}
+
+STATIC void wiznet5k_hw_deinit (wiznet5k_obj_t *self) {
+    if (!self->enabled) {
+        return;
+    }
+    mod_network_deregister_nic(self);
+    for (uint8_t sn = 0; sn < _WIZCHIP_SOCK_NUM_; sn++) {
+        wiznet5k_close_sn(sn);
+    }
+    if (self->int_pin) {
+        pin_irq_disable(self->int_pin);
+        machpin_register_irq_c_handler(self->int_pin, NULL);
+        self->int_pin = NULL;
+    }
+    self->enabled = false;
+    spi_bus_remove_device(self->dev);
+    spi_bus_free(self->host);
+    heap_caps_free(self->dma_buf);
+    self->dma_buf = NULL;
+    self->socket_used = 0;
+    if (self->rst) {
+        // held in reset, which is the lowest power state of the chip
+        self->rst->value = 0;
+        pin_set_value(self->rst);
+    }
+}
+
+STATIC wiznet5k_obj_t *wiznet5k_get_self (mp_obj_t self_in) {
+    wiznet5k_obj_t *self = self_in;
+    if (!self->enabled) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable);
+    }
+    return self;
+}
+
+STATIC mp_obj_t wiznet5k_init_helper (wiznet5k_obj_t *self, const mp_arg_val_t *args) {
+    mp_int_t baudrate = args[0].u_int;
+    if (baudrate <= 0 || baudrate > WIZNET5K_BAUDRATE_MAX) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    mp_obj_t *pins = (mp_obj_t *)wiznet5k_def_pin;
+    if (args[1].u_obj != MP_OBJ_NULL) {
+        mp_obj_get_array_fixed_n(args[1].u_obj, 3, &pins);
+    }
+    if (args[2].u_obj == MP_OBJ_NULL) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    spi_bus_config_t bus_config = {
+        .sclk_io_num = pin_find(pins[0])->pin_number,
+        .mosi_io_num = pin_find(pins[1])->pin_number,
+        .miso_io_num = pin_find(pins[2])->pin_number,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .max_transfer_sz = WIZNET5K_DMA_BUF_SIZE,
+    };
+    spi_device_interface_config_t dev_config = {
+        .mode = 0,
+        .clock_speed_hz = baudrate,
+        .spics_io_num = pin_find(args[2].u_obj)->pin_number,
+        .queue_size = 1,
+        // a frame either writes or reads after its address phase
+        .flags = SPI_DEVICE_HALFDUPLEX,
+    };
+    pin_obj_t *rst = (args[3].u_obj == mp_const_none) ? NULL : pin_find(args[3].u_obj);
+    pin_obj_t *int_pin = (args[4].u_obj == mp_const_none) ? NULL : pin_find(args[4].u_obj);
+
+    wiznet5k_hw_deinit(self);
+    if (self->mutex == NULL) {
+        self->mutex = xSemaphoreCreateRecursiveMutex();
+        self->dns_mutex = xSemaphoreCreateMutex();
+        for (uint8_t sn = 0; sn < _WIZCHIP_SOCK_NUM_; sn++) {
+            self->sn_sem[sn] = xSemaphoreCreateBinary();
+        }
+    }
+    self->dma_buf = heap_caps_malloc(WIZNET5K_DMA_BUF_SIZE, MALLOC_CAP_DMA);
+    if (self->dma_buf == NULL) {
+        mp_raise_OSError(MP_ENOMEM);
+    }
+    // the host has its own DMA channel
+    if (spi_bus_initialize(self->host, &bus_config, self->host) != ESP_OK) {
+        heap_caps_free(self->dma_buf);
+        self->dma_buf = NULL;
+        mp_raise_msg(&mp_type_OSError, mpexception_os_operation_failed);
+    }
+    if (spi_bus_add_device(self->host, &dev_config, &self->dev) != ESP_OK) {
+        spi_bus_free(self->host);
+        heap_caps_free(self->dma_buf);
+        self->dma_buf = NULL;
+        mp_raise_msg(&mp_type_OSError, mpexception_os_operation_failed);
+    }
+    self->enabled = true;
+
+    self->rst = rst;
+    if (rst) {
+        pin_config(rst, -1, -1, GPIO_MODE_OUTPUT, MACHPIN_PULL_NONE, 0);
+        mp_hal_delay_ms(1);     // the datasheet asks for 500 us
+        rst->value = 1;
+        pin_set_value(rst);
+        mp_hal_delay_ms(60);    // and 50 ms until the PLL locks
+    }
+
+    reg_wizchip_cris_cbfunc(wiz_cris_enter, wiz_cris_exit);
+    reg_wizchip_cs_cbfunc(wiz_cs_select, wiz_cs_deselect);
+    reg_wizchip_spi_cbfunc(wiz_spi_read, wiz_spi_write);
+
+    MP_THREAD_GIL_EXIT();
+    bool found = (getVERSIONR() == WIZNET5K_VERSION);
+    if (found) {
+        uint8_t sn_size[_WIZCHIP_SOCK_NUM_ * 2];
+        memset(sn_size, WIZNET5K_SOCKET_BUF_KB, sizeof(sn_size));
+        ctlwizchip(CW_INIT_WIZCHIP, sn_size);
+        // the waiting threads unmask their own sockets
+        setSIMR(0);
+        for (uint8_t sn = 0; sn < _WIZCHIP_SOCK_NUM_; sn++) {
+            setSn_IMR(sn, 0);
+            setSn_IR(sn, 0xFF);
+        }
+    }
+    MP_THREAD_GIL_ENTER();
+    if (!found) {
+        wiznet5k_hw_deinit(self);
+        mp_raise_msg(&mp_type_OSError, mpexception_os_operation_failed);
+    }
+
+    // the MAC address of the ESP32 set aside for Ethernet, a static address until ifconfig()
+    wiz_NetInfo netinfo = {
+        .ip = {192, 168, 0, 18},
+        .sn = {255, 255, 255, 0},
+        .gw = {192, 168, 0, 1},
+        .dns = {8, 8, 8, 8},
+        .dhcp = NETINFO_STATIC,
+    };
+    esp_read_mac(netinfo.mac, ESP_MAC_ETH);
+    ctlnetwork(CN_SET_NETINFO, &netinfo);
+
+    if (int_pin) {
+        self->int_pin = int_pin;
+        pin_config(int_pin, -1, -1, GPIO_MODE_INPUT, MACHPIN_PULL_UP, 0);
+        pin_extint_register(int_pin, GPIO_INTR_NEGEDGE, 0);
+        machpin_register_irq_c_handler(int_pin, (void *)wiznet5k_intr_handler);
+        pin_irq_enable(int_pin);
+    }
+
+    mod_network_register_nic(self);
+    return mp_const_none;
+}
+
+/******************************************************************************/
+// MicroPython bindings
+
+/// \class WIZNET5K(id=0, *, baudrate=20000000, pins=(CLK, MOSI, MISO), cs, rst=None, int_pin=None)
+/// A W5500 on the SPI bus, its 8 hardware sockets take the AF_INET sockets of usocket
+/// while it is initialised, lwIP is not involved. With int_pin the blocking calls
+/// sleep until the chip raises INTn, without it they poll. The SPI host is taken over.
+STATIC const mp_arg_t wiznet5k_init_args[] = {
+    { MP_QSTR_id,                          MP_ARG_INT, {.u_int = 0} },
+    { MP_QSTR_baudrate,                    MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = WIZNET5K_BAUDRATE_DEFAULT} },
+    { MP_QSTR_pins,                        MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+    { MP_QSTR_cs,                          MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+    { MP_QSTR_rst,                         MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+    { MP_QSTR_int_pin,                     MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+};
+STATIC mp_obj_t wiznet5k_make_new (const mp_obj_type_t *type, mp_uint_t n_args, mp_uint_t n_kw, const mp_obj_t *all_args) {
+    mp_map_t kw_args;
+    mp_map_init_fixed_table(&kw_args, n_kw, all_args + n_args);
+    mp_arg_val_t args[MP_ARRAY_SIZE(wiznet5k_init_args)];
+    mp_arg_parse_all(n_args, all_args, &kw_args, MP_ARRAY_SIZE(args), wiznet5k_init_args, args);
+
+    if (args[0].u_int != 0) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable);
+    }
+    wiznet5k_obj_t *self = &wiznet5k_obj;
+    self->base.type = (mp_obj_type_t *)&mod_network_nic_type_wiznet5k;
+    wiznet5k_init_helper(self, &args[1]);
+    return self;
+}
+
+STATIC mp_obj_t wiznet5k_init (mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    mp_arg_val_t args[MP_ARRAY_SIZE(wiznet5k_init_args) - 1];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), &wiznet5k_init_args[1], args);
+    return wiznet5k_init_helper(pos_args[0], args);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(wiznet5k_init_obj, 1, wiznet5k_init);
+
+STATIC mp_obj_t wiznet5k_deinit (mp_obj_t self_in) {
+    wiznet5k_hw_deinit(self_in);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(wiznet5k_deinit_obj, wiznet5k_deinit);
+
+/// \method ifconfig(config=None)
+/// Gets or sets (ip, subnet, gateway, dns), only static addresses are supported.
+STATIC mp_obj_t wiznet5k_ifconfig (mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t wiznet5k_ifconfig_args[] = {
+        { MP_QSTR_config,           MP_ARG_OBJ,     {.u_obj = MP_OBJ_NULL} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(wiznet5k_ifconfig_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), wiznet5k_ifconfig_args, args);
+    wiznet5k_get_self(pos_args[0]);
+
+    wiz_NetInfo netinfo;
+    ctlnetwork(CN_GET_NETINFO, &netinfo);
+    if (args[0].u_obj == MP_OBJ_NULL) {
+        mp_obj_t ifconfig[4] = {
+            netutils_format_ipv4_addr(netinfo.ip, NETUTILS_BIG),
+            netutils_format_ipv4_addr(netinfo.sn, NETUTILS_BIG),
+            netutils_format_ipv4_addr(netinfo.gw, NETUTILS_BIG),
+            netutils_format_ipv4_addr(netinfo.dns, NETUTILS_BIG),
+        };
+        return mp_obj_new_tuple(4, ifconfig);
+    }
+    if (!MP_OBJ_IS_TYPE(args[0].u_obj, &mp_type_tuple)) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    mp_obj_t *items;
+    mp_obj_get_array_fixed_n(args[0].u_obj, 4, &items);
+    netutils_parse_ipv4_addr(items[0], netinfo.ip, NETUTILS_BIG);
+    netutils_parse_ipv4_addr(items[1], netinfo.sn, NETUTILS_BIG);
+    netutils_parse_ipv4_addr(items[2], netinfo.gw, NETUTILS_BIG);
+    netutils_parse_ipv4_addr(items[3], netinfo.dns, NETUTILS_BIG);
+    ctlnetwork(CN_SET_NETINFO, &netinfo);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(wiznet5k_ifconfig_obj, 1, wiznet5k_ifconfig);
+
+STATIC mp_obj_t wiznet5k_isconnected (mp_obj_t self_in) {
+    wiznet5k_obj_t *self = self_in;
+    if (!self->enabled) {
+        return mp_const_false;
+    }
+    wiz_NetInfo netinfo;
+    ctlnetwork(CN_GET_NETINFO, &netinfo);
+    uint32_t ip;
+    memcpy(&ip, netinfo.ip, sizeof(ip));
+    return mp_obj_new_bool(wiznet5k_inf_up() && ip != 0);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(wiznet5k_isconnected_obj, wiznet5k_isconnected);
+
+STATIC mp_obj_t wiznet5k_mac (mp_obj_t self_in) {
+    wiznet5k_get_self(self_in);
+    wiz_NetInfo netinfo;
+    ctlnetwork(CN_GET_NETINFO, &netinfo);
+    return mp_obj_new_bytes(netinfo.mac, sizeof(netinfo.mac));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(wiznet5k_mac_obj, wiznet5k_mac);
+
+STATIC const mp_map_elem_t wiznet5k_locals_dict_table[] = {
+    { MP_OBJ_NEW_QSTR(MP_QSTR_init),                (mp_obj_t)&wiznet5k_init_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_deinit),              (mp_obj_t)&wiznet5k_deinit_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_ifconfig),            (mp_obj_t)&wiznet5k_ifconfig_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_isconnected),         (mp_obj_t)&wiznet5k_isconnected_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_mac),                 (mp_obj_t)&wiznet5k_mac_obj },
+};
+STATIC MP_DEFINE_CONST_DICT(wiznet5k_locals_dict, wiznet5k_locals_dict_table);
+
+const mod_network_nic_type_t mod_network_nic_type_wiznet5k = {
+    .base = {
+        { &mp_type_type },
+        .name = MP_QSTR_WIZNET5K,
+        .make_new = wiznet5k_make_new,
+        .locals_dict = (mp_obj_t)&wiznet5k_locals_dict,
+    },
+
+    .n_gethostbyname = wiznet5k_gethostbyname,
+    .n_socket = wiznet5k_socket_socket,
+    .n_close = wiznet5k_socket_close,
+    .n_bind = wiznet5k_socket_bind,
+    .n_listen = wiznet5k_socket_listen,
+    .n_accept = wiznet5k_socket_accept,
+    .n_connect = wiznet5k_socket_connect,
+    .n_send = wiznet5k_socket_send,
+    .n_recv = wiznet5k_socket_recv,
+    .n_sendto = wiznet5k_socket_sendto,
+    .n_recvfrom = wiznet5k_socket_recvfrom,
+    .n_setsockopt = wiznet5k_socket_setsockopt,
+    .n_settimeout = wiznet5k_socket_settimeout,
+    .n_ioctl = wiznet5k_socket_ioctl,
+    .n_setupssl = wiznet5k_socket_setupssl,
+    .inf_up = wiznet5k_inf_up,
+    .set_default_inf = wiznet5k_set_default_inf,
+    .stats = &wiznet5k_stats
+};
@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#ifndef MODWIZNET5K_H_
+#define MODWIZNET5K_H_
+
+#include "modnetwork.h"
+
+extern const mod_network_nic_type_t mod_network_nic_type_wiznet5k;
+
+extern bool wiznet5k_is_enabled (void);
+extern int wiznet5k_socket_connect_wait (mod_network_socket_obj_t *s, mp_int_t timeout_ms, int *_errno);
+
+#endif  // MODWIZNET5K_H_
@@ -9,6 +9,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -22,6 +23,7 @@
 #include "py/misc.h"
 
 #include "esp_heap_caps.h"
+#include "esp_attr.h"
 #include "sdkconfig.h"
 #include "esp_system.h"
 #include "esp_spi_flash.h"
@@ -34,6 +36,10 @@
 #include "vfs_littlefs.h"
 #include "esp_wpa2.h"
 #include "esp_smartconfig.h"
+#include "rom/crc.h"
+#include "mbedtls/md.h"
+#include "mbedtls/pkcs5.h"
+#include "mbedtls/sha256.h"
 
 //#include "timeutils.h"
 #include "netutils.h"
@@ -64,6 +70,64 @@
 /******************************************************************************
  DEFINE TYPES
  ******************************************************************************/
+// one frame in the capture ring, the payload follows and the record is padded to 4 bytes
+typedef struct {
+    uint16_t    caplen;         // WLAN_CAP_WRAP marks the unused tail of the buffer
+    uint16_t    origlen;
+    uint32_t    timestamp;
+    int8_t      rssi;
+    uint8_t     channel;
+    uint8_t     pkt_type;
+    uint8_t     reserved;
+} wlan_cap_hdr_t;
+
+// a compiled filter term, all of them must match for a frame to be captured
+typedef struct {
+    uint8_t     field;
+    bool        negate;
+    uint8_t     addr[6];
+    int32_t     value;
+} wlan_cap_rule_t;
+
+// pcap record header followed by a minimal radiotap header (channel and antenna signal)
+typedef struct __attribute__((packed)) {
+    uint32_t    ts_sec;
+    uint32_t    ts_usec;
+    uint32_t    incl_len;
+    uint32_t    orig_len;
+    uint8_t     rt_version;
+    uint8_t     rt_pad;
+    uint16_t    rt_len;
+    uint32_t    rt_present;
+    uint16_t    rt_freq;
+    uint16_t    rt_flags;
+    int8_t      rt_signal;
+} wlan_pcap_rec_t;
+
+// what the last connection to a WPA/WPA2 personal network needed, kept across deep sleep
+typedef struct {
+    uint32_t    magic;
+    uint8_t     ssid[32];
+    uint8_t     key_hash[32];   // SHA-256 of the passphrase the PMK was derived from
+    uint8_t     pmk[32];
+    uint8_t     bssid[6];
+    uint8_t     channel;        // 0 until a connection went through
+    uint32_t    crc;
+} wlan_fast_conn_t;
+
+// the settings of a scan, kept for the asynchronous ones and their later channels
+typedef struct {
+    wifi_scan_config_t config;
+    uint8_t     ssid[33];
+    uint8_t     bssid[6];
+    uint8_t     channels[14];   // MAX_WIFI_CHANNELS
+    uint8_t     n_channels;
+    uint8_t     next_channel;
+    char        prefix[33];
+    uint8_t     prefix_len;
+    int8_t      min_rssi;
+    volatile bool busy;         // an asynchronous scan is running
+} wlan_scan_req_t;
 
 /******************************************************************************
  DEFINE CONSTANTS
@@ -78,6 +142,29 @@
 
 #define MAX_WIFI_PKT_PARAMS                    18
 
+#define WLAN_CAP_RING_SIZE                      (16 * 1024)
+#define WLAN_CAP_RING_SIZE_PSRAM                (256 * 1024)
+#define WLAN_CAP_SNAPLEN_DEF                    (512)
+#define WLAN_CAP_RULES_MAX                      (8)
+#define WLAN_CAP_WRAP                           (0xFFFF)
+#define WLAN_CAP_ALIGN(len)                     (((len) + 3) & ~3)
+
+#define WLAN_CAP_FIELD_TYPE                     (0)     // mask of EVENT_PKT_xxx
+#define WLAN_CAP_FIELD_SUBTYPE                  (1)     // first frame control byte, type and subtype bits
+#define WLAN_CAP_FIELD_ADDR1                    (2)
+#define WLAN_CAP_FIELD_ADDR2                    (3)
+#define WLAN_CAP_FIELD_ADDR3                    (4)
+#define WLAN_CAP_FIELD_ANY_ADDR                 (5)
+#define WLAN_CAP_FIELD_MIN_LEN                  (6)
+#define WLAN_CAP_FIELD_MAX_LEN                  (7)
+#define WLAN_CAP_FIELD_MIN_RSSI                 (8)
+
+#define WLAN_PCAP_LINKTYPE_RADIOTAP             (127)
+#define WLAN_PCAP_RADIOTAP_LEN                  (13)
+
+#define WLAN_FAST_CONN_MAGIC                    (0x57464331)    // "WFC1"
+#define WLAN_PMK_ITERATIONS                     (4096)
+
 #define SMART_CONF_TASK_STACK_SIZE              4096
 
 #define SMART_CONF_TASK_PRIORITY                5
@@ -112,6 +199,15 @@ static int32_t wlan_conn_recover_timeout;
 static uint8_t wlan_conn_recover_scan_channel;
 static bool wlan_conn_recover_hidden = false;
 
+// the channel, BSSID and PMK of the last AP, so that a wake from deep sleep can
+// go straight to it instead of scanning every channel and running PBKDF2 again
+static RTC_DATA_ATTR wlan_fast_conn_t wlan_fast_conn;
+// the current attempt was set up from the cache, and targets the cached AP
+static bool wlan_fast_conn_used = false;
+static volatile bool wlan_fast_conn_pinned = false;
+
+static wlan_scan_req_t wlan_scan_req;
+
 static wlan_wpa2_ent_obj_t wlan_wpa2_ent;
 static TimerHandle_t wlan_conn_timeout_timer = NULL;
 static TimerHandle_t wlan_smartConfig_timeout = NULL;
@@ -120,6 +216,19 @@ static wlan_internal_prom_t wlan_prom_packet[2];
 
 static uint8_t token = 0;
 
+// capture ring, written by the Wi-Fi task and read by capture_read()
+static uint8_t *wlan_cap_buf = NULL;
+static uint32_t wlan_cap_size;
+static uint32_t wlan_cap_head;
+static uint32_t wlan_cap_tail;
+static uint32_t wlan_cap_used;
+static uint32_t wlan_cap_captured;
+static uint32_t wlan_cap_dropped;
+static uint16_t wlan_cap_snaplen = WLAN_CAP_SNAPLEN_DEF;
+static uint8_t wlan_cap_nrules;
+static wlan_cap_rule_t wlan_cap_rules[WLAN_CAP_RULES_MAX];
+static portMUX_TYPE wlan_cap_mux = portMUX_INITIALIZER_UNLOCKED;
+
 // Event bits
 const int CONNECTED_BIT = BIT0;
 
@@ -159,6 +268,7 @@ STATIC uint32_t wlan_set_ssid_internal (const char *ssid, uint8_t len, bool add_
 STATIC void wlan_validate_security (uint8_t auth, const char *key);
 STATIC void wlan_set_security_internal (uint8_t auth, const char *key);
 STATIC void wlan_validate_channel (uint8_t channel);
+STATIC void wlan_scan_done (void *arg);
 STATIC void wlan_set_antenna (uint8_t antenna);
 static esp_err_t wlan_event_handler(void *ctx, system_event_t *event);
 STATIC void wlan_do_connect (const char* ssid, const char* bssid, const wifi_auth_mode_t auth, const char* key, int32_t timeout, const wlan_wpa2_ent_obj_t * const wpa2_ent, const char *hostname, uint8_t channel);
@@ -172,6 +282,8 @@ STATIC void wlan_stop_smartConfig_timer();
 static void smart_config_callback(smartconfig_status_t status, void *pdata);
 static void TASK_SMART_CONFIG (void *pvParameters);
 STATIC void wlan_callback_handler(void* arg);
+STATIC void wlan_capture_put(const wifi_promiscuous_pkt_t *pkt, wifi_promiscuous_pkt_type_t type);
+STATIC void wlan_capture_free(void);
 //*****************************************************************************
 //
 //! \brief The Function Handles WLAN Events
@@ -364,6 +476,86 @@ STATIC bool wlan_is_inf_up(void)
 	return is_inf_up;
 }
 
+STATIC uint32_t wlan_fast_conn_crc (void) {
+    return crc32_le(UINT32_MAX, (const uint8_t *)&wlan_fast_conn, offsetof(wlan_fast_conn_t, crc));
+}
+
+STATIC void wlan_fast_conn_save (void) {
+    wlan_fast_conn.magic = WLAN_FAST_CONN_MAGIC;
+    wlan_fast_conn.crc = wlan_fast_conn_crc();
+}
+
+// only a passphrase gets here, a key of 64 hex digits already is the PSK
+STATIC bool wlan_fast_conn_allowed (wifi_auth_mode_t auth, const char *key, const char *bssid, uint8_t channel) {
+    if (auth != WIFI_AUTH_WPA_PSK && auth != WIFI_AUTH_WPA2_PSK && auth != WIFI_AUTH_WPA_WPA2_PSK) {
+        return false;
+    }
+    size_t len = key ? strlen(key) : 0;
+    // an AP chosen by the caller is left alone
+    return len >= 8 && len <= 63 && bssid == NULL && channel == 0;
+}
+
+STATIC bool wlan_derive_pmk (const uint8_t *ssid, size_t ssid_len, const char *key, uint8_t *pmk) {
+    mbedtls_md_context_t ctx;
+    mbedtls_md_init(&ctx);
+    bool ok = mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA1), 1) == 0 &&
+              mbedtls_pkcs5_pbkdf2_hmac(&ctx, (const unsigned char *)key, strlen(key), ssid, ssid_len,
+                                        WLAN_PMK_ITERATIONS, 32, pmk) == 0;
+    mbedtls_md_free(&ctx);
+    return ok;
+}
+
+// puts the PMK in place of the passphrase, derived once per SSID and passphrase,
+// and targets the AP of the last connection when there was one
+STATIC void wlan_fast_conn_setup (wifi_config_t *wifi_config, const char *key) {
+    uint8_t key_hash[32];
+    mbedtls_sha256_ret((const unsigned char *)key, strlen(key), key_hash, 0);
+    const uint8_t *ssid = wifi_config->sta.ssid;
+    size_t ssid_len = strnlen((const char *)ssid, sizeof(wifi_config->sta.ssid));
+
+    if (wlan_fast_conn.magic != WLAN_FAST_CONN_MAGIC || wlan_fast_conn.crc != wlan_fast_conn_crc() ||
+        memcmp(wlan_fast_conn.ssid, ssid, sizeof(wlan_fast_conn.ssid)) || memcmp(wlan_fast_conn.key_hash, key_hash, sizeof(key_hash))) {
+        memset(&wlan_fast_conn, 0, sizeof(wlan_fast_conn));
+        if (!wlan_derive_pmk(ssid, ssid_len, key, wlan_fast_conn.pmk)) {
+            return;
+        }
+        memcpy(wlan_fast_conn.ssid, ssid, sizeof(wlan_fast_conn.ssid));
+        memcpy(wlan_fast_conn.key_hash, key_hash, sizeof(key_hash));
+        wlan_fast_conn_save();
+    }
+
+    // 64 hex digits are taken by the driver as the PSK itself
+    for (size_t i = 0; i < sizeof(wlan_fast_conn.pmk); i++) {
+        static const char hex[] = "0123456789abcdef";
+        wifi_config->sta.password[2 * i] = hex[wlan_fast_conn.pmk[i] >> 4];
+        wifi_config->sta.password[2 * i + 1] = hex[wlan_fast_conn.pmk[i] & 0x0F];
+    }
+    wlan_fast_conn_used = true;
+
+    if (wlan_fast_conn.channel != 0) {
+        memcpy(wifi_config->sta.bssid, wlan_fast_conn.bssid, sizeof(wifi_config->sta.bssid));
+        wifi_config->sta.bssid_set = true;
+        wifi_config->sta.channel = wlan_fast_conn.channel;
+        wifi_config->sta.scan_method = WIFI_FAST_SCAN;
+        wlan_fast_conn_pinned = true;
+    }
+}
+
+// the cached AP is gone or moved, the next attempts scan all channels again
+STATIC void wlan_fast_conn_unpin (void) {
+    wifi_config_t wifi_config;
+    wlan_fast_conn_pinned = false;
+    wlan_fast_conn.channel = 0;
+    wlan_fast_conn_save();
+    if (esp_wifi_get_config(WIFI_IF_STA, &wifi_config) == ESP_OK) {
+        wifi_config.sta.bssid_set = false;
+        wifi_config.sta.channel = 0;
+        wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        wifi_config.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+        esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    }
+}
+
 STATIC esp_err_t wlan_event_handler(void *ctx, system_event_t *event) {
     switch(event->event_id) {
         case SYSTEM_EVENT_STA_START: /**< ESP32 station start */
@@ -380,6 +572,11 @@ STATIC esp_err_t wlan_event_handler(void *ctx, system_event_t *event) {
             wlan_obj.channel = _event->channel;
             wlan_obj.auth = _event->authmode;
             wlan_obj.disconnected = false;
+            if (wlan_fast_conn_used && wlan_fast_conn.magic == WLAN_FAST_CONN_MAGIC) {
+                memcpy(wlan_fast_conn.bssid, _event->bssid, sizeof(wlan_fast_conn.bssid));
+                wlan_fast_conn.channel = _event->channel;
+                wlan_fast_conn_save();
+            }
             /* Stop Conn timeout counter*/
             wlan_stop_sta_conn_timer();
         }
@@ -397,6 +594,18 @@ STATIC esp_err_t wlan_event_handler(void *ctx, system_event_t *event) {
             xEventGroupClearBits(wifi_event_group, CONNECTED_BIT);
             system_event_sta_disconnected_t *disconn = &event->event_info.disconnected;
         	is_inf_up = false;
+            if (wlan_fast_conn_pinned) {
+                switch (disconn->reason) {
+                    case WIFI_REASON_NO_AP_FOUND:
+                    case WIFI_REASON_BEACON_TIMEOUT:
+                    case WIFI_REASON_ASSOC_FAIL:
+                    case WIFI_REASON_AUTH_EXPIRE:
+                        wlan_fast_conn_unpin();
+                        break;
+                    default:
+                        break;
+                }
+            }
             switch (disconn->reason) {
                 case WIFI_REASON_AUTH_FAIL:
                 case WIFI_REASON_ASSOC_LEAVE:
@@ -435,8 +644,12 @@ STATIC esp_err_t wlan_event_handler(void *ctx, system_event_t *event) {
                 xEventGroupClearBits(wifi_event_group, CONNECTED_BIT);
             }
             break;
-        case SYSTEM_EVENT_WIFI_READY:                /**< ESP32 WiFi ready */
         case SYSTEM_EVENT_SCAN_DONE:                /**< ESP32 finish scanning AP */
+            if (wlan_scan_req.busy) {
+                mp_irq_queue_interrupt_non_ISR(wlan_scan_done, &wlan_scan_req);
+            }
+            break;
+        case SYSTEM_EVENT_WIFI_READY:                /**< ESP32 WiFi ready */
         case SYSTEM_EVENT_STA_AUTHMODE_CHANGE:      /**< the auth mode of AP connected by ESP32 station changed */
         case SYSTEM_EVENT_STA_LOST_IP:              /**< ESP32 station lost IP and the IP is reset to 0 */
         case SYSTEM_EVENT_STA_WPS_ER_SUCCESS:       /**< ESP32 station wps succeeds in enrollee mode */
@@ -756,6 +969,12 @@ STATIC void wlan_do_connect (const char* ssid, const char* bssid, const wifi_aut
         wifi_config.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
     }
 
+    wlan_fast_conn_used = false;
+    wlan_fast_conn_pinned = false;
+    if (wlan_fast_conn_allowed(auth, key, bssid, channel)) {
+        wlan_fast_conn_setup(&wifi_config, key);
+    }
+
     if (ESP_OK != esp_wifi_set_config(WIFI_IF_STA, &wifi_config)) {
         goto os_error;
     }
@@ -905,6 +1124,10 @@ STATIC void promiscuous_callback(void *buf, wifi_promiscuous_pkt_type_t type)
         break;
     }
 
+    if (wlan_cap_buf) {
+        wlan_capture_put((wifi_promiscuous_pkt_t *)buf, type);
+    }
+
     if (trigger && (token != old_token))
     {
         xSemaphoreTake(wlan_obj.mutex, portMAX_DELAY);
@@ -944,6 +1167,125 @@ STATIC void promiscuous_callback(void *buf, wifi_promiscuous_pkt_type_t type)
     }
 }
 
+STATIC uint32_t wlan_capture_type_mask(wifi_promiscuous_pkt_type_t type) {
+    switch (type) {
+    case WIFI_PKT_MGMT:
+        return MOD_WLAN_TRIGGER_PKT_MGMT;
+    case WIFI_PKT_CTRL:
+        return MOD_WLAN_TRIGGER_PKT_CTRL;
+    case WIFI_PKT_DATA:
+        return MOD_WLAN_TRIGGER_PKT_DATA;
+    default:
+        return MOD_WLAN_TRIGGER_PKT_MISC;
+    }
+}
+
+STATIC bool wlan_capture_match(const wifi_promiscuous_pkt_t *pkt, wifi_promiscuous_pkt_type_t type, uint16_t len) {
+    for (int i = 0; i < wlan_cap_nrules; i++) {
+        const wlan_cap_rule_t *rule = &wlan_cap_rules[i];
+        bool match;
+        switch (rule->field) {
+        case WLAN_CAP_FIELD_TYPE:
+            match = (wlan_capture_type_mask(type) & rule->value) != 0;
+            break;
+        case WLAN_CAP_FIELD_SUBTYPE:
+            match = len >= 1 && (pkt->payload[0] & 0xFC) == rule->value;
+            break;
+        case WLAN_CAP_FIELD_ADDR1:
+        case WLAN_CAP_FIELD_ADDR2:
+        case WLAN_CAP_FIELD_ADDR3: {
+            // the addresses start after frame control and duration
+            uint16_t offset = 4 + 6 * (rule->field - WLAN_CAP_FIELD_ADDR1);
+            match = len >= offset + 6 && !memcmp(&pkt->payload[offset], rule->addr, 6);
+            break;
+        }
+        case WLAN_CAP_FIELD_ANY_ADDR:
+            match = false;
+            for (uint16_t offset = 4; offset <= 16 && len >= offset + 6; offset += 6) {
+                if (!memcmp(&pkt->payload[offset], rule->addr, 6)) {
+                    match = true;
+                    break;
+                }
+            }
+            break;
+        case WLAN_CAP_FIELD_MIN_LEN:
+            match = pkt->rx_ctrl.sig_len >= rule->value;
+            break;
+        case WLAN_CAP_FIELD_MAX_LEN:
+            match = pkt->rx_ctrl.sig_len <= rule->value;
+            break;
+        case WLAN_CAP_FIELD_MIN_RSSI:
+            match = pkt->rx_ctrl.rssi >= rule->value;
+            break;
+        default:
+            match = true;
+            break;
+        }
+        if (match == rule->negate) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// runs in the Wi-Fi task, there's only one producer and one consumer so the copy happens outside the lock
+STATIC void wlan_capture_put(const wifi_promiscuous_pkt_t *pkt, wifi_promiscuous_pkt_type_t type) {
+    // control frames don't carry a payload we can read
+    uint16_t len = (type != WIFI_PKT_CTRL) ? pkt->rx_ctrl.sig_len : 0;
+
+    if (!wlan_capture_match(pkt, type, len)) {
+        return;
+    }
+
+    uint16_t caplen = MIN(len, wlan_cap_snaplen);
+    uint32_t reclen = WLAN_CAP_ALIGN(sizeof(wlan_cap_hdr_t) + caplen);
+
+    portENTER_CRITICAL(&wlan_cap_mux);
+    uint8_t *ring = wlan_cap_buf;
+    uint32_t tail = wlan_cap_tail;
+    uint32_t skip = (wlan_cap_size - tail < reclen) ? wlan_cap_size - tail : 0;
+    bool fits = ring && (wlan_cap_used + skip + reclen) <= wlan_cap_size;
+    if (ring && !fits) {
+        wlan_cap_dropped++;
+    }
+    portEXIT_CRITICAL(&wlan_cap_mux);
+    if (!fits) {
+        return;
+    }
+
+    if (skip) {
+        // records are kept contiguous, mark the rest of the buffer as unused
+        ((wlan_cap_hdr_t *)&ring[tail])->caplen = WLAN_CAP_WRAP;
+        tail = 0;
+    }
+    wlan_cap_hdr_t *hdr = (wlan_cap_hdr_t *)&ring[tail];
+    hdr->caplen = caplen;
+    hdr->origlen = len;
+    hdr->timestamp = pkt->rx_ctrl.timestamp;
+    hdr->rssi = pkt->rx_ctrl.rssi;
+    hdr->channel = pkt->rx_ctrl.channel;
+    hdr->pkt_type = type;
+    memcpy(hdr + 1, pkt->payload, caplen);
+
+    portENTER_CRITICAL(&wlan_cap_mux);
+    wlan_cap_tail = (tail + reclen) % wlan_cap_size;
+    wlan_cap_used += skip + reclen;
+    wlan_cap_captured++;
+    portEXIT_CRITICAL(&wlan_cap_mux);
+}
+
+STATIC void wlan_capture_free(void) {
+    portENTER_CRITICAL(&wlan_cap_mux);
+    uint8_t *buf = wlan_cap_buf;
+    wlan_cap_buf = NULL;
+    portEXIT_CRITICAL(&wlan_cap_mux);
+    if (buf) {
+        // let a callback that already picked up the buffer finish with it
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+        heap_caps_free(buf);
+    }
+}
+
 STATIC void wlan_set_default_inf(void)
 {
 #if defined(FIPY) || defined(GPY)
@@ -1303,17 +1645,102 @@ mp_obj_t wlan_deinit(mp_obj_t self_in) {
             wlan_obj.country = NULL;
         }
         wlan_obj.started = false;
+        wlan_obj.is_promiscuous = false;
+        wlan_capture_free();
         mod_network_deregister_nic(&wlan_obj);
     }
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(wlan_deinit_obj, wlan_deinit);
 
-STATIC mp_obj_t wlan_scan(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
-    STATIC const qstr wlan_scan_info_fields[] = {
-        MP_QSTR_ssid, MP_QSTR_bssid, MP_QSTR_sec, MP_QSTR_channel, MP_QSTR_rssi
-    };
+STATIC const qstr wlan_scan_info_fields[] = {
+    MP_QSTR_ssid, MP_QSTR_bssid, MP_QSTR_sec, MP_QSTR_channel, MP_QSTR_rssi
+};
 
+STATIC bool wlan_scan_match (const wlan_scan_req_t *req, const wifi_ap_record_t *ap_record) {
+    return ap_record->rssi >= req->min_rssi && !strncmp((const char *)ap_record->ssid, req->prefix, req->prefix_len);
+}
+
+// fetches the records of the scan that just finished and hands the matching ones
+// one by one to the handler, or appends them to the list when there's none
+STATIC void wlan_scan_collect (const wlan_scan_req_t *req, mp_obj_t handler, mp_obj_t nets) {
+    uint16_t ap_num = 0;
+    esp_wifi_scan_get_ap_num(&ap_num); // get the number of scanned APs
+    if (ap_num == 0) {
+        return;
+    }
+    // outside of the GC heap, only the matching APs become objects
+    wifi_ap_record_t *ap_record_buffer = malloc(ap_num * sizeof(wifi_ap_record_t));
+    if (ap_record_buffer == NULL) {
+        mp_raise_OSError(MP_ENOMEM);
+    }
+    if (ESP_OK != esp_wifi_scan_get_ap_records(&ap_num, ap_record_buffer)) {
+        ap_num = 0;
+    }
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        for (int i = 0; i < ap_num; i++) {
+            wifi_ap_record_t *ap_record = &ap_record_buffer[i];
+            if (!wlan_scan_match(req, ap_record)) {
+                continue;
+            }
+            mp_obj_t tuple[5];
+            tuple[0] = mp_obj_new_str((const char *)ap_record->ssid, strlen((char *)ap_record->ssid));
+            tuple[1] = mp_obj_new_bytes((const byte *)ap_record->bssid, sizeof(ap_record->bssid));
+            tuple[2] = mp_obj_new_int(ap_record->authmode);
+            tuple[3] = mp_obj_new_int(ap_record->primary);
+            tuple[4] = mp_obj_new_int(ap_record->rssi);
+            mp_obj_t net = mp_obj_new_attrtuple(wlan_scan_info_fields, 5, tuple);
+            if (handler != mp_const_none) {
+                mp_call_function_1(handler, net);
+            } else {
+                // add the network to the list
+                mp_obj_list_append(nets, net);
+            }
+        }
+        nlr_pop();
+        free(ap_record_buffer);
+    } else {
+        free(ap_record_buffer);
+        nlr_jump(nlr.ret_val);
+    }
+}
+
+STATIC void wlan_scan_end (void) {
+    wlan_scan_req.busy = false;
+    mp_irq_remove(&wlan_scan_req);
+}
+
+// a scan started by scan(handler=...) is done, called from the interrupts task
+STATIC void wlan_scan_done (void *arg) {
+    wlan_scan_req_t *req = arg;
+    mp_obj_tuple_t *irq = mp_irq_find(req);
+    if (irq == NULL) {
+        req->busy = false;
+        return;
+    }
+    mp_obj_t handler = irq->items[1];
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        wlan_scan_collect(req, handler, MP_OBJ_NULL);
+        nlr_pop();
+    } else {
+        wlan_scan_end();
+        nlr_jump(nlr.ret_val);
+    }
+    // on to the next of the selected channels
+    while (++req->next_channel < req->n_channels) {
+        req->config.channel = req->channels[req->next_channel];
+        if (esp_wifi_scan_start(&req->config, false) == ESP_OK) {
+            return;
+        }
+    }
+    wlan_scan_end();
+    // None marks the end of the scan
+    mp_call_function_1(handler, mp_const_none);
+}
+
+STATIC mp_obj_t wlan_scan(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     STATIC const mp_arg_t allowed_args[] = {
         { MP_QSTR_ssid,                 MP_ARG_KW_ONLY  | MP_ARG_OBJ, {.u_obj = mp_const_none} },
         { MP_QSTR_bssid,                MP_ARG_KW_ONLY  | MP_ARG_OBJ, {.u_obj = mp_const_none} },
@@ -1321,22 +1748,23 @@ STATIC mp_obj_t wlan_scan(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *
         { MP_QSTR_show_hidden,          MP_ARG_KW_ONLY  | MP_ARG_OBJ, {.u_obj = mp_const_none} },
         { MP_QSTR_type,                 MP_ARG_KW_ONLY  | MP_ARG_OBJ, {.u_obj = mp_const_none} },
         { MP_QSTR_scantime,             MP_ARG_KW_ONLY  | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_ssid_prefix,          MP_ARG_KW_ONLY  | MP_ARG_OBJ, {.u_obj = mp_const_none} },
+        { MP_QSTR_min_rssi,             MP_ARG_KW_ONLY  | MP_ARG_INT, {.u_int = -128} },
+        { MP_QSTR_handler,              MP_ARG_KW_ONLY  | MP_ARG_OBJ, {.u_obj = mp_const_none} },
     };
 
     // parse args
     mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
     mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
 
+    if (wlan_scan_req.busy) {
+        mp_raise_OSError(MP_EBUSY);
+    }
+
     /* Scan Config */
-    wifi_scan_config_t scan_config =
-    {
-        NULL,
-        NULL,
-        0,
-        false,
-        WIFI_SCAN_TYPE_ACTIVE,
-    };
-    wifi_scan_config_t * ptr_config;
+    wlan_scan_req_t *req = &wlan_scan_req;
+    memset(req, 0, sizeof(*req));
+    req->config.scan_type = WIFI_SCAN_TYPE_ACTIVE;
     mp_buffer_info_t bufinfo;
     mp_obj_t *stime;
     size_t stimelen;
@@ -1344,7 +1772,11 @@ STATIC mp_obj_t wlan_scan(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *
 
     if(args[0].u_obj != mp_const_none)
     {
-        scan_config.ssid = (uint8_t*)mp_obj_str_get_str(args[0].u_obj);
+        // copied, an asynchronous scan outlives the argument
+        size_t len;
+        const char *ssid = mp_obj_str_get_data(args[0].u_obj, &len);
+        memcpy(req->ssid, ssid, MIN(len, sizeof(req->ssid) - 1));
+        req->config.ssid = req->ssid;
     }
 
     if(args[1].u_obj != mp_const_none)
@@ -1352,7 +1784,11 @@ STATIC mp_obj_t wlan_scan(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *
         if(MP_OBJ_IS_TYPE(args[1].u_obj, &mp_type_bytes))
         {
             mp_get_buffer_raise(args[1].u_obj, &bufinfo, MP_BUFFER_READ);
-            scan_config.bssid = bufinfo.buf;
+            if (bufinfo.len != BSSID_MAX_SIZE) {
+                nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "invalid bssid"));
+            }
+            memcpy(req->bssid, bufinfo.buf, BSSID_MAX_SIZE);
+            req->config.bssid = req->bssid;
         }
         else
         {
@@ -1362,28 +1798,45 @@ STATIC mp_obj_t wlan_scan(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *
 
     if(args[2].u_obj != mp_const_none)
     {
-        scan_config.channel = mp_obj_get_int(args[2].u_obj);
+        // a single channel, or a selection of them scanned one after the other
+        if (MP_OBJ_IS_INT(args[2].u_obj)) {
+            req->channels[0] = mp_obj_get_int(args[2].u_obj);
+            req->n_channels = 1;
+        } else {
+            mp_obj_t *channels;
+            size_t n_channels;
+            mp_obj_get_array(args[2].u_obj, &n_channels, &channels);
+            if (n_channels == 0 || n_channels > MAX_WIFI_CHANNELS) {
+                nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "invalid channels"));
+            }
+            for (size_t i = 0; i < n_channels; i++) {
+                req->channels[i] = mp_obj_get_int(channels[i]);
+                wlan_validate_channel(req->channels[i]);
+            }
+            req->n_channels = n_channels;
+        }
+        req->config.channel = req->channels[0];
     }
 
     if(args[3].u_obj != mp_const_none)
     {
-        scan_config.show_hidden = mp_obj_get_int(args[3].u_obj) >= 1;
+        req->config.show_hidden = mp_obj_get_int(args[3].u_obj) >= 1;
     }
 
     if(args[4].u_obj != mp_const_none)
     {
         if((wifi_scan_type_t)(mp_obj_get_int(args[4].u_obj)) == WIFI_SCAN_TYPE_PASSIVE)
         {
-            scan_config.scan_type = WIFI_SCAN_TYPE_PASSIVE;
+            req->config.scan_type = WIFI_SCAN_TYPE_PASSIVE;
         }
         else
         {
-            scan_config.scan_type = WIFI_SCAN_TYPE_ACTIVE;
+            req->config.scan_type = WIFI_SCAN_TYPE_ACTIVE;
         }
     }
     else if(wlan_obj.mode == WIFI_MODE_STA && !wlan_obj.disconnected)
     {
-        scan_config.scan_type = WIFI_SCAN_TYPE_PASSIVE;
+        req->config.scan_type = WIFI_SCAN_TYPE_PASSIVE;
     }
     else
     {
@@ -1392,16 +1845,16 @@ STATIC mp_obj_t wlan_scan(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *
 
     if(args[5].u_obj != mp_const_none)
     {
-        if(MP_OBJ_IS_TYPE(args[5].u_obj, &mp_type_tuple) && scan_config.scan_type == WIFI_SCAN_TYPE_ACTIVE)
+        if(MP_OBJ_IS_TYPE(args[5].u_obj, &mp_type_tuple) && req->config.scan_type == WIFI_SCAN_TYPE_ACTIVE)
         {
             mp_obj_get_array(args[5].u_obj, &stimelen, &stime);
 
             if(stimelen != 0 && stimelen <= 2)
             {
-                if(stimelen == 2 && scan_config.scan_type == WIFI_SCAN_TYPE_ACTIVE)
+                if(stimelen == 2 && req->config.scan_type == WIFI_SCAN_TYPE_ACTIVE)
                 {
-                    scan_config.scan_time.active.min = mp_obj_get_int(stime[0]);
-                    scan_config.scan_time.active.max = mp_obj_get_int(stime[1]);
+                    req->config.scan_time.active.min = mp_obj_get_int(stime[0]);
+                    req->config.scan_time.active.max = mp_obj_get_int(stime[1]);
                 }
                 else
                 {
@@ -1413,13 +1866,13 @@ STATIC mp_obj_t wlan_scan(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *
                 goto scan_time_err;
             }
         }
-        else if(MP_OBJ_IS_INT(args[5].u_obj) && scan_config.scan_type == WIFI_SCAN_TYPE_PASSIVE)
+        else if(MP_OBJ_IS_INT(args[5].u_obj) && req->config.scan_type == WIFI_SCAN_TYPE_PASSIVE)
         {
             uint32_t passive = mp_obj_get_int(args[5].u_obj);
 
             if(passive >= 0)
             {
-                scan_config.scan_time.passive = mp_obj_get_int(args[5].u_obj);
+                req->config.scan_time.passive = mp_obj_get_int(args[5].u_obj);
             }
             else
             {
@@ -1432,59 +1885,56 @@ STATIC mp_obj_t wlan_scan(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *
         }
     }
 
-    ptr_config = &scan_config;
+    if(args[6].u_obj != mp_const_none)
+    {
+        size_t len;
+        const char *prefix = mp_obj_str_get_data(args[6].u_obj, &len);
+        req->prefix_len = MIN(len, sizeof(req->prefix) - 1);
+        memcpy(req->prefix, prefix, req->prefix_len);
+    }
+    req->min_rssi = MAX(MIN(args[7].u_int, 0), -128);
 
     // check for the correct wlan mode
     if (wlan_obj.mode == WIFI_MODE_AP) {
         nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_request_not_possible));
     }
 
-    MP_THREAD_GIL_EXIT();
-    esp_err_t err = esp_wifi_scan_start(ptr_config, true);
-    MP_THREAD_GIL_ENTER();
-
-    switch(err)
-    {
-    case ESP_OK:
-        /* Success */
-        break;
-    case ESP_ERR_WIFI_TIMEOUT:
-        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Scan operation timed out!"));
-        break;
-    default:
-        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Scan operation Failed!"));
-        break;
+    mp_obj_t handler = args[8].u_obj;
+    if (handler != mp_const_none) {
+        // handler(net) is called for each AP found, then handler(None)
+        mp_irq_add(req, handler);
+        req->busy = true;
+        if (ESP_OK != esp_wifi_scan_start(&req->config, false)) {
+            wlan_scan_end();
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Scan operation Failed!"));
+        }
+        return mp_const_none;
     }
 
-    uint16_t ap_num;
-    wifi_ap_record_t *ap_record_buffer;
-    wifi_ap_record_t *ap_record;
     mp_obj_t nets = mp_obj_new_list(0, NULL);
+    for (;;) {
+        MP_THREAD_GIL_EXIT();
+        esp_err_t err = esp_wifi_scan_start(&req->config, true);
+        MP_THREAD_GIL_ENTER();
 
-    esp_wifi_scan_get_ap_num(&ap_num); // get the number of scanned APs
-
-    if (ap_num > 0) {
-        ap_record_buffer = malloc(ap_num * sizeof(wifi_ap_record_t));
-        if (ap_record_buffer == NULL) {
-            mp_raise_OSError(MP_ENOMEM);
+        switch(err)
+        {
+        case ESP_OK:
+            /* Success */
+            break;
+        case ESP_ERR_WIFI_TIMEOUT:
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Scan operation timed out!"));
+            break;
+        default:
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Scan operation Failed!"));
+            break;
         }
 
-        // get the scanned AP list
-        if (ESP_OK == esp_wifi_scan_get_ap_records(&ap_num, (wifi_ap_record_t *)ap_record_buffer)) {
-            for (int i = 0; i < ap_num; i++) {
-                ap_record = &ap_record_buffer[i];
-                mp_obj_t tuple[5];
-                tuple[0] = mp_obj_new_str((const char *)ap_record->ssid, strlen((char *)ap_record->ssid));
-                tuple[1] = mp_obj_new_bytes((const byte *)ap_record->bssid, sizeof(ap_record->bssid));
-                tuple[2] = mp_obj_new_int(ap_record->authmode);
-                tuple[3] = mp_obj_new_int(ap_record->primary);
-                tuple[4] = mp_obj_new_int(ap_record->rssi);
-
-                // add the network to the list
-                mp_obj_list_append(nets, mp_obj_new_attrtuple(wlan_scan_info_fields, 5, tuple));
-            }
+        wlan_scan_collect(req, mp_const_none, nets);
+        if (++req->next_channel >= req->n_channels) {
+            break;
         }
-        free(ap_record_buffer);
+        req->config.channel = req->channels[req->next_channel];
     }
 
     return nets;
@@ -2518,6 +2968,7 @@ STATIC mp_obj_t wlan_promiscuous_mode (mp_uint_t n_args, const mp_obj_t *args)
             if(ESP_OK == esp_wifi_set_promiscuous(false))
             {
                 self->is_promiscuous = false;
+                wlan_capture_free();
             }
             else
             {
@@ -2543,6 +2994,7 @@ STATIC mp_obj_t wlan_callback(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map
         { MP_QSTR_trigger,      MP_ARG_REQUIRED | MP_ARG_OBJ,   },
         { MP_QSTR_handler,      MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
         { MP_QSTR_arg,          MP_ARG_OBJ,                     {.u_obj = mp_const_none} },
+        { MP_QSTR_priority,     MP_ARG_KW_ONLY | MP_ARG_INT,    {.u_int = MP_IRQ_PRIORITY_NORMAL} },
     };
 
     // parse arguments
@@ -2598,7 +3050,7 @@ STATIC mp_obj_t wlan_callback(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map
         INTERRUPT_OBJ_CLEAN(self);
     }
 
-    mp_irq_add(self, args[1].u_obj);
+    mp_irq_add_prio(self, args[1].u_obj, args[3].u_int);
 
     return mp_const_none;
 }
@@ -2692,6 +3144,209 @@ STATIC mp_obj_t wlan_ctrl_pkt_filter(mp_uint_t n_args, const mp_obj_t *args) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(wlan_ctrl_pkt_filter_obj, 1, 2, wlan_ctrl_pkt_filter);
 
+STATIC void wlan_capture_compile(mp_obj_t filter_in, wlan_cap_rule_t *rules, uint8_t *nrules) {
+    size_t len;
+    mp_obj_t *terms;
+    mp_obj_get_array(filter_in, &len, &terms);
+    if (len > WLAN_CAP_RULES_MAX) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+    for (size_t i = 0; i < len; i++) {
+        // (field, value) or (field, value, negate)
+        size_t n;
+        mp_obj_t *term;
+        mp_obj_get_array(terms[i], &n, &term);
+        if (n < 2 || n > 3) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+        }
+        wlan_cap_rule_t *rule = &rules[i];
+        memset(rule, 0, sizeof(*rule));
+        rule->field = mp_obj_get_int(term[0]);
+        rule->negate = (n == 3) && mp_obj_is_true(term[2]);
+        switch (rule->field) {
+        case WLAN_CAP_FIELD_ADDR1:
+        case WLAN_CAP_FIELD_ADDR2:
+        case WLAN_CAP_FIELD_ADDR3:
+        case WLAN_CAP_FIELD_ANY_ADDR: {
+            mp_buffer_info_t bufinfo;
+            mp_get_buffer_raise(term[1], &bufinfo, MP_BUFFER_READ);
+            if (bufinfo.len != 6) {
+                nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+            }
+            memcpy(rule->addr, bufinfo.buf, 6);
+            break;
+        }
+        case WLAN_CAP_FIELD_TYPE:
+        case WLAN_CAP_FIELD_SUBTYPE:
+        case WLAN_CAP_FIELD_MIN_LEN:
+        case WLAN_CAP_FIELD_MAX_LEN:
+        case WLAN_CAP_FIELD_MIN_RSSI:
+            rule->value = mp_obj_get_int(term[1]);
+            break;
+        default:
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+        }
+    }
+    *nrules = len;
+}
+
+/// \method capture(enable, *, size, snaplen, filter)
+STATIC mp_obj_t wlan_capture(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t allowed_args[] = {
+        { MP_QSTR_enable,       MP_ARG_REQUIRED | MP_ARG_BOOL,  },
+        { MP_QSTR_size,         MP_ARG_KW_ONLY  | MP_ARG_OBJ,   {.u_obj = mp_const_none} },
+        { MP_QSTR_snaplen,      MP_ARG_KW_ONLY  | MP_ARG_INT,   {.u_int = WLAN_CAP_SNAPLEN_DEF} },
+        { MP_QSTR_filter,       MP_ARG_KW_ONLY  | MP_ARG_OBJ,   {.u_obj = mp_const_none} },
+    };
+
+    // parse arguments
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), allowed_args, args);
+    wlan_obj_t *self = pos_args[0];
+
+    wlan_capture_free();
+    if (!args[0].u_bool) {
+        return mp_const_none;
+    }
+
+    if (!self->is_promiscuous) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "Wifi is not in promiscuous mode!"));
+    }
+    if (args[2].u_int <= 0 || args[2].u_int >= MAX_WIFI_PROM_PKT_SIZE) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+
+    wlan_cap_rule_t rules[WLAN_CAP_RULES_MAX];
+    uint8_t nrules = 0;
+    if (args[3].u_obj != mp_const_none) {
+        wlan_capture_compile(args[3].u_obj, rules, &nrules);
+    }
+
+    bool psram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM) > 0;
+    uint32_t size;
+    if (args[1].u_obj != mp_const_none) {
+        size = WLAN_CAP_ALIGN(mp_obj_get_int(args[1].u_obj));
+    } else {
+        size = psram ? WLAN_CAP_RING_SIZE_PSRAM : WLAN_CAP_RING_SIZE;
+    }
+    // at least one full sized frame has to fit
+    if (size < WLAN_CAP_ALIGN(sizeof(wlan_cap_hdr_t) + args[2].u_int)) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+    uint8_t *buf = heap_caps_malloc(size, psram ? MALLOC_CAP_SPIRAM : MALLOC_CAP_INTERNAL);
+    if (!buf) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_MemoryError, "cannot allocate the capture buffer"));
+    }
+
+    memcpy(wlan_cap_rules, rules, sizeof(rules));
+    wlan_cap_nrules = nrules;
+    wlan_cap_snaplen = args[2].u_int;
+    wlan_cap_size = size;
+    wlan_cap_head = 0;
+    wlan_cap_tail = 0;
+    wlan_cap_used = 0;
+    wlan_cap_captured = 0;
+    wlan_cap_dropped = 0;
+    portENTER_CRITICAL(&wlan_cap_mux);
+    wlan_cap_buf = buf;
+    portEXIT_CRITICAL(&wlan_cap_mux);
+
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(wlan_capture_obj, 1, wlan_capture);
+
+/// \method capture_read(buf)
+/// fills buf with as many pcap records as fit and returns the number of bytes written
+STATIC mp_obj_t wlan_capture_read(mp_obj_t self_in, mp_obj_t buf_in) {
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(buf_in, &bufinfo, MP_BUFFER_WRITE);
+
+    if (!wlan_cap_buf) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_request_not_possible));
+    }
+
+    uint8_t *out = bufinfo.buf;
+    size_t written = 0;
+    for (;;) {
+        portENTER_CRITICAL(&wlan_cap_mux);
+        uint32_t used = wlan_cap_used;
+        uint32_t head = wlan_cap_head;
+        portEXIT_CRITICAL(&wlan_cap_mux);
+        if (used == 0) {
+            break;
+        }
+
+        wlan_cap_hdr_t *hdr = (wlan_cap_hdr_t *)&wlan_cap_buf[head];
+        uint32_t reclen;
+        if (hdr->caplen == WLAN_CAP_WRAP) {
+            reclen = wlan_cap_size - head;
+        } else {
+            size_t outlen = sizeof(wlan_pcap_rec_t) + hdr->caplen;
+            if (written + outlen > bufinfo.len) {
+                if (written == 0) {
+                    // the buffer can't even hold one record
+                    nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+                }
+                break;
+            }
+            wlan_pcap_rec_t rec;
+            rec.ts_sec = hdr->timestamp / 1000000;
+            rec.ts_usec = hdr->timestamp % 1000000;
+            rec.incl_len = WLAN_PCAP_RADIOTAP_LEN + hdr->caplen;
+            rec.orig_len = WLAN_PCAP_RADIOTAP_LEN + hdr->origlen;
+            rec.rt_version = 0;
+            rec.rt_pad = 0;
+            rec.rt_len = WLAN_PCAP_RADIOTAP_LEN;
+            rec.rt_present = (1 << 3) | (1 << 5);   // channel, dBm antenna signal
+            rec.rt_freq = (hdr->channel == 14) ? 2484 : (2407 + 5 * hdr->channel);
+            rec.rt_flags = 0x0080;                  // 2 GHz spectrum
+            rec.rt_signal = hdr->rssi;
+            memcpy(&out[written], &rec, sizeof(rec));
+            memcpy(&out[written + sizeof(rec)], hdr + 1, hdr->caplen);
+            written += outlen;
+            reclen = WLAN_CAP_ALIGN(sizeof(wlan_cap_hdr_t) + hdr->caplen);
+        }
+
+        portENTER_CRITICAL(&wlan_cap_mux);
+        wlan_cap_head = (head + reclen) % wlan_cap_size;
+        wlan_cap_used -= reclen;
+        portEXIT_CRITICAL(&wlan_cap_mux);
+    }
+    return mp_obj_new_int(written);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(wlan_capture_read_obj, wlan_capture_read);
+
+/// \method capture_header()
+/// the pcap file header matching the records returned by capture_read()
+STATIC mp_obj_t wlan_capture_header(mp_obj_t self_in) {
+    uint32_t header[6] = {
+        0xA1B2C3D4,                                     // magic, microsecond timestamps
+        (4 << 16) | 2,                                  // version 2.4
+        0,                                              // GMT offset
+        0,                                              // timestamp accuracy
+        WLAN_PCAP_RADIOTAP_LEN + wlan_cap_snaplen,
+        WLAN_PCAP_LINKTYPE_RADIOTAP,
+    };
+    return mp_obj_new_bytes((const byte *)header, sizeof(header));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(wlan_capture_header_obj, wlan_capture_header);
+
+/// \method capture_stats()
+/// returns (captured, dropped, pending bytes)
+STATIC mp_obj_t wlan_capture_stats(mp_obj_t self_in) {
+    mp_obj_t tuple[3];
+    portENTER_CRITICAL(&wlan_cap_mux);
+    uint32_t captured = wlan_cap_captured;
+    uint32_t dropped = wlan_cap_dropped;
+    uint32_t used = wlan_cap_used;
+    portEXIT_CRITICAL(&wlan_cap_mux);
+    tuple[0] = mp_obj_new_int_from_uint(captured);
+    tuple[1] = mp_obj_new_int_from_uint(dropped);
+    tuple[2] = mp_obj_new_int_from_uint(used);
+    return mp_obj_new_tuple(3, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(wlan_capture_stats_obj, wlan_capture_stats);
+
 
 STATIC const mp_map_elem_t wlan_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_init),                (mp_obj_t)&wlan_init_obj },
@@ -2722,6 +3377,10 @@ STATIC const mp_map_elem_t wlan_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_events),              (mp_obj_t)&wlan_events_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_wifi_packet),         (mp_obj_t)&wlan_packet_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_ctrl_pkt_filter),     (mp_obj_t)&wlan_ctrl_pkt_filter_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_capture),             (mp_obj_t)&wlan_capture_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_capture_read),        (mp_obj_t)&wlan_capture_read_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_capture_header),      (mp_obj_t)&wlan_capture_header_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_capture_stats),       (mp_obj_t)&wlan_capture_stats_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_smartConfig),         (mp_obj_t)&wlan_smartConfig_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_Connected_ap_pwd),    (mp_obj_t)&wlan_smartConfkey_obj },
 
@@ -2767,9 +3426,20 @@ STATIC const mp_map_elem_t wlan_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_FILTER_CTRL_PKT_CFENDACK),     MP_OBJ_NEW_SMALL_INT(WIFI_PROMIS_CTRL_FILTER_MASK_CFENDACK) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_SMART_CONF_DONE),             MP_OBJ_NEW_SMALL_INT(MOD_WLAN_SMART_CONFIG_DONE) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_SMART_CONF_TIMEOUT),             MP_OBJ_NEW_SMALL_INT(MOD_WLAN_SMART_CONFIG_TIMEOUT) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_CAP_TYPE),                    MP_OBJ_NEW_SMALL_INT(WLAN_CAP_FIELD_TYPE) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_CAP_SUBTYPE),                 MP_OBJ_NEW_SMALL_INT(WLAN_CAP_FIELD_SUBTYPE) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_CAP_ADDR1),                   MP_OBJ_NEW_SMALL_INT(WLAN_CAP_FIELD_ADDR1) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_CAP_ADDR2),                   MP_OBJ_NEW_SMALL_INT(WLAN_CAP_FIELD_ADDR2) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_CAP_ADDR3),                   MP_OBJ_NEW_SMALL_INT(WLAN_CAP_FIELD_ADDR3) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_CAP_ANY_ADDR),                MP_OBJ_NEW_SMALL_INT(WLAN_CAP_FIELD_ANY_ADDR) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_CAP_MIN_LEN),                 MP_OBJ_NEW_SMALL_INT(WLAN_CAP_FIELD_MIN_LEN) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_CAP_MAX_LEN),                 MP_OBJ_NEW_SMALL_INT(WLAN_CAP_FIELD_MAX_LEN) },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_CAP_MIN_RSSI),                MP_OBJ_NEW_SMALL_INT(WLAN_CAP_FIELD_MIN_RSSI) },
 };
 STATIC MP_DEFINE_CONST_DICT(wlan_locals_dict, wlan_locals_dict_table);
 
+STATIC mod_network_nic_stats_t wlan_stats;
+
 const mod_network_nic_type_t mod_network_nic_type_wlan = {
     .base = {
         { &mp_type_type },
@@ -2794,7 +3464,8 @@ const mod_network_nic_type_t mod_network_nic_type_wlan = {
     .n_ioctl = lwipsocket_socket_ioctl,
     .n_setupssl = lwipsocket_socket_setup_ssl,
 	.inf_up = wlan_is_inf_up,
-	.set_default_inf = wlan_set_default_inf
+	.set_default_inf = wlan_set_default_inf,
+	.stats = &wlan_stats
 };
 
 //STATIC const mp_irq_methods_t wlan_irq_methods = {
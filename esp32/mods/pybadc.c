@@ -25,8 +25,10 @@
 #include "esp_intr.h"
 #include "soc/dport_reg.h"
 #include "soc/gpio_sig_map.h"
+#include "soc/syscon_struct.h"
 
 #include "adc.h"
+#include "i2s.h"
 #include "esp_adc_cal.h"
 #include "pybadc.h"
 #include "mpexception.h"
@@ -41,6 +43,16 @@
 #define PYB_ADC_NUM_CHANNELS                (ADC1_CHANNEL_MAX)
 #define V_REF_NOM                           1100
 
+// the I2S peripheral samples ADC1 through DMA, only I2S0 is wired to the ADC
+#define PYB_ADC_I2S_NUM                     (I2S_NUM_0)
+#define PYB_ADC_DMA_BUF_LEN                 (256)       // samples per DMA buffer
+#define PYB_ADC_DMA_BUF_COUNT               (8)
+#define PYB_ADC_CHUNK_SAMPLES               (128)       // samples drained from the DMA buffers at a time
+#define PYB_ADC_SAMPLE_TAG_SHIFT            (12)        // the channel number is in the top 4 bits of each DMA sample
+#define PYB_ADC_SAMPLE_DATA_MASK            (0x0FFF)
+#define PYB_ADC_RATE_MIN                    (1000)
+#define PYB_ADC_RATE_MAX                    (2000000)
+
 /******************************************************************************
  DEFINE TYPES
  ******************************************************************************/
@@ -76,10 +88,22 @@ STATIC pyb_adc_channel_obj_t pyb_adc_channel_obj[PYB_ADC_NUM_CHANNELS] = { {.pin
 STATIC pyb_adc_obj_t pyb_adc_obj = {.vref = V_REF_NOM, .enabled = false};
 STATIC const mp_obj_type_t pyb_adc_channel_type;
 
+// state of the DMA-driven sampling, the channels are scanned in the order given by the user
+STATIC struct {
+    pyb_adc_channel_obj_t *channels[PYB_ADC_NUM_CHANNELS];
+    int8_t slot[PYB_ADC_NUM_CHANNELS];      // position of each ADC1 channel within a frame, -1 if not scanned
+    uint8_t n_channels;
+    bool active;
+} pyb_adc_stream;
+
 /******************************************************************************
  DECLARE PRIVATE FUNCTIONS
  ******************************************************************************/
 STATIC mp_obj_t adc_channel_deinit(mp_obj_t self_in);
+STATIC void pyb_adc_stream_start (uint32_t rate, mp_obj_t channels, uint32_t dma_buffers);
+STATIC void pyb_adc_stream_stop (void);
+STATIC uint32_t pyb_adc_stream_fill (uint16_t *samples, uint32_t n_frames, TickType_t timeout);
+STATIC void pyb_adc_to_voltage (uint16_t *samples, uint32_t n_frames);
 
 /******************************************************************************
  DEFINE PUBLIC FUNCTIONS
@@ -96,6 +120,35 @@ STATIC void pyb_adc_check_init(void) {
     }
 }
 
+STATIC void pyb_adc_channel_check_idle(void) {
+    // adc1_get_raw() would block while the I2S peripheral owns ADC1
+    if (pyb_adc_stream.active) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_request_not_possible));
+    }
+}
+
+// Timer.Sampler reads the channels from its own task, where nothing can raise
+// and the GIL isn't held, so it looks the channel up once and works by number
+int pyb_adc_channel_get_id (mp_obj_t channel) {
+    pyb_adc_channel_obj_t *self = channel;
+    if (!MP_OBJ_IS_TYPE(channel, &pyb_adc_channel_type) || !self->enabled) {
+        return -1;
+    }
+    if (self->calibrate) {
+        self->calibrate = false;
+        esp_adc_cal_characterize(ADC_UNIT_1, self->attn, self->adc->width - 9,self->adc->vref, &self->characteristics);
+    }
+    return self->channel;
+}
+
+uint32_t pyb_adc_channel_raw_to_voltage (uint8_t channel_id, uint32_t raw) {
+    return esp_adc_cal_raw_to_voltage(raw, &pyb_adc_channel_obj[channel_id].characteristics);
+}
+
+bool pyb_adc_is_streaming (void) {
+    return pyb_adc_stream.active;
+}
+
 STATIC void pyb_adc_channel_init (pyb_adc_channel_obj_t *self) {
     // the ADC block must be enabled first
     pyb_adc_check_init();
@@ -104,6 +157,123 @@ STATIC void pyb_adc_channel_init (pyb_adc_channel_obj_t *self) {
     self->enabled = true;
 }
 
+STATIC void pyb_adc_stream_start (uint32_t rate, mp_obj_t channels, uint32_t dma_buffers) {
+    pyb_adc_check_init();
+    if (pyb_adc_stream.active) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable));
+    }
+
+    mp_uint_t n_channels;
+    mp_obj_t *items;
+    mp_obj_get_array(channels, &n_channels, &items);
+    if (n_channels == 0 || n_channels > PYB_ADC_NUM_CHANNELS || rate < PYB_ADC_RATE_MIN || rate > PYB_ADC_RATE_MAX || dma_buffers < 2) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+
+    memset(pyb_adc_stream.slot, -1, sizeof(pyb_adc_stream.slot));
+    for (int i = 0; i < n_channels; i++) {
+        pyb_adc_channel_obj_t *ch = items[i];
+        if (mp_obj_get_type(ch) != &pyb_adc_channel_type || !ch->enabled || pyb_adc_stream.slot[ch->channel] >= 0) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+        }
+        if (ch->calibrate) {
+            ch->calibrate = false;
+            esp_adc_cal_characterize(ADC_UNIT_1, ch->attn, ch->adc->width - 9, ch->adc->vref, &ch->characteristics);
+        }
+        pyb_adc_stream.channels[i] = ch;
+        pyb_adc_stream.slot[ch->channel] = i;
+    }
+    pyb_adc_stream.n_channels = n_channels;
+
+    // each channel gets rate samples per second, the DMA buffers hold the samples until they are read
+    i2s_config_t i2s_config = {
+        .mode = I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN,
+        .sample_rate = rate * n_channels,
+        .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
+        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
+        .communication_format = I2S_COMM_FORMAT_I2S_MSB,
+        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
+        .dma_buf_count = dma_buffers,
+        .dma_buf_len = PYB_ADC_DMA_BUF_LEN,
+        .use_apll = false,
+    };
+    if (i2s_driver_install(PYB_ADC_I2S_NUM, &i2s_config, 0, NULL) != ESP_OK) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable));
+    }
+    i2s_set_adc_mode(ADC_UNIT_1, pyb_adc_stream.channels[0]->channel);
+    i2s_adc_enable(PYB_ADC_I2S_NUM);
+
+    // i2s_adc_enable() programs a single channel pattern, replace it with the scan list
+    // each entry is channel[7:4], width[3:2] (12 bits) and attenuation[1:0], the first one in the MSB
+    uint32_t patt_tab[2] = { 0, 0 };
+    for (int i = 0; i < n_channels; i++) {
+        pyb_adc_channel_obj_t *ch = pyb_adc_stream.channels[i];
+        uint32_t entry = (ch->channel << 4) | (ADC_WIDTH_BIT_12 << 2) | ch->attn;
+        patt_tab[i / 4] |= entry << (24 - 8 * (i % 4));
+    }
+    SYSCON.saradc_ctrl.sar1_patt_len = n_channels - 1;
+    SYSCON.saradc_sar1_patt_tab[0] = patt_tab[0];
+    SYSCON.saradc_sar1_patt_tab[1] = patt_tab[1];
+
+    pyb_adc_stream.active = true;
+}
+
+STATIC void pyb_adc_stream_stop (void) {
+    if (pyb_adc_stream.active) {
+        i2s_adc_disable(PYB_ADC_I2S_NUM);
+        i2s_driver_uninstall(PYB_ADC_I2S_NUM);
+        pyb_adc_stream.active = false;
+    }
+}
+
+// collects n_frames complete frames (one sample of each channel) into samples, returns the frames collected
+STATIC uint32_t pyb_adc_stream_fill (uint16_t *samples, uint32_t n_frames, TickType_t timeout) {
+    uint32_t n_channels = pyb_adc_stream.n_channels;
+    uint32_t count[PYB_ADC_NUM_CHANNELS] = { 0 };
+    uint32_t frames = 0;
+    uint16_t chunk[PYB_ADC_CHUNK_SAMPLES];
+
+    while (frames < n_frames) {
+        size_t wanted = MIN((n_frames - frames) * n_channels, PYB_ADC_CHUNK_SAMPLES) * sizeof(uint16_t);
+        size_t bytes_read = 0;
+        MP_THREAD_GIL_EXIT();
+        i2s_read(PYB_ADC_I2S_NUM, chunk, wanted, &bytes_read, timeout);
+        MP_THREAD_GIL_ENTER();
+        if (bytes_read == 0) {
+            break;
+        }
+        // the DMA swaps every pair of samples, so they are placed by the channel tag instead of their order
+        for (uint32_t i = 0; i < bytes_read / sizeof(uint16_t); i++) {
+            int8_t slot = pyb_adc_stream.slot[(chunk[i] >> PYB_ADC_SAMPLE_TAG_SHIFT) & 0x07];
+            if (slot >= 0 && count[slot] < n_frames) {
+                samples[count[slot]++ * n_channels + slot] = chunk[i] & PYB_ADC_SAMPLE_DATA_MASK;
+            }
+        }
+        frames = count[0];
+        for (uint32_t c = 1; c < n_channels; c++) {
+            frames = MIN(frames, count[c]);
+        }
+    }
+    // scale to the width selected for the ADC block, that's what the calibration expects
+    uint8_t shift = 12 - pyb_adc_obj.width;
+    for (uint32_t i = 0; shift > 0 && i < frames * n_channels; i++) {
+        samples[i] >>= shift;
+    }
+    return frames;
+}
+
+// converts the raw samples to millivolts in place, using the calibration of the channel of each slot
+STATIC void pyb_adc_to_voltage (uint16_t *samples, uint32_t n_frames) {
+    uint32_t n_channels = pyb_adc_stream.n_channels;
+    for (uint32_t c = 0; c < n_channels; c++) {
+        const esp_adc_cal_characteristics_t *chars = &pyb_adc_stream.channels[c]->characteristics;
+        for (uint32_t f = 0; f < n_frames; f++) {
+            uint16_t *s = &samples[f * n_channels + c];
+            *s = esp_adc_cal_raw_to_voltage(*s, chars);
+        }
+    }
+}
+
 /******************************************************************************/
 /* Micro Python bindings : adc object                                         */
 
@@ -191,11 +361,78 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(adc_vref_obj, 1, 2, adc_vref);
 
 STATIC mp_obj_t adc_deinit(mp_obj_t self_in) {
     pyb_adc_obj_t *self = self_in;
+    pyb_adc_stream_stop();
     self->enabled = false;
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(adc_deinit_obj, adc_deinit);
 
+STATIC mp_obj_t adc_stream_start(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t pyb_adc_stream_start_args[] = {
+        { MP_QSTR_rate,         MP_ARG_REQUIRED | MP_ARG_INT, },
+        { MP_QSTR_channels,     MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_dma_buffers,  MP_ARG_KW_ONLY  | MP_ARG_INT, {.u_int = PYB_ADC_DMA_BUF_COUNT} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(pyb_adc_stream_start_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), pyb_adc_stream_start_args, args);
+
+    pyb_adc_stream_start(args[0].u_int, args[1].u_obj, args[2].u_int);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(adc_stream_start_obj, 3, adc_stream_start);
+
+STATIC mp_obj_t adc_stream_read(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t pyb_adc_stream_read_args[] = {
+        { MP_QSTR_buf,          MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_timeout_ms,   MP_ARG_KW_ONLY  | MP_ARG_INT,  {.u_int = 0} },
+        { MP_QSTR_voltage,      MP_ARG_KW_ONLY  | MP_ARG_BOOL, {.u_bool = false} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(pyb_adc_stream_read_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), pyb_adc_stream_read_args, args);
+
+    if (!pyb_adc_stream.active) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_request_not_possible));
+    }
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[0].u_obj, &bufinfo, MP_BUFFER_WRITE);
+    TickType_t timeout = (args[1].u_int < 0) ? portMAX_DELAY : (args[1].u_int / portTICK_PERIOD_MS);
+    uint32_t frames = pyb_adc_stream_fill(bufinfo.buf, bufinfo.len / (sizeof(uint16_t) * pyb_adc_stream.n_channels), timeout);
+    if (args[2].u_bool) {
+        pyb_adc_to_voltage(bufinfo.buf, frames);
+    }
+    return mp_obj_new_int_from_uint(frames);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(adc_stream_read_obj, 2, adc_stream_read);
+
+STATIC mp_obj_t adc_stream_stop(mp_obj_t self_in) {
+    pyb_adc_stream_stop();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(adc_stream_stop_obj, adc_stream_stop);
+
+STATIC mp_obj_t adc_read_timed(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    STATIC const mp_arg_t pyb_adc_read_timed_args[] = {
+        { MP_QSTR_buf,          MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_rate,         MP_ARG_REQUIRED | MP_ARG_INT, },
+        { MP_QSTR_channels,     MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_voltage,      MP_ARG_KW_ONLY  | MP_ARG_BOOL, {.u_bool = false} },
+    };
+    mp_arg_val_t args[MP_ARRAY_SIZE(pyb_adc_read_timed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), pyb_adc_read_timed_args, args);
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[0].u_obj, &bufinfo, MP_BUFFER_WRITE);
+
+    pyb_adc_stream_start(args[1].u_int, args[2].u_obj, PYB_ADC_DMA_BUF_COUNT);
+    uint32_t frames = pyb_adc_stream_fill(bufinfo.buf, bufinfo.len / (sizeof(uint16_t) * pyb_adc_stream.n_channels), portMAX_DELAY);
+    pyb_adc_stream_stop();
+    if (args[3].u_bool) {
+        pyb_adc_to_voltage(bufinfo.buf, frames);
+    }
+    return mp_obj_new_int_from_uint(frames);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(adc_read_timed_obj, 4, adc_read_timed);
+
 STATIC mp_obj_t adc_channel(mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     STATIC const mp_arg_t pyb_adc_channel_args[] = {
         { MP_QSTR_id,                          MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
@@ -252,6 +489,10 @@ STATIC const mp_map_elem_t adc_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_channel),             (mp_obj_t)&adc_channel_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_vref),                (mp_obj_t)&adc_vref_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_vref_to_pin),         (mp_obj_t)&adc_vref_to_pin_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_read_timed),          (mp_obj_t)&adc_read_timed_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_stream_start),        (mp_obj_t)&adc_stream_start_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_stream_read),         (mp_obj_t)&adc_stream_read_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_stream_stop),         (mp_obj_t)&adc_stream_stop_obj },
 
     { MP_OBJ_NEW_QSTR(MP_QSTR_ATTN_0DB),            MP_OBJ_NEW_SMALL_INT(ADC_ATTEN_0db) },
     { MP_OBJ_NEW_QSTR(MP_QSTR_ATTN_2_5DB),          MP_OBJ_NEW_SMALL_INT(ADC_ATTEN_2_5db) },
@@ -299,6 +540,7 @@ STATIC mp_obj_t adc_channel_value(mp_obj_t self_in) {
     if (!self->enabled) {
         nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_request_not_possible));
     }
+    pyb_adc_channel_check_idle();
     return MP_OBJ_NEW_SMALL_INT(adc1_get_raw(self->channel));
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(adc_channel_value_obj, adc_channel_value);
@@ -310,6 +552,7 @@ STATIC mp_obj_t adc_channel_voltage(mp_obj_t self_in) {
     if (!self->enabled) {
         nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_request_not_possible));
     }
+    pyb_adc_channel_check_idle();
     if (self->calibrate) {
         self->calibrate = false;
         esp_adc_cal_characterize(ADC_UNIT_1, self->attn, self->adc->width - 9,self->adc->vref, &self->characteristics);
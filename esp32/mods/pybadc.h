@@ -12,4 +12,8 @@
 
 extern const mp_obj_type_t pyb_adc_type;
 
+extern int pyb_adc_channel_get_id (mp_obj_t channel);
+extern uint32_t pyb_adc_channel_raw_to_voltage (uint8_t channel_id, uint32_t raw);
+extern bool pyb_adc_is_streaming (void);
+
 #endif /* PYBADC_H_ */
@@ -8,18 +8,39 @@
  */
 
 
+#include <string.h>
+
 #include "py/runtime.h"
 
+#include "esp_heap_caps.h"
+#include "i2s.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
 #include "analog.h"
 #include "pybdac.h"
 #include "mpexception.h"
+#include "mpirq.h"
 #include "machpin.h"
+#include "pycom_config.h"
 
 
 /******************************************************************************
  DECLARE CONSTANTS
  ******************************************************************************/
 #define PYB_DAC_NUM                         2
+
+// waveforms are played by I2S0 in built-in DAC mode, which takes the high byte of each 16 bit slot
+#define PYB_DAC_I2S_NUM                     (I2S_NUM_0)
+#define PYB_DAC_DMA_BUF_LEN                 (256)       // frames per DMA buffer
+#define PYB_DAC_DMA_BUF_COUNT               (4)
+#define PYB_DAC_WAVE_QUEUE_LEN              (2)         // the one playing can be followed by one more
+#define PYB_DAC_RATE_MIN                    (1000)
+#define PYB_DAC_RATE_MAX                    (1000000)
+#define PYB_DAC_TASK_STACK_SIZE             (2048)
+#define PYB_DAC_TASK_PRIORITY               (6)
 /******************************************************************************
  DEFINE TYPES
  ******************************************************************************/
@@ -33,8 +54,15 @@ typedef struct {
     uint8_t dc_value;
     uint16_t tone_step;
     uint8_t tone_scale;
+    mp_obj_t handler;
 } pyb_dac_obj_t;
 
+typedef struct {
+    uint32_t *frames;       // samples expanded to I2S frames, owned by the playback task once queued
+    uint32_t len;           // in bytes
+    bool loop;
+} pyb_dac_wave_t;
+
 
 /******************************************************************************
  DECLARE PRIVATE DATA
@@ -42,11 +70,23 @@ typedef struct {
 STATIC pyb_dac_obj_t pyb_dac_obj[PYB_DAC_NUM] = { {.id = 0, .enabled = false, .tone = false},
                                                   {.id = 1, .enabled = false, .tone = false} };
 
+// only one DAC at a time can play through the I2S peripheral
+STATIC struct {
+    pyb_dac_obj_t *owner;
+    QueueHandle_t queue;
+    TaskHandle_t task;
+    volatile bool stop;
+} pyb_dac_timed;
+
 
 /******************************************************************************
  DECLARE PRIVATE FUNCTIONS
  ******************************************************************************/
 STATIC mp_obj_t dac_deinit(mp_obj_t self_in);
+STATIC void TASK_DAC (void *pvParameters);
+STATIC void pyb_dac_timed_start (pyb_dac_obj_t *self, uint32_t rate);
+STATIC void pyb_dac_timed_stop (void);
+STATIC void dac_callback_handler (void *arg);
 
 esp_err_t set_dac(void){
 
@@ -66,6 +106,97 @@ STATIC void pyb_dac_init (pyb_dac_obj_t *self) {
     self->enabled = true;
 }
 
+STATIC void pyb_dac_timed_start (pyb_dac_obj_t *self, uint32_t rate) {
+    i2s_config_t i2s_config = {
+        .mode = I2S_MODE_MASTER | I2S_MODE_TX | I2S_MODE_DAC_BUILT_IN,
+        .sample_rate = rate,
+        .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
+        .channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT,
+        .communication_format = I2S_COMM_FORMAT_I2S_MSB,
+        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
+        .dma_buf_count = PYB_DAC_DMA_BUF_COUNT,
+        .dma_buf_len = PYB_DAC_DMA_BUF_LEN,
+        .use_apll = false,
+        .tx_desc_auto_clear = true,     // output 0 instead of repeating the last buffer on underrun
+    };
+    // fails as well when the ADC is sampling through I2S0
+    if (i2s_driver_install(PYB_DAC_I2S_NUM, &i2s_config, 0, NULL) != ESP_OK) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable));
+    }
+    // DAC1 (P22, GPIO25) is the right channel and DAC2 (P21, GPIO26) the left one
+    i2s_set_dac_mode((self->id == 0) ? I2S_DAC_CHANNEL_RIGHT_EN : I2S_DAC_CHANNEL_LEFT_EN);
+
+    if (pyb_dac_timed.queue == NULL) {
+        pyb_dac_timed.queue = xQueueCreate(PYB_DAC_WAVE_QUEUE_LEN, sizeof(pyb_dac_wave_t));
+        xTaskCreatePinnedToCore(TASK_DAC, "DAC", PYB_DAC_TASK_STACK_SIZE / sizeof(StackType_t), NULL, PYB_DAC_TASK_PRIORITY, &pyb_dac_timed.task, config_get_service_core());
+    }
+    pyb_dac_timed.stop = false;
+    pyb_dac_timed.owner = self;
+}
+
+STATIC void pyb_dac_timed_stop (void) {
+    if (pyb_dac_timed.owner != NULL) {
+        // the task frees the waveforms still queued and lets us know when the I2S peripheral is idle,
+        // the empty waveform wakes it up in case it's waiting for one
+        pyb_dac_wave_t wakeup = { .frames = NULL };
+        pyb_dac_timed.stop = true;
+        MP_THREAD_GIL_EXIT();
+        xQueueSend(pyb_dac_timed.queue, &wakeup, portMAX_DELAY);
+        while (pyb_dac_timed.stop) {
+            vTaskDelay(1);
+        }
+        MP_THREAD_GIL_ENTER();
+        i2s_driver_uninstall(PYB_DAC_I2S_NUM);
+        pyb_dac_timed.owner = NULL;
+    }
+}
+
+STATIC void TASK_DAC (void *pvParameters) {
+    pyb_dac_wave_t wave = { .frames = NULL };
+    for (;;) {
+        pyb_dac_wave_t next;
+        // a looping waveform plays until the next one is queued, otherwise wait for one
+        TickType_t wait = (wave.frames != NULL) ? 0 : portMAX_DELAY;
+        if (xQueueReceive(pyb_dac_timed.queue, &next, wait) == pdTRUE) {
+            heap_caps_free(wave.frames);
+            wave = next;
+        }
+        if (pyb_dac_timed.stop) {
+            heap_caps_free(wave.frames);
+            wave.frames = NULL;
+            while (xQueueReceive(pyb_dac_timed.queue, &next, 0) == pdTRUE) {
+                heap_caps_free(next.frames);
+            }
+            i2s_zero_dma_buffer(PYB_DAC_I2S_NUM);
+            pyb_dac_timed.stop = false;
+            continue;
+        }
+        if (wave.frames == NULL) {
+            continue;
+        }
+
+        // no per-sample work here, the frames were prepared when the waveform was queued
+        size_t written;
+        i2s_write(PYB_DAC_I2S_NUM, wave.frames, wave.len, &written, portMAX_DELAY);
+
+        if (!wave.loop) {
+            heap_caps_free(wave.frames);
+            wave.frames = NULL;
+            // ask for more so the generation can go on without gaps
+            if (pyb_dac_timed.owner != NULL) {
+                mp_irq_queue_interrupt_non_ISR(dac_callback_handler, (void *)pyb_dac_timed.owner);
+            }
+        }
+    }
+}
+
+STATIC void dac_callback_handler (void *arg) {
+    pyb_dac_obj_t *self = arg;
+    if (self->handler && self->handler != mp_const_none) {
+        mp_call_function_1(self->handler, self);
+    }
+}
+
 /******************************************************************************/
 /* Micro Python bindings : dac object                                         */
 
@@ -124,6 +255,9 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_KW(dac_init_obj, 1, dac_init);
 STATIC mp_obj_t dac_deinit(mp_obj_t self_in) {
     pyb_dac_obj_t *self = self_in;
 
+    if (pyb_dac_timed.owner == self) {
+        pyb_dac_timed_stop();
+    }
     self->enabled = false;
     self->dc_value = 0;
     set_dac();
@@ -191,11 +325,80 @@ STATIC mp_obj_t dac_tone(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_a
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(dac_tone_obj, 1, dac_tone);
 
 
+STATIC mp_obj_t dac_write_timed(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    static const mp_arg_t allowed_args[] = {
+        { MP_QSTR_buf,      MP_ARG_REQUIRED | MP_ARG_OBJ, },
+        { MP_QSTR_rate,     MP_ARG_REQUIRED | MP_ARG_INT, },
+        { MP_QSTR_loop,     MP_ARG_KW_ONLY  | MP_ARG_BOOL, {.u_bool = false} },
+        { MP_QSTR_handler,  MP_ARG_KW_ONLY  | MP_ARG_OBJ,  {.u_obj = mp_const_none} },
+    };
+
+    pyb_dac_obj_t *self = MP_OBJ_TO_PTR(pos_args[0]);
+    mp_arg_val_t args[MP_ARRAY_SIZE(allowed_args)];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(allowed_args), allowed_args, args);
+
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(args[0].u_obj, &bufinfo, MP_BUFFER_READ);
+    uint32_t rate = args[1].u_int;
+    if (bufinfo.len == 0 || rate < PYB_DAC_RATE_MIN || rate > PYB_DAC_RATE_MAX) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
+    if (pyb_dac_timed.owner != NULL && pyb_dac_timed.owner != self) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable));
+    }
+
+    // the 8 bit samples go in the high byte of both slots of a frame, only the selected DAC outputs its slot
+    pyb_dac_wave_t wave = { .len = bufinfo.len * sizeof(uint32_t), .loop = args[2].u_bool };
+    wave.frames = heap_caps_malloc(wave.len, MALLOC_CAP_8BIT);
+    if (wave.frames == NULL) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_MemoryError, "waveform buffer cannot be allocated"));
+    }
+    const uint8_t *samples = bufinfo.buf;
+    for (uint32_t i = 0; i < bufinfo.len; i++) {
+        wave.frames[i] = ((uint32_t)samples[i] << 24) | ((uint32_t)samples[i] << 8);
+    }
+
+    self->handler = args[3].u_obj;
+    if (self->handler != mp_const_none) {
+        mp_irq_add(self, self->handler);
+    } else {
+        mp_irq_remove(self);
+    }
+
+    if (pyb_dac_timed.owner == NULL) {
+        self->tone = false;
+        self->dc_value = 0;
+        set_dac();
+        pyb_dac_timed_start(self, rate);
+    } else {
+        // keep playing at the same rate, the new waveform follows the current one
+        i2s_set_sample_rates(PYB_DAC_I2S_NUM, rate);
+    }
+
+    // when both slots are taken wait for the current waveform to finish
+    MP_THREAD_GIL_EXIT();
+    xQueueSend(pyb_dac_timed.queue, &wave, portMAX_DELAY);
+    MP_THREAD_GIL_ENTER();
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(dac_write_timed_obj, 3, dac_write_timed);
+
+STATIC mp_obj_t dac_stop_timed(mp_obj_t self_in) {
+    pyb_dac_obj_t *self = self_in;
+    if (pyb_dac_timed.owner == self) {
+        pyb_dac_timed_stop();
+    }
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(dac_stop_timed_obj, dac_stop_timed);
+
 STATIC const mp_map_elem_t dac_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_init),                (mp_obj_t)&dac_init_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_deinit),              (mp_obj_t)&dac_deinit_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_write),               (mp_obj_t)&dac_write_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_tone),                (mp_obj_t)&dac_tone_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_write_timed),         (mp_obj_t)&dac_write_timed_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_stop_timed),          (mp_obj_t)&dac_stop_timed_obj },
 };
 
 STATIC MP_DEFINE_CONST_DICT(dac_locals_dict, dac_locals_dict_table);
@@ -41,7 +41,7 @@
 /******************************************************************************
  DECLARE PUBLIC DATA
  ******************************************************************************/
-pybsd_obj_t pybsd_obj = {.enabled = false};
+pybsd_obj_t pybsd_obj = {.width = 1, .enabled = false};
 
 /******************************************************************************
  DECLARE PRIVATE DATA
@@ -50,7 +50,7 @@ pybsd_obj_t pybsd_obj = {.enabled = false};
 /******************************************************************************
  DECLARE PRIVATE FUNCTIONS
  ******************************************************************************/
-STATIC void pyb_sd_hw_init (pybsd_obj_t *self);
+STATIC void pyb_sd_hw_init (pybsd_obj_t *self, uint8_t width);
 STATIC mp_obj_t pyb_sd_make_new (const mp_obj_type_t *type, mp_uint_t n_args, mp_uint_t n_kw, const mp_obj_t *args);
 STATIC mp_obj_t pyb_sd_deinit (mp_obj_t self_in);
 
@@ -58,24 +58,44 @@ STATIC mp_obj_t pyb_sd_deinit (mp_obj_t self_in);
  DEFINE PRIVATE FUNCTIONS
  ******************************************************************************/
 /// initalizes the sd card hardware driver
-STATIC void pyb_sd_hw_init (pybsd_obj_t *self) {
-    if (!self->enabled) {
+STATIC void pyb_sd_hw_init (pybsd_obj_t *self, uint8_t width) {
+    if (!self->enabled || self->width != width) {
         sdmmc_slot_config_t slot_config =
         {
             .gpio_cd = SDMMC_SLOT_NO_CD,
             .gpio_wp = SDMMC_SLOT_NO_WP,
-            .width   = 1,  // single bit bus
+            .width   = width,  // 1 or 4 bit bus, D1-D3 are on GPIO4, GPIO12 and GPIO13
         };
 
-        sdmmc_host_init();
+        if (!self->enabled) {
+            sdmmc_host_init();
+        }
         sdmmc_host_init_slot(SDMMC_HOST_SLOT_1, &slot_config);
+        self->width = width;
         self->enabled = true;
     }
 }
 
 STATIC mp_obj_t pyb_sd_init_helper (pybsd_obj_t *self, const mp_arg_val_t *args) {
-    pyb_sd_hw_init (self);
-    if (sd_disk_init() != 0) {
+    uint8_t width = args[1].u_int;
+    if (width != 1 && width != 4) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    uint32_t freq_khz = SDMMC_FREQ_DEFAULT;
+    if (args[0].u_obj != MP_OBJ_NULL) {
+        // in Hz, the host rounds it down to what it can divide from its clock
+        freq_khz = mp_obj_get_int(args[0].u_obj) / 1000;
+        if (freq_khz < SDMMC_FREQ_PROBING || freq_khz > SDMMC_FREQ_HIGHSPEED) {
+            mp_raise_ValueError(mpexception_value_invalid_arguments);
+        }
+    }
+    if (args[2].u_int < 0 || args[2].u_int > 128) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+
+    pyb_sd_hw_init (self, width);
+    sd_disk_set_readahead(args[2].u_int);
+    if (sd_disk_init(width, freq_khz) != 0) {
         mp_raise_msg(&mp_type_OSError, mpexception_os_operation_failed);
     }
 
@@ -89,6 +109,8 @@ STATIC mp_obj_t pyb_sd_init_helper (pybsd_obj_t *self, const mp_arg_val_t *args)
 STATIC const mp_arg_t pyb_sd_init_args[] = {
     { MP_QSTR_id,                          MP_ARG_INT, {.u_int = 0} },
     { MP_QSTR_freq,                        MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+    { MP_QSTR_width,                       MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 1} },
+    { MP_QSTR_readahead,                   MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = SD_READAHEAD_SECTORS_DEFAULT} },
 };
 STATIC mp_obj_t pyb_sd_make_new (const mp_obj_type_t *type, mp_uint_t n_args, mp_uint_t n_kw, const mp_obj_t *all_args) {
     // parse args
@@ -129,6 +151,20 @@ STATIC mp_obj_t pyb_sd_deinit (mp_obj_t self_in) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(pyb_sd_deinit_obj, pyb_sd_deinit);
 
+STATIC mp_obj_t pyb_sd_stats (mp_obj_t self_in) {
+    sd_disk_stats_t stats;
+    sd_disk_get_stats(&stats);
+    mp_obj_t tuple[6];
+    tuple[0] = mp_obj_new_int_from_uint(stats.reads);
+    tuple[1] = mp_obj_new_int_from_uint(stats.writes);
+    tuple[2] = mp_obj_new_int_from_uint(stats.sectors_read);
+    tuple[3] = mp_obj_new_int_from_uint(stats.sectors_written);
+    tuple[4] = mp_obj_new_int_from_uint(stats.readahead_hits);
+    tuple[5] = mp_obj_new_int_from_uint(stats.errors);
+    return mp_obj_new_tuple(6, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(pyb_sd_stats_obj, pyb_sd_stats);
+
 STATIC mp_obj_t pyb_sd_readblocks(mp_obj_t self, mp_obj_t block_num, mp_obj_t buf) {
     mp_buffer_info_t bufinfo;
     mp_get_buffer_raise(buf, &bufinfo, MP_BUFFER_WRITE);
@@ -168,6 +204,7 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_3(pyb_sd_ioctl_obj, pyb_sd_ioctl);
 STATIC const mp_map_elem_t pyb_sd_locals_dict_table[] = {
     { MP_OBJ_NEW_QSTR(MP_QSTR_init),            (mp_obj_t)&pyb_sd_init_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_deinit),          (mp_obj_t)&pyb_sd_deinit_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_stats),           (mp_obj_t)&pyb_sd_stats_obj },
     // block device protocol
     { MP_OBJ_NEW_QSTR(MP_QSTR_readblocks), (mp_obj_t)&pyb_sd_readblocks_obj },
     { MP_OBJ_NEW_QSTR(MP_QSTR_writeblocks), (mp_obj_t)&pyb_sd_writeblocks_obj },
@@ -15,6 +15,7 @@
  ******************************************************************************/
 typedef struct {
     mp_obj_base_t       base;
+    uint8_t             width;
     bool                enabled;
 } pybsd_obj_t;
 
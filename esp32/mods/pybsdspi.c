@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/mpthread.h"
+#include "py/mperrno.h"
+#include "lib/oofatfs/ff.h"
+#include "lib/oofatfs/diskio.h"
+#include "extmod/vfs_fat.h"
+#include "driver/gpio.h"
+#include "driver/sdspi_host.h"
+#include "driver/sdmmc_defs.h"
+#include "sdmmc_cmd.h"
+#include "esp_heap_caps.h"
+#include "soc/soc_memory_layout.h"
+
+#include "sd_diskio.h"
+#include "pybsdspi.h"
+#include "mpexception.h"
+#include "machpin.h"
+#include "pins.h"
+
+/******************************************************************************
+ DEFINE PRIVATE CONSTANTS
+ ******************************************************************************/
+#define SDSPI_BAUDRATE_DEFAULT              (20000000)
+// stages the transfers of buffers the DMA can't reach, still several sectors per command
+#define SDSPI_DMA_SECTORS                   (8)
+
+/******************************************************************************
+ DEFINE PRIVATE TYPES
+ ******************************************************************************/
+typedef struct {
+    mp_obj_base_t       base;
+    sdmmc_card_t        card;
+    BYTE                *dma_buf;
+    uint8_t             host;
+    bool                enabled;
+} pybsdspi_obj_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+#if defined(WIPY) || defined(GPY)
+STATIC pybsdspi_obj_t pybsdspi_obj[2] = { {.host = HSPI_HOST}, {.host = VSPI_HOST} };
+STATIC const mp_obj_t pybsdspi_def_pin[2][3] = { {&PIN_MODULE_P10, &PIN_MODULE_P11, &PIN_MODULE_P14},
+                                                 {&PIN_MODULE_P19, &PIN_MODULE_P20, &PIN_MODULE_P21} };
+#else
+STATIC pybsdspi_obj_t pybsdspi_obj[1] = { {.host = HSPI_HOST} };
+STATIC const mp_obj_t pybsdspi_def_pin[1][3] = { {&PIN_MODULE_P10, &PIN_MODULE_P11, &PIN_MODULE_P14} };
+#endif
+// the SD SPI host of the IDF is torn down as a whole, along with the last card
+STATIC uint8_t pybsdspi_n_enabled;
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+STATIC bool pybsdspi_dma_capable (const void *buf) {
+    return esp_ptr_dma_capable(buf) && ((intptr_t)buf % 4) == 0;
+}
+
+STATIC void pybsdspi_hw_deinit (pybsdspi_obj_t *self) {
+    if (self->enabled) {
+        heap_caps_free(self->dma_buf);
+        self->dma_buf = NULL;
+        self->enabled = false;
+        if (--pybsdspi_n_enabled == 0) {
+            sdspi_host_deinit();
+        }
+    }
+}
+
+// one CMD18 or CMD25 per call of the card driver, through the bounce buffer when needed
+STATIC bool pybsdspi_transfer (pybsdspi_obj_t *self, BYTE *buf, DWORD sector, UINT count, bool write) {
+    if (pybsdspi_dma_capable(buf)) {
+        esp_err_t err = write ? sdmmc_write_sectors(&self->card, buf, sector, count) :
+                                sdmmc_read_sectors(&self->card, buf, sector, count);
+        return err == ESP_OK;
+    }
+    while (count > 0) {
+        UINT n = MIN(count, SDSPI_DMA_SECTORS);
+        if (write) {
+            memcpy(self->dma_buf, buf, n * SD_SECTOR_SIZE);
+            if (sdmmc_write_sectors(&self->card, self->dma_buf, sector, n) != ESP_OK) {
+                return false;
+            }
+        } else {
+            if (sdmmc_read_sectors(&self->card, self->dma_buf, sector, n) != ESP_OK) {
+                return false;
+            }
+            memcpy(buf, self->dma_buf, n * SD_SECTOR_SIZE);
+        }
+        buf += n * SD_SECTOR_SIZE;
+        sector += n;
+        count -= n;
+    }
+    return true;
+}
+
+STATIC mp_obj_t pybsdspi_blocks (mp_obj_t self_in, mp_obj_t block_num, mp_obj_t buf, bool write) {
+    pybsdspi_obj_t *self = self_in;
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(buf, &bufinfo, write ? MP_BUFFER_READ : MP_BUFFER_WRITE);
+    DWORD sector = mp_obj_get_int(block_num);
+    bool ok = false;
+    if (self->enabled) {
+        MP_THREAD_GIL_EXIT();
+        ok = pybsdspi_transfer(self, bufinfo.buf, sector, bufinfo.len / SD_SECTOR_SIZE, write);
+        MP_THREAD_GIL_ENTER();
+    }
+    return MP_OBJ_NEW_SMALL_INT(!ok); // return of 0 means success
+}
+
+STATIC mp_obj_t pyb_sdspi_init_helper (pybsdspi_obj_t *self, const mp_arg_val_t *args) {
+    mp_int_t baudrate = args[0].u_int;
+    if (baudrate < SDMMC_FREQ_PROBING * 1000 || baudrate > SDMMC_FREQ_DEFAULT * 1000 * 2) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    mp_obj_t *pins = (mp_obj_t *)pybsdspi_def_pin[self - pybsdspi_obj];
+    if (args[1].u_obj != MP_OBJ_NULL) {
+        mp_obj_get_array_fixed_n(args[1].u_obj, 3, &pins);
+    }
+    if (args[2].u_obj == MP_OBJ_NULL) {
+        mp_raise_ValueError(mpexception_value_invalid_arguments);
+    }
+    pin_obj_t *clk = pin_find(pins[0]);
+    pin_obj_t *mosi = pin_find(pins[1]);
+    pin_obj_t *miso = pin_find(pins[2]);
+    pin_obj_t *cs = pin_find(args[2].u_obj);
+
+    pybsdspi_hw_deinit(self);
+    self->dma_buf = heap_caps_malloc(SDSPI_DMA_SECTORS * SD_SECTOR_SIZE, MALLOC_CAP_DMA);
+    if (self->dma_buf == NULL) {
+        mp_raise_OSError(MP_ENOMEM);
+    }
+
+    sdmmc_host_t host = SDSPI_HOST_DEFAULT();
+    host.slot = self->host;
+    host.max_freq_khz = baudrate / 1000;
+    sdspi_slot_config_t slot = SDSPI_SLOT_CONFIG_DEFAULT();
+    slot.gpio_sck = clk->pin_number;
+    slot.gpio_mosi = mosi->pin_number;
+    slot.gpio_miso = miso->pin_number;
+    slot.gpio_cs = cs->pin_number;
+    // each host has its own DMA channel, so both can run at once
+    slot.dma_channel = self->host;
+    gpio_set_pull_mode(slot.gpio_miso, GPIO_PULLUP_ONLY);
+
+    if (pybsdspi_n_enabled == 0) {
+        sdspi_host_init();
+    }
+    pybsdspi_n_enabled++;
+    self->enabled = true;
+    if (sdspi_host_init_slot(self->host, &slot) != ESP_OK || sdmmc_card_init(&host, &self->card) != ESP_OK) {
+        pybsdspi_hw_deinit(self);
+        mp_raise_msg(&mp_type_OSError, mpexception_os_operation_failed);
+    }
+    return mp_const_none;
+}
+
+/******************************************************************************/
+// Micro Python bindings
+//
+
+/// \class SDSPI(id=0, *, baudrate=20000000, pins=(CLK, MOSI, MISO), cs)
+/// An SD card in SPI mode as a block device, for boards without the SD slot. The
+/// card driver of the IDF does the protocol on the SPI host with DMA, and several
+/// sectors go out as a single CMD18 or CMD25. The host is taken over, it can't be
+/// used by machine.SPI(id) at the same time.
+STATIC const mp_arg_t pyb_sdspi_init_args[] = {
+    { MP_QSTR_id,                          MP_ARG_INT, {.u_int = 0} },
+    { MP_QSTR_baudrate,                    MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = SDSPI_BAUDRATE_DEFAULT} },
+    { MP_QSTR_pins,                        MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+    { MP_QSTR_cs,                          MP_ARG_KW_ONLY | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+};
+STATIC mp_obj_t pyb_sdspi_make_new (const mp_obj_type_t *type, mp_uint_t n_args, mp_uint_t n_kw, const mp_obj_t *all_args) {
+    // parse args
+    mp_map_t kw_args;
+    mp_map_init_fixed_table(&kw_args, n_kw, all_args + n_args);
+    mp_arg_val_t args[MP_ARRAY_SIZE(pyb_sdspi_init_args)];
+    mp_arg_parse_all(n_args, all_args, &kw_args, MP_ARRAY_SIZE(args), pyb_sdspi_init_args, args);
+
+    // check the peripheral id
+    if (args[0].u_int < 0 || args[0].u_int >= MP_ARRAY_SIZE(pybsdspi_obj)) {
+        mp_raise_msg(&mp_type_OSError, mpexception_os_resource_not_avaliable);
+    }
+
+    // setup and initialize the object
+    pybsdspi_obj_t *self = &pybsdspi_obj[args[0].u_int];
+    self->base.type = &pyb_sdspi_type;
+    pyb_sdspi_init_helper(self, &args[1]);
+    return self;
+}
+
+STATIC mp_obj_t pyb_sdspi_init (mp_uint_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    // parse args
+    mp_arg_val_t args[MP_ARRAY_SIZE(pyb_sdspi_init_args) - 1];
+    mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args, MP_ARRAY_SIZE(args), &pyb_sdspi_init_args[1], args);
+    return pyb_sdspi_init_helper(pos_args[0], args);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(pyb_sdspi_init_obj, 1, pyb_sdspi_init);
+
+STATIC mp_obj_t pyb_sdspi_deinit (mp_obj_t self_in) {
+    pybsdspi_hw_deinit(self_in);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(pyb_sdspi_deinit_obj, pyb_sdspi_deinit);
+
+STATIC mp_obj_t pyb_sdspi_readblocks (mp_obj_t self, mp_obj_t block_num, mp_obj_t buf) {
+    return pybsdspi_blocks(self, block_num, buf, false);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(pyb_sdspi_readblocks_obj, pyb_sdspi_readblocks);
+
+STATIC mp_obj_t pyb_sdspi_writeblocks (mp_obj_t self, mp_obj_t block_num, mp_obj_t buf) {
+    return pybsdspi_blocks(self, block_num, buf, true);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(pyb_sdspi_writeblocks_obj, pyb_sdspi_writeblocks);
+
+STATIC mp_obj_t pyb_sdspi_ioctl (mp_obj_t self_in, mp_obj_t cmd_in, mp_obj_t arg_in) {
+    pybsdspi_obj_t *self = self_in;
+    mp_int_t cmd = mp_obj_get_int(cmd_in);
+    switch (cmd) {
+        case BP_IOCTL_INIT:
+        case BP_IOCTL_SYNC:
+            // nothing to do
+            return MP_OBJ_NEW_SMALL_INT(self->enabled ? 0 : -1);
+
+        case BP_IOCTL_DEINIT:
+            pybsdspi_hw_deinit(self);
+            return MP_OBJ_NEW_SMALL_INT(0);
+
+        case BP_IOCTL_SEC_COUNT:
+            return MP_OBJ_NEW_SMALL_INT(self->card.csd.capacity);
+
+        case BP_IOCTL_SEC_SIZE:
+            return MP_OBJ_NEW_SMALL_INT(self->card.csd.sector_size);
+
+        default: // unknown command
+            return MP_OBJ_NEW_SMALL_INT(-1); // error
+    }
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(pyb_sdspi_ioctl_obj, pyb_sdspi_ioctl);
+
+STATIC const mp_map_elem_t pyb_sdspi_locals_dict_table[] = {
+    { MP_OBJ_NEW_QSTR(MP_QSTR_init),            (mp_obj_t)&pyb_sdspi_init_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_deinit),          (mp_obj_t)&pyb_sdspi_deinit_obj },
+    // block device protocol
+    { MP_OBJ_NEW_QSTR(MP_QSTR_readblocks),      (mp_obj_t)&pyb_sdspi_readblocks_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_writeblocks),     (mp_obj_t)&pyb_sdspi_writeblocks_obj },
+    { MP_OBJ_NEW_QSTR(MP_QSTR_ioctl),           (mp_obj_t)&pyb_sdspi_ioctl_obj },
+};
+
+STATIC MP_DEFINE_CONST_DICT(pyb_sdspi_locals_dict, pyb_sdspi_locals_dict_table);
+
+const mp_obj_type_t pyb_sdspi_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_SDSPI,
+    .make_new = pyb_sdspi_make_new,
+    .locals_dict = (mp_obj_t)&pyb_sdspi_locals_dict,
+};
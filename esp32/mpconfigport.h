@@ -40,17 +40,27 @@
 #define __INCLUDED_MPCONFIGPORT_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include "mp_pycom_err.h"
 
 // options to control how Micro Python is built
+#ifndef MICROPY_OBJ_REPR   // can be configured by make option
 #define MICROPY_OBJ_REPR                            (MICROPY_OBJ_REPR_A)
+#endif
 #define MICROPY_ALLOC_PATH_MAX                      (128)
 #define MICROPY_EMIT_X64                            (0)
 #define MICROPY_EMIT_THUMB                          (0)
 #define MICROPY_EMIT_INLINE_THUMB                   (0)
+#define MICROPY_EMIT_XTENSAWIN                      (1)
+#define MICROPY_EMIT_INLINE_XTENSA                  (1)
 #define MICROPY_MEM_STATS                           (0)
 #define MICROPY_DEBUG_PRINTERS                      (1)
 #define MICROPY_ENABLE_GC                           (1)
+#define MICROPY_GC_LAZY_SWEEP                       (1)
+#define MICROPY_GC_SPLIT_HEAP                       (1)
+#define MICROPY_GC_FREE_LISTS                       (1)
+#define MICROPY_GC_PARALLEL_MARK                    (1)
+#define MICROPY_GC_REALLOC_STATS                    (1)
 #define MICROPY_STACK_CHECK                         (1)
 #define MICROPY_HELPER_REPL                         (1)
 #define MICROPY_PY_BUILTINS_HELP                    (1)
@@ -72,6 +82,7 @@
 #define MICROPY_PY_WEBSOCKET                        (1)
 #define MICROPY_PY___FILE__                         (1)
 #define MICROPY_PY_GC                               (1)
+#define MICROPY_PY_GC_DEFRAG                        (1)
 #define MICROPY_PY_ARRAY                            (1)
 #define MICROPY_PY_ARRAY_SLICE_ASSIGN               (1)
 #define MICROPY_PY_COLLECTIONS                      (1)
@@ -80,11 +91,19 @@
 #define MICROPY_PY_CMATH                            (1)
 #define MICROPY_PY_IO                               (1)
 #define MICROPY_PY_IO_FILEIO                        (1)
+#define MICROPY_PY_IO_BUFFEREDWRITER                (1)
+#define MICROPY_PY_IO_BUFFEREDREADER                (1)
+#define MICROPY_PY_IO_BYTESBUILDER                  (1)
 #define MICROPY_PY_STRUCT                           (1)
+#define MICROPY_PY_STRUCT_CLASS                     (1)
 #define MICROPY_PY_SYS                              (1)
 #define MICROPY_PY_THREAD                           (1)
 #define MICROPY_PY_THREAD_GIL                       (1)
+#define MICROPY_PY_THREAD_CORE_AFFINITY             (1)
 #define MICROPY_PY_THREAD_GIL_VM_DIVISOR            (8)
+#define MICROPY_PY_THREAD_GIL_ADAPTIVE              (1)
+#define MICROPY_PY_THREAD_STACK_INFO                (1)
+#define MICROPY_PY_THREAD_STACK_EXT_RAM             (1)
 #define MICROPY_PY_SYS_MAXSIZE                      (1)
 #define MICROPY_PY_SYS_EXIT                         (1)
 #define MICROPY_PY_SYS_STDFILES                     (1)
@@ -95,18 +114,35 @@
 #define MICROPY_PY_UHASHLIB_SHA1                    (0)
 #define MICROPY_PY_UJSON                            (1)
 #define MICROPY_PY_URE                              (1)
+#define MICROPY_PY_URE_CACHE_SIZE                   (8)
+#define MICROPY_PY_URE_SPANS                        (1)
 #define MICROPY_PY_USELECT                          (1)
+#define MICROPY_PY_USELECT_PORT_WAIT                (1)
 #define MICROPY_PY_MACHINE                          (1)
 #define MICROPY_PY_MICROPYTHON_MEM_INFO             (1)
+#define MICROPY_PY_MICROPYTHON_ALLOC_STATS          (1)
+#define MICROPY_PY_MICROPYTHON_PROFILE              (1)
 #define MICROPY_PY_UTIMEQ                           (1)
 #define MICROPY_CPYTHON_COMPAT                      (1)
 #define MICROPY_LONGINT_IMPL                        (MICROPY_LONGINT_IMPL_MPZ)
 #ifndef MICROPY_FLOAT_IMPL   // can be configured by make option
 #define MICROPY_FLOAT_IMPL                          (MICROPY_FLOAT_IMPL_FLOAT)
 #endif
+#define MICROPY_FLOAT_SHORTEST_REPR                 (1)
 #define MICROPY_ERROR_REPORTING                     (MICROPY_ERROR_REPORTING_NORMAL)
 #define MICROPY_OPT_COMPUTED_GOTO                   (1)
 #define MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE    (0)
+#define MICROPY_OPT_MAP_LOOKUP_CACHE                (1)
+#define MICROPY_OPT_MAP_COMPACT                     (1)
+#define MICROPY_OPT_TYPE_ATTR_CACHE                 (1)
+#define MICROPY_OPT_CODE_STATE_POOL                 (1)
+#define MICROPY_OPT_GENERATOR_SHRINK                (1)
+#define MICROPY_OPT_CLOSURE_BY_VALUE                (1)
+#define MICROPY_OPT_VM_BINARY_OP_FAST_PATH          (1)
+#define MICROPY_OPT_MPZ_KARATSUBA                   (1)
+#define MICROPY_OPT_MPZ_POW3_MONTGOMERY             (1)
+#define MICROPY_OPT_BYTECODE_PEEPHOLE               (1)
+#define MICROPY_QSTR_HASH_INDEX                     (1)
 #define MICROPY_REPL_AUTO_INDENT                    (1)
 #define MICROPY_COMP_MODULE_CONST                   (1)
 #define MICROPY_ENABLE_FINALISER                    (1)
@@ -116,9 +152,16 @@
 #define MICROPY_MODULE_FROZEN_STR                   (0)
 #define MICROPY_MODULE_FROZEN_MPY                   (1)
 #define MICROPY_PERSISTENT_CODE_LOAD                (1)
+#define MICROPY_PERSISTENT_CODE_SAVE                (1)
+#define MICROPY_MODULE_FROZEN_XIP                   (1)
+#define MICROPY_MODULE_COMPILE_CACHE                (1)
+#define MICROPY_PARSE_STREAMING                     (1)
 #define MICROPY_QSTR_EXTRA_POOL                     mp_qstr_frozen_const_pool
 #define MICROPY_PY_FRAMEBUF                         (1)
+#define MICROPY_PY_UVECTOR                          (1)
 #define MICROPY_PY_UZLIB                            (1)
+#define MICROPY_PY_UZLIB_COMPRESS                   (1)
+#define MICROPY_PY_BTREE_AUTOSYNC                   (32)
 
 #define MICROPY_STREAMS_NON_BLOCK                   (1)
 #define MICROPY_PY_BUILTINS_TIMEOUTERROR            (1)
@@ -127,6 +170,7 @@
 #define MICROPY_ENABLE_EMERGENCY_EXCEPTION_BUF      (1)
 #define MICROPY_EMERGENCY_EXCEPTION_BUF_SIZE        (0)
 #define MICROPY_KBD_EXCEPTION                       (1)
+#define MICROPY_ENABLE_PREALLOC_EXCEPTIONS          (1)
 
 #ifndef BOOTLOADER_BUILD
 #include "freertos/FreeRTOS.h"
@@ -144,8 +188,11 @@
 
 #define MICROPY_VFS                                 (1)
 #define MICROPY_VFS_FAT                             (1)
+#define MICROPY_VFS_FAT_RELEASE_GIL                 (1)
 
 #define MICROPY_READER_VFS                          (1)
+#define MICROPY_READER_VFS_BUF_SIZE                 (512)   // a FAT sector
+#define MICROPY_VFS_IMPORT_STAT_CACHE               (32)
 #define MICROPY_PY_BUILTINS_INPUT                   (1)
 
 // TODO these should be generic, not bound to fatfs
@@ -173,6 +220,14 @@ typedef long mp_off_t;
 
 #define MP_PLAT_PRINT_STRN(str, len)                mp_hal_stdout_tx_strn_cooked(str, len)
 
+// native code is emitted into the GC heap and then copied into executable IRAM
+void *esp_native_code_commit(void *buf, size_t len);
+#define MP_PLAT_COMMIT_EXEC(buf, len)               esp_native_code_commit(buf, len)
+
+// btree pages are flash block sized and kept in PSRAM when there is some
+size_t btree_default_cachesize(void);
+#define MICROPY_PY_BTREE_DEFAULT_CACHESIZE          btree_default_cachesize()
+
 // extra built in names to add to the global namespace
 #define MICROPY_PORT_BUILTINS \
     { MP_OBJ_NEW_QSTR(MP_QSTR_help),  (mp_obj_t)&mp_builtin_help_obj },   \
@@ -193,6 +248,10 @@ extern const struct _mp_obj_module_t mp_module_uhashlib;
 extern const struct _mp_obj_module_t module_ucrypto;
 extern const struct _mp_obj_module_t mp_module_ussl;
 extern const struct _mp_obj_module_t mp_module_uqueue;
+extern const struct _mp_obj_module_t mp_module_tslog;
+extern const struct _mp_obj_module_t mp_module_kvstore;
+extern const struct _mp_obj_module_t mp_module_mqttcore;
+extern const struct _mp_obj_module_t mp_module_mlinfer;
 
 #define MICROPY_PORT_BUILTIN_MODULES \
     { MP_OBJ_NEW_QSTR(MP_QSTR_umachine),        (mp_obj_t)&machine_module },      \
@@ -208,6 +267,10 @@ extern const struct _mp_obj_module_t mp_module_uqueue;
     { MP_OBJ_NEW_QSTR(MP_QSTR_ussl),            (mp_obj_t)&mp_module_ussl },      \
     { MP_OBJ_NEW_QSTR(MP_QSTR_uerrno),          (mp_obj_t)&mp_module_uerrno },    \
     { MP_OBJ_NEW_QSTR(MP_QSTR_uqueue),          (mp_obj_t)&mp_module_uqueue },    \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_tslog),           (mp_obj_t)&mp_module_tslog },     \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_kvstore),         (mp_obj_t)&mp_module_kvstore },   \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_mqttcore),        (mp_obj_t)&mp_module_mqttcore },  \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_mlinfer),         (mp_obj_t)&mp_module_mlinfer },   \
 
 #define MICROPY_PORT_BUILTIN_MODULE_WEAK_LINKS \
     { MP_OBJ_NEW_QSTR(MP_QSTR_machine),         (mp_obj_t)&machine_module },      \
@@ -237,6 +300,8 @@ extern const struct _mp_obj_module_t mp_module_uqueue;
 #define MICROPY_END_ATOMIC_SECTION(state)           portEXIT_CRITICAL_NESTED(state)
 
 #define MICROPY_EVENT_POLL_HOOK                     mp_hal_delay_ms(1);
+// used by the WIZnet ioLibrary while it spins on the chip
+#define MICROPY_THREAD_YIELD()                      portYIELD()
 
 #define MICROPY_PORT_ROOT_POINTERS \
     const char *readline_hist[8];                               \
@@ -249,10 +314,12 @@ extern const struct _mp_obj_module_t mp_module_uqueue;
     mp_obj_t mp_os_write[3];                                    \
     mp_obj_t mp_alarm_heap;                                     \
     mp_obj_t mach_pwm_timer_obj[4];                             \
+    mp_obj_t mach_mcpwm_obj[6];                                 \
     mp_obj_list_t btc_conn_list;                                \
     mp_obj_list_t bts_srv_list;                                 \
     mp_obj_list_t bts_attr_list;                                \
     mp_obj_t coap_ptr;                                          \
+    uint8_t *pygate_tap_buf;                                    \
 
 // we need to provide a declaration/definition of alloca()
 #include <alloca.h>
@@ -260,8 +327,28 @@ extern const struct _mp_obj_module_t mp_module_uqueue;
 // board specifics
 #define MICROPY_MPHALPORT_H                                     "esp32_mphal.h"
 #define MICROPY_HW_MCU_NAME                                     "ESP32"
-#define MICROPY_PORT_SFLASH_BLOCK_COUNT_4MB                     127
-#define MICROPY_PORT_SFLASH_BLOCK_COUNT_8MB                     1024
+// blocks taken off the end of the filesystem for tslog.Log() without a file
+// (the filesystem then needs reformatting), none by default
+#define MICROPY_PORT_TSLOG_BLOCK_COUNT_4MB                      0
+#define MICROPY_PORT_TSLOG_BLOCK_COUNT_8MB                      0
+#define MICROPY_PORT_SFLASH_BLOCK_COUNT_4MB                     (127 - MICROPY_PORT_TSLOG_BLOCK_COUNT_4MB)
+// number of 4K blocks FatFS keeps in its write-back cache
+#define MICROPY_PORT_SFLASH_CACHE_BLOCKS                        (4)
+#define MICROPY_PORT_SFLASH_CACHE_BLOCKS_PSRAM                  (16)
+// number of 4K pages in the cache of a btree database opened without a cachesize
+#define MICROPY_PORT_BTREE_CACHE_PAGES                          (4)
+#define MICROPY_PORT_BTREE_CACHE_PAGES_PSRAM                    (32)
+// the execute-in-place module image lives in the 64K gap between ota_0 and the
+// filesystem on 4MB flash; 8MB flash has no gap, so blocks there have to be
+// taken off the end of the filesystem (which then needs reformatting)
+#define MICROPY_PORT_XIP_BLOCK_COUNT_8MB                        0
+#define MICROPY_PORT_SFLASH_BLOCK_COUNT_8MB                     (1024 - MICROPY_PORT_XIP_BLOCK_COUNT_8MB - MICROPY_PORT_TSLOG_BLOCK_COUNT_8MB)
+#define MICROPY_PORT_XIP_START_ADDR_4MB                         0x0036E000
+#define MICROPY_PORT_XIP_SIZE_4MB                               (64 * 1024)
+#define MICROPY_PORT_XIP_START_ADDR_8MB                         (0x00800000 - MICROPY_PORT_XIP_SIZE_8MB)
+#define MICROPY_PORT_XIP_SIZE_8MB                               (MICROPY_PORT_XIP_BLOCK_COUNT_8MB * 4096)
+#define MICROPY_PORT_TSLOG_START_ADDR_4MB                       (0x00380000 + MICROPY_PORT_SFLASH_BLOCK_COUNT_4MB * 4096)
+#define MICROPY_PORT_TSLOG_START_ADDR_8MB                       (0x00400000 + MICROPY_PORT_SFLASH_BLOCK_COUNT_8MB * 4096)
 
 #define DEFAULT_AP_PASSWORD                                     "www.pycom.io"
 #define DEFAULT_AP_CHANNEL                                      (6)
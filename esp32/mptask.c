@@ -37,6 +37,7 @@
 #include "machuart.h"
 #include "machwdt.h"
 #include "machpin.h"
+#include "machtouch.h"
 #include "moduos.h"
 #include "mperror.h"
 #include "mpirq.h"
@@ -88,6 +89,11 @@
 #include "sflash_diskio_littlefs.h"
 #include "lteppp.h"
 #include "esp32chipinfo.h"
+#include "bootprof.h"
+#include "fsstate.h"
+#include "taskwdt.h"
+#include "crashdump.h"
+#include "pwrmgr.h"
 
 
 /******************************************************************************
@@ -106,12 +112,15 @@ extern TaskHandle_t svTaskHandle;
  ******************************************************************************/
 #define GC_POOL_SIZE_BYTES                                          (67 * 1024)
 #define GC_POOL_SIZE_BYTES_PSRAM                                    ((2048 + 512) * 1024)
+#define GC_POOL_SIZE_BYTES_FAST                                     (32 * 1024)
 
 /******************************************************************************
  DECLARE PRIVATE FUNCTIONS
  ******************************************************************************/
 STATIC void mptask_preinit (void);
 STATIC void mptask_init_sflash_filesystem (void);
+STATIC void mptask_remount_sflash_filesystem (void);
+STATIC void mptask_mount_sflash_vfs (void);
 STATIC void mptask_init_sflash_filesystem_fatfs(void);
 STATIC void mptask_create_main_py (void);
 STATIC void mptask_init_sflash_filesystem_littlefs(void);
@@ -129,6 +138,12 @@ fs_user_mount_t sflash_vfs_flash;
  DECLARE PRIVATE DATA
  ******************************************************************************/
 static uint8_t *gc_pool_upy;
+#if MICROPY_GC_SPLIT_HEAP
+// internal RAM area of the heap used for small objects when the main pool is in PSRAM
+static uint8_t *gc_pool_fast;
+#endif
+
+static bool mptask_warm_reset_req = false;
 
 static char fresh_main_py[] = "# main.py -- put your code here!\r\n";
 static char fresh_boot_py[] = "# boot.py -- run on boot-up\r\n";
@@ -141,6 +156,7 @@ void TASK_Micropython (void *pvParameters) {
     volatile uint32_t sp = (uint32_t)get_sp();
     uint32_t gc_pool_size;
     bool soft_reset = false;
+    bool warm_reset = false;
     uint32_t stack_len;
     bool safeboot = false;
     boot_info_t boot_info;
@@ -176,19 +192,21 @@ void TASK_Micropython (void *pvParameters) {
     antenna_init0();
     config_init0();
     mpsleep_init0();
+    mach_rtc_mono_init();
     if (mpsleep_get_reset_cause() != MPSLEEP_DEEPSLEEP_RESET) {
         rtc_init0();
     }
+    bootprof_init0();
+    taskwdt_init0();
+    crashdump_init0();
 
     // initialization that must not be repeted after a soft reset
     mptask_preinit();
+    pwrmgr_preinit();
 #if MICROPY_PY_THREAD
     mp_thread_preinit(mpTaskStack, stack_len, chip_rev);
     mp_irq_preinit();
 #endif
-    /* Creat Socket Operation task */
-    modusocket_pre_init();
-
     // initialise the stack pointer for the main thread (must be done after mp_thread_preinit)
     mp_stack_set_top((void *)sp);
 
@@ -209,18 +227,38 @@ void TASK_Micropython (void *pvParameters) {
         for ( ; ; );
     }
 
+#if MICROPY_GC_SPLIT_HEAP
+    if (esp32_get_chip_rev() > 0) {
+        // not fatal, the heap then lives in PSRAM only
+        gc_pool_fast = heap_caps_malloc(GC_POOL_SIZE_BYTES_FAST, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+#endif
+
     mach_timer_alarm_preinit();
     pin_preinit();
 
 soft_reset:
 
+    // a warm soft reset only rebuilds the Python side, the filesystem stays mounted
+    warm_reset = soft_reset && mptask_warm_reset_req;
+    mptask_warm_reset_req = false;
+
     // thread init
 #if MICROPY_PY_THREAD
     mp_thread_init();
 #endif
 
     // GC init
-    gc_init((void *)gc_pool_upy, (void *)(gc_pool_upy + gc_pool_size));
+#if MICROPY_GC_SPLIT_HEAP
+    if (gc_pool_fast != NULL) {
+        // small objects go to the internal RAM area, large buffers to the PSRAM one
+        gc_init((void *)gc_pool_fast, (void *)(gc_pool_fast + GC_POOL_SIZE_BYTES_FAST));
+        gc_add((void *)gc_pool_upy, (void *)(gc_pool_upy + gc_pool_size));
+    } else
+#endif
+    {
+        gc_init((void *)gc_pool_upy, (void *)(gc_pool_upy + gc_pool_size));
+    }
 
     // MicroPython init
     mp_init();
@@ -244,6 +282,7 @@ soft_reset:
     modbt_init0();
     machtimer_init0();
     modpycom_init0();
+    bootprof_mark(BOOTPROF_PHASE_STARTUP);
 
     if (!soft_reset) {
         if (config_get_wdt_on_boot()) {
@@ -255,8 +294,11 @@ soft_reset:
                 config_set_wdt_on_boot(false);
             }
         }
-        // Config Wifi as per Pycom config
-        mptask_config_wifi(false);
+        // Config Wifi as per Pycom config, unless we are fast booting out of deep sleep
+        if (!bootprof_is_fast_boot()) {
+            mptask_config_wifi(false);
+        }
+        bootprof_mark(BOOTPROF_PHASE_WIFI);
         // these ones are special because they need uPy running and they launch tasks
 #ifdef MOD_LORA_ENABLED
         modlora_init0();
@@ -266,24 +308,29 @@ soft_reset:
 #endif
     }
 
-    // initialize the serial flash file system
-    mptask_init_sflash_filesystem();
+    if (warm_reset) {
+        mptask_remount_sflash_filesystem();
+    } else {
+        // initialize the serial flash file system
+        mptask_init_sflash_filesystem();
 
-#if defined(MOD_LORA_ENABLED) || defined(MOD_SIGFOX_ENABLED)
-    // must be done after initializing the file system
-    mptask_update_lpwan_mac_address();
-#endif
+    #if defined(MOD_LORA_ENABLED) || defined(MOD_SIGFOX_ENABLED)
+        // must be done after initializing the file system
+        mptask_update_lpwan_mac_address();
+    #endif
 
-#ifdef MOD_SIGFOX_ENABLED
-    sigfox_update_id();
-    sigfox_update_pac();
-    sigfox_update_private_key();
-    sigfox_update_public_key();
-#endif
+    #ifdef MOD_SIGFOX_ENABLED
+        sigfox_update_id();
+        sigfox_update_pac();
+        sigfox_update_private_key();
+        sigfox_update_public_key();
+    #endif
+    }
 
     // append the flash paths to the system path
     mp_obj_list_append(mp_sys_path, MP_OBJ_NEW_QSTR(MP_QSTR__slash_flash));
     mp_obj_list_append(mp_sys_path, MP_OBJ_NEW_QSTR(MP_QSTR__slash_flash_slash_lib));
+    bootprof_mark(BOOTPROF_PHASE_FILESYSTEM);
 
     // reset config variables; they should be set by boot.py
     MP_STATE_PORT(machine_config_main) = MP_OBJ_NULL;
@@ -300,6 +347,7 @@ soft_reset:
         }
     #endif
     }
+    bootprof_mark(BOOTPROF_PHASE_FROZEN_BOOT);
 
     if (!safeboot) {
         // run boot.py
@@ -314,6 +362,7 @@ soft_reset:
 #endif
         }
     }
+    bootprof_mark(BOOTPROF_PHASE_BOOT_PY);
 
     if (!safeboot) {
         // execute the frozen main first
@@ -327,6 +376,7 @@ soft_reset:
 #else
         pyexec_frozen_module("_main.py");
 #endif
+        bootprof_mark(BOOTPROF_PHASE_FROZEN_MAIN);
 
         // run the main script from the current directory.
         if (pyexec_mode_kind == PYEXEC_MODE_FRIENDLY_REPL) {
@@ -371,18 +421,28 @@ soft_reset_exit:
     mp_thread_deinit();
 #endif
     mpsleep_signal_soft_reset();
-    mp_printf(&mp_plat_print, "PYB: soft reboot\n");
+    // a batch of settings left open by the script still gets written
+    config_commit();
+#if MICROPY_EMIT_NATIVE
+    esp_native_code_free_all();
+#endif
+    mp_printf(&mp_plat_print, mptask_warm_reset_req ? "PYB: warm soft reboot\n" : "PYB: soft reboot\n");
     // it needs to be this one in order to not mess with the GIL
     ets_delay_us(5000);
 
     uart_deinit_all();
     // TODO: rmt_deinit_all();
     rmt_deinit_rgb();
+    machtouch_deinit_all();
 
     soft_reset = true;
     goto soft_reset;
 }
 
+void mptask_request_warm_reset (void) {
+    mptask_warm_reset_req = true;
+}
+
 bool isLittleFs(const TCHAR *path){
 #ifndef FS_USE_LITTLEFS
     if (config_get_boot_fs_type() == 0x01) {
@@ -404,7 +464,7 @@ STATIC void mptask_preinit (void) {
     wlan_pre_init();
     //eth_pre_init();
     //TODO: Re-check this: increased stack is needed by modified FTP implementation due to LittleFS vs FatFs
-    xTaskCreatePinnedToCore(TASK_Servers, "Servers", 2*SERVERS_STACK_LEN, NULL, SERVERS_PRIORITY, &svTaskHandle, 1);
+    xTaskCreatePinnedToCore(TASK_Servers, "Servers", 2*SERVERS_STACK_LEN, NULL, SERVERS_PRIORITY, &svTaskHandle, config_get_service_core());
 }
 
 STATIC void mptask_init_sflash_filesystem(void) {
@@ -418,6 +478,41 @@ STATIC void mptask_init_sflash_filesystem(void) {
     }
 }
 
+// mount the flash device (there should be no other devices mounted at this point)
+STATIC void mptask_mount_sflash_vfs (void) {
+    // we allocate this structure on the heap because vfs->next is a root pointer
+    mp_vfs_mount_t *vfs = m_new_obj_maybe(mp_vfs_mount_t);
+    if (vfs == NULL) {
+        __fatal_error("failed to create /flash");
+    }
+    vfs->str = "/flash";
+    vfs->len = 6;
+    vfs->obj = MP_OBJ_FROM_PTR(&sflash_vfs_flash);
+    vfs->next = NULL;
+    MP_STATE_VM(vfs_mount_table) = vfs;
+
+    // The current directory is used as the boot up directory.
+    // It is set to the internal flash filesystem by default.
+    MP_STATE_PORT(vfs_cur) = vfs;
+}
+
+// the filesystem is still mounted from before the warm soft reset, only the
+// objects that lived in the Python heap have to be made again
+STATIC void mptask_remount_sflash_filesystem (void) {
+    fs_user_mount_t *vfs_flash = &sflash_vfs_flash;
+    if (config_get_boot_fs_type() == 0x01) {
+        xSemaphoreTake(vfs_flash->fs.littlefs.mutex, portMAX_DELAY);
+        // the open files were in the heap, littlefs mustn't walk them any more
+        vfs_flash->fs.littlefs.lfs.mlist = NULL;
+        vfs_flash->fs.littlefs.cwd[0] = '/';
+        vfs_flash->fs.littlefs.cwd[1] = '\0';
+        xSemaphoreGive(vfs_flash->fs.littlefs.mutex);
+    } else {
+        f_chdir(&vfs_flash->fs.fatfs, "/");
+    }
+    mptask_mount_sflash_vfs();
+}
+
 STATIC void mptask_init_sflash_filesystem_fatfs(void) {
     // Initialise the local flash filesystem.
     // init the vfs object
@@ -426,10 +521,13 @@ STATIC void mptask_init_sflash_filesystem_fatfs(void) {
     pyb_flash_init_vfs(vfs_fat);
 
     FILINFO fno;
+    // waking up from deep sleep, the one-time set-up was done on an earlier boot
+    bool fast_boot = bootprof_is_fast_boot();
 
     // Create it if needed, and mount it on /flash.
     FRESULT res = f_mount(&vfs_fat->fs.fatfs);
     if (res == FR_NO_FILESYSTEM) {
+        fast_boot = false;
         // no filesystem, so create a fresh one
         uint8_t working_buf[FF_MAX_SS];
         res = f_mkfs(&vfs_fat->fs.fatfs, FM_SFD | FM_FAT, 0, working_buf, sizeof(working_buf));
@@ -440,8 +538,9 @@ STATIC void mptask_init_sflash_filesystem_fatfs(void) {
         mptask_create_main_py();
     }
     else if (res == FR_OK) {
-        // mount sucessful
-        if (FR_OK != f_stat(&vfs_fat->fs.fatfs, "/main.py", &fno)) {
+        // mount sucessful, pick up the free cluster count from before the deep sleep
+        fsstate_restore_fatfs(&vfs_fat->fs.fatfs);
+        if (!fast_boot && FR_OK != f_stat(&vfs_fat->fs.fatfs, "/main.py", &fno)) {
             // create empty main.py
             mptask_create_main_py();
         }
@@ -449,21 +548,11 @@ STATIC void mptask_init_sflash_filesystem_fatfs(void) {
         __fatal_error("failed to create /flash");
     }
 
-    // mount the flash device (there should be no other devices mounted at this point)
-    // we allocate this structure on the heap because vfs->next is a root pointer
-    mp_vfs_mount_t *vfs = m_new_obj_maybe(mp_vfs_mount_t);
-    if (vfs == NULL) {
-        __fatal_error("failed to create /flash");
-    }
-    vfs->str = "/flash";
-    vfs->len = 6;
-    vfs->obj = MP_OBJ_FROM_PTR(vfs_fat);
-    vfs->next = NULL;
-    MP_STATE_VM(vfs_mount_table) = vfs;
+    mptask_mount_sflash_vfs();
 
-    // The current directory is used as the boot up directory.
-    // It is set to the internal flash filesystem by default.
-    MP_STATE_PORT(vfs_cur) = vfs;
+    if (fast_boot) {
+        return;
+    }
 
     // create /flash/sys, /flash/lib and /flash/cert if they don't exist
     if (FR_OK != f_chdir (&vfs_fat->fs.fatfs, "/sys")) {
@@ -521,7 +610,12 @@ STATIC void mptask_init_sflash_filesystem_littlefs(void) {
     }
 
     // Mount the file system if exists
-    if(LFS_ERR_OK != lfs_mount(littlefsptr, &lfscfg))
+    if(LFS_ERR_OK == lfs_mount(littlefsptr, &lfscfg))
+    {
+        // carry on allocating from where we were before the deep sleep
+        fsstate_restore_littlefs(littlefsptr);
+    }
+    else
     {
         // File system does not exist, create it and mount
         if(LFS_ERR_OK == lfs_format(littlefsptr, &lfscfg))
@@ -537,21 +631,7 @@ STATIC void mptask_init_sflash_filesystem_littlefs(void) {
         }
     }
 
-    // mount the flash device (there should be no other devices mounted at this point)
-    // we allocate this structure on the heap because vfs->next is a root pointer
-    mp_vfs_mount_t *vfs = m_new_obj_maybe(mp_vfs_mount_t);
-    if (vfs == NULL) {
-        __fatal_error("failed to create /flash");
-    }
-    vfs->str = "/flash";
-    vfs->len = 6;
-    vfs->obj = MP_OBJ_FROM_PTR(vfs_littlefs);
-    vfs->next = NULL;
-    MP_STATE_VM(vfs_mount_table) = vfs;
-
-    // The current directory is used as the boot up directory.
-    // It is set to the internal flash filesystem by default.
-    MP_STATE_PORT(vfs_cur) = vfs;
+    mptask_mount_sflash_vfs();
 
     //Initialize the current working directory (cwd)
     vfs_littlefs->fs.littlefs.cwd = (char*)malloc(2);
@@ -560,6 +640,11 @@ STATIC void mptask_init_sflash_filesystem_littlefs(void) {
 
     vfs_littlefs->fs.littlefs.mutex = xSemaphoreCreateMutex();
 
+    if (bootprof_is_fast_boot()) {
+        // the files and directories below were created before the deep sleep
+        return;
+    }
+
     xSemaphoreTake(vfs_littlefs->fs.littlefs.mutex, portMAX_DELAY);
 
     // create empty main.py if does not exist
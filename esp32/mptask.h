@@ -33,4 +33,5 @@ extern fs_user_mount_t sflash_vfs_flash;
 extern void TASK_Micropython (void *pvParameters);
 extern bool isLittleFs(const TCHAR *path);
 extern void mptask_config_wifi(bool force_start);
+extern void mptask_request_warm_reset (void);
 #endif /* MPTASK_H_ */
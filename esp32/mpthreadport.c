@@ -36,11 +36,13 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "py/mpconfig.h"
 #include "py/mpstate.h"
 #include "py/gc.h"
 #include "py/mpthread.h"
+#include "py/mphal.h"
 
 #include "sdkconfig.h"
 #include "esp_system.h"
@@ -49,10 +51,14 @@
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "freertos/queue.h"
+#include "esp_heap_caps.h"
 
 #include  "py/gc.h"
 
 #include "mpirq.h"
+#include "pycom_config.h"
+#include "tracering.h"
+#include "taskwdt.h"
 
 #if MICROPY_PY_THREAD
 
@@ -67,6 +73,8 @@ typedef struct _thread_t {
     void *stack;            // pointer to the stack
     StaticTask_t *tcb;      // pointer to the Task Control Block
     size_t stack_len;       // number of words in the stack
+    size_t stack_size;      // size of the stack as allocated, in bytes
+    const char *name;       // task name
     struct _thread_t *next;
 } thread_t;
 
@@ -77,6 +85,24 @@ STATIC thread_t *thread; // root pointer, handled by mp_thread_gc_others
 
 STATIC bool during_soft_reset = false;
 STATIC uint8_t mp_chip_revision;
+STATIC BaseType_t thread_core = PYCOM_CORE_AFFINITY_DEFAULT; // core for new threads, or tskNO_AFFINITY
+
+// system task handles, see main.c
+extern TaskHandle_t svTaskHandle;
+#if defined(LOPY) || defined (LOPY4) || defined (FIPY)
+extern TaskHandle_t xLoRaTaskHndl;
+extern TaskHandle_t xLoRaTimerTaskHndl;
+#endif
+#if defined(SIPY) || defined (LOPY4) || defined (FIPY)
+extern TaskHandle_t xSigfoxTaskHndl;
+#endif
+#if defined(GPY) || defined (FIPY)
+extern TaskHandle_t xLTETaskHndl;
+extern TaskHandle_t xLTEUartEvtTaskHndl;
+#endif
+#if defined(LORA_OPENTHREAD_ENABLED)
+extern TaskHandle_t xMeshTaskHndl;
+#endif
 
 void mp_thread_preinit(void *stack, uint32_t stack_len, uint8_t chip_revision) {
     mp_thread_set_state(&mp_state_ctx.thread);
@@ -87,6 +113,8 @@ void mp_thread_preinit(void *stack, uint32_t stack_len, uint8_t chip_revision) {
     thread->arg = NULL;
     thread->stack = stack;
     thread->stack_len = stack_len;
+    thread->stack_size = stack_len * sizeof(StackType_t);
+    thread->name = "MicroPy";
     thread->next = NULL;
     mp_chip_revision = chip_revision;
 }
@@ -96,6 +124,23 @@ void mp_thread_init(void) {
     {
         mp_thread_mutex_init(&thread_mutex);
     }
+    // start every soft reset with the core affinity stored in the config block
+    uint8_t core = config_get_thread_core();
+    thread_core = (core == PYCOM_CORE_AFFINITY_ANY) ? tskNO_AFFINITY : core;
+}
+
+int mp_thread_get_core_affinity(void) {
+    return (thread_core == tskNO_AFFINITY) ? -1 : thread_core;
+}
+
+void mp_thread_set_core_affinity(int core) {
+    if (core == -1) {
+        thread_core = tskNO_AFFINITY;
+    } else if (core >= 0 && core < portNUM_PROCESSORS) {
+        thread_core = core;
+    } else {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "invalid core"));
+    }
 }
 
 void mp_thread_gc_others(void) {
@@ -154,7 +199,7 @@ STATIC void freertos_entry(void *arg) {
     for (;;);
 }
 
-void mp_thread_create_ex(void *(*entry)(void*), void *arg, size_t *stack_size, int priority, char *name) {
+STATIC void mp_thread_create_in(void *(*entry)(void*), void *arg, size_t *stack_size, int priority, char *name, bool ext_ram) {
     // store thread entry function into a global variable so we can access it
     ext_thread_entry = entry;
 
@@ -169,7 +214,27 @@ void mp_thread_create_ex(void *(*entry)(void*), void *arg, size_t *stack_size, i
     thread_t *th;
 
     // allocate TCB, stack and linked-list node (must be outside thread_mutex lock)
-    if (mp_chip_revision > 0) {
+    if (ext_ram) {
+        // only the stack goes to PSRAM, the TCB must stay in internal memory
+        if (mp_chip_revision == 0) {
+            nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, "no PSRAM stacks on this chip"));
+        }
+        tcb = malloc(sizeof(StaticTask_t));
+        if (!tcb) {
+            goto memory_error;
+        }
+        stack = heap_caps_malloc(*stack_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!stack) {
+            free(tcb);
+            goto memory_error;
+        }
+        th = malloc(sizeof(thread_t));
+        if (!th) {
+            free(stack);
+            free(tcb);
+            goto memory_error;
+        }
+    } else if (mp_chip_revision > 0) {
         // for revision 1 devices we allocate from the internal memory of the malloc heap
         tcb = malloc(sizeof(StaticTask_t));
         if (!tcb) {
@@ -193,7 +258,7 @@ void mp_thread_create_ex(void *(*entry)(void*), void *arg, size_t *stack_size, i
     mp_thread_mutex_lock(&thread_mutex, 1);
 
     // create thread
-    TaskHandle_t id = xTaskCreateStaticPinnedToCore(freertos_entry, name, *stack_size / sizeof(StackType_t), arg, priority, stack, tcb, 1);
+    TaskHandle_t id = xTaskCreateStaticPinnedToCore(freertos_entry, name, *stack_size / sizeof(StackType_t), arg, priority, stack, tcb, thread_core);
     if (id == NULL) {
         mp_thread_mutex_unlock(&thread_mutex);
         nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "can't create thread"));
@@ -208,7 +273,9 @@ void mp_thread_create_ex(void *(*entry)(void*), void *arg, size_t *stack_size, i
     th->arg = arg;
     th->stack = stack;
     th->tcb = tcb;
+    th->stack_size = *stack_size + 1024;
     th->stack_len = *stack_size / sizeof(StackType_t);
+    th->name = name;
     th->next = thread;
     thread = th;
 
@@ -220,10 +287,95 @@ memory_error:
     nlr_raise(mp_obj_new_exception_msg(&mp_type_MemoryError, "can't create thread"));
 }
 
+void mp_thread_create_ex(void *(*entry)(void*), void *arg, size_t *stack_size, int priority, char *name) {
+    mp_thread_create_in(entry, arg, stack_size, priority, name, false);
+}
+
 void mp_thread_create(void *(*entry)(void*), void *arg, size_t *stack_size) {
     mp_thread_create_ex(entry, arg, stack_size, MP_THREAD_PRIORITY, "MPThread");
 }
 
+void mp_thread_create_ext_ram(void *(*entry)(void*), void *arg, size_t *stack_size) {
+    mp_thread_create_in(entry, arg, stack_size, MP_THREAD_PRIORITY, "MPThread", true);
+}
+
+STATIC mp_obj_t mp_thread_stack_tuple(const char *name, TaskHandle_t id, mp_obj_t size, size_t free) {
+    mp_obj_t tuple[4] = {
+        mp_obj_new_str(name, strlen(name)),
+        mp_obj_new_int_from_uint((uintptr_t)id),
+        size,
+        mp_obj_new_int_from_uint(free),
+    };
+    return mp_obj_new_tuple(4, tuple);
+}
+
+mp_obj_t mp_thread_stack_info(void) {
+    // the system tasks, whose stacks are sized at compile time
+    static const struct {
+        const char *name;
+        TaskHandle_t *id;
+    } sys_tasks[] = {
+        { "Servers", &svTaskHandle },
+        #if defined(LOPY) || defined (LOPY4) || defined (FIPY)
+        { "LoRa", &xLoRaTaskHndl },
+        { "LoRa_Timer", &xLoRaTimerTaskHndl },
+        #endif
+        #if defined(SIPY) || defined (LOPY4) || defined (FIPY)
+        { "Sigfox", &xSigfoxTaskHndl },
+        #endif
+        #if defined(GPY) || defined (FIPY)
+        { "LTE", &xLTETaskHndl },
+        { "LTE_UART_EVT", &xLTEUartEvtTaskHndl },
+        #endif
+        #if defined(LORA_OPENTHREAD_ENABLED)
+        { "Mesh", &xMeshTaskHndl },
+        #endif
+    };
+    typedef struct {
+        const char *name;
+        TaskHandle_t id;
+        size_t size;
+        size_t free;
+    } stack_snapshot_t;
+
+    // take a snapshot under the lock, a thread may end while we build the list
+    mp_thread_mutex_lock(&thread_mutex, 1);
+    size_t n = 0;
+    for (thread_t *th = thread; th != NULL; th = th->next) {
+        n++;
+    }
+    mp_thread_mutex_unlock(&thread_mutex);
+    // leave room for threads started before we take the lock again
+    n += 4;
+    stack_snapshot_t *snap = m_new(stack_snapshot_t, n);
+    size_t len = 0;
+    mp_thread_mutex_lock(&thread_mutex, 1);
+    for (thread_t *th = thread; th != NULL && len < n; th = th->next) {
+        snap[len].name = th->name;
+        snap[len].id = th->id;
+        snap[len].size = th->stack_size;
+        // the high water mark is counted in StackType_t units
+        snap[len].free = uxTaskGetStackHighWaterMark(th->id) * sizeof(StackType_t);
+        len++;
+    }
+    mp_thread_mutex_unlock(&thread_mutex);
+
+    mp_obj_t list = mp_obj_new_list(0, NULL);
+    for (size_t i = 0; i < len; i++) {
+        mp_obj_list_append(list, mp_thread_stack_tuple(snap[i].name, snap[i].id,
+                                                       mp_obj_new_int_from_uint(snap[i].size), snap[i].free));
+    }
+    m_del(stack_snapshot_t, snap, n);
+
+    for (size_t i = 0; i < MP_ARRAY_SIZE(sys_tasks); i++) {
+        if (*sys_tasks[i].id != NULL) {
+            size_t free = uxTaskGetStackHighWaterMark(*sys_tasks[i].id) * sizeof(StackType_t);
+            mp_obj_list_append(list, mp_thread_stack_tuple(sys_tasks[i].name, *sys_tasks[i].id, mp_const_none, free));
+        }
+    }
+    return list;
+}
+
 void mp_thread_finish(void) {
     mp_thread_mutex_lock(&thread_mutex, 1);
     for (thread_t *th = thread; th != NULL; th = th->next) {
@@ -238,6 +390,8 @@ void mp_thread_finish(void) {
 void vPortCleanUpTCB (void *tcb) {
     thread_t *prev = NULL;
 
+    taskwdt_forget(tcb);
+
     /* If we are performing soft-reset the mutex has been already taken by mp_thread_deinit,
      * do not try to take it here again as it causes deadlock.
      * As the mutex is already taken, performing actions on the "thread" list is safe. */
@@ -295,13 +449,72 @@ void mp_thread_mutex_init(mp_thread_mutex_t *mutex) {
 }
 
 int mp_thread_mutex_lock(mp_thread_mutex_t *mutex, int wait) {
-    return (pdTRUE == xSemaphoreTake(mutex->handle, wait ? portMAX_DELAY : 0));
+    if (pdTRUE == xSemaphoreTake(mutex->handle, wait ? portMAX_DELAY : 0)) {
+        if (mutex == &MP_STATE_VM(gil_mutex)) {
+            TRACE_BEGIN(TRACE_EV_GIL, 0);
+        }
+        return 1;
+    }
+    return 0;
 }
 
 void mp_thread_mutex_unlock(mp_thread_mutex_t *mutex) {
+    if (mutex == &MP_STATE_VM(gil_mutex)) {
+        TRACE_END(TRACE_EV_GIL, 0);
+    }
     xSemaphoreGive(mutex->handle);
 }
 
+#if MICROPY_PY_THREAD_GIL_ADAPTIVE
+// the waiter counts are updated by threads not holding the GIL, on either core
+STATIC portMUX_TYPE gil_waiters_mux = portMUX_INITIALIZER_UNLOCKED;
+
+STATIC void mp_thread_gil_take(bool from_io) {
+    if (!mp_thread_mutex_lock(&MP_STATE_VM(gil_mutex), 0)) {
+        portENTER_CRITICAL(&gil_waiters_mux);
+        MP_STATE_VM(gil_waiting)++;
+        if (from_io) {
+            MP_STATE_VM(gil_io_waiting)++;
+        }
+        portEXIT_CRITICAL(&gil_waiters_mux);
+        // the mutex raises the holder to our priority while we wait
+        mp_thread_mutex_lock(&MP_STATE_VM(gil_mutex), 1);
+        portENTER_CRITICAL(&gil_waiters_mux);
+        MP_STATE_VM(gil_waiting)--;
+        if (from_io) {
+            MP_STATE_VM(gil_io_waiting)--;
+        }
+        portEXIT_CRITICAL(&gil_waiters_mux);
+        MP_STATE_VM(gil_contended)++;
+    }
+    MP_STATE_VM(gil_acquires)++;
+    MP_STATE_VM(gil_slice_start) = (uint32_t)mp_hal_ticks_us_non_blocking();
+}
+
+void mp_thread_gil_enter(void) {
+    mp_thread_gil_take(true);
+}
+
+bool mp_thread_gil_should_yield(void) {
+    // a thread back from blocking I/O doesn't have to wait for the slice to end
+    return MP_STATE_VM(gil_io_waiting) != 0
+        || (uint32_t)mp_hal_ticks_us_non_blocking() - MP_STATE_VM(gil_slice_start) >= MP_STATE_VM(gil_slice_us);
+}
+
+void mp_thread_gil_handoff(void) {
+    uint32_t acquires = MP_STATE_VM(gil_acquires);
+    MP_STATE_VM(gil_handoffs)++;
+    mp_thread_mutex_unlock(&MP_STATE_VM(gil_mutex));
+    // the give only readies the waiter: let it run if it has our priority,
+    // and step aside for a tick if it is lower and still hasn't got in
+    taskYIELD();
+    if (MP_STATE_VM(gil_acquires) == acquires && MP_STATE_VM(gil_waiting) != 0) {
+        vTaskDelay(1);
+    }
+    mp_thread_gil_take(false);
+}
+#endif
+
 void mp_thread_deinit(void) {
     mp_thread_mutex_lock(&thread_mutex, 1);
     during_soft_reset = true;
@@ -323,7 +536,7 @@ void mp_thread_deinit(void) {
 #else
 
 void vPortCleanUpTCB (void *tcb) {
-
+    taskwdt_forget(tcb);
 }
 
 #endif // MICROPY_PY_THREAD
@@ -15,6 +15,7 @@
 #include "diskio.h"
 #include "sflash_diskio.h"
 #include "pycom_config.h"
+#include "rom/crc.h"
 
 #define CONFIG_DATA_FLASH_BLOCK         (SFLASH_START_BLOCK_4MB + SFLASH_BLOCK_COUNT_4MB)
 #define CONFIG_DATA_FLASH_ADDR          (SFLASH_START_ADDR_4MB + (SFLASH_BLOCK_COUNT_4MB * SFLASH_BLOCK_SIZE))
@@ -22,10 +23,37 @@
 static bool config_write (void);
 
 static pycom_config_block_t pycom_config_block;
+// what the flash sector holds, to leave it alone when nothing has changed
+static uint32_t config_flash_crc;
+// while batching the setters only change the RAM copy
+static bool config_batching;
+static bool config_dirty;
+
+static uint32_t config_crc (void) {
+    return crc32_le(UINT32_MAX, (const uint8_t *)&pycom_config_block, sizeof(pycom_config_block));
+}
 
 void config_init0 (void) {
     // read the config struct from flash
     spi_flash_read(CONFIG_DATA_FLASH_ADDR, (void *)&pycom_config_block, sizeof(pycom_config_block));
+    config_flash_crc = config_crc();
+}
+
+void config_batch_begin (void) {
+    config_batching = true;
+}
+
+bool config_get_batching (void) {
+    return config_batching;
+}
+
+// ends a batch, the changes made during it are written with a single sector erase
+bool config_commit (void) {
+    config_batching = false;
+    if (config_dirty) {
+        return config_write();
+    }
+    return true;
 }
 
 bool config_set_lpwan_mac (const uint8_t *mac) {
@@ -243,6 +271,52 @@ bool config_get_lte_modem_enable_on_boot (void) {
     return (bool)pycom_config_block.lte_config.lte_modem_en_on_boot;
 }
 
+bool config_set_service_core (uint8_t service_core) {
+    if (pycom_config_block.core_affinity_config.service_core != service_core) {
+        pycom_config_block.core_affinity_config.service_core = service_core;
+        return config_write();
+    }
+    return true;
+}
+
+uint8_t config_get_service_core (void) {
+    uint8_t core = pycom_config_block.core_affinity_config.service_core;
+    // an erased config block reads back as 0xFF
+    if (core > PYCOM_CORE_AFFINITY_CORE_1) {
+        return PYCOM_CORE_AFFINITY_DEFAULT;
+    }
+    return core;
+}
+
+bool config_set_thread_core (uint8_t thread_core) {
+    if (pycom_config_block.core_affinity_config.thread_core != thread_core) {
+        pycom_config_block.core_affinity_config.thread_core = thread_core;
+        return config_write();
+    }
+    return true;
+}
+
+uint8_t config_get_thread_core (void) {
+    uint8_t core = pycom_config_block.core_affinity_config.thread_core;
+    if (core > PYCOM_CORE_AFFINITY_ANY) {
+        return PYCOM_CORE_AFFINITY_DEFAULT;
+    }
+    return core;
+}
+
+bool config_set_fast_boot_on_wake (bool fast_boot_on_wake) {
+    if (pycom_config_block.boot_config.fast_boot_on_wake != (uint8_t)fast_boot_on_wake) {
+        pycom_config_block.boot_config.fast_boot_on_wake = (uint8_t)fast_boot_on_wake;
+        return config_write();
+    }
+    return true;
+}
+
+bool config_get_fast_boot_on_wake (void) {
+    // an erased config block reads back as 0xFF, which means disabled
+    return pycom_config_block.boot_config.fast_boot_on_wake == 1;
+}
+
 #if (VARIANT == PYBYTES)
 bool config_set_pybytes_force_update (uint8_t force_update) {
     if (pycom_config_block.pybytes_config.force_update != force_update) {
@@ -406,10 +480,25 @@ bool config_get_pybytes_autostart (void) {
 }
 
 static bool config_write (void) {
+    if (config_batching) {
+        config_dirty = true;
+        return true;
+    }
+    uint32_t crc = config_crc();
+    if (crc == config_flash_crc) {
+        config_dirty = false;
+        return true;
+    }
     // erase the block first
     if (ESP_OK == spi_flash_erase_sector(CONFIG_DATA_FLASH_BLOCK)) {
         // then write it
-        return (spi_flash_write(CONFIG_DATA_FLASH_ADDR, (void *)&pycom_config_block, sizeof(pycom_config_block)) == ESP_OK);
+        if (spi_flash_write(CONFIG_DATA_FLASH_ADDR, (void *)&pycom_config_block, sizeof(pycom_config_block)) == ESP_OK) {
+            config_flash_crc = crc;
+            config_dirty = false;
+            return true;
+        }
     }
+    // the sector is in an unknown state now
+    config_flash_crc = ~crc;
     return false;
 }
@@ -25,6 +25,11 @@
 /******************************************************************************
  DEFINE CONSTANTS
  ******************************************************************************/
+// core affinity of the service tasks and Python threads
+#define PYCOM_CORE_AFFINITY_CORE_0              (0)
+#define PYCOM_CORE_AFFINITY_CORE_1              (1)
+#define PYCOM_CORE_AFFINITY_ANY                 (2)     // only valid for Python threads
+#define PYCOM_CORE_AFFINITY_DEFAULT             PYCOM_CORE_AFFINITY_CORE_1
 
 /******************************************************************************
  DEFINE TYPES
@@ -108,7 +113,17 @@ typedef struct {
     uint8_t band;
     uint8_t reset;
 } pycom_pybytes_lte_config_t;
-// pycom_pybytes_lte_config_t is the last used member of pycom_config_block_t, so no _Static_assert(sizeof()) needed
+_Static_assert(sizeof(pycom_pybytes_lte_config_t) == 278, "pycom_pybytes_lte_config_t should have a size of 278 bytes");
+
+typedef struct {
+    uint8_t service_core;       // LoRa, LTE, sockets, servers, ethernet and Pygate tasks
+    uint8_t thread_core;        // Python threads
+} pycom_core_affinity_config_t;
+
+typedef struct {
+    uint8_t fast_boot_on_wake;  // skip the safe boot wait, WiFi and file system checks after a deep sleep
+} pycom_boot_config_t;
+// pycom_boot_config_t is the last used member of pycom_config_block_t, so no _Static_assert(sizeof()) needed
 
 typedef struct {                                         // size
     pycom_lpwan_config_t lpwan_config;                   //   53
@@ -122,7 +137,9 @@ typedef struct {                                         // size
     pycom_config_t pycom_config;                         //   15
     pycom_wifi_ap_config_t wifi_ap_config;               //   98
     pycom_pybytes_lte_config_t pycom_pybytes_lte_config; //  278
-    uint8_t pycom_reserved[112];                         //  112
+    pycom_core_affinity_config_t core_affinity_config;   //    2
+    pycom_boot_config_t boot_config;                     //    1
+    uint8_t pycom_reserved[109];                         //  109
 } pycom_config_block_t;                                  // 1024
 _Static_assert(sizeof(pycom_config_block_t) == 1024, "pycom_config_block_t should have a size of 1024 bytes"); // partition is 4Kb, I think multiples of 1Kb <= 4Kb are ok
 
@@ -139,6 +156,12 @@ typedef enum
  ******************************************************************************/
 void config_init0(void);
 
+void config_batch_begin(void);
+
+bool config_get_batching(void);
+
+bool config_commit(void);
+
 bool config_set_lpwan_mac(const uint8_t *mac);
 
 void config_get_lpwan_mac(uint8_t *mac);
@@ -245,4 +268,16 @@ bool config_set_pybytes_autostart (bool pybytes_autostart);
 
 bool config_get_pybytes_autostart (void);
 
+bool config_set_service_core (uint8_t service_core);
+
+uint8_t config_get_service_core (void);
+
+bool config_set_thread_core (uint8_t thread_core);
+
+uint8_t config_get_thread_core (void);
+
+bool config_set_fast_boot_on_wake (bool fast_boot_on_wake);
+
+bool config_get_fast_boot_on_wake (void);
+
 #endif /* PYCOM_CONFIG_H_ */
@@ -24,10 +24,9 @@ Maintainer: Michael Coracin
 /* -------------------------------------------------------------------------- */
 /* --- DEPENDANCIES --------------------------------------------------------- */
 
-#define _GNU_SOURCE     /* needed for qsort_r to be defined */
-#include <stdlib.h>     /* qsort_r */
+#include <stdlib.h>
 #include <stdio.h>      /* printf, fprintf, snprintf, fopen, fputs */
-#include <string.h>     /* memset, memcpy */
+#include <string.h>     /* memset, memcpy, memmove */
 #include <pthread.h>
 #include <assert.h>
 #include <math.h>
@@ -38,6 +37,12 @@ Maintainer: Michael Coracin
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
 
+/* Timestamps are compared relatively, so that the order survives the counter roll-over.
+   All the packets of the queue are within TX_MAX_ADVANCE_DELAY of each other, far below 2^31 us */
+#define TIME_BEFORE(a, b)       ((int32_t)((uint32_t)(a) - (uint32_t)(b)) < 0)
+
+#define NODE(queue, rank)       (&(queue)->nodes[(queue)->order[(rank)]])
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE CONSTANTS & TYPES -------------------------------------------- */
 #define TX_START_DELAY          1500    /* microseconds */
@@ -51,6 +56,8 @@ Maintainer: Michael Coracin
                                             to ensure beacon can be sent */
 #define BEACON_RESERVED         2120000 /* Time on air of the beacon, with some margin */
 
+#define PRE_DELAY_MAX           (TX_START_DELAY + BEACON_GUARD + TX_JIT_DELAY) /* Largest pre_delay a node can have */
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES (GLOBAL) ------------------------------------------- */
 static pthread_mutex_t mx_jit_queue = PTHREAD_MUTEX_INITIALIZER; /* control access to JIT queue */
@@ -58,6 +65,83 @@ static pthread_mutex_t mx_jit_queue = PTHREAD_MUTEX_INITIALIZER; /* control acce
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
+static bool jit_collision_test(uint32_t p1_count_us, uint32_t p1_pre_delay, uint32_t p1_post_delay, uint32_t p2_count_us, uint32_t p2_pre_delay, uint32_t p2_post_delay) {
+    if (((p1_count_us - p2_count_us) <= (p1_pre_delay + p2_post_delay + TX_MARGIN_DELAY)) ||
+            ((p2_count_us - p1_count_us) <= (p2_pre_delay + p1_post_delay + TX_MARGIN_DELAY))) {
+        return true;
+    } else {
+        return false;
+    }
+}
+
+/* rank of the first packet not scheduled before count_us */
+static int jit_lower_bound(struct jit_queue_s *queue, uint32_t count_us) {
+    int lo = 0;
+    int hi = queue->num_pkt;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (TIME_BEFORE(NODE(queue, mid)->pkt.count_us, count_us)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* rank of a packet colliding with the given one, -1 if there's none
+ * Only the packets close enough to count_us to possibly overlap are tested: walking away from
+ * the insertion point, the search stops as soon as the gap exceeds the largest possible reservation */
+static int jit_find_collision(struct jit_queue_s *queue, uint32_t count_us, uint32_t pre_delay, uint32_t post_delay, bool ignore_beacon_guard) {
+    struct jit_node_s *node;
+    uint32_t target_pre_delay;
+    int rank = jit_lower_bound(queue, count_us);
+    int i;
+
+    /* packets before, they can only reach us with their post_delay */
+    for (i = rank - 1; i >= 0; i--) {
+        node = NODE(queue, i);
+        if ((count_us - node->pkt.count_us) > (pre_delay + queue->max_post_delay + TX_MARGIN_DELAY)) {
+            break;
+        }
+        target_pre_delay = (ignore_beacon_guard && (node->pkt_type == JIT_PKT_TYPE_BEACON)) ? TX_START_DELAY : node->pre_delay;
+        if (jit_collision_test(count_us, pre_delay, post_delay, node->pkt.count_us, target_pre_delay, node->post_delay) == true) {
+            return i;
+        }
+    }
+
+    /* packets after, they can only reach us with their pre_delay */
+    for (i = rank; i < queue->num_pkt; i++) {
+        node = NODE(queue, i);
+        if ((node->pkt.count_us - count_us) > (PRE_DELAY_MAX + post_delay + TX_MARGIN_DELAY)) {
+            break;
+        }
+        target_pre_delay = (ignore_beacon_guard && (node->pkt_type == JIT_PKT_TYPE_BEACON)) ? TX_START_DELAY : node->pre_delay;
+        if (jit_collision_test(count_us, pre_delay, post_delay, node->pkt.count_us, target_pre_delay, node->post_delay) == true) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* moves the node at rank to the free slots, the queue mutex must be held */
+static void jit_remove(struct jit_queue_s *queue, int rank) {
+    uint8_t slot = queue->order[rank];
+
+    if (queue->nodes[slot].pkt_type == JIT_PKT_TYPE_BEACON) {
+        queue->num_beacon--;
+    }
+    queue->num_pkt--;
+    memmove(&queue->order[rank], &queue->order[rank + 1], queue->num_pkt - rank);
+    queue->order[queue->num_pkt] = slot;
+    memset(&queue->nodes[slot], 0, sizeof(struct jit_node_s));
+    if (queue->num_pkt == 0) {
+        queue->max_post_delay = 0;
+    }
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ----------------------------------------- */
 
@@ -66,7 +150,7 @@ bool jit_queue_is_full(struct jit_queue_s *queue) {
 
     pthread_mutex_lock(&mx_jit_queue);
 
-    result = (queue->num_pkt == JIT_QUEUE_MAX) ? true : false;
+    result = (queue->num_pkt >= queue->capacity) ? true : false;
 
     pthread_mutex_unlock(&mx_jit_queue);
 
@@ -85,65 +169,30 @@ bool jit_queue_is_empty(struct jit_queue_s *queue) {
     return result;
 }
 
-void jit_queue_init(struct jit_queue_s *queue) {
+void jit_queue_init(struct jit_queue_s *queue, int capacity) {
     int i;
 
     pthread_mutex_lock(&mx_jit_queue);
 
     memset(queue, 0, sizeof(*queue));
+    queue->capacity = ((capacity <= 0) || (capacity > JIT_QUEUE_MAX)) ? JIT_QUEUE_MAX : capacity;
     for (i = 0; i < JIT_QUEUE_MAX; i++) {
-        queue->nodes[i].pre_delay = 0;
-        queue->nodes[i].post_delay = 0;
+        queue->order[i] = i;
     }
 
     pthread_mutex_unlock(&mx_jit_queue);
 }
 
-int compare(const void *a, const void *b, void *arg) {
-    struct jit_node_s *p = (struct jit_node_s *)a;
-    struct jit_node_s *q = (struct jit_node_s *)b;
-    int *counter = (int *)arg;
-    int p_count, q_count;
-
-    p_count = p->pkt.count_us;
-    q_count = q->pkt.count_us;
-
-    if (p_count > q_count) {
-        *counter = *counter + 1;
-    }
-
-    return p_count - q_count;
-}
-
-void jit_sort_queue(struct jit_queue_s *queue) {
-    int counter = 0;
-
-    if (queue->num_pkt == 0) {
-        return;
-    }
-
-    //MSG_DEBUG("jit: sorting queue in ascending order packet timestamp - queue size:%u\n", queue->num_pkt);
-    qsort_r(queue->nodes, queue->num_pkt, sizeof(queue->nodes[0]), compare, &counter);
-    //MSG_DEBUG("jit: sorting queue done - swapped:%d\n", counter);
-}
-
-bool jit_collision_test(uint32_t p1_count_us, uint32_t p1_pre_delay, uint32_t p1_post_delay, uint32_t p2_count_us, uint32_t p2_pre_delay, uint32_t p2_post_delay) {
-    if (((p1_count_us - p2_count_us) <= (p1_pre_delay + p2_post_delay + TX_MARGIN_DELAY)) ||
-            ((p2_count_us - p1_count_us) <= (p2_pre_delay + p1_post_delay + TX_MARGIN_DELAY))) {
-        return true;
-    } else {
-        return false;
-    }
-}
-
 enum jit_error_e jit_enqueue(struct jit_queue_s *queue, struct timeval *time, struct lgw_pkt_tx_s *packet, enum jit_pkt_type_e pkt_type) {
     int i = 0;
+    int rank;
+    uint8_t slot;
     uint32_t time_us = time->tv_sec * 1000000UL + time->tv_usec; /* convert time in µs */
     uint32_t packet_post_delay = 0;
     uint32_t packet_pre_delay = 0;
-    uint32_t target_pre_delay = 0;
     enum jit_error_e err_collision = JIT_ERROR_OK;
     uint32_t asap_count_us;
+    bool ignore_beacon_guard;
 
     if (packet == NULL) {
         MSG_ERROR("jitqueue: invalid parameter\n");
@@ -174,6 +223,9 @@ enum jit_error_e jit_enqueue(struct jit_queue_s *queue, struct timeval *time, st
             break;
     }
 
+    /* We ignore Beacon Guard for Class A/C downlinks */
+    ignore_beacon_guard = (pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_A) || (pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_C);
+
     pthread_mutex_lock(&mx_jit_queue);
 
     /* An immediate downlink becomes a timestamped downlink "ASAP" */
@@ -183,45 +235,30 @@ enum jit_error_e jit_enqueue(struct jit_queue_s *queue, struct timeval *time, st
         packet->tx_mode = TIMESTAMPED;
 
         /* Search for the ASAP timestamp to be given to the packet */
-        asap_count_us = time_us + 1E6; /*FIXME:this is a double literal*/ /* TODO: Take 1 second margin, to be refined */
+        asap_count_us = time_us + 1000000UL; /* TODO: Take 1 second margin, to be refined */
         if (queue->num_pkt == 0) {
             /* If the jit queue is empty, we can insert this packet */
             MSG_DEBUG("insert IMMEDIATE downlink, first in JiT queue (count_us=%u)\n", asap_count_us);
         } else {
             /* Else we can try to insert it:
                 - ASAP meaning NOW + MARGIN
-                - at the last index of the queue
-                - between 2 downlinks in the queue
+                - right after the packet it collides with, or one of the following ones
             */
 
             /* First, try if the ASAP time collides with an already enqueued downlink */
-            for (i = 0; i < queue->num_pkt; i++) {
-                if (jit_collision_test(asap_count_us, packet_pre_delay, packet_post_delay, queue->nodes[i].pkt.count_us, queue->nodes[i].pre_delay, queue->nodes[i].post_delay) == true) {
-                    MSG_DEBUG("cannot insert IMMEDIATE downlink at asap_count_us=%u, collides with pkt.count_us=%u (index=%d)\n", asap_count_us, queue->nodes[i].pkt.count_us, i);
-                    break;
-                }
-            }
-            if (i == queue->num_pkt) {
+            i = jit_find_collision(queue, asap_count_us, packet_pre_delay, packet_post_delay, ignore_beacon_guard);
+            if (i < 0) {
                 /* No collision with ASAP time, we can insert it */
                 MSG_DEBUG("insert IMMEDIATE downlink ASAP at asap_count_us=%u (no collision)\n", asap_count_us);
             } else {
-                /* Search for the best slot then */
-                for (i = 0; i < queue->num_pkt; i++) {
-                    asap_count_us = queue->nodes[i].pkt.count_us + queue->nodes[i].post_delay + packet_pre_delay + TX_JIT_DELAY + TX_MARGIN_DELAY;
-                    if (i == (queue->num_pkt - 1)) {
-                        /* Last packet index, we can insert after this one */
-                        MSG_DEBUG("insert IMMEDIATE downlink, last in JiT queue (count_us=%u)\n", asap_count_us);
-                    } else {
-                        /* Check if packet can be inserted between this index and the next one */
-                        MSG_DEBUG("try to insert IMMEDIATE downlink (count_us=%u) between index %d and index %d?\n", asap_count_us, i, i + 1);
-                        if (jit_collision_test(asap_count_us, packet_pre_delay, packet_post_delay, queue->nodes[i + 1].pkt.count_us, queue->nodes[i + 1].pre_delay, queue->nodes[i + 1].post_delay) == true) {
-                            MSG_DEBUG("failed to insert IMMEDIATE downlink (asap_count_us=%u), continue...\n", asap_count_us);
-                            continue;
-                        } else {
-                            MSG_DEBUG("insert IMMEDIATE downlink (asap_count_us=%u)\n", asap_count_us);
-                            break;
-                        }
+                /* Search for the best slot then, the queue being ordered the gaps after the colliding packet are tried in turn */
+                for ( ; i < queue->num_pkt; i++) {
+                    asap_count_us = NODE(queue, i)->pkt.count_us + NODE(queue, i)->post_delay + packet_pre_delay + TX_JIT_DELAY + TX_MARGIN_DELAY;
+                    if (jit_find_collision(queue, asap_count_us, packet_pre_delay, packet_post_delay, ignore_beacon_guard) < 0) {
+                        MSG_DEBUG("insert IMMEDIATE downlink after index %d (asap_count_us=%u)\n", i, asap_count_us);
+                        break;
                     }
+                    MSG_DEBUG("failed to insert IMMEDIATE downlink after index %d (asap_count_us=%u), continue...\n", i, asap_count_us);
                 }
             }
         }
@@ -264,57 +301,53 @@ enum jit_error_e jit_enqueue(struct jit_queue_s *queue, struct timeval *time, st
      *  Note: - need to take into account packet's pre_delay and post_delay of each packet
      *        - Valid for both Downlinks and beacon packets
      *        - Beacon guard can be ignored if we try to queue a Class A downlink
+     *
+     *  Warning: unsigned arithmetic (handle roll-over)
+     *      t_packet_new - pre_delay_packet_new < t_packet_prev + post_delay_packet_prev (OVERLAP on post delay)
+     *      t_packet_new + post_delay_packet_new > t_packet_prev - pre_delay_packet_prev (OVERLAP on pre delay)
      */
-    for (i = 0; i < queue->num_pkt; i++) {
-        /* We ignore Beacon Guard for Class A/C downlinks */
-        if (((pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_A) || (pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_C)) && (queue->nodes[i].pkt_type == JIT_PKT_TYPE_BEACON)) {
-            target_pre_delay = TX_START_DELAY;
-        } else {
-            target_pre_delay = queue->nodes[i].pre_delay;
-        }
-
-        /* Check if there is a collision
-         *  Warning: unsigned arithmetic (handle roll-over)
-         *      t_packet_new - pre_delay_packet_new < t_packet_prev + post_delay_packet_prev (OVERLAP on post delay)
-         *      t_packet_new + post_delay_packet_new > t_packet_prev - pre_delay_packet_prev (OVERLAP on pre delay)
-         */
-        if (jit_collision_test(packet->count_us, packet_pre_delay, packet_post_delay, queue->nodes[i].pkt.count_us, target_pre_delay, queue->nodes[i].post_delay) == true) {
-            switch (queue->nodes[i].pkt_type) {
-                case JIT_PKT_TYPE_DOWNLINK_CLASS_A:
-                case JIT_PKT_TYPE_DOWNLINK_CLASS_B:
-                case JIT_PKT_TYPE_DOWNLINK_CLASS_C:
-                    MSG_ERROR("jitqueue: Packet (type=%d) REJECTED, collision with packet already programmed at %u (%u)\n", pkt_type, queue->nodes[i].pkt.count_us, packet->count_us);
-                    err_collision = JIT_ERROR_COLLISION_PACKET;
-                    break;
-                case JIT_PKT_TYPE_BEACON:
-                    if (pkt_type != JIT_PKT_TYPE_BEACON) {
-                        /* do not overload logs for beacon/beacon collision, as it is expected to happen with beacon pre-scheduling algorith used */
-                        MSG_ERROR("jitqueue: Packet (type=%d) REJECTED, collision with beacon already programmed at %u (%u)\n", pkt_type, queue->nodes[i].pkt.count_us, packet->count_us);
-                    }
-                    err_collision = JIT_ERROR_COLLISION_BEACON;
-                    break;
-                default:
-                    MSG_ERROR("jitqueue: Unknown packet type, should not occur, BUG?\n");
-                    assert(0);
-                    break;
-            }
-            pthread_mutex_unlock(&mx_jit_queue);
-            return err_collision;
+    i = jit_find_collision(queue, packet->count_us, packet_pre_delay, packet_post_delay, ignore_beacon_guard);
+    if (i >= 0) {
+        switch (NODE(queue, i)->pkt_type) {
+            case JIT_PKT_TYPE_DOWNLINK_CLASS_A:
+            case JIT_PKT_TYPE_DOWNLINK_CLASS_B:
+            case JIT_PKT_TYPE_DOWNLINK_CLASS_C:
+                MSG_ERROR("jitqueue: Packet (type=%d) REJECTED, collision with packet already programmed at %u (%u)\n", pkt_type, NODE(queue, i)->pkt.count_us, packet->count_us);
+                err_collision = JIT_ERROR_COLLISION_PACKET;
+                break;
+            case JIT_PKT_TYPE_BEACON:
+                if (pkt_type != JIT_PKT_TYPE_BEACON) {
+                    /* do not overload logs for beacon/beacon collision, as it is expected to happen with beacon pre-scheduling algorith used */
+                    MSG_ERROR("jitqueue: Packet (type=%d) REJECTED, collision with beacon already programmed at %u (%u)\n", pkt_type, NODE(queue, i)->pkt.count_us, packet->count_us);
+                }
+                err_collision = JIT_ERROR_COLLISION_BEACON;
+                break;
+            default:
+                MSG_ERROR("jitqueue: Unknown packet type, should not occur, BUG?\n");
+                assert(0);
+                break;
         }
+        pthread_mutex_unlock(&mx_jit_queue);
+        return err_collision;
     }
 
     /* Finally enqueue it */
-    /* Insert packet at the end of the queue */
-    memcpy(&(queue->nodes[queue->num_pkt].pkt), packet, sizeof(struct lgw_pkt_tx_s));
-    queue->nodes[queue->num_pkt].pre_delay = packet_pre_delay;
-    queue->nodes[queue->num_pkt].post_delay = packet_post_delay;
-    queue->nodes[queue->num_pkt].pkt_type = pkt_type;
+    /* Take the first free slot, and insert it in the order at its timestamp rank */
+    rank = jit_lower_bound(queue, packet->count_us);
+    slot = queue->order[queue->num_pkt];
+    memmove(&queue->order[rank + 1], &queue->order[rank], queue->num_pkt - rank);
+    queue->order[rank] = slot;
+    memcpy(&(queue->nodes[slot].pkt), packet, sizeof(struct lgw_pkt_tx_s));
+    queue->nodes[slot].pre_delay = packet_pre_delay;
+    queue->nodes[slot].post_delay = packet_post_delay;
+    queue->nodes[slot].pkt_type = pkt_type;
     if (pkt_type == JIT_PKT_TYPE_BEACON) {
         queue->num_beacon++;
     }
+    if (packet_post_delay > queue->max_post_delay) {
+        queue->max_post_delay = packet_post_delay;
+    }
     queue->num_pkt++;
-    /* Sort the queue in ascending order of packet timestamp */
-    jit_sort_queue(queue);
 
     /* Done */
     pthread_mutex_unlock(&mx_jit_queue);
@@ -344,21 +377,16 @@ enum jit_error_e jit_dequeue(struct jit_queue_s *queue, int index, struct lgw_pk
 
     pthread_mutex_lock(&mx_jit_queue);
 
-    /* Dequeue requested packet */
-    memcpy(packet, &(queue->nodes[index].pkt), sizeof(struct lgw_pkt_tx_s));
-    queue->num_pkt--;
-    *pkt_type = queue->nodes[index].pkt_type;
-    if (*pkt_type == JIT_PKT_TYPE_BEACON) {
-        queue->num_beacon--;
-        //MSG_DEBUG("jitqueue: --- Beacon dequeued ---\n");
+    if (index >= queue->num_pkt) {
+        pthread_mutex_unlock(&mx_jit_queue);
+        MSG_ERROR("jitqueue: invalid parameter\n");
+        return JIT_ERROR_INVALID;
     }
 
-    /* Replace dequeued packet with last packet of the queue */
-    memcpy(&(queue->nodes[index]), &(queue->nodes[queue->num_pkt]), sizeof(struct jit_node_s));
-    memset(&(queue->nodes[queue->num_pkt]), 0, sizeof(struct jit_node_s));
-
-    /* Sort queue in ascending order of packet timestamp */
-    jit_sort_queue(queue);
+    /* Dequeue requested packet */
+    memcpy(packet, &(NODE(queue, index)->pkt), sizeof(struct lgw_pkt_tx_s));
+    *pkt_type = NODE(queue, index)->pkt_type;
+    jit_remove(queue, index);
 
     /* Done */
     pthread_mutex_unlock(&mx_jit_queue);
@@ -372,9 +400,9 @@ enum jit_error_e jit_dequeue(struct jit_queue_s *queue, int index, struct lgw_pk
 
 enum jit_error_e jit_peek(struct jit_queue_s *queue, struct timeval *time, int *pkt_idx) {
     /* Return index of node containing a packet inline with given time */
-    int i = 0;
-    int idx_highest_priority = -1;
+    struct jit_node_s *node;
     uint32_t time_us;
+    int i;
 
     if ((time == NULL) || (pkt_idx == NULL)) {
         MSG_ERROR("jitqueue: invalid parameter\n");
@@ -389,54 +417,38 @@ enum jit_error_e jit_peek(struct jit_queue_s *queue, struct timeval *time, int *
 
     pthread_mutex_lock(&mx_jit_queue);
 
-    /* Search for highest priority packet to be sent */
-    for (i = 0; i < queue->num_pkt; i++) {
-        /* First check if that packet is outdated:
-         *  If a packet seems too much in advance, and was not rejected at enqueue time,
-         *  it means that we missed it for peeking, we need to drop it
-         *
-         *  Warning: unsigned arithmetic
-         *      t_packet > t_current + TX_MAX_ADVANCE_DELAY
-         */
-        if (queue->nodes[i].pkt.count_us >= time_us + TX_MAX_ADVANCE_DELAY) {
-            /* We drop the packet to avoid lock-up */
-            queue->num_pkt--;
-            if (queue->nodes[i].pkt_type == JIT_PKT_TYPE_BEACON) {
-                queue->num_beacon--;
-                MSG_WARN("jitqueue: --- Beacon dropped (current_time=%u, packet_time=%u) ---\n", time_us, queue->nodes[i].pkt.count_us);
-            } else {
-                MSG_WARN("jitqueue: --- Packet dropped (current_time=%u, packet_time=%u, p-c=%u(%f)) ---\n", time_us, queue->nodes[i].pkt.count_us, (queue->nodes[i].pkt.count_us-time_us),(queue->nodes[i].pkt.count_us-(double)time_us) );
-            }
-
-            /* Replace dropped packet with last packet of the queue */
-            memcpy(&(queue->nodes[i]), &(queue->nodes[queue->num_pkt]), sizeof(struct jit_node_s));
-            memset(&(queue->nodes[queue->num_pkt]), 0, sizeof(struct jit_node_s));
-
-            /* Sort queue in ascending order of packet timestamp */
-            jit_sort_queue(queue);
-
-            /* restart loop  after purge to find packet to be sent */
-            i = 0;
-            continue;
+    /* First drop the outdated packets:
+     *  If a packet seems too much in advance, and was not rejected at enqueue time,
+     *  it means that we missed it for peeking, we need to drop it.
+     *  The missed ones sort first, the ones really too much in advance last.
+     *
+     *  Warning: unsigned arithmetic
+     *      t_packet - t_current >= TX_MAX_ADVANCE_DELAY
+     */
+    while (queue->num_pkt > 0) {
+        i = ((NODE(queue, 0)->pkt.count_us - time_us) >= TX_MAX_ADVANCE_DELAY) ? 0 : queue->num_pkt - 1;
+        node = NODE(queue, i);
+        if ((node->pkt.count_us - time_us) < TX_MAX_ADVANCE_DELAY) {
+            break;
         }
-
-        /* Then look for highest priority packet to be sent:
-         *  Warning: unsigned arithmetic (handle roll-over)
-         *      t_packet < t_highest
-         */
-        if ((idx_highest_priority == -1) || (((queue->nodes[i].pkt.count_us - time_us) < (queue->nodes[idx_highest_priority].pkt.count_us - time_us)))) {
-            idx_highest_priority = i;
+        /* We drop the packet to avoid lock-up */
+        if (node->pkt_type == JIT_PKT_TYPE_BEACON) {
+            MSG_WARN("jitqueue: --- Beacon dropped (current_time=%u, packet_time=%u) ---\n", time_us, node->pkt.count_us);
+        } else {
+            MSG_WARN("jitqueue: --- Packet dropped (current_time=%u, packet_time=%u, p-c=%u(%f)) ---\n", time_us, node->pkt.count_us, (node->pkt.count_us-time_us),(node->pkt.count_us-(double)time_us) );
         }
+        jit_remove(queue, i);
     }
 
-    /* Peek criteria 1: look for a packet to be sent in next TX_JIT_DELAY ms timeframe
+    /* Peek criteria 1: look for a packet to be sent in next TX_JIT_DELAY ms timeframe,
+     *  the highest priority packet is the head of the queue
      *  Warning: unsigned arithmetic (handle roll-over)
      *      t_packet < t_current + TX_JIT_DELAY
      */
-    if ((queue->nodes[idx_highest_priority].pkt.count_us - time_us) < TX_JIT_DELAY) {
-        *pkt_idx = idx_highest_priority;
+    if ((queue->num_pkt > 0) && ((NODE(queue, 0)->pkt.count_us - time_us) < TX_JIT_DELAY)) {
+        *pkt_idx = 0;
         //MSG_DEBUG("jit: peek packet with count_us=%u at index %d\n",
-        //          queue->nodes[idx_highest_priority].pkt.count_us, idx_highest_priority);
+        //          NODE(queue, 0)->pkt.count_us, 0);
     } else {
         *pkt_idx = -1;
     }
@@ -457,12 +469,12 @@ void jit_print_queue(struct jit_queue_s *queue, bool show_all) {
 
         mp_printf(&mp_plat_print,"[jit] queue contains %d packets:\n", queue->num_pkt);
         mp_printf(&mp_plat_print,"[jit] queue contains %d beacons:\n", queue->num_beacon);
-        loop_end = (show_all == true) ? JIT_QUEUE_MAX : queue->num_pkt;
+        loop_end = (show_all == true) ? queue->capacity : queue->num_pkt;
         for (i = 0; i < loop_end; i++) {
             mp_printf(&mp_plat_print," - node[%d]: count_us=%u - type=%d\n",
                       i,
-                      queue->nodes[i].pkt.count_us,
-                      queue->nodes[i].pkt_type);
+                      NODE(queue, i)->pkt.count_us,
+                      NODE(queue, i)->pkt_type);
         }
 
         pthread_mutex_unlock(&mx_jit_queue);
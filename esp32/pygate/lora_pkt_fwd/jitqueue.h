@@ -37,7 +37,9 @@ Maintainer: Michael Coracin
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC CONSTANTS ----------------------------------------------------- */
 
-#define JIT_QUEUE_MAX           32  /* Maximum number of packets to be stored in JiT queue */
+#ifndef JIT_QUEUE_MAX
+#define JIT_QUEUE_MAX           32  /* Maximum number of packets to be stored in JiT queue, up to 255 */
+#endif
 #define JIT_NUM_BEACON_IN_QUEUE 3   /* Number of beacons to be loaded in JiT queue at any time */
 
 /* -------------------------------------------------------------------------- */
@@ -77,6 +79,9 @@ struct jit_node_s {
 struct jit_queue_s {
     uint8_t num_pkt;                /* Total number of packets in the queue (downlinks, beacons...) */
     uint8_t num_beacon;             /* Number of beacons in the queue */
+    uint8_t capacity;               /* Number of packets the queue accepts, up to JIT_QUEUE_MAX */
+    uint32_t max_post_delay;        /* Largest post_delay queued since the queue was last empty */
+    uint8_t order[JIT_QUEUE_MAX];   /* Node indexes, the first num_pkt in ascending order of timestamp, then the free ones */
     struct jit_node_s nodes[JIT_QUEUE_MAX]; /* Nodes/packets array in the queue */
 };
 
@@ -103,10 +108,11 @@ bool jit_queue_is_empty(struct jit_queue_s *queue);
 @brief Initialize a Just in Time queue.
 
 @param queue[in] Just in Time queue to be initialized. Memory should have been allocated already.
+@param capacity[in] Number of packets the queue accepts, 0 or more than JIT_QUEUE_MAX means JIT_QUEUE_MAX
 
 This function is used to reset every elements in the allocated queue.
 */
-void jit_queue_init(struct jit_queue_s *queue);
+void jit_queue_init(struct jit_queue_s *queue, int capacity);
 
 /**
 @brief Add a packet in a Just-in-Time queue
@@ -127,7 +133,7 @@ enum jit_error_e jit_enqueue(struct jit_queue_s *queue, struct timeval *time, st
 @brief Dequeue a packet from a Just-in-Time queue
 
 @param queue[in/out] Just in Time queue from which the packet should be removed
-@param index[in] in the queue where to get the packet to be removed
+@param index[in] rank in the queue (0 is the earliest packet) of the packet to be removed
 @param packet[out] that was at index
 @param pkt_type[out] Type of packet dequeued: Downlink, Beacon
 @return success if the function was able to dequeue the packet
@@ -146,8 +152,8 @@ enum jit_error_e jit_dequeue(struct jit_queue_s *queue, int index, struct lgw_pk
 @return success if the function was able to parse the queue. pkt_idx is set to -1 if no packet found.
 
 This function is typically used to check in JiT queue if there is a packet soon to be sent.
-It search the packet with the highest priority in queue, and check if its timestamp is near
-enough the current concentrator time.
+The queue is kept in ascending order of timestamp, so only its head is checked against
+the current concentrator time, after dropping the packets that can no longer be sent.
 */
 enum jit_error_e jit_peek(struct jit_queue_s *queue, struct timeval *time, int *pkt_idx);
 
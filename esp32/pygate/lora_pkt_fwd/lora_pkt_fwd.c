@@ -57,6 +57,8 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include "timersync.h"
 #include "parson.h"
 #include "base64.h"
+#include "pkt_json.h"
+#include "pkt_tap.h"
 #include "loragw_hal.h"
 #include "loragw_reg.h"
 #include "loragw_aux.h"
@@ -74,6 +76,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #include "machpin.h"
 #include "pins.h"
 #include "sx1308-config.h"
+#include "pycom_config.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
@@ -96,7 +99,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define DEFAULT_STAT        30          /* default time interval for statistics */
 #define PUSH_TIMEOUT_MS     100
 #define PULL_TIMEOUT_MS     200
-#define FETCH_SLEEP_MS      50          /* nb of ms waited when a fetch return no packets */
+#define FETCH_SLEEP_MS      10          /* nb of ms waited when a fetch return no packets */
 
 #define PROTOCOL_VERSION    2           /* v1.3 */
 
@@ -107,7 +110,8 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define PKT_PULL_ACK    4
 #define PKT_TX_ACK      5
 
-#define NB_PKT_MAX      2 /* max number of packets per fetch/send cycle */
+#define NB_PKT_DEFAULT  8 /* default number of packets per fetch/send cycle */
+#define NB_PKT_MAX      LGW_PKT_FIFO_SIZE /* max number of packets per fetch/send cycle, the whole concentrator FIFO */
 
 #define MIN_LORA_PREAMB 6 /* minimum Lora preamble length for this application */
 #define STD_LORA_PREAMB 8
@@ -115,7 +119,7 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 #define STD_FSK_PREAMB  5
 
 #define STATUS_SIZE     200
-#define TX_BUFF_SIZE    ((540 * NB_PKT_MAX) + 30 + STATUS_SIZE)
+#define TX_BUFF_SIZE(nb_pkt)    ((540 * (nb_pkt)) + 30 + STATUS_SIZE)
 
 #define NI_NUMERICHOST	1	/* return the host address, not the name */
 
@@ -154,6 +158,7 @@ volatile DRAM_ATTR bool quit_sig = false; /* 1 -> application terminates without
 static bool fwd_valid_pkt = true; /* packets with PAYLOAD CRC OK are forwarded */
 static bool fwd_error_pkt = false; /* packets with PAYLOAD CRC ERROR are NOT forwarded */
 static bool fwd_nocrc_pkt = false; /* packets with NO PAYLOAD CRC are NOT forwarded */
+static bool fwd_rx_time = false; /* UTC reception time, from the synchronized unix clock, is NOT forwarded */
 
 /* network configuration variables */
 static uint64_t lgwm = 0; /* Lora gateway MAC address */
@@ -164,6 +169,8 @@ static int keepalive_time = DEFAULT_KEEPALIVE; /* send a PULL_DATA request every
 
 /* statistics collection configuration variables */
 static unsigned stat_interval = DEFAULT_STAT; /* time interval (in sec) at which statistics are collected and displayed */
+static unsigned fetch_nb_pkt = NB_PKT_DEFAULT; /* max number of packets fetched from the concentrator at once */
+static int jit_queue_size = JIT_QUEUE_MAX; /* max number of downlinks and beacons waiting in the JiT queue */
 
 /* gateway <-> MAC protocol variables */
 static uint32_t net_mac_h; /* Most Significant Nibble, network order */
@@ -192,6 +199,7 @@ static uint32_t meas_nb_rx_rcv = 0; /* count packets received */
 static uint32_t meas_nb_rx_ok = 0; /* count packets received with PAYLOAD CRC OK */
 static uint32_t meas_nb_rx_bad = 0; /* count packets received with PAYLOAD CRC ERROR */
 static uint32_t meas_nb_rx_nocrc = 0; /* count packets received with NO PAYLOAD CRC */
+static uint32_t meas_nb_rx_drop = 0; /* count packets fetched but dropped (unknown status, no room in the datagram) */
 static uint32_t meas_up_pkt_fwd = 0; /* number of radio packet forwarded to the server */
 static uint32_t meas_up_network_byte = 0; /* sum of UDP bytes sent for upstream traffic */
 static uint32_t meas_up_payload_byte = 0; /* sum of radio payload bytes sent for upstream traffic */
@@ -245,6 +253,8 @@ static int parse_gateway_configuration(const char * conf_file);
 
 static double time_diff(struct timeval x , struct timeval y);
 
+static bool parse_lora_datr(const struct pkt_json_field_s *field, short *sf, short *bw);
+
 static void obtain_time(void);
 
 static void loragw_exit(int status);
@@ -704,6 +714,30 @@ static int parse_gateway_configuration(const char * conf_file) {
         MSG_INFO("[main] upstream PUSH_DATA time-out is configured to %u ms\n", (unsigned)(push_timeout_half.tv_usec / 500));
     }
 
+    /* get max number of packets fetched and forwarded at once (optional) */
+    val = json_object_get_value(conf_obj, "fetch_batch");
+    if (val != NULL) {
+        fetch_nb_pkt = (unsigned)json_value_get_number(val);
+        if (fetch_nb_pkt < 1) {
+            fetch_nb_pkt = 1;
+        } else if (fetch_nb_pkt > NB_PKT_MAX) {
+            fetch_nb_pkt = NB_PKT_MAX;
+        }
+        MSG_INFO("[main] up to %u packets are fetched at once\n", fetch_nb_pkt);
+    }
+
+    /* get JiT queue capacity (optional) */
+    val = json_object_get_value(conf_obj, "jit_queue_size");
+    if (val != NULL) {
+        jit_queue_size = (int)json_value_get_number(val);
+        if (jit_queue_size < 1) {
+            jit_queue_size = 1;
+        } else if (jit_queue_size > JIT_QUEUE_MAX) {
+            jit_queue_size = JIT_QUEUE_MAX;
+        }
+        MSG_INFO("[main] JiT queue holds up to %d packets\n", jit_queue_size);
+    }
+
     /* packet filtering parameters */
     val = json_object_get_value(conf_obj, "forward_crc_valid");
     if (json_value_get_type(val) == JSONBoolean) {
@@ -720,6 +754,11 @@ static int parse_gateway_configuration(const char * conf_file) {
         fwd_nocrc_pkt = (bool)json_value_get_boolean(val);
     }
     MSG_INFO("[main] packets received with no CRC will%s be forwarded\n", (fwd_nocrc_pkt ? "" : " NOT"));
+    val = json_object_get_value(conf_obj, "forward_rx_time");
+    if (json_value_get_type(val) == JSONBoolean) {
+        fwd_rx_time = (bool)json_value_get_boolean(val);
+    }
+    MSG_INFO("[main] reception time will%s be forwarded\n", (fwd_rx_time ? "" : " NOT"));
 
     /* get reference coordinates */
     val = json_object_get_value(conf_obj, "ref_latitude");
@@ -782,6 +821,30 @@ static double time_diff(struct timeval x , struct timeval y)
     return x;
 }*/
 
+/* parses a LoRa "datr" string such as "SF9BW125" */
+static bool parse_lora_datr(const struct pkt_json_field_s *field, short *sf, short *bw)
+{
+    const char *p = field->val;
+    const char *end = field->val + field->val_len;
+    short *dst[2] = {sf, bw};
+    const char *tag[2] = {"SF", "BW"};
+
+    for (int k = 0; k < 2; ++k) {
+        if (end - p < 3 || p[0] != tag[k][0] || p[1] != tag[k][1]) {
+            return false;
+        }
+        p += 2;
+        *dst[k] = 0;
+        for (int n = 0; p < end && *p >= '0' && *p <= '9'; ++p, ++n) {
+            if (n == 3) {
+                return false;
+            }
+            *dst[k] = *dst[k] * 10 + (*p - '0');
+        }
+    }
+    return p == end;
+}
+
 static void obtain_time(void)
 {
     // wait for time to be set
@@ -902,7 +965,7 @@ void lora_gw_init(const char* global_conf) {
     xTaskCreatePinnedToCore(TASK_lora_gw, "LoraGW",
         LORA_GW_STACK_SIZE / sizeof(StackType_t),
         (void *) global_conf,
-        LORA_GW_PRIORITY, &xLoraGwTaskHndl, 1);
+        LORA_GW_PRIORITY, &xLoraGwTaskHndl, config_get_service_core());
     MSG_INFO("lora_gw_init() done fh=%u high=%u\n", xPortGetFreeHeapSize(), uxTaskGetStackHighWaterMark(NULL));
 }
 
@@ -993,6 +1056,7 @@ void TASK_lora_gw(void *pvParameters) {
     uint32_t cp_nb_rx_ok;
     uint32_t cp_nb_rx_bad;
     uint32_t cp_nb_rx_nocrc;
+    uint32_t cp_nb_rx_drop;
     uint32_t cp_up_pkt_fwd;
     uint32_t cp_up_network_byte;
     uint32_t cp_up_payload_byte;
@@ -1289,6 +1353,7 @@ void TASK_lora_gw(void *pvParameters) {
         cp_nb_rx_ok        = meas_nb_rx_ok;
         cp_nb_rx_bad       = meas_nb_rx_bad;
         cp_nb_rx_nocrc     = meas_nb_rx_nocrc;
+        cp_nb_rx_drop      = meas_nb_rx_drop;
         cp_up_pkt_fwd      = meas_up_pkt_fwd;
         cp_up_network_byte = meas_up_network_byte;
         cp_up_payload_byte = meas_up_payload_byte;
@@ -1298,6 +1363,7 @@ void TASK_lora_gw(void *pvParameters) {
         meas_nb_rx_ok = 0;
         meas_nb_rx_bad = 0;
         meas_nb_rx_nocrc = 0;
+        meas_nb_rx_drop = 0;
         meas_up_pkt_fwd = 0;
         meas_up_network_byte = 0;
         meas_up_payload_byte = 0;
@@ -1365,6 +1431,7 @@ void TASK_lora_gw(void *pvParameters) {
         mp_printf(&mp_plat_print, "# RF packets received by concentrator: %u\n", cp_nb_rx_rcv);
         mp_printf(&mp_plat_print, "# CRC_OK: %.2f%%, CRC_FAIL: %.2f%%, NO_CRC: %.2f%%\n", 100.0 * rx_ok_ratio, 100.0 * rx_bad_ratio, 100.0 * rx_nocrc_ratio);
         mp_printf(&mp_plat_print, "# RF packets forwarded: %u (%u bytes)\n", cp_up_pkt_fwd, cp_up_payload_byte);
+        mp_printf(&mp_plat_print, "# RF packets dropped: %u\n", cp_nb_rx_drop);
         mp_printf(&mp_plat_print, "# PUSH_DATA datagrams sent: %u (%u bytes)\n", cp_up_dgram_sent, cp_up_network_byte);
         mp_printf(&mp_plat_print, "# PUSH_DATA acknowledged: %.2f%%\n", 100.0 * up_ack_ratio);
         mp_printf(&mp_plat_print, "### [DOWNSTREAM] ###\n");
@@ -1392,7 +1459,7 @@ void TASK_lora_gw(void *pvParameters) {
 
         /* generate a JSON report (will be sent to server by upstream thread) */
         pthread_mutex_lock(&mx_stat_rep);
-        snprintf(status_report, STATUS_SIZE, "\"stat\":{\"time\":\"%s\",\"rxnb\":%u,\"rxok\":%u,\"rxfw\":%u,\"ackr\":%.1f,\"dwnb\":%u,\"txnb\":%u}", stat_timestamp, cp_nb_rx_rcv, cp_nb_rx_ok, cp_up_pkt_fwd, 100.0 * up_ack_ratio, cp_dw_dgram_rcv, cp_nb_tx_ok);
+        snprintf(status_report, STATUS_SIZE, "\"stat\":{\"time\":\"%s\",\"rxnb\":%u,\"rxok\":%u,\"rxfw\":%u,\"rxdr\":%u,\"ackr\":%.1f,\"dwnb\":%u,\"txnb\":%u}", stat_timestamp, cp_nb_rx_rcv, cp_nb_rx_ok, cp_up_pkt_fwd, cp_nb_rx_drop, 100.0 * up_ack_ratio, cp_dw_dgram_rcv, cp_nb_tx_ok);
         report_ready = true;
         pthread_mutex_unlock(&mx_stat_rep);
     }
@@ -1430,13 +1497,14 @@ void thread_up(void) {
     int i, j; /* loop variables */
     unsigned pkt_in_dgram; /* nb on Lora packet in the current datagram */
 
-    /* allocate memory for packet fetching and processing */
-    struct lgw_pkt_rx_s rxpkt[NB_PKT_MAX]; /* array containing inbound packets + metadata */
+    /* allocate memory for packet fetching and processing, sized by the configured batch */
+    struct lgw_pkt_rx_s *rxpkt; /* array containing inbound packets + metadata */
     struct lgw_pkt_rx_s *p; /* pointer on a RX packet */
     int nb_pkt;
 
     /* data buffers */
-    uint8_t buff_up[TX_BUFF_SIZE]; /* buffer to compose the upstream packet */
+    uint8_t *buff_up; /* buffer to compose the upstream packet, kept off the thread stack */
+    const int buff_up_size = TX_BUFF_SIZE(fetch_nb_pkt);
     int buff_index;
     uint8_t buff_ack[32]; /* buffer to receive acknowledges */
 
@@ -1448,6 +1516,10 @@ void thread_up(void) {
     struct timeval send_time;
     struct timeval recv_time;
 
+    /* reception time variables */
+    struct timeval pkt_utc_time;
+    struct tm pkt_utc_tm;
+
     /* report management variable */
     bool send_report = false;
 
@@ -1463,6 +1535,17 @@ void thread_up(void) {
         machine_pygate_set_status(PYGATE_ERROR);
     }
 
+    rxpkt = malloc(fetch_nb_pkt * sizeof(struct lgw_pkt_rx_s));
+    buff_up = malloc(buff_up_size);
+    if (rxpkt == NULL || buff_up == NULL) {
+        MSG_ERROR("[up  ] failed to allocate the fetch buffers\n");
+        free(rxpkt);
+        free(buff_up);
+        quit_sig = true;
+        machine_pygate_set_status(PYGATE_ERROR);
+        return;
+    }
+
     /* pre-fill the data buffer with fixed fields */
     buff_up[0] = PROTOCOL_VERSION;
     buff_up[3] = PKT_PUSH_DATA;
@@ -1472,18 +1555,23 @@ void thread_up(void) {
     while (!exit_sig && !quit_sig) {
         /* fetch packets */
         pthread_mutex_lock(&mx_concent);
-        nb_pkt = lgw_receive(NB_PKT_MAX, rxpkt);  // Crashing here
+        nb_pkt = lgw_receive(fetch_nb_pkt, rxpkt);  // Crashing here
         pthread_mutex_unlock(&mx_concent);
         if (nb_pkt == LGW_HAL_ERROR) {
             MSG_ERROR("[up  ] failed packet fetch, exiting\n");
             //exit(EXIT_FAILURE);
+            nb_pkt = 0;
         }
 
+        /* hand the raw packets to the application too, if it asked for them */
+        pkt_tap_push(rxpkt, nb_pkt);
+
         /* check if there are status report to send */
         send_report = report_ready; /* copy the variable so it doesn't change mid-function */
         /* no mutex, we're only reading */
 
-        /* wait a short time if no packets, nor status report */
+        /* wait a short time if no packets, nor status report. A full batch means the FIFO may
+           hold more, so the next fetch follows right after this datagram is sent */
         if ((nb_pkt == 0) && (send_report == false)) {
             wait_ms ((FETCH_SLEEP_MS));
             continue;
@@ -1546,10 +1634,17 @@ void thread_up(void) {
                     break;
                 default:
                     MSG_WARN("[up  ] received packet with unknown status %u (size %u, modulation %u, BW %u, DR %u, RSSI %.1f)\n", p->status, p->size, p->modulation, p->bandwidth, p->datarate, p->rssi);
+                    meas_nb_rx_drop += 1;
                     pthread_mutex_unlock(&mx_meas_up);
                     continue; /* skip that packet */
                     // exit(EXIT_FAILURE);
             }
+            /* worst case packet serialization, plus the closing of the datagram and the status report */
+            if (buff_index + 540 + 2 + STATUS_SIZE > buff_up_size) {
+                meas_nb_rx_drop += 1;
+                pthread_mutex_unlock(&mx_meas_up);
+                continue; /* skip that packet */
+            }
             meas_up_pkt_fwd += 1;
             meas_up_payload_byte += p->size;
             pthread_mutex_unlock(&mx_meas_up);
@@ -1565,23 +1660,30 @@ void thread_up(void) {
             }
 
             /* RAW timestamp, 8-17 useful chars */
-            j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE - buff_index, "\"tmst\":%u", p->count_us);
-            if (j > 0) {
-                buff_index += j;
-            } else {
-                MSG_ERROR("[up  ] snprintf failed line %u\n", (__LINE__ - 4));
-                quit_sig = true;
+            memcpy((void *)(buff_up + buff_index), (void *)"\"tmst\":", 7);
+            buff_index += 7;
+            buff_index += pkt_json_put_uint((char *)(buff_up + buff_index), p->count_us);
+
+            /* Packet RX time (unix clock, SNTP synchronized), 37 useful chars */
+            if (fwd_rx_time && (get_unix_time(&pkt_utc_time, p->count_us) == 0)) {
+                gmtime_r(&pkt_utc_time.tv_sec, &pkt_utc_tm);
+                j = strftime((char *)(buff_up + buff_index), buff_up_size - buff_index, ",\"time\":\"%Y-%m-%dT%H:%M:%S", &pkt_utc_tm);
+                if (j > 0) {
+                    buff_index += j;
+                    buff_index += snprintf((char *)(buff_up + buff_index), buff_up_size - buff_index, ".%06liZ\"", (long)pkt_utc_time.tv_usec);
+                }
             }
 
             /* Packet concentrator channel, RF chain & RX frequency, 34-36 useful chars */
-            j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE - buff_index, ",\"chan\":%1u,\"rfch\":%1u,\"freq\":%.6lf", p->if_chain, p->rf_chain, ((double)p->freq_hz / 1e6));
-            if (j > 0) {
-                buff_index += j;
-            } else {
-                MSG_ERROR("[up  ] snprintf failed line %u\n", (__LINE__ - 4));
-                quit_sig = true;
-                machine_pygate_set_status(PYGATE_ERROR);
-            }
+            memcpy((void *)(buff_up + buff_index), (void *)",\"chan\":", 8);
+            buff_index += 8;
+            buff_index += pkt_json_put_uint((char *)(buff_up + buff_index), p->if_chain);
+            memcpy((void *)(buff_up + buff_index), (void *)",\"rfch\":", 8);
+            buff_index += 8;
+            buff_index += pkt_json_put_uint((char *)(buff_up + buff_index), p->rf_chain);
+            memcpy((void *)(buff_up + buff_index), (void *)",\"freq\":", 8);
+            buff_index += 8;
+            buff_index += pkt_json_put_fixed((char *)(buff_up + buff_index), p->freq_hz, 6); /* in MHz, Hz resolution */
 
             /* Packet status, 9-10 useful chars */
             switch (p->status) {
@@ -1695,27 +1797,17 @@ void thread_up(void) {
                 }
 
                 /* Lora SNR, 11-13 useful chars */
-                j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE - buff_index, ",\"lsnr\":%.1f", p->snr);
-                if (j > 0) {
-                    buff_index += j;
-                } else {
-                    MSG_ERROR("[up  ] snprintf failed line %u\n", (__LINE__ - 4));
-                    quit_sig = true;
-                    machine_pygate_set_status(PYGATE_ERROR);
-                }
+                memcpy((void *)(buff_up + buff_index), (void *)",\"lsnr\":", 8);
+                buff_index += 8;
+                buff_index += pkt_json_put_fixed((char *)(buff_up + buff_index), lroundf(p->snr * 10), 1);
             } else if (p->modulation == MOD_FSK) {
                 memcpy((void *)(buff_up + buff_index), (void *)",\"modu\":\"FSK\"", 13);
                 buff_index += 13;
 
                 /* FSK datarate, 11-14 useful chars */
-                j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE - buff_index, ",\"datr\":%u", p->datarate);
-                if (j > 0) {
-                    buff_index += j;
-                } else {
-                    MSG_ERROR("[up  ] snprintf failed line %u\n", (__LINE__ - 4));
-                    quit_sig = true;
-                    machine_pygate_set_status(PYGATE_ERROR);
-                }
+                memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":", 8);
+                buff_index += 8;
+                buff_index += pkt_json_put_uint((char *)(buff_up + buff_index), p->datarate);
             } else {
                 MSG_ERROR("[up  ] received packet with unknown modulation\n");
                 quit_sig = true;
@@ -1723,14 +1815,12 @@ void thread_up(void) {
             }
 
             /* Packet RSSI, payload size, 18-23 useful chars */
-            j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE - buff_index, ",\"rssi\":%.0f,\"size\":%u", p->rssi, p->size);
-            if (j > 0) {
-                buff_index += j;
-            } else {
-                MSG_ERROR("[up  ] snprintf failed line %u\n", (__LINE__ - 4));
-                quit_sig = true;
-                machine_pygate_set_status(PYGATE_ERROR);
-            }
+            memcpy((void *)(buff_up + buff_index), (void *)",\"rssi\":", 8);
+            buff_index += 8;
+            buff_index += pkt_json_put_int((char *)(buff_up + buff_index), lroundf(p->rssi));
+            memcpy((void *)(buff_up + buff_index), (void *)",\"size\":", 8);
+            buff_index += 8;
+            buff_index += pkt_json_put_uint((char *)(buff_up + buff_index), p->size);
 
             /* Packet base64-encoded payload, 14-350 useful chars */
             memcpy((void *)(buff_up + buff_index), (void *)",\"data\":\"", 9);
@@ -1776,15 +1866,10 @@ void thread_up(void) {
         if (send_report == true) {
             pthread_mutex_lock(&mx_stat_rep);
             report_ready = false;
-            j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE - buff_index, "%s", status_report);
+            j = strlen(status_report);
+            memcpy((void *)(buff_up + buff_index), (void *)status_report, j);
             pthread_mutex_unlock(&mx_stat_rep);
-            if (j > 0) {
-                buff_index += j;
-            } else {
-                MSG_ERROR("[up  ] snprintf failed line %u\n", (__LINE__ - 5));
-                quit_sig = true;
-                machine_pygate_set_status(PYGATE_ERROR);
-            }
+            buff_index += j;
         }
 
         /* end of JSON datagram payload */
@@ -1830,6 +1915,8 @@ void thread_up(void) {
         pthread_mutex_unlock(&mx_meas_up);
         wait_ms (5);
     }
+    free(rxpkt);
+    free(buff_up);
     MSG_INFO("[up  ] End of upstream thread\n\n");
 }
 
@@ -1858,11 +1945,11 @@ void thread_down(void) {
     uint8_t token_l; /* random token for acknowledgement matching */
     bool req_ack = false; /* keep track of whether PULL_DATA was acknowledged or not */
 
-    /* JSON parsing variables */
-    JSON_Value *root_val = NULL;
-    JSON_Object *txpk_obj = NULL;
-    JSON_Value *val = NULL; /* needed to detect the absence of some fields */
-    const char *str; /* pointer to sub-strings in the JSON data */
+    /* JSON parsing variables, the fields point into buff_down */
+    struct pkt_json_field_s fields[PKT_JSON_FIELDS_MAX];
+    const struct pkt_json_field_s *field; /* needed to detect the absence of some fields */
+    int nb_fields;
+    int64_t num;
     short x0, x1;
 
     /* auto-quit variable */
@@ -1889,7 +1976,7 @@ void thread_down(void) {
     *(uint32_t *)(buff_req + 8) = net_mac_l;
 
     /* JIT queue initialization */
-    jit_queue_init(&jit_queue);
+    jit_queue_init(&jit_queue, jit_queue_size);
 
     while (!exit_sig && !quit_sig) {
 
@@ -1963,24 +2050,16 @@ void thread_down(void) {
             MSG_DEBUG("[down] received PULL_RESP [%d:%d] :)\n", buff_down[1], buff_down[2]); /* very verbose */
             MSG_DEBUG("[down] PULL_RESP json: %s\n", (char *)(buff_down + 4)); /* DEBUG: display JSON payload */
 
-            /* initialize TX struct and try to parse JSON */
+            /* initialize TX struct and try to tokenize the JSON, in place */
             memset(&txpkt, 0, sizeof txpkt);
-            root_val = json_parse_string_with_comments((const char *)(buff_down + 4)); /* JSON offset */
-            if (root_val == NULL) {
-                MSG_WARN("[down] invalid JSON, TX aborted\n");
-                continue;
-            }
-
-            /* look for JSON sub-object 'txpk' */
-            txpk_obj = json_object_get_object(json_value_get_object(root_val), "txpk");
-            if (txpk_obj == NULL) {
-                MSG_WARN("[down] no \"txpk\" object in JSON, TX aborted\n");
-                json_value_free(root_val);
+            nb_fields = pkt_json_tokenize((const char *)(buff_down + 4), msg_len - 4, "txpk", fields, PKT_JSON_FIELDS_MAX); /* JSON offset */
+            if (nb_fields < 0) {
+                MSG_WARN("[down] invalid JSON or no \"txpk\" object in JSON, TX aborted\n");
                 continue;
             }
 
             /* Parse "immediate" tag, or target timestamp */
-            i = json_object_get_boolean(txpk_obj, "imme"); /* can be 1 if true, 0 if false, or -1 if not a JSON boolean */
+            i = pkt_json_get_bool(pkt_json_find(fields, nb_fields, "imme")); /* can be 1 if true, 0 if false, or -1 if not a JSON boolean */
             if (i == 1) {
                 /* TX procedure: send immediately */
                 sent_immediate = true;
@@ -1988,80 +2067,67 @@ void thread_down(void) {
                 MSG_INFO("[down] a packet will be sent in \"immediate\" mode\n");
             } else {
                 sent_immediate = false;
-                val = json_object_get_value(txpk_obj, "tmst");
-                if (val != NULL) {
+                if (pkt_json_get_fixed(pkt_json_find(fields, nb_fields, "tmst"), 0, &num)) {
                     /* TX procedure: send on timestamp value */
-                    txpkt.count_us = (uint32_t)json_value_get_number(val);
+                    txpkt.count_us = (uint32_t)num;
 
                     /* Concentrator timestamp is given, we consider it is a Class A downlink */
                     downlink_type = JIT_PKT_TYPE_DOWNLINK_CLASS_A;
                 } else {
                     /* TX procedure: send on UTC time (converted to timestamp value) */
-                    str = json_object_get_string(txpk_obj, "time");
-                    if (str == NULL) {
+                    if (pkt_json_find(fields, nb_fields, "time") == NULL) {
                         MSG_WARN("[down] no mandatory \"txpk.tmst\" or \"txpk.time\" objects in JSON, TX aborted\n");
-                        json_value_free(root_val);
                         continue;
                     }
                     MSG_WARN("[down] GPS disabled, impossible to send packet on specific UTC time, TX aborted\n");
-                    json_value_free(root_val);
                     continue;
                 }
             }
 
             /* Parse "No CRC" flag (optional field) */
-            val = json_object_get_value(txpk_obj, "ncrc");
-            if (val != NULL) {
-                txpkt.no_crc = (bool)json_value_get_boolean(val);
+            field = pkt_json_find(fields, nb_fields, "ncrc");
+            if (field != NULL) {
+                txpkt.no_crc = (pkt_json_get_bool(field) != 0);
             }
 
-            /* parse target frequency (mandatory) */
-            val = json_object_get_value(txpk_obj, "freq");
-            if (val == NULL) {
+            /* parse target frequency (mandatory), given in MHz */
+            if (!pkt_json_get_fixed(pkt_json_find(fields, nb_fields, "freq"), 6, &num)) {
                 MSG_WARN("[down] no mandatory \"txpk.freq\" object in JSON, TX aborted\n");
-                json_value_free(root_val);
                 continue;
             }
-            txpkt.freq_hz = (uint32_t)((double)(1.0e6) * json_value_get_number(val));
+            txpkt.freq_hz = (uint32_t)num;
 
             /* parse RF chain used for TX (mandatory) */
-            val = json_object_get_value(txpk_obj, "rfch");
-            if (val == NULL) {
+            if (!pkt_json_get_fixed(pkt_json_find(fields, nb_fields, "rfch"), 0, &num)) {
                 MSG_WARN("[down] no mandatory \"txpk.rfch\" object in JSON, TX aborted\n");
-                json_value_free(root_val);
                 continue;
             }
-            txpkt.rf_chain = (uint8_t)json_value_get_number(val);
+            txpkt.rf_chain = (uint8_t)num;
 
             /* parse TX power (optional field) */
-            val = json_object_get_value(txpk_obj, "powe");
-            if (val != NULL) {
-                txpkt.rf_power = (int8_t)json_value_get_number(val) - antenna_gain;
+            if (pkt_json_get_fixed(pkt_json_find(fields, nb_fields, "powe"), 0, &num)) {
+                txpkt.rf_power = (int8_t)num - antenna_gain;
             }
 
             /* Parse modulation (mandatory) */
-            str = json_object_get_string(txpk_obj, "modu");
-            if (str == NULL) {
+            field = pkt_json_find(fields, nb_fields, "modu");
+            if (field == NULL || field->type != PKT_JSON_STRING) {
                 MSG_WARN("[down] no mandatory \"txpk.modu\" object in JSON, TX aborted\n");
-                json_value_free(root_val);
                 continue;
             }
 
-            if (strcmp(str, "LORA") == 0) {
+            if (pkt_json_str_equals(field, "LORA")) {
                 /* Lora modulation */
                 txpkt.modulation = MOD_LORA;
 
                 /* Parse Lora spreading-factor and modulation bandwidth (mandatory) */
-                str = json_object_get_string(txpk_obj, "datr");
-                if (str == NULL) {
+                field = pkt_json_find(fields, nb_fields, "datr");
+                if (field == NULL || field->type != PKT_JSON_STRING) {
                     MSG_WARN("[down] no mandatory \"txpk.datr\" object in JSON, TX aborted\n");
-                    json_value_free(root_val);
                     continue;
                 }
-                i = sscanf(str, "SF%2hdBW%3hd", &x0, &x1);
-                if (i != 2) {
+                if (!parse_lora_datr(field, &x0, &x1)) {
                     MSG_WARN("[down] format error in \"txpk.datr\", TX aborted\n");
-                    json_value_free(root_val);
                     continue;
                 }
                 switch (x0) {
@@ -2085,7 +2151,6 @@ void thread_down(void) {
                         break;
                     default:
                         MSG_WARN("[down] format error in \"txpk.datr\", invalid SF, TX aborted\n");
-                        json_value_free(root_val);
                         continue;
                 }
                 switch (x1) {
@@ -2100,45 +2165,41 @@ void thread_down(void) {
                         break;
                     default:
                         MSG_WARN("[down] format error in \"txpk.datr\", invalid BW, TX aborted\n");
-                        json_value_free(root_val);
                         continue;
                 }
               
                 /* Parse ECC coding rate (optional field) */
-                str = json_object_get_string(txpk_obj, "codr");
-                if (str == NULL) {
+                field = pkt_json_find(fields, nb_fields, "codr");
+                if (field == NULL) {
                     MSG_WARN("[down] no mandatory \"txpk.codr\" object in json, TX aborted\n");
-                    json_value_free(root_val);
                     continue;
                 }
-                if      (strcmp(str, "4/5") == 0) {
+                if      (pkt_json_str_equals(field, "4/5")) {
                     txpkt.coderate = CR_LORA_4_5;
-                } else if (strcmp(str, "4/6") == 0) {
+                } else if (pkt_json_str_equals(field, "4/6")) {
                     txpkt.coderate = CR_LORA_4_6;
-                } else if (strcmp(str, "2/3") == 0) {
+                } else if (pkt_json_str_equals(field, "2/3")) {
                     txpkt.coderate = CR_LORA_4_6;
-                } else if (strcmp(str, "4/7") == 0) {
+                } else if (pkt_json_str_equals(field, "4/7")) {
                     txpkt.coderate = CR_LORA_4_7;
-                } else if (strcmp(str, "4/8") == 0) {
+                } else if (pkt_json_str_equals(field, "4/8")) {
                     txpkt.coderate = CR_LORA_4_8;
-                } else if (strcmp(str, "1/2") == 0) {
+                } else if (pkt_json_str_equals(field, "1/2")) {
                     txpkt.coderate = CR_LORA_4_8;
                 } else {
                     MSG_WARN("[down] format error in \"txpk.codr\", TX aborted\n");
-                    json_value_free(root_val);
                     continue;
                 }
 
                 /* Parse signal polarity switch (optional field) */
-                val = json_object_get_value(txpk_obj, "ipol");
-                if (val != NULL) {
-                    txpkt.invert_pol = (bool)json_value_get_boolean(val);
+                field = pkt_json_find(fields, nb_fields, "ipol");
+                if (field != NULL) {
+                    txpkt.invert_pol = (pkt_json_get_bool(field) != 0);
                 }
 
                 /* parse Lora preamble length (optional field, optimum min value enforced) */
-                val = json_object_get_value(txpk_obj, "prea");
-                if (val != NULL) {
-                    i = (int)json_value_get_number(val);
+                if (pkt_json_get_fixed(pkt_json_find(fields, nb_fields, "prea"), 0, &num)) {
+                    i = (int)num;
                     if (i >= MIN_LORA_PREAMB) {
                         txpkt.preamble = (uint16_t)i;
                     } else {
@@ -2148,33 +2209,28 @@ void thread_down(void) {
                     txpkt.preamble = (uint16_t)STD_LORA_PREAMB;
                 }
 
-            } else if (strcmp(str, "FSK") == 0) {
+            } else if (pkt_json_str_equals(field, "FSK")) {
 
                 /* FSK modulation */
                 txpkt.modulation = MOD_FSK;
 
                 /* parse FSK bitrate (mandatory) */
-                val = json_object_get_value(txpk_obj, "datr");
-                if (val == NULL) {
+                if (!pkt_json_get_fixed(pkt_json_find(fields, nb_fields, "datr"), 0, &num)) {
                     MSG_WARN("[down] no mandatory \"txpk.datr\" object in JSON, TX aborted\n");
-                    json_value_free(root_val);
                     continue;
                 }
-                txpkt.datarate = (uint32_t)(json_value_get_number(val));
+                txpkt.datarate = (uint32_t)num;
 
                 /* parse frequency deviation (mandatory) */
-                val = json_object_get_value(txpk_obj, "fdev");
-                if (val == NULL) {
+                if (!pkt_json_get_fixed(pkt_json_find(fields, nb_fields, "fdev"), 0, &num)) {
                     MSG_WARN("[down] no mandatory \"txpk.fdev\" object in JSON, TX aborted\n");
-                    json_value_free(root_val);
                     continue;
                 }
-                txpkt.f_dev = (uint8_t)(json_value_get_number(val) / 1000.0); /* JSON value in Hz, txpkt.f_dev in kHz */
+                txpkt.f_dev = (uint8_t)(num / 1000); /* JSON value in Hz, txpkt.f_dev in kHz */
 
                 /* parse FSK preamble length (optional field, optimum min value enforced) */
-                val = json_object_get_value(txpk_obj, "prea");
-                if (val != NULL) {
-                    i = (int)json_value_get_number(val);
+                if (pkt_json_get_fixed(pkt_json_find(fields, nb_fields, "prea"), 0, &num)) {
+                    i = (int)num;
                     if (i >= MIN_FSK_PREAMB) {
                         txpkt.preamble = (uint16_t)i;
                     } else {
@@ -2186,34 +2242,27 @@ void thread_down(void) {
 
             } else {
                 MSG_WARN("[down] invalid modulation in \"txpk.modu\", TX aborted\n");
-                json_value_free(root_val);
                 continue;
             }
 
             /* Parse payload length (mandatory) */
-            val = json_object_get_value(txpk_obj, "size");
-            if (val == NULL) {
+            if (!pkt_json_get_fixed(pkt_json_find(fields, nb_fields, "size"), 0, &num)) {
                 MSG_WARN("[down] no mandatory \"txpk.size\" object in JSON, TX aborted\n");
-                json_value_free(root_val);
                 continue;
             }
-            txpkt.size = (uint16_t)json_value_get_number(val);
+            txpkt.size = (uint16_t)num;
 
-            /* Parse payload data (mandatory) */
-            str = json_object_get_string(txpk_obj, "data");
-            if (str == NULL) {
+            /* Parse payload data (mandatory), decoded straight from the datagram */
+            field = pkt_json_find(fields, nb_fields, "data");
+            if (field == NULL || field->type != PKT_JSON_STRING) {
                 MSG_WARN("[down] no mandatory \"txpk.data\" object in JSON, TX aborted\n");
-                json_value_free(root_val);
                 continue;
             }
-            i = b64_to_bin(str, strlen(str), txpkt.payload, sizeof txpkt.payload);
+            i = b64_to_bin(field->val, field->val_len, txpkt.payload, sizeof txpkt.payload);
             if (i != txpkt.size) {
                 MSG_WARN("[down] mismatch between .size and .data size once converter to binary\n");
             }
 
-            /* free the JSON parse tree from memory */
-            json_value_free(root_val);
-
             /* select TX mode */
             if (sent_immediate) {
                 txpkt.tx_mode = IMMEDIATE;
@@ -25,6 +25,7 @@ Maintainer: Michael Coracin
 #ifndef _LORA_PKTFWD_H
 #define _LORA_PKTFWD_H
 
+#include <stdint.h>
 #include "py/mpprint.h"
 
 int lora_gw_init(char *);
@@ -32,5 +33,12 @@ void pygate_reset();
 int lora_gw_get_debug_level();
 void lora_gw_set_debug_level(int level);
 
+/* received packets ring (pkt_tap.c), a record is a raw struct lgw_pkt_rx_s */
+#define PKT_TAP_REC_SIZE    300
+
+void pkt_tap_start(uint8_t *buf, uint32_t nb_rec);
+uint32_t pkt_tap_available(uint32_t *first, uint32_t *dropped);
+void pkt_tap_release(uint32_t nb_rec);
+
 #endif
 /* --- EOF ------------------------------------------------------------------ */
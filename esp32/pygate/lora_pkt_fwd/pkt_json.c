@@ -0,0 +1,383 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+/*
+Description:
+    Allocation free helpers for the Semtech UDP protocol JSON
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "pkt_json.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define PKT_JSON_DEPTH_MAX      16              /* deepest nesting skipped over */
+#define PKT_JSON_FIXED_MAX      100000000000000000LL    /* stop accumulating digits above this */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct pkt_json_cursor_s {
+    const char *p;
+    const char *end;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void skip_ws(struct pkt_json_cursor_s *c) {
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\r' || *c->p == '\n')) {
+        ++c->p;
+    }
+}
+
+/* on entry c->p is on the opening quote, on exit after the closing one */
+static bool scan_string(struct pkt_json_cursor_s *c, const char **str, uint16_t *len) {
+    const char *start = ++c->p;
+    while (c->p < c->end && *c->p != '"') {
+        if (*c->p == '\\') {
+            ++c->p; /* escaped char, kept as is */
+        }
+        ++c->p;
+    }
+    if (c->p >= c->end) {
+        return false;
+    }
+    *str = start;
+    *len = c->p - start;
+    ++c->p;
+    return true;
+}
+
+static bool scan_literal(struct pkt_json_cursor_s *c, const char *lit) {
+    int n = strlen(lit);
+    if (c->end - c->p < n || memcmp(c->p, lit, n) != 0) {
+        return false;
+    }
+    c->p += n;
+    return true;
+}
+
+/* skips an object or an array, on entry c->p is on the opening bracket */
+static bool skip_container(struct pkt_json_cursor_s *c) {
+    char stack[PKT_JSON_DEPTH_MAX];
+    int depth = 0;
+    const char *s;
+    uint16_t l;
+
+    while (c->p < c->end) {
+        char ch = *c->p;
+        if (ch == '"') {
+            if (!scan_string(c, &s, &l)) {
+                return false;
+            }
+            continue;
+        }
+        if (ch == '{' || ch == '[') {
+            if (depth == PKT_JSON_DEPTH_MAX) {
+                return false;
+            }
+            stack[depth++] = (ch == '{') ? '}' : ']';
+        } else if (ch == '}' || ch == ']') {
+            if (depth == 0 || stack[depth - 1] != ch) {
+                return false;
+            }
+            if (--depth == 0) {
+                ++c->p;
+                return true;
+            }
+        }
+        ++c->p;
+    }
+    return false;
+}
+
+/* scans any value, and reports where it is */
+static bool scan_value(struct pkt_json_cursor_s *c, struct pkt_json_field_s *f) {
+    const char *start;
+
+    skip_ws(c);
+    if (c->p >= c->end) {
+        return false;
+    }
+    start = c->p;
+    switch (*c->p) {
+        case '"':
+            f->type = PKT_JSON_STRING;
+            return scan_string(c, &f->val, &f->val_len);
+        case '{':
+        case '[':
+            f->type = (*c->p == '{') ? PKT_JSON_OBJECT : PKT_JSON_ARRAY;
+            if (!skip_container(c)) {
+                return false;
+            }
+            break;
+        case 't':
+            f->type = PKT_JSON_TRUE;
+            if (!scan_literal(c, "true")) {
+                return false;
+            }
+            break;
+        case 'f':
+            f->type = PKT_JSON_FALSE;
+            if (!scan_literal(c, "false")) {
+                return false;
+            }
+            break;
+        case 'n':
+            f->type = PKT_JSON_NULL;
+            if (!scan_literal(c, "null")) {
+                return false;
+            }
+            break;
+        default:
+            f->type = PKT_JSON_NUMBER;
+            while (c->p < c->end && (strchr("+-.eE", *c->p) != NULL || (*c->p >= '0' && *c->p <= '9'))) {
+                ++c->p;
+            }
+            if (c->p == start) {
+                return false;
+            }
+            break;
+    }
+    f->val = start;
+    f->val_len = c->p - start;
+    return true;
+}
+
+/* walks the members of the object c->p is on, keeping them all or only the one called name */
+static int scan_object(struct pkt_json_cursor_s *c, struct pkt_json_field_s *fields, int max_fields,
+                       const char *name, struct pkt_json_field_s *found) {
+    struct pkt_json_field_s f;
+    int nb = 0;
+
+    skip_ws(c);
+    if (c->p >= c->end || *c->p != '{') {
+        return -1;
+    }
+    ++c->p;
+    skip_ws(c);
+    if (c->p < c->end && *c->p == '}') {
+        ++c->p;
+        return 0;
+    }
+    while (c->p < c->end) {
+        skip_ws(c);
+        if (c->p >= c->end || *c->p != '"' || !scan_string(c, &f.key, &f.key_len)) {
+            return -1;
+        }
+        skip_ws(c);
+        if (c->p >= c->end || *c->p != ':') {
+            return -1;
+        }
+        ++c->p;
+        if (!scan_value(c, &f)) {
+            return -1;
+        }
+        if (name != NULL) {
+            if (f.key_len == strlen(name) && memcmp(f.key, name, f.key_len) == 0) {
+                *found = f;
+                nb = 1;
+            }
+        } else if (nb < max_fields) {
+            fields[nb++] = f;
+        }
+        skip_ws(c);
+        if (c->p < c->end && *c->p == ',') {
+            ++c->p;
+        } else if (c->p < c->end && *c->p == '}') {
+            ++c->p;
+            return nb;
+        } else {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int pkt_json_put_uint(char *out, uint32_t x) {
+    char tmp[10];
+    int n = 0;
+    int i;
+
+    do {
+        tmp[n++] = '0' + (x % 10);
+        x /= 10;
+    } while (x != 0);
+    for (i = 0; i < n; ++i) {
+        out[i] = tmp[n - 1 - i];
+    }
+    return n;
+}
+
+int pkt_json_put_int(char *out, int32_t x) {
+    if (x < 0) {
+        out[0] = '-';
+        return 1 + pkt_json_put_uint(out + 1, (uint32_t)0 - (uint32_t)x);
+    }
+    return pkt_json_put_uint(out, (uint32_t)x);
+}
+
+int pkt_json_put_fixed(char *out, int64_t x, int decimals) {
+    uint64_t scale = 1;
+    uint64_t ux;
+    int n = 0;
+    int i;
+
+    for (i = 0; i < decimals; ++i) {
+        scale *= 10;
+    }
+    if (x < 0) {
+        out[n++] = '-';
+        ux = (uint64_t)0 - (uint64_t)x;
+    } else {
+        ux = (uint64_t)x;
+    }
+    n += pkt_json_put_uint(out + n, (uint32_t)(ux / scale));
+    if (decimals > 0) {
+        ux %= scale;
+        out[n++] = '.';
+        for (i = decimals - 1; i >= 0; --i) {
+            out[n + i] = '0' + (ux % 10);
+            ux /= 10;
+        }
+        n += decimals;
+    }
+    return n;
+}
+
+int pkt_json_tokenize(const char *json, int len, const char *name, struct pkt_json_field_s *fields, int max_fields) {
+    struct pkt_json_cursor_s c = { json, json + len };
+    struct pkt_json_field_s obj;
+
+    /* first pass over the root object only, to find where the member is */
+    if (scan_object(&c, NULL, 0, name, &obj) != 1 || obj.type != PKT_JSON_OBJECT) {
+        return -1;
+    }
+    /* then the member object itself */
+    c.p = obj.val;
+    c.end = obj.val + obj.val_len;
+    return scan_object(&c, fields, max_fields, NULL, NULL);
+}
+
+const struct pkt_json_field_s *pkt_json_find(const struct pkt_json_field_s *fields, int nb_fields, const char *key) {
+    int len = strlen(key);
+    int i;
+
+    for (i = 0; i < nb_fields; ++i) {
+        if (fields[i].key_len == len && memcmp(fields[i].key, key, len) == 0) {
+            return &fields[i];
+        }
+    }
+    return NULL;
+}
+
+bool pkt_json_get_fixed(const struct pkt_json_field_s *field, int decimals, int64_t *x) {
+    const char *p;
+    const char *end;
+    bool neg = false;
+    bool digits = false;
+    int64_t v = 0;
+    int shift = 0; /* power of 10 still to apply to v */
+    int exp = 0;
+    bool exp_neg = false;
+
+    if (field == NULL || field->type != PKT_JSON_NUMBER) {
+        return false;
+    }
+    p = field->val;
+    end = field->val + field->val_len;
+
+    if (p < end && (*p == '-' || *p == '+')) {
+        neg = (*p == '-');
+        ++p;
+    }
+    for ( ; p < end && *p >= '0' && *p <= '9'; ++p) {
+        digits = true;
+        if (v < PKT_JSON_FIXED_MAX) {
+            v = v * 10 + (*p - '0');
+        } else {
+            ++shift; /* too many digits, scale instead */
+        }
+    }
+    if (p < end && *p == '.') {
+        for (++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+            digits = true;
+            if (v < PKT_JSON_FIXED_MAX) {
+                v = v * 10 + (*p - '0');
+                --shift;
+            }
+        }
+    }
+    if (!digits) {
+        return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        if (p < end && (*p == '-' || *p == '+')) {
+            exp_neg = (*p == '-');
+            ++p;
+        }
+        if (p == end) {
+            return false;
+        }
+        for ( ; p < end && *p >= '0' && *p <= '9'; ++p) {
+            if (exp < 100) {
+                exp = exp * 10 + (*p - '0');
+            }
+        }
+        shift += exp_neg ? -exp : exp;
+    }
+    if (p != end) {
+        return false;
+    }
+
+    for (shift += decimals; shift > 0; --shift) {
+        if (v > PKT_JSON_FIXED_MAX) {
+            return false;
+        }
+        v *= 10;
+    }
+    for ( ; shift < 0 && v != 0; ++shift) {
+        v /= 10; /* truncates, like a C cast would */
+    }
+    *x = neg ? -v : v;
+    return true;
+}
+
+int pkt_json_get_bool(const struct pkt_json_field_s *field) {
+    if (field == NULL) {
+        return -1;
+    }
+    if (field->type == PKT_JSON_TRUE) {
+        return 1;
+    }
+    if (field->type == PKT_JSON_FALSE) {
+        return 0;
+    }
+    return -1;
+}
+
+bool pkt_json_str_equals(const struct pkt_json_field_s *field, const char *str) {
+    int len = strlen(str);
+    return field != NULL && field->type == PKT_JSON_STRING && field->val_len == len && memcmp(field->val, str, len) == 0;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+/*
+Description:
+    Allocation free helpers for the Semtech UDP protocol JSON: number
+    formatting for the PUSH_DATA emitter and a single pass tokenizer for the
+    objects carried by PULL_RESP.
+*/
+
+
+#ifndef _LORA_PKTFWD_PKT_JSON_H
+#define _LORA_PKTFWD_PKT_JSON_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define PKT_JSON_FIELDS_MAX     24  /* max number of members kept for one object */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+enum pkt_json_type_e {
+    PKT_JSON_STRING,
+    PKT_JSON_NUMBER,
+    PKT_JSON_TRUE,
+    PKT_JSON_FALSE,
+    PKT_JSON_NULL,
+    PKT_JSON_OBJECT,
+    PKT_JSON_ARRAY
+};
+
+/**
+@struct pkt_json_field_s
+@brief One member of a JSON object, pointing into the parsed text
+*/
+struct pkt_json_field_s {
+    const char *key;            /*!> member name, not null terminated */
+    uint16_t key_len;
+    enum pkt_json_type_e type;
+    const char *val;            /*!> value text, without the quotes for strings, not null terminated */
+    uint16_t val_len;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Write an unsigned integer in decimal
+@param out pointer to the output buffer, needs room for 10 chars
+@param x value to write
+@return number of chars written (no null terminator)
+*/
+int pkt_json_put_uint(char *out, uint32_t x);
+
+/**
+@brief Write a signed integer in decimal
+@param out pointer to the output buffer, needs room for 11 chars
+@return number of chars written (no null terminator)
+*/
+int pkt_json_put_int(char *out, int32_t x);
+
+/**
+@brief Write a value scaled by 10^decimals as a fixed point number, eg. (-35, 1) -> "-3.5"
+@param out pointer to the output buffer, needs room for 12 + decimals chars
+@return number of chars written (no null terminator)
+*/
+int pkt_json_put_fixed(char *out, int64_t x, int decimals);
+
+/**
+@brief Find the object member named 'name' of the root object of a JSON text, and tokenize it
+@param json JSON text
+@param len length of the JSON text
+@param name name of the member of the root object to tokenize
+@param fields array receiving the members of that object
+@param max_fields size of the fields array
+@return number of members found, -1 if the text is not valid JSON or the member is not an object
+*/
+int pkt_json_tokenize(const char *json, int len, const char *name, struct pkt_json_field_s *fields, int max_fields);
+
+/**
+@brief Find a member by name among the fields returned by pkt_json_tokenize
+@return pointer to the field, NULL if there's no such member
+*/
+const struct pkt_json_field_s *pkt_json_find(const struct pkt_json_field_s *fields, int nb_fields, const char *key);
+
+/**
+@brief Get a number member, scaled by 10^decimals and truncated towards zero
+@return false if the field is missing, not a number or out of range
+*/
+bool pkt_json_get_fixed(const struct pkt_json_field_s *field, int decimals, int64_t *x);
+
+/**
+@brief Get a boolean member
+@return 1 if true, 0 if false, -1 if the field is missing or not a boolean
+*/
+int pkt_json_get_bool(const struct pkt_json_field_s *field);
+
+/**
+@brief Compare a string member with a null terminated string
+@return true if the field is a string equal to str
+*/
+bool pkt_json_str_equals(const struct pkt_json_field_s *field, const char *str);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
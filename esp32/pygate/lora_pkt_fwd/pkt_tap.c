@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+/*
+Description:
+    Ring of the raw packets received by the forwarder, shared with the
+    application
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "py/obj.h"
+#include "py/misc.h"
+#include "modmachine.h"
+#include "pkt_tap.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES (GLOBAL) ------------------------------------------- */
+
+static pthread_mutex_t mx_tap = PTHREAD_MUTEX_INITIALIZER; /* keeps the ring from being changed during a push */
+
+static uint8_t *tap_buf = NULL;
+static uint32_t tap_nb_rec = 0;
+static volatile uint32_t tap_head = 0;      /* records written, only changed by the producer */
+static volatile uint32_t tap_tail = 0;      /* records read, only changed by the consumer */
+static volatile uint32_t tap_dropped = 0;
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void pkt_tap_start(uint8_t *buf, uint32_t nb_rec) {
+    MP_STATIC_ASSERT(sizeof(struct lgw_pkt_rx_s) == PKT_TAP_REC_SIZE);
+
+    pthread_mutex_lock(&mx_tap);
+    tap_buf = (nb_rec > 0) ? buf : NULL;
+    tap_nb_rec = (buf != NULL) ? nb_rec : 0;
+    tap_head = 0;
+    tap_tail = 0;
+    tap_dropped = 0;
+    pthread_mutex_unlock(&mx_tap);
+}
+
+void pkt_tap_push(const struct lgw_pkt_rx_s *pkt, int nb_pkt) {
+    uint32_t head;
+    uint32_t free_rec;
+    bool was_empty;
+    int i;
+
+    if (tap_buf == NULL || nb_pkt <= 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&mx_tap);
+    if (tap_buf != NULL) {
+        head = tap_head;
+        was_empty = (head == tap_tail);
+        free_rec = tap_nb_rec - (head - tap_tail);
+        for (i = 0; i < nb_pkt && free_rec > 0; i++, free_rec--) {
+            memcpy(tap_buf + (head % tap_nb_rec) * PKT_TAP_REC_SIZE, &pkt[i], PKT_TAP_REC_SIZE);
+            head++;
+        }
+        tap_dropped += nb_pkt - i;
+        /* the records must be complete before the reader can see them */
+        __sync_synchronize();
+        tap_head = head;
+        if (was_empty && i > 0) {
+            machine_pygate_rx_event();
+        }
+    }
+    pthread_mutex_unlock(&mx_tap);
+}
+
+uint32_t pkt_tap_available(uint32_t *first, uint32_t *dropped) {
+    uint32_t head = tap_head;
+    uint32_t tail = tap_tail;
+    uint32_t count;
+
+    __sync_synchronize();
+    *dropped = tap_dropped;
+    if (tap_nb_rec == 0) {
+        *first = 0;
+        return 0;
+    }
+    *first = tail % tap_nb_rec;
+    count = head - tail;
+    if (*first + count > tap_nb_rec) {
+        count = tap_nb_rec - *first;
+    }
+    return count;
+}
+
+void pkt_tap_release(uint32_t nb_rec) {
+    uint32_t used = tap_head - tap_tail;
+
+    if (nb_rec > used) {
+        nb_rec = used;
+    }
+    /* the reader is done with the records before the writer may reuse them */
+    __sync_synchronize();
+    tap_tail += nb_rec;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
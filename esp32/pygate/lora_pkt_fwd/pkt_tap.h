@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+/*
+Description:
+    Ring of the raw packets received by the forwarder, shared with the
+    application (machine.pygate_tap()). One producer, the upstream thread,
+    and one consumer, so no lock is taken to read it.
+*/
+
+
+#ifndef _LORA_PKTFWD_PKT_TAP_H
+#define _LORA_PKTFWD_PKT_TAP_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <stdbool.h>    /* bool type */
+
+#include "loragw_hal.h"
+#include "lora_pkt_fwd.h"   /* reader side of the ring */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Copy received packets to the ring, called by the upstream thread after each fetch
+@param pkt array of packets
+@param nb_pkt number of packets in the array
+
+Packets that don't fit are counted as dropped, the forwarder never waits for the reader.
+The first packet stored in an empty ring raises the machine PYGATE_RX_EVT event.
+*/
+void pkt_tap_push(const struct lgw_pkt_rx_s *pkt, int nb_pkt);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
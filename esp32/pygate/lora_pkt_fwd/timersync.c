@@ -27,6 +27,7 @@ Maintainer: Michael Coracin
 
 #include <stdio.h>        /* printf, fprintf, snprintf, fopen, fputs */
 #include <stdint.h>        /* C99 types */
+#include <stdbool.h>       /* bool type */
 #include <pthread.h>
 
 #include "trace.h"
@@ -34,28 +35,35 @@ Maintainer: Michael Coracin
 #include "loragw_hal.h"
 #include "loragw_reg.h"
 #include "loragw_aux.h"
+#include "py/obj.h"
+#include "machrtc.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE CONSTANTS & TYPES -------------------------------------------- */
 
+#define TS_BURST                4       /* counter reads per sync, the one with the shortest round trip is kept */
+#define TS_STEP_US              10000   /* deviation from the model taken as a step of the counter */
+#define TS_DRIFT_WEIGHT         8       /* 1/weight of each new drift measurement in the estimate */
+#define TS_DRIFT_MAX_PPB        200000  /* crystals are far better than 200ppm, anything above is noise */
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
 
-#define timersub(a, b, result)                                                \
-  do {                                                                        \
-    (result)->tv_sec = (a)->tv_sec - (b)->tv_sec;                             \
-    (result)->tv_usec = (a)->tv_usec - (b)->tv_usec;                          \
-    if ((result)->tv_usec < 0) {                                              \
-      --(result)->tv_sec;                                                     \
-      (result)->tv_usec += 1000000;                                           \
-    }                                                                         \
-  } while (0)
+#define TV_TO_US(tv)            ((int64_t)(tv)->tv_sec * 1000000LL + (tv)->tv_usec)
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES (GLOBAL) ------------------------------------------- */
 
 static pthread_mutex_t mx_timersync = PTHREAD_MUTEX_INITIALIZER; /* control access to timer sync offsets */
-static struct timeval offset_unix_concent = {0, 0}; /* timer offset between unix host and concentrator */
+
+/* Mapping between the monotonic clock of machrtc and the concentrator counter (extended to 64 bits),
+ * both in us, the unix time is only added when converting so NTP updates don't disturb it:
+ *  offset(t) = ref_offset + (t - ref_mono) * drift / 10^9
+ *  concentrator = t - offset(t) */
+static bool ts_valid = false;
+static int64_t ts_ref_mono = 0;                 /* monotonic time of the last sync */
+static int64_t ts_ref_offset = 0;               /* offset monotonic - concentrator at ts_ref_mono */
+static int32_t ts_drift_ppb = 0;                /* drift of the offset, in ns per s */
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE SHARED VARIABLES (GLOBAL) ------------------------------------ */
@@ -63,11 +71,29 @@ extern bool exit_sig;
 extern bool quit_sig;
 extern pthread_mutex_t mx_concent;
 
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* the disciplined unix time minus the monotonic one */
+static int64_t ts_unix_offset(void) {
+    int64_t now_us = mach_rtc_ticks_us64();
+    return (int64_t)mach_rtc_get_us_since_epoch() - now_us;
+}
+
+/* the mutex must be held */
+static int64_t ts_offset_at(int64_t mono_us) {
+    if (!ts_valid) {
+        return 0;
+    }
+    return ts_ref_offset + (mono_us - ts_ref_mono) * ts_drift_ppb / 1000000000LL;
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
 
 int get_concentrator_time(struct timeval *concent_time, struct timeval unix_time) {
-    struct timeval local_timeval;
+    int64_t mono_us = TV_TO_US(&unix_time) - ts_unix_offset();
+    uint32_t count_us;
 
     if (concent_time == NULL) {
         MSG_ERROR("[ts  ] %s invalid parameter\n", __FUNCTION__);
@@ -75,17 +101,37 @@ int get_concentrator_time(struct timeval *concent_time, struct timeval unix_time
     }
 
     pthread_mutex_lock(&mx_timersync); /* protect global variable access */
-    timersub(&unix_time, &offset_unix_concent, &local_timeval);
+    count_us = (uint32_t)(mono_us - ts_offset_at(mono_us)); /* the counter wraps like the 32 bits one */
     pthread_mutex_unlock(&mx_timersync);
 
-    /* TODO: handle sx1301 coutner wrap-up !! */
-    concent_time->tv_sec = local_timeval.tv_sec;
-    concent_time->tv_usec = local_timeval.tv_usec;
-    /*
-    MSG_DEBUG("[ts  ] --> TIME: unix current time is    (%ld,%ld)[s,us]\n", unix_time.tv_sec, unix_time.tv_usec);
-    MSG_DEBUG("[ts  ]           concent current time is (%ld,%ld)[s,us]\n", local_timeval.tv_sec, local_timeval.tv_usec);
-    MSG_DEBUG("[ts  ]           offset is               (%ld,%ld)[s,us]\n", offset_unix_concent.tv_sec, offset_unix_concent.tv_usec);
-    */
+    concent_time->tv_sec = count_us / 1000000UL;
+    concent_time->tv_usec = count_us - (concent_time->tv_sec * 1000000UL);
+    return 0;
+}
+
+int get_unix_time(struct timeval *unix_time, uint32_t count_us) {
+    int64_t count;
+    int64_t mono_us;
+
+    if (unix_time == NULL) {
+        MSG_ERROR("[ts  ] %s invalid parameter\n", __FUNCTION__);
+        return -1;
+    }
+
+    pthread_mutex_lock(&mx_timersync); /* protect global variable access */
+    if (!ts_valid) {
+        pthread_mutex_unlock(&mx_timersync);
+        return -1;
+    }
+    /* extend the counter around the last sync, then apply the offset of that time */
+    count = (ts_ref_mono - ts_ref_offset) + (int32_t)(count_us - (uint32_t)(ts_ref_mono - ts_ref_offset));
+    mono_us = count + ts_ref_offset;
+    mono_us = count + ts_offset_at(mono_us);
+    pthread_mutex_unlock(&mx_timersync);
+    int64_t unix_us = mono_us + ts_unix_offset();
+
+    unix_time->tv_sec = unix_us / 1000000LL;
+    unix_time->tv_usec = unix_us % 1000000LL;
     return 0;
 }
 
@@ -94,53 +140,88 @@ int get_concentrator_time(struct timeval *concent_time, struct timeval unix_time
 
 void thread_timersync(void) {
     MSG_INFO("[ts  ] start\n");
-    struct timeval unix_timeval;
-    struct timeval concentrator_timeval;
+    int64_t before_us;
+    int64_t after_us;
     uint32_t sx1301_timecount = 0;
-    struct timeval offset_previous = {0, 0};
-    struct timeval offset_drift = {0, 0}; /* delta between current and previous offset */
+    int64_t mono_us = 0;
+    int64_t rtt_us;
+    int64_t best_rtt_us;
+    int64_t count;
+    int64_t offset;
+    int64_t error;
+    int64_t elapsed;
+    int32_t drift;
+    uint32_t count_us = 0;
+    int i;
 
     while (!exit_sig && !quit_sig) {
-        /* Get current unix time */
-        gettimeofday(&unix_timeval, NULL);
-
-        /* Get current concentrator counter value (1MHz) */
-        lgw_get_trigcnt(&sx1301_timecount);
-
-        concentrator_timeval.tv_sec = sx1301_timecount / 1000000UL;
-        concentrator_timeval.tv_usec = sx1301_timecount - (concentrator_timeval.tv_sec * 1000000UL);
-
-        /* Compute offset between unix and concentrator timers, with microsecond precision */
-        offset_previous.tv_sec = offset_unix_concent.tv_sec;
-        offset_previous.tv_usec = offset_unix_concent.tv_usec;
+        /* Read the concentrator counter (1MHz) a few times, each read between two readings of the monotonic
+           clock, and keep the one that took the least time: the middle of the two is where it was read */
+        best_rtt_us = -1;
+        for (i = 0; i < TS_BURST; i++) {
+            pthread_mutex_lock(&mx_concent);
+            before_us = mach_rtc_ticks_us64();
+            if (lgw_get_trigcnt(&sx1301_timecount) != LGW_HAL_SUCCESS) {
+                pthread_mutex_unlock(&mx_concent);
+                continue;
+            }
+            after_us = mach_rtc_ticks_us64();
+            pthread_mutex_unlock(&mx_concent);
+
+            rtt_us = after_us - before_us;
+            if ((best_rtt_us < 0) || (rtt_us < best_rtt_us)) {
+                best_rtt_us = rtt_us;
+                mono_us = before_us + rtt_us / 2;
+                count_us = sx1301_timecount;
+            }
+        }
+        if (best_rtt_us < 0) {
+            MSG_WARN("[ts  ] failed to read the concentrator counter\n");
+            wait_ms(750);
+            continue;
+        }
 
         pthread_mutex_lock(&mx_timersync); /* protect global variable access */
-        timersub(&unix_timeval, &concentrator_timeval, &offset_unix_concent);
+        if (!ts_valid) {
+            count = count_us;
+        } else {
+            /* extend the 32 bits counter around the predicted value */
+            count = mono_us - ts_offset_at(mono_us);
+            count += (int32_t)(count_us - (uint32_t)count);
+        }
+        offset = mono_us - count;
+        error = offset - ts_offset_at(mono_us);
+        elapsed = mono_us - ts_ref_mono;
+
+        if (!ts_valid || (error > TS_STEP_US) || (error < -TS_STEP_US) || (elapsed <= 0)) {
+            /* first sync, or the concentrator counter was reset, start again from this sample */
+            if (ts_valid) {
+                MSG_INFO("[ts  ] concentrator counter stepped by %lld us\n", (long long)error);
+            }
+            ts_ref_offset = offset;
+            ts_valid = true;
+        } else {
+            /* follow the phase halfway, and the frequency a little: a sample jitters by its round trip,
+               the drift of a crystal changes slowly */
+            drift = ts_drift_ppb + (int32_t)(error * 1000000000LL / elapsed / TS_DRIFT_WEIGHT);
+            if (drift > TS_DRIFT_MAX_PPB) {
+                drift = TS_DRIFT_MAX_PPB;
+            } else if (drift < -TS_DRIFT_MAX_PPB) {
+                drift = -TS_DRIFT_MAX_PPB;
+            }
+            ts_ref_offset = ts_offset_at(mono_us) + error / 2;
+            ts_drift_ppb = drift;
+        }
+        ts_ref_mono = mono_us;
         pthread_mutex_unlock(&mx_timersync);
 
-        timersub(&offset_unix_concent, &offset_previous, &offset_drift);
-
-/*
-        MSG_DEBUG("[ts  ] unix_timeval (%ld,%ld)[s,us]\n",
-                  unix_timeval.tv_sec,
-                  unix_timeval.tv_usec);
-        MSG_DEBUG("[ts  ] concentrator (%ld,%ld)[s,us] = %u [us]\n",
-                  concentrator_timeval.tv_sec,
-                  concentrator_timeval.tv_usec,
-                  sx1301_timecount);
-
-        MSG_DEBUG("[ts  ] offset       (%ld,%ld)[s,us], drift=%ld [us]\n",
-            offset_unix_concent.tv_sec,
-            offset_unix_concent.tv_usec,
-            offset_drift.tv_sec * 1000000UL + offset_drift.tv_usec);
-*/
+        MSG_DEBUG("[ts  ] concentrator=%u, round trip=%lld us, error=%lld us, drift=%ld ppb\n",
+                  count_us, (long long)best_rtt_us, (long long)error, (long)ts_drift_ppb);
 
         /* delay next sync */
         /* If we consider a crystal oscillator precision of about 20ppm worst case, and a clock
             running at 1MHz, this would mean 1µs drift every 50000µs (10000000/20).
-            As here the time precision is not critical, we should be able to cope with at least 1ms drift,
-            which should occur after 50s (50000µs * 1000).
-            Let's set the thread sleep to 1 minute for now */
+            The drift is followed, so the mapping stays within the read round trip in between */
         wait_ms(750);
     }
     MSG_INFO("[ts  ] end exit=%u quit=%u\n", exit_sig, quit_sig);
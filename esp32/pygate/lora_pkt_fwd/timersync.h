@@ -29,12 +29,19 @@ Maintainer: Michael Coracin
 /* --- DEPENDANCIES --------------------------------------------------------- */
 
 #include <sys/time.h>    /* timeval */
+#include <stdint.h>      /* C99 types */
 
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
 
 int get_concentrator_time(struct timeval *concent_time, struct timeval unix_time);
 
+/**
+@brief Convert a concentrator counter value, within half a counter period of now, to unix time
+@return 0 on success, -1 if the clocks were not synchronized yet
+*/
+int get_unix_time(struct timeval *unix_time, uint32_t count_us);
+
 void thread_timersync(void);
 
 #endif
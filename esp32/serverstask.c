@@ -19,7 +19,7 @@
 //#include "debug.h"
 #include "telnet.h"
 #include "ftp.h"
-//#include "pybwdt.h"
+#include "taskwdt.h"
 #include "modusocket.h"
 #include "mpexception.h"
 #include "modnetwork.h"
@@ -50,6 +50,7 @@ static volatile bool sleep_sockets = false;
 /******************************************************************************
  DECLARE PRIVATE FUNCTIONS
  ******************************************************************************/
+static void servers_wait_for_activity (void);
 
 /******************************************************************************
  DECLARE PUBLIC DATA
@@ -61,14 +62,14 @@ extern TaskHandle_t svTaskHandle;
  DECLARE PUBLIC FUNCTIONS
  ******************************************************************************/
 void TASK_Servers (void *pvParameters) {
-    bool cycle = false;
-
     strcpy (servers_user, SERVERS_DEF_USER);
     strcpy (servers_pass, SERVERS_DEF_PASS);
 
     telnet_init();
     ftp_init();
 
+    taskwdt_register(TASKWDT_SERVERS_TIMEOUT_MS);
+
     for ( ; ; ) {
 
         if (servers_data.do_enable) {
@@ -99,17 +100,14 @@ void TASK_Servers (void *pvParameters) {
             modusocket_close_all_user_sockets();
         }
 
-        if (cycle) {
-            telnet_run();
-        } else {
-            ftp_run();
-        }
+        telnet_run();
+        ftp_run();
 
         if (sleep_sockets) {
-//            pybwdt_srv_sleeping(true);  //  FIXME
+            taskwdt_sleeping(true);
 //            modusocket_enter_sleep();   //  FIXME
-//            pybwdt_srv_sleeping(false); // FIXME
             vTaskDelay((SERVERS_CYCLE_TIME_MS * 2) / portTICK_PERIOD_MS);
+            taskwdt_sleeping(false);
             if (servers_data.do_wlan_cycle_power) {
                 servers_data.do_wlan_cycle_power = false;
 //                wlan_off_on(); // FIXME
@@ -118,15 +116,16 @@ void TASK_Servers (void *pvParameters) {
         }
 
         // set the alive flag for the wdt
-//        pybwdt_srv_alive(); // FIXME
+        taskwdt_alive();
 
         if (servers_data.reset_and_safe_boot) {
             mp_hal_reset_safe_and_boot(true);
         }
 
-        // move to the next cycle
-        cycle = cycle ? false : true;
-        vTaskDelay (SERVERS_CYCLE_TIME_MS / portTICK_PERIOD_MS);
+        // sleep until one of the services has something to do
+        taskwdt_sleeping(true);
+        servers_wait_for_activity();
+        taskwdt_sleeping(false);
     }
 }
 
@@ -208,3 +207,26 @@ uint32_t servers_get_timeout (void) {
 /******************************************************************************
  DEFINE PRIVATE FUNCTIONS
  ******************************************************************************/
+static void servers_wait_for_activity (void) {
+    fd_set readfds;
+    fd_set writefds;
+    int32_t maxfd = -1;
+
+    FD_ZERO(&readfds);
+    FD_ZERO(&writefds);
+    // don't short-circuit, both services must add their sockets
+    bool busy = telnet_add_wait_sockets(&readfds, &writefds, &maxfd);
+    busy |= ftp_add_wait_sockets(&readfds, &writefds, &maxfd);
+
+    if (busy) {
+        // there's work pending that doesn't depend on the sockets, just let lower priority tasks run
+        vTaskDelay(1);
+    } else if (maxfd < 0) {
+        vTaskDelay(SERVERS_CYCLE_TIME_MS / portTICK_PERIOD_MS);
+    } else {
+        // wake up as soon as a socket is ready, or after one cycle to handle timeouts and
+        // the enable/disable requests
+        struct timeval tv = {.tv_sec = 0, .tv_usec = SERVERS_CYCLE_TIME_MS * 1000};
+        select(maxfd + 1, &readfds, &writefds, NULL, &tv);
+    }
+}
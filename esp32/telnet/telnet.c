@@ -36,6 +36,7 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 
 /******************************************************************************
  DEFINE PRIVATE CONSTANTS
@@ -47,7 +48,10 @@
 #define TELNET_TX_RETRIES_MAX               50
 #define TELNET_WAIT_TIME_MS                 2
 #define TELNET_LOGIN_RETRIES_MAX            3
-#define TELNET_CYCLE_TIME_MS                (SERVERS_CYCLE_TIME_MS * 2)
+// the REPL output is coalesced up to one TCP segment, or for TELNET_TX_COALESCE_MS
+// after the first byte queued, instead of doing a send() per character
+#define TELNET_TX_BUFFER_SIZE               1024
+#define TELNET_TX_COALESCE_MS               5
 
 #define SE 240
 #define AYT 246
@@ -100,7 +104,11 @@ typedef union {
 
 typedef struct {
     uint8_t             *rxBuffer;
-    uint32_t            timeout;
+    uint8_t             *txBuffer;
+    SemaphoreHandle_t   txMutex;            // the REPL task fills txBuffer, the servers task drains it
+    uint32_t            txQueued_ms;        // ticks when the oldest byte in txBuffer was queued
+    uint16_t            txLen;
+    uint32_t            activity_ms;        // ticks of the last data received
     telnet_state_t      state;
     telnet_substate_t   substate;
     int32_t             sd;
@@ -148,6 +156,7 @@ static int telnet_process_credential (char *credential, int32_t rxLen);
 static void telnet_parse_input (uint8_t *str, int32_t *len);
 static bool telnet_send_with_retries (int32_t sd, const void *pBuf, int32_t len);
 static void telnet_reset_buffer (void);
+static void telnet_tx_drain (void);
 
 /******************************************************************************
  DEFINE PUBLIC FUNCTIONS
@@ -155,6 +164,9 @@ static void telnet_reset_buffer (void);
 void telnet_init (void) {
     // allocate memory for the receive buffer (from the RTOS heap)
     telnet_data.rxBuffer = malloc(TELNET_RX_BUFFER_SIZE);
+    telnet_data.txBuffer = malloc(TELNET_TX_BUFFER_SIZE);
+    telnet_data.txMutex = xSemaphoreCreateMutex();
+    telnet_data.txLen = 0;
     telnet_data.state = E_TELNET_STE_DISABLED;
 }
 
@@ -245,13 +257,16 @@ void telnet_run (void) {
             break;
         case E_TELNET_STE_LOGGED_IN:
             telnet_process();
+            if (telnet_data.txLen > 0 && (mp_hal_ticks_ms() - telnet_data.txQueued_ms) >= TELNET_TX_COALESCE_MS) {
+                telnet_flush();
+            }
             break;
         default:
             break;
     }
 
     if (telnet_data.state >= E_TELNET_STE_CONNECTED) {
-        if (telnet_data.timeout++ > (servers_get_timeout() / TELNET_CYCLE_TIME_MS)) {
+        if ((mp_hal_ticks_ms() - telnet_data.activity_ms) > servers_get_timeout()) {
             telnet_reset();
         }
     }
@@ -259,7 +274,29 @@ void telnet_run (void) {
 
 void telnet_tx_strn (const char *str, int len) {
     if (telnet_data.n_sd > 0 && telnet_data.state == E_TELNET_STE_LOGGED_IN && len > 0) {
-        telnet_send_with_retries(telnet_data.n_sd, str, len);
+        xSemaphoreTake(telnet_data.txMutex, portMAX_DELAY);
+        if (telnet_data.txLen + len > TELNET_TX_BUFFER_SIZE) {
+            telnet_tx_drain();
+        }
+        if (len >= TELNET_TX_BUFFER_SIZE) {
+            // too big to be coalesced, send it right away
+            telnet_send_with_retries(telnet_data.n_sd, str, len);
+        } else {
+            if (telnet_data.txLen == 0) {
+                telnet_data.txQueued_ms = mp_hal_ticks_ms();
+            }
+            memcpy(telnet_data.txBuffer + telnet_data.txLen, str, len);
+            telnet_data.txLen += len;
+        }
+        xSemaphoreGive(telnet_data.txMutex);
+    }
+}
+
+void telnet_flush (void) {
+    if (telnet_data.txLen > 0) {
+        xSemaphoreTake(telnet_data.txMutex, portMAX_DELAY);
+        telnet_tx_drain();
+        xSemaphoreGive(telnet_data.txMutex);
     }
 }
 
@@ -277,6 +314,41 @@ int telnet_rx_char (void) {
     return rx_char;
 }
 
+bool telnet_add_wait_sockets (fd_set *readfds, fd_set *writefds, int32_t *maxfd) {
+    int32_t sd = -1;
+    switch (telnet_data.state) {
+        case E_TELNET_STE_LISTEN:
+            sd = telnet_data.sd;
+            break;
+        case E_TELNET_STE_CONNECTED:
+            if (telnet_data.substate.connected != E_TELNET_STE_SUB_GET_USER &&
+                telnet_data.substate.connected != E_TELNET_STE_SUB_GET_PASSWORD) {
+                // still sending the login dialog
+                return true;
+            }
+            sd = telnet_data.n_sd;
+            break;
+        case E_TELNET_STE_LOGGED_IN:
+            if ((uint8_t)(telnet_data.rxWindex + 1) == telnet_data.rxRindex) {
+                // the receive buffer is full, wait for the REPL to consume it
+                return true;
+            }
+            if (telnet_data.txLen > 0) {
+                // output is waiting to be drained, don't sleep for a whole cycle
+                return true;
+            }
+            sd = telnet_data.n_sd;
+            break;
+        default:
+            break;
+    }
+    if (sd >= 0) {
+        FD_SET(sd, readfds);
+        *maxfd = MAX(*maxfd, sd);
+    }
+    return false;
+}
+
 void telnet_enable (void) {
     telnet_data.enabled = true;
 }
@@ -291,6 +363,10 @@ void telnet_reset (void) {
     // close the connection and start all over again
     servers_close_socket(&telnet_data.n_sd);
     servers_close_socket(&telnet_data.sd);
+    // whatever output was pending belongs to the session that just ended
+    xSemaphoreTake(telnet_data.txMutex, portMAX_DELAY);
+    telnet_data.txLen = 0;
+    xSemaphoreGive(telnet_data.txMutex);
     telnet_data.state = E_TELNET_STE_START;
 }
 
@@ -383,7 +459,7 @@ static void telnet_wait_for_connection (void) {
         telnet_data.substate.connected = E_TELNET_STE_SUB_WELCOME;
         telnet_data.credentialsValid = true;
         telnet_data.loginRetries = 0;
-        telnet_data.timeout = 0;
+        telnet_data.activity_ms = mp_hal_ticks_ms();
         telnet_data.binary_mode = false;
     }
 }
@@ -411,7 +487,7 @@ static telnet_result_t telnet_recv_text_non_blocking (void *buff, int32_t Maxlen
     *rxLen = recv(telnet_data.n_sd, buff, Maxlen, 0);
     // if there's data received, parse it
     if (*rxLen > 0) {
-        telnet_data.timeout = 0;
+        telnet_data.activity_ms = mp_hal_ticks_ms();
         telnet_parse_input (buff, rxLen);
         if (*rxLen > 0) {
             return E_TELNET_RESULT_OK;
@@ -578,6 +654,16 @@ static bool telnet_send_with_retries (int32_t sd, const void *pBuf, int32_t len)
     return false;
 }
 
+// must be called with txMutex taken
+static void telnet_tx_drain (void) {
+    if (telnet_data.txLen > 0) {
+        if (telnet_data.n_sd > 0) {
+            telnet_send_with_retries(telnet_data.n_sd, telnet_data.txBuffer, telnet_data.txLen);
+        }
+        telnet_data.txLen = 0;
+    }
+}
+
 static void telnet_reset_buffer (void) {
     // erase any characters present in the current line
     memset (telnet_data.rxBuffer, '\b', TELNET_RX_BUFFER_SIZE / 2);
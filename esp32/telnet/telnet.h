@@ -10,16 +10,20 @@
 #ifndef TELNET_H_
 #define TELNET_H_
 
+#include "lwip/sockets.h"
+
 /******************************************************************************
  DECLARE EXPORTED FUNCTIONS
  ******************************************************************************/
 extern void telnet_init (void);
 extern void telnet_run (void);
 extern void telnet_tx_strn (const char *str, int len);
+extern void telnet_flush (void);
 extern bool telnet_rx_any (void);
 extern int  telnet_rx_char (void);
 extern void telnet_enable (void);
 extern void telnet_disable (void);
 extern void telnet_reset (void);
+extern bool telnet_add_wait_sockets (fd_set *readfds, fd_set *writefds, int32_t *maxfd);
 
 #endif /* TELNET_H_ */
@@ -0,0 +1,192 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2021, Pycom Limited.
+#
+# This software is licensed under the GNU GPL version 3 or any
+# later version, with permitted additional terms. For more information
+# see the Pycom Licence v1.0 document supplied with this file, or
+# available at https://www.pycom.io/opensource/licensing
+#
+
+"""
+Create a streamed delta update (PYDELTA1) between two application images.
+
+The device applies it against its running image while it is being received
+and writes the result straight into the OTA partition, so the delta never
+has to be stored and can be resumed from any checkpoint (see
+pycom.ota_start(resume=True)).
+
+Format, all integers little endian:
+
+    header  "PYDELTA1", u32 new size, u32 old size, u32 CRC-32 of the old image, u32 0
+    COPY    0x01, u32 old offset, u32 length
+    ADD     0x02, u32 old offset, u16 length, u16 payload length, payload
+    DATA    0x03, u16 length, u16 payload length, payload
+    END     0xFF
+
+COPY takes bytes from the old image, ADD adds the payload bytewise to them
+(bsdiff style), DATA is new data. Payloads are raw deflate streams of their
+own, or stored when the payload length equals the length. No record produces
+more than 4096 bytes or crosses a 4096 byte boundary of the new image.
+
+Usage: mkdelta.py old.bin new.bin delta.bin [--verify]
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+SECTOR = 4096
+PIECE = 512
+ANCHOR = 16
+OLD_STEP = 8
+MAX_CANDIDATES = 3
+
+OP_COPY = 0x01
+OP_ADD = 0x02
+OP_DATA = 0x03
+OP_END = 0xFF
+
+
+def deflate(data):
+    c = zlib.compressobj(9, zlib.DEFLATED, -15)
+    z = c.compress(data) + c.flush()
+    return z if len(z) < len(data) else data
+
+
+def build_index(old):
+    index = {}
+    for i in range(0, len(old) - ANCHOR + 1, OLD_STEP):
+        index.setdefault(old[i:i + ANCHOR], i)
+    return index
+
+
+def candidates(old, new, index, start, end, last_shift):
+    votes = {}
+    for j in range(start, min(end, len(new) - ANCHOR + 1)):
+        i = index.get(new[j:j + ANCHOR])
+        if i is not None:
+            votes[i - j] = votes.get(i - j, 0) + 1
+    shifts = sorted(votes, key=votes.get, reverse=True)[:MAX_CANDIDATES]
+    if last_shift is not None and last_shift not in shifts:
+        shifts.append(last_shift)
+    return [s for s in shifts if start + s >= 0 and end + s <= len(old)]
+
+
+def encode_piece(old, new, index, start, end, last_shift):
+    """Returns the cheapest (op, shift, payload) for new[start:end]."""
+    piece = new[start:end]
+    best = (OP_DATA, None, deflate(piece))
+    for shift in candidates(old, new, index, start, end, last_shift):
+        ref = old[start + shift:end + shift]
+        if ref == piece:
+            return (OP_COPY, shift, b'')
+        diff = bytes((a - b) & 0xFF for a, b in zip(piece, ref))
+        payload = deflate(diff)
+        if len(payload) + 4 < len(best[2]):
+            best = (OP_ADD, shift, payload)
+    return best
+
+
+def make_delta(old, new):
+    index = build_index(old)
+    out = [b'PYDELTA1', struct.pack('<IIII', len(new), len(old), zlib.crc32(old) & 0xFFFFFFFF, 0)]
+    last_shift = None
+    for sector in range(0, len(new), SECTOR):
+        sector_end = min(sector + SECTOR, len(new))
+        # neighbouring pieces that agree on the operation are merged, within the sector
+        runs = []
+        for start in range(sector, sector_end, PIECE):
+            end = min(start + PIECE, sector_end)
+            op, shift, _ = encode_piece(old, new, index, start, end, last_shift)
+            if shift is not None:
+                last_shift = shift
+            if runs and runs[-1][0] == op and runs[-1][1] == shift:
+                runs[-1][3] = end
+            else:
+                runs.append([op, shift, start, end])
+        for op, shift, start, end in runs:
+            length = end - start
+            if op == OP_COPY:
+                out.append(struct.pack('<BII', OP_COPY, start + shift, length))
+            elif op == OP_ADD:
+                ref = old[start + shift:end + shift]
+                payload = deflate(bytes((a - b) & 0xFF for a, b in zip(new[start:end], ref)))
+                out.append(struct.pack('<BIHH', OP_ADD, start + shift, length, len(payload)) + payload)
+            else:
+                payload = deflate(new[start:end])
+                out.append(struct.pack('<BHH', OP_DATA, length, len(payload)) + payload)
+    out.append(bytes([OP_END]))
+    return b''.join(out)
+
+
+def unpack(payload, length):
+    if len(payload) == length:
+        return payload
+    return zlib.decompress(payload, -15)
+
+
+def apply_delta(old, delta):
+    """Reference implementation of what the updater does on the device."""
+    if delta[:8] != b'PYDELTA1':
+        raise ValueError('not a delta')
+    new_size, old_size, old_crc, _ = struct.unpack_from('<IIII', delta, 8)
+    if old_size != len(old) or old_crc != zlib.crc32(old) & 0xFFFFFFFF:
+        raise ValueError('delta made for a different image')
+    pos = 24
+    new = bytearray()
+    while True:
+        op = delta[pos]
+        if op == OP_END:
+            break
+        if op == OP_COPY:
+            off, length = struct.unpack_from('<II', delta, pos + 1)
+            chunk = old[off:off + length]
+            pos += 9
+        elif op == OP_ADD:
+            off, length, plen = struct.unpack_from('<IHH', delta, pos + 1)
+            diff = unpack(delta[pos + 9:pos + 9 + plen], length)
+            chunk = bytes((a + b) & 0xFF for a, b in zip(diff, old[off:off + length]))
+            pos += 9 + plen
+        elif op == OP_DATA:
+            length, plen = struct.unpack_from('<HH', delta, pos + 1)
+            chunk = unpack(delta[pos + 5:pos + 5 + plen], length)
+            pos += 5 + plen
+        else:
+            raise ValueError('bad record at %d' % pos)
+        if len(new) % SECTOR + length > SECTOR:
+            raise ValueError('record crosses a sector at %d' % pos)
+        new += chunk
+    if len(new) != new_size:
+        raise ValueError('size mismatch')
+    return bytes(new)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Create a streamed delta update between two application images')
+    parser.add_argument('old', help='image running on the device')
+    parser.add_argument('new', help='image to update to')
+    parser.add_argument('delta', help='output file')
+    parser.add_argument('--verify', action='store_true', help='apply the delta again and compare')
+    args = parser.parse_args()
+
+    with open(args.old, 'rb') as f:
+        old = f.read()
+    with open(args.new, 'rb') as f:
+        new = f.read()
+
+    delta = make_delta(old, new)
+    with open(args.delta, 'wb') as f:
+        f.write(delta)
+    print('%s: %d bytes (%.1f%% of the new image)' % (args.delta, len(delta), 100.0 * len(delta) / max(len(new), 1)))
+
+    if args.verify:
+        if apply_delta(old, delta) != new:
+            print('verification FAILED')
+            sys.exit(1)
+        print('verified')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "py/mpstate.h"
+#include "py/runtime.h"
+#include "py/obj.h"
+
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "soc/soc.h"
+#include "bootmgr.h"
+#include "pycom_config.h"
+#include "mpsleep.h"
+#include "bootprof.h"
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+STATIC const char *bootprof_phase_names[BOOTPROF_NUM_PHASES] = {
+    [BOOTPROF_PHASE_BOOTLOADER]     = "bootloader",
+    [BOOTPROF_PHASE_SAFE_BOOT]      = "safe_boot",
+    [BOOTPROF_PHASE_STARTUP]        = "startup",
+    [BOOTPROF_PHASE_WIFI]           = "wifi",
+    [BOOTPROF_PHASE_FILESYSTEM]     = "filesystem",
+    [BOOTPROF_PHASE_FROZEN_BOOT]    = "_boot.py",
+    [BOOTPROF_PHASE_BOOT_PY]        = "boot.py",
+    [BOOTPROF_PHASE_FROZEN_MAIN]    = "_main.py",
+};
+
+// time at which each phase completed, in us since the app started (the
+// bootloader phases are durations); kept in RTC memory like the user area
+static RTC_DATA_ATTR uint64_t bootprof_stamps[BOOTPROF_NUM_PHASES];
+STATIC bool bootprof_fast_boot = false;
+
+/******************************************************************************
+ DEFINE PUBLIC FUNCTIONS
+ ******************************************************************************/
+void bootprof_init0 (void) {
+    uint32_t shared = REG_READ(BOOTMGR_RTC_SHARED_REG);
+
+    // RTC memory survives a deep sleep, so drop the previous boot
+    memset(bootprof_stamps, 0, sizeof(bootprof_stamps));
+    if (shared & BOOTMGR_RTC_TIMING_VALID) {
+        bootprof_stamps[BOOTPROF_PHASE_BOOTLOADER] =
+            (uint64_t)((shared >> BOOTMGR_RTC_BOOT_TIME_SHIFT) & BOOTMGR_RTC_TIME_MASK) * 1000;
+        bootprof_stamps[BOOTPROF_PHASE_SAFE_BOOT] =
+            (uint64_t)((shared >> BOOTMGR_RTC_SAFE_BOOT_TIME_SHIFT) & BOOTMGR_RTC_TIME_MASK) * 1000;
+    }
+
+    bool enabled = config_get_fast_boot_on_wake();
+    bootprof_fast_boot = enabled && (mpsleep_get_reset_cause() == MPSLEEP_DEEPSLEEP_RESET);
+    // re-arm the request for the bootloader and clear the timing for the next boot
+    bootprof_set_fast_boot(enabled);
+}
+
+void bootprof_mark (bootprof_phase_t phase) {
+    // only the hardware boot is profiled, soft resets run the same steps again
+    if (mpsleep_get_reset_cause() != MPSLEEP_SOFT_RESET && phase > BOOTPROF_PHASE_SAFE_BOOT) {
+        bootprof_stamps[phase] = esp_timer_get_time();
+    }
+}
+
+bool bootprof_is_fast_boot (void) {
+    return bootprof_fast_boot;
+}
+
+void bootprof_set_fast_boot (bool enable) {
+    REG_WRITE(BOOTMGR_RTC_SHARED_REG, enable ? BOOTMGR_RTC_FAST_BOOT_REQ : 0);
+}
+
+mp_obj_t bootprof_get_profile (void) {
+    mp_obj_t list = mp_obj_new_list(0, NULL);
+    uint64_t prev = 0;
+
+    for (int i = 0; i < BOOTPROF_NUM_PHASES; i++) {
+        mp_obj_t entry[2];
+        entry[0] = mp_obj_new_str(bootprof_phase_names[i], strlen(bootprof_phase_names[i]));
+        if (i <= BOOTPROF_PHASE_SAFE_BOOT) {
+            entry[1] = mp_obj_new_int_from_ull(bootprof_stamps[i]);
+        } else if (bootprof_stamps[i] == 0) {
+            // not reached (yet)
+            entry[1] = mp_const_none;
+        } else {
+            entry[1] = mp_obj_new_int_from_ull(bootprof_stamps[i] - prev);
+            prev = bootprof_stamps[i];
+        }
+        mp_obj_list_append(list, mp_obj_new_tuple(2, entry));
+    }
+    return list;
+}
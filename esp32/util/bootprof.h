@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#ifndef BOOTPROF_H_
+#define BOOTPROF_H_
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+
+// boot phases in the order they complete
+typedef enum {
+    BOOTPROF_PHASE_BOOTLOADER = 0,      // reset until the bootloader is done with the safe boot pin
+    BOOTPROF_PHASE_SAFE_BOOT,           // part of the above spent checking the safe boot pin
+    BOOTPROF_PHASE_STARTUP,             // app start until the interpreter and peripherals are initialised
+    BOOTPROF_PHASE_WIFI,
+    BOOTPROF_PHASE_FILESYSTEM,
+    BOOTPROF_PHASE_FROZEN_BOOT,         // _boot.py and the LTE modem start
+    BOOTPROF_PHASE_BOOT_PY,
+    BOOTPROF_PHASE_FROZEN_MAIN,         // _main.py, after which main.py runs
+    BOOTPROF_NUM_PHASES
+} bootprof_phase_t;
+
+/******************************************************************************
+ DECLARE FUNCTIONS
+ ******************************************************************************/
+void bootprof_init0 (void);
+void bootprof_mark (bootprof_phase_t phase);
+bool bootprof_is_fast_boot (void);
+void bootprof_set_fast_boot (bool enable);
+mp_obj_t bootprof_get_profile (void);
+
+#endif /* BOOTPROF_H_ */
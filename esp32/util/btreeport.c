@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "py/mpconfig.h"
+
+#include "esp_heap_caps.h"
+#include "sflash_diskio.h"
+
+#if MICROPY_PY_BTREE
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+STATIC bool btree_has_psram (void) {
+    return heap_caps_get_free_size(MALLOC_CAP_SPIRAM) > 0;
+}
+
+/******************************************************************************
+ DEFINE PUBLIC FUNCTIONS
+ ******************************************************************************/
+// every allocation of the Berkeley DB code goes through here, the pages of the
+// cache being by far the largest; malloc() would keep 4K blocks internal
+void *btree_page_malloc (size_t size) {
+    void *ptr = NULL;
+    if (btree_has_psram()) {
+        ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    }
+    return ptr ? ptr : malloc(size);
+}
+
+size_t btree_default_cachesize (void) {
+    uint32_t pages = btree_has_psram() ? MICROPY_PORT_BTREE_CACHE_PAGES_PSRAM : MICROPY_PORT_BTREE_CACHE_PAGES;
+    return pages * SFLASH_BLOCK_SIZE;
+}
+
+#endif // MICROPY_PY_BTREE
@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/mpstate.h"
+#include "py/bc.h"
+#include "py/qstr.h"
+
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_core_dump.h"
+#include "rom/crc.h"
+#include "soc/soc.h"
+#include "soc/soc_memory_layout.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/xtensa_context.h"
+
+#include "crashdump.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define CRASHDUMP_MAGIC                     (0x43525348)    // "CRSH"
+#define CRASHDUMP_BACKTRACE_DEPTH           (16)
+#define CRASHDUMP_TASKS_MAX                 (24)
+#define CRASHDUMP_QSTR_LEN                  (24)
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t pc;
+    uint32_t ret;                       // where the blocking function was called from
+    uint32_t stack_free;
+} crashdump_task_t;
+
+typedef struct {
+    uint32_t magic;
+    char task[configMAX_TASK_NAME_LEN];
+    uint32_t core;
+    uint32_t exccause;
+    uint32_t pc;
+    uint32_t excvaddr;
+    uint32_t n_backtrace;
+    uint32_t backtrace[CRASHDUMP_BACKTRACE_DEPTH];
+    uint32_t n_tasks;
+    crashdump_task_t tasks[CRASHDUMP_TASKS_MAX];
+    uint32_t heap_free;
+    uint32_t heap_min_free;
+    uint32_t py_line;                   // 0 when no Python code was running
+    char py_file[CRASHDUMP_QSTR_LEN];
+    char py_block[CRASHDUMP_QSTR_LEN];
+    uint32_t crc;
+} crashdump_report_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+// written by the panic handler, it survives the reset that follows
+static RTC_NOINIT_ATTR crashdump_report_t crashdump_rtc_report;
+STATIC crashdump_report_t crashdump_last_report;
+STATIC bool crashdump_has_report;
+
+/******************************************************************************
+ DECLARE PRIVATE FUNCTIONS
+ ******************************************************************************/
+// the real one, that prints the ELF core dump on the console
+void __real_esp_core_dump_to_uart (XtExcFrame *frame);
+void __wrap_esp_core_dump_to_uart (XtExcFrame *frame);
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+STATIC uint32_t crashdump_report_crc (const crashdump_report_t *report) {
+    return crc32_le(UINT32_MAX, (const uint8_t *)report, sizeof(crashdump_report_t) - sizeof(report->crc));
+}
+
+STATIC uint32_t crashdump_code_addr (uint32_t pc) {
+    // the two upper bits of a return address hold the window increment
+    if (pc & 0x80000000) {
+        pc = (pc & 0x3fffffff) | 0x40000000;
+    }
+    return pc;
+}
+
+// bytecode is either in RAM or frozen in the memory mapped flash
+STATIC bool crashdump_ptr_readable (const void *ptr) {
+    return esp_ptr_byte_accessible(ptr) || ((intptr_t)ptr >= SOC_DROM_LOW && (intptr_t)ptr < SOC_DROM_HIGH);
+}
+
+STATIC void crashdump_copy_qstr (char *dest, qstr q) {
+    size_t len;
+    const byte *data = qstr_data(q, &len);
+    len = MIN(len, CRASHDUMP_QSTR_LEN - 1);
+    memcpy(dest, data, len);
+    dest[len] = '\0';
+}
+
+// the same walk as the backtrace the panic handler prints, the register windows have been spilled
+STATIC void crashdump_backtrace (crashdump_report_t *report, const XtExcFrame *frame) {
+    uint32_t pc = frame->pc;
+    uint32_t sp = frame->a1;
+    report->backtrace[report->n_backtrace++] = crashdump_code_addr(pc);
+    pc = frame->a0;
+    while (report->n_backtrace < CRASHDUMP_BACKTRACE_DEPTH && esp_stack_ptr_is_sane(sp)) {
+        uint32_t psp = sp;
+        sp = *((uint32_t *)(sp - 0x10 + 4));
+        // a return address, step back to the call instruction
+        report->backtrace[report->n_backtrace++] = crashdump_code_addr(pc) - 3;
+        pc = *((uint32_t *)(psp - 0x10));
+        if (pc < 0x40000000) {
+            break;
+        }
+    }
+}
+
+// where every other task was left when it was switched out
+STATIC void crashdump_tasks (crashdump_report_t *report) {
+    TaskSnapshot_t snapshots[CRASHDUMP_TASKS_MAX];
+    UBaseType_t tcb_size;
+    UBaseType_t n_tasks = uxTaskGetSnapshotAll(snapshots, CRASHDUMP_TASKS_MAX, &tcb_size);
+    for (UBaseType_t i = 0; i < n_tasks; i++) {
+        TaskHandle_t task = (TaskHandle_t)snapshots[i].pxTCB;
+        const uint32_t *top = (const uint32_t *)snapshots[i].pxTopOfStack;
+        if (!esp_ptr_byte_accessible(top)) {
+            continue;
+        }
+        crashdump_task_t *entry = &report->tasks[report->n_tasks++];
+        strncpy(entry->name, pcTaskGetTaskName(task), sizeof(entry->name) - 1);
+        entry->name[sizeof(entry->name) - 1] = '\0';
+        if (((const XtExcFrame *)top)->exit) {
+            // preempted by an interrupt
+            entry->pc = crashdump_code_addr(((const XtExcFrame *)top)->pc);
+            entry->ret = crashdump_code_addr(((const XtExcFrame *)top)->a0);
+        } else {
+            // gave up the CPU itself
+            entry->pc = crashdump_code_addr(((const XtSolFrame *)top)->pc);
+            entry->ret = crashdump_code_addr(((const XtSolFrame *)top)->a0);
+        }
+        entry->stack_free = uxTaskGetStackHighWaterMark(task);
+    }
+}
+
+// the innermost Python frame of the crashed task, or of the main thread when the
+// crash happened outside of Python
+STATIC void crashdump_python (crashdump_report_t *report) {
+    mp_state_thread_t *ts = pvTaskGetThreadLocalStoragePointer(NULL, 1);
+    if (ts == NULL || !esp_ptr_byte_accessible(ts)) {
+        ts = &mp_state_ctx.thread;
+    }
+    const mp_code_state_t *code_state = ts->current_code_state;
+    if (code_state == NULL || !esp_ptr_byte_accessible(code_state) || !esp_ptr_byte_accessible(code_state->fun_bc) ||
+        !crashdump_ptr_readable(code_state->fun_bc->bytecode) || !crashdump_ptr_readable(code_state->ip)) {
+        return;
+    }
+    qstr source_file, block_name;
+    size_t source_line;
+    mp_bytecode_get_source_info(code_state, &source_file, &block_name, &source_line);
+    crashdump_copy_qstr(report->py_file, source_file);
+    crashdump_copy_qstr(report->py_block, block_name);
+    report->py_line = source_line;
+}
+
+STATIC mp_obj_t crashdump_new_str (const char *str, size_t max_len) {
+    return mp_obj_new_str(str, strnlen(str, max_len));
+}
+
+/******************************************************************************
+ DEFINE PUBLIC FUNCTIONS
+ ******************************************************************************/
+// called by the panic handler of the IDF, with the other core stalled; the summary
+// is saved before anything else so that the console dump can't get in its way
+void __wrap_esp_core_dump_to_uart (XtExcFrame *frame) {
+    crashdump_report_t *report = &crashdump_rtc_report;
+    memset(report, 0, sizeof(*report));
+    report->magic = CRASHDUMP_MAGIC;
+    strncpy(report->task, pcTaskGetTaskName(NULL), sizeof(report->task) - 1);
+    report->core = xPortGetCoreID();
+    report->exccause = frame->exccause;
+    report->pc = crashdump_code_addr(frame->pc);
+    report->excvaddr = frame->excvaddr;
+    report->heap_free = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    report->heap_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+    crashdump_backtrace(report, frame);
+    crashdump_tasks(report);
+    report->crc = crashdump_report_crc(report);
+
+    // the Python state may be what got corrupted, so it comes last and the
+    // report is already valid without it
+    crashdump_python(report);
+    report->crc = crashdump_report_crc(report);
+
+    __real_esp_core_dump_to_uart(frame);
+}
+
+void crashdump_init0 (void) {
+    // the RTC memory holds garbage after a power on, hence the checks
+    if (crashdump_rtc_report.magic == CRASHDUMP_MAGIC && crashdump_rtc_report.crc == crashdump_report_crc(&crashdump_rtc_report)) {
+        memcpy(&crashdump_last_report, &crashdump_rtc_report, sizeof(crashdump_last_report));
+        crashdump_has_report = true;
+    }
+    crashdump_rtc_report.magic = 0;
+}
+
+// (task, core, exccause, pc, excvaddr, [backtrace], [(task, pc, ret, stack_free), ...],
+//  heap_free, heap_min_free, (file, block, line) or None) or None
+mp_obj_t crashdump_get_report (void) {
+    if (!crashdump_has_report) {
+        return mp_const_none;
+    }
+    crashdump_report_t *report = &crashdump_last_report;
+
+    mp_obj_t backtrace = mp_obj_new_list(0, NULL);
+    for (uint32_t i = 0; i < MIN(report->n_backtrace, CRASHDUMP_BACKTRACE_DEPTH); i++) {
+        mp_obj_list_append(backtrace, mp_obj_new_int_from_uint(report->backtrace[i]));
+    }
+
+    mp_obj_t tasks = mp_obj_new_list(0, NULL);
+    for (uint32_t i = 0; i < MIN(report->n_tasks, CRASHDUMP_TASKS_MAX); i++) {
+        crashdump_task_t *entry = &report->tasks[i];
+        mp_obj_t tuple[4] = {
+            crashdump_new_str(entry->name, sizeof(entry->name)),
+            mp_obj_new_int_from_uint(entry->pc),
+            mp_obj_new_int_from_uint(entry->ret),
+            mp_obj_new_int_from_uint(entry->stack_free),
+        };
+        mp_obj_list_append(tasks, mp_obj_new_tuple(4, tuple));
+    }
+
+    mp_obj_t python = mp_const_none;
+    if (report->py_line > 0) {
+        mp_obj_t tuple[3] = {
+            crashdump_new_str(report->py_file, sizeof(report->py_file)),
+            crashdump_new_str(report->py_block, sizeof(report->py_block)),
+            mp_obj_new_int_from_uint(report->py_line),
+        };
+        python = mp_obj_new_tuple(3, tuple);
+    }
+
+    mp_obj_t tuple[10] = {
+        crashdump_new_str(report->task, sizeof(report->task)),
+        mp_obj_new_int_from_uint(report->core),
+        mp_obj_new_int_from_uint(report->exccause),
+        mp_obj_new_int_from_uint(report->pc),
+        mp_obj_new_int_from_uint(report->excvaddr),
+        backtrace,
+        tasks,
+        mp_obj_new_int_from_uint(report->heap_free),
+        mp_obj_new_int_from_uint(report->heap_min_free),
+        python,
+    };
+    return mp_obj_new_tuple(10, tuple);
+}
@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#ifndef CRASHDUMP_H_
+#define CRASHDUMP_H_
+
+#include "py/obj.h"
+
+/******************************************************************************
+ DECLARE FUNCTIONS
+ ******************************************************************************/
+void crashdump_init0 (void);
+mp_obj_t crashdump_get_report (void);
+
+#endif /* CRASHDUMP_H_ */
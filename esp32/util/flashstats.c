@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "flashstats.h"
+#include "tracering.h"
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+typedef struct {
+    uint32_t count[FLASHSTATS_NUM_OPS];
+    uint64_t bytes[FLASHSTATS_NUM_OPS];
+    uint32_t max_us[FLASHSTATS_NUM_OPS];            // worst case latency
+    uint32_t cache_hits;
+    uint32_t errors;
+} flashstats_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+STATIC const char *flashstats_region_names[FLASHSTATS_NUM_REGIONS] = {
+    [FLASHSTATS_FATFS]      = "fatfs",
+    [FLASHSTATS_LITTLEFS]   = "littlefs",
+    [FLASHSTATS_OTA]        = "ota",
+    [FLASHSTATS_TSLOG]      = "tslog",
+};
+
+// counted since power on, a deep sleep doesn't start them again
+static RTC_DATA_ATTR flashstats_t flashstats[FLASHSTATS_NUM_REGIONS];
+// the drivers run from several tasks, some of them without the GIL
+static portMUX_TYPE flashstats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/******************************************************************************
+ DEFINE PUBLIC FUNCTIONS
+ ******************************************************************************/
+void flashstats_record (flashstats_region_t region, flashstats_op_t op, uint32_t bytes, int64_t start, esp_err_t err) {
+    uint32_t elapsed = esp_timer_get_time() - start;
+    flashstats_t *stats = &flashstats[region];
+
+    portENTER_CRITICAL(&flashstats_mux);
+    if (err != ESP_OK) {
+        stats->errors++;
+    } else {
+        stats->count[op]++;
+        stats->bytes[op] += bytes;
+        if (elapsed > stats->max_us[op]) {
+            stats->max_us[op] = elapsed;
+        }
+    }
+    portEXIT_CRITICAL(&flashstats_mux);
+    if (op == FLASHSTATS_ERASE) {
+        TRACE_COMPLETE(TRACE_EV_FLASH_ERASE, elapsed);
+    }
+}
+
+void flashstats_cache_hit (flashstats_region_t region) {
+    portENTER_CRITICAL(&flashstats_mux);
+    flashstats[region].cache_hits++;
+    portEXIT_CRITICAL(&flashstats_mux);
+}
+
+mp_obj_t flashstats_get (bool reset) {
+    flashstats_t copy[FLASHSTATS_NUM_REGIONS];
+
+    portENTER_CRITICAL(&flashstats_mux);
+    memcpy(copy, flashstats, sizeof(copy));
+    if (reset) {
+        memset(flashstats, 0, sizeof(flashstats));
+    }
+    portEXIT_CRITICAL(&flashstats_mux);
+
+    mp_obj_t dict = mp_obj_new_dict(FLASHSTATS_NUM_REGIONS);
+    for (int i = 0; i < FLASHSTATS_NUM_REGIONS; i++) {
+        flashstats_t *stats = &copy[i];
+        mp_obj_t tuple[FLASHSTATS_NUM_OPS * 3 + 2];
+        for (int op = 0; op < FLASHSTATS_NUM_OPS; op++) {
+            tuple[op * 2] = mp_obj_new_int_from_uint(stats->count[op]);
+            tuple[op * 2 + 1] = mp_obj_new_int_from_ull(stats->bytes[op]);
+            tuple[FLASHSTATS_NUM_OPS * 2 + 2 + op] = mp_obj_new_int_from_uint(stats->max_us[op]);
+        }
+        tuple[FLASHSTATS_NUM_OPS * 2] = mp_obj_new_int_from_uint(stats->cache_hits);
+        tuple[FLASHSTATS_NUM_OPS * 2 + 1] = mp_obj_new_int_from_uint(stats->errors);
+        mp_obj_dict_store(dict, mp_obj_new_str(flashstats_region_names[i], strlen(flashstats_region_names[i])),
+                          mp_obj_new_tuple(MP_ARRAY_SIZE(tuple), tuple));
+    }
+    return dict;
+}
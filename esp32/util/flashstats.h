@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#ifndef FLASHSTATS_H_
+#define FLASHSTATS_H_
+
+#include "esp_err.h"
+#include "esp_timer.h"
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+// the flash regions written by the firmware itself, NVS goes through the IDF and isn't counted
+typedef enum {
+    FLASHSTATS_FATFS = 0,
+    FLASHSTATS_LITTLEFS,
+    FLASHSTATS_OTA,                     // the app slots and their boot info
+    FLASHSTATS_TSLOG,
+    FLASHSTATS_NUM_REGIONS
+} flashstats_region_t;
+
+typedef enum {
+    FLASHSTATS_READ = 0,
+    FLASHSTATS_PROGRAM,
+    FLASHSTATS_ERASE,
+    FLASHSTATS_NUM_OPS
+} flashstats_op_t;
+
+/******************************************************************************
+ DECLARE FUNCTIONS
+ ******************************************************************************/
+// start is the esp_timer_get_time() taken just before the operation
+void flashstats_record (flashstats_region_t region, flashstats_op_t op, uint32_t bytes, int64_t start, esp_err_t err);
+void flashstats_cache_hit (flashstats_region_t region);
+mp_obj_t flashstats_get (bool reset);
+
+#endif /* FLASHSTATS_H_ */
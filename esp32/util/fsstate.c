@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+
+#include "esp_attr.h"
+#include "rom/crc.h"
+#include "extmod/vfs_fat.h"
+#include "lfs.h"
+#include "vfs_littlefs.h"
+#include "sflash_diskio.h"
+#include "pycom_config.h"
+#include "mpsleep.h"
+#include "bootprof.h"
+#include "mptask.h"
+#include "fsstate.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define FSSTATE_MAGIC                   (0x46535354)    // "FSST"
+// large enough for the lookahead of the biggest /flash
+#define FSSTATE_LOOKAHEAD_MAX           ((SFLASH_BLOCK_COUNT_8MB + 63) / 64 * 8)
+
+#define FSSTATE_TYPE_FATFS              (0)
+#define FSSTATE_TYPE_LITTLEFS           (1)
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+// what /flash looked like when the device went to deep sleep, so that the
+// mount on wake doesn't have to find it out again from the flash
+typedef struct {
+    uint32_t magic;
+    uint32_t crc;                       // of everything below
+    uint32_t type;
+    union {
+        struct {
+            // checked against the fresh mount before anything is used
+            lfs_block_t block_count;
+            lfs_size_t lookahead_size;
+            lfs_block_t root[2];
+            uint32_t gstate_tag;
+            // the allocator, saves the traversal of the whole tree on the first write
+            lfs_block_t off;
+            lfs_block_t size;
+            lfs_block_t i;
+            lfs_block_t ack;
+            uint32_t buffer[FSSTATE_LOOKAHEAD_MAX / 4];
+        } lfs;
+        struct {
+            DWORD n_fatent;
+            DWORD fsize;
+            DWORD volbase;
+            // saves the scan of the FAT on the first write and on statvfs
+            DWORD last_clst;
+            DWORD free_clst;
+        } fat;
+    };
+} fsstate_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+static RTC_DATA_ATTR fsstate_t fsstate;
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+static uint32_t fsstate_crc (void) {
+    const uint8_t *start = (const uint8_t *)&fsstate.type;
+    return crc32_le(UINT32_MAX, start, sizeof(fsstate) - (start - (const uint8_t *)&fsstate));
+}
+
+// only good for the wake up straight after the sleep it was saved for, nothing
+// writes to /flash in between; anything else could have changed the flash
+static bool fsstate_take (uint32_t type) {
+    bool valid = fsstate.magic == FSSTATE_MAGIC && fsstate.crc == fsstate_crc() && fsstate.type == type &&
+                 bootprof_is_fast_boot();
+    fsstate.magic = 0;
+    return valid;
+}
+
+/******************************************************************************
+ DEFINE PUBLIC FUNCTIONS
+ ******************************************************************************/
+void fsstate_save (void) {
+    fsstate.magic = 0;
+    if (!config_get_fast_boot_on_wake()) {
+        return;
+    }
+
+    if (config_get_boot_fs_type() == 0x01) {
+        vfs_lfs_struct_t *littlefs = &sflash_vfs_flash.fs.littlefs;
+        lfs_t *lfs = &littlefs->lfs;
+        if (lfs->cfg == NULL || lfs->cfg->lookahead_size > FSSTATE_LOOKAHEAD_MAX) {
+            return;
+        }
+        // no other task may be half way through a commit while this is copied
+        LITTLEFS_IO_LOCK(littlefs);
+        memset(&fsstate.lfs, 0, sizeof(fsstate.lfs));
+        fsstate.type = FSSTATE_TYPE_LITTLEFS;
+        fsstate.lfs.block_count = lfs->cfg->block_count;
+        fsstate.lfs.lookahead_size = lfs->cfg->lookahead_size;
+        fsstate.lfs.root[0] = lfs->root[0];
+        fsstate.lfs.root[1] = lfs->root[1];
+        fsstate.lfs.gstate_tag = lfs->gstate.tag;
+        fsstate.lfs.off = lfs->free.off;
+        fsstate.lfs.size = lfs->free.size;
+        fsstate.lfs.i = lfs->free.i;
+        fsstate.lfs.ack = lfs->free.ack;
+        memcpy(fsstate.lfs.buffer, lfs->free.buffer, lfs->cfg->lookahead_size);
+        fsstate.crc = fsstate_crc();
+        fsstate.magic = FSSTATE_MAGIC;
+        LITTLEFS_IO_UNLOCK(littlefs);
+    } else {
+        FATFS *fatfs = &sflash_vfs_flash.fs.fatfs;
+        // a FAT sector still waiting in the window would make the counts wrong
+        if (fatfs->fs_type == 0 || fatfs->wflag) {
+            return;
+        }
+        memset(&fsstate.fat, 0, sizeof(fsstate.fat));
+        fsstate.type = FSSTATE_TYPE_FATFS;
+        fsstate.fat.n_fatent = fatfs->n_fatent;
+        fsstate.fat.fsize = fatfs->fsize;
+        fsstate.fat.volbase = fatfs->volbase;
+        fsstate.fat.last_clst = fatfs->last_clst;
+        fsstate.fat.free_clst = fatfs->free_clst;
+        fsstate.crc = fsstate_crc();
+        fsstate.magic = FSSTATE_MAGIC;
+    }
+}
+
+void fsstate_restore_littlefs (lfs_t *lfs) {
+    if (!fsstate_take(FSSTATE_TYPE_LITTLEFS)) {
+        return;
+    }
+    if (fsstate.lfs.block_count != lfs->cfg->block_count || fsstate.lfs.lookahead_size != lfs->cfg->lookahead_size ||
+        fsstate.lfs.root[0] != lfs->root[0] || fsstate.lfs.root[1] != lfs->root[1] ||
+        fsstate.lfs.gstate_tag != lfs->gstate.tag) {
+        return;
+    }
+    lfs->free.off = fsstate.lfs.off;
+    lfs->free.size = fsstate.lfs.size;
+    lfs->free.i = fsstate.lfs.i;
+    lfs->free.ack = fsstate.lfs.ack;
+    memcpy(lfs->free.buffer, fsstate.lfs.buffer, lfs->cfg->lookahead_size);
+}
+
+void fsstate_restore_fatfs (FATFS *fatfs) {
+    if (!fsstate_take(FSSTATE_TYPE_FATFS)) {
+        return;
+    }
+    if (fsstate.fat.n_fatent != fatfs->n_fatent || fsstate.fat.fsize != fatfs->fsize ||
+        fsstate.fat.volbase != fatfs->volbase) {
+        return;
+    }
+    fatfs->last_clst = fsstate.fat.last_clst;
+    fatfs->free_clst = fsstate.fat.free_clst;
+}
@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#ifndef FSSTATE_H_
+#define FSSTATE_H_
+
+#include "ff.h"
+#include "lfs.h"
+
+/******************************************************************************
+ DECLARE FUNCTIONS
+ ******************************************************************************/
+void fsstate_save (void);
+void fsstate_restore_littlefs (lfs_t *lfs);
+void fsstate_restore_fatfs (FATFS *fatfs);
+
+#endif /* FSSTATE_H_ */
@@ -16,9 +16,28 @@
 #include "py/gc.h"
 #include "py/mpthread.h"
 #include "gccollect.h"
+#include "tracering.h"
 #include "soc/cpu.h"
 #include "xtensa/hal.h"
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/******************************************************************************
+DEFINE CONSTANTS
+ ******************************************************************************/
+#define GC_HELPER_TASK_STACK_SIZE               (2048)
+// above the MicroPython threads, so that the helper joins the mark right away
+#define GC_HELPER_TASK_PRIORITY                 (MP_THREAD_PRIORITY + 1)
+
+/******************************************************************************
+DECLARE PRIVATE DATA
+ ******************************************************************************/
+#if MICROPY_GC_PARALLEL_MARK && !CONFIG_FREERTOS_UNICORE
+// one helper per core, the one on the other core than the collector is used
+static TaskHandle_t gc_helper_task[portNUM_PROCESSORS];
+#endif
+
 /******************************************************************************
 DECLARE PRIVATE FUNCTIONS
  ******************************************************************************/
@@ -43,11 +62,43 @@ static void gc_collect_inner(int level) {
 #endif
 }
 
+#if MICROPY_GC_PARALLEL_MARK && !CONFIG_FREERTOS_UNICORE
+static void TASK_GC_Helper (void *pvParameters) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        gc_helper_mark();
+    }
+}
+#endif
+
 /******************************************************************************
 DECLARE PUBLIC FUNCTIONS
  ******************************************************************************/
+#if MICROPY_GC_PARALLEL_MARK
+bool gc_helper_start(void) {
+#if CONFIG_FREERTOS_UNICORE
+    return false;
+#else
+    // the collector is pinned to its core like every MicroPython thread
+    int core = !xPortGetCoreID();
+    if (gc_helper_task[core] == NULL) {
+        // the stack comes from the system heap, not from the GC heap we're collecting
+        if (xTaskCreatePinnedToCore(TASK_GC_Helper, "GCHelper", GC_HELPER_TASK_STACK_SIZE / sizeof(StackType_t), NULL,
+                                    GC_HELPER_TASK_PRIORITY, &gc_helper_task[core], core) != pdPASS) {
+            gc_helper_task[core] = NULL;
+            return false;
+        }
+    }
+    xTaskNotifyGive(gc_helper_task[core]);
+    return true;
+#endif
+}
+#endif
+
 void gc_collect(void) {
+    TRACE_BEGIN(TRACE_EV_GC, 0);
     gc_collect_start();
     gc_collect_inner(0);
     gc_collect_end();
+    TRACE_END(TRACE_EV_GC, 0);
 }
@@ -7,6 +7,8 @@
  * available at https://www.pycom.io/opensource/licensing
  */
 
+#include <string.h>
+
 #include "py/mpconfig.h"
 #include "py/obj.h"
 #include "py/runtime.h"
@@ -15,11 +17,15 @@
 #include "mperror.h"
 #include "mpirq.h"
 #include "mpthreadport.h"
+#include "tracering.h"
+#include "taskwdt.h"
 #include "py/stackctrl.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_attr.h"
+#include "py/mphal.h"
 
 #if MICROPY_PY_THREAD
 
@@ -28,19 +34,165 @@ typedef struct {
     mp_obj_dict_t *dict_globals;
 } mpirq_args_t;
 
+typedef struct {
+    mp_callback_obj_t items[INTERRUPTS_QUEUE_LEN];
+    uint16_t head;
+    uint16_t count;
+    uint16_t max_count;
+    uint32_t queued;
+    uint32_t coalesced;
+    uint32_t dropped;
+    uint32_t dispatched;
+    uint32_t max_latency_us;
+    uint64_t total_latency_us;
+} mp_irq_queue_t;
+
+typedef struct {
+    SemaphoreHandle_t pending;
+    uint8_t lowest_priority;                // serves from MP_IRQ_PRIORITY_HIGH down to this one
+    volatile bool alive;
+} mp_irq_worker_t;
+
+typedef struct {
+    void *parent;
+    uint8_t priority;
+} mp_irq_prio_entry_t;
+
 /******************************************************************************
  DECLARE PRIVATE DATA
  ******************************************************************************/
-STATIC QueueHandle_t InterruptsQueue;
-STATIC bool mp_irq_is_alive;
+STATIC mp_irq_queue_t mp_irq_queues[MP_IRQ_PRIORITY_COUNT];
+STATIC mp_irq_prio_entry_t mp_irq_prio_table[MP_IRQ_PRIORITY_TABLE_LEN];
+STATIC portMUX_TYPE mp_irq_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// the main worker serves all priorities, the high priority one is only started on demand
+STATIC mp_irq_worker_t mp_irq_main_worker = { .lowest_priority = MP_IRQ_PRIORITY_LOW };
+STATIC mp_irq_worker_t mp_irq_high_worker = { .lowest_priority = MP_IRQ_PRIORITY_HIGH };
+
+STATIC volatile bool mp_irq_is_alive;
 
 STATIC mpirq_args_t mpirq_args;
 
 /******************************************************************************
  DECLARE PRIVATE FUNCTIONS
  ******************************************************************************/
+static void *TASK_Interrupts(void *pvParameters);
+
+STATIC IRAM_ATTR mp_uint_t mp_irq_get_priority (void *parent) {
+    for (int i = 0; i < MP_IRQ_PRIORITY_TABLE_LEN; i++) {
+        if (mp_irq_prio_table[i].parent == parent) {
+            return mp_irq_prio_table[i].priority;
+        }
+    }
+    return MP_IRQ_PRIORITY_NORMAL;
+}
+
+STATIC void mp_irq_set_priority (void *parent, mp_int_t priority) {
+    mp_irq_prio_entry_t *free_entry = NULL;
+
+    portENTER_CRITICAL(&mp_irq_mux);
+    for (int i = 0; i < MP_IRQ_PRIORITY_TABLE_LEN; i++) {
+        if (mp_irq_prio_table[i].parent == parent) {
+            mp_irq_prio_table[i].parent = NULL;
+        }
+        if (!free_entry && mp_irq_prio_table[i].parent == NULL) {
+            free_entry = &mp_irq_prio_table[i];
+        }
+    }
+    // only the non default priorities need an entry
+    if (priority != MP_IRQ_PRIORITY_NORMAL && free_entry) {
+        free_entry->parent = parent;
+        free_entry->priority = priority;
+    }
+    portEXIT_CRITICAL(&mp_irq_mux);
+
+    if (priority != MP_IRQ_PRIORITY_NORMAL && !free_entry) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_OSError, "too many prioritized callbacks"));
+    }
+}
+
+// must be called with mp_irq_mux taken, returns false if the callback wasn't queued
+STATIC IRAM_ATTR bool mp_irq_queue_push (void (* handler)(void *), void *arg, mp_uint_t *priority) {
+    mp_uint_t prio = mp_irq_get_priority(arg);
+    mp_irq_queue_t *queue = &mp_irq_queues[prio];
+
+    *priority = prio;
+    // the same callback still waiting to be run handles this event too
+    for (uint32_t i = 0; i < queue->count; i++) {
+        mp_callback_obj_t *cb = &queue->items[(queue->head + i) % INTERRUPTS_QUEUE_LEN];
+        if (cb->handler == handler && cb->arg == arg) {
+            queue->coalesced++;
+            return false;
+        }
+    }
+    if (queue->count == INTERRUPTS_QUEUE_LEN) {
+        queue->dropped++;
+        return false;
+    }
+
+    mp_callback_obj_t *cb = &queue->items[(queue->head + queue->count) % INTERRUPTS_QUEUE_LEN];
+    cb->handler = handler;
+    cb->arg = arg;
+    cb->queued_us = (uint32_t)mp_hal_ticks_us_non_blocking();
+    queue->count++;
+    queue->queued++;
+    if (queue->count > queue->max_count) {
+        queue->max_count = queue->count;
+    }
+    return true;
+}
+
+STATIC bool mp_irq_queue_pop (mp_irq_worker_t *worker, mp_callback_obj_t *cb) {
+    bool found = false;
+
+    portENTER_CRITICAL(&mp_irq_mux);
+    for (int prio = MP_IRQ_PRIORITY_HIGH; prio >= worker->lowest_priority; prio--) {
+        mp_irq_queue_t *queue = &mp_irq_queues[prio];
+        if (queue->count > 0) {
+            *cb = queue->items[queue->head];
+            queue->head = (queue->head + 1) % INTERRUPTS_QUEUE_LEN;
+            queue->count--;
+
+            uint32_t latency = (uint32_t)mp_hal_ticks_us_non_blocking() - cb->queued_us;
+            queue->dispatched++;
+            queue->total_latency_us += latency;
+            if (latency > queue->max_latency_us) {
+                queue->max_latency_us = latency;
+            }
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&mp_irq_mux);
+
+    return found;
+}
+
+STATIC IRAM_ATTR SemaphoreHandle_t mp_irq_get_worker_sem (mp_uint_t priority) {
+    if (priority == MP_IRQ_PRIORITY_HIGH && mp_irq_high_worker.alive) {
+        return mp_irq_high_worker.pending;
+    }
+    return mp_irq_main_worker.pending;
+}
+
+STATIC void mp_irq_reset_queues (void) {
+    portENTER_CRITICAL(&mp_irq_mux);
+    memset(mp_irq_queues, 0, sizeof(mp_irq_queues));
+    memset(mp_irq_prio_table, 0, sizeof(mp_irq_prio_table));
+    portEXIT_CRITICAL(&mp_irq_mux);
+    xQueueReset(mp_irq_main_worker.pending);
+    xQueueReset(mp_irq_high_worker.pending);
+}
+
+STATIC void mp_irq_start_worker (mp_irq_worker_t *worker, int priority, char *name) {
+    uint32_t stack_size = INTERRUPTS_TASK_STACK_SIZE;
+
+    worker->alive = true;
+    mp_thread_create_ex(TASK_Interrupts, worker, &stack_size, priority, name);
+}
+
 static void *TASK_Interrupts(void *pvParameters) {
-    mpirq_args_t *args = (mpirq_args_t *)pvParameters;
+    mp_irq_worker_t *worker = (mp_irq_worker_t *)pvParameters;
 
     mp_callback_obj_t cb;
     mp_state_thread_t ts;
@@ -48,44 +200,61 @@ static void *TASK_Interrupts(void *pvParameters) {
 
     mp_stack_set_top(&ts + 1); // need to include ts in root-pointer scan
     mp_stack_set_limit(INTERRUPTS_TASK_STACK_SIZE - 1024);
+    #if MICROPY_TRACK_CODE_STATE
+    ts.current_code_state = NULL;
+    #endif
+    #if MICROPY_OPT_CODE_STATE_POOL
+    ts.code_state_pool_len = 0;
+    #endif
 
-    mp_locals_set(args->dict_locals);
-    mp_globals_set(args->dict_globals);
+    mp_locals_set(mpirq_args.dict_locals);
+    mp_globals_set(mpirq_args.dict_globals);
 
     MP_THREAD_GIL_ENTER();
     // signal that we are up and running
     mp_thread_start();
     MP_THREAD_GIL_EXIT();
-
-    for (;;) {
-        xQueueReceive(InterruptsQueue, &cb, portMAX_DELAY);
-
-        // a NULL handler means that we need to exit the loop
-        if (NULL == cb.handler) {
-            break;
-        }
-
-        MP_THREAD_GIL_ENTER();
-
-        nlr_buf_t nlr;
-        if (nlr_push(&nlr) == 0) {
-            cb.handler(cb.arg);
-            nlr_pop();
-        } else {
-            // uncaught exception, check for SystemExit
-            mp_obj_base_t *exc = (mp_obj_base_t*)nlr.ret_val;
-            if (mp_obj_is_subclass_fast(MP_OBJ_FROM_PTR(exc->type), MP_OBJ_FROM_PTR(&mp_type_SystemExit))) {
-                // swallow the exception silently
+    taskwdt_register(TASKWDT_IRQ_TIMEOUT_MS);
+
+    bool exit = false;
+    while (!exit) {
+        taskwdt_sleeping(true);
+        xSemaphoreTake(worker->pending, portMAX_DELAY);
+        taskwdt_sleeping(false);
+
+        // one signal might stand for several callbacks, go on until there's nothing left
+        while (mp_irq_is_alive && mp_irq_queue_pop(worker, &cb)) {
+            MP_THREAD_GIL_ENTER();
+            taskwdt_alive();
+
+            nlr_buf_t nlr;
+            if (nlr_push(&nlr) == 0) {
+                TRACE_BEGIN(TRACE_EV_IRQ, 0);
+                cb.handler(cb.arg);
+                TRACE_END(TRACE_EV_IRQ, 0);
+                nlr_pop();
             } else {
-                // print the exception out
-                mp_printf(&mp_plat_print, "Unhandled exception in callback handler\n");
-                mp_obj_print_exception(&mp_plat_print, MP_OBJ_FROM_PTR(exc));
-                // kill this thread
-                MP_THREAD_GIL_EXIT();
-                break;
+                TRACE_END(TRACE_EV_IRQ, 1);
+                // uncaught exception, check for SystemExit
+                mp_obj_base_t *exc = (mp_obj_base_t*)nlr.ret_val;
+                if (mp_obj_is_subclass_fast(MP_OBJ_FROM_PTR(exc->type), MP_OBJ_FROM_PTR(&mp_type_SystemExit))) {
+                    // swallow the exception silently
+                } else {
+                    // print the exception out
+                    mp_printf(&mp_plat_print, "Unhandled exception in callback handler\n");
+                    mp_obj_print_exception(&mp_plat_print, MP_OBJ_FROM_PTR(exc));
+                    // kill this thread
+                    MP_THREAD_GIL_EXIT();
+                    exit = true;
+                    break;
+                }
             }
+            MP_THREAD_GIL_EXIT();
+        }
+
+        if (!mp_irq_is_alive) {
+            break;
         }
-        MP_THREAD_GIL_EXIT();
     }
 
     MP_THREAD_GIL_ENTER();
@@ -93,7 +262,7 @@ static void *TASK_Interrupts(void *pvParameters) {
     mp_thread_finish();
     MP_THREAD_GIL_EXIT();
 
-    mp_irq_is_alive = false;
+    worker->alive = false;
 
     return NULL;
 }
@@ -102,31 +271,43 @@ static void *TASK_Interrupts(void *pvParameters) {
  DEFINE PUBLIC FUNCTIONS
  ******************************************************************************/
 void mp_irq_preinit(void) {
-    InterruptsQueue = xQueueCreate(INTERRUPTS_QUEUE_LEN, sizeof(mp_callback_obj_t));
+    // up to one signal per queued callback
+    mp_irq_main_worker.pending = xSemaphoreCreateCounting(INTERRUPTS_QUEUE_LEN * MP_IRQ_PRIORITY_COUNT, 0);
+    mp_irq_high_worker.pending = xSemaphoreCreateCounting(INTERRUPTS_QUEUE_LEN, 0);
 }
 
 void mp_irq_init0(void) {
-    uint32_t stack_size = INTERRUPTS_TASK_STACK_SIZE;
-
     // initialize the callback objects list
     mp_obj_list_init(&MP_STATE_PORT(mp_irq_obj_list), 0);
 
     mp_irq_is_alive = true;
-    xQueueReset(InterruptsQueue);
+    mp_irq_reset_queues();
 
     mpirq_args.dict_locals = mp_locals_get();
     mpirq_args.dict_globals = mp_globals_get();
 
-    mp_thread_create_ex(TASK_Interrupts, &mpirq_args, &stack_size, INTERRUPTS_TASK_PRIORITY, "IRQs");
+    mp_irq_start_worker(&mp_irq_main_worker, INTERRUPTS_TASK_PRIORITY, "IRQs");
 }
 
 void mp_irq_add (mp_obj_t parent, mp_obj_t handler) {
+    mp_irq_add_prio(parent, handler, MP_IRQ_PRIORITY_NORMAL);
+}
+
+void mp_irq_add_prio (mp_obj_t parent, mp_obj_t handler, mp_int_t priority) {
+    if (priority < MP_IRQ_PRIORITY_LOW || priority > MP_IRQ_PRIORITY_HIGH) {
+        nlr_raise(mp_obj_new_exception_msg(&mp_type_ValueError, mpexception_value_invalid_arguments));
+    }
     mp_obj_tuple_t *irq = mp_obj_new_tuple(2, NULL);
     irq->items[0] = parent;
     irq->items[1] = handler;
     // remove it in case it was already registered
     mp_irq_remove(parent);
+    mp_irq_set_priority(parent, priority);
     mp_obj_list_append(&MP_STATE_PORT(mp_irq_obj_list), irq);
+
+    if (priority == MP_IRQ_PRIORITY_HIGH && !mp_irq_high_worker.alive) {
+        mp_irq_start_worker(&mp_irq_high_worker, INTERRUPTS_HIGH_TASK_PRIORITY, "IRQs_High");
+    }
 }
 
 void mp_irq_remove (const mp_obj_t parent) {
@@ -134,6 +315,7 @@ void mp_irq_remove (const mp_obj_t parent) {
     if ((irq = mp_irq_find(parent))) {
         mp_obj_list_remove(&MP_STATE_PORT(mp_irq_obj_list), irq);
     }
+    mp_irq_set_priority(parent, MP_IRQ_PRIORITY_NORMAL);
 }
 
 mp_obj_tuple_t *mp_irq_find (mp_obj_t parent) {
@@ -147,11 +329,16 @@ mp_obj_tuple_t *mp_irq_find (mp_obj_t parent) {
 }
 
 void IRAM_ATTR mp_irq_queue_interrupt(void (* handler)(void *), void *arg) {
-    mp_callback_obj_t cb = {.handler = handler, .arg = arg};
-
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    mp_uint_t priority;
 
-    xQueueSendFromISR(InterruptsQueue, &cb, &xHigherPriorityTaskWoken);
+    portENTER_CRITICAL_ISR(&mp_irq_mux);
+    bool queued = mp_irq_queue_push(handler, arg, &priority);
+    portEXIT_CRITICAL_ISR(&mp_irq_mux);
+
+    if (queued) {
+        xSemaphoreGiveFromISR(mp_irq_get_worker_sem(priority), &xHigherPriorityTaskWoken);
+    }
 
     if( xHigherPriorityTaskWoken)
     {
@@ -160,32 +347,64 @@ void IRAM_ATTR mp_irq_queue_interrupt(void (* handler)(void *), void *arg) {
 }
 
 void mp_irq_queue_interrupt_non_ISR(void (* handler)(void *), void *arg) {
-    mp_callback_obj_t cb = {.handler = handler, .arg = arg};
-    (void)xQueueSend(InterruptsQueue, &cb, 0);
+    mp_uint_t priority;
+
+    portENTER_CRITICAL(&mp_irq_mux);
+    bool queued = mp_irq_queue_push(handler, arg, &priority);
+    portEXIT_CRITICAL(&mp_irq_mux);
+
+    if (queued) {
+        xSemaphoreGive(mp_irq_get_worker_sem(priority));
+    }
 }
 
 void IRAM_ATTR mp_irq_queue_interrupt_immediate_thread_delete(TaskHandle_t id) {
 
     // Check if IRQ task is not being shutdown
     if(mp_irq_is_alive == true){
-        mp_callback_obj_t cb = {.handler = vTaskDelete, .arg = id};
-        (void)xQueueSend(InterruptsQueue, &cb, 0);
+        mp_irq_queue_interrupt_non_ISR(vTaskDelete, id);
     }
 }
 
 void mp_irq_kill(void) {
-    // sending a NULL handler will kill the interrupt task
-    mp_irq_queue_interrupt(NULL, NULL);
+    // wake up the workers, they exit as soon as they see we are not alive anymore
+    mp_irq_is_alive = false;
+    xSemaphoreGive(mp_irq_main_worker.pending);
+    xSemaphoreGive(mp_irq_high_worker.pending);
     // release the GIL if we have it
     MP_THREAD_GIL_EXIT();
     do {
         // it needs to be this one in order to not mess with the GIL
         vTaskDelay(3 / portTICK_PERIOD_MS);
-    } while (mp_irq_is_alive);
-    xQueueReset(InterruptsQueue);
+    } while (mp_irq_main_worker.alive || mp_irq_high_worker.alive);
+    mp_irq_reset_queues();
     // TODO disable all interrupts here at hardware level
 }
 
+/// Returns a tuple with, per priority level from LOW to HIGH, the tuple
+/// (pending, max_pending, queued, coalesced, dropped, dispatched, max_latency_us, avg_latency_us)
+mp_obj_t mp_irq_stats(void) {
+    mp_obj_t prio_stats[MP_IRQ_PRIORITY_COUNT];
+
+    for (int prio = 0; prio < MP_IRQ_PRIORITY_COUNT; prio++) {
+        portENTER_CRITICAL(&mp_irq_mux);
+        mp_irq_queue_t queue = mp_irq_queues[prio];
+        portEXIT_CRITICAL(&mp_irq_mux);
+
+        mp_obj_t tuple[8];
+        tuple[0] = mp_obj_new_int_from_uint(queue.count);
+        tuple[1] = mp_obj_new_int_from_uint(queue.max_count);
+        tuple[2] = mp_obj_new_int_from_uint(queue.queued);
+        tuple[3] = mp_obj_new_int_from_uint(queue.coalesced);
+        tuple[4] = mp_obj_new_int_from_uint(queue.dropped);
+        tuple[5] = mp_obj_new_int_from_uint(queue.dispatched);
+        tuple[6] = mp_obj_new_int_from_uint(queue.max_latency_us);
+        tuple[7] = mp_obj_new_int_from_uint(queue.dispatched ? (queue.total_latency_us / queue.dispatched) : 0);
+        prio_stats[prio] = mp_obj_new_tuple(MP_ARRAY_SIZE(tuple), tuple);
+    }
+    return mp_obj_new_tuple(MP_ARRAY_SIZE(prio_stats), prio_stats);
+}
+
 #else
 
 void IRAM_ATTR mp_irq_queue_interrupt(void (* handler)(void *), void *arg) {
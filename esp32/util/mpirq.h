@@ -16,11 +16,21 @@
  DEFINE CONSTANTS
  ******************************************************************************/
 #define INTERRUPTS_TASK_PRIORITY                   11
+// the worker dedicated to high priority callbacks pre-empts the main one at the GIL
+#define INTERRUPTS_HIGH_TASK_PRIORITY              12
 #define INTERRUPTS_TASK_STACK_SIZE                 (8 * 1024)
 #define INTERRUPTS_TASK_STACK_LEN                  (INTERRUPTS_TASK_STACK_SIZE / sizeof(StackType_t))
 
 #define INTERRUPTS_QUEUE_LEN                       (32)
 
+#define MP_IRQ_PRIORITY_LOW                        (0)
+#define MP_IRQ_PRIORITY_NORMAL                     (1)
+#define MP_IRQ_PRIORITY_HIGH                       (2)
+#define MP_IRQ_PRIORITY_COUNT                      (3)
+
+// number of callbacks that can be registered with a non default priority
+#define MP_IRQ_PRIORITY_TABLE_LEN                  (16)
+
 #define INTERRUPT_OBJ_CLEAN(obj)                   {\
                                                        (obj)->handler = NULL; \
                                                        (obj)->handler_arg = NULL; \
@@ -32,6 +42,7 @@
 typedef struct {
     void (* handler)(void *);
     void *arg;
+    uint32_t queued_us;
 } mp_callback_obj_t;
 
 /******************************************************************************
@@ -46,10 +57,12 @@ extern const mp_obj_type_t mp_irq_type;
 void mp_irq_preinit(void);
 void mp_irq_init0 (void);
 void mp_irq_add (mp_obj_t parent, mp_obj_t handler);
+void mp_irq_add_prio (mp_obj_t parent, mp_obj_t handler, mp_int_t priority);
 void mp_irq_remove (mp_obj_t parent);
 mp_obj_tuple_t *mp_irq_find (mp_obj_t parent);
 void mp_irq_queue_interrupt(void (* handler)(void *), void *arg);
 void mp_irq_queue_interrupt_non_ISR(void (* handler)(void *), void *arg);
 void mp_irq_queue_interrupt_immediate_thread_delete(TaskHandle_t id);
 void mp_irq_kill(void);
+mp_obj_t mp_irq_stats(void);
 #endif /* MPIRQ_H_ */
@@ -18,21 +18,35 @@
 #include "rom/rtc.h"
 #include "esp_system.h"
 #include "esp_sleep.h"
+#include "esp_attr.h"
+#include "esp_clk.h"
+#include "soc/rtc.h"
+#include "soc/rtc_cntl_reg.h"
 #include "mpsleep.h"
 
 /******************************************************************************
  DECLARE PRIVATE CONSTANTS
  ******************************************************************************/
+#define MPSLEEP_STUB_MAGIC              (0x53545542)    // "STUB"
 
 /******************************************************************************
  DEFINE PRIVATE TYPES
  ******************************************************************************/
+// read by the wake stub, before anything but the RTC memory is up
+typedef struct {
+    uint32_t magic;
+    uint32_t boot_every;                // timer wakes per full boot
+    uint32_t wakes;                     // timer wakes since the last full boot
+    uint32_t skipped;                   // handled by the stub alone before this boot
+    uint64_t period_ticks;              // of the RTC slow clock
+} mpsleep_stub_t;
 
 /******************************************************************************
  DECLARE PRIVATE DATA
  ******************************************************************************/
 STATIC mpsleep_reset_cause_t mpsleep_reset_cause = MPSLEEP_PWRON_RESET;
 STATIC mpsleep_wake_reason_t mpsleep_wake_reason = MPSLEEP_PWRON_WAKE;
+static RTC_DATA_ATTR mpsleep_stub_t mpsleep_stub;
 
 /******************************************************************************
  DECLARE PRIVATE FUNCTIONS
@@ -72,6 +86,12 @@ void mpsleep_init0 (void) {
         case ESP_SLEEP_WAKEUP_TIMER:
             mpsleep_wake_reason = MPSLEEP_RTC_WAKE;
             break;
+        case ESP_SLEEP_WAKEUP_ULP:
+            mpsleep_wake_reason = MPSLEEP_ULP_WAKE;
+            break;
+        case ESP_SLEEP_WAKEUP_TOUCHPAD:
+            mpsleep_wake_reason = MPSLEEP_TOUCH_WAKE;
+            break;
         case ESP_SLEEP_WAKEUP_UNDEFINED:
         default:
             mpsleep_wake_reason = MPSLEEP_PWRON_WAKE;
@@ -91,6 +111,62 @@ mpsleep_wake_reason_t mpsleep_get_wake_reason (void) {
     return mpsleep_wake_reason;
 }
 
+void mpsleep_stub_config (uint32_t boot_every) {
+    mpsleep_stub.magic = MPSLEEP_STUB_MAGIC;
+    mpsleep_stub.boot_every = MAX(boot_every, 1);
+    mpsleep_stub.wakes = 0;
+}
+
+// called right before a timed deep sleep, the stub puts the chip back to sleep for
+// the same period on all but every boot_every-th timer wake
+void mpsleep_stub_arm (uint64_t sleep_us) {
+    if (mpsleep_stub.magic != MPSLEEP_STUB_MAGIC) {
+        mpsleep_stub_config(1);
+    }
+    // the stub can't call into flash for the 64 bit division
+    mpsleep_stub.period_ticks = rtc_time_us_to_slowclk(sleep_us, esp_clk_slowclk_cal_get());
+    mpsleep_stub.wakes = 0;
+}
+
+uint32_t mpsleep_stub_get_boot_every (void) {
+    return (mpsleep_stub.magic == MPSLEEP_STUB_MAGIC) ? mpsleep_stub.boot_every : 1;
+}
+
+uint32_t mpsleep_stub_get_skipped (void) {
+    return (mpsleep_stub.magic == MPSLEEP_STUB_MAGIC) ? mpsleep_stub.skipped : 0;
+}
+
+// Replaces the weak one of the IDF. It runs from RTC fast memory straight after a
+// deep sleep wake, in a few hundred us, and decides whether the boot goes on. GPIO,
+// touch and ULP wakes always boot, the sensor on the other end has asked for it.
+RTC_IRAM_ATTR void esp_wake_deep_sleep (void) {
+    esp_default_wake_deep_sleep();
+
+    if (mpsleep_stub.magic != MPSLEEP_STUB_MAGIC || mpsleep_stub.period_ticks == 0 ||
+        REG_GET_FIELD(RTC_CNTL_WAKEUP_STATE_REG, RTC_CNTL_WAKEUP_CAUSE) != RTC_TIMER_TRIG_EN) {
+        return;
+    }
+    if (++mpsleep_stub.wakes >= mpsleep_stub.boot_every) {
+        mpsleep_stub.skipped = mpsleep_stub.wakes - 1;
+        mpsleep_stub.wakes = 0;
+        return;
+    }
+
+    // the next alarm is one period from now
+    SET_PERI_REG_MASK(RTC_CNTL_TIME_UPDATE_REG, RTC_CNTL_TIME_UPDATE);
+    while (GET_PERI_REG_MASK(RTC_CNTL_TIME_UPDATE_REG, RTC_CNTL_TIME_VALID) == 0);
+    uint64_t alarm = READ_PERI_REG(RTC_CNTL_TIME0_REG) | ((uint64_t)READ_PERI_REG(RTC_CNTL_TIME1_REG) << 32);
+    alarm += mpsleep_stub.period_ticks;
+    WRITE_PERI_REG(RTC_CNTL_SLP_TIMER0_REG, (uint32_t)alarm);
+    WRITE_PERI_REG(RTC_CNTL_SLP_TIMER1_REG, ((uint32_t)(alarm >> 32) & RTC_CNTL_SLP_VAL_HI) | RTC_CNTL_MAIN_TIMER_ALARM_EN);
+
+    // back to sleep, with the stub as the entry point again
+    REG_WRITE(RTC_ENTRY_ADDR_REG, (uint32_t)&esp_wake_deep_sleep);
+    CLEAR_PERI_REG_MASK(RTC_CNTL_STATE0_REG, RTC_CNTL_SLEEP_EN);
+    SET_PERI_REG_MASK(RTC_CNTL_STATE0_REG, RTC_CNTL_SLEEP_EN);
+    while (true);
+}
+
 /******************************************************************************
  DEFINE PRIVATE FUNCTIONS
  ******************************************************************************/
@@ -31,13 +31,18 @@ typedef enum {
     MPSLEEP_PWRON_WAKE = 0,
     MPSLEEP_GPIO_WAKE,
     MPSLEEP_RTC_WAKE,
-    MPSLEEP_ULP_WAKE
+    MPSLEEP_ULP_WAKE,
+    MPSLEEP_TOUCH_WAKE
 } mpsleep_wake_reason_t;
 
 /******************************************************************************
  DECLARE FUNCTIONS
  ******************************************************************************/
 void mpsleep_init0 (void);
+void mpsleep_stub_config (uint32_t boot_every);
+void mpsleep_stub_arm (uint64_t sleep_us);
+uint32_t mpsleep_stub_get_boot_every (void);
+uint32_t mpsleep_stub_get_skipped (void);
 void mpsleep_signal_soft_reset (void);
 mpsleep_reset_cause_t mpsleep_get_reset_cause (void);
 mpsleep_wake_reason_t mpsleep_get_wake_reason (void);
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/mpthread.h"
+#include "py/mphal.h"
+#include "py/stream.h"
+#include "extmod/moduselect.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "lwip/sockets.h"
+
+#include "modnetwork.h"
+#include "modusocket.h"
+#include "machuart.h"
+#include "pollwait.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define POLLWAIT_WAKE_BIT                       (1 << 0)
+// longest single wait, so that pending exceptions and callbacks are not held off
+#define POLLWAIT_SLICE_MS                       (100)
+// shorter slice for lwip_select() when drivers that can't wake it are also polled
+#define POLLWAIT_MIXED_SLICE_MS                 (10)
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+static EventGroupHandle_t pollwait_events = NULL;
+
+/******************************************************************************
+ DEFINE PUBLIC FUNCTIONS
+ ******************************************************************************/
+void pollwait_notify (void) {
+    if (pollwait_events != NULL) {
+        xEventGroupSetBits(pollwait_events, POLLWAIT_WAKE_BIT);
+    }
+}
+
+void IRAM_ATTR pollwait_notify_from_isr (void) {
+    // skip the round trip through the timer task when nobody has consumed the last one
+    if (pollwait_events != NULL && !(xEventGroupGetBitsFromISR(pollwait_events) & POLLWAIT_WAKE_BIT)) {
+        BaseType_t woken = pdFALSE;
+        if (xEventGroupSetBitsFromISR(pollwait_events, POLLWAIT_WAKE_BIT, &woken) == pdPASS && woken == pdTRUE) {
+            portYIELD_FROM_ISR();
+        }
+    }
+}
+
+// called by uselect when none of the polled objects is ready yet
+void mp_uselect_port_wait (const mp_map_t *poll_map, mp_uint_t timeout) {
+    fd_set rfds, wfds, xfds;
+    int maxfd = -1;
+    bool notifiers = false;
+
+    if (pollwait_events == NULL) {
+        pollwait_events = xEventGroupCreate();
+        if (pollwait_events == NULL) {
+            mp_hal_delay_ms(1);
+            return;
+        }
+    }
+
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    FD_ZERO(&xfds);
+    for (mp_uint_t i = 0; i < poll_map->alloc; ++i) {
+        if (!mp_map_slot_is_filled(poll_map, i)) {
+            continue;
+        }
+        poll_obj_t *poll_obj = MP_OBJ_TO_PTR(poll_map->table[i].value);
+        const mp_obj_type_t *type = mp_obj_get_type(poll_obj->obj);
+        if (type == &socket_type) {
+            mod_network_socket_obj_t *s = MP_OBJ_TO_PTR(poll_obj->obj);
+            if (s->sock_base.nic_type == &mod_network_nic_type_lora) {
+                // LoRa and mesh sockets signal us when a packet is queued
+                notifiers = true;
+                continue;
+            }
+            if ((s->sock_base.nic_type == &mod_network_nic_type_wlan || s->sock_base.nic_type == &mod_network_nic_type_lte)
+                && s->sock_base.u.sd >= 0) {
+                int sd = s->sock_base.u.sd;
+                if (poll_obj->flags & MP_STREAM_POLL_RD) {
+                    FD_SET(sd, &rfds);
+                }
+                if (poll_obj->flags & MP_STREAM_POLL_WR) {
+                    FD_SET(sd, &wfds);
+                }
+                FD_SET(sd, &xfds);
+                if (sd > maxfd) {
+                    maxfd = sd;
+                }
+                continue;
+            }
+        } else if (type == &mach_uart_type) {
+            notifiers = true;
+            continue;
+        }
+        // something that can't wake us (eg Sigfox, SSL or a user stream), keep polling it
+        mp_hal_delay_ms(1);
+        return;
+    }
+
+    mp_uint_t slice = (maxfd >= 0 && notifiers) ? POLLWAIT_MIXED_SLICE_MS : POLLWAIT_SLICE_MS;
+    if (timeout < slice) {
+        slice = timeout;
+    }
+
+    MP_THREAD_GIL_EXIT();
+    if (maxfd >= 0) {
+        struct timeval tv = { .tv_sec = 0, .tv_usec = slice * 1000 };
+        lwip_select(maxfd + 1, &rfds, &wfds, &xfds, &tv);
+        xEventGroupClearBits(pollwait_events, POLLWAIT_WAKE_BIT);
+    } else {
+        xEventGroupWaitBits(pollwait_events, POLLWAIT_WAKE_BIT, pdTRUE, pdFALSE, slice / portTICK_PERIOD_MS);
+    }
+    MP_THREAD_GIL_ENTER();
+}
@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#ifndef POLLWAIT_H_
+#define POLLWAIT_H_
+
+/******************************************************************************
+ DECLARE FUNCTIONS
+ ******************************************************************************/
+// wake up a uselect.poll()/select() call that is blocked waiting for a driver
+extern void pollwait_notify (void);
+extern void pollwait_notify_from_isr (void);
+
+#endif  // POLLWAIT_H_
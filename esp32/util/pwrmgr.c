@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "py/mpconfig.h"
+
+#include "sdkconfig.h"
+#include "esp_pm.h"
+#include "freertos/FreeRTOS.h"
+#include "pwrmgr.h"
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+STATIC const char *pwrmgr_holder_names[PWRMGR_NUM_HOLDERS] = {
+    [PWRMGR_LORA]   = "lora",
+    [PWRMGR_LTE]    = "lte",
+    [PWRMGR_CAN]    = "can",
+    [PWRMGR_SPI]    = "spi",
+};
+
+STATIC esp_pm_lock_handle_t pwrmgr_locks[PWRMGR_NUM_HOLDERS];
+STATIC uint32_t pwrmgr_holders;
+STATIC bool pwrmgr_enabled;
+// the drivers report from their own tasks
+static portMUX_TYPE pwrmgr_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/******************************************************************************
+ DEFINE PUBLIC FUNCTIONS
+ ******************************************************************************/
+void pwrmgr_preinit (void) {
+    for (int i = 0; i < PWRMGR_NUM_HOLDERS; i++) {
+        // fails with ESP_ERR_NOT_SUPPORTED on IDF builds without power management,
+        // a NULL lock turns the holds into no-ops
+        if (esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, pwrmgr_holder_names[i], &pwrmgr_locks[i]) != ESP_OK) {
+            pwrmgr_locks[i] = NULL;
+        }
+    }
+}
+
+// While enabled the idle task of the scheduler, which only runs once every Python
+// thread is blocked, lowers the clock down to min_freq_mhz and, with light_sleep,
+// sleeps until the next timer or interrupt. Wi-Fi and Bluetooth hold off the light
+// sleep themselves unless their modem sleep (WLAN power_save) is on.
+esp_err_t pwrmgr_configure (bool enable, uint32_t min_freq_mhz, bool light_sleep) {
+    uint32_t max_freq_mhz = CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ;
+    esp_pm_config_esp32_t config = {
+        .max_freq_mhz = max_freq_mhz,
+        .min_freq_mhz = enable ? min_freq_mhz : max_freq_mhz,
+        .light_sleep_enable = enable && light_sleep,
+    };
+    esp_err_t err = esp_pm_configure(&config);
+    if (err == ESP_OK) {
+        pwrmgr_enabled = enable;
+    }
+    return err;
+}
+
+bool pwrmgr_is_enabled (void) {
+    return pwrmgr_enabled;
+}
+
+void pwrmgr_hold (pwrmgr_holder_t holder, bool hold) {
+    uint32_t mask = 1 << holder;
+    bool changed;
+    portENTER_CRITICAL(&pwrmgr_mux);
+    changed = hold != ((pwrmgr_holders & mask) != 0);
+    if (hold) {
+        pwrmgr_holders |= mask;
+    } else {
+        pwrmgr_holders &= ~mask;
+    }
+    portEXIT_CRITICAL(&pwrmgr_mux);
+
+    // the driver state changes far less often than it is reported
+    if (changed && pwrmgr_locks[holder]) {
+        if (hold) {
+            esp_pm_lock_acquire(pwrmgr_locks[holder]);
+        } else {
+            esp_pm_lock_release(pwrmgr_locks[holder]);
+        }
+    }
+}
+
+uint32_t pwrmgr_get_holders (void) {
+    return pwrmgr_holders;
+}
+
+const char *pwrmgr_holder_name (pwrmgr_holder_t holder) {
+    return pwrmgr_holder_names[holder];
+}
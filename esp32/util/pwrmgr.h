@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#ifndef PWRMGR_H_
+#define PWRMGR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+// peripherals that need the APB clock at 80 MHz and the chip awake while active
+typedef enum {
+    PWRMGR_LORA = 0,
+    PWRMGR_LTE,
+    PWRMGR_CAN,
+    PWRMGR_SPI,
+    PWRMGR_NUM_HOLDERS
+} pwrmgr_holder_t;
+
+/******************************************************************************
+ DECLARE FUNCTIONS
+ ******************************************************************************/
+void pwrmgr_preinit (void);
+esp_err_t pwrmgr_configure (bool enable, uint32_t min_freq_mhz, bool light_sleep);
+bool pwrmgr_is_enabled (void);
+void pwrmgr_hold (pwrmgr_holder_t holder, bool hold);
+uint32_t pwrmgr_get_holders (void);
+const char *pwrmgr_holder_name (pwrmgr_holder_t holder);
+
+#endif /* PWRMGR_H_ */
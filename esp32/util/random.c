@@ -8,36 +8,76 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 
 #include "py/obj.h"
 #include "random.h"
 #include "esp_system.h"
 #include "machrtc.h"
 
+#include "freertos/FreeRTOS.h"
+
+/******************************************************************************
+* LOCAL CONSTANTS
+******************************************************************************/
+#define RNG_CHACHA_ROUNDS                   (20)
+#define RNG_CHACHA_BLOCK_WORDS              (16)
+#define RNG_KEY_WORDS                       (8)
+
 /******************************************************************************
 * LOCAL TYPES
 ******************************************************************************/
 typedef union _rng_id_t {
-    uint32_t       id32;
-    uint16_t       id16[3];
-    uint8_t        id8[6];
+    uint32_t       id32[2];
+    uint8_t        id8[8];
 } rng_id_t;
 
 /******************************************************************************
 * LOCAL VARIABLES
 ******************************************************************************/
-static uint32_t s_seed;
+// the key of the ChaCha20 generator, replaced after every use so that what has
+// been handed out can't be recovered from it
+static uint32_t s_key[RNG_KEY_WORDS];
+static uint32_t s_mix_idx;
+static portMUX_TYPE s_rng_mux = portMUX_INITIALIZER_UNLOCKED;
 
 /******************************************************************************
 * LOCAL FUNCTION DECLARATIONS
 ******************************************************************************/
-STATIC uint32_t lfsr (uint32_t input);
+STATIC void rng_chacha_block (const uint32_t *key, uint32_t counter, uint32_t *out);
 
 /******************************************************************************
 * PRIVATE FUNCTIONS
 ******************************************************************************/
-STATIC uint32_t lfsr (uint32_t input) {
-    return (input >> 1) ^ (-(input & 0x01) & 0x00E10000);
+#define RNG_ROTL(v, n)                      (((v) << (n)) | ((v) >> (32 - (n))))
+#define RNG_QUARTER_ROUND(a, b, c, d) \
+    a += b; d ^= a; d = RNG_ROTL(d, 16); \
+    c += d; b ^= c; b = RNG_ROTL(b, 12); \
+    a += b; d ^= a; d = RNG_ROTL(d, 8);  \
+    c += d; b ^= c; b = RNG_ROTL(b, 7)
+
+// RFC 7539 block function, with a zero nonce since every key is used only once
+STATIC void rng_chacha_block (const uint32_t *key, uint32_t counter, uint32_t *out) {
+    uint32_t x[RNG_CHACHA_BLOCK_WORDS] = {
+        0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,     // "expand 32-byte k"
+        key[0], key[1], key[2], key[3], key[4], key[5], key[6], key[7],
+        counter, 0, 0, 0
+    };
+    uint32_t in[RNG_CHACHA_BLOCK_WORDS];
+    memcpy(in, x, sizeof(in));
+    for (int i = 0; i < RNG_CHACHA_ROUNDS; i += 2) {
+        RNG_QUARTER_ROUND(x[0], x[4], x[8],  x[12]);
+        RNG_QUARTER_ROUND(x[1], x[5], x[9],  x[13]);
+        RNG_QUARTER_ROUND(x[2], x[6], x[10], x[14]);
+        RNG_QUARTER_ROUND(x[3], x[7], x[11], x[15]);
+        RNG_QUARTER_ROUND(x[0], x[5], x[10], x[15]);
+        RNG_QUARTER_ROUND(x[1], x[6], x[11], x[12]);
+        RNG_QUARTER_ROUND(x[2], x[7], x[8],  x[13]);
+        RNG_QUARTER_ROUND(x[3], x[4], x[9],  x[14]);
+    }
+    for (int i = 0; i < RNG_CHACHA_BLOCK_WORDS; i++) {
+        out[i] = x[i] + in[i];
+    }
 }
 
 /******************************************************************************/
@@ -52,27 +92,70 @@ MP_DEFINE_CONST_FUN_OBJ_0(machine_rng_get_obj, machine_rng_get);
 * PUBLIC FUNCTIONS
 ******************************************************************************/
 void rng_init0 (void) {
-    rng_id_t juggler;
+    uint32_t seed[RNG_KEY_WORDS];
+    rng_fill_hw(seed, sizeof(seed));
 
+    // the RNG only gets true entropy once the radio runs, so the board identity and
+    // the time go in as well to tell apart devices booting with it off
+    rng_id_t juggler = { .id32 = { 0, 0 } };
     esp_efuse_mac_get_default(juggler.id8);
+    uint64_t us = mach_rtc_get_us_since_epoch();
 
-    // flatten the 48-bit board identification to 24 bits
-    juggler.id16[0] ^= juggler.id16[2];
+    portENTER_CRITICAL(&s_rng_mux);
+    for (int i = 0; i < RNG_KEY_WORDS; i++) {
+        s_key[i] ^= seed[i];
+    }
+    s_key[0] ^= juggler.id32[0];
+    s_key[1] ^= juggler.id32[1];
+    s_key[2] ^= (uint32_t)us;
+    s_key[3] ^= (uint32_t)(us >> 32);
+    portEXIT_CRITICAL(&s_rng_mux);
+    memset(seed, 0, sizeof(seed));
+}
+
+// straight from the hardware, each word costs a register read paced by the RNG
+void rng_fill_hw (void *buf, size_t len) {
+    uint8_t *p = buf;
+    for ( ; len >= sizeof(uint32_t); p += sizeof(uint32_t), len -= sizeof(uint32_t)) {
+        uint32_t word = esp_random();
+        memcpy(p, &word, sizeof(word));
+    }
+    if (len > 0) {
+        uint32_t word = esp_random();
+        memcpy(p, &word, len);
+    }
+}
 
-    juggler.id8[0]  ^= juggler.id8[3];
-    juggler.id8[1]  ^= juggler.id8[4];
-    juggler.id8[2]  ^= juggler.id8[5];
+// from the ChaCha20 generator, which takes a fresh hardware word on every call
+void rng_fill (void *buf, size_t len) {
+    uint32_t block[RNG_CHACHA_BLOCK_WORDS];
+    uint32_t hw = esp_random();
 
-    s_seed = juggler.id32 & 0x00FFFFFF;
-    s_seed += (uint32_t)mach_rtc_get_us_since_epoch();
+    // half of the block becomes the next key and the other half the key of this call,
+    // so that the lock is only held for a single block
+    portENTER_CRITICAL(&s_rng_mux);
+    s_key[s_mix_idx++ % RNG_KEY_WORDS] ^= hw;
+    rng_chacha_block(s_key, 0, block);
+    memcpy(s_key, block, sizeof(s_key));
+    portEXIT_CRITICAL(&s_rng_mux);
 
-    // the seed must never be zero
-    if (s_seed == 0) {
-        s_seed = 1;
+    uint32_t *key = &block[RNG_KEY_WORDS];
+    uint32_t out[RNG_CHACHA_BLOCK_WORDS];
+    uint8_t *p = buf;
+    for (uint32_t counter = 0; len > 0; counter++) {
+        rng_chacha_block(key, counter, out);
+        size_t n = MIN(len, sizeof(out));
+        memcpy(p, out, n);
+        p += n;
+        len -= n;
     }
+    memset(block, 0, sizeof(block));
+    memset(out, 0, sizeof(out));
 }
 
 uint32_t rng_get (void) {
-    s_seed = lfsr(s_seed);
-    return s_seed;
+    uint32_t value;
+    rng_fill(&value, sizeof(value));
+    // machine.rng() has always been 24-bit
+    return value & 0x00FFFFFF;
 }
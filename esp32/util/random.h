@@ -10,7 +10,11 @@
 #ifndef __RANDOM_H
 #define __RANDOM_H
 
+#include <stddef.h>
+
 void rng_init0 (void);
+void rng_fill_hw (void *buf, size_t len);
+void rng_fill (void *buf, size_t len);
 uint32_t rng_get (void);
 
 MP_DECLARE_CONST_FUN_OBJ_0(machine_rng_get_obj);
@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "rom/crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "tracering.h"
+#include "taskwdt.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define TASKWDT_TASKS_MAX                   (16)
+#define TASKWDT_CHECK_PERIOD_MS             (500)
+#define TASKWDT_REPORT_EVENTS               (8)
+#define TASKWDT_REPORT_MAGIC                (0x57445452)    // "WDTR"
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+typedef struct {
+    TaskHandle_t task;
+    uint32_t timeout_ms;
+    volatile uint32_t alive_ms;
+    volatile bool sleeping;
+    char name[configMAX_TASK_NAME_LEN];
+} taskwdt_entry_t;
+
+typedef struct {
+    uint32_t magic;
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t timeout_ms;
+    uint32_t overdue_ms;
+    uint32_t stack_free;
+    uint32_t hw;                        // the hardware watchdog went off, not a task deadline
+    uint32_t n_events;
+    trace_brief_t events[TASKWDT_REPORT_EVENTS];
+    uint32_t crc;
+} taskwdt_report_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+STATIC taskwdt_entry_t taskwdt_entries[TASKWDT_TASKS_MAX];
+STATIC portMUX_TYPE taskwdt_mux = portMUX_INITIALIZER_UNLOCKED;
+STATIC esp_timer_handle_t taskwdt_timer;
+
+// survives the reset that follows, and is moved out of the way at the next boot
+static RTC_NOINIT_ATTR taskwdt_report_t taskwdt_rtc_report;
+STATIC taskwdt_report_t taskwdt_last_report;
+STATIC bool taskwdt_has_report;
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+STATIC uint32_t taskwdt_now_ms (void) {
+    return esp_timer_get_time() / 1000;
+}
+
+STATIC uint32_t taskwdt_report_crc (const taskwdt_report_t *report) {
+    return crc32_le(UINT32_MAX, (const uint8_t *)report, sizeof(taskwdt_report_t) - sizeof(report->crc));
+}
+
+// the caller holds the lock
+STATIC taskwdt_entry_t *taskwdt_find (TaskHandle_t task) {
+    for (int i = 0; i < TASKWDT_TASKS_MAX; i++) {
+        if (taskwdt_entries[i].task == task) {
+            return &taskwdt_entries[i];
+        }
+    }
+    return NULL;
+}
+
+STATIC void taskwdt_save_report (const taskwdt_entry_t *entry, uint32_t overdue_ms, bool hw) {
+    taskwdt_report_t *report = &taskwdt_rtc_report;
+    memset(report, 0, sizeof(*report));
+    report->magic = TASKWDT_REPORT_MAGIC;
+    if (entry != NULL) {
+        memcpy(report->name, entry->name, sizeof(report->name));
+        report->timeout_ms = entry->timeout_ms;
+        report->stack_free = uxTaskGetStackHighWaterMark(entry->task);
+    }
+    report->overdue_ms = overdue_ms;
+    report->hw = hw;
+    report->n_events = trace_last_events(report->events, TASKWDT_REPORT_EVENTS);
+    report->crc = taskwdt_report_crc(report);
+}
+
+// the entry most overdue among the awake ones, NULL if none is
+STATIC taskwdt_entry_t *taskwdt_most_overdue (uint32_t now, uint32_t *overdue_ms) {
+    taskwdt_entry_t *worst = NULL;
+    *overdue_ms = 0;
+    for (int i = 0; i < TASKWDT_TASKS_MAX; i++) {
+        taskwdt_entry_t *entry = &taskwdt_entries[i];
+        if (entry->task == NULL || entry->sleeping) {
+            continue;
+        }
+        uint32_t elapsed = now - entry->alive_ms;
+        if (elapsed > entry->timeout_ms && elapsed - entry->timeout_ms >= *overdue_ms) {
+            *overdue_ms = elapsed - entry->timeout_ms;
+            worst = entry;
+        }
+    }
+    return worst;
+}
+
+// runs in the esp_timer task
+STATIC void taskwdt_check (void *arg) {
+    uint32_t overdue_ms;
+    taskwdt_entry_t *entry = taskwdt_most_overdue(taskwdt_now_ms(), &overdue_ms);
+    if (entry != NULL) {
+        taskwdt_save_report(entry, overdue_ms, false);
+        esp_restart();
+    }
+}
+
+/******************************************************************************
+ DEFINE PUBLIC FUNCTIONS
+ ******************************************************************************/
+void taskwdt_init0 (void) {
+    // the RTC memory holds garbage after a power on, hence the checks
+    if (taskwdt_rtc_report.magic == TASKWDT_REPORT_MAGIC && taskwdt_rtc_report.crc == taskwdt_report_crc(&taskwdt_rtc_report)) {
+        memcpy(&taskwdt_last_report, &taskwdt_rtc_report, sizeof(taskwdt_last_report));
+        taskwdt_has_report = true;
+    }
+    taskwdt_rtc_report.magic = 0;
+}
+
+void taskwdt_register (uint32_t timeout_ms) {
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    portENTER_CRITICAL(&taskwdt_mux);
+    taskwdt_entry_t *entry = taskwdt_find(task);
+    if (entry == NULL) {
+        entry = taskwdt_find(NULL);
+    }
+    if (entry != NULL) {
+        entry->timeout_ms = timeout_ms;
+        entry->alive_ms = taskwdt_now_ms();
+        entry->sleeping = false;
+        strncpy(entry->name, pcTaskGetTaskName(task), sizeof(entry->name) - 1);
+        entry->name[sizeof(entry->name) - 1] = '\0';
+        entry->task = task;
+    }
+    portEXIT_CRITICAL(&taskwdt_mux);
+}
+
+// called when a task is deleted
+void taskwdt_forget (void *task) {
+    portENTER_CRITICAL(&taskwdt_mux);
+    taskwdt_entry_t *entry = taskwdt_find(task);
+    if (entry != NULL) {
+        entry->task = NULL;
+    }
+    portEXIT_CRITICAL(&taskwdt_mux);
+}
+
+void taskwdt_alive (void) {
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < TASKWDT_TASKS_MAX; i++) {
+        if (taskwdt_entries[i].task == task) {
+            taskwdt_entries[i].alive_ms = taskwdt_now_ms();
+            return;
+        }
+    }
+}
+
+// around the waits for work that may last forever
+void taskwdt_sleeping (bool sleeping) {
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < TASKWDT_TASKS_MAX; i++) {
+        if (taskwdt_entries[i].task == task) {
+            taskwdt_entries[i].alive_ms = taskwdt_now_ms();
+            taskwdt_entries[i].sleeping = sleeping;
+            return;
+        }
+    }
+}
+
+// the deadlines are only enforced once the application has started the watchdog
+void taskwdt_start (void) {
+    if (taskwdt_timer == NULL) {
+        esp_timer_create_args_t timer_args = { .callback = taskwdt_check, .arg = NULL,
+                                               .dispatch_method = ESP_TIMER_TASK, .name = "taskwdt" };
+        if (esp_timer_create(&timer_args, &taskwdt_timer) != ESP_OK) {
+            return;
+        }
+        // what was done until now doesn't count
+        uint32_t now = taskwdt_now_ms();
+        for (int i = 0; i < TASKWDT_TASKS_MAX; i++) {
+            taskwdt_entries[i].alive_ms = now;
+        }
+        esp_timer_start_periodic(taskwdt_timer, TASKWDT_CHECK_PERIOD_MS * 1000);
+    }
+}
+
+// from the interrupt of the first stage of the hardware watchdog, just before the
+// reset; with no task late it is the application that stopped feeding
+void taskwdt_hw_expired (void) {
+    uint32_t overdue_ms;
+    taskwdt_entry_t *entry = taskwdt_most_overdue(taskwdt_now_ms(), &overdue_ms);
+    taskwdt_save_report(entry, overdue_ms, true);
+}
+
+mp_obj_t taskwdt_get_tasks (void) {
+    taskwdt_entry_t copy[TASKWDT_TASKS_MAX];
+    portENTER_CRITICAL(&taskwdt_mux);
+    memcpy(copy, taskwdt_entries, sizeof(copy));
+    portEXIT_CRITICAL(&taskwdt_mux);
+
+    uint32_t now = taskwdt_now_ms();
+    mp_obj_t list = mp_obj_new_list(0, NULL);
+    for (int i = 0; i < TASKWDT_TASKS_MAX; i++) {
+        taskwdt_entry_t *entry = &copy[i];
+        if (entry->task == NULL) {
+            continue;
+        }
+        mp_obj_t tuple[5] = {
+            mp_obj_new_str(entry->name, strlen(entry->name)),
+            mp_obj_new_int_from_uint(entry->timeout_ms),
+            mp_obj_new_int_from_uint(now - entry->alive_ms),
+            mp_obj_new_int_from_uint(uxTaskGetStackHighWaterMark(entry->task)),
+            mp_obj_new_bool(entry->sleeping),
+        };
+        mp_obj_list_append(list, mp_obj_new_tuple(5, tuple));
+    }
+    return list;
+}
+
+// (task, timeout_ms, overdue_ms, stack_free, hw, [(event, phase, arg, age_us), ...]) or None
+mp_obj_t taskwdt_get_report (void) {
+    if (!taskwdt_has_report) {
+        return mp_const_none;
+    }
+    taskwdt_report_t *report = &taskwdt_last_report;
+    mp_obj_t events = mp_obj_new_list(0, NULL);
+    for (uint32_t i = 0; i < MIN(report->n_events, TASKWDT_REPORT_EVENTS); i++) {
+        trace_brief_t *ev = &report->events[i];
+        const char *name = trace_event_name(ev->id);
+        mp_obj_t tuple[4] = {
+            mp_obj_new_str(name, strlen(name)),
+            mp_obj_new_str(&ev->phase, 1),
+            mp_obj_new_int_from_uint(ev->arg),
+            mp_obj_new_int_from_uint(ev->age_us),
+        };
+        mp_obj_list_append(events, mp_obj_new_tuple(4, tuple));
+    }
+    report->name[sizeof(report->name) - 1] = '\0';
+    mp_obj_t tuple[6] = {
+        report->name[0] ? mp_obj_new_str(report->name, strlen(report->name)) : mp_const_none,
+        mp_obj_new_int_from_uint(report->timeout_ms),
+        mp_obj_new_int_from_uint(report->overdue_ms),
+        mp_obj_new_int_from_uint(report->stack_free),
+        mp_obj_new_bool(report->hw),
+        events,
+    };
+    return mp_obj_new_tuple(6, tuple);
+}
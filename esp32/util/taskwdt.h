@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#ifndef TASKWDT_H_
+#define TASKWDT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "py/obj.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+// how long each task may go without checking in while it isn't sleeping
+#define TASKWDT_SERVERS_TIMEOUT_MS          (10000)
+#define TASKWDT_LORA_TIMEOUT_MS             (10000)
+#define TASKWDT_LTE_TIMEOUT_MS              (120000)
+#define TASKWDT_IRQ_TIMEOUT_MS              (30000)
+
+/******************************************************************************
+ DECLARE FUNCTIONS
+ ******************************************************************************/
+void taskwdt_init0 (void);
+void taskwdt_register (uint32_t timeout_ms);
+void taskwdt_forget (void *task);
+void taskwdt_alive (void);
+void taskwdt_sleeping (bool sleeping);
+void taskwdt_start (void);
+void taskwdt_hw_expired (void);
+mp_obj_t taskwdt_get_tasks (void);
+mp_obj_t taskwdt_get_report (void);
+
+#endif /* TASKWDT_H_ */
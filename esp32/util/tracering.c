@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "py/mpconfig.h"
+#include "py/obj.h"
+#include "py/runtime.h"
+#include "py/mpprint.h"
+#include "py/mperrno.h"
+
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_ipc.h"
+#include "rom/ets_sys.h"
+#include "xtensa/hal.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "tracering.h"
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+#define TRACE_NUM_CORES                 (portNUM_PROCESSORS)
+#define TRACE_EVENTS_MAX                (16384)     // per core
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+typedef struct {
+    uint32_t ccount;                    // cycle counter of the core that recorded it
+    uint16_t wraps;                     // of ccount since the start, it wraps every ~18 s
+    uint8_t id;
+    char phase;
+    uint32_t arg;
+    TaskHandle_t task;
+} trace_event_t;
+
+// only ever written by its own core, with that core's interrupts masked
+typedef struct {
+    trace_event_t *events;
+    uint32_t head;                      // events recorded, the oldest are overwritten
+    uint32_t last;                      // ccount of the latest event
+    uint16_t wraps;
+    // where the cycle counter of this core stood at the start
+    uint32_t base_ccount;
+    int64_t base_us;
+} trace_ring_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+STATIC const char *trace_event_names[TRACE_NUM_EVENTS] = {
+    [TRACE_EV_GIL]          = "gil",
+    [TRACE_EV_GC]           = "gc",
+    [TRACE_EV_IRQ]          = "irq",
+    [TRACE_EV_LORA_TX_DONE] = "lora_tx_done",
+    [TRACE_EV_LORA_RX_DONE] = "lora_rx_done",
+    [TRACE_EV_LORA_TIMEOUT] = "lora_timeout",
+    [TRACE_EV_PPP_RX]       = "ppp_rx",
+    [TRACE_EV_PPP_TX]       = "ppp_tx",
+    [TRACE_EV_SOCK_SEND]    = "sock_send",
+    [TRACE_EV_SOCK_RECV]    = "sock_recv",
+    [TRACE_EV_FLASH_ERASE]  = "flash_erase",
+    [TRACE_EV_USER]         = "user",
+};
+
+STATIC trace_ring_t trace_rings[TRACE_NUM_CORES];
+STATIC uint32_t trace_mask;             // ring size - 1, the size is a power of 2
+STATIC uint32_t trace_cpu_mhz;
+
+/******************************************************************************
+ DEFINE PUBLIC DATA
+ ******************************************************************************/
+volatile bool trace_enabled = false;
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+// runs on the core whose counter is sampled, the esp_timer is common to both
+STATIC void trace_sync_core (void *arg) {
+    trace_ring_t *ring = &trace_rings[xPortGetCoreID()];
+    uint32_t state = portENTER_CRITICAL_NESTED();
+    ring->base_us = esp_timer_get_time();
+    ring->base_ccount = xthal_get_ccount();
+    portEXIT_CRITICAL_NESTED(state);
+    ring->last = ring->base_ccount;
+    ring->wraps = 0;
+    ring->head = 0;
+}
+
+STATIC void trace_free (void) {
+    for (int i = 0; i < TRACE_NUM_CORES; i++) {
+        free(trace_rings[i].events);
+        trace_rings[i].events = NULL;
+    }
+}
+
+/******************************************************************************
+ DEFINE PUBLIC FUNCTIONS
+ ******************************************************************************/
+// IRAM, the radio hooks run from an interrupt
+IRAM_ATTR void trace_record (trace_event_id_t id, char phase, uint32_t arg) {
+    uint32_t state = portENTER_CRITICAL_NESTED();
+    trace_ring_t *ring = &trace_rings[xPortGetCoreID()];
+    uint32_t now = xthal_get_ccount();
+    if (now < ring->last) {
+        ring->wraps++;
+    }
+    ring->last = now;
+    trace_event_t *ev = &ring->events[ring->head++ & trace_mask];
+    ev->ccount = now;
+    ev->wraps = ring->wraps;
+    ev->id = id;
+    ev->phase = phase;
+    ev->arg = arg;
+    ev->task = xTaskGetCurrentTaskHandle();
+    portEXIT_CRITICAL_NESTED(state);
+}
+
+void trace_start (uint32_t events) {
+    trace_stop();
+    trace_free();
+
+    uint32_t size = 1;
+    while (size < events && size < TRACE_EVENTS_MAX) {
+        size <<= 1;
+    }
+    // internal RAM, the hooks may run while the PSRAM cache is busy
+    for (int i = 0; i < TRACE_NUM_CORES; i++) {
+        trace_rings[i].events = heap_caps_malloc(size * sizeof(trace_event_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (trace_rings[i].events == NULL) {
+            trace_free();
+            mp_raise_OSError(MP_ENOMEM);
+        }
+    }
+    trace_mask = size - 1;
+    trace_cpu_mhz = ets_get_cpu_frequency();
+
+    trace_sync_core(NULL);
+    #if TRACE_NUM_CORES > 1
+    esp_ipc_call_blocking(!xPortGetCoreID(), trace_sync_core, NULL);
+    #endif
+    trace_enabled = true;
+}
+
+void trace_stop (void) {
+    trace_enabled = false;
+    // let a hook that has just seen the flag finish its event
+    vTaskDelay(1);
+}
+
+// the latest events of both cores, newest first; safe to call while tracing, from
+// an interrupt too, the events being recorded meanwhile may come out garbled
+uint32_t trace_last_events (trace_brief_t *out, uint32_t max) {
+    if (!trace_enabled) {
+        return 0;
+    }
+    uint64_t now_ns = (uint64_t)esp_timer_get_time() * 1000;
+    uint32_t found = 0;
+    for (int core = 0; core < TRACE_NUM_CORES; core++) {
+        trace_ring_t *ring = &trace_rings[core];
+        if (ring->events == NULL) {
+            continue;
+        }
+        uint32_t head = ring->head;
+        uint32_t count = MIN(MIN(head, trace_mask + 1), max);
+        for (uint32_t n = head - count; n != head; n++) {
+            trace_event_t *ev = &ring->events[n & trace_mask];
+            uint64_t cycles = (((uint64_t)ev->wraps << 32) | ev->ccount) - ring->base_ccount;
+            uint64_t ns = (uint64_t)ring->base_us * 1000 + cycles * 1000 / trace_cpu_mhz;
+            uint32_t age_us = (ns < now_ns) ? (now_ns - ns) / 1000 : 0;
+            // insert it by age, dropping the oldest once full
+            uint32_t pos = found;
+            while (pos > 0 && out[pos - 1].age_us > age_us) {
+                pos--;
+            }
+            if (pos >= max) {
+                continue;
+            }
+            uint32_t last = (found < max) ? found : max - 1;
+            memmove(&out[pos + 1], &out[pos], (last - pos) * sizeof(trace_brief_t));
+            out[pos].age_us = age_us;
+            out[pos].arg = ev->arg;
+            out[pos].id = ev->id;
+            out[pos].phase = ev->phase;
+            if (found < max) {
+                found++;
+            }
+        }
+    }
+    return found;
+}
+
+const char *trace_event_name (uint8_t id) {
+    return (id < TRACE_NUM_EVENTS) ? trace_event_names[id] : "?";
+}
+
+// Chrome trace event format, loads in chrome://tracing and ui.perfetto.dev. The
+// pid is the core, the tid is the task handle as _thread.stack_info() shows it
+void trace_dump (const mp_print_t *print) {
+    bool was_enabled = trace_enabled;
+    if (was_enabled) {
+        trace_stop();
+    }
+
+    mp_printf(print, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (int core = 0; core < TRACE_NUM_CORES; core++) {
+        trace_ring_t *ring = &trace_rings[core];
+        if (ring->events == NULL) {
+            continue;
+        }
+        uint32_t count = MIN(ring->head, trace_mask + 1);
+        for (uint32_t n = ring->head - count; n != ring->head; n++) {
+            trace_event_t *ev = &ring->events[n & trace_mask];
+            uint64_t cycles = (((uint64_t)ev->wraps << 32) | ev->ccount) - ring->base_ccount;
+            uint64_t ns = (uint64_t)ring->base_us * 1000 + cycles * 1000 / trace_cpu_mhz;
+            const char *name = (ev->id < TRACE_NUM_EVENTS) ? trace_event_names[ev->id] : "?";
+            if (ev->phase == 'X') {
+                // recorded at the end
+                ns -= (uint64_t)ev->arg * 1000;
+                mp_printf(print, "%s{\"name\":\"%s\",\"ph\":\"X\",\"dur\":%u", first ? "" : ",\n", name, ev->arg);
+            } else {
+                mp_printf(print, "%s{\"name\":\"%s\",\"ph\":\"%c\"", first ? "" : ",\n", name, ev->phase);
+                if (ev->phase == 'i') {
+                    mp_printf(print, ",\"s\":\"t\"");
+                }
+            }
+            mp_printf(print, ",\"ts\":%u.%03u,\"pid\":%d,\"tid\":%u,\"args\":{\"arg\":%u}}",
+                      (uint32_t)(ns / 1000), (uint32_t)(ns % 1000), core, (uint32_t)ev->task, ev->arg);
+            first = false;
+        }
+        if (ring->head > count) {
+            mp_printf(print, "%s{\"name\":\"overwritten\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"events\":%u}}",
+                      first ? "" : ",\n", core, ring->head - count);
+            first = false;
+        }
+    }
+    mp_printf(print, "\n]}\n");
+
+    if (was_enabled) {
+        trace_enabled = true;
+    }
+}
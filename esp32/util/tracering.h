@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#ifndef TRACERING_H_
+#define TRACERING_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "py/mpprint.h"
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+typedef enum {
+    TRACE_EV_GIL = 0,                   // span the GIL is held for
+    TRACE_EV_GC,
+    TRACE_EV_IRQ,                       // a Python callback run by the interrupt task
+    TRACE_EV_LORA_TX_DONE,
+    TRACE_EV_LORA_RX_DONE,
+    TRACE_EV_LORA_TIMEOUT,              // arg is 0 for TX, 1 for RX
+    TRACE_EV_PPP_RX,                    // arg is the frame length
+    TRACE_EV_PPP_TX,
+    TRACE_EV_SOCK_SEND,                 // arg of the end is the length moved
+    TRACE_EV_SOCK_RECV,
+    TRACE_EV_FLASH_ERASE,               // complete event, arg is the duration in us
+    TRACE_EV_USER,                      // from pycom.trace_event()
+    TRACE_NUM_EVENTS
+} trace_event_id_t;
+
+// an event as it is kept in a crash report
+typedef struct {
+    uint32_t age_us;                    // before the report was made
+    uint32_t arg;
+    uint8_t id;
+    char phase;
+} trace_brief_t;
+
+/******************************************************************************
+ DECLARE PUBLIC DATA
+ ******************************************************************************/
+extern volatile bool trace_enabled;
+
+/******************************************************************************
+ DEFINE MACROS
+ ******************************************************************************/
+// all that is left of a hook while tracing is off is the flag check
+#define TRACE_BEGIN(id, arg)            do { if (trace_enabled) { trace_record((id), 'B', (arg)); } } while (0)
+#define TRACE_END(id, arg)              do { if (trace_enabled) { trace_record((id), 'E', (arg)); } } while (0)
+#define TRACE_INSTANT(id, arg)          do { if (trace_enabled) { trace_record((id), 'i', (arg)); } } while (0)
+#define TRACE_COMPLETE(id, dur_us)      do { if (trace_enabled) { trace_record((id), 'X', (dur_us)); } } while (0)
+
+/******************************************************************************
+ DECLARE FUNCTIONS
+ ******************************************************************************/
+void trace_record (trace_event_id_t id, char phase, uint32_t arg);
+void trace_start (uint32_t events);
+void trace_stop (void);
+void trace_dump (const mp_print_t *print);
+uint32_t trace_last_events (trace_brief_t *out, uint32_t max);
+const char *trace_event_name (uint8_t id);
+
+#endif /* TRACERING_H_ */
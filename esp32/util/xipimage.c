@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#include <string.h>
+
+#include "py/mpconfig.h"
+#include "py/runtime.h"
+#include "py/mperrno.h"
+#include "py/mphal.h"
+#include "py/persistentcode.h"
+
+#include "esp_spi_flash.h"
+#include "esp_flash_encrypt.h"
+
+#include "esp32chipinfo.h"
+#include "xipimage.h"
+
+#if MICROPY_MODULE_FROZEN_XIP
+
+/******************************************************************************
+ DEFINE CONSTANTS
+ ******************************************************************************/
+// encrypted flash can only be written in blocks of 16 bytes
+#define XIPIMAGE_BLOCK_SIZE                 (16)
+
+/******************************************************************************
+ DEFINE TYPES
+ ******************************************************************************/
+typedef struct {
+    uint32_t start;
+    uint32_t addr;      // where the next block goes
+    uint32_t end;
+    uint32_t buf_len;
+    uint8_t buf[XIPIMAGE_BLOCK_SIZE];
+    uint8_t head[XIPIMAGE_BLOCK_SIZE];  // written last, so the image only becomes valid once complete
+} xipimage_writer_t;
+
+/******************************************************************************
+ DECLARE PRIVATE DATA
+ ******************************************************************************/
+// the mapping is made once and kept across soft resets
+static const uint8_t *xipimage_mapped;
+static spi_flash_mmap_handle_t xipimage_mmap_handle;
+
+/******************************************************************************
+ DEFINE PRIVATE FUNCTIONS
+ ******************************************************************************/
+static void xipimage_region(uint32_t *addr, uint32_t *size) {
+    if (esp32_get_chip_rev() > 0) {
+        *addr = MICROPY_PORT_XIP_START_ADDR_8MB;
+        *size = MICROPY_PORT_XIP_SIZE_8MB;
+    } else {
+        *addr = MICROPY_PORT_XIP_START_ADDR_4MB;
+        *size = MICROPY_PORT_XIP_SIZE_4MB;
+    }
+}
+
+static void xipimage_flash_write(uint32_t addr, const uint8_t *data) {
+    esp_err_t err;
+    if (esp_flash_encryption_enabled()) {
+        // the region is read through the cache, which decrypts everything
+        err = spi_flash_write_encrypted(addr, data, XIPIMAGE_BLOCK_SIZE);
+    } else {
+        err = spi_flash_write(addr, data, XIPIMAGE_BLOCK_SIZE);
+    }
+    if (err != ESP_OK) {
+        mp_raise_OSError(MP_EIO);
+    }
+}
+
+static void xipimage_print_strn(void *env, const char *str, size_t len) {
+    xipimage_writer_t *w = env;
+    while (len > 0) {
+        size_t n = MIN(len, XIPIMAGE_BLOCK_SIZE - w->buf_len);
+        memcpy(w->buf + w->buf_len, str, n);
+        w->buf_len += n;
+        str += n;
+        len -= n;
+        if (w->buf_len == XIPIMAGE_BLOCK_SIZE) {
+            if (w->addr >= w->end) {
+                mp_raise_OSError(MP_ENOSPC);
+            }
+            if (w->addr == w->start) {
+                memcpy(w->head, w->buf, XIPIMAGE_BLOCK_SIZE);
+            } else {
+                xipimage_flash_write(w->addr, w->buf);
+            }
+            w->addr += XIPIMAGE_BLOCK_SIZE;
+            w->buf_len = 0;
+        }
+    }
+}
+
+/******************************************************************************
+ DEFINE PUBLIC FUNCTIONS
+ ******************************************************************************/
+const uint8_t *mp_hal_xip_image(size_t *max_len) {
+    uint32_t addr, size;
+    xipimage_region(&addr, &size);
+    if (size == 0) {
+        return NULL;
+    }
+    if (xipimage_mapped == NULL) {
+        // mappings start on an MMU page
+        uint32_t page = addr & ~(SPI_FLASH_MMU_PAGE_SIZE - 1);
+        const void *ptr;
+        if (spi_flash_mmap(page, size + (addr - page), SPI_FLASH_MMAP_DATA, &ptr, &xipimage_mmap_handle) != ESP_OK) {
+            return NULL;
+        }
+        xipimage_mapped = (const uint8_t *)ptr + (addr - page);
+    }
+    *max_len = size;
+    return xipimage_mapped;
+}
+
+void xipimage_build(mp_obj_t modules) {
+    uint32_t addr, size;
+    xipimage_region(&addr, &size);
+    if (size == 0) {
+        mp_raise_OSError(MP_ENODEV);
+    }
+    if (mp_raw_code_xip_names() != NULL) {
+        // the current image may still be running, see xipimage_invalidate
+        mp_raise_OSError(MP_EBUSY);
+    }
+    if (spi_flash_erase_range(addr, size) != ESP_OK) {
+        mp_raise_OSError(MP_EIO);
+    }
+    xipimage_writer_t w = { .start = addr, .addr = addr, .end = addr + size, .buf_len = 0 };
+    mp_print_t print = { &w, xipimage_print_strn };
+    mp_raw_code_save_xip(modules, &print);
+
+    // pad out the last block, then make the image valid
+    if (w.buf_len > 0) {
+        static const char padding[XIPIMAGE_BLOCK_SIZE] = { [0 ... XIPIMAGE_BLOCK_SIZE - 1] = 0xff };
+        xipimage_print_strn(&w, padding, XIPIMAGE_BLOCK_SIZE - w.buf_len);
+    }
+    xipimage_flash_write(w.start, w.head);
+}
+
+void xipimage_invalidate(void) {
+    uint32_t addr, size;
+    xipimage_region(&addr, &size);
+    if (size == 0) {
+        return;
+    }
+    // clearing bits needs no erase, so anything imported from the image keeps
+    // running until the next reset
+    static const uint8_t zeros[XIPIMAGE_BLOCK_SIZE] = {0};
+    if (spi_flash_write(addr, zeros, sizeof(zeros)) != ESP_OK) {
+        mp_raise_OSError(MP_EIO);
+    }
+}
+
+#endif // MICROPY_MODULE_FROZEN_XIP
@@ -0,0 +1,18 @@
+/*
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * This software is licensed under the GNU GPL version 3 or any
+ * later version, with permitted additional terms. For more information
+ * see the Pycom Licence v1.0 document supplied with this file, or
+ * available at https://www.pycom.io/opensource/licensing
+ */
+
+#ifndef ESP32_UTIL_XIPIMAGE_H_
+#define ESP32_UTIL_XIPIMAGE_H_
+
+#include "py/obj.h"
+
+extern void xipimage_build(mp_obj_t modules);
+extern void xipimage_invalidate(void);
+
+#endif /* ESP32_UTIL_XIPIMAGE_H_ */
@@ -50,6 +50,8 @@ typedef struct _mp_obj_btree_t {
     #define FLAG_ITER_ITEMS  0xc0
     byte flags;
     byte next_flags;
+    mp_uint_t autosync;
+    mp_uint_t changes;      // since the last sync
 } mp_obj_btree_t;
 
 STATIC const mp_obj_type_t btree_type;
@@ -63,16 +65,27 @@ void __dbpanic(DB *db) {
     printf("__dbpanic(%p)\n", db);
 }
 
-STATIC mp_obj_btree_t *btree_new(DB *db) {
+STATIC mp_obj_btree_t *btree_new(DB *db, mp_uint_t autosync) {
     mp_obj_btree_t *o = m_new_obj(mp_obj_btree_t);
     o->base.type = &btree_type;
     o->db = db;
     o->start_key = mp_const_none;
     o->end_key = mp_const_none;
     o->next_flags = 0;
+    o->autosync = autosync;
+    o->changes = 0;
     return o;
 }
 
+// the dirty pages are written out and the stream synced once every autosync
+// changes, rather than on each of them or not until close()
+STATIC void btree_changed(mp_obj_btree_t *self) {
+    if (self->autosync != 0 && ++self->changes >= self->autosync) {
+        self->changes = 0;
+        CHECK_ERROR(__bt_sync(self->db, 0));
+    }
+}
+
 STATIC void btree_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
     (void)kind;
     mp_obj_btree_t *self = MP_OBJ_TO_PTR(self_in);
@@ -81,6 +94,7 @@ STATIC void btree_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind
 
 STATIC mp_obj_t btree_flush(mp_obj_t self_in) {
     mp_obj_btree_t *self = MP_OBJ_TO_PTR(self_in);
+    self->changes = 0;
     return MP_OBJ_NEW_SMALL_INT(__bt_sync(self->db, 0));
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_1(btree_flush_obj, btree_flush);
@@ -97,7 +111,11 @@ STATIC mp_obj_t btree_put(size_t n_args, const mp_obj_t *args) {
     DBT key, val;
     key.data = (void*)mp_obj_str_get_data(args[1], &key.size);
     val.data = (void*)mp_obj_str_get_data(args[2], &val.size);
-    return MP_OBJ_NEW_SMALL_INT(__bt_put(self->db, &key, &val, 0));
+    int res = __bt_put(self->db, &key, &val, 0);
+    if (res == RET_SUCCESS) {
+        btree_changed(self);
+    }
+    return MP_OBJ_NEW_SMALL_INT(res);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(btree_put_obj, 3, 4, btree_put);
 
@@ -257,6 +275,7 @@ STATIC mp_obj_t btree_subscr(mp_obj_t self_in, mp_obj_t index, mp_obj_t value) {
             nlr_raise(mp_obj_new_exception(&mp_type_KeyError));
         }
         CHECK_ERROR(res);
+        btree_changed(self);
         return mp_const_none;
     } else if (value == MP_OBJ_SENTINEL) {
         // load
@@ -275,6 +294,7 @@ STATIC mp_obj_t btree_subscr(mp_obj_t self_in, mp_obj_t index, mp_obj_t value) {
         val.data = (void*)mp_obj_str_get_data(value, &val.size);
         int res = __bt_put(self->db, &key, &val, 0);
         CHECK_ERROR(res);
+        btree_changed(self);
         return mp_const_none;
     }
 }
@@ -333,6 +353,7 @@ STATIC mp_obj_t mod_btree_open(size_t n_args, const mp_obj_t *pos_args, mp_map_t
         { MP_QSTR_cachesize, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0} },
         { MP_QSTR_pagesize, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0} },
         { MP_QSTR_minkeypage, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = 0} },
+        { MP_QSTR_autosync, MP_ARG_KW_ONLY | MP_ARG_INT, {.u_int = MICROPY_PY_BTREE_AUTOSYNC} },
     };
 
     // Make sure we got a stream object
@@ -343,12 +364,16 @@ STATIC mp_obj_t mod_btree_open(size_t n_args, const mp_obj_t *pos_args, mp_map_t
         mp_arg_val_t cachesize;
         mp_arg_val_t pagesize;
         mp_arg_val_t minkeypage;
+        mp_arg_val_t autosync;
     } args;
     mp_arg_parse_all(n_args - 1, pos_args + 1, kw_args,
         MP_ARRAY_SIZE(allowed_args), allowed_args, (mp_arg_val_t*)&args);
     BTREEINFO openinfo = {0};
     openinfo.flags = args.flags.u_int;
     openinfo.cachesize = args.cachesize.u_int;
+    if (openinfo.cachesize == 0) {
+        openinfo.cachesize = MICROPY_PY_BTREE_DEFAULT_CACHESIZE;
+    }
     openinfo.psize = args.pagesize.u_int;
     openinfo.minkeypage = args.minkeypage.u_int;
 
@@ -356,7 +381,7 @@ STATIC mp_obj_t mod_btree_open(size_t n_args, const mp_obj_t *pos_args, mp_map_t
     if (db == NULL) {
         mp_raise_OSError(errno);
     }
-    return MP_OBJ_FROM_PTR(btree_new(db));
+    return MP_OBJ_FROM_PTR(btree_new(db, MAX(args.autosync.u_int, 0)));
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_btree_open_obj, 1, mod_btree_open);
 
@@ -38,6 +38,8 @@ typedef struct _mp_obj_framebuf_t {
     mp_obj_t buf_obj; // need to store this to prevent GC from reclaiming buf
     void *buf;
     uint16_t width, height, stride;
+    // area drawn since the last show(), empty when dirty_x0 >= dirty_x1
+    uint16_t dirty_x0, dirty_y0, dirty_x1, dirty_y1;
     uint8_t format;
 } mp_obj_framebuf_t;
 
@@ -75,16 +77,19 @@ STATIC uint32_t mono_horiz_getpixel(const mp_obj_framebuf_t *fb, int x, int y) {
 }
 
 STATIC void mono_horiz_fill_rect(const mp_obj_framebuf_t *fb, int x, int y, int w, int h, uint32_t col) {
-    int reverse = fb->format == FRAMEBUF_MHMSB;
-    int advance = fb->stride >> 3;
-    while (w--) {
-        uint8_t *b = &((uint8_t*)fb->buf)[(x >> 3) + y * advance];
-        int offset = reverse ?  x & 7 : 7 - (x & 7);
-        for (int hh = h; hh; --hh) {
-            *b = (*b & ~(0x01 << offset)) | ((col != 0) << offset);
-            b += advance;
+    uint8_t fill = col ? 0xff : 0x00;
+    for (int yend = y + h; y < yend; ++y) {
+        // the pixels up to the first byte boundary, whole bytes, then the rest
+        int xx = x;
+        int xend = x + w;
+        for (; xx < xend && (xx & 7); ++xx) {
+            mono_horiz_setpixel(fb, xx, y, col);
+        }
+        int nbytes = (xend - xx) >> 3;
+        memset(&((uint8_t*)fb->buf)[(xx + y * fb->stride) >> 3], fill, nbytes);
+        for (xx += nbytes << 3; xx < xend; ++xx) {
+            mono_horiz_setpixel(fb, xx, y, col);
         }
-        ++x;
     }
 }
 
@@ -101,14 +106,22 @@ STATIC uint32_t mvlsb_getpixel(const mp_obj_framebuf_t *fb, int x, int y) {
 }
 
 STATIC void mvlsb_fill_rect(const mp_obj_framebuf_t *fb, int x, int y, int w, int h, uint32_t col) {
-    while (h--) {
+    // a byte holds 8 rows of a column, so go over the rows a page of 8 at a time
+    for (int yend = y + h; y < yend; y = (y & ~7) + 8) {
         uint8_t *b = &((uint8_t*)fb->buf)[(y >> 3) * fb->stride + x];
-        uint8_t offset = y & 0x07;
-        for (int ww = w; ww; --ww) {
-            *b = (*b & ~(0x01 << offset)) | ((col != 0) << offset);
-            ++b;
+        int nrows = MIN(yend, (y & ~7) + 8) - y;
+        uint8_t mask = ((1 << nrows) - 1) << (y & 7);
+        if (mask == 0xff) {
+            memset(b, col ? 0xff : 0x00, w);
+        } else if (col) {
+            for (int ww = w; ww; --ww) {
+                *b++ |= mask;
+            }
+        } else {
+            for (int ww = w; ww; --ww) {
+                *b++ &= ~mask;
+            }
         }
-        ++y;
     }
 }
 
@@ -123,12 +136,13 @@ STATIC uint32_t rgb565_getpixel(const mp_obj_framebuf_t *fb, int x, int y) {
 }
 
 STATIC void rgb565_fill_rect(const mp_obj_framebuf_t *fb, int x, int y, int w, int h, uint32_t col) {
-    uint16_t *b = &((uint16_t*)fb->buf)[x + y * fb->stride];
-    while (h--) {
-        for (int ww = w; ww; --ww) {
-            *b++ = col;
-        }
-        b += fb->stride - w;
+    uint16_t *row = &((uint16_t*)fb->buf)[x + y * fb->stride];
+    for (int ww = 0; ww < w; ++ww) {
+        row[ww] = col;
+    }
+    // the other rows are copies of the first one
+    for (uint16_t *b = row + fb->stride; --h > 0; b += fb->stride) {
+        memcpy(b, row, w * sizeof(uint16_t));
     }
 }
 
@@ -244,7 +258,29 @@ static inline uint32_t getpixel(const mp_obj_framebuf_t *fb, int x, int y) {
     return formats[fb->format].getpixel(fb, x, y);
 }
 
-STATIC void fill_rect(const mp_obj_framebuf_t *fb, int x, int y, int w, int h, uint32_t col) {
+// grows the dirty rectangle to cover the given area, clipped to the framebuffer
+STATIC void mark_dirty(mp_obj_framebuf_t *fb, int x, int y, int w, int h) {
+    int xend = MIN(fb->width, x + w);
+    int yend = MIN(fb->height, y + h);
+    x = MAX(x, 0);
+    y = MAX(y, 0);
+    if (x >= xend || y >= yend) {
+        return;
+    }
+    if (fb->dirty_x0 >= fb->dirty_x1) {
+        fb->dirty_x0 = x;
+        fb->dirty_y0 = y;
+        fb->dirty_x1 = xend;
+        fb->dirty_y1 = yend;
+    } else {
+        fb->dirty_x0 = MIN(fb->dirty_x0, x);
+        fb->dirty_y0 = MIN(fb->dirty_y0, y);
+        fb->dirty_x1 = MAX(fb->dirty_x1, xend);
+        fb->dirty_y1 = MAX(fb->dirty_y1, yend);
+    }
+}
+
+STATIC void fill_rect(mp_obj_framebuf_t *fb, int x, int y, int w, int h, uint32_t col) {
     if (h < 1 || w < 1 || x + w <= 0 || y + h <= 0 || y >= fb->height || x >= fb->width) {
         // No operation needed.
         return;
@@ -257,6 +293,7 @@ STATIC void fill_rect(const mp_obj_framebuf_t *fb, int x, int y, int w, int h, u
     y = MAX(y, 0);
 
     formats[fb->format].fill_rect(fb, x, y, xend - x, yend - y, col);
+    mark_dirty(fb, x, y, xend - x, yend - y);
 }
 
 STATIC mp_obj_t framebuf_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
@@ -299,6 +336,9 @@ STATIC mp_obj_t framebuf_make_new(const mp_obj_type_t *type, size_t n_args, size
             mp_raise_ValueError("invalid format");
     }
 
+    // nothing says the display shows what's in the buffer yet
+    mark_dirty(o, 0, 0, o->width, o->height);
+
     return MP_OBJ_FROM_PTR(o);
 }
 
@@ -315,6 +355,7 @@ STATIC mp_obj_t framebuf_fill(mp_obj_t self_in, mp_obj_t col_in) {
     mp_obj_framebuf_t *self = MP_OBJ_TO_PTR(self_in);
     mp_int_t col = mp_obj_get_int(col_in);
     formats[self->format].fill_rect(self, 0, 0, self->width, self->height, col);
+    mark_dirty(self, 0, 0, self->width, self->height);
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_2(framebuf_fill_obj, framebuf_fill);
@@ -346,6 +387,7 @@ STATIC mp_obj_t framebuf_pixel(size_t n_args, const mp_obj_t *args) {
         } else {
             // set
             setpixel(self, x, y, mp_obj_get_int(args[3]));
+            mark_dirty(self, x, y, 1, 1);
         }
     }
     return mp_const_none;
@@ -411,6 +453,8 @@ STATIC mp_obj_t framebuf_line(size_t n_args, const mp_obj_t *args) {
     mp_int_t y2 = mp_obj_get_int(args[4]);
     mp_int_t col = mp_obj_get_int(args[5]);
 
+    mark_dirty(self, MIN(x1, x2), MIN(y1, y2), MAX(x1, x2) - MIN(x1, x2) + 1, MAX(y1, y2) - MIN(y1, y2) + 1);
+
     mp_int_t dx = x2 - x1;
     mp_int_t sx;
     if (dx > 0) {
@@ -467,6 +511,75 @@ STATIC mp_obj_t framebuf_line(size_t n_args, const mp_obj_t *args) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(framebuf_line_obj, 6, 6, framebuf_line);
 
+// Copies a w x h area between framebuffers of the same format, a row or a page
+// at a time instead of going through getpixel() and setpixel() for each pixel.
+// Returns false when the formats or the alignment don't allow it.
+STATIC bool blit_same_format(mp_obj_framebuf_t *dst, const mp_obj_framebuf_t *src, int x0, int y0, int x1, int y1, int w, int h, mp_int_t key) {
+    if (dst->format != src->format) {
+        return false;
+    }
+    switch (dst->format) {
+        case FRAMEBUF_RGB565:
+            for (int j = 0; j < h; ++j) {
+                uint16_t *d = &((uint16_t*)dst->buf)[x0 + (y0 + j) * dst->stride];
+                const uint16_t *s = &((const uint16_t*)src->buf)[x1 + (y1 + j) * src->stride];
+                if (key == -1) {
+                    memmove(d, s, w * sizeof(uint16_t));
+                } else {
+                    for (int i = 0; i < w; ++i) {
+                        if (s[i] != (uint32_t)key) {
+                            d[i] = s[i];
+                        }
+                    }
+                }
+            }
+            return true;
+        case FRAMEBUF_GS8:
+            if (key != -1) {
+                return false;
+            }
+            for (int j = 0; j < h; ++j) {
+                memmove(&((uint8_t*)dst->buf)[x0 + (y0 + j) * dst->stride],
+                    &((const uint8_t*)src->buf)[x1 + (y1 + j) * src->stride], w);
+            }
+            return true;
+        case FRAMEBUF_MHLSB:
+        case FRAMEBUF_MHMSB:
+            if (key != -1 || ((x0 | x1) & 7)) {
+                return false;
+            }
+            for (int j = 0; j < h; ++j) {
+                // whole bytes, then the pixels left of the last one
+                memmove(&((uint8_t*)dst->buf)[(x0 + (y0 + j) * dst->stride) >> 3],
+                    &((const uint8_t*)src->buf)[(x1 + (y1 + j) * src->stride) >> 3], w >> 3);
+                for (int i = w & ~7; i < w; ++i) {
+                    mono_horiz_setpixel(dst, x0 + i, y0 + j, mono_horiz_getpixel(src, x1 + i, y1 + j));
+                }
+            }
+            return true;
+        case FRAMEBUF_MVLSB:
+            if (key != -1 || ((y0 | y1) & 7)) {
+                return false;
+            }
+            for (int j = 0; j < h; j += 8) {
+                uint8_t *d = &((uint8_t*)dst->buf)[((y0 + j) >> 3) * dst->stride + x0];
+                const uint8_t *s = &((const uint8_t*)src->buf)[((y1 + j) >> 3) * src->stride + x1];
+                if (h - j >= 8) {
+                    memmove(d, s, w);
+                } else {
+                    // last page, only some of its rows are part of the area
+                    uint8_t mask = (1 << (h - j)) - 1;
+                    for (int i = 0; i < w; ++i) {
+                        d[i] = (d[i] & ~mask) | (s[i] & mask);
+                    }
+                }
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
 STATIC mp_obj_t framebuf_blit(size_t n_args, const mp_obj_t *args) {
     mp_obj_framebuf_t *self = MP_OBJ_TO_PTR(args[0]);
     mp_obj_framebuf_t *source = MP_OBJ_TO_PTR(args[1]);
@@ -495,6 +608,12 @@ STATIC mp_obj_t framebuf_blit(size_t n_args, const mp_obj_t *args) {
     int x0end = MIN(self->width, x + source->width);
     int y0end = MIN(self->height, y + source->height);
 
+    mark_dirty(self, x0, y0, x0end - x0, y0end - y0);
+
+    if (blit_same_format(self, source, x0, y0, x1, y1, x0end - x0, y0end - y0, key)) {
+        return mp_const_none;
+    }
+
     for (; y0 < y0end; ++y0) {
         int cx1 = x1;
         for (int cx0 = x0; cx0 < x0end; ++cx0) {
@@ -533,6 +652,7 @@ STATIC mp_obj_t framebuf_scroll(mp_obj_t self_in, mp_obj_t xstep_in, mp_obj_t ys
         yend = ystep - 1;
         dy = -1;
     }
+    mark_dirty(self, 0, 0, self->width, self->height);
     for (; y != yend; y += dy) {
         for (int x = sx; x != xend; x += dx) {
             setpixel(self, x, y, getpixel(self, x - xstep, y - ystep));
@@ -553,6 +673,10 @@ STATIC mp_obj_t framebuf_text(size_t n_args, const mp_obj_t *args) {
         col = mp_obj_get_int(args[4]);
     }
 
+    mark_dirty(self, x0, y0, strlen(str) * 8, 8);
+    // in MVLSB a column of a char is a single byte when it's aligned to a page
+    bool mvlsb_page = self->format == FRAMEBUF_MVLSB && (y0 & 7) == 0 && 0 <= y0 && y0 + 8 <= self->height;
+
     // loop over chars
     for (; *str; ++str) {
         // get char and make sure its in range of font
@@ -566,6 +690,11 @@ STATIC mp_obj_t framebuf_text(size_t n_args, const mp_obj_t *args) {
         for (int j = 0; j < 8; j++, x0++) {
             if (0 <= x0 && x0 < self->width) { // clip x
                 uint vline_data = chr_data[j]; // each byte is a column of 8 pixels, LSB at top
+                if (mvlsb_page) {
+                    uint8_t *b = &((uint8_t*)self->buf)[(y0 >> 3) * self->stride + x0];
+                    *b = col ? (*b | vline_data) : (*b & ~vline_data);
+                    continue;
+                }
                 for (int y = y0; vline_data; vline_data >>= 1, y++) { // scan over vertical column
                     if (vline_data & 1) { // only draw if pixel set
                         if (0 <= y && y < self->height) { // clip y
@@ -580,6 +709,98 @@ STATIC mp_obj_t framebuf_text(size_t n_args, const mp_obj_t *args) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(framebuf_text_obj, 4, 5, framebuf_text);
 
+// dirty([clear]) gives the (x, y, w, h) drawn since the dirty rectangle was last
+// cleared, or None
+STATIC mp_obj_t framebuf_dirty(size_t n_args, const mp_obj_t *args) {
+    mp_obj_framebuf_t *self = MP_OBJ_TO_PTR(args[0]);
+    mp_obj_t rect = mp_const_none;
+    if (self->dirty_x0 < self->dirty_x1) {
+        mp_obj_t items[4] = {
+            MP_OBJ_NEW_SMALL_INT(self->dirty_x0),
+            MP_OBJ_NEW_SMALL_INT(self->dirty_y0),
+            MP_OBJ_NEW_SMALL_INT(self->dirty_x1 - self->dirty_x0),
+            MP_OBJ_NEW_SMALL_INT(self->dirty_y1 - self->dirty_y0),
+        };
+        rect = mp_obj_new_tuple(4, items);
+    }
+    if (n_args > 1 && mp_obj_is_true(args[1])) {
+        self->dirty_x0 = self->dirty_x1 = 0;
+    }
+    return rect;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(framebuf_dirty_obj, 1, 2, framebuf_dirty);
+
+STATIC void show_write(mp_obj_t *write, const void *buf, size_t len) {
+    write[2] = mp_obj_new_bytearray_by_ref(len, (void*)buf);
+    mp_call_method_n_kw(1, 0, write);
+}
+
+STATIC void show_pin(mp_obj_t pin, int value) {
+    if (pin != mp_const_none) {
+        mp_obj_t dest[3];
+        mp_load_method(pin, MP_QSTR_value, dest);
+        dest[2] = MP_OBJ_NEW_SMALL_INT(value);
+        mp_call_method_n_kw(1, 0, dest);
+    }
+}
+
+STATIC void show_command(mp_obj_t *write, mp_obj_t dc, uint8_t cmd, uint16_t start, uint16_t end) {
+    uint8_t data[4] = {start >> 8, start, end >> 8, end};
+    show_pin(dc, 0);
+    show_write(write, &cmd, 1);
+    show_pin(dc, 1);
+    show_write(write, data, sizeof(data));
+}
+
+// show(spi, dc, cs, region=None) pushes the rows of region, or of the dirty
+// rectangle, to a MIPI DCS display (ILI9341, ST7735, ST7789...) with the
+// column/page address set and memory write commands.  The RGB565 pixels are
+// sent as they are in the buffer, so they must already be in the byte order of
+// the display.  cs can be None when the chip select is handled elsewhere.
+STATIC mp_obj_t framebuf_show(size_t n_args, const mp_obj_t *args) {
+    mp_obj_framebuf_t *self = MP_OBJ_TO_PTR(args[0]);
+    if (self->format != FRAMEBUF_RGB565) {
+        mp_raise_ValueError("show() needs RGB565");
+    }
+
+    int y, yend;
+    if (n_args > 4 && args[4] != mp_const_none) {
+        mp_obj_t *region;
+        mp_obj_get_array_fixed_n(args[4], 4, &region);
+        y = MAX(0, mp_obj_get_int(region[1]));
+        yend = MIN(self->height, mp_obj_get_int(region[1]) + mp_obj_get_int(region[3]));
+    } else {
+        y = self->dirty_y0;
+        yend = self->dirty_x0 < self->dirty_x1 ? self->dirty_y1 : y;
+        self->dirty_x0 = self->dirty_x1 = 0;
+    }
+    if (y >= yend) {
+        return mp_const_none;
+    }
+
+    mp_obj_t write[3];
+    mp_load_method(args[1], MP_QSTR_write, write);
+    show_pin(args[3], 0);
+    show_command(write, args[2], 0x2a, 0, self->width - 1);     // CASET
+    show_command(write, args[2], 0x2b, y, yend - 1);            // RASET
+    uint8_t ramwr = 0x2c;
+    show_pin(args[2], 0);
+    show_write(write, &ramwr, 1);
+    show_pin(args[2], 1);
+    const uint16_t *rows = &((const uint16_t*)self->buf)[y * self->stride];
+    if (self->stride == self->width) {
+        // the rows are contiguous, send them in one go
+        show_write(write, rows, (yend - y) * self->width * sizeof(uint16_t));
+    } else {
+        for (; y < yend; ++y, rows += self->stride) {
+            show_write(write, rows, self->width * sizeof(uint16_t));
+        }
+    }
+    show_pin(args[3], 1);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(framebuf_show_obj, 4, 5, framebuf_show);
+
 STATIC const mp_rom_map_elem_t framebuf_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_fill), MP_ROM_PTR(&framebuf_fill_obj) },
     { MP_ROM_QSTR(MP_QSTR_fill_rect), MP_ROM_PTR(&framebuf_fill_rect_obj) },
@@ -591,6 +812,8 @@ STATIC const mp_rom_map_elem_t framebuf_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_blit), MP_ROM_PTR(&framebuf_blit_obj) },
     { MP_ROM_QSTR(MP_QSTR_scroll), MP_ROM_PTR(&framebuf_scroll_obj) },
     { MP_ROM_QSTR(MP_QSTR_text), MP_ROM_PTR(&framebuf_text_obj) },
+    { MP_ROM_QSTR(MP_QSTR_dirty), MP_ROM_PTR(&framebuf_dirty_obj) },
+    { MP_ROM_QSTR(MP_QSTR_show), MP_ROM_PTR(&framebuf_show_obj) },
 };
 STATIC MP_DEFINE_CONST_DICT(framebuf_locals_dict, framebuf_locals_dict_table);
 
@@ -619,6 +842,7 @@ STATIC mp_obj_t legacy_framebuffer1(size_t n_args, const mp_obj_t *args) {
     } else {
         o->stride = o->width;
     }
+    mark_dirty(o, 0, 0, o->width, o->height);
 
     return MP_OBJ_FROM_PTR(o);
 }
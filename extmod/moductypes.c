@@ -66,6 +66,11 @@
 ///     print(s.a, s.b)
 ///     # Result:
 ///     # 100, 20
+///
+///     # A descriptor compiled once, with the fields in a table and the size
+///     # precomputed, is faster to use than the dict
+///     FOO_DESC = uctypes.compile(FOO_STRUCT)
+///     s = uctypes.struct(uctypes.addressof(buf), FOO_DESC)
 
 #define LAYOUT_LITTLE_ENDIAN (0)
 #define LAYOUT_BIG_ENDIAN    (1)
@@ -116,10 +121,56 @@ typedef struct _mp_obj_uctypes_struct_t {
     uint32_t flags;
 } mp_obj_uctypes_struct_t;
 
+// A structure descriptor made by compile(): the fields sorted by name, looked
+// up without hashing, and the size for the layout it was compiled for.
+STATIC const mp_obj_type_t uctypes_desc_type;
+
+typedef struct _uctypes_field_t {
+    qstr name;
+    mp_obj_t desc; // a scalar, or a tuple with its structures compiled
+} uctypes_field_t;
+
+typedef struct _mp_obj_uctypes_desc_t {
+    mp_obj_base_t base;
+    mp_uint_t size;
+    mp_uint_t max_field_size;
+    uint16_t layout;
+    uint16_t n_fields;
+    uctypes_field_t fields[];
+} mp_obj_uctypes_desc_t;
+
 STATIC NORETURN void syntax_error(void) {
     mp_raise_TypeError("syntax error in uctypes descriptor");
 }
 
+STATIC bool uctypes_is_struct_desc(mp_obj_t desc) {
+    return mp_obj_is_type(desc, &mp_type_dict)
+      #if MICROPY_PY_COLLECTIONS_ORDEREDDICT
+        || mp_obj_is_type(desc, &mp_type_ordereddict)
+      #endif
+        || mp_obj_is_type(desc, &uctypes_desc_type);
+}
+
+// The descriptor of a field of a structure
+STATIC mp_obj_t uctypes_struct_field(mp_obj_t desc_in, qstr attr) {
+    if (!mp_obj_is_type(desc_in, &uctypes_desc_type)) {
+        return mp_obj_dict_get(desc_in, MP_OBJ_NEW_QSTR(attr));
+    }
+    mp_obj_uctypes_desc_t *desc = MP_OBJ_TO_PTR(desc_in);
+    size_t lo = 0, hi = desc->n_fields;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (desc->fields[mid].name == attr) {
+            return desc->fields[mid].desc;
+        } else if (desc->fields[mid].name < attr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    nlr_raise(mp_obj_new_exception_arg1(&mp_type_KeyError, MP_OBJ_NEW_QSTR(attr)));
+}
+
 STATIC mp_obj_t uctypes_struct_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
     mp_arg_check_num(n_args, n_kw, 2, 3, false);
     mp_obj_uctypes_struct_t *o = m_new_obj(mp_obj_uctypes_struct_t);
@@ -137,11 +188,7 @@ STATIC void uctypes_struct_print(const mp_print_t *print, mp_obj_t self_in, mp_p
     (void)kind;
     mp_obj_uctypes_struct_t *self = MP_OBJ_TO_PTR(self_in);
     const char *typen = "unk";
-    if (mp_obj_is_type(self->desc, &mp_type_dict)
-      #if MICROPY_PY_COLLECTIONS_ORDEREDDICT
-        || mp_obj_is_type(self->desc, &mp_type_ordereddict)
-      #endif
-      ) {
+    if (uctypes_is_struct_desc(self->desc)) {
         typen = "STRUCT";
     } else if (mp_obj_is_type(self->desc, &mp_type_tuple)) {
         mp_obj_tuple_t *t = MP_OBJ_TO_PTR(self->desc);
@@ -209,7 +256,51 @@ STATIC mp_uint_t uctypes_struct_agg_size(mp_obj_tuple_t *t, int layout_type, mp_
     return total_size;
 }
 
+// Get the offset of the end of a field of a structure
+STATIC mp_uint_t uctypes_struct_field_end(mp_obj_t v, int layout_type, mp_uint_t *max_field_size) {
+    if (mp_obj_is_small_int(v)) {
+        mp_uint_t offset = MP_OBJ_SMALL_INT_VALUE(v);
+        mp_uint_t val_type = GET_TYPE(offset, VAL_TYPE_BITS);
+        offset &= VALUE_MASK(VAL_TYPE_BITS);
+        if (val_type >= BFUINT8 && val_type <= BFINT32) {
+            offset &= (1 << OFFSET_BITS) - 1;
+        }
+        mp_uint_t s = uctypes_struct_scalar_size(val_type);
+        if (s > *max_field_size) {
+            *max_field_size = s;
+        }
+        return offset + s;
+    } else {
+        if (!mp_obj_is_type(v, &mp_type_tuple)) {
+            syntax_error();
+        }
+        mp_obj_tuple_t *t = MP_OBJ_TO_PTR(v);
+        mp_int_t offset = MP_OBJ_SMALL_INT_VALUE(t->items[0]);
+        offset &= VALUE_MASK(AGG_TYPE_BITS);
+        return offset + uctypes_struct_agg_size(t, layout_type, max_field_size);
+    }
+}
+
 STATIC mp_uint_t uctypes_struct_size(mp_obj_t desc_in, int layout_type, mp_uint_t *max_field_size) {
+    mp_uint_t total_size = 0;
+
+    if (mp_obj_is_type(desc_in, &uctypes_desc_type)) {
+        mp_obj_uctypes_desc_t *desc = MP_OBJ_TO_PTR(desc_in);
+        if (desc->layout == layout_type) {
+            if (desc->max_field_size > *max_field_size) {
+                *max_field_size = desc->max_field_size;
+            }
+            return desc->size;
+        }
+        for (size_t i = 0; i < desc->n_fields; i++) {
+            mp_uint_t end = uctypes_struct_field_end(desc->fields[i].desc, layout_type, max_field_size);
+            if (end > total_size) {
+                total_size = end;
+            }
+        }
+        goto round_up;
+    }
+
     if (!mp_obj_is_type(desc_in, &mp_type_dict)
       #if MICROPY_PY_COLLECTIONS_ORDEREDDICT
         && !mp_obj_is_type(desc_in, &mp_type_ordereddict)
@@ -228,40 +319,17 @@ STATIC mp_uint_t uctypes_struct_size(mp_obj_t desc_in, int layout_type, mp_uint_
     }
 
     mp_obj_dict_t *d = MP_OBJ_TO_PTR(desc_in);
-    mp_uint_t total_size = 0;
 
     for (mp_uint_t i = 0; i < d->map.alloc; i++) {
         if (mp_map_slot_is_filled(&d->map, i)) {
-            mp_obj_t v = d->map.table[i].value;
-            if (mp_obj_is_small_int(v)) {
-                mp_uint_t offset = MP_OBJ_SMALL_INT_VALUE(v);
-                mp_uint_t val_type = GET_TYPE(offset, VAL_TYPE_BITS);
-                offset &= VALUE_MASK(VAL_TYPE_BITS);
-                if (val_type >= BFUINT8 && val_type <= BFINT32) {
-                    offset &= (1 << OFFSET_BITS) - 1;
-                }
-                mp_uint_t s = uctypes_struct_scalar_size(val_type);
-                if (s > *max_field_size) {
-                    *max_field_size = s;
-                }
-                if (offset + s > total_size) {
-                    total_size = offset + s;
-                }
-            } else {
-                if (!mp_obj_is_type(v, &mp_type_tuple)) {
-                    syntax_error();
-                }
-                mp_obj_tuple_t *t = MP_OBJ_TO_PTR(v);
-                mp_int_t offset = MP_OBJ_SMALL_INT_VALUE(t->items[0]);
-                offset &= VALUE_MASK(AGG_TYPE_BITS);
-                mp_uint_t s = uctypes_struct_agg_size(t, layout_type, max_field_size);
-                if (offset + s > total_size) {
-                    total_size = offset + s;
-                }
+            mp_uint_t end = uctypes_struct_field_end(d->map.table[i].value, layout_type, max_field_size);
+            if (end > total_size) {
+                total_size = end;
             }
         }
     }
 
+round_up:
     // Round size up to alignment of biggest field
     if (layout_type == LAYOUT_NATIVE) {
         total_size = (total_size + *max_field_size - 1) & ~(*max_field_size - 1);
@@ -296,6 +364,109 @@ STATIC mp_obj_t uctypes_struct_sizeof(size_t n_args, const mp_obj_t *args) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(uctypes_struct_sizeof_obj, 1, 2, uctypes_struct_sizeof);
 
+STATIC mp_obj_t uctypes_compile_desc(mp_obj_t desc_in, int layout_type);
+
+// Compile the structures an aggregate field refers to
+STATIC mp_obj_t uctypes_compile_agg(mp_obj_t v, int layout_type) {
+    if (!mp_obj_is_type(v, &mp_type_tuple)) {
+        return v;
+    }
+    mp_obj_tuple_t *t = MP_OBJ_TO_PTR(v);
+    mp_obj_tuple_t *t2 = MP_OBJ_TO_PTR(mp_obj_new_tuple(t->len, t->items));
+    for (size_t i = 1; i < t->len; i++) {
+        if (uctypes_is_struct_desc(t->items[i])) {
+            t2->items[i] = uctypes_compile_desc(t->items[i], layout_type);
+        }
+    }
+    return MP_OBJ_FROM_PTR(t2);
+}
+
+STATIC mp_obj_t uctypes_compile_desc(mp_obj_t desc_in, int layout_type) {
+    if (mp_obj_is_type(desc_in, &uctypes_desc_type)) {
+        mp_obj_uctypes_desc_t *desc = MP_OBJ_TO_PTR(desc_in);
+        if (desc->layout == layout_type) {
+            return desc_in;
+        }
+    }
+    if (!uctypes_is_struct_desc(desc_in)) {
+        syntax_error();
+    }
+
+    // checks the descriptor as a whole
+    mp_uint_t max_field_size = 0;
+    mp_uint_t size = uctypes_struct_size(desc_in, layout_type, &max_field_size);
+
+    size_t n_fields;
+    const uctypes_field_t *fields = NULL;
+    mp_map_t *map = NULL;
+    if (mp_obj_is_type(desc_in, &uctypes_desc_type)) {
+        mp_obj_uctypes_desc_t *desc = MP_OBJ_TO_PTR(desc_in);
+        n_fields = desc->n_fields;
+        fields = desc->fields;
+    } else {
+        map = &((mp_obj_dict_t*)MP_OBJ_TO_PTR(desc_in))->map;
+        n_fields = map->used;
+    }
+    if (n_fields > 0xffff) {
+        syntax_error();
+    }
+
+    mp_obj_uctypes_desc_t *o = m_new_obj_var(mp_obj_uctypes_desc_t, uctypes_field_t, n_fields);
+    o->base.type = &uctypes_desc_type;
+    o->size = size;
+    o->max_field_size = max_field_size;
+    o->layout = layout_type;
+    o->n_fields = 0;
+    for (size_t i = 0; map != NULL ? i < map->alloc : i < n_fields; i++) {
+        qstr name;
+        mp_obj_t v;
+        if (map != NULL) {
+            if (!mp_map_slot_is_filled(map, i)) {
+                continue;
+            }
+            name = mp_obj_str_get_qstr(map->table[i].key);
+            v = map->table[i].value;
+        } else {
+            name = fields[i].name;
+            v = fields[i].desc;
+        }
+        v = uctypes_compile_agg(v, layout_type);
+        // insertion sort by name, descriptors are small
+        size_t j = o->n_fields++;
+        for (; j > 0 && o->fields[j - 1].name > name; j--) {
+            o->fields[j] = o->fields[j - 1];
+        }
+        o->fields[j].name = name;
+        o->fields[j].desc = v;
+    }
+    return MP_OBJ_FROM_PTR(o);
+}
+
+/// \function compile()
+/// Compile a structure descriptor for the given layout.  Structures created
+/// with it look their fields up in a sorted table, and their size and the
+/// size of each element of their arrays of structures are known in advance.
+STATIC mp_obj_t uctypes_compile(size_t n_args, const mp_obj_t *args) {
+    int layout_type = LAYOUT_NATIVE;
+    if (n_args == 2) {
+        layout_type = mp_obj_get_int(args[1]);
+    }
+    return uctypes_compile_desc(args[0], layout_type);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(uctypes_compile_obj, 1, 2, uctypes_compile);
+
+STATIC void uctypes_desc_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
+    (void)kind;
+    mp_obj_uctypes_desc_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_printf(print, "<descriptor %u fields, size %u>", (uint)self->n_fields, (uint)self->size);
+}
+
+STATIC const mp_obj_type_t uctypes_desc_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_descriptor,
+    .print = uctypes_desc_print,
+};
+
 static inline mp_obj_t get_unaligned(uint val_type, byte *p, int big_endian) {
     char struct_type = big_endian ? '>' : '<';
     static const char type2char[16] = "BbHhIiQq------fd";
@@ -406,15 +577,11 @@ STATIC void set_aligned(uint val_type, void *p, mp_int_t index, mp_obj_t val) {
 STATIC mp_obj_t uctypes_struct_attr_op(mp_obj_t self_in, qstr attr, mp_obj_t set_val) {
     mp_obj_uctypes_struct_t *self = MP_OBJ_TO_PTR(self_in);
 
-    if (!mp_obj_is_type(self->desc, &mp_type_dict)
-      #if MICROPY_PY_COLLECTIONS_ORDEREDDICT
-        && !mp_obj_is_type(self->desc, &mp_type_ordereddict)
-      #endif
-      ) {
+    if (!uctypes_is_struct_desc(self->desc)) {
             mp_raise_TypeError("struct: no fields");
     }
 
-    mp_obj_t deref = mp_obj_dict_get(self->desc, MP_OBJ_NEW_QSTR(attr));
+    mp_obj_t deref = uctypes_struct_field(self->desc, attr);
     if (mp_obj_is_small_int(deref)) {
         mp_int_t offset = MP_OBJ_SMALL_INT_VALUE(deref);
         mp_uint_t val_type = GET_TYPE(offset, VAL_TYPE_BITS);
@@ -451,9 +618,11 @@ STATIC mp_obj_t uctypes_struct_attr_op(mp_obj_t self_in, qstr attr, mp_obj_t set
             if (set_val == MP_OBJ_NULL) {
                 val >>= bit_offset;
                 val &= (1 << bit_len) - 1;
-                // TODO: signed
-                assert((val_type & 1) == 0);
-                return mp_obj_new_int(val);
+                if ((val_type & 1) && (val & (1 << (bit_len - 1)))) {
+                    // signed, extend the sign bit
+                    return mp_obj_new_int((mp_int_t)val - ((mp_int_t)1 << bit_len));
+                }
+                return mp_obj_new_int_from_uint(val);
             } else {
                 mp_uint_t set_val_int = (mp_uint_t)mp_obj_get_int(set_val);
                 mp_uint_t mask = (1 << bit_len) - 1;
@@ -614,9 +783,25 @@ STATIC mp_obj_t uctypes_struct_subscr(mp_obj_t self_in, mp_obj_t index_in, mp_ob
     }
 }
 
+// The number of elements of an array, -1 if it's not an array
+STATIC mp_int_t uctypes_struct_array_len(mp_obj_uctypes_struct_t *self) {
+    if (mp_obj_is_type(self->desc, &mp_type_tuple)) {
+        mp_obj_tuple_t *t = MP_OBJ_TO_PTR(self->desc);
+        if (GET_TYPE(MP_OBJ_SMALL_INT_VALUE(t->items[0]), AGG_TYPE_BITS) == ARRAY) {
+            return MP_OBJ_SMALL_INT_VALUE(t->items[1]) & VALUE_MASK(VAL_TYPE_BITS);
+        }
+    }
+    return -1;
+}
+
 STATIC mp_obj_t uctypes_struct_unary_op(mp_unary_op_t op, mp_obj_t self_in) {
     mp_obj_uctypes_struct_t *self = MP_OBJ_TO_PTR(self_in);
     switch (op) {
+        case MP_UNARY_OP_LEN: {
+            mp_int_t len = uctypes_struct_array_len(self);
+            return len < 0 ? MP_OBJ_NULL : MP_OBJ_NEW_SMALL_INT(len);
+        }
+
         case MP_UNARY_OP_INT:
             if (mp_obj_is_type(self->desc, &mp_type_tuple)) {
                 mp_obj_tuple_t *t = MP_OBJ_TO_PTR(self->desc);
@@ -633,6 +818,36 @@ STATIC mp_obj_t uctypes_struct_unary_op(mp_unary_op_t op, mp_obj_t self_in) {
     }
 }
 
+typedef struct _mp_obj_uctypes_struct_it_t {
+    mp_obj_base_t base;
+    mp_fun_1_t iternext;
+    mp_obj_t array;
+    mp_int_t cur;
+} mp_obj_uctypes_struct_it_t;
+
+STATIC mp_obj_t uctypes_struct_it_iternext(mp_obj_t self_in) {
+    mp_obj_uctypes_struct_it_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->cur < uctypes_struct_array_len(MP_OBJ_TO_PTR(self->array))) {
+        return uctypes_struct_subscr(self->array, MP_OBJ_NEW_SMALL_INT(self->cur++), MP_OBJ_SENTINEL);
+    }
+    return MP_OBJ_STOP_ITERATION;
+}
+
+// Arrays iterate over their elements, in place like indexing does
+STATIC mp_obj_t uctypes_struct_getiter(mp_obj_t self_in, mp_obj_iter_buf_t *iter_buf) {
+    mp_obj_uctypes_struct_t *self = MP_OBJ_TO_PTR(self_in);
+    if (uctypes_struct_array_len(self) < 0) {
+        mp_raise_TypeError("struct: not an array");
+    }
+    assert(sizeof(mp_obj_uctypes_struct_it_t) <= sizeof(mp_obj_iter_buf_t));
+    mp_obj_uctypes_struct_it_t *o = (mp_obj_uctypes_struct_it_t*)iter_buf;
+    o->base.type = &mp_type_polymorph_iter;
+    o->iternext = uctypes_struct_it_iternext;
+    o->array = self_in;
+    o->cur = 0;
+    return MP_OBJ_FROM_PTR(o);
+}
+
 STATIC mp_int_t uctypes_get_buffer(mp_obj_t self_in, mp_buffer_info_t *bufinfo, mp_uint_t flags) {
     (void)flags;
     mp_obj_uctypes_struct_t *self = MP_OBJ_TO_PTR(self_in);
@@ -682,6 +897,7 @@ STATIC const mp_obj_type_t uctypes_struct_type = {
     .attr = uctypes_struct_attr,
     .subscr = uctypes_struct_subscr,
     .unary_op = uctypes_struct_unary_op,
+    .getiter = uctypes_struct_getiter,
     .buffer_p = { .get_buffer = uctypes_get_buffer },
 };
 
@@ -689,6 +905,7 @@ STATIC const mp_rom_map_elem_t mp_module_uctypes_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_uctypes) },
     { MP_ROM_QSTR(MP_QSTR_struct), MP_ROM_PTR(&uctypes_struct_type) },
     { MP_ROM_QSTR(MP_QSTR_sizeof), MP_ROM_PTR(&uctypes_struct_sizeof_obj) },
+    { MP_ROM_QSTR(MP_QSTR_compile), MP_ROM_PTR(&uctypes_compile_obj) },
     { MP_ROM_QSTR(MP_QSTR_addressof), MP_ROM_PTR(&uctypes_struct_addressof_obj) },
     { MP_ROM_QSTR(MP_QSTR_bytes_at), MP_ROM_PTR(&uctypes_struct_bytes_at_obj) },
     { MP_ROM_QSTR(MP_QSTR_bytearray_at), MP_ROM_PTR(&uctypes_struct_bytearray_at_obj) },
@@ -25,19 +25,54 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "py/objlist.h"
-#include "py/objstringio.h"
+#include "py/objstr.h"
 #include "py/parsenum.h"
 #include "py/runtime.h"
 #include "py/stream.h"
 
 #if MICROPY_PY_UJSON
 
+// dump() collects the output in a small buffer so the stream sees a few
+// large writes instead of one per token
+#define UJSON_DUMP_BUF_SIZE (128)
+
+typedef struct _ujson_dump_t {
+    mp_obj_t stream_obj;
+    size_t len;
+    byte buf[UJSON_DUMP_BUF_SIZE];
+} ujson_dump_t;
+
+STATIC void ujson_dump_flush(ujson_dump_t *d) {
+    if (d->len > 0) {
+        mp_stream_write(d->stream_obj, d->buf, d->len, MP_STREAM_RW_WRITE);
+        d->len = 0;
+    }
+}
+
+STATIC void ujson_dump_strn(void *data, const char *str, size_t len) {
+    ujson_dump_t *d = data;
+    if (d->len + len > UJSON_DUMP_BUF_SIZE) {
+        ujson_dump_flush(d);
+        if (len > UJSON_DUMP_BUF_SIZE) {
+            mp_stream_write(d->stream_obj, str, len, MP_STREAM_RW_WRITE);
+            return;
+        }
+    }
+    memcpy(d->buf + d->len, str, len);
+    d->len += len;
+}
+
 STATIC mp_obj_t mod_ujson_dump(mp_obj_t obj, mp_obj_t stream) {
     mp_get_stream_raise(stream, MP_STREAM_OP_WRITE);
-    mp_print_t print = {MP_OBJ_TO_PTR(stream), mp_stream_write_adaptor};
+    ujson_dump_t d;
+    d.stream_obj = stream;
+    d.len = 0;
+    mp_print_t print = {&d, ujson_dump_strn};
     mp_obj_print_helper(&print, obj, PRINT_JSON);
+    ujson_dump_flush(&d);
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_ujson_dump_obj, mod_ujson_dump);
@@ -63,12 +98,22 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_ujson_dumps_obj, mod_ujson_dumps);
 // Most of the work is parsing the primitives (null, false, true, numbers,
 // strings).  It does 1 pass over the input stream.  It tries to be fast and
 // small in code size, while not using more RAM than necessary.
+//
+// The input is read from the stream in chunks; loads() parses straight out
+// of the string without a stream at all.
+
+#define UJSON_STREAM_BUF_SIZE (64)
+// longer keys aren't worth a permanent qstr
+#define UJSON_INTERN_MAX_LEN (32)
 
 typedef struct _ujson_stream_t {
     mp_obj_t stream_obj;
     mp_uint_t (*read)(mp_obj_t obj, void *buf, mp_uint_t size, int *errcode);
     int errcode;
     byte cur;
+    const byte *pos;
+    const byte *end;
+    byte buf[UJSON_STREAM_BUF_SIZE];
 } ujson_stream_t;
 
 #define S_EOF (0) // null is not allowed in json stream so is ok as EOF marker
@@ -76,38 +121,75 @@ typedef struct _ujson_stream_t {
 #define S_CUR(s) ((s).cur)
 #define S_NEXT(s) (ujson_stream_next(&(s)))
 
-STATIC byte ujson_stream_next(ujson_stream_t *s) {
-    mp_uint_t ret = s->read(s->stream_obj, &s->cur, 1, &s->errcode);
-    if (s->errcode != 0) {
+// what ujson_next_token() found
+enum {
+    UJSON_TOK_VALUE,
+    UJSON_TOK_START_OBJECT,
+    UJSON_TOK_START_ARRAY,
+    UJSON_TOK_END,
+    UJSON_TOK_EOF,
+};
+
+STATIC byte ujson_stream_refill(ujson_stream_t *s) {
+    if (s->read == NULL) {
+        s->cur = S_EOF;
+        return s->cur;
+    }
+    mp_uint_t ret = s->read(s->stream_obj, s->buf, UJSON_STREAM_BUF_SIZE, &s->errcode);
+    if (ret == MP_STREAM_ERROR) {
         mp_raise_OSError(s->errcode);
     }
     if (ret == 0) {
         s->cur = S_EOF;
+        return s->cur;
+    }
+    s->pos = s->buf;
+    s->end = s->buf + ret;
+    s->cur = *s->pos++;
+    return s->cur;
+}
+
+static inline byte ujson_stream_next(ujson_stream_t *s) {
+    if (s->pos == s->end) {
+        return ujson_stream_refill(s);
     }
+    s->cur = *s->pos++;
     return s->cur;
 }
 
-STATIC mp_obj_t mod_ujson_load(mp_obj_t stream_obj) {
+STATIC void ujson_stream_init(ujson_stream_t *s, mp_obj_t stream_obj) {
     const mp_stream_p_t *stream_p = mp_get_stream_raise(stream_obj, MP_STREAM_OP_READ);
-    ujson_stream_t s = {stream_obj, stream_p->read, 0, 0};
-    vstr_t vstr;
-    vstr_init(&vstr, 8);
-    mp_obj_list_t stack; // we use a list as a simple stack for nested JSON
-    stack.len = 0;
-    stack.items = NULL;
-    mp_obj_t stack_top = MP_OBJ_NULL;
-    mp_obj_type_t *stack_top_type = NULL;
-    mp_obj_t stack_key = MP_OBJ_NULL;
-    S_NEXT(s);
+    s->stream_obj = stream_obj;
+    s->read = stream_p->read;
+    s->errcode = 0;
+    s->pos = s->end = NULL;
+    S_NEXT(*s);
+}
+
+STATIC void ujson_stream_init_str(ujson_stream_t *s, mp_obj_t str_obj) {
+    size_t len;
+    const char *buf = mp_obj_str_get_data(str_obj, &len);
+    s->stream_obj = str_obj;
+    s->read = NULL;
+    s->errcode = 0;
+    s->pos = (const byte*)buf;
+    s->end = (const byte*)buf + len;
+    S_NEXT(*s);
+}
+
+STATIC NORETURN void ujson_syntax_error(void) {
+    mp_raise_ValueError("syntax error in JSON");
+}
+
+// Reads the next primitive or bracket.  Keys become qstrs if asked, so that
+// documents with the same keys over and over don't store them again each time.
+STATIC int ujson_next_token(ujson_stream_t *s, vstr_t *vstr, mp_obj_t *value, bool intern) {
     for (;;) {
-        cont:
-        if (S_END(s)) {
-            break;
+        if (S_END(*s)) {
+            return UJSON_TOK_EOF;
         }
-        mp_obj_t next = MP_OBJ_NULL;
-        bool enter = false;
-        byte cur = S_CUR(s);
-        S_NEXT(s);
+        byte cur = S_CUR(*s);
+        S_NEXT(*s);
         switch (cur) {
             case ',':
             case ':':
@@ -115,37 +197,34 @@ STATIC mp_obj_t mod_ujson_load(mp_obj_t stream_obj) {
             case '\t':
             case '\n':
             case '\r':
-                goto cont;
+                continue;
             case 'n':
-                if (S_CUR(s) == 'u' && S_NEXT(s) == 'l' && S_NEXT(s) == 'l') {
-                    S_NEXT(s);
-                    next = mp_const_none;
-                } else {
-                    goto fail;
+                if (S_CUR(*s) == 'u' && S_NEXT(*s) == 'l' && S_NEXT(*s) == 'l') {
+                    S_NEXT(*s);
+                    *value = mp_const_none;
+                    return UJSON_TOK_VALUE;
                 }
-                break;
+                ujson_syntax_error();
             case 'f':
-                if (S_CUR(s) == 'a' && S_NEXT(s) == 'l' && S_NEXT(s) == 's' && S_NEXT(s) == 'e') {
-                    S_NEXT(s);
-                    next = mp_const_false;
-                } else {
-                    goto fail;
+                if (S_CUR(*s) == 'a' && S_NEXT(*s) == 'l' && S_NEXT(*s) == 's' && S_NEXT(*s) == 'e') {
+                    S_NEXT(*s);
+                    *value = mp_const_false;
+                    return UJSON_TOK_VALUE;
                 }
-                break;
+                ujson_syntax_error();
             case 't':
-                if (S_CUR(s) == 'r' && S_NEXT(s) == 'u' && S_NEXT(s) == 'e') {
-                    S_NEXT(s);
-                    next = mp_const_true;
-                } else {
-                    goto fail;
+                if (S_CUR(*s) == 'r' && S_NEXT(*s) == 'u' && S_NEXT(*s) == 'e') {
+                    S_NEXT(*s);
+                    *value = mp_const_true;
+                    return UJSON_TOK_VALUE;
                 }
-                break;
+                ujson_syntax_error();
             case '"':
-                vstr_reset(&vstr);
-                for (; !S_END(s) && S_CUR(s) != '"';) {
-                    byte c = S_CUR(s);
+                vstr_reset(vstr);
+                for (; !S_END(*s) && S_CUR(*s) != '"';) {
+                    byte c = S_CUR(*s);
                     if (c == '\\') {
-                        c = S_NEXT(s);
+                        c = S_NEXT(*s);
                         switch (c) {
                             case 'b': c = 0x08; break;
                             case 'f': c = 0x0c; break;
@@ -155,34 +234,38 @@ STATIC mp_obj_t mod_ujson_load(mp_obj_t stream_obj) {
                             case 'u': {
                                 mp_uint_t num = 0;
                                 for (int i = 0; i < 4; i++) {
-                                    c = (S_NEXT(s) | 0x20) - '0';
+                                    c = (S_NEXT(*s) | 0x20) - '0';
                                     if (c > 9) {
                                         c -= ('a' - ('9' + 1));
                                     }
                                     num = (num << 4) | c;
                                 }
-                                vstr_add_char(&vstr, num);
+                                vstr_add_char(vstr, num);
                                 goto str_cont;
                             }
                         }
                     }
-                    vstr_add_byte(&vstr, c);
+                    vstr_add_byte(vstr, c);
                 str_cont:
-                    S_NEXT(s);
+                    S_NEXT(*s);
                 }
-                if (S_END(s)) {
-                    goto fail;
+                if (S_END(*s)) {
+                    ujson_syntax_error();
                 }
-                S_NEXT(s);
-                next = mp_obj_new_str(vstr.buf, vstr.len);
-                break;
+                S_NEXT(*s);
+                if (intern && vstr->len <= UJSON_INTERN_MAX_LEN) {
+                    *value = MP_OBJ_NEW_QSTR(qstr_from_strn(vstr->buf, vstr->len));
+                } else {
+                    *value = mp_obj_new_str(vstr->buf, vstr->len);
+                }
+                return UJSON_TOK_VALUE;
             case '-':
             case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9': {
                 bool flt = false;
-                vstr_reset(&vstr);
+                vstr_reset(vstr);
                 for (;;) {
-                    vstr_add_byte(&vstr, cur);
-                    cur = S_CUR(s);
+                    vstr_add_byte(vstr, cur);
+                    cur = S_CUR(*s);
                     if (cur == '.' || cur == 'E' || cur == 'e') {
                         flt = true;
                     } else if (cur == '+' || cur == '-' || unichar_isdigit(cur)) {
@@ -190,28 +273,69 @@ STATIC mp_obj_t mod_ujson_load(mp_obj_t stream_obj) {
                     } else {
                         break;
                     }
-                    S_NEXT(s);
+                    S_NEXT(*s);
                 }
                 if (flt) {
-                    next = mp_parse_num_decimal(vstr.buf, vstr.len, false, false, NULL);
+                    *value = mp_parse_num_decimal(vstr->buf, vstr->len, false, false, NULL);
                 } else {
-                    next = mp_parse_num_integer(vstr.buf, vstr.len, 10, NULL);
+                    *value = mp_parse_num_integer(vstr->buf, vstr->len, 10, NULL);
                 }
-                break;
+                return UJSON_TOK_VALUE;
             }
             case '[':
+                return UJSON_TOK_START_ARRAY;
+            case '{':
+                return UJSON_TOK_START_OBJECT;
+            case '}':
+            case ']':
+                return UJSON_TOK_END;
+            default:
+                ujson_syntax_error();
+        }
+    }
+}
+
+// the input has to end after the document, apart from whitespace
+STATIC void ujson_check_trailing(ujson_stream_t *s) {
+    while (unichar_isspace(S_CUR(*s))) {
+        S_NEXT(*s);
+    }
+    if (!S_END(*s)) {
+        // unexpected chars
+        ujson_syntax_error();
+    }
+}
+
+STATIC mp_obj_t ujson_parse(ujson_stream_t *s, bool intern_keys) {
+    vstr_t vstr;
+    vstr_init(&vstr, 8);
+    mp_obj_list_t stack; // we use a list as a simple stack for nested JSON
+    stack.len = 0;
+    stack.items = NULL;
+    mp_obj_t stack_top = MP_OBJ_NULL;
+    mp_obj_type_t *stack_top_type = NULL;
+    mp_obj_t stack_key = MP_OBJ_NULL;
+    for (;;) {
+        mp_obj_t next = MP_OBJ_NULL;
+        bool key = intern_keys && stack_top_type == &mp_type_dict && stack_key == MP_OBJ_NULL;
+        int tok = ujson_next_token(s, &vstr, &next, key);
+        if (tok == UJSON_TOK_EOF) {
+            break;
+        }
+        bool enter = false;
+        switch (tok) {
+            case UJSON_TOK_START_ARRAY:
                 next = mp_obj_new_list(0, NULL);
                 enter = true;
                 break;
-            case '{':
+            case UJSON_TOK_START_OBJECT:
                 next = mp_obj_new_dict(0);
                 enter = true;
                 break;
-            case '}':
-            case ']': {
+            case UJSON_TOK_END:
                 if (stack_top == MP_OBJ_NULL) {
                     // no object at all
-                    goto fail;
+                    ujson_syntax_error();
                 }
                 if (stack.len == 0) {
                     // finished; compound object
@@ -220,10 +344,7 @@ STATIC mp_obj_t mod_ujson_load(mp_obj_t stream_obj) {
                 stack.len -= 1;
                 stack_top = stack.items[stack.len];
                 stack_top_type = mp_obj_get_type(stack_top);
-                goto cont;
-            }
-            default:
-                goto fail;
+                continue;
         }
         if (stack_top == MP_OBJ_NULL) {
             stack_top = next;
@@ -240,7 +361,7 @@ STATIC mp_obj_t mod_ujson_load(mp_obj_t stream_obj) {
                 if (stack_key == MP_OBJ_NULL) {
                     stack_key = next;
                     if (enter) {
-                        goto fail;
+                        ujson_syntax_error();
                     }
                 } else {
                     mp_obj_dict_store(stack_top, stack_key, next);
@@ -260,34 +381,139 @@ STATIC mp_obj_t mod_ujson_load(mp_obj_t stream_obj) {
         }
     }
     success:
-    // eat trailing whitespace
-    while (unichar_isspace(S_CUR(s))) {
-        S_NEXT(s);
-    }
-    if (!S_END(s)) {
-        // unexpected chars
-        goto fail;
-    }
+    ujson_check_trailing(s);
     if (stack_top == MP_OBJ_NULL || stack.len != 0) {
         // not exactly 1 object
-        goto fail;
+        ujson_syntax_error();
     }
     vstr_clear(&vstr);
     return stack_top;
+}
 
-    fail:
-    mp_raise_ValueError("syntax error in JSON");
+STATIC const mp_arg_t ujson_load_args[] = {
+    { MP_QSTR_, MP_ARG_REQUIRED | MP_ARG_OBJ, {.u_obj = MP_OBJ_NULL} },
+    { MP_QSTR_intern_keys, MP_ARG_KW_ONLY | MP_ARG_BOOL, {.u_bool = false} },
+};
+
+STATIC mp_obj_t mod_ujson_load(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    mp_arg_val_t args[MP_ARRAY_SIZE(ujson_load_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(args), ujson_load_args, args);
+    ujson_stream_t s;
+    ujson_stream_init(&s, args[0].u_obj);
+    return ujson_parse(&s, args[1].u_bool);
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_ujson_load_obj, mod_ujson_load);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_ujson_load_obj, 1, mod_ujson_load);
 
-STATIC mp_obj_t mod_ujson_loads(mp_obj_t obj) {
-    size_t len;
-    const char *buf = mp_obj_str_get_data(obj, &len);
-    vstr_t vstr = {len, len, (char*)buf, true};
-    mp_obj_stringio_t sio = {{&mp_type_stringio}, &vstr, 0, MP_OBJ_NULL};
-    return mod_ujson_load(MP_OBJ_FROM_PTR(&sio));
+STATIC mp_obj_t mod_ujson_loads(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    mp_arg_val_t args[MP_ARRAY_SIZE(ujson_load_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(args), ujson_load_args, args);
+    ujson_stream_t s;
+    ujson_stream_init_str(&s, args[0].u_obj);
+    return ujson_parse(&s, args[1].u_bool);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_ujson_loads_obj, 1, mod_ujson_loads);
+
+// iterparse() hands out the document one (event, value) pair at a time, so
+// only the current value and the nesting are ever held in memory
+
+enum {
+    UJSON_EV_START_OBJECT,
+    UJSON_EV_END_OBJECT,
+    UJSON_EV_START_ARRAY,
+    UJSON_EV_END_ARRAY,
+    UJSON_EV_KEY,
+    UJSON_EV_VALUE,
+};
+
+typedef struct _mp_obj_ujson_iterparse_t {
+    mp_obj_base_t base;
+    bool intern_keys;
+    bool key_next;          // inside an object, the next string is a key
+    bool finished;          // the top level value is complete
+    vstr_t vstr;
+    vstr_t nesting;         // a '{' or '[' per open container
+    ujson_stream_t s;
+} mp_obj_ujson_iterparse_t;
+
+STATIC mp_obj_t ujson_iterparse_iternext(mp_obj_t self_in) {
+    mp_obj_ujson_iterparse_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->finished) {
+        if (self->nesting.buf != NULL) {
+            ujson_check_trailing(&self->s);
+            vstr_clear(&self->vstr);
+            vstr_clear(&self->nesting);
+        }
+        return MP_OBJ_STOP_ITERATION;
+    }
+
+    bool in_object = self->nesting.len > 0 && self->nesting.buf[self->nesting.len - 1] == '{';
+    bool key = in_object && self->key_next;
+    mp_obj_t value = mp_const_none;
+    mp_int_t event;
+    int tok = ujson_next_token(&self->s, &self->vstr, &value, key && self->intern_keys);
+    switch (tok) {
+        case UJSON_TOK_START_OBJECT:
+        case UJSON_TOK_START_ARRAY:
+            if (key) {
+                ujson_syntax_error();
+            }
+            vstr_add_byte(&self->nesting, tok == UJSON_TOK_START_OBJECT ? '{' : '[');
+            self->key_next = true;
+            event = tok == UJSON_TOK_START_OBJECT ? UJSON_EV_START_OBJECT : UJSON_EV_START_ARRAY;
+            break;
+        case UJSON_TOK_END:
+            if (self->nesting.len == 0) {
+                ujson_syntax_error();
+            }
+            self->nesting.len -= 1;
+            event = self->nesting.buf[self->nesting.len] == '{' ? UJSON_EV_END_OBJECT : UJSON_EV_END_ARRAY;
+            // the container was a value of the one around it
+            self->key_next = true;
+            break;
+        case UJSON_TOK_VALUE:
+            if (key) {
+                self->key_next = false;
+                event = UJSON_EV_KEY;
+            } else {
+                self->key_next = true;
+                event = UJSON_EV_VALUE;
+            }
+            break;
+        default:
+            // the input ended before the document did
+            ujson_syntax_error();
+    }
+    self->finished = (self->nesting.len == 0);
+
+    mp_obj_t tuple[2] = {MP_OBJ_NEW_SMALL_INT(event), value};
+    return mp_obj_new_tuple(2, tuple);
+}
+
+STATIC const mp_obj_type_t ujson_iterparse_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_iterparse,
+    .getiter = mp_identity_getiter,
+    .iternext = ujson_iterparse_iternext,
+};
+
+STATIC mp_obj_t mod_ujson_iterparse(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
+    mp_arg_val_t args[MP_ARRAY_SIZE(ujson_load_args)];
+    mp_arg_parse_all(n_args, pos_args, kw_args, MP_ARRAY_SIZE(args), ujson_load_args, args);
+    mp_obj_ujson_iterparse_t *self = m_new_obj(mp_obj_ujson_iterparse_t);
+    self->base.type = &ujson_iterparse_type;
+    self->intern_keys = args[1].u_bool;
+    self->key_next = false;
+    self->finished = false;
+    vstr_init(&self->vstr, 8);
+    vstr_init(&self->nesting, 4);
+    if (mp_obj_is_str_or_bytes(args[0].u_obj)) {
+        ujson_stream_init_str(&self->s, args[0].u_obj);
+    } else {
+        ujson_stream_init(&self->s, args[0].u_obj);
+    }
+    return MP_OBJ_FROM_PTR(self);
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_1(mod_ujson_loads_obj, mod_ujson_loads);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_ujson_iterparse_obj, 1, mod_ujson_iterparse);
 
 STATIC const mp_rom_map_elem_t mp_module_ujson_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_ujson) },
@@ -295,6 +521,13 @@ STATIC const mp_rom_map_elem_t mp_module_ujson_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR_dumps), MP_ROM_PTR(&mod_ujson_dumps_obj) },
     { MP_ROM_QSTR(MP_QSTR_load), MP_ROM_PTR(&mod_ujson_load_obj) },
     { MP_ROM_QSTR(MP_QSTR_loads), MP_ROM_PTR(&mod_ujson_loads_obj) },
+    { MP_ROM_QSTR(MP_QSTR_iterparse), MP_ROM_PTR(&mod_ujson_iterparse_obj) },
+    { MP_ROM_QSTR(MP_QSTR_START_OBJECT), MP_ROM_INT(UJSON_EV_START_OBJECT) },
+    { MP_ROM_QSTR(MP_QSTR_END_OBJECT), MP_ROM_INT(UJSON_EV_END_OBJECT) },
+    { MP_ROM_QSTR(MP_QSTR_START_ARRAY), MP_ROM_INT(UJSON_EV_START_ARRAY) },
+    { MP_ROM_QSTR(MP_QSTR_END_ARRAY), MP_ROM_INT(UJSON_EV_END_ARRAY) },
+    { MP_ROM_QSTR(MP_QSTR_KEY), MP_ROM_INT(UJSON_EV_KEY) },
+    { MP_ROM_QSTR(MP_QSTR_VALUE), MP_ROM_INT(UJSON_EV_VALUE) },
 };
 
 STATIC MP_DEFINE_CONST_DICT(mp_module_ujson_globals, mp_module_ujson_globals_table);
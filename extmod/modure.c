@@ -50,9 +50,42 @@ typedef struct _mp_obj_match_t {
     mp_obj_base_t base;
     int num_matches;
     mp_obj_t str;
+    // start of the subject when it was matched, the caps are relative to it
+    const char *begin;
     const char *caps[0];
 } mp_obj_match_t;
 
+// The subject can be a str, a bytes or anything with the buffer protocol, so
+// that bytearray and memoryview are matched in place.  Substrings of the
+// latter are returned as bytes.
+STATIC const char *ure_get_subject(mp_obj_t subject, size_t *len) {
+    if (mp_obj_is_str_or_bytes(subject)) {
+        return mp_obj_str_get_data(subject, len);
+    }
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(subject, &bufinfo, MP_BUFFER_READ);
+    *len = bufinfo.len;
+    return bufinfo.buf;
+}
+
+STATIC const mp_obj_type_t *ure_result_type(mp_obj_t subject) {
+    return mp_obj_is_str(subject) ? &mp_type_str : &mp_type_bytes;
+}
+
+// Gives the offsets of group no, or false if it didn't match.  A bytearray
+// may have been resized since the match, so the offsets are clipped to it.
+STATIC bool match_get_offsets(mp_obj_match_t *self, mp_int_t no, size_t *s, size_t *e, const char **subject) {
+    const char *start = self->caps[no * 2];
+    if (start == NULL) {
+        return false;
+    }
+    size_t len;
+    *subject = ure_get_subject(self->str, &len);
+    *s = MIN((size_t)(start - self->begin), len);
+    *e = MIN((size_t)(self->caps[no * 2 + 1] - self->begin), len);
+    return true;
+}
+
 
 STATIC void match_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
     (void)kind;
@@ -67,13 +100,13 @@ STATIC mp_obj_t match_group(mp_obj_t self_in, mp_obj_t no_in) {
         nlr_raise(mp_obj_new_exception_arg1(&mp_type_IndexError, no_in));
     }
 
-    const char *start = self->caps[no * 2];
-    if (start == NULL) {
+    size_t s, e;
+    const char *subject;
+    if (!match_get_offsets(self, no, &s, &e, &subject)) {
         // no match for this group
         return mp_const_none;
     }
-    return mp_obj_new_str_of_type(mp_obj_get_type(self->str),
-        (const byte*)start, self->caps[no * 2 + 1] - start);
+    return mp_obj_new_str_of_type(ure_result_type(self->str), (const byte*)subject + s, e - s);
 }
 MP_DEFINE_CONST_FUN_OBJ_2(match_group_obj, match_group);
 
@@ -109,12 +142,12 @@ STATIC void match_span_helper(size_t n_args, const mp_obj_t *args, mp_obj_t span
 
     mp_int_t s = -1;
     mp_int_t e = -1;
-    const char *start = self->caps[no * 2];
-    if (start != NULL) {
+    size_t start, end;
+    const char *subject;
+    if (match_get_offsets(self, no, &start, &end, &subject)) {
         // have a match for this group
-        const char *begin = mp_obj_str_get_str(self->str);
-        s = start - begin;
-        e = self->caps[no * 2 + 1] - begin;
+        s = start;
+        e = end;
     }
 
     span[0] = mp_obj_new_int(s);
@@ -176,7 +209,7 @@ STATIC mp_obj_t ure_exec(bool is_anchored, uint n_args, const mp_obj_t *args) {
     mp_obj_re_t *self = MP_OBJ_TO_PTR(args[0]);
     Subject subj;
     size_t len;
-    subj.begin = mp_obj_str_get_data(args[1], &len);
+    subj.begin = ure_get_subject(args[1], &len);
     subj.end = subj.begin + len;
     int caps_num = (self->re.sub + 1) * 2;
     mp_obj_match_t *match = m_new_obj_var(mp_obj_match_t, char*, caps_num);
@@ -191,6 +224,7 @@ STATIC mp_obj_t ure_exec(bool is_anchored, uint n_args, const mp_obj_t *args) {
     match->base.type = &match_type;
     match->num_matches = caps_num / 2; // caps_num counts start and end pointers
     match->str = args[1];
+    match->begin = subj.begin;
     return MP_OBJ_FROM_PTR(match);
 }
 
@@ -204,12 +238,61 @@ STATIC mp_obj_t re_search(size_t n_args, const mp_obj_t *args) {
 }
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(re_search_obj, 2, 4, re_search);
 
+#if MICROPY_PY_URE_SPANS
+
+// Like match()/search() but gives (start0, end0, start1, end1, ...), with -1
+// for the groups that didn't match, instead of a match object, for the
+// callers that only need to know where the groups are.
+STATIC mp_obj_t ure_exec_spans(bool is_anchored, mp_obj_t self_in, mp_obj_t subject) {
+    mp_obj_re_t *self = MP_OBJ_TO_PTR(self_in);
+    Subject subj;
+    size_t len;
+    subj.begin = ure_get_subject(subject, &len);
+    subj.end = subj.begin + len;
+    int caps_num = (self->re.sub + 1) * 2;
+    const char **caps = mp_local_alloc(caps_num * sizeof(char*));
+    // cast is a workaround for a bug in msvc (see above)
+    memset((char**)caps, 0, caps_num * sizeof(char*));
+    int res = re1_5_recursiveloopprog(&self->re, &subj, caps, caps_num, is_anchored);
+
+    mp_obj_t spans = mp_const_none;
+    if (res != 0) {
+        mp_obj_tuple_t *t = MP_OBJ_TO_PTR(mp_obj_new_tuple(caps_num, NULL));
+        for (int i = 0; i < caps_num; i += 2) {
+            mp_int_t s = -1;
+            mp_int_t e = -1;
+            if (caps[i] != NULL) {
+                s = caps[i] - subj.begin;
+                e = caps[i + 1] - subj.begin;
+            }
+            t->items[i] = mp_obj_new_int(s);
+            t->items[i + 1] = mp_obj_new_int(e);
+        }
+        spans = MP_OBJ_FROM_PTR(t);
+    }
+    // cast is a workaround for a bug in msvc (see above)
+    mp_local_free((char**)caps);
+    return spans;
+}
+
+STATIC mp_obj_t re_match_spans(mp_obj_t self_in, mp_obj_t subject) {
+    return ure_exec_spans(true, self_in, subject);
+}
+MP_DEFINE_CONST_FUN_OBJ_2(re_match_spans_obj, re_match_spans);
+
+STATIC mp_obj_t re_search_spans(mp_obj_t self_in, mp_obj_t subject) {
+    return ure_exec_spans(false, self_in, subject);
+}
+MP_DEFINE_CONST_FUN_OBJ_2(re_search_spans_obj, re_search_spans);
+
+#endif
+
 STATIC mp_obj_t re_split(size_t n_args, const mp_obj_t *args) {
     mp_obj_re_t *self = MP_OBJ_TO_PTR(args[0]);
     Subject subj;
     size_t len;
-    const mp_obj_type_t *str_type = mp_obj_get_type(args[1]);
-    subj.begin = mp_obj_str_get_data(args[1], &len);
+    const mp_obj_type_t *str_type = ure_result_type(args[1]);
+    subj.begin = ure_get_subject(args[1], &len);
     subj.end = subj.begin + len;
     int caps_num = (self->re.sub + 1) * 2;
 
@@ -262,7 +345,7 @@ STATIC mp_obj_t re_sub_helper(mp_obj_t self_in, size_t n_args, const mp_obj_t *a
     }
 
     size_t where_len;
-    const char *where_str = mp_obj_str_get_data(where, &where_len);
+    const char *where_str = ure_get_subject(where, &where_len);
     Subject subj;
     subj.begin = where_str;
     subj.end = subj.begin + where_len;
@@ -274,6 +357,7 @@ STATIC mp_obj_t re_sub_helper(mp_obj_t self_in, size_t n_args, const mp_obj_t *a
     match->base.type = &match_type;
     match->num_matches = caps_num / 2; // caps_num counts start and end pointers
     match->str = where;
+    match->begin = where_str;
 
     for (;;) {
         // cast is a workaround for a bug in msvc: it treats const char** as a const pointer instead of a pointer to pointer to const char
@@ -347,13 +431,16 @@ STATIC mp_obj_t re_sub_helper(mp_obj_t self_in, size_t n_args, const mp_obj_t *a
 
     if (vstr_return.buf == NULL) {
         // Optimisation for case of no substitutions
-        return where;
+        if (mp_obj_is_str_or_bytes(where)) {
+            return where;
+        }
+        return mp_obj_new_bytes((const byte*)where_str, where_len);
     }
 
     // Add post-match string
     vstr_add_strn(&vstr_return, subj.begin, subj.end - subj.begin);
 
-    return mp_obj_new_str_from_vstr(mp_obj_get_type(where), &vstr_return);
+    return mp_obj_new_str_from_vstr(ure_result_type(where), &vstr_return);
 }
 
 STATIC mp_obj_t re_sub(size_t n_args, const mp_obj_t *args) {
@@ -366,6 +453,10 @@ MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(re_sub_obj, 3, 5, re_sub);
 STATIC const mp_rom_map_elem_t re_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_match), MP_ROM_PTR(&re_match_obj) },
     { MP_ROM_QSTR(MP_QSTR_search), MP_ROM_PTR(&re_search_obj) },
+    #if MICROPY_PY_URE_SPANS
+    { MP_ROM_QSTR(MP_QSTR_match_spans), MP_ROM_PTR(&re_match_spans_obj) },
+    { MP_ROM_QSTR(MP_QSTR_search_spans), MP_ROM_PTR(&re_search_spans_obj) },
+    #endif
     { MP_ROM_QSTR(MP_QSTR_split), MP_ROM_PTR(&re_split_obj) },
     #if MICROPY_PY_URE_SUB
     { MP_ROM_QSTR(MP_QSTR_sub), MP_ROM_PTR(&re_sub_obj) },
@@ -405,9 +496,50 @@ error:
 }
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_re_compile_obj, 1, 2, mod_re_compile);
 
+#if MICROPY_PY_URE_CACHE_SIZE
+STATIC bool mod_re_cache_hit(mp_obj_t cached, mp_obj_t pattern) {
+    if (cached == pattern) {
+        return true;
+    }
+    // a str pattern never equals a bytes one, don't let mp_obj_equal() warn about it
+    if (cached == MP_OBJ_NULL || mp_obj_is_str(cached) != mp_obj_is_str(pattern)) {
+        return false;
+    }
+    return mp_obj_equal(cached, pattern);
+}
+#endif
+
+// The module-level functions get the compiled patterns from a small cache, most
+// recently used first, instead of compiling them again on every call.
+STATIC mp_obj_t mod_re_compile_cached(mp_obj_t pattern) {
+    #if MICROPY_PY_URE_CACHE_SIZE
+    mp_obj_t *cache = MP_STATE_VM(ure_cache);
+    size_t i = 0;
+    for (; i < MICROPY_PY_URE_CACHE_SIZE - 1; ++i) {
+        if (cache[i * 2] == MP_OBJ_NULL || mod_re_cache_hit(cache[i * 2], pattern)) {
+            break;
+        }
+    }
+    mp_obj_t re;
+    if (mod_re_cache_hit(cache[i * 2], pattern)) {
+        pattern = cache[i * 2];
+        re = cache[i * 2 + 1];
+    } else {
+        // a miss evicts the least recently used entry, the last one
+        re = mod_re_compile(1, &pattern);
+    }
+    memmove(&cache[2], &cache[0], i * 2 * sizeof(mp_obj_t));
+    cache[0] = pattern;
+    cache[1] = re;
+    return re;
+    #else
+    return mod_re_compile(1, &pattern);
+    #endif
+}
+
 STATIC mp_obj_t mod_re_exec(bool is_anchored, uint n_args, const mp_obj_t *args) {
     (void)n_args;
-    mp_obj_t self = mod_re_compile(1, args);
+    mp_obj_t self = mod_re_compile_cached(args[0]);
 
     const mp_obj_t args2[] = {self, args[1]};
     mp_obj_t match = ure_exec(is_anchored, 2, args2);
@@ -426,7 +558,7 @@ MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_re_search_obj, 2, 4, mod_re_search);
 
 #if MICROPY_PY_URE_SUB
 STATIC mp_obj_t mod_re_sub(size_t n_args, const mp_obj_t *args) {
-    mp_obj_t self = mod_re_compile(1, args);
+    mp_obj_t self = mod_re_compile_cached(args[0]);
     return re_sub_helper(self, n_args, args);
 }
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_re_sub_obj, 3, 5, mod_re_sub);
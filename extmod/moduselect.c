@@ -36,21 +36,21 @@
 #include "py/stream.h"
 #include "py/mperrno.h"
 #include "py/mphal.h"
+#include "extmod/moduselect.h"
 
 // Flags for poll()
 #define FLAG_ONESHOT (1)
 
+#if MICROPY_PY_USELECT_PORT_WAIT
+#define USELECT_WAIT(poll_map, timeout) mp_uselect_port_wait(poll_map, timeout)
+#else
+#define USELECT_WAIT(poll_map, timeout) MICROPY_EVENT_POLL_HOOK
+#endif
+
 /// \module select - Provides select function to wait for events on a stream
 ///
 /// This module provides the select function.
 
-typedef struct _poll_obj_t {
-    mp_obj_t obj;
-    mp_uint_t (*ioctl)(mp_obj_t obj, mp_uint_t request, uintptr_t arg, int *errcode);
-    mp_uint_t flags;
-    mp_uint_t flags_ret;
-} poll_obj_t;
-
 STATIC void poll_map_add(mp_map_t *poll_map, const mp_obj_t *obj, mp_uint_t obj_len, mp_uint_t flags, bool or_flags) {
     for (mp_uint_t i = 0; i < obj_len; i++) {
         mp_map_elem_t *elem = mp_map_lookup(poll_map, mp_obj_id(obj[i]), MP_MAP_LOOKUP_ADD_IF_NOT_FOUND);
@@ -147,8 +147,9 @@ STATIC mp_obj_t select_select(size_t n_args, const mp_obj_t *args) {
     for (;;) {
         // poll the objects
         mp_uint_t n_ready = poll_map_poll(&poll_map, rwx_len);
+        mp_uint_t elapsed = mp_hal_ticks_ms() - start_tick;
 
-        if (n_ready > 0 || (timeout != -1 && mp_hal_ticks_ms() - start_tick >= timeout)) {
+        if (n_ready > 0 || (timeout != -1 && elapsed >= timeout)) {
             // one or more objects are ready, or we had a timeout
             mp_obj_t list_array[3];
             list_array[0] = mp_obj_new_list(rwx_len[0], NULL);
@@ -173,7 +174,7 @@ STATIC mp_obj_t select_select(size_t n_args, const mp_obj_t *args) {
             mp_map_deinit(&poll_map);
             return mp_obj_new_tuple(3, list_array);
         }
-        MICROPY_EVENT_POLL_HOOK
+        USELECT_WAIT(&poll_map, timeout == (mp_uint_t)-1 ? timeout : timeout - elapsed);
     }
 }
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_select_select_obj, 3, 4, select_select);
@@ -250,10 +251,11 @@ STATIC mp_uint_t poll_poll_internal(uint n_args, const mp_obj_t *args) {
     for (;;) {
         // poll the objects
         n_ready = poll_map_poll(&self->poll_map, NULL);
-        if (n_ready > 0 || (timeout != -1 && mp_hal_ticks_ms() - start_tick >= timeout)) {
+        mp_uint_t elapsed = mp_hal_ticks_ms() - start_tick;
+        if (n_ready > 0 || (timeout != -1 && elapsed >= timeout)) {
             break;
         }
-        MICROPY_EVENT_POLL_HOOK
+        USELECT_WAIT(&self->poll_map, timeout == (mp_uint_t)-1 ? timeout : timeout - elapsed);
     }
 
     return n_ready;
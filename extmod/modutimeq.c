@@ -39,17 +39,26 @@
 
 // the algorithm here is modelled on CPython's heapq.py
 
+// Each entry has a slot, which stays the same while the entry moves around the
+// heap and keeps its position in the heap.  push() returns a handle made of the
+// slot and of the id of the push, so that remove() and reschedule() find the
+// entry in O(1) and tell a handle of an entry already gone from one that reuses
+// its slot.
 struct qentry {
     mp_uint_t time;
     mp_uint_t id;
     mp_obj_t callback;
     mp_obj_t args;
+    mp_uint_t handle;
 };
 
 typedef struct _mp_obj_utimeq_t {
     mp_obj_base_t base;
     mp_uint_t alloc;
     mp_uint_t len;
+    mp_uint_t *pos; // by slot: the position in items[], or alloc + the next free slot
+    mp_uint_t free;
+    byte slot_bits;
     struct qentry items[];
 } mp_obj_utimeq_t;
 
@@ -59,6 +68,29 @@ STATIC mp_obj_utimeq_t *get_heap(mp_obj_t heap_in) {
     return MP_OBJ_TO_PTR(heap_in);
 }
 
+static inline mp_uint_t heap_slot(mp_obj_utimeq_t *heap, mp_uint_t handle) {
+    return handle & ((1 << heap->slot_bits) - 1);
+}
+
+static inline void heap_put(mp_obj_utimeq_t *heap, mp_uint_t pos, const struct qentry *item) {
+    heap->items[pos] = *item;
+    heap->pos[heap_slot(heap, item->handle)] = pos;
+}
+
+// The position of the entry of a handle, or -1 if it's no longer in the queue
+STATIC mp_int_t heap_find(mp_obj_utimeq_t *heap, mp_obj_t handle_in) {
+    mp_uint_t handle = mp_obj_get_int(handle_in);
+    mp_uint_t slot = heap_slot(heap, handle);
+    if (slot >= heap->alloc) {
+        return -1;
+    }
+    mp_uint_t pos = heap->pos[slot];
+    if (pos >= heap->alloc || heap->items[pos].handle != handle) {
+        return -1;
+    }
+    return pos;
+}
+
 STATIC bool time_less_than(struct qentry *item, struct qentry *parent) {
     mp_uint_t item_tm = item->time;
     mp_uint_t parent_tm = parent->time;
@@ -77,11 +109,21 @@ STATIC bool time_less_than(struct qentry *item, struct qentry *parent) {
 STATIC mp_obj_t utimeq_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
     mp_arg_check_num(n_args, n_kw, 1, 1, false);
     mp_uint_t alloc = mp_obj_get_int(args[0]);
-    mp_obj_utimeq_t *o = m_new_obj_var(mp_obj_utimeq_t, struct qentry, alloc);
+    // the position table is allocated along with the entries
+    mp_obj_utimeq_t *o = m_new_obj_var(mp_obj_utimeq_t, byte, (sizeof(struct qentry) + sizeof(mp_uint_t)) * alloc);
     o->base.type = type;
     memset(o->items, 0, sizeof(*o->items) * alloc);
     o->alloc = alloc;
     o->len = 0;
+    o->pos = (mp_uint_t*)&o->items[alloc];
+    for (mp_uint_t i = 0; i < alloc; i++) {
+        o->pos[i] = alloc + i + 1;
+    }
+    o->free = 0;
+    o->slot_bits = 0;
+    while (((mp_uint_t)1 << o->slot_bits) < alloc) {
+        o->slot_bits++;
+    }
     return MP_OBJ_FROM_PTR(o);
 }
 
@@ -92,13 +134,13 @@ STATIC void heap_siftdown(mp_obj_utimeq_t *heap, mp_uint_t start_pos, mp_uint_t
         struct qentry *parent = &heap->items[parent_pos];
         bool lessthan = time_less_than(&item, parent);
         if (lessthan) {
-            heap->items[pos] = *parent;
+            heap_put(heap, pos, parent);
             pos = parent_pos;
         } else {
             break;
         }
     }
-    heap->items[pos] = item;
+    heap_put(heap, pos, &item);
 }
 
 STATIC void heap_siftup(mp_obj_utimeq_t *heap, mp_uint_t pos) {
@@ -114,13 +156,29 @@ STATIC void heap_siftup(mp_obj_utimeq_t *heap, mp_uint_t pos) {
             }
         }
         // bubble up the smaller child
-        heap->items[pos] = heap->items[child_pos];
+        heap_put(heap, pos, &heap->items[child_pos]);
         pos = child_pos;
     }
-    heap->items[pos] = item;
+    heap_put(heap, pos, &item);
     heap_siftdown(heap, start_pos, pos);
 }
 
+// Take the entry at pos out of the queue
+STATIC void heap_remove(mp_obj_utimeq_t *heap, mp_uint_t pos) {
+    mp_uint_t slot = heap_slot(heap, heap->items[pos].handle);
+    heap->pos[slot] = heap->alloc + heap->free;
+    heap->free = slot;
+    heap->len -= 1;
+    if (pos != heap->len) {
+        // the last entry fills the hole, and goes up or down from there
+        heap_put(heap, pos, &heap->items[heap->len]);
+        heap_siftdown(heap, 0, pos);
+        heap_siftup(heap, heap->pos[heap_slot(heap, heap->items[heap->len].handle)]);
+    }
+    heap->items[heap->len].callback = MP_OBJ_NULL; // so we don't retain a pointer
+    heap->items[heap->len].args = MP_OBJ_NULL;
+}
+
 STATIC mp_obj_t mod_utimeq_heappush(size_t n_args, const mp_obj_t *args) {
     (void)n_args;
     mp_obj_t heap_in = args[0];
@@ -129,13 +187,17 @@ STATIC mp_obj_t mod_utimeq_heappush(size_t n_args, const mp_obj_t *args) {
         mp_raise_msg(&mp_type_IndexError, "queue overflow");
     }
     mp_uint_t l = heap->len;
+    mp_uint_t slot = heap->free;
+    heap->free = heap->pos[slot] - heap->alloc;
     heap->items[l].time = MP_OBJ_SMALL_INT_VALUE(args[1]);
     heap->items[l].id = utimeq_id++;
     heap->items[l].callback = args[2];
     heap->items[l].args = args[3];
+    heap->items[l].handle = ((heap->items[l].id << heap->slot_bits) | slot) & MP_SMALL_INT_POSITIVE_MASK;
+    heap->pos[slot] = l;
     heap_siftdown(heap, 0, heap->len);
     heap->len++;
-    return mp_const_none;
+    return MP_OBJ_NEW_SMALL_INT(heap->items[heap->pos[slot]].handle);
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_utimeq_heappush_obj, 4, 4, mod_utimeq_heappush);
 
@@ -153,17 +215,39 @@ STATIC mp_obj_t mod_utimeq_heappop(mp_obj_t heap_in, mp_obj_t list_ref) {
     ret->items[0] = MP_OBJ_NEW_SMALL_INT(item->time);
     ret->items[1] = item->callback;
     ret->items[2] = item->args;
-    heap->len -= 1;
-    heap->items[0] = heap->items[heap->len];
-    heap->items[heap->len].callback = MP_OBJ_NULL; // so we don't retain a pointer
-    heap->items[heap->len].args = MP_OBJ_NULL;
-    if (heap->len) {
-        heap_siftup(heap, 0);
-    }
+    heap_remove(heap, 0);
     return mp_const_none;
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_utimeq_heappop_obj, mod_utimeq_heappop);
 
+STATIC mp_obj_t mod_utimeq_remove(mp_obj_t heap_in, mp_obj_t handle_in) {
+    mp_obj_utimeq_t *heap = get_heap(heap_in);
+    mp_int_t pos = heap_find(heap, handle_in);
+    if (pos < 0) {
+        return mp_const_false;
+    }
+    heap_remove(heap, pos);
+    return mp_const_true;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(mod_utimeq_remove_obj, mod_utimeq_remove);
+
+// The entry keeps its handle, and goes after the ones already due at the same time
+STATIC mp_obj_t mod_utimeq_reschedule(mp_obj_t heap_in, mp_obj_t handle_in, mp_obj_t time_in) {
+    mp_obj_utimeq_t *heap = get_heap(heap_in);
+    mp_int_t pos = heap_find(heap, handle_in);
+    if (pos < 0) {
+        return mp_const_false;
+    }
+    struct qentry *item = &heap->items[pos];
+    mp_uint_t slot = heap_slot(heap, item->handle);
+    item->time = MP_OBJ_SMALL_INT_VALUE(time_in);
+    item->id = utimeq_id++;
+    heap_siftdown(heap, 0, pos);
+    heap_siftup(heap, heap->pos[slot]);
+    return mp_const_true;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(mod_utimeq_reschedule_obj, mod_utimeq_reschedule);
+
 STATIC mp_obj_t mod_utimeq_peektime(mp_obj_t heap_in) {
     mp_obj_utimeq_t *heap = get_heap(heap_in);
     if (heap->len == 0) {
@@ -200,6 +284,8 @@ STATIC const mp_rom_map_elem_t utimeq_locals_dict_table[] = {
     { MP_ROM_QSTR(MP_QSTR_push), MP_ROM_PTR(&mod_utimeq_heappush_obj) },
     { MP_ROM_QSTR(MP_QSTR_pop), MP_ROM_PTR(&mod_utimeq_heappop_obj) },
     { MP_ROM_QSTR(MP_QSTR_peektime), MP_ROM_PTR(&mod_utimeq_peektime_obj) },
+    { MP_ROM_QSTR(MP_QSTR_remove), MP_ROM_PTR(&mod_utimeq_remove_obj) },
+    { MP_ROM_QSTR(MP_QSTR_reschedule), MP_ROM_PTR(&mod_utimeq_reschedule_obj) },
     #if DEBUG
     { MP_ROM_QSTR(MP_QSTR_dump), MP_ROM_PTR(&mod_utimeq_dump_obj) },
     #endif
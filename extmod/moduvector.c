@@ -0,0 +1,369 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021, Pycom Limited.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdint.h>
+
+#include "py/runtime.h"
+#include "py/binary.h"
+
+#if MICROPY_PY_UVECTOR
+
+// Elementwise arithmetic and reductions over anything with the buffer
+// protocol (array, memoryview, bytearray, bytes).  Elements are read and
+// written according to the buffer's typecode.  Results are written into a
+// caller supplied destination, which may be one of the sources, so nothing
+// is allocated per call.
+//
+// Arithmetic is done in floating point if any operand is a float array or
+// a float scalar, otherwise in integers.  Stores into integer arrays wrap
+// the same way as assigning to an array element does.
+
+typedef struct _vec_t {
+    char typecode;
+    size_t len;
+    void *buf;
+} vec_t;
+
+#if MICROPY_PY_BUILTINS_FLOAT
+#define VEC_IS_FLOAT(typecode) ((typecode) == 'f' || (typecode) == 'd')
+#else
+#define VEC_IS_FLOAT(typecode) (0)
+#endif
+
+STATIC void vec_get(mp_obj_t obj, vec_t *v, mp_uint_t flags) {
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(obj, &bufinfo, flags);
+    char typecode = bufinfo.typecode == BYTEARRAY_TYPECODE ? 'B' : bufinfo.typecode;
+    switch (typecode) {
+        case 'b': case 'B': case 'h': case 'H':
+        case 'i': case 'I': case 'l': case 'L':
+        #if MICROPY_PY_BUILTINS_FLOAT
+        case 'f':
+        case 'd':
+        #endif
+            break;
+        default:
+            mp_raise_TypeError("unsupported array type");
+    }
+    v->typecode = typecode;
+    v->len = bufinfo.len / mp_binary_get_size('@', typecode, NULL);
+    v->buf = bufinfo.buf;
+}
+
+STATIC void vec_check_len(const vec_t *v, size_t len) {
+    if (v->len != len) {
+        mp_raise_ValueError("array lengths differ");
+    }
+}
+
+static inline long long vec_get_int(const vec_t *v, size_t i) {
+    switch (v->typecode) {
+        case 'b': return ((int8_t*)v->buf)[i];
+        case 'B': return ((uint8_t*)v->buf)[i];
+        case 'h': return ((int16_t*)v->buf)[i];
+        case 'H': return ((uint16_t*)v->buf)[i];
+        case 'i': return ((int*)v->buf)[i];
+        case 'I': return ((unsigned int*)v->buf)[i];
+        case 'l': return ((long*)v->buf)[i];
+        case 'L': return ((unsigned long*)v->buf)[i];
+        #if MICROPY_PY_BUILTINS_FLOAT
+        case 'f': return (long long)((float*)v->buf)[i];
+        case 'd': return (long long)((double*)v->buf)[i];
+        #endif
+    }
+    return 0;
+}
+
+static inline void vec_set_int(const vec_t *v, size_t i, mp_int_t val) {
+    switch (v->typecode) {
+        case 'b': case 'B': ((uint8_t*)v->buf)[i] = val; break;
+        case 'h': case 'H': ((uint16_t*)v->buf)[i] = val; break;
+        case 'i': case 'I': ((unsigned int*)v->buf)[i] = val; break;
+        case 'l': case 'L': ((unsigned long*)v->buf)[i] = val; break;
+        #if MICROPY_PY_BUILTINS_FLOAT
+        case 'f': ((float*)v->buf)[i] = val; break;
+        case 'd': ((double*)v->buf)[i] = val; break;
+        #endif
+    }
+}
+
+#if MICROPY_PY_BUILTINS_FLOAT
+static inline mp_float_t vec_get_float(const vec_t *v, size_t i) {
+    switch (v->typecode) {
+        case 'f': return ((float*)v->buf)[i];
+        case 'd': return ((double*)v->buf)[i];
+    }
+    return (mp_float_t)vec_get_int(v, i);
+}
+
+static inline void vec_set_float(const vec_t *v, size_t i, mp_float_t val) {
+    switch (v->typecode) {
+        case 'f': ((float*)v->buf)[i] = val; break;
+        case 'd': ((double*)v->buf)[i] = val; break;
+        default: vec_set_int(v, i, (mp_int_t)val); break;
+    }
+}
+#endif
+
+/******************************************************************************/
+// elementwise operations
+
+enum { VEC_OP_ADD, VEC_OP_MUL, VEC_OP_SCALE };
+
+// an operand that is either an array or a scalar
+typedef struct _vec_arg_t {
+    bool is_vec;
+    bool is_float;
+    vec_t vec;
+    mp_int_t i;
+    #if MICROPY_PY_BUILTINS_FLOAT
+    mp_float_t f;
+    #endif
+} vec_arg_t;
+
+STATIC void vec_get_arg(mp_obj_t obj, vec_arg_t *arg, bool allow_vec) {
+    arg->is_vec = false;
+    arg->is_float = false;
+    arg->i = 0;
+    if (mp_obj_is_int(obj)) {
+        arg->i = mp_obj_get_int_truncated(obj);
+        #if MICROPY_PY_BUILTINS_FLOAT
+        arg->f = arg->i;
+        #endif
+    #if MICROPY_PY_BUILTINS_FLOAT
+    } else if (mp_obj_is_float(obj)) {
+        arg->is_float = true;
+        arg->f = mp_obj_float_get(obj);
+    #endif
+    } else if (allow_vec) {
+        arg->is_vec = true;
+        vec_get(obj, &arg->vec, MP_BUFFER_READ);
+        arg->is_float = VEC_IS_FLOAT(arg->vec.typecode);
+    } else {
+        mp_raise_TypeError(NULL);
+    }
+}
+
+STATIC void vec_elementwise(int op, mp_obj_t dst_in, mp_obj_t a_in, mp_obj_t b_in, mp_obj_t c_in) {
+    vec_t dst, a;
+    vec_arg_t b, c;
+    vec_get(dst_in, &dst, MP_BUFFER_WRITE);
+    vec_get(a_in, &a, MP_BUFFER_READ);
+    vec_check_len(&a, dst.len);
+    vec_get_arg(b_in, &b, op != VEC_OP_SCALE);
+    if (b.is_vec) {
+        vec_check_len(&b.vec, dst.len);
+    }
+    vec_get_arg(c_in, &c, false);
+
+    #if MICROPY_PY_BUILTINS_FLOAT
+    if (VEC_IS_FLOAT(a.typecode) || b.is_float || c.is_float) {
+        for (size_t i = 0; i < dst.len; ++i) {
+            mp_float_t x = vec_get_float(&a, i);
+            mp_float_t y = b.is_vec ? vec_get_float(&b.vec, i) : b.f;
+            switch (op) {
+                case VEC_OP_ADD: x += y; break;
+                case VEC_OP_MUL: x *= y; break;
+                default: x = x * y + c.f; break;
+            }
+            vec_set_float(&dst, i, x);
+        }
+        return;
+    }
+    #endif
+
+    // unsigned so that overflow wraps rather than being undefined
+    for (size_t i = 0; i < dst.len; ++i) {
+        mp_uint_t x = vec_get_int(&a, i);
+        mp_uint_t y = b.is_vec ? vec_get_int(&b.vec, i) : (mp_uint_t)b.i;
+        switch (op) {
+            case VEC_OP_ADD: x += y; break;
+            case VEC_OP_MUL: x *= y; break;
+            default: x = x * y + c.i; break;
+        }
+        vec_set_int(&dst, i, x);
+    }
+}
+
+STATIC mp_obj_t uvector_add(mp_obj_t dst_in, mp_obj_t a_in, mp_obj_t b_in) {
+    vec_elementwise(VEC_OP_ADD, dst_in, a_in, b_in, MP_OBJ_NEW_SMALL_INT(0));
+    return dst_in;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(uvector_add_obj, uvector_add);
+
+STATIC mp_obj_t uvector_mul(mp_obj_t dst_in, mp_obj_t a_in, mp_obj_t b_in) {
+    vec_elementwise(VEC_OP_MUL, dst_in, a_in, b_in, MP_OBJ_NEW_SMALL_INT(0));
+    return dst_in;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_3(uvector_mul_obj, uvector_mul);
+
+// scale(dst, src, k[, offset]): dst = src * k + offset, also used to convert
+// integer samples into a float array
+STATIC mp_obj_t uvector_scale(size_t n_args, const mp_obj_t *args) {
+    vec_elementwise(VEC_OP_SCALE, args[0], args[1], args[2], n_args > 3 ? args[3] : MP_OBJ_NEW_SMALL_INT(0));
+    return args[0];
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(uvector_scale_obj, 3, 4, uvector_scale);
+
+/******************************************************************************/
+// reductions
+
+enum { VEC_RED_SUM, VEC_RED_MIN, VEC_RED_MAX };
+
+STATIC mp_obj_t vec_reduce(int op, mp_obj_t a_in) {
+    vec_t a;
+    vec_get(a_in, &a, MP_BUFFER_READ);
+    if (op != VEC_RED_SUM && a.len == 0) {
+        mp_raise_ValueError("empty array");
+    }
+
+    #if MICROPY_PY_BUILTINS_FLOAT
+    if (VEC_IS_FLOAT(a.typecode)) {
+        mp_float_t acc = op == VEC_RED_SUM ? 0 : vec_get_float(&a, 0);
+        for (size_t i = 0; i < a.len; ++i) {
+            mp_float_t x = vec_get_float(&a, i);
+            if (op == VEC_RED_SUM) {
+                acc += x;
+            } else if (op == VEC_RED_MIN ? x < acc : x > acc) {
+                acc = x;
+            }
+        }
+        return mp_obj_new_float(acc);
+    }
+    #endif
+
+    long long acc = op == VEC_RED_SUM ? 0 : vec_get_int(&a, 0);
+    for (size_t i = 0; i < a.len; ++i) {
+        long long x = vec_get_int(&a, i);
+        if (op == VEC_RED_SUM) {
+            acc += x;
+        } else if (op == VEC_RED_MIN ? x < acc : x > acc) {
+            acc = x;
+        }
+    }
+    return mp_obj_new_int_from_ll(acc);
+}
+
+STATIC mp_obj_t uvector_sum(mp_obj_t a_in) {
+    return vec_reduce(VEC_RED_SUM, a_in);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(uvector_sum_obj, uvector_sum);
+
+STATIC mp_obj_t uvector_min(mp_obj_t a_in) {
+    return vec_reduce(VEC_RED_MIN, a_in);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(uvector_min_obj, uvector_min);
+
+STATIC mp_obj_t uvector_max(mp_obj_t a_in) {
+    return vec_reduce(VEC_RED_MAX, a_in);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(uvector_max_obj, uvector_max);
+
+STATIC mp_obj_t uvector_dot(mp_obj_t a_in, mp_obj_t b_in) {
+    vec_t a, b;
+    vec_get(a_in, &a, MP_BUFFER_READ);
+    vec_get(b_in, &b, MP_BUFFER_READ);
+    vec_check_len(&b, a.len);
+
+    #if MICROPY_PY_BUILTINS_FLOAT
+    if (VEC_IS_FLOAT(a.typecode) || VEC_IS_FLOAT(b.typecode)) {
+        mp_float_t acc = 0;
+        for (size_t i = 0; i < a.len; ++i) {
+            acc += vec_get_float(&a, i) * vec_get_float(&b, i);
+        }
+        return mp_obj_new_float(acc);
+    }
+    #endif
+
+    long long acc = 0;
+    for (size_t i = 0; i < a.len; ++i) {
+        acc += vec_get_int(&a, i) * vec_get_int(&b, i);
+    }
+    return mp_obj_new_int_from_ll(acc);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(uvector_dot_obj, uvector_dot);
+
+// fir(dst, src, taps[, shift]): dst[n] = sum(taps[k] * src[n + len(taps) - 1 - k])
+// src must hold len(taps) - 1 samples of history ahead of the len(dst) new
+// ones; integer results are shifted right by shift for fixed-point taps
+STATIC mp_obj_t uvector_fir(size_t n_args, const mp_obj_t *args) {
+    vec_t dst, src, taps;
+    vec_get(args[0], &dst, MP_BUFFER_WRITE);
+    vec_get(args[1], &src, MP_BUFFER_READ);
+    vec_get(args[2], &taps, MP_BUFFER_READ);
+    mp_int_t shift = n_args > 3 ? mp_obj_get_int(args[3]) : 0;
+    if (taps.len == 0 || src.len < dst.len + taps.len - 1) {
+        mp_raise_ValueError("src too short");
+    }
+    if (shift < 0 || shift > 62) {
+        mp_raise_ValueError(NULL);
+    }
+    size_t last = taps.len - 1;
+
+    #if MICROPY_PY_BUILTINS_FLOAT
+    if (VEC_IS_FLOAT(src.typecode) || VEC_IS_FLOAT(taps.typecode)) {
+        for (size_t n = 0; n < dst.len; ++n) {
+            mp_float_t acc = 0;
+            for (size_t k = 0; k <= last; ++k) {
+                acc += vec_get_float(&taps, k) * vec_get_float(&src, n + last - k);
+            }
+            vec_set_float(&dst, n, acc);
+        }
+        return args[0];
+    }
+    #endif
+
+    for (size_t n = 0; n < dst.len; ++n) {
+        long long acc = 0;
+        for (size_t k = 0; k <= last; ++k) {
+            acc += vec_get_int(&taps, k) * vec_get_int(&src, n + last - k);
+        }
+        vec_set_int(&dst, n, (mp_int_t)(acc >> shift));
+    }
+    return args[0];
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(uvector_fir_obj, 3, 4, uvector_fir);
+
+STATIC const mp_rom_map_elem_t mp_module_uvector_globals_table[] = {
+    { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_uvector) },
+    { MP_ROM_QSTR(MP_QSTR_add), MP_ROM_PTR(&uvector_add_obj) },
+    { MP_ROM_QSTR(MP_QSTR_mul), MP_ROM_PTR(&uvector_mul_obj) },
+    { MP_ROM_QSTR(MP_QSTR_scale), MP_ROM_PTR(&uvector_scale_obj) },
+    { MP_ROM_QSTR(MP_QSTR_sum), MP_ROM_PTR(&uvector_sum_obj) },
+    { MP_ROM_QSTR(MP_QSTR_min), MP_ROM_PTR(&uvector_min_obj) },
+    { MP_ROM_QSTR(MP_QSTR_max), MP_ROM_PTR(&uvector_max_obj) },
+    { MP_ROM_QSTR(MP_QSTR_dot), MP_ROM_PTR(&uvector_dot_obj) },
+    { MP_ROM_QSTR(MP_QSTR_fir), MP_ROM_PTR(&uvector_fir_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(mp_module_uvector_globals, mp_module_uvector_globals_table);
+
+const mp_obj_module_t mp_module_uvector = {
+    .base = { &mp_type_module },
+    .globals = (mp_obj_dict_t*)&mp_module_uvector_globals,
+};
+
+#endif // MICROPY_PY_UVECTOR
@@ -38,6 +38,9 @@ enum { FRAME_HEADER, FRAME_OPT, PAYLOAD, CONTROL };
 
 enum { BLOCKING_WRITE = 0x80 };
 
+// frames up to this size are sent with their header in a single write
+#define WEBSOCKET_WRITE_COALESCE (125)
+
 typedef struct _mp_obj_websocket_t {
     mp_obj_base_t base;
     mp_obj_t sock;
@@ -47,7 +50,7 @@ typedef struct _mp_obj_websocket_t {
     byte to_recv;
     byte mask_pos;
     byte buf_pos;
-    byte buf[6];
+    byte buf[12];
     byte opts;
     // Copy of last data frame flags
     byte ws_flags;
@@ -57,6 +60,36 @@ typedef struct _mp_obj_websocket_t {
 
 STATIC mp_uint_t websocket_write(mp_obj_t self_in, const void *buf, mp_uint_t size, int *errcode);
 
+// XOR the payload with the mask, a word at a time once p is aligned
+STATIC void websocket_unmask(mp_obj_websocket_t *self, byte *p, size_t sz) {
+    uint32_t mask;
+    memcpy(&mask, self->mask, sizeof(mask));
+    if (mask == 0) {
+        // unmasked frame
+        return;
+    }
+    for (; sz > 0 && ((uintptr_t)p & 3) != 0; sz--) {
+        *p++ ^= self->mask[self->mask_pos++ & 3];
+    }
+    if (sz >= 4) {
+        // the mask as it lines up with the words from here on
+        byte m[4];
+        for (int i = 0; i < 4; i++) {
+            m[i] = self->mask[(self->mask_pos + i) & 3];
+        }
+        memcpy(&mask, m, sizeof(mask));
+        uint32_t *w = (uint32_t*)p;
+        for (size_t n = sz / 4; n > 0; n--) {
+            *w++ ^= mask;
+        }
+        p = (byte*)w;
+        sz &= 3;
+    }
+    for (; sz > 0; sz--) {
+        *p++ ^= self->mask[self->mask_pos++ & 3];
+    }
+}
+
 STATIC mp_obj_t websocket_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
     mp_arg_check_num(n_args, n_kw, 1, 2, false);
     mp_get_stream_raise(args[0], MP_STREAM_OP_READ | MP_STREAM_OP_WRITE | MP_STREAM_OP_IOCTL);
@@ -93,9 +126,8 @@ STATIC mp_uint_t websocket_read(mp_obj_t self_in, void *buf, mp_uint_t size, int
 
         switch (self->state) {
             case FRAME_HEADER: {
-                // TODO: Split frame handling below is untested so far, so conservatively disable it
-                assert(self->buf[0] & 0x80);
-
+                // Fragments of a split message are passed on as they come, like
+                // any other data frame, so a message of any size is never buffered.
                 // "Control frames MAY be injected in the middle of a fragmented message."
                 // So, they must be processed before data frames (and not alter
                 // self->ws_flags)
@@ -121,7 +153,7 @@ STATIC mp_uint_t websocket_read(mp_obj_t self_in, void *buf, mp_uint_t size, int
                     to_recv += 2;
                 } else if (sz == 127) {
                     // Msg size is next 8 bytes
-                    assert(0);
+                    to_recv += 8;
                 }
                 if (self->buf[1] & 0x80) {
                     // Next 4 bytes is mask
@@ -144,12 +176,19 @@ STATIC mp_uint_t websocket_read(mp_obj_t self_in, void *buf, mp_uint_t size, int
             }
 
             case FRAME_OPT: {
-                if ((self->buf_pos & 3) == 2) {
+                if (self->msg_sz == 126) {
                     // First two bytes are message length
                     self->msg_sz = (self->buf[0] << 8) | self->buf[1];
+                } else if (self->msg_sz == 127) {
+                    // First eight bytes are message length, we can't take 4GB or more
+                    if (self->buf[0] | self->buf[1] | self->buf[2] | self->buf[3]) {
+                        *errcode = MP_EFBIG;
+                        return MP_STREAM_ERROR;
+                    }
+                    self->msg_sz = ((uint32_t)self->buf[4] << 24) | (self->buf[5] << 16) | (self->buf[6] << 8) | self->buf[7];
                 }
-                if (self->buf_pos >= 4) {
-                    // Last 4 bytes is mask
+                if (self->buf_pos & 4) {
+                    // 4, 6 or 12 bytes were received, the last 4 are the mask
                     memcpy(self->mask, self->buf + self->buf_pos - 4, 4);
                 }
                 self->buf_pos = 0;
@@ -175,10 +214,7 @@ STATIC mp_uint_t websocket_read(mp_obj_t self_in, void *buf, mp_uint_t size, int
                     return out_sz;
                 }
 
-                sz = out_sz;
-                for (byte *p = buf; sz--; p++) {
-                    *p ^= self->mask[self->mask_pos++ & 3];
-                }
+                websocket_unmask(self, buf, out_sz);
 
                 self->msg_sz -= out_sz;
                 if (self->msg_sz == 0) {
@@ -218,17 +254,28 @@ no_payload:
 
 STATIC mp_uint_t websocket_write(mp_obj_t self_in, const void *buf, mp_uint_t size, int *errcode) {
     mp_obj_websocket_t *self =  MP_OBJ_TO_PTR(self_in);
-    assert(size < 0x10000);
-    byte header[4] = {0x80 | (self->opts & FRAME_OPCODE_MASK)};
+    byte header[2 + WEBSOCKET_WRITE_COALESCE] = {0x80 | (self->opts & FRAME_OPCODE_MASK)};
     int hdr_sz;
     if (size < 126) {
         header[1] = size;
         hdr_sz = 2;
-    } else {
+    } else if (size < 0x10000) {
         header[1] = 126;
         header[2] = size >> 8;
         header[3] = size & 0xff;
         hdr_sz = 4;
+    } else {
+        header[1] = 127;
+        for (int i = 0; i < 8; i++) {
+            header[9 - i] = (uint64_t)size >> (8 * i);
+        }
+        hdr_sz = 10;
+    }
+    if (size <= WEBSOCKET_WRITE_COALESCE) {
+        // one write, and so one packet, for the whole of a small frame
+        memcpy(header + hdr_sz, buf, size);
+        hdr_sz += size;
+        size = 0;
     }
 
     mp_obj_t dest[3];
@@ -240,7 +287,12 @@ STATIC mp_uint_t websocket_write(mp_obj_t self_in, const void *buf, mp_uint_t si
 
     mp_uint_t out_sz = mp_stream_write_exactly(self->sock, header, hdr_sz, errcode);
     if (*errcode == 0) {
-        out_sz = mp_stream_write_exactly(self->sock, buf, size, errcode);
+        if (size == 0) {
+            // the payload went with the 2 byte header
+            out_sz = hdr_sz - 2;
+        } else {
+            out_sz = mp_stream_write_exactly(self->sock, buf, size, errcode);
+        }
     }
 
     if (self->opts & BLOCKING_WRITE) {
@@ -142,6 +142,302 @@ STATIC const mp_obj_type_t decompio_type = {
     .locals_dict = (void*)&decompio_locals_dict,
 };
 
+#if MICROPY_PY_UZLIB_COMPRESS
+
+#define COMPIO_MIN_MATCH (3)
+#define COMPIO_MAX_MATCH (258)
+#define COMPIO_MIN_LOOKAHEAD (COMPIO_MAX_MATCH + COMPIO_MIN_MATCH + 1)
+#define COMPIO_MAX_CHAIN (16)
+
+enum { COMPIO_RAW, COMPIO_ZLIB, COMPIO_GZIP };
+
+typedef struct _mp_obj_compio_t {
+    mp_obj_base_t base;
+    mp_obj_t dest_stream;
+    struct Outbuf out;
+    byte *win; // history followed by lookahead, twice the window size
+    uint16_t *head; // latest position for each hash, 0 if none
+    uint16_t *prev; // previous position with the same hash, per window slot
+    uint32_t win_size;
+    uint32_t pos; // next byte in win to encode
+    uint32_t end; // end of the data in win
+    uint32_t checksum;
+    uint32_t in_len;
+    uint8_t hash_bits;
+    uint8_t format;
+    bool closed;
+    byte outbuf[128];
+} mp_obj_compio_t;
+
+STATIC void compio_drain(mp_obj_compio_t *o) {
+    if (o->out.outlen > 0) {
+        int err;
+        mp_uint_t len = o->out.outlen;
+        o->out.outlen = 0;
+        if (mp_stream_rw(o->dest_stream, o->outbuf, len, &err, MP_STREAM_RW_WRITE) != len) {
+            mp_raise_OSError(err);
+        }
+    }
+}
+
+STATIC void compio_out_byte(mp_obj_compio_t *o, byte b) {
+    outbits(&o->out, b, 8);
+}
+
+STATIC void compio_align(mp_obj_compio_t *o) {
+    if (o->out.noutbits > 0) {
+        outbits(&o->out, 0, 8 - o->out.noutbits);
+    }
+}
+
+STATIC inline uint32_t compio_hash(mp_obj_compio_t *o, const byte *p) {
+    return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> (32 - o->hash_bits);
+}
+
+// links pos into its hash chain and returns the previous head of that chain
+STATIC uint32_t compio_insert(mp_obj_compio_t *o, uint32_t pos) {
+    if (pos + COMPIO_MIN_MATCH > o->end) {
+        return 0;
+    }
+    uint32_t h = compio_hash(o, o->win + pos);
+    uint32_t cur = o->head[h];
+    o->prev[pos & (o->win_size - 1)] = cur;
+    o->head[h] = pos;
+    return cur;
+}
+
+STATIC uint32_t compio_longest_match(mp_obj_compio_t *o, uint32_t cur, uint32_t *dist) {
+    const byte *scan = o->win + o->pos;
+    uint32_t max_len = MIN(COMPIO_MAX_MATCH, o->end - o->pos);
+    uint32_t best_len = COMPIO_MIN_MATCH - 1;
+    int chain = COMPIO_MAX_CHAIN;
+    while (cur > 0 && cur < o->pos && o->pos - cur <= o->win_size && chain-- > 0) {
+        const byte *match = o->win + cur;
+        if (match[best_len] == scan[best_len]) {
+            uint32_t len = 0;
+            while (len < max_len && match[len] == scan[len]) {
+                len++;
+            }
+            if (len > best_len) {
+                best_len = len;
+                *dist = o->pos - cur;
+                if (len == max_len) {
+                    break;
+                }
+            }
+        }
+        uint32_t next = o->prev[cur & (o->win_size - 1)];
+        if (next >= cur) {
+            // the slot was reused by a newer position
+            break;
+        }
+        cur = next;
+    }
+    return best_len >= COMPIO_MIN_MATCH ? best_len : 0;
+}
+
+// encodes the buffered input, keeping enough lookahead for a full match unless flushing
+STATIC void compio_deflate(mp_obj_compio_t *o, bool flush) {
+    uint32_t keep = flush ? 0 : COMPIO_MIN_LOOKAHEAD;
+    while (o->end - o->pos > keep) {
+        uint32_t dist = 0;
+        uint32_t len = compio_longest_match(o, compio_insert(o, o->pos), &dist);
+        if (len > 0) {
+            zlib_match(&o->out, dist, len);
+            for (uint32_t i = 1; i < len; i++) {
+                compio_insert(o, o->pos + i);
+            }
+            o->pos += len;
+        } else {
+            zlib_literal(&o->out, o->win[o->pos]);
+            o->pos += 1;
+        }
+        if (o->out.outlen > sizeof(o->outbuf) - 8) {
+            compio_drain(o);
+        }
+    }
+}
+
+// drops the oldest half of win, positions that fall off it become 0
+STATIC void compio_slide(mp_obj_compio_t *o) {
+    uint32_t w = o->win_size;
+    memmove(o->win, o->win + w, w);
+    o->pos -= w;
+    o->end -= w;
+    for (uint32_t i = 0; i < (1u << o->hash_bits); i++) {
+        o->head[i] = o->head[i] >= w ? o->head[i] - w : 0;
+    }
+    for (uint32_t i = 0; i < w; i++) {
+        o->prev[i] = o->prev[i] >= w ? o->prev[i] - w : 0;
+    }
+}
+
+STATIC mp_obj_t compio_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+    mp_arg_check_num(n_args, n_kw, 1, 2, false);
+    mp_get_stream_raise(args[0], MP_STREAM_OP_WRITE);
+
+    // same convention as DecompIO: 9..15 zlib, 25..31 gzip, -9..-15 raw deflate
+    mp_int_t wbits = 10;
+    if (n_args > 1) {
+        wbits = mp_obj_get_int(args[1]);
+    }
+    byte format = COMPIO_ZLIB;
+    if (wbits >= 16) {
+        format = COMPIO_GZIP;
+        wbits -= 16;
+    } else if (wbits < 0) {
+        format = COMPIO_RAW;
+        wbits = -wbits;
+    }
+    // the window has to be bigger than the lookahead
+    if (wbits < 9 || wbits > 15) {
+        mp_raise_ValueError("wbits");
+    }
+
+    mp_obj_compio_t *o = m_new_obj(mp_obj_compio_t);
+    o->base.type = type;
+    o->dest_stream = args[0];
+    o->win_size = 1 << wbits;
+    o->hash_bits = wbits - 1;
+    o->win = m_new(byte, 2 * o->win_size);
+    o->head = m_new0(uint16_t, 1 << o->hash_bits);
+    o->prev = m_new0(uint16_t, o->win_size);
+    o->pos = 0;
+    o->end = 0;
+    o->in_len = 0;
+    o->format = format;
+    o->closed = false;
+    memset(&o->out, 0, sizeof(o->out));
+    o->out.outbuf = o->outbuf;
+    o->out.outsize = sizeof(o->outbuf);
+
+    if (format == COMPIO_ZLIB) {
+        byte cmf = (wbits - 8) << 4 | 8;
+        compio_out_byte(o, cmf);
+        compio_out_byte(o, (31 - (cmf << 8) % 31) % 31);
+        o->checksum = 1;
+    } else if (format == COMPIO_GZIP) {
+        static const byte gzip_header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff };
+        for (size_t i = 0; i < sizeof(gzip_header); i++) {
+            compio_out_byte(o, gzip_header[i]);
+        }
+        o->checksum = ~0;
+    }
+    // BFINAL=0, BTYPE=01: the stream is a run of static Huffman blocks
+    outbits(&o->out, 2, 3);
+    return MP_OBJ_FROM_PTR(o);
+}
+
+STATIC mp_uint_t compio_write(mp_obj_t o_in, const void *buf, mp_uint_t size, int *errcode) {
+    mp_obj_compio_t *o = MP_OBJ_TO_PTR(o_in);
+    if (o->closed) {
+        *errcode = MP_EINVAL;
+        return MP_STREAM_ERROR;
+    }
+    const byte *src = buf;
+    mp_uint_t left = size;
+    while (left > 0) {
+        mp_uint_t n = MIN(left, 2 * o->win_size - o->end);
+        memcpy(o->win + o->end, src, n);
+        if (o->format == COMPIO_ZLIB) {
+            o->checksum = uzlib_adler32(src, n, o->checksum);
+        } else if (o->format == COMPIO_GZIP) {
+            o->checksum = uzlib_crc32(src, n, o->checksum);
+        }
+        o->in_len += n;
+        o->end += n;
+        src += n;
+        left -= n;
+        compio_deflate(o, false);
+        if (o->end == 2 * o->win_size) {
+            compio_slide(o);
+        }
+    }
+    return size;
+}
+
+STATIC void compio_finish(mp_obj_compio_t *o) {
+    compio_deflate(o, true);
+    zlib_finish_block(&o->out);
+    zlib_start_block(&o->out);
+    zlib_finish_block(&o->out);
+    compio_align(o);
+    if (o->format == COMPIO_ZLIB) {
+        for (int i = 24; i >= 0; i -= 8) {
+            compio_out_byte(o, o->checksum >> i);
+        }
+    } else if (o->format == COMPIO_GZIP) {
+        uint32_t crc = ~o->checksum;
+        for (int i = 0; i < 32; i += 8) {
+            compio_out_byte(o, crc >> i);
+        }
+        for (int i = 0; i < 32; i += 8) {
+            compio_out_byte(o, o->in_len >> i);
+        }
+    }
+    compio_drain(o);
+    o->closed = true;
+    m_del(byte, o->win, 2 * o->win_size);
+    m_del(uint16_t, o->head, 1 << o->hash_bits);
+    m_del(uint16_t, o->prev, o->win_size);
+    o->win = NULL;
+    o->head = NULL;
+    o->prev = NULL;
+}
+
+STATIC mp_uint_t compio_ioctl(mp_obj_t o_in, mp_uint_t request, uintptr_t arg, int *errcode) {
+    mp_obj_compio_t *o = MP_OBJ_TO_PTR(o_in);
+    (void)arg;
+    if (request == MP_STREAM_CLOSE) {
+        if (!o->closed) {
+            compio_finish(o);
+        }
+        return 0;
+    } else if (request == MP_STREAM_FLUSH) {
+        if (o->closed) {
+            *errcode = MP_EINVAL;
+            return MP_STREAM_ERROR;
+        }
+        // sync flush: everything written so far becomes decodable,
+        // the history is kept for the data that follows
+        compio_deflate(o, true);
+        zlib_finish_block(&o->out);
+        outbits(&o->out, 0, 3);
+        compio_align(o);
+        outbits(&o->out, 0x0000, 16);
+        outbits(&o->out, 0xffff, 16);
+        outbits(&o->out, 2, 3);
+        compio_drain(o);
+        return 0;
+    } else {
+        *errcode = MP_EINVAL;
+        return MP_STREAM_ERROR;
+    }
+}
+
+STATIC const mp_rom_map_elem_t compio_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_write), MP_ROM_PTR(&mp_stream_write_obj) },
+    { MP_ROM_QSTR(MP_QSTR_flush), MP_ROM_PTR(&mp_stream_flush_obj) },
+    { MP_ROM_QSTR(MP_QSTR_close), MP_ROM_PTR(&mp_stream_close_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(compio_locals_dict, compio_locals_dict_table);
+
+STATIC const mp_stream_p_t compio_stream_p = {
+    .write = compio_write,
+    .ioctl = compio_ioctl,
+};
+
+STATIC const mp_obj_type_t compio_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_CompIO,
+    .make_new = compio_make_new,
+    .protocol = &compio_stream_p,
+    .locals_dict = (void*)&compio_locals_dict,
+};
+
+#endif // MICROPY_PY_UZLIB_COMPRESS
+
 STATIC mp_obj_t mod_uzlib_decompress(size_t n_args, const mp_obj_t *args) {
     mp_obj_t data = args[0];
     mp_buffer_info_t bufinfo;
@@ -205,6 +501,9 @@ STATIC const mp_rom_map_elem_t mp_module_uzlib_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_uzlib) },
     { MP_ROM_QSTR(MP_QSTR_decompress), MP_ROM_PTR(&mod_uzlib_decompress_obj) },
     { MP_ROM_QSTR(MP_QSTR_DecompIO), MP_ROM_PTR(&decompio_type) },
+    #if MICROPY_PY_UZLIB_COMPRESS
+    { MP_ROM_QSTR(MP_QSTR_CompIO), MP_ROM_PTR(&compio_type) },
+    #endif
 };
 
 STATIC MP_DEFINE_CONST_DICT(mp_module_uzlib_globals, mp_module_uzlib_globals_table);
@@ -222,5 +521,8 @@ const mp_obj_module_t mp_module_uzlib = {
 #include "uzlib/tinfgzip.c"
 #include "uzlib/adler32.c"
 #include "uzlib/crc32.c"
+#if MICROPY_PY_UZLIB_COMPRESS
+#include "uzlib/defl_static.c"
+#endif
 
 #endif // MICROPY_PY_UZLIB
@@ -54,6 +54,13 @@ struct webrepl_file {
     char fname[64];
 } __attribute__((packed));
 
+// File data is moved in chunks of up to this size, in both directions.  A get
+// waits for the client to acknowledge each chunk, so the bigger the chunks the
+// fewer the round trips; the size goes in 16 bits.
+#ifndef MICROPY_PY_WEBREPL_FILE_CHUNK
+#define MICROPY_PY_WEBREPL_FILE_CHUNK (1024)
+#endif
+
 enum { PUT_FILE = 1, GET_FILE, GET_VER };
 enum { STATE_PASSWD, STATE_NORMAL };
 
@@ -74,6 +81,9 @@ STATIC char denied_prompt[] = "\r\nAccess denied\r\n";
 
 STATIC char webrepl_passwd[10];
 
+// shared by the puts and the gets, there is only one file operation at a time
+STATIC byte webrepl_filebuf[2 + MICROPY_PY_WEBREPL_FILE_CHUNK];
+
 STATIC void write_webrepl(mp_obj_t websock, const void *buf, size_t len) {
     const mp_stream_p_t *sock_stream = mp_get_stream(websock);
     int err;
@@ -118,10 +128,11 @@ STATIC void check_file_op_finished(mp_obj_webrepl_t *self) {
 }
 
 STATIC int write_file_chunk(mp_obj_webrepl_t *self) {
+    MP_STATIC_ASSERT(MICROPY_PY_WEBREPL_FILE_CHUNK < 0x10000);
     const mp_stream_p_t *file_stream = mp_get_stream(self->cur_file);
-    byte readbuf[2 + 256];
+    byte *readbuf = webrepl_filebuf;
     int err;
-    mp_uint_t out_sz = file_stream->read(self->cur_file, readbuf + 2, sizeof(readbuf) - 2, &err);
+    mp_uint_t out_sz = file_stream->read(self->cur_file, readbuf + 2, MICROPY_PY_WEBREPL_FILE_CHUNK, &err);
     if (out_sz == MP_STREAM_ERROR) {
         return out_sz;
     }
@@ -246,11 +257,11 @@ STATIC mp_uint_t _webrepl_read(mp_obj_t self_in, void *buf, mp_uint_t size, int
     }
 
     if (self->data_to_recv != 0) {
-        static byte filebuf[512];
+        byte *filebuf = webrepl_filebuf;
         filebuf[0] = *(byte*)buf;
         mp_uint_t buf_sz = 1;
         if (--self->data_to_recv != 0) {
-            size_t to_read = MIN(sizeof(filebuf) - 1, self->data_to_recv);
+            size_t to_read = MIN(MICROPY_PY_WEBREPL_FILE_CHUNK - 1, self->data_to_recv);
             mp_uint_t sz = sock_stream->read(self->sock, filebuf + 1, to_read, errcode);
             if (sz == MP_STREAM_ERROR) {
                 return sz;
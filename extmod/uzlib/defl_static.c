@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) uzlib authors
+ *
+ * This software is provided 'as-is', without any express
+ * or implied warranty.  In no event will the authors be
+ * held liable for any damages arising from the use of
+ * this software.
+ *
+ * Permission is granted to anyone to use this software
+ * for any purpose, including commercial applications,
+ * and to alter it and redistribute it freely, subject to
+ * the following restrictions:
+ *
+ * 1. The origin of this software must not be
+ *    misrepresented; you must not claim that you
+ *    wrote the original software. If you use this
+ *    software in a product, an acknowledgment in
+ *    the product documentation would be appreciated
+ *    but is not required.
+ *
+ * 2. Altered source versions must be plainly marked
+ *    as such, and must not be misrepresented as
+ *    being the original software.
+ *
+ * 3. This notice may not be removed or altered from
+ *    any source distribution.
+ */
+
+/* Static Huffman (BTYPE=01) deflate encoder. Unlike the PuTTY original the
+   output buffer is not grown here: outbuf/outsize are supplied by the caller,
+   which drains outbuf (resetting outlen) before it can run out of room. A
+   single symbol never takes more than 4 bytes. */
+
+#include "uzlib.h"
+
+static const unsigned short defl_length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const unsigned char defl_length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const unsigned short defl_dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const unsigned char defl_dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/* Huffman codes are sent most significant bit first */
+static unsigned long defl_reverse_bits(unsigned long code, int nbits)
+{
+    unsigned long rev = 0;
+    while (nbits--) {
+        rev = (rev << 1) | (code & 1);
+        code >>= 1;
+    }
+    return rev;
+}
+
+void outbits(struct Outbuf *out, unsigned long bits, int nbits)
+{
+    out->outbits |= bits << out->noutbits;
+    out->noutbits += nbits;
+    while (out->noutbits >= 8) {
+        if (out->outlen < out->outsize) {
+            out->outbuf[out->outlen++] = out->outbits & 0xFF;
+        }
+        out->outbits >>= 8;
+        out->noutbits -= 8;
+    }
+}
+
+/* literal/length symbol 0..287 with the fixed code lengths of RFC 1951 3.2.6 */
+static void defl_static_symbol(struct Outbuf *out, int sym)
+{
+    if (sym < 144) {
+        outbits(out, defl_reverse_bits(0x30 + sym, 8), 8);
+    } else if (sym < 256) {
+        outbits(out, defl_reverse_bits(0x190 + sym - 144, 9), 9);
+    } else if (sym < 280) {
+        outbits(out, defl_reverse_bits(sym - 256, 7), 7);
+    } else {
+        outbits(out, defl_reverse_bits(0xC0 + sym - 280, 8), 8);
+    }
+}
+
+void zlib_start_block(struct Outbuf *out)
+{
+    /* BFINAL=1, BTYPE=01 */
+    outbits(out, 1, 1);
+    outbits(out, 1, 2);
+}
+
+void zlib_finish_block(struct Outbuf *out)
+{
+    /* end of block symbol */
+    defl_static_symbol(out, 256);
+}
+
+void zlib_literal(struct Outbuf *out, unsigned char c)
+{
+    defl_static_symbol(out, c);
+}
+
+void zlib_match(struct Outbuf *out, int distance, int len)
+{
+    int i;
+
+    /* 3 <= len <= 258, 1 <= distance <= 32768 */
+    for (i = 28; defl_length_base[i] > len; i--) {
+    }
+    defl_static_symbol(out, 257 + i);
+    if (defl_length_extra[i]) {
+        outbits(out, len - defl_length_base[i], defl_length_extra[i]);
+    }
+
+    for (i = 29; defl_dist_base[i] > distance; i--) {
+    }
+    outbits(out, defl_reverse_bits(i, 5), 5);
+    if (defl_dist_extra[i]) {
+        outbits(out, distance - defl_dist_base[i], defl_dist_extra[i]);
+    }
+}
@@ -142,7 +142,7 @@ STATIC mp_obj_t mp_vfs_proxy_call(mp_vfs_mount_t *vfs, qstr meth_name, size_t n_
     return mp_call_method_n_kw(n_args, 0, meth);
 }
 
-mp_import_stat_t mp_vfs_import_stat(const char *path) {
+STATIC mp_import_stat_t vfs_import_stat(const char *path) {
     const char *path_out;
     mp_vfs_mount_t *vfs = mp_vfs_lookup_path(path, &path_out);
     if (vfs == MP_VFS_NONE || vfs == MP_VFS_ROOT) {
@@ -176,6 +176,58 @@ mp_import_stat_t mp_vfs_import_stat(const char *path) {
     }
 }
 
+#if MICROPY_VFS_IMPORT_STAT_CACHE
+
+// An import walks sys.path stat'ing name, name.py and name.mpy in every entry,
+// and each miss costs a directory scan on flash. The results are kept in a
+// small direct-mapped table; an entry is valid only while its generation
+// matches the current one, so flushing the cache is a single increment.
+#define IMPORT_STAT_CACHE_PATH_MAX (56)
+
+typedef struct _import_stat_cache_entry_t {
+    uint32_t gen;
+    uint8_t stat;
+    char path[IMPORT_STAT_CACHE_PATH_MAX];
+} import_stat_cache_entry_t;
+
+STATIC import_stat_cache_entry_t import_stat_cache[MICROPY_VFS_IMPORT_STAT_CACHE];
+STATIC volatile uint32_t import_stat_cache_gen = 1;
+
+void mp_vfs_import_stat_cache_clear(void) {
+    import_stat_cache_gen++;
+}
+
+mp_import_stat_t mp_vfs_import_stat(const char *path) {
+    size_t len = strlen(path);
+    if (len >= IMPORT_STAT_CACHE_PATH_MAX) {
+        return vfs_import_stat(path);
+    }
+    import_stat_cache_entry_t *e = &import_stat_cache[qstr_compute_hash((const byte*)path, len) % MICROPY_VFS_IMPORT_STAT_CACHE];
+    uint32_t gen = import_stat_cache_gen;
+    if (e->gen == gen && !strcmp(e->path, path)) {
+        return e->stat;
+    }
+    mp_import_stat_t stat = vfs_import_stat(path);
+    // don't store a result that a write made meanwhile may have outdated
+    if (gen == import_stat_cache_gen) {
+        memcpy(e->path, path, len + 1);
+        e->stat = stat;
+        e->gen = gen;
+    }
+    return stat;
+}
+
+#else
+
+void mp_vfs_import_stat_cache_clear(void) {
+}
+
+mp_import_stat_t mp_vfs_import_stat(const char *path) {
+    return vfs_import_stat(path);
+}
+
+#endif
+
 mp_obj_t mp_vfs_mount(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args) {
     enum { ARG_readonly, ARG_mkfs };
     static const mp_arg_t allowed_args[] = {
@@ -237,6 +289,7 @@ mp_obj_t mp_vfs_mount(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args
         vfsp = &(*vfsp)->next;
     }
     *vfsp = vfs;
+    mp_vfs_import_stat_cache_clear();
 
     return mp_const_none;
 }
@@ -269,6 +322,7 @@ mp_obj_t mp_vfs_umount(mp_obj_t mnt_in) {
 
     // call the underlying object to do any unmounting operation
     mp_vfs_proxy_call(vfs, MP_QSTR_umount, 0, NULL);
+    mp_vfs_import_stat_cache_clear();
 
     return mp_const_none;
 }
@@ -296,7 +350,12 @@ mp_obj_t mp_vfs_open(size_t n_args, const mp_obj_t *pos_args, mp_map_t *kw_args)
     #endif
 
     mp_vfs_mount_t *vfs = lookup_path(args[ARG_file].u_obj, &args[ARG_file].u_obj);
-    return mp_vfs_proxy_call(vfs, MP_QSTR_open, 2, (mp_obj_t*)&args);
+    mp_obj_t file = mp_vfs_proxy_call(vfs, MP_QSTR_open, 2, (mp_obj_t*)&args);
+    // opening for writing may have created the file
+    if (strpbrk(mp_obj_str_get_str(args[ARG_mode].u_obj), "wax+") != NULL) {
+        mp_vfs_import_stat_cache_clear();
+    }
+    return file;
 }
 MP_DEFINE_CONST_FUN_OBJ_KW(mp_vfs_open_obj, 0, mp_vfs_open);
 
@@ -318,6 +377,8 @@ mp_obj_t mp_vfs_chdir(mp_obj_t path_in) {
     } else {
         mp_vfs_proxy_call(vfs, MP_QSTR_chdir, 1, &path_out);
     }
+    // cached relative paths were resolved against the old directory
+    mp_vfs_import_stat_cache_clear();
     return mp_const_none;
 }
 MP_DEFINE_CONST_FUN_OBJ_1(mp_vfs_chdir_obj, mp_vfs_chdir);
@@ -427,14 +488,18 @@ mp_obj_t mp_vfs_mkdir(mp_obj_t path_in) {
     if (vfs == MP_VFS_ROOT || (vfs != MP_VFS_NONE && !strcmp(mp_obj_str_get_str(path_out), "/"))) {
         mp_raise_OSError(MP_EEXIST);
     }
-    return mp_vfs_proxy_call(vfs, MP_QSTR_mkdir, 1, &path_out);
+    mp_obj_t ret = mp_vfs_proxy_call(vfs, MP_QSTR_mkdir, 1, &path_out);
+    mp_vfs_import_stat_cache_clear();
+    return ret;
 }
 MP_DEFINE_CONST_FUN_OBJ_1(mp_vfs_mkdir_obj, mp_vfs_mkdir);
 
 mp_obj_t mp_vfs_remove(mp_obj_t path_in) {
     mp_obj_t path_out;
     mp_vfs_mount_t *vfs = lookup_path(path_in, &path_out);
-    return mp_vfs_proxy_call(vfs, MP_QSTR_remove, 1, &path_out);
+    mp_obj_t ret = mp_vfs_proxy_call(vfs, MP_QSTR_remove, 1, &path_out);
+    mp_vfs_import_stat_cache_clear();
+    return ret;
 }
 MP_DEFINE_CONST_FUN_OBJ_1(mp_vfs_remove_obj, mp_vfs_remove);
 
@@ -446,14 +511,18 @@ mp_obj_t mp_vfs_rename(mp_obj_t old_path_in, mp_obj_t new_path_in) {
         // can't rename across filesystems
         mp_raise_OSError(MP_EPERM);
     }
-    return mp_vfs_proxy_call(old_vfs, MP_QSTR_rename, 2, args);
+    mp_obj_t ret = mp_vfs_proxy_call(old_vfs, MP_QSTR_rename, 2, args);
+    mp_vfs_import_stat_cache_clear();
+    return ret;
 }
 MP_DEFINE_CONST_FUN_OBJ_2(mp_vfs_rename_obj, mp_vfs_rename);
 
 mp_obj_t mp_vfs_rmdir(mp_obj_t path_in) {
     mp_obj_t path_out;
     mp_vfs_mount_t *vfs = lookup_path(path_in, &path_out);
-    return mp_vfs_proxy_call(vfs, MP_QSTR_rmdir, 1, &path_out);
+    mp_obj_t ret = mp_vfs_proxy_call(vfs, MP_QSTR_rmdir, 1, &path_out);
+    mp_vfs_import_stat_cache_clear();
+    return ret;
 }
 MP_DEFINE_CONST_FUN_OBJ_1(mp_vfs_rmdir_obj, mp_vfs_rmdir);
 
@@ -548,7 +617,9 @@ mp_obj_t mp_vfs_fsformat(mp_obj_t path_in)
 				{
 					if(!strcmp(vfs->str, path))
 					{
-						return mp_vfs_proxy_call(vfs, MP_QSTR_fsformat, 0, NULL);
+						mp_obj_t ret = mp_vfs_proxy_call(vfs, MP_QSTR_fsformat, 0, NULL);
+						mp_vfs_import_stat_cache_clear();
+						return ret;
 					}
 				}
 				mp_raise_OSError(MP_ENODEV);
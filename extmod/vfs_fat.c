@@ -35,6 +35,7 @@
 #include <string.h>
 #include "py/runtime.h"
 #include "py/mperrno.h"
+#include "py/gc.h"
 #include "lib/oofatfs/ff.h"
 #include "extmod/vfs_fat.h"
 #include "lib/timeutils/timeutils.h"
@@ -49,6 +50,18 @@
 
 STATIC FRESULT fat_format(fs_user_mount_t* vfs);
 
+#if MICROPY_VFS_FAT_RELEASE_GIL
+bool fat_vfs_release_gil(FATFS *fatfs) {
+    fs_user_mount_t *vfs = (fatfs != NULL) ? fatfs->drv : NULL;
+    // Python block devices need the GIL, so does a finaliser running in the middle of a collection
+    if (vfs == NULL || !(vfs->flags & FSUSER_NATIVE) || gc_is_locked()) {
+        return false;
+    }
+    MP_THREAD_GIL_EXIT();
+    return true;
+}
+#endif
+
 STATIC mp_import_stat_t fat_vfs_import_stat(void *vfs_in, const char *path) {
     fs_user_mount_t *vfs = vfs_in;
     FILINFO fno;
@@ -234,7 +247,9 @@ STATIC mp_obj_t fat_vfs_remove_internal(mp_obj_t vfs_in, mp_obj_t path_in, mp_in
     const char *path = mp_obj_str_get_str(path_in);
 
     FILINFO fno;
+    FAT_VFS_IO_BEGIN(&self->fs.fatfs);
     FRESULT res = f_stat(&self->fs.fatfs, path, &fno);
+    FAT_VFS_IO_END();
 
     if (res != FR_OK) {
         mp_raise_OSError(fresult_to_errno_table[res]);
@@ -242,7 +257,9 @@ STATIC mp_obj_t fat_vfs_remove_internal(mp_obj_t vfs_in, mp_obj_t path_in, mp_in
 
     // check if path is a file or directory
     if ((fno.fattrib & AM_DIR) == attr) {
+        FAT_VFS_IO_BEGIN(&self->fs.fatfs);
         res = f_unlink(&self->fs.fatfs, path);
+        FAT_VFS_IO_END();
 
         if (res != FR_OK) {
             mp_raise_OSError(fresult_to_errno_table[res]);
@@ -267,12 +284,16 @@ STATIC mp_obj_t fat_vfs_rename(mp_obj_t vfs_in, mp_obj_t path_in, mp_obj_t path_
     mp_obj_fat_vfs_t *self = MP_OBJ_TO_PTR(vfs_in);
     const char *old_path = mp_obj_str_get_str(path_in);
     const char *new_path = mp_obj_str_get_str(path_out);
+    FAT_VFS_IO_BEGIN(&self->fs.fatfs);
     FRESULT res = f_rename(&self->fs.fatfs, old_path, new_path);
+    FAT_VFS_IO_END();
     if (res == FR_EXIST) {
         // if new_path exists then try removing it (but only if it's a file)
         fat_vfs_remove_internal(vfs_in, path_out, 0); // 0 == file attribute
         // try to rename again
+        FAT_VFS_IO_BEGIN(&self->fs.fatfs);
         res = f_rename(&self->fs.fatfs, old_path, new_path);
+        FAT_VFS_IO_END();
     }
     if (res == FR_OK) {
         return mp_const_none;
@@ -286,7 +307,9 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_3(fat_vfs_rename_obj, fat_vfs_rename);
 STATIC mp_obj_t fat_vfs_mkdir(mp_obj_t vfs_in, mp_obj_t path_o) {
     mp_obj_fat_vfs_t *self = MP_OBJ_TO_PTR(vfs_in);
     const char *path = mp_obj_str_get_str(path_o);
+    FAT_VFS_IO_BEGIN(&self->fs.fatfs);
     FRESULT res = f_mkdir(&self->fs.fatfs, path);
+    FAT_VFS_IO_END();
     if (res == FR_OK) {
         return mp_const_none;
     } else {
@@ -380,7 +403,10 @@ STATIC mp_obj_t fat_vfs_statvfs(mp_obj_t vfs_in, mp_obj_t path_in) {
 
     DWORD nclst;
     FATFS *fatfs = &self->fs.fatfs;
+    // the first call scans the whole FAT
+    FAT_VFS_IO_BEGIN(fatfs);
     FRESULT res = f_getfree(fatfs, &nclst);
+    FAT_VFS_IO_END();
     if (FR_OK != res) {
         mp_raise_OSError(fresult_to_errno_table[res]);
     }
@@ -410,7 +436,9 @@ STATIC mp_obj_t fat_vfs_getfree(mp_obj_t vfs_in) {
     FATFS *fatfs = &self->fs.fatfs;
     DWORD nclst;
 
+    FAT_VFS_IO_BEGIN(fatfs);
     FRESULT res = f_getfree(fatfs, &nclst);
+    FAT_VFS_IO_END();
     if (FR_OK != res) {
         mp_raise_OSError(fresult_to_errno_table[res]);
     }
@@ -44,4 +44,15 @@ extern const mp_obj_type_t mp_type_vfs_fat_textio;
 
 MP_DECLARE_CONST_FUN_OBJ_3(fat_vfs_open_obj);
 
+#if MICROPY_VFS_FAT_RELEASE_GIL
+// other threads keep running while FatFS works on a native block device,
+// FatFS must be reentrant so the volume stays locked meanwhile
+#define FAT_VFS_IO_BEGIN(fatfs) bool fat_vfs_gil_released = fat_vfs_release_gil(fatfs)
+#define FAT_VFS_IO_END() do { if (fat_vfs_gil_released) { MP_THREAD_GIL_ENTER(); } } while (0)
+bool fat_vfs_release_gil(FATFS *fatfs);
+#else
+#define FAT_VFS_IO_BEGIN(fatfs)
+#define FAT_VFS_IO_END()
+#endif
+
 #endif // MICROPY_INCLUDED_EXTMOD_VFS_FAT_H
@@ -72,7 +72,9 @@ STATIC void file_obj_print(const mp_print_t *print, mp_obj_t self_in, mp_print_k
 STATIC mp_uint_t file_obj_read(mp_obj_t self_in, void *buf, mp_uint_t size, int *errcode) {
     pyb_file_obj_t *self = MP_OBJ_TO_PTR(self_in);
     UINT sz_out;
+    FAT_VFS_IO_BEGIN(self->fp.obj.fs);
     FRESULT res = f_read(&self->fp, buf, size, &sz_out);
+    FAT_VFS_IO_END();
     if (res != FR_OK) {
         *errcode = fresult_to_errno_table[res];
         return MP_STREAM_ERROR;
@@ -83,7 +85,9 @@ STATIC mp_uint_t file_obj_read(mp_obj_t self_in, void *buf, mp_uint_t size, int
 STATIC mp_uint_t file_obj_write(mp_obj_t self_in, const void *buf, mp_uint_t size, int *errcode) {
     pyb_file_obj_t *self = MP_OBJ_TO_PTR(self_in);
     UINT sz_out;
+    FAT_VFS_IO_BEGIN(self->fp.obj.fs);
     FRESULT res = f_write(&self->fp, buf, size, &sz_out);
+    FAT_VFS_IO_END();
     if (res != FR_OK) {
         *errcode = fresult_to_errno_table[res];
         return MP_STREAM_ERROR;
@@ -127,7 +131,9 @@ STATIC mp_uint_t file_obj_ioctl(mp_obj_t o_in, mp_uint_t request, uintptr_t arg,
         return 0;
 
     } else if (request == MP_STREAM_FLUSH) {
+        FAT_VFS_IO_BEGIN(self->fp.obj.fs);
         FRESULT res = f_sync(&self->fp);
+        FAT_VFS_IO_END();
         if (res != FR_OK) {
             *errcode = fresult_to_errno_table[res];
             return MP_STREAM_ERROR;
@@ -137,7 +143,9 @@ STATIC mp_uint_t file_obj_ioctl(mp_obj_t o_in, mp_uint_t request, uintptr_t arg,
     } else if (request == MP_STREAM_CLOSE) {
         // if fs==NULL then the file is closed and in that case this method is a no-op
         if (self->fp.obj.fs != NULL) {
+            FAT_VFS_IO_BEGIN(self->fp.obj.fs);
             FRESULT res = f_close(&self->fp);
+            FAT_VFS_IO_END();
             if (res != FR_OK) {
                 *errcode = fresult_to_errno_table[res];
                 return MP_STREAM_ERROR;
@@ -197,7 +205,9 @@ STATIC mp_obj_t file_open(fs_user_mount_t *vfs, const mp_obj_type_t *type, mp_ar
 
     const char *fname = mp_obj_str_get_str(args[0].u_obj);
     assert(vfs != NULL);
+    FAT_VFS_IO_BEGIN(&vfs->fs.fatfs);
     FRESULT res = f_open(&vfs->fs.fatfs, &o->fp, fname, mode);
+    FAT_VFS_IO_END();
     if (res != FR_OK) {
         m_del_obj(pyb_file_obj_t, o);
         mp_raise_OSError(fresult_to_errno_table[res]);
@@ -2209,7 +2209,8 @@ LoRaMacStatus_t PrepareFrame( LoRaMacHeader_t *macHdr, LoRaMacFrameCtrl_t *fCtrl
             memcpyr( LoRaMacBuffer + LoRaMacBufferPktLen, LoRaMacDevEui, 8 );
             LoRaMacBufferPktLen += 8;
 
-            LoRaMacDevNonce = Radio.Random( );
+            // from the system RNG, reading the radio noise blocks for 32 ms
+            LoRaMacDevNonce = BoardGetRandomSeed( );
 
             LoRaMacBuffer[LoRaMacBufferPktLen++] = LoRaMacDevNonce & 0xFF;
             LoRaMacBuffer[LoRaMacBufferPktLen++] = ( LoRaMacDevNonce >> 8 ) & 0xFF;
@@ -2562,7 +2563,7 @@ LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t *primitives, LoRaMacC
     Radio.Init( &RadioEvents );
 
     // Random seed initialization
-    srand1( Radio.Random( ) );
+    srand1( BoardGetRandomSeed( ) );
 
     PublicNetwork = true;
     Radio.SetPublicNetwork( PublicNetwork );
@@ -29,38 +29,46 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 // Regional includes
 #include "Region.h"
 
+#ifdef LORAMAC_REGION_SINGLE
+// A single region is compiled in (LORA_REGION=... on the make line), the tests fold
+// away and every call goes straight to it; RegionIsActive keeps checking the region
+#define REGION_IS( r )                             ( ( r ) == LORAMAC_REGION_SINGLE )
+#else
+#define REGION_IS( r )                             ( region == ( r ) )
+#endif
+
 
 // Setup regions
 #ifdef REGION_AS923
 #include "RegionAS923.h"
 #define AS923_IS_ACTIVE( )                         else if(region == LORAMAC_REGION_AS923) { return true; }
-#define AS923_GET_PHY_PARAM( )                     else if(region == LORAMAC_REGION_AS923) { return RegionAS923GetPhyParam( getPhy ); }
-#define AS923_SET_BAND_TX_DONE( )                  else if(region == LORAMAC_REGION_AS923) { RegionAS923SetBandTxDone( txDone );}
-#define AS923_INIT_DEFAULTS( )                     else if(region == LORAMAC_REGION_AS923) { RegionAS923InitDefaults( type );}
-#define AS923_VERIFY( )                            else if(region == LORAMAC_REGION_AS923) { return RegionAS923Verify( verify, phyAttribute ); }
-#define AS923_APPLY_CF_LIST( )                     else if(region == LORAMAC_REGION_AS923) { RegionAS923ApplyCFList( applyCFList );}
-#define AS923_CHAN_MASK_SET( )                     else if(region == LORAMAC_REGION_AS923) { return RegionAS923ChanMaskSet( chanMaskSet ); }
-#define AS923_ADR_NEXT( )                          else if(region == LORAMAC_REGION_AS923) { return RegionAS923AdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
-#define AS923_COMPUTE_RX_WINDOW_PARAMETERS( )      else if(region == LORAMAC_REGION_AS923) { RegionAS923ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
-#define AS923_RX_CONFIG( )                         else if(region == LORAMAC_REGION_AS923) { return RegionAS923RxConfig( rxConfig, datarate ); }
-#define AS923_TX_CONFIG( )                         else if(region == LORAMAC_REGION_AS923) { return RegionAS923TxConfig( txConfig, txPower, txTimeOnAir ); }
-#define AS923_LINK_ADR_REQ( )                      else if(region == LORAMAC_REGION_AS923) { return RegionAS923LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
-#define AS923_RX_PARAM_SETUP_REQ( )                else if(region == LORAMAC_REGION_AS923) { return RegionAS923RxParamSetupReq( rxParamSetupReq ); }
-#define AS923_NEW_CHANNEL_REQ( )                   else if(region == LORAMAC_REGION_AS923) { return RegionAS923NewChannelReq( newChannelReq ); }
-#define AS923_TX_PARAM_SETUP_REQ( )                else if(region == LORAMAC_REGION_AS923) { return RegionAS923TxParamSetupReq( txParamSetupReq ); }
-#define AS923_DL_CHANNEL_REQ( )                    else if(region == LORAMAC_REGION_AS923) { return RegionAS923DlChannelReq( dlChannelReq ); }
-#define AS923_ALTERNATE_DR( )                      else if(region == LORAMAC_REGION_AS923) { return RegionAS923AlternateDr( alternateDr ); }
-#define AS923_CALC_BACKOFF( )                      else if(region == LORAMAC_REGION_AS923) { RegionAS923CalcBackOff( calcBackOff );}
-#define AS923_NEXT_CHANNEL( )                      else if(region == LORAMAC_REGION_AS923) { return RegionAS923NextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
-#define AS923_CHANNEL_ADD( )                       else if(region == LORAMAC_REGION_AS923) { return RegionAS923ChannelAdd( channelAdd ); }
-#define AS923_CHANNEL_REMOVE( )                    else if(region == LORAMAC_REGION_AS923) { return RegionAS923ChannelsRemove( channelRemove ); }
-#define AS923_CHANNEL_MANUAL_ADD( )                else if(region == LORAMAC_REGION_AS923) { return RegionAS923ChannelManualAdd( channelAdd ); }
-#define AS923_CHANNEL_MANUAL_REMOVE( )             else if(region == LORAMAC_REGION_AS923) { return RegionAS923ChannelsRemove( channelRemove ); }
-#define AS923_SET_CONTINUOUS_WAVE( )               else if(region == LORAMAC_REGION_AS923) { RegionAS923SetContinuousWave( continuousWave );}
-#define AS923_APPLY_DR_OFFSET( )                   else if(region == LORAMAC_REGION_AS923) { return RegionAS923ApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
-#define AS923_GET_CHANNELS( )                      else if(region == LORAMAC_REGION_AS923) { return RegionAS923GetChannels( channels, size ); }
-#define AS923_GET_CHANNEL_MASK( )                  else if(region == LORAMAC_REGION_AS923) { return RegionAS923GetChannelMask( channelmask, size ); }
-#define AS923_FORCE_JOIN_DATARATE( )               else if(region == LORAMAC_REGION_AS923) { return RegionAS923ForceJoinDataRate( joinDr, alternateDr ); }
+#define AS923_GET_PHY_PARAM( )                     else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923GetPhyParam( getPhy ); }
+#define AS923_SET_BAND_TX_DONE( )                  else if(REGION_IS( LORAMAC_REGION_AS923 )) { RegionAS923SetBandTxDone( txDone );}
+#define AS923_INIT_DEFAULTS( )                     else if(REGION_IS( LORAMAC_REGION_AS923 )) { RegionAS923InitDefaults( type );}
+#define AS923_VERIFY( )                            else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923Verify( verify, phyAttribute ); }
+#define AS923_APPLY_CF_LIST( )                     else if(REGION_IS( LORAMAC_REGION_AS923 )) { RegionAS923ApplyCFList( applyCFList );}
+#define AS923_CHAN_MASK_SET( )                     else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923ChanMaskSet( chanMaskSet ); }
+#define AS923_ADR_NEXT( )                          else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923AdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
+#define AS923_COMPUTE_RX_WINDOW_PARAMETERS( )      else if(REGION_IS( LORAMAC_REGION_AS923 )) { RegionAS923ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
+#define AS923_RX_CONFIG( )                         else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923RxConfig( rxConfig, datarate ); }
+#define AS923_TX_CONFIG( )                         else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923TxConfig( txConfig, txPower, txTimeOnAir ); }
+#define AS923_LINK_ADR_REQ( )                      else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
+#define AS923_RX_PARAM_SETUP_REQ( )                else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923RxParamSetupReq( rxParamSetupReq ); }
+#define AS923_NEW_CHANNEL_REQ( )                   else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923NewChannelReq( newChannelReq ); }
+#define AS923_TX_PARAM_SETUP_REQ( )                else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923TxParamSetupReq( txParamSetupReq ); }
+#define AS923_DL_CHANNEL_REQ( )                    else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923DlChannelReq( dlChannelReq ); }
+#define AS923_ALTERNATE_DR( )                      else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923AlternateDr( alternateDr ); }
+#define AS923_CALC_BACKOFF( )                      else if(REGION_IS( LORAMAC_REGION_AS923 )) { RegionAS923CalcBackOff( calcBackOff );}
+#define AS923_NEXT_CHANNEL( )                      else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923NextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
+#define AS923_CHANNEL_ADD( )                       else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923ChannelAdd( channelAdd ); }
+#define AS923_CHANNEL_REMOVE( )                    else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923ChannelsRemove( channelRemove ); }
+#define AS923_CHANNEL_MANUAL_ADD( )                else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923ChannelManualAdd( channelAdd ); }
+#define AS923_CHANNEL_MANUAL_REMOVE( )             else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923ChannelsRemove( channelRemove ); }
+#define AS923_SET_CONTINUOUS_WAVE( )               else if(REGION_IS( LORAMAC_REGION_AS923 )) { RegionAS923SetContinuousWave( continuousWave );}
+#define AS923_APPLY_DR_OFFSET( )                   else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923ApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
+#define AS923_GET_CHANNELS( )                      else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923GetChannels( channels, size ); }
+#define AS923_GET_CHANNEL_MASK( )                  else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923GetChannelMask( channelmask, size ); }
+#define AS923_FORCE_JOIN_DATARATE( )               else if(REGION_IS( LORAMAC_REGION_AS923 )) { return RegionAS923ForceJoinDataRate( joinDr, alternateDr ); }
 #else
 #define AS923_IS_ACTIVE( )
 #define AS923_GET_PHY_PARAM( )
@@ -95,34 +103,34 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #ifdef REGION_AU915
 #include "RegionAU915.h"
 #define AU915_IS_ACTIVE( )                         else if(region == LORAMAC_REGION_AU915) { return true; }
-#define AU915_GET_PHY_PARAM( )                     else if(region == LORAMAC_REGION_AU915) { return RegionAU915GetPhyParam( getPhy ); }
-#define AU915_SET_BAND_TX_DONE( )                  else if(region == LORAMAC_REGION_AU915) { RegionAU915SetBandTxDone( txDone );}
-#define AU915_INIT_DEFAULTS( )                     else if(region == LORAMAC_REGION_AU915) { RegionAU915InitDefaults( type );}
-#define AU915_VERIFY( )                            else if(region == LORAMAC_REGION_AU915) { return RegionAU915Verify( verify, phyAttribute ); }
-#define AU915_APPLY_CF_LIST( )                     else if(region == LORAMAC_REGION_AU915) { RegionAU915ApplyCFList( applyCFList );}
-#define AU915_CHAN_MASK_SET( )                     else if(region == LORAMAC_REGION_AU915) { return RegionAU915ChanMaskSet( chanMaskSet ); }
-#define AU915_ADR_NEXT( )                          else if(region == LORAMAC_REGION_AU915) { return RegionAU915AdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
-#define AU915_COMPUTE_RX_WINDOW_PARAMETERS( )      else if(region == LORAMAC_REGION_AU915) { RegionAU915ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
-#define AU915_RX_CONFIG( )                         else if(region == LORAMAC_REGION_AU915) { return RegionAU915RxConfig( rxConfig, datarate ); }
-#define AU915_TX_CONFIG( )                         else if(region == LORAMAC_REGION_AU915) { return RegionAU915TxConfig( txConfig, txPower, txTimeOnAir ); }
-#define AU915_LINK_ADR_REQ( )                      else if(region == LORAMAC_REGION_AU915) { return RegionAU915LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
-#define AU915_RX_PARAM_SETUP_REQ( )                else if(region == LORAMAC_REGION_AU915) { return RegionAU915RxParamSetupReq( rxParamSetupReq ); }
-#define AU915_NEW_CHANNEL_REQ( )                   else if(region == LORAMAC_REGION_AU915) { return RegionAU915NewChannelReq( newChannelReq ); }
-#define AU915_TX_PARAM_SETUP_REQ( )                else if(region == LORAMAC_REGION_AU915) { return RegionAU915TxParamSetupReq( txParamSetupReq ); }
-#define AU915_DL_CHANNEL_REQ( )                    else if(region == LORAMAC_REGION_AU915) { return RegionAU915DlChannelReq( dlChannelReq ); }
-#define AU915_ALTERNATE_DR( )                      else if(region == LORAMAC_REGION_AU915) { return RegionAU915AlternateDr( alternateDr ); }
-#define AU915_CALC_BACKOFF( )                      else if(region == LORAMAC_REGION_AU915) { RegionAU915CalcBackOff( calcBackOff );}
-#define AU915_NEXT_CHANNEL( )                      else if(region == LORAMAC_REGION_AU915) { return RegionAU915NextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
-#define AU915_CHANNEL_ADD( )                       else if(region == LORAMAC_REGION_AU915) { return RegionAU915ChannelAdd( channelAdd ); }
-#define AU915_CHANNEL_REMOVE( )                    else if(region == LORAMAC_REGION_AU915) { return RegionAU915ChannelsRemove( channelRemove ); }
-#define AU915_CHANNEL_MANUAL_ADD( )                else if(region == LORAMAC_REGION_AU915) { return RegionAU915ChannelManualAdd( channelAdd ); }
-#define AU915_CHANNEL_MANUAL_REMOVE( )             else if(region == LORAMAC_REGION_AU915) { return RegionAU915ChannelsManualRemove( channelRemove ); }
-#define AU915_SET_CONTINUOUS_WAVE( )               else if(region == LORAMAC_REGION_AU915) { RegionAU915SetContinuousWave( continuousWave );}
-#define AU915_APPLY_DR_OFFSET( )                   else if(region == LORAMAC_REGION_AU915) { return RegionAU915ApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
-#define AU915_GET_CHANNELS( )                      else if(region == LORAMAC_REGION_AU915) { return RegionAU915GetChannels( channels, size ); }
-#define AU915_GET_CHANNEL_MASK( )                  else if(region == LORAMAC_REGION_AU915) { return RegionAU915GetChannelMask( channelmask, size ); }
-#define AU915_GET_CHANNEL_MASK_REMAINING( )        else if(region == LORAMAC_REGION_AU915) { return RegionAU915GetChannelMaskRemaining( channelmask, size ); }
-#define AU915_FORCE_JOIN_DATARATE( )               else if(region == LORAMAC_REGION_AU915) { return RegionAU915ForceJoinDataRate( joinDr, alternateDr ); }
+#define AU915_GET_PHY_PARAM( )                     else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915GetPhyParam( getPhy ); }
+#define AU915_SET_BAND_TX_DONE( )                  else if(REGION_IS( LORAMAC_REGION_AU915 )) { RegionAU915SetBandTxDone( txDone );}
+#define AU915_INIT_DEFAULTS( )                     else if(REGION_IS( LORAMAC_REGION_AU915 )) { RegionAU915InitDefaults( type );}
+#define AU915_VERIFY( )                            else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915Verify( verify, phyAttribute ); }
+#define AU915_APPLY_CF_LIST( )                     else if(REGION_IS( LORAMAC_REGION_AU915 )) { RegionAU915ApplyCFList( applyCFList );}
+#define AU915_CHAN_MASK_SET( )                     else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915ChanMaskSet( chanMaskSet ); }
+#define AU915_ADR_NEXT( )                          else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915AdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
+#define AU915_COMPUTE_RX_WINDOW_PARAMETERS( )      else if(REGION_IS( LORAMAC_REGION_AU915 )) { RegionAU915ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
+#define AU915_RX_CONFIG( )                         else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915RxConfig( rxConfig, datarate ); }
+#define AU915_TX_CONFIG( )                         else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915TxConfig( txConfig, txPower, txTimeOnAir ); }
+#define AU915_LINK_ADR_REQ( )                      else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
+#define AU915_RX_PARAM_SETUP_REQ( )                else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915RxParamSetupReq( rxParamSetupReq ); }
+#define AU915_NEW_CHANNEL_REQ( )                   else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915NewChannelReq( newChannelReq ); }
+#define AU915_TX_PARAM_SETUP_REQ( )                else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915TxParamSetupReq( txParamSetupReq ); }
+#define AU915_DL_CHANNEL_REQ( )                    else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915DlChannelReq( dlChannelReq ); }
+#define AU915_ALTERNATE_DR( )                      else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915AlternateDr( alternateDr ); }
+#define AU915_CALC_BACKOFF( )                      else if(REGION_IS( LORAMAC_REGION_AU915 )) { RegionAU915CalcBackOff( calcBackOff );}
+#define AU915_NEXT_CHANNEL( )                      else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915NextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
+#define AU915_CHANNEL_ADD( )                       else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915ChannelAdd( channelAdd ); }
+#define AU915_CHANNEL_REMOVE( )                    else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915ChannelsRemove( channelRemove ); }
+#define AU915_CHANNEL_MANUAL_ADD( )                else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915ChannelManualAdd( channelAdd ); }
+#define AU915_CHANNEL_MANUAL_REMOVE( )             else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915ChannelsManualRemove( channelRemove ); }
+#define AU915_SET_CONTINUOUS_WAVE( )               else if(REGION_IS( LORAMAC_REGION_AU915 )) { RegionAU915SetContinuousWave( continuousWave );}
+#define AU915_APPLY_DR_OFFSET( )                   else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915ApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
+#define AU915_GET_CHANNELS( )                      else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915GetChannels( channels, size ); }
+#define AU915_GET_CHANNEL_MASK( )                  else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915GetChannelMask( channelmask, size ); }
+#define AU915_GET_CHANNEL_MASK_REMAINING( )        else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915GetChannelMaskRemaining( channelmask, size ); }
+#define AU915_FORCE_JOIN_DATARATE( )               else if(REGION_IS( LORAMAC_REGION_AU915 )) { return RegionAU915ForceJoinDataRate( joinDr, alternateDr ); }
 #else
 #define AU915_IS_ACTIVE( )
 #define AU915_GET_PHY_PARAM( )
@@ -158,31 +166,31 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #ifdef REGION_CN470
 #include "RegionCN470.h"
 #define CN470_IS_ACTIVE( )                         else if(region == LORAMAC_REGION_CN470) { return true; }
-#define CN470_GET_PHY_PARAM( )                     else if(region == LORAMAC_REGION_CN470) { return RegionCN470GetPhyParam( getPhy ); }
-#define CN470_SET_BAND_TX_DONE( )                  else if(region == LORAMAC_REGION_CN470) { RegionCN470SetBandTxDone( txDone );}
-#define CN470_INIT_DEFAULTS( )                     else if(region == LORAMAC_REGION_CN470) { RegionCN470InitDefaults( type );}
-#define CN470_VERIFY( )                            else if(region == LORAMAC_REGION_CN470) { return RegionCN470Verify( verify, phyAttribute ); }
-#define CN470_APPLY_CF_LIST( )                     else if(region == LORAMAC_REGION_CN470) { RegionCN470ApplyCFList( applyCFList );}
-#define CN470_CHAN_MASK_SET( )                     else if(region == LORAMAC_REGION_CN470) { return RegionCN470ChanMaskSet( chanMaskSet ); }
-#define CN470_ADR_NEXT( )                          else if(region == LORAMAC_REGION_CN470) { return RegionCN470AdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
-#define CN470_COMPUTE_RX_WINDOW_PARAMETERS( )      else if(region == LORAMAC_REGION_CN470) { RegionCN470ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
-#define CN470_RX_CONFIG( )                         else if(region == LORAMAC_REGION_CN470) { return RegionCN470RxConfig( rxConfig, datarate ); }
-#define CN470_TX_CONFIG( )                         else if(region == LORAMAC_REGION_CN470) { return RegionCN470TxConfig( txConfig, txPower, txTimeOnAir ); }
-#define CN470_LINK_ADR_REQ( )                      else if(region == LORAMAC_REGION_CN470) { return RegionCN470LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
-#define CN470_RX_PARAM_SETUP_REQ( )                else if(region == LORAMAC_REGION_CN470) { return RegionCN470RxParamSetupReq( rxParamSetupReq ); }
-#define CN470_NEW_CHANNEL_REQ( )                   else if(region == LORAMAC_REGION_CN470) { return RegionCN470NewChannelReq( newChannelReq ); }
-#define CN470_TX_PARAM_SETUP_REQ( )                else if(region == LORAMAC_REGION_CN470) { return RegionCN470TxParamSetupReq( txParamSetupReq ); }
-#define CN470_DL_CHANNEL_REQ( )                    else if(region == LORAMAC_REGION_CN470) { return RegionCN470DlChannelReq( dlChannelReq ); }
-#define CN470_ALTERNATE_DR( )                      else if(region == LORAMAC_REGION_CN470) { return RegionCN470AlternateDr( alternateDr ); }
-#define CN470_CALC_BACKOFF( )                      else if(region == LORAMAC_REGION_CN470) { RegionCN470CalcBackOff( calcBackOff );}
-#define CN470_NEXT_CHANNEL( )                      else if(region == LORAMAC_REGION_CN470) { return RegionCN470NextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
-#define CN470_CHANNEL_ADD( )                       else if(region == LORAMAC_REGION_CN470) { return RegionCN470ChannelAdd( channelAdd ); }
-#define CN470_CHANNEL_REMOVE( )                    else if(region == LORAMAC_REGION_CN470) { return RegionCN470ChannelsRemove( channelRemove ); }
-#define CN470_CHANNEL_MANUAL_ADD( )                else if(region == LORAMAC_REGION_CN470) { return RegionCN470ChannelManualAdd( channelAdd ); }
-#define CN470_CHANNEL_MANUAL_REMOVE( )             else if(region == LORAMAC_REGION_CN470) { return RegionCN470ChannelsRemove( channelRemove ); }
-#define CN470_SET_CONTINUOUS_WAVE( )               else if(region == LORAMAC_REGION_CN470) { RegionCN470SetContinuousWave( continuousWave );}
-#define CN470_APPLY_DR_OFFSET( )                   else if(region == LORAMAC_REGION_CN470) { return RegionCN470ApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
-#define CN470_FORCE_JOIN_DATARATE( )               else if(region == LORAMAC_REGION_CN470) { return RegionCN470ForceJoinDataRate( joinDr, alternateDr ); }
+#define CN470_GET_PHY_PARAM( )                     else if(REGION_IS( LORAMAC_REGION_CN470 )) { return RegionCN470GetPhyParam( getPhy ); }
+#define CN470_SET_BAND_TX_DONE( )                  else if(REGION_IS( LORAMAC_REGION_CN470 )) { RegionCN470SetBandTxDone( txDone );}
+#define CN470_INIT_DEFAULTS( )                     else if(REGION_IS( LORAMAC_REGION_CN470 )) { RegionCN470InitDefaults( type );}
+#define CN470_VERIFY( )                            else if(REGION_IS( LORAMAC_REGION_CN470 )) { return RegionCN470Verify( verify, phyAttribute ); }
+#define CN470_APPLY_CF_LIST( )                     else if(REGION_IS( LORAMAC_REGION_CN470 )) { RegionCN470ApplyCFList( applyCFList );}
+#define CN470_CHAN_MASK_SET( )                     else if(REGION_IS( LORAMAC_REGION_CN470 )) { return RegionCN470ChanMaskSet( chanMaskSet ); }
+#define CN470_ADR_NEXT( )                          else if(REGION_IS( LORAMAC_REGION_CN470 )) { return RegionCN470AdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
+#define CN470_COMPUTE_RX_WINDOW_PARAMETERS( )      else if(REGION_IS( LORAMAC_REGION_CN470 )) { RegionCN470ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
+#define CN470_RX_CONFIG( )                         else if(REGION_IS( LORAMAC_REGION_CN470 )) { return RegionCN470RxConfig( rxConfig, datarate ); }
+#define CN470_TX_CONFIG( )                         else if(REGION_IS( LORAMAC_REGION_CN470 )) { return RegionCN470TxConfig( txConfig, txPower, txTimeOnAir ); }
+#define CN470_LINK_ADR_REQ( )                      else if(REGION_IS( LORAMAC_REGION_CN470 )) { return RegionCN470LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
+#define CN470_RX_PARAM_SETUP_REQ( )                else if(REGION_IS( LORAMAC_REGION_CN470 )) { return RegionCN470RxParamSetupReq( rxParamSetupReq ); }
+#define CN470_NEW_CHANNEL_REQ( )                   else if(REGION_IS( LORAMAC_REGION_CN470 )) { return RegionCN470NewChannelReq( newChannelReq ); }
+#define CN470_TX_PARAM_SETUP_REQ( )                else if(REGION_IS( LORAMAC_REGION_CN470 )) { return RegionCN470TxParamSetupReq( txParamSetupReq ); }
+#define CN470_DL_CHANNEL_REQ( )                    else if(REGION_IS( LORAMAC_REGION_CN470 )) { return RegionCN470DlChannelReq( dlChannelReq ); }
+#define CN470_ALTERNATE_DR( )                      else if(REGION_IS( LORAMAC_REGION_CN470 )) { return RegionCN470AlternateDr( alternateDr ); }
+#define CN470_CALC_BACKOFF( )                      else if(REGION_IS( LORAMAC_REGION_CN470 )) { RegionCN470CalcBackOff( calcBackOff );}
+#define CN470_NEXT_CHANNEL( )                      else if(REGION_IS( LORAMAC_REGION_CN470 )) { return RegionCN470NextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
+#define CN470_CHANNEL_ADD( )                       else if(REGION_IS( LORAMAC_REGION_CN470 )) { return RegionCN470ChannelAdd( channelAdd ); }
+#define CN470_CHANNEL_REMOVE( )                    else if(REGION_IS( LORAMAC_REGION_CN470 )) { return RegionCN470ChannelsRemove( channelRemove ); }
+#define CN470_CHANNEL_MANUAL_ADD( )                else if(REGION_IS( LORAMAC_REGION_CN470 )) { return RegionCN470ChannelManualAdd( channelAdd ); }
+#define CN470_CHANNEL_MANUAL_REMOVE( )             else if(REGION_IS( LORAMAC_REGION_CN470 )) { return RegionCN470ChannelsRemove( channelRemove ); }
+#define CN470_SET_CONTINUOUS_WAVE( )               else if(REGION_IS( LORAMAC_REGION_CN470 )) { RegionCN470SetContinuousWave( continuousWave );}
+#define CN470_APPLY_DR_OFFSET( )                   else if(REGION_IS( LORAMAC_REGION_CN470 )) { return RegionCN470ApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
+#define CN470_FORCE_JOIN_DATARATE( )               else if(REGION_IS( LORAMAC_REGION_CN470 )) { return RegionCN470ForceJoinDataRate( joinDr, alternateDr ); }
 #else
 #define CN470_IS_ACTIVE( )
 #define CN470_GET_PHY_PARAM( )
@@ -215,28 +223,28 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #ifdef REGION_CN779
 #include "RegionCN779.h"
 #define CN779_IS_ACTIVE( )                         else if(region == LORAMAC_REGION_CN779) { return true; }
-#define CN779_GET_PHY_PARAM( )                     else if(region == LORAMAC_REGION_CN779) { return RegionCN779GetPhyParam( getPhy ); }
-#define CN779_SET_BAND_TX_DONE( )                  else if(region == LORAMAC_REGION_CN779) { RegionCN779SetBandTxDone( txDone );}
-#define CN779_INIT_DEFAULTS( )                     else if(region == LORAMAC_REGION_CN779) { RegionCN779InitDefaults( type );}
-#define CN779_VERIFY( )                            else if(region == LORAMAC_REGION_CN779) { return RegionCN779Verify( verify, phyAttribute ); }
-#define CN779_APPLY_CF_LIST( )                     else if(region == LORAMAC_REGION_CN779) { RegionCN779ApplyCFList( applyCFList );}
-#define CN779_CHAN_MASK_SET( )                     else if(region == LORAMAC_REGION_CN779) { return RegionCN779ChanMaskSet( chanMaskSet ); }
-#define CN779_ADR_NEXT( )                          else if(region == LORAMAC_REGION_CN779) { return RegionCN779AdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
-#define CN779_COMPUTE_RX_WINDOW_PARAMETERS( )      else if(region == LORAMAC_REGION_CN779) { RegionCN779ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
-#define CN779_RX_CONFIG( )                         else if(region == LORAMAC_REGION_CN779) { return RegionCN779RxConfig( rxConfig, datarate ); }
-#define CN779_TX_CONFIG( )                         else if(region == LORAMAC_REGION_CN779) { return RegionCN779TxConfig( txConfig, txPower, txTimeOnAir ); }
-#define CN779_LINK_ADR_REQ( )                      else if(region == LORAMAC_REGION_CN779) { return RegionCN779LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
-#define CN779_RX_PARAM_SETUP_REQ( )                else if(region == LORAMAC_REGION_CN779) { return RegionCN779RxParamSetupReq( rxParamSetupReq ); }
-#define CN779_NEW_CHANNEL_REQ( )                   else if(region == LORAMAC_REGION_CN779) { return RegionCN779NewChannelReq( newChannelReq ); }
-#define CN779_TX_PARAM_SETUP_REQ( )                else if(region == LORAMAC_REGION_CN779) { return RegionCN779TxParamSetupReq( txParamSetupReq ); }
-#define CN779_DL_CHANNEL_REQ( )                    else if(region == LORAMAC_REGION_CN779) { return RegionCN779DlChannelReq( dlChannelReq ); }
-#define CN779_ALTERNATE_DR( )                      else if(region == LORAMAC_REGION_CN779) { return RegionCN779AlternateDr( alternateDr ); }
-#define CN779_CALC_BACKOFF( )                      else if(region == LORAMAC_REGION_CN779) { RegionCN779CalcBackOff( calcBackOff );}
-#define CN779_NEXT_CHANNEL( )                      else if(region == LORAMAC_REGION_CN779) { return RegionCN779NextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
-#define CN779_CHANNEL_ADD( )                       else if(region == LORAMAC_REGION_CN779) { return RegionCN779ChannelAdd( channelAdd ); }
-#define CN779_CHANNEL_REMOVE( )                    else if(region == LORAMAC_REGION_CN779) { return RegionCN779ChannelsRemove( channelRemove ); }
-#define CN779_SET_CONTINUOUS_WAVE( )               else if(region == LORAMAC_REGION_CN779) { RegionCN779SetContinuousWave( continuousWave );}
-#define CN779_APPLY_DR_OFFSET( )                   else if(region == LORAMAC_REGION_CN779) { return RegionCN779ApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
+#define CN779_GET_PHY_PARAM( )                     else if(REGION_IS( LORAMAC_REGION_CN779 )) { return RegionCN779GetPhyParam( getPhy ); }
+#define CN779_SET_BAND_TX_DONE( )                  else if(REGION_IS( LORAMAC_REGION_CN779 )) { RegionCN779SetBandTxDone( txDone );}
+#define CN779_INIT_DEFAULTS( )                     else if(REGION_IS( LORAMAC_REGION_CN779 )) { RegionCN779InitDefaults( type );}
+#define CN779_VERIFY( )                            else if(REGION_IS( LORAMAC_REGION_CN779 )) { return RegionCN779Verify( verify, phyAttribute ); }
+#define CN779_APPLY_CF_LIST( )                     else if(REGION_IS( LORAMAC_REGION_CN779 )) { RegionCN779ApplyCFList( applyCFList );}
+#define CN779_CHAN_MASK_SET( )                     else if(REGION_IS( LORAMAC_REGION_CN779 )) { return RegionCN779ChanMaskSet( chanMaskSet ); }
+#define CN779_ADR_NEXT( )                          else if(REGION_IS( LORAMAC_REGION_CN779 )) { return RegionCN779AdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
+#define CN779_COMPUTE_RX_WINDOW_PARAMETERS( )      else if(REGION_IS( LORAMAC_REGION_CN779 )) { RegionCN779ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
+#define CN779_RX_CONFIG( )                         else if(REGION_IS( LORAMAC_REGION_CN779 )) { return RegionCN779RxConfig( rxConfig, datarate ); }
+#define CN779_TX_CONFIG( )                         else if(REGION_IS( LORAMAC_REGION_CN779 )) { return RegionCN779TxConfig( txConfig, txPower, txTimeOnAir ); }
+#define CN779_LINK_ADR_REQ( )                      else if(REGION_IS( LORAMAC_REGION_CN779 )) { return RegionCN779LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
+#define CN779_RX_PARAM_SETUP_REQ( )                else if(REGION_IS( LORAMAC_REGION_CN779 )) { return RegionCN779RxParamSetupReq( rxParamSetupReq ); }
+#define CN779_NEW_CHANNEL_REQ( )                   else if(REGION_IS( LORAMAC_REGION_CN779 )) { return RegionCN779NewChannelReq( newChannelReq ); }
+#define CN779_TX_PARAM_SETUP_REQ( )                else if(REGION_IS( LORAMAC_REGION_CN779 )) { return RegionCN779TxParamSetupReq( txParamSetupReq ); }
+#define CN779_DL_CHANNEL_REQ( )                    else if(REGION_IS( LORAMAC_REGION_CN779 )) { return RegionCN779DlChannelReq( dlChannelReq ); }
+#define CN779_ALTERNATE_DR( )                      else if(REGION_IS( LORAMAC_REGION_CN779 )) { return RegionCN779AlternateDr( alternateDr ); }
+#define CN779_CALC_BACKOFF( )                      else if(REGION_IS( LORAMAC_REGION_CN779 )) { RegionCN779CalcBackOff( calcBackOff );}
+#define CN779_NEXT_CHANNEL( )                      else if(REGION_IS( LORAMAC_REGION_CN779 )) { return RegionCN779NextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
+#define CN779_CHANNEL_ADD( )                       else if(REGION_IS( LORAMAC_REGION_CN779 )) { return RegionCN779ChannelAdd( channelAdd ); }
+#define CN779_CHANNEL_REMOVE( )                    else if(REGION_IS( LORAMAC_REGION_CN779 )) { return RegionCN779ChannelsRemove( channelRemove ); }
+#define CN779_SET_CONTINUOUS_WAVE( )               else if(REGION_IS( LORAMAC_REGION_CN779 )) { RegionCN779SetContinuousWave( continuousWave );}
+#define CN779_APPLY_DR_OFFSET( )                   else if(REGION_IS( LORAMAC_REGION_CN779 )) { return RegionCN779ApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
 #else
 #define CN779_IS_ACTIVE( )
 #define CN779_GET_PHY_PARAM( )
@@ -266,30 +274,30 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #ifdef REGION_EU433
 #include "RegionEU433.h"
 #define EU433_IS_ACTIVE( )                         else if(region == LORAMAC_REGION_EU433) { return true; }
-#define EU433_GET_PHY_PARAM( )                     else if(region == LORAMAC_REGION_EU433) { return RegionEU433GetPhyParam( getPhy ); }
-#define EU433_SET_BAND_TX_DONE( )                  else if(region == LORAMAC_REGION_EU433) { RegionEU433SetBandTxDone( txDone );}
-#define EU433_INIT_DEFAULTS( )                     else if(region == LORAMAC_REGION_EU433) { RegionEU433InitDefaults( type );}
-#define EU433_VERIFY( )                            else if(region == LORAMAC_REGION_EU433) { return RegionEU433Verify( verify, phyAttribute ); }
-#define EU433_APPLY_CF_LIST( )                     else if(region == LORAMAC_REGION_EU433) { RegionEU433ApplyCFList( applyCFList );}
-#define EU433_CHAN_MASK_SET( )                     else if(region == LORAMAC_REGION_EU433) { return RegionEU433ChanMaskSet( chanMaskSet ); }
-#define EU433_ADR_NEXT( )                          else if(region == LORAMAC_REGION_EU433) { return RegionEU433AdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
-#define EU433_COMPUTE_RX_WINDOW_PARAMETERS( )      else if(region == LORAMAC_REGION_EU433) { RegionEU433ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
-#define EU433_RX_CONFIG( )                         else if(region == LORAMAC_REGION_EU433) { return RegionEU433RxConfig( rxConfig, datarate ); }
-#define EU433_TX_CONFIG( )                         else if(region == LORAMAC_REGION_EU433) { return RegionEU433TxConfig( txConfig, txPower, txTimeOnAir ); }
-#define EU433_LINK_ADR_REQ( )                      else if(region == LORAMAC_REGION_EU433) { return RegionEU433LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
-#define EU433_RX_PARAM_SETUP_REQ( )                else if(region == LORAMAC_REGION_EU433) { return RegionEU433RxParamSetupReq( rxParamSetupReq ); }
-#define EU433_NEW_CHANNEL_REQ( )                   else if(region == LORAMAC_REGION_EU433) { return RegionEU433NewChannelReq( newChannelReq ); }
-#define EU433_TX_PARAM_SETUP_REQ( )                else if(region == LORAMAC_REGION_EU433) { return RegionEU433TxParamSetupReq( txParamSetupReq ); }
-#define EU433_DL_CHANNEL_REQ( )                    else if(region == LORAMAC_REGION_EU433) { return RegionEU433DlChannelReq( dlChannelReq ); }
-#define EU433_ALTERNATE_DR( )                      else if(region == LORAMAC_REGION_EU433) { return RegionEU433AlternateDr( alternateDr ); }
-#define EU433_CALC_BACKOFF( )                      else if(region == LORAMAC_REGION_EU433) { RegionEU433CalcBackOff( calcBackOff );}
-#define EU433_NEXT_CHANNEL( )                      else if(region == LORAMAC_REGION_EU433) { return RegionEU433NextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
-#define EU433_CHANNEL_ADD( )                       else if(region == LORAMAC_REGION_EU433) { return RegionEU433ChannelAdd( channelAdd ); }
-#define EU433_CHANNEL_REMOVE( )                    else if(region == LORAMAC_REGION_EU433) { return RegionEU433ChannelsRemove( channelRemove ); }
+#define EU433_GET_PHY_PARAM( )                     else if(REGION_IS( LORAMAC_REGION_EU433 )) { return RegionEU433GetPhyParam( getPhy ); }
+#define EU433_SET_BAND_TX_DONE( )                  else if(REGION_IS( LORAMAC_REGION_EU433 )) { RegionEU433SetBandTxDone( txDone );}
+#define EU433_INIT_DEFAULTS( )                     else if(REGION_IS( LORAMAC_REGION_EU433 )) { RegionEU433InitDefaults( type );}
+#define EU433_VERIFY( )                            else if(REGION_IS( LORAMAC_REGION_EU433 )) { return RegionEU433Verify( verify, phyAttribute ); }
+#define EU433_APPLY_CF_LIST( )                     else if(REGION_IS( LORAMAC_REGION_EU433 )) { RegionEU433ApplyCFList( applyCFList );}
+#define EU433_CHAN_MASK_SET( )                     else if(REGION_IS( LORAMAC_REGION_EU433 )) { return RegionEU433ChanMaskSet( chanMaskSet ); }
+#define EU433_ADR_NEXT( )                          else if(REGION_IS( LORAMAC_REGION_EU433 )) { return RegionEU433AdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
+#define EU433_COMPUTE_RX_WINDOW_PARAMETERS( )      else if(REGION_IS( LORAMAC_REGION_EU433 )) { RegionEU433ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
+#define EU433_RX_CONFIG( )                         else if(REGION_IS( LORAMAC_REGION_EU433 )) { return RegionEU433RxConfig( rxConfig, datarate ); }
+#define EU433_TX_CONFIG( )                         else if(REGION_IS( LORAMAC_REGION_EU433 )) { return RegionEU433TxConfig( txConfig, txPower, txTimeOnAir ); }
+#define EU433_LINK_ADR_REQ( )                      else if(REGION_IS( LORAMAC_REGION_EU433 )) { return RegionEU433LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
+#define EU433_RX_PARAM_SETUP_REQ( )                else if(REGION_IS( LORAMAC_REGION_EU433 )) { return RegionEU433RxParamSetupReq( rxParamSetupReq ); }
+#define EU433_NEW_CHANNEL_REQ( )                   else if(REGION_IS( LORAMAC_REGION_EU433 )) { return RegionEU433NewChannelReq( newChannelReq ); }
+#define EU433_TX_PARAM_SETUP_REQ( )                else if(REGION_IS( LORAMAC_REGION_EU433 )) { return RegionEU433TxParamSetupReq( txParamSetupReq ); }
+#define EU433_DL_CHANNEL_REQ( )                    else if(REGION_IS( LORAMAC_REGION_EU433 )) { return RegionEU433DlChannelReq( dlChannelReq ); }
+#define EU433_ALTERNATE_DR( )                      else if(REGION_IS( LORAMAC_REGION_EU433 )) { return RegionEU433AlternateDr( alternateDr ); }
+#define EU433_CALC_BACKOFF( )                      else if(REGION_IS( LORAMAC_REGION_EU433 )) { RegionEU433CalcBackOff( calcBackOff );}
+#define EU433_NEXT_CHANNEL( )                      else if(REGION_IS( LORAMAC_REGION_EU433 )) { return RegionEU433NextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
+#define EU433_CHANNEL_ADD( )                       else if(REGION_IS( LORAMAC_REGION_EU433 )) { return RegionEU433ChannelAdd( channelAdd ); }
+#define EU433_CHANNEL_REMOVE( )                    else if(REGION_IS( LORAMAC_REGION_EU433 )) { return RegionEU433ChannelsRemove( channelRemove ); }
 #define EU433_CHANNEL_MANUAL_ADD( )                EU433_CASE { return RegionEU433ChannelManualAdd( channelAdd ); }
 #define EU433_CHANNEL_MANUAL_REMOVE( )             EU433_CASE { return RegionEU433ChannelsRemove( channelRemove ); }
-#define EU433_SET_CONTINUOUS_WAVE( )               else if(region == LORAMAC_REGION_EU433) { RegionEU433SetContinuousWave( continuousWave );}
-#define EU433_APPLY_DR_OFFSET( )                   else if(region == LORAMAC_REGION_EU433) { return RegionEU433ApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
+#define EU433_SET_CONTINUOUS_WAVE( )               else if(REGION_IS( LORAMAC_REGION_EU433 )) { RegionEU433SetContinuousWave( continuousWave );}
+#define EU433_APPLY_DR_OFFSET( )                   else if(REGION_IS( LORAMAC_REGION_EU433 )) { return RegionEU433ApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
 #define EU433_FORCE_JOIN_DATARATE( )               EU433_CASE { return RegionEU433ForceJoinDataRate( joinDr, alternateDr ); }
 #else
 #define EU433_IS_ACTIVE( )
@@ -323,33 +331,33 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #ifdef REGION_EU868
 #include "RegionEU868.h"
 #define EU868_IS_ACTIVE( )                         else if(region == LORAMAC_REGION_EU868) { return true; }
-#define EU868_GET_PHY_PARAM( )                     else if(region == LORAMAC_REGION_EU868) { return RegionEU868GetPhyParam( getPhy ); }
-#define EU868_SET_BAND_TX_DONE( )                  else if(region == LORAMAC_REGION_EU868) { RegionEU868SetBandTxDone( txDone );}
-#define EU868_INIT_DEFAULTS( )                     else if(region == LORAMAC_REGION_EU868) { RegionEU868InitDefaults( type );}
-#define EU868_VERIFY( )                            else if(region == LORAMAC_REGION_EU868) { return RegionEU868Verify( verify, phyAttribute ); }
-#define EU868_APPLY_CF_LIST( )                     else if(region == LORAMAC_REGION_EU868) { RegionEU868ApplyCFList( applyCFList );}
-#define EU868_CHAN_MASK_SET( )                     else if(region == LORAMAC_REGION_EU868) { return RegionEU868ChanMaskSet( chanMaskSet ); }
-#define EU868_ADR_NEXT( )                          else if(region == LORAMAC_REGION_EU868) { return RegionEU868AdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
-#define EU868_COMPUTE_RX_WINDOW_PARAMETERS( )      else if(region == LORAMAC_REGION_EU868) { RegionEU868ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
-#define EU868_RX_CONFIG( )                         else if(region == LORAMAC_REGION_EU868) { return RegionEU868RxConfig( rxConfig, datarate ); }
-#define EU868_TX_CONFIG( )                         else if(region == LORAMAC_REGION_EU868) { return RegionEU868TxConfig( txConfig, txPower, txTimeOnAir ); }
-#define EU868_LINK_ADR_REQ( )                      else if(region == LORAMAC_REGION_EU868) { return RegionEU868LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
-#define EU868_RX_PARAM_SETUP_REQ( )                else if(region == LORAMAC_REGION_EU868) { return RegionEU868RxParamSetupReq( rxParamSetupReq ); }
-#define EU868_NEW_CHANNEL_REQ( )                   else if(region == LORAMAC_REGION_EU868) { return RegionEU868NewChannelReq( newChannelReq ); }
-#define EU868_TX_PARAM_SETUP_REQ( )                else if(region == LORAMAC_REGION_EU868) { return RegionEU868TxParamSetupReq( txParamSetupReq ); }
-#define EU868_DL_CHANNEL_REQ( )                    else if(region == LORAMAC_REGION_EU868) { return RegionEU868DlChannelReq( dlChannelReq ); }
-#define EU868_ALTERNATE_DR( )                      else if(region == LORAMAC_REGION_EU868) { return RegionEU868AlternateDr( alternateDr ); }
-#define EU868_CALC_BACKOFF( )                      else if(region == LORAMAC_REGION_EU868) { RegionEU868CalcBackOff( calcBackOff );}
-#define EU868_NEXT_CHANNEL( )                      else if(region == LORAMAC_REGION_EU868) { return RegionEU868NextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
-#define EU868_CHANNEL_ADD( )                       else if(region == LORAMAC_REGION_EU868) { return RegionEU868ChannelAdd( channelAdd ); }
-#define EU868_CHANNEL_REMOVE( )                    else if(region == LORAMAC_REGION_EU868) { return RegionEU868ChannelsRemove( channelRemove ); }
-#define EU868_CHANNEL_MANUAL_ADD( )                else if(region == LORAMAC_REGION_EU868) { return RegionEU868ChannelManualAdd( channelAdd ); }
-#define EU868_CHANNEL_MANUAL_REMOVE( )             else if(region == LORAMAC_REGION_EU868) { return RegionEU868ChannelsRemove( channelRemove ); }
-#define EU868_SET_CONTINUOUS_WAVE( )               else if(region == LORAMAC_REGION_EU868) { RegionEU868SetContinuousWave( continuousWave );}
-#define EU868_APPLY_DR_OFFSET( )                   else if(region == LORAMAC_REGION_EU868) { return RegionEU868ApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
-#define EU868_GET_CHANNELS( )                      else if(region == LORAMAC_REGION_EU868) { return RegionEU868GetChannels( channels, size ); }
-#define EU868_GET_CHANNEL_MASK( )                  else if(region == LORAMAC_REGION_EU868) { return RegionEU868GetChannelMask( channelmask, size ); }
-#define EU868_FORCE_JOIN_DATARATE( )               else if(region == LORAMAC_REGION_EU868) { return RegionEU868ForceJoinDataRate( joinDr, alternateDr ); }
+#define EU868_GET_PHY_PARAM( )                     else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868GetPhyParam( getPhy ); }
+#define EU868_SET_BAND_TX_DONE( )                  else if(REGION_IS( LORAMAC_REGION_EU868 )) { RegionEU868SetBandTxDone( txDone );}
+#define EU868_INIT_DEFAULTS( )                     else if(REGION_IS( LORAMAC_REGION_EU868 )) { RegionEU868InitDefaults( type );}
+#define EU868_VERIFY( )                            else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868Verify( verify, phyAttribute ); }
+#define EU868_APPLY_CF_LIST( )                     else if(REGION_IS( LORAMAC_REGION_EU868 )) { RegionEU868ApplyCFList( applyCFList );}
+#define EU868_CHAN_MASK_SET( )                     else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868ChanMaskSet( chanMaskSet ); }
+#define EU868_ADR_NEXT( )                          else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868AdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
+#define EU868_COMPUTE_RX_WINDOW_PARAMETERS( )      else if(REGION_IS( LORAMAC_REGION_EU868 )) { RegionEU868ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
+#define EU868_RX_CONFIG( )                         else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868RxConfig( rxConfig, datarate ); }
+#define EU868_TX_CONFIG( )                         else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868TxConfig( txConfig, txPower, txTimeOnAir ); }
+#define EU868_LINK_ADR_REQ( )                      else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
+#define EU868_RX_PARAM_SETUP_REQ( )                else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868RxParamSetupReq( rxParamSetupReq ); }
+#define EU868_NEW_CHANNEL_REQ( )                   else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868NewChannelReq( newChannelReq ); }
+#define EU868_TX_PARAM_SETUP_REQ( )                else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868TxParamSetupReq( txParamSetupReq ); }
+#define EU868_DL_CHANNEL_REQ( )                    else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868DlChannelReq( dlChannelReq ); }
+#define EU868_ALTERNATE_DR( )                      else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868AlternateDr( alternateDr ); }
+#define EU868_CALC_BACKOFF( )                      else if(REGION_IS( LORAMAC_REGION_EU868 )) { RegionEU868CalcBackOff( calcBackOff );}
+#define EU868_NEXT_CHANNEL( )                      else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868NextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
+#define EU868_CHANNEL_ADD( )                       else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868ChannelAdd( channelAdd ); }
+#define EU868_CHANNEL_REMOVE( )                    else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868ChannelsRemove( channelRemove ); }
+#define EU868_CHANNEL_MANUAL_ADD( )                else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868ChannelManualAdd( channelAdd ); }
+#define EU868_CHANNEL_MANUAL_REMOVE( )             else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868ChannelsRemove( channelRemove ); }
+#define EU868_SET_CONTINUOUS_WAVE( )               else if(REGION_IS( LORAMAC_REGION_EU868 )) { RegionEU868SetContinuousWave( continuousWave );}
+#define EU868_APPLY_DR_OFFSET( )                   else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868ApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
+#define EU868_GET_CHANNELS( )                      else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868GetChannels( channels, size ); }
+#define EU868_GET_CHANNEL_MASK( )                  else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868GetChannelMask( channelmask, size ); }
+#define EU868_FORCE_JOIN_DATARATE( )               else if(REGION_IS( LORAMAC_REGION_EU868 )) { return RegionEU868ForceJoinDataRate( joinDr, alternateDr ); }
 #else
 #define EU868_IS_ACTIVE( )
 #define EU868_GET_PHY_PARAM( )
@@ -384,28 +392,28 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #ifdef REGION_KR920
 #include "RegionKR920.h"
 #define KR920_IS_ACTIVE( )                         else if(region == LORAMAC_REGION_KR920) { return true; }
-#define KR920_GET_PHY_PARAM( )                     else if(region == LORAMAC_REGION_KR920) { return RegionKR920GetPhyParam( getPhy  ); }
-#define KR920_SET_BAND_TX_DONE( )                  else if(region == LORAMAC_REGION_KR920) { RegionKR920SetBandTxDone( txDone );}
-#define KR920_INIT_DEFAULTS( )                     else if(region == LORAMAC_REGION_KR920) { RegionKR920InitDefaults( type );}
-#define KR920_VERIFY( )                            else if(region == LORAMAC_REGION_KR920) { return RegionKR920Verify( verify, phyAttribute ); }
-#define KR920_APPLY_CF_LIST( )                     else if(region == LORAMAC_REGION_KR920) { RegionKR920ApplyCFList( applyCFList );}
-#define KR920_CHAN_MASK_SET( )                     else if(region == LORAMAC_REGION_KR920) { return RegionKR920ChanMaskSet( chanMaskSet ); }
-#define KR920_ADR_NEXT( )                          else if(region == LORAMAC_REGION_KR920) { return RegionKR920AdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
-#define KR920_COMPUTE_RX_WINDOW_PARAMETERS( )      else if(region == LORAMAC_REGION_KR920) { RegionKR920ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
-#define KR920_RX_CONFIG( )                         else if(region == LORAMAC_REGION_KR920) { return RegionKR920RxConfig( rxConfig, datarate ); }
-#define KR920_TX_CONFIG( )                         else if(region == LORAMAC_REGION_KR920) { return RegionKR920TxConfig( txConfig, txPower, txTimeOnAir ); }
-#define KR920_LINK_ADR_REQ( )                      else if(region == LORAMAC_REGION_KR920) { return RegionKR920LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
-#define KR920_RX_PARAM_SETUP_REQ( )                else if(region == LORAMAC_REGION_KR920) { return RegionKR920RxParamSetupReq( rxParamSetupReq ); }
-#define KR920_NEW_CHANNEL_REQ( )                   else if(region == LORAMAC_REGION_KR920) { return RegionKR920NewChannelReq( newChannelReq ); }
-#define KR920_TX_PARAM_SETUP_REQ( )                else if(region == LORAMAC_REGION_KR920) { return RegionKR920TxParamSetupReq( txParamSetupReq ); }
-#define KR920_DL_CHANNEL_REQ( )                    else if(region == LORAMAC_REGION_KR920) { return RegionKR920DlChannelReq( dlChannelReq ); }
-#define KR920_ALTERNATE_DR( )                      else if(region == LORAMAC_REGION_KR920) { return RegionKR920AlternateDr( alternateDr ); }
-#define KR920_CALC_BACKOFF( )                      else if(region == LORAMAC_REGION_KR920) { RegionKR920CalcBackOff( calcBackOff );}
-#define KR920_NEXT_CHANNEL( )                      else if(region == LORAMAC_REGION_KR920) { return RegionKR920NextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
-#define KR920_CHANNEL_ADD( )                       else if(region == LORAMAC_REGION_KR920) { return RegionKR920ChannelAdd( channelAdd ); }
-#define KR920_CHANNEL_REMOVE( )                    else if(region == LORAMAC_REGION_KR920) { return RegionKR920ChannelsRemove( channelRemove ); }
-#define KR920_SET_CONTINUOUS_WAVE( )               else if(region == LORAMAC_REGION_KR920) { RegionKR920SetContinuousWave( continuousWave );}
-#define KR920_APPLY_DR_OFFSET( )                   else if(region == LORAMAC_REGION_KR920) { return RegionKR920ApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
+#define KR920_GET_PHY_PARAM( )                     else if(REGION_IS( LORAMAC_REGION_KR920 )) { return RegionKR920GetPhyParam( getPhy  ); }
+#define KR920_SET_BAND_TX_DONE( )                  else if(REGION_IS( LORAMAC_REGION_KR920 )) { RegionKR920SetBandTxDone( txDone );}
+#define KR920_INIT_DEFAULTS( )                     else if(REGION_IS( LORAMAC_REGION_KR920 )) { RegionKR920InitDefaults( type );}
+#define KR920_VERIFY( )                            else if(REGION_IS( LORAMAC_REGION_KR920 )) { return RegionKR920Verify( verify, phyAttribute ); }
+#define KR920_APPLY_CF_LIST( )                     else if(REGION_IS( LORAMAC_REGION_KR920 )) { RegionKR920ApplyCFList( applyCFList );}
+#define KR920_CHAN_MASK_SET( )                     else if(REGION_IS( LORAMAC_REGION_KR920 )) { return RegionKR920ChanMaskSet( chanMaskSet ); }
+#define KR920_ADR_NEXT( )                          else if(REGION_IS( LORAMAC_REGION_KR920 )) { return RegionKR920AdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
+#define KR920_COMPUTE_RX_WINDOW_PARAMETERS( )      else if(REGION_IS( LORAMAC_REGION_KR920 )) { RegionKR920ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
+#define KR920_RX_CONFIG( )                         else if(REGION_IS( LORAMAC_REGION_KR920 )) { return RegionKR920RxConfig( rxConfig, datarate ); }
+#define KR920_TX_CONFIG( )                         else if(REGION_IS( LORAMAC_REGION_KR920 )) { return RegionKR920TxConfig( txConfig, txPower, txTimeOnAir ); }
+#define KR920_LINK_ADR_REQ( )                      else if(REGION_IS( LORAMAC_REGION_KR920 )) { return RegionKR920LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
+#define KR920_RX_PARAM_SETUP_REQ( )                else if(REGION_IS( LORAMAC_REGION_KR920 )) { return RegionKR920RxParamSetupReq( rxParamSetupReq ); }
+#define KR920_NEW_CHANNEL_REQ( )                   else if(REGION_IS( LORAMAC_REGION_KR920 )) { return RegionKR920NewChannelReq( newChannelReq ); }
+#define KR920_TX_PARAM_SETUP_REQ( )                else if(REGION_IS( LORAMAC_REGION_KR920 )) { return RegionKR920TxParamSetupReq( txParamSetupReq ); }
+#define KR920_DL_CHANNEL_REQ( )                    else if(REGION_IS( LORAMAC_REGION_KR920 )) { return RegionKR920DlChannelReq( dlChannelReq ); }
+#define KR920_ALTERNATE_DR( )                      else if(REGION_IS( LORAMAC_REGION_KR920 )) { return RegionKR920AlternateDr( alternateDr ); }
+#define KR920_CALC_BACKOFF( )                      else if(REGION_IS( LORAMAC_REGION_KR920 )) { RegionKR920CalcBackOff( calcBackOff );}
+#define KR920_NEXT_CHANNEL( )                      else if(REGION_IS( LORAMAC_REGION_KR920 )) { return RegionKR920NextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
+#define KR920_CHANNEL_ADD( )                       else if(REGION_IS( LORAMAC_REGION_KR920 )) { return RegionKR920ChannelAdd( channelAdd ); }
+#define KR920_CHANNEL_REMOVE( )                    else if(REGION_IS( LORAMAC_REGION_KR920 )) { return RegionKR920ChannelsRemove( channelRemove ); }
+#define KR920_SET_CONTINUOUS_WAVE( )               else if(REGION_IS( LORAMAC_REGION_KR920 )) { RegionKR920SetContinuousWave( continuousWave );}
+#define KR920_APPLY_DR_OFFSET( )                   else if(REGION_IS( LORAMAC_REGION_KR920 )) { return RegionKR920ApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
 #else
 #define KR920_IS_ACTIVE( )
 #define KR920_GET_PHY_PARAM( )
@@ -435,33 +443,33 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #ifdef REGION_IN865
 #include "RegionIN865.h"
 #define IN865_IS_ACTIVE( )                        else if(region == LORAMAC_REGION_IN865) { return true; }
-#define IN865_GET_PHY_PARAM( )                    else if(region == LORAMAC_REGION_IN865) { return RegionIN865GetPhyParam( getPhy ); }
-#define IN865_SET_BAND_TX_DONE( )                 else if(region == LORAMAC_REGION_IN865) { RegionIN865SetBandTxDone( txDone );}
-#define IN865_INIT_DEFAULTS( )                    else if(region == LORAMAC_REGION_IN865) { RegionIN865InitDefaults( type );}
-#define IN865_VERIFY( )                           else if(region == LORAMAC_REGION_IN865) { return RegionIN865Verify( verify, phyAttribute ); }
-#define IN865_APPLY_CF_LIST( )                    else if(region == LORAMAC_REGION_IN865) { RegionIN865ApplyCFList( applyCFList );}
-#define IN865_CHAN_MASK_SET( )                    else if(region == LORAMAC_REGION_IN865) { return RegionIN865ChanMaskSet( chanMaskSet ); }
-#define IN865_ADR_NEXT( )                         else if(region == LORAMAC_REGION_IN865) { return RegionIN865AdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
-#define IN865_COMPUTE_RX_WINDOW_PARAMETERS( )     else if(region == LORAMAC_REGION_IN865) { RegionIN865ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
-#define IN865_RX_CONFIG( )                        else if(region == LORAMAC_REGION_IN865) { return RegionIN865RxConfig( rxConfig, datarate ); }
-#define IN865_TX_CONFIG( )                        else if(region == LORAMAC_REGION_IN865) { return RegionIN865TxConfig( txConfig, txPower, txTimeOnAir ); }
-#define IN865_LINK_ADR_REQ( )                     else if(region == LORAMAC_REGION_IN865) { return RegionIN865LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
-#define IN865_RX_PARAM_SETUP_REQ( )               else if(region == LORAMAC_REGION_IN865) { return RegionIN865RxParamSetupReq( rxParamSetupReq ); }
-#define IN865_NEW_CHANNEL_REQ( )                  else if(region == LORAMAC_REGION_IN865) { return RegionIN865NewChannelReq( newChannelReq ); }
-#define IN865_TX_PARAM_SETUP_REQ( )               else if(region == LORAMAC_REGION_IN865) { return RegionIN865TxParamSetupReq( txParamSetupReq ); }
-#define IN865_DL_CHANNEL_REQ( )                   else if(region == LORAMAC_REGION_IN865) { return RegionIN865DlChannelReq( dlChannelReq ); }
-#define IN865_ALTERNATE_DR( )                     else if(region == LORAMAC_REGION_IN865) { return RegionIN865AlternateDr( alternateDr ); }
-#define IN865_CALC_BACKOFF( )                     else if(region == LORAMAC_REGION_IN865) { RegionIN865CalcBackOff( calcBackOff );}
-#define IN865_NEXT_CHANNEL( )                     else if(region == LORAMAC_REGION_IN865) { return RegionIN865NextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
-#define IN865_CHANNEL_ADD( )                      else if(region == LORAMAC_REGION_IN865) { return RegionIN865ChannelAdd( channelAdd ); }
-#define IN865_CHANNEL_REMOVE( )                   else if(region == LORAMAC_REGION_IN865) { return RegionIN865ChannelsRemove( channelRemove ); }
-#define IN865_CHANNEL_MANUAL_ADD( )               else if(region == LORAMAC_REGION_IN865) { return RegionIN865ChannelManualAdd( channelAdd ); }
-#define IN865_CHANNEL_MANUAL_REMOVE( )            else if(region == LORAMAC_REGION_IN865) { return RegionIN865ChannelsRemove( channelRemove ); }
-#define IN865_SET_CONTINUOUS_WAVE( )              else if(region == LORAMAC_REGION_IN865) { RegionIN865SetContinuousWave( continuousWave );}
-#define IN865_APPLY_DR_OFFSET( )                  else if(region == LORAMAC_REGION_IN865) { return RegionIN865ApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
-#define IN865_GET_CHANNELS( )                     else if(region == LORAMAC_REGION_IN865) { return RegionIN865GetChannels( channels, size ); }
-#define IN865_GET_CHANNEL_MASK( )                 else if(region == LORAMAC_REGION_IN865) { return RegionIN865GetChannelMask( channelmask, size ); }
-#define IN865_FORCE_JOIN_DATARATE( )              else if(region == LORAMAC_REGION_IN865) { return RegionIN865ForceJoinDataRate( joinDr, alternateDr ); }
+#define IN865_GET_PHY_PARAM( )                    else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865GetPhyParam( getPhy ); }
+#define IN865_SET_BAND_TX_DONE( )                 else if(REGION_IS( LORAMAC_REGION_IN865 )) { RegionIN865SetBandTxDone( txDone );}
+#define IN865_INIT_DEFAULTS( )                    else if(REGION_IS( LORAMAC_REGION_IN865 )) { RegionIN865InitDefaults( type );}
+#define IN865_VERIFY( )                           else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865Verify( verify, phyAttribute ); }
+#define IN865_APPLY_CF_LIST( )                    else if(REGION_IS( LORAMAC_REGION_IN865 )) { RegionIN865ApplyCFList( applyCFList );}
+#define IN865_CHAN_MASK_SET( )                    else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865ChanMaskSet( chanMaskSet ); }
+#define IN865_ADR_NEXT( )                         else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865AdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
+#define IN865_COMPUTE_RX_WINDOW_PARAMETERS( )     else if(REGION_IS( LORAMAC_REGION_IN865 )) { RegionIN865ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
+#define IN865_RX_CONFIG( )                        else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865RxConfig( rxConfig, datarate ); }
+#define IN865_TX_CONFIG( )                        else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865TxConfig( txConfig, txPower, txTimeOnAir ); }
+#define IN865_LINK_ADR_REQ( )                     else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
+#define IN865_RX_PARAM_SETUP_REQ( )               else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865RxParamSetupReq( rxParamSetupReq ); }
+#define IN865_NEW_CHANNEL_REQ( )                  else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865NewChannelReq( newChannelReq ); }
+#define IN865_TX_PARAM_SETUP_REQ( )               else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865TxParamSetupReq( txParamSetupReq ); }
+#define IN865_DL_CHANNEL_REQ( )                   else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865DlChannelReq( dlChannelReq ); }
+#define IN865_ALTERNATE_DR( )                     else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865AlternateDr( alternateDr ); }
+#define IN865_CALC_BACKOFF( )                     else if(REGION_IS( LORAMAC_REGION_IN865 )) { RegionIN865CalcBackOff( calcBackOff );}
+#define IN865_NEXT_CHANNEL( )                     else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865NextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
+#define IN865_CHANNEL_ADD( )                      else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865ChannelAdd( channelAdd ); }
+#define IN865_CHANNEL_REMOVE( )                   else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865ChannelsRemove( channelRemove ); }
+#define IN865_CHANNEL_MANUAL_ADD( )               else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865ChannelManualAdd( channelAdd ); }
+#define IN865_CHANNEL_MANUAL_REMOVE( )            else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865ChannelsRemove( channelRemove ); }
+#define IN865_SET_CONTINUOUS_WAVE( )              else if(REGION_IS( LORAMAC_REGION_IN865 )) { RegionIN865SetContinuousWave( continuousWave );}
+#define IN865_APPLY_DR_OFFSET( )                  else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865ApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
+#define IN865_GET_CHANNELS( )                     else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865GetChannels( channels, size ); }
+#define IN865_GET_CHANNEL_MASK( )                 else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865GetChannelMask( channelmask, size ); }
+#define IN865_FORCE_JOIN_DATARATE( )              else if(REGION_IS( LORAMAC_REGION_IN865 )) { return RegionIN865ForceJoinDataRate( joinDr, alternateDr ); }
 #else
 #define IN865_IS_ACTIVE( )
 #define IN865_GET_PHY_PARAM( )
@@ -496,34 +504,34 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #ifdef REGION_US915
 #include "RegionUS915.h"
 #define US915_IS_ACTIVE( )                         else if(region == LORAMAC_REGION_US915) { return true; }
-#define US915_GET_PHY_PARAM( )                     else if(region == LORAMAC_REGION_US915) { return RegionUS915GetPhyParam( getPhy ); }
-#define US915_SET_BAND_TX_DONE( )                  else if(region == LORAMAC_REGION_US915) { RegionUS915SetBandTxDone( txDone );}
-#define US915_INIT_DEFAULTS( )                     else if(region == LORAMAC_REGION_US915) { RegionUS915InitDefaults( type );}
-#define US915_VERIFY( )                            else if(region == LORAMAC_REGION_US915) { return RegionUS915Verify( verify, phyAttribute ); }
-#define US915_APPLY_CF_LIST( )                     else if(region == LORAMAC_REGION_US915) { RegionUS915ApplyCFList( applyCFList );}
-#define US915_CHAN_MASK_SET( )                     else if(region == LORAMAC_REGION_US915) { return RegionUS915ChanMaskSet( chanMaskSet ); }
-#define US915_ADR_NEXT( )                          else if(region == LORAMAC_REGION_US915) { return RegionUS915AdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
-#define US915_COMPUTE_RX_WINDOW_PARAMETERS( )      else if(region == LORAMAC_REGION_US915) { RegionUS915ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
-#define US915_RX_CONFIG( )                         else if(region == LORAMAC_REGION_US915) { return RegionUS915RxConfig( rxConfig, datarate ); }
-#define US915_TX_CONFIG( )                         else if(region == LORAMAC_REGION_US915) { return RegionUS915TxConfig( txConfig, txPower, txTimeOnAir ); }
-#define US915_LINK_ADR_REQ( )                      else if(region == LORAMAC_REGION_US915) { return RegionUS915LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
-#define US915_RX_PARAM_SETUP_REQ( )                else if(region == LORAMAC_REGION_US915) { return RegionUS915RxParamSetupReq( rxParamSetupReq ); }
-#define US915_NEW_CHANNEL_REQ( )                   else if(region == LORAMAC_REGION_US915) { return RegionUS915NewChannelReq( newChannelReq ); }
-#define US915_TX_PARAM_SETUP_REQ( )                else if(region == LORAMAC_REGION_US915) { return RegionUS915TxParamSetupReq( txParamSetupReq ); }
-#define US915_DL_CHANNEL_REQ( )                    else if(region == LORAMAC_REGION_US915) { return RegionUS915DlChannelReq( dlChannelReq ); }
-#define US915_ALTERNATE_DR( )                      else if(region == LORAMAC_REGION_US915) { return RegionUS915AlternateDr( alternateDr ); }
-#define US915_CALC_BACKOFF( )                      else if(region == LORAMAC_REGION_US915) { RegionUS915CalcBackOff( calcBackOff );}
-#define US915_NEXT_CHANNEL( )                      else if(region == LORAMAC_REGION_US915) { return RegionUS915NextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
-#define US915_CHANNEL_ADD( )                       else if(region == LORAMAC_REGION_US915) { return RegionUS915ChannelAdd( channelAdd ); }
-#define US915_CHANNEL_REMOVE( )                    else if(region == LORAMAC_REGION_US915) { return RegionUS915ChannelsRemove( channelRemove ); }
-#define US915_CHANNEL_MANUAL_ADD( )                else if(region == LORAMAC_REGION_US915) { return RegionUS915ChannelManualAdd( channelAdd ); }
-#define US915_CHANNEL_MANUAL_REMOVE( )             else if(region == LORAMAC_REGION_US915) { return RegionUS915ChannelsManualRemove( channelRemove ); }
-#define US915_SET_CONTINUOUS_WAVE( )               else if(region == LORAMAC_REGION_US915) { RegionUS915SetContinuousWave( continuousWave );}
-#define US915_APPLY_DR_OFFSET( )                   else if(region == LORAMAC_REGION_US915) { return RegionUS915ApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
-#define US915_GET_CHANNELS( )                      else if(region == LORAMAC_REGION_US915) { return RegionUS915GetChannels( channels, size ); }
-#define US915_GET_CHANNEL_MASK( )                  else if(region == LORAMAC_REGION_US915) { return RegionUS915GetChannelMask( channelmask, size ); }
-#define US915_GET_CHANNEL_MASK_REMAINING( )        else if(region == LORAMAC_REGION_US915) { return RegionUS915GetChannelMaskRemaining( channelmask, size ); }
-#define US915_FORCE_JOIN_DATARATE( )               else if(region == LORAMAC_REGION_US915) { return RegionUS915ForceJoinDataRate( joinDr, alternateDr ); }
+#define US915_GET_PHY_PARAM( )                     else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915GetPhyParam( getPhy ); }
+#define US915_SET_BAND_TX_DONE( )                  else if(REGION_IS( LORAMAC_REGION_US915 )) { RegionUS915SetBandTxDone( txDone );}
+#define US915_INIT_DEFAULTS( )                     else if(REGION_IS( LORAMAC_REGION_US915 )) { RegionUS915InitDefaults( type );}
+#define US915_VERIFY( )                            else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915Verify( verify, phyAttribute ); }
+#define US915_APPLY_CF_LIST( )                     else if(REGION_IS( LORAMAC_REGION_US915 )) { RegionUS915ApplyCFList( applyCFList );}
+#define US915_CHAN_MASK_SET( )                     else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915ChanMaskSet( chanMaskSet ); }
+#define US915_ADR_NEXT( )                          else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915AdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
+#define US915_COMPUTE_RX_WINDOW_PARAMETERS( )      else if(REGION_IS( LORAMAC_REGION_US915 )) { RegionUS915ComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
+#define US915_RX_CONFIG( )                         else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915RxConfig( rxConfig, datarate ); }
+#define US915_TX_CONFIG( )                         else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915TxConfig( txConfig, txPower, txTimeOnAir ); }
+#define US915_LINK_ADR_REQ( )                      else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915LinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
+#define US915_RX_PARAM_SETUP_REQ( )                else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915RxParamSetupReq( rxParamSetupReq ); }
+#define US915_NEW_CHANNEL_REQ( )                   else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915NewChannelReq( newChannelReq ); }
+#define US915_TX_PARAM_SETUP_REQ( )                else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915TxParamSetupReq( txParamSetupReq ); }
+#define US915_DL_CHANNEL_REQ( )                    else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915DlChannelReq( dlChannelReq ); }
+#define US915_ALTERNATE_DR( )                      else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915AlternateDr( alternateDr ); }
+#define US915_CALC_BACKOFF( )                      else if(REGION_IS( LORAMAC_REGION_US915 )) { RegionUS915CalcBackOff( calcBackOff );}
+#define US915_NEXT_CHANNEL( )                      else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915NextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
+#define US915_CHANNEL_ADD( )                       else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915ChannelAdd( channelAdd ); }
+#define US915_CHANNEL_REMOVE( )                    else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915ChannelsRemove( channelRemove ); }
+#define US915_CHANNEL_MANUAL_ADD( )                else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915ChannelManualAdd( channelAdd ); }
+#define US915_CHANNEL_MANUAL_REMOVE( )             else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915ChannelsManualRemove( channelRemove ); }
+#define US915_SET_CONTINUOUS_WAVE( )               else if(REGION_IS( LORAMAC_REGION_US915 )) { RegionUS915SetContinuousWave( continuousWave );}
+#define US915_APPLY_DR_OFFSET( )                   else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915ApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
+#define US915_GET_CHANNELS( )                      else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915GetChannels( channels, size ); }
+#define US915_GET_CHANNEL_MASK( )                  else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915GetChannelMask( channelmask, size ); }
+#define US915_GET_CHANNEL_MASK_REMAINING( )        else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915GetChannelMaskRemaining( channelmask, size ); }
+#define US915_FORCE_JOIN_DATARATE( )               else if(REGION_IS( LORAMAC_REGION_US915 )) { return RegionUS915ForceJoinDataRate( joinDr, alternateDr ); }
 #else
 #define US915_IS_ACTIVE( )
 #define US915_GET_PHY_PARAM( )
@@ -559,34 +567,34 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jae
 #ifdef REGION_US915_HYBRID
 #include "RegionUS915-Hybrid.h"
 #define US915_HYBRID_IS_ACTIVE( )                         else if(region == LORAMAC_REGION_US915_HYBRID) { return true; }
-#define US915_HYBRID_GET_PHY_PARAM( )                     else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridGetPhyParam( getPhy ); }
-#define US915_HYBRID_SET_BAND_TX_DONE( )                  else if(region == LORAMAC_REGION_US915_HYBRID) { RegionUS915HybridSetBandTxDone( txDone );}
-#define US915_HYBRID_INIT_DEFAULTS( )                     else if(region == LORAMAC_REGION_US915_HYBRID) { RegionUS915HybridInitDefaults( type );}
-#define US915_HYBRID_VERIFY( )                            else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridVerify( verify, phyAttribute ); }
-#define US915_HYBRID_APPLY_CF_LIST( )                     else if(region == LORAMAC_REGION_US915_HYBRID) { RegionUS915HybridApplyCFList( applyCFList );}
-#define US915_HYBRID_CHAN_MASK_SET( )                     else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridChanMaskSet( chanMaskSet ); }
-#define US915_HYBRID_ADR_NEXT( )                          else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridAdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
-#define US915_HYBRID_COMPUTE_RX_WINDOW_PARAMETERS( )      else if(region == LORAMAC_REGION_US915_HYBRID) { RegionUS915HybridComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
-#define US915_HYBRID_RX_CONFIG( )                         else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridRxConfig( rxConfig, datarate ); }
-#define US915_HYBRID_TX_CONFIG( )                         else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridTxConfig( txConfig, txPower, txTimeOnAir ); }
-#define US915_HYBRID_LINK_ADR_REQ( )                      else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridLinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
-#define US915_HYBRID_RX_PARAM_SETUP_REQ( )                else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridRxParamSetupReq( rxParamSetupReq ); }
-#define US915_HYBRID_NEW_CHANNEL_REQ( )                   else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridNewChannelReq( newChannelReq ); }
-#define US915_HYBRID_TX_PARAM_SETUP_REQ( )                else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridTxParamSetupReq( txParamSetupReq ); }
-#define US915_HYBRID_DL_CHANNEL_REQ( )                    else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridDlChannelReq( dlChannelReq ); }
-#define US915_HYBRID_ALTERNATE_DR( )                      else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridAlternateDr( alternateDr ); }
-#define US915_HYBRID_CALC_BACKOFF( )                      else if(region == LORAMAC_REGION_US915_HYBRID) { RegionUS915HybridCalcBackOff( calcBackOff );}
-#define US915_HYBRID_NEXT_CHANNEL( )                      else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridNextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
-#define US915_HYBRID_CHANNEL_ADD( )                       else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridChannelAdd( channelAdd ); }
-#define US915_HYBRID_CHANNEL_REMOVE( )                    else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridChannelsRemove( channelRemove ); }
-#define US915_HYBRID_CHANNEL_MANUAL_ADD( )                else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridChannelManualAdd( channelAdd ); }
-#define US915_HYBRID_CHANNEL_MANUAL_REMOVE( )             else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridChannelsManualRemove( channelRemove ); }
-#define US915_HYBRID_SET_CONTINUOUS_WAVE( )               else if(region == LORAMAC_REGION_US915_HYBRID) { RegionUS915HybridSetContinuousWave( continuousWave );}
-#define US915_HYBRID_APPLY_DR_OFFSET( )                   else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
-#define US915_HYBRID_GET_CHANNELS( )                      else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridGetChannels( channels, size ); }
-#define US915_HYBRID_GET_CHANNEL_MASK( )                  else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridGetChannelMask( channelmask, size ); }
-#define US915_HYBRID_GET_CHANNEL_MASK_REMAINING( )        else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridGetChannelMaskRemaining( channelmask, size ); }
-#define US915_HYBRID_FORCE_JOIN_DATARATE( )               else if(region == LORAMAC_REGION_US915_HYBRID) { return RegionUS915HybridForceJoinDataRate( joinDr, alternateDr ); }
+#define US915_HYBRID_GET_PHY_PARAM( )                     else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridGetPhyParam( getPhy ); }
+#define US915_HYBRID_SET_BAND_TX_DONE( )                  else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { RegionUS915HybridSetBandTxDone( txDone );}
+#define US915_HYBRID_INIT_DEFAULTS( )                     else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { RegionUS915HybridInitDefaults( type );}
+#define US915_HYBRID_VERIFY( )                            else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridVerify( verify, phyAttribute ); }
+#define US915_HYBRID_APPLY_CF_LIST( )                     else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { RegionUS915HybridApplyCFList( applyCFList );}
+#define US915_HYBRID_CHAN_MASK_SET( )                     else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridChanMaskSet( chanMaskSet ); }
+#define US915_HYBRID_ADR_NEXT( )                          else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridAdrNext( adrNext, drOut, txPowOut, adrAckCounter ); }
+#define US915_HYBRID_COMPUTE_RX_WINDOW_PARAMETERS( )      else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { RegionUS915HybridComputeRxWindowParameters( datarate, minRxSymbols, rxError, rxConfigParams );}
+#define US915_HYBRID_RX_CONFIG( )                         else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridRxConfig( rxConfig, datarate ); }
+#define US915_HYBRID_TX_CONFIG( )                         else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridTxConfig( txConfig, txPower, txTimeOnAir ); }
+#define US915_HYBRID_LINK_ADR_REQ( )                      else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridLinkAdrReq( linkAdrReq, drOut, txPowOut, nbRepOut, nbBytesParsed ); }
+#define US915_HYBRID_RX_PARAM_SETUP_REQ( )                else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridRxParamSetupReq( rxParamSetupReq ); }
+#define US915_HYBRID_NEW_CHANNEL_REQ( )                   else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridNewChannelReq( newChannelReq ); }
+#define US915_HYBRID_TX_PARAM_SETUP_REQ( )                else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridTxParamSetupReq( txParamSetupReq ); }
+#define US915_HYBRID_DL_CHANNEL_REQ( )                    else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridDlChannelReq( dlChannelReq ); }
+#define US915_HYBRID_ALTERNATE_DR( )                      else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridAlternateDr( alternateDr ); }
+#define US915_HYBRID_CALC_BACKOFF( )                      else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { RegionUS915HybridCalcBackOff( calcBackOff );}
+#define US915_HYBRID_NEXT_CHANNEL( )                      else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridNextChannel( nextChanParams, channel, time, aggregatedTimeOff ); }
+#define US915_HYBRID_CHANNEL_ADD( )                       else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridChannelAdd( channelAdd ); }
+#define US915_HYBRID_CHANNEL_REMOVE( )                    else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridChannelsRemove( channelRemove ); }
+#define US915_HYBRID_CHANNEL_MANUAL_ADD( )                else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridChannelManualAdd( channelAdd ); }
+#define US915_HYBRID_CHANNEL_MANUAL_REMOVE( )             else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridChannelsManualRemove( channelRemove ); }
+#define US915_HYBRID_SET_CONTINUOUS_WAVE( )               else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { RegionUS915HybridSetContinuousWave( continuousWave );}
+#define US915_HYBRID_APPLY_DR_OFFSET( )                   else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridApplyDrOffset( downlinkDwellTime, dr, drOffset ); }
+#define US915_HYBRID_GET_CHANNELS( )                      else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridGetChannels( channels, size ); }
+#define US915_HYBRID_GET_CHANNEL_MASK( )                  else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridGetChannelMask( channelmask, size ); }
+#define US915_HYBRID_GET_CHANNEL_MASK_REMAINING( )        else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridGetChannelMaskRemaining( channelmask, size ); }
+#define US915_HYBRID_FORCE_JOIN_DATARATE( )               else if(REGION_IS( LORAMAC_REGION_US915_HYBRID )) { return RegionUS915HybridForceJoinDataRate( joinDr, alternateDr ); }
 #else
 #define US915_HYBRID_IS_ACTIVE( )
 #define US915_HYBRID_GET_PHY_PARAM( )
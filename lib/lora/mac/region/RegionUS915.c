@@ -64,6 +64,13 @@ static uint16_t ChannelsMaskRemaining[CHANNELS_MASK_SIZE];
  */
 static uint16_t ChannelsDefaultMask[CHANNELS_MASK_SIZE];
 
+/*!
+ * Channels supporting each datarate, in the layout of the channels mask.
+ * Rebuilt by the next channel selection after the channel list changed
+ */
+static uint16_t ChannelsDrMask[US915_TX_MAX_DATARATE + 1][CHANNELS_MASK_SIZE];
+static bool ChannelsDrMaskValid = false;
+
 // Static functions
 static int8_t GetNextLowerTxDr( int8_t dr, int8_t minDr )
 {
@@ -115,33 +122,55 @@ static int8_t LimitTxPower( int8_t txPower, int8_t maxBandTxPower, int8_t datara
     return txPowerResult;
 }
 
+static void UpdateChannelsDrMask( void )
+{
+    memset( ChannelsDrMask, 0, sizeof( ChannelsDrMask ) );
+    for( uint8_t i = 0; i < US915_MAX_NB_CHANNELS; i++ )
+    {
+        if( Channels[i].Frequency == 0 )
+        { // The channel is not enabled
+            continue;
+        }
+        for( int8_t dr = US915_TX_MIN_DATARATE; dr <= US915_TX_MAX_DATARATE; dr++ )
+        {
+            if( RegionCommonValueInRange( dr, Channels[i].DrRange.Fields.Min, Channels[i].DrRange.Fields.Max ) == true )
+            {
+                ChannelsDrMask[dr][i / 16] |= 1 << ( i % 16 );
+            }
+        }
+    }
+    ChannelsDrMaskValid = true;
+}
+
 static uint8_t CountNbOfEnabledChannels( uint8_t datarate, uint16_t* channelsMask, ChannelParams_t* channels, Band_t* bands, uint8_t* enabledChannels, uint8_t* delayTx )
 {
     uint8_t nbEnabledChannels = 0;
     uint8_t delayTransmission = 0;
 
-    for( uint8_t i = 0, k = 0; i < US915_MAX_NB_CHANNELS; i += 16, k++ )
+    if( datarate > US915_TX_MAX_DATARATE )
+    { // No channel supports the given datarate
+        *delayTx = 0;
+        return 0;
+    }
+    if( ChannelsDrMaskValid == false )
+    {
+        UpdateChannelsDrMask( );
+    }
+
+    for( uint8_t k = 0; k < ( US915_MAX_NB_CHANNELS + 15 ) / 16; k++ )
     {
-        for( uint8_t j = 0; j < 16; j++ )
+        // Only the channels of the mask that exist and support the datarate are visited
+        uint16_t mask = channelsMask[k] & ChannelsDrMask[datarate][k];
+        while( mask != 0 )
         {
-            if( ( channelsMask[k] & ( 1 << j ) ) != 0 )
-            {
-                if( channels[i + j].Frequency == 0 )
-                { // Check if the channel is enabled
-                    continue;
-                }
-                if( RegionCommonValueInRange( datarate, channels[i + j].DrRange.Fields.Min,
-                                              channels[i + j].DrRange.Fields.Max ) == false )
-                { // Check if the current channel selection supports the given datarate
-                    continue;
-                }
-                if( bands[channels[i + j].Band].TimeOff > 0 )
-                { // Check if the band is available for transmission
-                    delayTransmission++;
-                    continue;
-                }
-                enabledChannels[nbEnabledChannels++] = i + j;
+            uint8_t i = k * 16 + __builtin_ctz( mask );
+            mask &= mask - 1;
+            if( bands[channels[i].Band].TimeOff > 0 )
+            { // Check if the band is available for transmission
+                delayTransmission++;
+                continue;
             }
+            enabledChannels[nbEnabledChannels++] = i;
         }
     }
 
@@ -303,6 +332,7 @@ void RegionUS915InitDefaults( InitType_t type )
     {
         case INIT_TYPE_INIT:
         {
+            ChannelsDrMaskValid = false;
             // Channels
             // 125 kHz channels
             for( uint8_t i = 0; i < US915_MAX_NB_CHANNELS - 8; i++ )
@@ -883,6 +913,7 @@ LoRaMacStatus_t RegionUS915ChannelManualAdd( ChannelAddParams_t* channelAdd )
 
     memcpy( &(Channels[id]), channelAdd->NewChannel, sizeof( Channels[id] ) );
     Channels[id].Band = band;
+    ChannelsDrMaskValid = false;
     ChannelsMask[ (id / 16) ] |= (1 << (id % 16));
     // activate the channel in the remaining ones
     ChannelsMaskRemaining[id / 16] |= ChannelsMask[id / 16];
@@ -906,6 +937,7 @@ bool RegionUS915ChannelsManualRemove( ChannelRemoveParams_t* channelRemove  )
 
     // Remove the channel from the list of channels
     Channels[id] = ( ChannelParams_t ){ 0, 0, { 0 }, 0 };
+    ChannelsDrMaskValid = false;
 
     // Set the channel mask remaining accordingly
     ChannelsMaskRemaining[id / 16] &= ChannelsMask[id / 16];
@@ -938,6 +970,8 @@ uint8_t RegionUS915ApplyDrOffset( uint8_t downlinkDwellTime, int8_t dr, int8_t d
 
 bool RegionUS915GetChannels( ChannelParams_t** channels, uint32_t *size )
 {
+    // The caller may write the list, eg. when it is restored from NVS
+    ChannelsDrMaskValid = false;
     *channels = Channels;
     *size = sizeof(Channels);
     return true;
@@ -64,6 +64,8 @@
 
 #include "aes.h"
 
+#if !defined( LORA_HW_AES )
+
 //#if defined( HAVE_UINT_32T )
 //  typedef unsigned long uint32_t;
 //#endif
@@ -934,3 +936,5 @@ void aes_decrypt_256( const uint8_t in[N_BLOCK], uint8_t out[N_BLOCK],
 }
 
 #endif
+
+#endif /* !LORA_HW_AES */
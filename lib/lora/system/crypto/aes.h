@@ -63,10 +63,18 @@ typedef uint8_t return_type;
 
 typedef uint8_t length_type;
 
+#if defined( LORA_HW_AES )
+/*  The prekeyed calls are provided by the board using the hardware
+    AES engine, the context is the one of the platform driver
+*/
+#include "hwcrypto/aes.h"
+typedef esp_aes_context aes_context;
+#else
 typedef struct
 {   uint8_t ksch[(N_MAX_ROUNDS + 1) * N_BLOCK];
     uint8_t rnd;
 } aes_context;
+#endif
 
 /*  The following calls are for a precomputed key schedule
 
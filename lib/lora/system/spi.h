@@ -74,6 +74,17 @@ void SpiFrequency( Spi_t *obj, uint32_t hz );
  */
 #if defined(LOPY) || defined (LOPY4) || defined(FIPY)
 uint16_t SpiInOut( Spi_t *obj, uint16_t outData );
+
+/*!
+ * \brief Sends the address byte followed by size bytes in burst mode
+ *
+ * \param [IN]  obj       SPI object
+ * \param [IN]  addr      Address byte sent first
+ * \param [IN]  outBuffer Bytes to be sent (zeros are sent if NULL)
+ * \param [OUT] inBuffer  Received bytes (discarded if NULL)
+ * \param [IN]  size      Number of data bytes
+ */
+void SpiBurst( Spi_t *obj, uint8_t addr, const uint8_t *outBuffer, uint8_t *inBuffer, uint16_t size );
 #elif defined(SIPY)
 uint8_t SpiInOut(uint32_t spiNum, uint32_t outData);
 /*!
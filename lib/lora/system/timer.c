@@ -22,31 +22,44 @@ Maintainer: Miguel Luis and Gregory Cristian
 volatile uint8_t HasLoopedThroughMain = 0;
 
 /*!
- * Timers list head pointer
+ * Scheduled timers, kept as a binary min-heap ordered by expiry time.
+ * The first element always contains the next timer to expire.
  */
-static TimerEvent_t *TimerListHead = NULL;
+static TimerEvent_t *TimerHeap[TIMER_HEAP_SIZE_MAX];
 
 /*!
- * \brief Adds or replace the head timer of the list.
+ * Number of timers in the heap
+ */
+static uint32_t TimerHeapCount = 0;
+
+/*!
+ * \brief Checks if a timer expires before another one
  *
- * \remark The list is automatically sorted. The list head always contains the
- *         next timer to expire.
+ * \remark The comparison is done on the difference so that it survives
+ *         the roll over of the tick counter.
+ */
+static bool TimerExpiresBefore( TimerEvent_t *a, TimerEvent_t *b );
+
+/*!
+ * \brief Moves the timer at the given position up until the heap is ordered
  *
- * \param [IN]  obj Timer object to be become the new head
- * \param [IN]  remainingTime Remaining time of the previous head to be replaced
+ * \param [IN]  index Position of the timer in the heap
  */
-static void TimerInsertNewHeadTimer( TimerEvent_t *obj, uint32_t remainingTime );
+static void TimerHeapSiftUp( uint32_t index );
 
 /*!
- * \brief Adds a timer to the list.
+ * \brief Moves the timer at the given position down until the heap is ordered
  *
- * \remark The list is automatically sorted. The list head always contains the
- *         next timer to expire.
+ * \param [IN]  index Position of the timer in the heap
+ */
+static void TimerHeapSiftDown( uint32_t index );
+
+/*!
+ * \brief Removes the timer at the given position from the heap
  *
- * \param [IN]  obj Timer object to be added to the list
- * \param [IN]  remainingTime Remaining time of the running head after which the object may be added
+ * \param [IN]  index Position of the timer in the heap
  */
-static void TimerInsertTimer( TimerEvent_t *obj, uint32_t remainingTime );
+static void TimerHeapRemove( uint32_t index );
 
 /*!
  * \brief Sets a timeout with the duration "timestamp"
@@ -73,158 +86,118 @@ TimerTime_t TimerGetValue( void );
 
 void TimerInit( TimerEvent_t *obj, void ( *callback )( void ) )
 {
+    // re-initializing a scheduled timer must not leave it behind in the heap
+    TimerStop( obj );
+
     obj->Timestamp = 0;
     obj->ReloadValue = 0;
     obj->IsRunning = false;
     obj->Callback = callback;
-    obj->Next = NULL;
+    obj->HeapIndex = 0;
 }
 
 IRAM_ATTR void TimerStart( TimerEvent_t *obj )
 {
-    uint32_t elapsedTime = 0;
-    uint32_t remainingTime = 0;
-
     uint32_t ilevel = MICROPY_BEGIN_ATOMIC_SECTION();
 
-    if( ( obj == NULL ) || ( TimerExists( obj ) == true ) )
+    if( ( obj == NULL ) || ( TimerExists( obj ) == true ) || ( TimerHeapCount >= TIMER_HEAP_SIZE_MAX ) )
     {
         MICROPY_END_ATOMIC_SECTION(ilevel);
         return;
     }
 
-    obj->Timestamp = obj->ReloadValue;
-    obj->IsRunning = false;
+    obj->Timestamp = TimerGetCurrentTime( ) + obj->ReloadValue;
+    obj->IsRunning = true;
+    obj->HeapIndex = TimerHeapCount;
+    TimerHeap[TimerHeapCount++] = obj;
+    TimerHeapSiftUp( obj->HeapIndex );
 
-    if( TimerListHead == NULL )
+    if( TimerHeap[0] == obj )
     {
-        TimerInsertNewHeadTimer( obj, obj->Timestamp );
-    }
-    else
-    {
-        if( TimerListHead->IsRunning == true )
-        {
-            elapsedTime = TimerGetValue( );
-            if( elapsedTime > TimerListHead->Timestamp )
-            {
-                elapsedTime = TimerListHead->Timestamp; // security but should never occur
-            }
-            remainingTime = TimerListHead->Timestamp - elapsedTime;
-        }
-        else
-        {
-            remainingTime = TimerListHead->Timestamp;
-        }
-
-        if( obj->Timestamp < remainingTime )
-        {
-            TimerInsertNewHeadTimer( obj, remainingTime );
-        }
-        else
-        {
-             TimerInsertTimer( obj, remainingTime );
-        }
+        // the new timer is the next one to expire
+        TimerSetTimeout( obj );
     }
     MICROPY_END_ATOMIC_SECTION(ilevel);
 }
 
-static IRAM_ATTR void TimerInsertTimer( TimerEvent_t *obj, uint32_t remainingTime )
+static IRAM_ATTR bool TimerExpiresBefore( TimerEvent_t *a, TimerEvent_t *b )
 {
-    uint32_t aggregatedTimestamp = 0;      // hold the sum of timestamps
-    uint32_t aggregatedTimestampNext = 0;  // hold the sum of timestamps up to the next event
+    return ( int32_t )( a->Timestamp - b->Timestamp ) < 0;
+}
 
-    TimerEvent_t* prev = TimerListHead;
-    TimerEvent_t* cur = TimerListHead->Next;
+static IRAM_ATTR void TimerHeapSiftUp( uint32_t index )
+{
+    TimerEvent_t *obj = TimerHeap[index];
 
-    if( cur == NULL )
-    { // obj comes just after the head
-        obj->Timestamp -= remainingTime;
-        prev->Next = obj;
-        obj->Next = NULL;
-    }
-    else
+    while( index > 0 )
     {
-        aggregatedTimestamp = remainingTime;
-        aggregatedTimestampNext = remainingTime + cur->Timestamp;
-
-        while( prev != NULL )
+        uint32_t parent = ( index - 1 ) / 2;
+        if( TimerExpiresBefore( obj, TimerHeap[parent] ) == false )
         {
-            if( aggregatedTimestampNext > obj->Timestamp )
-            {
-                obj->Timestamp -= aggregatedTimestamp;
-                if( cur != NULL )
-                {
-                    cur->Timestamp -= obj->Timestamp;
-                }
-                prev->Next = obj;
-                obj->Next = cur;
-                break;
-            }
-            else
-            {
-                prev = cur;
-                cur = cur->Next;
-                if( cur == NULL )
-                { // obj comes at the end of the list
-                    aggregatedTimestamp = aggregatedTimestampNext;
-                    obj->Timestamp -= aggregatedTimestamp;
-                    prev->Next = obj;
-                    obj->Next = NULL;
-                    break;
-                }
-                else
-                {
-                    aggregatedTimestamp = aggregatedTimestampNext;
-                    aggregatedTimestampNext = aggregatedTimestampNext + cur->Timestamp;
-                }
-            }
+            break;
         }
+        TimerHeap[index] = TimerHeap[parent];
+        TimerHeap[index]->HeapIndex = index;
+        index = parent;
     }
+    TimerHeap[index] = obj;
+    obj->HeapIndex = index;
 }
 
-static IRAM_ATTR void TimerInsertNewHeadTimer( TimerEvent_t *obj, uint32_t remainingTime )
+static IRAM_ATTR void TimerHeapSiftDown( uint32_t index )
 {
-    TimerEvent_t* cur = TimerListHead;
+    TimerEvent_t *obj = TimerHeap[index];
 
-    if( cur != NULL )
+    for( ;; )
     {
-        cur->Timestamp = remainingTime - obj->Timestamp;
-        cur->IsRunning = false;
+        uint32_t child = ( index * 2 ) + 1;
+        if( child >= TimerHeapCount )
+        {
+            break;
+        }
+        if( ( ( child + 1 ) < TimerHeapCount ) && TimerExpiresBefore( TimerHeap[child + 1], TimerHeap[child] ) )
+        {
+            child++;
+        }
+        if( TimerExpiresBefore( TimerHeap[child], obj ) == false )
+        {
+            break;
+        }
+        TimerHeap[index] = TimerHeap[child];
+        TimerHeap[index]->HeapIndex = index;
+        index = child;
     }
-
-    obj->Next = cur;
-    obj->IsRunning = true;
-    TimerListHead = obj;
-    TimerSetTimeout( TimerListHead );
+    TimerHeap[index] = obj;
+    obj->HeapIndex = index;
 }
 
-IRAM_ATTR void TimerIrqHandler( void )
+static IRAM_ATTR void TimerHeapRemove( uint32_t index )
 {
-    uint32_t elapsedTime = 0;
-
-    // when all timers are stopped or expired, TimerListHead is NULL
-    if( TimerListHead == NULL )
-    {
-        return;
-    }
+    TimerEvent_t *last = TimerHeap[--TimerHeapCount];
 
-    elapsedTime = TimerGetValue( );
+    TimerHeap[index]->IsRunning = false;
+    TimerHeap[TimerHeapCount] = NULL;
 
-    if( elapsedTime >= TimerListHead->Timestamp )
+    if( index < TimerHeapCount )
     {
-        TimerListHead->Timestamp = 0;
-    }
-    else
-    {
-        TimerListHead->Timestamp -= elapsedTime;
+        // fill the hole with the last timer and restore the ordering
+        TimerHeap[index] = last;
+        last->HeapIndex = index;
+        TimerHeapSiftDown( index );
+        TimerHeapSiftUp( last->HeapIndex );
     }
+}
 
-    TimerListHead->IsRunning = false;
+IRAM_ATTR void TimerIrqHandler( void )
+{
+    uint32_t ilevel = MICROPY_BEGIN_ATOMIC_SECTION();
+    TimerTime_t now = TimerGetCurrentTime( );
 
-    while( ( TimerListHead != NULL ) && ( TimerListHead->Timestamp == 0 ) )
+    // when all timers are stopped or expired, the heap is empty
+    while( ( TimerHeapCount > 0 ) && ( ( int32_t )( TimerHeap[0]->Timestamp - now ) <= 0 ) )
     {
-        TimerEvent_t* elapsedTimer = TimerListHead;
-        TimerListHead = TimerListHead->Next;
+        TimerEvent_t* elapsedTimer = TimerHeap[0];
+        TimerHeapRemove( 0 );
 
         if( elapsedTimer->Callback != NULL )
         {
@@ -233,117 +206,49 @@ IRAM_ATTR void TimerIrqHandler( void )
         }
     }
 
-    // start the next TimerListHead if it exists
-    if( TimerListHead != NULL )
+    // start the next timer if it exists
+    if( TimerHeapCount > 0 )
     {
-        if( TimerListHead->IsRunning != true )
-        {
-            TimerListHead->IsRunning = true;
-            TimerSetTimeout( TimerListHead );
-        }
+        TimerSetTimeout( TimerHeap[0] );
     }
+    MICROPY_END_ATOMIC_SECTION(ilevel);
 }
 
 IRAM_ATTR void TimerStop( TimerEvent_t *obj )
 {
     uint32_t ilevel = MICROPY_BEGIN_ATOMIC_SECTION();
 
-    uint32_t elapsedTime = 0;
-    uint32_t remainingTime = 0;
-
-    TimerEvent_t* prev = TimerListHead;
-    TimerEvent_t* cur = TimerListHead;
-
-    // List is empty or the Obj to stop does not exist
-    if( ( TimerListHead == NULL ) || ( obj == NULL ) )
+    // the heap is empty or the Obj to stop is not scheduled
+    if( ( obj == NULL ) || ( TimerExists( obj ) == false ) )
     {
         MICROPY_END_ATOMIC_SECTION(ilevel);
         return;
     }
 
-    if( TimerListHead == obj ) // Stop the Head
+    if( obj->HeapIndex == 0 )
     {
-        if( TimerListHead->IsRunning == true ) // The head is already running
+        // Stop the next timer to expire, arm the one that follows
+        TimerHeapRemove( 0 );
+        if( TimerHeapCount > 0 )
         {
-            elapsedTime = TimerGetValue( );
-            if( elapsedTime > obj->Timestamp )
-            {
-                elapsedTime = obj->Timestamp;
-            }
-
-            remainingTime = obj->Timestamp - elapsedTime;
-
-            if( TimerListHead->Next != NULL )
-            {
-                TimerListHead->IsRunning = false;
-                TimerListHead = TimerListHead->Next;
-                TimerListHead->Timestamp += remainingTime;
-                TimerListHead->IsRunning = true;
-                TimerSetTimeout( TimerListHead );
-            }
-            else
-            {
-                TimerListHead = NULL;
-            }
-        }
-        else // Stop the head before it is started
-        {
-            if( TimerListHead->Next != NULL )
-            {
-                remainingTime = obj->Timestamp;
-                TimerListHead = TimerListHead->Next;
-                TimerListHead->Timestamp += remainingTime;
-            }
-            else
-            {
-                TimerListHead = NULL;
-            }
+            TimerSetTimeout( TimerHeap[0] );
         }
     }
-    else // Stop an object within the list
+    else
     {
-        remainingTime = obj->Timestamp;
-
-        while( cur != NULL )
-        {
-            if( cur == obj )
-            {
-                if( cur->Next != NULL )
-                {
-                    cur = cur->Next;
-                    prev->Next = cur;
-                    cur->Timestamp += remainingTime;
-                }
-                else
-                {
-                    cur = NULL;
-                    prev->Next = cur;
-                }
-                break;
-            }
-            else
-            {
-                prev = cur;
-                cur = cur->Next;
-            }
-        }
+        TimerHeapRemove( obj->HeapIndex );
     }
     MICROPY_END_ATOMIC_SECTION(ilevel);
 }
 
 static IRAM_ATTR bool TimerExists( TimerEvent_t *obj )
 {
-    TimerEvent_t* cur = TimerListHead;
+    return ( obj->IsRunning == true ) && ( obj->HeapIndex < TimerHeapCount ) && ( TimerHeap[obj->HeapIndex] == obj );
+}
 
-    while( cur != NULL )
-    {
-        if( cur == obj )
-        {
-            return true;
-        }
-        cur = cur->Next;
-    }
-    return false;
+IRAM_ATTR uint32_t TimerGetPendingCount( void )
+{
+    return TimerHeapCount;
 }
 
 void TimerReset( TimerEvent_t *obj )
@@ -371,8 +276,10 @@ IRAM_ATTR TimerTime_t TimerGetCurrentTime( void )
 
 static IRAM_ATTR void TimerSetTimeout( TimerEvent_t *obj )
 {
+    int32_t remainingTime = ( int32_t )( obj->Timestamp - TimerGetCurrentTime( ) );
+
     HasLoopedThroughMain = 0;
-    TimerHwStart( obj->Timestamp );
+    TimerHwStart( ( remainingTime > 0 ) ? ( uint32_t )remainingTime : 0 );
 }
 
 IRAM_ATTR TimerTime_t TimerGetElapsedTime( TimerTime_t savedTime )
@@ -382,7 +289,7 @@ IRAM_ATTR TimerTime_t TimerGetElapsedTime( TimerTime_t savedTime )
 
 void TimerLowPowerHandler( void )
 {
-    if( ( TimerListHead != NULL ) && ( TimerListHead->IsRunning == true ) )
+    if( TimerHeapCount > 0 )
     {
         if( HasLoopedThroughMain < 5 )
         {
@@ -20,13 +20,20 @@ Maintainer: Miguel Luis and Gregory Cristian
  */
 typedef struct TimerEvent_s
 {
-    uint32_t Timestamp;         //! Current timer value
+    uint32_t Timestamp;         //! Absolute expiry time while the timer is running
     uint32_t ReloadValue;       //! Timer delay value
-    bool IsRunning;             //! Is the timer currently running
+    bool IsRunning;             //! Is the timer currently scheduled
     void ( *Callback )( void ); //! Timer IRQ callback function
-    struct TimerEvent_s *Next;  //! Pointer to the next Timer object.
+    uint8_t HeapIndex;          //! Position of the timer in the scheduler heap
 }TimerEvent_t;
 
+/*!
+ * \brief Maximum number of timers that can be scheduled at the same time
+ */
+#ifndef TIMER_HEAP_SIZE_MAX
+#define TIMER_HEAP_SIZE_MAX     32
+#endif
+
 /*!
  * \brief Timer time variable definition
  */
@@ -94,6 +101,13 @@ TimerTime_t TimerGetCurrentTime( void );
  */
 TimerTime_t TimerGetElapsedTime( TimerTime_t savedTime );
 
+/*!
+ * \brief Return the number of timers currently scheduled
+ *
+ * \retval count number of pending timers
+ */
+uint32_t TimerGetPendingCount( void );
+
 /*!
  * \brief Manages the entry into ARM cortex deep-sleep mode
  */
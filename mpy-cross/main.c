@@ -31,6 +31,7 @@
 
 #include "py/compile.h"
 #include "py/persistentcode.h"
+#include "py/smallint.h"
 #include "py/runtime.h"
 #include "py/gc.h"
 #include "py/stackctrl.h"
@@ -43,6 +44,9 @@
 STATIC uint emit_opt = MP_EMIT_OPT_NONE;
 mp_uint_t mp_verbose_flag = 0;
 
+// Constants given with -D, folded into every module compiled
+STATIC mp_map_t predef_consts;
+
 // Heap size of GC heap (if enabled)
 // Make it larger on a 64 bit machine, because pointers are larger.
 long heap_size = 1024*1024 * (sizeof(mp_uint_t) / 4);
@@ -104,12 +108,13 @@ STATIC int usage(char **argv) {
 "-s : source filename to embed in the compiled bytecode (defaults to input file)\n"
 "-v : verbose (trace various operations); can be multiple\n"
 "-O[N] : apply bytecode optimizations of level N\n"
+"-D<name>=<int> : treat name as if assigned with const(), so \"if name:\" blocks are dropped when 0\n"
 "\n"
 "Target specific options:\n"
 "-msmall-int-bits=number : set the maximum bits used to encode a small-int\n"
 "-mno-unicode : don't support unicode in compiled strings\n"
 "-mcache-lookup-bc : cache map lookups in the bytecode\n"
-"-march=<arch> : set architecture for native emitter; x86, x64, armv6, armv7m, xtensa\n"
+"-march=<arch> : set architecture for native emitter; x86, x64, armv6, armv7m, xtensa, xtensawin\n"
 "\n"
 "Implementation specific options:\n", argv[0]
 );
@@ -194,6 +199,8 @@ MP_NOINLINE int main_(int argc, char **argv) {
     mp_dynamic_compiler.small_int_bits = 31;
     mp_dynamic_compiler.opt_cache_map_lookup_in_bytecode = 0;
     mp_dynamic_compiler.py_builtins_str_unicode = 1;
+    mp_map_init(&predef_consts, 0);
+    mp_dynamic_compiler.predef_consts = &predef_consts;
     #if defined(__i386__)
     mp_dynamic_compiler.native_arch = MP_NATIVE_ARCH_X86;
     #elif defined(__x86_64__)
@@ -238,6 +245,27 @@ MP_NOINLINE int main_(int argc, char **argv) {
                 }
                 a += 1;
                 source_file = argv[a];
+            } else if (strncmp(argv[a], "-D", 2) == 0) {
+                const char *def = argv[a] + 2;
+                if (*def == '\0') {
+                    if (a + 1 >= argc) {
+                        exit(usage(argv));
+                    }
+                    def = argv[++a];
+                }
+                const char *eq = strchr(def, '=');
+                if (eq == NULL || eq == def) {
+                    return usage(argv);
+                }
+                char *end;
+                long long value = strtoll(eq + 1, &end, 0);
+                if (eq[1] == '\0' || *end) {
+                    mp_printf(&mp_stderr_print, "constant %s must be an integer\n", def);
+                    exit(1);
+                }
+                mp_map_lookup(&predef_consts, MP_OBJ_NEW_QSTR(qstr_from_strn(def, eq - def)),
+                    MP_MAP_LOOKUP_ADD_IF_NOT_FOUND)->value = MP_SMALL_INT_FITS(value)
+                    ? MP_OBJ_NEW_SMALL_INT(value) : mp_obj_new_int_from_ll(value);
             } else if (strncmp(argv[a], "-msmall-int-bits=", sizeof("-msmall-int-bits=") - 1) == 0) {
                 char *end;
                 mp_dynamic_compiler.small_int_bits =
@@ -266,6 +294,8 @@ MP_NOINLINE int main_(int argc, char **argv) {
                     mp_dynamic_compiler.native_arch = MP_NATIVE_ARCH_ARMV7M;
                 } else if (strcmp(arch, "xtensa") == 0) {
                     mp_dynamic_compiler.native_arch = MP_NATIVE_ARCH_XTENSA;
+                } else if (strcmp(arch, "xtensawin") == 0) {
+                    mp_dynamic_compiler.native_arch = MP_NATIVE_ARCH_XTENSAWIN;
                 } else {
                     return usage(argv);
                 }
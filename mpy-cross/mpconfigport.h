@@ -38,6 +38,7 @@
 #define MICROPY_EMIT_INLINE_THUMB_FLOAT (1)
 #define MICROPY_EMIT_ARM            (1)
 #define MICROPY_EMIT_XTENSA         (1)
+#define MICROPY_EMIT_XTENSAWIN      (1)
 #define MICROPY_EMIT_INLINE_XTENSA  (1)
 
 #define MICROPY_DYNAMIC_COMPILER    (1)
@@ -49,6 +50,7 @@
 #define MICROPY_COMP_RETURN_IF_EXPR (1)
 
 #define MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE (0)
+#define MICROPY_OPT_BYTECODE_PEEPHOLE (1)
 
 #define MICROPY_READER_POSIX        (1)
 #define MICROPY_ENABLE_RUNTIME      (0)
@@ -437,7 +437,13 @@ MP_NOINLINE int main_(int argc, char **argv) {
 
 #if MICROPY_ENABLE_GC
     char *heap = malloc(heap_size);
+    #if MICROPY_GC_SPLIT_HEAP
+    // exercise the split heap with a small first area, the rest added after
+    gc_init(heap, heap + heap_size / 8);
+    gc_add(heap + heap_size / 8, heap + heap_size);
+    #else
     gc_init(heap, heap + heap_size);
+    #endif
 #endif
 
     #if MICROPY_ENABLE_PYSTACK
@@ -47,6 +47,10 @@
 #define MICROPY_COMP_TRIPLE_TUPLE_ASSIGN (1)
 #define MICROPY_COMP_RETURN_IF_EXPR (1)
 #define MICROPY_ENABLE_GC           (1)
+#define MICROPY_GC_LAZY_SWEEP       (1)
+#define MICROPY_GC_SPLIT_HEAP       (1)
+#define MICROPY_GC_FREE_LISTS       (1)
+#define MICROPY_GC_REALLOC_STATS    (1)
 #define MICROPY_ENABLE_FINALISER    (1)
 #define MICROPY_STACK_CHECK         (1)
 #define MICROPY_MALLOC_USES_ALLOCATED_SIZE (1)
@@ -70,6 +74,31 @@
 #ifndef MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE
 #define MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE (1)
 #endif
+#ifndef MICROPY_OPT_MAP_LOOKUP_CACHE
+#define MICROPY_OPT_MAP_LOOKUP_CACHE (1)
+#endif
+#ifndef MICROPY_OPT_MAP_COMPACT
+#define MICROPY_OPT_MAP_COMPACT (1)
+#endif
+#ifndef MICROPY_OPT_TYPE_ATTR_CACHE
+#define MICROPY_OPT_TYPE_ATTR_CACHE (1)
+#endif
+#ifndef MICROPY_OPT_CODE_STATE_POOL
+#define MICROPY_OPT_CODE_STATE_POOL (1)
+#endif
+#ifndef MICROPY_OPT_GENERATOR_SHRINK
+#define MICROPY_OPT_GENERATOR_SHRINK (1)
+#endif
+#ifndef MICROPY_OPT_CLOSURE_BY_VALUE
+#define MICROPY_OPT_CLOSURE_BY_VALUE (1)
+#endif
+#define MICROPY_OPT_VM_BINARY_OP_FAST_PATH (1)
+#define MICROPY_OPT_MPZ_KARATSUBA (1)
+#define MICROPY_OPT_MPZ_POW3_MONTGOMERY (1)
+#define MICROPY_OPT_BYTECODE_PEEPHOLE (1)
+#ifndef MICROPY_QSTR_HASH_INDEX
+#define MICROPY_QSTR_HASH_INDEX     (1)
+#endif
 #define MICROPY_CAN_OVERRIDE_BUILTINS (1)
 #define MICROPY_PY_FUNCTION_ATTRS   (1)
 #define MICROPY_PY_DESCRIPTORS      (1)
@@ -84,6 +113,8 @@
 #define MICROPY_PY_BUILTINS_INPUT   (1)
 #define MICROPY_PY_BUILTINS_POW3    (1)
 #define MICROPY_PY_MICROPYTHON_MEM_INFO (1)
+#define MICROPY_PY_MICROPYTHON_ALLOC_STATS (1)
+#define MICROPY_PY_MICROPYTHON_PROFILE (1)
 #define MICROPY_PY_ALL_SPECIAL_METHODS (1)
 #define MICROPY_PY_REVERSE_SPECIAL_METHODS (1)
 #define MICROPY_PY_ARRAY_SLICE_ASSIGN (1)
@@ -104,7 +135,11 @@
 #endif
 #define MICROPY_PY_CMATH            (1)
 #define MICROPY_PY_IO_FILEIO        (1)
+#define MICROPY_PY_IO_BUFFEREDWRITER (1)
+#define MICROPY_PY_IO_BUFFEREDREADER (1)
+#define MICROPY_PY_IO_BYTESBUILDER  (1)
 #define MICROPY_PY_GC_COLLECT_RETVAL (1)
+#define MICROPY_PY_GC_DEFRAG        (1)
 #define MICROPY_MODULE_FROZEN_STR   (1)
 
 #ifndef MICROPY_STACKLESS
@@ -112,14 +147,18 @@
 #define MICROPY_STACKLESS_STRICT    (0)
 #endif
 
+#define MICROPY_PY_STRUCT_CLASS     (1)
 #define MICROPY_PY_OS_STATVFS       (1)
 #define MICROPY_PY_UTIME            (1)
 #define MICROPY_PY_UTIME_MP_HAL     (1)
 #define MICROPY_PY_UERRNO           (1)
 #define MICROPY_PY_UCTYPES          (1)
 #define MICROPY_PY_UZLIB            (1)
+#define MICROPY_PY_UZLIB_COMPRESS   (1)
 #define MICROPY_PY_UJSON            (1)
 #define MICROPY_PY_URE              (1)
+#define MICROPY_PY_URE_CACHE_SIZE   (4)
+#define MICROPY_PY_URE_SPANS        (1)
 #define MICROPY_PY_UHEAPQ           (1)
 #define MICROPY_PY_UTIMEQ           (1)
 #define MICROPY_PY_UHASHLIB         (1)
@@ -129,6 +168,7 @@
 #define MICROPY_PY_UBINASCII        (1)
 #define MICROPY_PY_UBINASCII_CRC32  (1)
 #define MICROPY_PY_URANDOM          (1)
+#define MICROPY_PY_UVECTOR          (1)
 #ifndef MICROPY_PY_USELECT_POSIX
 #define MICROPY_PY_USELECT_POSIX    (1)
 #endif
@@ -166,6 +206,7 @@ extern const struct _mp_print_t mp_stderr_print;
 #define MICROPY_ENABLE_EMERGENCY_EXCEPTION_BUF   (1)
 #define MICROPY_EMERGENCY_EXCEPTION_BUF_SIZE  (256)
 #define MICROPY_KBD_EXCEPTION       (1)
+#define MICROPY_ENABLE_PREALLOC_EXCEPTIONS (1)
 #define MICROPY_ASYNC_KBD_INTR      (1)
 
 extern const struct _mp_obj_module_t mp_module_machine;
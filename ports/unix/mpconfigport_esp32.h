@@ -0,0 +1,108 @@
+/*
+ * This file is part of the MicroPython project, http://micropython.org/
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2013, 2014 Damien P. George
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// This config file mirrors the VM, GC and object model configuration of
+// esp32/mpconfigport.h, so that tests/bench can be run on the host against the
+// same code paths as the firmware. Only the options that change how the core
+// executes are mirrored; the unix I/O layer stays as it is. Keep this file in
+// step with esp32/mpconfigport.h.
+
+#include <mpconfigport.h>
+
+// object model and number types
+#undef MICROPY_FLOAT_IMPL
+#define MICROPY_FLOAT_IMPL                          (MICROPY_FLOAT_IMPL_FLOAT)
+#undef MICROPY_ERROR_REPORTING
+#define MICROPY_ERROR_REPORTING                     (MICROPY_ERROR_REPORTING_NORMAL)
+#define MICROPY_PY_BUILTINS_COMPLEX                 (1)
+#define MICROPY_PY_BUILTINS_EXECFILE                (1)
+#define MICROPY_PY_BUILTINS_TIMEOUTERROR            (1)
+#define MICROPY_MODULE_WEAK_LINKS                   (1)
+
+// the esp32 weak links that have a unix counterpart, so that scripts written
+// for the board (import time, import struct, ...) run unchanged
+#define MICROPY_PORT_BUILTIN_MODULE_WEAK_LINKS \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_os), (mp_obj_t)&mp_module_os }, \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_time), (mp_obj_t)&mp_module_time }, \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_select), (mp_obj_t)&mp_module_uselect }, \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_binascii), (mp_obj_t)&mp_module_ubinascii }, \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_struct), (mp_obj_t)&mp_module_ustruct }, \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_re), (mp_obj_t)&mp_module_ure }, \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_json), (mp_obj_t)&mp_module_ujson }, \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_hashlib), (mp_obj_t)&mp_module_uhashlib }, \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_errno), (mp_obj_t)&mp_module_uerrno }, \
+    { MP_OBJ_NEW_QSTR(MP_QSTR_heapq), (mp_obj_t)&mp_module_uheapq },
+
+// the esp32 port doesn't cache map lookups in the bytecode
+#undef MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE
+#define MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE    (0)
+#undef MICROPY_COMP_RETURN_IF_EXPR
+#define MICROPY_COMP_RETURN_IF_EXPR                 (0)
+#define MICROPY_PERSISTENT_CODE_SAVE                (1)
+
+// memory management
+#undef MICROPY_MEM_STATS
+#define MICROPY_MEM_STATS                           (0)
+#undef MICROPY_MALLOC_USES_ALLOCATED_SIZE
+#define MICROPY_MALLOC_USES_ALLOCATED_SIZE          (0)
+#undef MICROPY_EMERGENCY_EXCEPTION_BUF_SIZE
+#define MICROPY_EMERGENCY_EXCEPTION_BUF_SIZE        (0)
+#undef MICROPY_PY_URE_CACHE_SIZE
+#define MICROPY_PY_URE_CACHE_SIZE                   (8)
+
+// the threads share a GIL, handed over every 8 jumps when another thread waits
+#if MICROPY_PY_THREAD
+#undef MICROPY_PY_THREAD_GIL
+#define MICROPY_PY_THREAD_GIL                       (1)
+#define MICROPY_PY_THREAD_GIL_VM_DIVISOR            (8)
+#define MICROPY_PY_THREAD_GIL_ADAPTIVE              (1)
+#endif
+
+// the builtins the unix port adds on top of what the esp32 port has
+#undef MICROPY_PY_FUNCTION_ATTRS
+#define MICROPY_PY_FUNCTION_ATTRS                   (0)
+#undef MICROPY_PY_DESCRIPTORS
+#define MICROPY_PY_DESCRIPTORS                      (0)
+#undef MICROPY_PY_BUILTINS_STR_CENTER
+#define MICROPY_PY_BUILTINS_STR_CENTER              (0)
+#undef MICROPY_PY_BUILTINS_STR_PARTITION
+#define MICROPY_PY_BUILTINS_STR_PARTITION           (0)
+#undef MICROPY_PY_BUILTINS_STR_SPLITLINES
+#define MICROPY_PY_BUILTINS_STR_SPLITLINES          (0)
+#undef MICROPY_PY_BUILTINS_POW3
+#define MICROPY_PY_BUILTINS_POW3                    (0)
+#undef MICROPY_PY_REVERSE_SPECIAL_METHODS
+#define MICROPY_PY_REVERSE_SPECIAL_METHODS          (0)
+#undef MICROPY_PY_BUILTINS_SLICE_ATTRS
+#define MICROPY_PY_BUILTINS_SLICE_ATTRS             (0)
+#undef MICROPY_PY_COLLECTIONS_ORDEREDDICT
+#define MICROPY_PY_COLLECTIONS_ORDEREDDICT          (0)
+#undef MICROPY_PY_MATH_SPECIAL_FUNCTIONS
+#define MICROPY_PY_MATH_SPECIAL_FUNCTIONS           (0)
+#undef MICROPY_WARNINGS
+#define MICROPY_WARNINGS                            (0)
+#undef MICROPY_PY_STR_BYTES_CMP_WARN
+#define MICROPY_PY_STR_BYTES_CMP_WARN               (0)
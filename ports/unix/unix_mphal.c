@@ -81,6 +81,28 @@ void mp_hal_set_interrupt_char(char c) {
     }
 }
 
+#if MICROPY_PY_MICROPYTHON_PROFILE && !defined(_WIN32)
+STATIC void profile_sighandler(int signum) {
+    (void)signum;
+    mp_micropython_profile_sample();
+}
+
+void mp_hal_profile_timer(mp_uint_t period_us) {
+    struct sigaction sa;
+    // restart interrupted syscalls so the script doesn't see EINTR
+    sa.sa_flags = SA_RESTART;
+    sa.sa_handler = period_us ? profile_sighandler : SIG_IGN;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGPROF, &sa, NULL);
+
+    struct itimerval it;
+    it.it_interval.tv_sec = period_us / 1000000;
+    it.it_interval.tv_usec = period_us % 1000000;
+    it.it_value = it.it_interval;
+    setitimer(ITIMER_PROF, &it, NULL);
+}
+#endif
+
 #if MICROPY_USE_READLINE == 1
 
 #include <termios.h>
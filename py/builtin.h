@@ -121,6 +121,7 @@ extern const mp_obj_module_t mp_module_lwip;
 extern const mp_obj_module_t mp_module_uwebsocket;
 extern const mp_obj_module_t mp_module_webrepl;
 extern const mp_obj_module_t mp_module_framebuf;
+extern const mp_obj_module_t mp_module_uvector;
 extern const mp_obj_module_t mp_module_btree;
 
 extern const char MICROPY_PY_BUILTINS_HELP_TEXT[];
@@ -29,6 +29,7 @@
 
 #include "py/builtin.h"
 #include "py/objmodule.h"
+#include "py/persistentcode.h"
 
 #if MICROPY_PY_BUILTINS_HELP
 
@@ -94,6 +95,13 @@ STATIC void mp_help_print_modules(void) {
     mp_help_add_from_names(list, mp_frozen_mpy_names);
     #endif
 
+    #if MICROPY_MODULE_FROZEN_XIP
+    const char *xip_names = mp_raw_code_xip_names();
+    if (xip_names != NULL) {
+        mp_help_add_from_names(list, xip_names);
+    }
+    #endif
+
     // sort the list so it's printed in alphabetical order
     mp_obj_list_sort(1, &list, (mp_map_t*)&mp_const_empty_map);
 
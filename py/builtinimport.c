@@ -35,6 +35,17 @@
 #include "py/runtime.h"
 #include "py/builtin.h"
 #include "py/frozenmod.h"
+#include "py/gc.h"
+
+#if MICROPY_MODULE_COMPILE_CACHE
+#include "py/objtuple.h"
+#include "py/stream.h"
+#include "py/reader.h"
+#include "extmod/vfs.h"
+#if !MICROPY_VFS || !MICROPY_PERSISTENT_CODE_LOAD || !MICROPY_PERSISTENT_CODE_SAVE
+#error MICROPY_MODULE_COMPILE_CACHE requires MICROPY_VFS, MICROPY_PERSISTENT_CODE_LOAD and MICROPY_PERSISTENT_CODE_SAVE
+#endif
+#endif
 
 #if MICROPY_DEBUG_VERBOSE // print debugging info
 #define DEBUG_PRINT (1)
@@ -58,9 +69,12 @@ bool mp_obj_is_package(mp_obj_t module) {
 // (whatever is available, if at all).
 STATIC mp_import_stat_t mp_import_stat_any(const char *path) {
     #if MICROPY_MODULE_FROZEN
-    mp_import_stat_t st = mp_frozen_stat(path);
-    if (st != MP_IMPORT_STAT_NO_EXIST) {
-        return st;
+    // frozen names are relative, an absolute path can only be on the filesystem
+    if (path[0] != '/') {
+        mp_import_stat_t st = mp_frozen_stat(path);
+        if (st != MP_IMPORT_STAT_NO_EXIST) {
+            return st;
+        }
     }
     #endif
     return mp_import_stat(path);
@@ -131,7 +145,7 @@ STATIC mp_import_stat_t find_file(const char *file_str, uint file_len, vstr_t *d
 #endif
 }
 
-#if MICROPY_MODULE_FROZEN_STR || MICROPY_ENABLE_COMPILER
+#if MICROPY_MODULE_FROZEN_STR || (MICROPY_ENABLE_COMPILER && !MICROPY_PARSE_STREAMING)
 STATIC void do_load_from_lexer(mp_obj_t module_obj, mp_lexer_t *lex) {
     #if MICROPY_PY___FILE__
     qstr source_name = lex->source_name;
@@ -144,7 +158,7 @@ STATIC void do_load_from_lexer(mp_obj_t module_obj, mp_lexer_t *lex) {
 }
 #endif
 
-#if MICROPY_PERSISTENT_CODE_LOAD || MICROPY_MODULE_FROZEN_MPY
+#if MICROPY_PERSISTENT_CODE_LOAD || MICROPY_MODULE_FROZEN_MPY || MICROPY_PARSE_STREAMING
 STATIC void do_execute_raw_code(mp_obj_t module_obj, mp_raw_code_t *raw_code) {
     #if MICROPY_PY___FILE__
     // TODO
@@ -181,6 +195,209 @@ STATIC void do_execute_raw_code(mp_obj_t module_obj, mp_raw_code_t *raw_code) {
 }
 #endif
 
+#if MICROPY_PARSE_STREAMING
+// Compiles a whole module, returns NULL when the heap can't hold its parse tree
+STATIC mp_raw_code_t *compile_whole_maybe(const char *file_str) {
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        mp_lexer_t *lex = mp_lexer_new_from_file(file_str);
+        qstr source_name = lex->source_name;
+        mp_parse_tree_t parse_tree = mp_parse(lex, MP_PARSE_FILE_INPUT);
+        mp_raw_code_t *rc = mp_compile_to_raw_code(&parse_tree, source_name, MP_EMIT_OPT_NONE, false);
+        nlr_pop();
+        return rc;
+    } else if (mp_obj_is_subclass_fast(MP_OBJ_FROM_PTR(((mp_obj_base_t*)nlr.ret_val)->type), MP_OBJ_FROM_PTR(&mp_type_MemoryError))) {
+        return NULL;
+    }
+    nlr_jump(nlr.ret_val);
+}
+
+// Each top-level statement is parsed, compiled and executed before the next one
+// is read.  The statements before a syntax error have run by the time it's raised.
+STATIC void do_load_streaming(mp_obj_t module_obj, const char *file_str) {
+    #if MICROPY_ENABLE_GC
+    // let go of what the failed attempt left behind
+    gc_collect();
+    #endif
+    mp_lexer_t *lex = mp_lexer_new_from_file(file_str);
+    qstr source_name = lex->source_name;
+    #if MICROPY_PY___FILE__
+    mp_store_attr(module_obj, MP_QSTR___file__, MP_OBJ_NEW_QSTR(source_name));
+    #endif
+
+    mp_parse_stream_t ps;
+    mp_parse_stream_init(&ps, lex);
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        mp_parse_tree_t parse_tree;
+        while (mp_parse_stream_next(&ps, &parse_tree)) {
+            do_execute_raw_code(module_obj, mp_compile_to_raw_code(&parse_tree, source_name, MP_EMIT_OPT_NONE, false));
+        }
+        nlr_pop();
+    } else {
+        mp_parse_stream_deinit(&ps);
+        nlr_jump(nlr.ret_val);
+    }
+}
+#endif
+
+#if MICROPY_MODULE_COMPILE_CACHE
+// A cache file starts with the size and mtime of its source, little endian,
+// followed by the .mpy data.  The cache of dir/name.py is dir/__pycache__/name.mpy.
+#define CACHE_DIR "__pycache__"
+#define CACHE_KEY_LEN (8)
+
+STATIC bool cache_get_key(const char *file_str, byte *key) {
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        mp_obj_tuple_t *st = MP_OBJ_TO_PTR(mp_vfs_stat(mp_obj_new_str(file_str, strlen(file_str))));
+        uint32_t vals[2] = { mp_obj_get_int_truncated(st->items[6]), mp_obj_get_int_truncated(st->items[8]) };
+        nlr_pop();
+        for (int i = 0; i < CACHE_KEY_LEN; i++) {
+            key[i] = vals[i / 4] >> (8 * (i % 4));
+        }
+        return true;
+    }
+    return false;
+}
+
+STATIC void cache_get_path(const char *file_str, size_t file_len, vstr_t *path) {
+    const char *name = strrchr(file_str, PATH_SEP_CHAR);
+    name = (name == NULL) ? file_str : name + 1;
+    vstr_init(path, file_len + sizeof(CACHE_DIR) + 2);
+    vstr_add_strn(path, file_str, name - file_str);
+    vstr_add_str(path, CACHE_DIR);
+    vstr_add_char(path, PATH_SEP_CHAR);
+    // name.py becomes name.mpy
+    vstr_add_strn(path, name, file_str + file_len - name - 2);
+    vstr_add_str(path, "mpy");
+}
+
+// returns NULL when there's no cache of the module or it's stale or unreadable
+STATIC mp_raw_code_t *cache_load(const char *cache_str, const byte *key) {
+    mp_reader_t reader;
+    bool opened = false;
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        mp_reader_new_file(&reader, cache_str);
+        opened = true;
+        for (int i = 0; i < CACHE_KEY_LEN; i++) {
+            if (reader.readbyte(reader.data) != key[i]) {
+                nlr_pop();
+                reader.close(reader.data);
+                return NULL;
+            }
+        }
+        // closes the reader once it's done
+        mp_raw_code_t *rc = mp_raw_code_load(&reader);
+        opened = false;
+        nlr_pop();
+        return rc;
+    } else {
+        if (opened) {
+            reader.close(reader.data);
+        }
+        return NULL;
+    }
+}
+
+STATIC void cache_print_strn(void *env, const char *str, size_t len) {
+    int errcode;
+    if (mp_stream_rw(MP_OBJ_FROM_PTR(env), (void*)str, len, &errcode, MP_STREAM_RW_WRITE) != len) {
+        mp_raise_OSError(errcode);
+    }
+}
+
+// Written to a temporary file first, a cache file is never half there.  Any
+// error just leaves the module uncached.
+STATIC void cache_save(const char *file_str, vstr_t *cache_path, const byte *key, mp_raw_code_t *rc) {
+    vstr_t tmp_path;
+    vstr_init(&tmp_path, cache_path->len + 4);
+    vstr_add_strn(&tmp_path, cache_path->buf, cache_path->len);
+    vstr_add_str(&tmp_path, ".tmp");
+    mp_obj_t tmp_obj = mp_obj_new_str(tmp_path.buf, tmp_path.len);
+    vstr_clear(&tmp_path);
+    mp_obj_t stream = MP_OBJ_NULL;
+
+    nlr_buf_t nlr;
+    if (nlr_push(&nlr) == 0) {
+        char *sep = strrchr(cache_path->buf, PATH_SEP_CHAR);
+        mp_obj_t dir_obj = mp_obj_new_str(cache_path->buf, sep - cache_path->buf);
+        nlr_buf_t nlr_dir;
+        if (nlr_push(&nlr_dir) == 0) {
+            mp_vfs_mkdir(dir_obj);
+            nlr_pop();
+        }
+        mp_obj_t args[2] = { tmp_obj, MP_OBJ_NEW_QSTR(MP_QSTR_wb) };
+        stream = mp_vfs_open(2, args, (mp_map_t*)&mp_const_empty_map);
+        mp_print_t print = {MP_OBJ_TO_PTR(stream), cache_print_strn};
+        cache_print_strn(print.data, (const char*)key, CACHE_KEY_LEN);
+        mp_raw_code_save(rc, &print);
+        mp_stream_close(stream);
+        stream = MP_OBJ_NULL;
+        nlr_buf_t nlr_rm;
+        if (nlr_push(&nlr_rm) == 0) {
+            mp_vfs_remove(mp_obj_new_str(cache_path->buf, cache_path->len));
+            nlr_pop();
+        }
+        mp_vfs_rename(tmp_obj, mp_obj_new_str(cache_path->buf, cache_path->len));
+        nlr_pop();
+    } else {
+        DEBUG_printf("can't cache %s\n", file_str);
+        nlr_buf_t nlr_rm;
+        if (nlr_push(&nlr_rm) == 0) {
+            if (stream != MP_OBJ_NULL) {
+                mp_stream_close(stream);
+            }
+            mp_vfs_remove(tmp_obj);
+            nlr_pop();
+        }
+    }
+}
+
+// Loads a .py module through the cache, returns false when it can't be used
+// (the file isn't on a filesystem of the VFS)
+STATIC bool do_load_cached(mp_obj_t module_obj, vstr_t *file) {
+    const char *file_str = vstr_null_terminated_str(file);
+    byte key[CACHE_KEY_LEN];
+    if (file->len < 3 || !cache_get_key(file_str, key)) {
+        return false;
+    }
+    vstr_t cache_path;
+    cache_get_path(file_str, file->len, &cache_path);
+    const char *cache_str = vstr_null_terminated_str(&cache_path);
+
+    mp_raw_code_t *rc = cache_load(cache_str, key);
+    if (rc == NULL) {
+        #if MICROPY_PARSE_STREAMING
+        rc = compile_whole_maybe(file_str);
+        if (rc == NULL) {
+            // a module compiled by statement has no single raw code to cache
+            vstr_clear(&cache_path);
+            do_load_streaming(module_obj, file_str);
+            return true;
+        }
+        #else
+        mp_lexer_t *lex = mp_lexer_new_from_file(file_str);
+        qstr source_name = lex->source_name;
+        mp_parse_tree_t parse_tree = mp_parse(lex, MP_PARSE_FILE_INPUT);
+        rc = mp_compile_to_raw_code(&parse_tree, source_name, MP_EMIT_OPT_NONE, false);
+        #endif
+        // native code isn't relocatable once emitted, such modules are compiled each time
+        if (!mp_raw_code_has_native(rc)) {
+            cache_save(file_str, &cache_path, key, rc);
+        }
+    }
+    vstr_clear(&cache_path);
+
+    #if MICROPY_PY___FILE__
+    mp_store_attr(module_obj, MP_QSTR___file__, MP_OBJ_NEW_QSTR(qstr_from_strn(file->buf, file->len)));
+    #endif
+    do_execute_raw_code(module_obj, rc);
+    return true;
+}
+#endif
+
 STATIC void do_load(mp_obj_t module_obj, vstr_t *file) {
     #if MICROPY_MODULE_FROZEN || MICROPY_ENABLE_COMPILER || (MICROPY_PERSISTENT_CODE_LOAD && MICROPY_HAS_FILE_READER)
     char *file_str = vstr_null_terminated_str(file);
@@ -204,7 +421,7 @@ STATIC void do_load(mp_obj_t module_obj, vstr_t *file) {
 
     // If we support frozen mpy modules and we found a corresponding file (and
     // its data) in the list of frozen files, execute it.
-    #if MICROPY_MODULE_FROZEN_MPY
+    #if MICROPY_MODULE_FROZEN_MPY || MICROPY_MODULE_FROZEN_XIP
     if (frozen_type == MP_FROZEN_MPY) {
         do_execute_raw_code(module_obj, modref);
         return;
@@ -223,11 +440,31 @@ STATIC void do_load(mp_obj_t module_obj, vstr_t *file) {
 
     // If we can compile scripts then load the file and compile and execute it.
     #if MICROPY_ENABLE_COMPILER
+    #if MICROPY_MODULE_COMPILE_CACHE
+    if (do_load_cached(module_obj, file)) {
+        return;
+    }
+    #endif
+    #if MICROPY_PARSE_STREAMING
+    {
+        mp_raw_code_t *rc = compile_whole_maybe(file_str);
+        if (rc == NULL) {
+            do_load_streaming(module_obj, file_str);
+        } else {
+            #if MICROPY_PY___FILE__
+            mp_store_attr(module_obj, MP_QSTR___file__, MP_OBJ_NEW_QSTR(qstr_from_strn(file->buf, file->len)));
+            #endif
+            do_execute_raw_code(module_obj, rc);
+        }
+        return;
+    }
+    #else
     {
         mp_lexer_t *lex = mp_lexer_new_from_file(file_str);
         do_load_from_lexer(module_obj, lex);
         return;
     }
+    #endif
     #else
     // If we get here then the file was not frozen and we can't compile scripts.
     mp_raise_msg(&mp_type_ImportError, "script compilation not supported");
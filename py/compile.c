@@ -95,6 +95,7 @@ STATIC const emit_method_table_t *emit_native_table[] = {
     &emit_native_thumb_method_table,
     &emit_native_thumb_method_table,
     &emit_native_xtensa_method_table,
+    &emit_native_xtensawin_method_table,
 };
 
 #elif MICROPY_EMIT_NATIVE
@@ -109,6 +110,8 @@ STATIC const emit_method_table_t *emit_native_table[] = {
 #define NATIVE_EMITTER(f) emit_native_arm_##f
 #elif MICROPY_EMIT_XTENSA
 #define NATIVE_EMITTER(f) emit_native_xtensa_##f
+#elif MICROPY_EMIT_XTENSAWIN
+#define NATIVE_EMITTER(f) emit_native_xtensawin_##f
 #else
 #error "unknown native emitter"
 #endif
@@ -131,6 +134,7 @@ STATIC const emit_inline_asm_method_table_t *emit_asm_table[] = {
     &emit_inline_thumb_method_table,
     &emit_inline_thumb_method_table,
     &emit_inline_xtensa_method_table,
+    &emit_inline_xtensa_method_table,
 };
 
 #elif MICROPY_EMIT_INLINE_ASM
@@ -593,6 +597,22 @@ STATIC void c_assign(compiler_t *comp, mp_parse_node_t pn, assign_kind_t assign_
     compile_syntax_error(comp, pn, "can't assign to expression");
 }
 
+// whether id2 of a child scope is the variable id of the current scope closed over
+STATIC bool scope_id_is_closed_over(const id_info_t *id, const id_info_t *id2) {
+    if (id->qst != id2->qst) {
+        return false;
+    }
+    if (id2->kind == ID_INFO_KIND_FREE) {
+        return id->kind == ID_INFO_KIND_CELL || id->kind == ID_INFO_KIND_FREE;
+    }
+    #if MICROPY_OPT_CLOSURE_BY_VALUE
+    if (id2->kind == ID_INFO_KIND_FREE_VALUE) {
+        return id->kind == ID_INFO_KIND_LOCAL || id->kind == ID_INFO_KIND_FREE_VALUE;
+    }
+    #endif
+    return false;
+}
+
 // stuff for lambda and comprehensions and generators:
 //  if n_pos_defaults > 0 then there is a tuple on the stack with the positional defaults
 //  if n_kw_defaults > 0 then there is a dictionary on the stack with the keyword defaults
@@ -618,14 +638,12 @@ STATIC void close_over_variables_etc(compiler_t *comp, scope_t *this_scope, int
     if (comp->scope_cur->kind != SCOPE_MODULE) {
         for (int i = 0; i < comp->scope_cur->id_info_len; i++) {
             id_info_t *id = &comp->scope_cur->id_info[i];
-            if (id->kind == ID_INFO_KIND_CELL || id->kind == ID_INFO_KIND_FREE) {
-                for (int j = 0; j < this_scope->id_info_len; j++) {
-                    id_info_t *id2 = &this_scope->id_info[j];
-                    if (id2->kind == ID_INFO_KIND_FREE && id->qst == id2->qst) {
-                        // in MicroPython we load closures using LOAD_FAST
-                        EMIT_LOAD_FAST(id->qst, id->local_num);
-                        nfree += 1;
-                    }
+            for (int j = 0; j < this_scope->id_info_len; j++) {
+                id_info_t *id2 = &this_scope->id_info[j];
+                if (scope_id_is_closed_over(id, id2)) {
+                    // in MicroPython we load closures using LOAD_FAST
+                    EMIT_LOAD_FAST(id->qst, id->local_num);
+                    nfree += 1;
                 }
             }
         }
@@ -3352,7 +3370,7 @@ STATIC void scope_compute_things(scope_t *scope) {
                     id_info_t temp = *id_param; *id_param = *id; *id = temp;
                 }
                 break;
-            } else if (id_param == NULL && id->flags == ID_FLAG_IS_PARAM) {
+            } else if (id_param == NULL && (id->flags & ~ID_FLAG_IS_STORED) == ID_FLAG_IS_PARAM) {
                 id_param = id;
             }
         }
@@ -3405,15 +3423,13 @@ STATIC void scope_compute_things(scope_t *scope) {
         int num_free = 0;
         for (int i = 0; i < scope->parent->id_info_len; i++) {
             id_info_t *id = &scope->parent->id_info[i];
-            if (id->kind == ID_INFO_KIND_CELL || id->kind == ID_INFO_KIND_FREE) {
-                for (int j = 0; j < scope->id_info_len; j++) {
-                    id_info_t *id2 = &scope->id_info[j];
-                    if (id2->kind == ID_INFO_KIND_FREE && id->qst == id2->qst) {
-                        assert(!(id2->flags & ID_FLAG_IS_PARAM)); // free vars should not be params
-                        // in MicroPython the frees come first, before the params
-                        id2->local_num = num_free;
-                        num_free += 1;
-                    }
+            for (int j = 0; j < scope->id_info_len; j++) {
+                id_info_t *id2 = &scope->id_info[j];
+                if (scope_id_is_closed_over(id, id2)) {
+                    assert(!(id2->flags & ID_FLAG_IS_PARAM)); // free vars should not be params
+                    // in MicroPython the frees come first, before the params
+                    id2->local_num = num_free;
+                    num_free += 1;
                 }
             }
         }
@@ -3421,7 +3437,7 @@ STATIC void scope_compute_things(scope_t *scope) {
         if (num_free > 0) {
             for (int i = 0; i < scope->id_info_len; i++) {
                 id_info_t *id = &scope->id_info[i];
-                if (id->kind != ID_INFO_KIND_FREE || (id->flags & ID_FLAG_IS_PARAM)) {
+                if ((id->kind != ID_INFO_KIND_FREE && id->kind != ID_INFO_KIND_FREE_VALUE) || (id->flags & ID_FLAG_IS_PARAM)) {
                     id->local_num += num_free;
                 }
             }
@@ -3431,7 +3447,72 @@ STATIC void scope_compute_things(scope_t *scope) {
     }
 }
 
-#if !MICROPY_PERSISTENT_CODE_SAVE
+#if MICROPY_OPT_CLOSURE_BY_VALUE
+// the variable of an enclosing scope that a free variable of *scope refers to,
+// *scope is updated to the scope that holds it
+STATIC id_info_t *scope_find_closed_over(scope_t **scope, qstr qst) {
+    for (scope_t *s = (*scope)->parent; s != NULL; s = s->parent) {
+        id_info_t *id = scope_find(s, qst);
+        if (id != NULL && id->kind != ID_INFO_KIND_FREE && id->kind != ID_INFO_KIND_FREE_VALUE) {
+            *scope = s;
+            return id;
+        }
+    }
+    return NULL;
+}
+
+STATIC bool scope_can_close_over_by_value(scope_t *scope, id_info_t *id) {
+    // viper params may hold native values, which can't be passed as objects
+    return id->kind == ID_INFO_KIND_CELL
+        && (id->flags & (ID_FLAG_IS_PARAM | ID_FLAG_IS_STORED)) == ID_FLAG_IS_PARAM
+        && scope->emit_options != MP_EMIT_OPT_VIPER;
+}
+
+// A closed over parameter that is never rebound, by its function or through a
+// nonlocal further in, always has the value it was called with.  The closures can
+// then be given that value rather than a cell, and read it from a fast local.
+STATIC void scope_close_over_by_value(scope_t *scope_head) {
+    // a rebinding further in rules out the variable it refers to
+    for (scope_t *s = scope_head; s != NULL; s = s->next) {
+        for (int i = 0; i < s->id_info_len; i++) {
+            id_info_t *id = &s->id_info[i];
+            if (id->kind == ID_INFO_KIND_FREE && (id->flags & ID_FLAG_IS_STORED)) {
+                scope_t *s2 = s;
+                id_info_t *id2 = scope_find_closed_over(&s2, id->qst);
+                if (id2 != NULL) {
+                    id2->flags |= ID_FLAG_IS_STORED;
+                }
+            }
+        }
+    }
+
+    // the references to what is left, in the closures and in the scopes between
+    for (scope_t *s = scope_head; s != NULL; s = s->next) {
+        for (int i = 0; i < s->id_info_len; i++) {
+            id_info_t *id = &s->id_info[i];
+            if (id->kind == ID_INFO_KIND_FREE) {
+                scope_t *s2 = s;
+                id_info_t *id2 = scope_find_closed_over(&s2, id->qst);
+                if (id2 != NULL && scope_can_close_over_by_value(s2, id2)) {
+                    id->kind = ID_INFO_KIND_FREE_VALUE;
+                }
+            }
+        }
+    }
+
+    // and the parameters themselves, last since the loop above looks at them
+    for (scope_t *s = scope_head; s != NULL; s = s->next) {
+        for (int i = 0; i < s->id_info_len; i++) {
+            id_info_t *id = &s->id_info[i];
+            if (scope_can_close_over_by_value(s, id)) {
+                id->kind = ID_INFO_KIND_LOCAL;
+            }
+        }
+    }
+}
+#endif
+
+#if !MICROPY_PERSISTENT_CODE_SAVE && !MICROPY_PARSE_STREAMING
 STATIC
 #endif
 mp_raw_code_t *mp_compile_to_raw_code(mp_parse_tree_t *parse_tree, qstr source_file, uint emit_opt, bool is_repl) {
@@ -3480,6 +3561,12 @@ mp_raw_code_t *mp_compile_to_raw_code(mp_parse_tree_t *parse_tree, qstr source_f
         }
     }
 
+    #if MICROPY_OPT_CLOSURE_BY_VALUE
+    if (comp->compile_error == MP_OBJ_NULL) {
+        scope_close_over_by_value(comp->scope_head);
+    }
+    #endif
+
     // compute some things related to scope and identifiers
     for (scope_t *s = comp->scope_head; s != NULL && comp->compile_error == MP_OBJ_NULL; s = s->next) {
         scope_compute_things(s);
@@ -3507,7 +3594,8 @@ mp_raw_code_t *mp_compile_to_raw_code(mp_parse_tree_t *parse_tree, qstr source_f
             // TODO this can be improved by calculating it during SCOPE pass
             // but that requires some other structural changes to the asm emitters
             #if MICROPY_DYNAMIC_COMPILER
-            if (mp_dynamic_compiler.native_arch == MP_NATIVE_ARCH_XTENSA)
+            if (mp_dynamic_compiler.native_arch == MP_NATIVE_ARCH_XTENSA
+                || mp_dynamic_compiler.native_arch == MP_NATIVE_ARCH_XTENSAWIN)
             #endif
             {
                 compile_scope_inline_asm(comp, s, MP_PASS_CODE_SIZE);
@@ -70,6 +70,15 @@ struct _emit_t {
     uint16_t ct_cur_raw_code;
     #endif
     mp_uint_t *const_table;
+
+    #if MICROPY_OPT_BYTECODE_PEEPHOLE
+    // The last instruction that can be fused with the one after it, if
+    // nothing else is written or labelled in between.
+    byte peep_kind;
+    size_t peep_start;
+    size_t peep_end;
+    mp_int_t peep_arg;
+    #endif
 };
 
 emit_t *emit_bc_new(void) {
@@ -306,8 +315,45 @@ STATIC void emit_write_bytecode_byte_signed_label(emit_t *emit, byte b1, mp_uint
     c[2] = bytecode_offset >> 8;
 }
 
+#if MICROPY_OPT_BYTECODE_PEEPHOLE
+
+enum {
+    PEEP_NONE,
+    PEEP_LOAD_FAST,
+    PEEP_SMALL_INT,
+    PEEP_COMPARE,
+};
+
+// Remember that the instruction written since bytecode offset start can be
+// fused with the next one.
+STATIC void emit_bc_peep_mark(emit_t *emit, byte kind, size_t start, mp_int_t arg) {
+    emit->peep_kind = kind;
+    emit->peep_start = start;
+    emit->peep_end = emit->bytecode_offset;
+    emit->peep_arg = arg;
+}
+
+// If the last instruction written is of the given kind, rewind over it so the
+// caller can write a fused instruction in its place.  The decision only
+// depends on the code being compiled, so it's the same on every pass and the
+// labels stay put.
+STATIC bool emit_bc_peep_take(emit_t *emit, byte kind, mp_int_t *arg) {
+    if (emit->peep_kind != kind || emit->peep_end != emit->bytecode_offset) {
+        return false;
+    }
+    emit->bytecode_offset = emit->peep_start;
+    emit->peep_kind = PEEP_NONE;
+    *arg = emit->peep_arg;
+    return true;
+}
+
+#endif
+
 void mp_emit_bc_start_pass(emit_t *emit, pass_kind_t pass, scope_t *scope) {
     emit->pass = pass;
+    #if MICROPY_OPT_BYTECODE_PEEPHOLE
+    emit->peep_kind = PEEP_NONE;
+    #endif
     emit->stack_size = 0;
     emit->last_emit_was_return_value = false;
     emit->scope = scope;
@@ -485,6 +531,10 @@ void mp_emit_bc_set_source_line(emit_t *emit, mp_uint_t source_line) {
         emit_write_code_info_bytes_lines(emit, bytes_to_skip, lines_to_skip);
         emit->last_source_line_offset = emit->bytecode_offset;
         emit->last_source_line = source_line;
+        #if MICROPY_OPT_BYTECODE_PEEPHOLE
+        // the line info now points at the next instruction
+        emit->peep_kind = PEEP_NONE;
+        #endif
     }
 #else
     (void)emit;
@@ -498,6 +548,10 @@ void mp_emit_bc_label_assign(emit_t *emit, mp_uint_t l) {
         return;
     }
     assert(l < emit->max_num_labels);
+    #if MICROPY_OPT_BYTECODE_PEEPHOLE
+    // can't fuse across a jump target
+    emit->peep_kind = PEEP_NONE;
+    #endif
     if (emit->pass < MP_PASS_EMIT) {
         // assign label offset
         assert(emit->label_offsets[l] == (mp_uint_t)-1);
@@ -538,11 +592,17 @@ void mp_emit_bc_load_const_tok(emit_t *emit, mp_token_kind_t tok) {
 
 void mp_emit_bc_load_const_small_int(emit_t *emit, mp_int_t arg) {
     emit_bc_pre(emit, 1);
+    #if MICROPY_OPT_BYTECODE_PEEPHOLE
+    size_t start = emit->bytecode_offset;
+    #endif
     if (-16 <= arg && arg <= 47) {
         emit_write_bytecode_byte(emit, MP_BC_LOAD_CONST_SMALL_INT_MULTI + 16 + arg);
     } else {
         emit_write_bytecode_byte_int(emit, MP_BC_LOAD_CONST_SMALL_INT, arg);
     }
+    #if MICROPY_OPT_BYTECODE_PEEPHOLE
+    emit_bc_peep_mark(emit, PEEP_SMALL_INT, start, arg);
+    #endif
 }
 
 void mp_emit_bc_load_const_str(emit_t *emit, qstr qst) {
@@ -565,11 +625,19 @@ void mp_emit_bc_load_local(emit_t *emit, qstr qst, mp_uint_t local_num, int kind
     MP_STATIC_ASSERT(MP_BC_LOAD_FAST_N + MP_EMIT_IDOP_LOCAL_DEREF == MP_BC_LOAD_DEREF);
     (void)qst;
     emit_bc_pre(emit, 1);
+    #if MICROPY_OPT_BYTECODE_PEEPHOLE
+    size_t start = emit->bytecode_offset;
+    #endif
     if (kind == MP_EMIT_IDOP_LOCAL_FAST && local_num <= 15) {
         emit_write_bytecode_byte(emit, MP_BC_LOAD_FAST_MULTI + local_num);
     } else {
         emit_write_bytecode_byte_uint(emit, MP_BC_LOAD_FAST_N + kind, local_num);
     }
+    #if MICROPY_OPT_BYTECODE_PEEPHOLE
+    if (kind == MP_EMIT_IDOP_LOCAL_FAST && local_num <= 255) {
+        emit_bc_peep_mark(emit, PEEP_LOAD_FAST, start, local_num);
+    }
+    #endif
 }
 
 void mp_emit_bc_load_global(emit_t *emit, qstr qst, int kind) {
@@ -610,6 +678,16 @@ void mp_emit_bc_subscr(emit_t *emit, int kind) {
 void mp_emit_bc_attr(emit_t *emit, qstr qst, int kind) {
     if (kind == MP_EMIT_ATTR_LOAD) {
         emit_bc_pre(emit, 0);
+        #if MICROPY_OPT_BYTECODE_PEEPHOLE
+        // LOAD_FAST + LOAD_ATTR, only when LOAD_ATTR wouldn't have a cache byte
+        mp_int_t local_num;
+        if (!MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE_DYNAMIC
+            && emit_bc_peep_take(emit, PEEP_LOAD_FAST, &local_num)) {
+            emit_write_bytecode_byte_qstr(emit, MP_BC_LOAD_FAST_ATTR, qst);
+            emit_write_bytecode_byte(emit, local_num);
+            return;
+        }
+        #endif
         emit_write_bytecode_byte_qstr(emit, MP_BC_LOAD_ATTR, qst);
     } else {
         if (kind == MP_EMIT_ATTR_DELETE) {
@@ -689,6 +767,16 @@ void mp_emit_bc_jump(emit_t *emit, mp_uint_t label) {
 
 void mp_emit_bc_pop_jump_if(emit_t *emit, bool cond, mp_uint_t label) {
     emit_bc_pre(emit, -1);
+    #if MICROPY_OPT_BYTECODE_PEEPHOLE
+    // comparison + POP_JUMP_IF
+    mp_int_t op;
+    if (emit_bc_peep_take(emit, PEEP_COMPARE, &op)) {
+        emit_write_bytecode_byte_signed_label(emit,
+            cond ? MP_BC_BINARY_OP_POP_JUMP_IF_TRUE : MP_BC_BINARY_OP_POP_JUMP_IF_FALSE, label);
+        emit_write_bytecode_byte(emit, op);
+        return;
+    }
+    #endif
     if (cond) {
         emit_write_bytecode_byte_signed_label(emit, MP_BC_POP_JUMP_IF_TRUE, label);
     } else {
@@ -785,6 +873,23 @@ void mp_emit_bc_binary_op(emit_t *emit, mp_binary_op_t op) {
         op = MP_BINARY_OP_IS;
     }
     emit_bc_pre(emit, -1);
+    #if MICROPY_OPT_BYTECODE_PEEPHOLE
+    if (op <= MP_BINARY_OP_NOT_EQUAL) {
+        // comparisons are left alone so they can be fused with a following jump
+        size_t start = emit->bytecode_offset;
+        emit_write_bytecode_byte(emit, MP_BC_BINARY_OP_MULTI + op);
+        emit_bc_peep_mark(emit, PEEP_COMPARE, start, op);
+        return;
+    } else if (op >= MP_BINARY_OP_INPLACE_OR) {
+        // LOAD_CONST_SMALL_INT + arithmetic BINARY_OP
+        mp_int_t arg;
+        if (emit_bc_peep_take(emit, PEEP_SMALL_INT, &arg)) {
+            emit_write_bytecode_byte_int(emit, MP_BC_BINARY_OP_SMALL_INT, arg);
+            emit_write_bytecode_byte(emit, op);
+            return;
+        }
+    }
+    #endif
     emit_write_bytecode_byte(emit, MP_BC_BINARY_OP_MULTI + op);
     if (invert) {
         emit_bc_pre(emit, 0);
@@ -30,6 +30,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <math.h>
 #include "py/formatfloat.h"
 
@@ -426,4 +427,271 @@ int mp_format_float(FPTYPE f, char *buf, size_t buf_size, char fmt, int prec, ch
     return s - buf;
 }
 
+#if MP_FORMAT_FLOAT_SHORTEST
+
+/***********************************************************************
+
+  Shortest representation of a float, after Ulf Adams' Ryu algorithm
+  (https://github.com/ulfjack/ryu, Apache 2.0 / Boost licensed): the
+  decimal digits come out of 32x64 bit integer multiplications with a
+  table of powers of 5, so they are exact and read back to the same float.
+
+***********************************************************************/
+
+#define RYU_POW5_INV_BITCOUNT 59
+#define RYU_POW5_BITCOUNT 61
+
+// ryu_pow5_inv[i] = 2^(pow5bits(i) - 1 + 59) / 5^i + 1
+static const uint64_t ryu_pow5_inv[32] = {
+    0x0800000000000001ULL, 0x0666666666666667ULL, 0x051eb851eb851eb9ULL,
+    0x04189374bc6a7efaULL, 0x068db8bac710cb2aULL, 0x053e2d6238da3c22ULL,
+    0x0431bde82d7b634eULL, 0x06b5fca6af2bd216ULL, 0x055e63b88c230e78ULL,
+    0x044b82fa09b5a52dULL, 0x06df37f675ef6eaeULL, 0x057f5ff85e592558ULL,
+    0x0465e6604b7a8447ULL, 0x0709709a125da071ULL, 0x05a126e1a84ae6c1ULL,
+    0x0480ebe7b9d58567ULL, 0x0734aca5f6226f0bULL, 0x05c3bd5191b525a3ULL,
+    0x049c97747490eae9ULL, 0x0760f253edb4ab0eULL, 0x05e72843249088d8ULL,
+    0x04b8ed0283a6d3e0ULL, 0x078e480405d7b966ULL, 0x060b6cd004ac9452ULL,
+    0x04d5f0a66a23a9dbULL, 0x07bcb43d769f762bULL, 0x063090312bb2c4efULL,
+    0x04f3a68dbc8f03f3ULL, 0x07ec3daf94180651ULL, 0x065697bfa9acd1daULL,
+    0x051212ffbaf0a7e2ULL, 0x040e7599625a1fe8ULL,
+};
+
+// ryu_pow5[i] = 5^i scaled to 61 significant bits
+static const uint64_t ryu_pow5[48] = {
+    0x1000000000000000ULL, 0x1400000000000000ULL, 0x1900000000000000ULL,
+    0x1f40000000000000ULL, 0x1388000000000000ULL, 0x186a000000000000ULL,
+    0x1e84800000000000ULL, 0x1312d00000000000ULL, 0x17d7840000000000ULL,
+    0x1dcd650000000000ULL, 0x12a05f2000000000ULL, 0x174876e800000000ULL,
+    0x1d1a94a200000000ULL, 0x12309ce540000000ULL, 0x16bcc41e90000000ULL,
+    0x1c6bf52634000000ULL, 0x11c37937e0800000ULL, 0x16345785d8a00000ULL,
+    0x1bc16d674ec80000ULL, 0x1158e460913d0000ULL, 0x15af1d78b58c4000ULL,
+    0x1b1ae4d6e2ef5000ULL, 0x10f0cf064dd59200ULL, 0x152d02c7e14af680ULL,
+    0x1a784379d99db420ULL, 0x108b2a2c28029094ULL, 0x14adf4b7320334b9ULL,
+    0x19d971e4fe8401e7ULL, 0x1027e72f1f128130ULL, 0x1431e0fae6d7217cULL,
+    0x193e5939a08ce9dbULL, 0x1f8def8808b02452ULL, 0x13b8b5b5056e16b3ULL,
+    0x18a6e32246c99c60ULL, 0x1ed09bead87c0378ULL, 0x13426172c74d822bULL,
+    0x1812f9cf7920e2b6ULL, 0x1e17b84357691b64ULL, 0x12ced32a16a1b11eULL,
+    0x178287f49c4a1d66ULL, 0x1d6329f1c35ca4bfULL, 0x125dfa371a19e6f7ULL,
+    0x16f578c4e0a060b5ULL, 0x1cb2d6f618c878e3ULL, 0x11efc659cf7d4b8dULL,
+    0x166bb7f0435c9e71ULL, 0x1c06a5ec5433c60dULL, 0x118427b3b4a05bc8ULL,
+};
+
+// ceil(log2(5^e)) for e > 0
+static inline int32_t ryu_pow5bits(int32_t e) {
+    return (int32_t)(((uint32_t)e * 1217359) >> 19) + 1;
+}
+
+// floor(log10(2^e)) and floor(log10(5^e))
+static inline uint32_t ryu_log10_pow2(int32_t e) {
+    return ((uint32_t)e * 78913) >> 18;
+}
+static inline uint32_t ryu_log10_pow5(int32_t e) {
+    return ((uint32_t)e * 732923) >> 20;
+}
+
+static inline bool ryu_multiple_of_pow5(uint32_t value, uint32_t p) {
+    uint32_t count = 0;
+    while (value % 5 == 0) {
+        value /= 5;
+        count++;
+    }
+    return count >= p;
+}
+
+static inline uint32_t ryu_mul_shift(uint32_t m, uint64_t factor, int32_t shift) {
+    uint64_t bits0 = (uint64_t)m * (uint32_t)factor;
+    uint64_t bits1 = (uint64_t)m * (uint32_t)(factor >> 32);
+    return (uint32_t)(((bits0 >> 32) + bits1) >> (shift - 32));
+}
+
+// Returns the shortest digits of the finite, non-zero and positive value in bits,
+// setting *exp10 so that the value is digits * 10^exp10
+static uint32_t ryu_float_digits(uint32_t bits, int32_t *exp10) {
+    uint32_t ieee_mantissa = bits & FLT_MAN_MASK;
+    uint32_t ieee_exponent = (bits & FLT_EXP_MASK) >> 23;
+
+    int32_t e2;
+    uint32_t m2;
+    if (ieee_exponent == 0) {
+        e2 = 1 - 127 - 23 - 2;
+        m2 = ieee_mantissa;
+    } else {
+        e2 = ieee_exponent - 127 - 23 - 2;
+        m2 = (1 << 23) | ieee_mantissa;
+    }
+    // round to even: the bounds themselves read back to this value when m2 is even
+    bool accept_bounds = (m2 & 1) == 0;
+
+    // the value and the half-way points to its neighbours, times 4
+    uint32_t mv = 4 * m2;
+    uint32_t mp = 4 * m2 + 2;
+    uint32_t mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+    uint32_t mm = 4 * m2 - 1 - mm_shift;
+
+    uint32_t vr, vp, vm;
+    int32_t e10;
+    bool vm_trailing_zeros = false;
+    bool vr_trailing_zeros = false;
+    uint32_t last_removed_digit = 0;
+    if (e2 >= 0) {
+        uint32_t q = ryu_log10_pow2(e2);
+        e10 = q;
+        int32_t k = RYU_POW5_INV_BITCOUNT + ryu_pow5bits(q) - 1;
+        int32_t i = -e2 + (int32_t)q + k;
+        vr = ryu_mul_shift(mv, ryu_pow5_inv[q], i);
+        vp = ryu_mul_shift(mp, ryu_pow5_inv[q], i);
+        vm = ryu_mul_shift(mm, ryu_pow5_inv[q], i);
+        if (q != 0 && (vp - 1) / 10 <= vm / 10) {
+            // the digit loop below removes at most one digit, get the one it needs for rounding
+            int32_t l = RYU_POW5_INV_BITCOUNT + ryu_pow5bits(q - 1) - 1;
+            last_removed_digit = ryu_mul_shift(mv, ryu_pow5_inv[q - 1], -e2 + (int32_t)q - 1 + l) % 10;
+        }
+        if (q <= 9) {
+            // only one of mp, mv and mm can be a multiple of 5, if any
+            if (mv % 5 == 0) {
+                vr_trailing_zeros = ryu_multiple_of_pow5(mv, q);
+            } else if (accept_bounds) {
+                vm_trailing_zeros = ryu_multiple_of_pow5(mm, q);
+            } else {
+                vp -= ryu_multiple_of_pow5(mp, q);
+            }
+        }
+    } else {
+        uint32_t q = ryu_log10_pow5(-e2);
+        e10 = (int32_t)q + e2;
+        int32_t i = -e2 - (int32_t)q;
+        int32_t k = ryu_pow5bits(i) - RYU_POW5_BITCOUNT;
+        int32_t j = (int32_t)q - k;
+        vr = ryu_mul_shift(mv, ryu_pow5[i], j);
+        vp = ryu_mul_shift(mp, ryu_pow5[i], j);
+        vm = ryu_mul_shift(mm, ryu_pow5[i], j);
+        if (q != 0 && (vp - 1) / 10 <= vm / 10) {
+            j = (int32_t)q - 1 - (ryu_pow5bits(i + 1) - RYU_POW5_BITCOUNT);
+            last_removed_digit = ryu_mul_shift(mv, ryu_pow5[i + 1], j) % 10;
+        }
+        if (q <= 1) {
+            // mv has at least q trailing zero bits, so vr is exact
+            vr_trailing_zeros = true;
+            if (accept_bounds) {
+                vm_trailing_zeros = mm_shift == 1;
+            } else {
+                --vp;
+            }
+        } else if (q < 31) {
+            vr_trailing_zeros = (mv & ((1u << (q - 1)) - 1)) == 0;
+        }
+    }
+
+    // drop the digits shared by the whole interval that reads back to the value
+    int32_t removed = 0;
+    uint32_t output;
+    if (vm_trailing_zeros || vr_trailing_zeros) {
+        while (vp / 10 > vm / 10) {
+            vm_trailing_zeros &= vm % 10 == 0;
+            vr_trailing_zeros &= last_removed_digit == 0;
+            last_removed_digit = vr % 10;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        if (vm_trailing_zeros) {
+            while (vm % 10 == 0) {
+                vr_trailing_zeros &= last_removed_digit == 0;
+                last_removed_digit = vr % 10;
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                removed++;
+            }
+        }
+        if (vr_trailing_zeros && last_removed_digit == 5 && vr % 2 == 0) {
+            // exactly half-way, round to even
+            last_removed_digit = 4;
+        }
+        output = vr + ((vr == vm && (!accept_bounds || !vm_trailing_zeros)) || last_removed_digit >= 5);
+    } else {
+        while (vp / 10 > vm / 10) {
+            last_removed_digit = vr % 10;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        output = vr + (vr == vm || last_removed_digit >= 5);
+    }
+    *exp10 = e10 + removed;
+    return output;
+}
+
+// Formats f like the 'g' format with a precision of 7 would, but with the
+// shortest digits that read back to f instead of 7 rounded ones.
+int mp_format_float_shortest(float f, char *buf, size_t buf_size) {
+    union floatbits fb = {f};
+    if ((fb.u & ~FLT_SIGN_MASK) == 0 || (fb.u & FLT_EXP_MASK) == FLT_EXP_MASK || buf_size < 16) {
+        // zero, inf and nan
+        return mp_format_float(f, buf, buf_size, 'g', 7, '\0');
+    }
+
+    char digits[10];
+    int32_t exp10;
+    uint32_t output = ryu_float_digits(fb.u & ~FLT_SIGN_MASK, &exp10);
+    int n = 0;
+    for (; output; output /= 10) {
+        digits[n++] = '0' + output % 10;
+    }
+    // digits[] holds them backwards, and the first one has a weight of 10^e
+    int e = exp10 + n - 1;
+
+    char *s = buf;
+    if (fb.u & FLT_SIGN_MASK) {
+        *s++ = '-';
+    }
+    if (e < -4 || e >= 7) {
+        *s++ = digits[--n];
+        if (n) {
+            *s++ = '.';
+            while (n) {
+                *s++ = digits[--n];
+            }
+        }
+        *s++ = 'e';
+        if (e < 0) {
+            *s++ = '-';
+            e = -e;
+        } else {
+            *s++ = '+';
+        }
+        *s++ = '0' + e / 10;
+        *s++ = '0' + e % 10;
+    } else if (e < 0) {
+        *s++ = '0';
+        *s++ = '.';
+        while (++e) {
+            *s++ = '0';
+        }
+        while (n) {
+            *s++ = digits[--n];
+        }
+    } else {
+        for (; e >= 0; e--) {
+            *s++ = n ? digits[--n] : '0';
+        }
+        if (n) {
+            *s++ = '.';
+            while (n) {
+                *s++ = digits[--n];
+            }
+        }
+    }
+    *s = '\0';
+
+    // verify that we did not overrun the input buffer
+    assert((size_t)(s + 1 - buf) <= buf_size);
+
+    return s - buf;
+}
+
+#endif // MP_FORMAT_FLOAT_SHORTEST
+
 #endif // MICROPY_FLOAT_IMPL != MICROPY_FLOAT_IMPL_NONE
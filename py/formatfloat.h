@@ -32,4 +32,12 @@
 int mp_format_float(mp_float_t f, char *buf, size_t bufSize, char fmt, int prec, char sign);
 #endif
 
+// the shortest repr needs single precision floats with all their mantissa bits
+#define MP_FORMAT_FLOAT_SHORTEST (MICROPY_FLOAT_SHORTEST_REPR && MICROPY_FLOAT_IMPL == MICROPY_FLOAT_IMPL_FLOAT \
+    && MICROPY_OBJ_REPR != MICROPY_OBJ_REPR_C)
+
+#if MP_FORMAT_FLOAT_SHORTEST
+int mp_format_float_shortest(float f, char *buf, size_t bufSize);
+#endif
+
 #endif // MICROPY_INCLUDED_PY_FORMATFLOAT_H
@@ -30,6 +30,7 @@
 
 #include "py/lexer.h"
 #include "py/frozenmod.h"
+#include "py/persistentcode.h"
 
 #if MICROPY_MODULE_FROZEN_STR
 
@@ -96,6 +97,25 @@ STATIC const mp_raw_code_t *mp_find_frozen_mpy(const char *str, size_t len) {
 
 #endif
 
+#if MICROPY_MODULE_FROZEN_XIP
+
+STATIC mp_raw_code_t *mp_find_frozen_xip(const char *str, size_t len) {
+    const char *name = mp_raw_code_xip_names();
+    if (name == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; *name != 0; i++) {
+        size_t l = strlen(name);
+        if (l == len && !memcmp(str, name, l)) {
+            return mp_raw_code_load_xip(i);
+        }
+        name += l + 1;
+    }
+    return NULL;
+}
+
+#endif
+
 #if MICROPY_MODULE_FROZEN
 
 STATIC mp_import_stat_t mp_frozen_stat_helper(const char *name, const char *str) {
@@ -132,6 +152,16 @@ mp_import_stat_t mp_frozen_stat(const char *str) {
     }
     #endif
 
+    #if MICROPY_MODULE_FROZEN_XIP
+    const char *xip_names = mp_raw_code_xip_names();
+    if (xip_names != NULL) {
+        stat = mp_frozen_stat_helper(xip_names, str);
+        if (stat != MP_IMPORT_STAT_NO_EXIST) {
+            return stat;
+        }
+    }
+    #endif
+
     return MP_IMPORT_STAT_NO_EXIST;
 }
 
@@ -150,6 +180,13 @@ int mp_find_frozen_module(const char *str, size_t len, void **data) {
         return MP_FROZEN_MPY;
     }
     #endif
+    #if MICROPY_MODULE_FROZEN_XIP
+    mp_raw_code_t *xip_rc = mp_find_frozen_xip(str, len);
+    if (xip_rc != NULL) {
+        *data = xip_rc;
+        return MP_FROZEN_MPY;
+    }
+    #endif
     return MP_FROZEN_NONE;
 }
 
@@ -32,6 +32,14 @@
 #include "py/gc.h"
 #include "py/runtime.h"
 
+#if MICROPY_PY_MICROPYTHON_ALLOC_STATS
+#include "py/bc.h"
+#endif
+
+#if MICROPY_GC_LAZY_SWEEP
+#include "py/mphal.h"
+#endif
+
 #if MICROPY_ENABLE_GC
 
 #if MICROPY_DEBUG_VERBOSE // print debugging info
@@ -75,26 +83,42 @@
 #define ATB_3_IS_FREE(a) (((a) & ATB_MASK_3) == 0)
 
 #define BLOCK_SHIFT(block) (2 * ((block) & (BLOCKS_PER_ATB - 1)))
-#define ATB_GET_KIND(block) ((MP_STATE_MEM(gc_alloc_table_start)[(block) / BLOCKS_PER_ATB] >> BLOCK_SHIFT(block)) & 3)
-#define ATB_ANY_TO_FREE(block) do { MP_STATE_MEM(gc_alloc_table_start)[(block) / BLOCKS_PER_ATB] &= (~(AT_MARK << BLOCK_SHIFT(block))); } while (0)
-#define ATB_FREE_TO_HEAD(block) do { MP_STATE_MEM(gc_alloc_table_start)[(block) / BLOCKS_PER_ATB] |= (AT_HEAD << BLOCK_SHIFT(block)); } while (0)
-#define ATB_FREE_TO_TAIL(block) do { MP_STATE_MEM(gc_alloc_table_start)[(block) / BLOCKS_PER_ATB] |= (AT_TAIL << BLOCK_SHIFT(block)); } while (0)
-#define ATB_HEAD_TO_MARK(block) do { MP_STATE_MEM(gc_alloc_table_start)[(block) / BLOCKS_PER_ATB] |= (AT_MARK << BLOCK_SHIFT(block)); } while (0)
-#define ATB_MARK_TO_HEAD(block) do { MP_STATE_MEM(gc_alloc_table_start)[(block) / BLOCKS_PER_ATB] &= (~(AT_TAIL << BLOCK_SHIFT(block))); } while (0)
-
-#define BLOCK_FROM_PTR(ptr) (((byte*)(ptr) - MP_STATE_MEM(gc_pool_start)) / BYTES_PER_BLOCK)
-#define PTR_FROM_BLOCK(block) (((block) * BYTES_PER_BLOCK + (uintptr_t)MP_STATE_MEM(gc_pool_start)))
+#define ATB_GET_KIND(area, block) (((area)->gc_alloc_table_start[(block) / BLOCKS_PER_ATB] >> BLOCK_SHIFT(block)) & 3)
+#define ATB_ANY_TO_FREE(area, block) do { (area)->gc_alloc_table_start[(block) / BLOCKS_PER_ATB] &= (~(AT_MARK << BLOCK_SHIFT(block))); } while (0)
+#define ATB_FREE_TO_HEAD(area, block) do { (area)->gc_alloc_table_start[(block) / BLOCKS_PER_ATB] |= (AT_HEAD << BLOCK_SHIFT(block)); } while (0)
+#define ATB_FREE_TO_TAIL(area, block) do { (area)->gc_alloc_table_start[(block) / BLOCKS_PER_ATB] |= (AT_TAIL << BLOCK_SHIFT(block)); } while (0)
+#define ATB_HEAD_TO_MARK(area, block) do { (area)->gc_alloc_table_start[(block) / BLOCKS_PER_ATB] |= (AT_MARK << BLOCK_SHIFT(block)); } while (0)
+#define ATB_TAIL_TO_HEAD(area, block) do { (area)->gc_alloc_table_start[(block) / BLOCKS_PER_ATB] ^= ((AT_HEAD ^ AT_TAIL) << BLOCK_SHIFT(block)); } while (0)
+#define ATB_MARK_TO_HEAD(area, block) do { (area)->gc_alloc_table_start[(block) / BLOCKS_PER_ATB] &= (~(AT_TAIL << BLOCK_SHIFT(block))); } while (0)
+
+#define BLOCK_FROM_PTR(area, ptr) (((byte*)(ptr) - (area)->gc_pool_start) / BYTES_PER_BLOCK)
+#define PTR_FROM_BLOCK(area, block) (((block) * BYTES_PER_BLOCK + (uintptr_t)(area)->gc_pool_start))
 #define ATB_FROM_BLOCK(bl) ((bl) / BLOCKS_PER_ATB)
 
+// number of blocks in the pool of an area
+#define AREA_BLOCKS(area) ((area)->gc_alloc_table_byte_len * BLOCKS_PER_ATB)
+
+#if MICROPY_GC_SPLIT_HEAP
+#define NEXT_AREA(area) ((area)->next)
+#else
+#define NEXT_AREA(area) (NULL)
+#endif
+
+#if MICROPY_GC_LAZY_SWEEP
+// the elapsed time is only checked every that many blocks
+#define GC_SWEEP_SLICE_BLOCKS (256)
+#define GC_SWEEP_PENDING(area) ((area)->gc_sweep_block < AREA_BLOCKS(area))
+#endif
+
 #if MICROPY_ENABLE_FINALISER
 // FTB = finaliser table byte
 // if set, then the corresponding block may have a finaliser
 
 #define BLOCKS_PER_FTB (8)
 
-#define FTB_GET(block) ((MP_STATE_MEM(gc_finaliser_table_start)[(block) / BLOCKS_PER_FTB] >> ((block) & 7)) & 1)
-#define FTB_SET(block) do { MP_STATE_MEM(gc_finaliser_table_start)[(block) / BLOCKS_PER_FTB] |= (1 << ((block) & 7)); } while (0)
-#define FTB_CLEAR(block) do { MP_STATE_MEM(gc_finaliser_table_start)[(block) / BLOCKS_PER_FTB] &= (~(1 << ((block) & 7))); } while (0)
+#define FTB_GET(area, block) (((area)->gc_finaliser_table_start[(block) / BLOCKS_PER_FTB] >> ((block) & 7)) & 1)
+#define FTB_SET(area, block) do { (area)->gc_finaliser_table_start[(block) / BLOCKS_PER_FTB] |= (1 << ((block) & 7)); } while (0)
+#define FTB_CLEAR(area, block) do { (area)->gc_finaliser_table_start[(block) / BLOCKS_PER_FTB] &= (~(1 << ((block) & 7))); } while (0)
 #endif
 
 #if MICROPY_PY_THREAD && !MICROPY_PY_THREAD_GIL
@@ -105,8 +129,110 @@
 #define GC_EXIT()
 #endif
 
+#if MICROPY_GC_FREE_LISTS
+// free lists hold runs of 1, 2 and 4 blocks
+#define GC_FREE_LIST_CLASSES (3)
+#define GC_FREE_LIST_MAX_BLOCKS (4)
+#define GC_FREE_LIST_CLASS(n_blocks) ((n_blocks) == 1 ? 0 : (n_blocks) == 2 ? 1 : 2)
+
+// Record a run of free blocks, cut into the largest pieces the lists take
+STATIC void gc_free_list_add_run(mp_state_mem_area_t *area, size_t block, size_t len) {
+    while (len > 0) {
+        size_t c = len >= 4 ? 2 : len >= 2 ? 1 : 0;
+        if (area->gc_free_list_len[c] == MICROPY_GC_FREE_LIST_LEN) {
+            // the rest of the run is left for the table scan
+            return;
+        }
+        area->gc_free_list[c][area->gc_free_list_len[c]++] = block;
+        block += 1 << c;
+        len -= 1 << c;
+    }
+}
+
+// Take a run of at least n_blocks off the lists, starting with the smallest
+// fitting size.  Entries may have been allocated since they were recorded so
+// each is checked against the ATB, and the unused part of a run is put back.
+STATIC bool gc_free_list_take(mp_state_mem_area_t *area, size_t n_blocks, size_t *start_block) {
+    for (size_t c = GC_FREE_LIST_CLASS(n_blocks); c < GC_FREE_LIST_CLASSES; c++) {
+        while (area->gc_free_list_len[c] > 0) {
+            size_t block = area->gc_free_list[c][--area->gc_free_list_len[c]];
+            size_t len = 1 << c;
+            size_t n = 0;
+            while (n < len && ATB_GET_KIND(area, block + n) == AT_FREE) {
+                n++;
+            }
+            if (n == len) {
+                gc_free_list_add_run(area, block + n_blocks, len - n_blocks);
+                *start_block = block;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+STATIC void gc_free_list_clear(mp_state_mem_area_t *area) {
+    for (size_t c = 0; c < GC_FREE_LIST_CLASSES; c++) {
+        area->gc_free_list_len[c] = 0;
+    }
+}
+#endif
+
+#if MICROPY_PY_MICROPYTHON_ALLOC_STATS
+void gc_alloc_stats_enable(bool enable) {
+    GC_ENTER();
+    MP_STATE_MEM(alloc_stats_enabled) = enable;
+    if (enable) {
+        // start counting afresh, the first site takes everything not made
+        // by bytecode or that doesn't fit in the table
+        mp_alloc_site_t *other = &MP_STATE_MEM(alloc_stats_sites)[0];
+        other->source_file = MP_QSTR_NULL;
+        other->block_name = MP_QSTR_NULL;
+        other->source_line = 0;
+        other->count = 0;
+        other->bytes = 0;
+        MP_STATE_MEM(alloc_stats_n_sites) = 1;
+        MP_STATE_MEM(alloc_stats_collections) = 0;
+    }
+    GC_EXIT();
+}
+
+// Count an allocation against the source line executing, must be called with the GC entered
+STATIC void gc_alloc_stats_record(size_t n_bytes) {
+    qstr source_file = MP_QSTR_NULL;
+    qstr block_name = MP_QSTR_NULL;
+    size_t source_line = 0;
+    const mp_code_state_t *code_state = MP_STATE_THREAD(current_code_state);
+    if (code_state != NULL) {
+        mp_bytecode_get_source_info(code_state, &source_file, &block_name, &source_line);
+    }
+
+    mp_alloc_site_t *sites = MP_STATE_MEM(alloc_stats_sites);
+    size_t n_sites = MP_STATE_MEM(alloc_stats_n_sites);
+    mp_alloc_site_t *site = &sites[0];
+    for (size_t i = 0; i < n_sites; i++) {
+        if (sites[i].source_line == source_line && sites[i].source_file == source_file) {
+            site = &sites[i];
+            goto found;
+        }
+    }
+    if (n_sites < MICROPY_ALLOC_STATS_SITES) {
+        site = &sites[n_sites];
+        site->source_file = source_file;
+        site->block_name = block_name;
+        site->source_line = source_line;
+        site->count = 0;
+        site->bytes = 0;
+        MP_STATE_MEM(alloc_stats_n_sites) = n_sites + 1;
+    }
+found:
+    site->count += 1;
+    site->bytes += n_bytes;
+}
+#endif
+
 // TODO waste less memory; currently requires that all entries in alloc_table have a corresponding block in pool
-void gc_init(void *start, void *end) {
+STATIC void gc_setup_area(mp_state_mem_area_t *area, void *start, void *end) {
     // align end pointer on block boundary
     end = (void*)((uintptr_t)end & (~(BYTES_PER_BLOCK - 1)));
     DEBUG_printf("Initializing GC heap: %p..%p = " UINT_FMT " bytes\n", start, end, (byte*)end - (byte*)start);
@@ -118,36 +244,62 @@ void gc_init(void *start, void *end) {
     // => T = A * (1 + BLOCKS_PER_ATB / BLOCKS_PER_FTB + BLOCKS_PER_ATB * BYTES_PER_BLOCK)
     size_t total_byte_len = (byte*)end - (byte*)start;
 #if MICROPY_ENABLE_FINALISER
-    MP_STATE_MEM(gc_alloc_table_byte_len) = total_byte_len * BITS_PER_BYTE / (BITS_PER_BYTE + BITS_PER_BYTE * BLOCKS_PER_ATB / BLOCKS_PER_FTB + BITS_PER_BYTE * BLOCKS_PER_ATB * BYTES_PER_BLOCK);
+    area->gc_alloc_table_byte_len = total_byte_len * BITS_PER_BYTE / (BITS_PER_BYTE + BITS_PER_BYTE * BLOCKS_PER_ATB / BLOCKS_PER_FTB + BITS_PER_BYTE * BLOCKS_PER_ATB * BYTES_PER_BLOCK);
 #else
-    MP_STATE_MEM(gc_alloc_table_byte_len) = total_byte_len / (1 + BITS_PER_BYTE / 2 * BYTES_PER_BLOCK);
+    area->gc_alloc_table_byte_len = total_byte_len / (1 + BITS_PER_BYTE / 2 * BYTES_PER_BLOCK);
 #endif
 
-    MP_STATE_MEM(gc_alloc_table_start) = (byte*)start;
+    area->gc_alloc_table_start = (byte*)start;
 
 #if MICROPY_ENABLE_FINALISER
-    size_t gc_finaliser_table_byte_len = (MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB + BLOCKS_PER_FTB - 1) / BLOCKS_PER_FTB;
-    MP_STATE_MEM(gc_finaliser_table_start) = MP_STATE_MEM(gc_alloc_table_start) + MP_STATE_MEM(gc_alloc_table_byte_len);
+    size_t gc_finaliser_table_byte_len = (area->gc_alloc_table_byte_len * BLOCKS_PER_ATB + BLOCKS_PER_FTB - 1) / BLOCKS_PER_FTB;
+    area->gc_finaliser_table_start = area->gc_alloc_table_start + area->gc_alloc_table_byte_len;
 #endif
 
-    size_t gc_pool_block_len = MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB;
-    MP_STATE_MEM(gc_pool_start) = (byte*)end - gc_pool_block_len * BYTES_PER_BLOCK;
-    MP_STATE_MEM(gc_pool_end) = end;
+    size_t gc_pool_block_len = area->gc_alloc_table_byte_len * BLOCKS_PER_ATB;
+    area->gc_pool_start = (byte*)end - gc_pool_block_len * BYTES_PER_BLOCK;
+    area->gc_pool_end = end;
 
 #if MICROPY_ENABLE_FINALISER
-    assert(MP_STATE_MEM(gc_pool_start) >= MP_STATE_MEM(gc_finaliser_table_start) + gc_finaliser_table_byte_len);
+    assert(area->gc_pool_start >= area->gc_finaliser_table_start + gc_finaliser_table_byte_len);
 #endif
 
     // clear ATBs
-    memset(MP_STATE_MEM(gc_alloc_table_start), 0, MP_STATE_MEM(gc_alloc_table_byte_len));
+    memset(area->gc_alloc_table_start, 0, area->gc_alloc_table_byte_len);
 
 #if MICROPY_ENABLE_FINALISER
     // clear FTBs
-    memset(MP_STATE_MEM(gc_finaliser_table_start), 0, gc_finaliser_table_byte_len);
+    memset(area->gc_finaliser_table_start, 0, gc_finaliser_table_byte_len);
 #endif
 
     // set last free ATB index to start of heap
-    MP_STATE_MEM(gc_last_free_atb_index) = 0;
+    area->gc_last_free_atb_index = 0;
+
+    #if MICROPY_GC_LAZY_SWEEP
+    // nothing to sweep
+    area->gc_sweep_block = gc_pool_block_len;
+    area->gc_sweep_free_tail = false;
+    #endif
+
+    #if MICROPY_GC_FREE_LISTS
+    // the whole pool is free, but it's cheaper to find that by scanning
+    gc_free_list_clear(area);
+    #endif
+
+    DEBUG_printf("GC layout:\n");
+    DEBUG_printf("  alloc table at %p, length " UINT_FMT " bytes, " UINT_FMT " blocks\n", area->gc_alloc_table_start, area->gc_alloc_table_byte_len, area->gc_alloc_table_byte_len * BLOCKS_PER_ATB);
+#if MICROPY_ENABLE_FINALISER
+    DEBUG_printf("  finaliser table at %p, length " UINT_FMT " bytes, " UINT_FMT " blocks\n", area->gc_finaliser_table_start, gc_finaliser_table_byte_len, gc_finaliser_table_byte_len * BLOCKS_PER_FTB);
+#endif
+    DEBUG_printf("  pool at %p, length " UINT_FMT " bytes, " UINT_FMT " blocks\n", area->gc_pool_start, gc_pool_block_len * BYTES_PER_BLOCK, gc_pool_block_len);
+}
+
+void gc_init(void *start, void *end) {
+    // the first area is the one held in mp_state_mem_t
+    gc_setup_area(&MP_STATE_MEM(area), start, end);
+    #if MICROPY_GC_SPLIT_HEAP
+    MP_STATE_MEM(area).next = NULL;
+    #endif
 
     // unlock the GC
     MP_STATE_MEM(gc_lock_depth) = 0;
@@ -155,23 +307,56 @@ void gc_init(void *start, void *end) {
     // allow auto collection
     MP_STATE_MEM(gc_auto_collect_enabled) = 1;
 
+    #if MICROPY_PY_MICROPYTHON_ALLOC_STATS
+    MP_STATE_MEM(alloc_stats_enabled) = false;
+    #endif
+
+    #if MICROPY_GC_LAZY_SWEEP
+    MP_STATE_MEM(gc_sweep_budget_us) = MICROPY_GC_PAUSE_BUDGET_US;
+    #endif
+
+    #if MICROPY_GC_FREE_LISTS
+    MP_STATE_MEM(gc_free_list_hits) = 0;
+    MP_STATE_MEM(gc_free_list_misses) = 0;
+    #endif
+
     #if MICROPY_GC_ALLOC_THRESHOLD
     // by default, maxuint for gc threshold, effectively turning gc-by-threshold off
     MP_STATE_MEM(gc_alloc_threshold) = (size_t)-1;
     MP_STATE_MEM(gc_alloc_amount) = 0;
     #endif
 
+    #if MICROPY_GC_THREAD_ALLOC_BUFFER
+    // the threads holding buffers in the previous heap are gone
+    MP_STATE_MEM(gc_alloc_buf_threads) = NULL;
+    mp_state_ctx.thread.gc_alloc_buf_area = NULL;
+    mp_state_ctx.thread.gc_alloc_buf_busy = false;
+    mp_state_ctx.thread.gc_alloc_buf_listed = false;
+    #endif
+
     #if MICROPY_PY_THREAD
     mp_thread_mutex_init(&MP_STATE_MEM(gc_mutex));
     #endif
+}
 
-    DEBUG_printf("GC layout:\n");
-    DEBUG_printf("  alloc table at %p, length " UINT_FMT " bytes, " UINT_FMT " blocks\n", MP_STATE_MEM(gc_alloc_table_start), MP_STATE_MEM(gc_alloc_table_byte_len), MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB);
-#if MICROPY_ENABLE_FINALISER
-    DEBUG_printf("  finaliser table at %p, length " UINT_FMT " bytes, " UINT_FMT " blocks\n", MP_STATE_MEM(gc_finaliser_table_start), gc_finaliser_table_byte_len, gc_finaliser_table_byte_len * BLOCKS_PER_FTB);
-#endif
-    DEBUG_printf("  pool at %p, length " UINT_FMT " bytes, " UINT_FMT " blocks\n", MP_STATE_MEM(gc_pool_start), gc_pool_block_len * BYTES_PER_BLOCK, gc_pool_block_len);
+#if MICROPY_GC_SPLIT_HEAP
+void gc_add(void *start, void *end) {
+    // the area's own bookkeeping goes at the start of the new memory
+    mp_state_mem_area_t *area = (mp_state_mem_area_t*)start;
+    start = (byte*)start + sizeof(mp_state_mem_area_t);
+    gc_setup_area(area, start, end);
+    area->next = NULL;
+
+    // append it to the list of areas, after the fast first one
+    GC_ENTER();
+    mp_state_mem_area_t *prev = &MP_STATE_MEM(area);
+    while (prev->next != NULL) {
+        prev = prev->next;
+    }
+    prev->next = area;
+    GC_EXIT();
 }
+#endif
 
 void gc_lock(void) {
     GC_ENTER();
@@ -189,12 +374,167 @@ bool gc_is_locked(void) {
     return MP_STATE_MEM(gc_lock_depth) != 0;
 }
 
-// ptr should be of type void*
-#define VERIFY_PTR(ptr) ( \
-        ((uintptr_t)(ptr) & (BYTES_PER_BLOCK - 1)) == 0      /* must be aligned on a block */ \
-        && ptr >= (void*)MP_STATE_MEM(gc_pool_start)     /* must be above start of pool */ \
-        && ptr < (void*)MP_STATE_MEM(gc_pool_end)        /* must be below end of pool */ \
-    )
+// Returns the area the given pointer points into, or NULL if it isn't a
+// pointer to the start of a block in the heap.
+STATIC inline mp_state_mem_area_t *gc_get_ptr_area(const void *ptr) {
+    if (((uintptr_t)(ptr) & (BYTES_PER_BLOCK - 1)) != 0) {
+        // must be aligned on a block
+        return NULL;
+    }
+    for (mp_state_mem_area_t *area = &MP_STATE_MEM(area); area != NULL; area = NEXT_AREA(area)) {
+        if (ptr >= (void*)area->gc_pool_start && ptr < (void*)area->gc_pool_end) {
+            return area;
+        }
+    }
+    return NULL;
+}
+
+#if MICROPY_GC_THREAD_ALLOC_BUFFER
+// Each thread can hold a buffer of blocks taken from the heap in one go, out
+// of which it carves its small allocations without taking gc_mutex.  The
+// buffer starts and ends on a boundary of the ATB and FTB bytes, so while it
+// carves the owner is the only one changing them: gc_free and gc_realloc leave
+// the chunks of a buffer in use alone and the next collection deals with them.
+// The unused end of a buffer is always a head of its own which nothing points
+// to, so giving a buffer up is just forgetting it.  All the buffers are given
+// up when a collection starts, and none are taken while a lazy sweep is
+// pending, as the sweep would free the chunks carved after that.
+
+#if !MICROPY_PY_THREAD
+#error MICROPY_GC_THREAD_ALLOC_BUFFER requires MICROPY_PY_THREAD
+#endif
+
+// a multiple of BLOCKS_PER_ATB and BLOCKS_PER_FTB
+#define GC_ALLOC_BUF_ALIGN (8)
+// only the chunks up to that size are carved from a buffer
+#define GC_ALLOC_BUF_MAX_BLOCKS (4)
+#define GC_ALLOC_BUF_BARRIER() __sync_synchronize()
+#ifdef MICROPY_THREAD_YIELD
+#define GC_ALLOC_BUF_WAIT() MICROPY_THREAD_YIELD()
+#else
+#define GC_ALLOC_BUF_WAIT()
+#endif
+
+// Take the buffer away from its owner, called with the GC lock held
+STATIC void gc_alloc_buf_retire(mp_state_thread_t *ts) {
+    ts->gc_alloc_buf_area = NULL;
+    GC_ALLOC_BUF_BARRIER();
+    // the owner may be carving a chunk out of it right now
+    while (ts->gc_alloc_buf_busy) {
+        GC_ALLOC_BUF_WAIT();
+    }
+}
+
+STATIC void gc_alloc_buf_retire_all(void) {
+    for (mp_state_thread_t *ts = MP_STATE_MEM(gc_alloc_buf_threads); ts != NULL; ts = ts->gc_alloc_buf_next) {
+        gc_alloc_buf_retire(ts);
+    }
+}
+
+// Whether the block is in a buffer its owner still carves, called with the GC lock held
+STATIC bool gc_alloc_buf_owns(mp_state_mem_area_t *area, size_t block) {
+    for (mp_state_thread_t *ts = MP_STATE_MEM(gc_alloc_buf_threads); ts != NULL; ts = ts->gc_alloc_buf_next) {
+        if (ts->gc_alloc_buf_area == area && ts->gc_alloc_buf_start <= block && block < ts->gc_alloc_buf_end) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Carve a chunk out of the buffer of the calling thread, without the GC lock
+STATIC void *gc_alloc_buf_take(size_t n_blocks, bool has_finaliser) {
+    mp_state_thread_t *ts = mp_thread_get_state();
+    void *ret_ptr = NULL;
+    ts->gc_alloc_buf_busy = true;
+    GC_ALLOC_BUF_BARRIER();
+    mp_state_mem_area_t *area = ts->gc_alloc_buf_area;
+    if (area != NULL && MP_STATE_MEM(gc_lock_depth) == 0) {
+        size_t block = ts->gc_alloc_buf_block;
+        size_t n_left = ts->gc_alloc_buf_end - block;
+        if (n_blocks > n_left) {
+            // not worth keeping, the next chunk comes with a new buffer
+            ts->gc_alloc_buf_area = NULL;
+        } else {
+            if (n_blocks < n_left) {
+                // what is left of the buffer starts with a head of its own
+                ATB_TAIL_TO_HEAD(area, block + n_blocks);
+                ts->gc_alloc_buf_block = block + n_blocks;
+            } else {
+                ts->gc_alloc_buf_area = NULL;
+            }
+            ret_ptr = (void*)PTR_FROM_BLOCK(area, block);
+            memset(ret_ptr, 0, n_blocks * BYTES_PER_BLOCK);
+            #if MICROPY_ENABLE_FINALISER
+            if (has_finaliser) {
+                FTB_SET(area, block);
+            }
+            #else
+            (void)has_finaliser;
+            #endif
+        }
+    }
+    GC_ALLOC_BUF_BARRIER();
+    ts->gc_alloc_buf_busy = false;
+    return ret_ptr;
+}
+
+// Turn the blocks after the first n_blocks of the chunk just claimed into the
+// buffer of the calling thread.  Called with the GC lock held.
+STATIC void gc_alloc_buf_setup(mp_state_mem_area_t *area, size_t start_block, size_t end_block, size_t n_blocks) {
+    size_t buf_start = (start_block + n_blocks + GC_ALLOC_BUF_ALIGN - 1) & ~(GC_ALLOC_BUF_ALIGN - 1);
+    size_t buf_end = (end_block + 1) & ~(GC_ALLOC_BUF_ALIGN - 1);
+    // the blocks either side of the buffer are left as heads nothing points to
+    if (start_block + n_blocks <= end_block) {
+        ATB_TAIL_TO_HEAD(area, start_block + n_blocks);
+    }
+    if (buf_start + GC_ALLOC_BUF_ALIGN > buf_end) {
+        return;
+    }
+    if (buf_start != start_block + n_blocks) {
+        ATB_TAIL_TO_HEAD(area, buf_start);
+    }
+    if (buf_end <= end_block) {
+        ATB_TAIL_TO_HEAD(area, buf_end);
+    }
+    mp_state_thread_t *ts = mp_thread_get_state();
+    ts->gc_alloc_buf_start = buf_start;
+    ts->gc_alloc_buf_block = buf_start;
+    ts->gc_alloc_buf_end = buf_end;
+    GC_ALLOC_BUF_BARRIER();
+    ts->gc_alloc_buf_area = area;
+    if (!ts->gc_alloc_buf_listed) {
+        ts->gc_alloc_buf_next = MP_STATE_MEM(gc_alloc_buf_threads);
+        MP_STATE_MEM(gc_alloc_buf_threads) = ts;
+        ts->gc_alloc_buf_listed = true;
+    }
+}
+
+void gc_alloc_buf_release(void) {
+    GC_ENTER();
+    mp_state_thread_t *ts = mp_thread_get_state();
+    mp_state_mem_area_t *area = ts->gc_alloc_buf_area;
+    if (area != NULL) {
+        // hand the unused end back straight away
+        ts->gc_alloc_buf_area = NULL;
+        for (size_t bl = ts->gc_alloc_buf_block; bl < ts->gc_alloc_buf_end; bl++) {
+            ATB_ANY_TO_FREE(area, bl);
+        }
+        if (ts->gc_alloc_buf_block / BLOCKS_PER_ATB < area->gc_last_free_atb_index) {
+            area->gc_last_free_atb_index = ts->gc_alloc_buf_block / BLOCKS_PER_ATB;
+        }
+    }
+    if (ts->gc_alloc_buf_listed) {
+        for (mp_state_thread_t **link = &MP_STATE_MEM(gc_alloc_buf_threads); *link != NULL; link = &(*link)->gc_alloc_buf_next) {
+            if (*link == ts) {
+                *link = ts->gc_alloc_buf_next;
+                break;
+            }
+        }
+        ts->gc_alloc_buf_listed = false;
+    }
+    GC_EXIT();
+}
+#endif
 
 #ifndef TRACE_MARK
 #if DEBUG_PRINT
@@ -208,7 +548,7 @@ bool gc_is_locked(void) {
 // children: mark the unmarked child blocks and put those newly marked
 // blocks on the stack. When all children have been checked, pop off the
 // topmost block on the stack and repeat with that one.
-STATIC void gc_mark_subtree(size_t block) {
+STATIC void gc_mark_subtree(mp_state_mem_area_t *area, size_t block) {
     // Start with the block passed in the argument.
     size_t sp = 0;
     for (;;) {
@@ -216,20 +556,24 @@ STATIC void gc_mark_subtree(size_t block) {
         size_t n_blocks = 0;
         do {
             n_blocks += 1;
-        } while (ATB_GET_KIND(block + n_blocks) == AT_TAIL);
+        } while (ATB_GET_KIND(area, block + n_blocks) == AT_TAIL);
 
         // check this block's children
-        void **ptrs = (void**)PTR_FROM_BLOCK(block);
+        void **ptrs = (void**)PTR_FROM_BLOCK(area, block);
         for (size_t i = n_blocks * BYTES_PER_BLOCK / sizeof(void*); i > 0; i--, ptrs++) {
             void *ptr = *ptrs;
-            if (VERIFY_PTR(ptr)) {
+            mp_state_mem_area_t *ptr_area = gc_get_ptr_area(ptr);
+            if (ptr_area != NULL) {
                 // Mark and push this pointer
-                size_t childblock = BLOCK_FROM_PTR(ptr);
-                if (ATB_GET_KIND(childblock) == AT_HEAD) {
+                size_t childblock = BLOCK_FROM_PTR(ptr_area, ptr);
+                if (ATB_GET_KIND(ptr_area, childblock) == AT_HEAD) {
                     // an unmarked head, mark it, and push it on gc stack
                     TRACE_MARK(childblock, ptr);
-                    ATB_HEAD_TO_MARK(childblock);
+                    ATB_HEAD_TO_MARK(ptr_area, childblock);
                     if (sp < MICROPY_ALLOC_GC_STACK_SIZE) {
+                        #if MICROPY_GC_SPLIT_HEAP
+                        MP_STATE_MEM(gc_area_stack)[sp] = ptr_area;
+                        #endif
                         MP_STATE_MEM(gc_stack)[sp++] = childblock;
                     } else {
                         MP_STATE_MEM(gc_stack_overflow) = 1;
@@ -244,7 +588,11 @@ STATIC void gc_mark_subtree(size_t block) {
         }
 
         // pop the next block off the stack
-        block = MP_STATE_MEM(gc_stack)[--sp];
+        sp--;
+        #if MICROPY_GC_SPLIT_HEAP
+        area = MP_STATE_MEM(gc_area_stack)[sp];
+        #endif
+        block = MP_STATE_MEM(gc_stack)[sp];
     }
 }
 
@@ -253,77 +601,452 @@ STATIC void gc_deal_with_stack_overflow(void) {
         MP_STATE_MEM(gc_stack_overflow) = 0;
 
         // scan entire memory looking for blocks which have been marked but not their children
-        for (size_t block = 0; block < MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB; block++) {
-            // trace (again) if mark bit set
-            if (ATB_GET_KIND(block) == AT_MARK) {
-                gc_mark_subtree(block);
+        for (mp_state_mem_area_t *area = &MP_STATE_MEM(area); area != NULL; area = NEXT_AREA(area)) {
+            for (size_t block = 0; block < AREA_BLOCKS(area); block++) {
+                // trace (again) if mark bit set
+                if (ATB_GET_KIND(area, block) == AT_MARK) {
+                    gc_mark_subtree(area, block);
+                }
             }
         }
     }
 }
 
-STATIC void gc_sweep(void) {
-    #if MICROPY_PY_GC_COLLECT_RETVAL
-    MP_STATE_MEM(gc_collected) = 0;
+#if MICROPY_GC_PARALLEL_MARK
+// The mark phase is shared with a helper the port runs on another CPU.  The
+// blocks of each area are dealt out to the two workers in chunks and only the
+// owner of a chunk changes its ATB entries, so marking needs no atomic
+// operations on the allocation table (these don't work on all memories, eg
+// the external RAM of the ESP32).  A worker that finds a pointer into a chunk
+// of the other one passes it on through a single producer/consumer queue.
+// The collector is worker 0 and the helper worker 1.
+
+// must be a multiple of BLOCKS_PER_ATB so that no ATB byte is shared
+#define GC_PAR_CHUNK_BLOCKS (64)
+#define GC_PAR_OWNER(block) (((block) / GC_PAR_CHUNK_BLOCKS) & 1)
+// must be a power of 2
+#define GC_PAR_QUEUE_LEN (256)
+#define GC_PAR_BARRIER() __sync_synchronize()
+
+typedef struct _gc_par_queue_t {
+    #if MICROPY_GC_SPLIT_HEAP
+    mp_state_mem_area_t *area[GC_PAR_QUEUE_LEN];
     #endif
-    // free unmarked heads and their tails
-    int free_tail = 0;
-    for (size_t block = 0; block < MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB; block++) {
-        switch (ATB_GET_KIND(block)) {
-            case AT_HEAD:
-#if MICROPY_ENABLE_FINALISER
-                if (FTB_GET(block)) {
-                    mp_obj_base_t *obj = (mp_obj_base_t*)PTR_FROM_BLOCK(block);
-                    if (obj->type != NULL) {
-                        // if the object has a type then see if it has a __del__ method
-                        mp_obj_t dest[2];
-                        mp_load_method_maybe(MP_OBJ_FROM_PTR(obj), MP_QSTR___del__, dest);
-                        if (dest[0] != MP_OBJ_NULL) {
-                            // load_method returned a method, execute it in a protected environment
-                            #if MICROPY_ENABLE_SCHEDULER
-                            mp_sched_lock();
-                            #endif
-                            mp_call_function_1_protected(dest[0], dest[1]);
-                            #if MICROPY_ENABLE_SCHEDULER
-                            mp_sched_unlock();
-                            #endif
-                        }
+    size_t block[GC_PAR_QUEUE_LEN];
+    volatile size_t head; // only written by the producer
+    volatile size_t tail; // only written by the consumer
+} gc_par_queue_t;
+
+typedef struct _gc_par_worker_t {
+    MICROPY_GC_STACK_ENTRY_TYPE *stack;
+    #if MICROPY_GC_SPLIT_HEAP
+    mp_state_mem_area_t **area_stack;
+    #endif
+    size_t sp;
+    // blocks of our chunks found by the other worker
+    gc_par_queue_t in;
+    volatile bool idle;
+    // bumped each time the worker leaves idle, see gc_par_finished()
+    volatile uint32_t epoch;
+} gc_par_worker_t;
+
+STATIC MICROPY_GC_STACK_ENTRY_TYPE gc_par_helper_stack[MICROPY_ALLOC_GC_STACK_SIZE];
+#if MICROPY_GC_SPLIT_HEAP
+STATIC mp_state_mem_area_t *gc_par_helper_area_stack[MICROPY_ALLOC_GC_STACK_SIZE];
+#endif
+STATIC gc_par_worker_t gc_par_workers[2];
+STATIC volatile bool gc_par_active;
+// set once the collector has traced all the roots
+STATIC volatile bool gc_par_roots_done;
+// set by the helper when it leaves gc_helper_mark()
+STATIC volatile bool gc_par_helper_done;
+
+STATIC void gc_par_begin(void) {
+    for (int id = 0; id < 2; id++) {
+        gc_par_worker_t *w = &gc_par_workers[id];
+        w->sp = 0;
+        w->in.head = 0;
+        w->in.tail = 0;
+        // the collector is busy with the roots, the helper has nothing to do yet
+        w->idle = id == 1;
+        w->epoch = 0;
+    }
+    gc_par_workers[0].stack = MP_STATE_MEM(gc_stack);
+    gc_par_workers[1].stack = gc_par_helper_stack;
+    #if MICROPY_GC_SPLIT_HEAP
+    gc_par_workers[0].area_stack = MP_STATE_MEM(gc_area_stack);
+    gc_par_workers[1].area_stack = gc_par_helper_area_stack;
+    #endif
+    gc_par_roots_done = false;
+    gc_par_helper_done = false;
+    GC_PAR_BARRIER();
+    gc_par_active = gc_helper_start();
+}
+
+// Mark an unmarked head owned by the given worker and push it on its stack
+STATIC void gc_par_mark_own(gc_par_worker_t *w, mp_state_mem_area_t *area, size_t block) {
+    if (ATB_GET_KIND(area, block) == AT_HEAD) {
+        TRACE_MARK(block, (void*)PTR_FROM_BLOCK(area, block));
+        ATB_HEAD_TO_MARK(area, block);
+        if (w->sp < MICROPY_ALLOC_GC_STACK_SIZE) {
+            #if MICROPY_GC_SPLIT_HEAP
+            w->area_stack[w->sp] = area;
+            #endif
+            w->stack[w->sp++] = block;
+        } else {
+            MP_STATE_MEM(gc_stack_overflow) = 1;
+        }
+    }
+}
+
+// Deal with a pointer to the given head found by the given worker
+STATIC void gc_par_visit(int id, mp_state_mem_area_t *area, size_t block) {
+    if (GC_PAR_OWNER(block) == id) {
+        gc_par_mark_own(&gc_par_workers[id], area, block);
+        return;
+    }
+    gc_par_queue_t *q = &gc_par_workers[id ^ 1].in;
+    size_t head = q->head;
+    if (head - q->tail < GC_PAR_QUEUE_LEN) {
+        #if MICROPY_GC_SPLIT_HEAP
+        q->area[head & (GC_PAR_QUEUE_LEN - 1)] = area;
+        #endif
+        q->block[head & (GC_PAR_QUEUE_LEN - 1)] = block;
+        GC_PAR_BARRIER();
+        q->head = head + 1;
+    } else {
+        // The owner is falling behind.  The block containing the pointer is
+        // marked, so the rescan done for an overflowed stack will find it.
+        MP_STATE_MEM(gc_stack_overflow) = 1;
+    }
+}
+
+// Check the children of a marked block, as gc_mark_subtree() does
+STATIC void gc_par_scan(int id, mp_state_mem_area_t *area, size_t block) {
+    size_t n_blocks = 0;
+    do {
+        n_blocks += 1;
+    } while (ATB_GET_KIND(area, block + n_blocks) == AT_TAIL);
+
+    void **ptrs = (void**)PTR_FROM_BLOCK(area, block);
+    for (size_t i = n_blocks * BYTES_PER_BLOCK / sizeof(void*); i > 0; i--, ptrs++) {
+        void *ptr = *ptrs;
+        mp_state_mem_area_t *ptr_area = gc_get_ptr_area(ptr);
+        if (ptr_area != NULL) {
+            size_t childblock = BLOCK_FROM_PTR(ptr_area, ptr);
+            // the other worker may be marking this entry, the owner checks it again
+            if (ATB_GET_KIND(ptr_area, childblock) == AT_HEAD) {
+                gc_par_visit(id, ptr_area, childblock);
+            }
+        }
+    }
+}
+
+// Mark until the stack and the incoming queue of the worker are both empty
+STATIC void gc_par_work(int id) {
+    gc_par_worker_t *w = &gc_par_workers[id];
+    gc_par_queue_t *q = &w->in;
+    for (;;) {
+        if (w->sp > 0) {
+            w->sp--;
+            #if MICROPY_GC_SPLIT_HEAP
+            gc_par_scan(id, w->area_stack[w->sp], w->stack[w->sp]);
+            #else
+            gc_par_scan(id, &MP_STATE_MEM(area), w->stack[w->sp]);
+            #endif
+            continue;
+        }
+        size_t tail = q->tail;
+        if (tail == q->head) {
+            return;
+        }
+        if (w->idle) {
+            w->idle = false;
+            w->epoch++;
+        }
+        GC_PAR_BARRIER();
+        #if MICROPY_GC_SPLIT_HEAP
+        mp_state_mem_area_t *area = q->area[tail & (GC_PAR_QUEUE_LEN - 1)];
+        #else
+        mp_state_mem_area_t *area = &MP_STATE_MEM(area);
+        #endif
+        size_t block = q->block[tail & (GC_PAR_QUEUE_LEN - 1)];
+        GC_PAR_BARRIER();
+        q->tail = tail + 1;
+        gc_par_mark_own(w, area, block);
+    }
+}
+
+// Called by an idle worker, returns true once marking is over for both.  The
+// other worker can only get more work from us, so the mark is complete when
+// it is idle, both queues are empty and it didn't wake up in the meantime.
+STATIC bool gc_par_finished(int id) {
+    gc_par_worker_t *other = &gc_par_workers[id ^ 1];
+    gc_par_workers[id].idle = true;
+    GC_PAR_BARRIER();
+    if (!gc_par_roots_done) {
+        return false;
+    }
+    uint32_t epoch = other->epoch;
+    GC_PAR_BARRIER();
+    if (!other->idle) {
+        return false;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (gc_par_workers[i].in.head != gc_par_workers[i].in.tail) {
+            return false;
+        }
+    }
+    GC_PAR_BARRIER();
+    return other->idle && other->epoch == epoch;
+}
+
+STATIC void gc_par_mark(int id) {
+    do {
+        gc_par_work(id);
+    } while (!gc_par_finished(id));
+}
+
+void gc_helper_mark(void) {
+    if (!gc_par_active) {
+        return;
+    }
+    gc_par_mark(1);
+    GC_PAR_BARRIER();
+    gc_par_helper_done = true;
+}
+
+// Called by the collector once all the roots are traced
+STATIC void gc_par_end(void) {
+    gc_par_roots_done = true;
+    gc_par_mark(0);
+    while (!gc_par_helper_done) {
+    }
+    gc_par_active = false;
+}
+#endif
+
+#if MICROPY_PY_MICROPYTHON_ALLOC_STATS
+// Totals the free blocks and finds the longest run of them, in bytes.  If
+// hist is given, hist[i] counts the free runs of 2**i up to 2**(i+1)-1 blocks,
+// with the last entry also counting all longer runs.
+STATIC void gc_scan_free_runs(size_t *free, size_t *max_free, size_t *hist, size_t hist_len) {
+    size_t n_free = 0;
+    size_t max_run = 0;
+    for (mp_state_mem_area_t *area = &MP_STATE_MEM(area); area != NULL; area = NEXT_AREA(area)) {
+        size_t run = 0;
+        for (size_t block = 0; block <= AREA_BLOCKS(area); block++) {
+            if (block < AREA_BLOCKS(area) && ATB_GET_KIND(area, block) == AT_FREE) {
+                run++;
+                continue;
+            }
+            if (run > 0) {
+                n_free += run;
+                if (run > max_run) {
+                    max_run = run;
+                }
+                if (hist != NULL) {
+                    size_t i = 0;
+                    while (i + 1 < hist_len && (run >> (i + 1)) != 0) {
+                        i++;
                     }
-                    // clear finaliser flag
-                    FTB_CLEAR(block);
+                    hist[i]++;
                 }
+                run = 0;
+            }
+        }
+    }
+    *free = n_free * BYTES_PER_BLOCK;
+    *max_free = max_run * BYTES_PER_BLOCK;
+}
 #endif
-                free_tail = 1;
-                DEBUG_printf("gc_sweep(%p)\n", PTR_FROM_BLOCK(block));
-                #if MICROPY_PY_GC_COLLECT_RETVAL
-                MP_STATE_MEM(gc_collected)++;
-                #endif
-                // fall through to free the head
 
-            case AT_TAIL:
-                if (free_tail) {
-                    ATB_ANY_TO_FREE(block);
-                    #if CLEAR_ON_SWEEP
-                    memset((void*)PTR_FROM_BLOCK(block), 0, BYTES_PER_BLOCK);
-                    #endif
-                }
+// With MICROPY_GC_LAZY_SWEEP the sweep carries on from where the previous
+// slice stopped and returns once budget_us has elapsed, a zero budget sweeps
+// to the end of the heap.  Must be called with the GC locked.
+STATIC void gc_sweep(size_t budget_us) {
+    #if MICROPY_GC_LAZY_SWEEP
+    mp_uint_t start_us = mp_hal_ticks_us();
+    #else
+    (void)budget_us;
+    #endif
+    for (mp_state_mem_area_t *area = &MP_STATE_MEM(area); area != NULL; area = NEXT_AREA(area)) {
+        // free unmarked heads and their tails
+        #if MICROPY_GC_LAZY_SWEEP
+        size_t block = area->gc_sweep_block;
+        int free_tail = area->gc_sweep_free_tail;
+        size_t first_freed = SIZE_MAX;
+        #else
+        size_t block = 0;
+        int free_tail = 0;
+        #endif
+        #if MICROPY_GC_FREE_LISTS
+        // the run of free blocks, old and newly freed, ending at block
+        size_t run_len = 0;
+        #endif
+        for (; block < AREA_BLOCKS(area); block++) {
+            #if MICROPY_GC_LAZY_SWEEP
+            if (budget_us && (block % GC_SWEEP_SLICE_BLOCKS) == 0
+                && (size_t)(mp_hal_ticks_us() - start_us) >= budget_us) {
                 break;
+            }
+            #endif
+            switch (ATB_GET_KIND(area, block)) {
+                case AT_FREE:
+                    // a run of tails never spans a free block
+                    free_tail = 0;
+                    #if MICROPY_GC_FREE_LISTS
+                    run_len++;
+                    #endif
+                    break;
 
-            case AT_MARK:
-                ATB_MARK_TO_HEAD(block);
-                free_tail = 0;
-                break;
+                case AT_HEAD:
+#if MICROPY_ENABLE_FINALISER
+                    if (FTB_GET(area, block)) {
+                        mp_obj_base_t *obj = (mp_obj_base_t*)PTR_FROM_BLOCK(area, block);
+                        if (obj->type != NULL) {
+                            // if the object has a type then see if it has a __del__ method
+                            mp_obj_t dest[2];
+                            mp_load_method_maybe(MP_OBJ_FROM_PTR(obj), MP_QSTR___del__, dest);
+                            if (dest[0] != MP_OBJ_NULL) {
+                                // load_method returned a method, execute it in a protected environment
+                                #if MICROPY_ENABLE_SCHEDULER
+                                mp_sched_lock();
+                                #endif
+                                mp_call_function_1_protected(dest[0], dest[1]);
+                                #if MICROPY_ENABLE_SCHEDULER
+                                mp_sched_unlock();
+                                #endif
+                            }
+                        }
+                        // clear finaliser flag
+                        FTB_CLEAR(area, block);
+                    }
+#endif
+                    free_tail = 1;
+                    DEBUG_printf("gc_sweep(%p)\n", PTR_FROM_BLOCK(area, block));
+                    #if MICROPY_PY_GC_COLLECT_RETVAL
+                    MP_STATE_MEM(gc_collected)++;
+                    #endif
+                    // fall through to free the head
+
+                case AT_TAIL:
+                    if (free_tail) {
+                        ATB_ANY_TO_FREE(area, block);
+                        #if CLEAR_ON_SWEEP
+                        memset((void*)PTR_FROM_BLOCK(area, block), 0, BYTES_PER_BLOCK);
+                        #endif
+                        #if MICROPY_GC_LAZY_SWEEP
+                        if (first_freed == SIZE_MAX) {
+                            first_freed = block;
+                        }
+                        #endif
+                        #if MICROPY_GC_FREE_LISTS
+                        run_len++;
+                        #endif
+                    }
+                    break;
+
+                case AT_MARK:
+                    ATB_MARK_TO_HEAD(area, block);
+                    free_tail = 0;
+                    #if MICROPY_GC_FREE_LISTS
+                    // a live object ends the free run, live tails only ever follow it
+                    if (run_len > 0) {
+                        gc_free_list_add_run(area, block - run_len, run_len);
+                        run_len = 0;
+                    }
+                    #endif
+                    break;
+            }
         }
+        #if MICROPY_GC_FREE_LISTS
+        if (run_len > 0) {
+            gc_free_list_add_run(area, block - run_len, run_len);
+        }
+        #endif
+        #if MICROPY_GC_LAZY_SWEEP
+        area->gc_sweep_block = block;
+        area->gc_sweep_free_tail = free_tail;
+        // allocations may have moved the next scan past what was just freed
+        if (first_freed / BLOCKS_PER_ATB < area->gc_last_free_atb_index) {
+            area->gc_last_free_atb_index = first_freed / BLOCKS_PER_ATB;
+        }
+        if (GC_SWEEP_PENDING(area)) {
+            // out of budget, the following areas wait for the next slice
+            return;
+        }
+        #endif
+    }
+
+    #if MICROPY_PY_MICROPYTHON_ALLOC_STATS
+    if (MP_STATE_MEM(alloc_stats_enabled)) {
+        // the sweep is over, record what the collection left
+        mp_alloc_frag_t *frag = &MP_STATE_MEM(alloc_stats_history)[MP_STATE_MEM(alloc_stats_collections) % MICROPY_ALLOC_STATS_HISTORY];
+        frag->collection = ++MP_STATE_MEM(alloc_stats_collections);
+        gc_scan_free_runs(&frag->free, &frag->max_free, NULL, 0);
     }
+    #endif
+}
+
+#if MICROPY_GC_LAZY_SWEEP
+STATIC bool gc_sweep_pending(void) {
+    for (mp_state_mem_area_t *area = &MP_STATE_MEM(area); area != NULL; area = NEXT_AREA(area)) {
+        if (GC_SWEEP_PENDING(area)) {
+            return true;
+        }
+    }
+    return false;
 }
 
+// Blocks claimed while a sweep is pending must survive it: a head the sweep
+// hasn't reached yet is allocated marked, and a run of blocks covering the
+// sweep position means the run the sweep was freeing ended before it.
+STATIC void gc_sweep_claim(mp_state_mem_area_t *area, size_t start_block, size_t end_block, bool is_head) {
+    if (GC_SWEEP_PENDING(area)) {
+        size_t sweep_block = area->gc_sweep_block;
+        if (is_head && start_block >= sweep_block) {
+            ATB_HEAD_TO_MARK(area, start_block);
+        }
+        if (start_block <= sweep_block && sweep_block <= end_block) {
+            area->gc_sweep_free_tail = false;
+        }
+    }
+}
+
+// Sweeps whatever is left, unless called from within a sweep (ie a finaliser)
+STATIC void gc_sweep_complete(void) {
+    if (MP_STATE_MEM(gc_lock_depth) == 0 && gc_sweep_pending()) {
+        MP_STATE_MEM(gc_lock_depth)++;
+        gc_sweep(0);
+        MP_STATE_MEM(gc_lock_depth)--;
+    }
+}
+
+void gc_sweep_finish(void) {
+    GC_ENTER();
+    gc_sweep_complete();
+    GC_EXIT();
+}
+#endif
+
 void gc_collect_start(void) {
     GC_ENTER();
+    #if MICROPY_GC_THREAD_ALLOC_BUFFER
+    gc_alloc_buf_retire_all();
+    #endif
+    #if MICROPY_GC_LAZY_SWEEP
+    // the marks left from the last collection must be gone before marking again
+    gc_sweep_complete();
+    #endif
     MP_STATE_MEM(gc_lock_depth)++;
     #if MICROPY_GC_ALLOC_THRESHOLD
     MP_STATE_MEM(gc_alloc_amount) = 0;
     #endif
     MP_STATE_MEM(gc_stack_overflow) = 0;
+    #if MICROPY_GC_PARALLEL_MARK
+    gc_par_begin();
+    #endif
 
     // Trace root pointers.  This relies on the root pointers being organised
     // correctly in the mp_state_ctx structure.  We scan nlr_top, dict_locals,
@@ -343,97 +1066,195 @@ void gc_collect_start(void) {
 void gc_collect_root(void **ptrs, size_t len) {
     for (size_t i = 0; i < len; i++) {
         void *ptr = ptrs[i];
-        if (VERIFY_PTR(ptr)) {
-            size_t block = BLOCK_FROM_PTR(ptr);
-            if (ATB_GET_KIND(block) == AT_HEAD) {
+        mp_state_mem_area_t *area = gc_get_ptr_area(ptr);
+        if (area != NULL) {
+            size_t block = BLOCK_FROM_PTR(area, ptr);
+            if (ATB_GET_KIND(area, block) == AT_HEAD) {
+                #if MICROPY_GC_PARALLEL_MARK
+                if (gc_par_active) {
+                    // mark what we can reach from it, keeping our stack short
+                    gc_par_visit(0, area, block);
+                    gc_par_work(0);
+                    continue;
+                }
+                #endif
                 // An unmarked head: mark it, and mark all its children
                 TRACE_MARK(block, ptr);
-                ATB_HEAD_TO_MARK(block);
-                gc_mark_subtree(block);
+                ATB_HEAD_TO_MARK(area, block);
+                gc_mark_subtree(area, block);
             }
         }
     }
 }
 
 void gc_collect_end(void) {
+    #if MICROPY_GC_PARALLEL_MARK
+    if (gc_par_active) {
+        gc_par_end();
+    }
+    #endif
     gc_deal_with_stack_overflow();
-    gc_sweep();
-    MP_STATE_MEM(gc_last_free_atb_index) = 0;
+    #if MICROPY_PY_GC_COLLECT_RETVAL
+    MP_STATE_MEM(gc_collected) = 0;
+    #endif
+    #if MICROPY_GC_FREE_LISTS
+    // the sweep rebuilds the free lists
+    for (mp_state_mem_area_t *area = &MP_STATE_MEM(area); area != NULL; area = NEXT_AREA(area)) {
+        gc_free_list_clear(area);
+    }
+    #endif
+    #if MICROPY_GC_LAZY_SWEEP
+    // sweep the first slice now, the rest is done by the next allocations
+    for (mp_state_mem_area_t *area = &MP_STATE_MEM(area); area != NULL; area = NEXT_AREA(area)) {
+        area->gc_sweep_block = 0;
+        area->gc_sweep_free_tail = false;
+    }
+    gc_sweep(MP_STATE_MEM(gc_sweep_budget_us));
+    #else
+    gc_sweep(0);
+    #endif
+    for (mp_state_mem_area_t *area = &MP_STATE_MEM(area); area != NULL; area = NEXT_AREA(area)) {
+        area->gc_last_free_atb_index = 0;
+    }
     MP_STATE_MEM(gc_lock_depth)--;
     GC_EXIT();
 }
 
 void gc_sweep_all(void) {
     GC_ENTER();
+    #if MICROPY_GC_THREAD_ALLOC_BUFFER
+    gc_alloc_buf_retire_all();
+    #endif
+    #if MICROPY_GC_LAZY_SWEEP
+    gc_sweep_complete();
+    #endif
     MP_STATE_MEM(gc_lock_depth)++;
     MP_STATE_MEM(gc_stack_overflow) = 0;
     gc_collect_end();
+    #if MICROPY_GC_LAZY_SWEEP
+    gc_sweep_finish();
+    #endif
 }
 
 void gc_info(gc_info_t *info) {
     GC_ENTER();
-    info->total = MP_STATE_MEM(gc_pool_end) - MP_STATE_MEM(gc_pool_start);
+    #if MICROPY_GC_LAZY_SWEEP
+    // unswept garbage would be reported as used
+    gc_sweep_complete();
+    #endif
+    info->total = 0;
     info->used = 0;
     info->free = 0;
     info->max_free = 0;
     info->num_1block = 0;
     info->num_2block = 0;
     info->max_block = 0;
-    bool finish = false;
-    for (size_t block = 0, len = 0, len_free = 0; !finish;) {
-        size_t kind = ATB_GET_KIND(block);
-        switch (kind) {
-            case AT_FREE:
-                info->free += 1;
-                len_free += 1;
-                len = 0;
-                break;
-
-            case AT_HEAD:
-                info->used += 1;
-                len = 1;
-                break;
-
-            case AT_TAIL:
-                info->used += 1;
-                len += 1;
-                break;
-
-            case AT_MARK:
-                // shouldn't happen
-                break;
-        }
-
-        block++;
-        finish = (block == MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB);
-        // Get next block type if possible
-        if (!finish) {
-            kind = ATB_GET_KIND(block);
-        }
-
-        if (finish || kind == AT_FREE || kind == AT_HEAD) {
-            if (len == 1) {
-                info->num_1block += 1;
-            } else if (len == 2) {
-                info->num_2block += 1;
+    for (mp_state_mem_area_t *area = &MP_STATE_MEM(area); area != NULL; area = NEXT_AREA(area)) {
+        info->total += area->gc_pool_end - area->gc_pool_start;
+        bool finish = false;
+        for (size_t block = 0, len = 0, len_free = 0; !finish;) {
+            size_t kind = ATB_GET_KIND(area, block);
+            switch (kind) {
+                case AT_FREE:
+                    info->free += 1;
+                    len_free += 1;
+                    len = 0;
+                    break;
+
+                case AT_HEAD:
+                    info->used += 1;
+                    len = 1;
+                    break;
+
+                case AT_TAIL:
+                    info->used += 1;
+                    len += 1;
+                    break;
+
+                case AT_MARK:
+                    // shouldn't happen
+                    break;
             }
-            if (len > info->max_block) {
-                info->max_block = len;
+
+            block++;
+            finish = (block == AREA_BLOCKS(area));
+            // Get next block type if possible
+            if (!finish) {
+                kind = ATB_GET_KIND(area, block);
             }
-            if (finish || kind == AT_HEAD) {
-                if (len_free > info->max_free) {
-                    info->max_free = len_free;
+
+            if (finish || kind == AT_FREE || kind == AT_HEAD) {
+                if (len == 1) {
+                    info->num_1block += 1;
+                } else if (len == 2) {
+                    info->num_2block += 1;
+                }
+                if (len > info->max_block) {
+                    info->max_block = len;
+                }
+                if (finish || kind == AT_HEAD) {
+                    if (len_free > info->max_free) {
+                        info->max_free = len_free;
+                    }
+                    len_free = 0;
                 }
-                len_free = 0;
             }
         }
     }
 
     info->used *= BYTES_PER_BLOCK;
     info->free *= BYTES_PER_BLOCK;
+    #if MICROPY_GC_FREE_LISTS
+    info->free_list_hits = MP_STATE_MEM(gc_free_list_hits);
+    info->free_list_misses = MP_STATE_MEM(gc_free_list_misses);
+    #endif
     GC_EXIT();
 }
 
+#if MICROPY_PY_MICROPYTHON_ALLOC_STATS
+void gc_free_histogram(size_t *hist, size_t hist_len) {
+    GC_ENTER();
+    #if MICROPY_GC_LAZY_SWEEP
+    gc_sweep_complete();
+    #endif
+    memset(hist, 0, hist_len * sizeof(size_t));
+    size_t free, max_free;
+    gc_scan_free_runs(&free, &max_free, hist, hist_len);
+    GC_EXIT();
+}
+#endif
+
+// The order in which gc_alloc searches the areas.  The first area is the fast
+// one: small allocations start there, large ones leave it until last.
+STATIC mp_state_mem_area_t *gc_alloc_first_area(bool fast) {
+    mp_state_mem_area_t *first = &MP_STATE_MEM(area);
+    #if MICROPY_GC_SPLIT_HEAP
+    if (!fast && first->next != NULL) {
+        return first->next;
+    }
+    #else
+    (void)fast;
+    #endif
+    return first;
+}
+
+STATIC mp_state_mem_area_t *gc_alloc_next_area(mp_state_mem_area_t *area, bool fast) {
+    #if MICROPY_GC_SPLIT_HEAP
+    if (fast) {
+        return area->next;
+    }
+    if (area == &MP_STATE_MEM(area)) {
+        // the fast area was the last resort
+        return NULL;
+    }
+    return area->next != NULL ? area->next : &MP_STATE_MEM(area);
+    #else
+    (void)area;
+    (void)fast;
+    return NULL;
+    #endif
+}
+
 void *gc_alloc(size_t n_bytes, unsigned int alloc_flags) {
     bool has_finaliser = alloc_flags & GC_ALLOC_FLAG_HAS_FINALISER;
     size_t n_blocks = ((n_bytes + BYTES_PER_BLOCK - 1) & (~(BYTES_PER_BLOCK - 1))) / BYTES_PER_BLOCK;
@@ -444,6 +1265,16 @@ void *gc_alloc(size_t n_bytes, unsigned int alloc_flags) {
         return NULL;
     }
 
+    #if MICROPY_GC_THREAD_ALLOC_BUFFER
+    size_t n_wanted = n_blocks;
+    if (n_blocks <= GC_ALLOC_BUF_MAX_BLOCKS) {
+        void *ptr = gc_alloc_buf_take(n_blocks, has_finaliser);
+        if (ptr != NULL) {
+            return ptr;
+        }
+    }
+    #endif
+
     GC_ENTER();
 
     // check if GC is locked
@@ -452,11 +1283,26 @@ void *gc_alloc(size_t n_bytes, unsigned int alloc_flags) {
         return NULL;
     }
 
+    mp_state_mem_area_t *area;
     size_t i;
     size_t end_block;
     size_t start_block;
     size_t n_free;
     int collected = !MP_STATE_MEM(gc_auto_collect_enabled);
+    #if MICROPY_GC_SPLIT_HEAP
+    bool fast = n_bytes <= MICROPY_GC_SPLIT_HEAP_SMALL_BYTES || (alloc_flags & GC_ALLOC_FLAG_FAST);
+    #else
+    bool fast = true;
+    #endif
+
+    #if MICROPY_GC_LAZY_SWEEP
+    if (gc_sweep_pending()) {
+        // advance the sweep left pending by the last collection
+        MP_STATE_MEM(gc_lock_depth)++;
+        gc_sweep(MP_STATE_MEM(gc_sweep_budget_us));
+        MP_STATE_MEM(gc_lock_depth)--;
+    }
+    #endif
 
     #if MICROPY_GC_ALLOC_THRESHOLD
     if (!collected && MP_STATE_MEM(gc_alloc_amount) >= MP_STATE_MEM(gc_alloc_threshold)) {
@@ -467,17 +1313,56 @@ void *gc_alloc(size_t n_bytes, unsigned int alloc_flags) {
     }
     #endif
 
+    #if MICROPY_GC_THREAD_ALLOC_BUFFER
+    if (n_blocks <= GC_ALLOC_BUF_MAX_BLOCKS && mp_thread_get_state()->gc_alloc_buf_area == NULL
+        #if MICROPY_GC_LAZY_SWEEP
+        && !gc_sweep_pending()
+        #endif
+        #if MICROPY_PY_MICROPYTHON_ALLOC_STATS
+        && !MP_STATE_MEM(alloc_stats_enabled)
+        #endif
+        ) {
+        // claim a new buffer for this thread along with the chunk
+        n_blocks += MICROPY_GC_THREAD_ALLOC_BUFFER_BLOCKS;
+    }
+    #endif
+
     for (;;) {
 
         // look for a run of n_blocks available blocks
-        n_free = 0;
-        for (i = MP_STATE_MEM(gc_last_free_atb_index); i < MP_STATE_MEM(gc_alloc_table_byte_len); i++) {
-            byte a = MP_STATE_MEM(gc_alloc_table_start)[i];
-            if (ATB_0_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 0; goto found; } } else { n_free = 0; }
-            if (ATB_1_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 1; goto found; } } else { n_free = 0; }
-            if (ATB_2_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 2; goto found; } } else { n_free = 0; }
-            if (ATB_3_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 3; goto found; } } else { n_free = 0; }
+        for (area = gc_alloc_first_area(fast); area != NULL; area = gc_alloc_next_area(area, fast)) {
+            #if MICROPY_GC_FREE_LISTS
+            if (n_blocks <= GC_FREE_LIST_MAX_BLOCKS && gc_free_list_take(area, n_blocks, &start_block)) {
+                MP_STATE_MEM(gc_free_list_hits)++;
+                end_block = start_block + n_blocks - 1;
+                goto claim;
+            }
+            #endif
+            n_free = 0;
+            for (i = area->gc_last_free_atb_index; i < area->gc_alloc_table_byte_len; i++) {
+                byte a = area->gc_alloc_table_start[i];
+                if (ATB_0_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 0; goto found; } } else { n_free = 0; }
+                if (ATB_1_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 1; goto found; } } else { n_free = 0; }
+                if (ATB_2_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 2; goto found; } } else { n_free = 0; }
+                if (ATB_3_IS_FREE(a)) { if (++n_free >= n_blocks) { i = i * BLOCKS_PER_ATB + 3; goto found; } } else { n_free = 0; }
+            }
+        }
+
+        #if MICROPY_GC_THREAD_ALLOC_BUFFER
+        if (n_blocks != n_wanted) {
+            // no room for a buffer, try again with just the chunk
+            n_blocks = n_wanted;
+            continue;
         }
+        #endif
+
+        #if MICROPY_GC_LAZY_SWEEP
+        if (gc_sweep_pending()) {
+            // the unswept part of the heap might have what we need
+            gc_sweep_complete();
+            continue;
+        }
+        #endif
 
         GC_EXIT();
         // nothing found!
@@ -502,27 +1387,53 @@ found:
     // before this one.  Also, whenever we free or shink a block we must check
     // if this index needs adjusting (see gc_realloc and gc_free).
     if (n_free == 1) {
-        MP_STATE_MEM(gc_last_free_atb_index) = (i + 1) / BLOCKS_PER_ATB;
+        area->gc_last_free_atb_index = (i + 1) / BLOCKS_PER_ATB;
+    }
+
+    #if MICROPY_GC_FREE_LISTS
+    if (n_blocks <= GC_FREE_LIST_MAX_BLOCKS) {
+        MP_STATE_MEM(gc_free_list_misses)++;
     }
 
+    // a run taken from a free list joins here, it leaves the scan index alone
+claim:
+    #endif
+
     // mark first block as used head
-    ATB_FREE_TO_HEAD(start_block);
+    ATB_FREE_TO_HEAD(area, start_block);
 
     // mark rest of blocks as used tail
     // TODO for a run of many blocks can make this more efficient
     for (size_t bl = start_block + 1; bl <= end_block; bl++) {
-        ATB_FREE_TO_TAIL(bl);
+        ATB_FREE_TO_TAIL(area, bl);
     }
 
+    #if MICROPY_GC_LAZY_SWEEP
+    gc_sweep_claim(area, start_block, end_block, true);
+    #endif
+
     // get pointer to first block
     // we must create this pointer before unlocking the GC so a collection can find it
-    void *ret_ptr = (void*)(MP_STATE_MEM(gc_pool_start) + start_block * BYTES_PER_BLOCK);
+    void *ret_ptr = (void*)(area->gc_pool_start + start_block * BYTES_PER_BLOCK);
     DEBUG_printf("gc_alloc(%p)\n", ret_ptr);
 
     #if MICROPY_GC_ALLOC_THRESHOLD
     MP_STATE_MEM(gc_alloc_amount) += n_blocks;
     #endif
 
+    #if MICROPY_PY_MICROPYTHON_ALLOC_STATS
+    if (MP_STATE_MEM(alloc_stats_enabled)) {
+        gc_alloc_stats_record(n_bytes);
+    }
+    #endif
+
+    #if MICROPY_GC_THREAD_ALLOC_BUFFER
+    if (n_blocks != n_wanted) {
+        gc_alloc_buf_setup(area, start_block, end_block, n_wanted);
+        end_block = start_block + n_wanted - 1;
+    }
+    #endif
+
     GC_EXIT();
 
     #if MICROPY_GC_CONSERVATIVE_CLEAR
@@ -543,7 +1454,7 @@ found:
         ((mp_obj_base_t*)ret_ptr)->type = NULL;
         // set mp_obj flag only if it has a finaliser
         GC_ENTER();
-        FTB_SET(start_block);
+        FTB_SET(area, start_block);
         GC_EXIT();
     }
     #else
@@ -583,24 +1494,41 @@ void gc_free(void *ptr) {
         GC_EXIT();
     } else {
         // get the GC block number corresponding to this pointer
-        assert(VERIFY_PTR(ptr));
-        size_t block = BLOCK_FROM_PTR(ptr);
-        assert(ATB_GET_KIND(block) == AT_HEAD);
+        mp_state_mem_area_t *area = gc_get_ptr_area(ptr);
+        assert(area != NULL);
+        size_t block = BLOCK_FROM_PTR(area, ptr);
+        // heads not swept yet are still marked
+        assert(ATB_GET_KIND(area, block) == AT_HEAD || (MICROPY_GC_LAZY_SWEEP && ATB_GET_KIND(area, block) == AT_MARK));
+
+        #if MICROPY_GC_THREAD_ALLOC_BUFFER
+        if (gc_alloc_buf_owns(area, block)) {
+            // left for the next collection
+            GC_EXIT();
+            return;
+        }
+        #endif
 
         #if MICROPY_ENABLE_FINALISER
-        FTB_CLEAR(block);
+        FTB_CLEAR(area, block);
         #endif
 
         // set the last_free pointer to this block if it's earlier in the heap
-        if (block / BLOCKS_PER_ATB < MP_STATE_MEM(gc_last_free_atb_index)) {
-            MP_STATE_MEM(gc_last_free_atb_index) = block / BLOCKS_PER_ATB;
+        if (block / BLOCKS_PER_ATB < area->gc_last_free_atb_index) {
+            area->gc_last_free_atb_index = block / BLOCKS_PER_ATB;
         }
 
         // free head and all of its tail blocks
+        #if MICROPY_GC_FREE_LISTS
+        size_t start_block = block;
+        #endif
         do {
-            ATB_ANY_TO_FREE(block);
+            ATB_ANY_TO_FREE(area, block);
             block += 1;
-        } while (ATB_GET_KIND(block) == AT_TAIL);
+        } while (ATB_GET_KIND(area, block) == AT_TAIL);
+
+        #if MICROPY_GC_FREE_LISTS
+        gc_free_list_add_run(area, start_block, block - start_block);
+        #endif
 
         GC_EXIT();
 
@@ -612,14 +1540,15 @@ void gc_free(void *ptr) {
 
 size_t gc_nbytes(const void *ptr) {
     GC_ENTER();
-    if (VERIFY_PTR(ptr)) {
-        size_t block = BLOCK_FROM_PTR(ptr);
-        if (ATB_GET_KIND(block) == AT_HEAD) {
+    mp_state_mem_area_t *area = gc_get_ptr_area(ptr);
+    if (area != NULL) {
+        size_t block = BLOCK_FROM_PTR(area, ptr);
+        if (ATB_GET_KIND(area, block) == AT_HEAD || (MICROPY_GC_LAZY_SWEEP && ATB_GET_KIND(area, block) == AT_MARK)) {
             // work out number of consecutive blocks in the chain starting with this on
             size_t n_blocks = 0;
             do {
                 n_blocks += 1;
-            } while (ATB_GET_KIND(block + n_blocks) == AT_TAIL);
+            } while (ATB_GET_KIND(area, block + n_blocks) == AT_TAIL);
             GC_EXIT();
             return n_blocks * BYTES_PER_BLOCK;
         }
@@ -681,9 +1610,10 @@ void *gc_realloc(void *ptr_in, size_t n_bytes, bool allow_move) {
     }
 
     // get the GC block number corresponding to this pointer
-    assert(VERIFY_PTR(ptr));
-    size_t block = BLOCK_FROM_PTR(ptr);
-    assert(ATB_GET_KIND(block) == AT_HEAD);
+    mp_state_mem_area_t *area = gc_get_ptr_area(ptr);
+    assert(area != NULL);
+    size_t block = BLOCK_FROM_PTR(area, ptr);
+    assert(ATB_GET_KIND(area, block) == AT_HEAD || (MICROPY_GC_LAZY_SWEEP && ATB_GET_KIND(area, block) == AT_MARK));
 
     // compute number of new blocks that are requested
     size_t new_blocks = (n_bytes + BYTES_PER_BLOCK - 1) / BYTES_PER_BLOCK;
@@ -696,9 +1626,9 @@ void *gc_realloc(void *ptr_in, size_t n_bytes, bool allow_move) {
     // efficiently shrink it (see below for shrinking code).
     size_t n_free   = 0;
     size_t n_blocks = 1; // counting HEAD block
-    size_t max_block = MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB;
+    size_t max_block = AREA_BLOCKS(area);
     for (size_t bl = block + n_blocks; bl < max_block; bl++) {
-        byte block_type = ATB_GET_KIND(bl);
+        byte block_type = ATB_GET_KIND(area, bl);
         if (block_type == AT_TAIL) {
             n_blocks++;
             continue;
@@ -722,15 +1652,25 @@ void *gc_realloc(void *ptr_in, size_t n_bytes, bool allow_move) {
 
     // check if we can shrink the allocated area
     if (new_blocks < n_blocks) {
+        #if MICROPY_GC_THREAD_ALLOC_BUFFER
+        if (gc_alloc_buf_owns(area, block)) {
+            GC_EXIT();
+            return ptr_in;
+        }
+        #endif
+
         // free unneeded tail blocks
         for (size_t bl = block + new_blocks, count = n_blocks - new_blocks; count > 0; bl++, count--) {
-            ATB_ANY_TO_FREE(bl);
+            ATB_ANY_TO_FREE(area, bl);
         }
 
         // set the last_free pointer to end of this block if it's earlier in the heap
-        if ((block + new_blocks) / BLOCKS_PER_ATB < MP_STATE_MEM(gc_last_free_atb_index)) {
-            MP_STATE_MEM(gc_last_free_atb_index) = (block + new_blocks) / BLOCKS_PER_ATB;
+        if ((block + new_blocks) / BLOCKS_PER_ATB < area->gc_last_free_atb_index) {
+            area->gc_last_free_atb_index = (block + new_blocks) / BLOCKS_PER_ATB;
         }
+        #if MICROPY_GC_REALLOC_STATS
+        MP_STATE_MEM(gc_realloc_shrunk)++;
+        #endif
 
         GC_EXIT();
 
@@ -745,9 +1685,15 @@ void *gc_realloc(void *ptr_in, size_t n_bytes, bool allow_move) {
     if (new_blocks <= n_blocks + n_free) {
         // mark few more blocks as used tail
         for (size_t bl = block + n_blocks; bl < block + new_blocks; bl++) {
-            assert(ATB_GET_KIND(bl) == AT_FREE);
-            ATB_FREE_TO_TAIL(bl);
+            assert(ATB_GET_KIND(area, bl) == AT_FREE);
+            ATB_FREE_TO_TAIL(area, bl);
         }
+        #if MICROPY_GC_LAZY_SWEEP
+        gc_sweep_claim(area, block + n_blocks, block + new_blocks - 1, false);
+        #endif
+        #if MICROPY_GC_REALLOC_STATS
+        MP_STATE_MEM(gc_realloc_in_place)++;
+        #endif
 
         GC_EXIT();
 
@@ -767,11 +1713,53 @@ void *gc_realloc(void *ptr_in, size_t n_bytes, bool allow_move) {
     }
 
     #if MICROPY_ENABLE_FINALISER
-    bool ftb_state = FTB_GET(block);
+    bool ftb_state = FTB_GET(area, block);
     #else
     bool ftb_state = false;
     #endif
 
+    // check if we can expand into the free blocks before the chunk, the sweep
+    // must be done with this area for them to be known free
+    if (allow_move && (!MICROPY_GC_LAZY_SWEEP || !GC_SWEEP_PENDING(area))) {
+        size_t n_back = 0;
+        while (n_back < block && n_blocks + n_free + n_back < new_blocks
+            && ATB_GET_KIND(area, block - n_back - 1) == AT_FREE) {
+            n_back++;
+        }
+        if (new_blocks <= n_blocks + n_free + n_back) {
+            size_t new_block = block - n_back;
+            size_t n_after = new_blocks - n_blocks - n_back;
+            ATB_FREE_TO_HEAD(area, new_block);
+            for (size_t bl = new_block + 1; bl < block; bl++) {
+                ATB_FREE_TO_TAIL(area, bl);
+            }
+            ATB_ANY_TO_FREE(area, block);
+            ATB_FREE_TO_TAIL(area, block);
+            for (size_t bl = block + n_blocks; bl < block + n_blocks + n_after; bl++) {
+                ATB_FREE_TO_TAIL(area, bl);
+            }
+            #if MICROPY_ENABLE_FINALISER
+            if (ftb_state) {
+                FTB_CLEAR(area, block);
+                FTB_SET(area, new_block);
+            }
+            #endif
+
+            // the data is moved with the lock held so that a collection in
+            // another thread never sees it half way
+            void *ptr_out = (void*)PTR_FROM_BLOCK(area, new_block);
+            memmove(ptr_out, ptr_in, n_blocks * BYTES_PER_BLOCK);
+            memset((byte*)ptr_out + n_blocks * BYTES_PER_BLOCK, 0, (new_blocks - n_blocks) * BYTES_PER_BLOCK);
+            #if MICROPY_GC_REALLOC_STATS
+            MP_STATE_MEM(gc_realloc_backward)++;
+            #endif
+            GC_EXIT();
+
+            DEBUG_printf("gc_realloc(%p -> %p) backward\n", ptr_in, ptr_out);
+            return ptr_out;
+        }
+    }
+
     GC_EXIT();
 
     if (!allow_move) {
@@ -790,10 +1778,85 @@ void *gc_realloc(void *ptr_in, size_t n_bytes, bool allow_move) {
     DEBUG_printf("gc_realloc(%p -> %p)\n", ptr_in, ptr_out);
     memcpy(ptr_out, ptr_in, n_blocks * BYTES_PER_BLOCK);
     gc_free(ptr_in);
+    #if MICROPY_GC_REALLOC_STATS
+    MP_STATE_MEM(gc_realloc_moved)++;
+    #endif
     return ptr_out;
 }
 #endif // Alternative gc_realloc impl
 
+#if MICROPY_PY_GC_DEFRAG
+void *gc_move_lower(void *ptr) {
+    GC_ENTER();
+    if (MP_STATE_MEM(gc_lock_depth) > 0) {
+        GC_EXIT();
+        return NULL;
+    }
+    #if MICROPY_GC_LAZY_SWEEP
+    // the free blocks are only all known once the sweep is over
+    gc_sweep_complete();
+    #endif
+
+    mp_state_mem_area_t *area = gc_get_ptr_area(ptr);
+    if (area == NULL || ATB_GET_KIND(area, BLOCK_FROM_PTR(area, ptr)) != AT_HEAD) {
+        GC_EXIT();
+        return NULL;
+    }
+    size_t block = BLOCK_FROM_PTR(area, ptr);
+    #if MICROPY_GC_THREAD_ALLOC_BUFFER
+    if (gc_alloc_buf_owns(area, block)) {
+        GC_EXIT();
+        return NULL;
+    }
+    #endif
+    size_t n_blocks = 1;
+    while (ATB_GET_KIND(area, block + n_blocks) == AT_TAIL) {
+        n_blocks++;
+    }
+
+    // the lowest free run that fits, below the chunk
+    size_t n_free = 0;
+    size_t new_block = block;
+    for (size_t bl = area->gc_last_free_atb_index * BLOCKS_PER_ATB; bl < block; bl++) {
+        if (ATB_GET_KIND(area, bl) != AT_FREE) {
+            n_free = 0;
+        } else if (++n_free == n_blocks) {
+            new_block = bl + 1 - n_blocks;
+            break;
+        }
+    }
+    if (new_block == block) {
+        GC_EXIT();
+        return NULL;
+    }
+
+    ATB_FREE_TO_HEAD(area, new_block);
+    for (size_t bl = new_block + 1; bl < new_block + n_blocks; bl++) {
+        ATB_FREE_TO_TAIL(area, bl);
+    }
+    void *ptr_out = (void*)PTR_FROM_BLOCK(area, new_block);
+    memcpy(ptr_out, ptr, n_blocks * BYTES_PER_BLOCK);
+    #if MICROPY_ENABLE_FINALISER
+    if (FTB_GET(area, block)) {
+        FTB_CLEAR(area, block);
+        FTB_SET(area, new_block);
+    }
+    #endif
+    for (size_t bl = block; bl < block + n_blocks; bl++) {
+        ATB_ANY_TO_FREE(area, bl);
+    }
+    #if MICROPY_GC_FREE_LISTS
+    gc_free_list_add_run(area, block, n_blocks);
+    #endif
+    #if MICROPY_GC_REALLOC_STATS
+    MP_STATE_MEM(gc_realloc_defrag)++;
+    #endif
+
+    GC_EXIT();
+    return ptr_out;
+}
+#endif
+
 void gc_dump_info(void) {
     gc_info_t info;
     gc_info(&info);
@@ -806,110 +1869,112 @@ void gc_dump_info(void) {
 void gc_dump_alloc_table(void) {
     GC_ENTER();
     static const size_t DUMP_BYTES_PER_LINE = 64;
-    #if !EXTENSIVE_HEAP_PROFILING
-    // When comparing heap output we don't want to print the starting
-    // pointer of the heap because it changes from run to run.
-    mp_printf(&mp_plat_print, "GC memory layout; from %p:", MP_STATE_MEM(gc_pool_start));
-    #endif
-    for (size_t bl = 0; bl < MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB; bl++) {
-        if (bl % DUMP_BYTES_PER_LINE == 0) {
-            // a new line of blocks
-            {
-                // check if this line contains only free blocks
-                size_t bl2 = bl;
-                while (bl2 < MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB && ATB_GET_KIND(bl2) == AT_FREE) {
-                    bl2++;
-                }
-                if (bl2 - bl >= 2 * DUMP_BYTES_PER_LINE) {
-                    // there are at least 2 lines containing only free blocks, so abbreviate their printing
-                    mp_printf(&mp_plat_print, "\n       (%u lines all free)", (uint)(bl2 - bl) / DUMP_BYTES_PER_LINE);
-                    bl = bl2 & (~(DUMP_BYTES_PER_LINE - 1));
-                    if (bl >= MP_STATE_MEM(gc_alloc_table_byte_len) * BLOCKS_PER_ATB) {
-                        // got to end of heap
-                        break;
-                    }
-                }
-            }
-            // print header for new line of blocks
-            // (the cast to uint32_t is for 16-bit ports)
-            //mp_printf(&mp_plat_print, "\n%05x: ", (uint)(PTR_FROM_BLOCK(bl) & (uint32_t)0xfffff));
-            mp_printf(&mp_plat_print, "\n%05x: ", (uint)((bl * BYTES_PER_BLOCK) & (uint32_t)0xfffff));
-        }
-        int c = ' ';
-        switch (ATB_GET_KIND(bl)) {
-            case AT_FREE: c = '.'; break;
-            /* this prints out if the object is reachable from BSS or STACK (for unix only)
-            case AT_HEAD: {
-                c = 'h';
-                void **ptrs = (void**)(void*)&mp_state_ctx;
-                mp_uint_t len = offsetof(mp_state_ctx_t, vm.stack_top) / sizeof(mp_uint_t);
-                for (mp_uint_t i = 0; i < len; i++) {
-                    mp_uint_t ptr = (mp_uint_t)ptrs[i];
-                    if (VERIFY_PTR(ptr) && BLOCK_FROM_PTR(ptr) == bl) {
-                        c = 'B';
-                        break;
+    for (mp_state_mem_area_t *area = &MP_STATE_MEM(area); area != NULL; area = NEXT_AREA(area)) {
+        #if !EXTENSIVE_HEAP_PROFILING
+        // When comparing heap output we don't want to print the starting
+        // pointer of the heap because it changes from run to run.
+        mp_printf(&mp_plat_print, "GC memory layout; from %p:", area->gc_pool_start);
+        #endif
+        for (size_t bl = 0; bl < AREA_BLOCKS(area); bl++) {
+            if (bl % DUMP_BYTES_PER_LINE == 0) {
+                // a new line of blocks
+                {
+                    // check if this line contains only free blocks
+                    size_t bl2 = bl;
+                    while (bl2 < AREA_BLOCKS(area) && ATB_GET_KIND(area, bl2) == AT_FREE) {
+                        bl2++;
                     }
-                }
-                if (c == 'h') {
-                    ptrs = (void**)&c;
-                    len = ((mp_uint_t)MP_STATE_THREAD(stack_top) - (mp_uint_t)&c) / sizeof(mp_uint_t);
-                    for (mp_uint_t i = 0; i < len; i++) {
-                        mp_uint_t ptr = (mp_uint_t)ptrs[i];
-                        if (VERIFY_PTR(ptr) && BLOCK_FROM_PTR(ptr) == bl) {
-                            c = 'S';
+                    if (bl2 - bl >= 2 * DUMP_BYTES_PER_LINE) {
+                        // there are at least 2 lines containing only free blocks, so abbreviate their printing
+                        mp_printf(&mp_plat_print, "\n       (%u lines all free)", (uint)(bl2 - bl) / DUMP_BYTES_PER_LINE);
+                        bl = bl2 & (~(DUMP_BYTES_PER_LINE - 1));
+                        if (bl >= AREA_BLOCKS(area)) {
+                            // got to end of heap
                             break;
                         }
                     }
                 }
-                break;
+                // print header for new line of blocks
+                // (the cast to uint32_t is for 16-bit ports)
+                //mp_printf(&mp_plat_print, "\n%05x: ", (uint)(PTR_FROM_BLOCK(bl) & (uint32_t)0xfffff));
+                mp_printf(&mp_plat_print, "\n%05x: ", (uint)((bl * BYTES_PER_BLOCK) & (uint32_t)0xfffff));
             }
-            */
-            /* this prints the uPy object type of the head block */
-            case AT_HEAD: {
-                void **ptr = (void**)(MP_STATE_MEM(gc_pool_start) + bl * BYTES_PER_BLOCK);
-                if (*ptr == &mp_type_tuple) { c = 'T'; }
-                else if (*ptr == &mp_type_list) { c = 'L'; }
-                else if (*ptr == &mp_type_dict) { c = 'D'; }
-                else if (*ptr == &mp_type_str || *ptr == &mp_type_bytes) { c = 'S'; }
-                #if MICROPY_PY_BUILTINS_BYTEARRAY
-                else if (*ptr == &mp_type_bytearray) { c = 'A'; }
-                #endif
-                #if MICROPY_PY_ARRAY
-                else if (*ptr == &mp_type_array) { c = 'A'; }
-                #endif
-                #if MICROPY_PY_BUILTINS_FLOAT
-                else if (*ptr == &mp_type_float) { c = 'F'; }
-                #endif
-                else if (*ptr == &mp_type_fun_bc) { c = 'B'; }
-                else if (*ptr == &mp_type_module) { c = 'M'; }
-                else {
+            int c = ' ';
+            switch (ATB_GET_KIND(area, bl)) {
+                case AT_FREE: c = '.'; break;
+                /* this prints out if the object is reachable from BSS or STACK (for unix only)
+                case AT_HEAD: {
                     c = 'h';
-                    #if 0
-                    // This code prints "Q" for qstr-pool data, and "q" for qstr-str
-                    // data.  It can be useful to see how qstrs are being allocated,
-                    // but is disabled by default because it is very slow.
-                    for (qstr_pool_t *pool = MP_STATE_VM(last_pool); c == 'h' && pool != NULL; pool = pool->prev) {
-                        if ((qstr_pool_t*)ptr == pool) {
-                            c = 'Q';
+                    void **ptrs = (void**)(void*)&mp_state_ctx;
+                    mp_uint_t len = offsetof(mp_state_ctx_t, vm.stack_top) / sizeof(mp_uint_t);
+                    for (mp_uint_t i = 0; i < len; i++) {
+                        mp_uint_t ptr = (mp_uint_t)ptrs[i];
+                        if (gc_get_ptr_area((void*)ptr) == area && BLOCK_FROM_PTR(area, ptr) == bl) {
+                            c = 'B';
                             break;
                         }
-                        for (const byte **q = pool->qstrs, **q_top = pool->qstrs + pool->len; q < q_top; q++) {
-                            if ((const byte*)ptr == *q) {
-                                c = 'q';
+                    }
+                    if (c == 'h') {
+                        ptrs = (void**)&c;
+                        len = ((mp_uint_t)MP_STATE_THREAD(stack_top) - (mp_uint_t)&c) / sizeof(mp_uint_t);
+                        for (mp_uint_t i = 0; i < len; i++) {
+                            mp_uint_t ptr = (mp_uint_t)ptrs[i];
+                            if (gc_get_ptr_area((void*)ptr) == area && BLOCK_FROM_PTR(area, ptr) == bl) {
+                                c = 'S';
                                 break;
                             }
                         }
                     }
+                    break;
+                }
+                */
+                /* this prints the uPy object type of the head block */
+                case AT_HEAD: {
+                    void **ptr = (void**)(area->gc_pool_start + bl * BYTES_PER_BLOCK);
+                    if (*ptr == &mp_type_tuple) { c = 'T'; }
+                    else if (*ptr == &mp_type_list) { c = 'L'; }
+                    else if (*ptr == &mp_type_dict) { c = 'D'; }
+                    else if (*ptr == &mp_type_str || *ptr == &mp_type_bytes) { c = 'S'; }
+                    #if MICROPY_PY_BUILTINS_BYTEARRAY
+                    else if (*ptr == &mp_type_bytearray) { c = 'A'; }
+                    #endif
+                    #if MICROPY_PY_ARRAY
+                    else if (*ptr == &mp_type_array) { c = 'A'; }
+                    #endif
+                    #if MICROPY_PY_BUILTINS_FLOAT
+                    else if (*ptr == &mp_type_float) { c = 'F'; }
                     #endif
+                    else if (*ptr == &mp_type_fun_bc) { c = 'B'; }
+                    else if (*ptr == &mp_type_module) { c = 'M'; }
+                    else {
+                        c = 'h';
+                        #if 0
+                        // This code prints "Q" for qstr-pool data, and "q" for qstr-str
+                        // data.  It can be useful to see how qstrs are being allocated,
+                        // but is disabled by default because it is very slow.
+                        for (qstr_pool_t *pool = MP_STATE_VM(last_pool); c == 'h' && pool != NULL; pool = pool->prev) {
+                            if ((qstr_pool_t*)ptr == pool) {
+                                c = 'Q';
+                                break;
+                            }
+                            for (const byte **q = pool->qstrs, **q_top = pool->qstrs + pool->len; q < q_top; q++) {
+                                if ((const byte*)ptr == *q) {
+                                    c = 'q';
+                                    break;
+                                }
+                            }
+                        }
+                        #endif
+                    }
+                    break;
                 }
-                break;
+                case AT_TAIL: c = '='; break;
+                case AT_MARK: c = 'm'; break;
             }
-            case AT_TAIL: c = '='; break;
-            case AT_MARK: c = 'm'; break;
+            mp_printf(&mp_plat_print, "%c", c);
         }
-        mp_printf(&mp_plat_print, "%c", c);
+        mp_print_str(&mp_plat_print, "\n");
     }
-    mp_print_str(&mp_plat_print, "\n");
     GC_EXIT();
 }
 
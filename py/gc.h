@@ -33,6 +33,11 @@
 
 void gc_init(void *start, void *end);
 
+#if MICROPY_GC_SPLIT_HEAP
+// Used to add additional memory areas to the heap.
+void gc_add(void *start, void *end);
+#endif
+
 // These lock/unlock functions can be nested.
 // They can be used to prevent the GC from allocating/freeing.
 void gc_lock(void);
@@ -45,11 +50,33 @@ void gc_collect_start(void);
 void gc_collect_root(void **ptrs, size_t len);
 void gc_collect_end(void);
 
+#if MICROPY_GC_THREAD_ALLOC_BUFFER
+// Gives the allocation buffer of the calling thread back, for threads that exit
+void gc_alloc_buf_release(void);
+#endif
+
+#if MICROPY_GC_PARALLEL_MARK
+// Provided by the port: asks a helper on another CPU to call gc_helper_mark()
+// for the collection being started, returns false if there is none.
+bool gc_helper_start(void);
+// Run by the helper, takes its share of the mark phase and returns when done
+void gc_helper_mark(void);
+#endif
+
 // Use this function to sweep the whole heap and run all finalisers
 void gc_sweep_all(void);
 
+#if MICROPY_GC_LAZY_SWEEP
+// Finish the sweep left pending by the last collection
+void gc_sweep_finish(void);
+#endif
+
 enum {
     GC_ALLOC_FLAG_HAS_FINALISER = 1,
+    #if MICROPY_GC_SPLIT_HEAP
+    // prefer the first heap area whatever the size
+    GC_ALLOC_FLAG_FAST = 2,
+    #endif
 };
 
 void *gc_alloc(size_t n_bytes, unsigned int alloc_flags);
@@ -57,6 +84,12 @@ void gc_free(void *ptr); // does not call finaliser
 size_t gc_nbytes(const void *ptr);
 void *gc_realloc(void *ptr, size_t n_bytes, bool allow_move);
 
+#if MICROPY_PY_GC_DEFRAG
+// Move a chunk to the lowest free run below it that fits, returns the new
+// location or NULL if there is none.  The caller must own the only reference.
+void *gc_move_lower(void *ptr);
+#endif
+
 typedef struct _gc_info_t {
     size_t total;
     size_t used;
@@ -65,9 +98,20 @@ typedef struct _gc_info_t {
     size_t num_1block;
     size_t num_2block;
     size_t max_block;
+    #if MICROPY_GC_FREE_LISTS
+    size_t free_list_hits;
+    size_t free_list_misses;
+    #endif
 } gc_info_t;
 
 void gc_info(gc_info_t *info);
+
+#if MICROPY_PY_MICROPYTHON_ALLOC_STATS
+// Allocation tracking behind micropython.alloc_stats(), enabling it clears the counts
+void gc_alloc_stats_enable(bool enable);
+// hist[i] gets the number of free runs of 2**i to 2**(i+1)-1 blocks, the last entry all longer ones too
+void gc_free_histogram(size_t *hist, size_t hist_len);
+#endif
 void gc_dump_info(void);
 void gc_dump_alloc_table(void);
 
@@ -32,6 +32,7 @@
 #include "py/mpconfig.h"
 #include "py/misc.h"
 #include "py/runtime.h"
+#include "py/objstr.h"
 
 #if MICROPY_DEBUG_VERBOSE // print debugging info
 #define DEBUG_PRINT (1)
@@ -73,6 +74,97 @@ STATIC size_t get_hash_alloc_greater_or_equal_to(size_t x) {
     return (x + x / 2) | 1;
 }
 
+// Hash of a key, reusing the hash stored in str objects rather than going
+// through mp_unary_op.  Equal str and qstr keys get the same hash.
+STATIC inline mp_uint_t map_hash(mp_obj_t index) {
+    if (mp_obj_is_qstr(index)) {
+        return qstr_hash(MP_OBJ_QSTR_VALUE(index));
+    }
+    if (mp_obj_is_type(index, &mp_type_str)) {
+        mp_uint_t hash = ((mp_obj_str_t*)MP_OBJ_TO_PTR(index))->hash;
+        if (hash != 0) {
+            return hash;
+        }
+    }
+    return MP_OBJ_SMALL_INT_VALUE(mp_unary_op(MP_UNARY_OP_HASH, index));
+}
+
+// Two different qstrs are never equal, only the other cases need comparing
+STATIC inline bool map_key_equal(mp_obj_t key, mp_obj_t index) {
+    if (mp_obj_is_qstr(key) && mp_obj_is_qstr(index)) {
+        return false;
+    }
+    return mp_obj_equal(key, index);
+}
+
+#if MICROPY_OPT_MAP_COMPACT
+// A hash table is a dense array of entries, in insertion order, followed by a
+// word holding how many entries have been filled and then the index: a hash
+// table of 1-based entry numbers, 0 meaning an empty slot.  The index has more
+// slots than there are entries so it always has an empty one and stays at most
+// two thirds full.  A deleted entry keeps its key as MP_OBJ_SENTINEL until the
+// table is rebuilt, and its index slot can be taken by a new entry.  Iterating
+// over table[0..alloc] with mp_map_slot_is_filled works as for the plain table.
+
+STATIC inline size_t map_index_slots(size_t alloc) {
+    return get_hash_alloc_greater_or_equal_to(alloc + alloc / 2 + 1);
+}
+
+STATIC inline size_t map_index_width(size_t alloc) {
+    return alloc < 0xff ? 1 : alloc < 0xffff ? 2 : 4;
+}
+
+STATIC size_t map_table_bytes(size_t alloc) {
+    if (alloc == 0) {
+        return 0;
+    }
+    return alloc * sizeof(mp_map_elem_t) + sizeof(size_t) + map_index_slots(alloc) * map_index_width(alloc);
+}
+
+STATIC inline size_t *map_filled(mp_map_t *map) {
+    return (size_t*)&map->table[map->alloc];
+}
+
+STATIC inline size_t map_index_get(mp_map_t *map, size_t pos) {
+    void *index = map_filled(map) + 1;
+    switch (map_index_width(map->alloc)) {
+        case 1: return ((uint8_t*)index)[pos];
+        case 2: return ((uint16_t*)index)[pos];
+        default: return ((uint32_t*)index)[pos];
+    }
+}
+
+STATIC inline void map_index_set(mp_map_t *map, size_t pos, size_t entry) {
+    void *index = map_filled(map) + 1;
+    switch (map_index_width(map->alloc)) {
+        case 1: ((uint8_t*)index)[pos] = entry; break;
+        case 2: ((uint16_t*)index)[pos] = entry; break;
+        default: ((uint32_t*)index)[pos] = entry; break;
+    }
+}
+
+STATIC mp_map_elem_t *map_table_new(size_t alloc) {
+    return (mp_map_elem_t*)m_new0(byte, map_table_bytes(alloc));
+}
+
+// ordered maps are plain arrays of entries
+STATIC size_t map_table_size(const mp_map_t *map) {
+    return map->is_ordered ? map->alloc * sizeof(mp_map_elem_t) : map_table_bytes(map->alloc);
+}
+#else
+STATIC mp_map_elem_t *map_table_new(size_t alloc) {
+    return m_new0(mp_map_elem_t, alloc);
+}
+
+STATIC size_t map_table_size(const mp_map_t *map) {
+    return map->alloc * sizeof(mp_map_elem_t);
+}
+#endif
+
+size_t mp_map_table_size(const mp_map_t *map) {
+    return map_table_size(map);
+}
+
 /******************************************************************************/
 /* map                                                                        */
 
@@ -82,7 +174,7 @@ void mp_map_init(mp_map_t *map, size_t n) {
         map->table = NULL;
     } else {
         map->alloc = n;
-        map->table = m_new0(mp_map_elem_t, map->alloc);
+        map->table = map_table_new(map->alloc);
     }
     map->used = 0;
     map->all_keys_are_qstrs = 1;
@@ -102,14 +194,14 @@ void mp_map_init_fixed_table(mp_map_t *map, size_t n, const mp_obj_t *table) {
 // Differentiate from mp_map_clear() - semantics is different
 void mp_map_deinit(mp_map_t *map) {
     if (!map->is_fixed) {
-        m_del(mp_map_elem_t, map->table, map->alloc);
+        m_del(byte, map->table, map_table_size(map));
     }
     map->used = map->alloc = 0;
 }
 
 void mp_map_clear(mp_map_t *map) {
     if (!map->is_fixed) {
-        m_del(mp_map_elem_t, map->table, map->alloc);
+        m_del(byte, map->table, map_table_size(map));
     }
     map->alloc = 0;
     map->used = 0;
@@ -120,10 +212,17 @@ void mp_map_clear(mp_map_t *map) {
 
 STATIC void mp_map_rehash(mp_map_t *map) {
     size_t old_alloc = map->alloc;
+    #if MICROPY_OPT_MAP_COMPACT
+    // the entries are full, but if deletions freed half of them a rebuild is enough
+    size_t old_bytes = map_table_bytes(old_alloc);
+    size_t new_alloc = map->used < old_alloc / 2 ? old_alloc : get_hash_alloc_greater_or_equal_to(old_alloc + 1);
+    #else
+    size_t old_bytes = old_alloc * sizeof(mp_map_elem_t);
     size_t new_alloc = get_hash_alloc_greater_or_equal_to(map->alloc + 1);
+    #endif
     DEBUG_printf("mp_map_rehash(%p): " UINT_FMT " -> " UINT_FMT "\n", map, old_alloc, new_alloc);
     mp_map_elem_t *old_table = map->table;
-    mp_map_elem_t *new_table = m_new0(mp_map_elem_t, new_alloc);
+    mp_map_elem_t *new_table = map_table_new(new_alloc);
     // If we reach this point, table resizing succeeded, now we can edit the old map.
     map->alloc = new_alloc;
     map->used = 0;
@@ -134,9 +233,82 @@ STATIC void mp_map_rehash(mp_map_t *map) {
             mp_map_lookup(map, old_table[i].key, MP_MAP_LOOKUP_ADD_IF_NOT_FOUND)->value = old_table[i].value;
         }
     }
-    m_del(mp_map_elem_t, old_table, old_alloc);
+    m_del(byte, old_table, old_bytes);
 }
 
+#if MICROPY_OPT_MAP_LOOKUP_CACHE
+// The cache entry of a key holds the slot it was last found at, in whatever
+// map.  A hit is confirmed by comparing the key pointer in that slot, so a
+// stale or colliding entry only costs the regular lookup below.  The low bits
+// of the key are shifted out because they are mostly the object tag.
+#define MAP_CACHE_ENTRY(index) (MP_STATE_VM(map_lookup_cache)[(((uintptr_t)(index)) >> 2) % MICROPY_OPT_MAP_LOOKUP_CACHE_SIZE])
+#define MAP_CACHE_GET(map, index) (&(map)->table[MAP_CACHE_ENTRY(index) % (map)->alloc])
+#define MAP_CACHE_SET(index, pos) (MAP_CACHE_ENTRY(index) = (pos) & 0xff)
+#else
+#define MAP_CACHE_SET(index, pos)
+#endif
+
+#if MICROPY_OPT_MAP_COMPACT
+STATIC mp_map_elem_t *mp_map_lookup_compact(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t lookup_kind, bool compare_only_ptrs) {
+    if (map->alloc == 0) {
+        if (lookup_kind == MP_MAP_LOOKUP_ADD_IF_NOT_FOUND) {
+            mp_map_rehash(map);
+        } else {
+            return NULL;
+        }
+    }
+
+    mp_uint_t hash = map_hash(index);
+    for (;;) {
+        size_t n_slots = map_index_slots(map->alloc);
+        size_t pos = hash % n_slots;
+        size_t avail_pos = n_slots;
+        size_t entry;
+        while ((entry = map_index_get(map, pos)) != 0) {
+            mp_map_elem_t *elem = &map->table[entry - 1];
+            if (elem->key == MP_OBJ_SENTINEL) {
+                // deleted entry, its slot can be reused
+                if (avail_pos == n_slots) {
+                    avail_pos = pos;
+                }
+            } else if (elem->key == index || (!compare_only_ptrs && map_key_equal(elem->key, index))) {
+                if (lookup_kind == MP_MAP_LOOKUP_REMOVE_IF_FOUND) {
+                    // keep elem->value so that caller can access it if needed
+                    map->used--;
+                    elem->key = MP_OBJ_SENTINEL;
+                } else {
+                    MAP_CACHE_SET(index, entry - 1);
+                }
+                return elem;
+            }
+            pos = (pos + 1) % n_slots;
+        }
+
+        if (lookup_kind != MP_MAP_LOOKUP_ADD_IF_NOT_FOUND) {
+            return NULL;
+        }
+        size_t *filled = map_filled(map);
+        if (*filled < map->alloc) {
+            if (avail_pos == n_slots) {
+                avail_pos = pos;
+            }
+            mp_map_elem_t *elem = &map->table[*filled];
+            map_index_set(map, avail_pos, ++*filled);
+            map->used++;
+            elem->key = index;
+            elem->value = MP_OBJ_NULL;
+            if (!mp_obj_is_qstr(index)) {
+                map->all_keys_are_qstrs = 0;
+            }
+            MAP_CACHE_SET(index, elem - map->table);
+            return elem;
+        }
+        // no entry left, rebuild the table and search again
+        mp_map_rehash(map);
+    }
+}
+#endif
+
 // MP_MAP_LOOKUP behaviour:
 //  - returns NULL if not found, else the slot it was found in with key,value non-null
 // MP_MAP_LOOKUP_ADD_IF_NOT_FOUND behaviour:
@@ -147,6 +319,16 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
     // If the map is a fixed array then we must only be called for a lookup
     assert(!map->is_fixed || lookup_kind == MP_MAP_LOOKUP);
 
+    #if MICROPY_OPT_MAP_LOOKUP_CACHE
+    // Try the cache first, removal goes the regular way to keep ordered maps compact
+    if (lookup_kind != MP_MAP_LOOKUP_REMOVE_IF_FOUND && map->alloc) {
+        mp_map_elem_t *slot = MAP_CACHE_GET(map, index);
+        if (slot->key == index) {
+            return slot;
+        }
+    }
+    #endif
+
     // Work out if we can compare just pointers
     bool compare_only_ptrs = map->all_keys_are_qstrs;
     if (compare_only_ptrs) {
@@ -182,6 +364,7 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
                     elem->value = value;
                 }
                 #endif
+                MAP_CACHE_SET(index, elem - map->table);
                 return elem;
             }
         }
@@ -196,6 +379,7 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
             mp_seq_clear(map->table, map->used, map->alloc, sizeof(*map->table));
         }
         mp_map_elem_t *elem = map->table + map->used++;
+        MAP_CACHE_SET(index, elem - map->table);
         elem->key = index;
         if (!mp_obj_is_qstr(index)) {
             map->all_keys_are_qstrs = 0;
@@ -208,6 +392,10 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
 
     // map is a hash table (not an ordered array), so do a hash lookup
 
+    #if MICROPY_OPT_MAP_COMPACT
+    return mp_map_lookup_compact(map, index, lookup_kind, compare_only_ptrs);
+    #else
+
     if (map->alloc == 0) {
         if (lookup_kind == MP_MAP_LOOKUP_ADD_IF_NOT_FOUND) {
             mp_map_rehash(map);
@@ -216,13 +404,7 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
         }
     }
 
-    // get hash of index, with fast path for common case of qstr
-    mp_uint_t hash;
-    if (mp_obj_is_qstr(index)) {
-        hash = qstr_hash(MP_OBJ_QSTR_VALUE(index));
-    } else {
-        hash = MP_OBJ_SMALL_INT_VALUE(mp_unary_op(MP_UNARY_OP_HASH, index));
-    }
+    mp_uint_t hash = map_hash(index);
 
     size_t pos = hash % map->alloc;
     size_t start_pos = pos;
@@ -241,6 +423,7 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
                 if (!mp_obj_is_qstr(index)) {
                     map->all_keys_are_qstrs = 0;
                 }
+                MAP_CACHE_SET(index, avail_slot - map->table);
                 return avail_slot;
             } else {
                 return NULL;
@@ -250,7 +433,7 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
             if (avail_slot == NULL) {
                 avail_slot = slot;
             }
-        } else if (slot->key == index || (!compare_only_ptrs && mp_obj_equal(slot->key, index))) {
+        } else if (slot->key == index || (!compare_only_ptrs && map_key_equal(slot->key, index))) {
             // found index
             // Note: CPython does not replace the index; try x={True:'true'};x[1]='one';x
             if (lookup_kind == MP_MAP_LOOKUP_REMOVE_IF_FOUND) {
@@ -263,6 +446,8 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
                     slot->key = MP_OBJ_SENTINEL;
                 }
                 // keep slot->value so that caller can access it if needed
+            } else {
+                MAP_CACHE_SET(index, pos);
             }
             return slot;
         }
@@ -281,6 +466,7 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
                     if (!mp_obj_is_qstr(index)) {
                         map->all_keys_are_qstrs = 0;
                     }
+                    MAP_CACHE_SET(index, avail_slot - map->table);
                     return avail_slot;
                 } else {
                     // not enough room in table, rehash it
@@ -293,6 +479,7 @@ mp_map_elem_t *mp_map_lookup(mp_map_t *map, mp_obj_t index, mp_map_lookup_kind_t
             }
         }
     }
+    #endif
 }
 
 /******************************************************************************/
@@ -331,7 +518,7 @@ mp_obj_t mp_set_lookup(mp_set_t *set, mp_obj_t index, mp_map_lookup_kind_t looku
             return MP_OBJ_NULL;
         }
     }
-    mp_uint_t hash = MP_OBJ_SMALL_INT_VALUE(mp_unary_op(MP_UNARY_OP_HASH, index));
+    mp_uint_t hash = map_hash(index);
     size_t pos = hash % set->alloc;
     size_t start_pos = pos;
     mp_obj_t *avail_slot = NULL;
@@ -354,7 +541,7 @@ mp_obj_t mp_set_lookup(mp_set_t *set, mp_obj_t index, mp_map_lookup_kind_t looku
             if (avail_slot == NULL) {
                 avail_slot = &set->table[pos];
             }
-        } else if (mp_obj_equal(elem, index)) {
+        } else if (elem == index || map_key_equal(elem, index)) {
             // found index
             if (lookup_kind & MP_MAP_LOOKUP_REMOVE_IF_FOUND) {
                 // delete element
@@ -203,10 +203,15 @@ endif
 
 endif
 
+# a saved micropython.profile_stop() result lays out the hot frozen code contiguously
+ifneq ($(FROZEN_MPY_PROFILE),)
+MPY_TOOL_FLAGS += -p $(FROZEN_MPY_PROFILE)
+endif
+
 # to build frozen_mpy.c from all .mpy files
-$(BUILD)/frozen_mpy.c: $(FROZEN_MPY_MPY_FILES) $(BUILD)/genhdr/qstrdefs.generated.h
+$(BUILD)/frozen_mpy.c: $(FROZEN_MPY_MPY_FILES) $(BUILD)/genhdr/qstrdefs.generated.h $(FROZEN_MPY_PROFILE)
 	@$(ECHO) "GEN $@"
-	$(Q)$(MPY_TOOL) -f -q $(BUILD)/genhdr/qstrdefs.preprocessed.h $(FROZEN_MPY_MPY_FILES) > $@
+	$(Q)$(MPY_TOOL) -f -q $(BUILD)/genhdr/qstrdefs.preprocessed.h $(MPY_TOOL_FLAGS) $(FROZEN_MPY_MPY_FILES) > $@
 endif
 
 ifneq ($(PROG),)
@@ -27,6 +27,9 @@
 #include "py/mpstate.h"
 #include "py/obj.h"
 #include "py/gc.h"
+#include "py/runtime.h"
+#include "py/objlist.h"
+#include "py/objarray.h"
 
 #if MICROPY_PY_GC && MICROPY_ENABLE_GC
 
@@ -34,6 +37,10 @@
 STATIC mp_obj_t py_gc_collect(void) {
     gc_collect();
 #if MICROPY_PY_GC_COLLECT_RETVAL
+    #if MICROPY_GC_LAZY_SWEEP
+    // the count is only known once the whole heap is swept
+    gc_sweep_finish();
+    #endif
     return MP_OBJ_NEW_SMALL_INT(MP_STATE_MEM(gc_collected));
 #else
     return mp_const_none;
@@ -95,6 +102,78 @@ STATIC mp_obj_t gc_threshold(size_t n_args, const mp_obj_t *args) {
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(gc_threshold_obj, 0, 1, gc_threshold);
 #endif
 
+#if MICROPY_GC_LAZY_SWEEP
+// pause_budget_us([us]): get or set the time the sweep after a collection
+// may take per allocation, 0 (or negative) sweeps right after collecting
+STATIC mp_obj_t gc_pause_budget_us(size_t n_args, const mp_obj_t *args) {
+    if (n_args == 0) {
+        return mp_obj_new_int_from_uint(MP_STATE_MEM(gc_sweep_budget_us));
+    }
+    mp_int_t val = mp_obj_get_int(args[0]);
+    MP_STATE_MEM(gc_sweep_budget_us) = val < 0 ? 0 : val;
+    return mp_const_none;
+}
+MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(gc_pause_budget_us_obj, 0, 1, gc_pause_budget_us);
+#endif
+
+#if MICROPY_GC_REALLOC_STATS
+// realloc_stats(): (in_place, backward, moved, shrunk, defrag) counts of the
+// reallocations that changed the number of blocks, and of the defrag moves
+STATIC mp_obj_t gc_realloc_stats(void) {
+    mp_obj_t tuple[5] = {
+        mp_obj_new_int_from_uint(MP_STATE_MEM(gc_realloc_in_place)),
+        mp_obj_new_int_from_uint(MP_STATE_MEM(gc_realloc_backward)),
+        mp_obj_new_int_from_uint(MP_STATE_MEM(gc_realloc_moved)),
+        mp_obj_new_int_from_uint(MP_STATE_MEM(gc_realloc_shrunk)),
+        mp_obj_new_int_from_uint(MP_STATE_MEM(gc_realloc_defrag)),
+    };
+    return mp_obj_new_tuple(5, tuple);
+}
+MP_DEFINE_CONST_FUN_OBJ_0(gc_realloc_stats_obj, gc_realloc_stats);
+#endif
+
+#if MICROPY_PY_GC_DEFRAG
+// defrag(objs): move the storage of the lists, bytearrays and arrays in objs
+// to the lowest free runs that fit, returns how many were moved.  The GC is
+// conservative so only these objects, whose storage they alone point to, can
+// be fixed up; memoryviews of them are invalidated as if they had grown.
+STATIC mp_obj_t gc_defrag(mp_obj_t objs) {
+    mp_obj_iter_buf_t iter_buf;
+    mp_obj_t iterable = mp_getiter(objs, &iter_buf);
+    mp_obj_t item;
+    mp_int_t n_moved = 0;
+    while ((item = mp_iternext(iterable)) != MP_OBJ_STOP_ITERATION) {
+        void *moved = NULL;
+        if (MP_OBJ_IS_TYPE(item, &mp_type_list)) {
+            mp_obj_list_t *list = MP_OBJ_TO_PTR(item);
+            if ((moved = gc_move_lower(list->items)) != NULL) {
+                list->items = moved;
+            }
+        }
+        #if MICROPY_PY_BUILTINS_BYTEARRAY || MICROPY_PY_ARRAY
+        if (0
+            #if MICROPY_PY_BUILTINS_BYTEARRAY
+            || MP_OBJ_IS_TYPE(item, &mp_type_bytearray)
+            #endif
+            #if MICROPY_PY_ARRAY
+            || MP_OBJ_IS_TYPE(item, &mp_type_array)
+            #endif
+            ) {
+            mp_obj_array_t *array = MP_OBJ_TO_PTR(item);
+            if ((moved = gc_move_lower(array->items)) != NULL) {
+                array->items = moved;
+            }
+        }
+        #endif
+        if (moved != NULL) {
+            n_moved++;
+        }
+    }
+    return MP_OBJ_NEW_SMALL_INT(n_moved);
+}
+MP_DEFINE_CONST_FUN_OBJ_1(gc_defrag_obj, gc_defrag);
+#endif
+
 STATIC const mp_rom_map_elem_t mp_module_gc_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_gc) },
     { MP_ROM_QSTR(MP_QSTR_collect), MP_ROM_PTR(&gc_collect_obj) },
@@ -106,6 +185,15 @@ STATIC const mp_rom_map_elem_t mp_module_gc_globals_table[] = {
     #if MICROPY_GC_ALLOC_THRESHOLD
     { MP_ROM_QSTR(MP_QSTR_threshold), MP_ROM_PTR(&gc_threshold_obj) },
     #endif
+    #if MICROPY_GC_LAZY_SWEEP
+    { MP_ROM_QSTR(MP_QSTR_pause_budget_us), MP_ROM_PTR(&gc_pause_budget_us_obj) },
+    #endif
+    #if MICROPY_GC_REALLOC_STATS
+    { MP_ROM_QSTR(MP_QSTR_realloc_stats), MP_ROM_PTR(&gc_realloc_stats_obj) },
+    #endif
+    #if MICROPY_PY_GC_DEFRAG
+    { MP_ROM_QSTR(MP_QSTR_defrag), MP_ROM_PTR(&gc_defrag_obj) },
+    #endif
 };
 
 STATIC MP_DEFINE_CONST_DICT(mp_module_gc_globals, mp_module_gc_globals_table);
@@ -199,6 +199,189 @@ STATIC const mp_obj_type_t bufwriter_type = {
 };
 #endif // MICROPY_PY_IO_BUFFEREDWRITER
 
+#if MICROPY_PY_IO_BUFFEREDREADER
+// Reads from the underlying stream a whole buffer at a time, so that readline()
+// and small reads don't turn into a call to the stream per byte.
+#define BUFREADER_DEFAULT_SIZE (256)
+
+typedef struct _mp_obj_bufreader_t {
+    mp_obj_base_t base;
+    mp_obj_t stream;
+    size_t alloc;
+    size_t pos;
+    size_t len;
+    byte buf[0];
+} mp_obj_bufreader_t;
+
+STATIC mp_obj_t bufreader_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+    mp_arg_check_num(n_args, n_kw, 1, 2, false);
+    mp_get_stream_raise(args[0], MP_STREAM_OP_READ);
+    mp_int_t alloc = BUFREADER_DEFAULT_SIZE;
+    if (n_args > 1) {
+        alloc = mp_obj_get_int(args[1]);
+        if (alloc <= 0) {
+            mp_raise_ValueError(NULL);
+        }
+    }
+    mp_obj_bufreader_t *o = m_new_obj_var(mp_obj_bufreader_t, byte, alloc);
+    o->base.type = type;
+    o->stream = args[0];
+    o->alloc = alloc;
+    o->pos = 0;
+    o->len = 0;
+    return o;
+}
+
+// returns the number of bytes now buffered, 0 at EOF
+STATIC mp_uint_t bufreader_fill(mp_obj_bufreader_t *self, int *errcode) {
+    const mp_stream_p_t *stream_p = mp_get_stream(self->stream);
+    mp_uint_t out_sz = stream_p->read(self->stream, self->buf, self->alloc, errcode);
+    if (out_sz == MP_STREAM_ERROR) {
+        return MP_STREAM_ERROR;
+    }
+    self->pos = 0;
+    self->len = out_sz;
+    return out_sz;
+}
+
+STATIC mp_uint_t bufreader_read(mp_obj_t self_in, void *buf, mp_uint_t size, int *errcode) {
+    mp_obj_bufreader_t *self = MP_OBJ_TO_PTR(self_in);
+
+    if (self->pos == self->len) {
+        if (size >= self->alloc) {
+            // nothing to gain from going through the buffer
+            const mp_stream_p_t *stream_p = mp_get_stream(self->stream);
+            return stream_p->read(self->stream, buf, size, errcode);
+        }
+        mp_uint_t out_sz = bufreader_fill(self, errcode);
+        if (out_sz == MP_STREAM_ERROR || out_sz == 0) {
+            return out_sz;
+        }
+    }
+
+    // a short read, the caller asks again for the rest if it needs it
+    size = MIN(size, self->len - self->pos);
+    memcpy(buf, self->buf + self->pos, size);
+    self->pos += size;
+    return size;
+}
+
+STATIC mp_uint_t bufreader_ioctl(mp_obj_t self_in, mp_uint_t request, uintptr_t arg, int *errcode) {
+    mp_obj_bufreader_t *self = MP_OBJ_TO_PTR(self_in);
+    const mp_stream_p_t *stream_p = mp_get_stream(self->stream);
+    mp_uint_t ret = 0;
+
+    if (request == MP_STREAM_POLL && self->pos < self->len && (arg & MP_STREAM_POLL_RD)) {
+        // buffered data is readable whatever the stream says
+        arg &= ~MP_STREAM_POLL_RD;
+        ret = MP_STREAM_POLL_RD;
+        if (arg == 0) {
+            return ret;
+        }
+    }
+    if (request == MP_STREAM_CLOSE) {
+        self->pos = self->len = 0;
+    }
+    if (stream_p->ioctl == NULL) {
+        *errcode = MP_EINVAL;
+        return MP_STREAM_ERROR;
+    }
+    mp_uint_t res = stream_p->ioctl(self->stream, request, arg, errcode);
+    if (res == MP_STREAM_ERROR) {
+        return res;
+    }
+    return ret | res;
+}
+
+STATIC mp_obj_t bufreader_readline(size_t n_args, const mp_obj_t *args) {
+    mp_obj_bufreader_t *self = MP_OBJ_TO_PTR(args[0]);
+    mp_int_t max_size = -1;
+    if (n_args > 1) {
+        max_size = mp_obj_get_int(args[1]);
+    }
+
+    vstr_t vstr;
+    vstr_init(&vstr, 16);
+    while (max_size != 0) {
+        if (self->pos == self->len) {
+            int error;
+            mp_uint_t out_sz = bufreader_fill(self, &error);
+            if (out_sz == MP_STREAM_ERROR) {
+                if (mp_is_nonblocking_error(error)) {
+                    if (vstr.len == 0) {
+                        // same as the unbuffered readline, nothing read yet gives None
+                        vstr_clear(&vstr);
+                        return mp_const_none;
+                    }
+                    break;
+                }
+                mp_raise_OSError(error);
+            }
+            if (out_sz == 0) {
+                break;
+            }
+        }
+        // copy up to the newline in one go
+        size_t avail = self->len - self->pos;
+        if (max_size > 0 && (size_t)max_size < avail) {
+            avail = max_size;
+        }
+        const byte *start = self->buf + self->pos;
+        const byte *nl = memchr(start, '\n', avail);
+        size_t n = nl ? (size_t)(nl - start) + 1 : avail;
+        vstr_add_strn(&vstr, (const char*)start, n);
+        self->pos += n;
+        if (max_size > 0) {
+            max_size -= n;
+        }
+        if (nl) {
+            break;
+        }
+    }
+    return mp_obj_new_str_from_vstr(&mp_type_bytes, &vstr);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(bufreader_readline_obj, 1, 2, bufreader_readline);
+
+STATIC mp_obj_t bufreader_iternext(mp_obj_t self_in) {
+    mp_obj_t line = bufreader_readline(1, &self_in);
+    if (!mp_obj_is_true(line)) {
+        return MP_OBJ_STOP_ITERATION;
+    }
+    return line;
+}
+
+STATIC mp_obj_t bufreader___exit__(size_t n_args, const mp_obj_t *args) {
+    (void)n_args;
+    return mp_stream_close(args[0]);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(bufreader___exit___obj, 4, 4, bufreader___exit__);
+
+STATIC const mp_rom_map_elem_t bufreader_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_read), MP_ROM_PTR(&mp_stream_read_obj) },
+    { MP_ROM_QSTR(MP_QSTR_readinto), MP_ROM_PTR(&mp_stream_readinto_obj) },
+    { MP_ROM_QSTR(MP_QSTR_readline), MP_ROM_PTR(&bufreader_readline_obj) },
+    { MP_ROM_QSTR(MP_QSTR_close), MP_ROM_PTR(&mp_stream_close_obj) },
+    { MP_ROM_QSTR(MP_QSTR___enter__), MP_ROM_PTR(&mp_identity_obj) },
+    { MP_ROM_QSTR(MP_QSTR___exit__), MP_ROM_PTR(&bufreader___exit___obj) },
+};
+STATIC MP_DEFINE_CONST_DICT(bufreader_locals_dict, bufreader_locals_dict_table);
+
+STATIC const mp_stream_p_t bufreader_stream_p = {
+    .read = bufreader_read,
+    .ioctl = bufreader_ioctl,
+};
+
+STATIC const mp_obj_type_t bufreader_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_BufferedReader,
+    .make_new = bufreader_make_new,
+    .getiter = mp_identity_getiter,
+    .iternext = bufreader_iternext,
+    .protocol = &bufreader_stream_p,
+    .locals_dict = (mp_obj_dict_t*)&bufreader_locals_dict,
+};
+#endif // MICROPY_PY_IO_BUFFEREDREADER
+
 #if MICROPY_PY_IO_RESOURCE_STREAM
 STATIC mp_obj_t resource_stream(mp_obj_t package_in, mp_obj_t path_in) {
     VSTR_FIXED(path_buf, MICROPY_ALLOC_PATH_MAX);
@@ -271,9 +454,15 @@ STATIC const mp_rom_map_elem_t mp_module_io_globals_table[] = {
     #if MICROPY_PY_IO_BYTESIO
     { MP_ROM_QSTR(MP_QSTR_BytesIO), MP_ROM_PTR(&mp_type_bytesio) },
     #endif
+    #if MICROPY_PY_IO_BYTESBUILDER
+    { MP_ROM_QSTR(MP_QSTR_BytesBuilder), MP_ROM_PTR(&mp_type_bytesbuilder) },
+    #endif
     #if MICROPY_PY_IO_BUFFEREDWRITER
     { MP_ROM_QSTR(MP_QSTR_BufferedWriter), MP_ROM_PTR(&bufwriter_type) },
     #endif
+    #if MICROPY_PY_IO_BUFFEREDREADER
+    { MP_ROM_QSTR(MP_QSTR_BufferedReader), MP_ROM_PTR(&bufreader_type) },
+    #endif
 };
 
 STATIC MP_DEFINE_CONST_DICT(mp_module_io_globals, mp_module_io_globals_table);
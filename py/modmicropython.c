@@ -31,6 +31,9 @@
 #include "py/runtime.h"
 #include "py/gc.h"
 #include "py/mphal.h"
+#if MICROPY_PY_MICROPYTHON_PROFILE
+#include "py/bc.h"
+#endif
 
 // Various builtins specific to MicroPython runtime,
 // living in micropython module
@@ -83,6 +86,12 @@ mp_obj_t mp_micropython_mem_info(size_t n_args, const mp_obj_t *args) {
     if (n_args == 1) {
         // arg given means dump gc allocation table
         gc_dump_alloc_table();
+        #if MICROPY_GC_FREE_LISTS
+        gc_info_t info;
+        gc_info(&info);
+        mp_printf(&mp_plat_print, "GC free lists: hits: %u, misses: %u\n",
+            (uint)info.free_list_hits, (uint)info.free_list_misses);
+        #endif
     }
 #else
     (void)n_args;
@@ -121,6 +130,193 @@ STATIC mp_obj_t mp_micropython_pystack_use(void) {
 STATIC MP_DEFINE_CONST_FUN_OBJ_0(mp_micropython_pystack_use_obj, mp_micropython_pystack_use);
 #endif
 
+#if MICROPY_PY_MICROPYTHON_ALLOC_STATS
+// number of entries in the free run histogram, the last one is for 128 blocks and up
+#define ALLOC_STATS_HIST_LEN (8)
+
+STATIC mp_obj_t mp_alloc_stats_qstr_or_none(qstr q) {
+    return q == MP_QSTR_NULL ? mp_const_none : MP_OBJ_NEW_QSTR(q);
+}
+
+STATIC mp_obj_t mp_micropython_alloc_stats(size_t n_args, const mp_obj_t *args) {
+    if (n_args == 1) {
+        // turn tracking on (clearing the counts) or off
+        gc_alloc_stats_enable(mp_obj_is_true(args[0]));
+        return mp_const_none;
+    }
+
+    // don't count the allocations made to report the counts
+    bool enabled = MP_STATE_MEM(alloc_stats_enabled);
+    MP_STATE_MEM(alloc_stats_enabled) = false;
+
+    // (source_file, source_line, block_name, count, bytes) for each site
+    size_t n_sites = enabled ? MP_STATE_MEM(alloc_stats_n_sites) : 0;
+    mp_obj_t sites = mp_obj_new_list(0, NULL);
+    for (size_t i = 0; i < n_sites; i++) {
+        const mp_alloc_site_t *site = &MP_STATE_MEM(alloc_stats_sites)[i];
+        mp_obj_t t[5] = {
+            mp_alloc_stats_qstr_or_none(site->source_file),
+            MP_OBJ_NEW_SMALL_INT(site->source_line),
+            mp_alloc_stats_qstr_or_none(site->block_name),
+            mp_obj_new_int_from_uint(site->count),
+            mp_obj_new_int_from_uint(site->bytes),
+        };
+        mp_obj_list_append(sites, mp_obj_new_tuple(5, t));
+    }
+
+    // (collection, free, max_free) for the last collections, oldest first
+    size_t n_collections = enabled ? MP_STATE_MEM(alloc_stats_collections) : 0;
+    size_t n_history = MIN(n_collections, MICROPY_ALLOC_STATS_HISTORY);
+    mp_obj_t history = mp_obj_new_list(0, NULL);
+    for (size_t i = n_collections - n_history; i < n_collections; i++) {
+        const mp_alloc_frag_t *frag = &MP_STATE_MEM(alloc_stats_history)[i % MICROPY_ALLOC_STATS_HISTORY];
+        mp_obj_t t[3] = {
+            mp_obj_new_int_from_uint(frag->collection),
+            mp_obj_new_int_from_uint(frag->free),
+            mp_obj_new_int_from_uint(frag->max_free),
+        };
+        mp_obj_list_append(history, mp_obj_new_tuple(3, t));
+    }
+
+    // free runs of the heap as it is now, by length
+    size_t hist[ALLOC_STATS_HIST_LEN];
+    gc_free_histogram(hist, ALLOC_STATS_HIST_LEN);
+    mp_obj_t hist_items[ALLOC_STATS_HIST_LEN];
+    for (size_t i = 0; i < ALLOC_STATS_HIST_LEN; i++) {
+        hist_items[i] = mp_obj_new_int_from_uint(hist[i]);
+    }
+
+    MP_STATE_MEM(alloc_stats_enabled) = enabled;
+
+    mp_obj_t ret[3] = { sites, history, mp_obj_new_tuple(ALLOC_STATS_HIST_LEN, hist_items) };
+    return mp_obj_new_tuple(3, ret);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_micropython_alloc_stats_obj, 0, 1, mp_micropython_alloc_stats);
+#endif
+
+#if MICROPY_PY_MICROPYTHON_PROFILE
+#define PROFILE_DEFAULT_PERIOD_US (1000)
+#define PROFILE_DEFAULT_SAMPLES (1024)
+
+typedef struct _mp_profile_sample_t {
+    const mp_obj_fun_bc_t *fun_bc; // NULL if no bytecode was running
+    size_t offset;
+} mp_profile_sample_t;
+
+// Shared with the timer callback, which only ever appends to the samples
+STATIC mp_state_thread_t *profile_thread;
+STATIC size_t profile_alloc;
+STATIC volatile size_t profile_len;
+STATIC volatile size_t profile_dropped;
+
+void mp_micropython_profile_sample(void) {
+    mp_profile_sample_t *buf = MP_STATE_VM(profile_buf);
+    if (buf == NULL) {
+        return;
+    }
+    size_t len = profile_len;
+    if (len >= profile_alloc) {
+        profile_dropped++;
+        return;
+    }
+    const mp_code_state_t *code_state = profile_thread->current_code_state;
+    if (code_state != NULL) {
+        buf[len].fun_bc = code_state->fun_bc;
+        buf[len].offset = code_state->ip - code_state->fun_bc->bytecode;
+    } else {
+        buf[len].fun_bc = NULL;
+        buf[len].offset = 0;
+    }
+    profile_len = len + 1;
+}
+
+STATIC mp_obj_t mp_micropython_profile_start(size_t n_args, const mp_obj_t *args) {
+    mp_int_t period_us = n_args > 0 ? mp_obj_get_int(args[0]) : PROFILE_DEFAULT_PERIOD_US;
+    mp_int_t n_samples = n_args > 1 ? mp_obj_get_int(args[1]) : PROFILE_DEFAULT_SAMPLES;
+    if (period_us <= 0 || n_samples <= 0) {
+        mp_raise_ValueError(NULL);
+    }
+
+    // restart from scratch if a profile is already running
+    mp_hal_profile_timer(0);
+    MP_STATE_VM(profile_buf) = NULL;
+
+    #if MICROPY_PY_THREAD
+    profile_thread = mp_thread_get_state();
+    #else
+    profile_thread = &mp_state_ctx.thread;
+    #endif
+    profile_alloc = n_samples;
+    profile_len = 0;
+    profile_dropped = 0;
+    MP_STATE_VM(profile_buf) = m_new(mp_profile_sample_t, n_samples);
+    mp_hal_profile_timer(period_us);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mp_micropython_profile_start_obj, 0, 2, mp_micropython_profile_start);
+
+STATIC mp_obj_t mp_micropython_profile_stop(void) {
+    mp_hal_profile_timer(0);
+    mp_profile_sample_t *buf = MP_STATE_VM(profile_buf);
+    if (buf == NULL) {
+        return mp_const_none;
+    }
+    size_t len = profile_len;
+
+    // count the samples of each line, keyed by (block_name, source_file, line)
+    mp_obj_dict_t *counts = MP_OBJ_TO_PTR(mp_obj_new_dict(0));
+    for (size_t i = 0; i < len; i++) {
+        mp_obj_t key[3] = { mp_const_none, mp_const_none, MP_OBJ_NEW_SMALL_INT(0) };
+        if (buf[i].fun_bc != NULL) {
+            mp_code_state_t code_state;
+            code_state.fun_bc = (mp_obj_fun_bc_t*)buf[i].fun_bc;
+            code_state.ip = buf[i].fun_bc->bytecode + buf[i].offset;
+            qstr source_file, block_name;
+            size_t source_line;
+            mp_bytecode_get_source_info(&code_state, &source_file, &block_name, &source_line);
+            key[0] = MP_OBJ_NEW_QSTR(block_name);
+            key[1] = MP_OBJ_NEW_QSTR(source_file);
+            key[2] = MP_OBJ_NEW_SMALL_INT(source_line);
+        }
+        mp_map_elem_t *elem = mp_map_lookup(&counts->map, mp_obj_new_tuple(3, key), MP_MAP_LOOKUP_ADD_IF_NOT_FOUND);
+        mp_int_t n = elem->value == MP_OBJ_NULL ? 0 : MP_OBJ_SMALL_INT_VALUE(elem->value);
+        elem->value = MP_OBJ_NEW_SMALL_INT(n + 1);
+    }
+    MP_STATE_VM(profile_buf) = NULL;
+    m_del(mp_profile_sample_t, buf, profile_alloc);
+
+    // sort by (samples, line, source_file, block_name), which never compares None with a str
+    mp_obj_t sorted = mp_obj_new_list(0, NULL);
+    for (size_t i = 0; i < counts->map.alloc; i++) {
+        if (mp_map_slot_is_filled(&counts->map, i)) {
+            size_t n;
+            mp_obj_t *key;
+            mp_obj_tuple_get(counts->map.table[i].key, &n, &key);
+            mp_obj_t t[4] = { counts->map.table[i].value, key[2], key[1], key[0] };
+            mp_obj_list_append(sorted, mp_obj_new_tuple(4, t));
+        }
+    }
+    mp_obj_list_sort(1, &sorted, (mp_map_t*)&mp_const_empty_map);
+
+    // hottest first, as (block_name, source_file, line, samples)
+    size_t n_lines;
+    mp_obj_t *items;
+    mp_obj_list_get(sorted, &n_lines, &items);
+    mp_obj_t lines = mp_obj_new_list(0, NULL);
+    for (size_t i = n_lines; i > 0; i--) {
+        size_t n;
+        mp_obj_t *t;
+        mp_obj_tuple_get(items[i - 1], &n, &t);
+        mp_obj_t entry[4] = { t[3], t[2], t[1], t[0] };
+        mp_obj_list_append(lines, mp_obj_new_tuple(4, entry));
+    }
+
+    mp_obj_t ret[2] = { lines, mp_obj_new_int_from_uint(profile_dropped) };
+    return mp_obj_new_tuple(2, ret);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mp_micropython_profile_stop_obj, mp_micropython_profile_stop);
+#endif
+
 #if MICROPY_ENABLE_GC
 STATIC mp_obj_t mp_micropython_heap_lock(void) {
     gc_lock();
@@ -183,6 +379,13 @@ STATIC const mp_rom_map_elem_t mp_module_micropython_globals_table[] = {
     #if MICROPY_PY_MICROPYTHON_STACK_USE
     { MP_ROM_QSTR(MP_QSTR_stack_use), MP_ROM_PTR(&mp_micropython_stack_use_obj) },
     #endif
+    #if MICROPY_PY_MICROPYTHON_ALLOC_STATS
+    { MP_ROM_QSTR(MP_QSTR_alloc_stats), MP_ROM_PTR(&mp_micropython_alloc_stats_obj) },
+    #endif
+    #if MICROPY_PY_MICROPYTHON_PROFILE
+    { MP_ROM_QSTR(MP_QSTR_profile_start), MP_ROM_PTR(&mp_micropython_profile_start_obj) },
+    { MP_ROM_QSTR(MP_QSTR_profile_stop), MP_ROM_PTR(&mp_micropython_profile_stop_obj) },
+    #endif
 #if MICROPY_ENABLE_EMERGENCY_EXCEPTION_BUF && (MICROPY_EMERGENCY_EXCEPTION_BUF_SIZE == 0)
     { MP_ROM_QSTR(MP_QSTR_alloc_emergency_exception_buf), MP_ROM_PTR(&mp_alloc_emergency_exception_buf_obj) },
 #endif
@@ -248,6 +248,228 @@ STATIC mp_obj_t struct_pack_into(size_t n_args, const mp_obj_t *args) {
 }
 MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(struct_pack_into_obj, 3, MP_OBJ_FUN_ARGS_MAX, struct_pack_into);
 
+#if MICROPY_PY_STRUCT_CLASS
+
+// Struct(fmt) parses the format once into a list of ops, a typecode with its
+// repeat count each, so packing and unpacking don't go through the string again
+
+typedef struct _struct_op_t {
+    uint32_t cnt;   // repeat count, or the length of an 's' field
+    char type;
+} struct_op_t;
+
+typedef struct _mp_obj_struct_t {
+    mp_obj_base_t base;
+    mp_obj_t format;
+    char fmt_type;
+    size_t size;
+    size_t num_items;
+    size_t n_ops;
+    struct_op_t ops[];
+} mp_obj_struct_t;
+
+typedef struct _mp_obj_struct_iter_t {
+    mp_obj_base_t base;
+    mp_obj_struct_t *st;
+    mp_obj_t buf;
+    size_t offset;
+} mp_obj_struct_iter_t;
+
+STATIC const mp_obj_type_t struct_type;
+
+// fills ops if it's not NULL, returns the number of ops either way
+STATIC size_t struct_compile(const char *fmt, struct_op_t *ops) {
+    size_t n_ops = 0;
+    for (; *fmt; fmt++) {
+        mp_uint_t cnt = 1;
+        if (unichar_isdigit(*fmt)) {
+            cnt = get_fmt_num(&fmt);
+        }
+        if (cnt == 0 && *fmt != 's') {
+            continue;
+        }
+        if (ops != NULL) {
+            ops[n_ops].cnt = cnt;
+            ops[n_ops].type = *fmt;
+        }
+        n_ops++;
+    }
+    return n_ops;
+}
+
+STATIC mp_obj_t struct_make_new(const mp_obj_type_t *type, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+    mp_arg_check_num(n_args, n_kw, 1, 1, false);
+    const char *fmt = mp_obj_str_get_str(args[0]);
+    size_t size;
+    size_t num_items = calc_size_items(fmt, &size);
+    char fmt_type = get_fmt_type(&fmt);
+    size_t n_ops = struct_compile(fmt, NULL);
+
+    mp_obj_struct_t *self = m_new_obj_var(mp_obj_struct_t, struct_op_t, n_ops);
+    self->base.type = type;
+    self->format = args[0];
+    self->fmt_type = fmt_type;
+    self->size = size;
+    self->num_items = num_items;
+    self->n_ops = n_ops;
+    struct_compile(fmt, self->ops);
+    return MP_OBJ_FROM_PTR(self);
+}
+
+STATIC mp_obj_t struct_unpack_ops(mp_obj_struct_t *self, byte *p) {
+    mp_obj_tuple_t *res = MP_OBJ_TO_PTR(mp_obj_new_tuple(self->num_items, NULL));
+    mp_obj_t *item = res->items;
+    for (size_t i = 0; i < self->n_ops; i++) {
+        const struct_op_t *op = &self->ops[i];
+        if (op->type == 's') {
+            *item++ = mp_obj_new_bytes(p, op->cnt);
+            p += op->cnt;
+        } else {
+            for (uint32_t cnt = op->cnt; cnt > 0; cnt--) {
+                *item++ = mp_binary_get_val(self->fmt_type, op->type, &p);
+            }
+        }
+    }
+    return MP_OBJ_FROM_PTR(res);
+}
+
+// the caller makes sure there's room for self->size bytes at p
+STATIC void struct_pack_ops(mp_obj_struct_t *self, byte *p, size_t n_args, const mp_obj_t *args) {
+    if (n_args != self->num_items) {
+        mp_raise_ValueError("wrong number of values");
+    }
+    for (size_t i = 0; i < self->n_ops; i++) {
+        const struct_op_t *op = &self->ops[i];
+        if (op->type == 's') {
+            mp_buffer_info_t bufinfo;
+            mp_get_buffer_raise(*args++, &bufinfo, MP_BUFFER_READ);
+            size_t to_copy = MIN(bufinfo.len, op->cnt);
+            memcpy(p, bufinfo.buf, to_copy);
+            memset(p + to_copy, 0, op->cnt - to_copy);
+            p += op->cnt;
+        } else {
+            for (uint32_t cnt = op->cnt; cnt > 0; cnt--) {
+                mp_binary_set_val(self->fmt_type, op->type, *args++, &p);
+            }
+        }
+    }
+}
+
+// returns where self->size bytes start in buf_in, after checking they're all there
+STATIC byte *struct_get_buf(mp_obj_struct_t *self, mp_obj_t buf_in, mp_int_t offset, int flags) {
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(buf_in, &bufinfo, flags);
+    if (offset < 0) {
+        // negative offsets are relative to the end of the buffer
+        offset = (mp_int_t)bufinfo.len + offset;
+        if (offset < 0) {
+            mp_raise_ValueError("buffer too small");
+        }
+    }
+    if ((size_t)offset + self->size > bufinfo.len) {
+        mp_raise_ValueError("buffer too small");
+    }
+    return (byte*)bufinfo.buf + offset;
+}
+
+STATIC mp_obj_t struct_obj_pack(size_t n_args, const mp_obj_t *args) {
+    mp_obj_struct_t *self = MP_OBJ_TO_PTR(args[0]);
+    vstr_t vstr;
+    vstr_init_len(&vstr, self->size);
+    memset(vstr.buf, 0, self->size);
+    struct_pack_ops(self, (byte*)vstr.buf, n_args - 1, &args[1]);
+    return mp_obj_new_str_from_vstr(&mp_type_bytes, &vstr);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(struct_obj_pack_obj, 1, MP_OBJ_FUN_ARGS_MAX, struct_obj_pack);
+
+STATIC mp_obj_t struct_obj_pack_into(size_t n_args, const mp_obj_t *args) {
+    mp_obj_struct_t *self = MP_OBJ_TO_PTR(args[0]);
+    byte *p = struct_get_buf(self, args[1], mp_obj_get_int(args[2]), MP_BUFFER_WRITE);
+    struct_pack_ops(self, p, n_args - 3, &args[3]);
+    return mp_const_none;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(struct_obj_pack_into_obj, 3, MP_OBJ_FUN_ARGS_MAX, struct_obj_pack_into);
+
+STATIC mp_obj_t struct_obj_unpack_from(size_t n_args, const mp_obj_t *args) {
+    mp_obj_struct_t *self = MP_OBJ_TO_PTR(args[0]);
+    mp_int_t offset = n_args > 2 ? mp_obj_get_int(args[2]) : 0;
+    return struct_unpack_ops(self, struct_get_buf(self, args[1], offset, MP_BUFFER_READ));
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(struct_obj_unpack_from_obj, 2, 3, struct_obj_unpack_from);
+
+STATIC mp_obj_t struct_iter_iternext(mp_obj_t self_in) {
+    mp_obj_struct_iter_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_buffer_info_t bufinfo;
+    // looked up again each time, the buffer may have been resized in between
+    mp_get_buffer_raise(self->buf, &bufinfo, MP_BUFFER_READ);
+    if (self->offset + self->st->size > bufinfo.len) {
+        return MP_OBJ_STOP_ITERATION;
+    }
+    byte *p = (byte*)bufinfo.buf + self->offset;
+    self->offset += self->st->size;
+    return struct_unpack_ops(self->st, p);
+}
+
+STATIC const mp_obj_type_t struct_iter_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_iterator,
+    .getiter = mp_identity_getiter,
+    .iternext = struct_iter_iternext,
+};
+
+STATIC mp_obj_t struct_obj_iter_unpack(mp_obj_t self_in, mp_obj_t buf_in) {
+    mp_obj_struct_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_buffer_info_t bufinfo;
+    mp_get_buffer_raise(buf_in, &bufinfo, MP_BUFFER_READ);
+    if (self->size == 0 || bufinfo.len % self->size != 0) {
+        mp_raise_ValueError("buffer size not a multiple of struct size");
+    }
+    mp_obj_struct_iter_t *iter = m_new_obj(mp_obj_struct_iter_t);
+    iter->base.type = &struct_iter_type;
+    iter->st = self;
+    iter->buf = buf_in;
+    iter->offset = 0;
+    return MP_OBJ_FROM_PTR(iter);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_2(struct_obj_iter_unpack_obj, struct_obj_iter_unpack);
+
+STATIC const mp_rom_map_elem_t struct_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_pack), MP_ROM_PTR(&struct_obj_pack_obj) },
+    { MP_ROM_QSTR(MP_QSTR_pack_into), MP_ROM_PTR(&struct_obj_pack_into_obj) },
+    { MP_ROM_QSTR(MP_QSTR_unpack), MP_ROM_PTR(&struct_obj_unpack_from_obj) },
+    { MP_ROM_QSTR(MP_QSTR_unpack_from), MP_ROM_PTR(&struct_obj_unpack_from_obj) },
+    { MP_ROM_QSTR(MP_QSTR_iter_unpack), MP_ROM_PTR(&struct_obj_iter_unpack_obj) },
+};
+STATIC MP_DEFINE_CONST_DICT(struct_locals_dict, struct_locals_dict_table);
+
+STATIC void struct_attr(mp_obj_t self_in, qstr attr, mp_obj_t *dest) {
+    if (dest[0] != MP_OBJ_NULL) {
+        // not a load
+        return;
+    }
+    mp_obj_struct_t *self = MP_OBJ_TO_PTR(self_in);
+    if (attr == MP_QSTR_size) {
+        dest[0] = MP_OBJ_NEW_SMALL_INT(self->size);
+    } else if (attr == MP_QSTR_format) {
+        dest[0] = self->format;
+    } else {
+        mp_map_elem_t *elem = mp_map_lookup((mp_map_t*)&struct_locals_dict.map, MP_OBJ_NEW_QSTR(attr), MP_MAP_LOOKUP);
+        if (elem != NULL) {
+            mp_convert_member_lookup(self_in, &struct_type, elem->value, dest);
+        }
+    }
+}
+
+STATIC const mp_obj_type_t struct_type = {
+    { &mp_type_type },
+    .name = MP_QSTR_Struct,
+    .make_new = struct_make_new,
+    .attr = struct_attr,
+    .locals_dict = (mp_obj_dict_t*)&struct_locals_dict,
+};
+
+#endif // MICROPY_PY_STRUCT_CLASS
+
 STATIC const mp_rom_map_elem_t mp_module_struct_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR___name__), MP_ROM_QSTR(MP_QSTR_ustruct) },
     { MP_ROM_QSTR(MP_QSTR_calcsize), MP_ROM_PTR(&struct_calcsize_obj) },
@@ -255,6 +477,9 @@ STATIC const mp_rom_map_elem_t mp_module_struct_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR_pack_into), MP_ROM_PTR(&struct_pack_into_obj) },
     { MP_ROM_QSTR(MP_QSTR_unpack), MP_ROM_PTR(&struct_unpack_from_obj) },
     { MP_ROM_QSTR(MP_QSTR_unpack_from), MP_ROM_PTR(&struct_unpack_from_obj) },
+    #if MICROPY_PY_STRUCT_CLASS
+    { MP_ROM_QSTR(MP_QSTR_Struct), MP_ROM_PTR(&struct_type) },
+    #endif
 };
 
 STATIC MP_DEFINE_CONST_DICT(mp_module_struct_globals, mp_module_struct_globals_table);
@@ -33,6 +33,7 @@
 #if MICROPY_PY_THREAD
 
 #include "py/mpthread.h"
+#include "py/gc.h"
 
 #if MICROPY_DEBUG_VERBOSE // print debugging info
 #define DEBUG_PRINT (1)
@@ -140,6 +141,51 @@ STATIC mp_obj_t mod_thread_stack_size(size_t n_args, const mp_obj_t *args) {
 }
 STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_thread_stack_size_obj, 0, 1, mod_thread_stack_size);
 
+#if MICROPY_PY_THREAD_CORE_AFFINITY
+STATIC mp_obj_t mod_thread_core_affinity(size_t n_args, const mp_obj_t *args) {
+    mp_obj_t ret = MP_OBJ_NEW_SMALL_INT(mp_thread_get_core_affinity());
+    if (n_args != 0) {
+        mp_thread_set_core_affinity(mp_obj_get_int(args[0]));
+    }
+    return ret;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_thread_core_affinity_obj, 0, 1, mod_thread_core_affinity);
+#endif
+
+#if MICROPY_PY_THREAD_STACK_INFO
+STATIC mp_obj_t mod_thread_stack_info(void) {
+    return mp_thread_stack_info();
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_thread_stack_info_obj, mod_thread_stack_info);
+#endif
+
+#if MICROPY_PY_THREAD_GIL_ADAPTIVE
+STATIC mp_obj_t mod_thread_gil_slice_us(size_t n_args, const mp_obj_t *args) {
+    mp_obj_t ret = mp_obj_new_int_from_uint(MP_STATE_VM(gil_slice_us));
+    if (n_args != 0) {
+        mp_int_t us = mp_obj_get_int(args[0]);
+        if (us < 0) {
+            mp_raise_ValueError(NULL);
+        }
+        MP_STATE_VM(gil_slice_us) = us;
+    }
+    return ret;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_thread_gil_slice_us_obj, 0, 1, mod_thread_gil_slice_us);
+
+// returns (acquires, contended acquires, handoffs, threads waiting now)
+STATIC mp_obj_t mod_thread_gil_stats(void) {
+    mp_obj_t tuple[4] = {
+        mp_obj_new_int_from_uint(MP_STATE_VM(gil_acquires)),
+        mp_obj_new_int_from_uint(MP_STATE_VM(gil_contended)),
+        mp_obj_new_int_from_uint(MP_STATE_VM(gil_handoffs)),
+        MP_OBJ_NEW_SMALL_INT(MP_STATE_VM(gil_waiting)),
+    };
+    return mp_obj_new_tuple(4, tuple);
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_0(mod_thread_gil_stats_obj, mod_thread_gil_stats);
+#endif
+
 typedef struct _thread_entry_args_t {
     mp_obj_dict_t *dict_locals;
     mp_obj_dict_t *dict_globals;
@@ -161,6 +207,20 @@ STATIC void *thread_entry(void *args_in) {
     mp_stack_set_top(&ts + 1); // need to include ts in root-pointer scan
     mp_stack_set_limit(args->stack_size);
 
+    #if MICROPY_TRACK_CODE_STATE
+    ts.current_code_state = NULL;
+    #endif
+
+    #if MICROPY_OPT_CODE_STATE_POOL
+    ts.code_state_pool_len = 0;
+    #endif
+
+    #if MICROPY_GC_THREAD_ALLOC_BUFFER
+    ts.gc_alloc_buf_area = NULL;
+    ts.gc_alloc_buf_busy = false;
+    ts.gc_alloc_buf_listed = false;
+    #endif
+
     #if MICROPY_ENABLE_PYSTACK
     // TODO threading and pystack is not fully supported, for now just make a small stack
     mp_obj_t mini_pystack[128];
@@ -203,6 +263,10 @@ STATIC void *thread_entry(void *args_in) {
 
     DEBUG_printf("[thread] finish ts=%p\n", &ts);
 
+    #if MICROPY_GC_THREAD_ALLOC_BUFFER
+    gc_alloc_buf_release();
+    #endif
+
     // signal that we are finished
     mp_thread_finish();
 
@@ -211,13 +275,37 @@ STATIC void *thread_entry(void *args_in) {
     return NULL;
 }
 
-STATIC mp_obj_t mod_thread_start_new_thread(size_t n_args, const mp_obj_t *args) {
+STATIC mp_obj_t mod_thread_start_new_thread(size_t n_args, const mp_obj_t *args, mp_map_t *kw_args) {
     // This structure holds the Python function and arguments for thread entry.
     // We copy all arguments into this structure to keep ownership of them.
     // We must be very careful about root pointers because this pointer may
     // disappear from our address space before the thread is created.
     thread_entry_args_t *th_args;
 
+    if (n_args > 3) {
+        mp_raise_TypeError("too many args");
+    }
+
+    // per-thread overrides of the stack settings
+    size_t stack_size = thread_stack_size;
+    size_t n_kw_used = 0;
+    mp_map_elem_t *elem = mp_map_lookup(kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_stack_size), MP_MAP_LOOKUP);
+    if (elem != NULL) {
+        stack_size = mp_obj_get_int(elem->value);
+        n_kw_used++;
+    }
+    #if MICROPY_PY_THREAD_STACK_EXT_RAM
+    bool ext_ram = false;
+    elem = mp_map_lookup(kw_args, MP_OBJ_NEW_QSTR(MP_QSTR_psram), MP_MAP_LOOKUP);
+    if (elem != NULL) {
+        ext_ram = mp_obj_is_true(elem->value);
+        n_kw_used++;
+    }
+    #endif
+    if (kw_args->used != n_kw_used) {
+        mp_raise_TypeError("unexpected keyword argument");
+    }
+
     // get positional arguments
     size_t pos_args_len;
     mp_obj_t *pos_args_items;
@@ -254,17 +342,24 @@ STATIC mp_obj_t mod_thread_start_new_thread(size_t n_args, const mp_obj_t *args)
     th_args->dict_globals = mp_globals_get();
 
     // set the stack size to use
-    th_args->stack_size = thread_stack_size;
+    th_args->stack_size = stack_size;
 
     // set the function for thread entry
     th_args->fun = args[0];
 
     // spawn the thread!
-    mp_thread_create(thread_entry, th_args, &th_args->stack_size);
+    #if MICROPY_PY_THREAD_STACK_EXT_RAM
+    if (ext_ram) {
+        mp_thread_create_ext_ram(thread_entry, th_args, &th_args->stack_size);
+    } else
+    #endif
+    {
+        mp_thread_create(thread_entry, th_args, &th_args->stack_size);
+    }
 
     return mp_const_none;
 }
-STATIC MP_DEFINE_CONST_FUN_OBJ_VAR_BETWEEN(mod_thread_start_new_thread_obj, 2, 3, mod_thread_start_new_thread);
+STATIC MP_DEFINE_CONST_FUN_OBJ_KW(mod_thread_start_new_thread_obj, 2, mod_thread_start_new_thread);
 
 STATIC mp_obj_t mod_thread_exit(void) {
     nlr_raise(mp_obj_new_exception(&mp_type_SystemExit));
@@ -283,6 +378,16 @@ STATIC const mp_rom_map_elem_t mp_module_thread_globals_table[] = {
     { MP_ROM_QSTR(MP_QSTR_LockType), MP_ROM_PTR(&mp_type_thread_lock) },
     { MP_ROM_QSTR(MP_QSTR_get_ident), MP_ROM_PTR(&mod_thread_get_ident_obj) },
     { MP_ROM_QSTR(MP_QSTR_stack_size), MP_ROM_PTR(&mod_thread_stack_size_obj) },
+    #if MICROPY_PY_THREAD_CORE_AFFINITY
+    { MP_ROM_QSTR(MP_QSTR_core_affinity), MP_ROM_PTR(&mod_thread_core_affinity_obj) },
+    #endif
+    #if MICROPY_PY_THREAD_STACK_INFO
+    { MP_ROM_QSTR(MP_QSTR_stack_info), MP_ROM_PTR(&mod_thread_stack_info_obj) },
+    #endif
+    #if MICROPY_PY_THREAD_GIL_ADAPTIVE
+    { MP_ROM_QSTR(MP_QSTR_gil_slice_us), MP_ROM_PTR(&mod_thread_gil_slice_us_obj) },
+    { MP_ROM_QSTR(MP_QSTR_gil_stats), MP_ROM_PTR(&mod_thread_gil_stats_obj) },
+    #endif
     { MP_ROM_QSTR(MP_QSTR_start_new_thread), MP_ROM_PTR(&mod_thread_start_new_thread_obj) },
     { MP_ROM_QSTR(MP_QSTR_exit), MP_ROM_PTR(&mod_thread_exit_obj) },
     { MP_ROM_QSTR(MP_QSTR_allocate_lock), MP_ROM_PTR(&mod_thread_allocate_lock_obj) },
@@ -148,6 +148,64 @@
 #define MICROPY_GC_ALLOC_THRESHOLD (1)
 #endif
 
+// Support sweeping the heap lazily after a collection, in slices bounded by
+// gc.pause_budget_us(), run by subsequent allocations.  The mark phase is
+// still done in one go.  Requires mp_hal_ticks_us().
+#ifndef MICROPY_GC_LAZY_SWEEP
+#define MICROPY_GC_LAZY_SWEEP (0)
+#endif
+
+// Initial value of gc.pause_budget_us(), 0 sweeps the whole heap at once
+#ifndef MICROPY_GC_PAUSE_BUDGET_US
+#define MICROPY_GC_PAUSE_BUDGET_US (0)
+#endif
+
+// Whether the GC heap can be made of several areas, added with gc_add() after
+// gc_init().  The area given to gc_init() is treated as the fast one: small
+// allocations and those with GC_ALLOC_FLAG_FAST are served from it first,
+// larger ones from the other areas first.
+#ifndef MICROPY_GC_SPLIT_HEAP
+#define MICROPY_GC_SPLIT_HEAP (0)
+#endif
+
+// Allocations up to this many bytes prefer the first (fast) heap area
+#ifndef MICROPY_GC_SPLIT_HEAP_SMALL_BYTES
+#define MICROPY_GC_SPLIT_HEAP_SMALL_BYTES (64)
+#endif
+
+// Whether each thread carves its small allocations out of a buffer of blocks
+// claimed in one go, without taking gc_mutex.  Only useful without the GIL.
+#ifndef MICROPY_GC_THREAD_ALLOC_BUFFER
+#define MICROPY_GC_THREAD_ALLOC_BUFFER (0)
+#endif
+
+// Number of blocks in each thread allocation buffer
+#ifndef MICROPY_GC_THREAD_ALLOC_BUFFER_BLOCKS
+#define MICROPY_GC_THREAD_ALLOC_BUFFER_BLOCKS (64)
+#endif
+
+// Whether the mark phase is shared with a helper on another CPU, started by
+// the port in gc_helper_start().  Only the collector traces the roots.
+#ifndef MICROPY_GC_PARALLEL_MARK
+#define MICROPY_GC_PARALLEL_MARK (0)
+#endif
+
+// Whether the sweep records free runs of 1, 2 and 4 blocks in per-area
+// lists, so that small allocations don't need to scan the allocation table
+#ifndef MICROPY_GC_FREE_LISTS
+#define MICROPY_GC_FREE_LISTS (0)
+#endif
+
+// Number of entries in each of the free lists
+#ifndef MICROPY_GC_FREE_LIST_LEN
+#define MICROPY_GC_FREE_LIST_LEN (32)
+#endif
+
+// Whether gc_realloc counts how it resized chunks, read with gc.realloc_stats()
+#ifndef MICROPY_GC_REALLOC_STATS
+#define MICROPY_GC_REALLOC_STATS (0)
+#endif
+
 // Number of bytes to allocate initially when creating new chunks to store
 // interned string data.  Smaller numbers lead to more chunks being needed
 // and more wastage at the end of the chunk.  Larger numbers lead to wasted
@@ -236,6 +294,12 @@
 #define MICROPY_QSTR_BYTES_IN_HASH (2)
 #endif
 
+// Whether to keep a hash index of all qstrs, so looking one up doesn't search
+// every pool.  Costs 2 bytes of heap per slot, with at most 3/4 of slots used.
+#ifndef MICROPY_QSTR_HASH_INDEX
+#define MICROPY_QSTR_HASH_INDEX (0)
+#endif
+
 // Avoid using C stack when making Python function calls. C stack still
 // may be used if there's no free heap.
 #ifndef MICROPY_STACKLESS
@@ -318,13 +382,25 @@
 #define MICROPY_EMIT_XTENSA (0)
 #endif
 
+// Whether to emit Xtensa-Windowed native code
+#ifndef MICROPY_EMIT_XTENSAWIN
+#define MICROPY_EMIT_XTENSAWIN (0)
+#endif
+
 // Whether to enable the Xtensa inline assembler
 #ifndef MICROPY_EMIT_INLINE_XTENSA
 #define MICROPY_EMIT_INLINE_XTENSA (0)
 #endif
 
 // Convenience definition for whether any native emitter is enabled
-#define MICROPY_EMIT_NATIVE (MICROPY_EMIT_X64 || MICROPY_EMIT_X86 || MICROPY_EMIT_THUMB || MICROPY_EMIT_ARM || MICROPY_EMIT_XTENSA)
+#define MICROPY_EMIT_NATIVE (MICROPY_EMIT_X64 || MICROPY_EMIT_X86 || MICROPY_EMIT_THUMB || MICROPY_EMIT_ARM || MICROPY_EMIT_XTENSA || MICROPY_EMIT_XTENSAWIN)
+
+// Some architectures cannot read byte-wise from executable memory.  In this case
+// the prelude for a native function (which usually sits after the machine code)
+// must be separated out into its own, readable bytes object.
+#ifndef MICROPY_EMIT_NATIVE_PRELUDE_AS_BYTES_OBJ
+#define MICROPY_EMIT_NATIVE_PRELUDE_AS_BYTES_OBJ (MICROPY_EMIT_XTENSAWIN)
+#endif
 
 // Convenience definition for whether any inline assembler emitter is enabled
 #define MICROPY_EMIT_INLINE_ASM (MICROPY_EMIT_INLINE_THUMB || MICROPY_EMIT_INLINE_XTENSA)
@@ -442,12 +518,98 @@
 #define MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE (0)
 #endif
 
+// Whether to keep a global cache of the slot each key was last found at in
+// any map.  Unlike MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE it doesn't need
+// writable bytecode, so it also works for frozen code, and it covers every
+// lookup (LOAD_METHOD, STORE_ATTR, dict access, ...).  Uses
+// MICROPY_OPT_MAP_LOOKUP_CACHE_SIZE bytes of RAM.
+#ifndef MICROPY_OPT_MAP_LOOKUP_CACHE
+#define MICROPY_OPT_MAP_LOOKUP_CACHE (0)
+#endif
+
+#ifndef MICROPY_OPT_MAP_LOOKUP_CACHE_SIZE
+#define MICROPY_OPT_MAP_LOOKUP_CACHE_SIZE (128)
+#endif
+
+// Whether each thread keeps the last few heap allocated bytecode frames of
+// returned calls for reuse, instead of freeing them and allocating again on
+// the next call.  Costs MICROPY_OPT_CODE_STATE_POOL_LEN * 2 + 1 words per
+// thread state, and pooled frames keep their heap blocks.
+#ifndef MICROPY_OPT_CODE_STATE_POOL
+#define MICROPY_OPT_CODE_STATE_POOL (0)
+#endif
+
+#ifndef MICROPY_OPT_CODE_STATE_POOL_LEN
+#define MICROPY_OPT_CODE_STATE_POOL_LEN (4)
+#endif
+
+// Whether a finished generator shrinks its object back to the header, so that
+// the frame and what its locals refer to can be reclaimed while the generator
+// object itself is still referenced.
+#ifndef MICROPY_OPT_GENERATOR_SHRINK
+#define MICROPY_OPT_GENERATOR_SHRINK (0)
+#endif
+
+// Whether the compiler passes parameters that are closed over but never
+// rebound, by the function or through nonlocal, to the closures by value.
+// Such a parameter needs no cell, and the closures load it with LOAD_FAST.
+#ifndef MICROPY_OPT_CLOSURE_BY_VALUE
+#define MICROPY_OPT_CLOSURE_BY_VALUE (0)
+#endif
+
+// Whether to keep a direct mapped cache of the class, along the MRO, where an
+// attribute of a class or instance was found.  Saves walking the bases and
+// probing their dicts on each method call.  Uses 16 bytes per entry on 32-bit
+// targets, the number of entries must be a power of 2.
+#ifndef MICROPY_OPT_TYPE_ATTR_CACHE
+#define MICROPY_OPT_TYPE_ATTR_CACHE (0)
+#endif
+
+#ifndef MICROPY_OPT_TYPE_ATTR_CACHE_SIZE
+#define MICROPY_OPT_TYPE_ATTR_CACHE_SIZE (64)
+#endif
+
+// Whether hash tables of maps (dicts, instance members, globals) are stored
+// like CPython's: a dense array of entries in insertion order plus an index
+// of 1, 2 or 4 bytes per slot kept at most two thirds full.  Probes stay short
+// and dicts iterate in insertion order, for about 1.5 more bytes per entry.
+#ifndef MICROPY_OPT_MAP_COMPACT
+#define MICROPY_OPT_MAP_COMPACT (0)
+#endif
+
+// Whether the VM handles comparisons, add, subtract and bitwise ops on two
+// small ints, and arithmetic on floats, inline instead of calling
+// mp_binary_op.  Costs a few hundred bytes of code in the VM loop.
+#ifndef MICROPY_OPT_VM_BINARY_OP_FAST_PATH
+#define MICROPY_OPT_VM_BINARY_OP_FAST_PATH (0)
+#endif
+
+// Whether the bytecode emitter fuses common instruction pairs (LOAD_FAST +
+// LOAD_ATTR, a small int constant + arithmetic op, comparison + POP_JUMP_IF)
+// into single instructions, saving a dispatch each.  The VM understands the
+// fused instructions regardless, so this only affects the compiler.
+#ifndef MICROPY_OPT_BYTECODE_PEEPHOLE
+#define MICROPY_OPT_BYTECODE_PEEPHOLE (0)
+#endif
+
 // Whether to use fast versions of bitwise operations (and, or, xor) when the
 // arguments are both positive.  Increases Thumb2 code size by about 250 bytes.
 #ifndef MICROPY_OPT_MPZ_BITWISE
 #define MICROPY_OPT_MPZ_BITWISE (0)
 #endif
 
+// Whether to multiply large mpz integers using Karatsuba's method once both
+// operands have at least MPZ_KARATSUBA_THRESHOLD digits.
+#ifndef MICROPY_OPT_MPZ_KARATSUBA
+#define MICROPY_OPT_MPZ_KARATSUBA (0)
+#endif
+
+// Whether pow(a, b, m) with an odd modulus uses Montgomery multiplication,
+// avoiding a long division after every step of the exponentiation.
+#ifndef MICROPY_OPT_MPZ_POW3_MONTGOMERY
+#define MICROPY_OPT_MPZ_POW3_MONTGOMERY (0)
+#endif
+
 
 // Whether math.factorial is large, fast and recursive (1) or small and slow (0).
 #ifndef MICROPY_OPT_MATH_FACTORIAL
@@ -474,6 +636,11 @@
 #define MICROPY_READER_VFS (0)
 #endif
 
+// Size of the chunks the VFS reader reads files in
+#ifndef MICROPY_READER_VFS_BUF_SIZE
+#define MICROPY_READER_VFS_BUF_SIZE (24)
+#endif
+
 // Whether any readers have been defined
 #ifndef MICROPY_HAS_FILE_READER
 #define MICROPY_HAS_FILE_READER (MICROPY_READER_POSIX || MICROPY_READER_VFS)
@@ -537,6 +704,13 @@
 #define MICROPY_KBD_EXCEPTION (0)
 #endif
 
+// Whether mp_raise_prealloc reuses exception objects kept in the VM state,
+// which don't record a traceback, instead of allocating a new exception each
+// time.  For exceptions raised in polling loops, like EAGAIN from sockets.
+#ifndef MICROPY_ENABLE_PREALLOC_EXCEPTIONS
+#define MICROPY_ENABLE_PREALLOC_EXCEPTIONS (0)
+#endif
+
 // Prefer to raise KeyboardInterrupt asynchronously (from signal or interrupt
 // handler) - if supported by a particular port.
 #ifndef MICROPY_ASYNC_KBD_INTR
@@ -645,6 +819,13 @@ typedef double mp_float_t;
 #define MICROPY_PY_BUILTINS_COMPLEX (MICROPY_PY_BUILTINS_FLOAT)
 #endif
 
+// Whether repr() of a float, and so str(), "{}".format() and ujson.dumps(), prints the
+// shortest digits that read back to the same value instead of rounding to 7 digits.
+// Only used with MICROPY_FLOAT_IMPL_FLOAT and an object representation other than C.
+#ifndef MICROPY_FLOAT_SHORTEST_REPR
+#define MICROPY_FLOAT_SHORTEST_REPR (0)
+#endif
+
 // Whether to provide a high-quality hash for float and complex numbers.
 // Otherwise the default is a very simple but correct hashing function.
 #ifndef MICROPY_FLOAT_HIGH_QUALITY_HASH
@@ -704,9 +885,32 @@ typedef double mp_float_t;
 #define MICROPY_MODULE_FROZEN_MPY (0)
 #endif
 
+// Whether frozen modules are supported in the form of an image built at run
+// time, which is executed in place from memory-mapped flash.  The port
+// provides the image with mp_hal_xip_image(); requires
+// MICROPY_PERSISTENT_CODE_LOAD and MICROPY_PERSISTENT_CODE_SAVE.
+#ifndef MICROPY_MODULE_FROZEN_XIP
+#define MICROPY_MODULE_FROZEN_XIP (0)
+#endif
+
+// Whether an imported module that runs out of memory while being compiled as
+// a whole is compiled and executed again one top-level statement at a time,
+// so the peak heap use is that of its largest statement
+#ifndef MICROPY_PARSE_STREAMING
+#define MICROPY_PARSE_STREAMING (0)
+#endif
+
+// Whether compiled .py modules are cached as .mpy files, in a __pycache__
+// directory next to the source, and loaded from there while the size and
+// mtime of the source stay the same; requires MICROPY_VFS,
+// MICROPY_PERSISTENT_CODE_LOAD and MICROPY_PERSISTENT_CODE_SAVE.
+#ifndef MICROPY_MODULE_COMPILE_CACHE
+#define MICROPY_MODULE_COMPILE_CACHE (0)
+#endif
+
 // Convenience macro for whether frozen modules are supported
 #ifndef MICROPY_MODULE_FROZEN
-#define MICROPY_MODULE_FROZEN (MICROPY_MODULE_FROZEN_STR || MICROPY_MODULE_FROZEN_MPY)
+#define MICROPY_MODULE_FROZEN (MICROPY_MODULE_FROZEN_STR || MICROPY_MODULE_FROZEN_MPY || MICROPY_MODULE_FROZEN_XIP)
 #endif
 
 // Whether you can override builtins in the builtins module
@@ -758,6 +962,17 @@ typedef double mp_float_t;
 #define MICROPY_VFS_FAT (0)
 #endif
 
+// Number of entries in the cache of import stat results, 0 to disable;
+// the cache is flushed by any write, mount or chdir made through the VFS
+#ifndef MICROPY_VFS_IMPORT_STAT_CACHE
+#define MICROPY_VFS_IMPORT_STAT_CACHE (0)
+#endif
+
+// Whether FatFS operations on native block devices release the GIL
+#ifndef MICROPY_VFS_FAT_RELEASE_GIL
+#define MICROPY_VFS_FAT_RELEASE_GIL (0)
+#endif
+
 /*****************************************************************************/
 /* Fine control over Python builtins, classes, modules, etc                  */
 
@@ -1021,6 +1236,35 @@ typedef double mp_float_t;
 #define MICROPY_PY_MICROPYTHON_STACK_USE (MICROPY_PY_MICROPYTHON_MEM_INFO)
 #endif
 
+// Whether to provide "micropython.alloc_stats", which once enabled counts
+// heap allocations by the source line doing them and keeps a history of the
+// largest free block after each collection.  Lines need MICROPY_ENABLE_SOURCE_LINE.
+#ifndef MICROPY_PY_MICROPYTHON_ALLOC_STATS
+#define MICROPY_PY_MICROPYTHON_ALLOC_STATS (0)
+#endif
+
+// Number of allocation sites tracked, the last one collects all the others
+#ifndef MICROPY_ALLOC_STATS_SITES
+#define MICROPY_ALLOC_STATS_SITES (32)
+#endif
+
+// Number of collections the free memory history goes back
+#ifndef MICROPY_ALLOC_STATS_HISTORY
+#define MICROPY_ALLOC_STATS_HISTORY (16)
+#endif
+
+// Whether to provide "micropython.profile_start" and "profile_stop", a
+// sampling profiler that records the line being executed every time a port
+// timer fires (see mp_hal_profile_timer).  Lines need MICROPY_ENABLE_SOURCE_LINE.
+#ifndef MICROPY_PY_MICROPYTHON_PROFILE
+#define MICROPY_PY_MICROPYTHON_PROFILE (0)
+#endif
+
+// Whether each thread keeps track of the bytecode it is executing
+#ifndef MICROPY_TRACK_CODE_STATE
+#define MICROPY_TRACK_CODE_STATE (MICROPY_PY_MICROPYTHON_ALLOC_STATS || MICROPY_PY_MICROPYTHON_PROFILE)
+#endif
+
 // Whether to provide "array" module. Note that large chunk of the
 // underlying code is shared with "bytearray" builtin type, so to
 // get real savings, it should be disabled too.
@@ -1090,6 +1334,12 @@ typedef double mp_float_t;
 #define MICROPY_PY_GC_COLLECT_RETVAL (0)
 #endif
 
+// Whether to provide gc.defrag(), that moves the storage of lists, bytearrays
+// and arrays down the heap
+#ifndef MICROPY_PY_GC_DEFRAG
+#define MICROPY_PY_GC_DEFRAG (0)
+#endif
+
 // Whether to provide "io" module
 #ifndef MICROPY_PY_IO
 #define MICROPY_PY_IO (1)
@@ -1121,16 +1371,31 @@ typedef double mp_float_t;
 #define MICROPY_PY_IO_BYTESIO (1)
 #endif
 
+// Whether to provide "io.BytesBuilder" class, a BytesIO to assemble messages
+#ifndef MICROPY_PY_IO_BYTESBUILDER
+#define MICROPY_PY_IO_BYTESBUILDER (0)
+#endif
+
 // Whether to provide "io.BufferedWriter" class
 #ifndef MICROPY_PY_IO_BUFFEREDWRITER
 #define MICROPY_PY_IO_BUFFEREDWRITER (0)
 #endif
 
+// Whether to provide "io.BufferedReader" class
+#ifndef MICROPY_PY_IO_BUFFEREDREADER
+#define MICROPY_PY_IO_BUFFEREDREADER (0)
+#endif
+
 // Whether to provide "struct" module
 #ifndef MICROPY_PY_STRUCT
 #define MICROPY_PY_STRUCT (1)
 #endif
 
+// Whether to provide "struct.Struct" class, which parses its format only once
+#ifndef MICROPY_PY_STRUCT_CLASS
+#define MICROPY_PY_STRUCT_CLASS (0)
+#endif
+
 // Whether to provide "sys" module
 #ifndef MICROPY_PY_SYS
 #define MICROPY_PY_SYS (1)
@@ -1188,6 +1453,12 @@ typedef double mp_float_t;
 #define MICROPY_PY_USELECT (0)
 #endif
 
+// Whether the port provides mp_uselect_port_wait() to block while nothing is
+// ready, rather than uselect spinning on MICROPY_EVENT_POLL_HOOK
+#ifndef MICROPY_PY_USELECT_PORT_WAIT
+#define MICROPY_PY_USELECT_PORT_WAIT (0)
+#endif
+
 // Whether to provide "utime" module functions implementation
 // in terms of mp_hal_* functions.
 #ifndef MICROPY_PY_UTIME_MP_HAL
@@ -1221,6 +1492,37 @@ typedef double mp_float_t;
 #define MICROPY_PY_THREAD_GIL_VM_DIVISOR (32)
 #endif
 
+// Whether the GIL is only handed over when another thread is waiting for it,
+// after the holder has run for its time slice (or at once for a thread that
+// comes back from blocking I/O), rather than on every VM divisor expiry.
+// Requires the port to implement mp_thread_gil_{enter,should_yield,handoff}.
+#ifndef MICROPY_PY_THREAD_GIL_ADAPTIVE
+#define MICROPY_PY_THREAD_GIL_ADAPTIVE (0)
+#endif
+
+// Default GIL time slice in microseconds, see _thread.gil_slice_us()
+#ifndef MICROPY_PY_THREAD_GIL_SLICE_US
+#define MICROPY_PY_THREAD_GIL_SLICE_US (2000)
+#endif
+
+// Whether to provide "_thread.core_affinity" to select the CPU core new threads
+// run on; requires the port to implement mp_thread_{get,set}_core_affinity
+#ifndef MICROPY_PY_THREAD_CORE_AFFINITY
+#define MICROPY_PY_THREAD_CORE_AFFINITY (0)
+#endif
+
+// Whether to provide "_thread.stack_info" reporting the stack size and usage of
+// each thread and system task; requires the port to implement mp_thread_stack_info
+#ifndef MICROPY_PY_THREAD_STACK_INFO
+#define MICROPY_PY_THREAD_STACK_INFO (0)
+#endif
+
+// Whether "_thread.start_new_thread" accepts psram=True to put the new thread's
+// stack in external RAM; requires the port to implement mp_thread_create_ext_ram
+#ifndef MICROPY_PY_THREAD_STACK_EXT_RAM
+#define MICROPY_PY_THREAD_STACK_EXT_RAM (0)
+#endif
+
 // Extended modules
 
 #ifndef MICROPY_PY_UCTYPES
@@ -1237,6 +1539,11 @@ typedef double mp_float_t;
 #define MICROPY_PY_UZLIB (0)
 #endif
 
+// Whether to provide uzlib.CompIO, a streaming static Huffman compressor
+#ifndef MICROPY_PY_UZLIB_COMPRESS
+#define MICROPY_PY_UZLIB_COMPRESS (0)
+#endif
+
 #ifndef MICROPY_PY_UJSON
 #define MICROPY_PY_UJSON (0)
 #endif
@@ -1257,6 +1564,17 @@ typedef double mp_float_t;
 #define MICROPY_PY_URE_SUB (0)
 #endif
 
+// Number of patterns compiled by the module-level ure functions that are kept for
+// the next calls (0 to compile them each time)
+#ifndef MICROPY_PY_URE_CACHE_SIZE
+#define MICROPY_PY_URE_CACHE_SIZE (0)
+#endif
+
+// Whether to provide the match_spans() and search_spans() methods of compiled regexes
+#ifndef MICROPY_PY_URE_SPANS
+#define MICROPY_PY_URE_SPANS (0)
+#endif
+
 #ifndef MICROPY_PY_UHEAPQ
 #define MICROPY_PY_UHEAPQ (0)
 #endif
@@ -1344,10 +1662,27 @@ typedef double mp_float_t;
 #define MICROPY_PY_FRAMEBUF (0)
 #endif
 
+// Whether to provide the "uvector" module of elementwise operations on arrays
+#ifndef MICROPY_PY_UVECTOR
+#define MICROPY_PY_UVECTOR (0)
+#endif
+
 #ifndef MICROPY_PY_BTREE
 #define MICROPY_PY_BTREE (0)
 #endif
 
+// Page cache in bytes for a btree database opened without a cachesize, 0
+// leaves it to the library (its minimum number of pages)
+#ifndef MICROPY_PY_BTREE_DEFAULT_CACHESIZE
+#define MICROPY_PY_BTREE_DEFAULT_CACHESIZE (0)
+#endif
+
+// Number of changes after which a btree database syncs itself to its stream
+// when opened without an autosync, 0 to only sync on flush() and close()
+#ifndef MICROPY_PY_BTREE_AUTOSYNC
+#define MICROPY_PY_BTREE_AUTOSYNC (0)
+#endif
+
 /*****************************************************************************/
 /* Hooks for a port to add builtins                                          */
 
@@ -70,6 +70,19 @@ mp_uint_t mp_hal_ticks_us(void);
 mp_uint_t mp_hal_ticks_cpu(void);
 #endif
 
+#if MICROPY_MODULE_FROZEN_XIP
+// Memory-mapped execute-in-place image and the size of its region, or NULL
+const uint8_t *mp_hal_xip_image(size_t *max_len);
+#endif
+
+#if MICROPY_PY_MICROPYTHON_PROFILE
+// Calls mp_micropython_profile_sample() every period_us from a timer, a
+// period of 0 stops it.  The callback may run in an interrupt.
+void mp_hal_profile_timer(mp_uint_t period_us);
+// Takes one sample of what the profiled thread is executing
+void mp_micropython_profile_sample(void);
+#endif
+
 // If port HAL didn't define its own pin API, use generic
 // "virtual pin" API from the core.
 #ifndef mp_hal_pin_obj_t
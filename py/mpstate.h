@@ -47,6 +47,9 @@ typedef struct mp_dynamic_compiler_t {
     bool opt_cache_map_lookup_in_bytecode;
     bool py_builtins_str_unicode;
     uint8_t native_arch;
+    #if MICROPY_COMP_CONST
+    mp_map_t *predef_consts; // names folded as if assigned with const(), or NULL
+    #endif
 } mp_dynamic_compiler_t;
 extern mp_dynamic_compiler_t mp_dynamic_compiler;
 #endif
@@ -61,12 +64,29 @@ typedef struct _mp_sched_item_t {
     mp_obj_t arg;
 } mp_sched_item_t;
 
-// This structure hold information about the memory allocation system.
-typedef struct _mp_state_mem_t {
-    #if MICROPY_MEM_STATS
-    size_t total_bytes_allocated;
-    size_t current_bytes_allocated;
-    size_t peak_bytes_allocated;
+#if MICROPY_PY_MICROPYTHON_ALLOC_STATS
+// Allocations counted against one source line, source_file is MP_QSTR_NULL
+// for those made outside bytecode or that didn't fit in the table.
+typedef struct _mp_alloc_site_t {
+    qstr source_file;
+    qstr block_name;
+    size_t source_line;
+    size_t count;
+    size_t bytes;
+} mp_alloc_site_t;
+
+// State of the heap once a collection has been swept
+typedef struct _mp_alloc_frag_t {
+    size_t collection;
+    size_t free;
+    size_t max_free;
+} mp_alloc_frag_t;
+#endif
+
+// This structure holds the layout of one contiguous region of the GC heap.
+typedef struct _mp_state_mem_area_t {
+    #if MICROPY_GC_SPLIT_HEAP
+    struct _mp_state_mem_area_t *next;
     #endif
 
     byte *gc_alloc_table_start;
@@ -77,10 +97,45 @@ typedef struct _mp_state_mem_t {
     byte *gc_pool_start;
     byte *gc_pool_end;
 
+    size_t gc_last_free_atb_index;
+
+    #if MICROPY_GC_LAZY_SWEEP
+    // blocks from gc_sweep_block onwards are still to be swept
+    size_t gc_sweep_block;
+    bool gc_sweep_free_tail;
+    #endif
+
+    #if MICROPY_GC_FREE_LISTS
+    // first blocks of free runs of 1, 2 and 4 blocks, possibly stale
+    size_t gc_free_list[3][MICROPY_GC_FREE_LIST_LEN];
+    uint16_t gc_free_list_len[3];
+    #endif
+} mp_state_mem_area_t;
+
+// This structure hold information about the memory allocation system.
+typedef struct _mp_state_mem_t {
+    #if MICROPY_MEM_STATS
+    size_t total_bytes_allocated;
+    size_t current_bytes_allocated;
+    size_t peak_bytes_allocated;
+    #endif
+
+    // the area passed to gc_init, followed by those from gc_add
+    mp_state_mem_area_t area;
+
     int gc_stack_overflow;
     MICROPY_GC_STACK_ENTRY_TYPE gc_stack[MICROPY_ALLOC_GC_STACK_SIZE];
+    #if MICROPY_GC_SPLIT_HEAP
+    // the area each block on gc_stack belongs to
+    mp_state_mem_area_t *gc_area_stack[MICROPY_ALLOC_GC_STACK_SIZE];
+    #endif
     uint16_t gc_lock_depth;
 
+    #if MICROPY_GC_THREAD_ALLOC_BUFFER
+    // the threads that took an allocation buffer
+    struct _mp_state_thread_t *gc_alloc_buf_threads;
+    #endif
+
     // This variable controls auto garbage collection.  If set to 0 then the
     // GC won't automatically run when gc_alloc can't find enough blocks.  But
     // you can still allocate/free memory and also explicitly call gc_collect.
@@ -91,18 +146,54 @@ typedef struct _mp_state_mem_t {
     size_t gc_alloc_threshold;
     #endif
 
-    size_t gc_last_free_atb_index;
+    #if MICROPY_GC_LAZY_SWEEP
+    size_t gc_sweep_budget_us;
+    #endif
+
+    #if MICROPY_GC_FREE_LISTS
+    // small allocations served from the free lists, and those that weren't
+    size_t gc_free_list_hits;
+    size_t gc_free_list_misses;
+    #endif
+
+    #if MICROPY_PY_MICROPYTHON_ALLOC_STATS
+    bool alloc_stats_enabled;
+    size_t alloc_stats_n_sites;
+    mp_alloc_site_t alloc_stats_sites[MICROPY_ALLOC_STATS_SITES];
+    // ring buffer, alloc_stats_collections counts all the samples ever taken
+    size_t alloc_stats_collections;
+    mp_alloc_frag_t alloc_stats_history[MICROPY_ALLOC_STATS_HISTORY];
+    #endif
 
     #if MICROPY_PY_GC_COLLECT_RETVAL
     size_t gc_collected;
     #endif
 
+    #if MICROPY_GC_REALLOC_STATS
+    // how the reallocations that changed the number of blocks were done
+    size_t gc_realloc_in_place;
+    size_t gc_realloc_backward;
+    size_t gc_realloc_moved;
+    size_t gc_realloc_shrunk;
+    size_t gc_realloc_defrag;
+    #endif
+
     #if MICROPY_PY_THREAD
     // This is a global mutex used to make the GC thread-safe.
     mp_thread_mutex_t gc_mutex;
     #endif
 } mp_state_mem_t;
 
+#if MICROPY_OPT_TYPE_ATTR_CACHE
+// where an attribute looked up from a class was found, and its raw value
+typedef struct _mp_type_attr_cache_entry_t {
+    const mp_obj_type_t *type;
+    qstr attr;
+    const mp_obj_type_t *found;
+    mp_obj_t value;
+} mp_type_attr_cache_entry_t;
+#endif
+
 // This structure hold runtime and VM information.  It includes a section
 // which contains root pointers that must be scanned by the GC.
 typedef struct _mp_state_vm_t {
@@ -115,6 +206,10 @@ typedef struct _mp_state_vm_t {
 
     qstr_pool_t *last_pool;
 
+    #if MICROPY_QSTR_HASH_INDEX
+    qstr_index_t *qstr_index;
+    #endif
+
     // non-heap memory for creating an exception if we can't allocate RAM
     mp_obj_exception_t mp_emergency_exception_obj;
 
@@ -134,6 +229,11 @@ typedef struct _mp_state_vm_t {
     mp_obj_exception_t mp_kbd_exception;
     #endif
 
+    #if MICROPY_ENABLE_PREALLOC_EXCEPTIONS
+    // exception objects reused by mp_raise_prealloc
+    mp_obj_exception_t mp_prealloc_exc[MP_PREALLOC_EXC_NUM];
+    #endif
+
     // dictionary with loaded modules (may be exposed as sys.modules)
     mp_obj_dict_t mp_loaded_modules_dict;
 
@@ -178,11 +278,21 @@ typedef struct _mp_state_vm_t {
     mp_obj_t lwip_slip_stream;
     #endif
 
+    #if MICROPY_PY_URE && MICROPY_PY_URE_CACHE_SIZE
+    // pairs of pattern and compiled regex, most recently used first
+    mp_obj_t ure_cache[MICROPY_PY_URE_CACHE_SIZE * 2];
+    #endif
+
     #if MICROPY_VFS
     struct _mp_vfs_mount_t *vfs_cur;
     struct _mp_vfs_mount_t *vfs_mount_table;
     #endif
 
+    #if MICROPY_PY_MICROPYTHON_PROFILE
+    // samples of the profiler, holding on to the functions they refer to
+    struct _mp_profile_sample_t *profile_buf;
+    #endif
+
     //
     // END ROOT POINTER SECTION
     ////////////////////////////////////////////////////////////
@@ -202,6 +312,17 @@ typedef struct _mp_state_vm_t {
     mp_uint_t mp_optimise_value;
     #endif
 
+    #if MICROPY_OPT_MAP_LOOKUP_CACHE
+    // last known slot of a key, indexed by the key, shared by all maps
+    uint8_t map_lookup_cache[MICROPY_OPT_MAP_LOOKUP_CACHE_SIZE];
+    #endif
+
+    #if MICROPY_OPT_TYPE_ATTR_CACHE
+    // not scanned by the GC: an entry is only used for a live type, and is
+    // cleared when a type is created or a class attribute stored or deleted
+    mp_type_attr_cache_entry_t type_attr_cache[MICROPY_OPT_TYPE_ATTR_CACHE_SIZE];
+    #endif
+
     // size of the emergency exception buf, if it's dynamically allocated
     #if MICROPY_ENABLE_EMERGENCY_EXCEPTION_BUF && MICROPY_EMERGENCY_EXCEPTION_BUF_SIZE == 0
     mp_int_t mp_emergency_exception_buf_size;
@@ -216,6 +337,16 @@ typedef struct _mp_state_vm_t {
     #if MICROPY_PY_THREAD_GIL
     // This is a global mutex used to make the VM/runtime thread-safe.
     mp_thread_mutex_t gil_mutex;
+    #if MICROPY_PY_THREAD_GIL_ADAPTIVE
+    // threads blocked on gil_mutex, and how many of them return from I/O
+    volatile uint16_t gil_waiting;
+    volatile uint16_t gil_io_waiting;
+    uint32_t gil_slice_start;
+    uint32_t gil_slice_us;
+    uint32_t gil_acquires;
+    uint32_t gil_contended;
+    uint32_t gil_handoffs;
+    #endif
     #endif
 } mp_state_vm_t;
 
@@ -235,6 +366,22 @@ typedef struct _mp_state_thread_t {
     uint8_t *pystack_cur;
     #endif
 
+    #if MICROPY_TRACK_CODE_STATE
+    // the bytecode being executed, if any
+    struct _mp_code_state_t *current_code_state;
+    #endif
+
+    #if MICROPY_GC_THREAD_ALLOC_BUFFER
+    // the buffer small allocations are carved from, none if the area is NULL
+    mp_state_mem_area_t *volatile gc_alloc_buf_area;
+    size_t gc_alloc_buf_start;
+    size_t gc_alloc_buf_block;
+    size_t gc_alloc_buf_end;
+    volatile bool gc_alloc_buf_busy;
+    bool gc_alloc_buf_listed;
+    struct _mp_state_thread_t *gc_alloc_buf_next;
+    #endif
+
     ////////////////////////////////////////////////////////////
     // START ROOT POINTER SECTION
     // Everything that needs GC scanning must start here, and
@@ -245,6 +392,13 @@ typedef struct _mp_state_thread_t {
     mp_obj_dict_t *dict_globals;
 
     nlr_buf_t *nlr_top;
+
+    #if MICROPY_OPT_CODE_STATE_POOL
+    // heap allocated frames of returned calls, kept for the next ones
+    size_t code_state_pool_len;
+    struct _mp_code_state_t *code_state_pool[MICROPY_OPT_CODE_STATE_POOL_LEN];
+    size_t code_state_pool_size[MICROPY_OPT_CODE_STATE_POOL_LEN];
+    #endif
 } mp_state_thread_t;
 
 // This structure combines the above 3 structures.
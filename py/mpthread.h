@@ -46,12 +46,32 @@ void mp_thread_finish(void);
 void mp_thread_mutex_init(mp_thread_mutex_t *mutex);
 int mp_thread_mutex_lock(mp_thread_mutex_t *mutex, int wait);
 void mp_thread_mutex_unlock(mp_thread_mutex_t *mutex);
+#if MICROPY_PY_THREAD_CORE_AFFINITY
+// core is a CPU core number, or -1 to let new threads run on any core
+int mp_thread_get_core_affinity(void);
+void mp_thread_set_core_affinity(int core);
+#endif
+#if MICROPY_PY_THREAD_STACK_INFO
+// returns a list of (name, ident, stack size, minimum free) tuples, sizes in bytes
+mp_obj_t mp_thread_stack_info(void);
+#endif
+#if MICROPY_PY_THREAD_STACK_EXT_RAM
+void mp_thread_create_ext_ram(void *(*entry)(void*), void *arg, size_t *stack_size);
+#endif
 
 #endif // MICROPY_PY_THREAD
 
 #if MICROPY_PY_THREAD && MICROPY_PY_THREAD_GIL
 #include "py/mpstate.h"
+#if MICROPY_PY_THREAD_GIL_ADAPTIVE
+void mp_thread_gil_enter(void);
+bool mp_thread_gil_should_yield(void);
+void mp_thread_gil_handoff(void);
+#define MP_THREAD_GIL_ENTER() mp_thread_gil_enter()
+#define MP_THREAD_GIL_SHOULD_YIELD() (MP_STATE_VM(gil_waiting) && mp_thread_gil_should_yield())
+#else
 #define MP_THREAD_GIL_ENTER() mp_thread_mutex_lock(&MP_STATE_VM(gil_mutex), 1)
+#endif
 #define MP_THREAD_GIL_EXIT() mp_thread_mutex_unlock(&MP_STATE_VM(gil_mutex))
 #else
 #define MP_THREAD_GIL_ENTER()
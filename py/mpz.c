@@ -36,6 +36,11 @@
 #define DIG_MSB  (MPZ_LONG_1 << (DIG_SIZE - 1))
 #define DIG_BASE (MPZ_LONG_1 << DIG_SIZE)
 
+// minimum number of digits in both operands for Karatsuba multiplication
+#ifndef MPZ_KARATSUBA_THRESHOLD
+#define MPZ_KARATSUBA_THRESHOLD (64)
+#endif
+
 /*
  mpz is an arbitrary precision integer type with a public API.
 
@@ -449,6 +454,151 @@ STATIC size_t mpn_mul(mpz_dig_t *idig, mpz_dig_t *jdig, size_t jlen, mpz_dig_t *
     return ilen;
 }
 
+#if MICROPY_OPT_MPZ_KARATSUBA || MICROPY_OPT_MPZ_POW3_MONTGOMERY
+
+#if MICROPY_OPT_MPZ_KARATSUBA
+/* returns number of scratch digits needed by mpn_mul_n for n-digit operands
+*/
+STATIC size_t mpn_mul_n_scratch(size_t n) {
+    size_t len = 0;
+    while (n >= MPZ_KARATSUBA_THRESHOLD) {
+        size_t m = (n + 1) / 2;
+        len += 4 * (m + 1);
+        n = m + 1;
+    }
+    return len;
+}
+#else
+#define mpn_mul_n_scratch(n) (0)
+#endif
+
+/* computes i = j * k where j, k both have n digits
+   all 2 * n digits of i are written; i need not be zeroed
+   j, k need not be normalised (they may have leading zero digits)
+   scratch must have mpn_mul_n_scratch(n) digits; i can't overlap j, k or scratch
+*/
+STATIC void mpn_mul_n(mpz_dig_t *idig, mpz_dig_t *jdig, mpz_dig_t *kdig, size_t n, mpz_dig_t *scratch) {
+    #if MICROPY_OPT_MPZ_KARATSUBA
+    if (n >= MPZ_KARATSUBA_THRESHOLD) {
+        // split j = j1 * B^m + j0 and k = k1 * B^m + k0, then
+        // j * k = z2 * B^2m + z1 * B^m + z0 with z1 = (j0 + j1) * (k0 + k1) - z0 - z2
+        size_t m = (n + 1) / 2;
+        size_t h = n - m;
+        mpz_dig_t *sj = scratch;
+        mpz_dig_t *sk = sj + m + 1;
+        mpz_dig_t *z1 = sk + m + 1;
+
+        // z0 and z2 go straight into their place in i
+        mpn_mul_n(idig, jdig, kdig, m, scratch);
+        mpn_mul_n(idig + 2 * m, jdig + m, kdig + m, h, scratch);
+
+        sj[m] = 0;
+        mpn_add(sj, jdig, m, jdig + m, h);
+        sk[m] = 0;
+        mpn_add(sk, kdig, m, kdig + m, h);
+        mpn_mul_n(z1, sj, sk, m + 1, z1 + 2 * (m + 1));
+        mpn_sub(z1, z1, 2 * (m + 1), idig, 2 * m);
+        mpn_sub(z1, z1, 2 * (m + 1), idig + 2 * m, 2 * h);
+
+        // z1 < B^(2n - m) so adding it in can't carry out of i
+        size_t z1len = mpn_remove_trailing_zeros(z1, z1 + 2 * (m + 1));
+        if (z1len != 0) {
+            mpn_add(idig + m, idig + m, 2 * n - m, z1, z1len);
+        }
+        return;
+    }
+    #endif
+    (void)scratch;
+    memset(idig, 0, 2 * n * sizeof(mpz_dig_t));
+    mpn_mul(idig, jdig, n, kdig, n);
+}
+
+#endif
+
+#if MICROPY_OPT_MPZ_KARATSUBA
+/* computes i = j * k, multiplying j in klen-digit blocks with mpn_mul_n
+   returns number of digits in i
+   assumes enough memory in i; assumes normalised j, k
+   assumes jlen >= klen >= MPZ_KARATSUBA_THRESHOLD; i can't overlap j, k
+*/
+STATIC size_t mpn_mul_karatsuba(mpz_dig_t *idig, mpz_dig_t *jdig, size_t jlen, mpz_dig_t *kdig, size_t klen) {
+    size_t ilen = jlen + klen;
+    size_t tlen = 2 * klen + mpn_mul_n_scratch(klen);
+    mpz_dig_t *tdig = m_new(mpz_dig_t, tlen);
+
+    memset(idig, 0, ilen * sizeof(mpz_dig_t));
+
+    // the partial sums never exceed ilen digits so the adds can't carry out of i
+    size_t off = 0;
+    for (; jlen - off >= klen; off += klen) {
+        mpn_mul_n(tdig, jdig + off, kdig, klen, tdig + 2 * klen);
+        mpn_add(idig + off, idig + off, ilen - off, tdig, 2 * klen);
+    }
+
+    if (off < jlen) {
+        size_t rlen = jlen - off;
+        if (rlen >= MPZ_KARATSUBA_THRESHOLD) {
+            if (tlen < rlen + klen) {
+                tdig = m_renew(mpz_dig_t, tdig, tlen, rlen + klen);
+                tlen = rlen + klen;
+            }
+            size_t tl = mpn_mul_karatsuba(tdig, kdig, klen, jdig + off, rlen);
+            mpn_add(idig + off, idig + off, ilen - off, tdig, tl);
+        } else {
+            // digits of i from off + klen upwards are still zero, which is
+            // all that mpn_mul needs to accumulate the product in place
+            mpn_mul(idig + off, kdig, klen, jdig + off, rlen);
+        }
+    }
+
+    m_del(mpz_dig_t, tdig, tlen);
+
+    return mpn_remove_trailing_zeros(idig, idig + ilen);
+}
+#endif
+
+#if MICROPY_OPT_MPZ_POW3_MONTGOMERY
+/* computes i = j * k / B^n mod m (Montgomery multiplication)
+   j, k, i have n digits and are less than m; minv = -1 / m mod B
+   t must have 2 * n + 1 digits, scratch must have mpn_mul_n_scratch(n) digits
+   can have i, j, k pointing to same memory
+*/
+STATIC void mpn_montmul(mpz_dig_t *idig, mpz_dig_t *jdig, mpz_dig_t *kdig, const mpz_dig_t *mdig, size_t n,
+    mpz_dig_t minv, mpz_dig_t *tdig, mpz_dig_t *scratch) {
+    mpn_mul_n(tdig, jdig, kdig, n, scratch);
+    tdig[2 * n] = 0;
+
+    // add multiples of m to clear the low digits one at a time
+    for (size_t i = 0; i < n; ++i) {
+        mpz_dig_t u = ((mpz_dbl_dig_t)tdig[i] * (mpz_dbl_dig_t)minv) & DIG_MASK;
+        mpz_dig_t *td = tdig + i;
+        mpz_dbl_dig_t carry = 0;
+        for (size_t j = 0; j < n; ++j, ++td) {
+            carry += (mpz_dbl_dig_t)*td + (mpz_dbl_dig_t)u * (mpz_dbl_dig_t)mdig[j];
+            *td = carry & DIG_MASK;
+            carry >>= DIG_SIZE;
+        }
+        for (; carry != 0; ++td) {
+            carry += *td;
+            *td = carry & DIG_MASK;
+            carry >>= DIG_SIZE;
+        }
+    }
+
+    // the high half is now less than 2 * m
+    mpz_dig_t *rdig = tdig + n;
+    size_t l = n;
+    while (l > 0 && rdig[l - 1] == mdig[l - 1]) {
+        --l;
+    }
+    if (rdig[n] != 0 || l == 0 || rdig[l - 1] > mdig[l - 1]) {
+        mpn_sub(rdig, rdig, n + 1, mdig, n);
+    }
+    memcpy(idig, rdig, n * sizeof(mpz_dig_t));
+}
+
+#endif
+
 /* natural_div - quo * den + new_num = old_num (ie num is replaced with rem)
    assumes den != 0
    assumes num_dig has enough memory to be extended by 1 digit
@@ -519,8 +669,12 @@ STATIC void mpn_div(mpz_dig_t *num_dig, size_t *num_len, const mpz_dig_t *den_di
     while (*num_len > den_len) {
         mpz_dbl_dig_t quo = ((mpz_dbl_dig_t)*num_dig << DIG_SIZE) | num_dig[-1];
 
-        // get approximate quotient
+        // get approximate quotient; a digit of the quotient can't exceed
+        // DIG_MASK, and clamping it keeps borrow from overflowing below
         quo /= lead_den_digit;
+        if (quo > DIG_MASK) {
+            quo = DIG_MASK;
+        }
 
         // Multiply quo by den and subtract from num to get remainder.
         // We have different code here to handle different compile-time
@@ -886,9 +1040,32 @@ void mpz_set_from_bytes(mpz_t *z, bool big_endian, size_t len, const byte *buf)
 
     mpz_need_dig(z, (len * 8 + DIG_SIZE - 1) / DIG_SIZE);
 
+    z->neg = 0;
+
+    #if DIG_SIZE == 16 || DIG_SIZE == 32
+    // each digit holds a whole number of bytes so can be built directly
+    mpz_dig_t *dig = z->dig;
+    for (; len >= DIG_SIZE / 8; len -= DIG_SIZE / 8) {
+        mpz_dig_t d = buf[0];
+        d |= (mpz_dig_t)buf[delta] << 8;
+        #if DIG_SIZE == 32
+        d |= (mpz_dig_t)buf[2 * delta] << 16;
+        d |= (mpz_dig_t)buf[3 * delta] << 24;
+        #endif
+        *dig++ = d;
+        buf += DIG_SIZE / 8 * delta;
+    }
+    if (len) {
+        mpz_dig_t d = 0;
+        for (int num_bits = 0; len; --len, num_bits += 8, buf += delta) {
+            d |= (mpz_dig_t)*buf << num_bits;
+        }
+        *dig++ = d;
+    }
+    z->len = mpn_remove_trailing_zeros(z->dig, dig);
+    #else
     mpz_dig_t d = 0;
     int num_bits = 0;
-    z->neg = 0;
     z->len = 0;
     while (len) {
         while (len && num_bits < DIG_SIZE) {
@@ -908,6 +1085,7 @@ void mpz_set_from_bytes(mpz_t *z, bool big_endian, size_t len, const byte *buf)
     }
 
     z->len = mpn_remove_trailing_zeros(z->dig, z->dig + z->len);
+    #endif
 }
 
 #if 0
@@ -1313,8 +1491,19 @@ void mpz_mul_inpl(mpz_t *dest, const mpz_t *lhs, const mpz_t *rhs) {
     }
 
     mpz_need_dig(dest, lhs->len + rhs->len); // min mem l+r-1, max mem l+r
-    memset(dest->dig, 0, dest->alloc * sizeof(mpz_dig_t));
-    dest->len = mpn_mul(dest->dig, lhs->dig, lhs->len, rhs->dig, rhs->len);
+    #if MICROPY_OPT_MPZ_KARATSUBA
+    if (lhs->len >= MPZ_KARATSUBA_THRESHOLD && rhs->len >= MPZ_KARATSUBA_THRESHOLD) {
+        if (lhs->len >= rhs->len) {
+            dest->len = mpn_mul_karatsuba(dest->dig, lhs->dig, lhs->len, rhs->dig, rhs->len);
+        } else {
+            dest->len = mpn_mul_karatsuba(dest->dig, rhs->dig, rhs->len, lhs->dig, lhs->len);
+        }
+    } else
+    #endif
+    {
+        memset(dest->dig, 0, dest->alloc * sizeof(mpz_dig_t));
+        dest->len = mpn_mul(dest->dig, lhs->dig, lhs->len, rhs->dig, rhs->len);
+    }
 
     if (lhs->neg == rhs->neg) {
         dest->neg = 0;
@@ -1359,6 +1548,76 @@ void mpz_pow_inpl(mpz_t *dest, const mpz_t *lhs, const mpz_t *rhs) {
     mpz_free(n);
 }
 
+#if MICROPY_OPT_MPZ_POW3_MONTGOMERY
+/* computes dest = (x ** rhs) % mod using Montgomery multiplication
+   assumes mod is positive and odd; assumes 0 <= x < mod; assumes rhs > 0
+   dest can't be the same as x or mod
+*/
+STATIC void mpz_pow3_montgomery(mpz_t *dest, const mpz_t *x, const mpz_t *rhs, const mpz_t *mod) {
+    size_t n = mod->len;
+
+    // minv = -1 / mod mod B by Newton iteration; m0 is its own inverse mod 8
+    mpz_dbl_dig_t m0 = mod->dig[0];
+    mpz_dbl_dig_t inv = m0;
+    for (int i = 3; i < DIG_SIZE; i *= 2) {
+        inv = (inv * ((2 + DIG_BASE - ((m0 * inv) & DIG_MASK)) & DIG_MASK)) & DIG_MASK;
+    }
+    mpz_dig_t minv = (DIG_BASE - inv) & DIG_MASK;
+
+    size_t slen = mpn_mul_n_scratch(n);
+    size_t buflen = 5 * n + 1 + slen;
+    mpz_dig_t *buf = m_new(mpz_dig_t, buflen);
+    mpz_dig_t *acc = buf;
+    mpz_dig_t *xm = acc + n;
+    mpz_dig_t *one = xm + n;
+    mpz_dig_t *tdig = one + n;
+    mpz_dig_t *scratch = tdig + 2 * n + 1;
+
+    // convert x to Montgomery form, x * B^n mod m
+    mpz_t r, quo;
+    mpz_init_zero(&r);
+    mpz_init_zero(&quo);
+    mpz_shl_inpl(&r, x, n * DIG_SIZE);
+    mpz_divmod_inpl(&quo, &r, &r, mod);
+    memset(xm, 0, n * sizeof(mpz_dig_t));
+    memcpy(xm, r.dig, r.len * sizeof(mpz_dig_t));
+    mpz_deinit(&quo);
+    mpz_deinit(&r);
+
+    // left-to-right binary exponentiation, starting at the top set bit
+    memcpy(acc, xm, n * sizeof(mpz_dig_t));
+    size_t di = rhs->len - 1;
+    int bit = DIG_SIZE - 1;
+    while (!((rhs->dig[di] >> bit) & 1)) {
+        --bit;
+    }
+    for (;;) {
+        if (--bit < 0) {
+            if (di-- == 0) {
+                break;
+            }
+            bit = DIG_SIZE - 1;
+        }
+        mpn_montmul(acc, acc, acc, mod->dig, n, minv, tdig, scratch);
+        if ((rhs->dig[di] >> bit) & 1) {
+            mpn_montmul(acc, acc, xm, mod->dig, n, minv, tdig, scratch);
+        }
+    }
+
+    // convert back out of Montgomery form
+    memset(one, 0, n * sizeof(mpz_dig_t));
+    one[0] = 1;
+    mpn_montmul(acc, acc, one, mod->dig, n, minv, tdig, scratch);
+
+    mpz_need_dig(dest, n);
+    memcpy(dest->dig, acc, n * sizeof(mpz_dig_t));
+    dest->len = mpn_remove_trailing_zeros(dest->dig, dest->dig + n);
+    dest->neg = 0;
+
+    m_del(mpz_dig_t, buf, buflen);
+}
+#endif
+
 /* computes dest = (lhs ** rhs) % mod
    can have dest, lhs, rhs the same; mod can't be the same as dest
 */
@@ -1368,11 +1627,29 @@ void mpz_pow3_inpl(mpz_t *dest, const mpz_t *lhs, const mpz_t *rhs, const mpz_t
         return;
     }
 
-    mpz_set_from_int(dest, 1);
-
     if (rhs->len == 0) {
+        mpz_set_from_int(dest, 1);
+        return;
+    }
+
+    #if MICROPY_OPT_MPZ_POW3_MONTGOMERY
+    if (!mod->neg && (mod->dig[0] & 1) != 0) {
+        mpz_t x, quo;
+        mpz_init_zero(&x);
+        mpz_init_zero(&quo);
+        mpz_divmod_inpl(&quo, &x, lhs, mod);
+        if (mpz_is_zero(&x)) {
+            mpz_set_from_int(dest, 0);
+        } else {
+            mpz_pow3_montgomery(dest, &x, rhs, mod);
+        }
+        mpz_deinit(&quo);
+        mpz_deinit(&x);
         return;
     }
+    #endif
+
+    mpz_set_from_int(dest, 1);
 
     mpz_t *x = mpz_clone(lhs);
     mpz_t *n = mpz_clone(rhs);
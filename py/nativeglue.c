@@ -223,7 +223,11 @@ const void *const mp_fun_table[MP_F_NUMBER_OF] = {
     mp_call_method_n_kw_var,
     mp_native_getiter,
     mp_native_iternext,
+#if MICROPY_NLR_SETJMP
+    nlr_push_tail,
+#else
     nlr_push,
+#endif
     nlr_pop,
     mp_native_raise,
     mp_import_name,
@@ -243,6 +247,11 @@ const void *const mp_fun_table[MP_F_NUMBER_OF] = {
     mp_small_int_floor_divide,
     mp_small_int_modulo,
     mp_native_yield_from,
+#if MICROPY_NLR_SETJMP
+    setjmp,
+#else
+    NULL,
+#endif
 };
 
 /*
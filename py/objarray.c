@@ -333,8 +333,8 @@ STATIC mp_obj_t array_append(mp_obj_t self_in, mp_obj_t arg) {
 
     if (self->free == 0) {
         size_t item_sz = mp_binary_get_size('@', self->typecode, NULL);
-        // TODO: alloc policy
-        self->free = 8;
+        // grow by half, so that appending one item at a time stays linear
+        self->free = MAX(8, self->len / 2);
         self->items = m_renew(byte, self->items, item_sz * self->len, item_sz * (self->len + self->free));
         mp_seq_clear(self->items, self->len + 1, self->len + self->free, item_sz);
     }
@@ -361,11 +361,17 @@ STATIC mp_obj_t array_extend(mp_obj_t self_in, mp_obj_t arg_in) {
     // convert byte count to element count
     size_t len = arg_bufinfo.len / sz;
 
-    // make sure we have enough room to extend
-    // TODO: alloc policy; at the moment we go conservative
+    // make sure we have enough room to extend; an array that is being grown gets half
+    // of its length on top, an empty one is extended to the exact size
     if (self->free < len) {
-        self->items = m_renew(byte, self->items, (self->len + self->free) * sz, (self->len + len) * sz);
-        self->free = 0;
+        size_t new_free = self->len / 2;
+        self->items = m_renew(byte, self->items, (self->len + self->free) * sz, (self->len + len + new_free) * sz);
+        mp_seq_clear(self->items, self->len + len, self->len + len + new_free, sz);
+        self->free = new_free;
+        if (arg_in == self_in) {
+            // extending by itself, the buffer may have moved
+            arg_bufinfo.buf = self->items;
+        }
     } else {
         self->free -= len;
     }
@@ -609,6 +615,13 @@ mp_obj_t mp_obj_new_bytearray_by_ref(size_t n, void *items) {
 }
 #endif
 
+#if MICROPY_PY_ARRAY
+// Create array of n uninitialised items of the given typecode
+mp_obj_t mp_obj_new_array(char typecode, size_t n) {
+    return MP_OBJ_FROM_PTR(array_new(typecode, n));
+}
+#endif
+
 /******************************************************************************/
 // array iterator
 
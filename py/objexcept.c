@@ -496,6 +496,10 @@ void mp_obj_exception_clear_traceback(mp_obj_t self_in) {
 void mp_obj_exception_add_traceback(mp_obj_t self_in, qstr file, size_t line, qstr block) {
     GET_NATIVE_EXCEPTION(self, self_in);
 
+    if (self->traceback_data == MP_OBJ_EXCEPTION_NO_TRACEBACK) {
+        return;
+    }
+
     // append this traceback info to traceback data
     // if memory allocation fails (eg because gc is locked), just return
 
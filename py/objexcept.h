@@ -37,6 +37,18 @@ typedef struct _mp_obj_exception_t {
     mp_obj_tuple_t *args;
 } mp_obj_exception_t;
 
+// Stored in traceback_data of an exception that must not record a traceback
+#define MP_OBJ_EXCEPTION_NO_TRACEBACK ((size_t*)(uintptr_t)1)
+
+// The exceptions that mp_raise_prealloc can raise
+typedef enum {
+    MP_PREALLOC_EXC_STOP_ITERATION, // StopIteration()
+    MP_PREALLOC_EXC_EAGAIN,         // OSError(EAGAIN)
+    MP_PREALLOC_EXC_ETIMEDOUT,      // OSError(ETIMEDOUT)
+    MP_PREALLOC_EXC_TIMEOUT,        // TimeoutError('timed out')
+    MP_PREALLOC_EXC_NUM
+} mp_prealloc_exc_t;
+
 void mp_obj_exception_print(const mp_print_t *print, mp_obj_t o_in, mp_print_kind_t kind);
 void mp_obj_exception_attr(mp_obj_t self_in, qstr attr, mp_obj_t *dest);
 
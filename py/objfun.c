@@ -212,6 +212,46 @@ STATIC void dump_args(const mp_obj_t *a, size_t sz) {
     mp_setup_code_state(code_state, n_args, n_kw, args); \
     code_state->old_globals = mp_globals_get();
 
+#if MICROPY_OPT_CODE_STATE_POOL
+#if MICROPY_PY_THREAD
+#define CODE_STATE_POOL_TS() mp_thread_get_state()
+#else
+#define CODE_STATE_POOL_TS() (&mp_state_ctx.thread)
+#endif
+
+// Take a pooled frame big enough, but not so big that a smaller call would
+// waste most of it.  The most recently returned one is tried first.
+STATIC mp_code_state_t *code_state_pool_take(size_t *state_size) {
+    mp_state_thread_t *ts = CODE_STATE_POOL_TS();
+    for (size_t i = ts->code_state_pool_len; i-- > 0;) {
+        size_t size = ts->code_state_pool_size[i];
+        if (size >= *state_size && size <= 2 * *state_size) {
+            mp_code_state_t *code_state = ts->code_state_pool[i];
+            size_t last = --ts->code_state_pool_len;
+            ts->code_state_pool[i] = ts->code_state_pool[last];
+            ts->code_state_pool_size[i] = ts->code_state_pool_size[last];
+            ts->code_state_pool[last] = NULL;
+            *state_size = size;
+            return code_state;
+        }
+    }
+    return NULL;
+}
+
+// Keep a frame for the next call, the oldest one is freed if the pool is full
+STATIC void code_state_pool_put(mp_code_state_t *code_state, size_t state_size) {
+    mp_state_thread_t *ts = CODE_STATE_POOL_TS();
+    if (ts->code_state_pool_len == MICROPY_OPT_CODE_STATE_POOL_LEN) {
+        m_del_var(mp_code_state_t, byte, ts->code_state_pool_size[0], ts->code_state_pool[0]);
+        memmove(&ts->code_state_pool[0], &ts->code_state_pool[1], (MICROPY_OPT_CODE_STATE_POOL_LEN - 1) * sizeof(ts->code_state_pool[0]));
+        memmove(&ts->code_state_pool_size[0], &ts->code_state_pool_size[1], (MICROPY_OPT_CODE_STATE_POOL_LEN - 1) * sizeof(ts->code_state_pool_size[0]));
+        ts->code_state_pool_len--;
+    }
+    ts->code_state_pool[ts->code_state_pool_len] = code_state;
+    ts->code_state_pool_size[ts->code_state_pool_len++] = state_size;
+}
+#endif
+
 #if MICROPY_STACKLESS
 mp_code_state_t *mp_obj_fun_bc_prepare_codestate(mp_obj_t self_in, size_t n_args, size_t n_kw, const mp_obj_t *args) {
     MP_STACK_CHECK();
@@ -264,6 +304,10 @@ STATIC mp_obj_t fun_bc_call(mp_obj_t self_in, size_t n_args, size_t n_kw, const
     code_state = mp_pystack_alloc(sizeof(mp_code_state_t) + state_size);
     #else
     if (state_size > VM_MAX_STATE_ON_STACK) {
+        #if MICROPY_OPT_CODE_STATE_POOL
+        code_state = code_state_pool_take(&state_size);
+        if (code_state == NULL)
+        #endif
         code_state = m_new_obj_var_maybe(mp_code_state_t, byte, state_size);
         #if MICROPY_DEBUG_VM_STACK_OVERFLOW
         if (code_state != NULL) {
@@ -284,7 +328,14 @@ STATIC mp_obj_t fun_bc_call(mp_obj_t self_in, size_t n_args, size_t n_kw, const
 
     // execute the byte code with the correct globals context
     mp_globals_set(self->globals);
+    #if MICROPY_TRACK_CODE_STATE
+    mp_code_state_t *prev_code_state = MP_STATE_THREAD(current_code_state);
+    MP_STATE_THREAD(current_code_state) = code_state;
+    #endif
     mp_vm_return_kind_t vm_return_kind = mp_execute_bytecode(code_state, MP_OBJ_NULL);
+    #if MICROPY_TRACK_CODE_STATE
+    MP_STATE_THREAD(current_code_state) = prev_code_state;
+    #endif
     mp_globals_set(code_state->old_globals);
 
     #if MICROPY_DEBUG_VM_STACK_OVERFLOW
@@ -332,7 +383,11 @@ STATIC mp_obj_t fun_bc_call(mp_obj_t self_in, size_t n_args, size_t n_kw, const
     #else
     // free the state if it was allocated on the heap
     if (state_size != 0) {
+        #if MICROPY_OPT_CODE_STATE_POOL
+        code_state_pool_put(code_state, state_size);
+        #else
         m_del_var(mp_code_state_t, byte, state_size, code_state);
+        #endif
     }
     #endif
 
@@ -529,4 +584,15 @@ mp_obj_t mp_obj_new_fun_asm(size_t n_args, const void *fun_data, mp_uint_t type_
     return o;
 }
 
+// the machine code of an inline assembler function, or NULL for any other object,
+// for ports that call it without going through the VM (e.g. from an interrupt)
+const void *mp_obj_fun_asm_get_code(mp_obj_t fun, size_t *n_args) {
+    if (!mp_obj_is_type(fun, &mp_type_fun_asm)) {
+        return NULL;
+    }
+    mp_obj_fun_asm_t *self = MP_OBJ_TO_PTR(fun);
+    *n_args = self->n_args;
+    return MICROPY_MAKE_POINTER_CALLABLE(self->fun_data);
+}
+
 #endif // MICROPY_EMIT_INLINE_ASM
@@ -30,8 +30,10 @@
 
 #include "py/runtime.h"
 #include "py/bc.h"
+#include "py/gc.h"
 #include "py/objgenerator.h"
 #include "py/objfun.h"
+#include "py/objstr.h"
 #include "py/stackctrl.h"
 
 /******************************************************************************/
@@ -84,6 +86,11 @@ STATIC mp_obj_t native_gen_wrap_call(mp_obj_t self_in, size_t n_args, size_t n_k
 
     // Determine start of prelude, and extract n_state from it
     uintptr_t prelude_offset = ((uintptr_t*)self_fun->bytecode)[0];
+    #if MICROPY_EMIT_NATIVE_PRELUDE_AS_BYTES_OBJ
+    // Prelude is in bytes object in const_table, at index prelude_offset
+    mp_obj_str_t *prelude_bytes = MP_OBJ_TO_PTR(self_fun->const_table[prelude_offset]);
+    prelude_offset = (const byte*)prelude_bytes->data - self_fun->bytecode;
+    #endif
     size_t n_state = mp_decode_uint_value(self_fun->bytecode + prelude_offset);
     size_t n_exc_stack = 0;
 
@@ -123,6 +130,17 @@ const mp_obj_type_t mp_type_native_gen_wrap = {
 /******************************************************************************/
 /* generator instance                                                         */
 
+#if MICROPY_OPT_GENERATOR_SHRINK && MICROPY_ENABLE_GC
+// A stopped generator is never executed again and only its header is used from
+// then on, so the blocks of the frame are given back; it can't move, it may be
+// referenced from anywhere.
+STATIC void gen_instance_release_state(mp_obj_gen_instance_t *self) {
+    gc_realloc(self, sizeof(mp_obj_gen_instance_t), false);
+}
+#else
+#define gen_instance_release_state(self) (void)(self)
+#endif
+
 STATIC void gen_instance_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
     (void)kind;
     mp_obj_gen_instance_t *self = MP_OBJ_TO_PTR(self_in);
@@ -178,7 +196,14 @@ mp_vm_return_kind_t mp_obj_gen_resume(mp_obj_t self_in, mp_obj_t send_value, mp_
     #endif
     {
         // A bytecode generator
+        #if MICROPY_TRACK_CODE_STATE
+        mp_code_state_t *prev_code_state = MP_STATE_THREAD(current_code_state);
+        MP_STATE_THREAD(current_code_state) = &self->code_state;
+        #endif
         ret_kind = mp_execute_bytecode(&self->code_state, throw_value);
+        #if MICROPY_TRACK_CODE_STATE
+        MP_STATE_THREAD(current_code_state) = prev_code_state;
+        #endif
     }
 
     self->globals = mp_globals_get();
@@ -192,6 +217,7 @@ mp_vm_return_kind_t mp_obj_gen_resume(mp_obj_t self_in, mp_obj_t send_value, mp_
             // again and again, leading to side effects.
             self->code_state.ip = 0;
             *ret_val = *self->code_state.sp;
+            gen_instance_release_state(self);
             break;
 
         case MP_VM_RETURN_YIELD:
@@ -208,6 +234,7 @@ mp_vm_return_kind_t mp_obj_gen_resume(mp_obj_t self_in, mp_obj_t send_value, mp_
             if (mp_obj_is_subclass_fast(MP_OBJ_FROM_PTR(mp_obj_get_type(*ret_val)), MP_OBJ_FROM_PTR(&mp_type_StopIteration))) {
                 *ret_val = mp_obj_new_exception_msg(&mp_type_RuntimeError, "generator raised StopIteration");
             }
+            gen_instance_release_state(self);
             break;
         }
     }
@@ -299,6 +326,10 @@ STATIC MP_DEFINE_CONST_FUN_OBJ_1(gen_instance_close_obj, gen_instance_close);
 
 STATIC mp_obj_t gen_instance_pend_throw(mp_obj_t self_in, mp_obj_t exc_in) {
     mp_obj_gen_instance_t *self = MP_OBJ_TO_PTR(self_in);
+    if (self->code_state.ip == 0) {
+        // stopped, there is nothing left to throw into
+        return mp_const_none;
+    }
     if (self->code_state.sp == self->code_state.state - 1) {
         mp_raise_TypeError("can't pend throw to just-started generator");
     }
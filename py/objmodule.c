@@ -220,6 +220,9 @@ STATIC const mp_rom_map_elem_t mp_builtin_module_table[] = {
 #if MICROPY_PY_FRAMEBUF
     { MP_ROM_QSTR(MP_QSTR_framebuf), MP_ROM_PTR(&mp_module_framebuf) },
 #endif
+#if MICROPY_PY_UVECTOR
+    { MP_ROM_QSTR(MP_QSTR_uvector), MP_ROM_PTR(&mp_module_uvector) },
+#endif
 #if MICROPY_PY_BTREE
     { MP_ROM_QSTR(MP_QSTR_btree), MP_ROM_PTR(&mp_module_btree) },
 #endif
@@ -272,26 +272,109 @@ wrong_args:
 
 // like strstr but with specified length and allows \0 bytes
 // TODO replace with something more efficient/standard
-const byte *find_subbytes(const byte *haystack, size_t hlen, const byte *needle, size_t nlen, int direction) {
-    if (hlen >= nlen) {
-        size_t str_index, str_index_end;
-        if (direction > 0) {
-            str_index = 0;
-            str_index_end = hlen - nlen;
-        } else {
-            str_index = hlen - nlen;
-            str_index_end = 0;
+// Word-at-a-time search for a single byte: a word of the haystack XORed
+// with the byte repeated in every lane has a zero lane where it matches.
+#define SWAR_ONES ((mp_uint_t)-1 / 0xff)
+#define SWAR_HAS_ZERO(w) (((w) - SWAR_ONES) & ~(w) & (SWAR_ONES * 0x80))
+
+STATIC const byte *find_byte_rev(const byte *haystack, size_t hlen, byte c) {
+    const byte *p = haystack + hlen;
+    while (p > haystack && ((uintptr_t)p & (sizeof(mp_uint_t) - 1))) {
+        if (*--p == c) {
+            return p;
+        }
+    }
+    mp_uint_t pattern = SWAR_ONES * c;
+    while (p - haystack >= (ptrdiff_t)sizeof(mp_uint_t)) {
+        mp_uint_t w;
+        memcpy(&w, p - sizeof(mp_uint_t), sizeof(w));
+        if (SWAR_HAS_ZERO(w ^ pattern)) {
+            break;
         }
-        for (;;) {
-            if (memcmp(&haystack[str_index], needle, nlen) == 0) {
-                //found
-                return haystack + str_index;
+        p -= sizeof(mp_uint_t);
+    }
+    while (p > haystack) {
+        if (*--p == c) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+// Below this many candidate positions the skip table isn't worth setting up,
+// finding the first byte and comparing the rest is faster.
+#define FIND_SUBBYTES_HORSPOOL_MIN (64)
+
+// Boyer-Moore-Horspool; the shifts are capped at 255 to keep the table small,
+// which only makes some of them shorter than they could be.
+STATIC const byte *find_subbytes_horspool(const byte *haystack, size_t hlen, const byte *needle, size_t nlen, int direction) {
+    byte shift[256];
+    memset(shift, MIN(nlen, 255), sizeof(shift));
+    size_t pos;
+    if (direction > 0) {
+        for (size_t i = 0; i < nlen - 1; i++) {
+            shift[needle[i]] = MIN(nlen - 1 - i, 255);
+        }
+        byte last = needle[nlen - 1];
+        for (pos = 0; pos <= hlen - nlen; pos += shift[haystack[pos + nlen - 1]]) {
+            if (haystack[pos + nlen - 1] == last && memcmp(haystack + pos, needle, nlen - 1) == 0) {
+                return haystack + pos;
+            }
+        }
+    } else {
+        // the mirror image, aligning on the first byte of the window
+        for (size_t i = nlen - 1; i > 0; i--) {
+            shift[needle[i]] = MIN(i, 255);
+        }
+        byte first = needle[0];
+        for (pos = hlen - nlen;; pos -= shift[haystack[pos]]) {
+            if (haystack[pos] == first && memcmp(haystack + pos + 1, needle + 1, nlen - 1) == 0) {
+                return haystack + pos;
+            }
+            if (pos < shift[haystack[pos]]) {
+                break;
+            }
+        }
+    }
+    return NULL;
+}
+
+const byte *find_subbytes(const byte *haystack, size_t hlen, const byte *needle, size_t nlen, int direction) {
+    if (hlen < nlen) {
+        return NULL;
+    }
+    if (nlen == 0) {
+        return direction > 0 ? haystack : haystack + hlen;
+    }
+    if (nlen > 2 && hlen - nlen >= FIND_SUBBYTES_HORSPOOL_MIN) {
+        return find_subbytes_horspool(haystack, hlen, needle, nlen, direction);
+    }
+
+    // look for the first byte (or last going backwards), then check the rest
+    if (direction > 0) {
+        const byte *p = haystack;
+        const byte *end = haystack + hlen - nlen + 1;
+        while (p < end) {
+            p = memchr(p, needle[0], end - p);
+            if (p == NULL) {
+                break;
+            }
+            if (memcmp(p + 1, needle + 1, nlen - 1) == 0) {
+                return p;
             }
-            if (str_index == str_index_end) {
-                //not found
+            p++;
+        }
+    } else {
+        size_t len = hlen - nlen + 1;
+        while (len > 0) {
+            const byte *p = find_byte_rev(haystack, len, needle[0]);
+            if (p == NULL) {
                 break;
             }
-            str_index += direction;
+            if (memcmp(p + 1, needle + 1, nlen - 1) == 0) {
+                return p;
+            }
+            len = p - haystack;
         }
     }
     return NULL;
@@ -548,19 +631,16 @@ mp_obj_t mp_obj_str_split(size_t n_args, const mp_obj_t *args) {
 
         for (;;) {
             const byte *start = s;
-            for (;;) {
-                if (splits == 0 || s + sep_len > top) {
-                    s = top;
-                    break;
-                } else if (memcmp(s, sep_str, sep_len) == 0) {
-                    break;
-                }
-                s++;
+            if (splits != 0) {
+                s = find_subbytes(s, top - s, (const byte*)sep_str, sep_len, 1);
+            } else {
+                s = NULL;
             }
-            mp_obj_list_append(res, mp_obj_new_str_of_type(self_type, start, s - start));
-            if (s >= top) {
+            if (s == NULL) {
+                mp_obj_list_append(res, mp_obj_new_str_of_type(self_type, start, top - start));
                 break;
             }
+            mp_obj_list_append(res, mp_obj_new_str_of_type(self_type, start, s - start));
             s += sep_len;
             if (splits > 0) {
                 splits--;
@@ -654,16 +734,11 @@ STATIC mp_obj_t str_rsplit(size_t n_args, const mp_obj_t *args) {
         const byte *beg = s;
         const byte *last = s + len;
         for (;;) {
-            s = last - sep_len;
-            for (;;) {
-                if (splits == 0 || s < beg) {
-                    break;
-                } else if (memcmp(s, sep_str, sep_len) == 0) {
-                    break;
-                }
-                s--;
+            s = NULL;
+            if (splits != 0) {
+                s = find_subbytes(beg, last - beg, (const byte*)sep_str, sep_len, -1);
             }
-            if (s < beg || splits == 0) {
+            if (s == NULL) {
                 res->items[idx] = mp_obj_new_str_of_type(self_type, beg, last - beg);
                 break;
             }
@@ -1726,13 +1801,14 @@ STATIC mp_obj_t str_count(size_t n_args, const mp_obj_t *args) {
 
     // count the occurrences
     mp_int_t num_occurrences = 0;
-    for (const byte *haystack_ptr = start; haystack_ptr + needle_len <= end;) {
-        if (memcmp(haystack_ptr, needle, needle_len) == 0) {
-            num_occurrences++;
-            haystack_ptr += needle_len;
-        } else {
-            haystack_ptr = utf8_next_char(haystack_ptr);
+    // a match can't start part way through a utf-8 char, so there's no need to step by chars
+    for (const byte *haystack_ptr = start; haystack_ptr < end;) {
+        haystack_ptr = find_subbytes(haystack_ptr, end - haystack_ptr, needle, needle_len, 1);
+        if (haystack_ptr == NULL) {
+            break;
         }
+        num_occurrences++;
+        haystack_ptr += needle_len;
     }
 
     return MP_OBJ_NEW_SMALL_INT(num_occurrences);
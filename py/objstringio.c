@@ -48,7 +48,7 @@ STATIC void check_stringio_is_open(const mp_obj_stringio_t *o) {
 STATIC void stringio_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
     (void)kind;
     mp_obj_stringio_t *self = MP_OBJ_TO_PTR(self_in);
-    mp_printf(print, self->base.type == &mp_type_stringio ? "<io.StringIO 0x%x>" : "<io.BytesIO 0x%x>", self);
+    mp_printf(print, "<io.%q 0x%x>", self->base.type->name, self);
 }
 
 STATIC mp_uint_t stringio_read(mp_obj_t o_in, void *buf, mp_uint_t size, int *errcode) {
@@ -250,6 +250,44 @@ STATIC const mp_stream_p_t bytesio_stream_p = {
     .ioctl = stringio_ioctl,
 };
 
+#if MICROPY_PY_IO_BYTESBUILDER
+// A write-only BytesIO for assembling messages: it grows geometrically and freeze()
+// hands its buffer over to the bytes object instead of copying it
+STATIC mp_obj_t bytesbuilder_make_new(const mp_obj_type_t *type_in, size_t n_args, size_t n_kw, const mp_obj_t *args) {
+    mp_arg_check_num(n_args, n_kw, 0, 1, false);
+    mp_obj_stringio_t *o = stringio_new(type_in);
+    o->vstr = vstr_new(n_args > 0 ? mp_obj_get_int(args[0]) : 16);
+    return MP_OBJ_FROM_PTR(o);
+}
+
+STATIC mp_obj_t bytesbuilder_unary_op(mp_unary_op_t op, mp_obj_t self_in) {
+    mp_obj_stringio_t *self = MP_OBJ_TO_PTR(self_in);
+    switch (op) {
+        case MP_UNARY_OP_BOOL: return mp_obj_new_bool(self->vstr->len != 0);
+        case MP_UNARY_OP_LEN: return MP_OBJ_NEW_SMALL_INT(self->vstr->len);
+        default: return MP_OBJ_NULL; // op not supported
+    }
+}
+
+STATIC mp_obj_t bytesbuilder_freeze(mp_obj_t self_in) {
+    mp_obj_stringio_t *self = MP_OBJ_TO_PTR(self_in);
+    mp_obj_t bytes = mp_obj_new_str_from_vstr(&mp_type_bytes, self->vstr);
+    // start again empty, the buffer now belongs to the bytes object
+    vstr_init(self->vstr, 16);
+    self->pos = 0;
+    return bytes;
+}
+STATIC MP_DEFINE_CONST_FUN_OBJ_1(bytesbuilder_freeze_obj, bytesbuilder_freeze);
+
+STATIC const mp_rom_map_elem_t bytesbuilder_locals_dict_table[] = {
+    { MP_ROM_QSTR(MP_QSTR_write), MP_ROM_PTR(&mp_stream_write_obj) },
+    { MP_ROM_QSTR(MP_QSTR_getvalue), MP_ROM_PTR(&stringio_getvalue_obj) },
+    { MP_ROM_QSTR(MP_QSTR_freeze), MP_ROM_PTR(&bytesbuilder_freeze_obj) },
+};
+
+STATIC MP_DEFINE_CONST_DICT(bytesbuilder_locals_dict, bytesbuilder_locals_dict_table);
+#endif
+
 const mp_obj_type_t mp_type_stringio = {
     { &mp_type_type },
     .name = MP_QSTR_StringIO,
@@ -274,4 +312,16 @@ const mp_obj_type_t mp_type_bytesio = {
 };
 #endif
 
+#if MICROPY_PY_IO_BYTESBUILDER
+const mp_obj_type_t mp_type_bytesbuilder = {
+    { &mp_type_type },
+    .name = MP_QSTR_BytesBuilder,
+    .print = stringio_print,
+    .make_new = bytesbuilder_make_new,
+    .unary_op = bytesbuilder_unary_op,
+    .protocol = &bytesio_stream_p,
+    .locals_dict = (mp_obj_dict_t*)&bytesbuilder_locals_dict,
+};
+#endif
+
 #endif
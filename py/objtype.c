@@ -134,11 +134,46 @@ struct class_lookup_data {
     size_t meth_offset;
     mp_obj_t *dest;
     bool is_type;
+    #if MICROPY_OPT_TYPE_ATTR_CACHE
+    // set by a match in a locals_dict
+    const mp_obj_type_t *found;
+    mp_obj_t found_value;
+    // the result may depend on the object, through a native base's own lookup
+    bool uncacheable;
+    #endif
 };
 
-STATIC void mp_obj_class_lookup(struct class_lookup_data  *lookup, const mp_obj_type_t *type) {
-    assert(lookup->dest[0] == MP_OBJ_NULL);
-    assert(lookup->dest[1] == MP_OBJ_NULL);
+#if MICROPY_OPT_TYPE_ATTR_CACHE
+#define TYPE_ATTR_CACHE_ENTRY(type, attr) \
+    (&MP_STATE_VM(type_attr_cache)[(((uintptr_t)(type) >> 4) ^ (attr)) & (MICROPY_OPT_TYPE_ATTR_CACHE_SIZE - 1)])
+
+void mp_type_attr_cache_clear(void) {
+    memset(MP_STATE_VM(type_attr_cache), 0, sizeof(MP_STATE_VM(type_attr_cache)));
+}
+#endif
+
+STATIC void class_lookup_convert(struct class_lookup_data *lookup, const mp_obj_type_t *type, mp_obj_t value) {
+    if (lookup->is_type) {
+        // If we look up a class method, we need to return original type for which we
+        // do a lookup, not a (base) type in which we found the class method.
+        const mp_obj_type_t *org_type = (const mp_obj_type_t*)lookup->obj;
+        mp_convert_member_lookup(MP_OBJ_NULL, org_type, value, lookup->dest);
+    } else {
+        mp_obj_instance_t *obj = lookup->obj;
+        mp_obj_t obj_obj;
+        if (obj != NULL && mp_obj_is_native_type(type) && type != &mp_type_object /* object is not a real type */) {
+            // If we're dealing with native base class, then it applies to native sub-object
+            obj_obj = obj->subobj[0];
+        } else {
+            obj_obj = MP_OBJ_FROM_PTR(obj);
+        }
+        mp_convert_member_lookup(obj_obj, type, value, lookup->dest);
+    }
+}
+
+STATIC void mp_obj_class_lookup(struct class_lookup_data  *lookup, const mp_obj_type_t *type);
+
+STATIC void mp_obj_class_lookup_walk(struct class_lookup_data  *lookup, const mp_obj_type_t *type) {
     for (;;) {
         DEBUG_printf("mp_obj_class_lookup: Looking up %s in %s\n", qstr_str(lookup->attr), qstr_str(type->name));
         // Optimize special method lookup for native types
@@ -160,22 +195,11 @@ STATIC void mp_obj_class_lookup(struct class_lookup_data  *lookup, const mp_obj_
             mp_map_t *locals_map = &type->locals_dict->map;
             mp_map_elem_t *elem = mp_map_lookup(locals_map, MP_OBJ_NEW_QSTR(lookup->attr), MP_MAP_LOOKUP);
             if (elem != NULL) {
-                if (lookup->is_type) {
-                    // If we look up a class method, we need to return original type for which we
-                    // do a lookup, not a (base) type in which we found the class method.
-                    const mp_obj_type_t *org_type = (const mp_obj_type_t*)lookup->obj;
-                    mp_convert_member_lookup(MP_OBJ_NULL, org_type, elem->value, lookup->dest);
-                } else {
-                    mp_obj_instance_t *obj = lookup->obj;
-                    mp_obj_t obj_obj;
-                    if (obj != NULL && mp_obj_is_native_type(type) && type != &mp_type_object /* object is not a real type */) {
-                        // If we're dealing with native base class, then it applies to native sub-object
-                        obj_obj = obj->subobj[0];
-                    } else {
-                        obj_obj = MP_OBJ_FROM_PTR(obj);
-                    }
-                    mp_convert_member_lookup(obj_obj, type, elem->value, lookup->dest);
-                }
+                #if MICROPY_OPT_TYPE_ATTR_CACHE
+                lookup->found = type;
+                lookup->found_value = elem->value;
+                #endif
+                class_lookup_convert(lookup, type, elem->value);
 #if DEBUG_PRINT
                 DEBUG_printf("mp_obj_class_lookup: Returning: ");
                 mp_obj_print_helper(MICROPY_DEBUG_PRINTER, lookup->dest[0], PRINT_REPR);
@@ -192,6 +216,11 @@ STATIC void mp_obj_class_lookup(struct class_lookup_data  *lookup, const mp_obj_
         // Previous code block takes care about attributes defined in .locals_dict,
         // but some attributes of native types may be handled using .load_attr method,
         // so make sure we try to lookup those too.
+        #if MICROPY_OPT_TYPE_ATTR_CACHE
+        if (mp_obj_is_native_type(type) && type != &mp_type_object) {
+            lookup->uncacheable = true;
+        }
+        #endif
         if (lookup->obj != NULL && !lookup->is_type && mp_obj_is_native_type(type) && type != &mp_type_object /* object is not a real type */) {
             mp_load_method_maybe(lookup->obj->subobj[0], lookup->attr, lookup->dest);
             if (lookup->dest[0] != MP_OBJ_NULL) {
@@ -236,6 +265,36 @@ STATIC void mp_obj_class_lookup(struct class_lookup_data  *lookup, const mp_obj_
     }
 }
 
+STATIC void mp_obj_class_lookup(struct class_lookup_data  *lookup, const mp_obj_type_t *type) {
+    assert(lookup->dest[0] == MP_OBJ_NULL);
+    assert(lookup->dest[1] == MP_OBJ_NULL);
+    #if MICROPY_OPT_TYPE_ATTR_CACHE
+    // special method slots of native bases are looked up the long way
+    if (lookup->meth_offset == 0) {
+        mp_type_attr_cache_entry_t *entry = TYPE_ATTR_CACHE_ENTRY(type, lookup->attr);
+        if (entry->type == type && entry->attr == lookup->attr) {
+            lookup->found = entry->found;
+            lookup->found_value = entry->value;
+            class_lookup_convert(lookup, entry->found, entry->value);
+            return;
+        }
+        bool uncacheable = lookup->uncacheable;
+        lookup->found = NULL;
+        lookup->uncacheable = false;
+        mp_obj_class_lookup_walk(lookup, type);
+        if (lookup->found != NULL && !lookup->uncacheable) {
+            entry->type = type;
+            entry->attr = lookup->attr;
+            entry->found = lookup->found;
+            entry->value = lookup->found_value;
+        }
+        lookup->uncacheable |= uncacheable;
+        return;
+    }
+    #endif
+    mp_obj_class_lookup_walk(lookup, type);
+}
+
 STATIC void instance_print(const mp_print_t *print, mp_obj_t self_in, mp_print_kind_t kind) {
     mp_obj_instance_t *self = MP_OBJ_TO_PTR(self_in);
     qstr meth = (kind == PRINT_STR) ? MP_QSTR___str__ : MP_QSTR___repr__;
@@ -1030,6 +1089,10 @@ STATIC void type_attr(mp_obj_t self_in, qstr attr, mp_obj_t *dest) {
                 // can't apply delete/store to a fixed map
                 return;
             }
+            #if MICROPY_OPT_TYPE_ATTR_CACHE
+            // this class and its subclasses may have cached the old value
+            mp_type_attr_cache_clear();
+            #endif
             if (dest[1] == MP_OBJ_NULL) {
                 // delete attribute
                 mp_map_elem_t *elem = mp_map_lookup(locals_map, MP_OBJ_NEW_QSTR(attr), MP_MAP_LOOKUP_REMOVE_IF_FOUND);
@@ -1142,6 +1205,11 @@ mp_obj_t mp_obj_new_type(qstr name, mp_obj_t bases_tuple, mp_obj_t locals_dict)
 
     o->locals_dict = MP_OBJ_TO_PTR(locals_dict);
 
+    #if MICROPY_OPT_TYPE_ATTR_CACHE
+    // the new type may have the address of a freed one still in the cache
+    mp_type_attr_cache_clear();
+    #endif
+
     #if ENABLE_SPECIAL_ACCESSORS
     // Check if the class has any special accessor methods
     if (!(o->flags & TYPE_FLAG_HAS_SPECIAL_ACCESSORS)) {
@@ -42,6 +42,10 @@ typedef struct _mp_obj_instance_t {
 mp_obj_instance_t *mp_obj_new_instance(const mp_obj_type_t *cls, const mp_obj_type_t **native_base);
 #endif
 
+#if MICROPY_OPT_TYPE_ATTR_CACHE
+void mp_type_attr_cache_clear(void);
+#endif
+
 // these need to be exposed so mp_obj_is_callable can work correctly
 bool mp_obj_instance_is_callable(mp_obj_t self_in);
 mp_obj_t mp_obj_instance_call(mp_obj_t self_in, size_t n_args, size_t n_kw, const mp_obj_t *args);
@@ -237,7 +237,7 @@ typedef struct _parser_t {
     mp_parse_chunk_t *cur_chunk;
 
     #if MICROPY_COMP_CONST
-    mp_map_t consts;
+    mp_map_t *consts;
     #endif
 } parser_t;
 
@@ -476,7 +476,7 @@ STATIC void push_result_token(parser_t *parser, uint8_t rule_id) {
         // if name is a standalone identifier, look it up in the table of dynamic constants
         mp_map_elem_t *elem;
         if (rule_id == RULE_atom
-            && (elem = mp_map_lookup(&parser->consts, MP_OBJ_NEW_QSTR(id), MP_MAP_LOOKUP)) != NULL) {
+            && (elem = mp_map_lookup(parser->consts, MP_OBJ_NEW_QSTR(id), MP_MAP_LOOKUP)) != NULL) {
             if (mp_obj_is_small_int(elem->value)) {
                 pn = mp_parse_node_new_small_int_checked(parser, elem->value);
             } else {
@@ -724,7 +724,7 @@ STATIC bool fold_constants(parser_t *parser, uint8_t rule_id, size_t num_args) {
                 }
 
                 // store the value in the table of dynamic constants
-                mp_map_elem_t *elem = mp_map_lookup(&parser->consts, MP_OBJ_NEW_QSTR(id), MP_MAP_LOOKUP_ADD_IF_NOT_FOUND);
+                mp_map_elem_t *elem = mp_map_lookup(parser->consts, MP_OBJ_NEW_QSTR(id), MP_MAP_LOOKUP_ADD_IF_NOT_FOUND);
                 assert(elem->value == MP_OBJ_NULL);
                 elem->value = value;
 
@@ -829,7 +829,9 @@ STATIC void push_result_rule(parser_t *parser, size_t src_line, uint8_t rule_id,
     push_result_node(parser, (mp_parse_node_t)pn);
 }
 
-mp_parse_tree_t mp_parse(mp_lexer_t *lex, mp_parse_input_kind_t input_kind) {
+// With one_stmt the parser stops after one top-level statement of a file input,
+// leaving the lexer at the next one
+STATIC mp_parse_tree_t parse(mp_lexer_t *lex, mp_parse_input_kind_t input_kind, mp_map_t *consts, bool one_stmt) {
 
     // initialise parser and allocate memory for its stacks
 
@@ -849,7 +851,9 @@ mp_parse_tree_t mp_parse(mp_lexer_t *lex, mp_parse_input_kind_t input_kind) {
     parser.cur_chunk = NULL;
 
     #if MICROPY_COMP_CONST
-    mp_map_init(&parser.consts, 0);
+    parser.consts = consts;
+    #else
+    (void)consts;
     #endif
 
     // work out the top-level rule to use, and push it on the stack
@@ -857,7 +861,7 @@ mp_parse_tree_t mp_parse(mp_lexer_t *lex, mp_parse_input_kind_t input_kind) {
     switch (input_kind) {
         case MP_PARSE_SINGLE_INPUT: top_level_rule = RULE_single_input; break;
         case MP_PARSE_EVAL_INPUT: top_level_rule = RULE_eval_input; break;
-        default: top_level_rule = RULE_file_input;
+        default: top_level_rule = one_stmt ? RULE_single_input : RULE_file_input;
     }
     push_rule(&parser, lex->tok_line, top_level_rule, 0);
 
@@ -1119,10 +1123,6 @@ mp_parse_tree_t mp_parse(mp_lexer_t *lex, mp_parse_input_kind_t input_kind) {
         }
     }
 
-    #if MICROPY_COMP_CONST
-    mp_map_deinit(&parser.consts);
-    #endif
-
     // truncate final chunk and link into chain of chunks
     if (parser.cur_chunk != NULL) {
         (void)m_renew_maybe(byte, parser.cur_chunk,
@@ -1135,7 +1135,7 @@ mp_parse_tree_t mp_parse(mp_lexer_t *lex, mp_parse_input_kind_t input_kind) {
     }
 
     if (
-        lex->tok_kind != MP_TOKEN_END // check we are at the end of the token stream
+        (!one_stmt && lex->tok_kind != MP_TOKEN_END) // check we are at the end of the token stream
         || parser.result_stack_top == 0 // check that we got a node (can fail on empty input)
         ) {
     syntax_error:;
@@ -1164,12 +1164,80 @@ mp_parse_tree_t mp_parse(mp_lexer_t *lex, mp_parse_input_kind_t input_kind) {
     m_del(rule_stack_t, parser.rule_stack, parser.rule_stack_alloc);
     m_del(mp_parse_node_t, parser.result_stack, parser.result_stack_alloc);
 
+    return parser.tree;
+}
+
+#if MICROPY_COMP_CONST
+STATIC void parse_consts_init(mp_map_t *consts) {
+    mp_map_init(consts, 0);
+    #if MICROPY_DYNAMIC_COMPILER
+    // seed the table with the constants given to the cross compiler
+    const mp_map_t *predef = mp_dynamic_compiler.predef_consts;
+    if (predef != NULL) {
+        for (size_t i = 0; i < predef->alloc; i++) {
+            if (mp_map_slot_is_filled(predef, i)) {
+                mp_map_lookup(consts, predef->table[i].key, MP_MAP_LOOKUP_ADD_IF_NOT_FOUND)->value = predef->table[i].value;
+            }
+        }
+    }
+    #endif
+}
+#endif
+
+mp_parse_tree_t mp_parse(mp_lexer_t *lex, mp_parse_input_kind_t input_kind) {
+    #if MICROPY_COMP_CONST
+    mp_map_t consts;
+    parse_consts_init(&consts);
+    mp_parse_tree_t tree = parse(lex, input_kind, &consts, false);
+    mp_map_deinit(&consts);
+    #else
+    mp_parse_tree_t tree = parse(lex, input_kind, NULL, false);
+    #endif
+
     // we also free the lexer on behalf of the caller
     mp_lexer_free(lex);
 
-    return parser.tree;
+    return tree;
+}
+
+#if MICROPY_PARSE_STREAMING
+void mp_parse_stream_init(mp_parse_stream_t *ps, mp_lexer_t *lex) {
+    ps->lex = lex;
+    #if MICROPY_COMP_CONST
+    parse_consts_init(&ps->consts);
+    #endif
+}
+
+bool mp_parse_stream_next(mp_parse_stream_t *ps, mp_parse_tree_t *tree) {
+    if (ps->lex == NULL) {
+        return false;
+    }
+    while (ps->lex->tok_kind == MP_TOKEN_NEWLINE) {
+        mp_lexer_to_next(ps->lex);
+    }
+    if (ps->lex->tok_kind == MP_TOKEN_END) {
+        mp_parse_stream_deinit(ps);
+        return false;
+    }
+    #if MICROPY_COMP_CONST
+    *tree = parse(ps->lex, MP_PARSE_FILE_INPUT, &ps->consts, true);
+    #else
+    *tree = parse(ps->lex, MP_PARSE_FILE_INPUT, NULL, true);
+    #endif
+    return true;
 }
 
+void mp_parse_stream_deinit(mp_parse_stream_t *ps) {
+    if (ps->lex != NULL) {
+        mp_lexer_free(ps->lex);
+        ps->lex = NULL;
+        #if MICROPY_COMP_CONST
+        mp_map_deinit(&ps->consts);
+        #endif
+    }
+}
+#endif
+
 void mp_parse_tree_clear(mp_parse_tree_t *tree) {
     mp_parse_chunk_t *chunk = tree->chunk;
     while (chunk != NULL) {
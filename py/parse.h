@@ -104,4 +104,20 @@ typedef struct _mp_parse_t {
 mp_parse_tree_t mp_parse(struct _mp_lexer_t *lex, mp_parse_input_kind_t input_kind);
 void mp_parse_tree_clear(mp_parse_tree_t *tree);
 
+#if MICROPY_PARSE_STREAMING
+// A file input parsed one top-level statement at a time, so that each can be
+// compiled and its parse tree freed before the next one is read
+typedef struct _mp_parse_stream_t {
+    struct _mp_lexer_t *lex;
+    #if MICROPY_COMP_CONST
+    mp_map_t consts;                // const() names stay defined for the later statements
+    #endif
+} mp_parse_stream_t;
+
+void mp_parse_stream_init(mp_parse_stream_t *ps, struct _mp_lexer_t *lex);
+// returns false, freeing the lexer, at the end of the input
+bool mp_parse_stream_next(mp_parse_stream_t *ps, mp_parse_tree_t *tree);
+void mp_parse_stream_deinit(mp_parse_stream_t *ps);
+#endif
+
 #endif // MICROPY_INCLUDED_PY_PARSE_H
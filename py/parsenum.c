@@ -179,16 +179,28 @@ mp_obj_t mp_parse_num_decimal(const char *str, size_t len, bool allow_imag, bool
 //   Note: EXACT_POWER_OF_10 is at least floor(log_5(2^mantissa_length)). Indeed, 10^n = 2^n * 5^n
 //   so we only have to store the 5^n part in the mantissa (the 2^n part will go into the float's
 //   exponent).
+// EXACT_MANTISSA_MAX is the largest integer below which all integers can be stored exactly in a float
 #if MICROPY_FLOAT_IMPL == MICROPY_FLOAT_IMPL_FLOAT
 #define DEC_VAL_MAX 1e20F
 #define SMALL_NORMAL_VAL (1e-37F)
 #define SMALL_NORMAL_EXP (-37)
 #define EXACT_POWER_OF_10 (9)
+#define EXACT_MANTISSA_MAX (1UL << 24)
+    typedef uint32_t dec_exact_t;
+    static const float exact_pow_10[] = {
+        1e0F, 1e1F, 1e2F, 1e3F, 1e4F, 1e5F, 1e6F, 1e7F, 1e8F, 1e9F,
+    };
 #elif MICROPY_FLOAT_IMPL == MICROPY_FLOAT_IMPL_DOUBLE
 #define DEC_VAL_MAX 1e200
 #define SMALL_NORMAL_VAL (1e-307)
 #define SMALL_NORMAL_EXP (-307)
 #define EXACT_POWER_OF_10 (22)
+#define EXACT_MANTISSA_MAX (1ULL << 53)
+    typedef uint64_t dec_exact_t;
+    static const double exact_pow_10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
 #endif
 
     const char *top = str + len;
@@ -237,6 +249,9 @@ mp_obj_t mp_parse_num_decimal(const char *str, size_t len, bool allow_imag, bool
         bool exp_neg = false;
         int exp_val = 0;
         int exp_extra = 0;
+        // the digits are accumulated as an integer for as long as they fit in the mantissa
+        dec_exact_t dec_exact = 0;
+        bool dec_is_exact = true;
         while (str < top) {
             unsigned int dig = *str++;
             if ('0' <= dig && dig <= '9') {
@@ -248,7 +263,17 @@ mp_obj_t mp_parse_num_decimal(const char *str, size_t len, bool allow_imag, bool
                     if (exp_val < (INT_MAX / 2 - 9) / 10) {
                         exp_val = 10 * exp_val + dig;
                     }
+                } else if (dec_is_exact && dec_exact <= (EXACT_MANTISSA_MAX - dig) / 10) {
+                    dec_exact = 10 * dec_exact + dig;
+                    if (in == PARSE_DEC_IN_FRAC) {
+                        --exp_extra;
+                    }
                 } else {
+                    if (dec_is_exact) {
+                        // from here on only a float can hold the digits
+                        dec_val = dec_exact;
+                        dec_is_exact = false;
+                    }
                     if (dec_val < DEC_VAL_MAX) {
                         // dec_val won't overflow so keep accumulating
                         dec_val = 10 * dec_val + dig;
@@ -295,22 +320,37 @@ mp_obj_t mp_parse_num_decimal(const char *str, size_t len, bool allow_imag, bool
             exp_val = -exp_val;
         }
 
-        // apply the exponent, making sure it's not a subnormal value
         exp_val += exp_extra;
-        if (exp_val < SMALL_NORMAL_EXP) {
-            exp_val -= SMALL_NORMAL_EXP;
-            dec_val *= SMALL_NORMAL_VAL;
-        }
-
-        // At this point, we need to multiply the mantissa by its base 10 exponent. If possible,
-        // we would rather manipulate numbers that have an exact representation in IEEE754. It
-        // turns out small positive powers of 10 do, whereas small negative powers of 10 don't.
-        // So in that case, we'll yield a division of exact values rather than a multiplication
-        // of slightly erroneous values.
-        if (exp_val < 0 && exp_val >= -EXACT_POWER_OF_10) {
-            dec_val /= MICROPY_FLOAT_C_FUN(pow)(10, -exp_val);
+        if (dec_is_exact && exp_val >= -EXACT_POWER_OF_10 && exp_val <= EXACT_POWER_OF_10) {
+            // Both the digits and the power of 10 are exact, so a single multiplication or
+            // division rounds straight to the nearest float. This covers most numbers written
+            // by hand or by a telemetry encoder.
+            if (exp_val < 0) {
+                dec_val = (mp_float_t)dec_exact / exact_pow_10[-exp_val];
+            } else {
+                dec_val = (mp_float_t)dec_exact * exact_pow_10[exp_val];
+            }
         } else {
-            dec_val *= MICROPY_FLOAT_C_FUN(pow)(10, exp_val);
+            if (dec_is_exact) {
+                dec_val = dec_exact;
+            }
+
+            // apply the exponent, making sure it's not a subnormal value
+            if (exp_val < SMALL_NORMAL_EXP) {
+                exp_val -= SMALL_NORMAL_EXP;
+                dec_val *= SMALL_NORMAL_VAL;
+            }
+
+            // At this point, we need to multiply the mantissa by its base 10 exponent. If possible,
+            // we would rather manipulate numbers that have an exact representation in IEEE754. It
+            // turns out small positive powers of 10 do, whereas small negative powers of 10 don't.
+            // So in that case, we'll yield a division of exact values rather than a multiplication
+            // of slightly erroneous values.
+            if (exp_val < 0 && exp_val >= -EXACT_POWER_OF_10) {
+                dec_val /= MICROPY_FLOAT_C_FUN(pow)(10, -exp_val);
+            } else {
+                dec_val *= MICROPY_FLOAT_C_FUN(pow)(10, exp_val);
+            }
         }
     }
 
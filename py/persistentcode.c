@@ -71,6 +71,8 @@
 #define MPY_FEATURE_ARCH (MP_NATIVE_ARCH_ARMV6)
 #elif MICROPY_EMIT_XTENSA
 #define MPY_FEATURE_ARCH (MP_NATIVE_ARCH_XTENSA)
+#elif MICROPY_EMIT_XTENSAWIN
+#define MPY_FEATURE_ARCH (MP_NATIVE_ARCH_XTENSAWIN)
 #else
 #define MPY_FEATURE_ARCH (MP_NATIVE_ARCH_NONE)
 #endif
@@ -200,7 +202,7 @@ STATIC void arch_link_qstr(uint8_t *pc, bool is_obj, qstr qst) {
     if (is_obj) {
         val = (mp_uint_t)MP_OBJ_NEW_QSTR(qst);
     }
-    #if MICROPY_EMIT_X86 || MICROPY_EMIT_X64 || MICROPY_EMIT_ARM || MICROPY_EMIT_XTENSA
+    #if MICROPY_EMIT_X86 || MICROPY_EMIT_X64 || MICROPY_EMIT_ARM || MICROPY_EMIT_XTENSA || MICROPY_EMIT_XTENSAWIN
     pc[0] = val & 0xff;
     pc[1] = (val >> 8) & 0xff;
     pc[2] = (val >> 16) & 0xff;
@@ -337,7 +339,7 @@ STATIC mp_raw_code_t *load_raw_code(mp_reader_t *reader, qstr_window_t *qw) {
     byte *ip2;
     bytecode_prelude_t prelude = {0};
     #if MICROPY_EMIT_NATIVE
-    size_t prelude_offset;
+    size_t prelude_offset = 0;
     mp_uint_t type_sig = 0;
     size_t n_qstr_link = 0;
     #endif
@@ -405,17 +407,24 @@ STATIC mp_raw_code_t *load_raw_code(mp_reader_t *reader, qstr_window_t *qw) {
     }
 
     mp_uint_t *const_table = NULL;
+    size_t n_obj = 0;
+    size_t n_raw_code = 0;
     if (kind != MP_CODE_NATIVE_ASM) {
         // Load constant table for bytecode, native and viper
 
         // Number of entries in constant table
-        size_t n_obj = read_uint(reader, NULL);
-        size_t n_raw_code = read_uint(reader, NULL);
+        n_obj = read_uint(reader, NULL);
+        n_raw_code = read_uint(reader, NULL);
 
         // Allocate constant table
         size_t n_alloc = prelude.n_pos_args + prelude.n_kwonly_args + n_obj + n_raw_code;
         if (kind != MP_CODE_BYTECODE) {
             ++n_alloc; // additional entry for mp_fun_table
+            #if MICROPY_EMIT_NATIVE_PRELUDE_AS_BYTES_OBJ
+            if (kind == MP_CODE_NATIVE_PY) {
+                ++n_alloc; // additional entry for the prelude
+            }
+            #endif
         }
         const_table = m_new(mp_uint_t, n_alloc);
         mp_uint_t *ct = const_table;
@@ -430,6 +439,13 @@ STATIC mp_raw_code_t *load_raw_code(mp_reader_t *reader, qstr_window_t *qw) {
         if (kind != MP_CODE_BYTECODE) {
             // Populate mp_fun_table entry
             *ct++ = (mp_uint_t)(uintptr_t)mp_fun_table;
+
+            #if MICROPY_EMIT_NATIVE_PRELUDE_AS_BYTES_OBJ
+            if (kind == MP_CODE_NATIVE_PY) {
+                // Populate prelude bytes object (the prelude sits at the end of the code)
+                *ct++ = (mp_uint_t)mp_obj_new_bytes(fun_data + prelude_offset, fun_data_len - prelude_offset);
+            }
+            #endif
         }
         #endif
 
@@ -478,7 +494,7 @@ mp_raw_code_t *mp_raw_code_load(mp_reader_t *reader) {
     byte header[4];
     read_bytes(reader, header, sizeof(header));
     if (header[0] != 'M'
-        || header[1] != MPY_VERSION
+        || header[1] < MPY_VERSION_MIN || header[1] > MPY_VERSION
         || MPY_FEATURE_DECODE_FLAGS(header[2]) != MPY_FEATURE_FLAGS
         || header[3] > mp_small_int_bits()
         || read_uint(reader, NULL) > QSTR_WINDOW_SIZE) {
@@ -681,6 +697,13 @@ STATIC void save_raw_code(mp_print_t *print, mp_raw_code_t *rc, qstr_window_t *q
         if (rc->kind != MP_CODE_BYTECODE) {
             // Skip saving mp_fun_table entry
             ++const_table;
+
+            #if MICROPY_EMIT_NATIVE_PRELUDE_AS_BYTES_OBJ
+            if (rc->kind == MP_CODE_NATIVE_PY && MPY_FEATURE_ARCH_DYNAMIC == MP_NATIVE_ARCH_XTENSAWIN) {
+                // Skip saving prelude bytes object, it is recreated on load
+                ++const_table;
+            }
+            #endif
         }
 
         // Save constant objects and raw code children
@@ -693,7 +716,7 @@ STATIC void save_raw_code(mp_print_t *print, mp_raw_code_t *rc, qstr_window_t *q
     }
 }
 
-STATIC bool mp_raw_code_has_native(mp_raw_code_t *rc) {
+bool mp_raw_code_has_native(mp_raw_code_t *rc) {
     if (rc->kind != MP_CODE_BYTECODE) {
         return true;
     }
@@ -767,8 +790,394 @@ void mp_raw_code_save_file(mp_raw_code_t *rc, const char *filename) {
     close(fd);
 }
 
-#else
+#elif !MICROPY_MODULE_FROZEN_XIP
+// (ports that only save code into an execute-in-place image don't need it)
 #error mp_raw_code_save_file not implemented for this platform
 #endif
 
 #endif // MICROPY_PERSISTENT_CODE_SAVE
+
+#if MICROPY_MODULE_FROZEN_XIP
+
+#if !MICROPY_PERSISTENT_CODE_LOAD || !MICROPY_PERSISTENT_CODE_SAVE
+#error MICROPY_MODULE_FROZEN_XIP requires MICROPY_PERSISTENT_CODE_LOAD and MICROPY_PERSISTENT_CODE_SAVE
+#endif
+#if MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE
+#error MICROPY_MODULE_FROZEN_XIP needs bytecode that is never written to
+#endif
+
+#include "py/mphal.h"
+#include "py/mperrno.h"
+#include "py/compile.h"
+
+// An execute-in-place image holds modules with their qstrs already linked,
+// against the constant qstr pools followed by the image's own qstrs, so the
+// bytecode runs from wherever the image is mapped.  Only the constant tables
+// and raw code objects are created in the heap at import time.
+//
+// The image, multi-byte header fields are little endian:
+//  byte[4]     "MPXI"
+//  byte[4]     .mpy version, feature flags, bits in a small int, 0
+//  uint32      length of the image
+//  uint32      fingerprint of the constant qstrs that the image is linked against
+//  uint16      number of constant qstrs, the id of the first qstr of the image
+//  uint16      number of qstrs in the image
+//  uint32      offset of the qstr entries, stored back to back
+//  uint32      number of modules
+//  uint32      offset of the module names, "name1.py\0name2.py\0\0"
+//  uint32[]    offset of the code of each module
+//
+// The code of a module is a tree of raw code, each one stored as:
+//  uint        length of the bytecode
+//  byte[]      the bytecode, executed in place
+//  uint        number of constant objects, number of children
+//  uint16[]    qstr of each argument name
+//  ...         constant objects as in .mpy files, str/bytes data has a '\0' after it
+//  ...         children
+
+#define XIP_HEADER_SIZE (32)
+
+// The image that modules are imported from, NULL if there is no valid image
+STATIC const byte *xip_image;
+
+STATIC uint32_t xip_get_u16(const byte *p) {
+    return p[0] | p[1] << 8;
+}
+
+STATIC uint32_t xip_get_u32(const byte *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+STATIC void xip_put_u16(byte *p, uint32_t val) {
+    p[0] = val;
+    p[1] = val >> 8;
+}
+
+STATIC void xip_put_u32(byte *p, uint32_t val) {
+    p[0] = val;
+    p[1] = val >> 8;
+    p[2] = val >> 16;
+    p[3] = val >> 24;
+}
+
+// Detects a different set of constant qstrs, ie an image built by other firmware
+STATIC uint32_t xip_qstr_fingerprint(size_t n_qstr) {
+    uint32_t h = n_qstr;
+    for (qstr q = 1; q < n_qstr; q++) {
+        h = (h * 33) ^ qstr_hash(q);
+    }
+    return h;
+}
+
+void mp_raw_code_xip_init(void) {
+    xip_image = NULL;
+    size_t max_len;
+    const byte *image = mp_hal_xip_image(&max_len);
+    if (image == NULL || max_len < XIP_HEADER_SIZE || memcmp(image, "MPXI", 4) != 0) {
+        return;
+    }
+    size_t n_const_qstr = qstr_const_total();
+    if (image[4] != MPY_VERSION
+        || image[5] != MPY_FEATURE_FLAGS
+        || image[6] != mp_small_int_bits()
+        || xip_get_u32(image + 8) > max_len
+        || xip_get_u16(image + 16) != n_const_qstr
+        || xip_get_u32(image + 12) != xip_qstr_fingerprint(n_const_qstr)) {
+        // not linked against this firmware so its bytecode can't be used
+        return;
+    }
+    qstr_add_const_entries(image + xip_get_u32(image + 20), xip_get_u16(image + 18));
+    xip_image = image;
+}
+
+const char *mp_raw_code_xip_names(void) {
+    if (xip_image == NULL) {
+        return NULL;
+    }
+    return (const char*)xip_image + xip_get_u32(xip_image + 28);
+}
+
+STATIC mp_obj_t xip_load_obj(const byte **ptr) {
+    byte obj_type = *(*ptr)++;
+    if (obj_type == 'e') {
+        return MP_OBJ_FROM_PTR(&mp_const_ellipsis_obj);
+    }
+    size_t len = mp_decode_uint(ptr);
+    const byte *data = *ptr;
+    *ptr += len;
+    if (obj_type == 's' || obj_type == 'b') {
+        // the data stays in the image
+        *ptr += 1;
+        mp_obj_str_t *o = m_new_obj(mp_obj_str_t);
+        o->base.type = obj_type == 's' ? &mp_type_str : &mp_type_bytes;
+        o->hash = qstr_compute_hash(data, len);
+        o->len = len;
+        o->data = data;
+        return MP_OBJ_FROM_PTR(o);
+    } else if (obj_type == 'i') {
+        return mp_parse_num_integer((const char*)data, len, 10, NULL);
+    } else {
+        assert(obj_type == 'f' || obj_type == 'c');
+        return mp_parse_num_decimal((const char*)data, len, obj_type == 'c', false, NULL);
+    }
+}
+
+STATIC mp_raw_code_t *xip_load_raw_code(const byte **ptr) {
+    size_t fun_data_len = mp_decode_uint(ptr);
+    const byte *fun_data = *ptr;
+    *ptr += fun_data_len;
+
+    const byte *ip = fun_data;
+    const byte *ip2;
+    bytecode_prelude_t prelude;
+    extract_prelude(&ip, &ip2, &prelude);
+
+    size_t n_obj = mp_decode_uint(ptr);
+    size_t n_raw_code = mp_decode_uint(ptr);
+    size_t n_arg_names = prelude.n_pos_args + prelude.n_kwonly_args;
+    mp_uint_t *const_table = m_new(mp_uint_t, n_arg_names + n_obj + n_raw_code);
+    mp_uint_t *ct = const_table;
+    for (size_t i = 0; i < n_arg_names; ++i) {
+        *ct++ = (mp_uint_t)MP_OBJ_NEW_QSTR(xip_get_u16(*ptr));
+        *ptr += 2;
+    }
+    for (size_t i = 0; i < n_obj; ++i) {
+        *ct++ = (mp_uint_t)xip_load_obj(ptr);
+    }
+    for (size_t i = 0; i < n_raw_code; ++i) {
+        *ct++ = (mp_uint_t)(uintptr_t)xip_load_raw_code(ptr);
+    }
+
+    mp_raw_code_t *rc = mp_emit_glue_new_raw_code();
+    mp_emit_glue_assign_bytecode(rc, fun_data, fun_data_len, const_table,
+        n_obj, n_raw_code, prelude.scope_flags);
+    return rc;
+}
+
+mp_raw_code_t *mp_raw_code_load_xip(size_t idx) {
+    assert(xip_image != NULL && idx < xip_get_u32(xip_image + 24));
+    const byte *ptr = xip_image + xip_get_u32(xip_image + XIP_HEADER_SIZE + 4 * idx);
+    return xip_load_raw_code(&ptr);
+}
+
+typedef struct _xip_build_t {
+    mp_print_t *print; // destination of the image, NULL while sizing it
+    mp_print_t out; // goes through xip_print_strn to count the bytes
+    size_t len;
+    size_t qstr_base;
+    mp_map_t qstr_map; // run-time qstr -> qstr in the image
+} xip_build_t;
+
+STATIC void xip_print_strn(void *env, const char *str, size_t len) {
+    xip_build_t *b = env;
+    if (b->print != NULL) {
+        b->print->print_strn(b->print->data, str, len);
+    }
+    b->len += len;
+}
+
+STATIC qstr xip_link_qstr(xip_build_t *b, qstr qst) {
+    if (qst < b->qstr_base) {
+        return qst;
+    }
+    mp_map_elem_t *elem = mp_map_lookup(&b->qstr_map, MP_OBJ_NEW_QSTR(qst), MP_MAP_LOOKUP_ADD_IF_NOT_FOUND);
+    if (elem->value == MP_OBJ_NULL) {
+        size_t id = b->qstr_base + b->qstr_map.used - 1;
+        if (id > 0xffff) {
+            mp_raise_ValueError("too many qstrs");
+        }
+        elem->value = MP_OBJ_NEW_SMALL_INT(id);
+    }
+    return MP_OBJ_SMALL_INT_VALUE(elem->value);
+}
+
+STATIC void xip_save_qstr(xip_build_t *b, qstr qst) {
+    byte buf[2];
+    xip_put_u16(buf, xip_link_qstr(b, qst));
+    mp_print_bytes(&b->out, buf, 2);
+}
+
+STATIC void xip_save_raw_code(xip_build_t *b, mp_raw_code_t *rc) {
+    if (rc->kind != MP_CODE_BYTECODE) {
+        mp_raise_ValueError("native code can't be executed in place");
+    }
+
+    // link the qstrs of a copy of the bytecode
+    size_t len = rc->fun_data_len;
+    byte *code = m_new(byte, len);
+    memcpy(code, rc->fun_data, len);
+    const byte *ip = code;
+    const byte *ip2;
+    bytecode_prelude_t prelude;
+    extract_prelude(&ip, &ip2, &prelude);
+    byte *p = (byte*)ip2;
+    xip_put_u16(p, xip_link_qstr(b, p[0] | (p[1] << 8))); // simple_name
+    xip_put_u16(p + 2, xip_link_qstr(b, p[2] | (p[3] << 8))); // source_file
+    for (p = (byte*)ip; p < code + len;) {
+        size_t sz;
+        uint f = mp_opcode_format(p, &sz, true);
+        if (f == MP_OPCODE_QSTR) {
+            xip_put_u16(p + 1, xip_link_qstr(b, p[1] | (p[2] << 8)));
+        }
+        p += sz;
+    }
+    mp_print_uint(&b->out, len);
+    mp_print_bytes(&b->out, code, len);
+    m_del(byte, code, len);
+
+    mp_print_uint(&b->out, rc->n_obj);
+    mp_print_uint(&b->out, rc->n_raw_code);
+    const mp_uint_t *const_table = rc->const_table;
+    for (size_t i = 0; i < prelude.n_pos_args + prelude.n_kwonly_args; ++i) {
+        xip_save_qstr(b, MP_OBJ_QSTR_VALUE((mp_obj_t)*const_table++));
+    }
+    for (size_t i = 0; i < rc->n_obj; ++i) {
+        mp_obj_t o = (mp_obj_t)*const_table++;
+        save_obj(&b->out, o);
+        if (mp_obj_is_str_or_bytes(o)) {
+            mp_print_bytes(&b->out, (const byte*)"", 1);
+        }
+    }
+    for (size_t i = 0; i < rc->n_raw_code; ++i) {
+        xip_save_raw_code(b, (mp_raw_code_t*)(uintptr_t)*const_table++);
+    }
+}
+
+// Gets the name of a module as it's imported, and the file it comes from
+STATIC const char *xip_module_path(mp_obj_t item, vstr_t *names) {
+    const char *path;
+    if (mp_obj_is_type(item, &mp_type_tuple)) {
+        mp_obj_t *name_path;
+        mp_obj_get_array_fixed_n(item, 2, &name_path);
+        vstr_add_str(names, mp_obj_str_get_str(name_path[0]));
+        path = mp_obj_str_get_str(name_path[1]);
+    } else {
+        // the base name of the file, always with a .py extension
+        path = mp_obj_str_get_str(item);
+        const char *base = strrchr(path, '/');
+        base = base == NULL ? path : base + 1;
+        size_t len = strlen(base);
+        if (len > 4 && strcmp(base + len - 4, ".mpy") == 0) {
+            len -= 4;
+        } else if (len > 3 && strcmp(base + len - 3, ".py") == 0) {
+            len -= 3;
+        }
+        vstr_add_strn(names, base, len);
+        vstr_add_str(names, ".py");
+    }
+    vstr_add_byte(names, '\0');
+    return path;
+}
+
+STATIC mp_raw_code_t *xip_module_load(const char *path, const char *name) {
+    size_t len = strlen(path);
+    if (len > 4 && strcmp(path + len - 4, ".mpy") == 0) {
+        return mp_raw_code_load_file(path);
+    }
+    #if MICROPY_ENABLE_COMPILER
+    mp_lexer_t *lex = mp_lexer_new_from_file(path);
+    mp_parse_tree_t parse_tree = mp_parse(lex, MP_PARSE_FILE_INPUT);
+    return mp_compile_to_raw_code(&parse_tree, qstr_from_str(name), MP_EMIT_OPT_NONE, false);
+    #else
+    (void)name;
+    mp_raise_ValueError("only .mpy files can be added");
+    #endif
+}
+
+void mp_raw_code_save_xip(mp_obj_t modules, mp_print_t *print) {
+    if (xip_image != NULL) {
+        // the image being replaced may still be running
+        mp_raise_OSError(MP_EBUSY);
+    }
+
+    size_t n_modules;
+    mp_obj_t *items;
+    mp_obj_get_array(modules, &n_modules, &items);
+    vstr_t names;
+    vstr_init(&names, 16);
+    const char **paths = m_new(const char*, n_modules);
+    size_t *name_offsets = m_new(size_t, n_modules);
+    for (size_t i = 0; i < n_modules; ++i) {
+        name_offsets[i] = names.len;
+        paths[i] = xip_module_path(items[i], &names);
+    }
+    vstr_add_byte(&names, '\0');
+
+    xip_build_t b;
+    b.print = NULL;
+    b.out.data = &b;
+    b.out.print_strn = xip_print_strn;
+    b.qstr_base = qstr_const_total();
+    mp_map_init(&b.qstr_map, 0);
+
+    // the first pass sizes the image and picks the ids of its qstrs, the
+    // second one writes it with the same qstrs
+    size_t *code_offsets = m_new(size_t, n_modules);
+    size_t qstr_offset = 0;
+    size_t image_len = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        b.len = 0;
+        if (pass == 1) {
+            b.print = print;
+            byte header[XIP_HEADER_SIZE];
+            memcpy(header, "MPXI", 4);
+            header[4] = MPY_VERSION;
+            header[5] = MPY_FEATURE_FLAGS;
+            header[6] = mp_small_int_bits();
+            header[7] = 0;
+            xip_put_u32(header + 8, image_len);
+            xip_put_u32(header + 12, xip_qstr_fingerprint(b.qstr_base));
+            xip_put_u16(header + 16, b.qstr_base);
+            xip_put_u16(header + 18, b.qstr_map.used);
+            xip_put_u32(header + 20, qstr_offset);
+            xip_put_u32(header + 24, n_modules);
+            xip_put_u32(header + 28, XIP_HEADER_SIZE + 4 * n_modules);
+            mp_print_bytes(&b.out, header, sizeof(header));
+            for (size_t i = 0; i < n_modules; ++i) {
+                byte offset[4];
+                xip_put_u32(offset, code_offsets[i]);
+                mp_print_bytes(&b.out, offset, 4);
+            }
+            mp_print_bytes(&b.out, (const byte*)names.buf, names.len);
+        } else {
+            b.len = XIP_HEADER_SIZE + 4 * n_modules + names.len;
+        }
+        for (size_t i = 0; i < n_modules; ++i) {
+            code_offsets[i] = b.len;
+            mp_raw_code_t *rc = xip_module_load(paths[i], names.buf + name_offsets[i]);
+            xip_save_raw_code(&b, rc);
+        }
+        qstr_offset = b.len;
+        image_len = qstr_offset;
+        for (size_t i = 0; i < b.qstr_map.alloc; ++i) {
+            if (mp_map_slot_is_filled(&b.qstr_map, i)) {
+                size_t n_bytes;
+                qstr_entry(MP_OBJ_QSTR_VALUE(b.qstr_map.table[i].key), &n_bytes);
+                image_len += n_bytes;
+            }
+        }
+    }
+
+    // the qstr entries, in the order of their ids
+    qstr *qstrs = m_new(qstr, b.qstr_map.used);
+    for (size_t i = 0; i < b.qstr_map.alloc; ++i) {
+        if (mp_map_slot_is_filled(&b.qstr_map, i)) {
+            qstrs[MP_OBJ_SMALL_INT_VALUE(b.qstr_map.table[i].value) - b.qstr_base] = MP_OBJ_QSTR_VALUE(b.qstr_map.table[i].key);
+        }
+    }
+    for (size_t i = 0; i < b.qstr_map.used; ++i) {
+        size_t n_bytes;
+        const byte *entry = qstr_entry(qstrs[i], &n_bytes);
+        mp_print_bytes(&b.out, entry, n_bytes);
+    }
+    assert(b.len == image_len);
+
+    m_del(qstr, qstrs, b.qstr_map.used);
+    mp_map_deinit(&b.qstr_map);
+    m_del(size_t, code_offsets, n_modules);
+    m_del(size_t, name_offsets, n_modules);
+    m_del(const char*, paths, n_modules);
+    vstr_clear(&names);
+}
+
+#endif // MICROPY_MODULE_FROZEN_XIP
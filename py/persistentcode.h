@@ -31,7 +31,11 @@
 #include "py/emitglue.h"
 
 // The current version of .mpy files
-#define MPY_VERSION 4
+#define MPY_VERSION 5
+
+// The oldest version that can still be loaded; version 5 only added the fused
+// bytecodes so the rest of the format is the same
+#define MPY_VERSION_MIN 4
 
 enum {
     MP_NATIVE_ARCH_NONE = 0,
@@ -44,6 +48,7 @@ enum {
     MP_NATIVE_ARCH_ARMV7EMSP,
     MP_NATIVE_ARCH_ARMV7EMDP,
     MP_NATIVE_ARCH_XTENSA,
+    MP_NATIVE_ARCH_XTENSAWIN,
 };
 
 mp_raw_code_t *mp_raw_code_load(mp_reader_t *reader);
@@ -51,6 +56,18 @@ mp_raw_code_t *mp_raw_code_load_mem(const byte *buf, size_t len);
 mp_raw_code_t *mp_raw_code_load_file(const char *filename);
 
 void mp_raw_code_save(mp_raw_code_t *rc, mp_print_t *print);
+bool mp_raw_code_has_native(mp_raw_code_t *rc);
 void mp_raw_code_save_file(mp_raw_code_t *rc, const char *filename);
 
+#if MICROPY_MODULE_FROZEN_XIP
+// Picks up the port's execute-in-place image, straight after qstr_init
+void mp_raw_code_xip_init(void);
+// Names of the modules in the image (like mp_frozen_mpy_names), NULL if none
+const char *mp_raw_code_xip_names(void);
+mp_raw_code_t *mp_raw_code_load_xip(size_t idx);
+// Builds an image from a sequence of paths to .py/.mpy files, or of
+// (name, path) tuples, and writes it to print; the image can't be in use
+void mp_raw_code_save_xip(mp_obj_t modules, mp_print_t *print);
+#endif
+
 #endif // MICROPY_INCLUDED_PY_PERSISTENTCODE_H
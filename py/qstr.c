@@ -120,6 +120,51 @@ extern const qstr_pool_t MICROPY_QSTR_EXTRA_POOL;
 #define CONST_POOL mp_qstr_const_pool
 #endif
 
+#if MICROPY_QSTR_HASH_INDEX
+
+STATIC void qstr_index_insert(qstr_index_t *index, qstr q, mp_uint_t hash) {
+    size_t mask = index->alloc - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        if (index->slots[i] == 0) {
+            index->slots[i] = q;
+            index->used += 1;
+            return;
+        }
+    }
+}
+
+// Replace the index with one that has room for n_extra more qstrs
+STATIC void qstr_index_rebuild(size_t n_extra) {
+    size_t n = QSTR_TOTAL() + n_extra;
+    size_t alloc = 64;
+    while (alloc * 3 < n * 4) {
+        alloc *= 2;
+    }
+    qstr_index_t *index = NULL;
+    if (n <= 0xffff) {
+        index = m_new_obj_var_maybe(qstr_index_t, uint16_t, alloc);
+    }
+    if (index != NULL) {
+        index->alloc = alloc;
+        index->used = 0;
+        memset(index->slots, 0, alloc * sizeof(uint16_t));
+        for (qstr_pool_t *pool = MP_STATE_VM(last_pool); pool != NULL; pool = pool->prev) {
+            for (size_t i = 0; i < pool->len; i++) {
+                qstr q = pool->total_prev_len + i;
+                if (q != MP_QSTR_NULL) {
+                    qstr_index_insert(index, q, Q_GET_HASH(pool->qstrs[i]));
+                }
+            }
+        }
+    }
+    // Without an index (out of memory or too many qstrs) lookups search the
+    // pools.  The old index isn't freed because a lookup in another thread may
+    // still be using it.
+    MP_STATE_VM(qstr_index) = index;
+}
+
+#endif
+
 void qstr_init(void) {
     MP_STATE_VM(last_pool) = (qstr_pool_t*)&CONST_POOL; // we won't modify the const_pool since it has no allocated room left
     MP_STATE_VM(qstr_last_chunk) = NULL;
@@ -127,6 +172,10 @@ void qstr_init(void) {
     #if MICROPY_PY_THREAD
     mp_thread_mutex_init(&MP_STATE_VM(qstr_mutex));
     #endif
+
+    #if MICROPY_QSTR_HASH_INDEX
+    qstr_index_rebuild(MICROPY_ALLOC_QSTR_ENTRIES_INIT);
+    #endif
 }
 
 STATIC const byte *find_qstr(qstr q) {
@@ -166,6 +215,18 @@ STATIC qstr qstr_add(const byte *q_ptr) {
     // add the new qstr
     MP_STATE_VM(last_pool)->qstrs[MP_STATE_VM(last_pool)->len++] = q_ptr;
 
+    #if MICROPY_QSTR_HASH_INDEX
+    qstr_index_t *index = MP_STATE_VM(qstr_index);
+    if (index != NULL) {
+        if ((index->used + 1) * 4 > index->alloc * 3 || QSTR_TOTAL() > 0xffff) {
+            // grow by half the qstrs there are, which includes the new one
+            qstr_index_rebuild(QSTR_TOTAL() / 2);
+        } else {
+            qstr_index_insert(index, QSTR_TOTAL() - 1, Q_GET_HASH(q_ptr));
+        }
+    }
+    #endif
+
     // return id for the newly-added qstr
     return MP_STATE_VM(last_pool)->total_prev_len + MP_STATE_VM(last_pool)->len - 1;
 }
@@ -174,6 +235,23 @@ qstr qstr_find_strn(const char *str, size_t str_len) {
     // work out hash of str
     mp_uint_t str_hash = qstr_compute_hash((const byte*)str, str_len);
 
+    #if MICROPY_QSTR_HASH_INDEX
+    qstr_index_t *index = MP_STATE_VM(qstr_index);
+    if (index != NULL) {
+        size_t mask = index->alloc - 1;
+        for (size_t i = str_hash & mask;; i = (i + 1) & mask) {
+            qstr q = index->slots[i];
+            if (q == MP_QSTR_NULL) {
+                return 0;
+            }
+            const byte *qd = find_qstr(q);
+            if (Q_GET_HASH(qd) == str_hash && Q_GET_LENGTH(qd) == str_len && memcmp(Q_GET_DATA(qd), str, str_len) == 0) {
+                return q;
+            }
+        }
+    }
+    #endif
+
     // search pools for the data
     for (qstr_pool_t *pool = MP_STATE_VM(last_pool); pool != NULL; pool = pool->prev) {
         for (const byte **q = pool->qstrs, **q_top = pool->qstrs + pool->len; q < q_top; q++) {
@@ -271,6 +349,39 @@ const byte *qstr_data(qstr q, size_t *len) {
     return Q_GET_DATA(qd);
 }
 
+#if MICROPY_MODULE_FROZEN_XIP
+size_t qstr_const_total(void) {
+    return CONST_POOL.total_prev_len + CONST_POOL.len;
+}
+
+const byte *qstr_entry(qstr q, size_t *n_bytes) {
+    const byte *qd = find_qstr(q);
+    *n_bytes = Q_GET_ALLOC(qd);
+    return qd;
+}
+
+void qstr_add_const_entries(const byte *data, size_t n) {
+    assert(QSTR_TOTAL() == qstr_const_total());
+    if (n == 0) {
+        return;
+    }
+    qstr_pool_t *pool = m_new_obj_var(qstr_pool_t, const char*, n);
+    pool->prev = MP_STATE_VM(last_pool);
+    pool->total_prev_len = QSTR_TOTAL();
+    // like the frozen pool this one is full, alloc only sizes the next pool
+    pool->alloc = MIN(n, MICROPY_ALLOC_QSTR_ENTRIES_INIT);
+    pool->len = n;
+    for (size_t i = 0; i < n; i++) {
+        pool->qstrs[i] = data;
+        data += Q_GET_ALLOC(data);
+    }
+    MP_STATE_VM(last_pool) = pool;
+    #if MICROPY_QSTR_HASH_INDEX
+    qstr_index_rebuild(MICROPY_ALLOC_QSTR_ENTRIES_INIT);
+    #endif
+}
+#endif
+
 void qstr_pool_info(size_t *n_pool, size_t *n_qstr, size_t *n_str_data_bytes, size_t *n_total_bytes) {
     QSTR_ENTER();
     *n_pool = 0;
@@ -290,6 +401,11 @@ void qstr_pool_info(size_t *n_pool, size_t *n_qstr, size_t *n_str_data_bytes, si
         #endif
     }
     *n_total_bytes += *n_str_data_bytes;
+    #if MICROPY_QSTR_HASH_INDEX && MICROPY_ENABLE_GC
+    if (MP_STATE_VM(qstr_index) != NULL) {
+        *n_total_bytes += gc_nbytes(MP_STATE_VM(qstr_index));
+    }
+    #endif
     QSTR_EXIT();
 }
 
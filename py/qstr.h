@@ -55,6 +55,15 @@ typedef struct _qstr_pool_t {
     const byte *qstrs[];
 } qstr_pool_t;
 
+#if MICROPY_QSTR_HASH_INDEX
+// Open-addressed table of qstr ids, probed linearly from the qstr's hash
+typedef struct _qstr_index_t {
+    size_t alloc; // a power of 2
+    size_t used;
+    uint16_t slots[]; // 0 (MP_QSTR_NULL) marks an empty slot
+} qstr_index_t;
+#endif
+
 #define QSTR_FROM_STR_STATIC(s) (qstr_from_strn((s), strlen(s)))
 #define QSTR_TOTAL() (MP_STATE_VM(last_pool)->total_prev_len + MP_STATE_VM(last_pool)->len)
 
@@ -71,6 +80,16 @@ const char *qstr_str(qstr q);
 size_t qstr_len(qstr q);
 const byte *qstr_data(qstr q, size_t *len);
 
+#if MICROPY_MODULE_FROZEN_XIP
+// Number of qstrs in the constant pools, the first run-time qstr has this id
+size_t qstr_const_total(void);
+// Interned entry of a qstr (hash, length, data and '\0'), to copy verbatim
+const byte *qstr_entry(qstr q, size_t *n_bytes);
+// Add n entries stored back to back as a pool straight after the constant
+// pools, before any other qstr is created; data must stay valid
+void qstr_add_const_entries(const byte *data, size_t n);
+#endif
+
 void qstr_pool_info(size_t *n_pool, size_t *n_qstr, size_t *n_str_data_bytes, size_t *n_total_bytes);
 void qstr_dump_data(void);
 
@@ -35,12 +35,15 @@
 #include "py/objtuple.h"
 #include "py/objlist.h"
 #include "py/objmodule.h"
+#include "py/objtype.h"
 #include "py/objgenerator.h"
 #include "py/smallint.h"
 #include "py/runtime.h"
 #include "py/builtin.h"
 #include "py/stackctrl.h"
 #include "py/gc.h"
+#include "py/persistentcode.h"
+#include "py/mperrno.h"
 
 #if MICROPY_DEBUG_VERBOSE // print debugging info
 #define DEBUG_PRINT (1)
@@ -56,11 +59,57 @@ const mp_obj_module_t mp_module___main__ = {
     .globals = (mp_obj_dict_t*)&MP_STATE_VM(dict_main),
 };
 
+STATIC MP_DEFINE_STR_OBJ(prealloc_exc_timed_out_obj, "timed out");
+STATIC const mp_rom_obj_tuple_t prealloc_exc_eagain_args = {{&mp_type_tuple}, 1, {MP_ROM_INT(MP_EAGAIN)}};
+STATIC const mp_rom_obj_tuple_t prealloc_exc_etimedout_args = {{&mp_type_tuple}, 1, {MP_ROM_INT(MP_ETIMEDOUT)}};
+STATIC const mp_rom_obj_tuple_t prealloc_exc_timeout_args = {{&mp_type_tuple}, 1, {MP_ROM_PTR(&prealloc_exc_timed_out_obj)}};
+
+STATIC const struct {
+    const mp_obj_type_t *type;
+    const mp_rom_obj_tuple_t *args;
+} prealloc_exc_table[MP_PREALLOC_EXC_NUM] = {
+    [MP_PREALLOC_EXC_STOP_ITERATION] = { &mp_type_StopIteration, (const mp_rom_obj_tuple_t*)&mp_const_empty_tuple_obj },
+    [MP_PREALLOC_EXC_EAGAIN] = { &mp_type_OSError, &prealloc_exc_eagain_args },
+    [MP_PREALLOC_EXC_ETIMEDOUT] = { &mp_type_OSError, &prealloc_exc_etimedout_args },
+    #if MICROPY_PY_BUILTINS_TIMEOUTERROR
+    [MP_PREALLOC_EXC_TIMEOUT] = { &mp_type_TimeoutError, &prealloc_exc_timeout_args },
+    #else
+    [MP_PREALLOC_EXC_TIMEOUT] = { &mp_type_OSError, &prealloc_exc_timeout_args },
+    #endif
+};
+
 void mp_init(void) {
     qstr_init();
 
+    #if MICROPY_MODULE_FROZEN_XIP
+    // the image's qstrs must come straight after the constant ones
+    mp_raw_code_xip_init();
+    #endif
+
     // no pending exceptions to start with
     MP_STATE_VM(mp_pending_exception) = MP_OBJ_NULL;
+
+    #if MICROPY_OPT_MAP_LOOKUP_CACHE
+    memset(MP_STATE_VM(map_lookup_cache), 0, sizeof(MP_STATE_VM(map_lookup_cache)));
+    #endif
+
+    #if MICROPY_OPT_TYPE_ATTR_CACHE
+    // the types of the previous session are gone
+    mp_type_attr_cache_clear();
+    #endif
+
+    #if MICROPY_TRACK_CODE_STATE
+    MP_STATE_THREAD(current_code_state) = NULL;
+    #endif
+
+    #if MICROPY_OPT_CODE_STATE_POOL
+    // the pooled frames went with the previous heap
+    MP_STATE_THREAD(code_state_pool_len) = 0;
+    #endif
+
+    #if MICROPY_PY_MICROPYTHON_PROFILE
+    MP_STATE_VM(profile_buf) = NULL;
+    #endif
     #if MICROPY_ENABLE_SCHEDULER
     MP_STATE_VM(sched_state) = MP_SCHED_IDLE;
     MP_STATE_VM(sched_idx) = 0;
@@ -80,6 +129,17 @@ void mp_init(void) {
     MP_STATE_VM(mp_kbd_exception).args = (mp_obj_tuple_t*)&mp_const_empty_tuple_obj;
     #endif
 
+    #if MICROPY_ENABLE_PREALLOC_EXCEPTIONS
+    for (size_t i = 0; i < MP_PREALLOC_EXC_NUM; i++) {
+        mp_obj_exception_t *exc = &MP_STATE_VM(mp_prealloc_exc)[i];
+        exc->base.type = prealloc_exc_table[i].type;
+        exc->traceback_alloc = 0;
+        exc->traceback_len = 0;
+        exc->traceback_data = MP_OBJ_EXCEPTION_NO_TRACEBACK;
+        exc->args = (mp_obj_tuple_t*)prealloc_exc_table[i].args;
+    }
+    #endif
+
     // call port specific initialization if any
 #ifdef MICROPY_PORT_INIT_FUNC
     MICROPY_PORT_INIT_FUNC;
@@ -112,6 +172,10 @@ void mp_init(void) {
     }
     #endif
 
+    #if MICROPY_PY_URE && MICROPY_PY_URE_CACHE_SIZE
+    memset(MP_STATE_VM(ure_cache), 0, sizeof(MP_STATE_VM(ure_cache)));
+    #endif
+
     #if MICROPY_VFS
     // initialise the VFS sub-system
     MP_STATE_VM(vfs_cur) = NULL;
@@ -120,6 +184,12 @@ void mp_init(void) {
 
     #if MICROPY_PY_THREAD_GIL
     mp_thread_mutex_init(&MP_STATE_VM(gil_mutex));
+    #if MICROPY_PY_THREAD_GIL_ADAPTIVE
+    MP_STATE_VM(gil_slice_us) = MICROPY_PY_THREAD_GIL_SLICE_US;
+    MP_STATE_VM(gil_acquires) = 0;
+    MP_STATE_VM(gil_contended) = 0;
+    MP_STATE_VM(gil_handoffs) = 0;
+    #endif
     #endif
 
     MP_THREAD_GIL_ENTER();
@@ -1478,6 +1548,22 @@ NORETURN void mp_raise_OSError(int errno_) {
     nlr_raise(mp_obj_new_exception_arg1(&mp_type_OSError, MP_OBJ_NEW_SMALL_INT(errno_)));
 }
 
+// Raises one of a few exceptions that are common in hot paths.  With
+// MICROPY_ENABLE_PREALLOC_EXCEPTIONS the same object is raised every time
+// and no traceback is recorded, so nothing is allocated.
+NORETURN void mp_raise_prealloc(mp_prealloc_exc_t kind) {
+    #if MICROPY_ENABLE_PREALLOC_EXCEPTIONS
+    mp_obj_exception_t *exc = &MP_STATE_VM(mp_prealloc_exc)[kind];
+    // a re-raise from Python code clears the traceback marker
+    exc->traceback_len = 0;
+    exc->traceback_data = MP_OBJ_EXCEPTION_NO_TRACEBACK;
+    nlr_raise(MP_OBJ_FROM_PTR(exc));
+    #else
+    const mp_rom_obj_tuple_t *args = prealloc_exc_table[kind].args;
+    nlr_raise(mp_obj_new_exception_args(prealloc_exc_table[kind].type, args->len, (const mp_obj_t*)args->items));
+    #endif
+}
+
 NORETURN void mp_raise_NotImplementedError(const char *msg) {
     mp_raise_msg(&mp_type_NotImplementedError, msg);
 }
@@ -36,12 +36,14 @@ enum {
     ID_INFO_KIND_LOCAL, // in a function f, written and only referenced by f
     ID_INFO_KIND_CELL,  // in a function f, read/written by children of f
     ID_INFO_KIND_FREE,  // in a function f, belongs to the parent of f
+    ID_INFO_KIND_FREE_VALUE, // like FREE, but f gets its value rather than a cell
 };
 
 enum {
     ID_FLAG_IS_PARAM = 0x01,
     ID_FLAG_IS_STAR_PARAM = 0x02,
     ID_FLAG_IS_DBL_STAR_PARAM = 0x04,
+    ID_FLAG_IS_STORED = 0x08, // assigned to or deleted in the scope
     ID_FLAG_VIPER_TYPE_POS = 4,
 };
 
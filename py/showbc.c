@@ -191,6 +191,20 @@ const byte *mp_bytecode_print_str(const byte *ip) {
             break;
         }
 
+        case MP_BC_BINARY_OP_SMALL_INT: {
+            mp_int_t num = 0;
+            if ((ip[0] & 0x40) != 0) {
+                // Number is negative
+                num--;
+            }
+            do {
+                num = (num << 7) | (*ip & 0x7f);
+            } while ((*ip++ & 0x80) != 0);
+            mp_uint_t op = *ip++;
+            printf("BINARY_OP_SMALL_INT " INT_FMT " " UINT_FMT " %s", num, op, qstr_str(mp_binary_op_method_name[op]));
+            break;
+        }
+
         case MP_BC_LOAD_CONST_STRING:
             DECODE_QSTR;
             printf("LOAD_CONST_STRING '%s'", qstr_str(qst));
@@ -240,6 +254,12 @@ const byte *mp_bytecode_print_str(const byte *ip) {
             }
             break;
 
+        case MP_BC_LOAD_FAST_ATTR:
+            DECODE_QSTR;
+            printf("LOAD_FAST_ATTR %u %s", *ip, qstr_str(qst));
+            ip += 1;
+            break;
+
         case MP_BC_LOAD_METHOD:
             DECODE_QSTR;
             printf("LOAD_METHOD %s", qstr_str(qst));
@@ -345,6 +365,20 @@ const byte *mp_bytecode_print_str(const byte *ip) {
             printf("POP_JUMP_IF_FALSE " UINT_FMT, (mp_uint_t)(ip + unum - mp_showbc_code_start));
             break;
 
+        case MP_BC_BINARY_OP_POP_JUMP_IF_TRUE:
+            DECODE_SLABEL;
+            printf("BINARY_OP_POP_JUMP_IF_TRUE %u %s " UINT_FMT, *ip,
+                qstr_str(mp_binary_op_method_name[*ip]), (mp_uint_t)(ip + unum - mp_showbc_code_start));
+            ip += 1;
+            break;
+
+        case MP_BC_BINARY_OP_POP_JUMP_IF_FALSE:
+            DECODE_SLABEL;
+            printf("BINARY_OP_POP_JUMP_IF_FALSE %u %s " UINT_FMT, *ip,
+                qstr_str(mp_binary_op_method_name[*ip]), (mp_uint_t)(ip + unum - mp_showbc_code_start));
+            ip += 1;
+            break;
+
         case MP_BC_JUMP_IF_TRUE_OR_POP:
             DECODE_SLABEL;
             printf("JUMP_IF_TRUE_OR_POP " UINT_FMT, (mp_uint_t)(ip + unum - mp_showbc_code_start));
@@ -34,6 +34,7 @@
 #include "py/runtime.h"
 #include "py/bc0.h"
 #include "py/bc.h"
+#include "py/smallint.h"
 
 #if 0
 #define TRACE(ip) printf("sp=%d ", (int)(sp - &code_state->state[0] + 1)); mp_bytecode_print2(ip, 1, code_state->fun_bc->const_table);
@@ -108,6 +109,59 @@
     exc_sp--; /* pop back to previous exception handler */ \
     CLEAR_SYS_EXC_INFO() /* just clear sys.exc_info(), not compliant, but it shouldn't be used in 1st place */
 
+#if MICROPY_OPT_VM_BINARY_OP_FAST_PATH
+// Handles the common cases of a binary op on two small ints or two floats
+// without going through the type dispatch in mp_binary_op.  Returns
+// MP_OBJ_NULL if the op must be done the long way.
+static inline mp_obj_t vm_binary_op_fast(mp_uint_t op, mp_obj_t lhs, mp_obj_t rhs) {
+    if (mp_obj_is_small_int(lhs) && mp_obj_is_small_int(rhs)) {
+        mp_int_t l = MP_OBJ_SMALL_INT_VALUE(lhs);
+        mp_int_t r = MP_OBJ_SMALL_INT_VALUE(rhs);
+        switch (op) {
+            case MP_BINARY_OP_LESS: return mp_obj_new_bool(l < r);
+            case MP_BINARY_OP_MORE: return mp_obj_new_bool(l > r);
+            case MP_BINARY_OP_EQUAL: return mp_obj_new_bool(l == r);
+            case MP_BINARY_OP_LESS_EQUAL: return mp_obj_new_bool(l <= r);
+            case MP_BINARY_OP_MORE_EQUAL: return mp_obj_new_bool(l >= r);
+            case MP_BINARY_OP_NOT_EQUAL: return mp_obj_new_bool(l != r);
+            case MP_BINARY_OP_OR:
+            case MP_BINARY_OP_INPLACE_OR: return MP_OBJ_NEW_SMALL_INT(l | r);
+            case MP_BINARY_OP_XOR:
+            case MP_BINARY_OP_INPLACE_XOR: return MP_OBJ_NEW_SMALL_INT(l ^ r);
+            case MP_BINARY_OP_AND:
+            case MP_BINARY_OP_INPLACE_AND: return MP_OBJ_NEW_SMALL_INT(l & r);
+            case MP_BINARY_OP_ADD:
+            case MP_BINARY_OP_INPLACE_ADD: l += r; break;
+            case MP_BINARY_OP_SUBTRACT:
+            case MP_BINARY_OP_INPLACE_SUBTRACT: l -= r; break;
+            default: return MP_OBJ_NULL;
+        }
+        // the sum or difference of two small ints can't overflow a machine word
+        if (MP_SMALL_INT_FITS(l)) {
+            return MP_OBJ_NEW_SMALL_INT(l);
+        }
+        return MP_OBJ_NULL;
+    }
+    #if MICROPY_PY_BUILTINS_FLOAT
+    if (mp_obj_is_float(lhs) && (mp_obj_is_float(rhs) || mp_obj_is_small_int(rhs))) {
+        // with MICROPY_OBJ_REPR_C (or D) the result doesn't need a heap allocation
+        return mp_obj_float_binary_op(op, mp_obj_float_get(lhs), rhs);
+    }
+    #endif
+    return MP_OBJ_NULL;
+}
+#endif
+
+static inline mp_obj_t vm_binary_op(mp_uint_t op, mp_obj_t lhs, mp_obj_t rhs) {
+    #if MICROPY_OPT_VM_BINARY_OP_FAST_PATH
+    mp_obj_t res = vm_binary_op_fast(op, lhs, rhs);
+    if (res != MP_OBJ_NULL) {
+        return res;
+    }
+    #endif
+    return mp_binary_op(op, lhs, rhs);
+}
+
 // fastn has items in reverse order (fastn[0] is local[0], fastn[-1] is local[1], etc)
 // sp points to bottom of stack which grows up
 // returns:
@@ -226,6 +280,21 @@ dispatch_loop:
                     DISPATCH();
                 }
 
+                ENTRY(MP_BC_BINARY_OP_SMALL_INT): {
+                    MARK_EXC_IP_SELECTIVE();
+                    mp_int_t num = 0;
+                    if ((ip[0] & 0x40) != 0) {
+                        // Number is negative
+                        num--;
+                    }
+                    do {
+                        num = (num << 7) | (*ip & 0x7f);
+                    } while ((*ip++ & 0x80) != 0);
+                    mp_uint_t op = *ip++;
+                    SET_TOP(vm_binary_op(op, TOP(), MP_OBJ_NEW_SMALL_INT(num)));
+                    DISPATCH();
+                }
+
                 ENTRY(MP_BC_LOAD_CONST_STRING): {
                     DECODE_QSTR;
                     PUSH(MP_OBJ_NEW_QSTR(qst));
@@ -359,6 +428,17 @@ dispatch_loop:
                 }
                 #endif
 
+                ENTRY(MP_BC_LOAD_FAST_ATTR): {
+                    MARK_EXC_IP_SELECTIVE();
+                    DECODE_QSTR;
+                    obj_shared = fastn[-(mp_int_t)*ip++];
+                    if (obj_shared == MP_OBJ_NULL) {
+                        goto local_name_error;
+                    }
+                    PUSH(mp_load_attr(obj_shared, qst));
+                    DISPATCH();
+                }
+
                 ENTRY(MP_BC_LOAD_METHOD): {
                     MARK_EXC_IP_SELECTIVE();
                     DECODE_QSTR;
@@ -552,6 +632,33 @@ dispatch_loop:
                     DISPATCH_WITH_PEND_EXC_CHECK();
                 }
 
+                ENTRY(MP_BC_BINARY_OP_POP_JUMP_IF_TRUE): {
+                    MARK_EXC_IP_SELECTIVE();
+                    DECODE_SLABEL;
+                    mp_obj_t rhs = POP();
+                    mp_obj_t lhs = POP();
+                    // the jump is relative to the op byte following the offset
+                    if (mp_obj_is_true(vm_binary_op(*ip, lhs, rhs))) {
+                        ip += slab;
+                    } else {
+                        ip++;
+                    }
+                    DISPATCH_WITH_PEND_EXC_CHECK();
+                }
+
+                ENTRY(MP_BC_BINARY_OP_POP_JUMP_IF_FALSE): {
+                    MARK_EXC_IP_SELECTIVE();
+                    DECODE_SLABEL;
+                    mp_obj_t rhs = POP();
+                    mp_obj_t lhs = POP();
+                    if (!mp_obj_is_true(vm_binary_op(*ip, lhs, rhs))) {
+                        ip += slab;
+                    } else {
+                        ip++;
+                    }
+                    DISPATCH_WITH_PEND_EXC_CHECK();
+                }
+
                 ENTRY(MP_BC_JUMP_IF_TRUE_OR_POP): {
                     DECODE_SLABEL;
                     if (mp_obj_is_true(TOP())) {
@@ -1234,7 +1341,7 @@ yield:
                     MARK_EXC_IP_SELECTIVE();
                     mp_obj_t rhs = POP();
                     mp_obj_t lhs = TOP();
-                    SET_TOP(mp_binary_op(ip[-1] - MP_BC_BINARY_OP_MULTI, lhs, rhs));
+                    SET_TOP(vm_binary_op(ip[-1] - MP_BC_BINARY_OP_MULTI, lhs, rhs));
                     DISPATCH();
                 }
 
@@ -1257,7 +1364,7 @@ yield:
                     } else if (ip[-1] < MP_BC_BINARY_OP_MULTI + MP_BINARY_OP_NUM_BYTECODE) {
                         mp_obj_t rhs = POP();
                         mp_obj_t lhs = TOP();
-                        SET_TOP(mp_binary_op(ip[-1] - MP_BC_BINARY_OP_MULTI, lhs, rhs));
+                        SET_TOP(vm_binary_op(ip[-1] - MP_BC_BINARY_OP_MULTI, lhs, rhs));
                         DISPATCH();
                     } else
 #endif
@@ -1313,10 +1420,17 @@ pending_exception_check:
                     // can only switch threads if the scheduler is unlocked
                     if (MP_STATE_VM(sched_state) == MP_SCHED_IDLE)
                     #endif
+                    #if MICROPY_PY_THREAD_GIL_ADAPTIVE
+                    // only give up the GIL if someone is waiting for it
+                    if (MP_THREAD_GIL_SHOULD_YIELD()) {
+                        mp_thread_gil_handoff();
+                    }
+                    #else
                     {
                     MP_THREAD_GIL_EXIT();
                     MP_THREAD_GIL_ENTER();
                     }
+                    #endif
                 }
                 #endif
 
@@ -1362,50 +1476,9 @@ unwind_loop:
             // TODO: don't set traceback for exceptions re-raised by END_FINALLY.
             // But consider how to handle nested exceptions.
             if (nlr.ret_val != &mp_const_GeneratorExit_obj) {
-                const byte *ip = code_state->fun_bc->bytecode;
-                ip = mp_decode_uint_skip(ip); // skip n_state
-                ip = mp_decode_uint_skip(ip); // skip n_exc_stack
-                ip++; // skip scope_params
-                ip++; // skip n_pos_args
-                ip++; // skip n_kwonly_args
-                ip++; // skip n_def_pos_args
-                size_t bc = code_state->ip - ip;
-                size_t code_info_size = mp_decode_uint_value(ip);
-                ip = mp_decode_uint_skip(ip); // skip code_info_size
-                bc -= code_info_size;
-                #if MICROPY_PERSISTENT_CODE
-                qstr block_name = ip[0] | (ip[1] << 8);
-                qstr source_file = ip[2] | (ip[3] << 8);
-                ip += 4;
-                #else
-                qstr block_name = mp_decode_uint_value(ip);
-                ip = mp_decode_uint_skip(ip);
-                qstr source_file = mp_decode_uint_value(ip);
-                ip = mp_decode_uint_skip(ip);
-                #endif
-                size_t source_line = 1;
-                size_t c;
-                while ((c = *ip)) {
-                    size_t b, l;
-                    if ((c & 0x80) == 0) {
-                        // 0b0LLBBBBB encoding
-                        b = c & 0x1f;
-                        l = c >> 5;
-                        ip += 1;
-                    } else {
-                        // 0b1LLLBBBB 0bLLLLLLLL encoding (l's LSB in second byte)
-                        b = c & 0xf;
-                        l = ((c << 4) & 0x700) | ip[1];
-                        ip += 2;
-                    }
-                    if (bc >= b) {
-                        bc -= b;
-                        source_line += l;
-                    } else {
-                        // found source line corresponding to bytecode offset
-                        break;
-                    }
-                }
+                qstr source_file, block_name;
+                size_t source_line;
+                mp_bytecode_get_source_info(code_state, &source_file, &block_name, &source_line);
                 mp_obj_exception_add_traceback(MP_OBJ_FROM_PTR(nlr.ret_val), source_file, source_line, block_name);
             }
 
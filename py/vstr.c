@@ -112,6 +112,11 @@ STATIC void vstr_ensure_extra(vstr_t *vstr, size_t size) {
             mp_raise_msg(&mp_type_RuntimeError, NULL);
         }
         size_t new_alloc = ROUND_ALLOC((vstr->len + size) + 16);
+        // grow geometrically so that building a string piece by piece is linear;
+        // the excess goes when the buffer is turned into a str or bytes object
+        if (new_alloc < vstr->alloc + vstr->alloc / 2) {
+            new_alloc = ROUND_ALLOC(vstr->alloc + vstr->alloc / 2);
+        }
         char *new_buf = m_renew(char, vstr->buf, vstr->alloc, new_alloc);
         vstr->alloc = new_alloc;
         vstr->buf = new_buf;
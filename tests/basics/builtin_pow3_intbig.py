@@ -20,3 +20,12 @@ print(hex(pow(2, x-1, x))) # Should be 1, since x is prime
 print(hex(pow(y, x-1, x))) # Should be 1, since x is prime
 print(hex(pow(y, y-1, x))) # Should be a 'big value'
 print(hex(pow(y, y-1, y))) # Should be a 'big value'
+
+# odd and even moduli, with bases that are negative or larger than the modulus
+m = (1 << 521) - 1
+print(hex(pow(3, m - 2, m)))
+print(hex(pow(-x, 65537, m)))
+print(hex(pow(x * y, y, m)))
+print(pow(m, 5, m), pow(m + 1, y, m))
+print(hex(pow(y, 65537, 1 << 300)))
+print(hex(pow(y, 65537, (1 << 300) + 2)))
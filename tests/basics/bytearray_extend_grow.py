@@ -0,0 +1,14 @@
+# bytearray grown repeatedly with extend, += and append
+
+a = bytearray()
+for i in range(100):
+    a.extend(b"ab")
+    a += bytearray(b"c")
+    a.append(0x64)
+print(len(a), a[:8], a[-8:])
+
+# extend by itself
+a = bytearray(b"123")
+for i in range(4):
+    a.extend(a)
+print(len(a), a[:9])
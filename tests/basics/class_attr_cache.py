@@ -0,0 +1,66 @@
+# test repeated attribute lookups along the bases see changes to the classes
+
+class A:
+    def f(self):
+        return "A.f"
+    x = 1
+
+class B(A):
+    pass
+
+class C(B):
+    pass
+
+c = C()
+for i in range(3):
+    print(c.f(), c.x, C.x)
+
+# store in a base, then in the class itself, then delete them again
+A.x = 2
+print(c.x, C.x)
+C.x = 3
+print(c.x, C.x)
+del C.x
+print(c.x)
+B.f = lambda self: "B.f"
+print(c.f())
+del B.f
+print(c.f())
+del A.f
+try:
+    c.f()
+except AttributeError:
+    print("AttributeError")
+
+# an instance attribute hides the class one
+c.x = 4
+print(c.x, C.x)
+
+# multiple inheritance
+class D:
+    def g(self):
+        return "D.g"
+
+class E(C, D):
+    pass
+
+e = E()
+print(e.g(), e.g(), e.x)
+D.g = lambda self: "D.g2"
+print(e.g())
+
+# a native base
+class L(list):
+    def total(self):
+        return sum(self)
+
+l = L()
+for i in range(3):
+    l.append(i)
+print(l.total(), len(l))
+
+# classes created in a loop, each with its own attribute
+for i in range(5):
+    class K:
+        v = i
+    print(K().v)
@@ -0,0 +1,72 @@
+# closed over parameters, rebound and not
+
+def f(x):
+    return lambda: x
+print(f(1)(), f('a')())
+
+# rebound after the closure is made
+def f(x):
+    g = lambda: x
+    x = 2
+    return g
+print(f(1)())
+
+# rebound through nonlocal
+def f(x):
+    def g():
+        nonlocal x
+        x += 1
+        return x
+    return g
+g = f(1)
+print(g(), g())
+
+# rebound through nonlocal two levels in
+def f(x):
+    def g():
+        def h():
+            nonlocal x
+            x *= 2
+        h()
+        return x
+    return g
+print(f(3)())
+
+# deleted
+def f(x):
+    g = lambda: x
+    del x
+    return g
+try:
+    f(1)()
+except NameError:
+    print('NameError')
+
+# passed through a scope that doesn't use it
+def f(x, y):
+    def g(z):
+        return lambda: (x, y, z)
+    return g
+print(f(1, 2)(3)())
+
+# star parameters and a comprehension
+def f(*args, **kw):
+    return [(a, kw['k']) for a in args]
+print(f(1, 2, k=3))
+
+# a class body and a method
+def f(x):
+    class C:
+        a = x
+        def m(self):
+            return x
+    return C.a, C().m()
+print(f(5))
+
+# a generator and a closure over the same parameter
+def f(n):
+    def gen():
+        for i in range(n):
+            yield i * n
+    return list(gen()), (lambda: n)()
+print(f(3))
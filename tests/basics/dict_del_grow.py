@@ -0,0 +1,30 @@
+# test dicts with many deletions between insertions, str and int keys
+
+d = {}
+for i in range(300):
+    d["k%d" % i] = i
+for i in range(0, 300, 2):
+    del d["k%d" % i]
+for i in range(500):
+    d[i] = str(i)
+print(len(d))
+print(all(d["k%d" % i] == i for i in range(1, 300, 2)))
+print(all(d[i] == str(i) for i in range(500)))
+print("k0" in d, "k1" in d)
+
+# copies and popitem keep the entries consistent
+d2 = d.copy()
+print(d2 == d)
+n = 0
+while d2:
+    k, v = d2.popitem()
+    n += 1
+    d2[("t", n)] = n
+    del d2[("t", n)]
+print(n, len(d2))
+
+# reinserting deleted keys
+for i in range(50):
+    d.pop(i)
+    d[i] = i
+print(sorted(d[i] for i in range(50)) == list(range(50)))
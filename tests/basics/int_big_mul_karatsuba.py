@@ -0,0 +1,23 @@
+# test multiplication and division of integers large enough to be split up
+
+def gen(n, seed):
+    x = 0
+    for _ in range(n):
+        seed = (seed * 1103515245 + 12345) & 0x7fffffff
+        x = (x << 16) | (seed >> 8) & 0xffff
+    return x
+
+# operands of equal and of very different lengths, and all-ones values
+for n, m in ((60, 60), (64, 64), (65, 71), (129, 130), (300, 70), (250, 249), (500, 90)):
+    a = gen(n, n)
+    b = gen(m, m + 1)
+    p = a * b
+    print(n, m, p % 1000000007, p // a == b, p % b)
+    c = (1 << (16 * n)) - 1
+    q = c * c
+    print(q % 998244353, q // c == c, q == (c + 1) * (c - 1) + 1)
+
+# squaring and negative values
+a = gen(200, 7)
+print((a * a) % 1000000007, (-a * a) % 1000000007, (a * -a == -(a * a)))
+print(a * a == a ** 2)
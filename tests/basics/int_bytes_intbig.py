@@ -12,3 +12,9 @@ print(ib.to_bytes(20, "big"))
 
 # check that extra zero bytes don't change the internal int value
 print(int.from_bytes(b + bytes(10), "little") == int.from_bytes(b, "little"))
+
+# lengths that don't fill a whole number of internal digits
+for n in range(17, 24):
+    b = bytes(range(1, n + 1))
+    print(n, int.from_bytes(b, "little"), int.from_bytes(b, "big"))
+print(int.from_bytes(bytes(7) + b"\x01", "big"), int.from_bytes(b"\xff" * 33, "little"))
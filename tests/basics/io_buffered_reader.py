@@ -0,0 +1,39 @@
+import uio as io
+
+try:
+    io.BytesIO
+    io.BufferedReader
+except AttributeError:
+    print('SKIP')
+    raise SystemExit
+
+data = b"line one\nline two\n\nlast line without newline"
+
+buf = io.BufferedReader(io.BytesIO(data), 8)
+print(buf.readline())
+print(buf.read(3))
+print(buf.readline())
+print(buf.readline())
+print(buf.readline(4))
+print(buf.readline())
+print(buf.readline())
+
+# iteration and readinto
+buf = io.BufferedReader(io.BytesIO(data), 5)
+print([l for l in buf])
+buf = io.BufferedReader(io.BytesIO(data))
+b = bytearray(12)
+print(buf.readinto(b), b)
+print(buf.read())
+print(buf.read())
+
+# reads bigger than the buffer go straight to the stream
+buf = io.BufferedReader(io.BytesIO(data), 4)
+print(buf.read(2), buf.read(20), buf.read(2))
+
+with io.BufferedReader(io.BytesIO(b"abc")) as buf:
+    print(buf.read(1))
+try:
+    buf.read(1)
+except ValueError:
+    print('ValueError')
@@ -0,0 +1,35 @@
+# test io.BytesBuilder
+try:
+    import uio as io
+except ImportError:
+    import io
+
+try:
+    io.BytesBuilder
+except AttributeError:
+    print("SKIP")
+    raise SystemExit
+
+b = io.BytesBuilder()
+print(len(b), bool(b))
+b.write(b"abc")
+b.write(bytearray(b"def"))
+b.write(memoryview(b"ghi")[1:])
+print(len(b), bool(b))
+print(b.getvalue())
+
+# freeze hands the data over and the builder starts again empty
+v = b.freeze()
+print(type(v), v)
+print(len(b), b.getvalue())
+b.write(b"x")
+print(b.freeze(), v)
+
+# many small writes
+b = io.BytesBuilder(4)
+for i in range(200):
+    b.write(bytes([65 + i % 26]))
+v = b.freeze()
+print(len(v), v[:30], v[-4:])
+
+print(io.BytesBuilder().freeze())
@@ -0,0 +1,39 @@
+# test that map lookups stay correct when slots move around under the lookup cache
+
+class A:
+    pass
+
+a = A()
+for i in range(20):
+    setattr(a, 'x%d' % i, i)
+print(a.x0, a.x19)
+
+# deleting and re-adding attributes must not return stale slots
+del a.x0
+try:
+    a.x0
+except AttributeError:
+    print('AttributeError')
+a.x0 = 'new'
+print(a.x0, a.x10)
+
+# same key looked up in different maps
+b = A()
+b.x10 = 'b'
+print(a.x10, b.x10)
+
+# a dict that gets rehashed while it's being looked up
+d = {}
+for i in range(100):
+    d['k%d' % i] = i
+    if d['k%d' % (i // 2)] != i // 2:
+        print('FAIL', i)
+for i in range(0, 100, 2):
+    del d['k%d' % i]
+print(len(d), d.get('k2'), d.get('k3'))
+
+# methods and globals share the cache too
+def f():
+    return 1
+for i in range(3):
+    print(f(), a.__class__.__name__, callable([].append))
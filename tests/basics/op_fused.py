@@ -0,0 +1,60 @@
+# test instruction pairs that the compiler may fuse into one bytecode
+
+# small int constant with an arithmetic op, including overflow to a big int
+def arith(x):
+    return x + 1, x - 1, x * 3, x // 2, x % 7, x << 2, x >> 1, x & 6, x | 1, x ^ 5
+print(arith(10))
+print(arith(-10))
+x = 1
+for i in range(70):
+    x *= 2
+    x += 1
+print(x)
+
+# comparison followed by a conditional jump, with and without small ints
+def cmp(a, b):
+    r = []
+    if a < b: r.append('<')
+    if a <= b: r.append('<=')
+    if a == b: r.append('==')
+    if a != b: r.append('!=')
+    if a > b: r.append('>')
+    if a >= b: r.append('>=')
+    if not a < b: r.append('!<')
+    return r
+print(cmp(1, 2), cmp(2, 2), cmp(3, 2), cmp('a', 'b'))
+
+def count(n):
+    i = 0
+    while i < n:
+        i += 1
+    return i
+print(count(0), count(5))
+
+# a comparison that returns something other than a bool
+class C:
+    def __init__(self, v):
+        self.v = v
+    def __lt__(self, other):
+        return self.v
+print([1 if C(v) < 0 else 0 for v in (0, 1, [], [1], '', 'x')])
+
+# attribute of a local, and of an unbound local
+def attr(c):
+    return c.v
+print(attr(C(42)))
+def unbound():
+    if False:
+        c = None
+    return c.v
+try:
+    unbound()
+except NameError:
+    print('NameError')
+
+# an exception raised by the fused comparison
+try:
+    if 1 < 'a':
+        pass
+except TypeError:
+    print('TypeError')
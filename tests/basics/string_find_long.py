@@ -0,0 +1,32 @@
+# test find/rfind/count/split on haystacks long enough to use the fast paths
+
+def naive_find(h, n, start=0):
+    for i in range(start, len(h) - len(n) + 1):
+        if h[i:i + len(n)] == n:
+            return i
+    return -1
+
+def naive_rfind(h, n):
+    for i in range(len(h) - len(n), -1, -1):
+        if h[i:i + len(n)] == n:
+            return i
+    return -1
+
+hay = 'abcabdabcabcabd' * 20 + 'xyzzy' + 'abacabad' * 10 + 'the end'
+ok = True
+for needle in ('a', 'd', 'y', 'q', 'ab', 'zz', 'abd', 'abcabd', 'xyzzy', 'bad', 'the end',
+               'abacabad' * 3, 'dabc', 'q' * 10, hay[100:200], hay):
+    for h in (hay, hay.encode()):
+        n = needle if isinstance(h, str) else needle.encode()
+        if h.find(n) != naive_find(h, n) or h.rfind(n) != naive_rfind(h, n):
+            print('FAIL find', needle)
+            ok = False
+        if h.find(n, 37) != naive_find(h, n, 37):
+            print('FAIL find start', needle)
+            ok = False
+print(ok)
+
+print(hay.count('abc'), hay.count('abd'), hay.count('aba'), hay.count('q'))
+print(len(hay.split('abcab')), hay.split('xyzzy')[1][:8], hay.rsplit('abcab', 3)[1:])
+print(hay.split('abacabad', 2)[2][:16], hay.rsplit('abacabad', 2)[0][-16:])
+print(b'aaaa'.count(b'aa'), 'aሴaሴ'.count('ሴ'), 'aሴaሴ'.rfind('a'))
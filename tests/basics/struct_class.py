@@ -0,0 +1,49 @@
+# test precompiled ustruct.Struct objects
+
+try:
+    import ustruct as struct
+except:
+    try:
+        import struct
+    except ImportError:
+        print("SKIP")
+        raise SystemExit
+
+try:
+    struct.Struct
+except AttributeError:
+    print("SKIP")
+    raise SystemExit
+
+s = struct.Struct('<HbI2s')
+print(s.size, s.format)
+b = s.pack(1000, -2, 123456, b'xyz')
+print(b)
+print(s.unpack(b))
+print(s.unpack_from(b'\x00' + b, 1))
+print(s.unpack_from(b'\x00' + b, -s.size))
+
+buf = bytearray(12)
+s.pack_into(buf, 2, 1, 2, 3, b'a')
+print(buf)
+print(s.unpack_from(buf, 2))
+
+# formats with counts and zero counts
+s = struct.Struct('>3B0H2h')
+print(s.size, s.pack(1, 2, 3, -1, 256))
+print(s.unpack(b'\x01\x02\x03\xff\xff\x01\x00'))
+
+# iterating over records
+s = struct.Struct('<hB')
+data = b''.join(s.pack(i * 100, i) for i in range(5))
+for rec in s.iter_unpack(data):
+    print(rec)
+print(list(s.iter_unpack(b'')))
+
+# errors
+for f in (lambda: s.pack(1), lambda: s.pack(1, 2, 3), lambda: s.unpack_from(b'\x00\x00'),
+          lambda: s.pack_into(bytearray(2), 0, 1, 2), lambda: s.iter_unpack(b'\x00' * 4)):
+    try:
+        f()
+    except Exception:
+        print('Exception')
@@ -1,10 +1,21 @@
-import time
+import sys
+try:
+    import utime as time
+except ImportError:
+    import time
 
 
-ITERS = 20000000
+# run-bench-tests --iters passes a smaller count, for slow hosts and instruction counting
+ITERS = int(sys.argv[1]) if len(sys.argv) > 1 else 20000000
 
 def run(f):
-    t = time.time()
-    f(ITERS)
-    t = time.time() - t
+    # time.time() is too coarse for a single precision float build
+    if hasattr(time, 'ticks_us'):
+        t = time.ticks_us()
+        f(ITERS)
+        t = time.ticks_diff(time.ticks_us(), t) / 1000000
+    else:
+        t = time.time()
+        f(ITERS)
+        t = time.time() - t
     print(t)
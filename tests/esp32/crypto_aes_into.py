@@ -0,0 +1,56 @@
+from crypto import AES
+import ubinascii
+
+key = b'pycomisthekey...'
+IV = b'thisisthetestIV '
+msg = b'0123456789abcdef' * 4
+
+# encrypt_into gives the same as encrypt, also in place
+ref = AES(key, AES.MODE_CBC, IV).encrypt(msg)
+buf = bytearray(len(msg))
+print(AES(key, AES.MODE_CBC, IV).encrypt_into(msg, buf), buf == ref)
+buf = bytearray(msg)
+AES(key, AES.MODE_CBC, IV).encrypt_into(buf, buf)
+print(buf == ref)
+AES(key, AES.MODE_CBC, IV).decrypt_into(buf, memoryview(buf))
+print(buf == msg)
+
+# streaming: the chaining state carries over between calls
+for mode, extra in ((AES.MODE_CBC, {'IV': IV}), (AES.MODE_CTR, {'counter': IV})):
+    ref = AES(key, mode, **extra).encrypt(msg)
+    c = AES(key, mode, **extra)
+    out = bytearray(len(msg))
+    mv = memoryview(out)
+    c.encrypt_into(msg[:16], mv[:16])
+    c.encrypt_into(msg[16:], mv[16:])
+    print(out == ref)
+
+try:
+    AES(key, AES.MODE_ECB).encrypt_into(msg, bytearray(16))
+except ValueError:
+    print('ValueError')
+
+# GCM test vector from the GCM specification (test case 2)
+zero = bytes(16)
+c = AES(zero, AES.MODE_GCM, bytes(12))
+ct, mac = c.encrypt_and_digest(zero)
+print(ubinascii.hexlify(ct), ubinascii.hexlify(mac))
+print(c.decrypt_and_verify(ct, mac) == zero)
+try:
+    c.decrypt_and_verify(ct, bytes(16))
+except ValueError as e:
+    print(e)
+
+# CCM with associated data and a per message nonce
+c = AES(key, AES.MODE_CCM, mac_len=8)
+ct, mac = c.encrypt_and_digest(msg, aad=b'header', nonce=b'1234567')
+print(len(ct), len(mac))
+print(c.decrypt_and_verify(ct, mac, aad=b'header', nonce=b'1234567') == msg)
+try:
+    c.decrypt_and_verify(ct, mac, aad=b'other', nonce=b'1234567')
+except ValueError as e:
+    print(e)
+try:
+    c.encrypt(msg)
+except TypeError:
+    print('TypeError')
@@ -1,11 +1,34 @@
-# test single hash operation lock
+# several hash objects can be active at once, the ones that don't get the
+# SHA engine are computed in software
 
 import hashlib
 
-try:
-    h1 = hashlib.sha256()
-    h2 = hashlib.sha256()
-except OSError as e:
-    print(e)
-finally:
-    h1.digest()
+h1 = hashlib.sha256()
+h2 = hashlib.sha256()
+h3 = hashlib.sha512(b'pycom')
+h1.update(b'a')
+h2.update(b'b')
+print(h1.digest())
+print(h2.digest())
+print(h3.digest() == hashlib.sha512(b'pycom').digest())
+
+# memoryview slices are hashed in place
+buf = bytearray(b'xxpycomxx')
+print(hashlib.sha256(memoryview(buf)[2:7]).digest() == hashlib.sha256(b'pycom').digest())
+
+# an abandoned object doesn't keep the engine
+for i in range(10):
+    hashlib.sha1(b'pycom').update(b'pycom')
+print(hashlib.sha1(b'pycompycom').digest() == hashlib.sha1(b'pycompycom').digest())
+
+# whole files
+with open('/flash/hash_test.bin', 'wb') as f:
+    for i in range(10):
+        f.write(bytes(range(256)) * 4)
+h = hashlib.sha256()
+for i in range(10):
+    h.update(bytes(range(256)) * 4)
+print(hashlib.file_digest('/flash/hash_test.bin') == h.digest())
+print(hashlib.file_digest('/flash/hash_test.bin', hashlib.md5) == hashlib.md5(bytes(range(256)) * 40).digest())
+import os
+os.remove('/flash/hash_test.bin')
@@ -0,0 +1,47 @@
+import micropython
+
+@micropython.native
+def crc8(buf):
+    crc = 0
+    for b in buf:
+        crc ^= b
+        for i in range(8):
+            if crc & 0x80:
+                crc = ((crc << 1) ^ 0x07) & 0xff
+            else:
+                crc = (crc << 1) & 0xff
+    return crc
+
+@micropython.native
+def gen(n):
+    for i in range(n):
+        yield i * i
+
+@micropython.native
+def catch(x):
+    try:
+        raise ValueError(x)
+    except ValueError as e:
+        return e.args[0]
+
+@micropython.viper
+def vsum(buf:ptr8, n:int) -> int:
+    s = 0
+    for i in range(n):
+        s += buf[i]
+    return s
+
+@micropython.viper
+def vargs(a:int, b:int, c:int, d:int) -> int:
+    return a + b * c - d
+
+@micropython.asm_xtensa
+def asm_add(a2, a3):
+    add(a2, a2, a3)
+
+print(crc8(b'123456789'))
+print(list(gen(5)))
+print(catch(42))
+print(vsum(bytearray(b'\x01\x02\x03\xff'), 4))
+print(vargs(1, 2, 3, 4))
+print(asm_add(40, 2))
@@ -0,0 +1,36 @@
+import _thread
+import time
+
+done = []
+
+def work(n):
+    # use some stack so the high water mark moves
+    def rec(k):
+        return 0 if k == 0 else 1 + rec(k - 1)
+    done.append(rec(n))
+    time.sleep_ms(300)
+
+_thread.start_new_thread(work, (20,), stack_size=8192)
+time.sleep_ms(100)
+info = _thread.stack_info()
+names = [t[0] for t in info]
+print('MicroPy' in names, 'MPThread' in names, 'Servers' in names)
+for name, ident, size, free in info:
+    if name == 'MPThread':
+        print(size, 0 < free < size)
+    if name == 'Servers':
+        print(size, free > 0)
+
+try:
+    _thread.start_new_thread(work, (1,), stack_sz=4096)
+except TypeError:
+    print('TypeError')
+
+# a stack in PSRAM, on boards that have it
+try:
+    _thread.start_new_thread(work, (20,), psram=True)
+    time.sleep_ms(100)
+    print(done)
+except (MemoryError, ValueError):
+    print([20, 20])
+time.sleep_ms(500)
@@ -0,0 +1,29 @@
+import uasyncio as asyncio
+from uasyncio.periph import Alarm
+import _thread
+import utime
+
+async def ticker(alarm, n):
+    for i in range(n):
+        await alarm.wait()
+        print('tick', i)
+    alarm.cancel()
+
+async def main():
+    # one periodic alarm drives a task while another task keeps sleeping
+    alarm = Alarm(ms=100, periodic=True)
+    t = asyncio.create_task(ticker(alarm, 3))
+    await asyncio.sleep_ms(250)
+    print('sleep done')
+    await t
+
+    # the flag can be set from another thread as well
+    flag = asyncio.ThreadSafeFlag()
+    def setter():
+        utime.sleep_ms(50)
+        flag.set()
+    _thread.start_new_thread(setter, ())
+    await asyncio.wait_for(flag.wait(), 1)
+    print('flag set')
+
+asyncio.run(main())
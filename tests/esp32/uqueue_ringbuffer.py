@@ -0,0 +1,42 @@
+import uqueue
+import _thread
+import time
+
+# byte stream
+rb = uqueue.RingBuffer(64)
+print(rb.free())
+print(rb.write(b'hello '), rb.write(b'world'))
+print(rb.read(5), rb.read())
+try:
+    rb.read(timeout=10)
+except uqueue.RingBuffer.Empty:
+    print('Empty')
+
+# data that wraps around the end of the buffer comes back whole
+for i in range(10):
+    rb.write(b'0123456789')
+    buf = bytearray(10)
+    rb.readinto(buf)
+print(buf)
+
+try:
+    rb.write(bytes(65))
+except ValueError:
+    print('ValueError')
+
+# fixed-size records
+rec = uqueue.RingBuffer(128, record_size=4)
+print(rec.write(b'aaaabbbbcccc'))
+print(rec.read(), rec.read(), rec.read())
+
+# producer thread and blocking consumer
+def producer():
+    for i in range(5):
+        time.sleep_ms(20)
+        rec.write(bytes([i] * 4))
+
+_thread.start_new_thread(producer, ())
+got = []
+for i in range(5):
+    got.append(rec.read(timeout=1000)[0])
+print(got)
@@ -0,0 +1,20 @@
+import ussl
+import usocket
+
+# the per host session cache is on by default and starts out empty
+ussl.clear_cache()
+print(ussl.session_cache())
+
+print(ussl.session_cache(persist=True))
+print(ussl.session_cache(False))
+print(ussl.session_cache(True, persist=False))
+
+# only the lengths the max fragment length extension defines are accepted
+s = usocket.socket()
+try:
+    ussl.wrap_socket(s, max_fragment_len=1000)
+except ValueError:
+    print('ValueError')
+ss = ussl.wrap_socket(s, server_hostname='pycom.io', max_fragment_len=1024)
+print(ussl.session_cache()[2])
+ss.close()
@@ -0,0 +1,15 @@
+# the phases of the last boot, as recorded by pycom.boot_profile()
+import pycom
+
+def main():
+    total = 0
+    for phase, us in pycom.boot_profile():
+        if us is None:
+            continue
+        bench_report('boot.' + phase, us, 'us')
+        # main.py starts after boot.py
+        if phase != '_main.py':
+            total += us
+    bench_report('boot.to_main', total, 'us')
+
+main()
@@ -0,0 +1,42 @@
+# bulk transfer rates of the SPI, I2C and UART drivers
+import utime
+from machine import SPI, I2C, UART
+
+def rate(nbytes, t_us):
+    return nbytes * 1000000 // 1024 // t_us
+
+def main():
+    buf = bytearray(4096)
+    rounds = 32
+
+    spi = SPI(0, mode=SPI.MASTER, baudrate=int(BENCH_ARGS.get('spi_baud', 10000000)))
+    t = utime.ticks_us()
+    for i in range(rounds):
+        spi.write(buf)
+    bench_report('spi.write', rate(rounds * len(buf), utime.ticks_diff(utime.ticks_us(), t)), 'KB/s')
+    t = utime.ticks_us()
+    for i in range(rounds):
+        spi.readinto(buf)
+    bench_report('spi.readinto', rate(rounds * len(buf), utime.ticks_diff(utime.ticks_us(), t)), 'KB/s')
+    spi.deinit()
+
+    # needs something on the bus to answer
+    i2c = I2C(0, mode=I2C.MASTER, baudrate=int(BENCH_ARGS.get('i2c_baud', 400000)))
+    devices = i2c.scan()
+    if devices:
+        chunk = bytearray(32)
+        t = utime.ticks_us()
+        for i in range(rounds):
+            i2c.readfrom_into(devices[0], chunk)
+        bench_report('i2c.readfrom', rate(rounds * len(chunk), utime.ticks_diff(utime.ticks_us(), t)), 'KB/s')
+    i2c.deinit()
+
+    uart = UART(1, baudrate=int(BENCH_ARGS.get('uart_baud', 1000000)))
+    t = utime.ticks_us()
+    for i in range(rounds // 4):
+        uart.write(buf)
+    uart.wait_tx_done(10000)
+    bench_report('uart.write', rate(rounds // 4 * len(buf), utime.ticks_diff(utime.ticks_us(), t)), 'KB/s')
+    uart.deinit()
+
+main()
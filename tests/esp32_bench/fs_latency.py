@@ -0,0 +1,39 @@
+# write, fsync and read latencies of /flash (FatFS or LittleFS, per pycom.bootmgr) and of /sd
+import os
+import pycom
+import utime
+
+def bench_fs(root, name):
+    path = root + '/bench.tmp'
+    chunk = bytearray(4096)
+    writes = []
+    syncs = []
+    reads = []
+    f = open(path, 'wb')
+    for i in range(64):
+        t = utime.ticks_us()
+        f.write(chunk)
+        writes.append(utime.ticks_diff(utime.ticks_us(), t))
+        if i % 8 == 7:
+            t = utime.ticks_us()
+            f.flush()
+            os.sync()
+            syncs.append(utime.ticks_diff(utime.ticks_us(), t))
+    f.close()
+    f = open(path, 'rb')
+    for i in range(64):
+        t = utime.ticks_us()
+        f.readinto(chunk)
+        reads.append(utime.ticks_diff(utime.ticks_us(), t))
+    f.close()
+    os.remove(path)
+    for op, samples in (('write', writes), ('fsync', syncs), ('read', reads)):
+        for p, v in bench_percentiles(samples).items():
+            bench_report('fs.%s.%s.p%d' % (name, op, p), v, 'us')
+
+def main():
+    bench_fs('/flash', pycom.bootmgr()[1].lower())
+    if 'sd' in os.listdir('/'):
+        bench_fs('/sd', 'sd')
+
+main()
@@ -0,0 +1,24 @@
+# gc.collect() pause times with the heap filled to different levels
+import gc
+import utime
+
+def main():
+    gc.collect()
+    heap = gc.mem_free() + gc.mem_alloc()
+    bench_report('gc.heap', heap, 'B')
+    keep = []
+    for fill in (25, 50, 75):
+        # small linked objects, the marking cost grows with their number
+        while gc.mem_alloc() < heap * fill // 100:
+            keep.append([None] * 8)
+        samples = []
+        for i in range(20):
+            t = utime.ticks_us()
+            gc.collect()
+            samples.append(utime.ticks_diff(utime.ticks_us(), t))
+        for p, v in bench_percentiles(samples).items():
+            bench_report('gc.pause.fill%d.p%d' % (fill, p), v, 'us')
+    keep = None
+    gc.collect()
+
+main()
@@ -0,0 +1,47 @@
+# delay from an alarm expiring, or a pin edge, to its Python callback running
+import utime
+from machine import Timer, Pin
+
+stamps = []
+
+def alarm_cb(alarm):
+    stamps.append(utime.ticks_us())
+
+def pin_cb(pin):
+    stamps.append(utime.ticks_us())
+
+def main():
+    global stamps
+    samples = []
+    for i in range(50):
+        stamps = []
+        t = utime.ticks_us()
+        alarm = Timer.Alarm(alarm_cb, us=2000)
+        utime.sleep_ms(10)
+        alarm.cancel()
+        if stamps:
+            samples.append(utime.ticks_diff(stamps[0], t) - 2000)
+    for p, v in bench_percentiles(samples).items():
+        bench_report('irq.alarm.p%d' % p, v, 'us')
+
+    # the pin drives itself, nothing must be connected to it
+    name = BENCH_ARGS.get('irq_pin')
+    if name is None:
+        return
+    pin = Pin(name, mode=Pin.OPEN_DRAIN, pull=Pin.PULL_UP, value=1)
+    pin.callback(Pin.IRQ_FALLING, pin_cb)
+    samples = []
+    for i in range(50):
+        stamps = []
+        t = utime.ticks_us()
+        pin(0)
+        utime.sleep_ms(10)
+        pin(1)
+        utime.sleep_ms(2)
+        if stamps:
+            samples.append(utime.ticks_diff(stamps[0], t))
+    pin.callback(Pin.IRQ_FALLING, None)
+    for p, v in bench_percentiles(samples).items():
+        bench_report('irq.pin.p%d' % p, v, 'us')
+
+main()
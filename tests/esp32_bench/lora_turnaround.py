@@ -0,0 +1,29 @@
+# time from the start of one raw LoRa transmission to the start of the next
+import usocket
+import utime
+
+def main():
+    try:
+        from network import LoRa
+    except ImportError:
+        print('SKIP')
+        return
+    region = getattr(LoRa, BENCH_ARGS.get('lora_region', 'EU868'))
+    lora = LoRa(mode=LoRa.LORA, region=region, sf=int(BENCH_ARGS.get('lora_sf', 7)))
+    s = usocket.socket(usocket.AF_LORA, usocket.SOCK_RAW)
+    s.setblocking(True)
+    payload = bytes(int(BENCH_ARGS.get('lora_len', 16)))
+    samples = []
+    prev = None
+    for i in range(int(BENCH_ARGS.get('lora_count', 20))):
+        now = utime.ticks_us()
+        # a blocking send returns once the packet is out
+        s.send(payload)
+        if prev is not None:
+            samples.append(utime.ticks_diff(now, prev))
+        prev = now
+    s.close()
+    for p, v in bench_percentiles(samples).items():
+        bench_report('lora.tx_to_tx.p%d' % p, v, 'us')
+
+main()
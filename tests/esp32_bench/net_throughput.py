@@ -0,0 +1,38 @@
+# TCP upload and download rates against the sink/source started by run-esp32-bench --host-ip
+import usocket
+import utime
+
+def transfer(addr, cmd, size, upload):
+    s = usocket.socket()
+    s.connect(addr)
+    s.send(('%s%08d' % (cmd, size)).encode())
+    buf = bytearray(4096)
+    done = 0
+    t = utime.ticks_us()
+    if upload:
+        while done < size:
+            done += s.send(buf if size - done >= len(buf) else buf[:size - done])
+        # the peer acks once it has it all
+        s.recv(1)
+    else:
+        while done < size:
+            n = s.readinto(buf)
+            if not n:
+                break
+            done += n
+    t = utime.ticks_diff(utime.ticks_us(), t)
+    s.close()
+    return done * 1000000 // 1024 // t
+
+def main():
+    host = BENCH_ARGS.get('host')
+    if host is None:
+        print('SKIP')
+        return
+    addr = usocket.getaddrinfo(host, int(BENCH_ARGS.get('port', 8765)))[0][-1]
+    size = int(BENCH_ARGS.get('net_bytes', 1048576))
+    nic = BENCH_ARGS.get('nic', 'default')
+    bench_report('net.%s.upload' % nic, transfer(addr, 'U', size, True), 'KB/s')
+    bench_report('net.%s.download' % nic, transfer(addr, 'D', size, False), 'KB/s')
+
+main()
@@ -0,0 +1,63 @@
+# test the dirty rectangle of FrameBuffer and show()
+
+try:
+    import framebuf
+except ImportError:
+    print("SKIP")
+    raise SystemExit
+
+w, h = 8, 6
+fbuf = framebuf.FrameBuffer(bytearray(w * h * 2), w, h, framebuf.RGB565)
+
+# everything is dirty to begin with
+print(fbuf.dirty(True))
+print(fbuf.dirty())
+
+fbuf.pixel(2, 3, 1)
+print(fbuf.dirty())
+fbuf.hline(-4, 1, 7, 2)
+print(fbuf.dirty(True))
+fbuf.line(6, 5, 4, 2, 3)
+print(fbuf.dirty(True))
+fbuf.text("a", 5, 4)
+print(fbuf.dirty(True))
+fbuf.rect(10, 10, 3, 3, 1)
+print(fbuf.dirty(True))
+src = framebuf.FrameBuffer(bytearray(2 * 2 * 2), 2, 2, framebuf.RGB565)
+fbuf.blit(src, -1, 5)
+print(fbuf.dirty(True))
+
+class Pin:
+    def __init__(self, name):
+        self.name = name
+    def value(self, v):
+        log.append("%s=%d" % (self.name, v))
+
+class SPI:
+    def write(self, buf):
+        log.append(bytes(buf))
+
+log = []
+fbuf.fill_rect(3, 2, 2, 2, 0x1234)
+fbuf.show(SPI(), Pin("dc"), Pin("cs"))
+for entry in log:
+    print(entry)
+print(fbuf.dirty())
+
+# nothing to send
+log = []
+fbuf.show(SPI(), Pin("dc"), None)
+print(log)
+
+# explicit region, only its rows are sent and the dirty rectangle is kept
+fbuf.pixel(0, 0, 1)
+log = []
+fbuf.show(SPI(), Pin("dc"), None, (0, 4, 1, 10))
+print(len(log), len(log[-1]))
+print(fbuf.dirty())
+
+# only RGB565 can be shown
+try:
+    framebuf.FrameBuffer(bytearray(8), 8, 8, framebuf.MONO_VLSB).show(SPI(), Pin("dc"), None)
+except ValueError:
+    print("ValueError")
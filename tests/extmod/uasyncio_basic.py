@@ -0,0 +1,75 @@
+# test uasyncio tasks, timers and synchronisation primitives
+
+try:
+    import uasyncio as asyncio
+except ImportError:
+    print("SKIP")
+    raise SystemExit
+
+log = []
+
+
+async def worker(n, ms):
+    for i in range(3):
+        await asyncio.sleep_ms(ms)
+        log.append((n, i))
+    return n * 10
+
+
+async def main():
+    # interleaving by timer expiry
+    t1 = asyncio.create_task(worker(1, 50))
+    t2 = asyncio.create_task(worker(2, 20))
+    print(await t1, await t2)
+    print(log)
+
+    print(await asyncio.gather(worker(3, 1), worker(4, 2)))
+
+    try:
+        await asyncio.wait_for(worker(5, 50), 0.02)
+    except asyncio.TimeoutError:
+        print("timeout")
+    print(await asyncio.wait_for(worker(6, 1), 1))
+
+    # cancel a sleeping task
+    t = asyncio.create_task(worker(7, 100))
+    await asyncio.sleep_ms(1)
+    print(t.cancel(), t.cancel())
+    try:
+        await t
+    except asyncio.CancelledError:
+        print("cancelled")
+
+    ev = asyncio.Event()
+
+    async def waiter(n):
+        await ev.wait()
+        return n
+
+    ts = [asyncio.create_task(waiter(i)) for i in range(3)]
+    await asyncio.sleep_ms(5)
+    print(ev.is_set())
+    ev.set()
+    print(await asyncio.gather(*ts))
+
+    lock = asyncio.Lock()
+
+    async def locked(n):
+        async with lock:
+            log.append(n)
+            await asyncio.sleep_ms(2)
+            log.append(-n)
+
+    log.clear()
+    await asyncio.gather(locked(1), locked(2), locked(3))
+    print(log, lock.locked())
+
+    async def fail():
+        await asyncio.sleep_ms(1)
+        raise ValueError("bad")
+
+    print(await asyncio.gather(fail(), worker(8, 1), return_exceptions=True))
+    return "done"
+
+
+print(asyncio.run(main()))
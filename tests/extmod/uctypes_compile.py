@@ -0,0 +1,50 @@
+# compiled descriptors
+try:
+    import uctypes
+except ImportError:
+    print("SKIP")
+    raise SystemExit
+
+HDR = {
+    "len": uctypes.UINT8 | 0,
+    "flags": 1 | uctypes.BFUINT8 | 0 << uctypes.BF_POS | 4 << uctypes.BF_LEN,
+    "rssi": 1 | uctypes.BFINT8 | 4 << uctypes.BF_POS | 4 << uctypes.BF_LEN,
+    "addr": (uctypes.ARRAY | 2, uctypes.UINT8 | 3),
+}
+ITEM = {
+    "id": uctypes.UINT16 | 0,
+    "val": uctypes.INT16 | 2,
+}
+FRAME = {
+    "hdr": (0, HDR),
+    "items": (uctypes.ARRAY | 5, 3, ITEM),
+}
+
+for layout in (uctypes.LITTLE_ENDIAN, uctypes.BIG_ENDIAN):
+    d = uctypes.compile(FRAME, layout)
+    print(uctypes.sizeof(d, layout), uctypes.sizeof(FRAME, layout))
+    buf = bytearray(b"\x11\xa5\x01\x02\x03\x00\x01\xff\xfe\x00\x02\x00\x03\x00\x04\x00\x05")
+    s = uctypes.struct(uctypes.addressof(buf), d, layout)
+    print(s.hdr.len, s.hdr.flags, s.hdr.rssi, list(s.hdr.addr))
+    print(len(s.items), [(i.id, i.val) for i in s.items])
+    s.items[1].val = -3
+    s.hdr.rssi = -2
+    print(s.items[1].val, s.hdr.rssi, s.hdr.flags)
+
+# compiling again, and for another layout
+d = uctypes.compile(ITEM)
+print(uctypes.compile(d) is d, uctypes.sizeof(uctypes.compile(d, uctypes.LITTLE_ENDIAN)))
+
+# scalar arrays iterate too
+buf = bytearray(range(4))
+s = uctypes.struct(uctypes.addressof(buf), {"a": (uctypes.ARRAY | 0, uctypes.UINT16 | 2)}, uctypes.LITTLE_ENDIAN)
+print(len(s.a), list(s.a))
+
+try:
+    uctypes.struct(uctypes.addressof(buf), d).foo
+except KeyError:
+    print("KeyError")
+try:
+    iter(uctypes.struct(uctypes.addressof(buf), d))
+except TypeError:
+    print("TypeError")
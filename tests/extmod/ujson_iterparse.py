@@ -0,0 +1,44 @@
+# test the event based JSON parser and the chunked stream reader
+
+try:
+    from uio import StringIO
+    import ujson as json
+    json.iterparse
+except (ImportError, AttributeError):
+    print("SKIP")
+    raise SystemExit
+
+names = {json.START_OBJECT: 'start_object', json.END_OBJECT: 'end_object',
+         json.START_ARRAY: 'start_array', json.END_ARRAY: 'end_array',
+         json.KEY: 'key', json.VALUE: 'value'}
+
+def events(src, **kw):
+    return [(names[ev], val) for ev, val in json.iterparse(src, **kw)]
+
+print(events('1'))
+print(events('"abc"'))
+print(events('[]'))
+print(events('{}'))
+print(events('{"a": [1, {"b": null}], "c": true}'))
+print(events(StringIO('[[1, 2], [3], {"x": "y"}]')))
+
+# input spanning many buffer refills
+big = '[' + ','.join('{"id": %d, "name": "n%d"}' % (i, i) for i in range(100)) + ']'
+print(sum(1 for ev, val in json.iterparse(StringIO(big)) if ev == json.KEY))
+print(len(json.load(StringIO(big))), json.load(StringIO(big))[99])
+
+# keys as qstrs give equal dicts
+print(json.loads('{"some_key": 1, "other": {"some_key": 2}}', intern_keys=True))
+print(events('{"k": "v"}', intern_keys=True))
+
+# errors
+for src in ('', '[1', '{[1]: 2}', '1 2', ']'):
+    try:
+        events(src)
+    except ValueError:
+        print('ValueError')
+
+# dump in chunks
+s = StringIO()
+json.dump({'a': 'x' * 300, 'b': list(range(50))}, s)
+print(json.loads(s.getvalue()) == {'a': 'x' * 300, 'b': list(range(50))})
@@ -0,0 +1,43 @@
+# test matching bytearray/memoryview in place, the span-only methods and the
+# cache of the module-level functions
+
+try:
+    import ure as re
+except ImportError:
+    print("SKIP")
+    raise SystemExit
+
+try:
+    re.compile("a").match_spans
+except AttributeError:
+    print("SKIP")
+    raise SystemExit
+
+# bytes-like subjects, the groups come out as bytes
+buf = bytearray(b"+CSQ: 17,99\r\n")
+m = re.match(rb"\+CSQ: (\d+),(\d+)", buf)
+print(m.group(0), m.group(1), m.group(2))
+m = re.search(rb"(\d+)", memoryview(buf)[6:])
+print(m.group(1))
+print(re.compile(b",").split(buf))
+
+# the groups follow the content of the bytearray when it changes after the match
+buf = bytearray(b"+CSQ: 17,99")
+m = re.search(rb"(\d+),(\d+)", buf)
+buf[6:8] = b"42"
+print(m.group(1))
+buf[:] = b"+C"
+print(m.group(0), m.group(1), m.group(2))
+
+# spans only
+r = re.compile(r"(\d+),(\d+)(x)?")
+print(r.search_spans("+CSQ: 17,99"))
+print(r.match_spans("+CSQ: 17,99"))
+print(r.match_spans(b"1,2x"))
+print(r.search_spans(bytearray(b"--")))
+
+# more patterns than the cache holds, each has to give its own result
+pats = [r"a+", r"b+", r"c+", r"d+", r"e+", r"(f)+", r"g+", r"h+", r"i+", r"j+"]
+for _ in range(3):
+    print([re.search(p, "xxaabbccddeeffgghhiijj").group(0) for p in pats])
+print(re.match(r"a", "a").group(0), re.match(b"a", b"a").group(0))
@@ -0,0 +1,43 @@
+# test utimeq handles: remove() and reschedule()
+try:
+    from utimeq import utimeq
+except ImportError:
+    print("SKIP")
+    raise SystemExit
+
+res = [0, 0, 0]
+
+h = utimeq(10)
+a = h.push(30, "a", 0)
+b = h.push(10, "b", 0)
+c = h.push(20, "c", 0)
+print(type(a) is int, a != b, b != c)
+
+# remove from the middle of the heap
+print(h.remove(c), len(h))
+# a stale handle is refused
+print(h.remove(c), h.reschedule(c, 5))
+
+# move an entry to the front and to the back
+print(h.reschedule(a, 5))
+h.pop(res)
+print(res)
+h.push(15, "d", 0)
+print(h.reschedule(b, 40))
+while h:
+    h.pop(res)
+    print(res)
+
+# handles of popped entries are stale too
+print(h.remove(b), h.remove(a))
+
+# a reused slot gets a new handle
+x = h.push(1, "x", 0)
+h.pop(res)
+y = h.push(1, "y", 0)
+print(x != y, h.remove(x), h.remove(y), len(h))
+
+try:
+    h.remove("a")
+except TypeError:
+    print("TypeError")
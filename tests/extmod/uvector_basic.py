@@ -0,0 +1,56 @@
+# test uvector elementwise operations and reductions on integer arrays
+
+try:
+    import uvector
+    from array import array
+except ImportError:
+    print("SKIP")
+    raise SystemExit
+
+a = array('h', [1, -2, 3, -4, 5])
+b = array('h', [10, 20, 30, 40, 50])
+d = array('h', bytearray(10))
+
+print(uvector.add(d, a, b))
+print(uvector.mul(d, a, b))
+print(uvector.add(d, a, 7))
+print(uvector.scale(d, a, 3, -1))
+
+# in place, with wrapping on store like array assignment
+print(uvector.mul(a, a, 20000), a)
+a = array('h', [1, -2, 3, -4, 5])
+
+# mixed element types, memoryview and bytearray sources
+w = array('i', [0] * 5)
+print(uvector.add(w, a, memoryview(b)))
+print(uvector.add(w, bytearray(b'\x01\x02\x03\x04\xff'), a))
+m = memoryview(w)[1:4]
+uvector.add(m, m, 1000)
+print(w)
+
+# reductions
+print(uvector.sum(a), uvector.min(a), uvector.max(a), uvector.dot(a, b))
+print(uvector.sum(array('H')), uvector.dot(array('i', [100000] * 4), array('i', [100000] * 4)))
+print(uvector.max(array('I', [1, 0xffffffff, 2])), uvector.min(bytearray(b'\x05\x03\x09')))
+
+# fir: dst[n] = taps[0] * src[n + 2] + taps[1] * src[n + 1] + taps[2] * src[n]
+src = array('h', [0, 0, 4, 8, 12, 16, 20])
+out = array('h', [0] * 5)
+print(uvector.fir(out, src, array('h', [1, 2, 1])))
+# Q15 taps averaging each pair of samples
+print(uvector.fir(out, src[1:], array('h', [16384, 16384]), 15))
+
+# errors
+for args in ((d, a, array('h', [1])), (d, array('q', [1] * 5), b), (b'12345', a, b)):
+    try:
+        uvector.add(*args)
+    except (ValueError, TypeError) as e:
+        print(type(e).__name__)
+try:
+    uvector.min(array('b'))
+except ValueError:
+    print('ValueError')
+try:
+    uvector.fir(out, array('h', [1] * 6), array('h', [1, 2, 3]))
+except ValueError:
+    print('ValueError')
@@ -0,0 +1,37 @@
+# test uvector operations on float arrays and conversions to and from them
+
+try:
+    import uvector
+    from array import array
+    array('f')
+except (ImportError, ValueError):
+    print("SKIP")
+    raise SystemExit
+
+def show(v):
+    print([round(x, 3) for x in v])
+
+a = array('f', [0.5, -1.5, 2.25, 4.0])
+b = array('f', [2.0, 4.0, -1.0, 0.5])
+d = array('f', [0] * 4)
+
+show(uvector.add(d, a, b))
+show(uvector.mul(d, a, b))
+show(uvector.mul(d, a, 0.5))
+print(round(uvector.dot(a, b), 3), round(uvector.sum(a), 3), uvector.min(a), uvector.max(a))
+
+# integer samples converted to float with a scale and offset
+adc = array('H', [0, 1024, 2048, 4095])
+show(uvector.scale(d, adc, 1.1 / 4095, -0.55))
+
+# a float scalar makes the arithmetic floating point even for integer arrays
+h = array('h', [10, 20, 30, 40])
+print(uvector.mul(h, h, 0.25))
+
+# float results stored into an integer array are truncated
+print(uvector.add(array('i', [0] * 4), a, b))
+
+# moving average of a float signal
+sig = array('f', [0, 0, 0, 3, 6, 9, 12])
+out = array('f', [0] * 4)
+show(uvector.fir(out, sig, array('f', [1 / 4] * 4)))
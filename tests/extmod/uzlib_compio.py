@@ -0,0 +1,54 @@
+try:
+    import uzlib as zlib
+    import uio as io
+except ImportError:
+    print("SKIP")
+    raise SystemExit
+
+try:
+    zlib.CompIO
+except AttributeError:
+    print("SKIP")
+    raise SystemExit
+
+data = b''.join(b'temp=%d,hum=%d;' % (i % 30, i % 70) for i in range(500))
+
+def compress(data, wbits, chunk=100, flush=False):
+    buf = io.BytesIO()
+    c = zlib.CompIO(buf, wbits)
+    for i in range(0, len(data), chunk):
+        c.write(data[i:i + chunk])
+        if flush:
+            c.flush()
+    c.close()
+    return buf.getvalue()
+
+# zlib, raw deflate and gzip, with and without sync flushes
+for wbits in (9, 10, 12, -10, 16 + 10):
+    for flush in (False, True):
+        z = compress(data, wbits, flush=flush)
+        if wbits < 16:
+            d = zlib.decompress(z, wbits)
+        else:
+            d = zlib.DecompIO(io.BytesIO(z), wbits).read()
+        print(wbits, flush, d == data, len(z) < len(data) // 2)
+
+# small and empty inputs
+print(compress(b'', 10))
+print(zlib.decompress(compress(b'a', 10)))
+print(zlib.decompress(compress(b'ab' * 1000, 10, 1)) == b'ab' * 1000)
+
+# writing after close
+buf = io.BytesIO()
+c = zlib.CompIO(buf)
+c.close()
+c.close()
+try:
+    c.write(b'x')
+except OSError:
+    print('OSError')
+
+try:
+    zlib.CompIO(io.BytesIO(), 8)
+except ValueError:
+    print('ValueError')
@@ -24,15 +24,21 @@ print(ws_read(b"\x81\x04ping", 4))
 print(ws_read(b"\x80\x04ping", 4)) # FRAME_CONT
 print(ws_write(b"pong", 6))
 
-# split frames are not supported
-# print(ws_read(b"\x01\x04ping", 4))
+# split frames
+print(ws_read(b"\x01\x02pi\x80\x02ng", 4))
+print(ws_read(b"\x01\x02pi\x89\x00\x80\x02ng", 4)) # FRAME_PING in the middle
 
 # extended payloads
 print(ws_read(b'\x81~\x00\x80' + b'ping' * 32, 128))
 print(ws_write(b"pong" * 32, 132))
 
+# 64-bit payload length
+print(len(ws_read(b'\x81\x7f\x00\x00\x00\x00\x00\x01\x00\x00' + b'ping' * 16384, 65536)))
+print(ws_write(b"pong" * 16384, 14))
+
 # mask (returned data will be 'mask' ^ 'mask')
 print(ws_read(b"\x81\x84maskmask", 4))
+print(ws_read(b"\x81\x8dmask" + bytes(b ^ b"mask"[i & 3] for i, b in enumerate(b"hello, world!")), 13))
 
 # close control frame
 s = uio.BytesIO(b'\x88\x00') # FRAME_CLOSE
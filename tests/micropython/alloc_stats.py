@@ -0,0 +1,31 @@
+# test allocation tracking by source line
+
+import micropython, gc
+
+try:
+    micropython.alloc_stats
+except AttributeError:
+    print("SKIP")
+    raise SystemExit
+
+def churn(n):
+    out = []
+    for i in range(n):
+        out.append([i, i])
+    return out
+
+micropython.alloc_stats(True)
+churn(100)
+gc.collect()
+sites, history, hist = micropython.alloc_stats()
+micropython.alloc_stats(False)
+
+# the list literal in churn() is line 14
+for file, line, block, count, nbytes in sites:
+    if line == 14:
+        print(block, count >= 100, nbytes > 0)
+print(len(history) >= 1, history[-1][1] >= history[-1][2] > 0)
+print(len(hist), sum(hist) > 0)
+
+# nothing is reported once tracking is off
+print(micropython.alloc_stats()[:2])
@@ -0,0 +1,43 @@
+# test growing buffers into the free blocks before them, and gc.defrag()
+
+import gc
+
+try:
+    gc.defrag
+    gc.realloc_stats
+except AttributeError:
+    print("SKIP")
+    raise SystemExit
+
+# buffers between garbage, each growth may expand in place, backward or move
+bufs = []
+for i in range(50):
+    junk = bytearray(64)
+    b = bytearray(i % 7 + 1)
+    b[0] = i
+    bufs.append(b)
+    junk = None
+gc.collect()
+s0 = gc.realloc_stats()
+for i, b in enumerate(bufs):
+    for j in range(10):
+        b.extend(bytes(range(j * 10, j * 10 + 10)))
+s1 = gc.realloc_stats()
+print(all(b[0] == i and b[-10:] == bytes(range(90, 100)) for i, b in enumerate(bufs)))
+print(len(s1), s1[0] + s1[1] + s1[2] > s0[0] + s0[1] + s0[2])
+
+# lists and arrays moved down keep their contents
+import array
+objs = []
+for i in range(30):
+    junk = [0] * 20
+    objs.append([i] * 10)
+    objs.append(array.array('i', range(i, i + 10)))
+    junk = None
+gc.collect()
+n = gc.defrag(objs + [1, "str", None])
+print(n >= 0, n <= len(objs))
+print(all(objs[2 * i] == [i] * 10 for i in range(30)))
+print(all(list(objs[2 * i + 1]) == list(range(i, i + 10)) for i in range(30)))
+objs[0].append(1)
+print(objs[0][-1])
@@ -0,0 +1,25 @@
+# test small allocations reusing the holes left by a collection
+
+import gc
+
+# fragment the heap with live objects of 1 to 4 blocks between garbage
+live = []
+for i in range(400):
+    obj = [i] * (i % 6)
+    if i % 3 == 0:
+        live.append(obj)
+gc.collect()
+
+# refill the holes, freeing some explicitly along the way
+new = []
+for i in range(400):
+    b = bytearray(i % 40 + 1)
+    b[0] = i & 0xff
+    new.append(b)
+    if i % 5 == 0:
+        del new[-1]
+
+print(all(l == [i * 3] * (i * 3 % 6) for i, l in enumerate(live)))
+kept = [i for i in range(400) if i % 5]
+print(all(b[0] == i & 0xff and len(b) == i % 40 + 1 for i, b in zip(kept, new)))
+print(len(new))
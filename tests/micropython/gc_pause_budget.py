@@ -0,0 +1,37 @@
+# test lazy sweeping of the heap with a pause budget
+
+import gc
+
+try:
+    gc.pause_budget_us
+except AttributeError:
+    print("SKIP")
+    raise SystemExit
+
+old = gc.pause_budget_us()
+gc.pause_budget_us(1)
+print(gc.pause_budget_us())
+
+# keep some objects alive across collections while lots of garbage comes and goes
+live = []
+for i in range(200):
+    live.append([i] * (i % 7 + 1))
+    junk = [bytearray(i % 50 + 1) for _ in range(20)]
+    if i % 25 == 0:
+        gc.collect()
+ok = True
+for i, l in enumerate(live):
+    if l != [i] * (i % 7 + 1):
+        ok = False
+print(ok)
+
+# growing objects in place while the sweep is still pending
+gc.collect()
+b = bytearray()
+for i in range(500):
+    b.extend(b'x')
+print(len(b), gc.mem_free() > 0)
+
+gc.pause_budget_us(-1)
+print(gc.pause_budget_us())
+gc.pause_budget_us(old)
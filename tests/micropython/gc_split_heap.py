@@ -0,0 +1,27 @@
+# test objects of mixed sizes, which a split heap serves from different areas
+
+import gc
+
+small = []
+large = []
+for i in range(50):
+    small.append((i, str(i)))
+    large.append(bytearray([i] * (1000 + i)))
+    if i % 10 == 0:
+        gc.collect()
+
+# small objects referencing large ones and the other way round
+links = [[s, l] for s, l in zip(small, large)]
+large[0] = [list(range(20)) for _ in range(5)]
+gc.collect()
+
+print(all(s == (i, str(i)) for i, s in enumerate(small)))
+print(all(len(l) == 1000 + i and l[0] == i for i, l in enumerate(large) if i))
+print(all(l[0] is small[i] for i, l in enumerate(links)))
+print(large[0][4][19])
+
+# growing a small object into a large one
+b = bytearray(8)
+for i in range(12):
+    b.extend(b)
+print(len(b))
@@ -0,0 +1,37 @@
+# test raising StopIteration from next() with the heap locked
+
+import micropython
+
+try:
+    micropython.heap_lock
+except AttributeError:
+    print("SKIP")
+    raise SystemExit
+
+def exhaust(it, n):
+    count = 0
+    for i in range(n):
+        try:
+            next(it)
+        except StopIteration:
+            count += 1
+    return count
+
+it = iter(())
+micropython.heap_lock()
+n = exhaust(it, 5)
+micropython.heap_unlock()
+print(n)
+
+# the exception still looks like a normal one, and can be re-raised
+def f():
+    return next(iter(()))
+for i in range(2):
+    try:
+        f()
+    except StopIteration as e:
+        print(type(e), e.args)
+        try:
+            raise e
+        except StopIteration as e2:
+            print(e2.args)
@@ -0,0 +1,39 @@
+# test the sampling profiler
+
+import micropython
+
+try:
+    micropython.profile_start
+except AttributeError:
+    print("SKIP")
+    raise SystemExit
+
+print(micropython.profile_stop())
+
+def hot():
+    n = 0
+    for i in range(20000):
+        n += i
+    return n
+
+micropython.profile_start(100, 4096)
+for _ in range(100):
+    hot()
+lines, dropped = micropython.profile_stop()
+
+# every entry is (block, file, line, samples), hottest first
+print(all(len(l) == 4 for l in lines))
+print(all(lines[i][3] >= lines[i + 1][3] for i in range(len(lines) - 1)))
+print(any(l[0] == 'hot' for l in lines), dropped >= 0)
+
+# a tiny buffer drops samples rather than overflowing
+micropython.profile_start(100, 1)
+for _ in range(100):
+    hot()
+lines, dropped = micropython.profile_stop()
+print(sum(l[3] for l in lines), dropped > 0)
+
+try:
+    micropython.profile_start(0)
+except ValueError:
+    print('ValueError')
@@ -0,0 +1,25 @@
+# test interning many qstrs, which grows the qstr hash index
+
+class A:
+    pass
+
+a = A()
+n = 1000
+for i in range(n):
+    setattr(a, 'qstr_index_%d' % i, i)
+
+ok = True
+for i in range(n):
+    if getattr(a, 'qstr_index_%d' % i) != i:
+        ok = False
+print(ok)
+
+# names that already exist in ROM must give the same qstr
+print(getattr(a, 'qstr_index_' + '999'), getattr([1], 'app' + 'end') is not None)
+print(hasattr(a, 'qstr_index_%d' % n))
+
+# strings that collide in their low hash bits still look up correctly
+d = {}
+for i in range(200):
+    d[str(i * 1024)] = i
+print(all(d[str(i * 1024)] == i for i in range(200)))
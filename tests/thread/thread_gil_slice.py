@@ -0,0 +1,44 @@
+# test the adaptive GIL: compute threads still share time, and contention is counted
+
+import _thread
+import time
+
+try:
+    _thread.gil_stats
+except AttributeError:
+    print("SKIP")
+    raise SystemExit
+
+old = _thread.gil_slice_us(500)
+print(_thread.gil_slice_us())
+
+counts = [0, 0]
+stop = False
+n_finished = 0
+lock = _thread.allocate_lock()
+
+def spin(idx):
+    global n_finished
+    while not stop:
+        counts[idx] += 1
+    with lock:
+        n_finished += 1
+
+acq0, cont0, hand0, _ = _thread.gil_stats()
+for i in range(2):
+    _thread.start_new_thread(spin, (i,))
+time.sleep(0.5)
+stop = True
+while n_finished < 2:
+    time.sleep(0.1)
+
+# neither thread was starved and the GIL changed hands between them
+print(counts[0] > 0 and counts[1] > 0)
+acq, cont, hand, waiting = _thread.gil_stats()
+print(acq > acq0, cont > cont0, hand > hand0, waiting >= 0)
+
+try:
+    _thread.gil_slice_us(-1)
+except ValueError:
+    print("ValueError")
+_thread.gil_slice_us(old)
@@ -57,7 +57,8 @@ class FreezeError(Exception):
         return 'error while freezing %s: %s' % (self.rawcode.source_file, self.msg)
 
 class Config:
-    MPY_VERSION = 4
+    MPY_VERSION = 5
+    MPY_VERSION_MIN = 4
     MICROPY_LONGINT_IMPL_NONE = 0
     MICROPY_LONGINT_IMPL_LONGLONG = 1
     MICROPY_LONGINT_IMPL_MPZ = 2
@@ -102,6 +103,7 @@ MP_NATIVE_ARCH_ARMV7EM = 6
 MP_NATIVE_ARCH_ARMV7EMSP = 7
 MP_NATIVE_ARCH_ARMV7EMDP = 8
 MP_NATIVE_ARCH_XTENSA = 9
+MP_NATIVE_ARCH_XTENSAWIN = 10
 
 MP_OPCODE_BYTE = 0
 MP_OPCODE_QSTR = 1
@@ -112,6 +114,10 @@ MP_OPCODE_OFFSET = 3
 MP_BC_MAKE_CLOSURE = 0x62
 MP_BC_MAKE_CLOSURE_DEFARGS = 0x63
 MP_BC_RAISE_VARARGS = 0x5c
+MP_BC_BINARY_OP_SMALL_INT = 0x15
+MP_BC_LOAD_FAST_ATTR = 0x2c
+MP_BC_BINARY_OP_POP_JUMP_IF_TRUE = 0x3a
+MP_BC_BINARY_OP_POP_JUMP_IF_FALSE = 0x3b
 # extra byte if caching enabled:
 MP_BC_LOAD_NAME = 0x1b
 MP_BC_LOAD_GLOBAL = 0x1c
@@ -133,16 +139,16 @@ def make_opcode_format():
     OC4(U, U, U, U), # 0x08-0x0b
     OC4(U, U, U, U), # 0x0c-0x0f
     OC4(B, B, B, U), # 0x10-0x13
-    OC4(V, U, Q, V), # 0x14-0x17
+    OC4(V, V, Q, V), # 0x14-0x17
     OC4(B, V, V, Q), # 0x18-0x1b
     OC4(Q, Q, Q, Q), # 0x1c-0x1f
     OC4(B, B, V, V), # 0x20-0x23
     OC4(Q, Q, Q, B), # 0x24-0x27
     OC4(V, V, Q, Q), # 0x28-0x2b
-    OC4(U, U, U, U), # 0x2c-0x2f
+    OC4(Q, U, U, U), # 0x2c-0x2f
     OC4(B, B, B, B), # 0x30-0x33
     OC4(B, O, O, O), # 0x34-0x37
-    OC4(O, O, U, U), # 0x38-0x3b
+    OC4(O, O, O, O), # 0x38-0x3b
     OC4(U, O, B, O), # 0x3c-0x3f
     OC4(O, B, B, O), # 0x40-0x43
     OC4(O, U, O, B), # 0x44-0x47
@@ -212,12 +218,17 @@ def mp_opcode_format(bytecode, ip, count_var_uint, opcode_format=make_opcode_for
                 or opcode == MP_BC_LOAD_ATTR
                 or opcode == MP_BC_STORE_ATTR):
                 ip += 1
+        if opcode == MP_BC_LOAD_FAST_ATTR:
+            ip += 1
         ip += 3
     else:
         extra_byte = (
             opcode == MP_BC_RAISE_VARARGS
             or opcode == MP_BC_MAKE_CLOSURE
             or opcode == MP_BC_MAKE_CLOSURE_DEFARGS
+            or opcode == MP_BC_BINARY_OP_SMALL_INT
+            or opcode == MP_BC_BINARY_OP_POP_JUMP_IF_TRUE
+            or opcode == MP_BC_BINARY_OP_POP_JUMP_IF_FALSE
         )
         ip += 1
         if f == MP_OPCODE_VAR_UINT:
@@ -300,7 +311,8 @@ class RawCode(object):
             rc.freeze('')
         # TODO
 
-    def freeze_children(self, parent_name):
+    def assign_name(self, parent_name):
+        self.parent_name = parent_name
         self.escaped_name = parent_name + self.simple_name.qstr_esc
 
         # make sure the escaped name is unique
@@ -310,61 +322,92 @@ class RawCode(object):
             i += 1
         RawCode.escaped_names.add(self.escaped_name)
 
+    def assign_names(self, parent_name, out):
+        # name this raw code and all its children, in the order freeze() would
+        self.assign_name(parent_name)
+        out.append(self)
+        for rc in self.raw_codes:
+            rc.assign_names(self.escaped_name + '_', out)
+
+    def freeze_children(self, parent_name):
+        self.assign_name(parent_name)
+
         # emit children first
         for rc in self.raw_codes:
             rc.freeze(self.escaped_name + '_')
 
+    def freeze(self, parent_name):
+        self.freeze_children(parent_name)
+        self.freeze_fun_data()
+        self.freeze_constants()
+        self.freeze_module()
+
+    def used_qstrs(self):
+        # the qstrs this raw code needs at run time, in the order it uses them
+        qstrs = [self.simple_name, self.source_file]
+        qstrs.extend(global_qstrs[qst] for qst in self.qstrs)
+        return qstrs
+
+    def forward_declare(self):
+        if self.simple_name.str != '<module>':
+            print('STATIC ', end='')
+        print('const mp_raw_code_t raw_code_%s;' % self.escaped_name)
+
     def freeze_constants(self):
-        # generate constant objects
         for i, obj in enumerate(self.objs):
-            obj_name = 'const_obj_%s_%u' % (self.escaped_name, i)
-            if obj is MPFunTable:
-                pass
-            elif obj is Ellipsis:
-                print('#define %s mp_const_ellipsis_obj' % obj_name)
-            elif is_str_type(obj) or is_bytes_type(obj):
-                if is_str_type(obj):
-                    obj = bytes_cons(obj, 'utf8')
-                    obj_type = 'mp_type_str'
-                else:
-                    obj_type = 'mp_type_bytes'
-                print('STATIC const mp_obj_str_t %s = {{&%s}, %u, %u, (const byte*)"%s"};'
-                    % (obj_name, obj_type, qstrutil.compute_hash(obj, config.MICROPY_QSTR_BYTES_IN_HASH),
-                        len(obj), ''.join(('\\x%02x' % b) for b in obj)))
-            elif is_int_type(obj):
-                if config.MICROPY_LONGINT_IMPL == config.MICROPY_LONGINT_IMPL_NONE:
-                    # TODO check if we can actually fit this long-int into a small-int
-                    raise FreezeError(self, 'target does not support long int')
-                elif config.MICROPY_LONGINT_IMPL == config.MICROPY_LONGINT_IMPL_LONGLONG:
-                    # TODO
-                    raise FreezeError(self, 'freezing int to long-long is not implemented')
-                elif config.MICROPY_LONGINT_IMPL == config.MICROPY_LONGINT_IMPL_MPZ:
-                    neg = 0
-                    if obj < 0:
-                        obj = -obj
-                        neg = 1
-                    bits_per_dig = config.MPZ_DIG_SIZE
-                    digs = []
-                    z = obj
-                    while z:
-                        digs.append(z & ((1 << bits_per_dig) - 1))
-                        z >>= bits_per_dig
-                    ndigs = len(digs)
-                    digs = ','.join(('%#x' % d) for d in digs)
-                    print('STATIC const mp_obj_int_t %s = {{&mp_type_int}, '
-                        '{.neg=%u, .fixed_dig=1, .alloc=%u, .len=%u, .dig=(uint%u_t*)(const uint%u_t[]){%s}}};'
-                        % (obj_name, neg, ndigs, ndigs, bits_per_dig, bits_per_dig, digs))
-            elif type(obj) is float:
-                print('#if MICROPY_OBJ_REPR == MICROPY_OBJ_REPR_A || MICROPY_OBJ_REPR == MICROPY_OBJ_REPR_B')
-                print('STATIC const mp_obj_float_t %s = {{&mp_type_float}, %.16g};'
-                    % (obj_name, obj))
-                print('#endif')
-            elif type(obj) is complex:
-                print('STATIC const mp_obj_complex_t %s = {{&mp_type_complex}, %.16g, %.16g};'
-                    % (obj_name, obj.real, obj.imag))
+            self.freeze_const_obj(i, obj)
+        self.freeze_const_table()
+
+    def freeze_const_obj(self, i, obj):
+        obj_name = 'const_obj_%s_%u' % (self.escaped_name, i)
+        if obj is MPFunTable:
+            pass
+        elif obj is Ellipsis:
+            print('#define %s mp_const_ellipsis_obj' % obj_name)
+        elif is_str_type(obj) or is_bytes_type(obj):
+            if is_str_type(obj):
+                obj = bytes_cons(obj, 'utf8')
+                obj_type = 'mp_type_str'
             else:
-                raise FreezeError(self, 'freezing of object %r is not implemented' % (obj,))
+                obj_type = 'mp_type_bytes'
+            print('STATIC const mp_obj_str_t %s = {{&%s}, %u, %u, (const byte*)"%s"};'
+                % (obj_name, obj_type, qstrutil.compute_hash(obj, config.MICROPY_QSTR_BYTES_IN_HASH),
+                    len(obj), ''.join(('\\x%02x' % b) for b in obj)))
+        elif is_int_type(obj):
+            if config.MICROPY_LONGINT_IMPL == config.MICROPY_LONGINT_IMPL_NONE:
+                # TODO check if we can actually fit this long-int into a small-int
+                raise FreezeError(self, 'target does not support long int')
+            elif config.MICROPY_LONGINT_IMPL == config.MICROPY_LONGINT_IMPL_LONGLONG:
+                # TODO
+                raise FreezeError(self, 'freezing int to long-long is not implemented')
+            elif config.MICROPY_LONGINT_IMPL == config.MICROPY_LONGINT_IMPL_MPZ:
+                neg = 0
+                if obj < 0:
+                    obj = -obj
+                    neg = 1
+                bits_per_dig = config.MPZ_DIG_SIZE
+                digs = []
+                z = obj
+                while z:
+                    digs.append(z & ((1 << bits_per_dig) - 1))
+                    z >>= bits_per_dig
+                ndigs = len(digs)
+                digs = ','.join(('%#x' % d) for d in digs)
+                print('STATIC const mp_obj_int_t %s = {{&mp_type_int}, '
+                    '{.neg=%u, .fixed_dig=1, .alloc=%u, .len=%u, .dig=(uint%u_t*)(const uint%u_t[]){%s}}};'
+                    % (obj_name, neg, ndigs, ndigs, bits_per_dig, bits_per_dig, digs))
+        elif type(obj) is float:
+            print('#if MICROPY_OBJ_REPR == MICROPY_OBJ_REPR_A || MICROPY_OBJ_REPR == MICROPY_OBJ_REPR_B')
+            print('STATIC const mp_obj_float_t %s = {{&mp_type_float}, %.16g};'
+                % (obj_name, obj))
+            print('#endif')
+        elif type(obj) is complex:
+            print('STATIC const mp_obj_complex_t %s = {{&mp_type_complex}, %.16g, %.16g};'
+                % (obj_name, obj.real, obj.imag))
+        else:
+            raise FreezeError(self, 'freezing of object %r is not implemented' % (obj,))
 
+    def freeze_const_table(self):
         # generate constant table, if it has any entries
         const_table_len = len(self.qstrs) + len(self.objs) + len(self.raw_codes)
         if const_table_len:
@@ -425,12 +468,20 @@ class RawCodeBytecode(RawCode):
     def __init__(self, bytecode, qstrs, objs, raw_codes):
         super(RawCodeBytecode, self).__init__(MP_CODE_BYTECODE, bytecode, 0, qstrs, objs, raw_codes)
 
-    def freeze(self, parent_name):
-        self.freeze_children(parent_name)
+    def used_qstrs(self):
+        qstrs = super(RawCodeBytecode, self).used_qstrs()
+        ip = self.ip
+        while ip < len(self.bytecode):
+            f, sz = mp_opcode_format(self.bytecode, ip, True)
+            if f == 1:
+                qstrs.append(self._unpack_qstr(ip + 1))
+            ip += sz
+        return qstrs
 
+    def freeze_fun_data(self):
         # generate bytecode data
         print()
-        print('// frozen bytecode for file %s, scope %s%s' % (self.source_file.str, parent_name, self.simple_name.str))
+        print('// frozen bytecode for file %s, scope %s%s' % (self.source_file.str, self.parent_name, self.simple_name.str))
         print('STATIC ', end='')
         if not config.MICROPY_OPT_CACHE_MAP_LOOKUP_IN_BYTECODE:
             print('const ', end='')
@@ -457,9 +508,6 @@ class RawCodeBytecode(RawCode):
             ip += sz
         print('};')
 
-        self.freeze_constants()
-        self.freeze_module()
-
 class RawCodeNative(RawCode):
     def __init__(self, code_kind, fun_data, prelude_offset, prelude, qstr_links, qstrs, objs, raw_codes, type_sig):
         super(RawCodeNative, self).__init__(code_kind, fun_data, prelude_offset, qstrs, objs, raw_codes)
@@ -483,7 +531,7 @@ class RawCodeNative(RawCode):
         else:
             if kind == 2:
                 qst = '((uintptr_t)MP_OBJ_NEW_QSTR(%s))' % qst
-            if config.native_arch in (MP_NATIVE_ARCH_X86, MP_NATIVE_ARCH_X64):
+            if config.native_arch in (MP_NATIVE_ARCH_X86, MP_NATIVE_ARCH_X64, MP_NATIVE_ARCH_XTENSA, MP_NATIVE_ARCH_XTENSAWIN):
                 print('    %s & 0xff, %s >> 8, 0, 0,' % (qst, qst))
             elif MP_NATIVE_ARCH_ARMV6M <= config.native_arch <= MP_NATIVE_ARCH_ARMV7EMDP:
                 if is_obj:
@@ -495,16 +543,25 @@ class RawCodeNative(RawCode):
                 assert 0
 
     def freeze(self, parent_name):
-        self.freeze_children(parent_name)
+        if self.code_kind == MP_CODE_NATIVE_PY and config.native_arch == MP_NATIVE_ARCH_XTENSAWIN:
+            # the prelude must be a separate bytes object, which is not yet supported here
+            raise FreezeError(self, 'freezing of native code for xtensawin is not implemented')
+        super(RawCodeNative, self).freeze(parent_name)
+
+    def used_qstrs(self):
+        qstrs = super(RawCodeNative, self).used_qstrs()
+        qstrs.extend(global_qstrs[qst] for _, _, qst in self.qstr_links)
+        return qstrs
 
+    def freeze_fun_data(self):
         # generate native code data
         print()
         if self.code_kind == MP_CODE_NATIVE_PY:
-            print('// frozen native code for file %s, scope %s%s' % (self.source_file.str, parent_name, self.simple_name.str))
+            print('// frozen native code for file %s, scope %s%s' % (self.source_file.str, self.parent_name, self.simple_name.str))
         elif self.code_kind == MP_CODE_NATIVE_VIPER:
-            print('// frozen viper code for scope %s' % (parent_name,))
+            print('// frozen viper code for scope %s' % (self.parent_name,))
         else:
-            print('// frozen assembler code for scope %s' % (parent_name,))
+            print('// frozen assembler code for scope %s' % (self.parent_name,))
         print('STATIC const byte fun_data_%s[%u] %s = {' % (self.escaped_name, len(self.bytecode), self.fun_data_attributes))
 
         if self.code_kind == MP_CODE_NATIVE_PY:
@@ -548,8 +605,8 @@ class RawCodeNative(RawCode):
 
         print('};')
 
-        self.freeze_constants()
-        self.freeze_module(self.qstr_links, self.type_sig)
+    def freeze_module(self):
+        super(RawCodeNative, self).freeze_module(self.qstr_links, self.type_sig)
 
 class BytecodeBuffer:
     def __init__(self, size):
@@ -708,7 +765,7 @@ def read_mpy(filename):
         header = bytes_cons(f.read(4))
         if header[0] != ord('M'):
             raise Exception('not a valid .mpy file')
-        if header[1] != config.MPY_VERSION:
+        if not config.MPY_VERSION_MIN <= header[1] <= config.MPY_VERSION:
             raise Exception('incompatible .mpy version')
         feature_byte = header[2]
         qw_size = read_uint(f)
@@ -723,10 +780,81 @@ def dump_mpy(raw_codes):
     for rc in raw_codes:
         rc.dump()
 
-def freeze_mpy(base_qstrs, raw_codes):
+def load_profile(filename):
+    # the repr() of what micropython.profile_stop() returned, or just its list of lines
+    import ast
+    with open(filename) as f:
+        profile = ast.literal_eval(f.read())
+    if isinstance(profile, tuple):
+        profile = profile[0]
+    samples = {}
+    for block, source_file, line, n in profile:
+        if block is not None:
+            key = (source_file, block)
+            samples[key] = samples.get(key, 0) + n
+    return samples
+
+# constant objects are grouped by type, so the objects of one kind share cache lines
+def const_obj_kind(obj):
+    if is_str_type(obj):
+        return 0
+    elif is_bytes_type(obj):
+        return 1
+    elif is_int_type(obj):
+        return 2
+    elif type(obj) is float:
+        return 3
+    else:
+        return 4
+
+def hot_raw_codes(raw_codes, profile):
+    # the functions the profile sampled, hottest first
+    hot = []
+    todo = list(raw_codes)
+    while todo:
+        rc = todo.pop(0)
+        rc.samples = profile.get((rc.source_file.str, rc.simple_name.str), 0)
+        if rc.samples:
+            hot.append(rc)
+        todo.extend(rc.raw_codes)
+    hot.sort(key=lambda rc: -rc.samples)
+    return hot
+
+def freeze_layout(raw_codes, hot):
+    # name everything up front, the order of emission no longer follows the nesting
+    all_rcs = []
+    for rc in raw_codes:
+        rc.assign_names(rc.source_file.str.replace('/', '_')[:-3] + '_', all_rcs)
+    cold = [rc for rc in all_rcs if not rc.samples]
+
+    print()
+    print('// layout from profile, %u of %u functions are hot' % (len(hot), len(all_rcs)))
+    for rc in all_rcs:
+        rc.forward_declare()
+
+    # the code of a group comes right after its constants, so hot code and data are contiguous
+    for group in (hot, cold):
+        objs = [(const_obj_kind(obj), rc, i, obj) for rc in group for i, obj in enumerate(rc.objs)]
+        objs.sort(key=lambda o: o[0])
+        print()
+        for _, rc, i, obj in objs:
+            rc.freeze_const_obj(i, obj)
+        for rc in group:
+            rc.freeze_fun_data()
+            rc.freeze_const_table()
+            rc.freeze_module()
+
+def freeze_mpy(base_qstrs, raw_codes, profile=None):
+    # the qstrs of the hot functions go first in the pool, in the order they are used
+    hot_qstrs = []
+    if profile is not None:
+        hot = hot_raw_codes(raw_codes, profile)
+        for rc in hot:
+            hot_qstrs.extend(rc.used_qstrs())
+
     # add to qstrs
     new = {}
-    for q in global_qstrs:
+    for q in hot_qstrs + global_qstrs:
         # don't add duplicates
         if q is None or q.qstr_esc in base_qstrs or q.qstr_esc in new:
             continue
@@ -799,8 +927,11 @@ def freeze_mpy(base_qstrs, raw_codes):
     print('    },')
     print('};')
 
-    for rc in raw_codes:
-        rc.freeze(rc.source_file.str.replace('/', '_')[:-3] + '_')
+    if profile is None:
+        for rc in raw_codes:
+            rc.freeze(rc.source_file.str.replace('/', '_')[:-3] + '_')
+    else:
+        freeze_layout(raw_codes, hot)
 
     print()
     print('const char mp_frozen_mpy_names[] = {')
@@ -823,6 +954,8 @@ def main():
         help='freeze files')
     cmd_parser.add_argument('-q', '--qstr-header',
         help='qstr header file to freeze against')
+    cmd_parser.add_argument('-p', '--profile',
+        help='output of micropython.profile_stop() to lay out the frozen code by')
     cmd_parser.add_argument('-mlongint-impl', choices=['none', 'longlong', 'mpz'], default='mpz',
         help='long-int implementation used by target (default mpz)')
     cmd_parser.add_argument('-mmpz-dig-size', metavar='N', type=int, default=16,
@@ -855,7 +988,8 @@ def main():
         dump_mpy(raw_codes)
     elif args.freeze:
         try:
-            freeze_mpy(base_qstrs, raw_codes)
+            profile = load_profile(args.profile) if args.profile else None
+            freeze_mpy(base_qstrs, raw_codes, profile)
         except FreezeError as er:
             print(er, file=sys.stderr)
             sys.exit(1)
@@ -2,11 +2,16 @@
 import argparse
 import os
 import os.path
+import re
 
 argparser = argparse.ArgumentParser(description="Compile all .py files to .mpy recursively")
 argparser.add_argument("-o", "--out", help="output directory (default: input dir)")
 argparser.add_argument("--target", help="select MicroPython target config")
 argparser.add_argument("-mcache-lookup-bc", action="store_true", help="cache map lookups in the bytecode")
+argparser.add_argument("-D", dest="defines", action="append", default=[], metavar="NAME=INT",
+    help="constant folded into every module, e.g. -D DEBUG=0 to drop the 'if DEBUG:' blocks")
+argparser.add_argument("--inline-consts", action="store_true",
+    help="fold the const() values that a module imports by name from another module of the tree")
 argparser.add_argument("dir", help="input directory")
 args = argparser.parse_args()
 
@@ -22,17 +27,79 @@ if not args.out:
 
 path_prefix_len = len(args.dir) + 1
 
+RE_CONST = re.compile(r"^([A-Za-z]\w*)\s*=\s*const\(\s*(-?(?:0[xob])?[0-9a-fA-F]+)\s*\)", re.M)
+RE_FROM_IMPORT = re.compile(r"^\s*from\s+([\w.]+)\s+import\s+([\w ,]+?)\s*(?:#.*)?$", re.M)
+
+def module_name(rel_path):
+    name = rel_path[:-3].replace("/", ".")
+    if name.endswith(".__init__"):
+        name = name[:-len(".__init__")]
+    return name
+
+# Module-level constants of each module, by module name.  Names starting with
+# an underscore aren't stored in the module so they can't be imported.
+def scan_consts(py_files):
+    consts = {}
+    for rel_path, fpath in py_files:
+        with open(fpath) as f:
+            src = f.read()
+        found = {}
+        for name, value in RE_CONST.findall(src):
+            try:
+                found[name] = int(value, 0)
+            except ValueError:
+                pass
+        consts[module_name(rel_path)] = found
+    return consts
+
+# The -D options that inline into fpath the constants it gets with
+# "from <module of the tree> import NAME [as ALIAS]".  A name that the module
+# also assigns itself is left alone, since folding it would break the store.
+def inline_defines(fpath, consts):
+    with open(fpath) as f:
+        src = f.read()
+    defines = []
+    for mod, names in RE_FROM_IMPORT.findall(src):
+        mod_consts = consts.get(mod)
+        if not mod_consts:
+            continue
+        for item in names.split(","):
+            parts = item.split()
+            if len(parts) == 3 and parts[1] == "as":
+                name, alias = parts[0], parts[2]
+            elif len(parts) == 1:
+                name = alias = parts[0]
+            else:
+                continue
+            if name not in mod_consts:
+                continue
+            if re.search(r"^\s*%s\s*[-+*/|&^]?=[^=]" % re.escape(alias), src, re.M):
+                continue
+            if re.search(r"^\s*(def|class)\s+%s\b" % re.escape(alias), src, re.M):
+                continue
+            defines.append("%s=%d" % (alias, mod_consts[name]))
+    return defines
+
+py_files = []
 for path, subdirs, files in os.walk(args.dir):
     for f in files:
         if f.endswith(".py"):
             fpath = path + "/" + f
-            #print(fpath)
-            out_fpath = args.out + "/" + fpath[path_prefix_len:-3] + ".mpy"
-            out_dir = os.path.dirname(out_fpath)
-            if not os.path.isdir(out_dir):
-                os.makedirs(out_dir)
-            cmd = "mpy-cross -v -v %s -s %s %s -o %s" % (TARGET_OPTS.get(args.target, ""),
-                fpath[path_prefix_len:], fpath, out_fpath)
-            #print(cmd)
-            res = os.system(cmd)
-            assert res == 0
+            py_files.append((fpath[path_prefix_len:], fpath))
+
+consts = scan_consts(py_files) if args.inline_consts else {}
+
+for rel_path, fpath in py_files:
+    #print(fpath)
+    out_fpath = args.out + "/" + rel_path[:-3] + ".mpy"
+    out_dir = os.path.dirname(out_fpath)
+    if not os.path.isdir(out_dir):
+        os.makedirs(out_dir)
+    defines = list(args.defines)
+    if args.inline_consts:
+        defines += inline_defines(fpath, consts)
+    cmd = "mpy-cross -v -v %s %s -s %s %s -o %s" % (TARGET_OPTS.get(args.target, ""),
+        " ".join("-D " + d for d in defines), rel_path, fpath, out_fpath)
+    #print(cmd)
+    res = os.system(cmd)
+    assert res == 0
@@ -0,0 +1,282 @@
+#!/usr/bin/env python3
+#
+# This file is part of the MicroPython project, http://micropython.org/
+#
+# The MIT License (MIT)
+#
+# Copyright (c) 2021 Pycom Limited
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+
+"""
+differential filesystem sync over the raw REPL
+
+Copies a local directory tree to the filesystem of one or more boards,
+sending only the files whose SHA256 differs from the copy on the board.
+A small agent is executed on the board after the soft reset done by
+entering the raw REPL; it hashes files with uhashlib.file_digest (the
+SHA accelerator on the esp32), inflates the deflate-compressed chunks
+sent by the host with uzlib and writes them to the filesystem in large
+batches. Files are written to a temporary name and only renamed into
+place once their hash has been checked, so an interrupted sync never
+leaves a truncated file behind.
+
+Example usage:
+
+    ./pysync.py --device /dev/ttyUSB0 --device /dev/ttyUSB1 app/
+
+Several devices are updated in parallel, each over its own connection.
+"""
+
+import argparse
+import ast
+import binascii
+import hashlib
+import os
+import sys
+import threading
+import zlib
+
+import pyboard
+
+# raw data per compressed chunk; the board inflates one chunk at a time
+CHUNK_SIZE = 2048
+# base64 text sent in one raw REPL command, several chunks are batched in it
+COMMAND_SIZE = 6144
+# bytes the agent accumulates before writing them to the filesystem
+WRITE_BATCH = 4096
+
+# runs on the board; the names start with _sy_ to stay out of the way of user code
+AGENT = """
+import ubinascii, uzlib
+try:
+    import uos as os
+except ImportError:
+    import os
+try:
+    from uhashlib import file_digest as _sy_fd
+except ImportError:
+    _sy_fd = None
+def _sy_digest(p):
+    try:
+        if _sy_fd:
+            return ubinascii.hexlify(_sy_fd(p))
+        import uhashlib
+        h = uhashlib.sha256()
+        with open(p, 'rb') as f:
+            while True:
+                b = f.read(1024)
+                if not b:
+                    break
+                h.update(b)
+        return ubinascii.hexlify(h.digest())
+    except OSError:
+        return None
+def _sy_hashes(ps):
+    print(repr([_sy_digest(p) for p in ps]))
+def _sy_walk(d, out):
+    try:
+        ns = os.listdir(d)
+    except OSError:
+        return
+    for n in ns:
+        p = d + '/' + n
+        if os.stat(p)[0] & 0x4000:
+            _sy_walk(p, out)
+        else:
+            out.append(p)
+def _sy_list(d):
+    out = []
+    _sy_walk(d, out)
+    print(repr(out))
+def _sy_mkdirs(p):
+    d = ''
+    for n in p.split('/')[1:-1]:
+        d += '/' + n
+        try:
+            os.mkdir(d)
+        except OSError:
+            pass
+def _sy_open(p):
+    global _sy_f, _sy_b
+    _sy_mkdirs(p)
+    _sy_f = open(p + '.part', 'wb')
+    _sy_b = bytearray()
+def _sy_put(d):
+    global _sy_b
+    _sy_b.extend(uzlib.decompress(ubinascii.a2b_base64(d)))
+    if len(_sy_b) >= %d:
+        _sy_f.write(_sy_b)
+        _sy_b = bytearray()
+def _sy_close(p, h):
+    _sy_f.write(_sy_b)
+    _sy_f.close()
+    if _sy_digest(p + '.part') != h:
+        os.remove(p + '.part')
+        print(0)
+        return
+    try:
+        os.remove(p)
+    except OSError:
+        pass
+    os.rename(p + '.part', p)
+    print(1)
+""" % WRITE_BATCH
+
+class SyncError(Exception):
+    pass
+
+def local_files(src):
+    # maps the path relative to src, with '/' separators, to the local path
+    files = {}
+    for root, dirs, names in os.walk(src):
+        dirs.sort()
+        for name in sorted(names):
+            path = os.path.join(root, name)
+            rel = os.path.relpath(path, src).replace(os.sep, '/')
+            files[rel] = path
+    return files
+
+def local_digest(path):
+    h = hashlib.sha256()
+    with open(path, 'rb') as f:
+        for block in iter(lambda: f.read(65536), b''):
+            h.update(block)
+    return h.hexdigest().encode('ascii')
+
+class Syncer:
+    def __init__(self, pyb, dest, log):
+        self.pyb = pyb
+        self.dest = dest.rstrip('/')
+        self.log = log
+        self.sent = 0
+        self.raw = 0
+
+    def start(self):
+        self.pyb.enter_raw_repl()
+        self.pyb.exec_(AGENT)
+
+    def eval(self, command, timeout=60):
+        ret, ret_err = self.pyb.exec_raw(command, timeout=timeout)
+        if ret_err:
+            raise SyncError(ret_err.decode('utf8', 'replace').strip())
+        return ast.literal_eval(ret.decode('utf8').strip())
+
+    def remote_hashes(self, rels):
+        # batched so that the command and its result stay small on the board
+        hashes = []
+        for i in range(0, len(rels), 32):
+            paths = [self.dest + '/' + rel for rel in rels[i:i + 32]]
+            hashes += self.eval('_sy_hashes(%r)' % paths)
+        return hashes
+
+    def put(self, rel, path, digest):
+        remote = self.dest + '/' + rel
+        self.pyb.exec_('_sy_open(%r)' % remote)
+        calls = []
+        size = 0
+        with open(path, 'rb') as f:
+            for raw in iter(lambda: f.read(CHUNK_SIZE), b''):
+                data = binascii.b2a_base64(zlib.compress(raw, 9)).strip()
+                self.raw += len(raw)
+                self.sent += len(data)
+                calls.append('_sy_put(%r)' % data)
+                size += len(data)
+                if size >= COMMAND_SIZE:
+                    self.pyb.exec_('\n'.join(calls))
+                    calls = []
+                    size = 0
+        if calls:
+            self.pyb.exec_('\n'.join(calls))
+        if not self.eval('_sy_close(%r, %r)' % (remote, digest)):
+            raise SyncError('hash mismatch after writing ' + remote)
+
+    def sync(self, src, delete=False, dry_run=False):
+        files = local_files(src)
+        rels = sorted(files)
+        digests = [local_digest(files[rel]) for rel in rels]
+        remote = self.remote_hashes(rels)
+        changed = [(rel, digest) for rel, digest, have in zip(rels, digests, remote) if digest != have]
+        self.log('%d of %d files changed' % (len(changed), len(rels)))
+        for rel, digest in changed:
+            self.log('put ' + rel)
+            if not dry_run:
+                self.put(rel, files[rel], digest)
+        if delete:
+            wanted = set(self.dest + '/' + rel for rel in rels)
+            for path in self.eval('_sy_list(%r)' % self.dest):
+                if path not in wanted:
+                    self.log('delete ' + path)
+                    if not dry_run:
+                        self.pyb.exec_('os.remove(%r)' % path)
+        if self.raw:
+            self.log('sent %d bytes for %d bytes of data' % (self.sent, self.raw))
+
+def sync_device(args, device, results, lock):
+    def log(msg):
+        with lock:
+            print('%s: %s' % (device, msg))
+    try:
+        pyb = pyboard.Pyboard(device, args.baudrate, args.user, args.password, args.wait)
+    except pyboard.PyboardError as er:
+        log(er)
+        return
+    try:
+        syncer = Syncer(pyb, args.dest, log)
+        syncer.start()
+        syncer.sync(args.src, args.delete, args.dry_run)
+        pyb.exit_raw_repl()
+        results[device] = True
+    except (pyboard.PyboardError, SyncError) as er:
+        log('failed: %s' % (er,))
+    finally:
+        pyb.close()
+
+def main():
+    cmd_parser = argparse.ArgumentParser(description='Copy the changed files of a directory to one or more boards.')
+    cmd_parser.add_argument('--device', action='append', help='a serial device or IP address, may be given several times')
+    cmd_parser.add_argument('-b', '--baudrate', default=115200, help='the baud rate of the serial devices')
+    cmd_parser.add_argument('-u', '--user', default='micro', help='the telnet login username')
+    cmd_parser.add_argument('-p', '--password', default='python', help='the telnet login password')
+    cmd_parser.add_argument('-w', '--wait', default=0, type=int, help='seconds to wait for USB connected boards to become available')
+    cmd_parser.add_argument('--dest', default='/flash', help='directory on the boards to sync into [default /flash]')
+    cmd_parser.add_argument('--delete', action='store_true', help='remove the files under dest that are not in src')
+    cmd_parser.add_argument('-n', '--dry-run', action='store_true', help='only show what would be changed')
+    cmd_parser.add_argument('src', help='local directory to copy')
+    args = cmd_parser.parse_args()
+
+    if not os.path.isdir(args.src):
+        print('%s is not a directory' % args.src)
+        sys.exit(1)
+    devices = args.device or ['/dev/ttyUSB0']
+
+    results = {}
+    lock = threading.Lock()
+    threads = [threading.Thread(target=sync_device, args=(args, device, results, lock)) for device in devices]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+    if len(results) != len(devices):
+        print('%d of %d devices failed' % (len(devices) - len(results), len(devices)))
+        sys.exit(1)
+
+if __name__ == "__main__":
+    main()